@@ -2,6 +2,7 @@
 #include "allegro5/allegro_audio.h"
 #include "allegro5/internal/aintern_acodec_cfg.h"
 #include "acodec.h"
+#include "helper.h"
 
 
 /* globals */
@@ -22,6 +23,8 @@ bool al_init_acodec_addon(void)
 {
    bool ret = true;
 
+   _al_acodec_init_dynlib_lock();
+
    ret &= al_register_sample_loader(".wav", _al_load_wav);
    ret &= al_register_sample_saver(".wav", _al_save_wav);
    ret &= al_register_audio_stream_loader(".wav", _al_load_wav_audio_stream);
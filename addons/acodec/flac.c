@@ -35,6 +35,15 @@ typedef struct FLACFILE {
    uint64_t buffer_pos, buffer_size;
    char *buffer;
 
+   /* Start of the samples in the buffer which have not been streamed yet. */
+   uint64_t buffer_start;
+
+   /* When streaming, the decoder writes up to this many samples straight
+    * into the stream fragment, and only the rest into the buffer.
+    */
+   char *direct;
+   uint64_t direct_samples;
+
    /* Number of samples in the complete FLAC. */
    uint64_t total_samples;
 
@@ -91,7 +100,7 @@ static void shutdown_dynlib(void)
 #endif
 
 
-static bool init_dynlib(void)
+static bool load_dynlib(void)
 {
 #ifdef ALLEGRO_CFG_ACODEC_FLAC_DLL
    if (flac_dll) {
@@ -121,12 +130,12 @@ static bool init_dynlib(void)
             return false;                                                     \
          }                                                                    \
       } while(0)
+
+   memset(&lib, 0, sizeof(lib));
 #else
    #define INITSYM(x)   (lib.x = (x))
 #endif
 
-   memset(&lib, 0, sizeof(lib));
-
    INITSYM(FLAC__stream_decoder_new);
    INITSYM(FLAC__stream_decoder_delete);
    INITSYM(FLAC__stream_decoder_init_stream);
@@ -143,6 +152,20 @@ static bool init_dynlib(void)
 }
 
 
+/* Samples may be loaded on several threads at once, see
+ * al_load_samples_batch.
+ */
+static bool init_dynlib(void)
+{
+   bool ret;
+
+   _al_acodec_lock_dynlibs();
+   ret = load_dynlib();
+   _al_acodec_unlock_dynlibs();
+   return ret;
+}
+
+
 static FLAC__StreamDecoderReadStatus read_callback(const FLAC__StreamDecoder *decoder,
    FLAC__byte buffer[], size_t *bytes, void *dptr)
 {
@@ -256,39 +279,26 @@ static void error_callback(const FLAC__StreamDecoder *decoder,
 }
 
 
-static FLAC__StreamDecoderWriteStatus write_callback(
-   const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame,
-   const FLAC__int32 * const buffer[], void *client_data)
+/* Converts 'count' samples of the frame starting at 'first' from the
+ * FLAC__int32 per channel arrays to interleaved samples at 'dest'.
+ */
+static bool flatten_samples(FLACFILE *ff, const FLAC__int32 * const buffer[],
+   long first, long count, char *dest)
 {
-   FLACFILE *ff = (FLACFILE *) client_data;
-   long len = frame->header.blocksize;
-   long bytes = len * ff->channels * ff->sample_size;
-   FLAC__uint8 *buf8;
-   FLAC__int16 *buf16;
-   float *buf32;
-   int sample_index;
+   FLAC__uint8 *buf8 = (FLAC__uint8 *) dest;
+   FLAC__int16 *buf16 = (FLAC__int16 *) dest;
+   float *buf32 = (float *) dest;
+   long end = first + count;
+   long sample_index;
    int channel_index;
    int out_index;
 
-   if (ff->buffer_pos + bytes > ff->buffer_size) {
-      ff->buffer = al_realloc(ff->buffer, ff->buffer_pos + bytes);
-      ff->buffer_size = ff->buffer_pos + bytes;
-   }
-
-   /* FLAC returns FLAC__int32 and I need to convert it to my own format. */
-   buf8 = (FLAC__uint8 *) (ff->buffer + ff->buffer_pos);
-   buf16 = (FLAC__int16 *) buf8;
-   buf32 = (float *) buf8;
-
-   (void)decoder;
-   (void)client_data;
-
    /* Flatten the array */
    /* TODO: test this array flattening process on 5.1 and higher flac files */
    out_index = 0;
    switch (ff->sample_size) {
       case 1:
-         for (sample_index = 0; sample_index < len; sample_index++) {
+         for (sample_index = first; sample_index < end; sample_index++) {
              for (channel_index = 0;
                   channel_index < ff->channels;
                   channel_index++) {
@@ -299,7 +309,7 @@ static FLAC__StreamDecoderWriteStatus write_callback(
          break;
 
       case 2:
-         for (sample_index = 0; sample_index < len; sample_index++) {
+         for (sample_index = first; sample_index < end; sample_index++) {
              for (channel_index = 0; channel_index < ff->channels;
                    channel_index++) {
                 buf16[out_index++] =
@@ -309,7 +319,7 @@ static FLAC__StreamDecoderWriteStatus write_callback(
          break;
 
       case 3:
-         for (sample_index = 0; sample_index < len; sample_index++) {
+         for (sample_index = first; sample_index < end; sample_index++) {
              for (channel_index = 0; channel_index < ff->channels;
                 channel_index++)
              {
@@ -325,7 +335,7 @@ static FLAC__StreamDecoderWriteStatus write_callback(
          break;
 
       case 4:
-         for (sample_index = 0; sample_index < len; sample_index++) {
+         for (sample_index = first; sample_index < end; sample_index++) {
              for (channel_index = 0; channel_index < ff->channels;
                    channel_index++) {
                 buf32[out_index++] =
@@ -336,6 +346,44 @@ static FLAC__StreamDecoderWriteStatus write_callback(
 
       default:
          /* Word_size not supported. */
+         return false;
+   }
+
+   return true;
+}
+
+
+static FLAC__StreamDecoderWriteStatus write_callback(
+   const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame,
+   const FLAC__int32 * const buffer[], void *client_data)
+{
+   FLACFILE *ff = (FLACFILE *) client_data;
+   long len = frame->header.blocksize;
+   long sample_bytes = ff->channels * ff->sample_size;
+   long direct = 0;
+   long bytes;
+
+   (void)decoder;
+
+   /* FLAC returns FLAC__int32 and I need to convert it to my own format. */
+   if (ff->direct_samples > 0) {
+      direct = len;
+      if ((uint64_t)direct > ff->direct_samples)
+         direct = ff->direct_samples;
+      if (!flatten_samples(ff, buffer, 0, direct, ff->direct))
+         return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+      ff->direct += direct * sample_bytes;
+      ff->direct_samples -= direct;
+   }
+
+   bytes = (len - direct) * sample_bytes;
+   if (bytes > 0) {
+      if (ff->buffer_pos + bytes > ff->buffer_size) {
+         ff->buffer = al_realloc(ff->buffer, ff->buffer_pos + bytes);
+         ff->buffer_size = ff->buffer_pos + bytes;
+      }
+      if (!flatten_samples(ff, buffer, direct, len - direct,
+            ff->buffer + ff->buffer_pos))
          return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
    }
 
@@ -388,15 +436,29 @@ static size_t flac_stream_update(ALLEGRO_AUDIO_STREAM *stream, void *data,
       read_samples = ff->decoded_samples - ff->streamed_samples;
 
       /* If the buffer size is small, we shouldn't read a new frame or our
-       * buffer keeps growing - so only refill when needed.
+       * buffer keeps growing - so only refill when needed.  The new frame is
+       * decoded straight into the stream buffer as far as it fits.
        */
       if (!read_samples) {
-         if (!lib.FLAC__stream_decoder_process_single(ff->decoder))
+         FLAC__bool ok;
+
+         ff->buffer_pos = 0;
+         ff->buffer_start = 0;
+         ff->direct = (char *)data + written_bytes;
+         ff->direct_samples = wanted_samples;
+         ok = lib.FLAC__stream_decoder_process_single(ff->decoder);
+         read_samples = wanted_samples - ff->direct_samples;
+         ff->direct = NULL;
+         ff->direct_samples = 0;
+
+         ff->streamed_samples += read_samples;
+         wanted_samples -= read_samples;
+         written_bytes += read_samples * bytes_per_sample;
+         if (!ok)
             break;
-         read_samples = ff->decoded_samples - ff->streamed_samples;
-         if (!read_samples) {
+         if (!read_samples && ff->decoded_samples == ff->streamed_samples)
             break;
-         }
+         continue;
       }
 
       if (read_samples > wanted_samples)
@@ -405,11 +467,9 @@ static size_t flac_stream_update(ALLEGRO_AUDIO_STREAM *stream, void *data,
       wanted_samples -= read_samples;
       read_bytes = read_samples * bytes_per_sample;
       /* Copy data from the FLAC file buffer to the stream buffer. */
-      memcpy((uint8_t *)data + written_bytes, ff->buffer, read_bytes);
-      /* Make room in the FLACFILE buffer. */
-      memmove(ff->buffer, ff->buffer + read_bytes,
-         ff->buffer_pos - read_bytes);
-      ff->buffer_pos -= read_bytes;
+      memcpy((uint8_t *)data + written_bytes, ff->buffer + ff->buffer_start,
+         read_bytes);
+      ff->buffer_start += read_bytes;
       written_bytes += read_bytes;
    }
 
@@ -440,6 +500,7 @@ static bool real_seek(ALLEGRO_AUDIO_STREAM *stream, uint64_t sample)
    lib.FLAC__stream_decoder_seek_absolute(ff->decoder, sample);
 
    ff->buffer_pos = 0;
+   ff->buffer_start = 0;
    ff->streamed_samples = sample;
    ff->decoded_samples = sample;
    return true;
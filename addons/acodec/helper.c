@@ -1,36 +1,57 @@
+#include <string.h>
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_audio.h"
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_audio.h"
+#include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_system.h"
 #include "helper.h"
 
+/* Serialises loading the codec libraries. */
+static ALLEGRO_MUTEX *dynlib_mutex = NULL;
+
 void _al_acodec_start_feed_thread(ALLEGRO_AUDIO_STREAM *stream)
 {
-   stream->feed_thread = al_create_thread(_al_kcm_feed_stream, stream);
-   stream->feed_thread_started_cond = al_create_cond();
-   stream->feed_thread_started_mutex = al_create_mutex();
-   al_start_thread(stream->feed_thread);
+   _al_kcm_start_feeding_stream(stream);
 }
 
 void _al_acodec_stop_feed_thread(ALLEGRO_AUDIO_STREAM *stream)
 {
-   ALLEGRO_EVENT quit_event;
+   _al_kcm_stop_feeding_stream(stream);
+}
+
+/* Whether decoders which produce floats anyway should stream them as is. */
+bool _al_acodec_want_float_streams(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "audio",
+      "stream_depth");
+
+   return value && !strcmp(value, "float32");
+}
 
-   /* Need to wait for the thread to start, otherwise the quit event may be
-    * sent before the event source is registered with the queue. */
-   al_lock_mutex(stream->feed_thread_started_mutex);
-   while (!stream->feed_thread_started) {
-      al_wait_cond(stream->feed_thread_started_cond, stream->feed_thread_started_mutex);
+static void destroy_dynlib_lock(void)
+{
+   al_destroy_mutex(dynlib_mutex);
+   dynlib_mutex = NULL;
+}
+
+void _al_acodec_init_dynlib_lock(void)
+{
+   if (!dynlib_mutex) {
+      dynlib_mutex = al_create_mutex();
+      _al_add_exit_func(destroy_dynlib_lock, "destroy_dynlib_lock");
    }
-   al_unlock_mutex(stream->feed_thread_started_mutex);
+}
 
-   quit_event.type = _KCM_STREAM_FEEDER_QUIT_EVENT_TYPE;
-   al_emit_user_event(al_get_audio_stream_event_source(stream), &quit_event, NULL);
-   al_join_thread(stream->feed_thread, NULL);
-   al_destroy_thread(stream->feed_thread);
-   al_destroy_cond(stream->feed_thread_started_cond);
-   al_destroy_mutex(stream->feed_thread_started_mutex);
+void _al_acodec_lock_dynlibs(void)
+{
+   if (dynlib_mutex)
+      al_lock_mutex(dynlib_mutex);
+}
 
-   stream->feed_thread = NULL;
+void _al_acodec_unlock_dynlibs(void)
+{
+   if (dynlib_mutex)
+      al_unlock_mutex(dynlib_mutex);
 }
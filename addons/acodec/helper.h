@@ -3,5 +3,10 @@
 
 void _al_acodec_start_feed_thread(ALLEGRO_AUDIO_STREAM *stream);
 void _al_acodec_stop_feed_thread(ALLEGRO_AUDIO_STREAM *stream);
+bool _al_acodec_want_float_streams(void);
+
+void _al_acodec_init_dynlib_lock(void);
+void _al_acodec_lock_dynlibs(void);
+void _al_acodec_unlock_dynlibs(void);
 
 #endif
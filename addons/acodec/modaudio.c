@@ -8,6 +8,7 @@
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_acodec.h"
 #include "allegro5/allegro_audio.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_audio.h"
 #include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_system.h"
@@ -22,6 +23,7 @@
 #define DUMB_DECLARE_DEPRECATED
 #include <dumb.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 ALLEGRO_DEBUG_CHANNEL("acodec")
 
@@ -51,6 +53,10 @@ typedef struct MOD_FILE
    ALLEGRO_FILE *fh;
    double length;
    long loop_start, loop_end;
+   int frequency;
+   bool float_out;
+   sample_t **samples;     /* DUMB's output for float streams */
+   long samples_size;      /* in frames */
 } MOD_FILE;
 
 
@@ -90,6 +96,12 @@ static struct
    void (*dumb_it_set_loop_callback)(DUMB_IT_SIGRENDERER *, int (*)(void *), void *);
    void (*dumb_it_set_xm_speed_zero_callback)(DUMB_IT_SIGRENDERER *, int (*)(void *), void *);
    int (*dumb_it_callback_terminate)(void *);
+   long (*duh_sigrenderer_generate_samples)(DUH_SIGRENDERER *,
+      float, float, long, sample_t **);
+   sample_t **(*allocate_sample_buffer)(int, long);
+   void (*destroy_sample_buffer)(sample_t **);
+   void (*dumb_silence)(sample_t *, long);
+   int *dumb_resampling_quality;
 
 #if (DUMB_MAJOR_VERSION) >= 2
    /*
@@ -158,13 +170,41 @@ static dumb_off_t dfs_get_size(void *f)
 
 /* Stream Functions */
 
+/* Renders straight from DUMB's mixing buffer into float fragments,
+ * which duh_render can only produce as 8 or 16-bit integers.
+ */
+static long render_float(MOD_FILE *df, float *buf, long frames)
+{
+   const float scale = 1.0f / 0x800000;
+   long i;
+
+   if (frames > df->samples_size) {
+      if (df->samples)
+         lib.destroy_sample_buffer(df->samples);
+      df->samples = lib.allocate_sample_buffer(2, frames);
+      df->samples_size = df->samples ? frames : 0;
+      if (!df->samples)
+         return 0;
+   }
+
+   lib.dumb_silence(df->samples[0], frames * 2);
+   frames = lib.duh_sigrenderer_generate_samples(df->sig, 1.0,
+      65536.0 / df->frequency, frames, df->samples);
+
+   /* Stereo samples are interleaved in the first channel pair. */
+   for (i = 0; i < frames * 2; i++)
+      buf[i] = df->samples[0][i] * scale;
+
+   return frames;
+}
+
 static size_t modaudio_stream_update(ALLEGRO_AUDIO_STREAM *stream, void *data,
    size_t buf_size)
 {
    MOD_FILE *const df = stream->extra;
 
-   /* the mod files are stereo and 16-bit */
-   const int sample_size = 4;
+   /* the mod files are stereo, and 16-bit unless float was asked for */
+   const int sample_size = df->float_out ? 8 : 4;
    size_t written = 0;
    size_t i;
 
@@ -176,8 +216,15 @@ static size_t modaudio_stream_update(ALLEGRO_AUDIO_STREAM *stream, void *data,
    }
 
    while (written < buf_size) {
-      written += lib.duh_render(df->sig, 16, 0, 1.0, 65536.0 / 44100.0,
-         (buf_size - written) / sample_size, &(((char *)data)[written])) * sample_size;
+      long frames = (buf_size - written) / sample_size;
+      char *dest = &(((char *)data)[written]);
+
+      if (df->float_out)
+         frames = render_float(df, (float *)dest, frames);
+      else
+         frames = lib.duh_render(df->sig, 16, 0, 1.0,
+            65536.0 / df->frequency, frames, dest);
+      written += frames * sample_size;
       if (stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONCE) {
             break;
       }
@@ -197,6 +244,8 @@ static void modaudio_stream_close(ALLEGRO_AUDIO_STREAM *stream)
 
    lib.duh_end_sigrenderer(df->sig);
    lib.unload_duh(df->duh);
+   if (df->samples)
+      lib.destroy_sample_buffer(df->samples);
    if (df->fh)
       al_fclose(df->fh);
 }
@@ -242,6 +291,41 @@ static bool modaudio_stream_set_loop(ALLEGRO_AUDIO_STREAM *stream,
    return true;
 }
 
+static int get_module_frequency(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "audio",
+      "primary_mixer_frequency");
+   int frequency = (value && value[0] != '\0') ? atoi(value) : 44100;
+
+   if (frequency <= 0)
+      frequency = 44100;
+   return frequency;
+}
+
+/* Maps the default mixer quality onto DUMB's resamplers. */
+static int get_resampling_quality(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "audio",
+      "default_mixer_quality");
+
+   if (!value || value[0] == '\0')
+      return -1;
+   if (!_al_stricmp(value, "point"))
+      return DUMB_RQ_ALIASING;
+   if (!_al_stricmp(value, "linear"))
+      return DUMB_RQ_LINEAR;
+   if (!_al_stricmp(value, "cubic"))
+      return DUMB_RQ_CUBIC;
+   if (!_al_stricmp(value, "sinc")) {
+#ifdef DUMB_RQ_FIR
+      return DUMB_RQ_FIR;
+#else
+      return DUMB_RQ_CUBIC;
+#endif
+   }
+   return -1;
+}
+
 static ALLEGRO_AUDIO_STREAM *modaudio_stream_init(ALLEGRO_FILE* f,
    size_t buffer_count, unsigned int samples
 #if (DUMB_MAJOR_VERSION) < 2
@@ -256,6 +340,8 @@ static ALLEGRO_AUDIO_STREAM *modaudio_stream_init(ALLEGRO_FILE* f,
    DUH *duh = NULL;
    DUMB_IT_SIGRENDERER *it_sig = NULL;
    int64_t start_pos = -1;
+   int frequency = get_module_frequency();
+   bool float_out = _al_acodec_want_float_streams();
 
    df = lib.dumbfile_open_ex(f, &dfs_f);
    if (!df) {
@@ -297,11 +383,15 @@ static ALLEGRO_AUDIO_STREAM *modaudio_stream_init(ALLEGRO_FILE* f,
       lib.dumb_it_set_xm_speed_zero_callback(it_sig, lib.dumb_it_callback_terminate, NULL);
    }
 
-   stream = al_create_audio_stream(buffer_count, samples, 44100,
-      ALLEGRO_AUDIO_DEPTH_INT16, ALLEGRO_CHANNEL_CONF_2);
+   /* DUMB resamples each instrument anyway, so have it render at the rate
+    * of the default mixer to spare the mixer a second resampling pass.
+    */
+   stream = al_create_audio_stream(buffer_count, samples, frequency,
+      float_out ? ALLEGRO_AUDIO_DEPTH_FLOAT32 : ALLEGRO_AUDIO_DEPTH_INT16,
+      ALLEGRO_CHANNEL_CONF_2);
 
    if (stream) {
-      MOD_FILE *mf = al_malloc(sizeof(MOD_FILE));
+      MOD_FILE *mf = al_calloc(1, sizeof(MOD_FILE));
       mf->duh = duh;
       mf->sig = sig;
       mf->fh = NULL;
@@ -310,6 +400,8 @@ static ALLEGRO_AUDIO_STREAM *modaudio_stream_init(ALLEGRO_FILE* f,
          mf->length = 0;
       mf->loop_start = -1;
       mf->loop_end = -1;
+      mf->frequency = frequency;
+      mf->float_out = float_out;
 
       stream->extra = mf;
       stream->feeder = modaudio_stream_update;
@@ -403,6 +495,23 @@ static bool init_libdumb(void)
    INITSYM(dumb_it_set_loop_callback);
    INITSYM(dumb_it_set_xm_speed_zero_callback);
    INITSYM(dumb_it_callback_terminate);
+   INITSYM(duh_sigrenderer_generate_samples);
+   INITSYM(allocate_sample_buffer);
+   INITSYM(destroy_sample_buffer);
+   INITSYM(dumb_silence);
+
+   /* A variable, not a function, and only used if it can be found. */
+#ifdef ALLEGRO_CFG_ACODEC_DUMB_DLL
+   lib.dumb_resampling_quality = _al_import_symbol(dumb_dll,
+      "dumb_resampling_quality");
+#else
+   lib.dumb_resampling_quality = &dumb_resampling_quality;
+#endif
+   if (lib.dumb_resampling_quality) {
+      int quality = get_resampling_quality();
+      if (quality >= 0)
+         *lib.dumb_resampling_quality = quality;
+   }
 
    dfs.open = dfs_open;
    dfs.skip = dfs_skip;
@@ -21,30 +21,62 @@
 
 ALLEGRO_DEBUG_CHANNEL("acodec")
 
+/* Both the sample and the stream loaders decode through minimp3's
+ * mp3dec_ex API, which reads the file through a fixed size buffer with the
+ * callbacks below rather than needing it in memory. Opening scans the
+ * frame headers once to count the samples and build the seek index, which
+ * later seeks reuse.
+ */
+
 typedef struct MP3FILE
 {
-   mp3dec_t dec;
-
-   uint8_t* file_buffer;      /* encoded MP3 file */
-   int64_t file_size;         /* in bytes */
-   int64_t next_frame_offset; /* next frame offset, in bytes */
+   mp3dec_ex_t dec;
+   mp3dec_io_t io;
+   ALLEGRO_FILE *fh;
 
-   int file_pos;              /* position in samples */
-   int file_samples;          /* in samples */
+   int64_t file_pos;          /* position in samples */
+   int64_t file_samples;      /* in samples */
    double loop_start;
    double loop_end;
 
-   mp3d_sample_t frame_buffer[MINIMP3_MAX_SAMPLES_PER_FRAME]; /* decoded MP3 frame */
-   int frame_pos;             /* position in the frame buffer, in samples */
-
-   int* frame_offsets;        /* in bytes */
-   int num_frames;
-   int frame_samples;         /* in samples, same across all frames */
-
+   int channels;
    int freq;
    ALLEGRO_CHANNEL_CONF chan_conf;
 } MP3FILE;
 
+static size_t read_callback(void *buf, size_t size, void *user_data)
+{
+   return al_fread((ALLEGRO_FILE *)user_data, buf, size);
+}
+
+static int seek_callback(uint64_t position, void *user_data)
+{
+   return al_fseek((ALLEGRO_FILE *)user_data, position, ALLEGRO_SEEK_SET) ?
+      0 : -1;
+}
+
+static bool open_decoder(mp3dec_ex_t *dec, mp3dec_io_t *io, ALLEGRO_FILE *f)
+{
+   int rc;
+
+   io->read = read_callback;
+   io->read_data = f;
+   io->seek = seek_callback;
+   io->seek_data = f;
+
+   rc = mp3dec_ex_open_cb(dec, io, MP3D_SEEK_TO_SAMPLE);
+   if (rc) {
+      ALLEGRO_WARN("Could not open MP3 (error %d).\n", rc);
+      return false;
+   }
+   if (dec->samples == 0 || dec->info.channels == 0) {
+      ALLEGRO_WARN("Could not decode the first frame.\n");
+      mp3dec_ex_close(dec);
+      return false;
+   }
+   return true;
+}
+
 ALLEGRO_SAMPLE *_al_load_mp3(const char *filename)
 {
    ALLEGRO_FILE *f;
@@ -66,41 +98,43 @@ ALLEGRO_SAMPLE *_al_load_mp3(const char *filename)
 
 ALLEGRO_SAMPLE *_al_load_mp3_f(ALLEGRO_FILE *f)
 {
-   mp3dec_t dec;
-   mp3dec_init(&dec);
-
-   mp3dec_file_info_t info;
+   mp3dec_ex_t dec;
+   mp3dec_io_t io;
    ALLEGRO_SAMPLE *spl = NULL;
 
-   /* Read our file size. */
-   int64_t filesize = al_fsize(f);
-   if (filesize == -1) {
-      ALLEGRO_WARN("Could not determine file size.\n");
+   if (!open_decoder(&dec, &io, f))
       return NULL;
-   }
 
-   /* Allocate buffer and read all the file. */
-   uint8_t* mp3data = (uint8_t*)al_malloc(filesize);
-   size_t readbytes = al_fread(f, mp3data, filesize);
-   if (readbytes != (size_t)filesize) {
-      ALLEGRO_WARN("Failed to read file into memory.\n");
-      al_free(mp3data);
+   /* Only the decoded samples are held in memory, not the file. */
+   size_t total = dec.samples;
+   mp3d_sample_t *pcm = al_malloc(total * sizeof(mp3d_sample_t));
+   if (!pcm) {
+      ALLEGRO_WARN("Could not allocate %lu samples.\n", (unsigned long)total);
+      mp3dec_ex_close(&dec);
       return NULL;
    }
 
-   /* Decode the file contents, and copy to a new buffer. */
-   mp3dec_load_buf(&dec, mp3data, filesize, &info, NULL, NULL);
-   al_free(mp3data);
+   size_t read = mp3dec_ex_read(&dec, pcm, total);
+   if (read != total) {
+      ALLEGRO_DEBUG("Decoded %lu of %lu samples.\n",
+         (unsigned long)read, (unsigned long)total);
+   }
+   int channels = dec.info.channels;
+   int hz = dec.info.hz;
+   mp3dec_ex_close(&dec);
 
-   if (info.buffer == NULL) {
+   if (read == 0) {
       ALLEGRO_WARN("Could not decode MP3.\n");
+      al_free(pcm);
       return NULL;
    }
 
-   /* Create sample from info variable. */
-   spl = al_create_sample(info.buffer, info.samples / info.channels, info.hz,
+   /* Create sample from the decoded buffer. */
+   spl = al_create_sample(pcm, read / channels, hz,
       _al_word_size_to_depth_conf(sizeof(mp3d_sample_t)),
-      _al_count_to_channel_conf(info.channels), true);
+      _al_count_to_channel_conf(channels), true);
+   if (!spl)
+      al_free(pcm);
 
    return spl;
 }
@@ -124,37 +158,25 @@ ALLEGRO_AUDIO_STREAM *_al_load_mp3_audio_stream(const char *filename, size_t buf
 
    return stream;
 }
-#include <stdio.h>
 
 static bool mp3_stream_seek(ALLEGRO_AUDIO_STREAM * stream, double time)
 {
    MP3FILE *mp3file = (MP3FILE *) stream->extra;
-   int file_pos = time * mp3file->freq;
-   int frame = file_pos / mp3file->frame_samples;
-   /* It is necessary to start decoding a little earlier than where we are
-    * seeking to, because frames will reuse decoder state from previous frames.
-    * minimp3 assures us that 10 frames is sufficient. */
-   int sync_frame = _ALLEGRO_MAX(0, frame - 10);
-   int frame_pos = file_pos - frame * mp3file->frame_samples;
-   if (frame < 0 || frame > mp3file->num_frames) {
+   int64_t file_pos = time * mp3file->freq;
+
+   if (file_pos < 0 || file_pos > mp3file->file_samples) {
       ALLEGRO_WARN("Seeking outside the stream bounds: %f\n", time);
       return false;
    }
-   int frame_offset = mp3file->frame_offsets[frame];
-   int sync_frame_offset = mp3file->frame_offsets[sync_frame];
-
-   mp3dec_frame_info_t frame_info;
-   do {
-      mp3dec_decode_frame(&mp3file->dec,
-         mp3file->file_buffer + sync_frame_offset,
-         mp3file->file_size - sync_frame_offset,
-         mp3file->frame_buffer, &frame_info);
-      sync_frame_offset += frame_info.frame_bytes;
-   } while (sync_frame_offset <= frame_offset);
-
-   mp3file->next_frame_offset = frame_offset + frame_info.frame_bytes;
+
+   /* minimp3 counts the samples of all channels. It starts decoding a few
+    * frames early from the index, as frames reuse state from previous ones.
+    */
+   if (mp3dec_ex_seek(&mp3file->dec, file_pos * mp3file->channels)) {
+      ALLEGRO_WARN("Could not seek to %f.\n", time);
+      return false;
+   }
    mp3file->file_pos = file_pos;
-   mp3file->frame_pos = frame_pos;
 
    return true;
 }
@@ -196,49 +218,29 @@ static size_t mp3_stream_update(ALLEGRO_AUDIO_STREAM *stream, void *data,
    size_t buf_size)
 {
    MP3FILE *mp3file = (MP3FILE *) stream->extra;
-   int sample_size = sizeof(mp3d_sample_t) * al_get_channel_count(mp3file->chan_conf);
-   int samples_needed = buf_size / sample_size;;
+   int sample_size = sizeof(mp3d_sample_t) * mp3file->channels;
+   int samples_needed = buf_size / sample_size;
    double ctime = mp3_stream_get_position(stream);
    double btime = (double)samples_needed / mp3file->freq;
 
    if (stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR && ctime + btime > mp3file->loop_end) {
       samples_needed = (mp3file->loop_end - ctime) * mp3file->freq;
    }
-   if (samples_needed < 0)
+   if (samples_needed <= 0)
       return 0;
 
-   mp3dec_t dec;
-   mp3dec_init(&dec);
-
-   int samples_read = 0;
-   while (samples_read < samples_needed) {
-      int samples_from_this_frame = _ALLEGRO_MIN(
-         mp3file->frame_samples - mp3file->frame_pos,
-         samples_needed - samples_read
-      );
-      memcpy(data,
-         mp3file->frame_buffer + mp3file->frame_pos * al_get_channel_count(mp3file->chan_conf),
-         samples_from_this_frame * sample_size);
-
-      mp3file->frame_pos += samples_from_this_frame;
-      mp3file->file_pos += samples_from_this_frame;
-      data = (char*)(data) + samples_from_this_frame * sample_size;
-      samples_read += samples_from_this_frame;
-
-      if (mp3file->frame_pos >= mp3file->frame_samples) {
-         mp3dec_frame_info_t frame_info;
-         int frame_samples = mp3dec_decode_frame(&mp3file->dec,
-            mp3file->file_buffer + mp3file->next_frame_offset,
-            mp3file->file_size - mp3file->next_frame_offset,
-            mp3file->frame_buffer, &frame_info);
-         if (frame_samples == 0) {
-            mp3_stream_rewind(stream);
-            break;
-         }
-         mp3file->frame_pos = 0;
-         mp3file->next_frame_offset += frame_info.frame_bytes;
+   size_t read = mp3dec_ex_read(&mp3file->dec, (mp3d_sample_t *)data,
+      (size_t)samples_needed * mp3file->channels);
+   int samples_read = read / mp3file->channels;
+   mp3file->file_pos += samples_read;
+
+   if (samples_read < samples_needed) {
+      if (mp3file->dec.last_error) {
+         ALLEGRO_WARN("Decoding failed (error %d).\n", mp3file->dec.last_error);
       }
+      mp3_stream_rewind(stream);
    }
+
    return samples_read * sample_size;
 }
 
@@ -248,71 +250,29 @@ static void mp3_stream_close(ALLEGRO_AUDIO_STREAM *stream)
 
    _al_acodec_stop_feed_thread(stream);
 
-   al_free(mp3file->frame_offsets);
-   al_free(mp3file->file_buffer);
+   mp3dec_ex_close(&mp3file->dec);
+   al_fclose(mp3file->fh);
    al_free(mp3file);
    stream->extra = NULL;
-   stream->feed_thread = NULL;
 }
 
 ALLEGRO_AUDIO_STREAM *_al_load_mp3_audio_stream_f(ALLEGRO_FILE* f, size_t buffer_count, unsigned int samples)
 {
    MP3FILE* mp3file = al_calloc(sizeof(MP3FILE), 1);
-   mp3dec_init(&mp3file->dec);
-
-   /* Read our file size. */
-   mp3file->file_size = al_fsize(f);
-   if (mp3file->file_size == -1) {
-      ALLEGRO_WARN("Could not determine file size.\n");
-      goto failure;
-   }
-
-   /* Allocate buffer and read all the file. */
-   mp3file->file_buffer = (uint8_t*)al_malloc(mp3file->file_size);
-   size_t readbytes = al_fread(f, mp3file->file_buffer, mp3file->file_size);
-   if (readbytes != (size_t)mp3file->file_size) {
-      ALLEGRO_WARN("Failed to read file into memory.\n");
-      goto failure;
-   }
-   al_fclose(f);
-
-   /* Go through all the frames, to build the offset table. */
-   int frame_offset_capacity = 0;
-   int offset_so_far = 0;
-   while (true) {
-      if (mp3file->num_frames + 1 > frame_offset_capacity) {
-         frame_offset_capacity = mp3file->num_frames * 3 / 2  + 1;
-         mp3file->frame_offsets = al_realloc(mp3file->frame_offsets,
-            sizeof(int) * frame_offset_capacity);
-      }
-
-      mp3dec_frame_info_t frame_info;
-      int frame_samples = mp3dec_decode_frame(&mp3file->dec,
-         mp3file->file_buffer + offset_so_far,
-         mp3file->file_size - offset_so_far, NULL, &frame_info);
-      if (frame_samples == 0) {
-         if (mp3file->num_frames == 0) {
-            ALLEGRO_WARN("Could not decode the first frame.\n");
-            goto failure;
-         }
-         else {
-            break;
-         }
-      }
-      /* Grab the file information from the first frame. */
-      if (offset_so_far == 0) {
-         ALLEGRO_DEBUG("Channels %d, frequency %d\n", frame_info.channels, frame_info.hz);
-         mp3file->chan_conf = _al_count_to_channel_conf(frame_info.channels);
-         mp3file->freq = frame_info.hz;
-         mp3file->frame_samples = frame_samples;
-      }
+   if (!mp3file)
+      return NULL;
 
-      mp3file->frame_offsets[mp3file->num_frames] = offset_so_far;
-      mp3file->num_frames += 1;
-      offset_so_far += frame_info.frame_bytes;
-      mp3file->file_samples += frame_samples;
+   if (!open_decoder(&mp3file->dec, &mp3file->io, f)) {
+      al_free(mp3file);
+      return NULL;
    }
-   mp3file->loop_end = (double)mp3file->file_samples * mp3file->freq;
+   mp3file->fh = f;
+   mp3file->channels = mp3file->dec.info.channels;
+   mp3file->freq = mp3file->dec.info.hz;
+   mp3file->chan_conf = _al_count_to_channel_conf(mp3file->channels);
+   mp3file->file_samples = mp3file->dec.samples / mp3file->channels;
+   mp3file->loop_end = (double)mp3file->file_samples / mp3file->freq;
+   ALLEGRO_DEBUG("Channels %d, frequency %d\n", mp3file->channels, mp3file->freq);
 
    ALLEGRO_AUDIO_STREAM *stream = al_create_audio_stream(
       buffer_count, samples, mp3file->freq,
@@ -320,7 +280,9 @@ ALLEGRO_AUDIO_STREAM *_al_load_mp3_audio_stream_f(ALLEGRO_FILE* f, size_t buffer
       mp3file->chan_conf);
    if (!stream) {
       ALLEGRO_WARN("Failed to create stream.\n");
-      goto failure;
+      mp3dec_ex_close(&mp3file->dec);
+      al_free(mp3file);
+      return NULL;
    }
 
    stream->extra = mp3file;
@@ -337,10 +299,4 @@ ALLEGRO_AUDIO_STREAM *_al_load_mp3_audio_stream_f(ALLEGRO_FILE* f, size_t buffer
    _al_acodec_start_feed_thread(stream);
 
    return stream;
-failure:
-   al_free(mp3file->frame_offsets);
-   al_free(mp3file->file_buffer);
-   al_free(mp3file->frame_buffer);
-   al_free(mp3file);
-   return NULL;
 }
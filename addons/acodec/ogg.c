@@ -37,6 +37,7 @@ struct AL_OV_DATA {
    int bitstream;
    double loop_start;
    double loop_end;
+   bool read_float;  /* stream float samples, see [audio] stream_depth */
 };
 
 
@@ -57,6 +58,7 @@ static struct
    int (*ov_time_seek_lap)(OggVorbis_File *, double);
    double (*ov_time_tell)(OggVorbis_File *);
    long (*ov_read)(OggVorbis_File *, char *, int, int, int, int, int *);
+   long (*ov_read_float)(OggVorbis_File *, float ***, int, int *);
 #else
    int (*ov_open_callbacks)(void *, OggVorbis_File *, const char *, long, ov_callbacks);
    ogg_int64_t (*ov_time_total)(OggVorbis_File *, int);
@@ -79,7 +81,7 @@ static void shutdown_dynlib(void)
 #endif
 
 
-static bool init_dynlib(void)
+static bool load_dynlib(void)
 {
 #ifdef ALLEGRO_CFG_ACODEC_VORBISFILE_DLL
    if (ov_dll) {
@@ -109,12 +111,12 @@ static bool init_dynlib(void)
             return false;                                                     \
          }                                                                    \
       } while(0)
+
+   memset(&lib, 0, sizeof(lib));
 #else
    #define INITSYM(x)   (lib.x = (x))
 #endif
 
-   memset(&lib, 0, sizeof(lib));
-
    INITSYM(ov_clear);
    INITSYM(ov_open_callbacks);
    INITSYM(ov_pcm_total);
@@ -124,6 +126,7 @@ static bool init_dynlib(void)
    INITSYM(ov_time_seek_lap);
    INITSYM(ov_time_tell);
    INITSYM(ov_read);
+   INITSYM(ov_read_float);
 #else
    INITSYM(ov_time_total);
    INITSYM(ov_time_seek);
@@ -137,6 +140,20 @@ static bool init_dynlib(void)
 }
 
 
+/* Samples may be loaded on several threads at once, see
+ * al_load_samples_batch.
+ */
+static bool init_dynlib(void)
+{
+   bool ret;
+
+   _al_acodec_lock_dynlibs();
+   ret = load_dynlib();
+   _al_acodec_unlock_dynlibs();
+   return ret;
+}
+
+
 static size_t read_callback(void *ptr, size_t size, size_t nmemb, void *dptr)
 {
    AL_OV_DATA *ov = (AL_OV_DATA *)dptr;
@@ -376,6 +393,31 @@ static void ogg_stream_close(ALLEGRO_AUDIO_STREAM *stream)
 }
 
 
+#ifndef TREMOR
+/* Reads up to 'frames' frames as floats, interleaving the channels, which
+ * the decoder hands out separately.  Returns the number of bytes written.
+ */
+static long read_float(AL_OV_DATA *extra, float *buf, int frames)
+{
+   const int channels = extra->vi->channels;
+   float **pcm;
+   long read;
+   long i;
+   int c;
+
+   read = lib.ov_read_float(extra->vf, &pcm, frames, &extra->bitstream);
+   if (read <= 0)
+      return 0;
+
+   for (i = 0; i < read; i++) {
+      for (c = 0; c < channels; c++)
+         *buf++ = pcm[c][i];
+   }
+   return read * channels * sizeof(float);
+}
+#endif
+
+
 static size_t ogg_stream_update(ALLEGRO_AUDIO_STREAM *stream, void *data,
                                 size_t buf_size)
 {
@@ -386,7 +428,8 @@ static size_t ogg_stream_update(ALLEGRO_AUDIO_STREAM *stream, void *data,
 #else
    const int endian = 1;      /* 0 for Little-Endian, 1 for Big-Endian */
 #endif
-   const int word_size = 2;   /* 1 = 8bit, 2 = 16-bit. nothing else */
+   /* 2 = 16-bit, or 4 for floats. */
+   const int word_size = extra->read_float ? 4 : 2;
    const int signedness = 1;  /* 0 for unsigned, 1 for signed */
 
    unsigned long pos = 0;
@@ -413,8 +456,15 @@ static size_t ogg_stream_update(ALLEGRO_AUDIO_STREAM *stream, void *data,
    }
    while (pos < (unsigned long)read_length) {
 #ifndef TREMOR
-      read = lib.ov_read(extra->vf, (char *)data + pos,
-         read_length - pos, endian, word_size, signedness, &extra->bitstream);
+      if (extra->read_float) {
+         read = read_float(extra, (float *)((char *)data + pos),
+            (read_length - pos) / (word_size * extra->vi->channels));
+      }
+      else {
+         read = lib.ov_read(extra->vf, (char *)data + pos,
+            read_length - pos, endian, word_size, signedness,
+            &extra->bitstream);
+      }
 #else
       (void)endian;
       (void)signedness;
@@ -459,7 +509,7 @@ ALLEGRO_AUDIO_STREAM *_al_load_ogg_vorbis_audio_stream(const char *filename,
 ALLEGRO_AUDIO_STREAM *_al_load_ogg_vorbis_audio_stream_f(ALLEGRO_FILE *file,
    size_t buffer_count, unsigned int samples)
 {
-   const int word_size = 2; /* 1 = 8bit, 2 = 16-bit. nothing else */
+   int word_size = 2; /* 2 = 16-bit, or 4 for floats */
    OggVorbis_File* vf;
    vorbis_info* vi;
    int channels;
@@ -480,6 +530,14 @@ ALLEGRO_AUDIO_STREAM *_al_load_ogg_vorbis_audio_stream_f(ALLEGRO_FILE *file,
    }
 
    extra->file = file;
+#ifndef TREMOR
+   /* The decoder produces floats, so this saves a conversion. */
+   extra->read_float = _al_acodec_want_float_streams();
+   if (extra->read_float)
+      word_size = 4;
+#else
+   extra->read_float = false;
+#endif
    
    vf = al_malloc(sizeof(OggVorbis_File));
    if (lib.ov_open_callbacks(extra, vf, NULL, 0, callbacks) < 0) {
@@ -519,7 +577,6 @@ ALLEGRO_AUDIO_STREAM *_al_load_ogg_vorbis_audio_stream_f(ALLEGRO_FILE *file,
 
    extra->loop_start = 0.0;
    extra->loop_end = ogg_stream_get_length(stream);
-   stream->quit_feed_thread = false;
    stream->feeder = ogg_stream_update;
    stream->rewind_feeder = ogg_stream_rewind;
    stream->seek_feeder = ogg_stream_seek;
@@ -31,6 +31,7 @@ struct AL_OP_DATA {
    int bitstream;
    double loop_start;
    double loop_end;
+   bool read_float;  /* stream float samples, see [audio] stream_depth */
 };
 
 /* dynamic loading support (Windows only currently) */
@@ -48,6 +49,7 @@ static struct
    int (*op_pcm_seek)(OggOpusFile *_of, ogg_int64_t _pcm_offset);
    ogg_int64_t (*op_pcm_tell)(const OggOpusFile *_of);
    int (*op_read)(OggOpusFile *_of, opus_int16 *_pcm, int _buf_size, int *_li);
+   int (*op_read_float)(OggOpusFile *_of, float *_pcm, int _buf_size, int *_li);
 } lib;
 
 
@@ -63,7 +65,7 @@ static void shutdown_dynlib(void)
 #endif
 
 
-static bool init_dynlib(void)
+static bool load_dynlib(void)
 {
 #ifdef ALLEGRO_CFG_ACODEC_OPUSFILE_DLL
    if (op_dll) {
@@ -93,12 +95,12 @@ static bool init_dynlib(void)
             return false;                                                     \
          }                                                                    \
       } while(0)
+
+   memset(&lib, 0, sizeof(lib));
 #else
    #define INITSYM(x)   (lib.x = (x))
 #endif
 
-   memset(&lib, 0, sizeof(lib));
-
    INITSYM(op_free);
    INITSYM(op_channel_count);
    INITSYM(op_open_callbacks);
@@ -106,6 +108,7 @@ static bool init_dynlib(void)
    INITSYM(op_pcm_seek);
    INITSYM(op_pcm_tell);
    INITSYM(op_read);
+   INITSYM(op_read_float);
 
    return true;
 
@@ -113,6 +116,20 @@ static bool init_dynlib(void)
 }
 
 
+/* Samples may be loaded on several threads at once, see
+ * al_load_samples_batch.
+ */
+static bool init_dynlib(void)
+{
+   bool ret;
+
+   _al_acodec_lock_dynlibs();
+   ret = load_dynlib();
+   _al_acodec_unlock_dynlibs();
+   return ret;
+}
+
+
 static int read_callback(void *stream, unsigned char *ptr, int nbytes)
 {
    AL_OP_DATA *op = (AL_OP_DATA *)stream;
@@ -333,41 +350,46 @@ static size_t ogg_stream_update(ALLEGRO_AUDIO_STREAM *stream, void *data,
 {
    AL_OP_DATA *extra = (AL_OP_DATA *) stream->extra;
 
-   const int word_size = 2;   /* 2 = 16-bit. opus_int16 size, for use in op_read */
+   /* 2 = 16-bit for op_read, or 4 for op_read_float. */
+   const int word_size = extra->read_float ? 4 : 2;
 
-   unsigned long pos = 0;
-   int read_length = buf_size;
-   int buf_in_word;
    long rate = 48000;
    int channels = extra->channels;
+   /* Both count the values of all channels. */
+   int pos = 0;
+   int read_length = buf_size / (word_size * channels) * channels;
 
    double ctime = lib.op_pcm_tell(extra->of)/(double)rate;
 
    double btime = ((double)buf_size / (word_size * channels)) / rate;
-   long read;
+   int read;
 
    if (stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR) {
       if (ctime + btime > extra->loop_end) {
-         read_length = (extra->loop_end - ctime) * rate * word_size * channels;
+         read_length = (int)((extra->loop_end - ctime) * rate) * channels;
          if (read_length < 0)
             return 0;
-         read_length += read_length % word_size;
       }
    }
 
-   buf_in_word= read_length/word_size;
+   while (pos < read_length) {
+      if (extra->read_float) {
+         read = lib.op_read_float(extra->of, (float *)data + pos,
+            read_length - pos, NULL);
+      }
+      else {
+         read = lib.op_read(extra->of, (opus_int16 *)data + pos,
+            read_length - pos, NULL);
+      }
 
-   while (pos < (unsigned long) read_length) {
-      read = lib.op_read(extra->of, (opus_int16 *)data + pos, buf_in_word - pos, NULL);
+      /* Stop at the end or on errors. */
+      if (read <= 0)
+         break;
       pos += read * channels;
-
-      if (read == 0) {
-         /* Return the number of useful bytes written. */
-         return pos*word_size;
-      }
    }
 
-   return pos;
+   /* Return the number of useful bytes written. */
+   return pos * word_size;
 }
 
 
@@ -397,7 +419,7 @@ ALLEGRO_AUDIO_STREAM *_al_load_ogg_opus_audio_stream(const char *filename,
 ALLEGRO_AUDIO_STREAM *_al_load_ogg_opus_audio_stream_f(ALLEGRO_FILE *file,
    size_t buffer_count, unsigned int samples)
 {
-   const int word_size = 2; /* 1 = 8bit, 2 = 16-bit. nothing else */
+   int word_size = 2; /* 2 = 16-bit, or 4 for floats */
    OggOpusFile* of;
    int channels;
    long rate;
@@ -418,6 +440,10 @@ ALLEGRO_AUDIO_STREAM *_al_load_ogg_opus_audio_stream_f(ALLEGRO_FILE *file,
    }
 
    extra->file = file;
+   /* The decoder works in floats, so this saves a conversion. */
+   extra->read_float = _al_acodec_want_float_streams();
+   if (extra->read_float)
+      word_size = 4;
 
    of = lib.op_open_callbacks(extra, &callbacks, NULL, 0, NULL);
    if (!of) {
@@ -455,7 +481,6 @@ ALLEGRO_AUDIO_STREAM *_al_load_ogg_opus_audio_stream_f(ALLEGRO_FILE *file,
 
    extra->loop_start = 0.0;
    extra->loop_end = ogg_stream_get_length(stream);
-   stream->quit_feed_thread = false;
    stream->feeder = ogg_stream_update;
    stream->rewind_feeder = ogg_stream_rewind;
    stream->seek_feeder = ogg_stream_seek;
@@ -3,6 +3,8 @@
  * author: Matthew Leverton 
  */
 
+#define ALLEGRO_INTERNAL_UNSTABLE
+
 #include <stdio.h>
 
 #include "allegro5/allegro_audio.h"
@@ -18,14 +20,20 @@ typedef struct WAVFILE
    ALLEGRO_FILE *f; 
    size_t dpos;     /* the starting position of the data chunk */
    int freq;        /* e.g., 44100 */
-   short bits;      /* 8 (unsigned char) or 16 (signed short) */
+   short format;    /* WAVE_FORMAT_PCM or WAVE_FORMAT_IMA_ADPCM */
+   short bits;      /* 8 (unsigned char) or 16 (signed short), 4 for ADPCM */
    short channels;  /* 1 (mono) or 2 (stereo) */
+   int block_align; /* bytes per ADPCM block */
    int sample_size; /* channels * bits/8 */
    int samples;     /* # of samples. size = samples * sample_size */
+   int data_size;   /* size of the data chunk */
    double loop_start;
    double loop_end;
 } WAVFILE;
 
+#define WAVE_FORMAT_PCM       1
+#define WAVE_FORMAT_IMA_ADPCM 0x11
+
 
 /* wav_open:
  *  Opens f and prepares a WAVFILE struct with the WAV format info.
@@ -48,8 +56,10 @@ static WAVFILE *wav_open(ALLEGRO_FILE *f)
    }
    wavfile->f = f;
    wavfile->freq = 22050;
+   wavfile->format = WAVE_FORMAT_PCM;
    wavfile->bits = 8;
    wavfile->channels = 1;
+   wavfile->block_align = 0;
 
    /* check the header */
    if (al_fread(f, buffer, 12) != 12) {
@@ -67,7 +77,6 @@ static WAVFILE *wav_open(ALLEGRO_FILE *f)
     */
    while (true) {
       int length = 0;
-      short pcm = 0;
 
       if (al_fread(f, buffer, 4) != 4) {
          ALLEGRO_ERROR("Unexpected EOF while reading RIFF type.\n");
@@ -83,10 +92,11 @@ static WAVFILE *wav_open(ALLEGRO_FILE *f)
             goto wav_open_error;
          }
 
-         /* should be 1 for PCM data */
-         pcm = al_fread16le(f);
-         if (pcm != 1) {
-            ALLEGRO_ERROR("Bad PCM value: %d.\n", pcm);
+         /* PCM data, or IMA-ADPCM which is kept compressed */
+         wavfile->format = al_fread16le(f);
+         if (wavfile->format != WAVE_FORMAT_PCM &&
+               wavfile->format != WAVE_FORMAT_IMA_ADPCM) {
+            ALLEGRO_ERROR("Bad PCM value: %d.\n", wavfile->format);
             goto wav_open_error;
          }
 
@@ -101,12 +111,21 @@ static WAVFILE *wav_open(ALLEGRO_FILE *f)
          /* sample frequency */
          wavfile->freq = al_fread32le(f);
        
-         /* skip six bytes */
-         al_fseek(f, 6, ALLEGRO_SEEK_CUR);   
+         /* skip the byte rate */
+         al_fseek(f, 4, ALLEGRO_SEEK_CUR);   
+
+         wavfile->block_align = al_fread16le(f);
 
          /* 8 or 16 bit data? */
          wavfile->bits = al_fread16le(f);
-         if ((wavfile->bits != 8) && (wavfile->bits != 16)) {
+         if (wavfile->format == WAVE_FORMAT_IMA_ADPCM) {
+            if (wavfile->bits != 4 || _al_kcm_adpcm_block_frames(
+                  wavfile->block_align, wavfile->channels) == 0) {
+               ALLEGRO_ERROR("Bad IMA-ADPCM format.\n");
+               goto wav_open_error;
+            }
+         }
+         else if ((wavfile->bits != 8) && (wavfile->bits != 16)) {
             ALLEGRO_ERROR("Bad number of bits: %d.\n", wavfile->bits);
             goto wav_open_error;
          }
@@ -129,7 +148,20 @@ static WAVFILE *wav_open(ALLEGRO_FILE *f)
    }
 
    /* find out how many samples exist */
-   wavfile->samples = al_fread32le(f);
+   wavfile->samples = wavfile->data_size = al_fread32le(f);
+
+   if (wavfile->format == WAVE_FORMAT_IMA_ADPCM) {
+      /* A short last block holds as many whole groups of 8 as fit. */
+      int per_block = _al_kcm_adpcm_block_frames(wavfile->block_align,
+         wavfile->channels);
+      int rest = wavfile->data_size % wavfile->block_align;
+      wavfile->samples = wavfile->data_size / wavfile->block_align * per_block;
+      if (rest >= 4 * wavfile->channels)
+         wavfile->samples += 1 + (rest / (4 * wavfile->channels) - 1) * 8;
+      wavfile->sample_size = 0;
+      wavfile->dpos = al_ftell(f);
+      return wavfile;
+   }
 
    if (wavfile->channels == 2) {
       wavfile->samples = (wavfile->samples + 1) / 2;
@@ -205,11 +237,11 @@ static bool wav_stream_seek(ALLEGRO_AUDIO_STREAM * stream, double time)
 {
    WAVFILE *wavfile = (WAVFILE *) stream->extra;
    int align = (wavfile->bits / 8) * wavfile->channels;
-   unsigned long cpos = time * (double)(wavfile->freq * (wavfile->bits / 8) * wavfile->channels);
+   /* Whole frames, so that loops are sample-accurate. */
+   int64_t frame = time * wavfile->freq;
    if (time >= wavfile->loop_end)
       return false;
-   cpos += cpos % align;
-   return al_fseek(wavfile->f, wavfile->dpos + cpos, ALLEGRO_SEEK_SET);
+   return al_fseek(wavfile->f, wavfile->dpos + frame * align, ALLEGRO_SEEK_SET);
 }
 
 
@@ -257,18 +289,17 @@ static size_t wav_stream_update(ALLEGRO_AUDIO_STREAM *stream, void *data,
    size_t buf_size)
 {
    int bytes_per_sample, samples, samples_read;
-   double ctime, btime;
+   int64_t frame, loop_end;
 
    WAVFILE *wavfile = (WAVFILE *) stream->extra;
    bytes_per_sample = (wavfile->bits / 8) * wavfile->channels;
-   ctime = wav_stream_get_position(stream);
-   btime = ((double)buf_size / (double)bytes_per_sample) / (double)(wavfile->freq);
-   
-   if (stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR && ctime + btime > wavfile->loop_end) {
-      samples = ((wavfile->loop_end - ctime) * (double)(wavfile->freq));
-   }
-   else {
-      samples = buf_size / bytes_per_sample;
+   frame = (al_ftell(wavfile->f) - wavfile->dpos) / bytes_per_sample;
+   loop_end = wavfile->loop_end * wavfile->freq;
+   samples = buf_size / bytes_per_sample;
+
+   if (stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR &&
+         frame + samples > loop_end) {
+      samples = loop_end - frame;
    }
    if (samples < 0)
       return 0;
@@ -291,39 +322,113 @@ static void wav_stream_close(ALLEGRO_AUDIO_STREAM *stream)
    al_fclose(wavfile->f);
    wav_close(wavfile);
    stream->extra = NULL;
-   stream->feed_thread = NULL;
 }
 
 
-/* _al_load_wav:
- *  Reads a RIFF WAV format sample ALLEGRO_FILE, returning an ALLEGRO_SAMPLE
- *  structure, or NULL on error.
+static bool want_mapped_samples(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "audio",
+      "map_wav_samples");
+
+   return value && !strcmp(value, "true");
+}
+
+
+/* map_sample:
+ *  If fp was opened with al_fopen_mmap and holds the whole data chunk in a
+ *  format the mixer reads as is, including IMA-ADPCM, returns a sample
+ *  whose buffer points straight into the mapping. The sample then owns fp.
  */
-ALLEGRO_SAMPLE *_al_load_wav(const char *filename)
+static ALLEGRO_SAMPLE *map_sample(WAVFILE *wavfile, ALLEGRO_FILE *fp)
 {
-   ALLEGRO_FILE *f;
+#ifdef ALLEGRO_LITTLE_ENDIAN
+   size_t n = (wavfile->bits / 8) * wavfile->channels * wavfile->samples;
    ALLEGRO_SAMPLE *spl;
-   ASSERT(filename);
-
-   f = al_fopen(filename, "rb");
-   if (!f) {
-      ALLEGRO_ERROR("Unable to open %s for reading.\n", filename);
+   const void *data;
+   size_t avail;
+
+   data = al_fget_mapped_buffer(fp, &avail);
+   if (wavfile->format == WAVE_FORMAT_IMA_ADPCM) {
+      /* Blocks are read a byte at a time, so need no alignment. */
+      n = wavfile->data_size;
+      if (!data || avail < n)
+         return NULL;
+      spl = _al_kcm_create_adpcm_sample((void *)data, wavfile->samples,
+         wavfile->freq, _al_count_to_channel_conf(wavfile->channels),
+         wavfile->block_align, false);
+      if (spl) {
+         spl->mapping = fp;
+         ALLEGRO_DEBUG("Mapped %lu bytes of ADPCM data.\n", (unsigned long)n);
+      }
+      return spl;
+   }
+   if (!data || avail < n || wavfile->dpos % (wavfile->bits / 8) != 0)
       return NULL;
+
+   spl = al_create_sample((void *)data, wavfile->samples, wavfile->freq,
+      _al_word_size_to_depth_conf(wavfile->bits / 8),
+      _al_count_to_channel_conf(wavfile->channels), false);
+   if (spl) {
+      spl->mapping = fp;
+      ALLEGRO_DEBUG("Mapped %lu bytes of sample data.\n", (unsigned long)n);
    }
+   return spl;
+#else
+   /* The data would have to be byte swapped. */
+   (void)wavfile;
+   (void)fp;
+   return NULL;
+#endif
+}
+
+
+/* load_adpcm:
+ *  Reads the IMA-ADPCM blocks of the data chunk into a sample that keeps
+ *  them compressed.
+ */
+static ALLEGRO_SAMPLE *load_adpcm(WAVFILE *wavfile)
+{
+   ALLEGRO_SAMPLE *spl;
+   char *data = al_calloc(1, wavfile->data_size);
 
-   spl = _al_load_wav_f(f);
+   if (!data)
+      return NULL;
 
-   al_fclose(f);
+   if (al_fread(wavfile->f, data, wavfile->data_size) !=
+         (size_t)wavfile->data_size) {
+      ALLEGRO_WARN("Short ADPCM data chunk.\n");
+   }
 
+   spl = _al_kcm_create_adpcm_sample(data, wavfile->samples, wavfile->freq,
+      _al_count_to_channel_conf(wavfile->channels), wavfile->block_align,
+      true);
+   if (!spl)
+      al_free(data);
    return spl;
 }
 
-ALLEGRO_SAMPLE *_al_load_wav_f(ALLEGRO_FILE *fp)
+
+static ALLEGRO_SAMPLE *load_wav(ALLEGRO_FILE *fp, bool may_map, bool *mapped)
 {
    WAVFILE *wavfile = wav_open(fp);
    ALLEGRO_SAMPLE *spl = NULL;
 
-   if (wavfile) {
+   *mapped = false;
+
+   if (wavfile && may_map) {
+      spl = map_sample(wavfile, fp);
+      if (spl) {
+         *mapped = true;
+         wav_close(wavfile);
+         return spl;
+      }
+   }
+
+   if (wavfile && wavfile->format == WAVE_FORMAT_IMA_ADPCM) {
+      spl = load_adpcm(wavfile);
+      wav_close(wavfile);
+   }
+   else if (wavfile) {
       size_t n = (wavfile->bits / 8) * wavfile->channels * wavfile->samples;
       char *data = al_malloc(n);
 
@@ -347,6 +452,50 @@ ALLEGRO_SAMPLE *_al_load_wav_f(ALLEGRO_FILE *fp)
 }
 
 
+/* _al_load_wav:
+ *  Reads a RIFF WAV format sample ALLEGRO_FILE, returning an ALLEGRO_SAMPLE
+ *  structure, or NULL on error.
+ */
+ALLEGRO_SAMPLE *_al_load_wav(const char *filename)
+{
+   ALLEGRO_FILE *f = NULL;
+   ALLEGRO_SAMPLE *spl;
+   bool may_map = want_mapped_samples();
+   bool mapped;
+   ASSERT(filename);
+
+   if (may_map) {
+      f = al_fopen_mmap(filename);
+      if (!f) {
+         ALLEGRO_WARN("Unable to map %s, reading it instead.\n", filename);
+         may_map = false;
+      }
+   }
+   if (!f) {
+      f = al_fopen(filename, "rb");
+   }
+   if (!f) {
+      ALLEGRO_ERROR("Unable to open %s for reading.\n", filename);
+      return NULL;
+   }
+
+   spl = load_wav(f, may_map, &mapped);
+
+   if (!mapped)
+      al_fclose(f);
+
+   return spl;
+}
+
+ALLEGRO_SAMPLE *_al_load_wav_f(ALLEGRO_FILE *fp)
+{
+   bool mapped;
+
+   /* The caller owns fp, so the sample cannot keep it mapped. */
+   return load_wav(fp, false, &mapped);
+}
+
+
 /* _al_load_wav_audio_stream:
 */
 ALLEGRO_AUDIO_STREAM *_al_load_wav_audio_stream(const char *filename,
@@ -386,6 +535,12 @@ ALLEGRO_AUDIO_STREAM *_al_load_wav_audio_stream_f(ALLEGRO_FILE* f,
       return NULL;
    }
 
+   if (wavfile->format != WAVE_FORMAT_PCM) {
+      ALLEGRO_ERROR("IMA-ADPCM wav files can only be loaded as samples.\n");
+      wav_close(wavfile);
+      return NULL;
+   }
+
    stream = al_create_audio_stream(buffer_count, samples, wavfile->freq,
       _al_word_size_to_depth_conf(wavfile->bits / 8),
       _al_count_to_channel_conf(wavfile->channels));
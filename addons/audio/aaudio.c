@@ -0,0 +1,541 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      AAudio sound driver (Android 8.1 and later).
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern_audio.h"
+
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/system_properties.h>
+
+ALLEGRO_DEBUG_CHANNEL("AAudio")
+
+/* AAudio only exists from API level 26 on, so it is loaded at run time and
+ * the few constants used are repeated here rather than requiring a newer
+ * NDK platform to build against. API level 26 itself had enough problems
+ * with AAudio that it is left to OpenSL there.
+ */
+#define MIN_API_LEVEL                     27
+
+#define AAUDIO_OK                         0
+#define AAUDIO_ERROR_DISCONNECTED         (-899)
+#define AAUDIO_DIRECTION_OUTPUT           0
+#define AAUDIO_FORMAT_PCM_I16             1
+#define AAUDIO_FORMAT_PCM_FLOAT           2
+#define AAUDIO_SHARING_MODE_EXCLUSIVE     0
+#define AAUDIO_SHARING_MODE_SHARED        1
+#define AAUDIO_PERFORMANCE_MODE_LOW_LATENCY  12
+#define AAUDIO_CALLBACK_RESULT_CONTINUE   0
+
+/* Buffer size in bursts. Two bursts is the usual recommendation: the device
+ * reads one while the callback fills the other.
+ */
+#define DEFAULT_BUFFER_BURSTS    2
+
+typedef struct AAudioStreamStruct AAudioStream;
+typedef struct AAudioStreamBuilderStruct AAudioStreamBuilder;
+
+typedef int32_t (*data_callback_t)(AAudioStream *stream, void *user,
+   void *data, int32_t frames);
+typedef void (*error_callback_t)(AAudioStream *stream, void *user,
+   int32_t error);
+
+static struct {
+   int32_t (*create_builder)(AAudioStreamBuilder **builder);
+   int32_t (*builder_delete)(AAudioStreamBuilder *builder);
+   void (*set_direction)(AAudioStreamBuilder *builder, int32_t direction);
+   void (*set_sample_rate)(AAudioStreamBuilder *builder, int32_t rate);
+   void (*set_channel_count)(AAudioStreamBuilder *builder, int32_t count);
+   void (*set_format)(AAudioStreamBuilder *builder, int32_t format);
+   void (*set_sharing_mode)(AAudioStreamBuilder *builder, int32_t mode);
+   void (*set_performance_mode)(AAudioStreamBuilder *builder, int32_t mode);
+   void (*set_data_callback)(AAudioStreamBuilder *builder,
+      data_callback_t callback, void *user);
+   void (*set_error_callback)(AAudioStreamBuilder *builder,
+      error_callback_t callback, void *user);
+   int32_t (*open_stream)(AAudioStreamBuilder *builder, AAudioStream **stream);
+   int32_t (*close)(AAudioStream *stream);
+   int32_t (*request_start)(AAudioStream *stream);
+   int32_t (*request_stop)(AAudioStream *stream);
+   int32_t (*get_frames_per_burst)(AAudioStream *stream);
+   int32_t (*get_buffer_capacity)(AAudioStream *stream);
+   int32_t (*set_buffer_size)(AAudioStream *stream, int32_t frames);
+   int32_t (*get_xrun_count)(AAudioStream *stream);
+   int32_t (*get_sharing_mode)(AAudioStream *stream);
+   int32_t (*get_sample_rate)(AAudioStream *stream);
+   int64_t (*get_frames_written)(AAudioStream *stream);
+   int32_t (*get_timestamp)(AAudioStream *stream, clockid_t clock,
+      int64_t *frame_position, int64_t *nanos);
+   const char *(*result_text)(int32_t result);
+} aa;
+
+static void *aaudio_lib;
+
+typedef struct AAUDIO_VOICE
+{
+   AAudioStream *stream;
+   ALLEGRO_MUTEX *lock;          /* protects the fields below */
+   ALLEGRO_THREAD *reopen_thread;
+   bool playing;
+   bool closing;
+
+   /* Only used by the callback. */
+   unsigned int frame_size;
+   int32_t burst;
+   int32_t buffer_size;
+   int32_t xruns;
+} AAUDIO_VOICE;
+
+
+static int get_api_level(void)
+{
+   char value[PROP_VALUE_MAX];
+
+   if (__system_property_get("ro.build.version.sdk", value) <= 0)
+      return 0;
+   return atoi(value);
+}
+
+
+static int aaudio_open(void)
+{
+   int api = get_api_level();
+
+   if (api < MIN_API_LEVEL) {
+      ALLEGRO_INFO("Not using AAudio on API level %d.\n", api);
+      return 1;
+   }
+
+   aaudio_lib = dlopen("libaaudio.so", RTLD_NOW);
+   if (!aaudio_lib) {
+      ALLEGRO_WARN("Could not load libaaudio.so.\n");
+      return 1;
+   }
+
+#define GET(field, name) \
+   (*(void **)&aa.field = dlsym(aaudio_lib, name))
+
+   if (!GET(create_builder, "AAudio_createStreamBuilder") ||
+       !GET(builder_delete, "AAudioStreamBuilder_delete") ||
+       !GET(set_direction, "AAudioStreamBuilder_setDirection") ||
+       !GET(set_sample_rate, "AAudioStreamBuilder_setSampleRate") ||
+       !GET(set_channel_count, "AAudioStreamBuilder_setChannelCount") ||
+       !GET(set_format, "AAudioStreamBuilder_setFormat") ||
+       !GET(set_sharing_mode, "AAudioStreamBuilder_setSharingMode") ||
+       !GET(set_performance_mode, "AAudioStreamBuilder_setPerformanceMode") ||
+       !GET(set_data_callback, "AAudioStreamBuilder_setDataCallback") ||
+       !GET(set_error_callback, "AAudioStreamBuilder_setErrorCallback") ||
+       !GET(open_stream, "AAudioStreamBuilder_openStream") ||
+       !GET(close, "AAudioStream_close") ||
+       !GET(request_start, "AAudioStream_requestStart") ||
+       !GET(request_stop, "AAudioStream_requestStop") ||
+       !GET(get_frames_per_burst, "AAudioStream_getFramesPerBurst") ||
+       !GET(get_buffer_capacity, "AAudioStream_getBufferCapacityInFrames") ||
+       !GET(set_buffer_size, "AAudioStream_setBufferSizeInFrames") ||
+       !GET(get_xrun_count, "AAudioStream_getXRunCount") ||
+       !GET(get_sharing_mode, "AAudioStream_getSharingMode") ||
+       !GET(get_sample_rate, "AAudioStream_getSampleRate") ||
+       !GET(get_frames_written, "AAudioStream_getFramesWritten") ||
+       !GET(get_timestamp, "AAudioStream_getTimestamp") ||
+       !GET(result_text, "AAudio_convertResultToText")) {
+      ALLEGRO_WARN("libaaudio.so lacks %s.\n", dlerror());
+      dlclose(aaudio_lib);
+      aaudio_lib = NULL;
+      return 1;
+   }
+
+#undef GET
+
+   return 0;
+}
+
+
+static void aaudio_close(void)
+{
+   if (aaudio_lib) {
+      dlclose(aaudio_lib);
+      aaudio_lib = NULL;
+   }
+}
+
+
+static int32_t get_config_sharing_mode(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "aaudio",
+      "sharing_mode");
+
+   if (value && _al_stricmp(value, "shared") == 0)
+      return AAUDIO_SHARING_MODE_SHARED;
+   return AAUDIO_SHARING_MODE_EXCLUSIVE;
+}
+
+
+static int32_t get_config_buffer_bursts(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "aaudio",
+      "buffer_bursts");
+
+   if (value && value[0] != '\0') {
+      int n = atoi(value);
+      if (n >= 1)
+         return n;
+   }
+   return DEFAULT_BUFFER_BURSTS;
+}
+
+
+/* data_callback:
+ *  Called on the high priority thread of AAudio whenever the device needs
+ *  more frames. It must not block for long, but the voice mutex is only
+ *  held briefly by the rest of the addon.
+ */
+static int32_t data_callback(AAudioStream *stream, void *user, void *data,
+   int32_t frames)
+{
+   ALLEGRO_VOICE *voice = user;
+   AAUDIO_VOICE *av = voice->extra;
+   char *out = data;
+   int32_t xruns;
+
+   while (frames > 0) {
+      unsigned int n = frames;
+      const void *buf = _al_voice_update(voice, voice->mutex, &n);
+
+      if (!buf || n == 0) {
+         al_fill_silence(out, frames, voice->depth, voice->chan_conf);
+         break;
+      }
+      memcpy(out, buf, n * av->frame_size);
+      out += n * av->frame_size;
+      frames -= n;
+   }
+
+   /* Every underrun costs another burst of latency, until the buffer is as
+    * big as the stream allows. This settles on the smallest buffer which
+    * the device keeps up with.
+    */
+   xruns = aa.get_xrun_count(stream);
+   if (xruns > av->xruns) {
+      av->xruns = xruns;
+      _al_kcm_voice_underrun(voice);
+      if (av->buffer_size + av->burst <= aa.get_buffer_capacity(stream)) {
+         int32_t size = aa.set_buffer_size(stream,
+            av->buffer_size + av->burst);
+         if (size > 0)
+            av->buffer_size = size;
+      }
+   }
+
+   return AAUDIO_CALLBACK_RESULT_CONTINUE;
+}
+
+
+static void error_callback(AAudioStream *stream, void *user, int32_t error);
+
+
+/* open_stream:
+ *  Open a stream matching the voice, with the buffer a few bursts big.
+ */
+static AAudioStream *open_stream(ALLEGRO_VOICE *voice)
+{
+   AAUDIO_VOICE *av = voice->extra;
+   AAudioStreamBuilder *builder;
+   AAudioStream *stream = NULL;
+   int32_t result;
+
+   result = aa.create_builder(&builder);
+   if (result != AAUDIO_OK) {
+      ALLEGRO_ERROR("AAudio_createStreamBuilder: %s\n", aa.result_text(result));
+      return NULL;
+   }
+
+   aa.set_direction(builder, AAUDIO_DIRECTION_OUTPUT);
+   aa.set_sample_rate(builder, voice->frequency);
+   aa.set_channel_count(builder, al_get_channel_count(voice->chan_conf));
+   aa.set_format(builder, voice->depth == ALLEGRO_AUDIO_DEPTH_INT16 ?
+      AAUDIO_FORMAT_PCM_I16 : AAUDIO_FORMAT_PCM_FLOAT);
+   aa.set_sharing_mode(builder, get_config_sharing_mode());
+   aa.set_performance_mode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+   aa.set_data_callback(builder, data_callback, voice);
+   aa.set_error_callback(builder, error_callback, voice);
+
+   result = aa.open_stream(builder, &stream);
+   aa.builder_delete(builder);
+   if (result != AAUDIO_OK) {
+      ALLEGRO_ERROR("AAudioStreamBuilder_openStream: %s\n",
+         aa.result_text(result));
+      return NULL;
+   }
+
+   /* The mixer assumes the voice runs at the rate it asked for. */
+   if (aa.get_sample_rate(stream) != (int32_t)voice->frequency) {
+      ALLEGRO_ERROR("AAudio stream opened at %d Hz instead of %u Hz.\n",
+         aa.get_sample_rate(stream), voice->frequency);
+      aa.close(stream);
+      return NULL;
+   }
+
+   av->burst = aa.get_frames_per_burst(stream);
+   av->buffer_size = aa.set_buffer_size(stream,
+      av->burst * get_config_buffer_bursts());
+   av->xruns = aa.get_xrun_count(stream);
+
+   ALLEGRO_INFO("Opened %s stream, burst %d frames, buffer %d frames.\n",
+      aa.get_sharing_mode(stream) == AAUDIO_SHARING_MODE_EXCLUSIVE ?
+         "an exclusive" : "a shared",
+      av->burst, av->buffer_size);
+
+   return stream;
+}
+
+
+/* reopen_stream:
+ *  The stream stops for good when its device goes away, e.g. when
+ *  headphones are unplugged. The replacement can't be opened from the
+ *  error callback, so this runs in its own thread.
+ */
+static void *reopen_stream(ALLEGRO_THREAD *thread, void *arg)
+{
+   ALLEGRO_VOICE *voice = arg;
+   AAUDIO_VOICE *av = voice->extra;
+   (void)thread;
+
+   al_lock_mutex(av->lock);
+   if (!av->closing) {
+      ALLEGRO_INFO("Device disconnected, reopening the stream.\n");
+      aa.close(av->stream);
+      av->stream = open_stream(voice);
+      if (av->stream && av->playing)
+         aa.request_start(av->stream);
+   }
+   al_unlock_mutex(av->lock);
+
+   return NULL;
+}
+
+
+static void error_callback(AAudioStream *stream, void *user, int32_t error)
+{
+   ALLEGRO_VOICE *voice = user;
+   AAUDIO_VOICE *av = voice->extra;
+   (void)stream;
+
+   ALLEGRO_WARN("Stream error: %s\n", aa.result_text(error));
+   if (error != AAUDIO_ERROR_DISCONNECTED)
+      return;
+
+   /* A previous reopen has finished by now, as it opened this stream. */
+   al_lock_mutex(av->lock);
+   if (!av->closing) {
+      if (av->reopen_thread) {
+         al_join_thread(av->reopen_thread, NULL);
+         al_destroy_thread(av->reopen_thread);
+      }
+      av->reopen_thread = al_create_thread(reopen_stream, voice);
+      if (av->reopen_thread)
+         al_start_thread(av->reopen_thread);
+   }
+   al_unlock_mutex(av->lock);
+}
+
+
+static int aaudio_allocate_voice(ALLEGRO_VOICE *voice)
+{
+   AAUDIO_VOICE *av;
+
+   if (voice->depth != ALLEGRO_AUDIO_DEPTH_INT16 &&
+         voice->depth != ALLEGRO_AUDIO_DEPTH_FLOAT32) {
+      ALLEGRO_ERROR("Only int16 and float32 voices are supported.\n");
+      return 1;
+   }
+
+   av = al_calloc(1, sizeof(*av));
+   if (!av)
+      return 1;
+
+   av->lock = al_create_mutex();
+   if (!av->lock) {
+      al_free(av);
+      return 1;
+   }
+   av->frame_size = al_get_channel_count(voice->chan_conf) *
+      al_get_audio_depth_size(voice->depth);
+   voice->extra = av;
+
+   av->stream = open_stream(voice);
+   if (!av->stream) {
+      al_destroy_mutex(av->lock);
+      al_free(av);
+      voice->extra = NULL;
+      return 1;
+   }
+
+   return 0;
+}
+
+
+static void aaudio_deallocate_voice(ALLEGRO_VOICE *voice)
+{
+   AAUDIO_VOICE *av = voice->extra;
+
+   al_lock_mutex(av->lock);
+   av->closing = true;
+   al_unlock_mutex(av->lock);
+
+   if (av->reopen_thread) {
+      al_join_thread(av->reopen_thread, NULL);
+      al_destroy_thread(av->reopen_thread);
+   }
+
+   if (av->stream) {
+      aa.request_stop(av->stream);
+      aa.close(av->stream);
+   }
+
+   al_destroy_mutex(av->lock);
+   al_free(av);
+   voice->extra = NULL;
+}
+
+
+/* Only streaming voices are supported, as with OpenSL. */
+static int aaudio_load_voice(ALLEGRO_VOICE *voice, const void *data)
+{
+   (void)voice;
+   (void)data;
+   ALLEGRO_ERROR("Non-streaming voices are not supported.\n");
+   return 1;
+}
+
+
+static void aaudio_unload_voice(ALLEGRO_VOICE *voice)
+{
+   (void)voice;
+}
+
+
+static int aaudio_start_voice(ALLEGRO_VOICE *voice)
+{
+   AAUDIO_VOICE *av = voice->extra;
+   int32_t result = AAUDIO_OK;
+
+   al_lock_mutex(av->lock);
+   if (av->stream)
+      result = aa.request_start(av->stream);
+   if (result == AAUDIO_OK)
+      av->playing = true;
+   al_unlock_mutex(av->lock);
+
+   if (result != AAUDIO_OK) {
+      ALLEGRO_ERROR("AAudioStream_requestStart: %s\n", aa.result_text(result));
+      return 1;
+   }
+   return 0;
+}
+
+
+static int aaudio_stop_voice(ALLEGRO_VOICE *voice)
+{
+   AAUDIO_VOICE *av = voice->extra;
+
+   al_lock_mutex(av->lock);
+   if (av->stream)
+      aa.request_stop(av->stream);
+   av->playing = false;
+   al_unlock_mutex(av->lock);
+
+   return 0;
+}
+
+
+static bool aaudio_voice_is_playing(const ALLEGRO_VOICE *voice)
+{
+   AAUDIO_VOICE *av = voice->extra;
+   return av->playing;
+}
+
+
+static unsigned int aaudio_get_voice_position(const ALLEGRO_VOICE *voice)
+{
+   (void)voice;
+   return 0;
+}
+
+
+static int aaudio_set_voice_position(ALLEGRO_VOICE *voice, unsigned int pos)
+{
+   (void)voice;
+   (void)pos;
+   return 1;
+}
+
+
+/* aaudio_get_voice_latency:
+ *  The stream timestamp tells when a past frame was presented; the last
+ *  frame written comes out that much later.
+ */
+static double aaudio_get_voice_latency(const ALLEGRO_VOICE *voice)
+{
+   AAUDIO_VOICE *av = voice->extra;
+   int64_t position, nanos, written;
+   struct timespec now;
+   double latency = -1.0;
+
+   al_lock_mutex(av->lock);
+   if (av->stream && av->playing &&
+         aa.get_timestamp(av->stream, CLOCK_MONOTONIC, &position,
+            &nanos) == AAUDIO_OK) {
+      written = aa.get_frames_written(av->stream);
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      latency = (double)(written - position) / voice->frequency +
+         (nanos - ((int64_t)now.tv_sec * 1000000000 + now.tv_nsec)) / 1e9;
+      if (latency < 0.0)
+         latency = 0.0;
+   }
+   al_unlock_mutex(av->lock);
+
+   return latency;
+}
+
+
+ALLEGRO_AUDIO_DRIVER _al_kcm_aaudio_driver =
+{
+   "AAudio",
+
+   aaudio_open,
+   aaudio_close,
+
+   aaudio_allocate_voice,
+   aaudio_deallocate_voice,
+
+   aaudio_load_voice,
+   aaudio_unload_voice,
+
+   aaudio_start_voice,
+   aaudio_stop_voice,
+
+   aaudio_voice_is_playing,
+
+   aaudio_get_voice_position,
+   aaudio_set_voice_position,
+
+   NULL,
+   NULL,
+
+   aaudio_get_voice_latency
+};
+
+/* vim: set sts=3 sw=3 et: */
@@ -49,6 +49,8 @@ enum ALLEGRO_AUDIO_EVENT_TYPE
    ALLEGRO_EVENT_AUDIO_STREAM_FINISHED   = 514,
 #if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_KCM_AUDIO_SRC)
    ALLEGRO_EVENT_AUDIO_RECORDER_FRAGMENT = 515,
+   ALLEGRO_EVENT_AUDIO_VOICE_OVERLOAD    = 516,
+   ALLEGRO_EVENT_AUDIO_SAMPLE_LOADED     = 517,
 #endif
 };
 
@@ -63,6 +65,22 @@ struct ALLEGRO_AUDIO_RECORDER_EVENT
    void *buffer;
    unsigned int samples;
 };
+
+/* Type: ALLEGRO_AUDIO_STATS
+ */
+typedef struct ALLEGRO_AUDIO_STATS ALLEGRO_AUDIO_STATS;
+struct ALLEGRO_AUDIO_STATS
+{
+   unsigned int mix_count;
+   double mix_time_min;
+   double mix_time_avg;
+   double mix_time_max;
+   unsigned int overloads;
+   unsigned int underruns;
+   unsigned int starved_fragments;
+   unsigned int active_instances;
+   unsigned int virtual_instances;
+};
 #endif
 
 
@@ -131,10 +149,23 @@ enum ALLEGRO_MIXER_QUALITY
 {
    ALLEGRO_MIXER_QUALITY_POINT   = 0x110,
    ALLEGRO_MIXER_QUALITY_LINEAR  = 0x111,
-   ALLEGRO_MIXER_QUALITY_CUBIC   = 0x112
+   ALLEGRO_MIXER_QUALITY_CUBIC   = 0x112,
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_KCM_AUDIO_SRC)
+   ALLEGRO_MIXER_QUALITY_SINC    = 0x113,
+#endif
 };
 
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_KCM_AUDIO_SRC)
+/* Enum: ALLEGRO_VOICE_FLAGS
+ */
+enum ALLEGRO_VOICE_FLAGS
+{
+   ALLEGRO_VOICE_LOW_LATENCY     = 0x0001
+};
+#endif
+
+
 /* Enum: ALLEGRO_AUDIO_PAN_NONE
  */
 #define ALLEGRO_AUDIO_PAN_NONE      (-1000.0f)
@@ -178,6 +209,46 @@ typedef struct ALLEGRO_VOICE ALLEGRO_VOICE;
 /* Type: ALLEGRO_AUDIO_RECORDER
  */
 typedef struct ALLEGRO_AUDIO_RECORDER ALLEGRO_AUDIO_RECORDER;
+
+/* Type: ALLEGRO_AUDIO_EFFECT
+ */
+typedef struct ALLEGRO_AUDIO_EFFECT ALLEGRO_AUDIO_EFFECT;
+
+/* Enum: ALLEGRO_AUDIO_EFFECT_TYPE
+ */
+enum ALLEGRO_AUDIO_EFFECT_TYPE
+{
+   ALLEGRO_AUDIO_EFFECT_LOWPASS,
+   ALLEGRO_AUDIO_EFFECT_HIGHPASS,
+   ALLEGRO_AUDIO_EFFECT_PEAKING_EQ,
+   ALLEGRO_AUDIO_EFFECT_LOW_SHELF,
+   ALLEGRO_AUDIO_EFFECT_HIGH_SHELF,
+   ALLEGRO_AUDIO_EFFECT_COMPRESSOR,
+   ALLEGRO_AUDIO_EFFECT_REVERB
+};
+
+/* Enum: ALLEGRO_AUDIO_EFFECT_PARAM
+ */
+enum ALLEGRO_AUDIO_EFFECT_PARAM
+{
+   ALLEGRO_AUDIO_EFFECT_PARAM_FREQUENCY,
+   ALLEGRO_AUDIO_EFFECT_PARAM_Q,
+   ALLEGRO_AUDIO_EFFECT_PARAM_GAIN,
+   ALLEGRO_AUDIO_EFFECT_PARAM_THRESHOLD,
+   ALLEGRO_AUDIO_EFFECT_PARAM_RATIO,
+   ALLEGRO_AUDIO_EFFECT_PARAM_ATTACK,
+   ALLEGRO_AUDIO_EFFECT_PARAM_RELEASE,
+   ALLEGRO_AUDIO_EFFECT_PARAM_ROOM_SIZE,
+   ALLEGRO_AUDIO_EFFECT_PARAM_DAMPING,
+   ALLEGRO_AUDIO_EFFECT_PARAM_WET,
+   ALLEGRO_AUDIO_EFFECT_PARAM_DRY,
+   ALLEGRO_AUDIO_EFFECT_NUM_PARAMS
+};
+
+#ifndef __cplusplus
+typedef enum ALLEGRO_AUDIO_EFFECT_TYPE ALLEGRO_AUDIO_EFFECT_TYPE;
+typedef enum ALLEGRO_AUDIO_EFFECT_PARAM ALLEGRO_AUDIO_EFFECT_PARAM;
+#endif
 #endif
 
 
@@ -208,6 +279,10 @@ ALLEGRO_KCM_AUDIO_FUNC(unsigned int, al_get_sample_length, (const ALLEGRO_SAMPLE
 ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_AUDIO_DEPTH, al_get_sample_depth, (const ALLEGRO_SAMPLE *spl));
 ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_CHANNEL_CONF, al_get_sample_channels, (const ALLEGRO_SAMPLE *spl));
 ALLEGRO_KCM_AUDIO_FUNC(void *, al_get_sample_data, (const ALLEGRO_SAMPLE *spl));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_KCM_AUDIO_SRC)
+ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_SAMPLE *, al_create_adpcm_sample, (const ALLEGRO_SAMPLE *spl));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_is_sample_compressed, (const ALLEGRO_SAMPLE *spl));
+#endif
 
 ALLEGRO_KCM_AUDIO_FUNC(unsigned int, al_get_sample_instance_frequency, (const ALLEGRO_SAMPLE_INSTANCE *spl));
 ALLEGRO_KCM_AUDIO_FUNC(unsigned int, al_get_sample_instance_length, (const ALLEGRO_SAMPLE_INSTANCE *spl));
@@ -243,6 +318,9 @@ ALLEGRO_KCM_AUDIO_FUNC(bool, al_play_sample_instance, (ALLEGRO_SAMPLE_INSTANCE *
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_stop_sample_instance, (ALLEGRO_SAMPLE_INSTANCE *spl));
 #if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_KCM_AUDIO_SRC)
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_sample_instance_channel_matrix, (ALLEGRO_SAMPLE_INSTANCE *spl, const float *matrix));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_sample_instance_priority, (ALLEGRO_SAMPLE_INSTANCE *spl, int priority));
+ALLEGRO_KCM_AUDIO_FUNC(int, al_get_sample_instance_priority, (const ALLEGRO_SAMPLE_INSTANCE *spl));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_get_sample_instance_virtual, (const ALLEGRO_SAMPLE_INSTANCE *spl));
 #endif
 
 
@@ -292,6 +370,8 @@ ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_EVENT_SOURCE *, al_get_audio_stream_event_source,
 
 #if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_KCM_AUDIO_SRC)
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_audio_stream_channel_matrix, (ALLEGRO_AUDIO_STREAM *stream, const float *matrix));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_fade_audio_stream, (ALLEGRO_AUDIO_STREAM *stream, float gain, double seconds, bool stop));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_crossfade_audio_streams, (ALLEGRO_AUDIO_STREAM *from, ALLEGRO_AUDIO_STREAM *to, double seconds));
 #endif
 
 /* Mixer functions */
@@ -322,6 +402,28 @@ ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_mixer_gain, (ALLEGRO_MIXER *mixer, float gai
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_mixer_playing, (ALLEGRO_MIXER *mixer, bool val));
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_detach_mixer, (ALLEGRO_MIXER *mixer));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_KCM_AUDIO_SRC)
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_mixer_parallel, (ALLEGRO_MIXER *mixer, bool parallel));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_get_mixer_parallel, (const ALLEGRO_MIXER *mixer));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_mixer_max_voices, (ALLEGRO_MIXER *mixer, int max_voices));
+ALLEGRO_KCM_AUDIO_FUNC(int, al_get_mixer_max_voices, (const ALLEGRO_MIXER *mixer));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_mixer_audibility_threshold, (ALLEGRO_MIXER *mixer, float gain));
+ALLEGRO_KCM_AUDIO_FUNC(float, al_get_mixer_audibility_threshold, (const ALLEGRO_MIXER *mixer));
+ALLEGRO_KCM_AUDIO_FUNC(void, al_get_mixer_stats, (const ALLEGRO_MIXER *mixer, ALLEGRO_AUDIO_STATS *stats));
+ALLEGRO_KCM_AUDIO_FUNC(void, al_reset_mixer_stats, (ALLEGRO_MIXER *mixer));
+
+/* Effect functions */
+ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_AUDIO_EFFECT *, al_create_audio_effect, (ALLEGRO_AUDIO_EFFECT_TYPE type));
+ALLEGRO_KCM_AUDIO_FUNC(void, al_destroy_audio_effect, (ALLEGRO_AUDIO_EFFECT *effect));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_audio_effect_param, (ALLEGRO_AUDIO_EFFECT *effect,
+   ALLEGRO_AUDIO_EFFECT_PARAM param, float value));
+ALLEGRO_KCM_AUDIO_FUNC(float, al_get_audio_effect_param, (const ALLEGRO_AUDIO_EFFECT *effect,
+   ALLEGRO_AUDIO_EFFECT_PARAM param));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_attach_audio_effect_to_mixer, (ALLEGRO_AUDIO_EFFECT *effect,
+   ALLEGRO_MIXER *mixer, bool after_gain));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_detach_audio_effect, (ALLEGRO_AUDIO_EFFECT *effect));
+#endif
+
 /* Voice functions */
 ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_VOICE*, al_create_voice, (unsigned int freq,
       ALLEGRO_AUDIO_DEPTH depth,
@@ -343,6 +445,16 @@ ALLEGRO_KCM_AUDIO_FUNC(bool, al_get_voice_playing, (const ALLEGRO_VOICE *voice))
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_voice_position, (ALLEGRO_VOICE *voice, unsigned int val));
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_voice_playing, (ALLEGRO_VOICE *voice, bool val));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_KCM_AUDIO_SRC)
+ALLEGRO_KCM_AUDIO_FUNC(void, al_set_new_voice_flags, (int flags));
+ALLEGRO_KCM_AUDIO_FUNC(int, al_get_new_voice_flags, (void));
+ALLEGRO_KCM_AUDIO_FUNC(int, al_get_voice_flags, (const ALLEGRO_VOICE *voice));
+ALLEGRO_KCM_AUDIO_FUNC(double, al_get_voice_latency, (const ALLEGRO_VOICE *voice));
+ALLEGRO_KCM_AUDIO_FUNC(void, al_get_voice_stats, (const ALLEGRO_VOICE *voice, ALLEGRO_AUDIO_STATS *stats));
+ALLEGRO_KCM_AUDIO_FUNC(void, al_reset_voice_stats, (ALLEGRO_VOICE *voice));
+ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_EVENT_SOURCE *, al_get_voice_event_source, (ALLEGRO_VOICE *voice));
+#endif
+
 /* Misc. audio functions */
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_install_audio, (void));
 ALLEGRO_KCM_AUDIO_FUNC(void, al_uninstall_audio, (void));
@@ -368,6 +480,9 @@ ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_VOICE *, al_get_default_voice, (void));
 ALLEGRO_KCM_AUDIO_FUNC(void, al_set_default_voice, (ALLEGRO_VOICE *voice));
 
 #if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_KCM_AUDIO_SRC)
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_play_sample_with_priority, (ALLEGRO_SAMPLE *data,
+      float gain, float pan, float speed, ALLEGRO_PLAYMODE loop, int priority,
+      ALLEGRO_SAMPLE_ID *ret_id));
 ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_SAMPLE_INSTANCE*, al_lock_sample_id, (ALLEGRO_SAMPLE_ID *spl_id));
 ALLEGRO_KCM_AUDIO_FUNC(void, al_unlock_sample_id, (ALLEGRO_SAMPLE_ID *spl_id));
 #endif
@@ -401,6 +516,36 @@ ALLEGRO_KCM_AUDIO_FUNC(bool, al_save_sample_f, (ALLEGRO_FILE* fp, const char *id
 ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_AUDIO_STREAM *, al_load_audio_stream_f, (ALLEGRO_FILE* fp, const char *ident,
 	size_t buffer_count, unsigned int samples));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_KCM_AUDIO_SRC)
+ALLEGRO_KCM_AUDIO_FUNC(int, al_load_sample_async, (const char *filename,
+	ALLEGRO_EVENT_QUEUE *queue));
+ALLEGRO_KCM_AUDIO_FUNC(int, al_load_samples_batch, (const char * const *filenames,
+	int count, ALLEGRO_SAMPLE **samples));
+
+/* Sample cache functions */
+
+/* Type: ALLEGRO_SAMPLE_CACHE
+ */
+typedef struct ALLEGRO_SAMPLE_CACHE ALLEGRO_SAMPLE_CACHE;
+
+/* Enum: ALLEGRO_SAMPLE_CACHE_FLAGS
+ */
+enum ALLEGRO_SAMPLE_CACHE_FLAGS
+{
+   ALLEGRO_SAMPLE_CACHE_KEEP_COMPRESSED = 1
+};
+
+ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_SAMPLE_CACHE *, al_create_sample_cache, (size_t budget, int flags));
+ALLEGRO_KCM_AUDIO_FUNC(void, al_destroy_sample_cache, (ALLEGRO_SAMPLE_CACHE *cache));
+ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_SAMPLE *, al_get_cached_sample, (ALLEGRO_SAMPLE_CACHE *cache, const char *filename));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_preload_cached_sample, (ALLEGRO_SAMPLE_CACHE *cache, const char *filename));
+ALLEGRO_KCM_AUDIO_FUNC(void, al_release_cached_sample, (ALLEGRO_SAMPLE *spl));
+ALLEGRO_KCM_AUDIO_FUNC(void, al_set_sample_cache_budget, (ALLEGRO_SAMPLE_CACHE *cache, size_t budget));
+ALLEGRO_KCM_AUDIO_FUNC(size_t, al_get_sample_cache_budget, (ALLEGRO_SAMPLE_CACHE *cache));
+ALLEGRO_KCM_AUDIO_FUNC(size_t, al_get_sample_cache_size, (ALLEGRO_SAMPLE_CACHE *cache));
+
+#endif
+
 
 #if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_KCM_AUDIO_SRC)
 
@@ -413,6 +558,8 @@ ALLEGRO_KCM_AUDIO_FUNC(bool, al_is_audio_recorder_recording, (ALLEGRO_AUDIO_RECO
 ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_EVENT_SOURCE *, al_get_audio_recorder_event_source,
    (ALLEGRO_AUDIO_RECORDER *r));
 ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_AUDIO_RECORDER_EVENT *, al_get_audio_recorder_event, (ALLEGRO_EVENT *event));
+ALLEGRO_KCM_AUDIO_FUNC(const void *, al_get_audio_recorder_fragment, (ALLEGRO_AUDIO_RECORDER *r,
+   unsigned int *samples));
 ALLEGRO_KCM_AUDIO_FUNC(void, al_destroy_audio_recorder, (ALLEGRO_AUDIO_RECORDER *r));
 
 #endif
@@ -6,7 +6,8 @@
 #define AINTERN_AUDIO_H
 
 #include "allegro5/allegro.h"
-#include "allegro5/internal/aintern_list.h"
+#include "allegro5/internal/aintern_atomicops.h"
+#include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_vector.h"
 #include "../allegro_audio.h"
 
@@ -24,7 +25,21 @@ struct ALLEGRO_AUDIO_RECORDER {
   unsigned int             frequency;
 
   void                     **fragments;
-                           /* the buffers to record into */
+                           /* the buffers to record into, consecutive parts
+                              of one ring */
+
+  unsigned int             *fragment_samples;
+                           /* the number of samples recorded into each fragment */
+
+  volatile _AL_ATOMIC      fragments_written;
+                           /* fragments completed by the driver so far */
+
+  unsigned int             fragments_read;
+                           /* fragments taken by al_get_audio_recorder_fragment */
+
+  unsigned int             next_fragment;
+                           /* the fragment al_get_audio_recorder_fragment
+                              returns next */
 
   unsigned int             fragment_count;
                            /* the number of fragments */
@@ -57,7 +72,8 @@ typedef enum ALLEGRO_AUDIO_DRIVER_ENUM
    ALLEGRO_AUDIO_DRIVER_AQUEUE     = 0x20005,
    ALLEGRO_AUDIO_DRIVER_PULSEAUDIO = 0x20006,
    ALLEGRO_AUDIO_DRIVER_OPENSL     = 0x20007,
-   ALLEGRO_AUDIO_DRIVER_SDL        = 0x20008
+   ALLEGRO_AUDIO_DRIVER_SDL        = 0x20008,
+   ALLEGRO_AUDIO_DRIVER_AAUDIO     = 0x20009
 } ALLEGRO_AUDIO_DRIVER_ENUM;
 
 typedef struct ALLEGRO_AUDIO_DRIVER ALLEGRO_AUDIO_DRIVER;
@@ -84,14 +100,41 @@ struct ALLEGRO_AUDIO_DRIVER {
    
    int            (*allocate_recorder)(struct ALLEGRO_AUDIO_RECORDER *);
    void           (*deallocate_recorder)(struct ALLEGRO_AUDIO_RECORDER *);
+
+   /* Optional, returns the measured output latency in seconds or a
+    * negative value if it isn't known.
+    */
+   double         (*get_voice_latency)(const ALLEGRO_VOICE*);
 };
 
 extern ALLEGRO_AUDIO_DRIVER *_al_kcm_driver;
 
+void _al_kcm_recorder_fragment_done(struct ALLEGRO_AUDIO_RECORDER *r,
+   unsigned int fragment, unsigned int samples);
+
+/* Counters behind al_get_mixer_stats and al_get_voice_stats.  They are
+ * updated by the audio thread while it holds the voice mutex.
+ */
+typedef struct _AL_AUDIO_STATS {
+   unsigned int         mix_count;
+   double               mix_time_min;
+   double               mix_time_max;
+   double               mix_time_total;
+   unsigned int         overloads;
+   unsigned int         underruns;
+   unsigned int         starved_fragments;
+   unsigned int         active_instances;
+   unsigned int         virtual_instances;
+} _AL_AUDIO_STATS;
+
+void _al_kcm_add_mix_time(_AL_AUDIO_STATS *stats, double time);
+
 const void *_al_voice_update(ALLEGRO_VOICE *voice, ALLEGRO_MUTEX *mutex,
    unsigned int *samples);
+void _al_kcm_voice_underrun(ALLEGRO_VOICE *voice);
 bool _al_kcm_set_voice_playing(ALLEGRO_VOICE *voice, ALLEGRO_MUTEX *mutex,
    bool val);
+void _al_kcm_set_realtime_priority(void);
 
 /* A voice structure that you'd attach a mixer or sample to. Ideally there
  * would be one ALLEGRO_VOICE per system/hardware voice.
@@ -106,6 +149,9 @@ struct ALLEGRO_VOICE {
    size_t               num_buffers;
                         /* If non-0, they must be honored by the driver. */
 
+   int                  flags;
+                        /* ALLEGRO_VOICE_FLAGS the voice was created with. */
+
    ALLEGRO_SAMPLE_INSTANCE       *attached_stream;
                         /* The stream that is attached to the voice, or NULL.
                          * May be an ALLEGRO_SAMPLE_INSTANCE or ALLEGRO_MIXER object.
@@ -117,7 +163,16 @@ struct ALLEGRO_VOICE {
    ALLEGRO_MUTEX        *mutex;
    ALLEGRO_COND         *cond;
 
-   _AL_LIST_ITEM        *dtor_item;
+   _AL_DTOR_ITEM        *dtor_item;
+
+   ALLEGRO_EVENT_SOURCE es;
+                        /* Emits ALLEGRO_EVENT_AUDIO_VOICE_OVERLOAD. */
+   _AL_AUDIO_STATS      stats;
+   double               overload_threshold;
+                        /* Fraction of the played time a read may take
+                         * before it counts as an overload.
+                         */
+   double               last_overload_event;
 
    ALLEGRO_AUDIO_DRIVER *driver;
                         /* XXX shouldn't there only be one audio driver active
@@ -150,9 +205,62 @@ struct ALLEGRO_SAMPLE {
                         /* Whether `buffer' needs to be freed when the sample
                          * is destroyed, or when `buffer' changes.
                          */
-   _AL_LIST_ITEM        *dtor_item;
+   void                 *cache_entry;
+                        /* The ALLEGRO_SAMPLE_CACHE entry holding the sample,
+                         * if it came from al_get_cached_sample.
+                         */
+   ALLEGRO_FILE         *mapping;
+                        /* A file opened with al_fopen_mmap that `buffer'
+                         * points into, closed when the sample is destroyed.
+                         */
+   int                  block_align;
+   int                  block_frames;
+                        /* Non-zero if `buffer' holds IMA-ADPCM blocks of
+                         * block_align bytes, each decoding to block_frames
+                         * frames of `depth', instead of the frames
+                         * themselves.
+                         */
+   _AL_DTOR_ITEM        *dtor_item;
 };
 
+void _al_kcm_release_cached_sample(ALLEGRO_SAMPLE *spl);
+
+/* The blocks of a compressed sample that an instance has decoded. */
+#define _AL_ADPCM_CACHE_BLOCKS   2
+
+typedef struct _AL_ADPCM_CACHE {
+   int                  block[_AL_ADPCM_CACHE_BLOCKS];
+                        /* The block in each slot, or -1. */
+   int                  next;
+                        /* The slot to decode into next. */
+   int16_t              *frames[_AL_ADPCM_CACHE_BLOCKS];
+} _AL_ADPCM_CACHE;
+
+/* A fade asked for by the user, see _al_kcm_fade_sample_instance. */
+typedef struct _AL_PENDING_FADE {
+   unsigned int         serial;
+                        /* Counts up with every new fade. */
+   float                from;
+                        /* The fade to start from, or -1 to start from the
+                         * current one.
+                         */
+   float                to;
+   int                  frames;
+   bool                 stop;
+} _AL_PENDING_FADE;
+
+ALLEGRO_KCM_AUDIO_FUNC(int, _al_kcm_adpcm_block_frames, (int block_align,
+   int channels));
+void _al_kcm_decode_adpcm_block(const ALLEGRO_SAMPLE *spl, int block,
+   int16_t *out);
+_AL_ADPCM_CACHE *_al_kcm_create_adpcm_cache(const ALLEGRO_SAMPLE *spl);
+void _al_kcm_invalidate_adpcm_cache(_AL_ADPCM_CACHE *cache);
+const int16_t *_al_kcm_fill_adpcm_cache(_AL_ADPCM_CACHE *cache,
+   const ALLEGRO_SAMPLE *spl, int block);
+ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_SAMPLE *, _al_kcm_create_adpcm_sample, (
+   void *buf, unsigned int samples, unsigned int freq,
+   ALLEGRO_CHANNEL_CONF chan_conf, int block_align, bool free_buf));
+
 /* Read some samples into a mixer buffer.
  *
  * source:
@@ -221,6 +329,53 @@ struct ALLEGRO_SAMPLE_INSTANCE {
                          * The gain is premultiplied in.
                          */
 
+   /* Changes to the step and the matrix while attached to a mixer are
+    * published here, and picked up by the mixer between the blocks it
+    * mixes, so setting them never has to wait for the mixer mutex.
+    */
+   ALLEGRO_MUTEX        *params_mutex;
+                        /* Serialises the setters. */
+   volatile _AL_ATOMIC  params_seq;
+                        /* Odd while the pending values are being changed. */
+   _AL_ATOMIC           params_applied;
+                        /* params_seq at the time the mixer last picked up
+                         * the pending values.
+                         */
+   float                *pending_matrix;
+   int                  pending_step;
+   int                  applied_step;
+                        /* pending_step as last picked up by the mixer. */
+   _AL_PENDING_FADE     pending_fade;
+   unsigned int         applied_fade_serial;
+
+   float                fade;
+   float                fade_target;
+   float                fade_step;
+   int                  fade_frames;
+   bool                 fade_stop;
+                        /* A gain ramp applied on top of the matrix, moved on
+                         * by the mixer with every block, and the frames it
+                         * has left to go.  'fade' is 1 when not faded.
+                         */
+
+   struct _AL_SINC_BANK *sinc_bank;
+   int                  sinc_step;
+                        /* The filter bank used for sinc resampling, and the
+                         * step it was picked for.  The bank belongs to the
+                         * parent mixer.
+                         */
+
+   _AL_ADPCM_CACHE      *adpcm_cache;
+                        /* Decoded blocks of a compressed sample, while
+                         * attached to a mixer.
+                         */
+
+   int                  priority;
+   bool                 is_virtual;
+                        /* Set by the mixer for instances it only advances
+                         * instead of mixing, see al_set_mixer_max_voices.
+                         */
+
    bool                 is_mixer;
    stream_reader_t      spl_read;
                         /* Reads sample data into the provided buffer, using
@@ -236,12 +391,18 @@ struct ALLEGRO_SAMPLE_INSTANCE {
    sample_parent_t      parent;
                         /* The object that this sample is attached to, if any.
                          */
-   _AL_LIST_ITEM        *dtor_item;
+   int                  parent_index;
+                        /* Index in the streams of the parent mixer, so that
+                         * detaching needs no search.
+                         */
+   _AL_DTOR_ITEM        *dtor_item;
 };
 
 void _al_kcm_destroy_sample(ALLEGRO_SAMPLE_INSTANCE *sample, bool unregister);
 void _al_kcm_stream_set_mutex(ALLEGRO_SAMPLE_INSTANCE *stream, ALLEGRO_MUTEX *mutex);
 void _al_kcm_detach_from_parent(ALLEGRO_SAMPLE_INSTANCE *spl);
+bool _al_kcm_fade_sample_instance(ALLEGRO_SAMPLE_INSTANCE *spl, float from,
+   float to, double seconds, bool stop);
 
 
 typedef size_t (*stream_callback_t)(ALLEGRO_AUDIO_STREAM *, void *, size_t);
@@ -295,11 +456,18 @@ struct ALLEGRO_AUDIO_STREAM {
                           * the stream was started.
                           */
 
-   ALLEGRO_THREAD        *feed_thread;
-   ALLEGRO_MUTEX         *feed_thread_started_mutex;
-   ALLEGRO_COND          *feed_thread_started_cond;
-   bool                  feed_thread_started;
-   volatile bool         quit_feed_thread;
+   bool                  starved;
+                         /* Set while the stream is out of fragments without
+                          * draining, so each dry spell is only counted once.
+                          */
+
+   int                   feed_state;
+   uint64_t              feed_order;
+   bool                  feed_finished_sent;
+                         /* State of the stream in the feeder pool, see
+                          * kcm_feeder.c.
+                          */
+
    unload_feeder_t       unload_feeder;
    rewind_feeder_t       rewind_feeder;
    seek_feeder_t         seek_feeder;
@@ -309,17 +477,35 @@ struct ALLEGRO_AUDIO_STREAM {
    stream_callback_t     feeder;
                          /* If ALLEGRO_AUDIO_STREAM has been created by
                           * al_load_audio_stream(), the stream will be fed
-                          * by a thread using the 'feeder' callback. Such
-                          * streams don't need to be fed by the user.
+                          * by the feeder threads using the 'feeder' callback.
+                          * Such streams don't need to be fed by the user.
                           */
 
-   _AL_LIST_ITEM        *dtor_item;
+   _AL_DTOR_ITEM        *dtor_item;
+
+   double                loop_start;
+                         /* As last set with al_set_audio_stream_loop_secs. */
+
+   char                  *loop_cache;
+   size_t                loop_cache_size;
+   size_t                loop_cache_pos;
+   bool                  loop_cache_valid;
+   bool                  loop_cache_whole;
+                         /* The first fragment's worth of the loop, decoded
+                          * by the feeder threads the first time the stream
+                          * loops, so that later loops need no seek before
+                          * the fragment at the loop point is handed over.
+                          * 'loop_cache_pos' is how much of it has been fed
+                          * since the stream last looped.  If the whole loop
+                          * fits, 'loop_cache_whole' is set.  See kcm_feeder.c.
+                          */
 
    void                  *extra;
                          /* Extra data for use by the flac/vorbis addons. */
 };
 
 bool _al_kcm_refill_stream(ALLEGRO_AUDIO_STREAM *stream);
+void _al_kcm_drop_loop_cache_rest(ALLEGRO_AUDIO_STREAM *stream);
 
 
 typedef void (*postprocess_callback_t)(void *buf, unsigned int samples,
@@ -331,26 +517,74 @@ typedef void (*postprocess_callback_t)(void *buf, unsigned int samples,
  * will be set to a different function that will call the read method of all
  * attached streams (which may be a sample, or another mixer).
  */
+#define _AL_MIXER_INLINE_STREAMS 8
+
 struct ALLEGRO_MIXER {
    ALLEGRO_SAMPLE_INSTANCE          ss;
                            /* ALLEGRO_MIXER is derived from ALLEGRO_SAMPLE_INSTANCE. */
 
    ALLEGRO_MIXER_QUALITY   quality;
 
+   bool                    parallel;
+                           /* Mix the attached mixers on the worker threads. */
+   bool                    premixed;
+   bool                    premix_ok;
+                           /* Set once the parent mixer has mixed this one
+                            * in parallel for the current period.
+                            */
+
    postprocess_callback_t  postprocess_callback;
    void                    *pp_callback_userdata;
 
    _AL_VECTOR              streams;
                            /* Vector of ALLEGRO_SAMPLE_INSTANCE*.  Holds the list of
-                            * streams being mixed together.
+                            * streams being mixed together, in no particular
+                            * order.  The first few are kept in inline_streams.
+                            */
+   ALLEGRO_SAMPLE_INSTANCE *inline_streams[_AL_MIXER_INLINE_STREAMS];
+   _AL_VECTOR              effects;
+                           /* Vector of ALLEGRO_AUDIO_EFFECT*, in the order
+                            * they run in.
+                            */
+   _AL_VECTOR              sinc_banks;
+                           /* Vector of _AL_SINC_BANK*.  The filter banks
+                            * created for the attached streams so far.
+                            */
+   int                     max_voices;
+   float                   audibility_threshold;
+                           /* Sample instances beyond the first max_voices
+                            * (if non-zero), or with a gain below the
+                            * threshold, are virtual.
                             */
-   _AL_LIST_ITEM           *dtor_item;
+   ALLEGRO_SAMPLE_INSTANCE **voice_order;
+   int                     voice_order_size;
+                           /* Scratch space for picking the real voices. */
+   _AL_AUDIO_STATS         stats;
+                           /* Starved fragments and the instance counts only
+                            * count the streams attached directly.
+                            */
+   _AL_DTOR_ITEM           *dtor_item;
 };
 
 extern void _al_kcm_mixer_rejig_sample_matrix(ALLEGRO_MIXER *mixer,
    ALLEGRO_SAMPLE_INSTANCE *spl);
-extern void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
-   ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc);
+extern void _al_kcm_mixer_set_sample_matrix(ALLEGRO_MIXER *mixer,
+   ALLEGRO_SAMPLE_INSTANCE *spl, const float *matrix);
+extern void _al_kcm_mixer_set_sample_step(ALLEGRO_SAMPLE_INSTANCE *spl,
+   int step);
+extern void _al_kcm_mixer_free_sample_params(ALLEGRO_SAMPLE_INSTANCE *spl);
+extern void _al_kcm_mixer_free_sinc_banks(ALLEGRO_MIXER *mixer);
+void _al_kcm_run_mixer_effects(ALLEGRO_MIXER *mixer, unsigned int samples,
+   bool after_gain);
+void _al_kcm_detach_mixer_effects(ALLEGRO_MIXER *mixer);
+ALLEGRO_KCM_AUDIO_FUNC(void, _al_kcm_mixer_read, (void *source, void **buf,
+   unsigned int *samples, ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc));
+struct ALLEGRO_AUDIO_STATS;
+extern void _al_kcm_mixer_sum_stats(const ALLEGRO_MIXER *mixer,
+   _AL_AUDIO_STATS *stats);
+extern void _al_kcm_mixer_reset_stats(ALLEGRO_MIXER *mixer);
+extern void _al_kcm_copy_stats(const _AL_AUDIO_STATS *src,
+   struct ALLEGRO_AUDIO_STATS *dst);
 
 
 typedef enum {
@@ -362,17 +596,34 @@ typedef enum {
 
 extern void _al_set_error(int error, char* string);
 
+/* States of a stream in the feeder pool. */
+enum {
+   _AL_FEED_NONE,       /* not fed by the pool */
+   _AL_FEED_IDLE,       /* no fragments to refill */
+   _AL_FEED_QUEUED,     /* waiting for a feeder thread */
+   _AL_FEED_FEEDING,    /* being refilled by a feeder thread */
+   _AL_FEED_AGAIN,      /* being refilled, with more fragments to follow */
+   _AL_FEED_DRAINING    /* out of data, waiting for playback to end */
+};
+
+void _al_kcm_init_stream_feeders(void);
+void _al_kcm_shutdown_stream_feeders(void);
+
+void _al_kcm_init_async_loading(void);
+void _al_kcm_shutdown_async_loading(void);
+
 /* Supposedly internal */
-ALLEGRO_KCM_AUDIO_FUNC(void*, _al_kcm_feed_stream, (ALLEGRO_THREAD *self, void *vstream));
+ALLEGRO_KCM_AUDIO_FUNC(void, _al_kcm_start_feeding_stream, (ALLEGRO_AUDIO_STREAM *stream));
+ALLEGRO_KCM_AUDIO_FUNC(void, _al_kcm_stop_feeding_stream, (ALLEGRO_AUDIO_STREAM *stream));
 
 /* Helper to emit an event that the stream has got a buffer ready to be refilled. */
 void _al_kcm_emit_stream_events(ALLEGRO_AUDIO_STREAM *stream);
 
 void _al_kcm_init_destructors(void);
 void _al_kcm_shutdown_destructors(void);
-_AL_LIST_ITEM *_al_kcm_register_destructor(char const *name, void *object,
+_AL_DTOR_ITEM *_al_kcm_register_destructor(char const *name, void *object,
    void (*func)(void*));
-void _al_kcm_unregister_destructor(_AL_LIST_ITEM *dtor_item);
+void _al_kcm_unregister_destructor(_AL_DTOR_ITEM *dtor_item);
 void _al_kcm_foreach_destructor(
       void (*callback)(void *object, void (*func)(void *), void *udata),
       void *userdata);
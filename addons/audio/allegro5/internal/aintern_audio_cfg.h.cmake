@@ -1,6 +1,7 @@
 #cmakedefine ALLEGRO_CFG_KCM_ALSA
 #cmakedefine ALLEGRO_CFG_KCM_OPENAL
 #cmakedefine ALLEGRO_CFG_KCM_OPENSL
+#cmakedefine ALLEGRO_CFG_KCM_AAUDIO
 #cmakedefine ALLEGRO_CFG_KCM_DSOUND
 #cmakedefine ALLEGRO_CFG_KCM_OSS
 #cmakedefine ALLEGRO_CFG_KCM_PULSEAUDIO
@@ -54,6 +54,12 @@ static char *alsa_device = NULL;
 // This value works well on my RPI3 and Linux machine.
 #define DEFAULT_BUFFER_SIZE 2048
 
+// Low-latency voices use the smallest period the device allows, but not less
+// than this floor (about 2.7 ms at 48 kHz). Below that most consumer hardware
+// and the ALSA plugins start to underrun.
+#define DEFAULT_LOW_LATENCY_PERIOD_SIZE   128
+#define DEFAULT_LOW_LATENCY_PERIODS       3
+
 static unsigned int get_period_size(void)
 {
    const char *val = al_get_config_value(al_get_system_config(),
@@ -82,6 +88,34 @@ static snd_pcm_uframes_t get_buffer_size(void)
    return DEFAULT_BUFFER_SIZE;
 }
 
+static snd_pcm_uframes_t get_low_latency_period_size(void)
+{
+   const char *val = al_get_config_value(al_get_system_config(),
+      "alsa", "low_latency_period_size");
+   if (val && val[0] != '\0') {
+      int n = atoi(val);
+      if (n < MIN_PERIOD_SIZE)
+         n = MIN_PERIOD_SIZE;
+      return n;
+   }
+
+   return DEFAULT_LOW_LATENCY_PERIOD_SIZE;
+}
+
+static unsigned int get_low_latency_periods(void)
+{
+   const char *val = al_get_config_value(al_get_system_config(),
+      "alsa", "low_latency_periods");
+   if (val && val[0] != '\0') {
+      int n = atoi(val);
+      if (n < 2)
+         n = 2;
+      return n;
+   }
+
+   return DEFAULT_LOW_LATENCY_PERIODS;
+}
+
 typedef struct ALSA_VOICE {
    unsigned int frame_size; /* in bytes */
    unsigned int len; /* in frames */
@@ -98,6 +132,10 @@ typedef struct ALSA_VOICE {
 
    snd_pcm_t *pcm_handle;
    bool mmapped;
+
+   bool low_latency;
+   int poll_timeout; /* in ms, 0 to rest between polls instead */
+   volatile snd_pcm_sframes_t delay; /* last measured, in frames, or -1 */
 } ALSA_VOICE;
 
 
@@ -151,9 +189,10 @@ static void alsa_close(void)
 
 
 /* Underrun and suspend recovery */
-static int xrun_recovery(snd_pcm_t *handle, int err)
+static int xrun_recovery(ALLEGRO_VOICE *voice, snd_pcm_t *handle, int err)
 {
    if (err == -EPIPE) { /* under-run */
+      _al_kcm_voice_underrun(voice);
       err = snd_pcm_prepare(handle);
       if (err < 0) {
          ALLEGRO_ERROR("Can't recover from underrun, prepare failed: %s\n", snd_strerror(err));
@@ -239,13 +278,26 @@ static int alsa_update_nonstream_voice(ALLEGRO_VOICE *voice, void **buf, int *by
 }
 
 
+/* Remembers how many frames are queued in front of the ones just written,
+ * for alsa_get_voice_latency.
+ */
+static void update_delay(ALSA_VOICE *alsa_voice)
+{
+   snd_pcm_sframes_t delay;
+
+   if (snd_pcm_delay(alsa_voice->pcm_handle, &delay) == 0 && delay >= 0)
+      alsa_voice->delay = delay;
+}
+
+
 /* Returns true if the voice is ready for more data. */
-static int alsa_voice_is_ready(ALSA_VOICE *alsa_voice)
+static int alsa_voice_is_ready(ALLEGRO_VOICE *voice)
 {
+   ALSA_VOICE *alsa_voice = (ALSA_VOICE*)voice->extra;
    unsigned short revents;
    int err;
 
-   poll(alsa_voice->ufds, alsa_voice->ufds_count, 0);
+   poll(alsa_voice->ufds, alsa_voice->ufds_count, alsa_voice->poll_timeout);
    snd_pcm_poll_descriptors_revents(alsa_voice->pcm_handle, alsa_voice->ufds,
                                     alsa_voice->ufds_count, &revents);
 
@@ -258,7 +310,7 @@ static int alsa_voice_is_ready(ALSA_VOICE *alsa_voice)
          else
             err = -ESTRPIPE;
 
-         if (xrun_recovery(alsa_voice->pcm_handle, err) < 0) {
+         if (xrun_recovery(voice, alsa_voice->pcm_handle, err) < 0) {
             ALLEGRO_ERROR("Write error: %s\n", snd_strerror(err));
             return -POLLERR;
          }
@@ -292,9 +344,13 @@ static void *alsa_update_mmap(ALLEGRO_THREAD *self, void *arg)
 
    ALLEGRO_INFO("ALSA update_mmap thread started\n");
 
+   if (alsa_voice->low_latency)
+      _al_kcm_set_realtime_priority();
+
    while (!al_get_thread_should_stop(self)) {
       if (alsa_voice->stop && !alsa_voice->stopped) {
          snd_pcm_drop(alsa_voice->pcm_handle);
+         alsa_voice->delay = -1;
          al_lock_mutex(voice->mutex);
          alsa_voice->stopped = true;
          al_signal_cond(voice->cond);
@@ -331,11 +387,15 @@ static void *alsa_update_mmap(ALLEGRO_THREAD *self, void *arg)
          ALLEGRO_DEBUG("snd_pcm_start returned: %d\n", rc);
       }
 
-      ret = alsa_voice_is_ready(alsa_voice);
+      ret = alsa_voice_is_ready(voice);
       if (ret < 0)
          break;
       if (ret == 0) {
-         al_rest(0.005); /* TODO: Why not use an event or condition variable? */
+         /* With a poll timeout we already slept until the device wanted
+          * more data (or the timeout ran out).
+          */
+         if (alsa_voice->poll_timeout == 0)
+            al_rest(0.005); /* TODO: Why not use an event or condition variable? */
          continue;
       }
 
@@ -343,7 +403,7 @@ static void *alsa_update_mmap(ALLEGRO_THREAD *self, void *arg)
       frames = alsa_voice->frag_len;
       ret = snd_pcm_mmap_begin(alsa_voice->pcm_handle, &areas, &offset, &frames);
       if (ret < 0) {
-         if ((ret = xrun_recovery(alsa_voice->pcm_handle, ret)) < 0) {
+         if ((ret = xrun_recovery(voice, alsa_voice->pcm_handle, ret)) < 0) {
             ALLEGRO_ERROR("MMAP begin avail error: %s\n", snd_strerror(ret));
          }
          break;
@@ -396,11 +456,12 @@ silence:
 commit:
       commitres = snd_pcm_mmap_commit(alsa_voice->pcm_handle, offset, frames);
       if (commitres < 0 || (snd_pcm_uframes_t)commitres != frames) {
-         if ((ret = xrun_recovery(alsa_voice->pcm_handle, commitres >= 0 ? -EPIPE : commitres)) < 0) {
+         if ((ret = xrun_recovery(voice, alsa_voice->pcm_handle, commitres >= 0 ? -EPIPE : commitres)) < 0) {
             ALLEGRO_ERROR("MMAP commit error: %s\n", snd_strerror(ret));
             break;
          }
       }
+      update_delay(alsa_voice);
    }
 
    ALLEGRO_INFO("ALSA update_mmap thread stopped\n");
@@ -420,9 +481,13 @@ static void *alsa_update_rw(ALLEGRO_THREAD *self, void *arg)
 
    ALLEGRO_INFO("ALSA update_rw thread started\n");
 
+   if (alsa_voice->low_latency)
+      _al_kcm_set_realtime_priority();
+
    while (!al_get_thread_should_stop(self)) {
       if (alsa_voice->stop && !alsa_voice->stopped) {
          snd_pcm_drop(alsa_voice->pcm_handle);
+         alsa_voice->delay = -1;
          al_lock_mutex(voice->mutex);
          alsa_voice->stopped = true;
          al_signal_cond(voice->cond);
@@ -463,6 +528,7 @@ static void *alsa_update_rw(ALLEGRO_THREAD *self, void *arg)
       err = snd_pcm_avail_update(alsa_voice->pcm_handle);
       if (err < 0) {
          if (err == -EPIPE) {
+            _al_kcm_voice_underrun(voice);
             snd_pcm_prepare(alsa_voice->pcm_handle);
          }
          else {
@@ -503,9 +569,13 @@ silence:
       err = snd_pcm_writei(alsa_voice->pcm_handle, buf, frames);
       if (err < 0) {
          if (err == -EPIPE) {
+            _al_kcm_voice_underrun(voice);
             snd_pcm_prepare(alsa_voice->pcm_handle);
          }
       }
+      else {
+         update_delay(alsa_voice);
+      }
    }
 
    ALLEGRO_INFO("ALSA update_rw thread stopped\n");
@@ -590,6 +660,35 @@ static bool alsa_voice_is_playing(const ALLEGRO_VOICE *voice)
 }
 
 
+/* Asks for the smallest period the device supports, limited by the
+   configured floor, and a buffer of only a few periods. */
+static int set_low_latency_params(snd_pcm_t *pcm_handle,
+   snd_pcm_hw_params_t *hwparams, snd_pcm_uframes_t *period,
+   snd_pcm_uframes_t *buffer_size)
+{
+   snd_pcm_uframes_t min_period;
+   int dir = 0;
+   int err;
+
+   err = snd_pcm_hw_params_get_period_size_min(hwparams, &min_period, &dir);
+   if (err < 0)
+      return err;
+
+   *period = get_low_latency_period_size();
+   if (*period < min_period)
+      *period = min_period;
+
+   err = snd_pcm_hw_params_set_period_size_near(pcm_handle, hwparams, period,
+      NULL);
+   if (err < 0)
+      return err;
+
+   *buffer_size = *period * get_low_latency_periods();
+   return snd_pcm_hw_params_set_buffer_size_near(pcm_handle, hwparams,
+      buffer_size);
+}
+
+
 /* The allocate_voice method should grab a voice from the system, and allocate
    any data common to streaming and non-streaming sources. */
 static int alsa_allocate_voice(ALLEGRO_VOICE *voice)
@@ -610,6 +709,8 @@ static int alsa_allocate_voice(ALLEGRO_VOICE *voice)
    ex_data->stop = true;
    ex_data->stopped = true;
    ex_data->reversed = false;
+   ex_data->low_latency = (voice->flags & ALLEGRO_VOICE_LOW_LATENCY) != 0;
+   ex_data->delay = -1;
 
    ex_data->frag_len = get_period_size();
 
@@ -652,11 +753,25 @@ static int alsa_allocate_voice(ALLEGRO_VOICE *voice)
    ALSA_CHECK(snd_pcm_hw_params_set_format(ex_data->pcm_handle, hwparams, format));
    ALSA_CHECK(snd_pcm_hw_params_set_channels(ex_data->pcm_handle, hwparams, chan_count));
    ALSA_CHECK(snd_pcm_hw_params_set_rate_near(ex_data->pcm_handle, hwparams, &req_freq, NULL));
-   ALSA_CHECK(snd_pcm_hw_params_set_period_size_near(ex_data->pcm_handle, hwparams, &ex_data->frag_len, NULL));
-   snd_pcm_uframes_t buffer_size = get_buffer_size();
-   ALSA_CHECK(snd_pcm_hw_params_set_buffer_size_near(ex_data->pcm_handle, hwparams, &buffer_size));
+   snd_pcm_uframes_t buffer_size;
+   if (ex_data->low_latency) {
+      ALSA_CHECK(set_low_latency_params(ex_data->pcm_handle, hwparams, &ex_data->frag_len, &buffer_size));
+   }
+   else {
+      ALSA_CHECK(snd_pcm_hw_params_set_period_size_near(ex_data->pcm_handle, hwparams, &ex_data->frag_len, NULL));
+      buffer_size = get_buffer_size();
+      ALSA_CHECK(snd_pcm_hw_params_set_buffer_size_near(ex_data->pcm_handle, hwparams, &buffer_size));
+   }
    ALSA_CHECK(snd_pcm_hw_params(ex_data->pcm_handle, hwparams));
 
+   if (ex_data->low_latency) {
+      /* Wake up on the device instead of resting, for at most two periods
+       * so stop requests are still noticed. */
+      ex_data->poll_timeout = 1 + (int)(2000 * ex_data->frag_len / req_freq);
+      ALLEGRO_INFO("Low-latency voice: period %lu, buffer %lu frames.\n",
+         (unsigned long)ex_data->frag_len, (unsigned long)buffer_size);
+   }
+
    if (voice->frequency != req_freq) {
       ALLEGRO_ERROR("Unsupported rate! Requested %u, got %iu.\n", voice->frequency, req_freq);
       goto Error;
@@ -698,6 +813,20 @@ Error:
 
 
 
+/* The get_voice_latency method returns how long it takes for the data
+   written last to be heard, as measured by the update thread. */
+static double alsa_get_voice_latency(const ALLEGRO_VOICE *voice)
+{
+   ALSA_VOICE *alsa_voice = (ALSA_VOICE*)voice->extra;
+   snd_pcm_sframes_t delay = alsa_voice->delay;
+
+   if (delay < 0)
+      return -1.0;
+   return (double)delay / voice->frequency;
+}
+
+
+
 /* The deallocate_voice method should free the resources for the given voice,
    but still retain a hold on the device. The voice should be stopped and
    unloaded by the time this is called */
@@ -751,7 +880,6 @@ static void *alsa_update_recorder(ALLEGRO_THREAD *t, void *thread_data)
 {
    ALLEGRO_AUDIO_RECORDER *r = thread_data;
    ALSA_RECORDER_DATA *alsa = r->extra;
-   ALLEGRO_EVENT user_event;
    uint8_t *null_buffer;
    unsigned int fragment_i = 0;
    
@@ -774,16 +902,11 @@ static void *alsa_update_recorder(ALLEGRO_THREAD *t, void *thread_data)
          snd_pcm_readi(alsa->capture_handle, null_buffer, 1024);
       }
       else {
-         ALLEGRO_AUDIO_RECORDER_EVENT *e;
          snd_pcm_sframes_t count;
          al_unlock_mutex(r->mutex);
          if ((count = snd_pcm_readi(alsa->capture_handle, r->fragments[fragment_i], r->samples)) > 0) {
-            user_event.user.type = ALLEGRO_EVENT_AUDIO_RECORDER_FRAGMENT;
-            e = al_get_audio_recorder_event(&user_event);
-            e->buffer = r->fragments[fragment_i];
-            e->samples = count;
-            al_emit_user_event(&r->source, &user_event, NULL);
-         
+            _al_kcm_recorder_fragment_done(r, fragment_i, count);
+
             if (++fragment_i == r->fragment_count) {
                fragment_i = 0;
             }
@@ -800,6 +923,8 @@ static int alsa_allocate_recorder(ALLEGRO_AUDIO_RECORDER *r)
    ALSA_RECORDER_DATA *data;
    unsigned int frequency = r->frequency;
    snd_pcm_format_t format;
+   snd_pcm_uframes_t period_size;
+   snd_pcm_uframes_t buffer_size;
    const char *device = default_device;
    const char *config_device;
    config_device =
@@ -843,6 +968,20 @@ static int alsa_allocate_recorder(ALLEGRO_AUDIO_RECORDER *r)
    }
    
    ALSA_CHECK(snd_pcm_hw_params_set_channels(data->capture_handle, data->hw_params, al_get_channel_count(r->chan_conf)));
+
+   /* Wake up once per fragment rather than once per default sized period,
+    * which may be much longer. The device buffer need not be larger than
+    * the fragments we record into.
+    */
+   period_size = r->samples;
+   buffer_size = (snd_pcm_uframes_t)r->samples * r->fragment_count;
+   if (buffer_size < period_size * 2)
+      buffer_size = period_size * 2;
+   ALSA_CHECK(snd_pcm_hw_params_set_period_size_near(data->capture_handle, data->hw_params, &period_size, NULL));
+   ALSA_CHECK(snd_pcm_hw_params_set_buffer_size_near(data->capture_handle, data->hw_params, &buffer_size));
+   ALLEGRO_DEBUG("Capture period %lu, buffer %lu frames.\n",
+      (unsigned long)period_size, (unsigned long)buffer_size);
+
    ALSA_CHECK(snd_pcm_hw_params(data->capture_handle, data->hw_params));
    
    ALSA_CHECK(snd_pcm_prepare(data->capture_handle));
@@ -897,7 +1036,9 @@ ALLEGRO_AUDIO_DRIVER _al_kcm_alsa_driver =
    alsa_set_voice_position,
 
    alsa_allocate_recorder,
-   alsa_deallocate_recorder
+   alsa_deallocate_recorder,
+
+   alsa_get_voice_latency
 };
 
 /* vim: set sts=3 sw=3 et: */
@@ -8,6 +8,7 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_audio.h"
@@ -16,6 +17,11 @@
 #include "allegro5/internal/aintern_audio.h"
 #include "allegro5/internal/aintern_audio_cfg.h"
 
+#ifdef ALLEGRO_UNIX
+   #include <pthread.h>
+   #include <sched.h>
+#endif
+
 ALLEGRO_DEBUG_CHANNEL("audio")
 
 void _al_set_error(int error, char* string)
@@ -31,6 +37,9 @@ ALLEGRO_AUDIO_DRIVER *_al_kcm_driver = NULL;
 #if defined(ALLEGRO_CFG_KCM_OPENSL)
    extern struct ALLEGRO_AUDIO_DRIVER _al_kcm_opensl_driver;
 #endif
+#if defined(ALLEGRO_CFG_KCM_AAUDIO)
+   extern struct ALLEGRO_AUDIO_DRIVER _al_kcm_aaudio_driver;
+#endif
 #if defined(ALLEGRO_CFG_KCM_ALSA)
    extern struct ALLEGRO_AUDIO_DRIVER _al_kcm_alsa_driver;
 #endif
@@ -166,6 +175,47 @@ void al_fill_silence(void *buf, unsigned int samples,
    }
 }
 
+/* _al_kcm_set_realtime_priority:
+ *  Moves the calling driver thread into the SCHED_FIFO class. This is used by
+ *  the update threads of low-latency voices, which would otherwise miss their
+ *  deadlines whenever the rest of the process keeps the CPUs busy. Most
+ *  systems only allow it for users with an rtprio limit, so failing is not
+ *  an error.
+ */
+void _al_kcm_set_realtime_priority(void)
+{
+#ifdef ALLEGRO_UNIX
+   struct sched_param param;
+   const char *val;
+   int prio = 10;
+   int min = sched_get_priority_min(SCHED_FIFO);
+   int max = sched_get_priority_max(SCHED_FIFO);
+   int err;
+
+   val = al_get_config_value(al_get_system_config(), "audio",
+      "realtime_priority");
+   if (val && val[0] != '\0')
+      prio = atoi(val);
+   if (prio <= 0) {
+      ALLEGRO_INFO("Real-time priority disabled.\n");
+      return;
+   }
+
+   memset(&param, 0, sizeof(param));
+   param.sched_priority = _ALLEGRO_CLAMP(min, min + prio - 1, max);
+   err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+   if (err != 0) {
+      ALLEGRO_WARN("Could not switch to SCHED_FIFO priority %d: %s\n",
+         param.sched_priority, strerror(err));
+      return;
+   }
+   ALLEGRO_INFO("Running at SCHED_FIFO priority %d.\n",
+      param.sched_priority);
+#else
+   ALLEGRO_INFO("Real-time priority not supported on this platform.\n");
+#endif
+}
+
 static ALLEGRO_AUDIO_DRIVER_ENUM get_config_audio_driver(void)
 {
    ALLEGRO_CONFIG *config = al_get_system_config();
@@ -184,6 +234,9 @@ static ALLEGRO_AUDIO_DRIVER_ENUM get_config_audio_driver(void)
    if (0 == _al_stricmp(value, "OPENSL"))
       return ALLEGRO_AUDIO_DRIVER_OPENSL;
 
+   if (0 == _al_stricmp(value, "AAUDIO"))
+      return ALLEGRO_AUDIO_DRIVER_AAUDIO;
+
    if (0 == _al_stricmp(value, "OSS"))
       return ALLEGRO_AUDIO_DRIVER_OSS;
 
@@ -253,6 +306,12 @@ static bool do_install_audio(ALLEGRO_AUDIO_DRIVER_ENUM mode)
          if (retVal)
             return retVal;
 #endif
+/* AAudio has much lower latency where it is available. */
+#if defined(ALLEGRO_CFG_KCM_AAUDIO)
+         retVal = do_install_audio(ALLEGRO_AUDIO_DRIVER_AAUDIO);
+         if (retVal)
+            return retVal;
+#endif
 #if defined(ALLEGRO_CFG_KCM_OPENSL)
          retVal = do_install_audio(ALLEGRO_AUDIO_DRIVER_OPENSL);
          if (retVal)
@@ -302,6 +361,19 @@ static bool do_install_audio(ALLEGRO_AUDIO_DRIVER_ENUM mode)
             return false;
          #endif
 
+      case ALLEGRO_AUDIO_DRIVER_AAUDIO:
+         #if defined(ALLEGRO_CFG_KCM_AAUDIO)
+            if (_al_kcm_aaudio_driver.open() == 0) {
+               ALLEGRO_INFO("Using AAudio driver\n");
+               _al_kcm_driver = &_al_kcm_aaudio_driver;
+               return true;
+            }
+            return false;
+         #else
+            _al_set_error(ALLEGRO_INVALID_PARAM, "AAudio not available on this platform");
+            return false;
+         #endif
+
       case ALLEGRO_AUDIO_DRIVER_ALSA:
          #if defined(ALLEGRO_CFG_KCM_ALSA)
             if (_al_kcm_alsa_driver.open() == 0) {
@@ -378,6 +450,7 @@ static bool do_install_audio(ALLEGRO_AUDIO_DRIVER_ENUM mode)
 bool al_install_audio(void)
 {
    bool ret;
+   double t0;
 
    if (_al_kcm_driver)
       return true;
@@ -386,9 +459,14 @@ bool al_install_audio(void)
     * because the user may still create samples.
     */
    _al_kcm_init_destructors();
+   _al_kcm_init_stream_feeders();
+   _al_kcm_init_async_loading();
    _al_add_exit_func(al_uninstall_audio, "al_uninstall_audio");
 
+   t0 = al_get_time();
    ret = do_install_audio(ALLEGRO_AUDIO_DRIVER_AUTODETECT);
+   ALLEGRO_INFO("Probing audio drivers took %.2f ms.\n",
+      (al_get_time() - t0) * 1000.0);
    return ret;
 }
 
@@ -396,6 +474,8 @@ bool al_install_audio(void)
  */
 void al_uninstall_audio(void)
 {
+   _al_kcm_shutdown_async_loading();
+   _al_kcm_shutdown_stream_feeders();
    if (_al_kcm_driver) {
       _al_kcm_shutdown_default_mixer();
       _al_kcm_shutdown_destructors();
@@ -0,0 +1,320 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Asynchronous and parallel sample loading.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#define ALLEGRO_INTERNAL_UNSTABLE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_audio.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_audio.h"
+#include "allegro5/internal/aintern_vector.h"
+#include "allegro5/internal/aintern_workers.h"
+
+ALLEGRO_DEBUG_CHANNEL("audio")
+
+#define DEFAULT_LOAD_THREADS  2
+#define MAX_LOAD_THREADS      16
+
+
+/*
+ * Samples are loaded by jobs on a pool of our own, which is created on first
+ * use. Loads mostly wait for the disk, which must not hold up the default
+ * job pool Allegro's own operations run on. Every loader call sets up its
+ * own decoder, so any number of files can be decoded at once. A finished load is announced by an event from one of our event
+ * sources, one per queue; if nobody is listening any more the sample is
+ * destroyed again. A source is only handed to another queue once no job
+ * refers to it.
+ *
+ * al_uninstall_audio waits for the loads in progress, since they create
+ * samples and emit events.
+ */
+
+typedef struct LOAD_SOURCE
+{
+   ALLEGRO_EVENT_SOURCE es;
+   int num_jobs;
+} LOAD_SOURCE;
+
+typedef struct LOAD_JOB
+{
+   int id;
+   char *filename;
+   ALLEGRO_STATE state;
+   LOAD_SOURCE *source;
+} LOAD_JOB;
+
+typedef struct BATCH
+{
+   const char * const *filenames;
+   ALLEGRO_SAMPLE **samples;
+   ALLEGRO_STATE state;
+} BATCH;
+
+static ALLEGRO_MUTEX *async_mutex = NULL;
+static ALLEGRO_COND *async_cond = NULL;
+static ALLEGRO_JOB_POOL *load_pool = NULL;
+static int num_unfinished = 0;
+static int next_id = 1;
+
+static _AL_VECTOR load_sources = _AL_VECTOR_INITIALIZER(LOAD_SOURCE *);
+
+
+void _al_kcm_init_async_loading(void)
+{
+   if (async_mutex)
+      return;
+
+   async_mutex = al_create_mutex();
+   async_cond = al_create_cond();
+}
+
+
+void _al_kcm_shutdown_async_loading(void)
+{
+   unsigned i;
+
+   if (!async_mutex)
+      return;
+
+   al_lock_mutex(async_mutex);
+   while (num_unfinished > 0)
+      al_wait_cond(async_cond, async_mutex);
+   al_unlock_mutex(async_mutex);
+
+   al_destroy_job_pool(load_pool);
+   load_pool = NULL;
+
+   for (i = 0; i < _al_vector_size(&load_sources); i++) {
+      LOAD_SOURCE *source = *(LOAD_SOURCE **)_al_vector_ref(&load_sources, i);
+      al_destroy_user_event_source(&source->es);
+      al_free(source);
+   }
+   _al_vector_free(&load_sources);
+
+   al_destroy_cond(async_cond);
+   al_destroy_mutex(async_mutex);
+   async_cond = NULL;
+   async_mutex = NULL;
+}
+
+
+static int get_config_thread_count(void)
+{
+   const char *p;
+   int n = DEFAULT_LOAD_THREADS;
+
+   p = al_get_config_value(al_get_system_config(), "audio",
+      "async_load_threads");
+   if (p && p[0] != '\0') {
+      n = atoi(p);
+      if (n < 1)
+         n = 1;
+      if (n > MAX_LOAD_THREADS)
+         n = MAX_LOAD_THREADS;
+   }
+   return n;
+}
+
+
+/* Must be called with async_mutex held. */
+static ALLEGRO_JOB_POOL *get_load_pool(void)
+{
+   if (!load_pool) {
+      load_pool = al_create_job_pool(get_config_thread_count());
+      if (load_pool)
+         ALLEGRO_INFO("Started %d sample loading threads\n",
+            al_get_job_pool_size(load_pool));
+   }
+   return load_pool;
+}
+
+
+/* Must be called with async_mutex held. */
+static LOAD_SOURCE *get_source(ALLEGRO_EVENT_QUEUE *queue)
+{
+   LOAD_SOURCE **slot;
+   LOAD_SOURCE *unused = NULL;
+   unsigned i;
+
+   for (i = 0; i < _al_vector_size(&load_sources); i++) {
+      LOAD_SOURCE *source = *(LOAD_SOURCE **)_al_vector_ref(&load_sources, i);
+
+      if (al_is_event_source_registered(queue, &source->es))
+         return source;
+      if (!unused && source->num_jobs == 0)
+         unused = source;
+   }
+
+   if (unused) {
+      /* Detach it from whatever queue it was used with before. */
+      al_destroy_user_event_source(&unused->es);
+   }
+   else {
+      unused = al_calloc(1, sizeof *unused);
+      if (!unused)
+         return NULL;
+      slot = _al_vector_alloc_back(&load_sources);
+      if (!slot) {
+         al_free(unused);
+         return NULL;
+      }
+      *slot = unused;
+   }
+
+   al_init_user_event_source(&unused->es);
+   al_register_event_source(queue, &unused->es);
+   return unused;
+}
+
+
+/* [worker thread] */
+static void *load_job(void *arg)
+{
+   LOAD_JOB *job = arg;
+   ALLEGRO_SAMPLE *spl;
+   ALLEGRO_EVENT event;
+
+   al_restore_state(&job->state);
+   spl = al_load_sample(job->filename);
+
+   event.user.type = ALLEGRO_EVENT_AUDIO_SAMPLE_LOADED;
+   event.user.timestamp = al_get_time();
+   event.user.data1 = (intptr_t)spl;
+   event.user.data2 = job->id;
+
+   al_lock_mutex(async_mutex);
+   if (!al_emit_user_event(&job->source->es, &event, NULL) && spl) {
+      ALLEGRO_DEBUG("Nobody listening, dropped %s.\n", job->filename);
+      al_destroy_sample(spl);
+   }
+   job->source->num_jobs--;
+   num_unfinished--;
+   al_broadcast_cond(async_cond);
+   al_unlock_mutex(async_mutex);
+
+   al_free(job->filename);
+   al_free(job);
+
+   return NULL;
+}
+
+
+/* Function: al_load_sample_async
+ */
+int al_load_sample_async(const char *filename, ALLEGRO_EVENT_QUEUE *queue)
+{
+   ALLEGRO_JOB_POOL *pool;
+   ALLEGRO_JOB *handle;
+   LOAD_JOB *job;
+   int id;
+
+   ASSERT(filename);
+   ASSERT(queue);
+
+   if (!async_mutex)
+      return 0;
+
+   job = al_calloc(1, sizeof *job);
+   if (!job)
+      return 0;
+   job->filename = al_malloc(strlen(filename) + 1);
+   if (!job->filename) {
+      al_free(job);
+      return 0;
+   }
+   strcpy(job->filename, filename);
+   al_store_state(&job->state, ALLEGRO_STATE_NEW_FILE_INTERFACE);
+
+   al_lock_mutex(async_mutex);
+   pool = get_load_pool();
+   job->source = pool ? get_source(queue) : NULL;
+   if (!job->source) {
+      al_unlock_mutex(async_mutex);
+      ALLEGRO_ERROR("Could not queue %s for loading.\n", filename);
+      al_free(job->filename);
+      al_free(job);
+      return 0;
+   }
+   id = job->id = next_id;
+   if (++next_id <= 0)
+      next_id = 1;
+   job->source->num_jobs++;
+   num_unfinished++;
+
+   /* Submitted with the lock held so that a quick job cannot touch the
+    * counters before they are set up.
+    */
+   handle = al_submit_job(pool, load_job, job);
+   if (!handle) {
+      job->source->num_jobs--;
+      num_unfinished--;
+      al_unlock_mutex(async_mutex);
+      ALLEGRO_ERROR("Could not queue %s for loading.\n", filename);
+      al_free(job->filename);
+      al_free(job);
+      return 0;
+   }
+   al_unlock_mutex(async_mutex);
+
+   /* The job may be done and freed already. */
+   al_release_job(handle);
+
+   return id;
+}
+
+
+/* [worker thread] */
+static void load_batch_sample(int index, void *arg)
+{
+   BATCH *batch = arg;
+
+   al_restore_state(&batch->state);
+   batch->samples[index] = al_load_sample(batch->filenames[index]);
+}
+
+
+/* Function: al_load_samples_batch
+ */
+int al_load_samples_batch(const char * const *filenames, int count,
+   ALLEGRO_SAMPLE **samples)
+{
+   BATCH batch;
+   int loaded = 0;
+   int i;
+
+   ASSERT(filenames);
+   ASSERT(samples);
+
+   batch.filenames = filenames;
+   batch.samples = samples;
+   al_store_state(&batch.state, ALLEGRO_STATE_NEW_FILE_INTERFACE);
+
+   _al_run_parallel(count, load_batch_sample, &batch);
+
+   /* The calling thread did its share of the work, too. */
+   al_restore_state(&batch.state);
+
+   for (i = 0; i < count; i++) {
+      if (samples[i])
+         loaded++;
+   }
+
+   return loaded;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -359,6 +359,11 @@ bool al_save_sample(const char *filename, ALLEGRO_SAMPLE *spl)
       return false;
    }
 
+   if (spl->block_align) {
+      ALLEGRO_ERROR("Compressed samples cannot be saved.\n");
+      return false;
+   }
+
    ent = find_acodec_table_entry(ext);
    if (ent && ent->saver) {
       return (ent->saver)(filename, spl);
@@ -380,6 +385,11 @@ bool al_save_sample_f(ALLEGRO_FILE *fp, const char *ident, ALLEGRO_SAMPLE *spl)
 
    ASSERT(fp);
    ASSERT(ident);
+
+   if (spl->block_align) {
+      ALLEGRO_ERROR("Compressed samples cannot be saved.\n");
+      return false;
+   }
    
    ent = find_acodec_table_entry(ident);
    if (ent && ent->fs_saver) {
@@ -828,7 +828,9 @@ ALLEGRO_AUDIO_DRIVER _al_kcm_dsound_driver = {
    _dsound_set_voice_position,
 
    _dsound_open_recorder,
-   _dsound_close_recorder
+   _dsound_close_recorder,
+
+   NULL
 };
 
 } /* End extern "C" */
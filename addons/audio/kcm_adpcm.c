@@ -0,0 +1,362 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Samples kept IMA-ADPCM compressed in memory.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_audio.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_audio.h"
+
+ALLEGRO_DEBUG_CHANNEL("audio")
+
+
+/* The blocks have the layout used by WAV files (format tag 0x11).  Each
+ * block starts with a 4 byte header per channel: the first frame as a
+ * little endian 16-bit value, the step index and a padding byte.  The
+ * remaining frames follow in groups of 8, with 4 bytes of nibbles per
+ * channel, low nibble first.
+ *
+ * Sample instances decode whole blocks into an _AL_ADPCM_CACHE of their
+ * own when the mixer reads them, see adpcm_frame in kcm_mixer.c.
+ */
+
+/* Bytes per channel in a block made by al_create_adpcm_sample. */
+#define ENCODE_BLOCK_ALIGN 512
+
+typedef struct ADPCM_STATE {
+   int pred;
+   int index;
+} ADPCM_STATE;
+
+static const int step_table[89] = {
+   7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37,
+   41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173,
+   190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+   724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+   2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+   7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818,
+   18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int index_table[16] = {
+   -1, -1, -1, -1, 2, 4, 6, 8,
+   -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+
+static int decode_nibble(ADPCM_STATE *st, int nibble)
+{
+   int step = step_table[st->index];
+   int diff = step >> 3;
+
+   if (nibble & 4)
+      diff += step;
+   if (nibble & 2)
+      diff += step >> 1;
+   if (nibble & 1)
+      diff += step >> 2;
+
+   st->pred += (nibble & 8) ? -diff : diff;
+   if (st->pred > 32767)
+      st->pred = 32767;
+   else if (st->pred < -32768)
+      st->pred = -32768;
+
+   st->index += index_table[nibble];
+   if (st->index < 0)
+      st->index = 0;
+   else if (st->index > 88)
+      st->index = 88;
+
+   return st->pred;
+}
+
+
+static int encode_nibble(ADPCM_STATE *st, int value)
+{
+   int step = step_table[st->index];
+   int diff = value - st->pred;
+   int nibble = 0;
+
+   if (diff < 0) {
+      nibble = 8;
+      diff = -diff;
+   }
+   if (diff >= step) {
+      nibble |= 4;
+      diff -= step;
+   }
+   step >>= 1;
+   if (diff >= step) {
+      nibble |= 2;
+      diff -= step;
+   }
+   step >>= 1;
+   if (diff >= step)
+      nibble |= 1;
+
+   /* Keep the state exactly as the decoder will see it. */
+   decode_nibble(st, nibble);
+   return nibble;
+}
+
+
+/* _al_kcm_adpcm_block_frames:
+ *  Returns the number of frames in a block of the given size, or 0 if
+ *  that is not a valid block size.
+ */
+int _al_kcm_adpcm_block_frames(int block_align, int channels)
+{
+   int data = block_align - 4 * channels;
+
+   if (channels <= 0 || data < 0 || data % (4 * channels) != 0)
+      return 0;
+   return 1 + data / (4 * channels) * 8;
+}
+
+
+/* _al_kcm_decode_adpcm_block:
+ *  Decodes the given block of a compressed sample into out, which must
+ *  have room for block_frames frames.
+ */
+void _al_kcm_decode_adpcm_block(const ALLEGRO_SAMPLE *spl, int block,
+   int16_t *out)
+{
+   const int channels = al_get_channel_count(spl->chan_conf);
+   const uint8_t *in = spl->buffer.u8 + (size_t)block * spl->block_align;
+   ADPCM_STATE st[ALLEGRO_MAX_CHANNELS];
+   int frames = spl->len - block * spl->block_frames;
+   int c, f, k;
+
+   if (frames > spl->block_frames)
+      frames = spl->block_frames;
+
+   for (c = 0; c < channels; c++) {
+      st[c].pred = (int16_t)(in[0] | (in[1] << 8));
+      st[c].index = in[2] > 88 ? 88 : in[2];
+      out[c] = st[c].pred;
+      in += 4;
+   }
+
+   for (f = 1; f < frames; f += 8) {
+      for (c = 0; c < channels; c++) {
+         for (k = 0; k < 8 && f + k < frames; k++) {
+            int nibble = (in[k >> 1] >> ((k & 1) * 4)) & 15;
+            out[(f + k) * channels + c] = decode_nibble(&st[c], nibble);
+         }
+         in += 4;
+      }
+   }
+}
+
+
+/* _al_kcm_create_adpcm_cache:
+ *  Creates the cache of decoded blocks a sample instance needs to play a
+ *  compressed sample.
+ */
+_AL_ADPCM_CACHE *_al_kcm_create_adpcm_cache(const ALLEGRO_SAMPLE *spl)
+{
+   size_t block_size = (size_t)spl->block_frames *
+      al_get_channel_count(spl->chan_conf);
+   _AL_ADPCM_CACHE *cache;
+   int i;
+
+   cache = al_malloc(sizeof *cache +
+      _AL_ADPCM_CACHE_BLOCKS * block_size * sizeof(int16_t));
+   if (!cache)
+      return NULL;
+
+   for (i = 0; i < _AL_ADPCM_CACHE_BLOCKS; i++) {
+      cache->block[i] = -1;
+      cache->frames[i] = (int16_t *)(cache + 1) + i * block_size;
+   }
+   cache->next = 0;
+   return cache;
+}
+
+
+/* _al_kcm_invalidate_adpcm_cache:
+ *  Forgets the blocks in the cache, for when the sample changes.
+ */
+void _al_kcm_invalidate_adpcm_cache(_AL_ADPCM_CACHE *cache)
+{
+   int i;
+
+   for (i = 0; i < _AL_ADPCM_CACHE_BLOCKS; i++)
+      cache->block[i] = -1;
+}
+
+
+/* _al_kcm_fill_adpcm_cache:
+ *  Decodes a block into the cache slot used least recently, and returns
+ *  its frames.
+ */
+const int16_t *_al_kcm_fill_adpcm_cache(_AL_ADPCM_CACHE *cache,
+   const ALLEGRO_SAMPLE *spl, int block)
+{
+   int slot = cache->next;
+
+   _al_kcm_decode_adpcm_block(spl, block, cache->frames[slot]);
+   cache->block[slot] = block;
+   cache->next = (slot + 1) % _AL_ADPCM_CACHE_BLOCKS;
+   return cache->frames[slot];
+}
+
+
+/* _al_kcm_create_adpcm_sample:
+ *  Creates a sample from IMA-ADPCM blocks of block_align bytes each.  The
+ *  last block may be shorter.
+ */
+ALLEGRO_SAMPLE *_al_kcm_create_adpcm_sample(void *buf, unsigned int samples,
+   unsigned int freq, ALLEGRO_CHANNEL_CONF chan_conf, int block_align,
+   bool free_buf)
+{
+   int block_frames = _al_kcm_adpcm_block_frames(block_align,
+      al_get_channel_count(chan_conf));
+   ALLEGRO_SAMPLE *spl;
+
+   if (block_frames == 0) {
+      _al_set_error(ALLEGRO_INVALID_PARAM, "Invalid ADPCM block size");
+      return NULL;
+   }
+
+   spl = al_create_sample(buf, samples, freq, ALLEGRO_AUDIO_DEPTH_INT16,
+      chan_conf, free_buf);
+   if (spl) {
+      spl->block_align = block_align;
+      spl->block_frames = block_frames;
+   }
+   return spl;
+}
+
+
+/* Returns value i of the sample data as a 16-bit value. */
+static int get_value(const ALLEGRO_SAMPLE *spl, size_t i)
+{
+   float f;
+
+   switch (spl->depth) {
+      case ALLEGRO_AUDIO_DEPTH_INT8:
+         return spl->buffer.s8[i] << 8;
+      case ALLEGRO_AUDIO_DEPTH_UINT8:
+         return (spl->buffer.u8[i] - 0x80) << 8;
+      case ALLEGRO_AUDIO_DEPTH_INT16:
+         return spl->buffer.s16[i];
+      case ALLEGRO_AUDIO_DEPTH_UINT16:
+         return spl->buffer.u16[i] - 0x8000;
+      case ALLEGRO_AUDIO_DEPTH_INT24:
+         return spl->buffer.s24[i] >> 8;
+      case ALLEGRO_AUDIO_DEPTH_UINT24:
+         return ((int32_t)spl->buffer.u24[i] - 0x800000) >> 8;
+      case ALLEGRO_AUDIO_DEPTH_FLOAT32:
+         f = spl->buffer.f32[i] * 32767.0f;
+         if (f > 32767.0f)
+            return 32767;
+         if (f < -32768.0f)
+            return -32768;
+         return (int)f;
+   }
+   ASSERT(false);
+   return 0;
+}
+
+
+/* Function: al_create_adpcm_sample
+ */
+ALLEGRO_SAMPLE *al_create_adpcm_sample(const ALLEGRO_SAMPLE *spl)
+{
+   const int channels = al_get_channel_count(spl->chan_conf);
+   const int block_align = ENCODE_BLOCK_ALIGN * channels;
+   const int block_frames = _al_kcm_adpcm_block_frames(block_align, channels);
+   ADPCM_STATE st[ALLEGRO_MAX_CHANNELS];
+   ALLEGRO_SAMPLE *adpcm;
+   int blocks, block, c, f, k;
+   uint8_t *data, *out;
+
+   ASSERT(spl);
+
+   if (spl->block_align) {
+      _al_set_error(ALLEGRO_INVALID_PARAM, "Sample is already compressed");
+      return NULL;
+   }
+   if (spl->len <= 0) {
+      _al_set_error(ALLEGRO_INVALID_PARAM, "Sample is empty");
+      return NULL;
+   }
+
+   blocks = (spl->len + block_frames - 1) / block_frames;
+   data = al_calloc(blocks, block_align);
+   if (!data) {
+      _al_set_error(ALLEGRO_GENERIC_ERROR,
+         "Out of memory allocating ADPCM data");
+      return NULL;
+   }
+
+   for (c = 0; c < channels; c++)
+      st[c].index = 0;
+
+   out = data;
+   for (block = 0; block < blocks; block++) {
+      const int first = block * block_frames;
+      int frames = spl->len - first;
+
+      if (frames > block_frames)
+         frames = block_frames;
+
+      /* The step index carries over from the previous block. */
+      for (c = 0; c < channels; c++) {
+         st[c].pred = get_value(spl, (size_t)first * channels + c);
+         out[0] = st[c].pred & 0xff;
+         out[1] = (st[c].pred >> 8) & 0xff;
+         out[2] = st[c].index;
+         out[3] = 0;
+         out += 4;
+      }
+
+      for (f = 1; f < block_frames; f += 8) {
+         for (c = 0; c < channels; c++) {
+            for (k = 0; k < 8; k++) {
+               /* Pad the last block with its last frame. */
+               int i = f + k < frames ? f + k : frames - 1;
+               int v = get_value(spl, (size_t)(first + i) * channels + c);
+               out[k >> 1] |= encode_nibble(&st[c], v) << ((k & 1) * 4);
+            }
+            out += 4;
+         }
+      }
+   }
+
+   adpcm = _al_kcm_create_adpcm_sample(data, spl->len, spl->frequency,
+      spl->chan_conf, block_align, true);
+   if (!adpcm) {
+      al_free(data);
+      return NULL;
+   }
+
+   ALLEGRO_DEBUG("Compressed %d frames into %d bytes.\n", spl->len,
+      blocks * block_align);
+   return adpcm;
+}
+
+
+/* Function: al_is_sample_compressed
+ */
+bool al_is_sample_compressed(const ALLEGRO_SAMPLE *spl)
+{
+   ASSERT(spl);
+
+   return spl->block_align != 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -53,7 +53,7 @@ void _al_kcm_shutdown_destructors(void)
 /* _al_kcm_register_destructor:
  *  Register an object to be destroyed.
  */
-_AL_LIST_ITEM *_al_kcm_register_destructor(char const *name, void *object,
+_AL_DTOR_ITEM *_al_kcm_register_destructor(char const *name, void *object,
    void (*func)(void*))
 {
    return _al_register_destructor(kcm_dtors, name, object, func);
@@ -63,7 +63,7 @@ _AL_LIST_ITEM *_al_kcm_register_destructor(char const *name, void *object,
 /* _al_kcm_unregister_destructor:
  *  Unregister an object to be destroyed.
  */
-void _al_kcm_unregister_destructor(_AL_LIST_ITEM *dtor_item)
+void _al_kcm_unregister_destructor(_AL_DTOR_ITEM *dtor_item)
 {
    _al_unregister_destructor(kcm_dtors, dtor_item);
 }
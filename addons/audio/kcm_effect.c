@@ -0,0 +1,777 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Effects run over the buffers of mixers.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#define ALLEGRO_INTERNAL_UNSTABLE
+
+#include <math.h>
+#include <string.h>
+
+#include "allegro5/allegro_audio.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_audio.h"
+
+ALLEGRO_DEBUG_CHANNEL("audio")
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+   #if defined(_MSC_VER) || defined(__clang__) || \
+      (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+      #define SIMD_X86
+   #endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+   #define SIMD_NEON
+#endif
+
+#if defined(SIMD_X86)
+   #include <emmintrin.h>
+   #if defined(__GNUC__) || defined(__clang__)
+      #define TARGET(x) __attribute__((target(x)))
+   #else
+      #define TARGET(x)
+   #endif
+#elif defined(SIMD_NEON)
+   #include <arm_neon.h>
+#endif
+
+/*
+ * Effects are attached to a single float mixer, which runs them on its own
+ * buffer once the inputs are mixed, in the order they were attached. Those
+ * attached before the gain run before the post-processing callback.
+ *
+ * The parameters are only changed while holding the mixer's mutex, and the
+ * values derived from them (filter coefficients and such) are worked out
+ * again by the mixer the next time it runs the effect.
+ *
+ * The filters are biquads in transposed direct form II, with the
+ * coefficients from Robert Bristow-Johnson's Audio EQ Cookbook. The
+ * channels are independent, so up to four of them are filtered at once.
+ *
+ * The reverb is a feedback delay network of four damped delay lines mixed
+ * by a Hadamard matrix, fed with the average of the channels.
+ */
+
+#define REVERB_LINES 4
+
+static const float reverb_line_ms[REVERB_LINES] = {
+   29.7f, 37.1f, 41.1f, 43.7f
+};
+
+struct ALLEGRO_AUDIO_EFFECT
+{
+   ALLEGRO_AUDIO_EFFECT_TYPE type;
+   float params[ALLEGRO_AUDIO_EFFECT_NUM_PARAMS];
+
+   ALLEGRO_MIXER *mixer;
+   bool after_gain;
+   bool dirty;
+   unsigned int frequency;
+                  /* The mixer frequency the derived values are for. */
+
+   /* Filters */
+   float b0, b1, b2, a1, a2;
+   float z1[ALLEGRO_MAX_CHANNELS];
+   float z2[ALLEGRO_MAX_CHANNELS];
+
+   /* Compressor */
+   float envelope;
+   float attack_coef;
+   float release_coef;
+   float threshold;
+   float exponent;
+   float makeup;
+
+   /* Reverb */
+   float *lines;
+   int line_size;
+   int line_len[REVERB_LINES];
+   int line_pos[REVERB_LINES];
+   float lowpass[REVERB_LINES];
+   float feedback;
+   float damping;
+
+   _AL_DTOR_ITEM *dtor_item;
+};
+
+
+static void maybe_lock_mutex(ALLEGRO_MUTEX *mutex)
+{
+   if (mutex) {
+      al_lock_mutex(mutex);
+   }
+}
+
+
+static void maybe_unlock_mutex(ALLEGRO_MUTEX *mutex)
+{
+   if (mutex) {
+      al_unlock_mutex(mutex);
+   }
+}
+
+
+static float db_to_gain(float db)
+{
+   return powf(10.0f, db / 20.0f);
+}
+
+
+static void update_filter(ALLEGRO_AUDIO_EFFECT *e)
+{
+   const float *p = e->params;
+   double freq = p[ALLEGRO_AUDIO_EFFECT_PARAM_FREQUENCY];
+   double w0, cw, alpha, A, sqA, a0;
+   double b0, b1, b2, a1, a2;
+
+   /* Keep the corner below the Nyquist frequency. */
+   if (freq > e->frequency * 0.49)
+      freq = e->frequency * 0.49;
+
+   w0 = 2 * ALLEGRO_PI * freq / e->frequency;
+   cw = cos(w0);
+   alpha = sin(w0) / (2 * p[ALLEGRO_AUDIO_EFFECT_PARAM_Q]);
+   A = pow(10.0, p[ALLEGRO_AUDIO_EFFECT_PARAM_GAIN] / 40.0);
+   sqA = sqrt(A);
+
+   switch (e->type) {
+      case ALLEGRO_AUDIO_EFFECT_LOWPASS:
+         b0 = (1 - cw) / 2;
+         b1 = 1 - cw;
+         b2 = (1 - cw) / 2;
+         a0 = 1 + alpha;
+         a1 = -2 * cw;
+         a2 = 1 - alpha;
+         break;
+
+      case ALLEGRO_AUDIO_EFFECT_HIGHPASS:
+         b0 = (1 + cw) / 2;
+         b1 = -(1 + cw);
+         b2 = (1 + cw) / 2;
+         a0 = 1 + alpha;
+         a1 = -2 * cw;
+         a2 = 1 - alpha;
+         break;
+
+      case ALLEGRO_AUDIO_EFFECT_PEAKING_EQ:
+         b0 = 1 + alpha * A;
+         b1 = -2 * cw;
+         b2 = 1 - alpha * A;
+         a0 = 1 + alpha / A;
+         a1 = -2 * cw;
+         a2 = 1 - alpha / A;
+         break;
+
+      case ALLEGRO_AUDIO_EFFECT_LOW_SHELF:
+         b0 = A * ((A + 1) - (A - 1) * cw + 2 * sqA * alpha);
+         b1 = 2 * A * ((A - 1) - (A + 1) * cw);
+         b2 = A * ((A + 1) - (A - 1) * cw - 2 * sqA * alpha);
+         a0 = (A + 1) + (A - 1) * cw + 2 * sqA * alpha;
+         a1 = -2 * ((A - 1) + (A + 1) * cw);
+         a2 = (A + 1) + (A - 1) * cw - 2 * sqA * alpha;
+         break;
+
+      case ALLEGRO_AUDIO_EFFECT_HIGH_SHELF:
+      default:
+         b0 = A * ((A + 1) + (A - 1) * cw + 2 * sqA * alpha);
+         b1 = -2 * A * ((A - 1) + (A + 1) * cw);
+         b2 = A * ((A + 1) + (A - 1) * cw - 2 * sqA * alpha);
+         a0 = (A + 1) - (A - 1) * cw + 2 * sqA * alpha;
+         a1 = 2 * ((A - 1) - (A + 1) * cw);
+         a2 = (A + 1) - (A - 1) * cw - 2 * sqA * alpha;
+         break;
+   }
+
+   e->b0 = b0 / a0;
+   e->b1 = b1 / a0;
+   e->b2 = b2 / a0;
+   e->a1 = a1 / a0;
+   e->a2 = a2 / a0;
+}
+
+
+/* Returns the coefficient of a one pole smoother reaching about 63% of a
+ * step after the given time.
+ */
+static float smoothing_coef(float seconds, unsigned int frequency)
+{
+   if (seconds <= 0.0f)
+      return 0.0f;
+   return expf(-1.0f / (seconds * frequency));
+}
+
+
+static void update_compressor(ALLEGRO_AUDIO_EFFECT *e)
+{
+   const float *p = e->params;
+
+   e->attack_coef = smoothing_coef(p[ALLEGRO_AUDIO_EFFECT_PARAM_ATTACK],
+      e->frequency);
+   e->release_coef = smoothing_coef(p[ALLEGRO_AUDIO_EFFECT_PARAM_RELEASE],
+      e->frequency);
+   e->threshold = db_to_gain(p[ALLEGRO_AUDIO_EFFECT_PARAM_THRESHOLD]);
+   e->exponent = 1.0f / p[ALLEGRO_AUDIO_EFFECT_PARAM_RATIO] - 1.0f;
+   e->makeup = db_to_gain(p[ALLEGRO_AUDIO_EFFECT_PARAM_GAIN]);
+}
+
+
+static bool update_reverb(ALLEGRO_AUDIO_EFFECT *e)
+{
+   const float *p = e->params;
+   int size = ceil(reverb_line_ms[REVERB_LINES - 1] * e->frequency / 1000.0);
+   int i;
+
+   if (size > e->line_size) {
+      float *lines = al_calloc(REVERB_LINES * size, sizeof(float));
+      if (!lines)
+         return false;
+      al_free(e->lines);
+      e->lines = lines;
+      e->line_size = size;
+      memset(e->line_pos, 0, sizeof e->line_pos);
+      memset(e->lowpass, 0, sizeof e->lowpass);
+   }
+
+   for (i = 0; i < REVERB_LINES; i++) {
+      e->line_len[i] = reverb_line_ms[i] * e->frequency / 1000.0f;
+      if (e->line_len[i] < 1)
+         e->line_len[i] = 1;
+      if (e->line_pos[i] >= e->line_len[i])
+         e->line_pos[i] = 0;
+   }
+
+   /* The decay time grows quickly as the feedback approaches 1. */
+   e->feedback = 0.7f + 0.28f * p[ALLEGRO_AUDIO_EFFECT_PARAM_ROOM_SIZE];
+   e->damping = p[ALLEGRO_AUDIO_EFFECT_PARAM_DAMPING] * 0.9f;
+   return true;
+}
+
+
+/* Works out the values derived from the parameters for the current mixer
+ * frequency. Returns false if the effect can not be run.
+ */
+static bool update_effect(ALLEGRO_AUDIO_EFFECT *e, unsigned int frequency)
+{
+   e->frequency = frequency;
+   e->dirty = false;
+
+   switch (e->type) {
+      case ALLEGRO_AUDIO_EFFECT_COMPRESSOR:
+         update_compressor(e);
+         return true;
+
+      case ALLEGRO_AUDIO_EFFECT_REVERB:
+         if (!update_reverb(e)) {
+            ALLEGRO_ERROR("Out of memory for the reverb delay lines.\n");
+            return false;
+         }
+         return true;
+
+      default:
+         update_filter(e);
+         return true;
+   }
+}
+
+
+static void run_biquad_generic(ALLEGRO_AUDIO_EFFECT *e, float *buf,
+   unsigned int n, int maxc, int c)
+{
+   const float b0 = e->b0, b1 = e->b1, b2 = e->b2, a1 = e->a1, a2 = e->a2;
+
+   for (; c < maxc; c++) {
+      float z1 = e->z1[c];
+      float z2 = e->z2[c];
+      float *p = buf + c;
+      unsigned int i;
+
+      for (i = 0; i < n; i++, p += maxc) {
+         float x = *p;
+         float y = b0 * x + z1;
+         z1 = b1 * x - a1 * y + z2;
+         z2 = b2 * x - a2 * y;
+         *p = y;
+      }
+
+      e->z1[c] = z1;
+      e->z2[c] = z2;
+   }
+}
+
+
+#if defined(SIMD_X86)
+
+/* Filters four channels at once, then two. Returns the number of channels
+ * done.
+ */
+TARGET("sse2")
+static int run_biquad_sse2(ALLEGRO_AUDIO_EFFECT *e, float *buf,
+   unsigned int n, int maxc)
+{
+   const __m128 b0 = _mm_set1_ps(e->b0);
+   const __m128 b1 = _mm_set1_ps(e->b1);
+   const __m128 b2 = _mm_set1_ps(e->b2);
+   const __m128 a1 = _mm_set1_ps(e->a1);
+   const __m128 a2 = _mm_set1_ps(e->a2);
+   int c = 0;
+
+   for (; c + 4 <= maxc; c += 4) {
+      __m128 z1 = _mm_loadu_ps(e->z1 + c);
+      __m128 z2 = _mm_loadu_ps(e->z2 + c);
+      float *p = buf + c;
+      unsigned int i;
+
+      for (i = 0; i < n; i++, p += maxc) {
+         __m128 x = _mm_loadu_ps(p);
+         __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), z1);
+         z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z2);
+         z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+         _mm_storeu_ps(p, y);
+      }
+
+      _mm_storeu_ps(e->z1 + c, z1);
+      _mm_storeu_ps(e->z2 + c, z2);
+   }
+
+   if (c + 2 <= maxc) {
+      __m128 z1 = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)(e->z1 + c));
+      __m128 z2 = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)(e->z2 + c));
+      float *p = buf + c;
+      unsigned int i;
+
+      for (i = 0; i < n; i++, p += maxc) {
+         __m128 x = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)p);
+         __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), z1);
+         z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z2);
+         z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+         _mm_storel_pi((__m64 *)p, y);
+      }
+
+      _mm_storel_pi((__m64 *)(e->z1 + c), z1);
+      _mm_storel_pi((__m64 *)(e->z2 + c), z2);
+      c += 2;
+   }
+
+   return c;
+}
+
+#elif defined(SIMD_NEON)
+
+static int run_biquad_neon(ALLEGRO_AUDIO_EFFECT *e, float *buf,
+   unsigned int n, int maxc)
+{
+   int c = 0;
+
+   for (; c + 4 <= maxc; c += 4) {
+      float32x4_t z1 = vld1q_f32(e->z1 + c);
+      float32x4_t z2 = vld1q_f32(e->z2 + c);
+      float *p = buf + c;
+      unsigned int i;
+
+      for (i = 0; i < n; i++, p += maxc) {
+         float32x4_t x = vld1q_f32(p);
+         float32x4_t y = vaddq_f32(vmulq_n_f32(x, e->b0), z1);
+         z1 = vaddq_f32(vsubq_f32(vmulq_n_f32(x, e->b1),
+            vmulq_n_f32(y, e->a1)), z2);
+         z2 = vsubq_f32(vmulq_n_f32(x, e->b2), vmulq_n_f32(y, e->a2));
+         vst1q_f32(p, y);
+      }
+
+      vst1q_f32(e->z1 + c, z1);
+      vst1q_f32(e->z2 + c, z2);
+   }
+
+   if (c + 2 <= maxc) {
+      float32x2_t z1 = vld1_f32(e->z1 + c);
+      float32x2_t z2 = vld1_f32(e->z2 + c);
+      float *p = buf + c;
+      unsigned int i;
+
+      for (i = 0; i < n; i++, p += maxc) {
+         float32x2_t x = vld1_f32(p);
+         float32x2_t y = vadd_f32(vmul_n_f32(x, e->b0), z1);
+         z1 = vadd_f32(vsub_f32(vmul_n_f32(x, e->b1),
+            vmul_n_f32(y, e->a1)), z2);
+         z2 = vsub_f32(vmul_n_f32(x, e->b2), vmul_n_f32(y, e->a2));
+         vst1_f32(p, y);
+      }
+
+      vst1_f32(e->z1 + c, z1);
+      vst1_f32(e->z2 + c, z2);
+      c += 2;
+   }
+
+   return c;
+}
+
+#endif
+
+
+static void run_biquad(ALLEGRO_AUDIO_EFFECT *e, float *buf, unsigned int n,
+   int maxc)
+{
+   int c = 0;
+   int i;
+
+#if defined(SIMD_X86)
+   if (maxc >= 2 && (al_get_cpu_features() & ALLEGRO_CPU_SSE2))
+      c = run_biquad_sse2(e, buf, n, maxc);
+#elif defined(SIMD_NEON)
+   if (maxc >= 2 && (al_get_cpu_features() & ALLEGRO_CPU_NEON))
+      c = run_biquad_neon(e, buf, n, maxc);
+#endif
+
+   if (c < maxc)
+      run_biquad_generic(e, buf, n, maxc, c);
+
+   /* Don't let the state decay into denormals, which are slow. */
+   for (i = 0; i < maxc; i++) {
+      if (fabsf(e->z1[i]) < 1e-15f)
+         e->z1[i] = 0.0f;
+      if (fabsf(e->z2[i]) < 1e-15f)
+         e->z2[i] = 0.0f;
+   }
+}
+
+
+/* A feed-forward compressor following the loudest channel, so that the
+ * stereo image does not move.
+ */
+static void run_compressor(ALLEGRO_AUDIO_EFFECT *e, float *buf,
+   unsigned int n, int maxc)
+{
+   float env = e->envelope;
+   unsigned int i;
+   int c;
+
+   for (i = 0; i < n; i++, buf += maxc) {
+      float peak = 0.0f;
+      float gain = e->makeup;
+
+      for (c = 0; c < maxc; c++) {
+         float x = fabsf(buf[c]);
+         if (x > peak)
+            peak = x;
+      }
+
+      if (peak > env)
+         env = e->attack_coef * env + (1.0f - e->attack_coef) * peak;
+      else
+         env = e->release_coef * env + (1.0f - e->release_coef) * peak;
+
+      if (env > e->threshold)
+         gain *= powf(env / e->threshold, e->exponent);
+
+      if (gain != 1.0f) {
+         for (c = 0; c < maxc; c++)
+            buf[c] *= gain;
+      }
+   }
+
+   e->envelope = (env < 1e-15f) ? 0.0f : env;
+}
+
+
+static void run_reverb(ALLEGRO_AUDIO_EFFECT *e, float *buf, unsigned int n,
+   int maxc)
+{
+   const float wet = e->params[ALLEGRO_AUDIO_EFFECT_PARAM_WET];
+   const float dry = e->params[ALLEGRO_AUDIO_EFFECT_PARAM_DRY];
+   const float in_scale = 1.0f / maxc;
+   const float g = e->feedback * 0.5f;  /* 0.5 normalises the Hadamard matrix */
+   const float d = e->damping;
+   unsigned int i;
+   int c, k;
+
+   for (i = 0; i < n; i++, buf += maxc) {
+      float in = 0.0f;
+      float out[REVERB_LINES];
+      float *line[REVERB_LINES];
+
+      for (c = 0; c < maxc; c++)
+         in += buf[c];
+      in *= in_scale;
+
+      for (k = 0; k < REVERB_LINES; k++) {
+         line[k] = e->lines + k * e->line_size + e->line_pos[k];
+         e->lowpass[k] = *line[k] * (1.0f - d) + e->lowpass[k] * d;
+         out[k] = *line[k];
+      }
+
+      {
+         const float *l = e->lowpass;
+         *line[0] = in + g * (l[0] + l[1] + l[2] + l[3]);
+         *line[1] = in + g * (l[0] - l[1] + l[2] - l[3]);
+         *line[2] = in + g * (l[0] + l[1] - l[2] - l[3]);
+         *line[3] = in + g * (l[0] - l[1] - l[2] + l[3]);
+      }
+
+      for (k = 0; k < REVERB_LINES; k++) {
+         if (++e->line_pos[k] == e->line_len[k])
+            e->line_pos[k] = 0;
+      }
+
+      for (c = 0; c < maxc; c++)
+         buf[c] = dry * buf[c] + wet * out[c % REVERB_LINES];
+   }
+}
+
+
+/* _al_kcm_run_mixer_effects:
+ *  Runs the effects attached to the mixer before or after its gain over
+ *  the mixer's buffer. Called with the mixer's mutex held.
+ */
+void _al_kcm_run_mixer_effects(ALLEGRO_MIXER *mixer, unsigned int samples,
+   bool after_gain)
+{
+   float *buf = mixer->ss.spl_data.buffer.f32;
+   int maxc = al_get_channel_count(mixer->ss.spl_data.chan_conf);
+   unsigned int i;
+
+   ASSERT(mixer->ss.spl_data.depth == ALLEGRO_AUDIO_DEPTH_FLOAT32);
+
+   for (i = 0; i < _al_vector_size(&mixer->effects); i++) {
+      ALLEGRO_AUDIO_EFFECT **slot = _al_vector_ref(&mixer->effects, i);
+      ALLEGRO_AUDIO_EFFECT *e = *slot;
+
+      if (e->after_gain != after_gain)
+         continue;
+
+      if (e->dirty || e->frequency != mixer->ss.spl_data.frequency) {
+         if (!update_effect(e, mixer->ss.spl_data.frequency))
+            continue;
+      }
+
+      switch (e->type) {
+         case ALLEGRO_AUDIO_EFFECT_COMPRESSOR:
+            run_compressor(e, buf, samples, maxc);
+            break;
+
+         case ALLEGRO_AUDIO_EFFECT_REVERB:
+            run_reverb(e, buf, samples, maxc);
+            break;
+
+         default:
+            run_biquad(e, buf, samples, maxc);
+            break;
+      }
+   }
+}
+
+
+/* _al_kcm_detach_mixer_effects:
+ *  Detaches all effects from a mixer which is being destroyed.
+ */
+void _al_kcm_detach_mixer_effects(ALLEGRO_MIXER *mixer)
+{
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&mixer->effects); i++) {
+      ALLEGRO_AUDIO_EFFECT **slot = _al_vector_ref(&mixer->effects, i);
+      (*slot)->mixer = NULL;
+   }
+   _al_vector_free(&mixer->effects);
+}
+
+
+/* Function: al_create_audio_effect
+ */
+ALLEGRO_AUDIO_EFFECT *al_create_audio_effect(ALLEGRO_AUDIO_EFFECT_TYPE type)
+{
+   ALLEGRO_AUDIO_EFFECT *e;
+   float *p;
+
+   if (type < ALLEGRO_AUDIO_EFFECT_LOWPASS ||
+         type > ALLEGRO_AUDIO_EFFECT_REVERB) {
+      _al_set_error(ALLEGRO_INVALID_PARAM, "Unknown audio effect type");
+      return NULL;
+   }
+
+   e = al_calloc(1, sizeof *e);
+   if (!e) {
+      _al_set_error(ALLEGRO_GENERIC_ERROR,
+         "Out of memory allocating audio effect");
+      return NULL;
+   }
+
+   e->type = type;
+   e->dirty = true;
+
+   p = e->params;
+   p[ALLEGRO_AUDIO_EFFECT_PARAM_FREQUENCY] = 1000.0f;
+   p[ALLEGRO_AUDIO_EFFECT_PARAM_Q] = 0.7071f;
+   p[ALLEGRO_AUDIO_EFFECT_PARAM_GAIN] = 0.0f;
+   p[ALLEGRO_AUDIO_EFFECT_PARAM_THRESHOLD] = -12.0f;
+   p[ALLEGRO_AUDIO_EFFECT_PARAM_RATIO] = 4.0f;
+   p[ALLEGRO_AUDIO_EFFECT_PARAM_ATTACK] = 0.005f;
+   p[ALLEGRO_AUDIO_EFFECT_PARAM_RELEASE] = 0.1f;
+   p[ALLEGRO_AUDIO_EFFECT_PARAM_ROOM_SIZE] = 0.5f;
+   p[ALLEGRO_AUDIO_EFFECT_PARAM_DAMPING] = 0.5f;
+   p[ALLEGRO_AUDIO_EFFECT_PARAM_WET] = 0.3f;
+   p[ALLEGRO_AUDIO_EFFECT_PARAM_DRY] = 1.0f;
+
+   e->dtor_item = _al_kcm_register_destructor("audio effect", e,
+      (void (*)(void *)) al_destroy_audio_effect);
+
+   return e;
+}
+
+
+/* Function: al_destroy_audio_effect
+ */
+void al_destroy_audio_effect(ALLEGRO_AUDIO_EFFECT *effect)
+{
+   if (!effect)
+      return;
+
+   _al_kcm_unregister_destructor(effect->dtor_item);
+   al_detach_audio_effect(effect);
+   al_free(effect->lines);
+   al_free(effect);
+}
+
+
+static bool param_is_valid(ALLEGRO_AUDIO_EFFECT_PARAM param, float value)
+{
+   switch (param) {
+      case ALLEGRO_AUDIO_EFFECT_PARAM_FREQUENCY:
+      case ALLEGRO_AUDIO_EFFECT_PARAM_Q:
+         return value > 0.0f;
+      case ALLEGRO_AUDIO_EFFECT_PARAM_RATIO:
+         return value >= 1.0f;
+      case ALLEGRO_AUDIO_EFFECT_PARAM_ATTACK:
+      case ALLEGRO_AUDIO_EFFECT_PARAM_RELEASE:
+         return value >= 0.0f;
+      case ALLEGRO_AUDIO_EFFECT_PARAM_ROOM_SIZE:
+      case ALLEGRO_AUDIO_EFFECT_PARAM_DAMPING:
+         return value >= 0.0f && value <= 1.0f;
+      case ALLEGRO_AUDIO_EFFECT_PARAM_GAIN:
+      case ALLEGRO_AUDIO_EFFECT_PARAM_THRESHOLD:
+      case ALLEGRO_AUDIO_EFFECT_PARAM_WET:
+      case ALLEGRO_AUDIO_EFFECT_PARAM_DRY:
+         return true;
+      default:
+         return false;
+   }
+}
+
+
+/* Function: al_set_audio_effect_param
+ */
+bool al_set_audio_effect_param(ALLEGRO_AUDIO_EFFECT *effect,
+   ALLEGRO_AUDIO_EFFECT_PARAM param, float value)
+{
+   ALLEGRO_MUTEX *mutex;
+
+   ASSERT(effect);
+
+   if (!param_is_valid(param, value)) {
+      _al_set_error(ALLEGRO_INVALID_PARAM,
+         "Audio effect parameter out of range");
+      return false;
+   }
+
+   mutex = effect->mixer ? effect->mixer->ss.mutex : NULL;
+   maybe_lock_mutex(mutex);
+   effect->params[param] = value;
+   effect->dirty = true;
+   maybe_unlock_mutex(mutex);
+
+   return true;
+}
+
+
+/* Function: al_get_audio_effect_param
+ */
+float al_get_audio_effect_param(const ALLEGRO_AUDIO_EFFECT *effect,
+   ALLEGRO_AUDIO_EFFECT_PARAM param)
+{
+   ASSERT(effect);
+
+   if (param < 0 || param >= ALLEGRO_AUDIO_EFFECT_NUM_PARAMS)
+      return 0.0f;
+   return effect->params[param];
+}
+
+
+/* Function: al_attach_audio_effect_to_mixer
+ */
+bool al_attach_audio_effect_to_mixer(ALLEGRO_AUDIO_EFFECT *effect,
+   ALLEGRO_MIXER *mixer, bool after_gain)
+{
+   ALLEGRO_AUDIO_EFFECT **slot;
+
+   ASSERT(effect);
+   ASSERT(mixer);
+
+   if (effect->mixer) {
+      _al_set_error(ALLEGRO_INVALID_OBJECT,
+         "Attempted to attach an audio effect that is already attached");
+      return false;
+   }
+
+   if (mixer->ss.spl_data.depth != ALLEGRO_AUDIO_DEPTH_FLOAT32) {
+      _al_set_error(ALLEGRO_INVALID_PARAM,
+         "Audio effects need a float32 mixer");
+      return false;
+   }
+
+   maybe_lock_mutex(mixer->ss.mutex);
+
+   slot = _al_vector_alloc_back(&mixer->effects);
+   if (!slot) {
+      maybe_unlock_mutex(mixer->ss.mutex);
+      _al_set_error(ALLEGRO_GENERIC_ERROR,
+         "Out of memory allocating attachment pointers");
+      return false;
+   }
+   *slot = effect;
+
+   /* Start from silence, whatever the effect was used for before. */
+   memset(effect->z1, 0, sizeof effect->z1);
+   memset(effect->z2, 0, sizeof effect->z2);
+   effect->envelope = 0.0f;
+   if (effect->lines)
+      memset(effect->lines, 0, REVERB_LINES * effect->line_size * sizeof(float));
+   memset(effect->lowpass, 0, sizeof effect->lowpass);
+
+   effect->mixer = mixer;
+   effect->after_gain = after_gain;
+   effect->dirty = true;
+
+   maybe_unlock_mutex(mixer->ss.mutex);
+
+   return true;
+}
+
+
+/* Function: al_detach_audio_effect
+ */
+bool al_detach_audio_effect(ALLEGRO_AUDIO_EFFECT *effect)
+{
+   ALLEGRO_MIXER *mixer;
+
+   ASSERT(effect);
+
+   mixer = effect->mixer;
+   if (!mixer)
+      return true;
+
+   maybe_lock_mutex(mixer->ss.mutex);
+   _al_vector_find_and_delete(&mixer->effects, &effect);
+   effect->mixer = NULL;
+   maybe_unlock_mutex(mixer->ss.mutex);
+
+   return true;
+}
+
+/* vim: set sts=3 sw=3 et: */
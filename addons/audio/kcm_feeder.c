@@ -0,0 +1,655 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Shared threads feeding the streams created by al_load_audio_stream.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_audio.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_audio.h"
+#include "allegro5/internal/aintern_dtor.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_system.h"
+
+ALLEGRO_DEBUG_CHANNEL("audio")
+
+#define DEFAULT_FEEDER_THREADS   2
+#define MAX_FEEDER_THREADS       16
+
+/* How often streams which are draining are checked for having stopped. */
+#define DRAIN_POLL_INTERVAL      0.01
+
+
+/*
+ * Rather than each stream having a thread of its own, a small fixed pool of
+ * threads feeds all of them.  The fragment events of every fed stream go into
+ * one event queue.  Whichever thread gets the lock next moves the streams
+ * those events are for into the queued state, then feeds the queued stream
+ * which has the least audio buffered, one fragment at a time.  A stream is
+ * only ever fed by one thread at a time.
+ *
+ * stream->feed_state is protected by feeders.mutex.
+ */
+static struct {
+   ALLEGRO_MUTEX *mutex;
+   ALLEGRO_COND *cond;           /* signalled when a stream stops feeding */
+   ALLEGRO_EVENT_QUEUE *queue;
+   ALLEGRO_EVENT_SOURCE wake_source; /* for waking up waiting threads */
+   _AL_DTOR_ITEM *dtor_item;
+   ALLEGRO_THREAD **threads;
+   int num_threads;
+   bool quit;
+   _AL_VECTOR streams;           /* of ALLEGRO_AUDIO_STREAM * */
+   int num_draining;
+   uint64_t order;
+} feeders;
+
+
+static ALLEGRO_MUTEX *maybe_lock_mutex(ALLEGRO_MUTEX *mutex)
+{
+   if (mutex) {
+      al_lock_mutex(mutex);
+   }
+   return mutex;
+}
+
+
+static void maybe_unlock_mutex(ALLEGRO_MUTEX *mutex)
+{
+   if (mutex) {
+      al_unlock_mutex(mutex);
+   }
+}
+
+
+static void emit_finished_event(ALLEGRO_AUDIO_STREAM *stream)
+{
+   ALLEGRO_EVENT fin_event;
+   fin_event.user.type = ALLEGRO_EVENT_AUDIO_STREAM_FINISHED;
+   fin_event.user.timestamp = al_get_time();
+   al_emit_user_event(&stream->spl.es, &fin_event, NULL);
+}
+
+
+/* _al_kcm_drop_loop_cache_rest:
+ *  Forgets what is left to feed of the loop cache, after the stream was
+ *  moved to another position.  Must be called with the stream mutex held.
+ */
+void _al_kcm_drop_loop_cache_rest(ALLEGRO_AUDIO_STREAM *stream)
+{
+   stream->loop_cache_pos = stream->loop_cache_size;
+}
+
+
+/* Copies what is left of the loop cache into buf. */
+static size_t read_loop_cache(ALLEGRO_AUDIO_STREAM *stream, char *buf,
+   size_t bytes)
+{
+   size_t n = stream->loop_cache_size - stream->loop_cache_pos;
+
+   if (n > bytes)
+      n = bytes;
+   memcpy(buf, stream->loop_cache + stream->loop_cache_pos, n);
+   stream->loop_cache_pos += n;
+   return n;
+}
+
+
+/* Rewinds the stream and decodes the start of the loop into the loop cache,
+ * which leaves the decoder right behind it.
+ */
+static bool fill_loop_cache(ALLEGRO_AUDIO_STREAM *stream, size_t bytes)
+{
+   if (!stream->loop_cache) {
+      stream->loop_cache = al_malloc(bytes);
+      if (!stream->loop_cache)
+         return false;
+   }
+   if (!stream->rewind_feeder(stream))
+      return false;
+
+   stream->loop_cache_size = stream->feeder(stream, stream->loop_cache, bytes);
+   stream->loop_cache_pos = 0;
+   stream->loop_cache_whole = stream->loop_cache_size < bytes;
+   stream->loop_cache_valid = true;
+   return true;
+}
+
+
+/* Moves the decoder to where the loop cache ends. If that fails, it can
+ * only be because the cache ends right at the end of the loop.
+ */
+static void seek_past_loop_cache(ALLEGRO_AUDIO_STREAM *stream)
+{
+   double freq = stream->spl.spl_data.frequency;
+   size_t frame_size = al_get_channel_count(stream->spl.spl_data.chan_conf) *
+      al_get_audio_depth_size(stream->spl.spl_data.depth);
+   double frame = floor(stream->loop_start * freq) +
+      stream->loop_cache_size / frame_size;
+
+   /* Aim a little into the frame so that rounding cannot go wrong. */
+   if (!stream->seek_feeder(stream, (frame + 0.25) / freq))
+      stream->loop_cache_whole = true;
+}
+
+
+/* Starts the loop over, writing up to 'bytes' bytes of it into buf.  Once
+ * the loop cache is filled, it is fed instead of rewinding.  The decoder is
+ * then still at the end of the loop, so *seek is set to have it moved past
+ * the cache, which the caller does once the fragment is handed over.
+ */
+static size_t restart_loop(ALLEGRO_AUDIO_STREAM *stream, char *buf,
+   size_t bytes, size_t fragment_bytes, bool *seek)
+{
+   size_t n;
+
+   if (!stream->seek_feeder || !stream->rewind_feeder) {
+      if (stream->rewind_feeder)
+         stream->rewind_feeder(stream);
+      return stream->feeder(stream, buf, bytes);
+   }
+
+   if (stream->loop_cache_valid) {
+      stream->loop_cache_pos = 0;
+      *seek = !stream->loop_cache_whole;
+   }
+   else if (!fill_loop_cache(stream, fragment_bytes)) {
+      ALLEGRO_WARN("Could not fill the loop cache.\n");
+      stream->rewind_feeder(stream);
+      return stream->feeder(stream, buf, bytes);
+   }
+
+   n = read_loop_cache(stream, buf, bytes);
+   if (n < bytes && *seek) {
+      seek_past_loop_cache(stream);
+      *seek = false;
+   }
+   if (n < bytes)
+      n += stream->feeder(stream, buf + n, bytes - n);
+   return n;
+}
+
+
+/* Refills one fragment of the stream, usually getting data from some file
+ * reader backend.  Returns true if the stream ran out of data and should be
+ * drained.
+ */
+static bool feed_fragment(ALLEGRO_AUDIO_STREAM *stream)
+{
+   char *fragment;
+   unsigned long bytes;
+   unsigned long bytes_written;
+   ALLEGRO_MUTEX *stream_mutex;
+   bool seek = false;
+
+   if (stream->is_draining)
+      return false;
+
+   fragment = al_get_audio_stream_fragment(stream);
+   if (!fragment) {
+      /* This is not an error. */
+      return false;
+   }
+
+   bytes = (stream->spl.spl_data.len) *
+         al_get_channel_count(stream->spl.spl_data.chan_conf) *
+         al_get_audio_depth_size(stream->spl.spl_data.depth);
+
+   stream_mutex = maybe_lock_mutex(stream->spl.mutex);
+   /* The rest of the loop cache goes first if the stream just looped. */
+   bytes_written = read_loop_cache(stream, fragment, bytes);
+   if (bytes_written < bytes) {
+      bytes_written += stream->feeder(stream, fragment + bytes_written,
+         bytes - bytes_written);
+   }
+   maybe_unlock_mutex(stream_mutex);
+
+   /* Keep looping until the fragment is filled. */
+   while (bytes_written < bytes &&
+         stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR) {
+      size_t bw;
+      stream_mutex = maybe_lock_mutex(stream->spl.mutex);
+      bw = restart_loop(stream, fragment + bytes_written,
+         bytes - bytes_written, bytes, &seek);
+      maybe_unlock_mutex(stream_mutex);
+      if (bw == 0)
+         break;
+      bytes_written += bw;
+   }
+
+   if (bytes_written < bytes) {
+      /* Fill the rest of the fragment with silence. */
+      int silence_samples = (bytes - bytes_written) /
+         (al_get_channel_count(stream->spl.spl_data.chan_conf) *
+          al_get_audio_depth_size(stream->spl.spl_data.depth));
+      al_fill_silence(fragment + bytes_written, silence_samples,
+                      stream->spl.spl_data.depth, stream->spl.spl_data.chan_conf);
+   }
+
+   if (!al_set_audio_stream_fragment(stream, fragment)) {
+      ALLEGRO_ERROR("Error setting stream buffer.\n");
+      return false;
+   }
+
+   /* Seek while the fragment with the loop point is already queued. */
+   if (seek) {
+      stream_mutex = maybe_lock_mutex(stream->spl.mutex);
+      seek_past_loop_cache(stream);
+      maybe_unlock_mutex(stream_mutex);
+   }
+
+   /* The streaming source doesn't feed any more, so drain buffers.
+    * Don't stop feeding in case the user decides to seek and then restart
+    * the stream. */
+   if (bytes_written != bytes &&
+      stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONCE) {
+      if (!stream->feed_finished_sent) {
+         emit_finished_event(stream);
+         stream->feed_finished_sent = true;
+      }
+      return true;
+   }
+
+   stream->feed_finished_sent = false;
+   return false;
+}
+
+
+static ALLEGRO_AUDIO_STREAM *find_stream(ALLEGRO_EVENT_SOURCE *source)
+{
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&feeders.streams); i++) {
+      ALLEGRO_AUDIO_STREAM **slot = _al_vector_ref(&feeders.streams, i);
+      if (&(*slot)->spl.es == source)
+         return *slot;
+   }
+   return NULL;
+}
+
+
+static void queue_stream(ALLEGRO_AUDIO_STREAM *stream)
+{
+   stream->feed_state = _AL_FEED_QUEUED;
+   stream->feed_order = feeders.order++;
+}
+
+
+/* Must be called with feeders.mutex held. */
+static void handle_events(void)
+{
+   ALLEGRO_EVENT event;
+
+   while (al_get_next_event(feeders.queue, &event)) {
+      ALLEGRO_AUDIO_STREAM *stream;
+
+      if (event.type != ALLEGRO_EVENT_AUDIO_STREAM_FRAGMENT)
+         continue;
+      stream = find_stream(event.any.source);
+      if (!stream)
+         continue;
+
+      if (stream->feed_state == _AL_FEED_IDLE)
+         queue_stream(stream);
+      else if (stream->feed_state == _AL_FEED_FEEDING)
+         stream->feed_state = _AL_FEED_AGAIN;
+   }
+}
+
+
+/* Must be called with feeders.mutex held.
+ * This is what al_drain_audio_stream does, without blocking a feeder thread
+ * until the stream has stopped.
+ */
+static void check_draining_streams(void)
+{
+   unsigned int i;
+
+   if (feeders.num_draining == 0)
+      return;
+
+   for (i = 0; i < _al_vector_size(&feeders.streams); i++) {
+      ALLEGRO_AUDIO_STREAM **slot = _al_vector_ref(&feeders.streams, i);
+      ALLEGRO_AUDIO_STREAM *stream = *slot;
+
+      if (stream->feed_state == _AL_FEED_DRAINING &&
+            !al_get_audio_stream_playing(stream)) {
+         stream->is_draining = false;
+         stream->feed_state = _AL_FEED_IDLE;
+         feeders.num_draining--;
+      }
+   }
+}
+
+
+/* Returns how many seconds of audio the stream has left before it runs dry,
+ * not counting the fragment being played.
+ */
+static double buffered_time(ALLEGRO_AUDIO_STREAM *stream)
+{
+   unsigned int avail = al_get_available_audio_stream_fragments(stream);
+   unsigned int filled = stream->buf_count - avail;
+
+   return (double)filled * stream->spl.spl_data.len /
+      stream->spl.spl_data.frequency;
+}
+
+
+/* Must be called with feeders.mutex held.
+ * Picks the queued stream which is closest to running out.  Among equally
+ * urgent streams the one queued first wins.
+ */
+static ALLEGRO_AUDIO_STREAM *pick_stream(void)
+{
+   ALLEGRO_AUDIO_STREAM *best = NULL;
+   double best_time = 0;
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&feeders.streams); i++) {
+      ALLEGRO_AUDIO_STREAM **slot = _al_vector_ref(&feeders.streams, i);
+      ALLEGRO_AUDIO_STREAM *stream = *slot;
+      double t;
+
+      if (stream->feed_state != _AL_FEED_QUEUED)
+         continue;
+      t = buffered_time(stream);
+      if (!best || t < best_time ||
+            (t == best_time && stream->feed_order < best->feed_order)) {
+         best = stream;
+         best_time = t;
+      }
+   }
+
+   return best;
+}
+
+
+static void *feeder_proc(ALLEGRO_THREAD *self, void *unused)
+{
+   (void)self;
+   (void)unused;
+
+   ALLEGRO_DEBUG("Stream feeder thread started.\n");
+
+   al_lock_mutex(feeders.mutex);
+   while (!feeders.quit) {
+      ALLEGRO_AUDIO_STREAM *stream;
+      bool drain;
+
+      handle_events();
+      check_draining_streams();
+
+      stream = pick_stream();
+      if (!stream) {
+         bool poll = feeders.num_draining > 0;
+         al_unlock_mutex(feeders.mutex);
+         /* Only wait for an event to arrive, leaving it in the queue for
+          * handle_events.  That way the quit event wakes every thread.
+          */
+         if (poll)
+            al_wait_for_event_timed(feeders.queue, NULL, DRAIN_POLL_INTERVAL);
+         else
+            al_wait_for_event(feeders.queue, NULL);
+         al_lock_mutex(feeders.mutex);
+         continue;
+      }
+
+      stream->feed_state = _AL_FEED_FEEDING;
+      al_unlock_mutex(feeders.mutex);
+
+      drain = feed_fragment(stream);
+      if (drain && !al_get_audio_stream_attached(stream)) {
+         al_set_audio_stream_playing(stream, false);
+         drain = false;
+      }
+      else if (drain) {
+         stream->is_draining = true;
+      }
+
+      al_lock_mutex(feeders.mutex);
+      if (drain) {
+         stream->feed_state = _AL_FEED_DRAINING;
+         feeders.num_draining++;
+      }
+      else if (stream->feed_state == _AL_FEED_AGAIN ||
+            al_get_available_audio_stream_fragments(stream) > 0) {
+         queue_stream(stream);
+      }
+      else {
+         stream->feed_state = _AL_FEED_IDLE;
+      }
+      al_broadcast_cond(feeders.cond);
+   }
+   al_unlock_mutex(feeders.mutex);
+
+   ALLEGRO_DEBUG("Stream feeder thread finished.\n");
+
+   return NULL;
+}
+
+
+static int get_config_thread_count(void)
+{
+   const char *p;
+   int n = DEFAULT_FEEDER_THREADS;
+
+   p = al_get_config_value(al_get_system_config(), "audio",
+      "stream_feeder_threads");
+   if (p && p[0] != '\0') {
+      n = atoi(p);
+      if (n < 1)
+         n = 1;
+      if (n > MAX_FEEDER_THREADS)
+         n = MAX_FEEDER_THREADS;
+   }
+   return n;
+}
+
+
+static void stop_threads(void *unused)
+{
+   (void)unused;
+   _al_kcm_shutdown_stream_feeders();
+}
+
+
+/* Must be called with feeders.mutex held. */
+static bool start_threads(void)
+{
+   int n = get_config_thread_count();
+   unsigned int i;
+
+   feeders.queue = al_create_event_queue();
+   if (!feeders.queue)
+      return false;
+   al_init_user_event_source(&feeders.wake_source);
+   al_register_event_source(feeders.queue, &feeders.wake_source);
+
+   /* Streams left over from an earlier al_uninstall_audio. */
+   for (i = 0; i < _al_vector_size(&feeders.streams); i++) {
+      ALLEGRO_AUDIO_STREAM **slot = _al_vector_ref(&feeders.streams, i);
+      al_register_event_source(feeders.queue, &(*slot)->spl.es);
+   }
+
+   feeders.threads = al_calloc(n, sizeof(ALLEGRO_THREAD *));
+   if (!feeders.threads)
+      n = 0;
+   for (feeders.num_threads = 0; feeders.num_threads < n;
+         feeders.num_threads++) {
+      ALLEGRO_THREAD *thread = al_create_thread(feeder_proc, NULL);
+      if (!thread)
+         break;
+      feeders.threads[feeders.num_threads] = thread;
+      al_start_thread(thread);
+   }
+
+   if (feeders.num_threads == 0) {
+      ALLEGRO_ERROR("Could not start any stream feeder threads.\n");
+      al_free(feeders.threads);
+      feeders.threads = NULL;
+      al_destroy_event_queue(feeders.queue);
+      al_destroy_user_event_source(&feeders.wake_source);
+      feeders.queue = NULL;
+      return false;
+   }
+
+   /* The threads must be stopped before al_uninstall_system destroys the
+    * event queue they are waiting on.
+    */
+   feeders.dtor_item = _al_register_destructor(_al_dtor_list,
+      "stream_feeders", &feeders, stop_threads);
+
+   ALLEGRO_INFO("Started %d stream feeder threads.\n", feeders.num_threads);
+   return true;
+}
+
+
+static void destroy_feeders(void)
+{
+   _al_kcm_shutdown_stream_feeders();
+   _al_vector_free(&feeders.streams);
+   al_destroy_cond(feeders.cond);
+   al_destroy_mutex(feeders.mutex);
+   feeders.cond = NULL;
+   feeders.mutex = NULL;
+}
+
+
+/* _al_kcm_init_stream_feeders:
+ *  Prepare the feeder pool.  The threads are only started once the first
+ *  stream needs them.
+ */
+void _al_kcm_init_stream_feeders(void)
+{
+   if (feeders.mutex)
+      return;
+
+   feeders.mutex = al_create_mutex();
+   feeders.cond = al_create_cond();
+   _al_vector_init(&feeders.streams, sizeof(ALLEGRO_AUDIO_STREAM *));
+   _al_add_exit_func(destroy_feeders, "destroy_feeders");
+}
+
+
+/* _al_kcm_shutdown_stream_feeders:
+ *  Stop the feeder threads.  Streams which have not been destroyed yet stay
+ *  known to the pool and are fed again if the threads are restarted.
+ */
+void _al_kcm_shutdown_stream_feeders(void)
+{
+   ALLEGRO_EVENT quit_event;
+   int i;
+
+   if (!feeders.mutex)
+      return;
+
+   al_lock_mutex(feeders.mutex);
+   if (!feeders.queue) {
+      al_unlock_mutex(feeders.mutex);
+      return;
+   }
+   feeders.quit = true;
+   al_unlock_mutex(feeders.mutex);
+
+   _al_unregister_destructor(_al_dtor_list, feeders.dtor_item);
+   feeders.dtor_item = NULL;
+
+   quit_event.type = _KCM_STREAM_FEEDER_QUIT_EVENT_TYPE;
+   al_emit_user_event(&feeders.wake_source, &quit_event, NULL);
+
+   for (i = 0; i < feeders.num_threads; i++) {
+      al_join_thread(feeders.threads[i], NULL);
+      al_destroy_thread(feeders.threads[i]);
+   }
+   al_free(feeders.threads);
+   feeders.threads = NULL;
+   feeders.num_threads = 0;
+
+   al_lock_mutex(feeders.mutex);
+   al_destroy_event_queue(feeders.queue);
+   al_destroy_user_event_source(&feeders.wake_source);
+   feeders.queue = NULL;
+   feeders.quit = false;
+   al_unlock_mutex(feeders.mutex);
+}
+
+
+/* _al_kcm_start_feeding_stream:
+ *  Have the feeder threads keep the stream filled using its 'feeder'
+ *  callback.
+ */
+void _al_kcm_start_feeding_stream(ALLEGRO_AUDIO_STREAM *stream)
+{
+   ALLEGRO_AUDIO_STREAM **slot;
+   ALLEGRO_EVENT event;
+   ASSERT(stream->feeder);
+   ASSERT(stream->feed_state == _AL_FEED_NONE);
+
+   /* In case the stream is loaded without al_install_audio. */
+   _al_kcm_init_stream_feeders();
+
+   al_lock_mutex(feeders.mutex);
+
+   slot = _al_vector_alloc_back(&feeders.streams);
+   *slot = stream;
+   stream->feed_finished_sent = false;
+   queue_stream(stream);
+
+   if (!feeders.queue) {
+      start_threads();
+      al_unlock_mutex(feeders.mutex);
+      return;
+   }
+   al_register_event_source(feeders.queue, &stream->spl.es);
+   al_unlock_mutex(feeders.mutex);
+
+   /* Wake up a waiting thread to pick up the new stream. */
+   event.type = ALLEGRO_EVENT_AUDIO_STREAM_FRAGMENT;
+   al_emit_user_event(&feeders.wake_source, &event, NULL);
+}
+
+
+/* _al_kcm_stop_feeding_stream:
+ *  Remove the stream from the feeder pool, waiting for a refill in progress
+ *  to finish first.  Emits ALLEGRO_EVENT_AUDIO_STREAM_FINISHED.
+ */
+void _al_kcm_stop_feeding_stream(ALLEGRO_AUDIO_STREAM *stream)
+{
+   ASSERT(feeders.mutex);
+
+   if (stream->feed_state == _AL_FEED_NONE)
+      return;
+
+   al_lock_mutex(feeders.mutex);
+   while (stream->feed_state == _AL_FEED_FEEDING ||
+         stream->feed_state == _AL_FEED_AGAIN) {
+      al_wait_cond(feeders.cond, feeders.mutex);
+   }
+   if (stream->feed_state == _AL_FEED_DRAINING)
+      feeders.num_draining--;
+   stream->feed_state = _AL_FEED_NONE;
+   _al_vector_find_and_delete(&feeders.streams, &stream);
+   if (feeders.queue)
+      al_unregister_event_source(feeders.queue, &stream->spl.es);
+   al_unlock_mutex(feeders.mutex);
+
+   emit_finished_event(stream);
+}
+
+
+/* vim: set sts=3 sw=3 et: */
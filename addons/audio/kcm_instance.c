@@ -83,11 +83,13 @@ static void stream_free(ALLEGRO_SAMPLE_INSTANCE *spl)
 
             spl->parent.u.ptr = NULL;
             spl->spl_read = NULL;
-            al_free(spl->matrix);
-            spl->matrix = NULL;
+            _al_kcm_mixer_free_sample_params(spl);
          }
 
          _al_vector_free(&mixer->streams);
+         al_free(mixer->voice_order);
+         _al_kcm_detach_mixer_effects(mixer);
+         _al_kcm_mixer_free_sinc_banks(mixer);
 
          if (spl->spl_data.buffer.ptr) {
             ASSERT(spl->spl_data.free_buf);
@@ -111,6 +113,7 @@ static void stream_free(ALLEGRO_SAMPLE_INSTANCE *spl)
 void _al_kcm_detach_from_parent(ALLEGRO_SAMPLE_INSTANCE *spl)
 {
    ALLEGRO_MIXER *mixer;
+   ALLEGRO_SAMPLE_INSTANCE **slot;
    int i;
 
    if (!spl || !spl->parent.u.ptr)
@@ -122,28 +125,26 @@ void _al_kcm_detach_from_parent(ALLEGRO_SAMPLE_INSTANCE *spl)
    }
    
    mixer = spl->parent.u.mixer;
+   i = spl->parent_index;
+   ASSERT(i >= 0 && i < (int)_al_vector_size(&mixer->streams));
+   ASSERT(*(ALLEGRO_SAMPLE_INSTANCE **)_al_vector_ref(&mixer->streams, i) == spl);
 
-   /* Search through the streams and check for this one */
-   for (i = _al_vector_size(&mixer->streams) - 1; i >= 0; i--) {
-      ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&mixer->streams, i);
+   maybe_lock_mutex(mixer->ss.mutex);
 
-      if (*slot == spl) {
-         maybe_lock_mutex(mixer->ss.mutex);
-
-         _al_vector_delete_at(&mixer->streams, i);
-         spl->parent.u.mixer = NULL;
-         _al_kcm_stream_set_mutex(spl, NULL);
-
-         spl->spl_read = NULL;
+   /* The last stream takes the place of this one. */
+   if (_al_vector_delete_at_unordered(&mixer->streams, i)) {
+      slot = _al_vector_ref(&mixer->streams, i);
+      (*slot)->parent_index = i;
+   }
+   spl->parent.u.mixer = NULL;
+   _al_kcm_stream_set_mutex(spl, NULL);
 
-         maybe_unlock_mutex(mixer->ss.mutex);
+   spl->spl_read = NULL;
+   spl->is_virtual = false;
 
-         break;
-      }
-   }
+   maybe_unlock_mutex(mixer->ss.mutex);
 
-   al_free(spl->matrix);
-   spl->matrix = NULL;
+   _al_kcm_mixer_free_sample_params(spl);
 }
 
 
@@ -168,6 +169,7 @@ ALLEGRO_SAMPLE_INSTANCE *al_create_sample_instance(ALLEGRO_SAMPLE *sample_data)
    spl->loop = ALLEGRO_PLAYMODE_ONCE;
    spl->speed = 1.0f;
    spl->gain = 1.0f;
+   spl->fade = 1.0f;
    spl->pan = 0.0f;
    spl->pos = 0;
    spl->loop_start = 0;
@@ -355,6 +357,41 @@ bool al_get_sample_instance_playing(const ALLEGRO_SAMPLE_INSTANCE *spl)
 }
 
 
+/* Function: al_get_sample_instance_virtual
+ */
+bool al_get_sample_instance_virtual(const ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   ASSERT(spl);
+
+   return spl->is_playing && spl->is_virtual;
+}
+
+
+/* Function: al_get_sample_instance_priority
+ */
+int al_get_sample_instance_priority(const ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   ASSERT(spl);
+
+   return spl->priority;
+}
+
+
+/* Function: al_set_sample_instance_priority
+ */
+bool al_set_sample_instance_priority(ALLEGRO_SAMPLE_INSTANCE *spl,
+   int priority)
+{
+   ASSERT(spl);
+
+   maybe_lock_mutex(spl->mutex);
+   spl->priority = priority;
+   maybe_unlock_mutex(spl->mutex);
+
+   return true;
+}
+
+
 /* Function: al_get_sample_instance_attached
  */
 bool al_get_sample_instance_attached(const ALLEGRO_SAMPLE_INSTANCE *spl)
@@ -426,21 +463,17 @@ bool al_set_sample_instance_speed(ALLEGRO_SAMPLE_INSTANCE *spl, float val)
 
    spl->speed = val;
    if (spl->parent.u.mixer) {
-      ALLEGRO_MIXER *mixer = spl->parent.u.mixer;
+      int step = (spl->spl_data.frequency) * spl->speed;
 
-      maybe_lock_mutex(spl->mutex);
-
-      spl->step = (spl->spl_data.frequency) * spl->speed;
-      spl->step_denom = mixer->ss.spl_data.frequency;
       /* Don't wanna be trapped with a step value of 0 */
-      if (spl->step == 0) {
+      if (step == 0) {
          if (spl->speed > 0.0f)
-            spl->step = 1;
+            step = 1;
          else
-            spl->step = -1;
+            step = -1;
       }
 
-      maybe_unlock_mutex(spl->mutex);
+      _al_kcm_mixer_set_sample_step(spl, step);
    }
 
    return true;
@@ -466,11 +499,7 @@ bool al_set_sample_instance_gain(ALLEGRO_SAMPLE_INSTANCE *spl, float val)
        * matrix to take into account the gain.
        */
       if (spl->parent.u.mixer) {
-         ALLEGRO_MIXER *mixer = spl->parent.u.mixer;
-
-         maybe_lock_mutex(spl->mutex);
-         _al_kcm_mixer_rejig_sample_matrix(mixer, spl);
-         maybe_unlock_mutex(spl->mutex);
+         _al_kcm_mixer_rejig_sample_matrix(spl->parent.u.mixer, spl);
       }
    }
 
@@ -501,11 +530,7 @@ bool al_set_sample_instance_pan(ALLEGRO_SAMPLE_INSTANCE *spl, float val)
        * matrix to take into account the panning.
        */
       if (spl->parent.u.mixer) {
-         ALLEGRO_MIXER *mixer = spl->parent.u.mixer;
-
-         maybe_lock_mutex(spl->mutex);
-         _al_kcm_mixer_rejig_sample_matrix(mixer, spl);
-         maybe_unlock_mutex(spl->mutex);
+         _al_kcm_mixer_rejig_sample_matrix(spl->parent.u.mixer, spl);
       }
    }
 
@@ -614,7 +639,8 @@ bool al_set_sample(ALLEGRO_SAMPLE_INSTANCE *spl, ALLEGRO_SAMPLE *data)
    if (spl->parent.u.ptr != NULL) {
       if (spl->spl_data.frequency != data->frequency ||
             spl->spl_data.depth != data->depth ||
-            spl->spl_data.chan_conf != data->chan_conf) {
+            spl->spl_data.chan_conf != data->chan_conf ||
+            spl->spl_data.block_align != data->block_align) {
          old_parent = spl->parent;
          need_reattach = true;
          _al_kcm_detach_from_parent(spl);
@@ -623,6 +649,9 @@ bool al_set_sample(ALLEGRO_SAMPLE_INSTANCE *spl, ALLEGRO_SAMPLE *data)
 
    spl->spl_data = *data;
    spl->spl_data.free_buf = false;
+   if (spl->adpcm_cache) {
+      _al_kcm_invalidate_adpcm_cache(spl->adpcm_cache);
+   }
    spl->pos = 0;
    spl->loop_start = 0;
    spl->loop_end = data->len;
@@ -671,16 +700,8 @@ bool al_set_sample_instance_channel_matrix(ALLEGRO_SAMPLE_INSTANCE *spl, const f
    }
 
    if (spl->parent.u.mixer) {
-      ALLEGRO_MIXER *mixer = spl->parent.u.mixer;
-      size_t dst_chans = al_get_channel_count(mixer->ss.spl_data.chan_conf);
-      size_t src_chans = al_get_channel_count(spl->spl_data.chan_conf);
       ASSERT(spl->matrix);
-
-      maybe_lock_mutex(spl->mutex);
-
-      memcpy(spl->matrix, matrix, dst_chans * src_chans * sizeof(float));
-
-      maybe_unlock_mutex(spl->mutex);
+      _al_kcm_mixer_set_sample_matrix(spl->parent.u.mixer, spl, matrix);
    }
 
    return true;
@@ -8,6 +8,9 @@
 /* Title: Mixer functions
  */
 
+#define ALLEGRO_INTERNAL_UNSTABLE
+
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 
@@ -15,9 +18,36 @@
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_audio.h"
 #include "allegro5/internal/aintern_audio_cfg.h"
+#include "allegro5/internal/aintern_workers.h"
 
 ALLEGRO_DEBUG_CHANNEL("audio")
 
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+   #if defined(_MSC_VER) || defined(__clang__) || \
+      (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+      #define SIMD_X86
+   #endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+   #define SIMD_NEON
+#endif
+
+#if defined(SIMD_X86)
+   #include <emmintrin.h>
+   #if defined(__GNUC__) || defined(__clang__)
+      #define TARGET(x) __attribute__((target(x)))
+   #else
+      #define TARGET(x)
+   #endif
+#elif defined(SIMD_NEON)
+   #include <arm_neon.h>
+#endif
+
+
+/* The sample readers produce up to this many frames at once into a buffer
+ * on the stack, before they get mixed in.
+ */
+#define MIXER_BLOCK 128
+
 
 typedef union {
    float f32[ALLEGRO_MAX_CHANNELS]; /* max: 7.1 */
@@ -47,20 +77,18 @@ static void maybe_unlock_mutex(ALLEGRO_MUTEX *mutex)
  *  This function provides a (temporary!) matrix that can be used to convert
  *  one channel configuration into another.
  *
- *  Returns a pointer to a statically allocated array.
+ *  Returns a pointer to the first element of mat.
  */
 static float *_al_rechannel_matrix(ALLEGRO_CHANNEL_CONF orig,
-   ALLEGRO_CHANNEL_CONF target, float gain, float pan)
+   ALLEGRO_CHANNEL_CONF target, float gain, float pan,
+   float mat[ALLEGRO_MAX_CHANNELS][ALLEGRO_MAX_CHANNELS])
 {
-   /* Max 7.1 (8 channels) for input and output */
-   static float mat[ALLEGRO_MAX_CHANNELS][ALLEGRO_MAX_CHANNELS];
-
    size_t dst_chans = al_get_channel_count(target);
    size_t src_chans = al_get_channel_count(orig);
    size_t i, j;
 
    /* Start with a simple identity matrix */
-   memset(mat, 0, sizeof(mat));
+   memset(mat, 0, sizeof(float) * ALLEGRO_MAX_CHANNELS * ALLEGRO_MAX_CHANNELS);
    for (i = 0; i < src_chans && i < dst_chans; i++) {
       mat[i][i] = 1.0;
    }
@@ -133,32 +161,232 @@ static float *_al_rechannel_matrix(ALLEGRO_CHANNEL_CONF orig,
 }
 
 
+/* begin_sample_params, end_sample_params:
+ *  Bracket changes to the pending step and matrix of a sample.  While
+ *  params_seq is odd the mixer leaves the pending values alone.
+ */
+static void begin_sample_params(ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   maybe_lock_mutex(spl->params_mutex);
+   _al_store_release(&spl->params_seq, spl->params_seq + 1);
+   _al_memory_barrier();
+}
+
+
+static void end_sample_params(ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   _al_store_release(&spl->params_seq, spl->params_seq + 1);
+   maybe_unlock_mutex(spl->params_mutex);
+}
+
+
+/* apply_sample_params: [mixer]
+ *  Picks up the step and matrix last published for the sample.  If they are
+ *  being changed right now, this is tried again before the next block.
+ *  The caller must be holding the mixer mutex.
+ */
+static void apply_sample_params(ALLEGRO_SAMPLE_INSTANCE *spl,
+   size_t matrix_size)
+{
+   float matrix[ALLEGRO_MAX_CHANNELS * ALLEGRO_MAX_CHANNELS];
+   _AL_ATOMIC seq = _al_load_acquire(&spl->params_seq);
+   _AL_PENDING_FADE fade;
+   int step;
+
+   if (seq == spl->params_applied || (seq & 1))
+      return;
+
+   memcpy(matrix, spl->pending_matrix, matrix_size * sizeof(float));
+   step = spl->pending_step;
+   fade = spl->pending_fade;
+
+   _al_memory_barrier();
+   if (_al_load_acquire(&spl->params_seq) != seq)
+      return;
+
+   memcpy(spl->matrix, matrix, matrix_size * sizeof(float));
+   if (step != spl->applied_step) {
+      spl->step = step;
+      spl->applied_step = step;
+   }
+   if (fade.serial != spl->applied_fade_serial) {
+      if (fade.from >= 0.0f)
+         spl->fade = fade.from;
+      spl->fade_target = fade.to;
+      spl->fade_frames = fade.frames;
+      spl->fade_step = (fade.to - spl->fade) / fade.frames;
+      spl->fade_stop = fade.stop;
+      spl->applied_fade_serial = fade.serial;
+   }
+   spl->params_applied = seq;
+}
+
+
+/* advance_fade: [mixer]
+ *  Moves the fade of a sample on by n frames. A sample which was to stop
+ *  at the end of its fade is stopped, and its fade reset.
+ */
+static void advance_fade(ALLEGRO_SAMPLE_INSTANCE *spl, size_t n)
+{
+   if (spl->fade_frames == 0)
+      return;
+
+   if (n < (size_t)spl->fade_frames) {
+      spl->fade += spl->fade_step * n;
+      spl->fade_frames -= n;
+      return;
+   }
+
+   spl->fade = spl->fade_target;
+   spl->fade_frames = 0;
+   if (spl->fade_stop) {
+      spl->fade_stop = false;
+      spl->fade = 1.0f;
+      spl->is_playing = false;
+   }
+}
+
+
+/* fade_matrix: [mixer]
+ *  Returns the matrix to mix the next n frames of a sample with. While the
+ *  sample is faded, that is its matrix scaled into 'faded'. The fade is
+ *  moved on by n frames.
+ */
+static const float *fade_matrix(ALLEGRO_SAMPLE_INSTANCE *spl, size_t n,
+   size_t matrix_size, float *faded)
+{
+   size_t i;
+
+   if (spl->fade == 1.0f && spl->fade_frames == 0)
+      return spl->matrix;
+
+   for (i = 0; i < matrix_size; i++)
+      faded[i] = spl->matrix[i] * spl->fade;
+   advance_fade(spl, n);
+   return faded;
+}
+
+
 /* _al_kcm_mixer_rejig_sample_matrix:
  *  Recompute the mixing matrix for a sample attached to a mixer.
- *  The caller must be holding the mixer mutex.
+ *  The mixer picks it up before the next block, so the caller need not
+ *  hold the mixer mutex.
  */
 void _al_kcm_mixer_rejig_sample_matrix(ALLEGRO_MIXER *mixer,
    ALLEGRO_SAMPLE_INSTANCE *spl)
 {
-   float *mat;
+   float mat[ALLEGRO_MAX_CHANNELS][ALLEGRO_MAX_CHANNELS];
+   float matrix[ALLEGRO_MAX_CHANNELS * ALLEGRO_MAX_CHANNELS];
    size_t dst_chans;
    size_t src_chans;
    size_t i, j;
 
-   mat = _al_rechannel_matrix(spl->spl_data.chan_conf,
-      mixer->ss.spl_data.chan_conf, spl->gain, spl->pan);
+   _al_rechannel_matrix(spl->spl_data.chan_conf,
+      mixer->ss.spl_data.chan_conf, spl->gain, spl->pan, mat);
 
    dst_chans = al_get_channel_count(mixer->ss.spl_data.chan_conf);
    src_chans = al_get_channel_count(spl->spl_data.chan_conf);
 
-   if (!spl->matrix)
-      spl->matrix = al_calloc(1, src_chans * dst_chans * sizeof(float));
-
    for (i = 0; i < dst_chans; i++) {
       for (j = 0; j < src_chans; j++) {
-         spl->matrix[i*src_chans + j] = mat[i*ALLEGRO_MAX_CHANNELS + j];
+         matrix[i*src_chans + j] = mat[i][j];
       }
    }
+
+   _al_kcm_mixer_set_sample_matrix(mixer, spl, matrix);
+}
+
+
+/* _al_kcm_mixer_set_sample_matrix:
+ *  Sets the mixing matrix for a sample attached to a mixer, which the
+ *  mixer picks up before the next block.
+ */
+void _al_kcm_mixer_set_sample_matrix(ALLEGRO_MIXER *mixer,
+   ALLEGRO_SAMPLE_INSTANCE *spl, const float *matrix)
+{
+   size_t dst_chans = al_get_channel_count(mixer->ss.spl_data.chan_conf);
+   size_t src_chans = al_get_channel_count(spl->spl_data.chan_conf);
+   size_t size = src_chans * dst_chans * sizeof(float);
+
+   /* Only happens while attaching, which holds the mixer mutex. */
+   if (!spl->matrix) {
+      spl->matrix = al_calloc(1, size);
+      spl->pending_matrix = al_calloc(1, size);
+      spl->params_mutex = al_create_mutex();
+   }
+
+   begin_sample_params(spl);
+   memcpy(spl->pending_matrix, matrix, size);
+   end_sample_params(spl);
+}
+
+
+/* _al_kcm_mixer_set_sample_step:
+ *  Sets the step for a sample attached to a mixer, which the mixer picks
+ *  up before the next block.
+ */
+void _al_kcm_mixer_set_sample_step(ALLEGRO_SAMPLE_INSTANCE *spl, int step)
+{
+   begin_sample_params(spl);
+   spl->pending_step = step;
+   end_sample_params(spl);
+}
+
+
+/* _al_kcm_fade_sample_instance:
+ *  Ramps the gain of a sample attached to a mixer from 'from', or from
+ *  where it is now if that is negative, to 'to' over the given time, on top
+ *  of its own gain.  The mixer picks this up before the next block.  If
+ *  'stop' is set, the sample stops playing when the fade is over.
+ */
+bool _al_kcm_fade_sample_instance(ALLEGRO_SAMPLE_INSTANCE *spl, float from,
+   float to, double seconds, bool stop)
+{
+   double frames;
+
+   if (!spl->parent.u.ptr || spl->parent.is_voice) {
+      _al_set_error(ALLEGRO_GENERIC_ERROR,
+         "Can only fade samples attached to a mixer");
+      return false;
+   }
+
+   frames = seconds * spl->parent.u.mixer->ss.spl_data.frequency;
+   if (frames < 1.0)
+      frames = 1.0;
+   if (frames > INT_MAX)
+      frames = INT_MAX;
+
+   begin_sample_params(spl);
+   spl->pending_fade.serial++;
+   spl->pending_fade.from = from;
+   spl->pending_fade.to = to;
+   spl->pending_fade.frames = (int)frames;
+   spl->pending_fade.stop = stop;
+   end_sample_params(spl);
+
+   return true;
+}
+
+
+/* _al_kcm_mixer_free_sample_params:
+ *  Frees the matrix, the pending values and the decoded blocks of a sample
+ *  which is being detached from its mixer, and ends any fade.
+ */
+void _al_kcm_mixer_free_sample_params(ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   al_free(spl->matrix);
+   spl->matrix = NULL;
+   al_free(spl->pending_matrix);
+   spl->pending_matrix = NULL;
+   al_free(spl->adpcm_cache);
+   spl->adpcm_cache = NULL;
+   spl->fade = 1.0f;
+   spl->fade_frames = 0;
+   spl->fade_stop = false;
+   if (spl->params_mutex) {
+      al_destroy_mutex(spl->params_mutex);
+      spl->params_mutex = NULL;
+   }
 }
 
 
@@ -264,11 +492,311 @@ static INLINE int32_t clamp(int32_t val, int32_t min, int32_t max)
 }
 
 
+/* frames_to_boundary:
+ *  Returns how many frames can be read from the current position before
+ *  fix_looped_position would have to move it, at least 1.
+ */
+static int frames_to_boundary(const ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   int64_t denom = spl->step_denom;
+   int64_t fpos = (int64_t)spl->pos * denom + spl->pos_bresenham_error;
+   int64_t start, end, n;
+
+   switch (spl->loop) {
+      case ALLEGRO_PLAYMODE_LOOP:
+      case ALLEGRO_PLAYMODE_BIDIR:
+         if (spl->loop_end - spl->loop_start == 0)
+            return 1;
+         start = spl->loop_start;
+         end = spl->loop_end;
+         break;
+      default:
+         start = 0;
+         end = spl->spl_data.len;
+         break;
+   }
+
+   if (spl->step > 0)
+      n = (end * denom - fpos + spl->step - 1) / spl->step;
+   else if (spl->step < 0)
+      n = (fpos - start * denom) / -spl->step + 1;
+   else
+      n = INT_MAX;
+
+   if (n < 1)
+      return 1;
+   if (n > INT_MAX)
+      return INT_MAX;
+   return (int)n;
+}
+
+
+/* Compressed samples are decoded a block at a time into the cache of the
+ * instance, and these read single frames through it.  Two blocks are kept,
+ * so interpolating across a block boundary decodes each block only once.
+ */
+static INLINE const int16_t *adpcm_frame(const ALLEGRO_SAMPLE_INSTANCE *spl,
+   int frame, unsigned int maxc)
+{
+   _AL_ADPCM_CACHE *cache = spl->adpcm_cache;
+   const int block = frame / spl->spl_data.block_frames;
+   const int offset = (frame - block * spl->spl_data.block_frames) * maxc;
+
+   if (cache->block[0] == block)
+      return cache->frames[0] + offset;
+   if (cache->block[1] == block)
+      return cache->frames[1] + offset;
+   return _al_kcm_fill_adpcm_cache(cache, &spl->spl_data, block) + offset;
+}
+
+
+/* Returns the frame after p, the way the interpolating readers do. */
+static INLINE int adpcm_next(const ALLEGRO_SAMPLE_INSTANCE *spl, int p)
+{
+   p++;
+   if (spl->loop == ALLEGRO_PLAYMODE_ONCE) {
+      if (p >= spl->spl_data.len)
+         p = spl->spl_data.len - 1;
+   }
+   else if (p >= spl->loop_end) {
+      p = spl->loop_start;
+   }
+   return p;
+}
+
+
+static INLINE const void *adpcm_point_spl32(SAMP_BUF *samp_buf,
+   const ALLEGRO_SAMPLE_INSTANCE *spl, unsigned int maxc)
+{
+   const int16_t *x = adpcm_frame(spl, spl->pos, maxc);
+   unsigned int i;
+
+   for (i = 0; i < maxc; i++)
+      samp_buf->f32[i] = (float) x[i] / ((float) 0x7FFF + 0.5f);
+   return samp_buf->f32;
+}
+
+
+static INLINE const void *adpcm_linear_spl32(SAMP_BUF *samp_buf,
+   const ALLEGRO_SAMPLE_INSTANCE *spl, unsigned int maxc)
+{
+   const float t = (float) spl->pos_bresenham_error / spl->step_denom;
+   const int16_t *x0 = adpcm_frame(spl, spl->pos, maxc);
+   const int16_t *x1 = adpcm_frame(spl, adpcm_next(spl, spl->pos), maxc);
+   unsigned int i;
+
+   for (i = 0; i < maxc; i++) {
+      const float s = (x0[i] * (1.0f - t)) + (x1[i] * t);
+      samp_buf->f32[i] = s / ((float) 0x7FFF + 0.5f);
+   }
+   return samp_buf->f32;
+}
+
+
+static INLINE const void *adpcm_cubic_spl32(SAMP_BUF *samp_buf,
+   const ALLEGRO_SAMPLE_INSTANCE *spl, unsigned int maxc)
+{
+   const float t = (float) spl->pos_bresenham_error / spl->step_denom;
+   int p0 = spl->pos - 1;
+   int p2 = adpcm_next(spl, spl->pos);
+   int p3 = adpcm_next(spl, p2);
+   const int16_t *x0, *x1, *x2, *x3;
+   unsigned int i;
+
+   if (spl->loop == ALLEGRO_PLAYMODE_ONCE) {
+      if (p0 < 0)
+         p0 = 0;
+   }
+   else if (p0 < spl->loop_start) {
+      p0 = spl->loop_end - 1;
+   }
+
+   x0 = adpcm_frame(spl, p0, maxc);
+   x1 = adpcm_frame(spl, spl->pos, maxc);
+   x2 = adpcm_frame(spl, p2, maxc);
+   x3 = adpcm_frame(spl, p3, maxc);
+
+   for (i = 0; i < maxc; i++) {
+      float c0 = x1[i];
+      float c1 = 0.5f * (x2[i] - x0[i]);
+      float c2 = x0[i] - (2.5f * x1[i]) + (2.0f * x2[i]) - (0.5f * x3[i]);
+      float c3 = (0.5f * (x3[i] - x0[i])) + (1.5f * (x1[i] - x2[i]));
+      float s = (((((c3 * t) + c2) * t) + c1) * t) + c0;
+      samp_buf->f32[i] = s / ((float) 0x7FFF + 0.5f);
+   }
+   return samp_buf->f32;
+}
+
+
+static INLINE const void *adpcm_point_spl16(SAMP_BUF *samp_buf,
+   const ALLEGRO_SAMPLE_INSTANCE *spl, unsigned int maxc)
+{
+   (void)samp_buf;
+   return adpcm_frame(spl, spl->pos, maxc);
+}
+
+
+static INLINE const void *adpcm_linear_spl16(SAMP_BUF *samp_buf,
+   const ALLEGRO_SAMPLE_INSTANCE *spl, unsigned int maxc)
+{
+   const int32_t t = 256 * spl->pos_bresenham_error / spl->step_denom;
+   const int16_t *x0 = adpcm_frame(spl, spl->pos, maxc);
+   const int16_t *x1 = adpcm_frame(spl, adpcm_next(spl, spl->pos), maxc);
+   unsigned int i;
+
+   for (i = 0; i < maxc; i++) {
+      const int32_t s = ((x0[i] * (256 - t)) >> 8) + ((x1[i] * t) >> 8);
+      samp_buf->s16[i] = (int16_t) s;
+   }
+   return samp_buf->s16;
+}
+
+
+/* Applies the channel matrix to n frames of maxc channels each, adding the
+ * result to the dest_maxc channel frames in buf.  The products are added in
+ * the same order for all versions, so they give the same result.
+ */
+#define MAKE_MIX_BLOCK(NAME, TYPE)                                            \
+static void NAME(TYPE *buf, const TYPE *s, size_t n, size_t maxc,             \
+   size_t dest_maxc, const float *matrix)                                     \
+{                                                                             \
+   size_t i, c;                                                               \
+   int j;                                                                     \
+                                                                              \
+   for (i = 0; i < n; i++) {                                                  \
+      for (c = 0; c < dest_maxc; c++) {                                       \
+         for (j = (int)maxc - 1; j >= 0; j--)                                 \
+            *buf += s[j] * matrix[c*maxc + j];                                \
+         buf++;                                                               \
+      }                                                                       \
+      s += maxc;                                                              \
+   }                                                                          \
+}
+
+MAKE_MIX_BLOCK(mix_block_generic_float, float)
+MAKE_MIX_BLOCK(mix_block_int16_t, int16_t)
+
+#undef MAKE_MIX_BLOCK
+
+
+#if defined(SIMD_X86)
+
+TARGET("sse2")
+static size_t mix_mono_to_stereo_sse2(float *buf, const float *s, size_t n,
+   const float *matrix)
+{
+   const __m128 m = _mm_setr_ps(matrix[0], matrix[1], matrix[0], matrix[1]);
+   size_t i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      __m128 x = _mm_loadu_ps(s + i);
+      __m128 lo = _mm_unpacklo_ps(x, x);
+      __m128 hi = _mm_unpackhi_ps(x, x);
+      __m128 b0 = _mm_loadu_ps(buf + 2*i);
+      __m128 b1 = _mm_loadu_ps(buf + 2*i + 4);
+      _mm_storeu_ps(buf + 2*i, _mm_add_ps(b0, _mm_mul_ps(lo, m)));
+      _mm_storeu_ps(buf + 2*i + 4, _mm_add_ps(b1, _mm_mul_ps(hi, m)));
+   }
+   return i;
+}
+
+
+TARGET("sse2")
+static size_t mix_stereo_to_stereo_sse2(float *buf, const float *s, size_t n,
+   const float *matrix)
+{
+   const __m128 ml = _mm_setr_ps(matrix[0], matrix[2], matrix[0], matrix[2]);
+   const __m128 mr = _mm_setr_ps(matrix[1], matrix[3], matrix[1], matrix[3]);
+   size_t i;
+
+   for (i = 0; i + 2 <= n; i += 2) {
+      __m128 x = _mm_loadu_ps(s + 2*i);
+      __m128 l = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 2, 0, 0));
+      __m128 r = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 1, 1));
+      __m128 b = _mm_loadu_ps(buf + 2*i);
+      b = _mm_add_ps(b, _mm_mul_ps(r, mr));
+      b = _mm_add_ps(b, _mm_mul_ps(l, ml));
+      _mm_storeu_ps(buf + 2*i, b);
+   }
+   return i;
+}
+
+#elif defined(SIMD_NEON)
+
+static size_t mix_mono_to_stereo_neon(float *buf, const float *s, size_t n,
+   const float *matrix)
+{
+   const float32x2_t m = vld1_f32(matrix);
+   size_t i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      float32x4_t x = vld1q_f32(s + i);
+      float32x4x2_t b = vld2q_f32(buf + 2*i);
+      b.val[0] = vaddq_f32(b.val[0], vmulq_lane_f32(x, m, 0));
+      b.val[1] = vaddq_f32(b.val[1], vmulq_lane_f32(x, m, 1));
+      vst2q_f32(buf + 2*i, b);
+   }
+   return i;
+}
+
+
+static size_t mix_stereo_to_stereo_neon(float *buf, const float *s, size_t n,
+   const float *matrix)
+{
+   size_t i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      float32x4x2_t x = vld2q_f32(s + 2*i);
+      float32x4x2_t b = vld2q_f32(buf + 2*i);
+      b.val[0] = vaddq_f32(b.val[0], vmulq_n_f32(x.val[1], matrix[1]));
+      b.val[0] = vaddq_f32(b.val[0], vmulq_n_f32(x.val[0], matrix[0]));
+      b.val[1] = vaddq_f32(b.val[1], vmulq_n_f32(x.val[1], matrix[3]));
+      b.val[1] = vaddq_f32(b.val[1], vmulq_n_f32(x.val[0], matrix[2]));
+      vst2q_f32(buf + 2*i, b);
+   }
+   return i;
+}
+
+#endif
+
+
+static void mix_block_float(float *buf, const float *s, size_t n,
+   size_t maxc, size_t dest_maxc, const float *matrix)
+{
+   size_t done = 0;
+
+   if (dest_maxc == 2 && (maxc == 1 || maxc == 2)) {
+#if defined(SIMD_X86)
+      if (al_get_cpu_features() & ALLEGRO_CPU_SSE2) {
+         if (maxc == 1)
+            done = mix_mono_to_stereo_sse2(buf, s, n, matrix);
+         else
+            done = mix_stereo_to_stereo_sse2(buf, s, n, matrix);
+      }
+#elif defined(SIMD_NEON)
+      if (al_get_cpu_features() & ALLEGRO_CPU_NEON) {
+         if (maxc == 1)
+            done = mix_mono_to_stereo_neon(buf, s, n, matrix);
+         else
+            done = mix_stereo_to_stereo_neon(buf, s, n, matrix);
+      }
+#endif
+   }
+
+   if (done < n) {
+      mix_block_generic_float(buf + done * dest_maxc, s + done * maxc,
+         n - done, maxc, dest_maxc, matrix);
+   }
+}
+
+
 /* Mix as many sample values as possible from the source sample into a mixer
  * buffer.  Implements stream_reader_t.
  *
  * TYPE is the type of the sample values in the mixer buffer, and
- * NEXT_SAMPLE_VALUE must return a buffer of the same type.
+ * NEXT_SAMPLE_VALUE must return a buffer of the same type.  The frames up
+ * to the next loop point or the end are interpolated into a block first,
+ * which MIX_BLOCK then mixes in.
  * 
  * Note: Uses Bresenham to keep the precise sample position.
  */
@@ -279,98 +807,767 @@ static INLINE int32_t clamp(int32_t val, int32_t min, int32_t max)
       delta_error = spl->step - delta * spl->step_denom;                      \
    } while (0)
 
-#define MAKE_MIXER(NAME, NEXT_SAMPLE_VALUE, TYPE)                             \
-static void NAME(void *source, void **vbuf, unsigned int *samples,            \
-   ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc)                        \
-{                                                                             \
-   ALLEGRO_SAMPLE_INSTANCE *spl = (ALLEGRO_SAMPLE_INSTANCE *)source;          \
-   TYPE *buf = *vbuf;                                                         \
-   size_t maxc = al_get_channel_count(spl->spl_data.chan_conf);               \
-   size_t samples_l = *samples;                                               \
-   size_t c;                                                                  \
-   int delta, delta_error;                                                    \
-   SAMP_BUF samp_buf;                                                         \
-                                                                              \
-   BRESENHAM;                                                                 \
-                                                                              \
-   if (!spl->is_playing)                                                      \
-      return;                                                                 \
-                                                                              \
-   while (samples_l > 0) {                                                    \
-      const TYPE *s;                                                          \
-      int old_step = spl->step;                                               \
-                                                                              \
-      if (!fix_looped_position(spl))                                          \
-         return;                                                              \
-      if (old_step != spl->step) {                                            \
-         BRESENHAM;                                                           \
-      }                                                                       \
-                                                                              \
-      /* It might be worth preparing multiple sample values at once. */       \
-      s = (TYPE *) NEXT_SAMPLE_VALUE(&samp_buf, spl, maxc);                   \
-                                                                              \
-      for (c = 0; c < dest_maxc; c++) {                                       \
-         ALLEGRO_STATIC_ASSERT(kcm_mixer, ALLEGRO_MAX_CHANNELS == 8);         \
-         switch (maxc) {                                                      \
-            case 8: *buf += s[7] * spl->matrix[c*maxc + 7];                   \
-            /* fall through */                                                \
-            case 7: *buf += s[6] * spl->matrix[c*maxc + 6];                   \
-            /* fall through */                                                \
-            case 6: *buf += s[5] * spl->matrix[c*maxc + 5];                   \
-            /* fall through */                                                \
-            case 5: *buf += s[4] * spl->matrix[c*maxc + 4];                   \
-            /* fall through */                                                \
-            case 4: *buf += s[3] * spl->matrix[c*maxc + 3];                   \
-            /* fall through */                                                \
-            case 3: *buf += s[2] * spl->matrix[c*maxc + 2];                   \
-            /* fall through */                                                \
-            case 2: *buf += s[1] * spl->matrix[c*maxc + 1];                   \
-            /* fall through */                                                \
-            case 1: *buf += s[0] * spl->matrix[c*maxc + 0];                   \
-            /* fall through */                                                \
-            default: break;                                                   \
-         }                                                                    \
-         buf++;                                                               \
-      }                                                                       \
-                                                                              \
-      spl->pos += delta;                                                      \
-      spl->pos_bresenham_error += delta_error;                                \
-      if (spl->pos_bresenham_error >= spl->step_denom) {                      \
-         spl->pos++;                                                          \
-         spl->pos_bresenham_error -= spl->step_denom;                         \
-      }                                                                       \
-      samples_l--;                                                            \
-   }                                                                          \
-   fix_looped_position(spl);                                                  \
-   (void)buffer_depth;                                                        \
+#define MAKE_MIXER(NAME, NEXT_SAMPLE_VALUE, TYPE, MIX_BLOCK)                  \
+static void NAME(void *source, void **vbuf, unsigned int *samples,            \
+   ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc)                        \
+{                                                                             \
+   ALLEGRO_SAMPLE_INSTANCE *spl = (ALLEGRO_SAMPLE_INSTANCE *)source;          \
+   TYPE *buf = *vbuf;                                                         \
+   size_t maxc = al_get_channel_count(spl->spl_data.chan_conf);               \
+   size_t samples_l = *samples;                                               \
+   size_t c;                                                                  \
+   int delta, delta_error;                                                    \
+   SAMP_BUF samp_buf;                                                         \
+   TYPE block[MIXER_BLOCK * ALLEGRO_MAX_CHANNELS];                            \
+   float faded[ALLEGRO_MAX_CHANNELS * ALLEGRO_MAX_CHANNELS];                  \
+                                                                              \
+   ALLEGRO_STATIC_ASSERT(kcm_mixer, ALLEGRO_MAX_CHANNELS == 8);               \
+   BRESENHAM;                                                                 \
+                                                                              \
+   if (!spl->is_playing)                                                      \
+      return;                                                                 \
+                                                                              \
+   while (samples_l > 0) {                                                    \
+      TYPE *b = block;                                                        \
+      int old_step = spl->step;                                               \
+      size_t n, i;                                                            \
+                                                                              \
+      apply_sample_params(spl, maxc * dest_maxc);                             \
+      if (!fix_looped_position(spl))                                          \
+         return;                                                              \
+      if (old_step != spl->step) {                                            \
+         BRESENHAM;                                                           \
+      }                                                                       \
+                                                                              \
+      /* None of these frames need fix_looped_position. */                    \
+      n = frames_to_boundary(spl);                                            \
+      if (n > samples_l)                                                      \
+         n = samples_l;                                                       \
+      if (n > MIXER_BLOCK)                                                    \
+         n = MIXER_BLOCK;                                                     \
+                                                                              \
+      for (i = 0; i < n; i++) {                                               \
+         const TYPE *s = (TYPE *) NEXT_SAMPLE_VALUE(&samp_buf, spl, maxc);    \
+         for (c = 0; c < maxc; c++)                                           \
+            *b++ = s[c];                                                      \
+                                                                              \
+         spl->pos += delta;                                                   \
+         spl->pos_bresenham_error += delta_error;                             \
+         if (spl->pos_bresenham_error >= spl->step_denom) {                   \
+            spl->pos++;                                                       \
+            spl->pos_bresenham_error -= spl->step_denom;                      \
+         }                                                                    \
+      }                                                                       \
+                                                                              \
+      MIX_BLOCK(buf, block, n, maxc, dest_maxc,                               \
+         fade_matrix(spl, n, maxc * dest_maxc, faded));                       \
+      buf += n * dest_maxc;                                                   \
+      samples_l -= n;                                                         \
+      if (!spl->is_playing)                                                   \
+         break;                                                               \
+   }                                                                          \
+   fix_looped_position(spl);                                                  \
+   (void)buffer_depth;                                                        \
+}
+
+MAKE_MIXER(read_to_mixer_point_float_32, point_spl32, float,
+   mix_block_float)
+MAKE_MIXER(read_to_mixer_linear_float_32, linear_spl32, float,
+   mix_block_float)
+MAKE_MIXER(read_to_mixer_cubic_float_32, cubic_spl32, float,
+   mix_block_float)
+MAKE_MIXER(read_to_mixer_point_int16_t_16, point_spl16, int16_t,
+   mix_block_int16_t)
+MAKE_MIXER(read_to_mixer_linear_int16_t_16, linear_spl16, int16_t,
+   mix_block_int16_t)
+MAKE_MIXER(read_to_mixer_adpcm_point_float_32, adpcm_point_spl32, float,
+   mix_block_float)
+MAKE_MIXER(read_to_mixer_adpcm_linear_float_32, adpcm_linear_spl32, float,
+   mix_block_float)
+MAKE_MIXER(read_to_mixer_adpcm_cubic_float_32, adpcm_cubic_spl32, float,
+   mix_block_float)
+MAKE_MIXER(read_to_mixer_adpcm_point_int16_t_16, adpcm_point_spl16, int16_t,
+   mix_block_int16_t)
+MAKE_MIXER(read_to_mixer_adpcm_linear_int16_t_16, adpcm_linear_spl16, int16_t,
+   mix_block_int16_t)
+
+#undef MAKE_MIXER
+
+
+/* Windowed-sinc resampling.
+ *
+ * Every output frame is a weighted sum of the SINC_TAPS source frames
+ * around its position.  The weights only depend on the fractional part of
+ * the position, so they are precomputed into a bank of filter phases.
+ *
+ * If the step reduces to a ratio with a small denominator, e.g. 2:1 or
+ * 44100:48000, the fractional part only ever takes that many values and a
+ * bank with exactly those phases is used.  Otherwise the weights are
+ * interpolated between the two nearest of SINC_PHASES phases.
+ *
+ * When resampling down, the cutoff frequency is lowered to the destination
+ * Nyquist frequency, in steps of 1/SINC_CUTOFF_STEPS to limit the number of
+ * banks.  The banks are owned by the mixer.
+ */
+#define SINC_TAPS          16
+#define SINC_PHASES        256
+#define SINC_MAX_EXACT     320
+#define SINC_MAX_BANKS     16
+#define SINC_CUTOFF_STEPS  32
+#define SINC_KAISER_BETA   7.0
+#define SINC_WINDOW        (MIXER_BLOCK * 4)
+
+typedef struct _AL_SINC_BANK _AL_SINC_BANK;
+
+struct _AL_SINC_BANK {
+   int phases;
+   bool exact;
+   int cutoff;          /* In 1/SINC_CUTOFF_STEPS of the source Nyquist. */
+   float *coefs;        /* phases + 1 rows of SINC_TAPS weights. */
+};
+
+
+/* Zeroth order modified Bessel function of the first kind. */
+static double bessel_i0(double x)
+{
+   double sum = 1.0;
+   double term = 1.0;
+   int k;
+
+   for (k = 1; k < 32; k++) {
+      term *= (x / (2 * k)) * (x / (2 * k));
+      sum += term;
+      if (term < sum * 1e-12)
+         break;
+   }
+
+   return sum;
+}
+
+
+static _AL_SINC_BANK *create_sinc_bank(int phases, bool exact, int cutoff)
+{
+   _AL_SINC_BANK *bank;
+   double fc = (double)cutoff / SINC_CUTOFF_STEPS;
+   double i0_beta = bessel_i0(SINC_KAISER_BETA);
+   int p, j;
+
+   bank = al_malloc(sizeof *bank);
+   if (!bank)
+      return NULL;
+   bank->coefs = al_malloc((phases + 1) * SINC_TAPS * sizeof(float));
+   if (!bank->coefs) {
+      al_free(bank);
+      return NULL;
+   }
+   bank->phases = phases;
+   bank->exact = exact;
+   bank->cutoff = cutoff;
+
+   for (p = 0; p <= phases; p++) {
+      double t = (double)p / phases;
+      double h[SINC_TAPS];
+      double sum = 0.0;
+
+      for (j = 0; j < SINC_TAPS; j++) {
+         double x = j - (SINC_TAPS/2 - 1) - t;
+         double u = x / (SINC_TAPS/2);
+         double s = (x == 0.0) ? 1.0 : sin(ALLEGRO_PI * fc * x) / (ALLEGRO_PI * fc * x);
+         double w = (u >= -1.0 && u <= 1.0) ?
+            bessel_i0(SINC_KAISER_BETA * sqrt(1.0 - u * u)) / i0_beta : 0.0;
+         h[j] = s * w;
+         sum += h[j];
+      }
+
+      /* Normalise so that each phase passes DC unchanged. */
+      for (j = 0; j < SINC_TAPS; j++)
+         bank->coefs[p * SINC_TAPS + j] = h[j] / sum;
+   }
+
+   return bank;
+}
+
+
+static int64_t gcd64(int64_t a, int64_t b)
+{
+   while (b) {
+      int64_t t = a % b;
+      a = b;
+      b = t;
+   }
+   return a;
+}
+
+
+/* Picks the filter bank for the current step of the sample instance,
+ * creating it if the mixer doesn't have it yet.  Returns NULL if out of
+ * memory.
+ */
+static _AL_SINC_BANK *get_sinc_bank(ALLEGRO_MIXER *mixer,
+   ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   int64_t s = spl->step < 0 ? -(int64_t)spl->step : spl->step;
+   int64_t d = spl->step_denom;
+   int64_t g = gcd64(s, d);
+   int phases = SINC_PHASES;
+   bool exact = false;
+   int cutoff = SINC_CUTOFF_STEPS;
+   _AL_SINC_BANK **slot;
+   _AL_SINC_BANK *bank;
+   unsigned int i;
+
+   if (s > d) {
+      cutoff = (int)((SINC_CUTOFF_STEPS * d) / s);
+      if (cutoff < 1)
+         cutoff = 1;
+   }
+
+   if (d / g <= SINC_MAX_EXACT && spl->pos_bresenham_error % g == 0) {
+      phases = (int)(d / g);
+      exact = true;
+   }
+
+   for (i = 0; i < _al_vector_size(&mixer->sinc_banks); i++) {
+      slot = _al_vector_ref(&mixer->sinc_banks, i);
+      bank = *slot;
+      if (bank->phases == phases && bank->exact == exact &&
+            bank->cutoff == cutoff)
+         return bank;
+   }
+
+   /* Don't let a sweeping speed fill up the memory with exact banks. */
+   if (exact && _al_vector_size(&mixer->sinc_banks) >= SINC_MAX_BANKS) {
+      for (i = 0; i < _al_vector_size(&mixer->sinc_banks); i++) {
+         slot = _al_vector_ref(&mixer->sinc_banks, i);
+         bank = *slot;
+         if (!bank->exact && bank->cutoff == cutoff)
+            return bank;
+      }
+      phases = SINC_PHASES;
+      exact = false;
+   }
+
+   bank = create_sinc_bank(phases, exact, cutoff);
+   if (!bank)
+      return NULL;
+   slot = _al_vector_alloc_back(&mixer->sinc_banks);
+   if (!slot) {
+      al_free(bank->coefs);
+      al_free(bank);
+      return NULL;
+   }
+   *slot = bank;
+   ALLEGRO_DEBUG("Created sinc filter bank: %d %s phases, cutoff %d/%d\n",
+      phases, exact ? "exact" : "interpolated", cutoff, SINC_CUTOFF_STEPS);
+   return bank;
+}
+
+
+/* Internal function: _al_kcm_mixer_free_sinc_banks
+ */
+void _al_kcm_mixer_free_sinc_banks(ALLEGRO_MIXER *mixer)
+{
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&mixer->sinc_banks); i++) {
+      _AL_SINC_BANK **slot = _al_vector_ref(&mixer->sinc_banks, i);
+      al_free((*slot)->coefs);
+      al_free(*slot);
+   }
+   _al_vector_free(&mixer->sinc_banks);
+}
+
+
+/* Converts count frames starting at the given one to float. */
+static void frames_to_float(const ALLEGRO_SAMPLE_INSTANCE *spl, int frame,
+   int count, size_t maxc, float *out)
+{
+   const int i0 = frame * (int)maxc;
+   const int n = count * (int)maxc;
+   int i;
+
+   if (spl->spl_data.block_align) {
+      for (i = 0; i < count; i++) {
+         const int16_t *x = adpcm_frame(spl, frame + i, maxc);
+         size_t c;
+         for (c = 0; c < maxc; c++)
+            *out++ = (float) x[c] / ((float) 0x7FFF + 0.5f);
+      }
+      return;
+   }
+
+   switch (spl->spl_data.depth) {
+      case ALLEGRO_AUDIO_DEPTH_FLOAT32:
+         memcpy(out, spl->spl_data.buffer.f32 + i0, n * sizeof(float));
+         break;
+      case ALLEGRO_AUDIO_DEPTH_INT24:
+         for (i = 0; i < n; i++)
+            out[i] = (float) spl->spl_data.buffer.s24[i0 + i] / ((float) 0x7FFFFF + 0.5f);
+         break;
+      case ALLEGRO_AUDIO_DEPTH_UINT24:
+         for (i = 0; i < n; i++)
+            out[i] = (float) spl->spl_data.buffer.u24[i0 + i] / ((float) 0x7FFFFF + 0.5f) - 1.0f;
+         break;
+      case ALLEGRO_AUDIO_DEPTH_INT16:
+         for (i = 0; i < n; i++)
+            out[i] = (float) spl->spl_data.buffer.s16[i0 + i] / ((float) 0x7FFF + 0.5f);
+         break;
+      case ALLEGRO_AUDIO_DEPTH_UINT16:
+         for (i = 0; i < n; i++)
+            out[i] = (float) spl->spl_data.buffer.u16[i0 + i] / ((float) 0x7FFF + 0.5f) - 1.0f;
+         break;
+      case ALLEGRO_AUDIO_DEPTH_INT8:
+         for (i = 0; i < n; i++)
+            out[i] = (float) spl->spl_data.buffer.s8[i0 + i] / ((float) 0x7F + 0.5f);
+         break;
+      case ALLEGRO_AUDIO_DEPTH_UINT8:
+         for (i = 0; i < n; i++)
+            out[i] = (float) spl->spl_data.buffer.u8[i0 + i] / ((float) 0x7F + 0.5f) - 1.0f;
+         break;
+   }
+}
+
+
+/* Returns the frame of the sample data that frame index idx of the
+ * instance refers to, taking the loop into account, or -1 for silence.
+ */
+static int64_t sinc_source_frame(const ALLEGRO_SAMPLE_INSTANCE *spl,
+   int64_t idx)
+{
+   int64_t start = spl->loop_start;
+   int64_t len = (int64_t)spl->loop_end - spl->loop_start;
+
+   switch (spl->loop) {
+      case ALLEGRO_PLAYMODE_LOOP:
+         if (len > 0 && (idx < start || idx >= start + len)) {
+            idx = (idx - start) % len;
+            if (idx < 0)
+               idx += len;
+            idx += start;
+         }
+         break;
+
+      case ALLEGRO_PLAYMODE_BIDIR:
+         if (len > 0 && (idx < start || idx >= start + len)) {
+            idx = (idx - start) % (2 * len);
+            if (idx < 0)
+               idx += 2 * len;
+            if (idx >= len)
+               idx = 2 * len - 1 - idx;
+            idx += start;
+         }
+         break;
+
+      case _ALLEGRO_PLAYMODE_STREAM_ONCE:
+      case _ALLEGRO_PLAYMODE_STREAM_ONEDIR:
+         /* The stream buffers keep enough history in front of them. */
+         return idx;
+
+      default:
+         break;
+   }
+
+   if (idx < 0 || idx >= (int64_t)spl->spl_data.len)
+      return -1;
+   return idx;
+}
+
+
+/* Converts count frames starting at frame index lo into window, in runs
+ * of consecutive source frames.
+ */
+static void sinc_fill_window(const ALLEGRO_SAMPLE_INSTANCE *spl, int64_t lo,
+   int count, size_t maxc, float *window)
+{
+   int k = 0;
+
+   while (k < count) {
+      int64_t frame = sinc_source_frame(spl, lo + k);
+      int run = 1;
+
+      while (k + run < count &&
+            sinc_source_frame(spl, lo + k + run) == (frame < 0 ? -1 : frame + run))
+         run++;
+
+      if (frame < 0)
+         memset(window + k * maxc, 0, run * maxc * sizeof(float));
+      else
+         frames_to_float(spl, (int)frame, run, maxc, window + k * maxc);
+      k += run;
+   }
+}
+
+
+static void sinc_dot_generic(float *out, const float *w, const float *h,
+   size_t maxc)
+{
+   size_t c;
+   int j;
+
+   for (c = 0; c < maxc; c++) {
+      float sum = 0.0f;
+      for (j = 0; j < SINC_TAPS; j++)
+         sum += w[j * maxc + c] * h[j];
+      out[c] = sum;
+   }
+}
+
+
+#if defined(SIMD_X86)
+
+TARGET("sse2")
+static void sinc_dot_mono_sse2(float *out, const float *w, const float *h)
+{
+   __m128 acc = _mm_mul_ps(_mm_loadu_ps(w), _mm_loadu_ps(h));
+   int j;
+
+   for (j = 4; j < SINC_TAPS; j += 4)
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(w + j), _mm_loadu_ps(h + j)));
+   acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+   acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+   _mm_store_ss(out, acc);
+}
+
+
+TARGET("sse2")
+static void sinc_dot_stereo_sse2(float *out, const float *w, const float *h)
+{
+   __m128 acc = _mm_setzero_ps();
+   int j;
+
+   for (j = 0; j < SINC_TAPS; j += 4) {
+      __m128 c = _mm_loadu_ps(h + j);
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_unpacklo_ps(c, c), _mm_loadu_ps(w + 2*j)));
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_unpackhi_ps(c, c), _mm_loadu_ps(w + 2*j + 4)));
+   }
+   acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+   _mm_storel_pi((__m64 *)out, acc);
+}
+
+#elif defined(SIMD_NEON)
+
+static void sinc_dot_mono_neon(float *out, const float *w, const float *h)
+{
+   float32x4_t acc = vmulq_f32(vld1q_f32(w), vld1q_f32(h));
+   float32x2_t sum;
+   int j;
+
+   for (j = 4; j < SINC_TAPS; j += 4)
+      acc = vmlaq_f32(acc, vld1q_f32(w + j), vld1q_f32(h + j));
+   sum = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+   out[0] = vget_lane_f32(vpadd_f32(sum, sum), 0);
+}
+
+
+static void sinc_dot_stereo_neon(float *out, const float *w, const float *h)
+{
+   float32x4_t acc = vdupq_n_f32(0.0f);
+   int j;
+
+   for (j = 0; j < SINC_TAPS; j += 4) {
+      float32x4x2_t c = vzipq_f32(vld1q_f32(h + j), vld1q_f32(h + j));
+      acc = vmlaq_f32(acc, c.val[0], vld1q_f32(w + 2*j));
+      acc = vmlaq_f32(acc, c.val[1], vld1q_f32(w + 2*j + 4));
+   }
+   vst1_f32(out, vadd_f32(vget_low_f32(acc), vget_high_f32(acc)));
+}
+
+#endif
+
+
+/* Computes one output frame of maxc channels from the SINC_TAPS frames at
+ * w, using the weights h.
+ */
+static void sinc_dot(float *out, const float *w, const float *h, size_t maxc)
+{
+#if defined(SIMD_X86)
+   if (maxc <= 2 && (al_get_cpu_features() & ALLEGRO_CPU_SSE2)) {
+      if (maxc == 1)
+         sinc_dot_mono_sse2(out, w, h);
+      else
+         sinc_dot_stereo_sse2(out, w, h);
+      return;
+   }
+#elif defined(SIMD_NEON)
+   if (maxc <= 2 && (al_get_cpu_features() & ALLEGRO_CPU_NEON)) {
+      if (maxc == 1)
+         sinc_dot_mono_neon(out, w, h);
+      else
+         sinc_dot_stereo_neon(out, w, h);
+      return;
+   }
+#endif
+   sinc_dot_generic(out, w, h, maxc);
+}
+
+
+static int64_t floor_div64(int64_t a, int64_t b)
+{
+   int64_t q = a / b;
+   if ((a % b != 0) && ((a < 0) != (b < 0)))
+      q--;
+   return q;
+}
+
+
+/* Like the readers made by MAKE_MIXER, but with windowed-sinc resampling.
+ * Each block first converts the source frames it needs into a window, and
+ * then computes the output frames from that.
+ */
+static void read_to_mixer_sinc_float_32(void *source, void **vbuf,
+   unsigned int *samples, ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc)
+{
+   ALLEGRO_SAMPLE_INSTANCE *spl = (ALLEGRO_SAMPLE_INSTANCE *)source;
+   ALLEGRO_MIXER *mixer = spl->parent.u.mixer;
+   float *buf = *vbuf;
+   size_t maxc = al_get_channel_count(spl->spl_data.chan_conf);
+   size_t samples_l = *samples;
+   int delta, delta_error;
+   /* Streams have no frames ahead of the position, so lag behind. */
+   const int lead = (spl->loop == _ALLEGRO_PLAYMODE_STREAM_ONCE ||
+      spl->loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR) ?
+      SINC_TAPS - 1 : SINC_TAPS/2 - 1;
+   float block[MIXER_BLOCK * ALLEGRO_MAX_CHANNELS];
+   float window[SINC_WINDOW * ALLEGRO_MAX_CHANNELS];
+   float faded[ALLEGRO_MAX_CHANNELS * ALLEGRO_MAX_CHANNELS];
+
+   BRESENHAM;
+
+   if (!spl->is_playing)
+      return;
+
+   while (samples_l > 0) {
+      int old_step = spl->step;
+      _AL_SINC_BANK *bank;
+      int64_t d, fpos, first, last, lo;
+      float *b = block;
+      size_t n, max_n, i;
+      int g;
+
+      apply_sample_params(spl, maxc * dest_maxc);
+      if (!fix_looped_position(spl))
+         return;
+      if (old_step != spl->step) {
+         BRESENHAM;
+      }
+
+      bank = spl->sinc_bank;
+      if (!bank || spl->sinc_step != spl->step ||
+            (bank->exact &&
+               spl->pos_bresenham_error % (spl->step_denom / bank->phases))) {
+         bank = get_sinc_bank(mixer, spl);
+         if (!bank) {
+            unsigned int rest = samples_l;
+            void *p = buf;
+            ALLEGRO_WARN("Falling back to cubic interpolation\n");
+            if (spl->spl_data.block_align)
+               read_to_mixer_adpcm_cubic_float_32(spl, &p, &rest,
+                  buffer_depth, dest_maxc);
+            else
+               read_to_mixer_cubic_float_32(spl, &p, &rest, buffer_depth,
+                  dest_maxc);
+            return;
+         }
+         spl->sinc_bank = bank;
+         spl->sinc_step = spl->step;
+      }
+
+      d = spl->step_denom;
+      g = spl->step_denom / bank->phases;
+
+      /* None of these frames need fix_looped_position, and the window
+       * has to hold all the source frames they use.
+       */
+      n = frames_to_boundary(spl);
+      if (n > samples_l)
+         n = samples_l;
+      if (n > MIXER_BLOCK)
+         n = MIXER_BLOCK;
+      max_n = (size_t)(((int64_t)(SINC_WINDOW - SINC_TAPS - 1) * d) /
+         (spl->step < 0 ? -(int64_t)spl->step : spl->step)) + 1;
+      if (n > max_n)
+         n = max_n;
+
+      fpos = (int64_t)spl->pos * d + spl->pos_bresenham_error;
+      first = spl->pos;
+      last = floor_div64(fpos + (int64_t)(n - 1) * spl->step, d);
+      lo = (first < last ? first : last) - lead;
+      sinc_fill_window(spl, lo,
+         (int)((first < last ? last - first : first - last) + SINC_TAPS),
+         maxc, window);
+
+      for (i = 0; i < n; i++) {
+         const float *w = window + (spl->pos - lead - lo) * maxc;
+
+         if (bank->exact) {
+            sinc_dot(b, w, bank->coefs +
+               (spl->pos_bresenham_error / g) * SINC_TAPS, maxc);
+         }
+         else {
+            int64_t ph = (int64_t)spl->pos_bresenham_error * SINC_PHASES;
+            int k = (int)(ph / d);
+            float t = (float)(ph - k * d) / d;
+            const float *h0 = bank->coefs + k * SINC_TAPS;
+            const float *h1 = h0 + SINC_TAPS;
+            float h[SINC_TAPS];
+            int j;
+
+            for (j = 0; j < SINC_TAPS; j++)
+               h[j] = h0[j] + t * (h1[j] - h0[j]);
+            sinc_dot(b, w, h, maxc);
+         }
+         b += maxc;
+
+         spl->pos += delta;
+         spl->pos_bresenham_error += delta_error;
+         if (spl->pos_bresenham_error >= spl->step_denom) {
+            spl->pos++;
+            spl->pos_bresenham_error -= spl->step_denom;
+         }
+      }
+
+      mix_block_float(buf, block, n, maxc, dest_maxc,
+         fade_matrix(spl, n, maxc * dest_maxc, faded));
+      buf += n * dest_maxc;
+      samples_l -= n;
+      if (!spl->is_playing)
+         break;
+   }
+   fix_looped_position(spl);
+}
+
+
+static void premix_child_mixers(ALLEGRO_MIXER *m, unsigned int samples);
+
+
+/* advance_virtual_instance:
+ *  Moves a virtual sample instance on by the given number of frames, the
+ *  same way reading it would, without looking at its data.
+ */
+static void advance_virtual_instance(ALLEGRO_SAMPLE_INSTANCE *spl,
+   unsigned int samples, size_t dest_maxc)
+{
+   size_t maxc = al_get_channel_count(spl->spl_data.chan_conf);
+   size_t samples_l = samples;
+
+   while (samples_l > 0) {
+      int64_t fpos;
+      size_t n;
+
+      apply_sample_params(spl, maxc * dest_maxc);
+      if (!fix_looped_position(spl))
+         return;
+
+      n = frames_to_boundary(spl);
+      if (n > samples_l)
+         n = samples_l;
+      if (n > MIXER_BLOCK)
+         n = MIXER_BLOCK;
+
+      fpos = (int64_t)spl->pos * spl->step_denom + spl->pos_bresenham_error
+         + (int64_t)n * spl->step;
+      spl->pos = (int)floor_div64(fpos, spl->step_denom);
+      spl->pos_bresenham_error =
+         (int)(fpos - (int64_t)spl->pos * spl->step_denom);
+      samples_l -= n;
+      advance_fade(spl, n);
+      if (!spl->is_playing)
+         return;
+   }
+   fix_looped_position(spl);
+}
+
+
+/* Audio streams and mixers are always mixed: a stream has to consume its
+ * fragments, and a mixer's own inputs are picked separately.
+ */
+static bool may_be_virtual(const ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   return spl->is_playing && !spl->is_mixer &&
+      spl->loop != _ALLEGRO_PLAYMODE_STREAM_ONCE &&
+      spl->loop != _ALLEGRO_PLAYMODE_STREAM_ONEDIR;
+}
+
+
+/* More important instances sort first. Comparing the pointers last keeps
+ * the order stable between periods, so instances don't flip between real
+ * and virtual.
+ */
+static int compare_voice_importance(const void *a, const void *b)
+{
+   const ALLEGRO_SAMPLE_INSTANCE *sa = *(ALLEGRO_SAMPLE_INSTANCE * const *)a;
+   const ALLEGRO_SAMPLE_INSTANCE *sb = *(ALLEGRO_SAMPLE_INSTANCE * const *)b;
+
+   if (sa->priority != sb->priority)
+      return sa->priority > sb->priority ? -1 : 1;
+   if (sa->gain != sb->gain)
+      return sa->gain > sb->gain ? -1 : 1;
+   if (sa != sb)
+      return sa < sb ? -1 : 1;
+   return 0;
 }
 
-MAKE_MIXER(read_to_mixer_point_float_32, point_spl32, float)
-MAKE_MIXER(read_to_mixer_linear_float_32, linear_spl32, float)
-MAKE_MIXER(read_to_mixer_cubic_float_32, cubic_spl32, float)
-MAKE_MIXER(read_to_mixer_point_int16_t_16, point_spl16, int16_t)
-MAKE_MIXER(read_to_mixer_linear_int16_t_16, linear_spl16, int16_t)
 
-#undef MAKE_MIXER
+/* pick_real_voices:
+ *  Flags the sample instances that will only be advanced this period:
+ *  those below the audibility threshold, and the least important ones
+ *  beyond the mixer's voice budget.
+ */
+static void pick_real_voices(ALLEGRO_MIXER *m)
+{
+   int count = 0;
+   int i;
 
+   if (m->max_voices > 0 &&
+         m->voice_order_size < (int)_al_vector_size(&m->streams)) {
+      int size = _al_vector_size(&m->streams);
+      ALLEGRO_SAMPLE_INSTANCE **order = al_realloc(m->voice_order,
+         size * sizeof(*order));
+      if (order) {
+         m->voice_order = order;
+         m->voice_order_size = size;
+      }
+   }
 
-/* _al_kcm_mixer_read:
- *  Mixes the streams attached to the mixer and writes additively to the
- *  specified buffer (or if *buf is NULL, indicating a voice, convert it and
- *  set it to the buffer pointer).
+   for (i = 0; i < (int)_al_vector_size(&m->streams); i++) {
+      ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&m->streams, i);
+      ALLEGRO_SAMPLE_INSTANCE *spl = *slot;
+
+      spl->is_virtual = false;
+      if (!may_be_virtual(spl))
+         continue;
+      if (spl->gain < m->audibility_threshold) {
+         spl->is_virtual = true;
+         continue;
+      }
+      if (count < m->voice_order_size)
+         m->voice_order[count++] = spl;
+   }
+
+   if (m->max_voices > 0 && count > m->max_voices) {
+      qsort(m->voice_order, count, sizeof(*m->voice_order),
+         compare_voice_importance);
+      for (i = m->max_voices; i < count; i++)
+         m->voice_order[i]->is_virtual = true;
+   }
+}
+
+
+/* mix_into_buffer:
+ *  Mixes the streams attached to the mixer into its own buffer, then runs
+ *  the effects and the post-processing callback and applies the gain, and
+ *  finally runs the effects attached after the gain. Returns false if the
+ *  buffer could not be allocated.
  */
-void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
-   ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc)
+static bool mix_into_buffer(ALLEGRO_MIXER *m, unsigned int *samples)
 {
-   const ALLEGRO_MIXER *mixer;
-   ALLEGRO_MIXER *m = (ALLEGRO_MIXER *)source;
    int maxc = al_get_channel_count(m->ss.spl_data.chan_conf);
    int samples_l = *samples;
+   double start_time = al_get_time();
+   unsigned int active = 0;
+   unsigned int virtuals = 0;
    int i;
 
-   if (!m->ss.is_playing)
-      return;
-
    /* Make sure the mixer buffer is big enough. */
    if (m->ss.spl_data.len*maxc < samples_l*maxc) {
       al_free(m->ss.spl_data.buffer.ptr);
@@ -379,41 +1576,63 @@ void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
          _al_set_error(ALLEGRO_GENERIC_ERROR,
             "Out of memory allocating mixer buffer");
          m->ss.spl_data.len = 0;
-         return;
+         return false;
       }
       m->ss.spl_data.len = samples_l;
    }
 
-   mixer = m;
+   al_profile_begin("mix_into_buffer");
 
    /* Clear the buffer to silence. */
-   memset(mixer->ss.spl_data.buffer.ptr, 0, samples_l * maxc * al_get_audio_depth_size(mixer->ss.spl_data.depth));
+   memset(m->ss.spl_data.buffer.ptr, 0, samples_l * maxc * al_get_audio_depth_size(m->ss.spl_data.depth));
+
+   /* Let the child mixers do their own mixing on the worker threads first.
+    * Their results are still added below in the usual order, so the output
+    * is the same as when mixing serially.
+    */
+   if (m->parallel)
+      premix_child_mixers(m, *samples);
+
+   if (m->max_voices > 0 || m->audibility_threshold > 0.0f)
+      pick_real_voices(m);
 
    /* Mix the streams into the mixer buffer. */
-   for (i = _al_vector_size(&mixer->streams) - 1; i >= 0; i--) {
-      ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&mixer->streams, i);
+   for (i = _al_vector_size(&m->streams) - 1; i >= 0; i--) {
+      ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&m->streams, i);
       ALLEGRO_SAMPLE_INSTANCE *spl = *slot;
       ASSERT(spl->spl_read);
-      spl->spl_read(spl, (void **) &mixer->ss.spl_data.buffer.ptr, samples,
+      if (spl->is_virtual && spl->is_playing) {
+         virtuals++;
+         advance_virtual_instance(spl, *samples, maxc);
+         continue;
+      }
+      if (spl->is_playing && !spl->is_mixer)
+         active++;
+      spl->spl_read(spl, (void **) &m->ss.spl_data.buffer.ptr, samples,
          m->ss.spl_data.depth, maxc);
    }
+   m->stats.active_instances = active;
+   m->stats.virtual_instances = virtuals;
+
+   if (_al_vector_size(&m->effects) > 0)
+      _al_kcm_run_mixer_effects(m, *samples, false);
 
    /* Call the post-processing callback. */
-   if (mixer->postprocess_callback) {
-      mixer->postprocess_callback(mixer->ss.spl_data.buffer.ptr,
-         *samples, mixer->pp_callback_userdata);
+   if (m->postprocess_callback) {
+      m->postprocess_callback(m->ss.spl_data.buffer.ptr,
+         *samples, m->pp_callback_userdata);
    }
 
    samples_l *= maxc;
 
    /* Apply the gain if necessary. */
-   if (mixer->ss.gain != 1.0f) {
-      float mixer_gain = mixer->ss.gain;
+   if (m->ss.gain != 1.0f) {
+      float mixer_gain = m->ss.gain;
       unsigned long i = samples_l;
 
       switch (m->ss.spl_data.depth) {
          case ALLEGRO_AUDIO_DEPTH_FLOAT32: {
-            float *p = mixer->ss.spl_data.buffer.f32;
+            float *p = m->ss.spl_data.buffer.f32;
             while (i-- > 0) {
                *p++ *= mixer_gain;
             }
@@ -421,7 +1640,7 @@ void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
          }
 
          case ALLEGRO_AUDIO_DEPTH_INT16: {
-            int16_t *p = mixer->ss.spl_data.buffer.s16;
+            int16_t *p = m->ss.spl_data.buffer.s16;
             while (i-- > 0) {
                *p++ *= mixer_gain;
             }
@@ -439,6 +1658,88 @@ void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
       }
    }
 
+   if (_al_vector_size(&m->effects) > 0)
+      _al_kcm_run_mixer_effects(m, *samples, true);
+
+   _al_kcm_add_mix_time(&m->stats, al_get_time() - start_time);
+   al_profile_end();
+
+   return true;
+}
+
+
+#define MAX_PREMIX 32
+
+typedef struct PREMIX_JOB {
+   ALLEGRO_MIXER *mixers[MAX_PREMIX];
+   unsigned int samples;
+} PREMIX_JOB;
+
+
+static void premix_proc(int index, void *arg)
+{
+   PREMIX_JOB *job = arg;
+   ALLEGRO_MIXER *child = job->mixers[index];
+   unsigned int samples = job->samples;
+
+   child->premix_ok = mix_into_buffer(child, &samples);
+   child->premixed = true;
+}
+
+
+/* premix_child_mixers:
+ *  Mixes the playing mixers attached to m in parallel. Each of them is
+ *  flagged so that its regular read only adds the finished buffer.
+ */
+static void premix_child_mixers(ALLEGRO_MIXER *m, unsigned int samples)
+{
+   PREMIX_JOB job;
+   int count = 0;
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&m->streams) && count < MAX_PREMIX; i++) {
+      ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&m->streams, i);
+      ALLEGRO_SAMPLE_INSTANCE *spl = *slot;
+      if (spl->is_mixer && spl->is_playing)
+         job.mixers[count++] = (ALLEGRO_MIXER *)spl;
+   }
+
+   if (count < 2)
+      return;
+
+   job.samples = samples;
+   _al_run_parallel(count, premix_proc, &job);
+}
+
+
+/* _al_kcm_mixer_read:
+ *  Mixes the streams attached to the mixer and writes additively to the
+ *  specified buffer (or if *buf is NULL, indicating a voice, convert it and
+ *  set it to the buffer pointer).
+ */
+void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
+   ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc)
+{
+   const ALLEGRO_MIXER *mixer;
+   ALLEGRO_MIXER *m = (ALLEGRO_MIXER *)source;
+   int maxc = al_get_channel_count(m->ss.spl_data.chan_conf);
+   int samples_l = *samples;
+
+   if (!m->ss.is_playing)
+      return;
+
+   if (m->premixed) {
+      m->premixed = false;
+      if (!m->premix_ok)
+         return;
+   }
+   else if (!mix_into_buffer(m, samples)) {
+      return;
+   }
+
+   mixer = m;
+   samples_l *= maxc;
+
    /* Feeding to a non-voice.
     * Currently we only support mixers of the same audio depth doing this.
     */
@@ -638,6 +1939,10 @@ ALLEGRO_MIXER *al_create_mixer(unsigned int freq,
          ALLEGRO_INFO("Cubic interpolation\n");
          default_mixer_quality = ALLEGRO_MIXER_QUALITY_CUBIC;
       }
+      else if (!_al_stricmp(p, "sinc")) {
+         ALLEGRO_INFO("Windowed-sinc interpolation\n");
+         default_mixer_quality = ALLEGRO_MIXER_QUALITY_SINC;
+      }
    }
 
    if (!freq) {
@@ -674,7 +1979,10 @@ ALLEGRO_MIXER *al_create_mixer(unsigned int freq,
 
    mixer->quality = default_mixer_quality;
 
-   _al_vector_init(&mixer->streams, sizeof(ALLEGRO_SAMPLE_INSTANCE *));
+   _al_vector_init_inline(&mixer->streams, sizeof(ALLEGRO_SAMPLE_INSTANCE *),
+      mixer->inline_streams, _AL_MIXER_INLINE_STREAMS);
+   _al_vector_init(&mixer->effects, sizeof(ALLEGRO_AUDIO_EFFECT *));
+   _al_vector_init(&mixer->sinc_banks, sizeof(_AL_SINC_BANK *));
 
    mixer->dtor_item = _al_kcm_register_destructor("mixer", mixer, (void (*)(void *)) al_destroy_mixer);
 
@@ -693,6 +2001,30 @@ void al_destroy_mixer(ALLEGRO_MIXER *mixer)
 }
 
 
+/* Returns the reader for compressed samples that suits the mixer. */
+static stream_reader_t get_adpcm_reader(const ALLEGRO_MIXER *mixer)
+{
+   if (mixer->ss.spl_data.depth == ALLEGRO_AUDIO_DEPTH_INT16) {
+      if (mixer->quality == ALLEGRO_MIXER_QUALITY_POINT)
+         return read_to_mixer_adpcm_point_int16_t_16;
+      return read_to_mixer_adpcm_linear_int16_t_16;
+   }
+
+   switch (mixer->quality) {
+      case ALLEGRO_MIXER_QUALITY_POINT:
+         return read_to_mixer_adpcm_point_float_32;
+      case ALLEGRO_MIXER_QUALITY_LINEAR:
+         return read_to_mixer_adpcm_linear_float_32;
+      case ALLEGRO_MIXER_QUALITY_CUBIC:
+         return read_to_mixer_adpcm_cubic_float_32;
+      case ALLEGRO_MIXER_QUALITY_SINC:
+         /* Decodes through frames_to_float. */
+         return read_to_mixer_sinc_float_32;
+   }
+   return read_to_mixer_adpcm_linear_float_32;
+}
+
+
 /* This function is ALLEGRO_MIXER aware */
 /* Function: al_attach_sample_instance_to_mixer
  */
@@ -700,6 +2032,7 @@ bool al_attach_sample_instance_to_mixer(ALLEGRO_SAMPLE_INSTANCE *spl,
    ALLEGRO_MIXER *mixer)
 {
    ALLEGRO_SAMPLE_INSTANCE **slot;
+   _AL_ADPCM_CACHE *adpcm_cache = NULL;
 
    ASSERT(mixer);
    ASSERT(spl);
@@ -711,6 +2044,15 @@ bool al_attach_sample_instance_to_mixer(ALLEGRO_SAMPLE_INSTANCE *spl,
       return false;
    }
 
+   if (!spl->is_mixer && spl->spl_data.block_align) {
+      adpcm_cache = _al_kcm_create_adpcm_cache(&spl->spl_data);
+      if (!adpcm_cache) {
+         _al_set_error(ALLEGRO_GENERIC_ERROR,
+            "Out of memory allocating decoded blocks");
+         return false;
+      }
+   }
+
    maybe_lock_mutex(mixer->ss.mutex);
    
    _al_kcm_stream_set_mutex(spl, mixer->ss.mutex);
@@ -720,11 +2062,13 @@ bool al_attach_sample_instance_to_mixer(ALLEGRO_SAMPLE_INSTANCE *spl,
       if (mixer->ss.mutex) {
          al_unlock_mutex(mixer->ss.mutex);
       }
+      al_free(adpcm_cache);
       _al_set_error(ALLEGRO_GENERIC_ERROR,
          "Out of memory allocating attachment pointers");
       return false;
    }
    (*slot) = spl;
+   spl->parent_index = _al_vector_size(&mixer->streams) - 1;
 
    spl->step = (spl->spl_data.frequency) * spl->speed;
    spl->step_denom = mixer->ss.spl_data.frequency;
@@ -735,6 +2079,9 @@ bool al_attach_sample_instance_to_mixer(ALLEGRO_SAMPLE_INSTANCE *spl,
       else
          spl->step = -1;
    }
+   spl->pending_step = spl->step;
+   spl->applied_step = spl->step;
+   spl->sinc_bank = NULL;
 
    /* Set the proper sample stream reader. */
    ASSERT(spl->spl_read == NULL);
@@ -754,6 +2101,9 @@ bool al_attach_sample_instance_to_mixer(ALLEGRO_SAMPLE_INSTANCE *spl,
                case ALLEGRO_MIXER_QUALITY_CUBIC:
                   spl->spl_read = read_to_mixer_cubic_float_32;
                   break;
+               case ALLEGRO_MIXER_QUALITY_SINC:
+                  spl->spl_read = read_to_mixer_sinc_float_32;
+                  break;
             }
             break;
 
@@ -763,6 +2113,7 @@ bool al_attach_sample_instance_to_mixer(ALLEGRO_SAMPLE_INSTANCE *spl,
                   spl->spl_read = read_to_mixer_point_int16_t_16;
                   break;
                case ALLEGRO_MIXER_QUALITY_CUBIC:
+               case ALLEGRO_MIXER_QUALITY_SINC:
                   ALLEGRO_WARN("Falling back to linear interpolation\n");
                   /* fallthrough */
                case ALLEGRO_MIXER_QUALITY_LINEAR:
@@ -781,7 +2132,15 @@ bool al_attach_sample_instance_to_mixer(ALLEGRO_SAMPLE_INSTANCE *spl,
             break;
       }
 
+      /* Compressed samples are decoded as they are read. */
+      if (adpcm_cache) {
+         spl->adpcm_cache = adpcm_cache;
+         spl->spl_read = get_adpcm_reader(mixer);
+      }
+
       _al_kcm_mixer_rejig_sample_matrix(mixer, spl);
+      apply_sample_params(spl, al_get_channel_count(spl->spl_data.chan_conf)
+         * al_get_channel_count(mixer->ss.spl_data.chan_conf));
    }
 
    spl->parent.u.mixer = mixer;
@@ -971,6 +2330,213 @@ bool al_set_mixer_quality(ALLEGRO_MIXER *mixer, ALLEGRO_MIXER_QUALITY new_qualit
 }
 
 
+/* Function: al_set_mixer_parallel
+ */
+bool al_set_mixer_parallel(ALLEGRO_MIXER *mixer, bool parallel)
+{
+   ASSERT(mixer);
+
+   maybe_lock_mutex(mixer->ss.mutex);
+   mixer->parallel = parallel;
+   maybe_unlock_mutex(mixer->ss.mutex);
+
+   return true;
+}
+
+
+/* Function: al_get_mixer_parallel
+ */
+bool al_get_mixer_parallel(const ALLEGRO_MIXER *mixer)
+{
+   ASSERT(mixer);
+
+   return mixer->parallel;
+}
+
+
+/* Makes all sample instances real again once neither limit is in use,
+ * as the mixer stops looking at the flags then.
+ */
+static void clear_virtual_flags(ALLEGRO_MIXER *mixer)
+{
+   unsigned int i;
+
+   if (mixer->max_voices > 0 || mixer->audibility_threshold > 0.0f)
+      return;
+
+   for (i = 0; i < _al_vector_size(&mixer->streams); i++) {
+      ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&mixer->streams, i);
+      (*slot)->is_virtual = false;
+   }
+}
+
+
+/* Function: al_set_mixer_max_voices
+ */
+bool al_set_mixer_max_voices(ALLEGRO_MIXER *mixer, int max_voices)
+{
+   ASSERT(mixer);
+
+   if (max_voices < 0) {
+      _al_set_error(ALLEGRO_INVALID_PARAM, "Negative voice budget");
+      return false;
+   }
+
+   maybe_lock_mutex(mixer->ss.mutex);
+   mixer->max_voices = max_voices;
+   clear_virtual_flags(mixer);
+   maybe_unlock_mutex(mixer->ss.mutex);
+
+   return true;
+}
+
+
+/* Function: al_get_mixer_max_voices
+ */
+int al_get_mixer_max_voices(const ALLEGRO_MIXER *mixer)
+{
+   ASSERT(mixer);
+
+   return mixer->max_voices;
+}
+
+
+/* Function: al_set_mixer_audibility_threshold
+ */
+bool al_set_mixer_audibility_threshold(ALLEGRO_MIXER *mixer, float gain)
+{
+   ASSERT(mixer);
+
+   if (gain < 0.0f) {
+      _al_set_error(ALLEGRO_INVALID_PARAM, "Negative audibility threshold");
+      return false;
+   }
+
+   maybe_lock_mutex(mixer->ss.mutex);
+   mixer->audibility_threshold = gain;
+   clear_virtual_flags(mixer);
+   maybe_unlock_mutex(mixer->ss.mutex);
+
+   return true;
+}
+
+
+/* Function: al_get_mixer_audibility_threshold
+ */
+float al_get_mixer_audibility_threshold(const ALLEGRO_MIXER *mixer)
+{
+   ASSERT(mixer);
+
+   return mixer->audibility_threshold;
+}
+
+
+/* _al_kcm_add_mix_time:
+ *  Records how long one read of a mixer or voice took.
+ */
+void _al_kcm_add_mix_time(_AL_AUDIO_STATS *stats, double time)
+{
+   if (stats->mix_count == 0 || time < stats->mix_time_min)
+      stats->mix_time_min = time;
+   if (time > stats->mix_time_max)
+      stats->mix_time_max = time;
+   stats->mix_time_total += time;
+   stats->mix_count++;
+}
+
+
+/* _al_kcm_mixer_sum_stats:
+ *  Adds the starved fragments and active instances of all mixers attached
+ *  to this one, recursively, to stats.  The caller holds the mixer mutex.
+ */
+void _al_kcm_mixer_sum_stats(const ALLEGRO_MIXER *mixer,
+   _AL_AUDIO_STATS *stats)
+{
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&mixer->streams); i++) {
+      ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&mixer->streams, i);
+      const ALLEGRO_MIXER *child;
+
+      if (!(*slot)->is_mixer)
+         continue;
+      child = (const ALLEGRO_MIXER *)*slot;
+      stats->starved_fragments += child->stats.starved_fragments;
+      stats->active_instances += child->stats.active_instances;
+      stats->virtual_instances += child->stats.virtual_instances;
+      _al_kcm_mixer_sum_stats(child, stats);
+   }
+}
+
+
+/* _al_kcm_mixer_reset_stats:
+ *  Resets the counters of the mixer and all mixers attached to it.
+ */
+void _al_kcm_mixer_reset_stats(ALLEGRO_MIXER *mixer)
+{
+   unsigned int active = mixer->stats.active_instances;
+   unsigned int virtuals = mixer->stats.virtual_instances;
+   unsigned int i;
+
+   memset(&mixer->stats, 0, sizeof(mixer->stats));
+   mixer->stats.active_instances = active;
+   mixer->stats.virtual_instances = virtuals;
+
+   for (i = 0; i < _al_vector_size(&mixer->streams); i++) {
+      ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&mixer->streams, i);
+      if ((*slot)->is_mixer)
+         _al_kcm_mixer_reset_stats((ALLEGRO_MIXER *)*slot);
+   }
+}
+
+
+/* _al_kcm_copy_stats:
+ *  Fills in the public statistics from the internal counters.
+ */
+void _al_kcm_copy_stats(const _AL_AUDIO_STATS *src, ALLEGRO_AUDIO_STATS *dst)
+{
+   dst->mix_count = src->mix_count;
+   dst->mix_time_min = src->mix_time_min;
+   dst->mix_time_max = src->mix_time_max;
+   dst->mix_time_avg = src->mix_count ?
+      src->mix_time_total / src->mix_count : 0.0;
+   dst->overloads = src->overloads;
+   dst->underruns = src->underruns;
+   dst->starved_fragments = src->starved_fragments;
+   dst->active_instances = src->active_instances;
+   dst->virtual_instances = src->virtual_instances;
+}
+
+
+/* Function: al_get_mixer_stats
+ */
+void al_get_mixer_stats(const ALLEGRO_MIXER *mixer, ALLEGRO_AUDIO_STATS *stats)
+{
+   _AL_AUDIO_STATS sum;
+   ASSERT(mixer);
+   ASSERT(stats);
+
+   maybe_lock_mutex(mixer->ss.mutex);
+   sum = mixer->stats;
+   _al_kcm_mixer_sum_stats(mixer, &sum);
+   maybe_unlock_mutex(mixer->ss.mutex);
+
+   _al_kcm_copy_stats(&sum, stats);
+}
+
+
+/* Function: al_reset_mixer_stats
+ */
+void al_reset_mixer_stats(ALLEGRO_MIXER *mixer)
+{
+   ASSERT(mixer);
+
+   maybe_lock_mutex(mixer->ss.mutex);
+   _al_kcm_mixer_reset_stats(mixer);
+   maybe_unlock_mutex(mixer->ss.mutex);
+}
+
+
 /* Function: al_set_mixer_gain
  */
 bool al_set_mixer_gain(ALLEGRO_MIXER *mixer, float new_gain)
@@ -43,7 +43,7 @@ static _AL_VECTOR auto_samples = _AL_VECTOR_INITIALIZER(AUTO_SAMPLE);
 
 static bool create_default_mixer(void);
 static bool do_play_sample(ALLEGRO_SAMPLE_INSTANCE *spl, ALLEGRO_SAMPLE *data,
-      float gain, float pan, float speed, ALLEGRO_PLAYMODE loop);
+      float gain, float pan, float speed, ALLEGRO_PLAYMODE loop, int priority);
 static void free_sample_vector(void);
 
 
@@ -187,6 +187,12 @@ static void stop_sample_instances_helper(void *object, void (*func)(void *),
  */
 void al_destroy_sample(ALLEGRO_SAMPLE *spl)
 {
+   if (spl && spl->cache_entry) {
+      /* The cache decides when to really destroy it. */
+      _al_kcm_release_cached_sample(spl);
+      return;
+   }
+
    if (spl) {
       _al_kcm_foreach_destructor(stop_sample_instances_helper,
          al_get_sample_data(spl));
@@ -195,6 +201,9 @@ void al_destroy_sample(ALLEGRO_SAMPLE *spl)
       if (spl->free_buf && spl->buffer.ptr) {
          al_free(spl->buffer.ptr);
       }
+      if (spl->mapping) {
+         al_fclose(spl->mapping);
+      }
       spl->buffer.ptr = NULL;
       spl->free_buf = false;
       al_free(spl);
@@ -341,10 +350,57 @@ void al_set_default_voice(ALLEGRO_VOICE *voice)
  */
 bool al_play_sample(ALLEGRO_SAMPLE *spl, float gain, float pan, float speed,
    ALLEGRO_PLAYMODE loop, ALLEGRO_SAMPLE_ID *ret_id)
+{
+   return al_play_sample_with_priority(spl, gain, pan, speed, loop, 0, ret_id);
+}
+
+
+/* Returns the index of the reserved instance to cut off for a sample of the
+ * given priority, or -1.  That is the least important playing one, if it is
+ * less important than the new sample: the one with the lowest priority,
+ * then the quietest, then the oldest.
+ */
+static int find_stolen_slot(int priority)
+{
+   AUTO_SAMPLE *best = NULL;
+   int best_index = -1;
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&auto_samples); i++) {
+      AUTO_SAMPLE *slot = _al_vector_ref(&auto_samples, i);
+      ALLEGRO_SAMPLE_INSTANCE *inst = slot->instance;
+
+      if (slot->locked || inst->priority >= priority)
+         continue;
+      if (best) {
+         ALLEGRO_SAMPLE_INSTANCE *b = best->instance;
+         if (inst->priority > b->priority)
+            continue;
+         if (inst->priority == b->priority) {
+            if (inst->gain > b->gain)
+               continue;
+            if (inst->gain == b->gain && slot->id > best->id)
+               continue;
+         }
+      }
+      best = slot;
+      best_index = i;
+   }
+
+   return best_index;
+}
+
+
+/* Function: al_play_sample_with_priority
+ */
+bool al_play_sample_with_priority(ALLEGRO_SAMPLE *spl, float gain, float pan,
+   float speed, ALLEGRO_PLAYMODE loop, int priority, ALLEGRO_SAMPLE_ID *ret_id)
 {
    static int next_id = 0;
+   AUTO_SAMPLE *slot = NULL;
+   int index = -1;
    unsigned int i;
-   
+
    ASSERT(spl);
 
    if (ret_id != NULL) {
@@ -353,27 +409,38 @@ bool al_play_sample(ALLEGRO_SAMPLE *spl, float gain, float pan, float speed,
    }
 
    for (i = 0; i < _al_vector_size(&auto_samples); i++) {
-      AUTO_SAMPLE *slot = _al_vector_ref(&auto_samples, i);
-
+      slot = _al_vector_ref(&auto_samples, i);
       if (!al_get_sample_instance_playing(slot->instance) && !slot->locked) {
-         if (!do_play_sample(slot->instance, spl, gain, pan, speed, loop))
-            break;
+         index = i;
+         break;
+      }
+   }
 
-         if (ret_id != NULL) {
-            ret_id->_index = (int) i;
-            ret_id->_id = slot->id = ++next_id;
-         }
+   if (index < 0) {
+      index = find_stolen_slot(priority);
+      if (index < 0)
+         return false;
+      slot = _al_vector_ref(&auto_samples, index);
+      ALLEGRO_DEBUG("Stopping sample %d for one of priority %d.\n",
+         slot->id, priority);
+      al_stop_sample_instance(slot->instance);
+   }
 
-         return true;
-      }
+   if (!do_play_sample(slot->instance, spl, gain, pan, speed, loop, priority))
+      return false;
+
+   if (ret_id != NULL) {
+      ret_id->_index = index;
+      ret_id->_id = slot->id = ++next_id;
    }
 
-   return false;
+   return true;
 }
 
 
 static bool do_play_sample(ALLEGRO_SAMPLE_INSTANCE *splinst,
-   ALLEGRO_SAMPLE *spl, float gain, float pan, float speed, ALLEGRO_PLAYMODE loop)
+   ALLEGRO_SAMPLE *spl, float gain, float pan, float speed, ALLEGRO_PLAYMODE loop,
+   int priority)
 {
    if (!al_set_sample(splinst, spl)) {
       ALLEGRO_ERROR("al_set_sample failed\n");
@@ -383,7 +450,8 @@ static bool do_play_sample(ALLEGRO_SAMPLE_INSTANCE *splinst,
    if (!al_set_sample_instance_gain(splinst, gain) ||
          !al_set_sample_instance_pan(splinst, pan) ||
          !al_set_sample_instance_speed(splinst, speed) ||
-         !al_set_sample_instance_playmode(splinst, loop)) {
+         !al_set_sample_instance_playmode(splinst, loop) ||
+         !al_set_sample_instance_priority(splinst, priority)) {
       return false;
    }
 
@@ -0,0 +1,824 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Cache of decoded samples with a memory budget.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+/* Title: Sample cache
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_audio.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_audio.h"
+
+ALLEGRO_DEBUG_CHANNEL("audio")
+
+
+/* Every file that has been asked for gets an entry, found through a hash
+ * table keyed by its path.  An entry holds the decoded sample, the file
+ * contents as they are on disk, both or neither.
+ *
+ * Entries that nobody holds a reference to, but that still use memory, are
+ * in the LRU list, least recently released first.  Eviction drops the
+ * decoded samples of those first, and the compressed data after that.
+ */
+typedef struct CACHE_ENTRY CACHE_ENTRY;
+
+struct CACHE_ENTRY
+{
+   ALLEGRO_SAMPLE_CACHE *cache;
+   char *path;
+   uint32_t hash;
+   CACHE_ENTRY *next_in_bucket;
+
+   /* The identity of the file that was loaded. */
+   off_t file_size;
+   time_t file_mtime;
+
+   ALLEGRO_SAMPLE *sample;
+   size_t sample_bytes;
+   void *compressed;
+   size_t compressed_bytes;
+
+   int refs;
+   bool loading;
+   bool stale;          /* Replaced by a newer version of the file. */
+   CACHE_ENTRY *lru_prev;
+   CACHE_ENTRY *lru_next;
+   bool in_lru;
+};
+
+struct ALLEGRO_SAMPLE_CACHE
+{
+   ALLEGRO_MUTEX *mutex;
+   ALLEGRO_COND *loaded_cond;
+   int flags;
+   size_t budget;
+   size_t used;
+
+   CACHE_ENTRY **buckets;
+   unsigned int num_buckets;     /* Power of two. */
+   unsigned int num_entries;
+
+   CACHE_ENTRY *lru_head;
+   CACHE_ENTRY *lru_tail;
+
+   CACHE_ENTRY *stale_entries;   /* Linked through next_in_bucket. */
+
+   _AL_DTOR_ITEM *dtor_item;
+};
+
+
+#define INITIAL_BUCKETS 64
+
+
+static uint32_t hash_path(const char *path)
+{
+   uint32_t h = 2166136261u;
+
+   while (*path) {
+      h ^= (unsigned char)*path++;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+static void lru_remove(ALLEGRO_SAMPLE_CACHE *cache, CACHE_ENTRY *e)
+{
+   if (!e->in_lru)
+      return;
+   if (e->lru_prev)
+      e->lru_prev->lru_next = e->lru_next;
+   else
+      cache->lru_head = e->lru_next;
+   if (e->lru_next)
+      e->lru_next->lru_prev = e->lru_prev;
+   else
+      cache->lru_tail = e->lru_prev;
+   e->lru_prev = e->lru_next = NULL;
+   e->in_lru = false;
+}
+
+
+static void lru_append(ALLEGRO_SAMPLE_CACHE *cache, CACHE_ENTRY *e)
+{
+   ASSERT(!e->in_lru);
+   e->lru_prev = cache->lru_tail;
+   e->lru_next = NULL;
+   if (cache->lru_tail)
+      cache->lru_tail->lru_next = e;
+   else
+      cache->lru_head = e;
+   cache->lru_tail = e;
+   e->in_lru = true;
+}
+
+
+static CACHE_ENTRY *find_entry(ALLEGRO_SAMPLE_CACHE *cache, const char *path,
+   uint32_t hash)
+{
+   CACHE_ENTRY *e = cache->buckets[hash & (cache->num_buckets - 1)];
+
+   for (; e; e = e->next_in_bucket) {
+      if (e->hash == hash && !strcmp(e->path, path))
+         return e;
+   }
+   return NULL;
+}
+
+
+static void grow_table(ALLEGRO_SAMPLE_CACHE *cache)
+{
+   unsigned int n = cache->num_buckets * 2;
+   CACHE_ENTRY **buckets = al_calloc(n, sizeof *buckets);
+   unsigned int i;
+
+   /* Not fatal, the chains just get longer. */
+   if (!buckets)
+      return;
+
+   for (i = 0; i < cache->num_buckets; i++) {
+      CACHE_ENTRY *e = cache->buckets[i];
+      while (e) {
+         CACHE_ENTRY *next = e->next_in_bucket;
+         e->next_in_bucket = buckets[e->hash & (n - 1)];
+         buckets[e->hash & (n - 1)] = e;
+         e = next;
+      }
+   }
+
+   al_free(cache->buckets);
+   cache->buckets = buckets;
+   cache->num_buckets = n;
+}
+
+
+static void unlink_entry(ALLEGRO_SAMPLE_CACHE *cache, CACHE_ENTRY *e)
+{
+   CACHE_ENTRY **p = &cache->buckets[e->hash & (cache->num_buckets - 1)];
+
+   while (*p) {
+      if (*p == e) {
+         *p = e->next_in_bucket;
+         cache->num_entries--;
+         break;
+      }
+      p = &(*p)->next_in_bucket;
+   }
+   e->next_in_bucket = NULL;
+}
+
+
+static void drop_sample(ALLEGRO_SAMPLE_CACHE *cache, CACHE_ENTRY *e)
+{
+   if (e->sample) {
+      e->sample->cache_entry = NULL;
+      al_destroy_sample(e->sample);
+      e->sample = NULL;
+      cache->used -= e->sample_bytes;
+      e->sample_bytes = 0;
+   }
+}
+
+
+static void drop_compressed(ALLEGRO_SAMPLE_CACHE *cache, CACHE_ENTRY *e)
+{
+   if (e->compressed) {
+      al_free(e->compressed);
+      e->compressed = NULL;
+      cache->used -= e->compressed_bytes;
+      e->compressed_bytes = 0;
+   }
+}
+
+
+static void free_entry(ALLEGRO_SAMPLE_CACHE *cache, CACHE_ENTRY *e)
+{
+   if (e->stale) {
+      CACHE_ENTRY **p = &cache->stale_entries;
+      while (*p != e)
+         p = &(*p)->next_in_bucket;
+      *p = e->next_in_bucket;
+   }
+   lru_remove(cache, e);
+   drop_sample(cache, e);
+   drop_compressed(cache, e);
+   al_free(e->path);
+   al_free(e);
+}
+
+
+/* Called whenever an entry loses its last reference or its memory use
+ * changes while it has none.
+ */
+static void entry_released(ALLEGRO_SAMPLE_CACHE *cache, CACHE_ENTRY *e)
+{
+   ASSERT(e->refs == 0);
+
+   if (e->stale) {
+      free_entry(cache, e);
+      return;
+   }
+
+   lru_remove(cache, e);
+   if (e->sample || e->compressed)
+      lru_append(cache, e);
+}
+
+
+/* Evicts unreferenced entries until the cache is within its budget, or
+ * there is nothing left to evict.
+ */
+static void enforce_budget(ALLEGRO_SAMPLE_CACHE *cache)
+{
+   CACHE_ENTRY *e;
+
+   /* Decoded samples go first.  Entries which keep their compressed data
+    * can be decoded again without touching the disk.
+    */
+   e = cache->lru_head;
+   while (e && cache->used > cache->budget) {
+      CACHE_ENTRY *next = e->lru_next;
+      if (e->sample) {
+         ALLEGRO_DEBUG("Evicting decoded %s\n", e->path);
+         drop_sample(cache, e);
+         if (!e->compressed)
+            lru_remove(cache, e);
+      }
+      e = next;
+   }
+
+   e = cache->lru_head;
+   while (e && cache->used > cache->budget) {
+      CACHE_ENTRY *next = e->lru_next;
+      ALLEGRO_DEBUG("Evicting compressed %s\n", e->path);
+      drop_compressed(cache, e);
+      lru_remove(cache, e);
+      e = next;
+   }
+}
+
+
+/* A read-only ALLEGRO_FILE reading from the compressed data of an entry. */
+typedef struct MEMORY_FILE
+{
+   const char *data;
+   int64_t size;
+   int64_t pos;
+   bool eof;
+} MEMORY_FILE;
+
+
+static bool mf_fclose(ALLEGRO_FILE *f)
+{
+   al_free(al_get_file_userdata(f));
+   return true;
+}
+
+
+static size_t mf_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   size_t n = size;
+
+   if ((int64_t)n > mf->size - mf->pos) {
+      n = (size_t)(mf->size - mf->pos);
+      mf->eof = true;
+   }
+   memcpy(ptr, mf->data + mf->pos, n);
+   mf->pos += n;
+   return n;
+}
+
+
+static size_t mf_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
+{
+   (void)f;
+   (void)ptr;
+   (void)size;
+   return 0;
+}
+
+
+static bool mf_fflush(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return true;
+}
+
+
+static int64_t mf_ftell(ALLEGRO_FILE *f)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   return mf->pos;
+}
+
+
+static bool mf_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   int64_t pos;
+
+   switch (whence) {
+      case ALLEGRO_SEEK_SET: pos = offset; break;
+      case ALLEGRO_SEEK_CUR: pos = mf->pos + offset; break;
+      case ALLEGRO_SEEK_END: pos = mf->size + offset; break;
+      default: return false;
+   }
+   if (pos < 0 || pos > mf->size)
+      return false;
+   mf->pos = pos;
+   mf->eof = false;
+   return true;
+}
+
+
+static bool mf_feof(ALLEGRO_FILE *f)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   return mf->eof;
+}
+
+
+static int mf_ferror(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return 0;
+}
+
+
+static const char *mf_ferrmsg(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return "";
+}
+
+
+static void mf_fclearerr(ALLEGRO_FILE *f)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   mf->eof = false;
+}
+
+
+static int mf_fungetc(ALLEGRO_FILE *f, int c)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+
+   if (mf->pos <= 0)
+      return -1;
+   mf->pos--;
+   mf->eof = false;
+   return c;
+}
+
+
+static off_t mf_fsize(ALLEGRO_FILE *f)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   return (off_t)mf->size;
+}
+
+
+static const ALLEGRO_FILE_INTERFACE memory_file_vtable =
+{
+   NULL,
+   mf_fclose,
+   mf_fread,
+   mf_fwrite,
+   mf_fflush,
+   mf_ftell,
+   mf_fseek,
+   mf_feof,
+   mf_ferror,
+   mf_ferrmsg,
+   mf_fclearerr,
+   mf_fungetc,
+   mf_fsize
+};
+
+
+static ALLEGRO_SAMPLE *decode_compressed(const char *path,
+   const void *data, size_t size)
+{
+   MEMORY_FILE *mf;
+   ALLEGRO_FILE *fp;
+   ALLEGRO_SAMPLE *spl;
+   const char *ext = strrchr(path, '.');
+
+   if (!ext) {
+      ALLEGRO_ERROR("Unable to determine extension for %s.\n", path);
+      return NULL;
+   }
+
+   mf = al_calloc(1, sizeof *mf);
+   if (!mf)
+      return NULL;
+   mf->data = data;
+   mf->size = size;
+
+   fp = al_create_file_handle(&memory_file_vtable, mf);
+   if (!fp) {
+      al_free(mf);
+      return NULL;
+   }
+
+   spl = al_load_sample_f(fp, ext);
+   al_fclose(fp);
+   return spl;
+}
+
+
+static void *read_whole_file(const char *path, size_t *ret_size)
+{
+   ALLEGRO_FILE *fp;
+   int64_t size;
+   void *data;
+
+   fp = al_fopen(path, "rb");
+   if (!fp)
+      return NULL;
+
+   size = al_fsize(fp);
+   if (size < 0) {
+      al_fclose(fp);
+      return NULL;
+   }
+
+   data = al_malloc(size > 0 ? (size_t)size : 1);
+   if (data && al_fread(fp, data, (size_t)size) != (size_t)size) {
+      al_free(data);
+      data = NULL;
+   }
+   al_fclose(fp);
+
+   *ret_size = (size_t)size;
+   return data;
+}
+
+
+static size_t sample_bytes(ALLEGRO_SAMPLE *spl)
+{
+   if (spl->block_align) {
+      return (size_t)((spl->len + spl->block_frames - 1) / spl->block_frames) *
+         spl->block_align;
+   }
+   return (size_t)spl->len * al_get_channel_count(spl->chan_conf) *
+      al_get_audio_depth_size(spl->depth);
+}
+
+
+static void get_file_identity(const char *path, off_t *size, time_t *mtime)
+{
+   ALLEGRO_FS_ENTRY *fse = al_create_fs_entry(path);
+
+   *size = -1;
+   *mtime = 0;
+   if (fse) {
+      if (al_fs_entry_exists(fse)) {
+         *size = al_get_fs_entry_size(fse);
+         *mtime = al_get_fs_entry_mtime(fse);
+      }
+      al_destroy_fs_entry(fse);
+   }
+}
+
+
+/* Looks up the entry for path, creating it if necessary, and adds a
+ * reference to it.  If the file on disk is no longer the one the entry was
+ * made from, a new entry replaces it.  Must be called with the mutex held.
+ */
+static CACHE_ENTRY *acquire_entry(ALLEGRO_SAMPLE_CACHE *cache,
+   const char *path)
+{
+   uint32_t hash = hash_path(path);
+   CACHE_ENTRY *e = find_entry(cache, path, hash);
+
+   /* The identity is only checked when the file might have to be read
+    * again, so that getting a resident sample never touches the disk.
+    */
+   if (e && !e->sample && !e->loading) {
+      off_t size;
+      time_t mtime;
+
+      get_file_identity(path, &size, &mtime);
+      if (size != e->file_size || mtime != e->file_mtime) {
+         ALLEGRO_DEBUG("%s changed on disk\n", path);
+         unlink_entry(cache, e);
+         if (e->refs == 0) {
+            free_entry(cache, e);
+         }
+         else {
+            drop_compressed(cache, e);
+            e->stale = true;
+            e->next_in_bucket = cache->stale_entries;
+            cache->stale_entries = e;
+         }
+         e = NULL;
+      }
+   }
+
+   if (!e) {
+      e = al_calloc(1, sizeof *e);
+      if (!e)
+         return NULL;
+      e->path = al_malloc(strlen(path) + 1);
+      if (!e->path) {
+         al_free(e);
+         return NULL;
+      }
+      strcpy(e->path, path);
+      e->cache = cache;
+      e->hash = hash;
+      get_file_identity(path, &e->file_size, &e->file_mtime);
+
+      if (cache->num_entries >= cache->num_buckets * 2)
+         grow_table(cache);
+      e->next_in_bucket = cache->buckets[hash & (cache->num_buckets - 1)];
+      cache->buckets[hash & (cache->num_buckets - 1)] = e;
+      cache->num_entries++;
+   }
+
+   e->refs++;
+   lru_remove(cache, e);
+   return e;
+}
+
+
+static void release_entry(ALLEGRO_SAMPLE_CACHE *cache, CACHE_ENTRY *e)
+{
+   ASSERT(e->refs > 0);
+   if (--e->refs == 0) {
+      entry_released(cache, e);
+      enforce_budget(cache);
+   }
+}
+
+
+/* Makes sure the entry has its compressed data, and its decoded sample if
+ * decode is true.  The mutex is released while the file is read and
+ * decoded, other threads wanting the same entry wait for that.
+ */
+static bool load_entry(ALLEGRO_SAMPLE_CACHE *cache, CACHE_ENTRY *e,
+   bool decode)
+{
+   bool keep_compressed = cache->flags & ALLEGRO_SAMPLE_CACHE_KEEP_COMPRESSED;
+   ALLEGRO_SAMPLE *spl = NULL;
+   void *data = NULL;
+   size_t size = 0;
+
+   if (!keep_compressed)
+      decode = true;
+
+   while (e->loading)
+      al_wait_cond(cache->loaded_cond, cache->mutex);
+
+   if (e->sample || (!decode && e->compressed))
+      return true;
+
+   e->loading = true;
+   al_unlock_mutex(cache->mutex);
+
+   if (e->compressed) {
+      /* Only this thread touches the data while loading is set. */
+      spl = decode_compressed(e->path, e->compressed, e->compressed_bytes);
+   }
+   else if (keep_compressed) {
+      data = read_whole_file(e->path, &size);
+      if (data && decode)
+         spl = decode_compressed(e->path, data, size);
+   }
+   else {
+      spl = al_load_sample(e->path);
+   }
+
+   if (spl) {
+      /* The cache destroys the sample, not the audio addon shutdown. */
+      _al_kcm_unregister_destructor(spl->dtor_item);
+      spl->dtor_item = NULL;
+      spl->cache_entry = e;
+   }
+
+   al_lock_mutex(cache->mutex);
+   e->loading = false;
+   al_broadcast_cond(cache->loaded_cond);
+
+   if (data) {
+      e->compressed = data;
+      e->compressed_bytes = size;
+      cache->used += size;
+   }
+   if (spl) {
+      e->sample = spl;
+      e->sample_bytes = sample_bytes(spl);
+      cache->used += e->sample_bytes;
+   }
+
+   if (!e->sample && !e->compressed) {
+      ALLEGRO_ERROR("Could not load %s\n", e->path);
+      return false;
+   }
+   if (decode && !e->sample) {
+      ALLEGRO_ERROR("Could not decode %s\n", e->path);
+      return false;
+   }
+   return true;
+}
+
+
+/* Function: al_create_sample_cache
+ */
+ALLEGRO_SAMPLE_CACHE *al_create_sample_cache(size_t budget, int flags)
+{
+   ALLEGRO_SAMPLE_CACHE *cache;
+
+   cache = al_calloc(1, sizeof *cache);
+   if (!cache) {
+      _al_set_error(ALLEGRO_GENERIC_ERROR,
+         "Out of memory allocating sample cache");
+      return NULL;
+   }
+
+   cache->mutex = al_create_mutex();
+   cache->loaded_cond = al_create_cond();
+   cache->buckets = al_calloc(INITIAL_BUCKETS, sizeof *cache->buckets);
+   if (!cache->mutex || !cache->loaded_cond || !cache->buckets) {
+      _al_set_error(ALLEGRO_GENERIC_ERROR,
+         "Out of memory allocating sample cache");
+      al_destroy_mutex(cache->mutex);
+      al_destroy_cond(cache->loaded_cond);
+      al_free(cache->buckets);
+      al_free(cache);
+      return NULL;
+   }
+   cache->num_buckets = INITIAL_BUCKETS;
+   cache->flags = flags;
+   cache->budget = budget;
+
+   cache->dtor_item = _al_kcm_register_destructor("sample_cache", cache,
+      (void (*)(void *)) al_destroy_sample_cache);
+
+   return cache;
+}
+
+
+/* Function: al_destroy_sample_cache
+ */
+void al_destroy_sample_cache(ALLEGRO_SAMPLE_CACHE *cache)
+{
+   unsigned int i;
+
+   if (!cache)
+      return;
+
+   _al_kcm_unregister_destructor(cache->dtor_item);
+
+   for (i = 0; i < cache->num_buckets; i++) {
+      CACHE_ENTRY *e = cache->buckets[i];
+      while (e) {
+         CACHE_ENTRY *next = e->next_in_bucket;
+         ASSERT(!e->loading);
+         if (e->refs > 0)
+            ALLEGRO_WARN("%s is still referenced\n", e->path);
+         free_entry(cache, e);
+         e = next;
+      }
+   }
+
+   while (cache->stale_entries) {
+      ALLEGRO_WARN("%s is still referenced\n", cache->stale_entries->path);
+      free_entry(cache, cache->stale_entries);
+   }
+   ASSERT(cache->used == 0);
+
+   al_free(cache->buckets);
+   al_destroy_cond(cache->loaded_cond);
+   al_destroy_mutex(cache->mutex);
+   al_free(cache);
+}
+
+
+/* Function: al_get_cached_sample
+ */
+ALLEGRO_SAMPLE *al_get_cached_sample(ALLEGRO_SAMPLE_CACHE *cache,
+   const char *filename)
+{
+   CACHE_ENTRY *e;
+   ALLEGRO_SAMPLE *spl = NULL;
+   ASSERT(cache);
+   ASSERT(filename);
+
+   al_lock_mutex(cache->mutex);
+   e = acquire_entry(cache, filename);
+   if (e) {
+      if (load_entry(cache, e, true)) {
+         spl = e->sample;
+         enforce_budget(cache);
+      }
+      else {
+         release_entry(cache, e);
+      }
+   }
+   al_unlock_mutex(cache->mutex);
+
+   return spl;
+}
+
+
+/* Function: al_preload_cached_sample
+ */
+bool al_preload_cached_sample(ALLEGRO_SAMPLE_CACHE *cache,
+   const char *filename)
+{
+   CACHE_ENTRY *e;
+   bool ret = false;
+   ASSERT(cache);
+   ASSERT(filename);
+
+   al_lock_mutex(cache->mutex);
+   e = acquire_entry(cache, filename);
+   if (e) {
+      ret = load_entry(cache, e, false);
+      release_entry(cache, e);
+   }
+   al_unlock_mutex(cache->mutex);
+
+   return ret;
+}
+
+
+/* Internal function: _al_kcm_release_cached_sample
+ *  Drops the reference to a sample handed out by al_get_cached_sample.
+ */
+void _al_kcm_release_cached_sample(ALLEGRO_SAMPLE *spl)
+{
+   CACHE_ENTRY *e = spl->cache_entry;
+   ALLEGRO_SAMPLE_CACHE *cache = e->cache;
+
+   al_lock_mutex(cache->mutex);
+   release_entry(cache, e);
+   al_unlock_mutex(cache->mutex);
+}
+
+
+/* Function: al_release_cached_sample
+ */
+void al_release_cached_sample(ALLEGRO_SAMPLE *spl)
+{
+   if (spl) {
+      ASSERT(spl->cache_entry);
+      _al_kcm_release_cached_sample(spl);
+   }
+}
+
+
+/* Function: al_set_sample_cache_budget
+ */
+void al_set_sample_cache_budget(ALLEGRO_SAMPLE_CACHE *cache, size_t budget)
+{
+   ASSERT(cache);
+
+   al_lock_mutex(cache->mutex);
+   cache->budget = budget;
+   enforce_budget(cache);
+   al_unlock_mutex(cache->mutex);
+}
+
+
+/* Function: al_get_sample_cache_budget
+ */
+size_t al_get_sample_cache_budget(ALLEGRO_SAMPLE_CACHE *cache)
+{
+   ASSERT(cache);
+
+   return cache->budget;
+}
+
+
+/* Function: al_get_sample_cache_size
+ */
+size_t al_get_sample_cache_size(ALLEGRO_SAMPLE_CACHE *cache)
+{
+   size_t used;
+   ASSERT(cache);
+
+   al_lock_mutex(cache->mutex);
+   used = cache->used;
+   al_unlock_mutex(cache->mutex);
+
+   return used;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -17,11 +17,11 @@
 ALLEGRO_DEBUG_CHANNEL("audio")
 
 /*
- * The highest quality interpolator is a cubic interpolator requiring
- * four sample points.  In the streaming case we lag the true sample
- * position by three.
+ * The cubic interpolator requires four sample points, and the sinc
+ * interpolator sixteen.  In the streaming case we lag the true sample
+ * position by three and fifteen, respectively.
  */
-#define MAX_LAG   (3)
+#define MAX_LAG   (16)
 
 
 /*
@@ -91,6 +91,7 @@ ALLEGRO_AUDIO_STREAM *al_create_audio_stream(size_t fragment_count,
    stream->spl.spl_data.frequency = freq;
    stream->spl.speed     = 1.0f;
    stream->spl.gain      = 1.0f;
+   stream->spl.fade      = 1.0f;
    stream->spl.pan       = 0.0f;
 
    stream->spl.step = 0;
@@ -145,7 +146,7 @@ ALLEGRO_AUDIO_STREAM *al_create_audio_stream(size_t fragment_count,
 void al_destroy_audio_stream(ALLEGRO_AUDIO_STREAM *stream)
 {
    if (stream) {
-      if (stream->feed_thread) {
+      if (stream->unload_feeder) {
          stream->unload_feeder(stream);
       }
       /* See commented out call to _al_kcm_register_destructor. */
@@ -153,6 +154,7 @@ void al_destroy_audio_stream(ALLEGRO_AUDIO_STREAM *stream)
       _al_kcm_detach_from_parent(&stream->spl);
 
       al_destroy_user_event_source(&stream->spl.es);
+      al_free(stream->loop_cache);
       al_free(stream->main_buffer);
       al_free(stream->used_bufs);
       al_free(stream);
@@ -376,17 +378,14 @@ bool al_set_audio_stream_speed(ALLEGRO_AUDIO_STREAM *stream, float val)
 
    stream->spl.speed = val;
    if (stream->spl.parent.u.mixer) {
-      ALLEGRO_MIXER *mixer = stream->spl.parent.u.mixer;
-      ALLEGRO_MUTEX *stream_mutex = maybe_lock_mutex(stream->spl.mutex);
+      int step = (stream->spl.spl_data.frequency) * stream->spl.speed;
 
-      stream->spl.step = (stream->spl.spl_data.frequency) * stream->spl.speed;
-      stream->spl.step_denom = mixer->ss.spl_data.frequency;
       /* Don't wanna be trapped with a step value of 0 */
-      if (stream->spl.step == 0) {
-         stream->spl.step = 1;
+      if (step == 0) {
+         step = 1;
       }
 
-      maybe_unlock_mutex(stream_mutex);
+      _al_kcm_mixer_set_sample_step(&stream->spl, step);
    }
 
    return true;
@@ -412,10 +411,8 @@ bool al_set_audio_stream_gain(ALLEGRO_AUDIO_STREAM *stream, float val)
        * matrix to take into account the gain.
        */
       if (stream->spl.parent.u.mixer) {
-         ALLEGRO_MIXER *mixer = stream->spl.parent.u.mixer;
-         ALLEGRO_MUTEX *stream_mutex = maybe_lock_mutex(stream->spl.mutex);
-         _al_kcm_mixer_rejig_sample_matrix(mixer, &stream->spl);
-         maybe_unlock_mutex(stream_mutex);
+         _al_kcm_mixer_rejig_sample_matrix(stream->spl.parent.u.mixer,
+            &stream->spl);
       }
    }
 
@@ -446,10 +443,8 @@ bool al_set_audio_stream_pan(ALLEGRO_AUDIO_STREAM *stream, float val)
        * matrix to take into account the panning.
        */
       if (stream->spl.parent.u.mixer) {
-         ALLEGRO_MIXER *mixer = stream->spl.parent.u.mixer;
-         ALLEGRO_MUTEX *stream_mutex = maybe_lock_mutex(stream->spl.mutex);
-         _al_kcm_mixer_rejig_sample_matrix(mixer, &stream->spl);
-         maybe_unlock_mutex(stream_mutex);
+         _al_kcm_mixer_rejig_sample_matrix(stream->spl.parent.u.mixer,
+            &stream->spl);
       }
    }
 
@@ -605,6 +600,20 @@ bool al_set_audio_stream_fragment(ALLEGRO_AUDIO_STREAM *stream, void *val)
 }
 
 
+/* Adds a dry spell of the stream to the statistics of its parent. */
+static void count_starved_fragment(ALLEGRO_AUDIO_STREAM *stream)
+{
+   sample_parent_t *parent = &stream->spl.parent;
+
+   if (!parent->u.ptr)
+      return;
+   if (parent->is_voice)
+      parent->u.voice->stats.starved_fragments++;
+   else
+      parent->u.mixer->stats.starved_fragments++;
+}
+
+
 /* _al_kcm_refill_stream:
  *  Called by the mixer when the current buffer has been used up.  It should
  *  point to the next pending buffer and adjust the sample position to reflect
@@ -641,9 +650,14 @@ bool _al_kcm_refill_stream(ALLEGRO_AUDIO_STREAM *stream)
    new_buf = stream->pending_bufs[0];
    stream->spl.spl_data.buffer.ptr = new_buf;
    if (!new_buf) {
+      if (!stream->is_draining && !stream->starved) {
+         stream->starved = true;
+         count_starved_fragment(stream);
+      }
       ALLEGRO_WARN("Out of buffers\n");
       return false;
    }
+   stream->starved = false;
 
    /* Copy the last MAX_LAG sample values to the front of the new buffer
     * for interpolation.
@@ -667,118 +681,6 @@ bool _al_kcm_refill_stream(ALLEGRO_AUDIO_STREAM *stream)
 }
 
 
-/* _al_kcm_feed_stream:
- * A routine running in another thread that feeds the stream buffers as
- * necessary, usually getting data from some file reader backend.
- */
-void *_al_kcm_feed_stream(ALLEGRO_THREAD *self, void *vstream)
-{
-   ALLEGRO_AUDIO_STREAM *stream = vstream;
-   ALLEGRO_EVENT_QUEUE *queue;
-   bool finished_event_sent = false;
-   (void)self;
-
-   ALLEGRO_DEBUG("Stream feeder thread started.\n");
-
-   queue = al_create_event_queue();
-   al_register_event_source(queue, &stream->spl.es);
-
-   al_lock_mutex(stream->feed_thread_started_mutex);
-   stream->feed_thread_started = true;
-   al_broadcast_cond(stream->feed_thread_started_cond);
-   al_unlock_mutex(stream->feed_thread_started_mutex);
-
-   stream->quit_feed_thread = false;
-
-   while (!stream->quit_feed_thread) {
-      char *fragment;
-      ALLEGRO_EVENT event;
-
-      al_wait_for_event(queue, &event);
-
-      if (event.type == ALLEGRO_EVENT_AUDIO_STREAM_FRAGMENT
-          && !stream->is_draining) {
-         unsigned long bytes;
-         unsigned long bytes_written;
-         ALLEGRO_MUTEX *stream_mutex;
-
-         fragment = al_get_audio_stream_fragment(stream);
-         if (!fragment) {
-            /* This is not an error. */
-            continue;
-         }
-
-         bytes = (stream->spl.spl_data.len) *
-               al_get_channel_count(stream->spl.spl_data.chan_conf) *
-               al_get_audio_depth_size(stream->spl.spl_data.depth);
-
-         stream_mutex = maybe_lock_mutex(stream->spl.mutex);
-         bytes_written = stream->feeder(stream, fragment, bytes);
-         maybe_unlock_mutex(stream_mutex);
-
-         if (stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR) {
-            /* Keep rewinding until the fragment is filled. */
-            while (bytes_written < bytes &&
-                     stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR) {
-               size_t bw;
-               al_rewind_audio_stream(stream);
-               stream_mutex = maybe_lock_mutex(stream->spl.mutex);
-               bw = stream->feeder(stream, fragment + bytes_written,
-                  bytes - bytes_written);
-               bytes_written += bw;
-               maybe_unlock_mutex(stream_mutex);
-            }
-         }
-         else if (bytes_written < bytes) {
-            /* Fill the rest of the fragment with silence. */
-            int silence_samples = (bytes - bytes_written) /
-               (al_get_channel_count(stream->spl.spl_data.chan_conf) *
-                al_get_audio_depth_size(stream->spl.spl_data.depth));
-            al_fill_silence(fragment + bytes_written, silence_samples,
-                            stream->spl.spl_data.depth, stream->spl.spl_data.chan_conf);
-         }
-
-         if (!al_set_audio_stream_fragment(stream, fragment)) {
-            ALLEGRO_ERROR("Error setting stream buffer.\n");
-            continue;
-         }
-
-         /* The streaming source doesn't feed any more, so drain buffers.
-          * Don't quit in case the user decides to seek and then restart the
-          * stream. */
-         if (bytes_written != bytes &&
-            stream->spl.loop == _ALLEGRO_PLAYMODE_STREAM_ONCE) {
-            al_drain_audio_stream(stream);
-
-            if (!finished_event_sent) {
-               ALLEGRO_EVENT fin_event;
-               fin_event.user.type = ALLEGRO_EVENT_AUDIO_STREAM_FINISHED;
-               fin_event.user.timestamp = al_get_time();
-               al_emit_user_event(&stream->spl.es, &fin_event, NULL);
-               finished_event_sent = true;
-            }
-         } else {
-            finished_event_sent = false;
-         }
-      }
-      else if (event.type == _KCM_STREAM_FEEDER_QUIT_EVENT_TYPE) {
-         ALLEGRO_EVENT fin_event;
-         stream->quit_feed_thread = true;
-
-         fin_event.user.type = ALLEGRO_EVENT_AUDIO_STREAM_FINISHED;
-         fin_event.user.timestamp = al_get_time();
-         al_emit_user_event(&stream->spl.es, &fin_event, NULL);
-      }
-   }
-
-   al_destroy_event_queue(queue);
-
-   ALLEGRO_DEBUG("Stream feeder thread finished.\n");
-
-   return NULL;
-}
-
-
 void _al_kcm_emit_stream_events(ALLEGRO_AUDIO_STREAM *stream)
 {
    /* Emit one event for each stream fragment available right now.
@@ -812,6 +714,7 @@ bool al_rewind_audio_stream(ALLEGRO_AUDIO_STREAM *stream)
    if (stream->rewind_feeder) {
       ALLEGRO_MUTEX *stream_mutex = maybe_lock_mutex(stream->spl.mutex);
       ret = stream->rewind_feeder(stream);
+      _al_kcm_drop_loop_cache_rest(stream);
       maybe_unlock_mutex(stream_mutex);
       return ret;
    }
@@ -829,6 +732,7 @@ bool al_seek_audio_stream_secs(ALLEGRO_AUDIO_STREAM *stream, double time)
    if (stream->seek_feeder) {
       ALLEGRO_MUTEX *stream_mutex = maybe_lock_mutex(stream->spl.mutex);
       ret = stream->seek_feeder(stream, time);
+      _al_kcm_drop_loop_cache_rest(stream);
       maybe_unlock_mutex(stream_mutex);
       return ret;
    }
@@ -884,6 +788,11 @@ bool al_set_audio_stream_loop_secs(ALLEGRO_AUDIO_STREAM *stream,
    if (stream->set_feeder_loop) {
       ALLEGRO_MUTEX *stream_mutex = maybe_lock_mutex(stream->spl.mutex);
       ret = stream->set_feeder_loop(stream, start, end);
+      if (ret) {
+         stream->loop_start = start;
+         stream->loop_cache_valid = false;
+         _al_kcm_drop_loop_cache_rest(stream);
+      }
       maybe_unlock_mutex(stream_mutex);
       return ret;
    }
@@ -892,6 +801,38 @@ bool al_set_audio_stream_loop_secs(ALLEGRO_AUDIO_STREAM *stream,
 }
 
 
+/* Function: al_fade_audio_stream
+ */
+bool al_fade_audio_stream(ALLEGRO_AUDIO_STREAM *stream, float gain,
+   double seconds, bool stop)
+{
+   ASSERT(stream);
+
+   if (gain < 0.0f) {
+      _al_set_error(ALLEGRO_INVALID_PARAM, "Negative fade gain");
+      return false;
+   }
+   return _al_kcm_fade_sample_instance(&stream->spl, -1.0f, gain, seconds,
+      stop);
+}
+
+
+/* Function: al_crossfade_audio_streams
+ */
+bool al_crossfade_audio_streams(ALLEGRO_AUDIO_STREAM *from,
+   ALLEGRO_AUDIO_STREAM *to, double seconds)
+{
+   ASSERT(from);
+   ASSERT(to);
+
+   if (!_al_kcm_fade_sample_instance(&to->spl, 0.0f, 1.0f, seconds, false))
+      return false;
+   if (!_al_kcm_fade_sample_instance(&from->spl, -1.0f, 0.0f, seconds, true))
+      return false;
+   return al_set_audio_stream_playing(to, true);
+}
+
+
 /* Function: al_get_audio_stream_event_source
  */
 ALLEGRO_EVENT_SOURCE *al_get_audio_stream_event_source(
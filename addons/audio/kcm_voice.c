@@ -17,12 +17,55 @@
 ALLEGRO_DEBUG_CHANNEL("audio")
 
 
+/* Flags for new voices. The audio addon is usually driven from a single
+ * thread, so unlike the new bitmap flags this is not thread local.
+ */
+static int new_voice_flags = 0;
+
+/* Overload events are emitted at most this often per voice, in seconds. */
+#define OVERLOAD_EVENT_INTERVAL   1.0
+
+#define DEFAULT_OVERLOAD_THRESHOLD   0.8
+
+
 /* forward declarations */
 static void stream_read(void *source, void **vbuf, unsigned int *samples,
    ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc);
 
 
 
+/* Tells the user that the voice has trouble keeping up. The voice mutex
+ * must be held.
+ */
+static void emit_overload_event(ALLEGRO_VOICE *voice)
+{
+   ALLEGRO_EVENT event;
+   double now = al_get_time();
+
+   if (now - voice->last_overload_event < OVERLOAD_EVENT_INTERVAL)
+      return;
+   voice->last_overload_event = now;
+
+   event.user.type = ALLEGRO_EVENT_AUDIO_VOICE_OVERLOAD;
+   event.user.timestamp = now;
+   al_emit_user_event(&voice->es, &event, NULL);
+}
+
+
+static double get_overload_threshold(void)
+{
+   const char *val = al_get_config_value(al_get_system_config(), "audio",
+      "overload_threshold");
+   if (val && val[0] != '\0') {
+      double t = atof(val);
+      if (t > 0.0)
+         return t;
+   }
+
+   return DEFAULT_OVERLOAD_THRESHOLD;
+}
+
+
 /* _al_voice_update:
  *  Reads the attached stream and provides a buffer for the sound card. It is
  *  the driver's responsiblity to call this and to make sure any
@@ -50,9 +93,20 @@ const void *_al_voice_update(ALLEGRO_VOICE *voice, ALLEGRO_MUTEX *mutex,
 
    al_lock_mutex(voice->mutex);
    if (voice->attached_stream) {
+      double start_time = al_get_time();
+      double time;
+
       ASSERT(voice->attached_stream->spl_read);
       voice->attached_stream->spl_read(voice->attached_stream, &buf, samples,
          voice->depth, 0);
+
+      time = al_get_time() - start_time;
+      _al_kcm_add_mix_time(&voice->stats, time);
+      if (*samples > 0 && time >
+            voice->overload_threshold * *samples / voice->frequency) {
+         voice->stats.overloads++;
+         emit_overload_event(voice);
+      }
    }
    al_unlock_mutex(voice->mutex);
 
@@ -60,6 +114,21 @@ const void *_al_voice_update(ALLEGRO_VOICE *voice, ALLEGRO_MUTEX *mutex,
 }
 
 
+/* _al_kcm_voice_underrun:
+ *  Drivers call this when the device ran out of data, from the thread
+ *  that feeds it and without holding the voice mutex.
+ */
+void _al_kcm_voice_underrun(ALLEGRO_VOICE *voice)
+{
+   ASSERT(voice);
+
+   al_lock_mutex(voice->mutex);
+   voice->stats.underruns++;
+   emit_overload_event(voice);
+   al_unlock_mutex(voice->mutex);
+}
+
+
 /* Function: al_create_voice
  */
 ALLEGRO_VOICE *al_create_voice(unsigned int freq,
@@ -80,6 +149,9 @@ ALLEGRO_VOICE *al_create_voice(unsigned int freq,
    voice->depth     = depth;
    voice->chan_conf = chan_conf;
    voice->frequency = freq;
+   voice->flags     = new_voice_flags;
+   voice->overload_threshold = get_overload_threshold();
+   voice->last_overload_event = -OVERLOAD_EVENT_INTERVAL;
 
    voice->mutex = al_create_mutex();
    voice->cond = al_create_cond();
@@ -87,7 +159,10 @@ ALLEGRO_VOICE *al_create_voice(unsigned int freq,
    voice->driver = _al_kcm_driver;
 
    ASSERT(_al_kcm_driver);
+   al_init_user_event_source(&voice->es);
+
    if (_al_kcm_driver->allocate_voice(voice) != 0) {
+      al_destroy_user_event_source(&voice->es);
       al_destroy_mutex(voice->mutex);
       al_destroy_cond(voice->cond);
       al_free(voice);
@@ -113,6 +188,7 @@ void al_destroy_voice(ALLEGRO_VOICE *voice)
 
       /* We do NOT lock the voice mutex when calling this method. */
       voice->driver->deallocate_voice(voice);
+      al_destroy_user_event_source(&voice->es);
       al_destroy_mutex(voice->mutex);
       al_destroy_cond(voice->cond);
 
@@ -146,6 +222,13 @@ bool al_attach_sample_instance_to_voice(ALLEGRO_SAMPLE_INSTANCE *spl,
       return false;
    }
 
+   if (spl->spl_data.block_align) {
+      ALLEGRO_WARN("Compressed samples can only be attached to mixers\n");
+      _al_set_error(ALLEGRO_INVALID_OBJECT,
+         "Compressed samples can only be attached to mixers");
+      return false;
+   }
+
    if (voice->chan_conf != spl->spl_data.chan_conf ||
       voice->frequency != spl->spl_data.frequency ||
       voice->depth != spl->spl_data.depth)
@@ -447,6 +530,96 @@ ALLEGRO_AUDIO_DEPTH al_get_voice_depth(const ALLEGRO_VOICE *voice)
 }
 
 
+/* Function: al_set_new_voice_flags
+ */
+void al_set_new_voice_flags(int flags)
+{
+   new_voice_flags = flags;
+}
+
+
+/* Function: al_get_new_voice_flags
+ */
+int al_get_new_voice_flags(void)
+{
+   return new_voice_flags;
+}
+
+
+/* Function: al_get_voice_flags
+ */
+int al_get_voice_flags(const ALLEGRO_VOICE *voice)
+{
+   ASSERT(voice);
+
+   return voice->flags;
+}
+
+
+/* Function: al_get_voice_latency
+ */
+double al_get_voice_latency(const ALLEGRO_VOICE *voice)
+{
+   ASSERT(voice);
+
+   if (!voice->driver->get_voice_latency)
+      return -1.0;
+   return voice->driver->get_voice_latency(voice);
+}
+
+
+/* Function: al_get_voice_stats
+ */
+void al_get_voice_stats(const ALLEGRO_VOICE *voice, ALLEGRO_AUDIO_STATS *stats)
+{
+   _AL_AUDIO_STATS sum;
+   ALLEGRO_SAMPLE_INSTANCE *spl;
+   ASSERT(voice);
+   ASSERT(stats);
+
+   al_lock_mutex(voice->mutex);
+   sum = voice->stats;
+   spl = voice->attached_stream;
+   if (spl && spl->is_mixer) {
+      const ALLEGRO_MIXER *mixer = (const ALLEGRO_MIXER *)spl;
+      sum.starved_fragments += mixer->stats.starved_fragments;
+      sum.active_instances = mixer->stats.active_instances;
+      sum.virtual_instances = mixer->stats.virtual_instances;
+      _al_kcm_mixer_sum_stats(mixer, &sum);
+   }
+   else {
+      sum.active_instances = (spl && spl->is_playing) ? 1 : 0;
+   }
+   al_unlock_mutex(voice->mutex);
+
+   _al_kcm_copy_stats(&sum, stats);
+}
+
+
+/* Function: al_reset_voice_stats
+ */
+void al_reset_voice_stats(ALLEGRO_VOICE *voice)
+{
+   ASSERT(voice);
+
+   al_lock_mutex(voice->mutex);
+   memset(&voice->stats, 0, sizeof(voice->stats));
+   if (voice->attached_stream && voice->attached_stream->is_mixer)
+      _al_kcm_mixer_reset_stats((ALLEGRO_MIXER *)voice->attached_stream);
+   al_unlock_mutex(voice->mutex);
+}
+
+
+/* Function: al_get_voice_event_source
+ */
+ALLEGRO_EVENT_SOURCE *al_get_voice_event_source(ALLEGRO_VOICE *voice)
+{
+   ASSERT(voice);
+
+   return &voice->es;
+}
+
+
 /* Function: al_get_voice_playing
  */
 bool al_get_voice_playing(const ALLEGRO_VOICE *voice)
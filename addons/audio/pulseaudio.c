@@ -22,6 +22,7 @@
 #include <pulse/error.h>
 #include <pulse/introspect.h>
 #include <pulse/mainloop.h>
+#include <limits.h>
 #include <stdlib.h>
 
 ALLEGRO_DEBUG_CHANNEL("PulseAudio")
@@ -52,11 +53,21 @@ typedef struct PULSEAUDIO_VOICE
    ALLEGRO_MUTEX *buffer_mutex;  
    char *buffer;
    char *buffer_end;
+
+   bool low_latency;
+   /* Last measured by the update thread, or -1. */
+   volatile int latency_usec;
 } PULSEAUDIO_VOICE;
 
 #define DEFAULT_BUFFER_SIZE   1024
 #define MIN_BUFFER_SIZE       128
 
+/* Target latency of low-latency voices. Going much lower makes the server
+ * wake up too often and underrun on a loaded desktop.
+ */
+#define DEFAULT_LOW_LATENCY_MSEC    10
+#define MIN_LOW_LATENCY_MSEC        2
+
 static unsigned int get_buffer_size(const ALLEGRO_CONFIG *config)
 {
    if (config) {
@@ -73,6 +84,33 @@ static unsigned int get_buffer_size(const ALLEGRO_CONFIG *config)
    return DEFAULT_BUFFER_SIZE;
 }
 
+static unsigned int get_low_latency_msec(const ALLEGRO_CONFIG *config)
+{
+   if (config) {
+      const char *val = al_get_config_value(config,
+         "pulseaudio", "low_latency_msec");
+      if (val && val[0] != '\0') {
+         int n = atoi(val);
+         if (n < MIN_LOW_LATENCY_MSEC)
+            n = MIN_LOW_LATENCY_MSEC;
+         return n;
+      }
+   }
+
+   return DEFAULT_LOW_LATENCY_MSEC;
+}
+
+/* Remembers how long it takes until the data just written is heard,
+ * for pulseaudio_get_voice_latency.
+ */
+static void update_latency(PULSEAUDIO_VOICE *pv)
+{
+   pa_usec_t usec = pa_simple_get_latency(pv->s, NULL);
+
+   if (usec != (pa_usec_t)-1)
+      pv->latency_usec = usec > INT_MAX ? INT_MAX : (int)usec;
+}
+
 static void sink_info_cb(pa_context *c, const pa_sink_info *i, int eol,
    void *userdata)
 {
@@ -161,6 +199,9 @@ static void *pulseaudio_update(ALLEGRO_THREAD *self, void *data)
    PULSEAUDIO_VOICE *pv = voice->extra;
    (void)self;
 
+   if (pv->low_latency)
+      _al_kcm_set_realtime_priority();
+
    for (;;) {
       enum PULSEAUDIO_VOICE_STATUS status;
 
@@ -182,6 +223,7 @@ static void *pulseaudio_update(ALLEGRO_THREAD *self, void *data)
             if (data) {
                pa_simple_write(pv->s, data,
                   frames * pv->frame_size_in_bytes, NULL);
+               update_latency(pv);
             }
          }
          else {
@@ -207,10 +249,12 @@ static void *pulseaudio_update(ALLEGRO_THREAD *self, void *data)
             al_unlock_mutex(pv->buffer_mutex);
 
             pa_simple_write(pv->s, data, len, NULL);
+            update_latency(pv);
          }
       }
       else if (status == PV_STOPPING) {
          pa_simple_drain(pv->s, NULL);
+         pv->latency_usec = -1;
          al_lock_mutex(voice->mutex);
          pv->status = PV_IDLE;
          al_broadcast_cond(pv->status_cond);
@@ -254,6 +298,15 @@ static int pulseaudio_allocate_voice(ALLEGRO_VOICE *voice)
    ba.minreq    = -1;
    ba.fragsize  = -1;
 
+   pv->low_latency = (voice->flags & ALLEGRO_VOICE_LOW_LATENCY) != 0;
+   if (pv->low_latency) {
+      // Ask the server to request data in quarters of the target latency,
+      // and write exactly that much each time.
+      unsigned int msec = get_low_latency_msec(al_get_system_config());
+      ba.tlength = pa_usec_to_bytes(msec * 1000, &ss);
+      ba.minreq  = pa_usec_to_bytes(msec * 1000 / 4, &ss);
+   }
+
    pv->s = pa_simple_new(
       NULL,                // Use the default server.
       al_get_app_name(),     
@@ -273,8 +326,18 @@ static int pulseaudio_allocate_voice(ALLEGRO_VOICE *voice)
 
    voice->extra = pv;
 
-   pv->buffer_size_in_frames = get_buffer_size(al_get_system_config());
    pv->frame_size_in_bytes = ss.channels * al_get_audio_depth_size(voice->depth);
+   if (pv->low_latency) {
+      pv->buffer_size_in_frames = ba.minreq / pv->frame_size_in_bytes;
+      if (pv->buffer_size_in_frames == 0)
+         pv->buffer_size_in_frames = 1;
+      ALLEGRO_INFO("Low-latency voice: writing %u frames at a time.\n",
+         pv->buffer_size_in_frames);
+   }
+   else {
+      pv->buffer_size_in_frames = get_buffer_size(al_get_system_config());
+   }
+   pv->latency_usec = -1;
 
    pv->status = PV_IDLE;
    //pv->status_mutex = al_create_mutex();
@@ -396,6 +459,16 @@ static int pulseaudio_set_voice_position(ALLEGRO_VOICE *voice, unsigned int pos)
    return 0;
 }
 
+static double pulseaudio_get_voice_latency(const ALLEGRO_VOICE *voice)
+{
+   PULSEAUDIO_VOICE *pv = voice->extra;
+   int usec = pv->latency_usec;
+
+   if (usec < 0)
+      return -1.0;
+   return usec / 1000000.0;
+}
+
 /* Recording */
 
 typedef struct PULSEAUDIO_RECORDER {
@@ -408,7 +481,6 @@ static void *pulse_audio_update_recorder(ALLEGRO_THREAD *t, void *data)
 {
    ALLEGRO_AUDIO_RECORDER *r = (ALLEGRO_AUDIO_RECORDER *) data;
    PULSEAUDIO_RECORDER *pa = (PULSEAUDIO_RECORDER *) r->extra;
-   ALLEGRO_EVENT user_event;
    uint8_t *null_buffer;
    unsigned int fragment_i = 0;
    
@@ -429,15 +501,10 @@ static void *pulse_audio_update_recorder(ALLEGRO_THREAD *t, void *data)
          pa_simple_read(pa->s, null_buffer, 1024, NULL);
       }
       else {
-         ALLEGRO_AUDIO_RECORDER_EVENT *e;
          al_unlock_mutex(r->mutex);
          if (pa_simple_read(pa->s, r->fragments[fragment_i], r->fragment_size, NULL) >= 0) {
-            user_event.user.type = ALLEGRO_EVENT_AUDIO_RECORDER_FRAGMENT;
-            e = al_get_audio_recorder_event(&user_event);
-            e->buffer = r->fragments[fragment_i];
-            e->samples = r->samples;           
-            al_emit_user_event(&r->source, &user_event, NULL);
-         
+            _al_kcm_recorder_fragment_done(r, fragment_i, r->samples);
+
             if (++fragment_i == r->fragment_count) {
                fragment_i = 0;
             }
@@ -486,9 +553,12 @@ static int pulseaudio_allocate_recorder(ALLEGRO_AUDIO_RECORDER *r)
       latency of around 2 seconds. Lower value decreases latency but increases
       overhead. 
       
-      The following attempts to set it (the base latency) to 1/8 of a second. 
+      The following attempts to set it (the base latency) to 1/8 of a second,
+      or to a single fragment if that is shorter.
     */
    pa->ba.fragsize = (r->sample_size * r->frequency) / 8;
+   if (pa->ba.fragsize > r->fragment_size)
+      pa->ba.fragsize = r->fragment_size;
    
    pa->s = pa_simple_new(NULL, al_get_app_name(), PA_STREAM_RECORD, NULL, "Allegro Audio Recorder", &pa->ss, NULL, &pa->ba, NULL);
    if (!pa->s) {
@@ -533,7 +603,9 @@ ALLEGRO_AUDIO_DRIVER _al_kcm_pulseaudio_driver =
    pulseaudio_set_voice_position,
    
    pulseaudio_allocate_recorder,
-   pulseaudio_deallocate_recorder
+   pulseaudio_deallocate_recorder,
+
+   pulseaudio_get_voice_latency
 };
 
 /* vim: set sts=3 sw=3 et: */
@@ -20,6 +20,7 @@ ALLEGRO_AUDIO_RECORDER *al_create_audio_recorder(size_t fragment_count,
    ALLEGRO_AUDIO_DEPTH depth, ALLEGRO_CHANNEL_CONF chan_conf)
 {
    size_t i;
+   uint8_t *ring;
 
    ALLEGRO_AUDIO_RECORDER *r;
    ASSERT(_al_kcm_driver);
@@ -43,26 +44,25 @@ ALLEGRO_AUDIO_RECORDER *al_create_audio_recorder(size_t fragment_count,
    
    r->sample_size = al_get_channel_count(chan_conf) * al_get_audio_depth_size(depth);
 
+   r->fragment_size = r->samples * r->sample_size;
+
+   /* The fragments are parts of a single ring so that they can be read
+    * straight from it with al_get_audio_recorder_fragment, too.
+    */
    r->fragments = al_malloc(r->fragment_count * sizeof(uint8_t *));
-   if (!r->fragments) {
+   r->fragment_samples = al_calloc(r->fragment_count, sizeof(unsigned int));
+   ring = al_malloc(r->fragment_count * r->fragment_size);
+   if (!r->fragments || !r->fragment_samples || !ring) {
+      al_free(ring);
+      al_free(r->fragment_samples);
+      al_free(r->fragments);
       al_free(r);
       ALLEGRO_ERROR("Unable to allocate memory for ALLEGRO_AUDIO_RECORDER fragments\n");
       return false;
    }
 
-   r->fragment_size = r->samples * r->sample_size;
    for (i = 0; i < fragment_count; ++i) {
-      r->fragments[i] = al_malloc(r->fragment_size);
-      if (!r->fragments[i]) {
-         size_t j;
-         for (j = 0; j < i; ++j) {
-            al_free(r->fragments[j]);
-         }
-         al_free(r->fragments);
-
-         ALLEGRO_ERROR("Unable to allocate memory for ALLEGRO_AUDIO_RECORDER fragments\n");
-         return false;
-      }
+      r->fragments[i] = ring + i * r->fragment_size;
    }
 
    if (_al_kcm_driver->allocate_recorder(r)) {
@@ -123,6 +123,60 @@ bool al_is_audio_recorder_recording(ALLEGRO_AUDIO_RECORDER *r)
    return is_recording;
 }
 
+/* _al_kcm_recorder_fragment_done:
+ *  Called by the drivers once they have recorded into a fragment.
+ */
+void _al_kcm_recorder_fragment_done(ALLEGRO_AUDIO_RECORDER *r,
+   unsigned int fragment, unsigned int samples)
+{
+   ALLEGRO_EVENT user_event;
+   ALLEGRO_AUDIO_RECORDER_EVENT *e;
+
+   r->fragment_samples[fragment] = samples;
+   _al_store_release(&r->fragments_written, r->fragments_written + 1);
+
+   user_event.user.type = ALLEGRO_EVENT_AUDIO_RECORDER_FRAGMENT;
+   e = al_get_audio_recorder_event(&user_event);
+   e->buffer = r->fragments[fragment];
+   e->samples = samples;
+   al_emit_user_event(&r->source, &user_event, NULL);
+}
+
+/* Function: al_get_audio_recorder_fragment
+ */
+const void *al_get_audio_recorder_fragment(ALLEGRO_AUDIO_RECORDER *r,
+   unsigned int *samples)
+{
+   unsigned int written;
+   unsigned int skipped;
+   unsigned int fragment;
+
+   ASSERT(r);
+
+   written = (unsigned int)_al_load_acquire(&r->fragments_written);
+   if (written == r->fragments_read || r->fragment_count < 2)
+      return NULL;
+
+   /* The driver is recording into the fragment after the last written one,
+    * so only fragment_count - 1 of them are intact. Skip what was lost.
+    */
+   if (written - r->fragments_read > r->fragment_count - 1) {
+      skipped = written - r->fragments_read - (r->fragment_count - 1);
+      ALLEGRO_DEBUG("Recorder overrun, skipped %u fragments.\n", skipped);
+      r->fragments_read += skipped;
+      r->next_fragment = (r->next_fragment + skipped) % r->fragment_count;
+   }
+
+   fragment = r->next_fragment;
+   if (++r->next_fragment == r->fragment_count)
+      r->next_fragment = 0;
+   r->fragments_read++;
+
+   if (samples)
+      *samples = r->fragment_samples[fragment];
+   return r->fragments[fragment];
+}
+
 /* Function: al_get_audio_recorder_event
  */
 ALLEGRO_AUDIO_RECORDER_EVENT *al_get_audio_recorder_event(ALLEGRO_EVENT *event)
@@ -142,8 +196,6 @@ ALLEGRO_EVENT_SOURCE *al_get_audio_recorder_event_source(ALLEGRO_AUDIO_RECORDER
  */
 void al_destroy_audio_recorder(ALLEGRO_AUDIO_RECORDER *r)
 {
-   size_t i;
-
    if (!r)
       return;
 
@@ -167,9 +219,8 @@ void al_destroy_audio_recorder(ALLEGRO_AUDIO_RECORDER *r)
    al_destroy_mutex(r->mutex);
    al_destroy_cond(r->cond);
    
-   for (i = 0; i < r->fragment_count; ++i) {
-      al_free(r->fragments[i]);
-   }
+   al_free(r->fragments[0]);
    al_free(r->fragments);
+   al_free(r->fragment_samples);
    al_free(r);
 }
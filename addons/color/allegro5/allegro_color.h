@@ -83,6 +83,31 @@ ALLEGRO_COLOR_FUNC(void, al_color_rgb_to_lch, (float red, float green, float blu
 ALLEGRO_COLOR_FUNC(ALLEGRO_COLOR, al_color_lch, (float l, float c, float h));
 ALLEGRO_COLOR_FUNC(bool, al_is_color_valid, (ALLEGRO_COLOR color));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_COLOR_SRC)
+ALLEGRO_COLOR_FUNC(void, al_color_srgb_to_linear_array, (const float *values,
+   float *linear, int n));
+ALLEGRO_COLOR_FUNC(void, al_color_linear_to_srgb_array, (const float *linear,
+   float *values, int n));
+ALLEGRO_COLOR_FUNC(void, al_color_rgb_to_xyz_array, (const ALLEGRO_COLOR *colors,
+   float *xyz, int n));
+ALLEGRO_COLOR_FUNC(void, al_color_xyz_to_rgb_array, (const float *xyz,
+   ALLEGRO_COLOR *colors, int n));
+ALLEGRO_COLOR_FUNC(void, al_color_rgb_to_lab_array, (const ALLEGRO_COLOR *colors,
+   float *lab, int n));
+ALLEGRO_COLOR_FUNC(void, al_color_lab_to_rgb_array, (const float *lab,
+   ALLEGRO_COLOR *colors, int n));
+ALLEGRO_COLOR_FUNC(void, al_color_rgb_to_hsv_array, (const ALLEGRO_COLOR *colors,
+   float *hsv, int n));
+ALLEGRO_COLOR_FUNC(void, al_color_hsv_to_rgb_array, (const float *hsv,
+   ALLEGRO_COLOR *colors, int n));
+ALLEGRO_COLOR_FUNC(void, al_color_rgb_to_hsl_array, (const ALLEGRO_COLOR *colors,
+   float *hsl, int n));
+ALLEGRO_COLOR_FUNC(void, al_color_hsl_to_rgb_array, (const float *hsl,
+   ALLEGRO_COLOR *colors, int n));
+ALLEGRO_COLOR_FUNC(void, al_color_distance_ciede2000_array, (const float *lab1,
+   const float *lab2, float *distances, int n));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
@@ -0,0 +1,582 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Color space conversions of whole arrays of colors.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#define ALLEGRO_INTERNAL_UNSTABLE
+
+#include <math.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_color.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_atomicops.h"
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+   #if defined(_MSC_VER) || defined(__clang__) || \
+      (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+      #define SIMD_X86
+   #endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+   #define SIMD_NEON
+#endif
+
+#if defined(SIMD_X86)
+   #include <emmintrin.h>
+   #if defined(__GNUC__) || defined(__clang__)
+      #define TARGET(x) __attribute__((target(x)))
+   #else
+      #define TARGET(x)
+   #endif
+#elif defined(SIMD_NEON)
+   #include <arm_neon.h>
+#endif
+
+
+/*
+ * The arrays are converted in blocks, with each channel of a block in an
+ * array of its own so that the matrix products can be done four colors at
+ * a time. The sRGB and CIELAB transfer functions are looked up in tables
+ * with linear interpolation instead of calling pow(). The first call sets
+ * the tables up; calls made by other threads meanwhile compute the values.
+ *
+ * Everything is done in float, so the results may differ from those of the
+ * functions converting a single color by about 1e-5.
+ */
+
+#define BLOCK        64
+#define TABLE_SIZE   4096
+
+/* The D65 white point, as in color.c. */
+#define XN  0.95047f
+#define YN  1.00000f
+#define ZN  1.08883f
+
+/* The CIELAB f() table covers x / Xn etc. up to this, enough for white. */
+#define LAB_TABLE_MAX 1.125f
+
+static float const delta = 6.0f / 29;
+static float const delta2 = 6.0f / 29 * 6.0f / 29;
+static float const delta3 = 6.0f / 29 * 6.0f / 29 * 6.0f / 29;
+static float const tf7 = 1.0f / 4 / 4 / 4 / 4 / 4 / 4 / 4;
+
+/* 3x3 matrices with an offset added to each row, row by row. */
+static float const srgb_to_xyz[12] = {
+   0.4124f, 0.3576f, 0.1805f, 0,
+   0.2126f, 0.7152f, 0.0722f, 0,
+   0.0193f, 0.1192f, 0.9505f, 0
+};
+
+static float const xyz_to_srgb[12] = {
+    3.2406f, -1.5372f, -0.4986f, 0,
+   -0.9689f,  1.8758f,  0.0415f, 0,
+    0.0557f, -0.2040f,  1.0570f, 0
+};
+
+/* Linear RGB to XYZ relative to the white point. */
+static float const srgb_to_xyz_white[12] = {
+   0.4124f / XN, 0.3576f / XN, 0.1805f / XN, 0,
+   0.2126f / YN, 0.7152f / YN, 0.0722f / YN, 0,
+   0.0193f / ZN, 0.1192f / ZN, 0.9505f / ZN, 0
+};
+
+static float const xyz_white_to_srgb[12] = {
+    3.2406f * XN, -1.5372f * YN, -0.4986f * ZN, 0,
+   -0.9689f * XN,  1.8758f * YN,  0.0415f * ZN, 0,
+    0.0557f * XN, -0.2040f * YN,  1.0570f * ZN, 0
+};
+
+/* f(x), f(y), f(z) to L*a*b* and back. */
+static float const lab_f_to_lab[12] = {
+   0, 1.16f, 0, -0.16f,
+   5.00f, -5.00f, 0, 0,
+   0, 2.00f, -2.00f, 0
+};
+
+static float const lab_to_lab_f[12] = {
+   1 / 1.16f, 1 / 5.00f, 0, 0.16f / 1.16f,
+   1 / 1.16f, 0, 0, 0.16f / 1.16f,
+   1 / 1.16f, 0, -1 / 2.00f, 0.16f / 1.16f
+};
+
+static float gamma_to_linear_table[TABLE_SIZE + 1];
+static float linear_to_gamma_table[TABLE_SIZE + 1];
+static float lab_f_table[TABLE_SIZE + 1];
+static volatile _AL_ATOMIC tables_claimed = 0;
+static volatile _AL_ATOMIC tables_ready = 0;
+
+
+static float gamma_to_linear(float x)
+{
+   if (x < 0.04045f)
+      return x / 12.92f;
+   return powf((x + 0.055f) / 1.055f, 2.4f);
+}
+
+
+static float linear_to_gamma(float x)
+{
+   if (x < 0.0031308f)
+      return x * 12.92f;
+   return powf(x, 1 / 2.4f) * 1.055f - 0.055f;
+}
+
+
+static float lab_f(float x)
+{
+   if (x > delta3)
+      return powf(x, 1.0f / 3);
+   return 4.0f / 29 + x / delta2 / 3;
+}
+
+
+static float lab_f_inv(float x)
+{
+   if (x > delta)
+      return x * x * x;
+   return (x - 4.0f / 29) * 3 * delta2;
+}
+
+
+static bool have_tables(void)
+{
+   int i;
+
+   if (_al_load_acquire(&tables_ready))
+      return true;
+   if (_al_fetch_and_add1(&tables_claimed) != 0)
+      return false;
+
+   for (i = 0; i <= TABLE_SIZE; i++) {
+      float x = (float)i / TABLE_SIZE;
+      gamma_to_linear_table[i] = gamma_to_linear(x);
+      linear_to_gamma_table[i] = linear_to_gamma(x);
+      lab_f_table[i] = lab_f(x * LAB_TABLE_MAX);
+   }
+
+   _al_store_release(&tables_ready, 1);
+   return true;
+}
+
+
+/* Interpolates in a table for x from 0 to 1. */
+static float lookup(const float *table, float x)
+{
+   float f = x * TABLE_SIZE;
+   int i = (int)f;
+
+   if (i >= TABLE_SIZE)
+      i = TABLE_SIZE - 1;
+   return table[i] + (f - i) * (table[i + 1] - table[i]);
+}
+
+
+static float to_linear(float x, bool tables)
+{
+   if (tables && x >= 0.0f && x <= 1.0f)
+      return lookup(gamma_to_linear_table, x);
+   return gamma_to_linear(x);
+}
+
+
+static float to_gamma(float x, bool tables)
+{
+   /* The linear part is steep near 0, which the table would smooth. */
+   if (tables && x >= 0.0031308f && x <= 1.0f)
+      return lookup(linear_to_gamma_table, x);
+   return linear_to_gamma(x);
+}
+
+
+static float to_lab_f(float x, bool tables)
+{
+   if (tables && x > delta3 && x <= LAB_TABLE_MAX)
+      return lookup(lab_f_table, x / LAB_TABLE_MAX);
+   return lab_f(x);
+}
+
+
+static void transform_generic(const float m[12], float *c0, float *c1,
+   float *c2, int i, int n)
+{
+   for (; i < n; i++) {
+      float a = c0[i], b = c1[i], c = c2[i];
+      c0[i] = m[0] * a + m[1] * b + m[2] * c + m[3];
+      c1[i] = m[4] * a + m[5] * b + m[6] * c + m[7];
+      c2[i] = m[8] * a + m[9] * b + m[10] * c + m[11];
+   }
+}
+
+
+#if defined(SIMD_X86)
+
+TARGET("sse2")
+static int transform_sse2(const float m[12], float *c0, float *c1,
+   float *c2, int n)
+{
+   int i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      __m128 a = _mm_loadu_ps(c0 + i);
+      __m128 b = _mm_loadu_ps(c1 + i);
+      __m128 c = _mm_loadu_ps(c2 + i);
+      int row;
+
+      for (row = 0; row < 3; row++) {
+         const float *r = m + row * 4;
+         __m128 v = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[0]), a),
+               _mm_mul_ps(_mm_set1_ps(r[1]), b)),
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[2]), c),
+               _mm_set1_ps(r[3])));
+         _mm_storeu_ps((row == 0 ? c0 : row == 1 ? c1 : c2) + i, v);
+      }
+   }
+
+   return i;
+}
+
+#elif defined(SIMD_NEON)
+
+static int transform_neon(const float m[12], float *c0, float *c1,
+   float *c2, int n)
+{
+   int i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      float32x4_t a = vld1q_f32(c0 + i);
+      float32x4_t b = vld1q_f32(c1 + i);
+      float32x4_t c = vld1q_f32(c2 + i);
+      int row;
+
+      for (row = 0; row < 3; row++) {
+         const float *r = m + row * 4;
+         float32x4_t v = vdupq_n_f32(r[3]);
+         v = vmlaq_n_f32(v, a, r[0]);
+         v = vmlaq_n_f32(v, b, r[1]);
+         v = vmlaq_n_f32(v, c, r[2]);
+         vst1q_f32((row == 0 ? c0 : row == 1 ? c1 : c2) + i, v);
+      }
+   }
+
+   return i;
+}
+
+#endif
+
+
+/* Multiplies the colors of a block, stored channel by channel, with an
+ * affine matrix.
+ */
+static void transform(const float m[12], float *c0, float *c1, float *c2,
+   int n)
+{
+   int i = 0;
+
+#if defined(SIMD_X86)
+   if (al_get_cpu_features() & ALLEGRO_CPU_SSE2)
+      i = transform_sse2(m, c0, c1, c2, n);
+#elif defined(SIMD_NEON)
+   if (al_get_cpu_features() & ALLEGRO_CPU_NEON)
+      i = transform_neon(m, c0, c1, c2, n);
+#endif
+
+   transform_generic(m, c0, c1, c2, i, n);
+}
+
+
+static void load_linear(const ALLEGRO_COLOR *colors, int n, bool tables,
+   float *r, float *g, float *b)
+{
+   int i;
+
+   for (i = 0; i < n; i++) {
+      r[i] = to_linear(colors[i].r, tables);
+      g[i] = to_linear(colors[i].g, tables);
+      b[i] = to_linear(colors[i].b, tables);
+   }
+}
+
+
+static void store_gamma(const float *r, const float *g, const float *b,
+   int n, bool tables, ALLEGRO_COLOR *colors)
+{
+   int i;
+
+   for (i = 0; i < n; i++) {
+      colors[i].r = to_gamma(r[i], tables);
+      colors[i].g = to_gamma(g[i], tables);
+      colors[i].b = to_gamma(b[i], tables);
+      colors[i].a = 1.0f;
+   }
+}
+
+
+static void load_triplets(const float *data, int n,
+   float *c0, float *c1, float *c2)
+{
+   int i;
+
+   for (i = 0; i < n; i++, data += 3) {
+      c0[i] = data[0];
+      c1[i] = data[1];
+      c2[i] = data[2];
+   }
+}
+
+
+static void store_triplets(const float *c0, const float *c1, const float *c2,
+   int n, float *data)
+{
+   int i;
+
+   for (i = 0; i < n; i++, data += 3) {
+      data[0] = c0[i];
+      data[1] = c1[i];
+      data[2] = c2[i];
+   }
+}
+
+
+/* Function: al_color_srgb_to_linear_array
+ */
+void al_color_srgb_to_linear_array(const float *values, float *linear, int n)
+{
+   bool tables = have_tables();
+   int i;
+
+   for (i = 0; i < n; i++)
+      linear[i] = to_linear(values[i], tables);
+}
+
+
+/* Function: al_color_linear_to_srgb_array
+ */
+void al_color_linear_to_srgb_array(const float *linear, float *values, int n)
+{
+   bool tables = have_tables();
+   int i;
+
+   for (i = 0; i < n; i++)
+      values[i] = to_gamma(linear[i], tables);
+}
+
+
+/* Function: al_color_rgb_to_xyz_array
+ */
+void al_color_rgb_to_xyz_array(const ALLEGRO_COLOR *colors, float *xyz,
+   int n)
+{
+   float x[BLOCK], y[BLOCK], z[BLOCK];
+   bool tables = have_tables();
+   int i, m;
+
+   for (i = 0; i < n; i += BLOCK) {
+      m = _ALLEGRO_MIN(BLOCK, n - i);
+      load_linear(colors + i, m, tables, x, y, z);
+      transform(srgb_to_xyz, x, y, z, m);
+      store_triplets(x, y, z, m, xyz + i * 3);
+   }
+}
+
+
+/* Function: al_color_xyz_to_rgb_array
+ */
+void al_color_xyz_to_rgb_array(const float *xyz, ALLEGRO_COLOR *colors,
+   int n)
+{
+   float r[BLOCK], g[BLOCK], b[BLOCK];
+   bool tables = have_tables();
+   int i, m;
+
+   for (i = 0; i < n; i += BLOCK) {
+      m = _ALLEGRO_MIN(BLOCK, n - i);
+      load_triplets(xyz + i * 3, m, r, g, b);
+      transform(xyz_to_srgb, r, g, b, m);
+      store_gamma(r, g, b, m, tables, colors + i);
+   }
+}
+
+
+/* Function: al_color_rgb_to_lab_array
+ */
+void al_color_rgb_to_lab_array(const ALLEGRO_COLOR *colors, float *lab,
+   int n)
+{
+   float c0[BLOCK], c1[BLOCK], c2[BLOCK];
+   bool tables = have_tables();
+   int i, j, m;
+
+   for (i = 0; i < n; i += BLOCK) {
+      m = _ALLEGRO_MIN(BLOCK, n - i);
+      load_linear(colors + i, m, tables, c0, c1, c2);
+      transform(srgb_to_xyz_white, c0, c1, c2, m);
+      for (j = 0; j < m; j++) {
+         c0[j] = to_lab_f(c0[j], tables);
+         c1[j] = to_lab_f(c1[j], tables);
+         c2[j] = to_lab_f(c2[j], tables);
+      }
+      transform(lab_f_to_lab, c0, c1, c2, m);
+      store_triplets(c0, c1, c2, m, lab + i * 3);
+   }
+}
+
+
+/* Function: al_color_lab_to_rgb_array
+ */
+void al_color_lab_to_rgb_array(const float *lab, ALLEGRO_COLOR *colors,
+   int n)
+{
+   float c0[BLOCK], c1[BLOCK], c2[BLOCK];
+   bool tables = have_tables();
+   int i, j, m;
+
+   for (i = 0; i < n; i += BLOCK) {
+      m = _ALLEGRO_MIN(BLOCK, n - i);
+      load_triplets(lab + i * 3, m, c0, c1, c2);
+      transform(lab_to_lab_f, c0, c1, c2, m);
+      for (j = 0; j < m; j++) {
+         c0[j] = lab_f_inv(c0[j]);
+         c1[j] = lab_f_inv(c1[j]);
+         c2[j] = lab_f_inv(c2[j]);
+      }
+      transform(xyz_white_to_srgb, c0, c1, c2, m);
+      store_gamma(c0, c1, c2, m, tables, colors + i);
+   }
+}
+
+
+/* Function: al_color_rgb_to_hsv_array
+ */
+void al_color_rgb_to_hsv_array(const ALLEGRO_COLOR *colors, float *hsv,
+   int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++, hsv += 3) {
+      al_color_rgb_to_hsv(colors[i].r, colors[i].g, colors[i].b,
+         hsv, hsv + 1, hsv + 2);
+   }
+}
+
+
+/* Function: al_color_hsv_to_rgb_array
+ */
+void al_color_hsv_to_rgb_array(const float *hsv, ALLEGRO_COLOR *colors,
+   int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++, hsv += 3) {
+      al_color_hsv_to_rgb(hsv[0], hsv[1], hsv[2],
+         &colors[i].r, &colors[i].g, &colors[i].b);
+      colors[i].a = 1.0f;
+   }
+}
+
+
+/* Function: al_color_rgb_to_hsl_array
+ */
+void al_color_rgb_to_hsl_array(const ALLEGRO_COLOR *colors, float *hsl,
+   int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++, hsl += 3) {
+      al_color_rgb_to_hsl(colors[i].r, colors[i].g, colors[i].b,
+         hsl, hsl + 1, hsl + 2);
+   }
+}
+
+
+/* Function: al_color_hsl_to_rgb_array
+ */
+void al_color_hsl_to_rgb_array(const float *hsl, ALLEGRO_COLOR *colors,
+   int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++, hsl += 3) {
+      al_color_hsl_to_rgb(hsl[0], hsl[1], hsl[2],
+         &colors[i].r, &colors[i].g, &colors[i].b);
+      colors[i].a = 1.0f;
+   }
+}
+
+
+/* The same as al_color_distance_ciede2000, in float and starting from
+ * L*a*b*.
+ */
+static float distance_ciede2000(const float *lab1, const float *lab2)
+{
+   float const pi = ALLEGRO_PI;
+   float l1 = lab1[0], a1 = lab1[1], b1 = lab1[2];
+   float l2 = lab2[0], a2 = lab2[1], b2 = lab2[2];
+   float dl = l1 - l2;
+   float ml = (l1 + l2) / 2;
+   float c1 = sqrtf(a1 * a1 + b1 * b1);
+   float c2 = sqrtf(a2 * a2 + b2 * b2);
+   float mc = (c1 + c2) / 2;
+   float mc7 = mc * mc * mc * mc * mc * mc * mc;
+   float fac = sqrtf(mc7 / (mc7 + tf7));
+   float g = 0.5f * (1 - fac);
+   float dc, h1, h2, dh, mh, t, mls, sl, sc, sh, rt, e;
+
+   a1 *= 1 + g;
+   a2 *= 1 + g;
+   c1 = sqrtf(a1 * a1 + b1 * b1);
+   c2 = sqrtf(a2 * a2 + b2 * b2);
+   dc = c2 - c1;
+   mc = (c1 + c2) / 2;
+   mc7 = mc * mc * mc * mc * mc * mc * mc;
+   fac = sqrtf(mc7 / (mc7 + tf7));
+   h1 = fmodf(2 * pi + atan2f(b1, a1), 2 * pi);
+   h2 = fmodf(2 * pi + atan2f(b2, a2), 2 * pi);
+   dh = 0;
+   mh = h1 + h2;
+   if (c1 * c2 != 0) {
+      dh = h2 - h1;
+      if (dh > pi) dh -= 2 * pi;
+      if (dh < -pi) dh += 2 * pi;
+      if (fabsf(h1 - h2) <= pi) mh = (h1 + h2) / 2;
+      else if (h1 + h2 < 2 * pi) mh = (h1 + h2 + 2 * pi) / 2;
+      else mh = (h1 + h2 - 2 * pi) / 2;
+   }
+   dh = 2 * sqrtf(c1 * c2) * sinf(dh / 2);
+   t = 1 - 0.17f * cosf(mh - pi / 6) + 0.24f * cosf(2 * mh) +
+         0.32f * cosf(3 * mh + pi / 30) - 0.2f * cosf(4 * mh - pi * 7 / 20);
+   mls = (ml - 0.5f) * (ml - 0.5f);
+   sl = 1 + 1.5f * mls / sqrtf(0.002f + mls);
+   sc = 1 + 4.5f * mc;
+   sh = 1 + 1.5f * mc * t;
+   e = mh / pi * 36 / 5 - 11;
+   rt = -2 * fac * sinf(pi / 3 * expf(-e * e));
+   dl /= sl;
+   dc /= sc;
+   dh /= sh;
+   return sqrtf(dl * dl + dc * dc + dh * dh + rt * dc * dh);
+}
+
+
+/* Function: al_color_distance_ciede2000_array
+ */
+void al_color_distance_ciede2000_array(const float *lab1, const float *lab2,
+   float *distances, int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++, lab1 += 3, lab2 += 3)
+      distances[i] = distance_ciede2000(lab1, lab2);
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -64,6 +64,14 @@ struct ALLEGRO_GLYPH
    int offset_y;
    int advance;
 };
+
+/* Type: ALLEGRO_TEXT_LAYOUT
+*/
+typedef struct ALLEGRO_TEXT_LAYOUT ALLEGRO_TEXT_LAYOUT;
+
+/* Type: ALLEGRO_WRAPPED_TEXT
+*/
+typedef struct ALLEGRO_WRAPPED_TEXT ALLEGRO_WRAPPED_TEXT;
 #endif
 
 enum {
@@ -139,6 +147,45 @@ ALLEGRO_FONT_FUNC(void, al_set_fallback_font, (ALLEGRO_FONT *font,
 ALLEGRO_FONT_FUNC(ALLEGRO_FONT *, al_get_fallback_font, (
    ALLEGRO_FONT *font));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_FONT_SRC)
+ALLEGRO_FONT_FUNC(ALLEGRO_TEXT_LAYOUT *, al_create_text_layout, (
+   const ALLEGRO_FONT *font, const ALLEGRO_USTR *ustr));
+ALLEGRO_FONT_FUNC(void, al_destroy_text_layout, (ALLEGRO_TEXT_LAYOUT *layout));
+ALLEGRO_FONT_FUNC(void, al_draw_text_layout, (const ALLEGRO_TEXT_LAYOUT *layout,
+   ALLEGRO_COLOR color, float x, float y, int flags));
+ALLEGRO_FONT_FUNC(int, al_get_text_layout_width, (
+   const ALLEGRO_TEXT_LAYOUT *layout));
+ALLEGRO_FONT_FUNC(const ALLEGRO_FONT *, al_get_text_layout_font, (
+   const ALLEGRO_TEXT_LAYOUT *layout));
+ALLEGRO_FONT_FUNC(bool, al_set_text_layout_cache_size, (int max_entries));
+ALLEGRO_FONT_FUNC(int, al_get_text_layout_cache_size, (void));
+
+ALLEGRO_FONT_FUNC(ALLEGRO_WRAPPED_TEXT *, al_create_wrapped_text, (
+   const ALLEGRO_FONT *font, float max_width));
+ALLEGRO_FONT_FUNC(void, al_destroy_wrapped_text, (
+   ALLEGRO_WRAPPED_TEXT *wrapped));
+ALLEGRO_FONT_FUNC(bool, al_append_wrapped_text, (
+   ALLEGRO_WRAPPED_TEXT *wrapped, const char *text));
+ALLEGRO_FONT_FUNC(bool, al_append_wrapped_ustr, (
+   ALLEGRO_WRAPPED_TEXT *wrapped, const ALLEGRO_USTR *ustr));
+ALLEGRO_FONT_FUNC(void, al_clear_wrapped_text, (
+   ALLEGRO_WRAPPED_TEXT *wrapped));
+ALLEGRO_FONT_FUNC(bool, al_set_wrapped_text_max_width, (
+   ALLEGRO_WRAPPED_TEXT *wrapped, float max_width));
+ALLEGRO_FONT_FUNC(float, al_get_wrapped_text_max_width, (
+   const ALLEGRO_WRAPPED_TEXT *wrapped));
+ALLEGRO_FONT_FUNC(int, al_get_wrapped_text_line_count, (
+   const ALLEGRO_WRAPPED_TEXT *wrapped));
+ALLEGRO_FONT_FUNC(const ALLEGRO_USTR *, al_get_wrapped_text_line, (
+   const ALLEGRO_WRAPPED_TEXT *wrapped, int line, ALLEGRO_USTR_INFO *info));
+ALLEGRO_FONT_FUNC(int, al_get_wrapped_text_line_width, (
+   const ALLEGRO_WRAPPED_TEXT *wrapped, int line));
+ALLEGRO_FONT_FUNC(void, al_draw_wrapped_text, (
+   const ALLEGRO_WRAPPED_TEXT *wrapped, ALLEGRO_COLOR color,
+   float x, float y, float line_height, int flags,
+   int first_line, int num_lines));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
@@ -1,7 +1,8 @@
 #ifndef __al_included_allegro_aintern_font_h
 #define __al_included_allegro_aintern_font_h
 
-#include "allegro5/internal/aintern_list.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_dtor.h"
 
 typedef struct ALLEGRO_FONT_VTABLE ALLEGRO_FONT_VTABLE;
 
@@ -11,7 +12,11 @@ struct ALLEGRO_FONT
    int height;
    ALLEGRO_FONT *fallback;
    ALLEGRO_FONT_VTABLE *vtable;
-   _AL_LIST_ITEM *dtor_item;
+   _AL_DTOR_ITEM *dtor_item;
+   /* Set if the glyphs can't be drawn as the plain bitmap regions reported
+    * by get_glyph, e.g. because they need scaling or a shader.
+    */
+   bool draws_own_glyphs;
 };
 
 /* text- and font-related stuff */
@@ -38,4 +43,34 @@ struct ALLEGRO_FONT_VTABLE
    ALLEGRO_FONT_METHOD(bool, get_glyph, (const ALLEGRO_FONT *f, int prev_codepoint, int codepoint, ALLEGRO_GLYPH *glyph));
 };
 
+void _al_font_align_to_integer_pixel(float *x, float *y);
+
+const ALLEGRO_USTR *_al_font_get_next_soft_line(const ALLEGRO_USTR *ustr,
+   ALLEGRO_USTR_INFO *info, int *pos,
+   const ALLEGRO_FONT *font, float max_width);
+
+/* Glyphs collected for drawing with a single
+ * _al_draw_tinted_bitmap_regions call per bitmap.
+ */
+#define _AL_GLYPH_BATCH_SIZE 64
+
+typedef struct _AL_GLYPH_BATCH
+{
+   ALLEGRO_BITMAP *bitmap;
+   ALLEGRO_COLOR color;
+   int count;
+   _AL_BITMAP_REGION regions[_AL_GLYPH_BATCH_SIZE];
+} _AL_GLYPH_BATCH;
+
+void _al_font_init_glyph_batch(_AL_GLYPH_BATCH *batch, ALLEGRO_COLOR color);
+void _al_font_batch_glyph(_AL_GLYPH_BATCH *batch, ALLEGRO_BITMAP *bitmap,
+   float sx, float sy, float sw, float sh, float dx, float dy);
+void _al_font_flush_glyph_batch(_AL_GLYPH_BATCH *batch);
+
+bool _al_font_draw_cached_layout(const ALLEGRO_FONT *font,
+   ALLEGRO_COLOR color, float x, float y, int flags, const ALLEGRO_USTR *ustr);
+ALLEGRO_FONT_FUNC(void, _al_font_clear_layout_cache, (void));
+ALLEGRO_FONT_FUNC(void, _al_font_invalidate_layout_cache, (void));
+void _al_font_shutdown_layout_cache(void);
+
 #endif
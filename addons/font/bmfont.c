@@ -3,6 +3,7 @@
 #include <stdio.h>
 
 #include "allegro5/internal/aintern_font.h"
+#include "allegro5/internal/aintern_vector.h"
 
 #include "font.h"
 #include "xml.h"
@@ -16,6 +17,7 @@ typedef struct {
 } BMFONT_KERNING;
 
 typedef struct {
+   int id;
    int page;
    int x, y;
    int width, height;
@@ -23,15 +25,18 @@ typedef struct {
    int xadvance;
    int chnl;
    int kerning_pairs;
-   BMFONT_KERNING *kerning;
+   BMFONT_KERNING *kerning;   /* Points into the font's kerning array. */
 } BMFONT_CHAR;
 
 typedef struct BMFONT_RANGE BMFONT_RANGE;
 
+/* A run of consecutive codepoints, pointing into the font's sorted array
+ * of characters.
+ */
 struct BMFONT_RANGE {
    int first;
    int count;
-   BMFONT_CHAR **characters;
+   BMFONT_CHAR *characters;
    BMFONT_RANGE *next;
 };
 
@@ -43,6 +48,9 @@ typedef struct {
    int line_height;
    int flags;
 
+   int chars_count;
+   BMFONT_CHAR *chars;
+
    int kerning_pairs;
    BMFONT_KERNING *kerning;
 } BMFONT_DATA;
@@ -52,91 +60,22 @@ typedef struct {
    ALLEGRO_USTR *tag;
    ALLEGRO_USTR *attribute;
    BMFONT_CHAR *c;
+   _AL_VECTOR chars;
    ALLEGRO_PATH *path;
 } BMFONT_PARSER;
 
-static void reallocate(BMFONT_RANGE *range) {
-   range->characters = al_realloc(range->characters,
-      range->count * sizeof *range->characters);
-}
-
-static void prepend_char(BMFONT_PARSER *parser, BMFONT_RANGE *range) {
-   range->first--;
-   range->count++;
-   reallocate(range);
-   memmove(range->characters + 1, range->characters,
-      (range->count - 1) * sizeof *range->characters);
-   range->characters[0] = parser->c;
-}
-
-static void append_char(BMFONT_PARSER *parser, BMFONT_RANGE *range) {
-   range->count++;
-   reallocate(range);
-   range->characters[range->count - 1] = parser->c;
-}
-
-static void combine_ranges(BMFONT_DATA *data,
-      BMFONT_RANGE *range, BMFONT_RANGE *range2) {
-   (void)data;
-   range->count += range2->count;
-   reallocate(range);
-   memmove(range->characters + range->count - range2->count,
-      range2->characters,
-      range2->count * sizeof *range->characters);
-   range->next = range2->next;
-   al_free(range2->characters);
-   al_free(range2);
-}
-
-static void insert_new_range(BMFONT_PARSER *parser, BMFONT_RANGE *prev,
-      int codepoint) {
-   BMFONT_RANGE *range = al_calloc(1, sizeof *range);
-   range->first = codepoint;
-   range->count = 1;
-   reallocate(range);
-   range->characters[0] = parser->c;
-   if (prev) {
-      range->next = prev->next;
-      prev->next = range;
-   }
-   else {
-      ALLEGRO_FONT *font = parser->font;
-      BMFONT_DATA *data = font->data;
-      range->next = data->range_first;
-      data->range_first = range;
-   }
+static int compare_chars(const void *a, const void *b) {
+   const BMFONT_CHAR *ca = a;
+   const BMFONT_CHAR *cb = b;
+   return (ca->id > cb->id) - (ca->id < cb->id);
 }
 
-/* Adding a new codepoint creates either a new range consisting of that
- * single codepoint, appends the codepoint to the end of a range,
- * prepends it to the beginning of a range, or merges two ranges.
- */
-static void add_codepoint(BMFONT_PARSER *parser, int codepoint) {
-   ALLEGRO_FONT *font = parser->font;
-   BMFONT_DATA *data = font->data;
-   BMFONT_RANGE *prev = NULL;
-   BMFONT_RANGE *range = data->range_first;
-   while (range) {
-      if (codepoint == range->first - 1) {
-         prepend_char(parser, range);
-         return;
-      }
-      if (codepoint < range->first) {
-         insert_new_range(parser, prev, codepoint);
-         return;
-      }
-      if (codepoint == range->first + range->count) {
-         append_char(parser, range);
-         BMFONT_RANGE *range2 = range->next;
-         if (range2 != NULL && codepoint == range2->first - 1) {
-            combine_ranges(data, range, range2);
-         }
-         return;
-      }
-      prev = range;
-      range = range->next;
-   }
-   insert_new_range(parser, prev, codepoint);
+static int compare_kerning(const void *a, const void *b) {
+   const BMFONT_KERNING *ka = a;
+   const BMFONT_KERNING *kb = b;
+   if (ka->first != kb->first)
+      return (ka->first > kb->first) - (ka->first < kb->first);
+   return (ka->second > kb->second) - (ka->second < kb->second);
 }
 
 static BMFONT_CHAR *find_codepoint(BMFONT_DATA *data, int codepoint) {
@@ -144,23 +83,106 @@ static BMFONT_CHAR *find_codepoint(BMFONT_DATA *data, int codepoint) {
    while (range) {
       if (codepoint >= range->first &&
             codepoint < range->first + range->count) {
-         return range->characters[codepoint - range->first];
+         return &range->characters[codepoint - range->first];
       }
       range = range->next;
    }
    return NULL;
 }
 
+/* Once all characters and kerning pairs are read, sorts them and builds
+ * the ranges and per character kerning lists in one go.
+ */
+static bool build_ranges(BMFONT_DATA *data) {
+   BMFONT_RANGE **next = &data->range_first;
+   int i, n = 0;
+
+   /* qsort must not be passed NULL, even for no elements. */
+   if (data->chars_count > 0)
+      qsort(data->chars, data->chars_count, sizeof *data->chars,
+         compare_chars);
+   for (i = 0; i < data->chars_count; i++) {
+      /* Keep the first of duplicated characters. */
+      if (n > 0 && data->chars[n - 1].id == data->chars[i].id)
+         continue;
+      data->chars[n++] = data->chars[i];
+   }
+   data->chars_count = n;
+
+   for (i = 0; i < data->chars_count; ) {
+      BMFONT_RANGE *range = al_calloc(1, sizeof *range);
+      if (!range)
+         return false;
+      range->first = data->chars[i].id;
+      range->characters = &data->chars[i];
+      do {
+         range->count++;
+         i++;
+      } while (i < data->chars_count &&
+         data->chars[i].id == range->first + range->count);
+      *next = range;
+      next = &range->next;
+   }
+
+   if (data->kerning_pairs > 0)
+      qsort(data->kerning, data->kerning_pairs, sizeof *data->kerning,
+         compare_kerning);
+   for (i = 0; i < data->kerning_pairs; ) {
+      BMFONT_CHAR *c = find_codepoint(data, data->kerning[i].first);
+      int j = i + 1;
+      while (j < data->kerning_pairs &&
+            data->kerning[j].first == data->kerning[i].first)
+         j++;
+      if (c) {
+         c->kerning = &data->kerning[i];
+         c->kerning_pairs = j - i;
+      }
+      i = j;
+   }
+   return true;
+}
+
+static ALLEGRO_BITMAP *load_page(ALLEGRO_PATH *path, char const *filename,
+      int flags) {
+   ALLEGRO_BITMAP *page;
+   al_set_path_filename(path, filename);
+   page = al_load_bitmap_flags(al_path_cstr(path, '/'), flags);
+   if (!page)
+      ALLEGRO_WARN("Could not load font page %s.\n", al_path_cstr(path, '/'));
+   return page;
+}
+
+/* Every character must be on a page which could be loaded, as they are
+ * drawn without checking.
+ */
+static bool check_pages(BMFONT_DATA *data, const char *filename) {
+   int i;
+   for (i = 0; i < data->pages_count; i++) {
+      if (!data->pages[i]) {
+         ALLEGRO_ERROR("%s: font page %d could not be loaded.\n", filename,
+            i);
+         return false;
+      }
+   }
+   for (i = 0; i < data->chars_count; i++) {
+      if (data->chars[i].page < 0 ||
+            data->chars[i].page >= data->pages_count) {
+         ALLEGRO_ERROR("%s: character %d is on page %d of %d.\n", filename,
+            data->chars[i].id, data->chars[i].page, data->pages_count);
+         return false;
+      }
+   }
+   return true;
+}
+
 static void add_page(BMFONT_PARSER *parser, char const *filename) {
    ALLEGRO_FONT *font = parser->font;
    BMFONT_DATA *data = font->data;
    data->pages_count++;
    data->pages = al_realloc(data->pages, data->pages_count *
       sizeof *data->pages);
-   al_set_path_filename(parser->path, filename);
-   ALLEGRO_BITMAP *page = al_load_bitmap_flags(
-      al_path_cstr(parser->path, '/'), data->flags);
-   data->pages[data->pages_count - 1] = page;
+   data->pages[data->pages_count - 1] = load_page(parser->path, filename,
+      data->flags);
 }
 
 static bool tag_is(BMFONT_PARSER *parser, char const *str) {
@@ -183,7 +205,8 @@ static int xml_callback(XmlState state, char const *value, void *u)
    if (state == ElementName) {
       al_ustr_assign_cstr(parser->tag, value);
       if (tag_is(parser, "char")) {
-         parser->c = al_calloc(1, sizeof *parser->c);
+         parser->c = _al_vector_alloc_back(&parser->chars);
+         memset(parser->c, 0, sizeof *parser->c);
       }
       else if (tag_is(parser, "kerning")) {
          data->kerning_pairs++;
@@ -205,9 +228,7 @@ static int xml_callback(XmlState state, char const *value, void *u)
          else if (attribute_is(parser, "page")) parser->c->page = get_int(value);
          else if (attribute_is(parser, "xadvance")) parser->c->xadvance = get_int(value);
          else if (attribute_is(parser, "chnl")) parser->c->chnl = get_int(value);
-         else if (attribute_is(parser, "id")) {
-            add_codepoint(parser, get_int(value));
-         }
+         else if (attribute_is(parser, "id")) parser->c->id = get_int(value);
       }
       else if (tag_is(parser, "page")) {
          if (attribute_is(parser, "file")) {
@@ -389,25 +410,33 @@ static int render_char(const ALLEGRO_FONT *f, ALLEGRO_COLOR color, int ch, float
    return c->xadvance;
 }
 
-static int render_char_cb(const ALLEGRO_FONT *f, ALLEGRO_COLOR color,
-      int ch, float x, float y, ALLEGRO_GLYPH *glyph) {
-   (void)glyph;
-   return render_char(f, color, ch, x, y);
-}
-
 static int render(const ALLEGRO_FONT *f, ALLEGRO_COLOR color,
       const ALLEGRO_USTR *text, float x, float y) {
-   return each_character(f, color, text, x, y, NULL, render_char_cb);
-}
-
-static void destroy_range(BMFONT_RANGE *range) {
-   int i;
-   for (i = 0; i < range->count; i++) {
-      BMFONT_CHAR *c = range->characters[i];
-      al_free(c->kerning);
-      al_free(c);
+   BMFONT_DATA *data = f->data;
+   _AL_GLYPH_BATCH batch;
+   BMFONT_CHAR *pc = NULL;
+   int pos = 0;
+   int advance = 0;
+   _al_font_init_glyph_batch(&batch, color);
+   while (true) {
+      int ch = al_ustr_get_next(text, &pos);
+      if (ch < 0) break;
+      BMFONT_CHAR *c = find_codepoint(data, ch);
+      advance += get_kerning(pc, ch);
+      if (c) {
+         _al_font_batch_glyph(&batch, data->pages[c->page], c->x, c->y,
+            c->width, c->height, x + advance + c->xoffset, y + c->yoffset);
+         advance += c->xadvance;
+      }
+      else if (f->fallback) {
+         _al_font_flush_glyph_batch(&batch);
+         advance += f->fallback->vtable->render_char(f->fallback, color, ch,
+            x + advance, y);
+      }
+      pc = c;
    }
-   al_free(range);
+   _al_font_flush_glyph_batch(&batch);
+   return advance;
 }
 
 static void destroy(ALLEGRO_FONT *f) {
@@ -415,7 +444,7 @@ static void destroy(ALLEGRO_FONT *f) {
    BMFONT_RANGE *range = data->range_first;
    while (range) {
       BMFONT_RANGE *next = range->next;
-      destroy_range(range);
+      al_free(range);
       range = next;
    }
 
@@ -425,7 +454,9 @@ static void destroy(ALLEGRO_FONT *f) {
    }
    al_free(data->pages);
    
+   al_free(data->chars);
    al_free(data->kerning);
+   al_free(data);
    al_free(f);
 }
 
@@ -476,44 +507,265 @@ static ALLEGRO_FONT_VTABLE _al_font_vtable_xml = {
    get_glyph
 };
 
-ALLEGRO_FONT *_al_load_bmfont_xml(const char *filename, int size,
+static ALLEGRO_FONT *create_font(int font_flags) {
+   ALLEGRO_FONT *font = al_calloc(1, sizeof *font);
+   BMFONT_DATA *data = al_calloc(1, sizeof *data);
+   if (!font || !data) {
+      al_free(font);
+      al_free(data);
+      return NULL;
+   }
+   data->flags = font_flags;
+   font->vtable = &_al_font_vtable_xml;
+   font->data = data;
+   return font;
+}
+
+static ALLEGRO_FONT *load_bmfont_xml_f(ALLEGRO_FILE *f, const char *filename,
       int font_flags)
 {
-   (void)size;
-   ALLEGRO_FILE *f = al_fopen(filename, "r");
-   if (!f) {
-      ALLEGRO_DEBUG("Could not open %s.\n", filename);
+   ALLEGRO_FONT *font = create_font(font_flags);
+   if (!font) {
+      al_fclose(f);
       return NULL;
    }
 
-   BMFONT_DATA *data = al_calloc(1, sizeof *data);
+   BMFONT_DATA *data = font->data;
    BMFONT_PARSER _parser;
    BMFONT_PARSER *parser = &_parser;
    parser->tag = al_ustr_new("");
    parser->attribute = al_ustr_new("");
    parser->path = al_create_path(filename);
-   data->flags = font_flags;
-
-   ALLEGRO_FONT *font = al_calloc(1, sizeof *font);
-   font->vtable = &_al_font_vtable_xml;
-   font->data = data;
    parser->font = font;
+   _al_vector_init(&parser->chars, sizeof(BMFONT_CHAR));
 
    _al_xml_parse(f, xml_callback, parser);
 
-   int i;
-   for (i = 0; i < data->kerning_pairs; i++) {
-      BMFONT_KERNING *k = data->kerning + i;
-      BMFONT_CHAR *c = find_codepoint(data, k->first);
-      c->kerning_pairs++;
-      c->kerning = al_realloc(c->kerning, c->kerning_pairs *
-         sizeof *c->kerning);
-      c->kerning[c->kerning_pairs - 1] = *k;
+   /* Take the characters out of the vector, so they can be sorted and the
+    * ranges built with a single allocation for them.
+    */
+   data->chars_count = _al_vector_size(&parser->chars);
+   if (data->chars_count > 0) {
+      data->chars = al_malloc(data->chars_count * sizeof *data->chars);
+      if (data->chars)
+         memcpy(data->chars, _al_vector_ref_front(&parser->chars),
+            data->chars_count * sizeof *data->chars);
    }
+   _al_vector_free(&parser->chars);
 
    al_ustr_free(parser->tag);
    al_ustr_free(parser->attribute);
    al_destroy_path(parser->path);
+
+   if ((data->chars_count > 0 && !data->chars) ||
+         !check_pages(data, filename) || !build_ranges(data)) {
+      destroy(font);
+      return NULL;
+   }
    
    return font;
 }
+
+ALLEGRO_FONT *_al_load_bmfont_xml(const char *filename, int size,
+      int font_flags)
+{
+   (void)size;
+   ALLEGRO_FILE *f = al_fopen(filename, "r");
+   if (!f) {
+      ALLEGRO_DEBUG("Could not open %s.\n", filename);
+      return NULL;
+   }
+   return load_bmfont_xml_f(f, filename, font_flags);
+}
+
+/* The binary .fnt format written by the AngelCode Bitmap Font Generator,
+ * version 3: "BMF", a version byte, then blocks of a type byte, a 32-bit
+ * size and that many bytes.  The character and kerning blocks are arrays
+ * of fixed size records, each read in with a single al_fread.
+ */
+enum {
+   BMF_BLOCK_INFO = 1,
+   BMF_BLOCK_COMMON = 2,
+   BMF_BLOCK_PAGES = 3,
+   BMF_BLOCK_CHARS = 4,
+   BMF_BLOCK_KERNING = 5
+};
+
+#define BMF_COMMON_SIZE 15
+#define BMF_CHAR_SIZE 20
+#define BMF_KERNING_SIZE 10
+
+static int get_u16(const unsigned char *p) {
+   return p[0] | (p[1] << 8);
+}
+
+static int get_s16(const unsigned char *p) {
+   return (int16_t)get_u16(p);
+}
+
+static int get_u32(const unsigned char *p) {
+   return (int)((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+      ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static bool read_binary_pages(BMFONT_DATA *data, const char *filename,
+      const unsigned char *block, int size) {
+   ALLEGRO_PATH *path = al_create_path(filename);
+   const char *names = (const char *)block;
+   int pos = 0;
+
+   if (!path)
+      return false;
+   while (pos < size) {
+      const char *end = memchr(names + pos, '\0', size - pos);
+      int len;
+      /* The names must be NUL terminated within the block. */
+      if (!end)
+         break;
+      len = end - (names + pos);
+      data->pages_count++;
+      data->pages = al_realloc(data->pages,
+         data->pages_count * sizeof *data->pages);
+      data->pages[data->pages_count - 1] = load_page(path, names + pos,
+         data->flags);
+      pos += len + 1;
+   }
+   al_destroy_path(path);
+   return true;
+}
+
+static bool read_binary_chars(BMFONT_DATA *data,
+      const unsigned char *block, int size) {
+   int i;
+   data->chars_count = size / BMF_CHAR_SIZE;
+   if (data->chars_count == 0)
+      return true;
+   data->chars = al_calloc(data->chars_count, sizeof *data->chars);
+   if (!data->chars)
+      return false;
+   for (i = 0; i < data->chars_count; i++) {
+      const unsigned char *p = block + i * BMF_CHAR_SIZE;
+      BMFONT_CHAR *c = &data->chars[i];
+      c->id = get_u32(p);
+      c->x = get_u16(p + 4);
+      c->y = get_u16(p + 6);
+      c->width = get_u16(p + 8);
+      c->height = get_u16(p + 10);
+      c->xoffset = get_s16(p + 12);
+      c->yoffset = get_s16(p + 14);
+      c->xadvance = get_s16(p + 16);
+      c->page = p[18];
+      c->chnl = p[19];
+   }
+   return true;
+}
+
+static bool read_binary_kerning(BMFONT_DATA *data,
+      const unsigned char *block, int size) {
+   int i;
+   data->kerning_pairs = size / BMF_KERNING_SIZE;
+   if (data->kerning_pairs == 0)
+      return true;
+   data->kerning = al_malloc(data->kerning_pairs * sizeof *data->kerning);
+   if (!data->kerning)
+      return false;
+   for (i = 0; i < data->kerning_pairs; i++) {
+      const unsigned char *p = block + i * BMF_KERNING_SIZE;
+      BMFONT_KERNING *k = &data->kerning[i];
+      k->first = get_u32(p);
+      k->second = get_u32(p + 4);
+      k->amount = get_s16(p + 8);
+   }
+   return true;
+}
+
+static ALLEGRO_FONT *load_bmfont_binary_f(ALLEGRO_FILE *f,
+      const char *filename, int font_flags)
+{
+   ALLEGRO_FONT *font;
+   BMFONT_DATA *data;
+   unsigned char *block = NULL;
+   bool ok = true;
+   int type;
+
+   if (al_fgetc(f) != 3) {
+      ALLEGRO_ERROR("%s: only version 3 of the binary format is supported.\n",
+         filename);
+      al_fclose(f);
+      return NULL;
+   }
+
+   font = create_font(font_flags);
+   if (!font) {
+      al_fclose(f);
+      return NULL;
+   }
+   data = font->data;
+
+   while (ok && (type = al_fgetc(f)) != EOF) {
+      int32_t size = al_fread32le(f);
+      if (al_feof(f) || size < 0 || size > (1 << 28)) {
+         ok = false;
+         break;
+      }
+      block = al_malloc(size ? size : 1);
+      if (!block || al_fread(f, block, size) != (size_t)size) {
+         ok = false;
+         break;
+      }
+      switch (type) {
+         case BMF_BLOCK_COMMON:
+            if (size < BMF_COMMON_SIZE) {
+               ok = false;
+               break;
+            }
+            data->line_height = get_u16(block);
+            data->base = get_u16(block + 2);
+            break;
+         case BMF_BLOCK_PAGES:
+            ok = read_binary_pages(data, filename, block, size);
+            break;
+         case BMF_BLOCK_CHARS:
+            ok = !data->chars && read_binary_chars(data, block, size);
+            break;
+         case BMF_BLOCK_KERNING:
+            ok = !data->kerning && read_binary_kerning(data, block, size);
+            break;
+         default:
+            /* The info block only describes how the font was generated. */
+            break;
+      }
+      al_free(block);
+      block = NULL;
+   }
+   al_free(block);
+   al_fclose(f);
+
+   if (!ok || !check_pages(data, filename) || !build_ranges(data)) {
+      ALLEGRO_ERROR("%s: invalid binary BMFont file.\n", filename);
+      destroy(font);
+      return NULL;
+   }
+
+   return font;
+}
+
+/* Loads a .fnt file, which may be either in the XML or the binary
+ * format.
+ */
+ALLEGRO_FONT *_al_load_bmfont(const char *filename, int size,
+      int font_flags)
+{
+   char magic[3];
+   ALLEGRO_FILE *f = al_fopen(filename, "rb");
+   if (!f) {
+      ALLEGRO_DEBUG("Could not open %s.\n", filename);
+      return NULL;
+   }
+
+   if (al_fread(f, magic, 3) == 3 && memcmp(magic, "BMF", 3) == 0)
+      return load_bmfont_binary_f(f, filename, font_flags);
+
+   al_fclose(f);
+   return _al_load_bmfont_xml(filename, size, font_flags);
+}
@@ -196,16 +196,29 @@ static int color_render(const ALLEGRO_FONT* f, ALLEGRO_COLOR color,
    const ALLEGRO_USTR *text,
     float x, float y)
 {
+    _AL_GLYPH_BATCH batch;
+    int h = f->vtable->font_height(f);
     int pos = 0;
     int advance = 0;
     int32_t ch;
-    bool held = al_is_bitmap_drawing_held();
 
-    al_hold_bitmap_drawing(true);
+    _al_font_init_glyph_batch(&batch, color);
     while ((ch = al_ustr_get_next(text, &pos)) >= 0) {
-        advance += f->vtable->render_char(f, color, ch, x + advance, y);
+        ALLEGRO_BITMAP *g = _al_font_color_find_glyph(f, ch);
+        if (g) {
+            int gw = al_get_bitmap_width(g);
+            int gh = al_get_bitmap_height(g);
+            _al_font_batch_glyph(&batch, g, 0, 0, gw, gh, x + advance,
+               y + ((float)h - gh)/2.0f);
+            advance += gw;
+        }
+        else if (f->fallback) {
+            _al_font_flush_glyph_batch(&batch);
+            al_draw_glyph(f->fallback, color, x + advance, y, ch);
+            advance += al_get_glyph_width(f->fallback, ch);
+        }
     }
-    al_hold_bitmap_drawing(held);
+    _al_font_flush_glyph_batch(&batch);
     return advance;
 }
 
@@ -221,7 +234,8 @@ static bool color_get_glyph(const ALLEGRO_FONT *f, int prev_codepoint, int codep
       glyph->h = al_get_bitmap_height(g);
       glyph->kerning = 0;
       glyph->offset_x = 0;
-      glyph->offset_y = 0;
+      /* Glyphs shorter than the font are centred, as in color_render_char. */
+      glyph->offset_y = (f->vtable->font_height(f) - glyph->h) / 2;
       glyph->advance = glyph->w;
       return true;
    }
@@ -356,6 +370,8 @@ static void font_shutdown(void)
     }
     _al_vector_free(&font_handlers);
 
+    _al_font_shutdown_layout_cache();
+
     font_inited = false;
 }
 
@@ -376,7 +392,7 @@ bool al_init_font_addon(void)
    al_register_font_loader(".tga", _al_load_bitmap_font);
 
    al_register_font_loader(".xml", _al_load_bmfont_xml);
-   al_register_font_loader(".fnt", _al_load_bmfont_xml);
+   al_register_font_loader(".fnt", _al_load_bmfont);
 
    _al_add_exit_func(font_shutdown, "font_shutdown");
 
@@ -17,6 +17,8 @@ ALLEGRO_FONT *_al_load_bitmap_font(const char *filename,
    int size, int flags);
 ALLEGRO_FONT *_al_load_bmfont_xml(const char *filename,
    int size, int flags);
+ALLEGRO_FONT *_al_load_bmfont(const char *filename,
+   int size, int flags);
 
 
 #endif
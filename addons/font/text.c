@@ -57,7 +57,10 @@ static void align_to_integer_pixel_inner(
    al_transform_coordinates(inv, x, y);
 }
 
-static void align_to_integer_pixel(float *x, float *y)
+/* _al_font_align_to_integer_pixel:
+ *  Moves x and y to the nearest pixel under the current transformation.
+ */
+void _al_font_align_to_integer_pixel(float *x, float *y)
 {
    ALLEGRO_TRANSFORM const *fwd;
    ALLEGRO_TRANSFORM inv;
@@ -70,6 +73,61 @@ static void align_to_integer_pixel(float *x, float *y)
 
 
 
+/* _al_font_init_glyph_batch:
+ *  Starts collecting glyphs to draw in the given color.
+ */
+void _al_font_init_glyph_batch(_AL_GLYPH_BATCH *batch, ALLEGRO_COLOR color)
+{
+   batch->bitmap = NULL;
+   batch->color = color;
+   batch->count = 0;
+}
+
+/* _al_font_batch_glyph:
+ *  Adds a glyph, drawing the ones collected so far first if it lives on a
+ *  different bitmap.  Sub-bitmaps are batched with their parent, so all
+ *  glyphs on one glyph sheet go together.
+ */
+void _al_font_batch_glyph(_AL_GLYPH_BATCH *batch, ALLEGRO_BITMAP *bitmap,
+   float sx, float sy, float sw, float sh, float dx, float dy)
+{
+   ALLEGRO_BITMAP *parent = al_get_parent_bitmap(bitmap);
+   _AL_BITMAP_REGION *r;
+
+   if (parent) {
+      sx += al_get_bitmap_x(bitmap);
+      sy += al_get_bitmap_y(bitmap);
+      bitmap = parent;
+   }
+
+   if (bitmap != batch->bitmap || batch->count == _AL_GLYPH_BATCH_SIZE) {
+      _al_font_flush_glyph_batch(batch);
+      batch->bitmap = bitmap;
+   }
+
+   r = &batch->regions[batch->count++];
+   r->sx = sx;
+   r->sy = sy;
+   r->sw = sw;
+   r->sh = sh;
+   r->dx = dx;
+   r->dy = dy;
+}
+
+/* _al_font_flush_glyph_batch:
+ *  Draws the glyphs collected so far.
+ */
+void _al_font_flush_glyph_batch(_AL_GLYPH_BATCH *batch)
+{
+   if (batch->count > 0) {
+      _al_draw_tinted_bitmap_regions(batch->bitmap, batch->color,
+         batch->regions, batch->count);
+      batch->count = 0;
+   }
+}
+
+
+
 /* Function: al_draw_ustr
  */
 void al_draw_ustr(const ALLEGRO_FONT *font,
@@ -79,6 +137,9 @@ void al_draw_ustr(const ALLEGRO_FONT *font,
    ASSERT(font);
    ASSERT(ustr);
 
+   if (_al_font_draw_cached_layout(font, color, x, y, flags, ustr))
+      return;
+
    if (flags & ALLEGRO_ALIGN_CENTRE) {
       /* Use integer division to avoid introducing a fractional
        * component to an integer x value.
@@ -90,7 +151,7 @@ void al_draw_ustr(const ALLEGRO_FONT *font,
    }
 
    if (flags & ALLEGRO_ALIGN_INTEGER)
-      align_to_integer_pixel(&x, &y);
+      _al_font_align_to_integer_pixel(&x, &y);
 
    font->vtable->render(font, color, ustr, x, y);
 }
@@ -155,7 +216,7 @@ void al_draw_justified_ustr(const ALLEGRO_FONT *font,
    if ((space <= 0) || (space > diff) || (num_words < 2)) {
       /* can't justify */
       if (flags & ALLEGRO_ALIGN_INTEGER)
-         align_to_integer_pixel(&x1, &y);
+         _al_font_align_to_integer_pixel(&x1, &y);
       font->vtable->render(font, color, ustr, x1, y);
       return; 
    }
@@ -361,6 +422,7 @@ void al_destroy_font(ALLEGRO_FONT *f)
       return;
 
    _al_unregister_destructor(_al_dtor_list, f->dtor_item);
+   _al_font_clear_layout_cache();
 
    f->vtable->destroy(f);
 }
@@ -452,7 +514,7 @@ static const ALLEGRO_USTR *ustr_split_next(const ALLEGRO_USTR *ustr,
  * line was split, but pos will be set to point to after that trailing
  * space so iteration can continue easily.
  */
-static const ALLEGRO_USTR *get_next_soft_line(const ALLEGRO_USTR *ustr,
+const ALLEGRO_USTR *_al_font_get_next_soft_line(const ALLEGRO_USTR *ustr,
    ALLEGRO_USTR_INFO *info, int *pos,
    const ALLEGRO_FONT *font, float max_width)
 {
@@ -533,7 +595,7 @@ void al_do_multiline_ustr(const ALLEGRO_FONT *font, float max_width,
       /* For every "soft" line in the "hard" line... */
       soft_line_pos = 0;
       soft_line =
-      get_next_soft_line(hard_line, &soft_line_info, &soft_line_pos, font,
+      _al_font_get_next_soft_line(hard_line, &soft_line_info, &soft_line_pos, font,
          max_width);
       /* No soft line here because it's an empty hard line. */
       if (!soft_line) {
@@ -548,7 +610,7 @@ void al_do_multiline_ustr(const ALLEGRO_FONT *font, float max_width,
          if (!proceed) return;
          line_num++;
 
-         soft_line = get_next_soft_line(hard_line, &soft_line_info,
+         soft_line = _al_font_get_next_soft_line(hard_line, &soft_line_info,
             &soft_line_pos, font, max_width);
       }
       hard_line = ustr_split_next(ustr, &hard_line_info, &hard_line_pos,
@@ -695,6 +757,8 @@ void al_draw_multiline_textf(const ALLEGRO_FONT *font,
  */
 void al_set_fallback_font(ALLEGRO_FONT *font, ALLEGRO_FONT *fallback)
 {
+   if (font->fallback != fallback)
+      _al_font_clear_layout_cache();
    font->fallback = fallback;
 }
 
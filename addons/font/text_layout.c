@@ -0,0 +1,501 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Text layouts, strings with their glyphs already looked up and
+ *      positioned, and a cache of them for al_draw_ustr.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include "allegro5/allegro.h"
+
+#include "allegro5/allegro_font.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_atomicops.h"
+#include "allegro5/internal/aintern_font.h"
+
+ALLEGRO_DEBUG_CHANNEL("font")
+
+
+typedef struct LAYOUT_GLYPH
+{
+   ALLEGRO_BITMAP *bitmap;
+   float sx, sy, sw, sh;
+   float dx, dy;
+} LAYOUT_GLYPH;
+
+struct ALLEGRO_TEXT_LAYOUT
+{
+   const ALLEGRO_FONT *font;
+   int width;
+   int num_glyphs;
+   LAYOUT_GLYPH *glyphs;
+   ALLEGRO_USTR *text;     /* Drawn through the font instead, if set. */
+};
+
+
+/* Fonts that draw their own glyphs, say scaled with a shader, can't be
+ * laid out as bitmap regions.  That includes fonts falling back on one.
+ */
+static bool has_plain_glyphs(const ALLEGRO_FONT *font)
+{
+   for (; font; font = font->fallback) {
+      if (font->draws_own_glyphs)
+         return false;
+   }
+   return true;
+}
+
+
+/* Function: al_create_text_layout
+ */
+ALLEGRO_TEXT_LAYOUT *al_create_text_layout(const ALLEGRO_FONT *font,
+   const ALLEGRO_USTR *ustr)
+{
+   ALLEGRO_TEXT_LAYOUT *layout;
+   int pos = 0;
+   int advance = 0;
+   int32_t prev_ch = -1;
+   int32_t ch;
+   ASSERT(font);
+   ASSERT(ustr);
+
+   layout = al_calloc(1, sizeof *layout);
+   if (!layout)
+      return NULL;
+
+   layout->font = font;
+   layout->width = font->vtable->text_length(font, ustr);
+
+   if (!has_plain_glyphs(font)) {
+      layout->text = al_ustr_dup(ustr);
+      if (!layout->text) {
+         al_free(layout);
+         return NULL;
+      }
+      return layout;
+   }
+
+   /* One glyph per code point at most; al_ustr_length is only a walk over
+    * the string, much cheaper than the glyph lookups below.
+    */
+   if (al_ustr_size(ustr) > 0) {
+      layout->glyphs = al_malloc(al_ustr_length(ustr) * sizeof(LAYOUT_GLYPH));
+      if (!layout->glyphs) {
+         al_free(layout);
+         return NULL;
+      }
+   }
+
+   while ((ch = al_ustr_get_next(ustr, &pos)) >= 0) {
+      ALLEGRO_GLYPH glyph;
+
+      if (font->vtable->get_glyph(font, prev_ch, ch, &glyph)) {
+         if (glyph.bitmap) {
+            LAYOUT_GLYPH *g = &layout->glyphs[layout->num_glyphs++];
+            g->bitmap = glyph.bitmap;
+            g->sx = glyph.x;
+            g->sy = glyph.y;
+            g->sw = glyph.w;
+            g->sh = glyph.h;
+            g->dx = advance + glyph.offset_x + glyph.kerning;
+            g->dy = glyph.offset_y;
+         }
+         advance += glyph.advance;
+      }
+      prev_ch = ch;
+   }
+
+   return layout;
+}
+
+
+/* Function: al_destroy_text_layout
+ */
+void al_destroy_text_layout(ALLEGRO_TEXT_LAYOUT *layout)
+{
+   if (!layout)
+      return;
+
+   al_free(layout->glyphs);
+   al_ustr_free(layout->text);
+   al_free(layout);
+}
+
+
+/* Function: al_get_text_layout_width
+ */
+int al_get_text_layout_width(const ALLEGRO_TEXT_LAYOUT *layout)
+{
+   ASSERT(layout);
+   return layout->width;
+}
+
+
+/* Function: al_get_text_layout_font
+ */
+const ALLEGRO_FONT *al_get_text_layout_font(const ALLEGRO_TEXT_LAYOUT *layout)
+{
+   ASSERT(layout);
+   return layout->font;
+}
+
+
+/* Function: al_draw_text_layout
+ */
+void al_draw_text_layout(const ALLEGRO_TEXT_LAYOUT *layout,
+   ALLEGRO_COLOR color, float x, float y, int flags)
+{
+   _AL_GLYPH_BATCH batch;
+   int i;
+   ASSERT(layout);
+
+   if (flags & ALLEGRO_ALIGN_CENTRE) {
+      /* Integer division, as in al_draw_ustr. */
+      x -= layout->width / 2;
+   }
+   else if (flags & ALLEGRO_ALIGN_RIGHT) {
+      x -= layout->width;
+   }
+
+   if (flags & ALLEGRO_ALIGN_INTEGER)
+      _al_font_align_to_integer_pixel(&x, &y);
+
+   if (layout->text) {
+      layout->font->vtable->render(layout->font, color, layout->text, x, y);
+      return;
+   }
+
+   _al_font_init_glyph_batch(&batch, color);
+
+   for (i = 0; i < layout->num_glyphs; i++) {
+      const LAYOUT_GLYPH *g = &layout->glyphs[i];
+      _al_font_batch_glyph(&batch, g->bitmap, g->sx, g->sy,
+         g->sw, g->sh, x + g->dx, y + g->dy);
+   }
+
+   _al_font_flush_glyph_batch(&batch);
+}
+
+
+
+/* The layout cache maps (font, string) to a layout, through a hash table
+ * with a fixed number of buckets chosen when the cache is sized.  The
+ * drawing flags are not part of the key: they only move the whole string,
+ * so every alignment of a string shares one entry.
+ *
+ * The LRU list runs from the most recently drawn entry at the head to the
+ * next one to evict at the tail.
+ *
+ * Fonts which fill in glyphs later, like TTF fonts rasterizing them in the
+ * background, bump the generation; entries from an older one are laid out
+ * again when next drawn.
+ */
+typedef struct LAYOUT_ENTRY LAYOUT_ENTRY;
+
+struct LAYOUT_ENTRY
+{
+   const ALLEGRO_FONT *font;
+   ALLEGRO_USTR *text;
+   uint32_t hash;
+   _AL_ATOMIC generation;
+   ALLEGRO_TEXT_LAYOUT *layout;
+   LAYOUT_ENTRY *next_in_bucket;
+   LAYOUT_ENTRY *lru_prev;
+   LAYOUT_ENTRY *lru_next;
+};
+
+static ALLEGRO_MUTEX *cache_mutex;
+static int cache_max_entries;
+static int cache_num_entries;
+static LAYOUT_ENTRY **cache_buckets;
+static unsigned int cache_num_buckets;    /* Power of two. */
+static LAYOUT_ENTRY *lru_head;
+static LAYOUT_ENTRY *lru_tail;
+static volatile _AL_ATOMIC cache_generation;
+
+
+static uint32_t hash_key(const ALLEGRO_FONT *font, const ALLEGRO_USTR *ustr)
+{
+   uintptr_t p = (uintptr_t)font;
+   const unsigned char *s = (const unsigned char *)al_cstr(ustr);
+   int n = al_ustr_size(ustr);
+   uint32_t h = 2166136261u;
+   unsigned int i;
+
+   for (i = 0; i < sizeof(p); i++) {
+      h ^= (unsigned char)(p >> (i * 8));
+      h *= 16777619u;
+   }
+   while (n-- > 0) {
+      h ^= *s++;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+static void lru_remove(LAYOUT_ENTRY *e)
+{
+   if (e->lru_prev)
+      e->lru_prev->lru_next = e->lru_next;
+   else
+      lru_head = e->lru_next;
+   if (e->lru_next)
+      e->lru_next->lru_prev = e->lru_prev;
+   else
+      lru_tail = e->lru_prev;
+   e->lru_prev = e->lru_next = NULL;
+}
+
+
+static void lru_push_front(LAYOUT_ENTRY *e)
+{
+   e->lru_prev = NULL;
+   e->lru_next = lru_head;
+   if (lru_head)
+      lru_head->lru_prev = e;
+   else
+      lru_tail = e;
+   lru_head = e;
+}
+
+
+static void free_entry(LAYOUT_ENTRY *e)
+{
+   LAYOUT_ENTRY **link = &cache_buckets[e->hash & (cache_num_buckets - 1)];
+
+   while (*link != e)
+      link = &(*link)->next_in_bucket;
+   *link = e->next_in_bucket;
+   lru_remove(e);
+
+   al_destroy_text_layout(e->layout);
+   al_ustr_free(e->text);
+   al_free(e);
+   cache_num_entries--;
+}
+
+
+static void clear_cache(void)
+{
+   while (lru_head)
+      free_entry(lru_head);
+   ASSERT(cache_num_entries == 0);
+}
+
+
+static LAYOUT_ENTRY *find_entry(const ALLEGRO_FONT *font,
+   const ALLEGRO_USTR *ustr, uint32_t hash)
+{
+   LAYOUT_ENTRY *e = cache_buckets[hash & (cache_num_buckets - 1)];
+
+   for (; e; e = e->next_in_bucket) {
+      if (e->hash == hash && e->font == font && al_ustr_equal(e->text, ustr))
+         return e;
+   }
+   return NULL;
+}
+
+
+static LAYOUT_ENTRY *add_entry(const ALLEGRO_FONT *font,
+   const ALLEGRO_USTR *ustr, uint32_t hash)
+{
+   LAYOUT_ENTRY *e;
+   LAYOUT_ENTRY **bucket;
+
+   e = al_calloc(1, sizeof *e);
+   if (!e)
+      return NULL;
+   /* Read first: glyphs may be filled in while the layout is built. */
+   e->generation = cache_generation;
+   e->text = al_ustr_dup(ustr);
+   e->layout = al_create_text_layout(font, ustr);
+   if (!e->text || !e->layout) {
+      al_ustr_free(e->text);
+      al_destroy_text_layout(e->layout);
+      al_free(e);
+      return NULL;
+   }
+   e->font = font;
+   e->hash = hash;
+
+   while (cache_num_entries >= cache_max_entries)
+      free_entry(lru_tail);
+
+   bucket = &cache_buckets[hash & (cache_num_buckets - 1)];
+   e->next_in_bucket = *bucket;
+   *bucket = e;
+   lru_push_front(e);
+   cache_num_entries++;
+
+   return e;
+}
+
+
+/* _al_font_draw_cached_layout:
+ *  Draws the string from the layout cache, building its layout first if
+ *  it is not in there.  Returns false if the cache is disabled, or the
+ *  layout could not be built; the caller should then draw it directly.
+ */
+bool _al_font_draw_cached_layout(const ALLEGRO_FONT *font,
+   ALLEGRO_COLOR color, float x, float y, int flags, const ALLEGRO_USTR *ustr)
+{
+   LAYOUT_ENTRY *e;
+   uint32_t hash;
+
+   if (cache_max_entries == 0 || !has_plain_glyphs(font))
+      return false;
+
+   hash = hash_key(font, ustr);
+
+   al_lock_mutex(cache_mutex);
+   if (cache_max_entries == 0) {
+      al_unlock_mutex(cache_mutex);
+      return false;
+   }
+
+   e = find_entry(font, ustr, hash);
+   if (e && e->generation != cache_generation) {
+      free_entry(e);
+      e = NULL;
+   }
+   if (e) {
+      if (e != lru_head) {
+         lru_remove(e);
+         lru_push_front(e);
+      }
+   }
+   else {
+      e = add_entry(font, ustr, hash);
+      if (!e) {
+         al_unlock_mutex(cache_mutex);
+         return false;
+      }
+   }
+
+   /* Drawn with the lock held, as another thread could evict it. */
+   al_draw_text_layout(e->layout, color, x, y, flags);
+   al_unlock_mutex(cache_mutex);
+
+   return true;
+}
+
+
+/* _al_font_clear_layout_cache:
+ *  Drops all cached layouts.  Called when a font is destroyed or its
+ *  fallback changes, either of which can invalidate the layouts of any
+ *  font that falls back on it.
+ */
+void _al_font_clear_layout_cache(void)
+{
+   if (!cache_mutex)
+      return;
+
+   al_lock_mutex(cache_mutex);
+   clear_cache();
+   al_unlock_mutex(cache_mutex);
+}
+
+
+/* _al_font_invalidate_layout_cache:
+ *  Makes all cached layouts be laid out again when they are next drawn.
+ *  Unlike _al_font_clear_layout_cache this takes no lock, so fonts can call
+ *  it from their glyph lookups, which run while a layout is being cached.
+ */
+void _al_font_invalidate_layout_cache(void)
+{
+   _al_fetch_and_add1(&cache_generation);
+}
+
+
+/* _al_font_shutdown_layout_cache:
+ *  Frees the layout cache and disables it.
+ */
+void _al_font_shutdown_layout_cache(void)
+{
+   if (!cache_mutex)
+      return;
+
+   clear_cache();
+   al_free(cache_buckets);
+   cache_buckets = NULL;
+   cache_num_buckets = 0;
+   cache_max_entries = 0;
+   al_destroy_mutex(cache_mutex);
+   cache_mutex = NULL;
+}
+
+
+/* Function: al_set_text_layout_cache_size
+ */
+bool al_set_text_layout_cache_size(int max_entries)
+{
+   LAYOUT_ENTRY **buckets = NULL;
+   unsigned int num_buckets = 0;
+
+   if (max_entries < 0) {
+      ALLEGRO_ERROR("Negative text layout cache size %d.\n", max_entries);
+      return false;
+   }
+
+   if (!cache_mutex) {
+      if (max_entries == 0)
+         return true;
+      cache_mutex = al_create_mutex();
+      if (!cache_mutex)
+         return false;
+   }
+
+   if (max_entries > 0) {
+      /* Aim for an average of at most one entry per bucket. */
+      num_buckets = 16;
+      while (num_buckets < (unsigned int)max_entries)
+         num_buckets *= 2;
+   }
+
+   al_lock_mutex(cache_mutex);
+
+   if (num_buckets != cache_num_buckets) {
+      if (num_buckets > 0) {
+         buckets = al_calloc(num_buckets, sizeof *buckets);
+         if (!buckets) {
+            al_unlock_mutex(cache_mutex);
+            return false;
+         }
+      }
+      clear_cache();
+      al_free(cache_buckets);
+      cache_buckets = buckets;
+      cache_num_buckets = num_buckets;
+   }
+   else {
+      while (cache_num_entries > max_entries)
+         free_entry(lru_tail);
+   }
+   cache_max_entries = max_entries;
+
+   al_unlock_mutex(cache_mutex);
+
+   ALLEGRO_DEBUG("Text layout cache holds up to %d strings.\n", max_entries);
+   return true;
+}
+
+
+/* Function: al_get_text_layout_cache_size
+ */
+int al_get_text_layout_cache_size(void)
+{
+   return cache_max_entries;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
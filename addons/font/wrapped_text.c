@@ -0,0 +1,356 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Wrapped text, multiline text with its line breaks kept around
+ *      and updated as text is appended.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include "allegro5/allegro.h"
+
+#include "allegro5/allegro_font.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_font.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("font")
+
+
+/* A line as al_do_multiline_ustr would pass it to its callback, as a byte
+ * range of the text.  first is set on the first line of each hard line, so
+ * the lines a hard line was wrapped into can be found again.
+ */
+typedef struct WRAPPED_LINE
+{
+   int start, end;
+   int width;
+   bool first;
+} WRAPPED_LINE;
+
+struct ALLEGRO_WRAPPED_TEXT
+{
+   const ALLEGRO_FONT *font;
+   float max_width;
+   ALLEGRO_USTR *text;
+   _AL_VECTOR lines;       /* of WRAPPED_LINE */
+};
+
+
+static bool add_line(ALLEGRO_WRAPPED_TEXT *wrapped, _AL_VECTOR *lines,
+   int start, int end, bool first)
+{
+   ALLEGRO_USTR_INFO info;
+   WRAPPED_LINE *line = _al_vector_alloc_back(lines);
+   if (!line)
+      return false;
+
+   line->start = start;
+   line->end = end;
+   line->width = (start == end) ? 0 : al_get_ustr_width(wrapped->font,
+      al_ref_ustr(&info, wrapped->text, start, end));
+   line->first = first;
+   return true;
+}
+
+
+/* Wraps the hard line from start to end (which excludes the newline) into
+ * soft lines, the same way al_do_multiline_ustr does.
+ */
+static bool wrap_hard_line(ALLEGRO_WRAPPED_TEXT *wrapped, _AL_VECTOR *lines,
+   int start, int end)
+{
+   ALLEGRO_USTR_INFO hard_info, soft_info;
+   const ALLEGRO_USTR *hard_line, *soft_line;
+   int pos = 0;
+   int line_start = 0;
+   bool first = true;
+
+   if (start == end)
+      return add_line(wrapped, lines, start, start, true);
+
+   hard_line = al_ref_ustr(&hard_info, wrapped->text, start, end);
+   while ((soft_line = _al_font_get_next_soft_line(hard_line, &soft_info,
+         &pos, wrapped->font, wrapped->max_width))) {
+      int s = start + line_start;
+      if (!add_line(wrapped, lines, s, s + al_ustr_size(soft_line), first))
+         return false;
+      first = false;
+      line_start = pos;
+   }
+   return true;
+}
+
+
+/* Wraps all of the text from pos on, which must be the start of a hard
+ * line.
+ */
+static bool wrap_from(ALLEGRO_WRAPPED_TEXT *wrapped, int pos)
+{
+   int size = al_ustr_size(wrapped->text);
+
+   while (pos < size) {
+      int end = al_ustr_find_chr(wrapped->text, pos, '\n');
+      if (end < 0)
+         end = size;
+      if (!wrap_hard_line(wrapped, &wrapped->lines, pos, end))
+         return false;
+      pos = end + 1;
+   }
+   return true;
+}
+
+
+/* Function: al_create_wrapped_text
+ */
+ALLEGRO_WRAPPED_TEXT *al_create_wrapped_text(const ALLEGRO_FONT *font,
+   float max_width)
+{
+   ALLEGRO_WRAPPED_TEXT *wrapped;
+   ASSERT(font);
+
+   wrapped = al_calloc(1, sizeof *wrapped);
+   if (!wrapped)
+      return NULL;
+
+   wrapped->text = al_ustr_new("");
+   if (!wrapped->text) {
+      al_free(wrapped);
+      return NULL;
+   }
+   wrapped->font = font;
+   wrapped->max_width = max_width;
+   _al_vector_init(&wrapped->lines, sizeof(WRAPPED_LINE));
+
+   return wrapped;
+}
+
+
+/* Function: al_destroy_wrapped_text
+ */
+void al_destroy_wrapped_text(ALLEGRO_WRAPPED_TEXT *wrapped)
+{
+   if (!wrapped)
+      return;
+
+   _al_vector_free(&wrapped->lines);
+   al_ustr_free(wrapped->text);
+   al_free(wrapped);
+}
+
+
+/* Function: al_append_wrapped_ustr
+ */
+bool al_append_wrapped_ustr(ALLEGRO_WRAPPED_TEXT *wrapped,
+   const ALLEGRO_USTR *ustr)
+{
+   int old_size;
+   int pos;
+   ASSERT(wrapped);
+   ASSERT(ustr);
+
+   old_size = al_ustr_size(wrapped->text);
+   pos = old_size;
+
+   /* Unless the text ended in a newline, its last hard line continues in
+    * the new text and has to be wrapped again.
+    */
+   if (old_size > 0 && al_ustr_get(wrapped->text, old_size - 1) != '\n') {
+      while (_al_vector_is_nonempty(&wrapped->lines)) {
+         WRAPPED_LINE *line = _al_vector_ref_back(&wrapped->lines);
+         bool first = line->first;
+         pos = line->start;
+         _al_vector_delete_at(&wrapped->lines,
+            _al_vector_size(&wrapped->lines) - 1);
+         if (first)
+            break;
+      }
+   }
+
+   if (!al_ustr_append(wrapped->text, ustr))
+      return false;
+
+   if (!wrap_from(wrapped, pos)) {
+      ALLEGRO_ERROR("Out of memory wrapping text.\n");
+      /* Keep the lines matching the text. */
+      al_ustr_truncate(wrapped->text, old_size);
+      _al_vector_free(&wrapped->lines);
+      wrap_from(wrapped, 0);
+      return false;
+   }
+   return true;
+}
+
+
+/* Function: al_append_wrapped_text
+ */
+bool al_append_wrapped_text(ALLEGRO_WRAPPED_TEXT *wrapped, const char *text)
+{
+   ALLEGRO_USTR_INFO info;
+   ASSERT(text);
+
+   return al_append_wrapped_ustr(wrapped, al_ref_cstr(&info, text));
+}
+
+
+/* Function: al_clear_wrapped_text
+ */
+void al_clear_wrapped_text(ALLEGRO_WRAPPED_TEXT *wrapped)
+{
+   ASSERT(wrapped);
+
+   al_ustr_truncate(wrapped->text, 0);
+   _al_vector_free(&wrapped->lines);
+}
+
+
+/* Function: al_set_wrapped_text_max_width
+ */
+bool al_set_wrapped_text_max_width(ALLEGRO_WRAPPED_TEXT *wrapped,
+   float max_width)
+{
+   _AL_VECTOR lines;
+   float old_max_width;
+   unsigned i, j;
+   ASSERT(wrapped);
+
+   if (max_width == wrapped->max_width)
+      return true;
+
+   old_max_width = wrapped->max_width;
+   wrapped->max_width = max_width;
+   _al_vector_init(&lines, sizeof(WRAPPED_LINE));
+
+   for (i = 0; i < _al_vector_size(&wrapped->lines); i = j) {
+      WRAPPED_LINE *line = _al_vector_ref(&wrapped->lines, i);
+      int end = al_ustr_find_chr(wrapped->text, line->start, '\n');
+      if (end < 0)
+         end = al_ustr_size(wrapped->text);
+
+      for (j = i + 1; j < _al_vector_size(&wrapped->lines); j++) {
+         WRAPPED_LINE *next = _al_vector_ref(&wrapped->lines, j);
+         if (next->first)
+            break;
+      }
+
+      /* A hard line that wasn't wrapped and still fits stays as it is,
+       * which is most of them in a typical log.  (A single word too long
+       * for the line loses trailing whitespace, so check the end too.)
+       */
+      if (j == i + 1 && line->end == end && line->width <= max_width) {
+         WRAPPED_LINE *copy = _al_vector_alloc_back(&lines);
+         if (!copy)
+            goto fail;
+         *copy = *line;
+      }
+      else if (!wrap_hard_line(wrapped, &lines, line->start, end)) {
+         goto fail;
+      }
+   }
+
+   _al_vector_free(&wrapped->lines);
+   wrapped->lines = lines;
+   return true;
+
+fail:
+   ALLEGRO_ERROR("Out of memory wrapping text.\n");
+   _al_vector_free(&lines);
+   wrapped->max_width = old_max_width;
+   return false;
+}
+
+
+/* Function: al_get_wrapped_text_max_width
+ */
+float al_get_wrapped_text_max_width(const ALLEGRO_WRAPPED_TEXT *wrapped)
+{
+   ASSERT(wrapped);
+   return wrapped->max_width;
+}
+
+
+/* Function: al_get_wrapped_text_line_count
+ */
+int al_get_wrapped_text_line_count(const ALLEGRO_WRAPPED_TEXT *wrapped)
+{
+   ASSERT(wrapped);
+   return _al_vector_size(&wrapped->lines);
+}
+
+
+/* Function: al_get_wrapped_text_line
+ */
+const ALLEGRO_USTR *al_get_wrapped_text_line(
+   const ALLEGRO_WRAPPED_TEXT *wrapped, int line, ALLEGRO_USTR_INFO *info)
+{
+   WRAPPED_LINE *l;
+   ASSERT(wrapped);
+   ASSERT(info);
+
+   if (line < 0 || line >= (int)_al_vector_size(&wrapped->lines))
+      return NULL;
+   l = _al_vector_ref(&wrapped->lines, line);
+   return al_ref_ustr(info, wrapped->text, l->start, l->end);
+}
+
+
+/* Function: al_get_wrapped_text_line_width
+ */
+int al_get_wrapped_text_line_width(const ALLEGRO_WRAPPED_TEXT *wrapped,
+   int line)
+{
+   WRAPPED_LINE *l;
+   ASSERT(wrapped);
+
+   if (line < 0 || line >= (int)_al_vector_size(&wrapped->lines))
+      return 0;
+   l = _al_vector_ref(&wrapped->lines, line);
+   return l->width;
+}
+
+
+/* Function: al_draw_wrapped_text
+ */
+void al_draw_wrapped_text(const ALLEGRO_WRAPPED_TEXT *wrapped,
+   ALLEGRO_COLOR color, float x, float y, float line_height, int flags,
+   int first_line, int num_lines)
+{
+   int count;
+   int i;
+   ASSERT(wrapped);
+
+   if (line_height < 1)
+      line_height = al_get_font_line_height(wrapped->font);
+
+   count = _al_vector_size(&wrapped->lines);
+   if (num_lines < 0)
+      num_lines = count;
+   if (first_line < 0) {
+      num_lines += first_line;
+      y -= first_line * line_height;
+      first_line = 0;
+   }
+   if (num_lines > count - first_line)
+      num_lines = count - first_line;
+
+   for (i = 0; i < num_lines; i++) {
+      WRAPPED_LINE *l = _al_vector_ref(&wrapped->lines, first_line + i);
+      ALLEGRO_USTR_INFO info;
+
+      if (l->start == l->end)
+         continue;
+      al_draw_ustr(wrapped->font, color, x, y + line_height * i, flags,
+         al_ref_ustr(&info, wrapped->text, l->start, l->end));
+   }
+}
+
+
+/* vim: set sts=3 sw=3 et: */
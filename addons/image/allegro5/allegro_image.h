@@ -36,6 +36,43 @@ ALLEGRO_IIO_FUNC(bool, al_is_image_addon_initialized, (void));
 ALLEGRO_IIO_FUNC(void, al_shutdown_image_addon, (void));
 ALLEGRO_IIO_FUNC(uint32_t, al_get_allegro_image_version, (void));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_IIO_SRC)
+/* Type: ALLEGRO_IMAGE_BAND
+ */
+typedef struct ALLEGRO_IMAGE_BAND ALLEGRO_IMAGE_BAND;
+
+struct ALLEGRO_IMAGE_BAND
+{
+   int image_width;
+   int image_height;
+   int y;
+   int height;
+   const void *data;
+   int pitch;
+};
+
+/* Type: ALLEGRO_IMAGE_BAND_CALLBACK
+ */
+typedef bool (*ALLEGRO_IMAGE_BAND_CALLBACK)(const ALLEGRO_IMAGE_BAND *band,
+   void *arg);
+
+ALLEGRO_IIO_FUNC(bool, al_load_image_bands, (const char *filename,
+   int band_height, int flags, ALLEGRO_IMAGE_BAND_CALLBACK callback,
+   void *arg));
+ALLEGRO_IIO_FUNC(bool, al_load_image_bands_f, (ALLEGRO_FILE *fp,
+   const char *ident, int band_height, int flags,
+   ALLEGRO_IMAGE_BAND_CALLBACK callback, void *arg));
+ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP **, al_load_bitmap_tiles, (const char *filename,
+   int tile_w, int tile_h, int flags, int *cols, int *rows));
+ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP **, al_load_bitmap_tiles_f, (ALLEGRO_FILE *fp,
+   const char *ident, int tile_w, int tile_h, int flags, int *cols, int *rows));
+
+ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, al_load_bitmap_thumbnail, (const char *filename,
+   int max_size, int flags));
+ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, al_load_bitmap_thumbnail_f, (ALLEGRO_FILE *fp,
+   const char *ident, int max_size, int flags));
+#endif
+
 
 #ifdef __cplusplus
 }
@@ -45,6 +45,29 @@ ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_dds, (const char *filename, int flag
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_dds_f, (ALLEGRO_FILE *f, int flags));
 ALLEGRO_IIO_FUNC(bool, _al_identify_dds, (ALLEGRO_FILE *f));
 
+ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_ktx, (const char *filename, int flags));
+ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_ktx_f, (ALLEGRO_FILE *f, int flags));
+ALLEGRO_IIO_FUNC(bool, _al_identify_ktx, (ALLEGRO_FILE *f));
+
+/* State shared by the streaming decoders and al_load_image_bands_f.
+ * Decoders call _al_start_image_bands once the image size is known, then
+ * write each row to _al_next_image_band_row and pass it on with
+ * _al_finish_image_band_row, stopping if that returns false.
+ */
+typedef struct _AL_IMAGE_BANDS
+{
+   ALLEGRO_IMAGE_BAND band;
+   int band_height;     /* 0 lets the decoder choose */
+   unsigned char *buf;
+   ALLEGRO_IMAGE_BAND_CALLBACK callback;
+   void *arg;
+} _AL_IMAGE_BANDS;
+
+ALLEGRO_IIO_FUNC(bool, _al_start_image_bands, (_AL_IMAGE_BANDS *bands,
+   int width, int height, int default_band_height));
+ALLEGRO_IIO_FUNC(unsigned char *, _al_next_image_band_row, (_AL_IMAGE_BANDS *bands));
+ALLEGRO_IIO_FUNC(bool, _al_finish_image_band_row, (_AL_IMAGE_BANDS *bands));
+
 ALLEGRO_IIO_FUNC(bool, _al_identify_png, (ALLEGRO_FILE *f));
 ALLEGRO_IIO_FUNC(bool, _al_identify_jpg, (ALLEGRO_FILE *f));
 ALLEGRO_IIO_FUNC(bool, _al_identify_webp, (ALLEGRO_FILE *f));
@@ -72,15 +95,19 @@ ALLEGRO_IIO_FUNC(bool, _al_save_gdiplus_gif_f, (ALLEGRO_FILE *f, ALLEGRO_BITMAP
 #ifdef ALLEGRO_CFG_IIO_HAVE_ANDROID
 ALLEGRO_BITMAP *_al_load_android_bitmap_f(ALLEGRO_FILE *fp, int flags);
 ALLEGRO_BITMAP *_al_load_android_bitmap(const char *filename, int flags);
+bool _al_have_android_image_decoder(void);
 #endif
 
-/* ALLEGRO_CFG_IIO_HAVE_PNG/JPG implies that "native" loaders aren't available. */
+/* ALLEGRO_CFG_IIO_HAVE_PNG/JPG implies that "native" loaders aren't available,
+ * except on Android, which uses them only where AImageDecoder is missing.
+ */
 
 #ifdef ALLEGRO_CFG_IIO_HAVE_PNG
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_png, (const char *filename, int flags));
 ALLEGRO_IIO_FUNC(bool, _al_save_png, (const char *filename, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_png_f, (ALLEGRO_FILE *f, int flags));
 ALLEGRO_IIO_FUNC(bool, _al_save_png_f, (ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp));
+ALLEGRO_IIO_FUNC(bool, _al_load_png_bands_f, (ALLEGRO_FILE *f, _AL_IMAGE_BANDS *bands, int flags));
 #endif
 
 #ifdef ALLEGRO_CFG_IIO_HAVE_JPG
@@ -88,6 +115,8 @@ ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_jpg, (const char *filename, int flag
 ALLEGRO_IIO_FUNC(bool, _al_save_jpg, (const char *filename, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_jpg_f, (ALLEGRO_FILE *f, int flags));
 ALLEGRO_IIO_FUNC(bool, _al_save_jpg_f, (ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp));
+ALLEGRO_IIO_FUNC(bool, _al_load_jpg_bands_f, (ALLEGRO_FILE *f, _AL_IMAGE_BANDS *bands, int flags));
+ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_jpg_scaled_f, (ALLEGRO_FILE *f, int flags, int max_size));
 #endif
 
 #ifdef ALLEGRO_CFG_IIO_HAVE_WEBP
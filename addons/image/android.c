@@ -13,3 +13,7 @@ ALLEGRO_BITMAP *_al_load_android_bitmap(const char *filename, int flags)
    return _al_android_load_image(filename, flags);
 }
 
+bool _al_have_android_image_decoder(void)
+{
+   return _al_android_have_image_decoder();
+}
@@ -0,0 +1,314 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Streaming images in bands of rows, for images too large to
+ *      load into a single bitmap.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_image.h"
+
+ALLEGRO_DEBUG_CHANNEL("image")
+
+
+typedef bool (*BAND_LOADER)(ALLEGRO_FILE *f, _AL_IMAGE_BANDS *bands, int flags);
+
+static const struct {
+   const char *ext;
+   BAND_LOADER load;
+} band_loaders[] = {
+#ifdef ALLEGRO_CFG_IIO_HAVE_PNG
+   { ".png", _al_load_png_bands_f },
+#endif
+#ifdef ALLEGRO_CFG_IIO_HAVE_JPG
+   { ".jpg", _al_load_jpg_bands_f },
+   { ".jpeg", _al_load_jpg_bands_f },
+#endif
+   { NULL, NULL }
+};
+
+
+bool _al_start_image_bands(_AL_IMAGE_BANDS *bands, int width, int height,
+   int default_band_height)
+{
+   if (bands->band_height <= 0)
+      bands->band_height = default_band_height;
+   bands->band_height = _ALLEGRO_CLAMP(1, bands->band_height, height);
+
+   bands->band.image_width = width;
+   bands->band.image_height = height;
+   bands->band.y = 0;
+   bands->band.height = 0;
+   bands->band.pitch = width * 4;
+
+   bands->buf = al_malloc((size_t)bands->band.pitch * bands->band_height);
+   if (!bands->buf) {
+      ALLEGRO_ERROR("Could not allocate a band of %d rows.\n",
+         bands->band_height);
+      return false;
+   }
+   bands->band.data = bands->buf;
+
+   return true;
+}
+
+
+unsigned char *_al_next_image_band_row(_AL_IMAGE_BANDS *bands)
+{
+   return bands->buf + (size_t)bands->band.height * bands->band.pitch;
+}
+
+
+bool _al_finish_image_band_row(_AL_IMAGE_BANDS *bands)
+{
+   ALLEGRO_IMAGE_BAND *band = &bands->band;
+
+   band->height++;
+   if (band->height < bands->band_height &&
+       band->y + band->height < band->image_height) {
+      return true;
+   }
+
+   if (!bands->callback(band, bands->arg)) {
+      ALLEGRO_DEBUG("Band callback stopped decoding at row %d.\n", band->y);
+      return false;
+   }
+
+   band->y += band->height;
+   band->height = 0;
+   return true;
+}
+
+
+/* Function: al_load_image_bands_f
+ */
+bool al_load_image_bands_f(ALLEGRO_FILE *fp, const char *ident,
+   int band_height, int flags, ALLEGRO_IMAGE_BAND_CALLBACK callback, void *arg)
+{
+   _AL_IMAGE_BANDS bands;
+   bool ret;
+   int i;
+
+   ASSERT(fp);
+   ASSERT(callback);
+
+   if (!ident)
+      ident = al_identify_bitmap_f(fp);
+   if (!ident) {
+      ALLEGRO_ERROR("Could not identify the image.\n");
+      return false;
+   }
+
+   for (i = 0; band_loaders[i].ext; i++) {
+      if (_al_stricmp(ident, band_loaders[i].ext) == 0)
+         break;
+   }
+   if (!band_loaders[i].ext) {
+      ALLEGRO_ERROR("No band decoder for %s images.\n", ident);
+      return false;
+   }
+
+   memset(&bands, 0, sizeof(bands));
+   bands.band_height = band_height;
+   bands.callback = callback;
+   bands.arg = arg;
+
+   ret = band_loaders[i].load(fp, &bands, flags);
+
+   al_free(bands.buf);
+   return ret;
+}
+
+
+/* Function: al_load_image_bands
+ */
+bool al_load_image_bands(const char *filename, int band_height, int flags,
+   ALLEGRO_IMAGE_BAND_CALLBACK callback, void *arg)
+{
+   ALLEGRO_FILE *fp;
+   const char *ident;
+   bool ret;
+
+   ASSERT(filename);
+
+   fp = al_fopen(filename, "rb");
+   if (!fp) {
+      ALLEGRO_ERROR("Unable to open %s for reading.\n", filename);
+      return false;
+   }
+
+   ident = al_identify_bitmap_f(fp);
+   if (!ident)
+      ident = strrchr(filename, '.');
+
+   ret = ident && al_load_image_bands_f(fp, ident, band_height, flags,
+      callback, arg);
+
+   al_fclose(fp);
+   return ret;
+}
+
+
+typedef struct TILES
+{
+   ALLEGRO_BITMAP **tiles;
+   int tile_w, tile_h;
+   int cols, rows;
+} TILES;
+
+
+static void destroy_tiles(TILES *t)
+{
+   int i;
+
+   if (!t->tiles)
+      return;
+   for (i = 0; i < t->cols * t->rows; i++)
+      al_destroy_bitmap(t->tiles[i]);
+   al_free(t->tiles);
+   t->tiles = NULL;
+}
+
+
+static bool create_tiles(TILES *t, int w, int h)
+{
+   int row, col;
+
+   t->cols = (w + t->tile_w - 1) / t->tile_w;
+   t->rows = (h + t->tile_h - 1) / t->tile_h;
+   t->tiles = al_calloc(t->cols * t->rows, sizeof(*t->tiles));
+   if (!t->tiles)
+      return false;
+
+   for (row = 0; row < t->rows; row++) {
+      for (col = 0; col < t->cols; col++) {
+         int tw = _ALLEGRO_MIN(t->tile_w, w - col * t->tile_w);
+         int th = _ALLEGRO_MIN(t->tile_h, h - row * t->tile_h);
+         ALLEGRO_BITMAP *tile = al_create_bitmap(tw, th);
+         if (!tile) {
+            ALLEGRO_ERROR("Could not create a %dx%d tile.\n", tw, th);
+            destroy_tiles(t);
+            return false;
+         }
+         t->tiles[row * t->cols + col] = tile;
+      }
+   }
+
+   return true;
+}
+
+
+/* Copies a band into the tiles it overlaps, locking only the rows it
+ * covers.
+ */
+static bool copy_band_to_tiles(const ALLEGRO_IMAGE_BAND *band, void *arg)
+{
+   TILES *t = arg;
+   int end = band->y + band->height;
+   int y, next_y;
+
+   if (!t->tiles && !create_tiles(t, band->image_width, band->image_height))
+      return false;
+
+   for (y = band->y; y < end; y = next_y) {
+      int row = y / t->tile_h;
+      int col;
+      next_y = _ALLEGRO_MIN((row + 1) * t->tile_h, end);
+
+      for (col = 0; col < t->cols; col++) {
+         ALLEGRO_BITMAP *tile = t->tiles[row * t->cols + col];
+         int tw = al_get_bitmap_width(tile);
+         const unsigned char *src = (const unsigned char *)band->data +
+            (y - band->y) * band->pitch + col * t->tile_w * 4;
+         ALLEGRO_LOCKED_REGION *lr;
+         int i;
+
+         lr = al_lock_bitmap_region(tile, 0, y - row * t->tile_h,
+            tw, next_y - y, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+            ALLEGRO_LOCK_WRITEONLY);
+         if (!lr) {
+            ALLEGRO_ERROR("Could not lock tile %d, %d.\n", col, row);
+            return false;
+         }
+         for (i = 0; i < next_y - y; i++) {
+            memcpy((char *)lr->data + i * lr->pitch, src + i * band->pitch,
+               tw * 4);
+         }
+         al_unlock_bitmap(tile);
+      }
+   }
+
+   return true;
+}
+
+
+/* Function: al_load_bitmap_tiles_f
+ */
+ALLEGRO_BITMAP **al_load_bitmap_tiles_f(ALLEGRO_FILE *fp, const char *ident,
+   int tile_w, int tile_h, int flags, int *cols, int *rows)
+{
+   TILES t;
+
+   ASSERT(fp);
+   ASSERT(tile_w > 0 && tile_h > 0);
+
+   memset(&t, 0, sizeof(t));
+   t.tile_w = tile_w;
+   t.tile_h = tile_h;
+
+   /* Bands as tall as the tiles fill one row of tiles each. */
+   if (!al_load_image_bands_f(fp, ident, tile_h, flags, copy_band_to_tiles,
+         &t)) {
+      destroy_tiles(&t);
+      return NULL;
+   }
+
+   if (cols)
+      *cols = t.cols;
+   if (rows)
+      *rows = t.rows;
+   return t.tiles;
+}
+
+
+/* Function: al_load_bitmap_tiles
+ */
+ALLEGRO_BITMAP **al_load_bitmap_tiles(const char *filename, int tile_w,
+   int tile_h, int flags, int *cols, int *rows)
+{
+   ALLEGRO_FILE *fp;
+   ALLEGRO_BITMAP **tiles;
+   const char *ident;
+
+   ASSERT(filename);
+
+   fp = al_fopen(filename, "rb");
+   if (!fp) {
+      ALLEGRO_ERROR("Unable to open %s for reading.\n", filename);
+      return NULL;
+   }
+
+   ident = al_identify_bitmap_f(fp);
+   if (!ident)
+      ident = strrchr(filename, '.');
+
+   tiles = ident ? al_load_bitmap_tiles_f(fp, ident, tile_w, tile_h, flags,
+      cols, rows) : NULL;
+
+   al_fclose(fp);
+   return tiles;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -22,6 +22,7 @@
 
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_convert.h"
 #include "allegro5/internal/aintern_image.h"
 
@@ -567,24 +568,29 @@ static void read_32_rgbx_8888_line(ALLEGRO_FILE *f, char *buf, char *data,
 static void read_32_argb_8888_line(ALLEGRO_FILE *f, char *buf, char *data,
    int length, bool premul)
 {
-   int i;
-   uint32_t *data32 = (uint32_t *)data;
    size_t bytes_wanted = length * 4;
 
    size_t bytes_read = al_fread(f, buf, bytes_wanted);
    memset(buf + bytes_read, 0, bytes_wanted - bytes_read);
 
-   for (i = 0; i < length; i++) {
-      uint32_t pixel = read_32le(buf + i*4);
-      uint32_t a = (pixel & 0xFF000000U) >> 24;
-      data32[i] = ALLEGRO_CONVERT_ARGB_8888_TO_ABGR_8888_LE(pixel);
-
-      if (premul && a != 255) {
-         data[i*4+1] = data[i*4+1] * a / 255;
-         data[i*4+2] = data[i*4+2] * a / 255;
-         data[i*4+3] = data[i*4+3] * a / 255;
+#ifdef ALLEGRO_LITTLE_ENDIAN
+   /* The file's pixels are ARGB_8888 in memory already. */
+   _al_convert_bitmap_data(buf, ALLEGRO_PIXEL_FORMAT_ARGB_8888, 0,
+      data, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, 0, 0, 0, 0, 0, length, 1);
+#else
+   {
+      uint32_t *data32 = (uint32_t *)data;
+      int i;
+      for (i = 0; i < length; i++) {
+         uint32_t pixel = read_32le(buf + i*4);
+         data32[i] = ALLEGRO_CONVERT_ARGB_8888_TO_ABGR_8888_LE(pixel);
       }
    }
+#endif
+
+   if (premul)
+      _al_premultiply_alpha(data, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, 0,
+         length, 1);
 }
 
 
@@ -604,15 +610,12 @@ static void read_32_rgba_8888_line(ALLEGRO_FILE *f, char *buf, char *data,
 
    for (i = 0; i < length; i++) {
       uint32_t pixel = read_32le(buf + i*4);
-      uint32_t a = (pixel & 0x000000FFU);
       data32[i] = ALLEGRO_CONVERT_RGBA_8888_TO_ABGR_8888_LE(pixel);
-
-      if (premul && a != 255) {
-         data[i*4]   = data[i*4] * a / 255;
-         data[i*4+1] = data[i*4+1] * a / 255;
-         data[i*4+2] = data[i*4+2] * a / 255;
-      }
    }
+
+   if (premul)
+      _al_premultiply_alpha(data, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, 0,
+         length, 1);
 }
 
 
@@ -856,6 +859,7 @@ static bool read_bitfields_image(ALLEGRO_FILE *f, int flags,
 
    for (i = 0; i < height; i++, line += dir) {
       unsigned char *data = (unsigned char *)lr->data + lr->pitch * line;
+      unsigned char *row = data;
 
       bytes_read = al_fread(f, linebuf, linesize);
       memset(linebuf + bytes_read, 0, linesize - bytes_read);
@@ -882,12 +886,6 @@ static bool read_bitfields_image(ALLEGRO_FILE *f, int flags,
 
             if (atable) a = atable[a];
             else        a = a * 255 / am;
-
-            if (premul) {
-               r = r * a / 255;
-               g = g * a / 255;
-               b = b * a / 255;
-            }
          }
 
          data[0] = r;
@@ -897,6 +895,10 @@ static bool read_bitfields_image(ALLEGRO_FILE *f, int flags,
 
          data += 4;
       }
+
+      if (am && premul)
+         _al_premultiply_alpha(row, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, 0,
+            width, 1);
    }
 
    al_free(linebuf);
@@ -979,17 +981,8 @@ static bool read_RGB_image_32bit_alpha_hack(ALLEGRO_FILE *f, int flags,
       }
    }
    else if (premul) {
-      line = startline;
-
-      for (i = 0; i < height; i++, line += dir) {
-         unsigned char *data = (unsigned char *)lr->data + lr->pitch * line;
-
-         for (j = 0; j < width; j++) {
-            data[j*4]   = data[j*4] * data[j*4+3] / 255;
-            data[j*4+1] = data[j*4+1] * data[j*4+3] / 255;
-            data[j*4+2] = data[j*4+2] * data[j*4+3] / 255;
-         }
-      }
+      _al_premultiply_alpha(lr->data, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+         lr->pitch, width, height);
    }
 
    al_free(linebuf);
@@ -1177,7 +1170,7 @@ static void read_RLE4_compressed_image(ALLEGRO_FILE *f, unsigned char *buf,
  *  i.e. you must either reset the offset to some known place or close the
  *  packfile. The packfile is not closed by this function.
  */
-ALLEGRO_BITMAP *_al_load_bmp_f(ALLEGRO_FILE *f, int flags)
+static ALLEGRO_BITMAP *load_bmp_f(ALLEGRO_FILE *f, int flags)
 {
    BMPFILEHEADER fileheader;
    BMPINFOHEADER infoheader;
@@ -1553,6 +1546,15 @@ ALLEGRO_BITMAP *_al_load_bmp_f(ALLEGRO_FILE *f, int flags)
 }
 
 
+ALLEGRO_BITMAP *_al_load_bmp_f(ALLEGRO_FILE *f, int flags)
+{
+   size_t old_size = _al_iio_begin_buffered_read(f);
+   ALLEGRO_BITMAP *bmp = load_bmp_f(f, flags);
+   _al_iio_end_buffered_read(f, old_size);
+   return bmp;
+}
+
+
 
 /*  Like save_bmp but writes into the ALLEGRO_FILE given instead of a new file.
  *  The packfile is not closed after writing is completed. On success the
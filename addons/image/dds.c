@@ -13,8 +13,12 @@
  *      See readme.txt for copyright information.
  */
 
+#define ALLEGRO_INTERNAL_UNSTABLE
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_image.h"
 
 #include "iio.h"
@@ -56,8 +60,82 @@ typedef struct {
 
 #define FOURCC(c0, c1, c2, c3) ((int)(c0) | ((int)(c1) << 8) | ((int)(c2) << 16) | ((int)(c3) << 24))
 
+#define DDSD_MIPMAPCOUNT 0x20000
 #define DDPF_FOURCC 0x4
 
+/* Formats which only have a DXGI_FORMAT code are stored with a 'DX10'
+ * FourCC and a DDS_HEADER_DXT10 after the header.
+ */
+#define DDS_HEADER_DXT10_SIZE 20
+
+static int get_dxgi_pixel_format(DWORD dxgi_format)
+{
+   switch (dxgi_format) {
+      case 71: /* DXGI_FORMAT_BC1_UNORM */
+      case 72: /* DXGI_FORMAT_BC1_UNORM_SRGB */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1;
+      case 74: /* DXGI_FORMAT_BC2_UNORM */
+      case 75: /* DXGI_FORMAT_BC2_UNORM_SRGB */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3;
+      case 77: /* DXGI_FORMAT_BC3_UNORM */
+      case 78: /* DXGI_FORMAT_BC3_UNORM_SRGB */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5;
+      case 80: /* DXGI_FORMAT_BC4_UNORM */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4;
+      case 83: /* DXGI_FORMAT_BC5_UNORM */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5;
+      case 98: /* DXGI_FORMAT_BC7_UNORM */
+      case 99: /* DXGI_FORMAT_BC7_UNORM_SRGB */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_BC7;
+      default:
+         return -1;
+   }
+}
+
+/* Uploads the mipmap levels, which follow each other starting with the base
+ * level. Returns false if not even the base level could be uploaded.
+ */
+static bool load_mipmaps(ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp, int format,
+   int w, int h, int levels)
+{
+   int block_width = al_get_pixel_block_width(format);
+   int block_height = al_get_pixel_block_height(format);
+   int block_size = al_get_pixel_block_size(format);
+   size_t avail;
+   const char *mapped = al_fget_mapped_buffer(f, &avail);
+   int level;
+
+   for (level = 0; level < levels; level++) {
+      int wc = (_ALLEGRO_MAX(1, w >> level) + block_width - 1) / block_width;
+      int hc = (_ALLEGRO_MAX(1, h >> level) + block_height - 1) / block_height;
+      size_t size = (size_t)wc * hc * block_size;
+      bool ok;
+      if (mapped) {
+         /* Upload straight out of the mapping. */
+         ok = size <= avail &&
+            _al_upload_bitmap_mipmap(bmp, level, mapped, wc * block_size);
+         if (ok) {
+            mapped += size;
+            avail -= size;
+            al_fseek(f, size, ALLEGRO_SEEK_CUR);
+         }
+      }
+      else {
+         char *data = al_malloc(size);
+         ok = data && al_fread(f, data, size) == size &&
+            _al_upload_bitmap_mipmap(bmp, level, data, wc * block_size);
+         al_free(data);
+      }
+      if (!ok) {
+         if (level > 0)
+            ALLEGRO_WARN("Only loaded %d of %d mipmap levels.\n", level, levels);
+         return level > 0;
+      }
+   }
+
+   return true;
+}
+
 ALLEGRO_BITMAP *_al_load_dds_f(ALLEGRO_FILE *f, int flags)
 {
    ALLEGRO_BITMAP *bmp;
@@ -65,6 +143,8 @@ ALLEGRO_BITMAP *_al_load_dds_f(ALLEGRO_FILE *f, int flags)
    DWORD magic;
    size_t num_read;
    int w, h, fourcc, format, block_width, block_height, block_size;
+   int levels;
+   int64_t data_start;
    ALLEGRO_STATE state;
    ALLEGRO_LOCKED_REGION *lr = NULL;
    int ii;
@@ -92,6 +172,7 @@ ALLEGRO_BITMAP *_al_load_dds_f(ALLEGRO_FILE *f, int flags)
    w = header.dwWidth;
    h = header.dwHeight;
    fourcc = header.ddspf.dwFourCC;
+   levels = (header.dwFlags & DDSD_MIPMAPCOUNT) ? header.dwMipMapCount : 1;
 
    switch (fourcc) {
       case FOURCC('D', 'X', 'T', '1'):
@@ -103,6 +184,28 @@ ALLEGRO_BITMAP *_al_load_dds_f(ALLEGRO_FILE *f, int flags)
       case FOURCC('D', 'X', 'T', '5'):
          format = ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5;
          break;
+      case FOURCC('A', 'T', 'I', '1'):
+      case FOURCC('B', 'C', '4', 'U'):
+         format = ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4;
+         break;
+      case FOURCC('A', 'T', 'I', '2'):
+      case FOURCC('B', 'C', '5', 'U'):
+         format = ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5;
+         break;
+      case FOURCC('D', 'X', '1', '0'): {
+         unsigned char dxt10[DDS_HEADER_DXT10_SIZE];
+         if (al_fread(f, dxt10, DDS_HEADER_DXT10_SIZE) != DDS_HEADER_DXT10_SIZE) {
+            ALLEGRO_ERROR("DDS file too short.\n");
+            return NULL;
+         }
+         format = get_dxgi_pixel_format(dxt10[0] | dxt10[1] << 8 |
+            dxt10[2] << 16 | dxt10[3] << 24);
+         if (format < 0) {
+            ALLEGRO_ERROR("Invalid pixel format.\n");
+            return NULL;
+         }
+         break;
+      }
       default:
          ALLEGRO_ERROR("Invalid pixel format.\n");
          return NULL;
@@ -113,7 +216,8 @@ ALLEGRO_BITMAP *_al_load_dds_f(ALLEGRO_FILE *f, int flags)
    block_size = al_get_pixel_block_size(format);
 
    al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
-   al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
+   al_set_new_bitmap_flags(
+      (al_get_new_bitmap_flags() & ~ALLEGRO_MEMORY_BITMAP) | ALLEGRO_VIDEO_BITMAP);
    al_set_new_bitmap_format(format);
    bmp = al_create_bitmap(w, h);
    if (!bmp) {
@@ -126,6 +230,17 @@ ALLEGRO_BITMAP *_al_load_dds_f(ALLEGRO_FILE *f, int flags)
       goto FAIL;
    }
 
+   /* Use the stored mipmaps rather than generating them, if we can. */
+   if (levels > 1 && (al_get_bitmap_flags(bmp) & ALLEGRO_MIPMAP)) {
+      data_start = al_ftell(f);
+      if (load_mipmaps(f, bmp, format, w, h, levels))
+         goto RESET;
+      if (!al_fseek(f, data_start, ALLEGRO_SEEK_SET)) {
+         ALLEGRO_ERROR("Could not seek back to the DDS data.\n");
+         goto FAIL;
+      }
+   }
+
    lr = al_lock_bitmap_blocked(bmp, ALLEGRO_LOCK_WRITEONLY);
 
    if (!lr) {
@@ -133,6 +248,9 @@ ALLEGRO_BITMAP *_al_load_dds_f(ALLEGRO_FILE *f, int flags)
          case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1:
          case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3:
          case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5:
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4:
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5:
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_BC7:
             ALLEGRO_ERROR("Could not lock the bitmap (probably the support for locking this format has not been enabled).\n");
             break;
          default:
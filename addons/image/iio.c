@@ -1,14 +1,39 @@
+#define ALLEGRO_INTERNAL_UNSTABLE
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
 #include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_image.h"
 #include "allegro5/internal/aintern_image_cfg.h"
 
+#include "iio.h"
+
 
 /* globals */
 static bool iio_inited = false;
 
 
+/* Gives f a read-ahead buffer of at least IIO_READ_BUFFER_SIZE bytes and
+ * returns the size it had before, to pass to _al_iio_end_buffered_read.
+ */
+size_t _al_iio_begin_buffered_read(ALLEGRO_FILE *f)
+{
+   size_t old_size = al_get_file_read_buffer_size(f);
+
+   if (old_size < IIO_READ_BUFFER_SIZE)
+      al_set_file_read_buffer_size(f, IIO_READ_BUFFER_SIZE);
+   return old_size;
+}
+
+
+void _al_iio_end_buffered_read(ALLEGRO_FILE *f, size_t old_size)
+{
+   /* This fails, keeping the buffer, only if the file can't seek back over
+    * the data read ahead. Nothing is lost either way.
+    */
+   al_set_file_read_buffer_size(f, old_size);
+}
+
+
 /* Function: al_init_image_addon
  */
 bool al_init_image_addon(void)
@@ -42,6 +67,10 @@ bool al_init_image_addon(void)
    success |= al_register_bitmap_loader_f(".dds", _al_load_dds_f);
    success |= al_register_bitmap_identifier(".dds", _al_identify_dds);
 
+   success |= al_register_bitmap_loader(".ktx2", _al_load_ktx);
+   success |= al_register_bitmap_loader_f(".ktx2", _al_load_ktx_f);
+   success |= al_register_bitmap_identifier(".ktx2", _al_identify_ktx);
+
    /* Even if we don't have libpng or libjpeg we most likely have a
     * native reader for those instead so always identify them.
     */
@@ -125,10 +154,31 @@ bool al_init_image_addon(void)
    {
       char const *extensions[] = {".webp", ".jpg", ".jpeg", ".ico", ".gif",
          ".wbmp", ".png", NULL};
-      int i;
-
+      /* The formats that one of the libraries above already loads. Without
+       * AImageDecoder they are faster than a round trip through Java.
+       */
+      char const *library_extensions[] = {
+#ifdef ALLEGRO_CFG_IIO_HAVE_PNG
+         ".png",
+#endif
+#ifdef ALLEGRO_CFG_IIO_HAVE_JPG
+         ".jpg", ".jpeg",
+#endif
+#ifdef ALLEGRO_CFG_IIO_HAVE_WEBP
+         ".webp",
+#endif
+         NULL};
+      bool have_decoder = _al_have_android_image_decoder();
+      int i, j;
 
       for (i = 0; extensions[i]; i++) {
+         bool skip = false;
+         for (j = 0; library_extensions[j] && !have_decoder; j++) {
+            if (0 == strcmp(extensions[i], library_extensions[j]))
+               skip = true;
+         }
+         if (skip)
+            continue;
          success |= al_register_bitmap_loader(extensions[i], _al_load_android_bitmap);
          success |= al_register_bitmap_loader_f(extensions[i], _al_load_android_bitmap_f);
          //success |= al_register_bitmap_saver(extensions[i], _al_save_android_bitmap);
@@ -12,5 +12,12 @@ typedef struct PalEntry {
 } PalEntry;
 
 
+/* Read-ahead for the loaders which read a few bytes at a time. */
+#define IIO_READ_BUFFER_SIZE 4096
+
+size_t _al_iio_begin_buffered_read(ALLEGRO_FILE *f);
+void _al_iio_end_buffered_read(ALLEGRO_FILE *f, size_t old_size);
+
+
 #endif
 
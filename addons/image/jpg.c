@@ -158,8 +158,27 @@ struct load_jpg_entry_helper_data {
    unsigned char *row;
 };
 
+/* Picks the smallest DCT scale at which the longer side of the image is
+ * still at least max_size pixels. Decoding at 1/2, 1/4 or 1/8 scale skips
+ * most of the work of the inverse DCT.
+ */
+static void set_scale(struct jpeg_decompress_struct *cinfo, int max_size)
+{
+   int longer = cinfo->image_width > cinfo->image_height ?
+      cinfo->image_width : cinfo->image_height;
+   int denom;
+
+   for (denom = 8; denom > 1; denom /= 2) {
+      if ((longer + denom - 1) / denom >= max_size)
+         break;
+   }
+
+   cinfo->scale_num = 1;
+   cinfo->scale_denom = denom;
+}
+
 static void load_jpg_entry_helper(ALLEGRO_FILE *fp,
-   struct load_jpg_entry_helper_data *data, int flags)
+   struct load_jpg_entry_helper_data *data, int flags, int max_size)
 {
    struct jpeg_decompress_struct cinfo;
    struct my_err_mgr jerr;
@@ -190,6 +209,8 @@ static void load_jpg_entry_helper(ALLEGRO_FILE *fp,
    jpeg_create_decompress(&cinfo);
    jpeg_packfile_src(&cinfo, fp, data->buffer);
    jpeg_read_header(&cinfo, true);
+   if (max_size > 0)
+      set_scale(&cinfo, max_size);
    jpeg_start_decompress(&cinfo);
 
    w = cinfo.output_width;
@@ -282,11 +303,122 @@ ALLEGRO_BITMAP *_al_load_jpg_f(ALLEGRO_FILE *fp, int flags)
    struct load_jpg_entry_helper_data data;
 
    memset(&data, 0, sizeof(data));
-   load_jpg_entry_helper(fp, &data, flags);
+   load_jpg_entry_helper(fp, &data, flags, 0);
 
    return data.bmp;
 }
 
+ALLEGRO_BITMAP *_al_load_jpg_scaled_f(ALLEGRO_FILE *fp, int flags, int max_size)
+{
+   struct load_jpg_entry_helper_data data;
+
+   memset(&data, 0, sizeof(data));
+   load_jpg_entry_helper(fp, &data, flags, max_size);
+
+   return data.bmp;
+}
+
+/* See comment about load_jpg_entry_helper_data. */
+struct load_jpg_bands_helper_data {
+   bool error;
+   JOCTET *buffer;
+};
+
+static void load_jpg_bands_helper(ALLEGRO_FILE *fp,
+   struct load_jpg_bands_helper_data *data, _AL_IMAGE_BANDS *bands)
+{
+   struct jpeg_decompress_struct cinfo;
+   struct my_err_mgr jerr;
+   int w, h, s;
+
+   data->error = false;
+
+   cinfo.err = jpeg_std_error(&jerr.pub);
+   jerr.pub.error_exit = my_error_exit;
+   if (setjmp(jerr.jmpenv) != 0) {
+      /* Longjmp'd. */
+      data->error = true;
+      goto longjmp_error;
+   }
+
+   data->buffer = al_malloc(BUFFER_SIZE);
+   if (!data->buffer) {
+      data->error = true;
+      goto error;
+   }
+
+   jpeg_create_decompress(&cinfo);
+   jpeg_packfile_src(&cinfo, fp, data->buffer);
+   jpeg_read_header(&cinfo, true);
+   jpeg_start_decompress(&cinfo);
+
+   w = cinfo.output_width;
+   h = cinfo.output_height;
+   s = cinfo.output_components;
+
+   if (s != 1 && s != 3) {
+      data->error = true;
+      ALLEGRO_ERROR("%d components makes no sense\n", s);
+      goto error;
+   }
+
+   /* Unless asked otherwise, pass on one row of MCUs at a time. */
+   if (!_al_start_image_bands(bands, w, h,
+         cinfo.max_v_samp_factor * DCTSIZE)) {
+      data->error = true;
+      goto error;
+   }
+
+   while ((int)cinfo.output_scanline < h) {
+      unsigned char *row = _al_next_image_band_row(bands);
+      int x;
+
+      jpeg_read_scanlines(&cinfo, (void *)&row, 1);
+
+      /* Expand to RGBA in place. Going from the right, no pixel is
+       * overwritten before it has been read.
+       */
+      for (x = w - 1; x >= 0; x--) {
+         const unsigned char *in = row + x * s;
+         unsigned char *out = row + x * 4;
+         unsigned char r = in[0];
+         unsigned char g = in[s == 3 ? 1 : 0];
+         unsigned char b = in[s == 3 ? 2 : 0];
+         out[0] = r;
+         out[1] = g;
+         out[2] = b;
+         out[3] = 255;
+      }
+
+      if (!_al_finish_image_band_row(bands)) {
+         data->error = true;
+         /* jpeg_finish_decompress would complain about the unread lines. */
+         goto longjmp_error;
+      }
+   }
+
+ error:
+   jpeg_finish_decompress(&cinfo);
+
+ longjmp_error:
+   jpeg_destroy_decompress(&cinfo);
+
+   al_free(data->buffer);
+}
+
+bool _al_load_jpg_bands_f(ALLEGRO_FILE *fp, _AL_IMAGE_BANDS *bands, int flags)
+{
+   struct load_jpg_bands_helper_data data;
+
+   /* ALLEGRO_NO_PREMULTIPLIED_ALPHA does not apply. */
+   (void)flags;
+
+   memset(&data, 0, sizeof(data));
+   load_jpg_bands_helper(fp, &data, bands);
+
+   return !data.error;
+}
+
 /* See comment about load_jpg_entry_helper_data. */
 struct save_jpg_entry_helper_data {
    bool error;
@@ -0,0 +1,373 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      A simple KTX2 reader.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#define ALLEGRO_INTERNAL_UNSTABLE
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_image.h"
+
+#include "iio.h"
+
+ALLEGRO_DEBUG_CHANNEL("image")
+
+#define MAX_LEVELS 32
+
+typedef struct KTX_LEVEL {
+   uint64_t offset;
+   uint64_t length;
+} KTX_LEVEL;
+
+static const uint8_t ktx2_identifier[12] = {
+   0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+/* The VkFormat values of the block compressed formats we can load. The
+ * sRGB variants are loaded as if they were linear, like all our formats.
+ */
+static int get_pixel_format(uint32_t vk_format)
+{
+   switch (vk_format) {
+      case 131: /* VK_FORMAT_BC1_RGB_UNORM_BLOCK */
+      case 132: /* VK_FORMAT_BC1_RGB_SRGB_BLOCK */
+      case 133: /* VK_FORMAT_BC1_RGBA_UNORM_BLOCK */
+      case 134: /* VK_FORMAT_BC1_RGBA_SRGB_BLOCK */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1;
+      case 135: /* VK_FORMAT_BC2_UNORM_BLOCK */
+      case 136: /* VK_FORMAT_BC2_SRGB_BLOCK */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3;
+      case 137: /* VK_FORMAT_BC3_UNORM_BLOCK */
+      case 138: /* VK_FORMAT_BC3_SRGB_BLOCK */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5;
+      case 139: /* VK_FORMAT_BC4_UNORM_BLOCK */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4;
+      case 141: /* VK_FORMAT_BC5_UNORM_BLOCK */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5;
+      case 145: /* VK_FORMAT_BC7_UNORM_BLOCK */
+      case 146: /* VK_FORMAT_BC7_SRGB_BLOCK */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_BC7;
+      case 147: /* VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK */
+      case 148: /* VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGB_ETC2;
+      case 151: /* VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK */
+      case 152: /* VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ETC2;
+      case 157: /* VK_FORMAT_ASTC_4x4_UNORM_BLOCK */
+      case 158: /* VK_FORMAT_ASTC_4x4_SRGB_BLOCK */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_4x4;
+      case 165: /* VK_FORMAT_ASTC_6x6_UNORM_BLOCK */
+      case 166: /* VK_FORMAT_ASTC_6x6_SRGB_BLOCK */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_6x6;
+      case 171: /* VK_FORMAT_ASTC_8x8_UNORM_BLOCK */
+      case 172: /* VK_FORMAT_ASTC_8x8_SRGB_BLOCK */
+         return ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x8;
+      default:
+         return ALLEGRO_PIXEL_FORMAT_ANY;
+   }
+}
+
+static uint64_t read64le(ALLEGRO_FILE *f)
+{
+   uint64_t lo = (uint32_t)al_fread32le(f);
+   uint64_t hi = (uint32_t)al_fread32le(f);
+   return lo | (hi << 32);
+}
+
+/* Returns true if the KTXorientation value says the rows go up, i.e. the
+ * first row of the file is the bottom of the image.
+ */
+static bool rows_go_up(ALLEGRO_FILE *f, int64_t start, uint32_t kvd_offset,
+   uint32_t kvd_length)
+{
+   static const char key[] = "KTXorientation";
+   unsigned char *kvd;
+   uint32_t pos = 0;
+   bool up = false;
+
+   if (kvd_length == 0 || kvd_length > 65536)
+      return false;
+
+   kvd = al_malloc(kvd_length);
+   if (!kvd)
+      return false;
+
+   if (!al_fseek(f, start + kvd_offset, ALLEGRO_SEEK_SET) ||
+       al_fread(f, kvd, kvd_length) != kvd_length) {
+      al_free(kvd);
+      return false;
+   }
+
+   while (pos + 4 <= kvd_length) {
+      uint32_t n = kvd[pos] | kvd[pos + 1] << 8 | kvd[pos + 2] << 16 |
+         (uint32_t)kvd[pos + 3] << 24;
+      pos += 4;
+      if (n > kvd_length - pos)
+         break;
+      if (n >= sizeof(key) + 2 && memcmp(kvd + pos, key, sizeof(key)) == 0) {
+         up = (kvd[pos + sizeof(key) + 1] == 'u');
+         break;
+      }
+      pos += (n + 3) & ~3u;
+   }
+
+   al_free(kvd);
+   return up;
+}
+
+/* Finds the blocks of a level and returns the pointer to and pitch of its top
+ * row. The blocks are read into a new buffer, returned in *buf, unless the
+ * file is memory-mapped, in which case they are used in place and *buf is
+ * NULL.
+ */
+static bool read_level(ALLEGRO_FILE *f, int64_t start, const KTX_LEVEL *level,
+   int wc, int hc, int block_size, bool up, char **buf, const char **top,
+   int *pitch)
+{
+   size_t size = (size_t)wc * hc * block_size;
+   const char *data;
+   size_t avail;
+
+   *buf = NULL;
+   if (level->length < size ||
+       !al_fseek(f, start + (int64_t)level->offset, ALLEGRO_SEEK_SET))
+      return false;
+
+   data = al_fget_mapped_buffer(f, &avail);
+   if (data) {
+      if (avail < size)
+         return false;
+   }
+   else {
+      *buf = al_malloc(size);
+      if (!*buf)
+         return false;
+      if (al_fread(f, *buf, size) != size) {
+         al_free(*buf);
+         *buf = NULL;
+         return false;
+      }
+      data = *buf;
+   }
+
+   *pitch = up ? -wc * block_size : wc * block_size;
+   *top = up ? data + (size_t)(hc - 1) * wc * block_size : data;
+   return true;
+}
+
+/* Uploads the mipmap levels. Returns false if not even the base level could
+ * be uploaded.
+ */
+static bool load_mipmaps(ALLEGRO_FILE *f, int64_t start, ALLEGRO_BITMAP *bmp,
+   const KTX_LEVEL *levels, int num_levels, bool up)
+{
+   int format = al_get_bitmap_format(bmp);
+   int block_width = al_get_pixel_block_width(format);
+   int block_height = al_get_pixel_block_height(format);
+   int block_size = al_get_pixel_block_size(format);
+   int w = al_get_bitmap_width(bmp);
+   int h = al_get_bitmap_height(bmp);
+   int level;
+
+   for (level = 0; level < num_levels; level++) {
+      int wc = (_ALLEGRO_MAX(1, w >> level) + block_width - 1) / block_width;
+      int hc = (_ALLEGRO_MAX(1, h >> level) + block_height - 1) / block_height;
+      char *data;
+      const char *top;
+      int pitch;
+      bool ok = read_level(f, start, &levels[level], wc, hc, block_size,
+         up, &data, &top, &pitch) &&
+         _al_upload_bitmap_mipmap(bmp, level, top, pitch);
+      al_free(data);
+      if (!ok) {
+         if (level > 0)
+            ALLEGRO_WARN("Only loaded %d of %d mipmap levels.\n", level,
+               num_levels);
+         return level > 0;
+      }
+   }
+
+   return true;
+}
+
+ALLEGRO_BITMAP *_al_load_ktx_f(ALLEGRO_FILE *f, int flags)
+{
+   ALLEGRO_BITMAP *bmp = NULL;
+   uint8_t identifier[12];
+   int64_t start;
+   uint32_t vk_format, w, h, depth, layers, faces, num_levels, scheme;
+   uint32_t kvd_offset, kvd_length;
+   KTX_LEVEL levels[MAX_LEVELS];
+   int format, block_width, block_height, block_size;
+   int wc, hc, ii;
+   uint32_t ll;
+   char *data = NULL;
+   const char *top;
+   int pitch;
+   bool up;
+   ALLEGRO_STATE state;
+   ALLEGRO_LOCKED_REGION *lr = NULL;
+   (void)flags;
+
+   start = al_ftell(f);
+
+   if (al_fread(f, identifier, 12) != 12 ||
+       memcmp(identifier, ktx2_identifier, 12) != 0) {
+      ALLEGRO_ERROR("Invalid KTX2 identifier.\n");
+      return NULL;
+   }
+
+   vk_format = al_fread32le(f);
+   al_fread32le(f); /* typeSize */
+   w = al_fread32le(f);
+   h = al_fread32le(f);
+   depth = al_fread32le(f);
+   layers = al_fread32le(f);
+   faces = al_fread32le(f);
+   num_levels = al_fread32le(f);
+   scheme = al_fread32le(f);
+
+   al_fread32le(f); /* dfdByteOffset */
+   al_fread32le(f); /* dfdByteLength */
+   kvd_offset = al_fread32le(f);
+   kvd_length = al_fread32le(f);
+   read64le(f); /* sgdByteOffset */
+   read64le(f); /* sgdByteLength */
+
+   /* A levelCount of 0 asks for the mipmaps to be generated. */
+   if (num_levels == 0)
+      num_levels = 1;
+
+   /* The level index starts with the base level. */
+   for (ll = 0; ll < num_levels && ll < MAX_LEVELS; ll++) {
+      levels[ll].offset = read64le(f);
+      levels[ll].length = read64le(f);
+      read64le(f); /* uncompressedByteLength */
+   }
+   if (num_levels > MAX_LEVELS)
+      num_levels = MAX_LEVELS;
+
+   if (al_feof(f) || al_ferror(f)) {
+      ALLEGRO_ERROR("KTX2 header too short.\n");
+      return NULL;
+   }
+
+   if (depth > 1 || layers > 1 || faces != 1) {
+      ALLEGRO_ERROR("Only 2D KTX2 textures supported.\n");
+      return NULL;
+   }
+
+   if (scheme != 0) {
+      ALLEGRO_ERROR("KTX2 supercompression scheme %u not supported.\n", scheme);
+      return NULL;
+   }
+
+   format = get_pixel_format(vk_format);
+   if (format == ALLEGRO_PIXEL_FORMAT_ANY) {
+      ALLEGRO_ERROR("KTX2 VkFormat %u not supported.\n", vk_format);
+      return NULL;
+   }
+
+   block_width = al_get_pixel_block_width(format);
+   block_height = al_get_pixel_block_height(format);
+   block_size = al_get_pixel_block_size(format);
+   wc = (w + block_width - 1) / block_width;
+   hc = (h + block_height - 1) / block_height;
+
+   if (w == 0 || h == 0) {
+      ALLEGRO_ERROR("Bad KTX2 base level size.\n");
+      return NULL;
+   }
+
+   up = rows_go_up(f, start, kvd_offset, kvd_length);
+
+   al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+   al_set_new_bitmap_flags(
+      (al_get_new_bitmap_flags() & ~ALLEGRO_MEMORY_BITMAP) | ALLEGRO_VIDEO_BITMAP);
+   al_set_new_bitmap_format(format);
+   bmp = al_create_bitmap(w, h);
+   if (!bmp) {
+      ALLEGRO_ERROR("Failed to create bitmap.\n");
+      goto FAIL;
+   }
+
+   if (al_get_bitmap_format(bmp) != format) {
+      ALLEGRO_ERROR("Created a bad bitmap.\n");
+      goto FAIL;
+   }
+
+   /* Use the stored mipmaps rather than generating them, if we can. */
+   if (num_levels > 1 && (al_get_bitmap_flags(bmp) & ALLEGRO_MIPMAP) &&
+       load_mipmaps(f, start, bmp, levels, num_levels, up)) {
+      goto RESET;
+   }
+
+   if (!read_level(f, start, &levels[0], wc, hc, block_size, up, &data, &top,
+         &pitch)) {
+      ALLEGRO_ERROR("KTX2 file too short.\n");
+      goto FAIL;
+   }
+
+   lr = al_lock_bitmap_blocked(bmp, ALLEGRO_LOCK_WRITEONLY);
+   if (!lr) {
+      ALLEGRO_ERROR("Could not lock the bitmap.\n");
+      goto FAIL;
+   }
+
+   for (ii = 0; ii < hc; ii++) {
+      memcpy((char *)lr->data + ii * lr->pitch, top + ii * pitch,
+         (size_t)wc * block_size);
+   }
+   al_unlock_bitmap(bmp);
+
+   goto RESET;
+FAIL:
+   if (lr)
+      al_unlock_bitmap(bmp);
+   al_destroy_bitmap(bmp);
+   bmp = NULL;
+RESET:
+   al_free(data);
+   al_restore_state(&state);
+   return bmp;
+}
+
+ALLEGRO_BITMAP *_al_load_ktx(const char *filename, int flags)
+{
+   ALLEGRO_FILE *f;
+   ALLEGRO_BITMAP *bmp;
+   ASSERT(filename);
+
+   f = al_fopen(filename, "rb");
+   if (!f) {
+      ALLEGRO_ERROR("Unable open %s for reading.\n", filename);
+      return NULL;
+   }
+
+   bmp = _al_load_ktx_f(f, flags);
+
+   al_fclose(f);
+
+   return bmp;
+}
+
+bool _al_identify_ktx(ALLEGRO_FILE *f)
+{
+   uint8_t x[12];
+   if (al_fread(f, x, 12) != 12)
+      return false;
+   return memcmp(x, ktx2_identifier, 12) == 0;
+}
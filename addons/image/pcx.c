@@ -9,7 +9,7 @@ ALLEGRO_DEBUG_CHANNEL("image")
 /* Do NOT simplify this to just (x), it doesn't work in MSVC. */
 #define INT_TO_BOOL(x)   ((x) != 0)
 
-ALLEGRO_BITMAP *_al_load_pcx_f(ALLEGRO_FILE *f, int flags)
+static ALLEGRO_BITMAP *load_pcx_f(ALLEGRO_FILE *f, int flags)
 {
    ALLEGRO_BITMAP *b;
    int c;
@@ -179,6 +179,15 @@ ALLEGRO_BITMAP *_al_load_pcx_f(ALLEGRO_FILE *f, int flags)
    return b;
 }
 
+
+ALLEGRO_BITMAP *_al_load_pcx_f(ALLEGRO_FILE *f, int flags)
+{
+   size_t old_size = _al_iio_begin_buffered_read(f);
+   ALLEGRO_BITMAP *bmp = load_pcx_f(f, flags);
+   _al_iio_end_buffered_read(f, old_size);
+   return bmp;
+}
+
 bool _al_save_pcx_f(ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp)
 {
    int c;
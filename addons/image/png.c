@@ -8,7 +8,10 @@
 
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_image.h"
+#include "allegro5/internal/aintern_workers.h"
 
 #include "iio.h"
 
@@ -86,37 +89,72 @@ static int check_if_png(ALLEGRO_FILE *fp)
 
 
 
-/* really_load_png:
- *  Worker routine, used by load_png and load_memory_png.
+/* get_lock_format:
+ *  Picks the format to lock a new bitmap with. Decoding straight into the
+ *  bitmap's own byte order lets the lock hand out the pixels or an upload
+ *  buffer directly, instead of converting them once more when unlocking.
+ *  *swap_rb is set if red and blue are swapped compared to RGBA in memory.
  */
-static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
-   int flags)
+static int get_lock_format(ALLEGRO_BITMAP *bmp, bool *swap_rb)
 {
-   ALLEGRO_BITMAP *bmp;
-   png_uint_32 width, height, rowbytes, real_rowbytes;
-   int bit_depth, color_type, interlace_type;
-   double image_gamma, screen_gamma;
-   int intent;
+#ifdef ALLEGRO_LITTLE_ENDIAN
+   switch (al_get_bitmap_format(bmp)) {
+      case ALLEGRO_PIXEL_FORMAT_ABGR_8888:
+      case ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB:
+         *swap_rb = false;
+         return al_get_bitmap_format(bmp);
+      case ALLEGRO_PIXEL_FORMAT_ARGB_8888:
+      case ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB:
+         *swap_rb = true;
+         return al_get_bitmap_format(bmp);
+      default:
+         break;
+   }
+#else
+   (void)bmp;
+#endif
+   *swap_rb = false;
+   return ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE;
+}
+
+
+/* How the rows libpng hands back are turned into 32-bit pixels. */
+typedef struct PNG_ROW_FORMAT
+{
+   png_uint_32 width;
    int bpp;
-   int number_passes, pass;
-   int num_trans = 0;
-   PalEntry pal[256];
+   int color_type;
+   int num_trans;
    png_bytep trans;
-   ALLEGRO_LOCKED_REGION *lock;
-   unsigned char *buf;
-   unsigned char *dest;
-   bool premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA);
+   PalEntry pal[256];
+   bool premul;
    bool index_only;
+   int ri, bi;
+   int format;             /* of the converted rows */
+} PNG_ROW_FORMAT;
 
-   ALLEGRO_ASSERT(png_ptr && info_ptr);
+
+/* setup_read:
+ *  Reads the PNG header and sets up the transformations common to all
+ *  loading routines. Returns the number of interlace passes.
+ */
+static int setup_read(png_structp png_ptr, png_infop info_ptr,
+   PNG_ROW_FORMAT *rf, png_uint_32 *height, int *interlace_type)
+{
+   png_uint_32 width, rowbytes;
+   int bit_depth, color_type;
+   double image_gamma, screen_gamma;
+   int intent;
+   int bpp;
+   int number_passes;
 
    /* The call to png_read_info() gives us all of the information from the
     * PNG file before the first IDAT (image data chunk).
     */
    png_read_info(png_ptr, info_ptr);
 
-   png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth,
-                &color_type, &interlace_type, NULL, NULL);
+   png_get_IHDR(png_ptr, info_ptr, &width, height, &bit_depth,
+                &color_type, interlace_type, NULL, NULL);
 
    /* Extract multiple pixels with bit depths of 1, 2, and 4 from a single
     * byte into separate bytes (useful for paletted and grayscale images).
@@ -130,10 +168,11 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
    /* Adds a full alpha channel if there is transparency information
     * in a tRNS chunk.
     */
+   rf->num_trans = 0;
    if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
       if (!(color_type & PNG_COLOR_MASK_PALETTE))
          png_set_tRNS_to_alpha(png_ptr);
-      png_get_tRNS(png_ptr, info_ptr, &trans, &num_trans, NULL);
+      png_get_tRNS(png_ptr, info_ptr, &rf->trans, &rf->num_trans, NULL);
    }
 
    /* Convert 16-bits per colour component to 8-bits per colour component. */
@@ -174,13 +213,13 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
       if (png_get_PLTE(png_ptr, info_ptr, &palette, &num_palette)) {
          /* We don't actually dither, we just copy the palette. */
          for (i = 0; ((i < num_palette) && (i < 256)); i++) {
-            pal[i].r = palette[i].red;
-            pal[i].g = palette[i].green;
-            pal[i].b = palette[i].blue;
+            rf->pal[i].r = palette[i].red;
+            rf->pal[i].g = palette[i].green;
+            rf->pal[i].b = palette[i].blue;
          }
 
          for (; i < 256; i++)
-            pal[i].r = pal[i].g = pal[i].b = 0;
+            rf->pal[i].r = rf->pal[i].g = rf->pal[i].b = 0;
       }
    }
 
@@ -201,41 +240,167 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
 #endif
    }
 
-   bmp = al_create_bitmap(width, height);
+   rf->width = width;
+   rf->bpp = bpp;
+   rf->color_type = color_type;
+   rf->index_only = false;
+   rf->ri = 0;
+   rf->bi = 2;
+   rf->format = ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE;
+
+   return number_passes;
+}
+
+
+/* convert_row:
+ *  Converts one row read by libpng into dest. Alpha is premultiplied
+ *  afterwards, for the whole row at once.
+ */
+static void convert_row(const PNG_ROW_FORMAT *rf, unsigned char *dest,
+   const unsigned char *ptr)
+{
+   unsigned char *row = dest;
+   const int ri = rf->ri;
+   const int bi = rf->bi;
+   unsigned int i;
+
+   switch (rf->bpp) {
+      case 8:
+         if (rf->index_only) {
+            for (i = 0; i < rf->width; i++) {
+               *(dest++) = *(ptr++);
+            }
+         }
+         else if (rf->color_type & PNG_COLOR_MASK_PALETTE) {
+            for (i = 0; i < rf->width; i++) {
+               int pix = ptr[0];
+               ptr++;
+               dest[ri] = rf->pal[pix].r;
+               dest[1] = rf->pal[pix].g;
+               dest[bi] = rf->pal[pix].b;
+               if (pix < rf->num_trans) {
+                  dest[3] = rf->trans[pix];
+               } else {
+                  dest[3] = 255;
+               }
+               dest += 4;
+            }
+         }
+         else {
+            for (i = 0; i < rf->width; i++) {
+               int pix = ptr[0];
+               ptr++;
+               *(dest++) = pix;
+               *(dest++) = pix;
+               *(dest++) = pix;
+               *(dest++) = 255;
+            }
+         }
+         break;
+
+      case 24:
+         for (i = 0; i < rf->width; i++) {
+            uint32_t pix = _AL_READ3BYTES(ptr);
+            ptr += 3;
+            dest[ri] = pix & 0xff;
+            dest[1] = (pix >> 8) & 0xff;
+            dest[bi] = (pix >> 16) & 0xff;
+            dest[3] = 255;
+            dest += 4;
+         }
+         break;
+
+      case 32:
+#ifdef ALLEGRO_LITTLE_ENDIAN
+         /* libpng's rows are RGBA in memory already. */
+         if (ri == 0) {
+            memcpy(dest, ptr, rf->width * 4);
+            break;
+         }
+         if (rf->format == ALLEGRO_PIXEL_FORMAT_ARGB_8888 ||
+               rf->format == ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB) {
+            _al_convert_bitmap_data(ptr, ALLEGRO_PIXEL_FORMAT_ABGR_8888, 0,
+               dest, ALLEGRO_PIXEL_FORMAT_ARGB_8888, 0,
+               0, 0, 0, 0, rf->width, 1);
+            break;
+         }
+#endif
+         for (i = 0; i < rf->width; i++) {
+            uint32_t pix = *(uint32_t*)ptr;
+            ptr += 4;
+            dest[ri] = pix & 0xff;
+            dest[1] = (pix >> 8) & 0xff;
+            dest[bi] = (pix >> 16) & 0xff;
+            dest[3] = (pix >> 24) & 0xff;
+            dest += 4;
+         }
+         break;
+
+      default:
+         ALLEGRO_ASSERT(rf->bpp == 8 || rf->bpp == 24 || rf->bpp == 32);
+         return;
+   }
+
+   if (rf->premul)
+      _al_premultiply_alpha(row, rf->format, 0, rf->width, 1);
+}
+
+
+/* really_load_png:
+ *  Worker routine, used by load_png and load_memory_png.
+ */
+static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
+   int flags)
+{
+   ALLEGRO_BITMAP *bmp;
+   png_uint_32 height, real_rowbytes;
+   int interlace_type;
+   int number_passes, pass;
+   PNG_ROW_FORMAT rf;
+   ALLEGRO_LOCKED_REGION *lock;
+   unsigned char *buf;
+   bool swap_rb = false;
+
+   ALLEGRO_ASSERT(png_ptr && info_ptr);
+
+   number_passes = setup_read(png_ptr, info_ptr, &rf, &height, &interlace_type);
+   rf.premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA) &&
+      (rf.bpp == 32 || rf.num_trans > 0);
+
+   bmp = al_create_bitmap(rf.width, height);
    if (!bmp) {
       ALLEGRO_ERROR("al_create_bitmap failed while loading PNG.\n");
       return NULL;
    }
 
    // TODO: can this be different from rowbytes?
-   real_rowbytes = ((bpp + 7) / 8) * width;
+   real_rowbytes = ((rf.bpp + 7) / 8) * rf.width;
    if (interlace_type == PNG_INTERLACE_ADAM7)
       buf = al_malloc(real_rowbytes * height);
    else
       buf = al_malloc(real_rowbytes);
 
-   if (bpp == 8 && (color_type & PNG_COLOR_MASK_PALETTE) &&
+   if (rf.bpp == 8 && (rf.color_type & PNG_COLOR_MASK_PALETTE) &&
       (flags & ALLEGRO_KEEP_INDEX))
    {
       lock = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_SINGLE_CHANNEL_8,
          ALLEGRO_LOCK_WRITEONLY);
-      index_only = true;
+      rf.index_only = true;
    }
    else {
-      lock = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
-         ALLEGRO_LOCK_WRITEONLY);
-      index_only = false;
+      rf.format = get_lock_format(bmp, &swap_rb);
+      lock = al_lock_bitmap(bmp, rf.format, ALLEGRO_LOCK_WRITEONLY);
+      rf.index_only = false;
    }
+   rf.ri = swap_rb ? 2 : 0;
+   rf.bi = swap_rb ? 0 : 2;
 
    /* Read the image, one line at a time (easier to debug!) */
    for (pass = 0; pass < number_passes; pass++) {
       png_uint_32 y;
-      unsigned int i;
       unsigned char *ptr;
-      dest = lock->data;
 
       for (y = 0; y < height; y++) {
-         unsigned char *dest_row_start = dest;
          /* For interlaced pictures, the row needs to be initialized with
           * the contents of the previous pass.
           */
@@ -244,85 +409,8 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
          else
             ptr = buf;
          png_read_row(png_ptr, NULL, ptr);
-   
-         switch (bpp) {
-            case 8:
-               if (index_only) {
-                  for (i = 0; i < width; i++) {
-                     *(dest++) = *(ptr++);
-                  }
-               }
-               else if (color_type & PNG_COLOR_MASK_PALETTE) {
-                  for (i = 0; i < width; i++) {
-                     int pix = ptr[0];
-                     ptr++;
-                     dest[0] = pal[pix].r;
-                     dest[1] = pal[pix].g;
-                     dest[2] = pal[pix].b;
-                     if (pix < num_trans) {
-                        int a = trans[pix];
-                        dest[3] = a;
-                        if (premul) {
-                           dest[0] = dest[0] * a / 255;
-                           dest[1] = dest[1] * a / 255;
-                           dest[2] = dest[2] * a / 255;
-                        }
-                     } else {
-                        dest[3] = 255;
-                     }
-                     dest += 4;
-                  }
-               }
-               else {
-                  for (i = 0; i < width; i++) {
-                     int pix = ptr[0];
-                     ptr++;
-                     *(dest++) = pix;
-                     *(dest++) = pix;
-                     *(dest++) = pix;
-                     *(dest++) = 255;
-                  }
-               }
-               break;
-
-            case 24:
-               for (i = 0; i < width; i++) {
-                  uint32_t pix = _AL_READ3BYTES(ptr);
-                  ptr += 3;
-                  *(dest++) = pix & 0xff;
-                  *(dest++) = (pix >> 8) & 0xff;
-                  *(dest++) = (pix >> 16) & 0xff;
-                  *(dest++) = 255;
-               }
-               break;
-
-            case 32:
-               for (i = 0; i < width; i++) {
-                  uint32_t pix = *(uint32_t*)ptr;
-                  int r = pix & 0xff;
-                  int g = (pix >> 8) & 0xff;
-                  int b = (pix >> 16) & 0xff;
-                  int a = (pix >> 24) & 0xff;
-                  ptr += 4;
-
-                  if (premul) {
-                     r = r * a / 255;
-                     g = g * a / 255;
-                     b = b * a / 255;
-                  }
-
-                  *(dest++) = r;
-                  *(dest++) = g;
-                  *(dest++) = b;
-                  *(dest++) = a;
-               }
-               break;
 
-            default:
-               ALLEGRO_ASSERT(bpp == 8 || bpp == 24 || bpp == 32);
-               break;
-         }
-         dest = dest_row_start + lock->pitch;
+         convert_row(&rf, (unsigned char *)lock->data + y * lock->pitch, ptr);
       }
    }
 
@@ -426,6 +514,108 @@ ALLEGRO_BITMAP *_al_load_png(const char *filename, int flags)
 
 
 
+/* We keep the row buffer for really_load_png_bands in a structure allocated
+ * in the caller's stack frame, so that it can be freed after a longjmp.
+ */
+struct load_png_bands_data {
+   unsigned char *row;
+};
+
+
+/* really_load_png_bands:
+ *  Worker routine for _al_load_png_bands_f. Passes the image on in bands
+ *  instead of creating a bitmap, so only a band's worth of memory is needed.
+ */
+static bool really_load_png_bands(png_structp png_ptr, png_infop info_ptr,
+   _AL_IMAGE_BANDS *bands, struct load_png_bands_data *data, int flags)
+{
+   png_uint_32 height, y;
+   int interlace_type;
+   PNG_ROW_FORMAT rf;
+
+   setup_read(png_ptr, info_ptr, &rf, &height, &interlace_type);
+   rf.premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA) &&
+      (rf.bpp == 32 || rf.num_trans > 0);
+
+   /* Each pass of an interlaced image touches every band. */
+   if (interlace_type == PNG_INTERLACE_ADAM7) {
+      ALLEGRO_ERROR("Interlaced PNGs cannot be decoded in bands.\n");
+      return false;
+   }
+
+   if (!_al_start_image_bands(bands, rf.width, height, 16))
+      return false;
+
+   data->row = al_malloc(((rf.bpp + 7) / 8) * rf.width);
+   if (!data->row)
+      return false;
+
+   for (y = 0; y < height; y++) {
+      png_read_row(png_ptr, NULL, data->row);
+      convert_row(&rf, _al_next_image_band_row(bands), data->row);
+      if (!_al_finish_image_band_row(bands))
+         return false;
+   }
+
+   png_read_end(png_ptr, info_ptr);
+
+   return true;
+}
+
+
+bool _al_load_png_bands_f(ALLEGRO_FILE *fp, _AL_IMAGE_BANDS *bands, int flags)
+{
+   jmp_buf jmpbuf;
+   struct load_png_bands_data data;
+   png_structp png_ptr;
+   png_infop info_ptr;
+   bool ret;
+
+   ALLEGRO_ASSERT(fp);
+
+   if (!check_if_png(fp)) {
+      ALLEGRO_ERROR("Not a png.\n");
+      return false;
+   }
+
+   png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                    (void *)NULL, NULL, NULL);
+   if (!png_ptr) {
+      ALLEGRO_ERROR("png_ptr == NULL\n");
+      return false;
+   }
+
+   info_ptr = png_create_info_struct(png_ptr);
+   if (!info_ptr) {
+      png_destroy_read_struct(&png_ptr, (png_infopp) NULL, (png_infopp) NULL);
+      ALLEGRO_ERROR("png_create_info_struct failed\n");
+      return false;
+   }
+
+   data.row = NULL;
+
+   if (setjmp(jmpbuf)) {
+      png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+      al_free(data.row);
+      ALLEGRO_ERROR("Error reading PNG file\n");
+      return false;
+   }
+   png_set_error_fn(png_ptr, jmpbuf, user_error_fn, NULL);
+
+   png_set_read_fn(png_ptr, fp, (png_rw_ptr) read_data);
+   png_set_sig_bytes(png_ptr, PNG_BYTES_TO_CHECK);
+
+   ret = really_load_png_bands(png_ptr, info_ptr, bands, &data, flags);
+
+   png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+   al_free(data.row);
+
+   return ret;
+}
+
+
+
+
 /*****************************************************************************
  * Saving routines
  ****************************************************************************/
@@ -471,20 +661,46 @@ static int translate_compression_level(const char* value) {
    return strtol(value, NULL, 10);
 }
 
+/* get_filter:
+ *  Translate the png_filter config value into a libpng filter. Returns 0
+ *  for "default", leaving libpng to pick a filter for every row.
+ */
+static int get_filter(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "image",
+      "png_filter");
+   if (!value || strcmp(value, "default") == 0)
+      return 0;
+   if (strcmp(value, "none") == 0)
+      return PNG_FILTER_NONE;
+   if (strcmp(value, "sub") == 0)
+      return PNG_FILTER_SUB;
+   if (strcmp(value, "up") == 0)
+      return PNG_FILTER_UP;
+   ALLEGRO_WARN("Unknown png_filter %s.\n", value);
+   return 0;
+}
+
 /* save_rgba:
- *  Core save routine for 32 bpp images.
+ *  Core save routine for 32 bpp images. The bitmap is locked in its own
+ *  format if it is already 32-bit RGBA in some byte order, so the lock has
+ *  nothing to convert.
  */
 static int save_rgba(png_structp png_ptr, ALLEGRO_BITMAP *bmp)
 {
    const int bmp_h = al_get_bitmap_height(bmp);
    ALLEGRO_LOCKED_REGION *lock;
+   bool swap_rb;
    int y;
 
-   lock = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+   lock = al_lock_bitmap(bmp, get_lock_format(bmp, &swap_rb),
       ALLEGRO_LOCK_READONLY);
    if (!lock)
       return 0;
 
+   if (swap_rb)
+      png_set_bgr(png_ptr);
+
    for (y = 0; y < bmp_h; y++) {
       unsigned char *p = (unsigned char *)lock->data + lock->pitch * y;
       png_write_row(png_ptr, p);
@@ -496,6 +712,253 @@ static int save_rgba(png_structp png_ptr, ALLEGRO_BITMAP *bmp)
 }
 
 
+/* Rows per chunk below which parallel compression is not worth it. */
+#define MIN_DEFLATE_ROWS 32
+
+/* The image data is split into horizontal chunks which are filtered and
+ * deflated independently, each ending on a byte boundary with a sync flush,
+ * so that the compressed chunks can simply be concatenated. Only the last
+ * one finishes the stream. The zlib header and trailer are added around
+ * them.
+ */
+typedef struct DEFLATE_CHUNK
+{
+   int y0, y1;
+   unsigned char *out;
+   size_t out_size;
+   uLong adler;
+   uLong length;
+   bool ok;
+} DEFLATE_CHUNK;
+
+typedef struct DEFLATE_JOB
+{
+   ALLEGRO_LOCKED_REGION *lock;
+   int width;
+   int height;
+   int filter;
+   int level;
+   bool swap_rb;
+   int num_chunks;
+   DEFLATE_CHUNK *chunks;
+} DEFLATE_JOB;
+
+
+static void get_png_row(const DEFLATE_JOB *job, int y, unsigned char *row)
+{
+   const unsigned char *src =
+      (const unsigned char *)job->lock->data + job->lock->pitch * y;
+   int x;
+
+   if (!job->swap_rb) {
+      memcpy(row, src, job->width * 4);
+      return;
+   }
+   for (x = 0; x < job->width; x++, src += 4, row += 4) {
+      row[0] = src[2];
+      row[1] = src[1];
+      row[2] = src[0];
+      row[3] = src[3];
+   }
+}
+
+
+static void filter_row(int filter, const unsigned char *cur,
+   const unsigned char *prev, unsigned char *out, int n)
+{
+   int i;
+
+   switch (filter) {
+      case PNG_FILTER_SUB:
+         out[0] = PNG_FILTER_VALUE_SUB;
+         for (i = 0; i < 4 && i < n; i++)
+            out[1 + i] = cur[i];
+         for (; i < n; i++)
+            out[1 + i] = cur[i] - cur[i - 4];
+         break;
+
+      case PNG_FILTER_UP:
+         out[0] = PNG_FILTER_VALUE_UP;
+         for (i = 0; i < n; i++)
+            out[1 + i] = cur[i] - prev[i];
+         break;
+
+      default:
+         out[0] = PNG_FILTER_VALUE_NONE;
+         memcpy(out + 1, cur, n);
+         break;
+   }
+}
+
+
+static void deflate_chunk(int index, void *arg)
+{
+   DEFLATE_JOB *job = arg;
+   DEFLATE_CHUNK *chunk = &job->chunks[index];
+   const int n = job->width * 4;
+   const bool last = (index == job->num_chunks - 1);
+   unsigned char *rows, *prev, *cur, *filtered;
+   z_stream z;
+   int y;
+
+   chunk->ok = false;
+
+   rows = al_malloc(3 * n + 1);
+   if (!rows)
+      return;
+   prev = rows;
+   cur = rows + n;
+   filtered = rows + 2 * n;
+
+   memset(&z, 0, sizeof(z));
+   if (deflateInit2(&z, job->level, Z_DEFLATED, -15, 8,
+         Z_DEFAULT_STRATEGY) != Z_OK) {
+      al_free(rows);
+      return;
+   }
+
+   chunk->length = (uLong)(chunk->y1 - chunk->y0) * (n + 1);
+   /* Room for the sync flush marker, and for the zlib header and trailer
+    * which are written into the first and last chunks.
+    */
+   chunk->out_size = deflateBound(&z, chunk->length) + 16;
+   chunk->out = al_malloc(chunk->out_size);
+   if (!chunk->out)
+      goto done;
+
+   /* The first row of the chunk is filtered against the row above it. */
+   if (chunk->y0 > 0)
+      get_png_row(job, chunk->y0 - 1, prev);
+   else
+      memset(prev, 0, n);
+
+   z.next_out = chunk->out + (index == 0 ? 2 : 0);
+   z.avail_out = chunk->out_size - 6;
+   chunk->adler = adler32(0, NULL, 0);
+
+   for (y = chunk->y0; y < chunk->y1; y++) {
+      unsigned char *tmp;
+      int flush = (y + 1 < chunk->y1) ? Z_NO_FLUSH :
+         (last ? Z_FINISH : Z_SYNC_FLUSH);
+      int rc;
+
+      get_png_row(job, y, cur);
+      filter_row(job->filter, cur, prev, filtered, n);
+      chunk->adler = adler32(chunk->adler, filtered, n + 1);
+
+      z.next_in = filtered;
+      z.avail_in = n + 1;
+      rc = deflate(&z, flush);
+      if (rc == Z_STREAM_ERROR || z.avail_in != 0 ||
+          (flush == Z_FINISH && rc != Z_STREAM_END))
+         goto done;
+
+      tmp = prev;
+      prev = cur;
+      cur = tmp;
+   }
+
+   chunk->out_size = z.next_out - chunk->out;
+   chunk->ok = true;
+
+done:
+   deflateEnd(&z);
+   al_free(rows);
+}
+
+
+/* write_chunk:
+ *  Writes a PNG chunk without going through libpng, which would longjmp out
+ *  on errors.
+ */
+static bool write_chunk(ALLEGRO_FILE *fp, const char *name,
+   const unsigned char *data, size_t size)
+{
+   uLong crc = crc32(0, (const Bytef *)name, 4);
+   /* crc32 treats a NULL buffer as a request for the initial value. */
+   if (size > 0)
+      crc = crc32(crc, data, size);
+
+   return al_fwrite32be(fp, size) == 4 &&
+      al_fwrite(fp, name, 4) == 4 &&
+      al_fwrite(fp, data, size) == size &&
+      al_fwrite32be(fp, crc) == 4;
+}
+
+
+/* save_rgba_parallel:
+ *  Like save_rgba, but filters and compresses the image data on the worker
+ *  threads and writes the IDAT and IEND chunks directly.
+ */
+static int save_rgba_parallel(ALLEGRO_FILE *fp, ALLEGRO_BITMAP *bmp,
+   int filter, int level, int num_chunks)
+{
+   DEFLATE_JOB job;
+   DEFLATE_CHUNK *last;
+   uLong adler;
+   bool ok = true;
+   int i;
+
+   job.width = al_get_bitmap_width(bmp);
+   job.height = al_get_bitmap_height(bmp);
+   job.filter = filter;
+   job.level = level;
+   job.num_chunks = num_chunks;
+   job.chunks = al_calloc(num_chunks, sizeof(*job.chunks));
+   if (!job.chunks)
+      return 0;
+
+   job.lock = al_lock_bitmap(bmp, get_lock_format(bmp, &job.swap_rb),
+      ALLEGRO_LOCK_READONLY);
+   if (!job.lock) {
+      al_free(job.chunks);
+      return 0;
+   }
+
+   for (i = 0; i < num_chunks; i++) {
+      job.chunks[i].y0 = job.height * i / num_chunks;
+      job.chunks[i].y1 = job.height * (i + 1) / num_chunks;
+   }
+
+   _al_run_parallel(num_chunks, deflate_chunk, &job);
+
+   al_unlock_bitmap(bmp);
+
+   for (i = 0; i < num_chunks; i++)
+      ok = ok && job.chunks[i].ok;
+
+   if (ok) {
+      /* zlib header: deflate with a 32K window, no preset dictionary. */
+      job.chunks[0].out[0] = 0x78;
+      job.chunks[0].out[1] = 0x9C;
+
+      adler = job.chunks[0].adler;
+      for (i = 1; i < num_chunks; i++) {
+         adler = adler32_combine(adler, job.chunks[i].adler,
+            job.chunks[i].length);
+      }
+      last = &job.chunks[num_chunks - 1];
+      last->out[last->out_size++] = (adler >> 24) & 0xff;
+      last->out[last->out_size++] = (adler >> 16) & 0xff;
+      last->out[last->out_size++] = (adler >> 8) & 0xff;
+      last->out[last->out_size++] = adler & 0xff;
+
+      /* Decoders treat consecutive IDAT chunks as one stream. */
+      for (i = 0; i < num_chunks && ok; i++) {
+         ok = write_chunk(fp, "IDAT", job.chunks[i].out,
+            job.chunks[i].out_size);
+      }
+      ok = ok && write_chunk(fp, "IEND", NULL, 0);
+   }
+
+   for (i = 0; i < num_chunks; i++)
+      al_free(job.chunks[i].out);
+   al_free(job.chunks);
+
+   return ok;
+}
+
+
 
 /* Writes a non-interlaced, no-frills PNG, taking the usual save_xyz
  *  parameters.  Returns non-zero on error.
@@ -506,6 +969,8 @@ bool _al_save_png_f(ALLEGRO_FILE *fp, ALLEGRO_BITMAP *bmp)
    png_structp png_ptr = NULL;
    png_infop info_ptr = NULL;
    int colour_type;
+   int filter;
+   int num_chunks;
 
    /* Create and initialize the png_struct with the
     * desired error handler functions.
@@ -550,6 +1015,23 @@ bool _al_save_png_f(ALLEGRO_FILE *fp, ALLEGRO_BITMAP *bmp)
    );
    png_set_compression_level(png_ptr, z_level);
 
+   /* Set the filter. With a fixed filter the rows can be compressed in
+    * parallel, if that is enabled and the image is tall enough.
+    */
+   filter = get_filter();
+   if (filter)
+      png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, filter);
+
+   num_chunks = 1;
+   if (filter) {
+      const char *value = al_get_config_value(al_get_system_config(),
+         "image", "png_parallel_deflate");
+      if (value && strcmp(value, "true") == 0) {
+         num_chunks = _ALLEGRO_MIN(_al_get_worker_count(),
+            al_get_bitmap_height(bmp) / MIN_DEFLATE_ROWS);
+      }
+   }
+
    png_set_IHDR(png_ptr, info_ptr,
                 al_get_bitmap_width(bmp), al_get_bitmap_height(bmp),
                 8, colour_type,
@@ -566,12 +1048,20 @@ bool _al_save_png_f(ALLEGRO_FILE *fp, ALLEGRO_BITMAP *bmp)
     * PNG_TEXT_COMPRESSION_zTXt_WR, so it doesn't get written out again
     * at the end.
     */
-   if (!save_rgba(png_ptr, bmp)) {
-      ALLEGRO_ERROR("save_rgba failed.\n");
-      goto Error;
+   if (num_chunks > 1) {
+      if (!save_rgba_parallel(fp, bmp, filter, z_level, num_chunks)) {
+         ALLEGRO_ERROR("save_rgba_parallel failed.\n");
+         goto Error;
+      }
    }
+   else {
+      if (!save_rgba(png_ptr, bmp)) {
+         ALLEGRO_ERROR("save_rgba failed.\n");
+         goto Error;
+      }
 
-   png_write_end(png_ptr, info_ptr);
+      png_write_end(png_ptr, info_ptr);
+   }
 
    png_destroy_write_struct(&png_ptr, &info_ptr);
 
@@ -24,6 +24,7 @@
 
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_image.h"
 #include "allegro5/internal/aintern_pixels.h"
 
@@ -234,7 +235,7 @@ static void rle_tga_read16(unsigned short *b, int w, ALLEGRO_FILE *f)
  *  i.e. you must either reset the offset to some known place or close the
  *  packfile. The packfile is not closed by this function.
  */
-ALLEGRO_BITMAP *_al_load_tga_f(ALLEGRO_FILE *f, int flags)
+static ALLEGRO_BITMAP *load_tga_f(ALLEGRO_FILE *f, int flags)
 {
    unsigned char image_id[256], image_palette[256][3];
    unsigned char id_length, palette_type, image_type, palette_entry_size;
@@ -415,32 +416,36 @@ ALLEGRO_BITMAP *_al_load_tga_f(ALLEGRO_FILE *f, int flags)
                else
                   raw_tga_read32((unsigned int *)buf, image_width, f);
 
-               for (i = 0; i < image_width; i++) {
-                  int true_x = (left_to_right) ? i : (image_width - 1 - i);
-                  unsigned char *dest = (unsigned char *)lr->data +
-                     lr->pitch*true_y + true_x*4;
+               /* The pixels read are ARGB_8888 in memory. */
+               if (left_to_right) {
+                  _al_convert_bitmap_data(buf, ALLEGRO_PIXEL_FORMAT_ARGB_8888,
+                     0, lr->data, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, lr->pitch,
+                     0, 0, 0, true_y, image_width, 1);
+               }
+               else {
+                  for (i = 0; i < image_width; i++) {
+                     int true_x = image_width - 1 - i;
+                     unsigned char *dest = (unsigned char *)lr->data +
+                        lr->pitch*true_y + true_x*4;
 
 #ifdef ALLEGRO_BIG_ENDIAN
-                  int a = buf[i * 4 + 0];
-                  int r = buf[i * 4 + 1];
-                  int g = buf[i * 4 + 2];
-                  int b = buf[i * 4 + 3];
-#else					 
-                  int b = buf[i * 4 + 0];
-                  int g = buf[i * 4 + 1];
-                  int r = buf[i * 4 + 2];
-                  int a = buf[i * 4 + 3];
-#endif                  
-                  if (premul) {
-                     r = r * a / 255;
-                     g = g * a / 255;
-                     b = b * a / 255;
+                     dest[3] = buf[i * 4 + 0];
+                     dest[0] = buf[i * 4 + 1];
+                     dest[1] = buf[i * 4 + 2];
+                     dest[2] = buf[i * 4 + 3];
+#else
+                     dest[2] = buf[i * 4 + 0];
+                     dest[1] = buf[i * 4 + 1];
+                     dest[0] = buf[i * 4 + 2];
+                     dest[3] = buf[i * 4 + 3];
+#endif
                   }
+               }
 
-                  dest[0] = r;
-                  dest[1] = g;
-                  dest[2] = b;
-                  dest[3] = a;
+               if (premul) {
+                  _al_premultiply_alpha(
+                     (char *)lr->data + lr->pitch * true_y,
+                     ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, 0, image_width, 1);
                }
             }
             else if (bpp == 24) {
@@ -499,6 +504,15 @@ ALLEGRO_BITMAP *_al_load_tga_f(ALLEGRO_FILE *f, int flags)
 }
 
 
+ALLEGRO_BITMAP *_al_load_tga_f(ALLEGRO_FILE *f, int flags)
+{
+   size_t old_size = _al_iio_begin_buffered_read(f);
+   ALLEGRO_BITMAP *bmp = load_tga_f(f, flags);
+   _al_iio_end_buffered_read(f, old_size);
+   return bmp;
+}
+
+
 
 /* Like save_tga but writes into the ALLEGRO_FILE given instead of a new file.
  *  The packfile is not closed after writing is completed. On success the
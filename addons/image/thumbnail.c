@@ -0,0 +1,93 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Loading images at reduced resolution.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_image.h"
+
+ALLEGRO_DEBUG_CHANNEL("image")
+
+
+typedef ALLEGRO_BITMAP *(*SCALED_LOADER)(ALLEGRO_FILE *f, int flags,
+   int max_size);
+
+static const struct {
+   const char *ext;
+   SCALED_LOADER load;
+} scaled_loaders[] = {
+#ifdef ALLEGRO_CFG_IIO_HAVE_JPG
+   { ".jpg", _al_load_jpg_scaled_f },
+   { ".jpeg", _al_load_jpg_scaled_f },
+#endif
+   { NULL, NULL }
+};
+
+
+/* Function: al_load_bitmap_thumbnail_f
+ */
+ALLEGRO_BITMAP *al_load_bitmap_thumbnail_f(ALLEGRO_FILE *fp,
+   const char *ident, int max_size, int flags)
+{
+   int i;
+
+   ASSERT(fp);
+
+   if (!ident)
+      ident = al_identify_bitmap_f(fp);
+   if (!ident) {
+      ALLEGRO_ERROR("Could not identify the image.\n");
+      return NULL;
+   }
+
+   for (i = 0; scaled_loaders[i].ext; i++) {
+      if (_al_stricmp(ident, scaled_loaders[i].ext) == 0)
+         return scaled_loaders[i].load(fp, flags, max_size);
+   }
+
+   /* The format cannot be decoded at a lower resolution. */
+   return al_load_bitmap_flags_f(fp, ident, flags);
+}
+
+
+/* Function: al_load_bitmap_thumbnail
+ */
+ALLEGRO_BITMAP *al_load_bitmap_thumbnail(const char *filename, int max_size,
+   int flags)
+{
+   ALLEGRO_FILE *fp;
+   ALLEGRO_BITMAP *bmp;
+   const char *ident;
+
+   ASSERT(filename);
+
+   fp = al_fopen(filename, "rb");
+   if (!fp) {
+      ALLEGRO_ERROR("Unable to open %s for reading.\n", filename);
+      return NULL;
+   }
+
+   ident = al_identify_bitmap_f(fp);
+   if (!ident)
+      ident = strrchr(filename, '.');
+
+   bmp = ident ? al_load_bitmap_thumbnail_f(fp, ident, max_size, flags) : NULL;
+
+   al_fclose(fp);
+   return bmp;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
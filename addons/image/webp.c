@@ -3,6 +3,8 @@
  */
 
 
+#define ALLEGRO_INTERNAL_UNSTABLE
+
 #include <webp/decode.h>
 #include <webp/encode.h>
 
@@ -66,19 +68,31 @@ ALLEGRO_BITMAP *_al_load_webp_f(ALLEGRO_FILE *fp, int flags)
 {
    ALLEGRO_ASSERT(fp);
    ALLEGRO_BITMAP *bmp;
+   size_t data_size;
+   uint8_t *data;
+   const uint8_t *mapped;
+
+   /* Memory-mapped files can be decoded in place. */
+   mapped = al_fget_mapped_buffer(fp, &data_size);
+   if (mapped) {
+      bmp = load_from_buffer(mapped, data_size, flags);
+      if (bmp)
+         al_fseek(fp, data_size, ALLEGRO_SEEK_CUR);
+      return bmp;
+   }
 
-   size_t data_size = al_fsize(fp);
-   uint8_t *data = al_malloc(data_size * sizeof(uint8_t));
+   data_size = al_fsize(fp);
+   data = al_malloc(data_size * sizeof(uint8_t));
 
    if (al_fread(fp, data, data_size) != data_size) {
       ALLEGRO_ERROR("Could not read WebP file\n");
-      free(data);
+      al_free(data);
       return NULL;
    }
 
    bmp = load_from_buffer(data, data_size, flags);
 
-   free(data);
+   al_free(data);
 
    return bmp;
 }
@@ -33,6 +33,12 @@ extern "C" {
 ALLEGRO_MEMFILE_FUNC(ALLEGRO_FILE *, al_open_memfile, (void *mem, int64_t size, const char *mode));
 ALLEGRO_MEMFILE_FUNC(uint32_t, al_get_allegro_memfile_version, (void));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_MEMFILE_SRC)
+ALLEGRO_MEMFILE_FUNC(ALLEGRO_FILE *, al_create_memfile, (size_t initial_capacity));
+ALLEGRO_MEMFILE_FUNC(void *, al_get_memfile_buffer, (ALLEGRO_FILE *fp, size_t *size));
+ALLEGRO_MEMFILE_FUNC(const void *, al_peek_memfile, (ALLEGRO_FILE *fp, size_t *size));
+#endif
+
 #ifdef __cplusplus
 }
 #endif
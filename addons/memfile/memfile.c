@@ -1,5 +1,8 @@
 #include <allegro5/allegro.h>
 #include "allegro5/allegro_memfile.h"
+#include "allegro5/internal/aintern_file.h"
+
+#define MIN_CAPACITY 64
 
 typedef struct ALLEGRO_FILE_MEMFILE ALLEGRO_FILE_MEMFILE;
 
@@ -11,11 +14,49 @@ struct ALLEGRO_FILE_MEMFILE {
    int64_t size;
    int64_t pos;
    char *mem;
+
+   /* Created by al_create_memfile: mem is ours and grows on writes. */
+   bool growable;
+   int64_t capacity;
 };
 
 static bool memfile_fclose(ALLEGRO_FILE *fp)
 {
-   al_free(al_get_file_userdata(fp));
+   ALLEGRO_FILE_MEMFILE *mf = al_get_file_userdata(fp);
+
+   if (mf->growable)
+      al_free(mf->mem);
+   al_free(mf);
+   return true;
+}
+
+/* Makes room for at least `needed` bytes, doubling the capacity so that a
+ * series of writes takes amortised linear time.
+ */
+static bool memfile_reserve(ALLEGRO_FILE_MEMFILE *mf, int64_t needed)
+{
+   int64_t capacity = mf->capacity;
+   char *mem;
+
+   if (needed <= capacity)
+      return true;
+
+   if (capacity < MIN_CAPACITY)
+      capacity = MIN_CAPACITY;
+   while (capacity < needed)
+      capacity *= 2;
+   if ((uint64_t)capacity > SIZE_MAX) {
+      al_set_errno(ENOMEM);
+      return false;
+   }
+
+   mem = al_realloc(mf->mem, capacity);
+   if (!mem) {
+      al_set_errno(ENOMEM);
+      return false;
+   }
+   mf->mem = mem;
+   mf->capacity = capacity;
    return true;
 }
 
@@ -38,7 +79,8 @@ static size_t memfile_fread(ALLEGRO_FILE *fp, void *ptr, size_t size)
       n = size;
    }
 
-   memcpy(ptr, mf->mem + mf->pos, n);
+   if (n > 0)
+      memcpy(ptr, mf->mem + mf->pos, n);
    mf->pos += n;   
    
    return n;
@@ -53,6 +95,16 @@ static size_t memfile_fwrite(ALLEGRO_FILE *fp, const void *ptr, size_t size)
       al_set_errno(EPERM);
       return 0;
    }   
+
+   if (mf->growable) {
+      if (!memfile_reserve(mf, mf->pos + (int64_t)size))
+         return 0;
+      memcpy(mf->mem + mf->pos, ptr, size);
+      mf->pos += size;
+      if (mf->pos > mf->size)
+         mf->size = mf->pos;
+      return size;
+   }
    
    if (mf->size - mf->pos < (int64_t)size) {
       /* partial write */
@@ -196,6 +248,79 @@ ALLEGRO_FILE *al_open_memfile(void *mem, int64_t size, const char *mode)
    return memfile;
 }
 
+/* Function: al_create_memfile
+ */
+ALLEGRO_FILE *al_create_memfile(size_t initial_capacity)
+{
+   ALLEGRO_FILE *memfile;
+   ALLEGRO_FILE_MEMFILE *userdata;
+
+   userdata = al_calloc(1, sizeof(ALLEGRO_FILE_MEMFILE));
+   if (!userdata) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   userdata->readable = true;
+   userdata->writable = true;
+   userdata->growable = true;
+   if (initial_capacity > 0 &&
+         !memfile_reserve(userdata, (int64_t)initial_capacity)) {
+      al_free(userdata);
+      return NULL;
+   }
+
+   memfile = al_create_file_handle(&memfile_vtable, userdata);
+   if (!memfile) {
+      al_free(userdata->mem);
+      al_free(userdata);
+   }
+
+   return memfile;
+}
+
+/* Function: al_get_memfile_buffer
+ */
+void *al_get_memfile_buffer(ALLEGRO_FILE *fp, size_t *size)
+{
+   ALLEGRO_FILE_MEMFILE *mf;
+
+   ASSERT(fp);
+
+   if (fp->vtable != &memfile_vtable)
+      return NULL;
+
+   mf = al_get_file_userdata(fp);
+   if (size)
+      *size = mf->size;
+   return mf->mem;
+}
+
+/* Function: al_peek_memfile
+ */
+const void *al_peek_memfile(ALLEGRO_FILE *fp, size_t *size)
+{
+   static const char empty[1] = {0};
+   ALLEGRO_FILE_MEMFILE *mf;
+   int64_t pos;
+
+   ASSERT(fp);
+
+   /* Bytes pushed back with al_fungetc are not part of the buffer. */
+   if (fp->vtable != &memfile_vtable || fp->ungetc_len > 0)
+      return NULL;
+
+   mf = al_get_file_userdata(fp);
+   if (!mf->readable)
+      return NULL;
+
+   /* Our position trails the memfile's by whatever was read ahead. */
+   pos = mf->pos - (int64_t)(fp->rbuf_len - fp->rbuf_pos);
+   if (size)
+      *size = mf->size - pos;
+   return mf->mem ? mf->mem + pos : empty;
+}
+
 /* Function: al_get_allegro_memfile_version
  */
 uint32_t al_get_allegro_memfile_version(void)
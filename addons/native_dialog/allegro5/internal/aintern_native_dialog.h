@@ -1,7 +1,7 @@
 #ifndef __al_included_allegro_aintern_native_dialog_h
 #define __al_included_allegro_aintern_native_dialog_h
 
-#include "allegro5/internal/aintern_list.h"
+#include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_vector.h"
 #include "allegro5/internal/aintern_native_dialog_cfg.h"
 
@@ -35,6 +35,9 @@ struct ALLEGRO_NATIVE_DIALOG
    bool tl_init_error;
    bool tl_done;
    bool tl_have_pending;
+   int tl_pending_lines;      /* newlines in tl_pending_text */
+   int tl_update_ms;          /* least time between updates of the window */
+   int tl_max_lines;          /* scrollback, 0 for no limit */
    ALLEGRO_EVENT_SOURCE tl_events;
    void *tl_textview;
 
@@ -43,7 +46,7 @@ struct ALLEGRO_NATIVE_DIALOG
    void *window;
    void *async_queue;
    
-   _AL_LIST_ITEM *dtor_item;
+   _AL_DTOR_ITEM *dtor_item;
 };
 
 extern bool _al_init_native_dialog_addon(void);
@@ -55,6 +58,8 @@ extern int _al_show_native_message_box(ALLEGRO_DISPLAY *display,
 extern bool _al_open_native_text_log(ALLEGRO_NATIVE_DIALOG *textlog);
 extern void _al_close_native_text_log(ALLEGRO_NATIVE_DIALOG *textlog);
 extern void _al_append_native_text_log(ALLEGRO_NATIVE_DIALOG *textlog);
+extern int _al_native_text_log_lines_to_trim(ALLEGRO_NATIVE_DIALOG *textlog,
+   int lines);
 
 typedef struct ALLEGRO_MENU_ITEM ALLEGRO_MENU_ITEM;
 
@@ -156,6 +156,16 @@ static gboolean do_append_native_text_log(gpointer data)
    GtkTextBuffer *buffer = gtk_text_view_get_buffer(tv);
    GtkTextIter iter;
    GtkTextMark *mark;
+   int trim;
+
+   trim = _al_native_text_log_lines_to_trim(textlog,
+      gtk_text_buffer_get_line_count(buffer) + textlog->tl_pending_lines);
+   if (trim > 0) {
+      GtkTextIter start;
+      gtk_text_buffer_get_start_iter(buffer, &start);
+      gtk_text_buffer_get_iter_at_line(buffer, &iter, trim);
+      gtk_text_buffer_delete(buffer, &start, &iter);
+   }
 
    gtk_text_buffer_get_end_iter(buffer, &iter);
    gtk_text_buffer_insert(buffer, &iter, al_cstr(textlog->tl_pending_text), -1);
@@ -165,6 +175,7 @@ static gboolean do_append_native_text_log(gpointer data)
    gtk_text_buffer_delete_mark(buffer, mark);
 
    al_ustr_truncate(textlog->tl_pending_text, 0);
+   textlog->tl_pending_lines = 0;
 
    textlog->tl_have_pending = false;
 
@@ -179,7 +190,8 @@ void _al_append_native_text_log(ALLEGRO_NATIVE_DIALOG *textlog)
       return;
    textlog->tl_have_pending = true;
 
-   gdk_threads_add_timeout(100, do_append_native_text_log, textlog);
+   gdk_threads_add_timeout(textlog->tl_update_ms, do_append_native_text_log,
+      textlog);
 }
 
 /* [gtk thread] */
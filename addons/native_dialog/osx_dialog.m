@@ -161,11 +161,12 @@ int _al_show_native_message_box(ALLEGRO_DISPLAY *display,
 {
 @public
    ALLEGRO_NATIVE_DIALOG *textlog;
+   int lines;
 }
 - (void)keyDown: (NSEvent*)event;
 - (BOOL)windowShouldClose: (id)sender;
 - (void)emitCloseEventWithKeypress: (BOOL)keypress;
-- (void)appendText: (NSString*)text;
+- (void)appendText: (NSString*)text lines: (int)n;
 @end
 
 
@@ -205,11 +206,26 @@ int _al_show_native_message_box(ALLEGRO_DISPLAY *display,
    al_emit_user_event(&self->textlog->tl_events, &event, NULL);
 }
 
-- (void)appendText: (NSString*)text
+- (void)appendText: (NSString*)text lines: (int)n
 {
    NSTextStorage* store = [self textStorage];
+   NSMutableString* str = [store mutableString];
+   int trim = _al_native_text_log_lines_to_trim(self->textlog, self->lines + n);
    [store beginEditing];
-   [[store mutableString] appendString:text];
+   if (trim > 0) {
+      /* Find the end of the trim'th line. */
+      NSUInteger end = 0;
+      int i;
+      for (i = 0; i < trim && end < [str length]; i++) {
+         NSRange r = [str rangeOfString: @"\n" options: NSLiteralSearch
+            range: NSMakeRange(end, [str length] - end)];
+         end = (r.location == NSNotFound) ? [str length] : r.location + 1;
+      }
+      [str deleteCharactersInRange: NSMakeRange(0, end)];
+      self->lines -= i;
+   }
+   [str appendString:text];
+   self->lines += n;
    [store endEditing];
 }
 @end
@@ -281,6 +297,11 @@ bool _al_open_native_text_log(ALLEGRO_NATIVE_DIALOG *textlog)
 void _al_close_native_text_log(ALLEGRO_NATIVE_DIALOG *textlog)
 {
     NSWindow *win = (NSWindow *)textlog->window;
+    /* Wait for the last update, which still uses the view. */
+    al_lock_mutex(textlog->tl_text_mutex);
+    while (textlog->tl_have_pending)
+        al_wait_cond(textlog->tl_text_cond, textlog->tl_text_mutex);
+    al_unlock_mutex(textlog->tl_text_mutex);
     if ([win isVisible]) {
         [win performSelectorOnMainThread:@selector(close) withObject:nil waitUntilDone:YES];
     }
@@ -294,15 +315,24 @@ void _al_close_native_text_log(ALLEGRO_NATIVE_DIALOG *textlog)
 
 void _al_append_native_text_log(ALLEGRO_NATIVE_DIALOG *textlog)
 {
-    if (textlog->is_active) {
+    if (!textlog->is_active || textlog->tl_have_pending)
+        return;
+    textlog->tl_have_pending = true;
+
+    /* Everything appended until then goes to the view at once. */
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW,
+          (int64_t)textlog->tl_update_ms * NSEC_PER_MSEC),
+       dispatch_get_main_queue(), ^{
         ALLEGLogView *view = (ALLEGLogView *)textlog->tl_textview;
+        al_lock_mutex(textlog->tl_text_mutex);
         NSString *text = [NSString stringWithUTF8String: al_cstr(textlog->tl_pending_text)];
-        [view performSelectorOnMainThread:@selector(appendText:)
-                               withObject:text
-                            waitUntilDone:YES];
-        
+        [view appendText: text lines: textlog->tl_pending_lines];
         al_ustr_truncate(textlog->tl_pending_text, 0);
-    }
+        textlog->tl_pending_lines = 0;
+        textlog->tl_have_pending = false;
+        al_broadcast_cond(textlog->tl_text_cond);
+        al_unlock_mutex(textlog->tl_text_mutex);
+    });
 }
 
 #pragma mark  Menus
@@ -1,7 +1,9 @@
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_native_dialog.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_native_dialog.h"
 #include "allegro5/internal/aintern_native_dialog_cfg.h"
 #include "allegro5/internal/aintern_dtor.h"
@@ -18,6 +20,67 @@
 #endif
 
 
+/* Appends collect in tl_pending_text, which the platform code moves to the
+ * window at most tl_update_ms apart. Programs logging thousands of lines a
+ * second would otherwise keep the window too busy to be redrawn.
+ */
+static void read_text_log_config(ALLEGRO_NATIVE_DIALOG *textlog)
+{
+   ALLEGRO_CONFIG *config = al_get_system_config();
+   const char *v;
+   int rate = 30;
+
+   v = al_get_config_value(config, "native_dialog", "textlog_update_rate");
+   if (v)
+      rate = atoi(v);
+   textlog->tl_update_ms = (rate > 0) ? 1000 / rate : 0;
+
+   v = al_get_config_value(config, "native_dialog", "textlog_max_lines");
+   textlog->tl_max_lines = v ? _ALLEGRO_MAX(0, atoi(v)) : 0;
+}
+
+
+/* _al_native_text_log_lines_to_trim:
+ *  Returns how many lines to remove from the start of a window which will
+ *  hold the given number of lines. An eighth more than needed goes, so that
+ *  trimming happens once every so many lines rather than on every update.
+ */
+int _al_native_text_log_lines_to_trim(ALLEGRO_NATIVE_DIALOG *textlog,
+   int lines)
+{
+   int max = textlog->tl_max_lines;
+
+   if (max <= 0 || lines <= max)
+      return 0;
+   return lines - max + max / 8;
+}
+
+
+/* count_pending_lines:
+ *  Count the newlines appended to tl_pending_text from byte pos on, and drop
+ *  the oldest lines if the window could not keep them anyway.
+ */
+static void count_pending_lines(ALLEGRO_NATIVE_DIALOG *textlog, int pos)
+{
+   ALLEGRO_USTR *text = textlog->tl_pending_text;
+   int trim;
+
+   while ((pos = al_ustr_find_chr(text, pos, '\n')) >= 0) {
+      textlog->tl_pending_lines++;
+      pos++;
+   }
+
+   trim = _al_native_text_log_lines_to_trim(textlog, textlog->tl_pending_lines);
+   if (trim > 0) {
+      pos = 0;
+      textlog->tl_pending_lines -= trim;
+      while (trim-- > 0)
+         pos = al_ustr_find_chr(text, pos, '\n') + 1;
+      al_ustr_remove_range(text, 0, pos);
+   }
+}
+
+
 /* This will only return when the text window is closed. */
 static void *text_log_thread_proc(ALLEGRO_THREAD *thread, void *arg)
 {
@@ -53,6 +116,7 @@ ALLEGRO_TEXTLOG *al_open_native_text_log(char const *title, int flags)
    textlog->tl_text_cond = al_create_cond();
    textlog->tl_text_mutex = al_create_mutex();
    textlog->tl_pending_text = al_ustr_new("");
+   read_text_log_config(textlog);
    al_init_user_event_source(&textlog->tl_events);
 
    textlog->tl_init_error = false;
@@ -137,6 +201,7 @@ void al_append_native_text_log(ALLEGRO_TEXTLOG *textlog,
 {
    ALLEGRO_NATIVE_DIALOG *dialog = (ALLEGRO_NATIVE_DIALOG *)textlog;
    va_list args;
+   int pos;
 
    /* Fall back to printf if no window. */
    if (!dialog) {
@@ -149,9 +214,11 @@ void al_append_native_text_log(ALLEGRO_TEXTLOG *textlog,
    al_lock_mutex(dialog->tl_text_mutex);
 
    /* We could optimise the case where format="%s". */
+   pos = al_ustr_size(dialog->tl_pending_text);
    va_start(args, format);
    al_ustr_vappendf(dialog->tl_pending_text, format, args);
    va_end(args);
+   count_pending_lines(dialog, pos);
 
    _al_append_native_text_log(dialog);
 
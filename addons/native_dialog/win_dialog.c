@@ -30,6 +30,9 @@ ALLEGRO_DEBUG_CHANNEL("win_dialog")
 #define WM_HIDE_MENU (WM_APP + 43)
 #define WM_SHOW_MENU (WM_APP + 44)
 
+/* Timer of the text log windows, for rate limited updates. */
+#define TEXT_LOG_TIMER_ID 1
+
 /* Reference count for shared resources. */
 static int wlog_count = 0;
 
@@ -418,6 +421,20 @@ static ALLEGRO_USTR* convert_crlf(ALLEGRO_USTR* s) {
 static void wlog_do_append_native_text_log(ALLEGRO_NATIVE_DIALOG *textlog)
 {
    int index;
+   int lines;
+   int trim;
+
+   lines = (int)SendMessage(textlog->tl_textview, EM_GETLINECOUNT, 0, 0);
+   trim = _al_native_text_log_lines_to_trim(textlog,
+      lines + textlog->tl_pending_lines);
+   if (trim > 0) {
+      index = (trim < lines) ?
+         (int)SendMessage(textlog->tl_textview, EM_LINEINDEX, (WPARAM)trim, 0) :
+         -1;
+      SendMessage(textlog->tl_textview, EM_SETSEL, 0, (LPARAM)index);
+      SendMessage(textlog->tl_textview, EM_REPLACESEL, 0, (LPARAM)TEXT(""));
+   }
+
    index = GetWindowTextLength(textlog->tl_textview);
    SendMessage(textlog->tl_textview, EM_SETSEL, (WPARAM)index, (LPARAM)index);
    convert_crlf(textlog->tl_pending_text);
@@ -425,7 +442,7 @@ static void wlog_do_append_native_text_log(ALLEGRO_NATIVE_DIALOG *textlog)
    SendMessage(textlog->tl_textview, EM_REPLACESEL, 0, (LPARAM) buf);
    al_free(buf);
    al_ustr_truncate(textlog->tl_pending_text, 0);
-   textlog->tl_have_pending = false;
+   textlog->tl_pending_lines = 0;
 
    SendMessage(textlog->tl_textview, WM_VSCROLL, SB_BOTTOM, 0);
 }
@@ -479,10 +496,32 @@ static LRESULT CALLBACK wlog_text_log_callback(HWND hWnd, UINT uMsg, WPARAM wPar
          break;
 
       case WM_USER:
+         /* The first text goes out at once. Until the timer finds nothing
+          * new, tl_have_pending stays set so that the user thread does not
+          * post more messages.
+          */
          al_lock_mutex(textlog->tl_text_mutex);
          wlog_do_append_native_text_log(textlog);
+         if (textlog->tl_update_ms > 0)
+            SetTimer(hWnd, TEXT_LOG_TIMER_ID, textlog->tl_update_ms, NULL);
+         else
+            textlog->tl_have_pending = false;
          al_unlock_mutex(textlog->tl_text_mutex);
          break;
+
+      case WM_TIMER:
+         if (wParam != TEXT_LOG_TIMER_ID)
+            break;
+         al_lock_mutex(textlog->tl_text_mutex);
+         if (al_ustr_size(textlog->tl_pending_text) > 0) {
+            wlog_do_append_native_text_log(textlog);
+         }
+         else {
+            KillTimer(hWnd, TEXT_LOG_TIMER_ID);
+            textlog->tl_have_pending = false;
+         }
+         al_unlock_mutex(textlog->tl_text_mutex);
+         return 0;
    }
 
    return DefWindowProc(hWnd, uMsg, wParam, lParam);
@@ -0,0 +1,68 @@
+#ifndef __al_included_allegro5_allegro_perf_h
+#define __al_included_allegro5_allegro_perf_h
+
+#include "allegro5/allegro.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if (defined ALLEGRO_MINGW32) || (defined ALLEGRO_MSVC) || (defined ALLEGRO_BCC32)
+   #ifndef ALLEGRO_STATICLINK
+      #ifdef ALLEGRO_PERF_SRC
+         #define _ALLEGRO_PERF_DLL __declspec(dllexport)
+      #else
+         #define _ALLEGRO_PERF_DLL __declspec(dllimport)
+      #endif
+   #else
+      #define _ALLEGRO_PERF_DLL
+   #endif
+#endif
+
+#if defined ALLEGRO_MSVC
+   #define ALLEGRO_PERF_FUNC(type, name, args)      _ALLEGRO_PERF_DLL type __cdecl name args
+#elif defined ALLEGRO_MINGW32
+   #define ALLEGRO_PERF_FUNC(type, name, args)      extern type name args
+#elif defined ALLEGRO_BCC32
+   #define ALLEGRO_PERF_FUNC(type, name, args)      extern _ALLEGRO_PERF_DLL type name args
+#else
+   #define ALLEGRO_PERF_FUNC      AL_FUNC
+#endif
+
+
+ALLEGRO_PERF_FUNC(uint32_t, al_get_allegro_perf_version, (void));
+
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_PERF_SRC)
+
+/* Type: ALLEGRO_PERF_OVERLAY
+ */
+typedef struct ALLEGRO_PERF_OVERLAY ALLEGRO_PERF_OVERLAY;
+
+/* Enum: ALLEGRO_PERF_OVERLAY_FLAGS
+ */
+enum ALLEGRO_PERF_OVERLAY_FLAGS {
+   ALLEGRO_PERF_FRAME_TIME       = 1 << 0,
+   ALLEGRO_PERF_FRAME_GRAPH      = 1 << 1,
+   ALLEGRO_PERF_DRAW_STATS       = 1 << 2,
+   ALLEGRO_PERF_TEXTURE_UPLOADS  = 1 << 3,
+   ALLEGRO_PERF_FILE_IO          = 1 << 4,
+   ALLEGRO_PERF_COUNTERS         = 1 << 5
+};
+
+ALLEGRO_PERF_FUNC(ALLEGRO_PERF_OVERLAY *, al_create_perf_overlay, (ALLEGRO_DISPLAY *display, int history));
+ALLEGRO_PERF_FUNC(void, al_destroy_perf_overlay, (ALLEGRO_PERF_OVERLAY *overlay));
+ALLEGRO_PERF_FUNC(void, al_set_perf_overlay_flags, (ALLEGRO_PERF_OVERLAY *overlay, int flags));
+ALLEGRO_PERF_FUNC(int, al_get_perf_overlay_flags, (const ALLEGRO_PERF_OVERLAY *overlay));
+ALLEGRO_PERF_FUNC(bool, al_set_perf_counter, (ALLEGRO_PERF_OVERLAY *overlay, const char *name, double value));
+ALLEGRO_PERF_FUNC(void, al_update_perf_overlay, (ALLEGRO_PERF_OVERLAY *overlay));
+ALLEGRO_PERF_FUNC(void, al_draw_perf_overlay, (ALLEGRO_PERF_OVERLAY *overlay, float x, float y));
+ALLEGRO_PERF_FUNC(bool, al_save_perf_overlay_csv, (const ALLEGRO_PERF_OVERLAY *overlay, const char *filename));
+ALLEGRO_PERF_FUNC(bool, al_save_perf_overlay_csv_f, (const ALLEGRO_PERF_OVERLAY *overlay, ALLEGRO_FILE *f));
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,474 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Performance overlay: per-frame statistics in a ring buffer, drawn
+ *      with the builtin font and exportable as CSV.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#define ALLEGRO_INTERNAL_UNSTABLE
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_font.h"
+#include "allegro5/allegro_perf.h"
+#include "allegro5/internal/aintern.h"
+
+ALLEGRO_DEBUG_CHANNEL("perf")
+
+#define MAX_COUNTERS       8
+#define MAX_COUNTER_NAME   32
+#define GRAPH_HEIGHT       40
+#define GRAPH_MAX_WIDTH    240
+#define GRAPH_SCALE        (1.0 / 30.0)   /* A full bar is 1/30 s. */
+#define DEFAULT_FLAGS      (ALLEGRO_PERF_FRAME_TIME | \
+                            ALLEGRO_PERF_FRAME_GRAPH | \
+                            ALLEGRO_PERF_DRAW_STATS | \
+                            ALLEGRO_PERF_TEXTURE_UPLOADS | \
+                            ALLEGRO_PERF_COUNTERS)
+
+typedef struct PERF_SAMPLE
+{
+   int64_t frame;
+   double time;
+   double frame_time;
+   double gpu_frame_time;
+   int draw_calls;
+   int vertices;
+   int texture_flushes;
+   int texture_uploads;
+   int64_t texture_upload_bytes;
+   uint64_t file_reads;
+   uint64_t file_bytes_read;
+   double counters[MAX_COUNTERS];
+} PERF_SAMPLE;
+
+struct ALLEGRO_PERF_OVERLAY
+{
+   ALLEGRO_DISPLAY *display;
+   int flags;
+
+   /* Ring buffer: the oldest sample is at next when count == capacity. */
+   PERF_SAMPLE *samples;
+   int capacity;
+   int count;
+   int next;
+   int64_t frame;
+
+   int num_counters;
+   char counter_names[MAX_COUNTERS][MAX_COUNTER_NAME];
+   double counter_values[MAX_COUNTERS];
+
+   /* Previous readings, the samples hold the differences. */
+   double last_time;
+   ALLEGRO_DISPLAY_STATS last_display;
+   ALLEGRO_FILE_STATS last_file;
+
+   /* Created on the first draw, for the display drawn to. */
+   ALLEGRO_FONT *font;
+   ALLEGRO_BITMAP *pixel;
+};
+
+
+/* Function: al_create_perf_overlay
+ */
+ALLEGRO_PERF_OVERLAY *al_create_perf_overlay(ALLEGRO_DISPLAY *display,
+   int history)
+{
+   ALLEGRO_PERF_OVERLAY *overlay;
+
+   ASSERT(history > 0);
+
+   overlay = al_calloc(1, sizeof(*overlay));
+   if (!overlay)
+      return NULL;
+   overlay->samples = al_calloc(history, sizeof(PERF_SAMPLE));
+   if (!overlay->samples) {
+      al_free(overlay);
+      return NULL;
+   }
+   overlay->display = display;
+   overlay->capacity = history;
+   overlay->flags = DEFAULT_FLAGS;
+   overlay->last_time = al_get_time();
+
+   /* The first call also starts the GPU timing. */
+   if (display)
+      al_get_display_stats(display, &overlay->last_display);
+
+   return overlay;
+}
+
+
+/* Function: al_destroy_perf_overlay
+ */
+void al_destroy_perf_overlay(ALLEGRO_PERF_OVERLAY *overlay)
+{
+   if (!overlay)
+      return;
+   if (overlay->font)
+      al_destroy_font(overlay->font);
+   if (overlay->pixel)
+      al_destroy_bitmap(overlay->pixel);
+   al_free(overlay->samples);
+   al_free(overlay);
+}
+
+
+/* read_file_stats:
+ *  Reads the statistics of the current file interface, if enabled.
+ */
+static void read_file_stats(ALLEGRO_FILE_STATS *stats)
+{
+   if (!al_get_file_interface_stats(al_get_new_file_interface(), stats))
+      memset(stats, 0, sizeof(*stats));
+}
+
+
+/* Function: al_set_perf_overlay_flags
+ */
+void al_set_perf_overlay_flags(ALLEGRO_PERF_OVERLAY *overlay, int flags)
+{
+   ASSERT(overlay);
+
+   if ((flags & ALLEGRO_PERF_FILE_IO) && !(overlay->flags & ALLEGRO_PERF_FILE_IO)) {
+      al_set_file_stats_enabled(true);
+      read_file_stats(&overlay->last_file);
+   }
+   overlay->flags = flags;
+}
+
+
+/* Function: al_get_perf_overlay_flags
+ */
+int al_get_perf_overlay_flags(const ALLEGRO_PERF_OVERLAY *overlay)
+{
+   ASSERT(overlay);
+   return overlay->flags;
+}
+
+
+/* Function: al_set_perf_counter
+ */
+bool al_set_perf_counter(ALLEGRO_PERF_OVERLAY *overlay, const char *name,
+   double value)
+{
+   int i;
+
+   ASSERT(overlay);
+   ASSERT(name);
+
+   for (i = 0; i < overlay->num_counters; i++) {
+      if (strcmp(overlay->counter_names[i], name) == 0) {
+         overlay->counter_values[i] = value;
+         return true;
+      }
+   }
+
+   if (overlay->num_counters == MAX_COUNTERS) {
+      ALLEGRO_WARN("No room for counter %s.\n", name);
+      return false;
+   }
+   _al_sane_strncpy(overlay->counter_names[i], name, MAX_COUNTER_NAME);
+   overlay->counter_values[i] = value;
+   overlay->num_counters++;
+   return true;
+}
+
+
+/* get_sample:
+ *  Returns the i-th sample, counting from the oldest.
+ */
+static PERF_SAMPLE *get_sample(const ALLEGRO_PERF_OVERLAY *overlay, int i)
+{
+   int first = (overlay->count < overlay->capacity) ? 0 : overlay->next;
+   return &overlay->samples[(first + i) % overlay->capacity];
+}
+
+
+/* counter_delta:
+ *  The difference between two readings of a counter, or the new reading if
+ *  the counter was reset in between.
+ */
+static int64_t counter_delta(int64_t now, int64_t last)
+{
+   return (now >= last) ? now - last : now;
+}
+
+
+/* Function: al_update_perf_overlay
+ */
+void al_update_perf_overlay(ALLEGRO_PERF_OVERLAY *overlay)
+{
+   PERF_SAMPLE *s;
+   double now = al_get_time();
+
+   ASSERT(overlay);
+
+   s = &overlay->samples[overlay->next];
+   memset(s, 0, sizeof(*s));
+   s->frame = overlay->frame++;
+   s->time = now;
+   s->frame_time = now - overlay->last_time;
+   overlay->last_time = now;
+
+   if (overlay->display) {
+      ALLEGRO_DISPLAY_STATS ds;
+      ALLEGRO_DISPLAY_STATS *last = &overlay->last_display;
+
+      al_get_display_stats(overlay->display, &ds);
+      s->gpu_frame_time = ds.gpu_frame_time;
+      s->draw_calls = counter_delta(ds.draw_calls, last->draw_calls);
+      s->vertices = counter_delta(ds.vertices, last->vertices);
+      s->texture_flushes = counter_delta(ds.texture_flushes,
+         last->texture_flushes);
+      s->texture_uploads = counter_delta(ds.texture_uploads,
+         last->texture_uploads);
+      s->texture_upload_bytes = counter_delta(ds.texture_upload_bytes,
+         last->texture_upload_bytes);
+      *last = ds;
+   }
+
+   if (overlay->flags & ALLEGRO_PERF_FILE_IO) {
+      ALLEGRO_FILE_STATS fs;
+
+      read_file_stats(&fs);
+      s->file_reads = counter_delta(fs.reads, overlay->last_file.reads);
+      s->file_bytes_read = counter_delta(fs.bytes_read,
+         overlay->last_file.bytes_read);
+      overlay->last_file = fs;
+   }
+
+   memcpy(s->counters, overlay->counter_values, sizeof(s->counters));
+
+   overlay->next = (overlay->next + 1) % overlay->capacity;
+   if (overlay->count < overlay->capacity)
+      overlay->count++;
+}
+
+
+/* create_resources:
+ *  Creates the font and the bitmap the graph is drawn with, for the display
+ *  of the target bitmap.
+ */
+static bool create_resources(ALLEGRO_PERF_OVERLAY *overlay)
+{
+   ALLEGRO_STATE state;
+
+   if (!overlay->font) {
+      overlay->font = al_create_builtin_font();
+      if (!overlay->font)
+         return false;
+   }
+
+   if (!overlay->pixel) {
+      al_store_state(&state, ALLEGRO_STATE_BITMAP);
+      al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
+      overlay->pixel = al_create_bitmap(1, 1);
+      if (overlay->pixel) {
+         al_set_target_bitmap(overlay->pixel);
+         al_clear_to_color(al_map_rgb_f(1, 1, 1));
+      }
+      al_restore_state(&state);
+      if (!overlay->pixel)
+         return false;
+   }
+
+   return true;
+}
+
+
+/* Function: al_draw_perf_overlay
+ */
+void al_draw_perf_overlay(ALLEGRO_PERF_OVERLAY *overlay, float x, float y)
+{
+   ALLEGRO_COLOR text = al_map_rgb_f(1, 1, 1);
+   ALLEGRO_STATE state;
+   const PERF_SAMPLE *last;
+   double frame_sum = 0, frame_max = 0;
+   int line_h, lines, width, i;
+   int graph_w = 0;
+   float ty;
+
+   ASSERT(overlay);
+
+   if (overlay->count == 0 || !create_resources(overlay))
+      return;
+
+   for (i = 0; i < overlay->count; i++) {
+      double t = get_sample(overlay, i)->frame_time;
+      frame_sum += t;
+      if (t > frame_max)
+         frame_max = t;
+   }
+   last = get_sample(overlay, overlay->count - 1);
+
+   line_h = al_get_font_line_height(overlay->font) + 2;
+   lines = 0;
+   if (overlay->flags & ALLEGRO_PERF_FRAME_TIME)
+      lines += 2;
+   if (overlay->flags & ALLEGRO_PERF_DRAW_STATS)
+      lines++;
+   if (overlay->flags & ALLEGRO_PERF_TEXTURE_UPLOADS)
+      lines++;
+   if (overlay->flags & ALLEGRO_PERF_FILE_IO)
+      lines++;
+   if (overlay->flags & ALLEGRO_PERF_COUNTERS)
+      lines += overlay->num_counters;
+   if (overlay->flags & ALLEGRO_PERF_FRAME_GRAPH)
+      graph_w = _ALLEGRO_MIN(overlay->capacity, GRAPH_MAX_WIDTH);
+   width = _ALLEGRO_MAX(graph_w, 30 * 8);
+
+   al_store_state(&state, ALLEGRO_STATE_BLENDER);
+   al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA);
+
+   /* Background and graph bars share the one bitmap, so they are one batch. */
+   al_hold_bitmap_drawing(true);
+   al_draw_tinted_scaled_bitmap(overlay->pixel, al_map_rgba_f(0, 0, 0, 0.6),
+      0, 0, 1, 1, x, y, width + 4,
+      lines * line_h + (graph_w ? GRAPH_HEIGHT + 4 : 0) + 4, 0);
+   if (graph_w) {
+      float gy = y + 2 + lines * line_h + GRAPH_HEIGHT;
+      int first = overlay->count - _ALLEGRO_MIN(overlay->count, graph_w);
+      for (i = first; i < overlay->count; i++) {
+         double t = get_sample(overlay, i)->frame_time;
+         float h = _ALLEGRO_MIN(t / GRAPH_SCALE, 1.0) * GRAPH_HEIGHT;
+         ALLEGRO_COLOR c = (t > 1.0 / 60 + 0.001) ?
+            al_map_rgb_f(1, 0.3, 0.2) : al_map_rgb_f(0.3, 1, 0.3);
+         al_draw_tinted_scaled_bitmap(overlay->pixel, c, 0, 0, 1, 1,
+            x + 2 + graph_w - (overlay->count - i), gy - h, 1, h, 0);
+      }
+   }
+   al_hold_bitmap_drawing(false);
+
+   al_hold_bitmap_drawing(true);
+   ty = y + 2;
+   if (overlay->flags & ALLEGRO_PERF_FRAME_TIME) {
+      al_draw_textf(overlay->font, text, x + 2, ty, 0,
+         "frame %6.2f ms  %5.1f fps", last->frame_time * 1000,
+         overlay->count / _ALLEGRO_MAX(frame_sum, 1e-6));
+      ty += line_h;
+      al_draw_textf(overlay->font, text, x + 2, ty, 0,
+         "avg %.2f max %.2f gpu %.2f", frame_sum * 1000 / overlay->count,
+         frame_max * 1000, last->gpu_frame_time * 1000);
+      ty += line_h;
+   }
+   if (overlay->flags & ALLEGRO_PERF_DRAW_STATS) {
+      al_draw_textf(overlay->font, text, x + 2, ty, 0,
+         "draws %d verts %d flush %d", last->draw_calls, last->vertices,
+         last->texture_flushes);
+      ty += line_h;
+   }
+   if (overlay->flags & ALLEGRO_PERF_TEXTURE_UPLOADS) {
+      al_draw_textf(overlay->font, text, x + 2, ty, 0,
+         "uploads %d (%.1f KB)", last->texture_uploads,
+         last->texture_upload_bytes / 1024.0);
+      ty += line_h;
+   }
+   if (overlay->flags & ALLEGRO_PERF_FILE_IO) {
+      al_draw_textf(overlay->font, text, x + 2, ty, 0,
+         "file reads %d (%.1f KB)", (int)last->file_reads,
+         last->file_bytes_read / 1024.0);
+      ty += line_h;
+   }
+   if (overlay->flags & ALLEGRO_PERF_COUNTERS) {
+      for (i = 0; i < overlay->num_counters; i++) {
+         al_draw_textf(overlay->font, text, x + 2, ty, 0, "%s %g",
+            overlay->counter_names[i], last->counters[i]);
+         ty += line_h;
+      }
+   }
+   al_hold_bitmap_drawing(false);
+
+   al_restore_state(&state);
+}
+
+
+/* Function: al_save_perf_overlay_csv
+ */
+bool al_save_perf_overlay_csv(const ALLEGRO_PERF_OVERLAY *overlay,
+   const char *filename)
+{
+   ALLEGRO_FILE *f;
+   bool ret;
+
+   ASSERT(overlay);
+   ASSERT(filename);
+
+   f = al_fopen(filename, "w");
+   if (!f)
+      return false;
+   ret = al_save_perf_overlay_csv_f(overlay, f);
+   if (!al_fclose(f))
+      ret = false;
+   return ret;
+}
+
+
+/* write_csv_name:
+ *  Writes a counter name as a quoted CSV field.
+ */
+static void write_csv_name(ALLEGRO_FILE *f, const char *name)
+{
+   al_fputc(f, '"');
+   for (; *name; name++) {
+      if (*name == '"')
+         al_fputc(f, '"');
+      al_fputc(f, *name);
+   }
+   al_fputc(f, '"');
+}
+
+
+/* Function: al_save_perf_overlay_csv_f
+ */
+bool al_save_perf_overlay_csv_f(const ALLEGRO_PERF_OVERLAY *overlay,
+   ALLEGRO_FILE *f)
+{
+   int i, j;
+
+   ASSERT(overlay);
+   ASSERT(f);
+
+   al_fputs(f, "frame,time,frame_ms,gpu_ms,draw_calls,vertices,"
+      "texture_flushes,texture_uploads,texture_upload_bytes,"
+      "file_reads,file_bytes_read");
+   for (j = 0; j < overlay->num_counters; j++) {
+      al_fputc(f, ',');
+      write_csv_name(f, overlay->counter_names[j]);
+   }
+   al_fputc(f, '\n');
+
+   for (i = 0; i < overlay->count; i++) {
+      const PERF_SAMPLE *s = get_sample(overlay, i);
+      al_fprintf(f, "%lld,%.6f,%.3f,%.3f,%d,%d,%d,%d,%lld,%llu,%llu",
+         (long long)s->frame, s->time, s->frame_time * 1000,
+         s->gpu_frame_time * 1000, s->draw_calls, s->vertices,
+         s->texture_flushes, s->texture_uploads,
+         (long long)s->texture_upload_bytes,
+         (unsigned long long)s->file_reads,
+         (unsigned long long)s->file_bytes_read);
+      for (j = 0; j < overlay->num_counters; j++)
+         al_fprintf(f, ",%g", s->counters[j]);
+      al_fputc(f, '\n');
+   }
+
+   return !al_ferror(f);
+}
+
+
+/* Function: al_get_allegro_perf_version
+ */
+uint32_t al_get_allegro_perf_version(void)
+{
+   return ALLEGRO_VERSION_INT;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -159,6 +159,26 @@ typedef struct ALLEGRO_VERTEX_BUFFER ALLEGRO_VERTEX_BUFFER;
  */
 typedef struct ALLEGRO_INDEX_BUFFER ALLEGRO_INDEX_BUFFER;
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_PRIMITIVES_SRC)
+/* Type: ALLEGRO_PRIM_INSTANCE
+ */
+typedef struct ALLEGRO_PRIM_INSTANCE ALLEGRO_PRIM_INSTANCE;
+
+struct ALLEGRO_PRIM_INSTANCE {
+   float x, y;
+   float sx, sy;
+   float theta;
+   float u, v;
+   ALLEGRO_COLOR color;
+};
+#endif
+
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_PRIMITIVES_SRC)
+/* Type: ALLEGRO_POLYLINE_BUFFER
+ */
+typedef struct ALLEGRO_POLYLINE_BUFFER ALLEGRO_POLYLINE_BUFFER;
+#endif
+
 ALLEGRO_PRIM_FUNC(uint32_t, al_get_allegro_primitives_version, (void));
 
 /*
@@ -172,6 +192,15 @@ ALLEGRO_PRIM_FUNC(int, al_draw_indexed_prim, (const void* vtxs, const ALLEGRO_VE
 ALLEGRO_PRIM_FUNC(int, al_draw_vertex_buffer, (ALLEGRO_VERTEX_BUFFER* vertex_buffer, ALLEGRO_BITMAP* texture, int start, int end, int type));
 ALLEGRO_PRIM_FUNC(int, al_draw_indexed_buffer, (ALLEGRO_VERTEX_BUFFER* vertex_buffer, ALLEGRO_BITMAP* texture, ALLEGRO_INDEX_BUFFER* index_buffer, int start, int end, int type));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_PRIMITIVES_SRC)
+ALLEGRO_PRIM_FUNC(void, al_hold_primitive_drawing, (bool hold));
+ALLEGRO_PRIM_FUNC(bool, al_is_primitive_drawing_held, (void));
+ALLEGRO_PRIM_FUNC(int, al_draw_instanced_prim, (const void* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEGRO_BITMAP* texture, int start, int end, int type, const ALLEGRO_PRIM_INSTANCE* instances, int num_instances));
+ALLEGRO_PRIM_FUNC(int, al_draw_instanced_vertex_buffer, (ALLEGRO_VERTEX_BUFFER* vertex_buffer, ALLEGRO_BITMAP* texture, int start, int end, int type, const ALLEGRO_PRIM_INSTANCE* instances, int num_instances));
+ALLEGRO_PRIM_FUNC(int, al_draw_vertex_buffers, (ALLEGRO_VERTEX_BUFFER* const* vertex_buffers, int num_buffers, ALLEGRO_BITMAP* texture, int start, int end, int type));
+ALLEGRO_PRIM_FUNC(int, al_draw_indexed_vertex_buffers, (ALLEGRO_VERTEX_BUFFER* const* vertex_buffers, int num_buffers, ALLEGRO_BITMAP* texture, ALLEGRO_INDEX_BUFFER* index_buffer, int start, int end, int type));
+#endif
+
 ALLEGRO_PRIM_FUNC(ALLEGRO_VERTEX_DECL*, al_create_vertex_decl, (const ALLEGRO_VERTEX_ELEMENT* elements, int stride));
 ALLEGRO_PRIM_FUNC(void, al_destroy_vertex_decl, (ALLEGRO_VERTEX_DECL* decl));
 
@@ -183,6 +212,10 @@ ALLEGRO_PRIM_FUNC(void, al_destroy_vertex_buffer, (ALLEGRO_VERTEX_BUFFER* buffer
 ALLEGRO_PRIM_FUNC(void*, al_lock_vertex_buffer, (ALLEGRO_VERTEX_BUFFER* buffer, int offset, int length, int flags));
 ALLEGRO_PRIM_FUNC(void, al_unlock_vertex_buffer, (ALLEGRO_VERTEX_BUFFER* buffer));
 ALLEGRO_PRIM_FUNC(int, al_get_vertex_buffer_size, (ALLEGRO_VERTEX_BUFFER* buffer));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_PRIMITIVES_SRC)
+ALLEGRO_PRIM_FUNC(bool, al_update_vertex_buffer, (ALLEGRO_VERTEX_BUFFER* buffer, int offset, const void* data, int length));
+ALLEGRO_PRIM_FUNC(int, al_append_vertex_buffer, (ALLEGRO_VERTEX_BUFFER* buffer, const void* data, int length));
+#endif
 
 /*
  * Index buffers
@@ -192,11 +225,18 @@ ALLEGRO_PRIM_FUNC(void, al_destroy_index_buffer, (ALLEGRO_INDEX_BUFFER* buffer))
 ALLEGRO_PRIM_FUNC(void*, al_lock_index_buffer, (ALLEGRO_INDEX_BUFFER* buffer, int offset, int length, int flags));
 ALLEGRO_PRIM_FUNC(void, al_unlock_index_buffer, (ALLEGRO_INDEX_BUFFER* buffer));
 ALLEGRO_PRIM_FUNC(int, al_get_index_buffer_size, (ALLEGRO_INDEX_BUFFER* buffer));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_PRIMITIVES_SRC)
+ALLEGRO_PRIM_FUNC(bool, al_update_index_buffer, (ALLEGRO_INDEX_BUFFER* buffer, int offset, const void* data, int length));
+ALLEGRO_PRIM_FUNC(int, al_append_index_buffer, (ALLEGRO_INDEX_BUFFER* buffer, const void* data, int length));
+#endif
 
 /*
 * Utilities for high level primitives.
 */
 ALLEGRO_PRIM_FUNC(bool, al_triangulate_polygon, (const float* vertices, size_t vertex_stride, const int* vertex_counts, void (*emit_triangle)(int, int, int, void*), void* userdata));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_PRIMITIVES_SRC)
+ALLEGRO_PRIM_FUNC(int, al_triangulate_polygon_to_indices, (const float* vertices, size_t vertex_stride, const int* vertex_counts, int* indices, int max_indices));
+#endif
 
 
 /*
@@ -241,6 +281,11 @@ ALLEGRO_PRIM_FUNC(void, al_draw_filled_pieslice, (float cx, float cy, float r, f
 ALLEGRO_PRIM_FUNC(void, al_draw_filled_rounded_rectangle, (float x1, float y1, float x2, float y2, float rx, float ry, ALLEGRO_COLOR color));
 
 ALLEGRO_PRIM_FUNC(void, al_draw_polyline, (const float* vertices, int vertex_stride, int vertex_count, int join_style, int cap_style, ALLEGRO_COLOR color, float thickness, float miter_limit));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_PRIMITIVES_SRC)
+ALLEGRO_PRIM_FUNC(ALLEGRO_POLYLINE_BUFFER*, al_create_polyline_buffer, (const float* vertices, int vertex_stride, int vertex_count, int join_style, int cap_style, float miter_limit));
+ALLEGRO_PRIM_FUNC(void, al_destroy_polyline_buffer, (ALLEGRO_POLYLINE_BUFFER* buffer));
+ALLEGRO_PRIM_FUNC(void, al_draw_polyline_buffer, (ALLEGRO_POLYLINE_BUFFER* buffer, ALLEGRO_COLOR color, float thickness));
+#endif
 
 ALLEGRO_PRIM_FUNC(void, al_draw_polygon, (const float* vertices, int vertex_count, int join_style, ALLEGRO_COLOR color, float thickness, float miter_limit));
 ALLEGRO_PRIM_FUNC(void, al_draw_filled_polygon, (const float* vertices, int vertex_count, ALLEGRO_COLOR color));
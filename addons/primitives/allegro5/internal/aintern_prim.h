@@ -40,8 +40,18 @@ typedef struct ALLEGRO_BUFFER_COMMON {
    int local_buffer_length;
    int lock_offset;
    int lock_length;
+
+   /* Where al_append_*_buffer writes next, in elements */
+   int append_pos;
 } ALLEGRO_BUFFER_COMMON;
 
+/* How a buffer update may treat data the GPU could still be reading. */
+enum {
+   _AL_BUFFER_UPDATE_SYNC,          /* wait for it */
+   _AL_BUFFER_UPDATE_NO_OVERWRITE,  /* the updated range is not in use */
+   _AL_BUFFER_UPDATE_DISCARD        /* the rest of the buffer is dropped */
+};
+
 struct ALLEGRO_VERTEX_BUFFER {
    ALLEGRO_VERTEX_DECL* decl;
    ALLEGRO_BUFFER_COMMON common;
@@ -64,13 +74,35 @@ void _al_prim_cache_push_triangle(ALLEGRO_PRIM_VERTEX_CACHE* cache, const float*
 /* Internal functions. */
 float     _al_prim_get_scale(void);
 float     _al_prim_normalize(float* vector);
+float     _al_prim_half_to_float(uint16_t half);
 int       _al_prim_test_line_side(const float* origin, const float* normal, const float* point);
 bool      _al_prim_is_point_in_triangle(const float* point, const float* v0, const float* v1, const float* v2);
 bool      _al_prim_intersect_segment(const float* v0, const float* v1, const float* p0, const float* p1, float* point, float* t0, float* t1);
 bool      _al_prim_are_points_equal(const float* point_a, const float* point_b);
+bool      _al_prim_triangulate_sweep(const float* vertices, size_t vertex_stride, const int* vertex_counts, void (*emit_triangle)(int, int, int, void*), void* userdata);
+
+/* Cache of unit arcs for al_calculate_arc. */
+void _al_prim_init_arc_cache(void);
+void _al_prim_free_arc_cache(void);
+
+/* Held primitive drawing. */
+int  _al_prim_list_type(int type);
+int  _al_prim_count_primitives(int type, int count, int* num_indices);
+int  _al_prim_list_indices(int type, const int* src, int base, int count, int* dst);
+int  _al_prim_batch_add(const ALLEGRO_VERTEX* vtxs, ALLEGRO_BITMAP* texture, const int* indices, int start, int count, int type);
+void _al_prim_flush_batch(void);
+void _al_prim_free_batch(void);
+
+/* Recorded drawing. */
+struct ALLEGRO_DRAW_LIST;
+int  _al_prim_record(struct ALLEGRO_DRAW_LIST* list, const void* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEGRO_BITMAP* texture, const int* indices, int start, int count, int type);
+
+/* Polyline buffers. */
+void _al_prim_free_stroke_shader(void);
 
 int _al_bitmap_region_is_locked(ALLEGRO_BITMAP* bmp, int x1, int y1, int x2, int y2);
 int _al_draw_buffer_common_soft(ALLEGRO_VERTEX_BUFFER* vertex_buffer, ALLEGRO_BITMAP* texture, ALLEGRO_INDEX_BUFFER* index_buffer, int start, int end, int type);
+int _al_draw_buffers_common_soft(ALLEGRO_VERTEX_BUFFER* const* vertex_buffers, int num_buffers, ALLEGRO_BITMAP* texture, ALLEGRO_INDEX_BUFFER* index_buffer, int start, int end, int type);
 
 #ifdef __cplusplus
 }
@@ -16,11 +16,13 @@ bool _al_create_vertex_buffer_directx(ALLEGRO_VERTEX_BUFFER* buf, const void* in
 void _al_destroy_vertex_buffer_directx(ALLEGRO_VERTEX_BUFFER* buf);
 void* _al_lock_vertex_buffer_directx(ALLEGRO_VERTEX_BUFFER* buf);
 void _al_unlock_vertex_buffer_directx(ALLEGRO_VERTEX_BUFFER* buf);
+bool _al_update_vertex_buffer_directx(ALLEGRO_VERTEX_BUFFER* buf, int offset, int length, const void* data, int mode);
 
 bool _al_create_index_buffer_directx(ALLEGRO_INDEX_BUFFER* buf, const void* initial_data, size_t num_indices, int flags);
 void _al_destroy_index_buffer_directx(ALLEGRO_INDEX_BUFFER* buf);
 void* _al_lock_index_buffer_directx(ALLEGRO_INDEX_BUFFER* buf);
 void _al_unlock_index_buffer_directx(ALLEGRO_INDEX_BUFFER* buf);
+bool _al_update_index_buffer_directx(ALLEGRO_INDEX_BUFFER* buf, int offset, int length, const void* data, int mode);
 
 int _al_draw_vertex_buffer_directx(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture, ALLEGRO_VERTEX_BUFFER* vertex_buffer, int start, int end, int type);
 int _al_draw_indexed_buffer_directx(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture, ALLEGRO_VERTEX_BUFFER* vertex_buffer, ALLEGRO_INDEX_BUFFER* index_buffer, int start, int end, int type);
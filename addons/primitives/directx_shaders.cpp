@@ -66,6 +66,7 @@ void _al_create_primitives_shader(void* dev, ALLEGRO_VERTEX_DECL* decl)
       switch(e->storage) {
          case ALLEGRO_PRIM_SHORT_2:
          case ALLEGRO_PRIM_FLOAT_2:
+         case ALLEGRO_PRIM_HALF_FLOAT_2:
             position = 1;
          break;
          case ALLEGRO_PRIM_FLOAT_3:
@@ -36,12 +36,14 @@
  *      See readme.txt for copyright information.
  */
 
+#define ALLEGRO_INTERNAL_UNSTABLE
 
 #include "allegro5/allegro_primitives.h"
 #ifdef ALLEGRO_CFG_OPENGL
 #include "allegro5/allegro_opengl.h"
 #endif
 #include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_prim.h"
 #include "allegro5/debug.h"
 #include <math.h>
 
@@ -421,16 +423,116 @@ void al_draw_filled_rectangle(float x1, float y1, float x2, float y2,
    al_draw_prim(vtx, 0, 0, 0, 4, ALLEGRO_PRIM_TRIANGLE_FAN);
 }
 
+/* Unit arcs starting at angle 0, which is what circles, ellipses and the
+ * corners of rounded rectangles use, indexed by the number of points.  An
+ * entry is never changed once it is made, so it can be read without the
+ * lock after it was looked up.
+ */
+#define ARC_CACHE_MAX_POINTS  ALLEGRO_VERTEX_CACHE_SIZE
+
+enum {
+   ARC_CACHE_FULL,
+   ARC_CACHE_QUARTER,
+   ARC_CACHE_NUM_KINDS
+};
+
+static float *arc_cache[ARC_CACHE_NUM_KINDS][ARC_CACHE_MAX_POINTS + 1];
+static ALLEGRO_MUTEX *arc_cache_mutex;
+
+
+void _al_prim_init_arc_cache(void)
+{
+   if (!arc_cache_mutex)
+      arc_cache_mutex = al_create_mutex();
+}
+
+
+void _al_prim_free_arc_cache(void)
+{
+   int i, j;
+
+   for (i = 0; i < ARC_CACHE_NUM_KINDS; i++) {
+      for (j = 0; j <= ARC_CACHE_MAX_POINTS; j++) {
+         al_free(arc_cache[i][j]);
+         arc_cache[i][j] = NULL;
+      }
+   }
+   al_destroy_mutex(arc_cache_mutex);
+   arc_cache_mutex = NULL;
+}
+
+
+/* Returns the cached cosines and sines of the points of an arc, or NULL if
+ * the arc is not of a cached kind.  They are computed the same way as
+ * al_calculate_arc does for the uncached arcs.
+ */
+static const float *get_unit_arc(float start_theta, float delta_theta,
+   int num_points)
+{
+   float *arc;
+   float theta, c, s, x, y, t;
+   int kind;
+   int ii;
+
+   if (!arc_cache_mutex || start_theta != 0.0f ||
+         num_points > ARC_CACHE_MAX_POINTS)
+      return NULL;
+   if (delta_theta == (float)(ALLEGRO_PI * 2))
+      kind = ARC_CACHE_FULL;
+   else if (delta_theta == (float)(ALLEGRO_PI / 2))
+      kind = ARC_CACHE_QUARTER;
+   else
+      return NULL;
+
+   al_lock_mutex(arc_cache_mutex);
+   arc = arc_cache[kind][num_points];
+   al_unlock_mutex(arc_cache_mutex);
+   if (arc)
+      return arc;
+
+   arc = al_malloc(2 * num_points * sizeof(float));
+   if (!arc)
+      return NULL;
+
+   theta = delta_theta / ((float)num_points - 1);
+   c = cosf(theta);
+   s = sinf(theta);
+   x = cosf(start_theta);
+   y = sinf(start_theta);
+   for (ii = 0; ii < num_points; ii++) {
+      arc[2 * ii] = x;
+      arc[2 * ii + 1] = y;
+
+      t = x;
+      x = c * x - s * y;
+      y = s * t + c * y;
+   }
+
+   al_lock_mutex(arc_cache_mutex);
+   if (arc_cache[kind][num_points]) {
+      /* Another thread was quicker. */
+      al_free(arc);
+      arc = arc_cache[kind][num_points];
+   }
+   else {
+      arc_cache[kind][num_points] = arc;
+   }
+   al_unlock_mutex(arc_cache_mutex);
+
+   return arc;
+}
+
 /* Function: al_calculate_arc
  */
 void al_calculate_arc(float* dest, int stride, float cx, float cy,
    float rx, float ry, float start_theta, float delta_theta, float thickness,
    int num_points)
 {   
+   const float *unit;
    float theta;
-   float c;
-   float s;
-   float x, y, t;
+   float c = 0;
+   float s = 0;
+   float x = 0, y = 0, t;
    int ii;
  
    ASSERT(dest);
@@ -438,13 +540,30 @@ void al_calculate_arc(float* dest, int stride, float cx, float cy,
    ASSERT(rx >= 0);
    ASSERT(ry >= 0);
 
-   if (thickness > 0.0f) {
+   unit = get_unit_arc(start_theta, delta_theta, num_points);
+   if (!unit) {
       theta = delta_theta / ((float)(num_points) - 1);
       c = cosf(theta);
       s = sinf(theta);
       x = cosf(start_theta);
       y = sinf(start_theta);
- 
+   }
+
+   /* Moves x and y to the point ii, from the point before it unless the
+    * arc is cached.
+    */
+#define NEXT_POINT(ii)                      \
+   if (unit) {                              \
+      x = unit[2 * (ii)];                   \
+      y = unit[2 * (ii) + 1];               \
+   }                                        \
+   else if ((ii) > 0) {                     \
+      t = x;                                \
+      x = c * x - s * y;                    \
+      y = s * t + c * y;                    \
+   }
+
+   if (thickness > 0.0f) {
       if (rx == ry) {
          /*
          The circle case is particularly simple
@@ -452,23 +571,22 @@ void al_calculate_arc(float* dest, int stride, float cx, float cy,
          float r1 = rx - thickness / 2.0f;
          float r2 = rx + thickness / 2.0f;
          for (ii = 0; ii < num_points; ii ++) {
+            NEXT_POINT(ii)
             *dest =       r2 * x + cx;
             *(dest + 1) = r2 * y + cy;
             dest = (float*)(((char*)dest) + stride);
             *dest =        r1 * x + cx;
             *(dest + 1) =  r1 * y + cy;
             dest = (float*)(((char*)dest) + stride);
-            
-            t = x;
-            x = c * x - s * y;
-            y = s * t + c * y;
          }
       } else {
          if (rx != 0 && ry != 0) {
             for (ii = 0; ii < num_points; ii++) {
-               float denom = hypotf(ry * x, rx * y);
-               float nx = thickness / 2 * ry * x / denom;
-               float ny = thickness / 2 * rx * y / denom;
+               float denom, nx, ny;
+               NEXT_POINT(ii)
+               denom = hypotf(ry * x, rx * y);
+               nx = thickness / 2 * ry * x / denom;
+               ny = thickness / 2 * rx * y / denom;
 
                *dest =       rx * x + cx + nx;
                *(dest + 1) = ry * y + cy + ny;
@@ -476,30 +594,19 @@ void al_calculate_arc(float* dest, int stride, float cx, float cy,
                *dest =       rx * x + cx - nx;
                *(dest + 1) = ry * y + cy - ny;
                dest = (float*)(((char*)dest) + stride);
-
-               t = x;
-               x = c * x - s * y;
-               y = s * t + c * y;
             }
          }
       }
    } else {
-      theta = delta_theta / ((float)num_points - 1);
-      c = cosf(theta);
-      s = sinf(theta);
-      x = cosf(start_theta);
-      y = sinf(start_theta);
-      
       for (ii = 0; ii < num_points; ii++) {
+         NEXT_POINT(ii)
          *dest =       rx * x + cx;
          *(dest + 1) = ry * y + cy;
          dest = (float*)(((char*)dest) + stride);
-
-         t = x;
-         x = c * x - s * y;
-         y = s * t + c * y;
       }
    }
+
+#undef NEXT_POINT
 }
 
 /* Function: al_draw_pieslice
@@ -1019,12 +1126,16 @@ void al_calculate_spline(float* dest, int stride, float points[8],
     */
    float cache_point_buffer_storage[150];
    float* cache_point_buffer = cache_point_buffer_storage;
+   size_t mark = 0;
 
    ASSERT(num_segments > 1);
    ASSERT(points);
 
    if (num_segments > (int)(sizeof(cache_point_buffer_storage) / sizeof(float) / 2)) {
-      cache_point_buffer = al_malloc(2 * sizeof(float) * num_segments);
+      mark = al_get_frame_arena_mark();
+      cache_point_buffer = al_frame_alloc(2 * sizeof(float) * num_segments);
+      if (!cache_point_buffer)
+         return;
    }
 
    dt = 1.0 / (num_segments - 1);
@@ -1073,7 +1184,7 @@ void al_calculate_spline(float* dest, int stride, float points[8],
    al_calculate_ribbon(dest, stride, cache_point_buffer, 2 * sizeof(float), thickness, num_segments);
 
    if (cache_point_buffer != cache_point_buffer_storage) {
-      al_free(cache_point_buffer);
+      al_rewind_frame_arena(mark);
    }
 }
 
@@ -636,7 +636,7 @@ void al_draw_soft_line(ALLEGRO_VERTEX* v1, ALLEGRO_VERTEX* v2, uintptr_t state,
           _al_pixel_format_is_video_only(target->locked_region.format))
          return;
    } else {
-      if (!(lr = al_lock_bitmap_region(target, min_x, min_y, max_x - min_x, max_y - min_y, ALLEGRO_PIXEL_FORMAT_ANY, 0)))
+      if (!(lr = _al_lock_drawn_region(target, min_x, min_y, max_x - min_x, max_y - min_y)))
          return;
       need_unlock = 1;
    }
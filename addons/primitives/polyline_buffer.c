@@ -0,0 +1,575 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Polyline buffers, polylines stroked once and drawn at any thickness.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#define ALLEGRO_INTERNAL_UNSTABLE
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_primitives.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_dtor.h"
+#include "allegro5/internal/aintern_prim.h"
+#include "allegro5/internal/aintern_system.h"
+#include <math.h>
+#include <stddef.h>
+
+ALLEGRO_DEBUG_CHANNEL("primitives")
+
+/* Segments in a half circle of a round join or cap, as in polyline.c. */
+#define ARC_SEGMENTS  32
+
+
+/* Every vertex of the stroke is a point of the polyline plus an offset
+ * for a stroke of thickness 2.  The triangles are built once with the
+ * same joins and caps as al_draw_polyline, and drawing them at some other
+ * thickness only scales the offsets, in a vertex shader if possible.
+ *
+ * Unlike al_draw_polyline, the inner sides of the joins overlap, so that
+ * the offsets do not depend on the thickness.
+ */
+typedef struct STROKE_VERTEX
+{
+   float x, y;
+   float dx, dy;
+} STROKE_VERTEX;
+
+
+struct ALLEGRO_POLYLINE_BUFFER
+{
+   float *points;
+   int num_points;
+   int join_style;
+   int cap_style;
+   float miter_limit;
+
+   STROKE_VERTEX *stroke;
+   int num_vtxs;
+   int capacity;
+
+   ALLEGRO_VERTEX_DECL *decl;
+   ALLEGRO_VERTEX_BUFFER *vertex_buffer;
+   ALLEGRO_VERTEX *vtxs;   /* Scratch space for drawing without shader. */
+};
+
+
+static ALLEGRO_SHADER *stroke_shader;
+static _AL_DTOR_ITEM *stroke_shader_dtor_item;
+static bool stroke_shader_failed;
+
+
+#ifdef ALLEGRO_CFG_SHADER_GLSL
+static const char *stroke_vertex_source =
+   "attribute vec4 " ALLEGRO_SHADER_VAR_POS ";\n"
+   "attribute vec2 " ALLEGRO_SHADER_VAR_USER_ATTR "0;\n"
+   "uniform mat4 " ALLEGRO_SHADER_VAR_PROJVIEW_MATRIX ";\n"
+   "uniform vec4 stroke_color;\n"
+   "uniform float stroke_radius;\n"
+   "varying vec4 varying_color;\n"
+   "varying vec2 varying_texcoord;\n"
+   "varying float varying_tex_index;\n"
+   "void main()\n"
+   "{\n"
+   "  vec2 pos = " ALLEGRO_SHADER_VAR_POS ".xy + stroke_radius * "
+         ALLEGRO_SHADER_VAR_USER_ATTR "0;\n"
+   "  varying_color = stroke_color;\n"
+   "  varying_texcoord = vec2(0.0, 0.0);\n"
+   "  varying_tex_index = 0.0;\n"
+   "  gl_Position = " ALLEGRO_SHADER_VAR_PROJVIEW_MATRIX " * vec4(pos, 0.0, 1.0);\n"
+   "}\n";
+#endif
+
+
+static void destroy_stroke_shader(void *shader)
+{
+   ASSERT(shader == stroke_shader);
+   al_destroy_shader(shader);
+   stroke_shader = NULL;
+}
+
+
+/* Returns the shader expanding strokes for the given target, or NULL if
+ * they have to be expanded on the CPU.
+ */
+static ALLEGRO_SHADER *get_stroke_shader(ALLEGRO_BITMAP *target)
+{
+#ifdef ALLEGRO_CFG_SHADER_GLSL
+   ALLEGRO_DISPLAY *display;
+   ALLEGRO_SHADER *shader;
+   const char *pixel_source;
+
+   if (!target || (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP))
+      return NULL;
+   display = _al_get_bitmap_display(target);
+   if (!display || !(al_get_display_flags(display) & ALLEGRO_OPENGL) ||
+         !(al_get_display_flags(display) & ALLEGRO_PROGRAMMABLE_PIPELINE))
+      return NULL;
+   if (stroke_shader || stroke_shader_failed)
+      return stroke_shader;
+
+   /* The shader is destroyed through the destructor registered below, which
+    * also forgets the global.
+    */
+   _al_push_destructor_owner();
+   shader = al_create_shader(ALLEGRO_SHADER_GLSL);
+   _al_pop_destructor_owner();
+   if (!shader) {
+      stroke_shader_failed = true;
+      return NULL;
+   }
+
+   pixel_source = al_get_default_shader_source(ALLEGRO_SHADER_GLSL,
+      ALLEGRO_PIXEL_SHADER);
+   if (!pixel_source ||
+         !al_attach_shader_source(shader, ALLEGRO_VERTEX_SHADER,
+            stroke_vertex_source) ||
+         !al_attach_shader_source(shader, ALLEGRO_PIXEL_SHADER,
+            pixel_source) ||
+         !al_build_shader(shader)) {
+      ALLEGRO_ERROR("Failed to build the polyline shader: %s\n",
+         al_get_shader_log(shader));
+      al_destroy_shader(shader);
+      stroke_shader_failed = true;
+      return NULL;
+   }
+
+   stroke_shader = shader;
+   stroke_shader_dtor_item = _al_register_destructor(_al_dtor_list,
+      "prim_stroke_shader", shader, destroy_stroke_shader);
+   return stroke_shader;
+#else
+   (void)target;
+   return NULL;
+#endif
+}
+
+
+void _al_prim_free_stroke_shader(void)
+{
+   if (stroke_shader) {
+      _al_unregister_destructor(_al_dtor_list, stroke_shader_dtor_item);
+      destroy_stroke_shader(stroke_shader);
+   }
+   stroke_shader_failed = false;
+}
+
+
+static bool push_vertex(ALLEGRO_POLYLINE_BUFFER *buf, const float *p,
+   float dx, float dy)
+{
+   STROKE_VERTEX *v;
+
+   if (buf->num_vtxs == buf->capacity) {
+      int capacity = buf->capacity ? buf->capacity * 2 : 256;
+      STROKE_VERTEX *stroke = al_realloc(buf->stroke,
+         capacity * sizeof *stroke);
+      if (!stroke)
+         return false;
+      buf->stroke = stroke;
+      buf->capacity = capacity;
+   }
+
+   v = &buf->stroke[buf->num_vtxs++];
+   v->x = p[0];
+   v->y = p[1];
+   v->dx = dx;
+   v->dy = dy;
+   return true;
+}
+
+
+/* Pushes the triangle between p + a, p + b and p + c. */
+static bool push_triangle(ALLEGRO_POLYLINE_BUFFER *buf, const float *p,
+   const float *a, const float *b, const float *c)
+{
+   return push_vertex(buf, p, a[0], a[1]) &&
+      push_vertex(buf, p, b[0], b[1]) &&
+      push_vertex(buf, p, c[0], c[1]);
+}
+
+
+/* Pushes a fan around p from the unit offset u, turning by angle. */
+static bool push_arc(ALLEGRO_POLYLINE_BUFFER *buf, const float *p,
+   const float *u, float angle)
+{
+   static const float zero[2] = { 0.0f, 0.0f };
+   int segments = (int)(ARC_SEGMENTS * fabsf(angle) / ALLEGRO_PI);
+   float c, s;
+   float a[2], b[2];
+   int i;
+
+   if (segments < 1)
+      segments = 1;
+   c = cosf(angle / segments);
+   s = sinf(angle / segments);
+
+   a[0] = u[0];
+   a[1] = u[1];
+   for (i = 0; i < segments; i++) {
+      b[0] = c * a[0] - s * a[1];
+      b[1] = s * a[0] + c * a[1];
+      if (!push_triangle(buf, p, zero, a, b))
+         return false;
+      a[0] = b[0];
+      a[1] = b[1];
+   }
+   return true;
+}
+
+
+static bool push_segment(ALLEGRO_POLYLINE_BUFFER *buf, const float *v0,
+   const float *v1, const float *normal)
+{
+   float n0 = normal[0], n1 = normal[1];
+
+   return push_vertex(buf, v0, n0, n1) &&
+      push_vertex(buf, v1, n0, n1) &&
+      push_vertex(buf, v1, -n0, -n1) &&
+      push_vertex(buf, v0, n0, n1) &&
+      push_vertex(buf, v1, -n0, -n1) &&
+      push_vertex(buf, v0, -n0, -n1);
+}
+
+
+/* Pushes the cap at p, for a line leaving p in direction dir. */
+static bool push_cap(ALLEGRO_POLYLINE_BUFFER *buf, const float *p,
+   const float *dir)
+{
+   float n[2] = { -dir[1], dir[0] };
+   float m[2] = { dir[1], -dir[0] };
+   float a[2], b[2];
+
+   switch (buf->cap_style) {
+      case ALLEGRO_LINE_CAP_SQUARE:
+         a[0] = n[0] + dir[0];
+         a[1] = n[1] + dir[1];
+         b[0] = m[0] + dir[0];
+         b[1] = m[1] + dir[1];
+         return push_triangle(buf, p, n, a, b) &&
+            push_triangle(buf, p, n, b, m);
+      case ALLEGRO_LINE_CAP_TRIANGLE:
+         return push_triangle(buf, p, n, dir, m);
+      case ALLEGRO_LINE_CAP_ROUND:
+         return push_arc(buf, p, m, ALLEGRO_PI);
+      default:
+         return true;
+   }
+}
+
+
+/* Pushes the join at p between the segments with directions d0 and d1,
+ * on the outer side of the turn.
+ */
+static bool push_join(ALLEGRO_POLYLINE_BUFFER *buf, const float *p,
+   const float *d0, const float *d1)
+{
+   static const float zero[2] = { 0.0f, 0.0f };
+   float cross = d0[0] * d1[1] - d0[1] * d1[0];
+   float dot = d0[0] * d1[0] + d0[1] * d1[1];
+   float side = cross > 0.0f ? -1.0f : 1.0f;
+   float u0[2] = { -d0[1] * side, d0[0] * side };
+   float u1[2] = { -d1[1] * side, d1[0] * side };
+   float middle[2];
+   float cos_half;
+   float ratio;
+
+   /* Straight on. */
+   if (fabsf(cross) < 1e-6f && dot > 0.0f)
+      return true;
+
+   switch (buf->join_style) {
+      case ALLEGRO_LINE_JOIN_BEVEL:
+         return push_triangle(buf, p, zero, u0, u1);
+
+      case ALLEGRO_LINE_JOIN_ROUND:
+         /* Turn from u0 to u1 around the outside, which for a reversal is
+          * the side d0 points to.
+          */
+         if (fabsf(cross) < 1e-6f)
+            return push_arc(buf, p, u0,
+               u0[1] * d0[0] - u0[0] * d0[1] > 0.0f ? -ALLEGRO_PI : ALLEGRO_PI);
+         return push_arc(buf, p, u0, atan2f(u0[0] * u1[1] - u0[1] * u1[0],
+            u0[0] * u1[0] + u0[1] * u1[1]));
+
+      case ALLEGRO_LINE_JOIN_MITER:
+         middle[0] = u0[0] + u1[0];
+         middle[1] = u0[1] + u1[1];
+         if (_al_prim_normalize(middle) < 1e-6f)
+            return true;
+         cos_half = middle[0] * u0[0] + middle[1] * u0[1];
+         ratio = 1.0f / cos_half;
+
+         if (ratio > buf->miter_limit) {
+            /* Cut the miter off at the limit, as polyline.c does. */
+            float limit = buf->miter_limit;
+            float offset = (ratio - limit) * cos_half /
+               sqrtf(1.0f - cos_half * cos_half);
+            float normal[2] = { -middle[1], middle[0] };
+            float a[2], b[2];
+
+            if (normal[0] * u0[0] + normal[1] * u0[1] < 0.0f) {
+               normal[0] = -normal[0];
+               normal[1] = -normal[1];
+            }
+            a[0] = middle[0] * limit + normal[0] * offset;
+            a[1] = middle[1] * limit + normal[1] * offset;
+            b[0] = middle[0] * limit - normal[0] * offset;
+            b[1] = middle[1] * limit - normal[1] * offset;
+            return push_triangle(buf, p, zero, a, b) &&
+               push_triangle(buf, p, zero, u0, a) &&
+               push_triangle(buf, p, zero, b, u1);
+         }
+         else {
+            float tip[2] = { middle[0] * ratio, middle[1] * ratio };
+            return push_triangle(buf, p, zero, u0, tip) &&
+               push_triangle(buf, p, zero, tip, u1);
+         }
+
+      default:
+         return true;
+   }
+}
+
+
+static bool build_stroke(ALLEGRO_POLYLINE_BUFFER *buf)
+{
+   const float *pts = buf->points;
+   int n = buf->num_points;
+   bool closed = buf->cap_style == ALLEGRO_LINE_CAP_CLOSED;
+   int num_segments = closed ? n : n - 1;
+   float dir[2], prev_dir[2], first_dir[2];
+   int i;
+
+   for (i = 0; i < num_segments; i++) {
+      const float *v0 = pts + 2 * i;
+      const float *v1 = pts + 2 * ((i + 1) % n);
+      float normal[2];
+
+      dir[0] = v1[0] - v0[0];
+      dir[1] = v1[1] - v0[1];
+      _al_prim_normalize(dir);
+      normal[0] = -dir[1];
+      normal[1] = dir[0];
+
+      if (!push_segment(buf, v0, v1, normal))
+         return false;
+
+      if (i == 0) {
+         first_dir[0] = dir[0];
+         first_dir[1] = dir[1];
+      }
+      else if (!push_join(buf, v0, prev_dir, dir)) {
+         return false;
+      }
+      prev_dir[0] = dir[0];
+      prev_dir[1] = dir[1];
+   }
+
+   if (closed)
+      return push_join(buf, pts, prev_dir, first_dir);
+
+   first_dir[0] = -first_dir[0];
+   first_dir[1] = -first_dir[1];
+   return push_cap(buf, pts, first_dir) &&
+      push_cap(buf, pts + 2 * (n - 1), dir);
+}
+
+
+static void create_vertex_buffer(ALLEGRO_POLYLINE_BUFFER *buf)
+{
+   ALLEGRO_VERTEX_ELEMENT elems[] = {
+      {ALLEGRO_PRIM_POSITION, ALLEGRO_PRIM_FLOAT_2,
+         offsetof(STROKE_VERTEX, x)},
+      {ALLEGRO_PRIM_USER_ATTR, ALLEGRO_PRIM_FLOAT_2,
+         offsetof(STROKE_VERTEX, dx)},
+      {0, 0, 0}
+   };
+
+   if (!get_stroke_shader(al_get_target_bitmap()))
+      return;
+
+   buf->decl = al_create_vertex_decl(elems, sizeof(STROKE_VERTEX));
+   if (!buf->decl)
+      return;
+   buf->vertex_buffer = al_create_vertex_buffer(buf->decl, buf->stroke,
+      buf->num_vtxs, ALLEGRO_PRIM_BUFFER_STATIC);
+   if (!buf->vertex_buffer) {
+      ALLEGRO_WARN("Could not create the polyline vertex buffer.\n");
+      al_destroy_vertex_decl(buf->decl);
+      buf->decl = NULL;
+   }
+}
+
+
+/* Function: al_create_polyline_buffer
+ */
+ALLEGRO_POLYLINE_BUFFER* al_create_polyline_buffer(const float* vertices,
+   int vertex_stride, int vertex_count, int join_style, int cap_style,
+   float miter_limit)
+{
+   ALLEGRO_POLYLINE_BUFFER *buf;
+   int i;
+
+   ASSERT(al_is_primitives_addon_initialized());
+   ASSERT(vertices || vertex_count == 0);
+
+   buf = al_calloc(1, sizeof *buf);
+   if (!buf)
+      return NULL;
+   buf->join_style = join_style;
+   buf->cap_style = cap_style;
+   buf->miter_limit = miter_limit;
+
+   buf->points = al_malloc((vertex_count > 0 ? vertex_count : 1) *
+      2 * sizeof(float));
+   if (!buf->points) {
+      al_free(buf);
+      return NULL;
+   }
+
+   /* Repeated points have no direction and are dropped. */
+   for (i = 0; i < vertex_count; i++) {
+      const float *v = (const float *)((const char *)vertices +
+         i * vertex_stride);
+      float *last = buf->points + 2 * (buf->num_points - 1);
+      if (buf->num_points > 0 && last[0] == v[0] && last[1] == v[1])
+         continue;
+      buf->points[2 * buf->num_points] = v[0];
+      buf->points[2 * buf->num_points + 1] = v[1];
+      buf->num_points++;
+   }
+   if (cap_style == ALLEGRO_LINE_CAP_CLOSED && buf->num_points > 1 &&
+         buf->points[0] == buf->points[2 * buf->num_points - 2] &&
+         buf->points[1] == buf->points[2 * buf->num_points - 1]) {
+      buf->num_points--;
+   }
+
+   /* A single line cannot be closed, see emit_polyline. */
+   if (buf->num_points == 2 && cap_style == ALLEGRO_LINE_CAP_CLOSED)
+      buf->cap_style = ALLEGRO_LINE_CAP_NONE;
+
+   if (buf->num_points >= 2) {
+      if (!build_stroke(buf)) {
+         ALLEGRO_ERROR("Out of memory for the polyline stroke.\n");
+         al_destroy_polyline_buffer(buf);
+         return NULL;
+      }
+      create_vertex_buffer(buf);
+   }
+
+   return buf;
+}
+
+
+/* Function: al_destroy_polyline_buffer
+ */
+void al_destroy_polyline_buffer(ALLEGRO_POLYLINE_BUFFER* buffer)
+{
+   if (!buffer)
+      return;
+   if (buffer->vertex_buffer)
+      al_destroy_vertex_buffer(buffer->vertex_buffer);
+   al_destroy_vertex_decl(buffer->decl);
+   al_free(buffer->points);
+   al_free(buffer->stroke);
+   al_free(buffer->vtxs);
+   al_free(buffer);
+}
+
+
+static bool draw_with_shader(ALLEGRO_POLYLINE_BUFFER *buf,
+   ALLEGRO_COLOR color, float radius)
+{
+   ALLEGRO_BITMAP *target = al_get_target_bitmap();
+   ALLEGRO_SHADER *shader;
+   ALLEGRO_SHADER *prev_shader;
+   bool held;
+
+   if (!buf->vertex_buffer)
+      return false;
+   shader = get_stroke_shader(target);
+   if (!shader)
+      return false;
+
+   /* Flush what was drawn with the previous shader. */
+   _al_prim_flush_batch();
+   held = al_is_bitmap_drawing_held();
+   al_hold_bitmap_drawing(false);
+
+   prev_shader = target->shader;
+   if (!al_use_shader(shader)) {
+      al_hold_bitmap_drawing(held);
+      return false;
+   }
+   al_set_shader_float_vector("stroke_color", 4, &color.r, 1);
+   al_set_shader_float("stroke_radius", radius);
+   al_draw_vertex_buffer(buf->vertex_buffer, NULL, 0, buf->num_vtxs,
+      ALLEGRO_PRIM_TRIANGLE_LIST);
+   al_use_shader(prev_shader);
+   al_hold_bitmap_drawing(held);
+   return true;
+}
+
+
+static void draw_expanded(ALLEGRO_POLYLINE_BUFFER *buf, ALLEGRO_COLOR color,
+   float radius)
+{
+   int i;
+
+   if (!buf->vtxs) {
+      buf->vtxs = al_malloc(buf->num_vtxs * sizeof *buf->vtxs);
+      if (!buf->vtxs) {
+         ALLEGRO_ERROR("Out of memory for %d vertices.\n", buf->num_vtxs);
+         return;
+      }
+   }
+
+   for (i = 0; i < buf->num_vtxs; i++) {
+      const STROKE_VERTEX *s = &buf->stroke[i];
+      ALLEGRO_VERTEX *v = &buf->vtxs[i];
+      v->x = s->x + s->dx * radius;
+      v->y = s->y + s->dy * radius;
+      v->z = 0.0f;
+      v->u = 0.0f;
+      v->v = 0.0f;
+      v->color = color;
+   }
+
+   al_draw_prim(buf->vtxs, NULL, NULL, 0, buf->num_vtxs,
+      ALLEGRO_PRIM_TRIANGLE_LIST);
+}
+
+
+/* Function: al_draw_polyline_buffer
+ */
+void al_draw_polyline_buffer(ALLEGRO_POLYLINE_BUFFER* buffer,
+   ALLEGRO_COLOR color, float thickness)
+{
+   ASSERT(buffer);
+
+   if (buffer->num_points < 2)
+      return;
+
+   if (thickness <= 0.0f) {
+      al_draw_polyline(buffer->points, 2 * sizeof(float), buffer->num_points,
+         buffer->join_style, buffer->cap_style, color, 0.0f,
+         buffer->miter_limit);
+      return;
+   }
+
+   if (!draw_with_shader(buffer, color, 0.5f * thickness))
+      draw_expanded(buffer, color, 0.5f * thickness);
+}
+
+/* vim: set sts=3 sw=3 et: */
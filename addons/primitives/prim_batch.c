@@ -0,0 +1,326 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Held primitive drawing, batching primitives into one draw call.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#define ALLEGRO_INTERNAL_UNSTABLE
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_primitives.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_prim.h"
+#include <string.h>
+
+ALLEGRO_DEBUG_CHANNEL("primitives")
+
+/* The batch is flushed when it would grow beyond this. */
+#define BATCH_MAX_VERTICES  (1 << 17)
+
+
+/* While drawing is held, primitives with the default vertex declaration are
+ * transformed on the CPU and appended to one indexed list of points, lines
+ * or triangles, which is drawn with the identity transformation when the
+ * texture, target or kind of primitive changes, or the hold is released.
+ * Strips, fans and loops become lists on the way.
+ */
+typedef struct PRIM_BATCH
+{
+   bool held;
+   ALLEGRO_BITMAP *target;
+   ALLEGRO_BITMAP *texture;
+   int type;               /* ALLEGRO_PRIM_POINT_LIST, _LINE_LIST or
+                              _TRIANGLE_LIST */
+   ALLEGRO_VERTEX *vtxs;
+   int num_vtxs;
+   int vtxs_capacity;
+   int *indices;
+   int num_indices;
+   int indices_capacity;
+} PRIM_BATCH;
+
+
+static PRIM_BATCH batch;
+
+
+int _al_prim_list_type(int type)
+{
+   switch (type) {
+      case ALLEGRO_PRIM_LINE_LIST:
+      case ALLEGRO_PRIM_LINE_STRIP:
+      case ALLEGRO_PRIM_LINE_LOOP:
+         return ALLEGRO_PRIM_LINE_LIST;
+      case ALLEGRO_PRIM_TRIANGLE_LIST:
+      case ALLEGRO_PRIM_TRIANGLE_STRIP:
+      case ALLEGRO_PRIM_TRIANGLE_FAN:
+         return ALLEGRO_PRIM_TRIANGLE_LIST;
+      default:
+         return ALLEGRO_PRIM_POINT_LIST;
+   }
+}
+
+
+/* Returns the number of primitives and of list indices for count
+ * vertices of the given type.
+ */
+int _al_prim_count_primitives(int type, int count, int *num_indices)
+{
+   int n;
+
+   switch (type) {
+      case ALLEGRO_PRIM_LINE_LIST:
+         n = count / 2;
+         *num_indices = n * 2;
+         return n;
+      case ALLEGRO_PRIM_LINE_STRIP:
+         n = count > 1 ? count - 1 : 0;
+         *num_indices = n * 2;
+         return n;
+      case ALLEGRO_PRIM_LINE_LOOP:
+         n = count > 1 ? count : 0;
+         *num_indices = n * 2;
+         return n;
+      case ALLEGRO_PRIM_TRIANGLE_LIST:
+         n = count / 3;
+         *num_indices = n * 3;
+         return n;
+      case ALLEGRO_PRIM_TRIANGLE_STRIP:
+      case ALLEGRO_PRIM_TRIANGLE_FAN:
+         n = count > 2 ? count - 2 : 0;
+         *num_indices = n * 3;
+         return n;
+      default:
+         *num_indices = count;
+         return count;
+   }
+}
+
+
+static bool reserve(int num_vtxs, int num_indices)
+{
+   if (batch.num_vtxs + num_vtxs > batch.vtxs_capacity) {
+      int capacity = batch.vtxs_capacity ? batch.vtxs_capacity : 1024;
+      ALLEGRO_VERTEX *vtxs;
+      while (capacity < batch.num_vtxs + num_vtxs)
+         capacity *= 2;
+      vtxs = al_realloc(batch.vtxs, capacity * sizeof *vtxs);
+      if (!vtxs)
+         return false;
+      batch.vtxs = vtxs;
+      batch.vtxs_capacity = capacity;
+   }
+
+   if (batch.num_indices + num_indices > batch.indices_capacity) {
+      int capacity = batch.indices_capacity ? batch.indices_capacity : 1024;
+      int *indices;
+      while (capacity < batch.num_indices + num_indices)
+         capacity *= 2;
+      indices = al_realloc(batch.indices, capacity * sizeof *indices);
+      if (!indices)
+         return false;
+      batch.indices = indices;
+      batch.indices_capacity = capacity;
+   }
+
+   return true;
+}
+
+
+/* Writes the list indices for count vertices of the given type to dst and
+ * returns how many there are.  The k-th vertex is base + (src ? src[k] : k).
+ */
+int _al_prim_list_indices(int type, const int *src, int base, int count,
+   int *dst)
+{
+   int *start = dst;
+   int k;
+
+   #define I(k) (base + (src ? src[k] : (k)))
+
+   switch (type) {
+      case ALLEGRO_PRIM_LINE_STRIP:
+      case ALLEGRO_PRIM_LINE_LOOP:
+         for (k = 0; k + 1 < count; k++) {
+            *dst++ = I(k);
+            *dst++ = I(k + 1);
+         }
+         if (type == ALLEGRO_PRIM_LINE_LOOP && count > 1) {
+            *dst++ = I(count - 1);
+            *dst++ = I(0);
+         }
+         break;
+      case ALLEGRO_PRIM_TRIANGLE_STRIP:
+         for (k = 0; k + 2 < count; k++) {
+            /* Keep the winding of every triangle the same. */
+            *dst++ = I(k + (k & 1));
+            *dst++ = I(k + 1 - (k & 1));
+            *dst++ = I(k + 2);
+         }
+         break;
+      case ALLEGRO_PRIM_TRIANGLE_FAN:
+         for (k = 1; k + 1 < count; k++) {
+            *dst++ = I(0);
+            *dst++ = I(k);
+            *dst++ = I(k + 1);
+         }
+         break;
+      default: {
+         /* Lists, without any incomplete primitive at the end. */
+         int num_indices;
+         _al_prim_count_primitives(type, count, &num_indices);
+         for (k = 0; k < num_indices; k++)
+            *dst++ = I(k);
+         break;
+      }
+   }
+
+   #undef I
+
+   return dst - start;
+}
+
+
+static int draw_unbatched(const ALLEGRO_VERTEX *vtxs, ALLEGRO_BITMAP *texture,
+   const int *indices, int start, int count, int type)
+{
+   int ret;
+
+   batch.held = false;
+   if (indices)
+      ret = al_draw_indexed_prim(vtxs, NULL, texture, indices, count, type);
+   else
+      ret = al_draw_prim(vtxs, NULL, texture, start, start + count, type);
+   batch.held = true;
+   return ret;
+}
+
+
+/* Adds the vertices from start to start + count, or the count vertices
+ * given by indices, to the batch.  Returns the number of primitives, as
+ * al_draw_prim would.
+ */
+int _al_prim_batch_add(const ALLEGRO_VERTEX *vtxs, ALLEGRO_BITMAP *texture,
+   const int *indices, int start, int count, int type)
+{
+   ALLEGRO_BITMAP *target = al_get_target_bitmap();
+   const ALLEGRO_TRANSFORM *trans = al_get_current_transform();
+   int first, last;
+   int num_indices;
+   int num_prims;
+   int base;
+   int i;
+
+   ASSERT(batch.held);
+
+   num_prims = _al_prim_count_primitives(type, count, &num_indices);
+   if (num_prims == 0)
+      return 0;
+
+   /* Only the vertices the primitives use are copied. */
+   if (indices) {
+      first = last = indices[0];
+      for (i = 1; i < count; i++) {
+         if (indices[i] < first)
+            first = indices[i];
+         else if (indices[i] > last)
+            last = indices[i];
+      }
+   }
+   else {
+      first = start;
+      last = start + count - 1;
+   }
+
+   if (target != batch.target || texture != batch.texture ||
+         _al_prim_list_type(type) != batch.type ||
+         batch.num_vtxs + (last - first + 1) > BATCH_MAX_VERTICES) {
+      _al_prim_flush_batch();
+   }
+   if (!reserve(last - first + 1, num_indices)) {
+      _al_prim_flush_batch();
+      ALLEGRO_WARN("Out of memory for the batch, drawing unbatched.\n");
+      return draw_unbatched(vtxs, texture, indices, start, count, type);
+   }
+   batch.target = target;
+   batch.texture = texture;
+   batch.type = _al_prim_list_type(type);
+
+   base = batch.num_vtxs;
+   memcpy(batch.vtxs + base, vtxs + first,
+      (last - first + 1) * sizeof(ALLEGRO_VERTEX));
+   al_transform_coordinates_3d_array(trans, &batch.vtxs[base].x,
+      last - first + 1, sizeof(ALLEGRO_VERTEX));
+   batch.num_vtxs += last - first + 1;
+
+   batch.num_indices += _al_prim_list_indices(type, indices,
+      indices ? base - first : base, count, batch.indices + batch.num_indices);
+
+   return num_prims;
+}
+
+
+/* Draws the batch with the target it was collected for. */
+void _al_prim_flush_batch(void)
+{
+   ALLEGRO_STATE state;
+   ALLEGRO_TRANSFORM identity;
+
+   if (batch.num_indices == 0) {
+      batch.num_vtxs = 0;
+      return;
+   }
+
+   al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_TRANSFORM);
+   if (al_get_target_bitmap() != batch.target)
+      al_set_target_bitmap(batch.target);
+   al_identity_transform(&identity);
+   al_use_transform(&identity);
+
+   draw_unbatched(batch.vtxs, batch.texture, batch.indices, 0,
+      batch.num_indices, batch.type);
+
+   al_restore_state(&state);
+
+   batch.num_vtxs = 0;
+   batch.num_indices = 0;
+}
+
+
+void _al_prim_free_batch(void)
+{
+   al_free(batch.vtxs);
+   al_free(batch.indices);
+   memset(&batch, 0, sizeof batch);
+}
+
+
+/* Function: al_hold_primitive_drawing
+ */
+void al_hold_primitive_drawing(bool hold)
+{
+   if (!hold && batch.held) {
+      _al_prim_flush_batch();
+      batch.target = NULL;
+      batch.texture = NULL;
+   }
+   batch.held = hold;
+}
+
+
+/* Function: al_is_primitive_drawing_held
+ */
+bool al_is_primitive_drawing_held(void)
+{
+   return batch.held;
+}
+
+/* vim: set sts=3 sw=3 et: */
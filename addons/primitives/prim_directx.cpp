@@ -16,6 +16,8 @@
  *      See readme.txt for copyright information.
  */
 
+#define ALLEGRO_INTERNAL_UNSTABLE
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_primitives.h"
 #include "allegro5/internal/aintern_bitmap.h"
@@ -23,6 +25,7 @@
 #include "allegro5/internal/aintern_prim_soft.h"
 #include "allegro5/internal/aintern_prim.h"
 #include "allegro5/internal/aintern_display.h"
+#include "allegro5/internal/aintern_pixels.h"
 
 #include "allegro5/platform/alplatf.h"
 
@@ -428,6 +431,8 @@ static D3D_STATE setup_state(LPDIRECT3DDEVICE9 device, const ALLEGRO_VERTEX_DECL
       else {
          device->SetSamplerState(0, D3DSAMP_MIPFILTER, D3DTEXF_NONE);
       }
+      device->SetSamplerState(0, D3DSAMP_SRGBTEXTURE,
+         _al_pixel_format_is_srgb(al_get_bitmap_format(texture)));
    }
 
    return state;
@@ -649,6 +654,9 @@ static int draw_prim_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture,
             };
          }
       }
+
+      disp->stats.draw_calls++;
+      disp->stats.vertices += num_vtx;
       
 #ifdef ALLEGRO_CFG_SHADER_HLSL
       if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
@@ -841,6 +849,9 @@ static int draw_buffer_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture, ALLE
          }
       }
 
+      disp->stats.draw_calls++;
+      disp->stats.vertices += num_vtx;
+
 #ifdef ALLEGRO_CFG_SHADER_HLSL
       if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
          d3d_disp->effect->EndPass();
@@ -988,7 +999,8 @@ void _al_set_d3d_decl(ALLEGRO_DISPLAY* display, ALLEGRO_VERTEX_DECL* ret)
          if(e->attribute) {
             d3delements[idx].Stream = 0;
             d3delements[idx].Offset = e->offset;
-            d3delements[idx].Type = D3DDECLTYPE_FLOAT4;
+            d3delements[idx].Type = e->storage == ALLEGRO_PRIM_NORMALIZED_UBYTE_4 ?
+               D3DDECLTYPE_UBYTE4N : D3DDECLTYPE_FLOAT4;
             d3delements[idx].Method = D3DDECLMETHOD_DEFAULT;
             d3delements[idx].Usage = D3DDECLUSAGE_TEXCOORD;
             d3delements[idx].UsageIndex = 1;
@@ -1193,3 +1205,61 @@ void _al_unlock_index_buffer_directx(ALLEGRO_INDEX_BUFFER* buf)
    (void)buf;
 #endif
 }
+
+/* The buffers live in the managed pool, where D3DLOCK_DISCARD and
+ * D3DLOCK_NOOVERWRITE are not allowed, so every mode locks the same way.
+ * The update still avoids reading the range back.
+ */
+bool _al_update_vertex_buffer_directx(ALLEGRO_VERTEX_BUFFER* buf, int offset, int length, const void* data, int mode)
+{
+#ifdef ALLEGRO_CFG_D3D
+   void* ptr;
+   HRESULT res;
+   (void)mode;
+
+   res = ((IDirect3DVertexBuffer9*)buf->common.handle)->Lock((UINT)offset, (UINT)length, &ptr, 0);
+   if (res != D3D_OK) {
+      ALLEGRO_WARN("Locking vertex buffer failed: %ld.\n", res);
+      return false;
+   }
+   memcpy(ptr, data, length);
+   ((IDirect3DVertexBuffer9*)buf->common.handle)->Unlock();
+
+   return true;
+#else
+   (void)buf;
+   (void)offset;
+   (void)length;
+   (void)data;
+   (void)mode;
+
+   return false;
+#endif
+}
+
+bool _al_update_index_buffer_directx(ALLEGRO_INDEX_BUFFER* buf, int offset, int length, const void* data, int mode)
+{
+#ifdef ALLEGRO_CFG_D3D
+   void* ptr;
+   HRESULT res;
+   (void)mode;
+
+   res = ((IDirect3DIndexBuffer9*)buf->common.handle)->Lock((UINT)offset, (UINT)length, &ptr, 0);
+   if (res != D3D_OK) {
+      ALLEGRO_WARN("Locking index buffer failed: %ld.\n", res);
+      return false;
+   }
+   memcpy(ptr, data, length);
+   ((IDirect3DIndexBuffer9*)buf->common.handle)->Unlock();
+
+   return true;
+#else
+   (void)buf;
+   (void)offset;
+   (void)length;
+   (void)data;
+   (void)mode;
+
+   return false;
+#endif
+}
@@ -0,0 +1,201 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Instanced drawing, many copies of one mesh in one draw call.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#define ALLEGRO_INTERNAL_UNSTABLE
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_primitives.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_prim.h"
+#include "allegro5/internal/aintern_prim_soft.h"
+#include <string.h>
+
+ALLEGRO_DEBUG_CHANNEL("primitives")
+
+/* The instances are split over several draw calls so that no call uses
+ * more vertices than this.
+ */
+#define INSTANCE_MAX_VERTICES  (1 << 16)
+
+
+/* The instances are expanded on the CPU: every instance gets a copy of the
+ * mesh with its transformation, color and texture offset applied, and the
+ * copies are drawn as one indexed list with the identity transformation.
+ */
+static int draw_instanced(const ALLEGRO_VERTEX *mesh, int num_mesh_vtxs,
+   ALLEGRO_BITMAP *texture, int type, const ALLEGRO_PRIM_INSTANCE *instances,
+   int num_instances)
+{
+   ALLEGRO_STATE state;
+   ALLEGRO_TRANSFORM current;
+   ALLEGRO_TRANSFORM identity;
+   ALLEGRO_VERTEX *vtxs;
+   int *mesh_indices;
+   int *indices;
+   int num_mesh_indices;
+   int per_call;
+   int num_primitives = 0;
+   int i;
+
+   if (num_instances <= 0 ||
+         _al_prim_count_primitives(type, num_mesh_vtxs, &num_mesh_indices) == 0)
+      return 0;
+
+   per_call = INSTANCE_MAX_VERTICES / num_mesh_vtxs;
+   if (per_call < 1)
+      per_call = 1;
+   if (per_call > num_instances)
+      per_call = num_instances;
+
+   mesh_indices = al_malloc(num_mesh_indices * sizeof *mesh_indices);
+   vtxs = al_malloc(per_call * num_mesh_vtxs * sizeof *vtxs);
+   indices = al_malloc(per_call * num_mesh_indices * sizeof *indices);
+   if (!mesh_indices || !vtxs || !indices) {
+      ALLEGRO_ERROR("Out of memory for %d instances.\n", per_call);
+      goto done;
+   }
+
+   _al_prim_list_indices(type, NULL, 0, num_mesh_vtxs, mesh_indices);
+
+   al_copy_transform(&current, al_get_current_transform());
+   al_store_state(&state, ALLEGRO_STATE_TRANSFORM);
+   al_identity_transform(&identity);
+   al_use_transform(&identity);
+
+   for (i = 0; i < num_instances; i += per_call) {
+      int n = num_instances - i < per_call ? num_instances - i : per_call;
+      int j, k;
+
+      for (j = 0; j < n; j++) {
+         const ALLEGRO_PRIM_INSTANCE *inst = &instances[i + j];
+         ALLEGRO_VERTEX *dst = vtxs + j * num_mesh_vtxs;
+         int *idx = indices + j * num_mesh_indices;
+         ALLEGRO_TRANSFORM t;
+
+         al_build_transform(&t, inst->x, inst->y, inst->sx, inst->sy,
+            inst->theta);
+         al_compose_transform(&t, &current);
+
+         memcpy(dst, mesh, num_mesh_vtxs * sizeof(ALLEGRO_VERTEX));
+         al_transform_coordinates_3d_array(&t, &dst[0].x, num_mesh_vtxs,
+            sizeof(ALLEGRO_VERTEX));
+         for (k = 0; k < num_mesh_vtxs; k++) {
+            dst[k].u += inst->u;
+            dst[k].v += inst->v;
+            dst[k].color.r *= inst->color.r;
+            dst[k].color.g *= inst->color.g;
+            dst[k].color.b *= inst->color.b;
+            dst[k].color.a *= inst->color.a;
+         }
+         for (k = 0; k < num_mesh_indices; k++)
+            idx[k] = mesh_indices[k] + j * num_mesh_vtxs;
+      }
+
+      num_primitives += al_draw_indexed_prim(vtxs, NULL, texture, indices,
+         n * num_mesh_indices, _al_prim_list_type(type));
+   }
+
+   al_restore_state(&state);
+
+done:
+   al_free(mesh_indices);
+   al_free(vtxs);
+   al_free(indices);
+   return num_primitives;
+}
+
+
+static int draw_instanced_decl(const void *vtxs, const ALLEGRO_VERTEX_DECL *decl,
+   ALLEGRO_BITMAP *texture, int num_vtxs, int type,
+   const ALLEGRO_PRIM_INSTANCE *instances, int num_instances)
+{
+   ALLEGRO_VERTEX *mesh;
+   int ret;
+   int i;
+
+   if (!decl)
+      return draw_instanced(vtxs, num_vtxs, texture, type, instances,
+         num_instances);
+
+   mesh = al_malloc(num_vtxs * sizeof *mesh);
+   if (!mesh) {
+      ALLEGRO_ERROR("Out of memory for %d vertices.\n", num_vtxs);
+      return 0;
+   }
+   for (i = 0; i < num_vtxs; i++) {
+      _al_prim_convert_vtx(texture, (const char *)vtxs + i * decl->stride,
+         &mesh[i], decl);
+   }
+   ret = draw_instanced(mesh, num_vtxs, texture, type, instances,
+      num_instances);
+   al_free(mesh);
+   return ret;
+}
+
+
+/* Function: al_draw_instanced_prim
+ */
+int al_draw_instanced_prim(const void* vtxs, const ALLEGRO_VERTEX_DECL* decl,
+   ALLEGRO_BITMAP* texture, int start, int end, int type,
+   const ALLEGRO_PRIM_INSTANCE* instances, int num_instances)
+{
+   int stride = decl ? decl->stride : (int)sizeof(ALLEGRO_VERTEX);
+
+   ASSERT(al_is_primitives_addon_initialized());
+   ASSERT(vtxs);
+   ASSERT(end >= start);
+   ASSERT(start >= 0);
+   ASSERT(type >= 0 && type < ALLEGRO_PRIM_NUM_TYPES);
+   ASSERT(instances || num_instances == 0);
+
+   return draw_instanced_decl((const char *)vtxs + start * stride, decl,
+      texture, end - start, type, instances, num_instances);
+}
+
+
+/* Function: al_draw_instanced_vertex_buffer
+ */
+int al_draw_instanced_vertex_buffer(ALLEGRO_VERTEX_BUFFER* vertex_buffer,
+   ALLEGRO_BITMAP* texture, int start, int end, int type,
+   const ALLEGRO_PRIM_INSTANCE* instances, int num_instances)
+{
+   void *vtxs;
+   int ret;
+
+   ASSERT(al_is_primitives_addon_initialized());
+   ASSERT(vertex_buffer);
+   ASSERT(!vertex_buffer->common.is_locked);
+   ASSERT(end >= start);
+   ASSERT(start >= 0);
+   ASSERT(end <= al_get_vertex_buffer_size(vertex_buffer));
+   ASSERT(type >= 0 && type < ALLEGRO_PRIM_NUM_TYPES);
+   ASSERT(instances || num_instances == 0);
+
+   if (vertex_buffer->common.write_only || end == start || num_instances <= 0)
+      return 0;
+
+   vtxs = al_lock_vertex_buffer(vertex_buffer, start, end - start,
+      ALLEGRO_LOCK_READONLY);
+   if (!vtxs)
+      return 0;
+
+   ret = draw_instanced_decl(vtxs, vertex_buffer->decl, texture, end - start,
+      type, instances, num_instances);
+
+   al_unlock_vertex_buffer(vertex_buffer);
+   return ret;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -30,6 +30,7 @@
 
 #include "allegro5/allegro_opengl.h"
 #include "allegro5/internal/aintern_opengl.h"
+#include <string.h>
 
 static void convert_storage(ALLEGRO_PRIM_STORAGE storage, GLenum* type, int* ncoord, bool* normalized)
 {
@@ -111,7 +112,10 @@ static void convert_storage(ALLEGRO_PRIM_STORAGE storage, GLenum* type, int* nco
    }
 }
 
-static void setup_state(const char* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEGRO_BITMAP* texture)
+/* With disable_missing false, the attributes the declaration lacks keep
+ * their arrays, which lets several buffers each set up some of them.
+ */
+static void setup_attributes(const char* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEGRO_BITMAP* texture, bool disable_missing)
 {
    ALLEGRO_DISPLAY *display = al_get_current_display();
    GLenum type;
@@ -132,7 +136,7 @@ static void setup_state(const char* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEG
                glVertexAttribPointer(display->ogl_extras->varlocs.pos_loc, ncoord, type, normalized, decl->stride, vtxs + e->offset);
                glEnableVertexAttribArray(display->ogl_extras->varlocs.pos_loc);
             }
-         } else {
+         } else if (disable_missing) {
             if (display->ogl_extras->varlocs.pos_loc >= 0) {
                glDisableVertexAttribArray(display->ogl_extras->varlocs.pos_loc);
             }
@@ -148,7 +152,7 @@ static void setup_state(const char* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEG
                glVertexAttribPointer(display->ogl_extras->varlocs.texcoord_loc, ncoord, type, normalized, decl->stride, vtxs + e->offset);
                glEnableVertexAttribArray(display->ogl_extras->varlocs.texcoord_loc);
             }
-         } else {
+         } else if (disable_missing) {
             if (display->ogl_extras->varlocs.texcoord_loc >= 0) {
                glDisableVertexAttribArray(display->ogl_extras->varlocs.texcoord_loc);
             }
@@ -157,10 +161,11 @@ static void setup_state(const char* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEG
          e = &decl->elements[ALLEGRO_PRIM_COLOR_ATTR];
          if(e->attribute) {
             if (display->ogl_extras->varlocs.color_loc >= 0) {
-               glVertexAttribPointer(display->ogl_extras->varlocs.color_loc, 4, GL_FLOAT, true, decl->stride, vtxs + e->offset);
+               type = e->storage == ALLEGRO_PRIM_NORMALIZED_UBYTE_4 ? GL_UNSIGNED_BYTE : GL_FLOAT;
+               glVertexAttribPointer(display->ogl_extras->varlocs.color_loc, 4, type, true, decl->stride, vtxs + e->offset);
                glEnableVertexAttribArray(display->ogl_extras->varlocs.color_loc);
             }
-         } else {
+         } else if (disable_missing) {
             if (display->ogl_extras->varlocs.color_loc >= 0) {
                glDisableVertexAttribArray(display->ogl_extras->varlocs.color_loc);
             }
@@ -175,7 +180,7 @@ static void setup_state(const char* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEG
                   glVertexAttribPointer(display->ogl_extras->varlocs.user_attr_loc[i], ncoord, type, normalized, decl->stride, vtxs + e->offset);
                   glEnableVertexAttribArray(display->ogl_extras->varlocs.user_attr_loc[i]);
                }
-            } else {
+            } else if (disable_missing) {
                if (display->ogl_extras->varlocs.user_attr_loc[i] >= 0) {
                   glDisableVertexAttribArray(display->ogl_extras->varlocs.user_attr_loc[i]);
                }
@@ -210,7 +215,7 @@ static void setup_state(const char* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEG
             convert_storage(e->storage, &type, &ncoord, &normalized);
 
             glVertexPointer(ncoord, type, decl->stride, vtxs + e->offset);
-         } else {
+         } else if (disable_missing) {
             glDisableClientState(GL_VERTEX_ARRAY);
          }
    
@@ -223,7 +228,7 @@ static void setup_state(const char* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEG
             convert_storage(e->storage, &type, &ncoord, &normalized);
 
             glTexCoordPointer(ncoord, type, decl->stride, vtxs + e->offset);
-         } else {
+         } else if (disable_missing) {
             glDisableClientState(GL_TEXTURE_COORD_ARRAY);
          }
    
@@ -231,8 +236,9 @@ static void setup_state(const char* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEG
          if(e->attribute) {
             glEnableClientState(GL_COLOR_ARRAY);
 
-            glColorPointer(4, GL_FLOAT, decl->stride, vtxs + e->offset);
-         } else {
+            type = e->storage == ALLEGRO_PRIM_NORMALIZED_UBYTE_4 ? GL_UNSIGNED_BYTE : GL_FLOAT;
+            glColorPointer(4, type, decl->stride, vtxs + e->offset);
+         } else if (disable_missing) {
             glDisableClientState(GL_COLOR_ARRAY);
             glColor4f(1, 1, 1, 1);
          }
@@ -249,6 +255,12 @@ static void setup_state(const char* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEG
       }
 #endif
    }
+}
+
+/* The declaration tells whether the texture coordinates are in pixels. */
+static void setup_texture(const ALLEGRO_VERTEX_DECL* decl, ALLEGRO_BITMAP* texture)
+{
+   ALLEGRO_DISPLAY *display = al_get_current_display();
 
    if (texture) {
       GLuint gl_texture = al_get_opengl_texture(texture);
@@ -334,6 +346,12 @@ static void setup_state(const char* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEG
    }
 }
 
+static void setup_state(const char* vtxs, const ALLEGRO_VERTEX_DECL* decl, ALLEGRO_BITMAP* texture)
+{
+   setup_attributes(vtxs, decl, texture, true);
+   setup_texture(decl, texture);
+}
+
 static void revert_state(ALLEGRO_BITMAP* texture)
 {
    ALLEGRO_DISPLAY *display = al_get_current_display();
@@ -387,8 +405,30 @@ static void revert_state(ALLEGRO_BITMAP* texture)
    }
 }
 
+/* Points the attributes into the vertex buffers, where the later buffers
+ * override the attributes of the earlier ones.
+ */
+static void setup_buffers(ALLEGRO_VERTEX_BUFFER* const* vertex_buffers, int num_buffers, ALLEGRO_BITMAP* texture)
+{
+   const ALLEGRO_VERTEX_DECL* uv_decl = vertex_buffers[0]->decl;
+   int i;
+
+   for (i = 0; i < num_buffers; i++) {
+      const ALLEGRO_VERTEX_DECL* decl = vertex_buffers[i]->decl;
+
+      glBindBuffer(GL_ARRAY_BUFFER, (GLuint)vertex_buffers[i]->common.handle);
+      setup_attributes(0, decl, texture, i == 0);
+
+      if (i > 0 && (!decl || decl->elements[ALLEGRO_PRIM_TEX_COORD].attribute ||
+            decl->elements[ALLEGRO_PRIM_TEX_COORD_PIXEL].attribute))
+         uv_decl = decl;
+   }
+
+   setup_texture(uv_decl, texture);
+}
+
 static int draw_prim_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture,
-   ALLEGRO_VERTEX_BUFFER* vertex_buffer,
+   ALLEGRO_VERTEX_BUFFER* const* vertex_buffers, int num_buffers,
    const void* vtx, const ALLEGRO_VERTEX_DECL* decl,
    int start, int end, int type)
 {
@@ -405,20 +445,19 @@ static int draw_prim_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture,
 
    if ((!extra->is_backbuffer && disp->ogl_extras->opengl_target !=
       opengl_target) || al_is_bitmap_locked(target)) {
-      if (vertex_buffer) {
-         return _al_draw_buffer_common_soft(vertex_buffer, texture, NULL, start, end, type);
+      if (num_buffers > 0) {
+         return _al_draw_buffers_common_soft(vertex_buffers, num_buffers, texture, NULL, start, end, type);
       }
       else {
          return _al_draw_prim_soft(texture, vtx, decl, start, end, type);
       }
    }
 
-   if (vertex_buffer) {
-      glBindBuffer(GL_ARRAY_BUFFER, (GLuint)vertex_buffer->common.handle);
-   }
-
    _al_opengl_set_blender(disp);
-   setup_state(vtx, decl, texture);
+   if (num_buffers > 0)
+      setup_buffers(vertex_buffers, num_buffers, texture);
+   else
+      setup_state(vtx, decl, texture);
 
    switch (type) {
       case ALLEGRO_PRIM_LINE_LIST: {
@@ -457,10 +496,12 @@ static int draw_prim_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture,
          break;
       };
    }
+   disp->stats.draw_calls++;
+   disp->stats.vertices += num_vtx;
 
    revert_state(texture);
 
-   if (vertex_buffer) {
+   if (num_buffers > 0) {
       glBindBuffer(GL_ARRAY_BUFFER, 0);
    }
 
@@ -468,7 +509,7 @@ static int draw_prim_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture,
 }
 
 static int draw_prim_indexed_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture,
-   ALLEGRO_VERTEX_BUFFER* vertex_buffer,
+   ALLEGRO_VERTEX_BUFFER* const* vertex_buffers, int num_buffers,
    const void* vtx, const ALLEGRO_VERTEX_DECL* decl,
    ALLEGRO_INDEX_BUFFER* index_buffer,
    const int* indices,
@@ -485,6 +526,7 @@ static int draw_prim_indexed_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture
    int num_vtx = end - start;
 #if defined ALLEGRO_IPHONE
    GLushort* iphone_idx = NULL;
+   size_t mark = al_get_frame_arena_mark();
 #endif
 
    if (use_buffers) {
@@ -500,7 +542,7 @@ static int draw_prim_indexed_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture
    if ((!extra->is_backbuffer && disp->ogl_extras->opengl_target !=
       opengl_target) || al_is_bitmap_locked(target)) {
       if (use_buffers) {
-         return _al_draw_buffer_common_soft(vertex_buffer, texture, index_buffer, start, end, type);
+         return _al_draw_buffers_common_soft(vertex_buffers, num_buffers, texture, index_buffer, start, end, type);
       }
       else {
          return _al_draw_prim_indexed_soft(texture, vtx, decl, indices, num_vtx, type);
@@ -510,7 +552,9 @@ static int draw_prim_indexed_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture
 #if defined ALLEGRO_IPHONE
    if (!use_buffers) {
       int ii;
-      iphone_idx = al_malloc(num_vtx * sizeof(GLushort));
+      iphone_idx = al_frame_alloc(num_vtx * sizeof(GLushort));
+      if (!iphone_idx)
+         return 0;
       for (ii = start; ii < end; ii++) {
          iphone_idx[ii] = (GLushort)indices[ii];
       }
@@ -523,11 +567,12 @@ static int draw_prim_indexed_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture
    _al_opengl_set_blender(disp);
 
    if (use_buffers) {
-      glBindBuffer(GL_ARRAY_BUFFER, (GLuint)vertex_buffer->common.handle);
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (GLuint)index_buffer->common.handle);
+      setup_buffers(vertex_buffers, num_buffers, texture);
+   }
+   else {
+      setup_state(vtx, decl, texture);
    }
-
-   setup_state(vtx, decl, texture);
 
    switch (type) {
       case ALLEGRO_PRIM_LINE_LIST: {
@@ -564,6 +609,10 @@ static int draw_prim_indexed_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture
          break;
       };
    }
+   if (num_primitives > 0) {
+      disp->stats.draw_calls++;
+      disp->stats.vertices += num_vtx;
+   }
 
    revert_state(texture);
 
@@ -573,7 +622,7 @@ static int draw_prim_indexed_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture
    }
 
 #if defined ALLEGRO_IPHONE
-   al_free(iphone_idx);
+   al_rewind_frame_arena(mark);
 #endif
    
    return num_primitives;
@@ -581,10 +630,30 @@ static int draw_prim_indexed_raw(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture
 
 #endif /* ALLEGRO_CFG_OPENGL */
 
+int _al_draw_vertex_buffers_opengl(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture, ALLEGRO_VERTEX_BUFFER* const* vertex_buffers, int num_buffers, ALLEGRO_INDEX_BUFFER* index_buffer, int start, int end, int type)
+{
+#ifdef ALLEGRO_CFG_OPENGL
+   if (index_buffer)
+      return draw_prim_indexed_raw(target, texture, vertex_buffers, num_buffers, NULL, NULL, index_buffer, NULL, start, end, type);
+   return draw_prim_raw(target, texture, vertex_buffers, num_buffers, NULL, NULL, start, end, type);
+#else
+   (void)target;
+   (void)texture;
+   (void)vertex_buffers;
+   (void)num_buffers;
+   (void)index_buffer;
+   (void)start;
+   (void)end;
+   (void)type;
+
+   return 0;
+#endif
+}
+
 int _al_draw_prim_opengl(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture, const void* vtxs, const ALLEGRO_VERTEX_DECL* decl, int start, int end, int type)
 {
 #ifdef ALLEGRO_CFG_OPENGL
-   return draw_prim_raw(target, texture, 0, vtxs, decl, start, end, type);
+   return draw_prim_raw(target, texture, NULL, 0, vtxs, decl, start, end, type);
 #else
    (void)target;
    (void)texture;
@@ -601,7 +670,7 @@ int _al_draw_prim_opengl(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture, const
 int _al_draw_vertex_buffer_opengl(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture, ALLEGRO_VERTEX_BUFFER* vertex_buffer, int start, int end, int type)
 {
 #ifdef ALLEGRO_CFG_OPENGL
-   return draw_prim_raw(target, texture, vertex_buffer, 0, vertex_buffer->decl, start, end, type);
+   return draw_prim_raw(target, texture, &vertex_buffer, 1, NULL, NULL, start, end, type);
 #else
    (void)target;
    (void)texture;
@@ -617,7 +686,7 @@ int _al_draw_vertex_buffer_opengl(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* textur
 int _al_draw_prim_indexed_opengl(ALLEGRO_BITMAP *target, ALLEGRO_BITMAP* texture, const void* vtxs, const ALLEGRO_VERTEX_DECL* decl, const int* indices, int num_vtx, int type)
 {
 #ifdef ALLEGRO_CFG_OPENGL
-   return draw_prim_indexed_raw(target, texture, NULL, vtxs, decl, NULL, indices, 0, num_vtx, type);
+   return draw_prim_indexed_raw(target, texture, NULL, 0, vtxs, decl, NULL, indices, 0, num_vtx, type);
 #else
    (void)target;
    (void)texture;
@@ -634,7 +703,7 @@ int _al_draw_prim_indexed_opengl(ALLEGRO_BITMAP *target, ALLEGRO_BITMAP* texture
 int _al_draw_indexed_buffer_opengl(ALLEGRO_BITMAP* target, ALLEGRO_BITMAP* texture, ALLEGRO_VERTEX_BUFFER* vertex_buffer, ALLEGRO_INDEX_BUFFER* index_buffer, int start, int end, int type)
 {
 #ifdef ALLEGRO_CFG_OPENGL
-   return draw_prim_indexed_raw(target, texture, vertex_buffer, NULL, vertex_buffer->decl, index_buffer, NULL, start, end, type);
+   return draw_prim_indexed_raw(target, texture, &vertex_buffer, 1, NULL, NULL, index_buffer, NULL, start, end, type);
 #else
    (void)target;
    (void)texture;
@@ -809,3 +878,77 @@ void _al_unlock_index_buffer_opengl(ALLEGRO_INDEX_BUFFER* buf)
    (void)buf;
 #endif
 }
+
+#ifdef ALLEGRO_CFG_OPENGL
+static bool update_buffer_common(ALLEGRO_BUFFER_COMMON* common, GLenum type, int offset, int length, const void* data, int mode)
+{
+   glBindBuffer(type, (GLuint)common->handle);
+
+#if !defined ALLEGRO_CFG_OPENGLES && !defined ALLEGRO_MACOSX
+   if (mode != _AL_BUFFER_UPDATE_SYNC &&
+         al_get_opengl_extension_list()->ALLEGRO_GL_ARB_map_buffer_range) {
+      GLbitfield access = GL_MAP_WRITE_BIT;
+      void* ptr;
+
+      if (mode == _AL_BUFFER_UPDATE_DISCARD)
+         access |= GL_MAP_INVALIDATE_BUFFER_BIT;
+      else
+         access |= GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+
+      ptr = glMapBufferRange(type, offset, length, access);
+      if (ptr) {
+         memcpy(ptr, data, length);
+         glUnmapBuffer(type);
+         glBindBuffer(type, 0);
+         return glGetError() == 0;
+      }
+   }
+#endif
+
+   /* Orphan the old storage so that the driver need not wait for draws
+    * still using it.
+    */
+   if (mode == _AL_BUFFER_UPDATE_DISCARD) {
+      GLint size;
+      GLint usage;
+
+      glGetBufferParameteriv(type, GL_BUFFER_SIZE, &size);
+      glGetBufferParameteriv(type, GL_BUFFER_USAGE, &usage);
+      glBufferData(type, size, NULL, usage);
+   }
+   glBufferSubData(type, offset, length, data);
+   glBindBuffer(type, 0);
+
+   return glGetError() == 0;
+}
+#endif
+
+bool _al_update_vertex_buffer_opengl(ALLEGRO_VERTEX_BUFFER* buf, int offset, int length, const void* data, int mode)
+{
+#ifdef ALLEGRO_CFG_OPENGL
+   return update_buffer_common(&buf->common, GL_ARRAY_BUFFER, offset, length, data, mode);
+#else
+   (void)buf;
+   (void)offset;
+   (void)length;
+   (void)data;
+   (void)mode;
+
+   return false;
+#endif
+}
+
+bool _al_update_index_buffer_opengl(ALLEGRO_INDEX_BUFFER* buf, int offset, int length, const void* data, int mode)
+{
+#ifdef ALLEGRO_CFG_OPENGL
+   return update_buffer_common(&buf->common, GL_ELEMENT_ARRAY_BUFFER, offset, length, data, mode);
+#else
+   (void)buf;
+   (void)offset;
+   (void)length;
+   (void)data;
+   (void)mode;
+
+   return false;
+#endif
+}
@@ -0,0 +1,139 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Recording primitives into draw lists.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#define ALLEGRO_INTERNAL_UNSTABLE
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_primitives.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_display.h"
+#include "allegro5/internal/aintern_prim.h"
+#include "allegro5/internal/aintern_prim_soft.h"
+#include <string.h>
+
+ALLEGRO_DEBUG_CHANNEL("primitives")
+
+
+/* A primitive is recorded as its vertices, converted to ALLEGRO_VERTEX and
+ * transformed, so that replaying it is a single al_draw_prim or
+ * al_draw_indexed_prim call with the replay transformation.
+ */
+typedef struct RECORDED_PRIM
+{
+   ALLEGRO_BITMAP *texture;
+   int type;
+   int num_vtxs;
+   int num_indices;        /* 0 if not indexed */
+   ALLEGRO_VERTEX *vtxs;   /* follow the struct */
+   int *indices;           /* follow the vertices */
+} RECORDED_PRIM;
+
+
+static void replay_prim(ALLEGRO_DISPLAY *display, void *data)
+{
+   RECORDED_PRIM *rec = data;
+   (void)display;
+
+   if (rec->num_indices > 0) {
+      al_draw_indexed_prim(rec->vtxs, NULL, rec->texture, rec->indices,
+         rec->num_indices, rec->type);
+   }
+   else {
+      al_draw_prim(rec->vtxs, NULL, rec->texture, 0, rec->num_vtxs,
+         rec->type);
+   }
+}
+
+
+static void destroy_prim(void *data)
+{
+   al_free(data);
+}
+
+
+/* Records the vertices from start to start + count, or the count vertices
+ * given by indices, into the list.  Returns the number of primitives, as
+ * al_draw_prim would.
+ */
+int _al_prim_record(ALLEGRO_DRAW_LIST *list, const void *vtxs,
+   const ALLEGRO_VERTEX_DECL *decl, ALLEGRO_BITMAP *texture,
+   const int *indices, int start, int count, int type)
+{
+   int stride = decl ? decl->stride : (int)sizeof(ALLEGRO_VERTEX);
+   RECORDED_PRIM *rec;
+   int num_prims;
+   int num_indices;
+   int first, last;
+   int i;
+
+   num_prims = _al_prim_count_primitives(type, count, &num_indices);
+   if (num_prims == 0)
+      return 0;
+
+   /* Only the vertices the primitives use are kept. */
+   if (indices) {
+      first = last = indices[0];
+      for (i = 1; i < count; i++) {
+         if (indices[i] < first)
+            first = indices[i];
+         else if (indices[i] > last)
+            last = indices[i];
+      }
+   }
+   else {
+      first = start;
+      last = start + count - 1;
+   }
+
+   rec = al_malloc(sizeof(*rec) +
+      (last - first + 1) * sizeof(ALLEGRO_VERTEX) +
+      (indices ? count * sizeof(int) : 0));
+   if (!rec) {
+      ALLEGRO_ERROR("Out of memory recording %d vertices.\n",
+         last - first + 1);
+      return 0;
+   }
+
+   rec->texture = texture;
+   rec->type = type;
+   rec->num_vtxs = last - first + 1;
+   rec->num_indices = indices ? count : 0;
+   rec->vtxs = (ALLEGRO_VERTEX *)(rec + 1);
+   rec->indices = (int *)(rec->vtxs + rec->num_vtxs);
+
+   if (decl) {
+      for (i = 0; i < rec->num_vtxs; i++) {
+         _al_prim_convert_vtx(texture, (const char *)vtxs + (first + i) * stride,
+            &rec->vtxs[i], decl);
+      }
+   }
+   else {
+      memcpy(rec->vtxs, (const ALLEGRO_VERTEX *)vtxs + first,
+         rec->num_vtxs * sizeof(ALLEGRO_VERTEX));
+   }
+   al_transform_coordinates_3d_array(al_get_current_transform(),
+      &rec->vtxs[0].x, rec->num_vtxs, sizeof(ALLEGRO_VERTEX));
+
+   for (i = 0; i < rec->num_indices; i++)
+      rec->indices[i] = indices[i] - first;
+
+   _al_update_draw_recording_blender(list);
+   if (!_al_draw_list_add(list, replay_prim, destroy_prim, rec))
+      return 0;
+
+   return num_prims;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -16,6 +16,7 @@
  *      See readme.txt for copyright information.
  */
 
+#define ALLEGRO_INTERNAL_UNSTABLE
 
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern_bitmap.h"
@@ -25,13 +26,47 @@
 #include "allegro5/internal/aintern_prim_soft.h"
 #include "allegro5/internal/aintern_prim.h"
 #include "allegro5/internal/aintern_tri_soft.h"
+#include "allegro5/internal/aintern_workers.h"
 
 /*
 The vertex cache allows for bulk transformation of vertices, for faster run speeds
 */
 #define LOCAL_VERTEX_CACHE  ALLEGRO_VERTEX vertex_cache[ALLEGRO_VERTEX_CACHE_SIZE]
 
-static void convert_vtx(ALLEGRO_BITMAP* texture, const char* src, ALLEGRO_VERTEX* dest, const ALLEGRO_VERTEX_DECL* decl)
+/* Reads the first two components of a position or texture coordinate. */
+static void convert_pair(const char* src, int storage, float* a, float* b)
+{
+   switch(storage) {
+      case ALLEGRO_PRIM_FLOAT_2:
+      case ALLEGRO_PRIM_FLOAT_3:
+      {
+         float *ptr = (float*)src;
+         *a = *(ptr);
+         *b = *(ptr + 1);
+         break;
+      }
+      case ALLEGRO_PRIM_SHORT_2:
+      {
+         short *ptr = (short*)src;
+         *a = (float)*(ptr);
+         *b = (float)*(ptr + 1);
+         break;
+      }
+      case ALLEGRO_PRIM_HALF_FLOAT_2:
+      {
+         uint16_t *ptr = (uint16_t*)src;
+         *a = _al_prim_half_to_float(*(ptr));
+         *b = _al_prim_half_to_float(*(ptr + 1));
+         break;
+      }
+   }
+}
+
+/*
+Converts the attributes present in the declaration, leaving the others of dest
+alone. With a NULL declaration the whole vertex is copied.
+*/
+void _al_prim_convert_vtx_attribs(ALLEGRO_BITMAP* texture, const char* src, ALLEGRO_VERTEX* dest, const ALLEGRO_VERTEX_DECL* decl)
 {
    ALLEGRO_VERTEX_ELEMENT* e;
    if(!decl) {
@@ -40,64 +75,142 @@ static void convert_vtx(ALLEGRO_BITMAP* texture, const char* src, ALLEGRO_VERTEX
    }
    e = &decl->elements[ALLEGRO_PRIM_POSITION];
    if(e->attribute) {
-      switch(e->storage) {
-         case ALLEGRO_PRIM_FLOAT_2:
-         case ALLEGRO_PRIM_FLOAT_3:
-         {
-            float *ptr = (float*)(src + e->offset);
-            dest->x = *(ptr);
-            dest->y = *(ptr + 1);
-            break;
-         }
-         case ALLEGRO_PRIM_SHORT_2:
-         {
-            short *ptr = (short*)(src + e->offset);
-            dest->x = (float)*(ptr);
-            dest->y = (float)*(ptr + 1);
-            break;
-         }
-      }
-   } else {
-      dest->x = 0;
-      dest->y = 0;
+      convert_pair(src + e->offset, e->storage, &dest->x, &dest->y);
    }
 
    e = &decl->elements[ALLEGRO_PRIM_TEX_COORD];
    if(!e->attribute)
       e = &decl->elements[ALLEGRO_PRIM_TEX_COORD_PIXEL];
    if(e->attribute) {
-      switch(e->storage) {
-         case ALLEGRO_PRIM_FLOAT_2:
-         case ALLEGRO_PRIM_FLOAT_3:
-         {
-            float *ptr = (float*)(src + e->offset);
-            dest->u = *(ptr);
-            dest->v = *(ptr + 1);
-            break;
-         }
-         case ALLEGRO_PRIM_SHORT_2:
-         {
-            short *ptr = (short*)(src + e->offset);
-            dest->u = (float)*(ptr);
-            dest->v = (float)*(ptr + 1);
-            break;
-         }
-      }
+      convert_pair(src + e->offset, e->storage, &dest->u, &dest->v);
       if(texture && e->attribute == ALLEGRO_PRIM_TEX_COORD) {
          dest->u *= (float)al_get_bitmap_width(texture);
          dest->v *= (float)al_get_bitmap_height(texture);
       }
-   } else {
-      dest->u = 0;
-      dest->v = 0;
    }
 
    e = &decl->elements[ALLEGRO_PRIM_COLOR_ATTR];
    if(e->attribute) {
-      dest->color = *(ALLEGRO_COLOR*)(src + e->offset);
-   } else {
+      if(e->storage == ALLEGRO_PRIM_NORMALIZED_UBYTE_4) {
+         const unsigned char *ptr = (const unsigned char*)(src + e->offset);
+         dest->color = al_map_rgba(ptr[0], ptr[1], ptr[2], ptr[3]);
+      } else {
+         dest->color = *(ALLEGRO_COLOR*)(src + e->offset);
+      }
+   }
+}
+
+void _al_prim_convert_vtx(ALLEGRO_BITMAP* texture, const char* src, ALLEGRO_VERTEX* dest, const ALLEGRO_VERTEX_DECL* decl)
+{
+   if(decl) {
+      dest->x = 0;
+      dest->y = 0;
+      dest->u = 0;
+      dest->v = 0;
       dest->color = al_map_rgba_f(1,1,1,1);
    }
+   _al_prim_convert_vtx_attribs(texture, src, dest, decl);
+}
+
+/*
+Triangles going to a memory bitmap are converted and handed over all at once,
+so that _al_draw_soft_triangles can split them over the worker threads. The
+triangles get their vertices in the order the one-by-one paths below would
+pass them, cached or not, so the pixels come out the same either way. Returns
+the number of primitives drawn, or 0 if they should be drawn one by one.
+*/
+static int draw_soft_triangles(ALLEGRO_BITMAP* texture, const void* vtxs, const ALLEGRO_VERTEX_DECL* decl,
+   const int* indices, int start, int num_vtx, int type, int use_cache)
+{
+   ALLEGRO_VERTEX* converted;
+   int* list;
+   int num_primitives;
+   int num_indices;
+   int ii, k;
+   size_t mark;
+   int stride = decl ? decl->stride : (int)sizeof(ALLEGRO_VERTEX);
+   const ALLEGRO_TRANSFORM* global_trans = al_get_current_transform();
+
+   if (type != ALLEGRO_PRIM_TRIANGLE_LIST && type != ALLEGRO_PRIM_TRIANGLE_STRIP &&
+         type != ALLEGRO_PRIM_TRIANGLE_FAN)
+      return 0;
+   if (!(al_get_bitmap_flags(al_get_target_bitmap()) & ALLEGRO_MEMORY_BITMAP) ||
+         _al_get_worker_count() < 2)
+      return 0;
+
+   num_primitives = _al_prim_count_primitives(type, num_vtx, &num_indices);
+   if (num_primitives == 0)
+      return 0;
+
+   mark = al_get_frame_arena_mark();
+   converted = al_frame_alloc(num_vtx * sizeof(ALLEGRO_VERTEX));
+   /* Fans may start with an extra, degenerate triangle. */
+   list = al_frame_alloc((num_indices + 3) * sizeof(int));
+   if (!converted || !list) {
+      al_rewind_frame_arena(mark);
+      return 0;
+   }
+
+   for (ii = 0; ii < num_vtx; ii++) {
+      int idx = indices ? indices[ii] : start + ii;
+      _al_prim_convert_vtx(texture, (const char*)vtxs + idx * stride, &converted[ii], decl);
+   }
+   al_transform_coordinates_array(global_trans, &converted[0].x, num_vtx,
+      sizeof(ALLEGRO_VERTEX));
+
+   k = 0;
+   switch (type) {
+      case ALLEGRO_PRIM_TRIANGLE_LIST: {
+         for (ii = 0; ii < num_indices; ii++)
+            list[k++] = ii;
+         break;
+      };
+      case ALLEGRO_PRIM_TRIANGLE_STRIP: {
+         for (ii = 2; ii < num_vtx; ii++) {
+            if (use_cache) {
+               list[k++] = ii - 2;
+               list[k++] = ii - 1;
+               list[k++] = ii;
+            } else {
+               /* Vertex ii sits in slot ii % 3. */
+               list[k++] = ii - ii % 3;
+               list[k++] = ii - (ii + 2) % 3;
+               list[k++] = ii - (ii + 1) % 3;
+            }
+         }
+         break;
+      };
+      case ALLEGRO_PRIM_TRIANGLE_FAN: {
+         if (use_cache) {
+            for (ii = 1; ii < num_vtx; ii++) {
+               list[k++] = 0;
+               list[k++] = ii;
+               list[k++] = ii - 1;
+            }
+         } else {
+            /* Odd vertices sit in slot 0 if indexed, in slot 1 if not. */
+            int odd_first = indices ? 1 : 0;
+            if (!indices) {
+               list[k++] = 0;
+               list[k++] = 1;
+               list[k++] = 1;
+            }
+            for (ii = 2; ii < num_vtx; ii++) {
+               int odd = (ii & 1) ? ii : ii - 1;
+               int even = (ii & 1) ? ii - 1 : ii;
+               list[k++] = 0;
+               list[k++] = odd_first ? odd : even;
+               list[k++] = odd_first ? even : odd;
+            }
+         }
+         break;
+      };
+   }
+
+   _al_draw_soft_triangles(texture, converted, list, k / 3);
+
+   al_rewind_frame_arena(mark);
+   return num_primitives;
 }
 
 int _al_draw_prim_soft(ALLEGRO_BITMAP* texture, const void* vtxs, const ALLEGRO_VERTEX_DECL* decl, int start, int end, int type)
@@ -115,21 +228,29 @@ int _al_draw_prim_soft(ALLEGRO_BITMAP* texture, const void* vtxs, const ALLEGRO_
 
    if (texture)
       al_lock_bitmap(texture, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY);
+
+   num_primitives = draw_soft_triangles(texture, vtxs, decl, NULL, start, num_vtx, type, use_cache);
+   if (num_primitives > 0) {
+      if (texture)
+         al_unlock_bitmap(texture);
+      return num_primitives;
+   }
       
    if (use_cache) {
       int ii;
       int n = 0;
       const char* vtxptr = (const char*)vtxs + start * stride;
       for (ii = 0; ii < num_vtx; ii++) {
-         convert_vtx(texture, vtxptr, &vertex_cache[ii], decl);
-         al_transform_coordinates(global_trans, &vertex_cache[ii].x, &vertex_cache[ii].y);
+         _al_prim_convert_vtx(texture, vtxptr, &vertex_cache[ii], decl);
          n++;
          vtxptr += stride;
       }
+      al_transform_coordinates_array(global_trans, &vertex_cache[0].x, num_vtx,
+         sizeof(ALLEGRO_VERTEX));
    }
    
 #define SET_VERTEX(v, idx)                                             \
-   convert_vtx(texture, (const char*)vtxs + stride * (idx), &v, decl); \
+   _al_prim_convert_vtx(texture, (const char*)vtxs + stride * (idx), &v, decl); \
    al_transform_coordinates(global_trans, &v.x, &v.y);            \
     
    switch (type) {
@@ -318,18 +439,25 @@ int _al_draw_prim_indexed_soft(ALLEGRO_BITMAP* texture, const void* vtxs, const
 
    if (texture)
       al_lock_bitmap(texture, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY);
+
+   num_primitives = draw_soft_triangles(texture, vtxs, decl, indices, 0, num_vtx, type, use_cache);
+   if (num_primitives > 0) {
+      if (texture)
+         al_unlock_bitmap(texture);
+      return num_primitives;
+   }
       
    if (use_cache) {
       int ii;
       for (ii = 0; ii < num_vtx; ii++) {
          int idx = indices[ii];
-         convert_vtx(texture, (const char*)vtxs + idx * stride, &vertex_cache[idx - min_idx], decl);
+         _al_prim_convert_vtx(texture, (const char*)vtxs + idx * stride, &vertex_cache[idx - min_idx], decl);
          al_transform_coordinates(global_trans, &vertex_cache[idx - min_idx].x, &vertex_cache[idx - min_idx].y);
       }
    }
    
 #define SET_VERTEX(v, idx)                                             \
-   convert_vtx(texture, (const char*)vtxs + stride * (idx), &v, decl); \
+   _al_prim_convert_vtx(texture, (const char*)vtxs + stride * (idx), &v, decl); \
    al_transform_coordinates(global_trans, &v.x, &v.y);            \
     
    switch (type) {
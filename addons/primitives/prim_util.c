@@ -40,6 +40,26 @@ float _al_prim_get_scale(void)
 }
 
 
+/*
+ * Converts an IEEE 754 half precision float to a float.
+ */
+float _al_prim_half_to_float(uint16_t half)
+{
+   int exponent = (half >> 10) & 0x1f;
+   int mantissa = half & 0x3ff;
+   float value;
+
+   if (exponent == 0)
+      value = ldexpf((float)mantissa, -24);
+   else if (exponent == 31)
+      value = mantissa ? NAN : INFINITY;
+   else
+      value = ldexpf((float)(mantissa | 0x400), exponent - 25);
+
+   return (half & 0x8000) ? -value : value;
+}
+
+
 /*
  * Normalizes vector.
  */
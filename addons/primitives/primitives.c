@@ -16,11 +16,14 @@
  *      See readme.txt for copyright information.
  */
 
+#define ALLEGRO_INTERNAL_UNSTABLE
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_primitives.h"
 #include "allegro5/platform/alplatf.h"
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_pixels.h"
 #include "allegro5/internal/aintern_prim.h"
@@ -28,6 +31,7 @@
 #include "allegro5/internal/aintern_prim_opengl.h"
 #include "allegro5/internal/aintern_prim_soft.h"
 #include <math.h>
+#include <string.h>
 
 #ifdef ALLEGRO_CFG_OPENGL
 #include "allegro5/allegro_opengl.h"
@@ -49,6 +53,7 @@ bool al_init_primitives_addon(void)
    ret &= _al_init_d3d_driver();
    
    addon_initialized = ret;
+   _al_prim_init_arc_cache();
    
    _al_add_exit_func(al_shutdown_primitives_addon, "primitives_shutdown");
    
@@ -66,16 +71,60 @@ bool al_is_primitives_addon_initialized(void)
  */
 void al_shutdown_primitives_addon(void)
 {
+   _al_prim_free_batch();
+   _al_prim_free_arc_cache();
+   _al_prim_free_stroke_shader();
    _al_shutdown_d3d_driver();
    addon_initialized = false;
 }
 
+/* Brings an evicted texture back into video memory and keeps it from
+ * being evicted this frame, see al_set_display_texture_budget.
+ */
+static void use_texture(ALLEGRO_BITMAP *texture)
+{
+   if (texture)
+      _al_mark_bitmap_used(texture,
+         _al_get_bitmap_display(al_get_target_bitmap()));
+}
+
+/* Adds the bounding box of the vertices to the damage of the target, see
+ * al_set_bitmap_damage_tracking. Vertices with a custom declaration damage
+ * the whole clipping rectangle.
+ */
+static void damage_vertices(const void *vtxs, const ALLEGRO_VERTEX_DECL *decl,
+   const int *indices, int start, int count)
+{
+   ALLEGRO_BITMAP *target = al_get_target_bitmap();
+   const ALLEGRO_VERTEX *v = vtxs;
+   float x1, y1, x2, y2;
+   int i;
+
+   if (decl) {
+      _al_damage_clipping_rectangle(target);
+      return;
+   }
+
+   i = indices ? indices[0] : start;
+   x1 = x2 = v[i].x;
+   y1 = y2 = v[i].y;
+   for (i = 1; i < count; i++) {
+      const ALLEGRO_VERTEX *p = &v[indices ? indices[i] : start + i];
+      x1 = _ALLEGRO_MIN(x1, p->x);
+      y1 = _ALLEGRO_MIN(y1, p->y);
+      x2 = _ALLEGRO_MAX(x2, p->x);
+      y2 = _ALLEGRO_MAX(y2, p->y);
+   }
+   _al_damage_target(target, al_get_current_transform(), x1, y1, x2, y2);
+}
+
 /* Function: al_draw_prim
  */
 int al_draw_prim(const void* vtxs, const ALLEGRO_VERTEX_DECL* decl,
    ALLEGRO_BITMAP* texture, int start, int end, int type)
 {  
    ALLEGRO_BITMAP *target;
+   ALLEGRO_DRAW_LIST *recording;
    int ret = 0;
  
    ASSERT(addon_initialized);
@@ -84,6 +133,19 @@ int al_draw_prim(const void* vtxs, const ALLEGRO_VERTEX_DECL* decl,
    ASSERT(start >= 0);
    ASSERT(type >= 0 && type < ALLEGRO_PRIM_NUM_TYPES);
 
+   recording = _al_get_draw_recording(al_get_current_display());
+   if (recording)
+      return _al_prim_record(recording, vtxs, decl, texture, NULL, start,
+         end - start, type);
+
+   use_texture(texture);
+
+   if (end > start && _AL_TRACKS_DAMAGE(al_get_target_bitmap()))
+      damage_vertices(vtxs, decl, NULL, start, end - start);
+
+   if (!decl && al_is_primitive_drawing_held())
+      return _al_prim_batch_add(vtxs, texture, NULL, start, end - start, type);
+
    target = al_get_target_bitmap();
 
    /* In theory, if we ever get a camera concept for this addon, the transformation into
@@ -112,6 +174,7 @@ int al_draw_indexed_prim(const void* vtxs, const ALLEGRO_VERTEX_DECL* decl,
    ALLEGRO_BITMAP* texture, const int* indices, int num_vtx, int type)
 {
    ALLEGRO_BITMAP *target;
+   ALLEGRO_DRAW_LIST *recording;
    int ret = 0;
  
    ASSERT(addon_initialized);
@@ -120,6 +183,19 @@ int al_draw_indexed_prim(const void* vtxs, const ALLEGRO_VERTEX_DECL* decl,
    ASSERT(num_vtx > 0);
    ASSERT(type >= 0 && type < ALLEGRO_PRIM_NUM_TYPES);
 
+   recording = _al_get_draw_recording(al_get_current_display());
+   if (recording)
+      return _al_prim_record(recording, vtxs, decl, texture, indices, 0,
+         num_vtx, type);
+
+   use_texture(texture);
+
+   if (_AL_TRACKS_DAMAGE(al_get_target_bitmap()))
+      damage_vertices(vtxs, decl, indices, 0, num_vtx);
+
+   if (!decl && al_is_primitive_drawing_held())
+      return _al_prim_batch_add(vtxs, texture, indices, 0, num_vtx, type);
+
    target = al_get_target_bitmap();
    
    /* In theory, if we ever get a camera concept for this addon, the transformation into
@@ -146,6 +222,12 @@ int _al_bitmap_region_is_locked(ALLEGRO_BITMAP* bmp, int x1, int y1, int w, int
 {
    ASSERT(bmp);
    
+   /* The locked region is in the coordinates of the parent. */
+   if (bmp->parent) {
+      x1 += bmp->xofs;
+      y1 += bmp->yofs;
+      bmp = _AL_LOCK_HOLDER(bmp);
+   }
    if (!al_is_bitmap_locked(bmp))
       return 0;
    if (x1 + w > bmp->lock_x && y1 + h > bmp->lock_y && x1 < bmp->lock_x + bmp->lock_w && y1 < bmp->lock_y + bmp->lock_h)
@@ -189,7 +271,8 @@ ALLEGRO_VERTEX_DECL* al_create_vertex_decl(const ALLEGRO_VERTEX_ELEMENT* element
    if (e->attribute) {
       if (e->storage != ALLEGRO_PRIM_FLOAT_2 &&
           e->storage != ALLEGRO_PRIM_FLOAT_3 &&
-          e->storage != ALLEGRO_PRIM_SHORT_2) {
+          e->storage != ALLEGRO_PRIM_SHORT_2 &&
+          e->storage != ALLEGRO_PRIM_HALF_FLOAT_2) {
          ALLEGRO_WARN("Invalid storage for ALLEGRO_PRIM_POSITION.\n");
          goto fail;
       }
@@ -200,14 +283,15 @@ ALLEGRO_VERTEX_DECL* al_create_vertex_decl(const ALLEGRO_VERTEX_ELEMENT* element
       e = &ret->elements[ALLEGRO_PRIM_TEX_COORD_PIXEL];
    if (e->attribute) {
       if (e->storage != ALLEGRO_PRIM_FLOAT_2 &&
-          e->storage != ALLEGRO_PRIM_SHORT_2) {
+          e->storage != ALLEGRO_PRIM_SHORT_2 &&
+          e->storage != ALLEGRO_PRIM_HALF_FLOAT_2) {
          ALLEGRO_WARN("Invalid storage for %s.\n", ret->elements[ALLEGRO_PRIM_TEX_COORD].attribute ? "ALLEGRO_PRIM_TEX_COORD" : "ALLEGRO_PRIM_TEX_COORD_PIXEL");
          goto fail;
       }
    }
 
    display = al_get_current_display();
-   flags = al_get_display_flags(display);
+   flags = display ? al_get_display_flags(display) : 0;
    if (flags & ALLEGRO_DIRECT3D) {
       _al_set_d3d_decl(display, ret);
    }
@@ -461,6 +545,129 @@ void al_unlock_index_buffer(ALLEGRO_INDEX_BUFFER* buffer)
    }
 }
 
+static bool update_vertex_buffer(ALLEGRO_VERTEX_BUFFER* buffer, int offset,
+   const void* data, int length, int mode)
+{
+   int flags = al_get_display_flags(al_get_current_display());
+   int stride = buffer->decl ? buffer->decl->stride : (int)sizeof(ALLEGRO_VERTEX);
+
+   if (flags & ALLEGRO_OPENGL) {
+      return _al_update_vertex_buffer_opengl(buffer, offset * stride,
+         length * stride, data, mode);
+   }
+   else if (flags & ALLEGRO_DIRECT3D) {
+      return _al_update_vertex_buffer_directx(buffer, offset * stride,
+         length * stride, data, mode);
+   }
+   return false;
+}
+
+static bool update_index_buffer(ALLEGRO_INDEX_BUFFER* buffer, int offset,
+   const void* data, int length, int mode)
+{
+   int flags = al_get_display_flags(al_get_current_display());
+   int size = buffer->index_size;
+
+   if (flags & ALLEGRO_OPENGL) {
+      return _al_update_index_buffer_opengl(buffer, offset * size,
+         length * size, data, mode);
+   }
+   else if (flags & ALLEGRO_DIRECT3D) {
+      return _al_update_index_buffer_directx(buffer, offset * size,
+         length * size, data, mode);
+   }
+   return false;
+}
+
+/* Returns where length elements should be appended, and how. */
+static int append_pos(ALLEGRO_BUFFER_COMMON* common, int length, int* mode)
+{
+   if (common->append_pos == 0 || common->append_pos + length > common->size) {
+      *mode = _AL_BUFFER_UPDATE_DISCARD;
+      return 0;
+   }
+   *mode = _AL_BUFFER_UPDATE_NO_OVERWRITE;
+   return common->append_pos;
+}
+
+/* Function: al_update_vertex_buffer
+ */
+bool al_update_vertex_buffer(ALLEGRO_VERTEX_BUFFER* buffer, int offset,
+   const void* data, int length)
+{
+   ASSERT(buffer);
+   ASSERT(data);
+   ASSERT(addon_initialized);
+
+   if (offset < 0 || length <= 0 || offset + length > buffer->common.size ||
+         buffer->common.is_locked)
+      return false;
+
+   return update_vertex_buffer(buffer, offset, data, length,
+      _AL_BUFFER_UPDATE_SYNC);
+}
+
+/* Function: al_update_index_buffer
+ */
+bool al_update_index_buffer(ALLEGRO_INDEX_BUFFER* buffer, int offset,
+   const void* data, int length)
+{
+   ASSERT(buffer);
+   ASSERT(data);
+   ASSERT(addon_initialized);
+
+   if (offset < 0 || length <= 0 || offset + length > buffer->common.size ||
+         buffer->common.is_locked)
+      return false;
+
+   return update_index_buffer(buffer, offset, data, length,
+      _AL_BUFFER_UPDATE_SYNC);
+}
+
+/* Function: al_append_vertex_buffer
+ */
+int al_append_vertex_buffer(ALLEGRO_VERTEX_BUFFER* buffer, const void* data,
+   int length)
+{
+   int offset;
+   int mode;
+   ASSERT(buffer);
+   ASSERT(data);
+   ASSERT(addon_initialized);
+
+   if (length <= 0 || length > buffer->common.size || buffer->common.is_locked)
+      return -1;
+
+   offset = append_pos(&buffer->common, length, &mode);
+   if (!update_vertex_buffer(buffer, offset, data, length, mode))
+      return -1;
+
+   buffer->common.append_pos = offset + length;
+   return offset;
+}
+
+/* Function: al_append_index_buffer
+ */
+int al_append_index_buffer(ALLEGRO_INDEX_BUFFER* buffer, const void* data,
+   int length)
+{
+   int offset;
+   int mode;
+   ASSERT(buffer);
+   ASSERT(data);
+   ASSERT(addon_initialized);
+
+   if (length <= 0 || length > buffer->common.size || buffer->common.is_locked)
+      return -1;
+
+   offset = append_pos(&buffer->common, length, &mode);
+   if (!update_index_buffer(buffer, offset, data, length, mode))
+      return -1;
+
+   buffer->common.append_pos = offset + length;
+   return offset;
+}
+
 /* Software fallback for buffer drawing */
 int _al_draw_buffer_common_soft(ALLEGRO_VERTEX_BUFFER* vertex_buffer, ALLEGRO_BITMAP* texture, ALLEGRO_INDEX_BUFFER* index_buffer, int start, int end, int type)
 {
@@ -478,14 +685,20 @@ int _al_draw_buffer_common_soft(ALLEGRO_VERTEX_BUFFER* vertex_buffer, ALLEGRO_BI
 
    if (index_buffer) {
       void* idx;
-      int* int_idx = NULL;
+      int* int_idx;
+      size_t mark = al_get_frame_arena_mark();
       int ii;
 
       idx = al_lock_index_buffer(index_buffer, start, num_vtx, ALLEGRO_LOCK_READONLY);
       ASSERT(idx);
 
       if (index_buffer->index_size != 4) {
-         int_idx = al_malloc(num_vtx * sizeof(int));
+         int_idx = al_frame_alloc(num_vtx * sizeof(int));
+         if (!int_idx) {
+            al_unlock_index_buffer(index_buffer);
+            al_unlock_vertex_buffer(vertex_buffer);
+            return 0;
+         }
          for (ii = 0; ii < num_vtx; ii++) {
             int_idx[ii] = ((unsigned short*)idx)[ii];
          }
@@ -495,7 +708,7 @@ int _al_draw_buffer_common_soft(ALLEGRO_VERTEX_BUFFER* vertex_buffer, ALLEGRO_BI
       num_primitives = _al_draw_prim_indexed_soft(texture, vtx, vertex_buffer->decl, idx, num_vtx, type);
 
       al_unlock_index_buffer(index_buffer);
-      al_free(int_idx);
+      al_rewind_frame_arena(mark);
    }
    else {
       num_primitives = _al_draw_prim_soft(texture, vtx, vertex_buffer->decl, 0, num_vtx, type);
@@ -505,6 +718,132 @@ int _al_draw_buffer_common_soft(ALLEGRO_VERTEX_BUFFER* vertex_buffer, ALLEGRO_BI
    return num_primitives;
 }
 
+/* Converts count vertices from first on, taking each attribute from the last
+ * buffer that has it. Returns NULL if some buffer cannot be read. The
+ * vertices are in the frame arena.
+ */
+static ALLEGRO_VERTEX* merge_vertex_buffers(ALLEGRO_VERTEX_BUFFER* const* vertex_buffers,
+   int num_buffers, ALLEGRO_BITMAP* texture, int first, int count)
+{
+   ALLEGRO_VERTEX* vtxs;
+   int ii, jj;
+
+   for (ii = 0; ii < num_buffers; ii++) {
+      if (vertex_buffers[ii]->common.write_only)
+         return NULL;
+   }
+
+   vtxs = al_frame_alloc(count * sizeof(ALLEGRO_VERTEX));
+   if (!vtxs)
+      return NULL;
+   memset(vtxs, 0, count * sizeof(ALLEGRO_VERTEX));
+   for (jj = 0; jj < count; jj++) {
+      vtxs[jj].color = al_map_rgba_f(1, 1, 1, 1);
+   }
+
+   for (ii = 0; ii < num_buffers; ii++) {
+      ALLEGRO_VERTEX_BUFFER* vertex_buffer = vertex_buffers[ii];
+      int stride = vertex_buffer->decl ? vertex_buffer->decl->stride : (int)sizeof(ALLEGRO_VERTEX);
+      const char* src = al_lock_vertex_buffer(vertex_buffer, first, count, ALLEGRO_LOCK_READONLY);
+
+      if (!src)
+         return NULL;
+      for (jj = 0; jj < count; jj++) {
+         _al_prim_convert_vtx_attribs(texture, src + jj * stride, &vtxs[jj], vertex_buffer->decl);
+      }
+      al_unlock_vertex_buffer(vertex_buffer);
+   }
+
+   return vtxs;
+}
+
+/* Returns the indices from start to end as ints in the frame arena, or
+ * NULL.
+ */
+static int* read_index_buffer(ALLEGRO_INDEX_BUFFER* index_buffer, int start, int end)
+{
+   int num_idx = end - start;
+   const void* idx;
+   int* int_idx;
+   int ii;
+
+   if (index_buffer->common.write_only)
+      return NULL;
+
+   int_idx = al_frame_alloc(num_idx * sizeof(int));
+   if (!int_idx)
+      return NULL;
+
+   idx = al_lock_index_buffer(index_buffer, start, num_idx, ALLEGRO_LOCK_READONLY);
+   if (!idx)
+      return NULL;
+   for (ii = 0; ii < num_idx; ii++) {
+      int_idx[ii] = index_buffer->index_size == 4 ? ((const int*)idx)[ii] : ((const unsigned short*)idx)[ii];
+   }
+   al_unlock_index_buffer(index_buffer);
+
+   return int_idx;
+}
+
+/* Draws several vertex buffers by merging them on the CPU, either in
+ * software or, with use_display, as a regular vertex array.
+ */
+static int draw_merged_buffers(ALLEGRO_VERTEX_BUFFER* const* vertex_buffers, int num_buffers,
+   ALLEGRO_BITMAP* texture, ALLEGRO_INDEX_BUFFER* index_buffer, int start, int end, int type,
+   bool use_display)
+{
+   ALLEGRO_VERTEX* vtxs;
+   int num_primitives = 0;
+   int first = index_buffer ? 0 : start;
+   int count = end - start;
+   size_t mark;
+   int ii;
+
+   if (index_buffer) {
+      count = al_get_vertex_buffer_size(vertex_buffers[0]);
+      for (ii = 1; ii < num_buffers; ii++) {
+         if (al_get_vertex_buffer_size(vertex_buffers[ii]) < count)
+            count = al_get_vertex_buffer_size(vertex_buffers[ii]);
+      }
+   }
+   if (count <= 0)
+      return 0;
+
+   mark = al_get_frame_arena_mark();
+   vtxs = merge_vertex_buffers(vertex_buffers, num_buffers, texture, first, count);
+   if (!vtxs) {
+      al_rewind_frame_arena(mark);
+      return 0;
+   }
+
+   if (index_buffer) {
+      int* idx = read_index_buffer(index_buffer, start, end);
+      if (idx) {
+         if (use_display)
+            num_primitives = al_draw_indexed_prim(vtxs, NULL, texture, idx, end - start, type);
+         else
+            num_primitives = _al_draw_prim_indexed_soft(texture, vtxs, NULL, idx, end - start, type);
+      }
+   }
+   else {
+      if (use_display)
+         num_primitives = al_draw_prim(vtxs, NULL, texture, 0, count, type);
+      else
+         num_primitives = _al_draw_prim_soft(texture, vtxs, NULL, 0, count, type);
+   }
+
+   al_rewind_frame_arena(mark);
+   return num_primitives;
+}
+
+/* Software fallback for drawing several buffers */
+int _al_draw_buffers_common_soft(ALLEGRO_VERTEX_BUFFER* const* vertex_buffers, int num_buffers, ALLEGRO_BITMAP* texture, ALLEGRO_INDEX_BUFFER* index_buffer, int start, int end, int type)
+{
+   if (num_buffers == 1)
+      return _al_draw_buffer_common_soft(vertex_buffers[0], texture, index_buffer, start, end, type);
+   return draw_merged_buffers(vertex_buffers, num_buffers, texture, index_buffer, start, end, type, false);
+}
+
 /* Function: al_draw_vertex_buffer
  */
 int al_draw_vertex_buffer(ALLEGRO_VERTEX_BUFFER* vertex_buffer,
@@ -521,7 +860,13 @@ int al_draw_vertex_buffer(ALLEGRO_VERTEX_BUFFER* vertex_buffer,
    ASSERT(vertex_buffer);
    ASSERT(!vertex_buffer->common.is_locked);
 
+   /* Keep the order with held primitives. */
+   _al_prim_flush_batch();
+   use_texture(texture);
+
    target = al_get_target_bitmap();
+   if (_AL_TRACKS_DAMAGE(target))
+      _al_damage_clipping_rectangle(target);
 
    if (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP ||
        (texture && al_get_bitmap_flags(texture) & ALLEGRO_MEMORY_BITMAP) ||
@@ -559,7 +904,12 @@ int al_draw_indexed_buffer(ALLEGRO_VERTEX_BUFFER* vertex_buffer,
    ASSERT(index_buffer);
    ASSERT(!index_buffer->common.is_locked);
 
+   _al_prim_flush_batch();
+   use_texture(texture);
+
    target = al_get_target_bitmap();
+   if (_AL_TRACKS_DAMAGE(target))
+      _al_damage_clipping_rectangle(target);
 
    if (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP ||
        (texture && al_get_bitmap_flags(texture) & ALLEGRO_MEMORY_BITMAP) ||
@@ -578,6 +928,87 @@ int al_draw_indexed_buffer(ALLEGRO_VERTEX_BUFFER* vertex_buffer,
    return ret;
 }
 
+static int draw_vertex_buffers(ALLEGRO_VERTEX_BUFFER* const* vertex_buffers,
+   int num_buffers, ALLEGRO_BITMAP* texture, ALLEGRO_INDEX_BUFFER* index_buffer,
+   int start, int end, int type)
+{
+   ALLEGRO_BITMAP *target;
+   int flags;
+
+   _al_prim_flush_batch();
+   use_texture(texture);
+
+   target = al_get_target_bitmap();
+   if (_AL_TRACKS_DAMAGE(target))
+      _al_damage_clipping_rectangle(target);
+   flags = al_get_display_flags(al_get_current_display());
+
+   if (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP ||
+       (texture && al_get_bitmap_flags(texture) & ALLEGRO_MEMORY_BITMAP) ||
+       _al_pixel_format_is_compressed(al_get_bitmap_format(target))) {
+      return _al_draw_buffers_common_soft(vertex_buffers, num_buffers, texture, index_buffer, start, end, type);
+   }
+   else if (flags & ALLEGRO_OPENGL) {
+      return _al_draw_vertex_buffers_opengl(target, texture, vertex_buffers, num_buffers, index_buffer, start, end, type);
+   }
+   else {
+      return draw_merged_buffers(vertex_buffers, num_buffers, texture, index_buffer, start, end, type, true);
+   }
+}
+
+/* Function: al_draw_vertex_buffers
+ */
+int al_draw_vertex_buffers(ALLEGRO_VERTEX_BUFFER* const* vertex_buffers,
+   int num_buffers, ALLEGRO_BITMAP* texture, int start, int end, int type)
+{
+   int ii;
+
+   ASSERT(addon_initialized);
+   ASSERT(vertex_buffers);
+   ASSERT(num_buffers > 0);
+   ASSERT(end >= start);
+   ASSERT(start >= 0);
+   ASSERT(type >= 0 && type < ALLEGRO_PRIM_NUM_TYPES);
+   for (ii = 0; ii < num_buffers; ii++) {
+      ASSERT(vertex_buffers[ii]);
+      ASSERT(!vertex_buffers[ii]->common.is_locked);
+      ASSERT(end <= al_get_vertex_buffer_size(vertex_buffers[ii]));
+   }
+
+   if (num_buffers == 1)
+      return al_draw_vertex_buffer(vertex_buffers[0], texture, start, end, type);
+
+   return draw_vertex_buffers(vertex_buffers, num_buffers, texture, NULL, start, end, type);
+}
+
+/* Function: al_draw_indexed_vertex_buffers
+ */
+int al_draw_indexed_vertex_buffers(ALLEGRO_VERTEX_BUFFER* const* vertex_buffers,
+   int num_buffers, ALLEGRO_BITMAP* texture, ALLEGRO_INDEX_BUFFER* index_buffer,
+   int start, int end, int type)
+{
+   int ii;
+
+   ASSERT(addon_initialized);
+   ASSERT(vertex_buffers);
+   ASSERT(num_buffers > 0);
+   ASSERT(end >= start);
+   ASSERT(start >= 0);
+   ASSERT(end <= al_get_index_buffer_size(index_buffer));
+   ASSERT(type >= 0 && type < ALLEGRO_PRIM_NUM_TYPES);
+   ASSERT(index_buffer);
+   ASSERT(!index_buffer->common.is_locked);
+   for (ii = 0; ii < num_buffers; ii++) {
+      ASSERT(vertex_buffers[ii]);
+      ASSERT(!vertex_buffers[ii]->common.is_locked);
+   }
+
+   if (num_buffers == 1)
+      return al_draw_indexed_buffer(vertex_buffers[0], texture, index_buffer, start, end, type);
+
+   return draw_vertex_buffers(vertex_buffers, num_buffers, texture, index_buffer, start, end, type);
+}
+
 /* Function: al_get_vertex_buffer_size
  */
 int al_get_vertex_buffer_size(ALLEGRO_VERTEX_BUFFER* buffer)
@@ -16,6 +16,7 @@
  *      See readme.txt for copyright information.
  */
 
+#define ALLEGRO_INTERNAL_UNSTABLE
 
 # include "allegro5/allegro.h"
 # include "allegro5/allegro_primitives.h"
@@ -28,6 +29,14 @@
 # define POLY_DEBUG 0
 
 
+/* Polygons with at least this many vertices are triangulated with the
+ * sweep line, which does not slow down quadratically.  Below that the ear
+ * clipper takes well under a millisecond, and it copes better with
+ * degenerate input and keeps the triangles smaller polygons always had.
+ */
+# define POLY_SWEEP_MIN_VERTICES  256
+
+
 /* */
 # define POLY_VERTEX_ATTR_REFLEX      0x0001
 # define POLY_VERTEX_ATTR_EAR_CLIP    0x0002
@@ -89,7 +98,6 @@ static void      poly_classify_vertices_in_range(_AL_LIST_ITEM* begin, _AL_LIST_
 static void      poly_do_triangulate(POLY* poly);
 
 static _AL_LIST* poly_create_split_list(POLY* polygon);
-static void      poly_split_list_dtor(void* user_data);
 
 
 /*
@@ -270,23 +278,17 @@ static _AL_LIST* poly_create_split_list(POLY* polygon)
    int i;
    int last_split;
 
-   _AL_LIST*       list   = _al_list_create_static(polygon->split_count);
-   POLY_SPLIT* splits = (POLY_SPLIT*)al_malloc(polygon->split_count * sizeof(POLY_SPLIT));
+   _AL_LIST*       list   = _al_list_create_frame_static(polygon->split_count);
+   POLY_SPLIT* splits = (POLY_SPLIT*)al_frame_alloc(polygon->split_count * sizeof(POLY_SPLIT));
 
+   /* Both live in the frame arena, which al_triangulate_polygon rewinds. */
    if ((NULL == list) || (NULL == splits)) {
 
       _al_list_destroy(list);
-      al_free(splits);
 
       return NULL;
    }
 
-   /* Set list destructor, so we will don't worry about
-    * manually releasing allocated memory.
-    */
-   _al_list_set_dtor(list, poly_split_list_dtor);
-   _al_list_set_user_data(list, splits);
-
    last_split = POLY_SPLIT(0);
    for (i = 1; i < (int)polygon->split_count; ++i) {
 
@@ -339,17 +341,6 @@ static _AL_LIST* poly_create_split_list(POLY* polygon)
 }
 
 
-/*
- *  Release memory allocated by split list. This method
- *  serve as callback to the list.
- */
-static void poly_split_list_dtor(void* user_data)
-{
-   /* This is array of POLY_SPLIT. */
-   al_free(user_data);
-}
-
-
 /*
  *  Perform initialization step to polygon triangulation.
  *
@@ -380,9 +371,9 @@ static bool poly_initialize(POLY* polygon)
    vertex_count = polygon->vertex_count + (polygon->split_count - 1) * 2;
 
    /* Create lists for polygon. */
-   vertex_list = _al_list_create_static(vertex_count);
-   reflex_list = _al_list_create_static(vertex_count);
-   ear_list    = _al_list_create_static(vertex_count);
+   vertex_list = _al_list_create_frame_static(vertex_count);
+   reflex_list = _al_list_create_frame_static(vertex_count);
+   ear_list    = _al_list_create_frame_static(vertex_count);
 
    if (polygon->split_count > 1) {
 
@@ -821,6 +812,7 @@ bool al_triangulate_polygon(
    int *splits;
    int i;
    bool ret;
+   size_t mark;
 
    for (i = 0; vertex_counts[i] > 0; i++) {
       /* do nothing */
@@ -828,7 +820,11 @@ bool al_triangulate_polygon(
    ASSERT(i > 0);
    split_count = i;
 
-   splits = malloc(split_count * sizeof(int));
+   /* All working memory comes from the frame arena, so that drawing
+    * polygons does not touch the heap once the arena is large enough.
+    */
+   mark = al_get_frame_arena_mark();
+   splits = al_frame_alloc(split_count * sizeof(int));
    if (!splits) {
       return false;
    }
@@ -838,6 +834,13 @@ bool al_triangulate_polygon(
       splits[i] = vertex_count;
    }
 
+   if (vertex_count >= POLY_SWEEP_MIN_VERTICES &&
+         _al_prim_triangulate_sweep(vertices, vertex_stride, vertex_counts,
+            emit_triangle, userdata)) {
+      al_rewind_frame_arena(mark);
+      return true;
+   }
+
    memset(&polygon, 0, sizeof(polygon));
    polygon.vertex_buffer = vertices;
    polygon.vertex_stride = vertex_stride;
@@ -862,9 +865,51 @@ bool al_triangulate_polygon(
       ret = false;
    }
 
-   free(splits);
+   al_rewind_frame_arena(mark);
 
    return ret;
 }
 
+
+typedef struct POLY_INDICES {
+   int *indices;
+   int max_indices;
+   int num_indices;
+} POLY_INDICES;
+
+
+static void poly_emit_indices(int a, int b, int c, void *userdata)
+{
+   POLY_INDICES *out = userdata;
+
+   if (out->num_indices + 3 <= out->max_indices) {
+      out->indices[out->num_indices + 0] = a;
+      out->indices[out->num_indices + 1] = b;
+      out->indices[out->num_indices + 2] = c;
+   }
+   out->num_indices += 3;
+}
+
+
+/* Function: al_triangulate_polygon_to_indices
+ */
+int al_triangulate_polygon_to_indices(
+   const float* vertices, size_t vertex_stride, const int* vertex_counts,
+   int* indices, int max_indices)
+{
+   POLY_INDICES out;
+
+   ASSERT(indices || max_indices == 0);
+
+   out.indices = indices;
+   out.max_indices = max_indices;
+   out.num_indices = 0;
+
+   if (!al_triangulate_polygon(vertices, vertex_stride, vertex_counts,
+         poly_emit_indices, &out))
+      return 0;
+
+   return out.num_indices;
+}
+
 /* vim: set sts=3 sw=3 et: */
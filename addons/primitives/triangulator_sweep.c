@@ -0,0 +1,613 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Polygon triangulation with holes by monotone partitioning.
+ *
+ *      The polygon is cut into y-monotone pieces with a sweep line,
+ *      as described in "Computational Geometry: Algorithms and
+ *      Applications" by de Berg et al., chapter 3, and every piece is
+ *      triangulated in linear time. This takes O(n log n) for the sort
+ *      plus the cost of keeping the edges crossing the sweep line in a
+ *      sorted array, instead of the O(n^2) of ear clipping.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#define ALLEGRO_INTERNAL_UNSTABLE
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_primitives.h"
+#include "allegro5/internal/aintern_prim.h"
+#include <stdlib.h>
+#include <string.h>
+
+ALLEGRO_DEBUG_CHANNEL("primitives")
+
+
+enum {
+   SWEEP_START,
+   SWEEP_END,
+   SWEEP_SPLIT,
+   SWEEP_MERGE,
+   SWEEP_REGULAR
+};
+
+
+/* A polygon vertex.  Adding a diagonal splits a polygon into two, so both
+ * ends of it get a copy, which keeps the index of the input vertex.
+ */
+typedef struct SWEEP_VERTEX {
+   float x, y;
+   int index;
+   int prev, next;
+} SWEEP_VERTEX;
+
+
+/* An edge crossing the sweep line.  Edges are identified by the index of
+ * the input vertex they start at, which stays the same when their start
+ * vertex is copied.
+ */
+typedef struct SWEEP_EDGE {
+   float x1, y1;
+   float x2, y2;
+   int id;
+} SWEEP_EDGE;
+
+
+typedef struct SWEEP_KEY {
+   float x, y;
+   int vertex;
+} SWEEP_KEY;
+
+
+/* All working memory is carved from one frame arena allocation. */
+typedef struct SWEEP {
+   SWEEP_VERTEX *vtxs;
+   int num_vtxs;
+   int max_vtxs;
+   char *type;
+   int *helper;            /* Per edge. */
+   int *edge_pos;          /* Per edge, the position in edges or -1. */
+   SWEEP_KEY *order;
+   SWEEP_EDGE *edges;
+   int num_edges;
+   int *tris;
+   int num_tris;
+   int max_tris;
+   /* Scratch space for the monotone pieces. */
+   int *piece;
+   char *chain;
+   int *piece_order;
+   int *stack;
+   char *used;
+} SWEEP;
+
+
+/* The sweep goes from top to bottom in a coordinate system with y up, ties
+ * broken by x.
+ */
+static bool below(const SWEEP_VERTEX *a, const SWEEP_VERTEX *b)
+{
+   return a->y < b->y || (a->y == b->y && a->x < b->x);
+}
+
+
+static bool left_turn(float x1, float y1, float x2, float y2, float x3, float y3)
+{
+   return (y3 - y1) * (x2 - x1) - (x3 - x1) * (y2 - y1) > 0;
+}
+
+
+static int compare_keys(const void *a, const void *b)
+{
+   const SWEEP_KEY *ka = a;
+   const SWEEP_KEY *kb = b;
+
+   if (ka->y > kb->y || (ka->y == kb->y && ka->x > kb->x))
+      return -1;
+   if (ka->y < kb->y || (ka->y == kb->y && ka->x < kb->x))
+      return 1;
+   return 0;
+}
+
+
+/* Orders the edges crossing the sweep line from left to right.  An edge
+ * with both ends equal stands for a point.
+ */
+static bool edge_less(const SWEEP_EDGE *a, const SWEEP_EDGE *b)
+{
+   if (b->y1 == b->y2) {
+      if (a->y1 == a->y2)
+         return a->y1 < b->y1;
+      return left_turn(a->x1, a->y1, a->x2, a->y2, b->x1, b->y1);
+   }
+   else if (a->y1 == a->y2 || a->y1 < b->y1) {
+      return !left_turn(b->x1, b->y1, b->x2, b->y2, a->x1, a->y1);
+   }
+   else {
+      return left_turn(a->x1, a->y1, a->x2, a->y2, b->x1, b->y1);
+   }
+}
+
+
+/* Returns the position of the first edge not less than e. */
+static int lower_bound(SWEEP *s, const SWEEP_EDGE *e)
+{
+   int lo = 0;
+   int hi = s->num_edges;
+
+   while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (edge_less(&s->edges[mid], e))
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return lo;
+}
+
+
+/* Inserts the edge starting at vertex v, with v as its helper. */
+static void insert_edge(SWEEP *s, int v)
+{
+   SWEEP_EDGE e;
+   int pos;
+   int i;
+
+   e.x1 = s->vtxs[v].x;
+   e.y1 = s->vtxs[v].y;
+   e.x2 = s->vtxs[s->vtxs[v].next].x;
+   e.y2 = s->vtxs[s->vtxs[v].next].y;
+   e.id = s->vtxs[v].index;
+
+   pos = lower_bound(s, &e);
+   for (i = s->num_edges; i > pos; i--) {
+      s->edges[i] = s->edges[i - 1];
+      s->edge_pos[s->edges[i].id] = i;
+   }
+   s->edges[pos] = e;
+   s->edge_pos[e.id] = pos;
+   s->helper[e.id] = v;
+   s->num_edges++;
+}
+
+
+static void remove_edge(SWEEP *s, int id)
+{
+   int pos = s->edge_pos[id];
+   int i;
+
+   for (i = pos; i < s->num_edges - 1; i++) {
+      s->edges[i] = s->edges[i + 1];
+      s->edge_pos[s->edges[i].id] = i;
+   }
+   s->num_edges--;
+   s->edge_pos[id] = -1;
+}
+
+
+/* Returns the edge directly left of vertex v, or -1. */
+static int find_left_edge(SWEEP *s, int v)
+{
+   SWEEP_EDGE e;
+   int pos;
+
+   e.x1 = e.x2 = s->vtxs[v].x;
+   e.y1 = e.y2 = s->vtxs[v].y;
+   e.id = -1;
+
+   pos = lower_bound(s, &e);
+   if (pos == 0)
+      return -1;
+   return s->edges[pos - 1].id;
+}
+
+
+/* Connects vertices a and b.  The copy of a made here takes over the edge
+ * that started at a, and the same for b, while a and b continue along the
+ * diagonal.  Returns the copy of a.
+ */
+static int add_diagonal(SWEEP *s, int a, int b)
+{
+   SWEEP_VERTEX *vtxs = s->vtxs;
+   int a2 = s->num_vtxs++;
+   int b2 = s->num_vtxs++;
+
+   ASSERT(s->num_vtxs <= s->max_vtxs);
+
+   vtxs[a2] = vtxs[a];
+   vtxs[b2] = vtxs[b];
+
+   vtxs[vtxs[a].next].prev = a2;
+   vtxs[vtxs[b].next].prev = b2;
+   vtxs[a].next = b2;
+   vtxs[b2].prev = a;
+   vtxs[b].next = a2;
+   vtxs[a2].prev = b;
+
+   s->type[a2] = s->type[a];
+   s->type[b2] = s->type[b];
+
+   return a2;
+}
+
+
+static bool helper_is_merge(SWEEP *s, int id)
+{
+   return s->type[s->helper[id]] == SWEEP_MERGE;
+}
+
+
+/* Adds the diagonals that cut the polygon into y-monotone pieces. */
+static bool partition(SWEEP *s, int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++) {
+      SWEEP_VERTEX *v = &s->vtxs[i];
+      SWEEP_VERTEX *prev = &s->vtxs[v->prev];
+      SWEEP_VERTEX *next = &s->vtxs[v->next];
+      bool convex = left_turn(next->x, next->y, prev->x, prev->y, v->x, v->y);
+
+      if (below(prev, v) && below(next, v))
+         s->type[i] = convex ? SWEEP_START : SWEEP_SPLIT;
+      else if (below(v, prev) && below(v, next))
+         s->type[i] = convex ? SWEEP_END : SWEEP_MERGE;
+      else
+         s->type[i] = SWEEP_REGULAR;
+      s->edge_pos[i] = -1;
+      s->order[i].x = v->x;
+      s->order[i].y = v->y;
+      s->order[i].vertex = i;
+   }
+
+   qsort(s->order, n, sizeof(SWEEP_KEY), compare_keys);
+
+   for (i = 0; i < n; i++) {
+      int v = s->order[i].vertex;
+      int v2 = v;
+      /* The edge ending at v. */
+      int prev = s->vtxs[s->vtxs[v].prev].index;
+      int left;
+
+      switch (s->type[v]) {
+         case SWEEP_START:
+            insert_edge(s, v);
+            break;
+
+         case SWEEP_END:
+            if (s->edge_pos[prev] < 0)
+               return false;
+            if (helper_is_merge(s, prev))
+               add_diagonal(s, v, s->helper[prev]);
+            remove_edge(s, prev);
+            break;
+
+         case SWEEP_SPLIT:
+            left = find_left_edge(s, v);
+            if (left < 0)
+               return false;
+            v2 = add_diagonal(s, v, s->helper[left]);
+            s->helper[left] = v;
+            insert_edge(s, v2);
+            break;
+
+         case SWEEP_MERGE:
+            if (s->edge_pos[prev] < 0)
+               return false;
+            if (helper_is_merge(s, prev))
+               v2 = add_diagonal(s, v, s->helper[prev]);
+            remove_edge(s, prev);
+            left = find_left_edge(s, v);
+            if (left < 0)
+               return false;
+            if (helper_is_merge(s, left))
+               add_diagonal(s, v2, s->helper[left]);
+            s->helper[left] = v2;
+            break;
+
+         case SWEEP_REGULAR:
+            if (below(&s->vtxs[v], &s->vtxs[s->vtxs[v].prev])) {
+               /* The interior is to the right. */
+               if (s->edge_pos[prev] < 0)
+                  return false;
+               if (helper_is_merge(s, prev))
+                  v2 = add_diagonal(s, v, s->helper[prev]);
+               remove_edge(s, prev);
+               insert_edge(s, v2);
+               s->helper[s->vtxs[v2].index] = v2;
+            }
+            else {
+               left = find_left_edge(s, v);
+               if (left < 0)
+                  return false;
+               if (helper_is_merge(s, left))
+                  add_diagonal(s, v, s->helper[left]);
+               s->helper[left] = v;
+            }
+            break;
+      }
+   }
+
+   return true;
+}
+
+
+static void add_triangle(SWEEP *s, int a, int b, int c)
+{
+   int *t;
+
+   if (s->num_tris++ >= s->max_tris)
+      return;
+   t = s->tris + 3 * (s->num_tris - 1);
+   t[0] = s->vtxs[a].index;
+   t[1] = s->vtxs[b].index;
+   t[2] = s->vtxs[c].index;
+}
+
+
+/* Triangulates the y-monotone polygon made of the num vertices in
+ * s->piece, in order.
+ */
+static bool triangulate_monotone(SWEEP *s, int num)
+{
+   const int *p = s->piece;
+   char *chain = s->chain;
+   int *order = s->piece_order;
+   int *stack = s->stack;
+   int top, bottom, left, right;
+   int sp;
+   int i, j;
+
+   #define V(k)  (&s->vtxs[p[k]])
+   #define LT(a, b, c) \
+      left_turn(V(a)->x, V(a)->y, V(b)->x, V(b)->y, V(c)->x, V(c)->y)
+
+   if (num < 3)
+      return true;
+   if (num == 3) {
+      add_triangle(s, p[0], p[1], p[2]);
+      return true;
+   }
+
+   top = bottom = 0;
+   for (i = 1; i < num; i++) {
+      if (below(V(i), V(bottom)))
+         bottom = i;
+      if (below(V(top), V(i)))
+         top = i;
+   }
+
+   /* Both chains must go down all the way. */
+   for (i = top; i != bottom; i = (i + 1) % num) {
+      if (!below(V((i + 1) % num), V(i)))
+         return false;
+   }
+   for (i = bottom; i != top; i = (i + 1) % num) {
+      if (!below(V(i), V((i + 1) % num)))
+         return false;
+   }
+
+   /* Merge the left (1) and right (-1) chains from the top. */
+   order[0] = top;
+   chain[top] = 0;
+   left = (top + 1) % num;
+   right = (top + num - 1) % num;
+   for (i = 1; i < num - 1; i++) {
+      if (left == bottom ||
+            (right != bottom && below(V(left), V(right)))) {
+         order[i] = right;
+         chain[right] = -1;
+         right = (right + num - 1) % num;
+      }
+      else {
+         order[i] = left;
+         chain[left] = 1;
+         left = (left + 1) % num;
+      }
+   }
+   order[i] = bottom;
+   chain[bottom] = 0;
+
+   stack[0] = order[0];
+   stack[1] = order[1];
+   sp = 2;
+
+   for (i = 2; i < num - 1; i++) {
+      int v = order[i];
+
+      if (chain[v] != chain[stack[sp - 1]]) {
+         for (j = 0; j < sp - 1; j++) {
+            if (chain[v] == 1)
+               add_triangle(s, p[stack[j + 1]], p[stack[j]], p[v]);
+            else
+               add_triangle(s, p[stack[j]], p[stack[j + 1]], p[v]);
+         }
+         stack[0] = order[i - 1];
+         stack[1] = v;
+         sp = 2;
+      }
+      else {
+         sp--;
+         while (sp > 0) {
+            if (chain[v] == 1) {
+               if (!LT(v, stack[sp - 1], stack[sp]))
+                  break;
+               add_triangle(s, p[v], p[stack[sp - 1]], p[stack[sp]]);
+            }
+            else {
+               if (!LT(v, stack[sp], stack[sp - 1]))
+                  break;
+               add_triangle(s, p[v], p[stack[sp]], p[stack[sp - 1]]);
+            }
+            sp--;
+         }
+         sp++;
+         stack[sp++] = v;
+      }
+   }
+
+   for (j = 0; j < sp - 1; j++) {
+      if (chain[stack[j + 1]] == 1)
+         add_triangle(s, p[stack[j]], p[stack[j + 1]], p[order[i]]);
+      else
+         add_triangle(s, p[stack[j + 1]], p[stack[j]], p[order[i]]);
+   }
+
+   #undef V
+   #undef LT
+
+   return true;
+}
+
+
+/* Triangulates every piece left by the partition. */
+static bool triangulate_pieces(SWEEP *s)
+{
+   int i;
+
+   for (i = 0; i < s->num_vtxs; i++)
+      s->used[i] = 0;
+
+   for (i = 0; i < s->num_vtxs; i++) {
+      int num = 0;
+      int v;
+
+      if (s->used[i])
+         continue;
+      v = i;
+      do {
+         s->used[v] = 1;
+         s->piece[num++] = v;
+         v = s->vtxs[v].next;
+      } while (v != i && num < s->num_vtxs);
+
+      if (v != i || !triangulate_monotone(s, num))
+         return false;
+   }
+
+   return true;
+}
+
+
+/* Triangulates the polygon with holes as al_triangulate_polygon does.
+ * The triangles are only emitted once all of them were found.  Returns false
+ * without emitting anything if the polygon cannot be handled here, for
+ * example because it is not oriented as documented, in which case ear
+ * clipping should be used.
+ */
+bool _al_prim_triangulate_sweep(const float *vertices, size_t vertex_stride,
+   const int *vertex_counts, void (*emit_triangle)(int, int, int, void*),
+   void *userdata)
+{
+   SWEEP s;
+   void *block;
+   char *arena;
+   size_t size;
+   size_t mark;
+   int n = 0;
+   int first;
+   int i, j;
+
+   for (i = 0; vertex_counts[i] > 0; i++) {
+      if (vertex_counts[i] < 3)
+         return false;
+      n += vertex_counts[i];
+   }
+
+   memset(&s, 0, sizeof(s));
+   s.max_vtxs = 3 * n;
+   /* Every hole adds two triangles. */
+   s.max_tris = n + 2 * (i - 1) - 2;
+
+   size = s.max_vtxs * (sizeof(SWEEP_VERTEX) + 3 * sizeof(int) + 3)
+      + n * (sizeof(SWEEP_EDGE) + sizeof(SWEEP_KEY) + 2 * sizeof(int))
+      + s.max_tris * 3 * sizeof(int);
+   mark = al_get_frame_arena_mark();
+   block = al_frame_alloc(size);
+   if (!block) {
+      ALLEGRO_WARN("Out of memory for %d polygon vertices.\n", n);
+      return false;
+   }
+   arena = block;
+
+   #define CARVE(ptr, count) \
+      ((ptr) = (void *)arena, arena += (count) * sizeof(*(ptr)))
+
+   CARVE(s.vtxs, s.max_vtxs);
+   CARVE(s.edges, n);
+   CARVE(s.order, n);
+   CARVE(s.helper, n);
+   CARVE(s.edge_pos, n);
+   CARVE(s.piece, s.max_vtxs);
+   CARVE(s.piece_order, s.max_vtxs);
+   CARVE(s.stack, s.max_vtxs);
+   CARVE(s.tris, 3 * s.max_tris);
+   CARVE(s.type, s.max_vtxs);
+   CARVE(s.chain, s.max_vtxs);
+   CARVE(s.used, s.max_vtxs);
+
+   #undef CARVE
+
+   /* Flip y, so that the documented winding is anti-clockwise for the
+    * outline and clockwise for the holes, as the sweep expects.  Repeated
+    * points are left out, they would only add empty triangles.
+    */
+   first = 0;
+   for (i = 0; vertex_counts[i] > 0; i++) {
+      int begin = s.num_vtxs;
+      int count;
+      float area = 0;
+
+      for (j = 0; j < vertex_counts[i]; j++) {
+         const float *p = (const float *)((const char *)vertices +
+            (first + j) * vertex_stride);
+         SWEEP_VERTEX *v = &s.vtxs[s.num_vtxs];
+         v->x = p[0];
+         v->y = -p[1];
+         v->index = first + j;
+         if (s.num_vtxs == begin || v->x != v[-1].x || v->y != v[-1].y)
+            s.num_vtxs++;
+      }
+      while (s.num_vtxs - begin > 1 &&
+            s.vtxs[s.num_vtxs - 1].x == s.vtxs[begin].x &&
+            s.vtxs[s.num_vtxs - 1].y == s.vtxs[begin].y)
+         s.num_vtxs--;
+      first += vertex_counts[i];
+
+      count = s.num_vtxs - begin;
+      for (j = 0; j < count; j++) {
+         SWEEP_VERTEX *a = &s.vtxs[begin + j];
+         const SWEEP_VERTEX *b = &s.vtxs[begin + (j + 1) % count];
+         a->prev = begin + (j + count - 1) % count;
+         a->next = begin + (j + 1) % count;
+         area += a->x * b->y - b->x * a->y;
+      }
+      if (count < 3 || (i == 0) != (area > 0)) {
+         al_rewind_frame_arena(mark);
+         return false;
+      }
+   }
+   n = s.num_vtxs;
+
+   if (!partition(&s, n) || !triangulate_pieces(&s) ||
+         s.num_tris > s.max_tris) {
+      al_rewind_frame_arena(mark);
+      return false;
+   }
+
+   for (i = 0; i < s.num_tris; i++)
+      emit_triangle(s.tris[3 * i], s.tris[3 * i + 1], s.tris[3 * i + 2], userdata);
+
+   al_rewind_frame_arena(mark);
+   return true;
+}
+
+/* vim: set sts=3 sw=3 et: */
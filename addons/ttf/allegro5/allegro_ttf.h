@@ -11,6 +11,9 @@
 #define ALLEGRO_TTF_NO_KERNING  1
 #define ALLEGRO_TTF_MONOCHROME  2
 #define ALLEGRO_TTF_NO_AUTOHINT 4
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_TTF_SRC)
+#define ALLEGRO_TTF_SDF         8
+#endif
 
 #if (defined ALLEGRO_MINGW32) || (defined ALLEGRO_MSVC) || (defined ALLEGRO_BCC32)
    #ifndef ALLEGRO_STATICLINK
@@ -43,6 +46,14 @@ ALLEGRO_TTF_FUNC(bool, al_is_ttf_addon_initialized, (void));
 ALLEGRO_TTF_FUNC(void, al_shutdown_ttf_addon, (void));
 ALLEGRO_TTF_FUNC(uint32_t, al_get_allegro_ttf_version, (void));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_TTF_SRC)
+ALLEGRO_TTF_FUNC(bool, al_prewarm_ttf_glyphs, (ALLEGRO_FONT *font, int ranges_n, const int ranges[]));
+ALLEGRO_TTF_FUNC(bool, al_save_ttf_glyph_cache, (ALLEGRO_FONT *font, const char *filename));
+ALLEGRO_TTF_FUNC(bool, al_save_ttf_glyph_cache_f, (ALLEGRO_FONT *font, ALLEGRO_FILE *f));
+ALLEGRO_TTF_FUNC(bool, al_load_ttf_glyph_cache, (ALLEGRO_FONT *font, const char *filename));
+ALLEGRO_TTF_FUNC(bool, al_load_ttf_glyph_cache_f, (ALLEGRO_FONT *font, ALLEGRO_FILE *f));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
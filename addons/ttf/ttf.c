@@ -5,6 +5,8 @@
 #include "allegro5/allegro_opengl.h"
 #endif
 #include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_atomicops.h"
+#include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_vector.h"
 
 #include "allegro5/allegro_ttf.h"
@@ -16,9 +18,17 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_MODULE_H
+#include FT_SIZES_H
 
+#include <math.h>
 #include <stdlib.h>
 
+/* FT_RENDER_MODE_SDF appeared in FreeType 2.11. */
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+   #define TTF_HAVE_SDF
+#endif
+
 ALLEGRO_DEBUG_CHANNEL("font")
 
 
@@ -38,6 +48,12 @@ ALLEGRO_DEBUG_CHANNEL("font")
 #define RANGE_SIZE   128
 
 
+/* How far, in pixels at the size the distance fields are rasterized at,
+ * they reach beyond the outlines.
+ */
+#define SDF_SPREAD   8
+
+
 typedef struct REGION
 {
    short x;
@@ -54,6 +70,7 @@ typedef struct ALLEGRO_TTF_GLYPH_DATA
    short offset_x;
    short offset_y;
    short advance;
+   bool pending;        /* Queued for the rasterizer thread. */
 } ALLEGRO_TTF_GLYPH_DATA;
 
 
@@ -64,37 +81,199 @@ typedef struct ALLEGRO_TTF_GLYPH_RANGE
 } ALLEGRO_TTF_GLYPH_RANGE;
 
 
-typedef struct ALLEGRO_TTF_FONT_DATA
+/* Codepoints below this map to glyphs through a flat table, the others
+ * through a hash table.
+ */
+#define LATIN_CHARS  256
+
+/* Number of kerning pairs remembered, a power of two. */
+#define KERNING_CACHE_SIZE 1024
+
+/* Number of code points decoded at a time when measuring or drawing text. */
+#define DECODE_CHUNK 64
+
+
+typedef struct TTF_CHAR_ENTRY
 {
-   FT_Face face;
-   int flags;
-   _AL_VECTOR glyph_ranges;  /* sorted array of of ALLEGRO_TTF_GLYPH_RANGE */
+   int32_t codepoint;   /* -1 for free hash table slots */
+   int ft_index;
+   ALLEGRO_TTF_GLYPH_DATA *glyph;  /* NULL if not looked up yet */
+} TTF_CHAR_ENTRY;
+
+
+typedef struct TTF_KERNING_ENTRY
+{
+   uint32_t pair;       /* first << 16 | second, all ones if unused */
+   int kerning;
+} TTF_KERNING_ENTRY;
+
+
+typedef struct TTF_ASYNC TTF_ASYNC;
+
 
+/* The pages glyphs are packed onto.  Each font normally has its own, but
+ * small sizes of one face can share them, see shared_pages_max_size.
+ */
+typedef struct TTF_PAGES
+{
    _AL_VECTOR page_bitmaps;  /* of ALLEGRO_BITMAP pointers */
    int page_pos_x;
    int page_pos_y;
    int page_line_height;
    ALLEGRO_LOCKED_REGION *page_lr;
 
+   int bitmap_format;
+   int bitmap_flags;
+
+   int min_page_size;
+   int max_page_size;
+
+   int refcount;
+} TTF_PAGES;
+
+
+/* A font file opened by FreeType.  All fonts loaded by al_load_ttf_font
+ * from the same file share one, each with its own FT_Size on the face, so
+ * the file is parsed and kept open once however many sizes of it are
+ * loaded.  The fonts may be used from different threads, so everything
+ * touching a shared face, its active size or its shared pages holds its
+ * mutex, see lock_face.
+ */
+typedef struct TTF_FACE
+{
+   char *key;                /* Resolved path, NULL if not shared. */
+   int refcount;
+   ALLEGRO_MUTEX *mutex;     /* Recursive, NULL if not shared. */
+   FT_Face face;
+
    FT_StreamRec stream;
    ALLEGRO_FILE *file;
    unsigned long base_offset;
    unsigned long offset;
 
-   int bitmap_format;
-   int bitmap_flags;
+   _AL_VECTOR shared_pages;  /* of TTF_PAGES pointers */
+} TTF_FACE;
 
-   int min_page_size;
-   int max_page_size;
+
+typedef struct ALLEGRO_TTF_FONT_DATA
+{
+   TTF_FACE *ttf_face;
+   FT_Face face;             /* ttf_face->face */
+   FT_Size size;             /* Activate before loading glyphs. */
+   int flags;
+   _AL_VECTOR glyph_ranges;  /* sorted array of of ALLEGRO_TTF_GLYPH_RANGE */
+
+   /* Codepoint to glyph lookups, so FreeType's charmap and the binary
+    * search over glyph_ranges are only needed on the first use.  The glyph
+    * pointers stay valid until the ranges are freed.
+    */
+   TTF_CHAR_ENTRY latin_chars[LATIN_CHARS];
+   TTF_CHAR_ENTRY *chars;    /* open addressing, chars_capacity slots */
+   int chars_capacity;
+   int chars_count;
+   TTF_CHAR_ENTRY scratch_char;
+   TTF_KERNING_ENTRY *kerning_cache;  /* [KERNING_CACHE_SIZE], lazily */
+
+   TTF_PAGES *pages;
+   _AL_VECTOR retired_pages; /* of TTF_PAGES pointers, see retire_pages */
 
    bool skip_cache_misses;
+   TTF_ASYNC *async;         /* NULL unless misses are rasterized async. */
 } ALLEGRO_TTF_FONT_DATA;
 
 
+/* With the async_cache_misses setting, glyphs missing from the cache are
+ * rasterized by a worker thread shared by all fonts, and copied to the pages
+ * by the next lookup on the drawing thread.  FreeType faces can't be used by
+ * two threads at once, so the worker has its own library and its own face,
+ * reading from its own handle of the font file.
+ */
+typedef struct TTF_RASTERIZED_GLYPH
+{
+   int ft_index;
+   int offset_x;
+   int offset_y;
+   int advance;
+   FT_Bitmap bitmap;         /* The buffer is ours. */
+} TTF_RASTERIZED_GLYPH;
+
+
+struct TTF_ASYNC
+{
+   FT_Library library;
+   FT_Face face;
+   FT_StreamRec stream;
+   ALLEGRO_FILE *file;
+   unsigned long base_offset;
+   unsigned long offset;
+
+   /* Guarded by the worker mutex. */
+   _AL_VECTOR results;       /* of TTF_RASTERIZED_GLYPH */
+   volatile _AL_ATOMIC have_results;
+};
+
+
+typedef struct TTF_GLYPH_JOB
+{
+   ALLEGRO_TTF_FONT_DATA *data;
+   int ft_index;
+} TTF_GLYPH_JOB;
+
+
+typedef struct TTF_WORKER
+{
+   ALLEGRO_THREAD *thread;
+   ALLEGRO_MUTEX *mutex;
+   ALLEGRO_COND *work_cond;
+   ALLEGRO_COND *done_cond;
+   _AL_VECTOR jobs;          /* of TTF_GLYPH_JOB, oldest first */
+   ALLEGRO_TTF_FONT_DATA *busy;
+   bool quit;
+} TTF_WORKER;
+
+
+/* The glyphs of ALLEGRO_TTF_SDF fonts are distance fields, rasterized once
+ * at the store size and shared by all such fonts loaded from the same file.
+ * The store holds a hidden font of that size, and an SDF font is a scaled
+ * view of it which draws the fields with a shader.
+ */
+typedef struct TTF_SDF_STORE
+{
+   char *key;           /* NULL if not shared, see get_face_key. */
+   int refcount;
+   ALLEGRO_FONT *base;
+} TTF_SDF_STORE;
+
+
+typedef struct TTF_SDF_FONT_DATA
+{
+   TTF_SDF_STORE *store;
+   float scale_x;
+   float scale_y;
+   int flags;
+} TTF_SDF_FONT_DATA;
+
+
+typedef struct SDF_DRAW_STATE
+{
+   bool held;
+   bool shader_used;
+   ALLEGRO_SHADER *prev_shader;
+} SDF_DRAW_STATE;
+
+
 /* globals */
 static bool ttf_inited;
 static FT_Library ft;
 static ALLEGRO_FONT_VTABLE vt;
+static ALLEGRO_FONT_VTABLE sdf_vt;
+static _AL_VECTOR sdf_stores = _AL_VECTOR_INITIALIZER(TTF_SDF_STORE *);
+static _AL_VECTOR ttf_faces = _AL_VECTOR_INITIALIZER(TTF_FACE *);
+static ALLEGRO_MUTEX *faces_mutex;  /* Recursive, guards ttf_faces and sdf_stores. */
+static ALLEGRO_SHADER *sdf_shader;
+static _AL_DTOR_ITEM *sdf_shader_dtor_item;
+static bool sdf_shader_failed;
+static TTF_WORKER ttf_worker;
 
 
 static INLINE int align4(int x)
@@ -107,6 +286,18 @@ static INLINE int align4(int x)
 }
 
 
+static INLINE bool glyph_is_valid(ALLEGRO_TTF_FONT_DATA *data, int ft_index,
+   ALLEGRO_TTF_GLYPH_DATA *glyph)
+{
+   /* If we're skipping cache misses and it isn't already cached, return it as invalid. */
+   if (data->skip_cache_misses && !glyph->page_bitmap && glyph->region.x >= 0) {
+      return false;
+   }
+
+   return ft_index != 0;
+}
+
+
 /* Returns false if the glyph is invalid.
  */
 static bool get_glyph(ALLEGRO_TTF_FONT_DATA *data,
@@ -148,43 +339,185 @@ static bool get_glyph(ALLEGRO_TTF_FONT_DATA *data,
    
    *glyph = &range->glyphs[ft_index - range_start]; 
    
-   /* If we're skipping cache misses and it isn't already cached, return it as invalid. */
-   if (data->skip_cache_misses && !(*glyph)->page_bitmap && (*glyph)->region.x >= 0) {
+   return glyph_is_valid(data, ft_index, *glyph);
+}
+
+
+static INLINE uint32_t hash_codepoint(int32_t ch)
+{
+   return (uint32_t)ch * 2654435761u;
+}
+
+
+static bool grow_chars(ALLEGRO_TTF_FONT_DATA *data)
+{
+   int capacity = data->chars_capacity ? data->chars_capacity * 2 : 64;
+   TTF_CHAR_ENTRY *chars = al_malloc(capacity * sizeof *chars);
+   int i;
+
+   if (!chars)
       return false;
+   for (i = 0; i < capacity; i++)
+      chars[i].codepoint = -1;
+
+   for (i = 0; i < data->chars_capacity; i++) {
+      TTF_CHAR_ENTRY *e = &data->chars[i];
+      uint32_t j;
+      if (e->codepoint < 0)
+         continue;
+      j = hash_codepoint(e->codepoint) & (capacity - 1);
+      while (chars[j].codepoint >= 0)
+         j = (j + 1) & (capacity - 1);
+      chars[j] = *e;
    }
 
-   return ft_index != 0;
+   al_free(data->chars);
+   data->chars = chars;
+   data->chars_capacity = capacity;
+   return true;
+}
+
+
+static void lock_face(TTF_FACE *ttf_face)
+{
+   if (ttf_face->mutex)
+      al_lock_mutex(ttf_face->mutex);
+}
+
+
+static void unlock_face(TTF_FACE *ttf_face)
+{
+   if (ttf_face->mutex)
+      al_unlock_mutex(ttf_face->mutex);
+}
+
+
+static void fill_char_entry(ALLEGRO_TTF_FONT_DATA *data, TTF_CHAR_ENTRY *e,
+   int32_t ch)
+{
+   e->codepoint = ch;
+   lock_face(data->ttf_face);
+   e->ft_index = FT_Get_Char_Index(data->face, ch);
+   unlock_face(data->ttf_face);
+   get_glyph(data, e->ft_index, &e->glyph);
+}
+
+
+static TTF_CHAR_ENTRY *find_char(ALLEGRO_TTF_FONT_DATA *data, int32_t ch)
+{
+   TTF_CHAR_ENTRY *e;
+   uint32_t mask;
+   uint32_t i;
+
+   if (ch >= 0 && ch < LATIN_CHARS) {
+      e = &data->latin_chars[ch];
+      if (!e->glyph)
+         fill_char_entry(data, e, ch);
+      return e;
+   }
+
+   /* Keep the table at most three quarters full. */
+   if (ch < 0 || ((data->chars_count + 1) * 4 > data->chars_capacity * 3 &&
+         !grow_chars(data))) {
+      fill_char_entry(data, &data->scratch_char, ch);
+      return &data->scratch_char;
+   }
+
+   mask = data->chars_capacity - 1;
+   i = hash_codepoint(ch) & mask;
+   while (data->chars[i].codepoint >= 0) {
+      if (data->chars[i].codepoint == ch)
+         return &data->chars[i];
+      i = (i + 1) & mask;
+   }
+
+   e = &data->chars[i];
+   fill_char_entry(data, e, ch);
+   data->chars_count++;
+   return e;
+}
+
+
+static int get_char_index(ALLEGRO_TTF_FONT_DATA *data, int32_t ch)
+{
+   return find_char(data, ch)->ft_index;
+}
+
+
+/* Like get_glyph, but by codepoint.
+ */
+static bool get_char_glyph(ALLEGRO_TTF_FONT_DATA *data, int32_t ch,
+   int *ft_index, ALLEGRO_TTF_GLYPH_DATA **glyph)
+{
+   TTF_CHAR_ENTRY *e = find_char(data, ch);
+
+   *ft_index = e->ft_index;
+   *glyph = e->glyph;
+   return glyph_is_valid(data, e->ft_index, e->glyph);
+}
+
+
+static void clear_char_cache(ALLEGRO_TTF_FONT_DATA *data)
+{
+   memset(data->latin_chars, 0, sizeof data->latin_chars);
+   al_free(data->chars);
+   data->chars = NULL;
+   data->chars_capacity = 0;
+   data->chars_count = 0;
 }
 
 
 static void unlock_current_page(ALLEGRO_TTF_FONT_DATA *data)
 {
-   if (data->page_lr) {
-      ALLEGRO_BITMAP **back = _al_vector_ref_back(&data->page_bitmaps);
+   if (data->pages->page_lr) {
+      ALLEGRO_BITMAP **back = _al_vector_ref_back(&data->pages->page_bitmaps);
       ASSERT(al_is_bitmap_locked(*back));
       al_unlock_bitmap(*back);
-      data->page_lr = NULL;
+      data->pages->page_lr = NULL;
       ALLEGRO_DEBUG("Unlocking page: %p\n", *back);
    }
 }
 
 
-static ALLEGRO_BITMAP *push_new_page(ALLEGRO_TTF_FONT_DATA *data, int glyph_size)
+static ALLEGRO_BITMAP *add_page(TTF_PAGES *pages, int w, int h)
 {
-    ALLEGRO_BITMAP **back;
     ALLEGRO_BITMAP *page;
     ALLEGRO_STATE state;
+
+    /* The bitmap will be destroyed when the parent font is destroyed so
+     * it is not safe to register a destructor for it.
+     */
+    _al_push_destructor_owner();
+    al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+    al_set_new_bitmap_format(pages->bitmap_format);
+    al_set_new_bitmap_flags(pages->bitmap_flags);
+    page = al_create_bitmap(w, h);
+    al_restore_state(&state);
+    _al_pop_destructor_owner();
+
+    if (page) {
+       ALLEGRO_BITMAP **back = _al_vector_alloc_back(&pages->page_bitmaps);
+       *back = page;
+    }
+
+    return page;
+}
+
+
+static ALLEGRO_BITMAP *push_new_page(ALLEGRO_TTF_FONT_DATA *data, int glyph_size)
+{
+    ALLEGRO_BITMAP *page;
     int page_size = 1;
     /* 16 seems to work well. A particular problem are fixed width fonts which
      * take an inordinate amount of space. */
     while (page_size < 16 * glyph_size) {
       page_size *= 2;
     }
-    if (page_size < data->min_page_size) {
-      page_size = data->min_page_size;
+    if (page_size < data->pages->min_page_size) {
+      page_size = data->pages->min_page_size;
     }
-    if (page_size > data->max_page_size) {
-      page_size = data->max_page_size;
+    if (page_size > data->pages->max_page_size) {
+      page_size = data->pages->max_page_size;
     }
     if (glyph_size > page_size) {
       ALLEGRO_ERROR("Unable create new page, glyph too large: %d > %d\n",
@@ -194,24 +527,11 @@ static ALLEGRO_BITMAP *push_new_page(ALLEGRO_TTF_FONT_DATA *data, int glyph_size
 
     unlock_current_page(data);
 
-    /* The bitmap will be destroyed when the parent font is destroyed so
-     * it is not safe to register a destructor for it.
-     */
-    _al_push_destructor_owner();
-    al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
-    al_set_new_bitmap_format(data->bitmap_format);
-    al_set_new_bitmap_flags(data->bitmap_flags);
-    page = al_create_bitmap(page_size, page_size);
-    al_restore_state(&state);
-    _al_pop_destructor_owner();
-
+    page = add_page(data->pages, page_size, page_size);
     if (page) {
-       back = _al_vector_alloc_back(&data->page_bitmaps);
-       *back = page;
-
-       data->page_pos_x = 0;
-       data->page_pos_y = 0;
-       data->page_line_height = 0;
+       data->pages->page_pos_x = 0;
+       data->pages->page_pos_y = 0;
+       data->pages->page_line_height = 0;
     }
 
     return page;
@@ -228,7 +548,7 @@ static unsigned char *alloc_glyph_region(ALLEGRO_TTF_FONT_DATA *data,
    int glyph_size = w4 > h4 ? w4 : h4;
    bool lock = false;
 
-   if (_al_vector_is_empty(&data->page_bitmaps) || new) {
+   if (_al_vector_is_empty(&data->pages->page_bitmaps) || new) {
       page = push_new_page(data, glyph_size);
       if (!page) {
          ALLEGRO_ERROR("Failed to create a new page for glyph %d.\n", ft_index);
@@ -236,33 +556,33 @@ static unsigned char *alloc_glyph_region(ALLEGRO_TTF_FONT_DATA *data,
       }
    }
    else {
-      ALLEGRO_BITMAP **back = _al_vector_ref_back(&data->page_bitmaps);
+      ALLEGRO_BITMAP **back = _al_vector_ref_back(&data->pages->page_bitmaps);
       page = *back;
    }
 
    ALLEGRO_DEBUG("Glyph %d: %dx%d (%dx%d)%s\n",
       ft_index, w, h, w4, h4, new ? " new" : "");
 
-   if (data->page_pos_x + w4 > al_get_bitmap_width(page)) {
-      data->page_pos_y += data->page_line_height;
-      data->page_pos_y = align4(data->page_pos_y);
-      data->page_pos_x = 0;
-      data->page_line_height = 0;
+   if (data->pages->page_pos_x + w4 > al_get_bitmap_width(page)) {
+      data->pages->page_pos_y += data->pages->page_line_height;
+      data->pages->page_pos_y = align4(data->pages->page_pos_y);
+      data->pages->page_pos_x = 0;
+      data->pages->page_line_height = 0;
    }
 
-   if (data->page_pos_y + h4 > al_get_bitmap_height(page)) {
+   if (data->pages->page_pos_y + h4 > al_get_bitmap_height(page)) {
       return alloc_glyph_region(data, ft_index, w, h, true, glyph, lock_whole_page);
    }
 
    glyph->page_bitmap = page;
-   glyph->region.x = data->page_pos_x;
-   glyph->region.y = data->page_pos_y;
+   glyph->region.x = data->pages->page_pos_x;
+   glyph->region.y = data->pages->page_pos_y;
    glyph->region.w = w;
    glyph->region.h = h;
 
-   data->page_pos_x = align4(data->page_pos_x + w4);
-   if (h > data->page_line_height) {
-      data->page_line_height = h4;
+   data->pages->page_pos_x = align4(data->pages->page_pos_x + w4);
+   if (h > data->pages->page_line_height) {
+      data->pages->page_line_height = h4;
    }
 
    REGION lock_rect;
@@ -271,7 +591,7 @@ static unsigned char *alloc_glyph_region(ALLEGRO_TTF_FONT_DATA *data,
       lock_rect.y = 0;
       lock_rect.w = al_get_bitmap_width(page);
       lock_rect.h = al_get_bitmap_height(page);
-      if (!data->page_lr) {
+      if (!data->pages->page_lr) {
          lock = true;
          ALLEGRO_DEBUG("Locking whole page: %p\n", page);
       }
@@ -292,11 +612,11 @@ static unsigned char *alloc_glyph_region(ALLEGRO_TTF_FONT_DATA *data,
       char *ptr;
       int i;
 
-      data->page_lr = al_lock_bitmap_region(page,
+      data->pages->page_lr = al_lock_bitmap_region(page,
          lock_rect.x, lock_rect.y, lock_rect.w, lock_rect.h,
          ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
 
-      if (!data->page_lr) {
+      if (!data->pages->page_lr) {
          ALLEGRO_ERROR("Failed to lock page.\n");
          return NULL;
       }
@@ -306,33 +626,33 @@ static unsigned char *alloc_glyph_region(ALLEGRO_TTF_FONT_DATA *data,
        * would be faster (yet)
        */
       for (i = 0; i < lock_rect.h; i++) {
-          ptr = (char *)(data->page_lr->data) + (i * data->page_lr->pitch);
+          ptr = (char *)(data->pages->page_lr->data) + (i * data->pages->page_lr->pitch);
           memset(ptr, 0, lock_rect.w * 4);
       }
    }
 
-   ASSERT(data->page_lr);
+   ASSERT(data->pages->page_lr);
 
    /* Copy a displaced pointer for the glyph. */
-   return (unsigned char *)data->page_lr->data
-      + ((glyph->region.y + 1) - lock_rect.y) * data->page_lr->pitch
+   return (unsigned char *)data->pages->page_lr->data
+      + ((glyph->region.y + 1) - lock_rect.y) * data->pages->page_lr->pitch
       + ((glyph->region.x + 1) - lock_rect.x) * sizeof(int32_t);
 }
 
 
-static void copy_glyph_mono(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
-   unsigned char *glyph_data)
+static void copy_glyph_mono(ALLEGRO_TTF_FONT_DATA *font_data,
+   FT_Bitmap const *bitmap, unsigned char *glyph_data)
 {
-   int pitch = font_data->page_lr->pitch;
+   int pitch = font_data->pages->page_lr->pitch;
    int x, y;
 
-   for (y = 0; y < (int)face->glyph->bitmap.rows; y++) {
-      unsigned char const *ptr = face->glyph->bitmap.buffer + face->glyph->bitmap.pitch * y;
+   for (y = 0; y < (int)bitmap->rows; y++) {
+      unsigned char const *ptr = bitmap->buffer + bitmap->pitch * y;
       unsigned char *dptr = glyph_data + pitch * y;
       int bit = 0;
 
       if (font_data->flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA) {
-         for (x = 0; x < (int)face->glyph->bitmap.width; x++) {
+         for (x = 0; x < (int)bitmap->width; x++) {
             unsigned char set = ((*ptr >> (7-bit)) & 1) ? 255 : 0;
             *dptr++ = 255;
             *dptr++ = 255;
@@ -345,7 +665,7 @@ static void copy_glyph_mono(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
          }
       }
       else {
-         for (x = 0; x < (int)face->glyph->bitmap.width; x++) {
+         for (x = 0; x < (int)bitmap->width; x++) {
             unsigned char set = ((*ptr >> (7-bit)) & 1) ? 255 : 0;
             *dptr++ = set;
             *dptr++ = set;
@@ -361,18 +681,18 @@ static void copy_glyph_mono(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
 }
 
 
-static void copy_glyph_color(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
-   unsigned char *glyph_data)
+static void copy_glyph_color(ALLEGRO_TTF_FONT_DATA *font_data,
+   FT_Bitmap const *bitmap, unsigned char *glyph_data)
 {
-   int pitch = font_data->page_lr->pitch;
+   int pitch = font_data->pages->page_lr->pitch;
    int x, y;
 
-   for (y = 0; y < (int)face->glyph->bitmap.rows; y++) {
-      unsigned char const *ptr = face->glyph->bitmap.buffer + face->glyph->bitmap.pitch * y;
+   for (y = 0; y < (int)bitmap->rows; y++) {
+      unsigned char const *ptr = bitmap->buffer + bitmap->pitch * y;
       unsigned char *dptr = glyph_data + pitch * y;
 
       if (font_data->flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA) {
-         for (x = 0; x < (int)face->glyph->bitmap.width; x++) {
+         for (x = 0; x < (int)bitmap->width; x++) {
             unsigned char c = *ptr;
             *dptr++ = 255;
             *dptr++ = 255;
@@ -382,7 +702,7 @@ static void copy_glyph_color(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
          }
       }
       else {
-         for (x = 0; x < (int)face->glyph->bitmap.width; x++) {
+         for (x = 0; x < (int)bitmap->width; x++) {
             unsigned char c = *ptr;
             *dptr++ = c;
             *dptr++ = c;
@@ -395,26 +715,10 @@ static void copy_glyph_color(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
 }
 
 
-/* NOTE: this function may disable the bitmap hold drawing state
- * and leave the current page bitmap locked.
- * 
- * NOTE: We have previously tried to be more clever about caching multiple
- * glyphs during incidental cache misses, but found that approach to be slower.
- */
-static void cache_glyph(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
-   int ft_index, ALLEGRO_TTF_GLYPH_DATA *glyph, bool lock_whole_page)
+static FT_Error load_glyph(FT_Face face, int flags, int ft_index)
 {
     FT_Int32 ft_load_flags;
     FT_Error e;
-    int w, h;
-    unsigned char *glyph_data;
-
-    if (glyph->page_bitmap || glyph->region.x < 0)
-        return;
-   
-    /* We shouldn't ever get here, as cache misses
-     * should have been set to ft_index = 0. */
-    ASSERT(!(font_data->skip_cache_misses && !lock_whole_page));
 
     // FIXME: make this a config setting? FT_LOAD_FORCE_AUTOHINT
 
@@ -422,22 +726,44 @@ static void cache_glyph(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
     // NO_BITMAP flags. Supposedly using that flag makes small sizes
     // look bad so ideally we would not used it.
     ft_load_flags = FT_LOAD_RENDER | FT_LOAD_NO_BITMAP;
-    if (font_data->flags & ALLEGRO_TTF_MONOCHROME)
+    if (flags & ALLEGRO_TTF_MONOCHROME)
        ft_load_flags |= FT_LOAD_TARGET_MONO;
-    if (font_data->flags & ALLEGRO_TTF_NO_AUTOHINT)
+    if (flags & ALLEGRO_TTF_NO_AUTOHINT)
        ft_load_flags |= FT_LOAD_NO_AUTOHINT;
 
-    e = FT_Load_Glyph(face, ft_index, ft_load_flags);
-    if (e) {
-       ALLEGRO_WARN("Failed loading glyph %d from.\n", ft_index);
+#ifdef TTF_HAVE_SDF
+    if (flags & ALLEGRO_TTF_SDF) {
+       /* Hinting is for one pixel grid, the fields get drawn at any scale. */
+       e = FT_Load_Glyph(face, ft_index,
+          FT_LOAD_DEFAULT | FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING);
+       if (!e)
+          e = FT_Render_Glyph(face->glyph, FT_RENDER_MODE_SDF);
+       return e;
     }
+#endif
+    e = FT_Load_Glyph(face, ft_index, ft_load_flags);
+    return e;
+}
+
+
+/* Puts a rasterized glyph onto the current page.
+ *
+ * NOTE: this function may disable the bitmap hold drawing state
+ * and leave the current page bitmap locked.
+ */
+static void store_glyph(ALLEGRO_TTF_FONT_DATA *font_data, int ft_index,
+   ALLEGRO_TTF_GLYPH_DATA *glyph, int offset_x, int offset_y, int advance,
+   FT_Bitmap const *bitmap, bool lock_whole_page)
+{
+    int w, h;
+    unsigned char *glyph_data;
 
-    glyph->offset_x = face->glyph->bitmap_left;
-    glyph->offset_y = (face->size->metrics.ascender >> 6) - face->glyph->bitmap_top;
-    glyph->advance = face->glyph->advance.x >> 6;
+    glyph->offset_x = offset_x;
+    glyph->offset_y = offset_y;
+    glyph->advance = advance;
 
-    w = face->glyph->bitmap.width;
-    h = face->glyph->bitmap.rows;
+    w = bitmap->width;
+    h = bitmap->rows;
 
     if (w == 0 || h == 0) {
        /* Mark this glyph so we won't try to cache it next time. */
@@ -457,18 +783,129 @@ static void cache_glyph(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
        return;
     }
 
-    if (font_data->flags & ALLEGRO_TTF_MONOCHROME)
-       copy_glyph_mono(font_data, face, glyph_data);
+    if ((font_data->flags & ALLEGRO_TTF_MONOCHROME) &&
+          !(font_data->flags & ALLEGRO_TTF_SDF))
+       copy_glyph_mono(font_data, bitmap, glyph_data);
     else
-       copy_glyph_color(font_data, face, glyph_data);
+       copy_glyph_color(font_data, bitmap, glyph_data);
+}
+
+
+/* Copies the glyphs the worker has finished to the pages. */
+static void store_async_glyphs(ALLEGRO_TTF_FONT_DATA *font_data)
+{
+    TTF_ASYNC *async = font_data->async;
+    _AL_VECTOR results;
+    unsigned i;
+
+    al_lock_mutex(ttf_worker.mutex);
+    results = async->results;
+    _al_vector_init(&async->results, sizeof(TTF_RASTERIZED_GLYPH));
+    _al_store_release(&async->have_results, 0);
+    al_unlock_mutex(ttf_worker.mutex);
+
+    for (i = 0; i < _al_vector_size(&results); i++) {
+       TTF_RASTERIZED_GLYPH *r = _al_vector_ref(&results, i);
+       ALLEGRO_TTF_GLYPH_DATA *glyph;
+
+       get_glyph(font_data, r->ft_index, &glyph);
+       glyph->pending = false;
+       if (!glyph->page_bitmap && glyph->region.x >= 0) {
+          store_glyph(font_data, r->ft_index, glyph, r->offset_x,
+             r->offset_y, r->advance, &r->bitmap, false);
+       }
+       al_free(r->bitmap.buffer);
+    }
+    unlock_current_page(font_data);
+    _al_vector_free(&results);
+
+    ALLEGRO_DEBUG("Stored %d asynchronously rasterized glyphs.\n",
+       (int)i);
+}
+
+
+static void queue_glyph(ALLEGRO_TTF_FONT_DATA *font_data, int ft_index,
+   ALLEGRO_TTF_GLYPH_DATA *glyph)
+{
+    TTF_GLYPH_JOB *job;
+
+    al_lock_mutex(ttf_worker.mutex);
+    job = _al_vector_alloc_back(&ttf_worker.jobs);
+    job->data = font_data;
+    job->ft_index = ft_index;
+    al_signal_cond(ttf_worker.work_cond);
+    al_unlock_mutex(ttf_worker.mutex);
+
+    glyph->pending = true;
+}
+
+
+static void rasterize_glyph_now(ALLEGRO_TTF_FONT_DATA *font_data,
+   FT_Face face, int ft_index, ALLEGRO_TTF_GLYPH_DATA *glyph,
+   bool lock_whole_page)
+{
+    FT_Error e;
+
+    lock_face(font_data->ttf_face);
+    FT_Activate_Size(font_data->size);
+    e = load_glyph(face, font_data->flags, ft_index);
+    if (e) {
+       ALLEGRO_WARN("Failed loading glyph %d from.\n", ft_index);
+    }
+
+    store_glyph(font_data, ft_index, glyph, face->glyph->bitmap_left,
+       (face->size->metrics.ascender >> 6) - face->glyph->bitmap_top,
+       face->glyph->advance.x >> 6, &face->glyph->bitmap, lock_whole_page);
 
     if (!lock_whole_page) {
        unlock_current_page(font_data);
     }
+    unlock_face(font_data->ttf_face);
+}
+
+
+/* Returns false if the glyph isn't ready yet, which only happens with
+ * asynchronous rasterization.  Its advance and region are zero then.
+ *
+ * NOTE: this function may disable the bitmap hold drawing state
+ * and leave the current page bitmap locked.
+ * 
+ * NOTE: We have previously tried to be more clever about caching multiple
+ * glyphs during incidental cache misses, but found that approach to be slower.
+ */
+static bool cache_glyph(ALLEGRO_TTF_FONT_DATA *font_data, FT_Face face,
+   int ft_index, ALLEGRO_TTF_GLYPH_DATA *glyph, bool lock_whole_page)
+{
+    if (font_data->async && !lock_whole_page &&
+          _al_load_acquire(&font_data->async->have_results)) {
+        lock_face(font_data->ttf_face);
+        store_async_glyphs(font_data);
+        unlock_face(font_data->ttf_face);
+    }
+
+    if (glyph->page_bitmap || glyph->region.x < 0)
+        return true;
+   
+    /* We shouldn't ever get here, as cache misses
+     * should have been set to ft_index = 0. */
+    ASSERT(!(font_data->skip_cache_misses && !lock_whole_page));
+
+    if (font_data->async && !lock_whole_page) {
+       if (!glyph->pending)
+          queue_glyph(font_data, ft_index, glyph);
+       return false;
+    }
+
+    al_profile_begin("ttf cache_glyph");
+    rasterize_glyph_now(font_data, face, ft_index, glyph, lock_whole_page);
+    al_profile_end();
+    return true;
 }
 
-/* WARNING: It is only valid to call this function when the current page is empty
- * (or already locked), otherwise it will gibberify the current glyphs on that page.
+/* Locking the whole page at once is only valid while the current page is
+ * empty (or already locked), otherwise it would gibberify the current glyphs
+ * on that page.  With shared pages other sizes may have put glyphs there
+ * already, so those are locked glyph by glyph instead.
  * 
  * This leaves the current page unlocked.
  */
@@ -477,26 +914,57 @@ static void cache_glyphs(ALLEGRO_TTF_FONT_DATA *data, const char *text, size_t t
    ALLEGRO_USTR_INFO info;
    const ALLEGRO_USTR* ustr = al_ref_buffer(&info, text, text_size);
    FT_Face face = data->face;
+   bool lock_whole_page = _al_vector_is_empty(&data->pages->page_bitmaps);
    int pos = 0;
    int32_t ch;  
 
+   lock_face(data->ttf_face);
    while ((ch = al_ustr_get_next(ustr, &pos)) >= 0) {
       ALLEGRO_TTF_GLYPH_DATA *glyph;
       int ft_index = FT_Get_Char_Index(face, ch);
       get_glyph(data, ft_index, &glyph);
-      cache_glyph(data, face, ft_index, glyph, true);
+      if (!glyph->page_bitmap && glyph->region.x >= 0)
+         rasterize_glyph_now(data, face, ft_index, glyph, lock_whole_page);
    }
+   unlock_face(data->ttf_face);
 }
 
 
-static int get_kerning(ALLEGRO_TTF_FONT_DATA const *data, FT_Face face,
+static int get_kerning(ALLEGRO_TTF_FONT_DATA *data, FT_Face face,
    int prev_ft_index, int ft_index)
 {
    /* Do kerning? */
-   if (!(data->flags & ALLEGRO_TTF_NO_KERNING) && prev_ft_index != -1) {
+   if (!(data->flags & ALLEGRO_TTF_NO_KERNING) && prev_ft_index != -1 &&
+         FT_HAS_KERNING(face)) {
+      TTF_KERNING_ENTRY *e = NULL;
       FT_Vector delta;
+
+      if (!data->kerning_cache) {
+         data->kerning_cache =
+            al_malloc(KERNING_CACHE_SIZE * sizeof(TTF_KERNING_ENTRY));
+         if (data->kerning_cache) {
+            memset(data->kerning_cache, 0xff,
+               KERNING_CACHE_SIZE * sizeof(TTF_KERNING_ENTRY));
+         }
+      }
+
+      /* Direct mapped, a pair simply replaces whatever was in its slot. */
+      if (data->kerning_cache && prev_ft_index < 0xffff && ft_index < 0xffff) {
+         uint32_t pair = (uint32_t)prev_ft_index << 16 | ft_index;
+         e = &data->kerning_cache[(hash_codepoint(pair) >> 16) &
+            (KERNING_CACHE_SIZE - 1)];
+         if (e->pair == pair)
+            return e->kerning;
+         e->pair = pair;
+      }
+
+      lock_face(data->ttf_face);
+      FT_Activate_Size(data->size);
       FT_Get_Kerning(face, prev_ft_index, ft_index,
          FT_KERNING_DEFAULT, &delta);
+      unlock_face(data->ttf_face);
+      if (e)
+         e->kerning = delta.x >> 6;
       return delta.x >> 6;
    }
 
@@ -504,14 +972,15 @@ static int get_kerning(ALLEGRO_TTF_FONT_DATA const *data, FT_Face face,
 }
 
 
-static bool ttf_get_glyph_worker(ALLEGRO_FONT const *f, int prev_ft_index, int ft_index, int prev_codepoint, int codepoint, ALLEGRO_GLYPH *info)
+static bool ttf_get_glyph_worker(ALLEGRO_FONT const *f, int prev_ft_index, int prev_codepoint, int codepoint, ALLEGRO_GLYPH *info)
 {
    ALLEGRO_TTF_FONT_DATA *data = f->data;
    FT_Face face = data->face;
    ALLEGRO_TTF_GLYPH_DATA *glyph;
+   int ft_index;
    int advance = 0;
 
-   if (!get_glyph(data, ft_index, &glyph)) {
+   if (!get_char_glyph(data, codepoint, &ft_index, &glyph)) {
       if (f->fallback)
          return f->fallback->vtable->get_glyph(f->fallback, prev_codepoint, codepoint, info);
       else {
@@ -520,7 +989,8 @@ static bool ttf_get_glyph_worker(ALLEGRO_FONT const *f, int prev_ft_index, int f
       }
    }
 
-   cache_glyph(data, face, ft_index, glyph, false);
+   if (!cache_glyph(data, face, ft_index, glyph, false) && f->fallback)
+      return f->fallback->vtable->get_glyph(f->fallback, prev_codepoint, codepoint, info);
 
    advance += get_kerning(data, face, prev_ft_index, ft_index);
 
@@ -553,19 +1023,17 @@ static bool ttf_get_glyph_worker(ALLEGRO_FONT const *f, int prev_ft_index, int f
 static bool ttf_get_glyph(ALLEGRO_FONT const *f, int prev_codepoint, int codepoint, ALLEGRO_GLYPH *glyph)
 {
    ALLEGRO_TTF_FONT_DATA *data = f->data;
-   FT_Face face = data->face;
-   int prev_ft_index = (prev_codepoint == -1) ? -1 : (int)FT_Get_Char_Index(face, prev_codepoint);
-   int ft_index = FT_Get_Char_Index(face, codepoint);
-   return ttf_get_glyph_worker(f, prev_ft_index, ft_index, prev_codepoint, codepoint, glyph);
+   int prev_ft_index = (prev_codepoint == -1) ? -1 : get_char_index(data, prev_codepoint);
+   return ttf_get_glyph_worker(f, prev_ft_index, prev_codepoint, codepoint, glyph);
 }
 
 
 static int render_glyph(ALLEGRO_FONT const *f, ALLEGRO_COLOR color,
-   int prev_ft_index, int ft_index, int32_t prev_ch, int32_t ch, float xpos, float ypos)
+   int prev_ft_index, int32_t prev_ch, int32_t ch, float xpos, float ypos)
 {
    ALLEGRO_GLYPH glyph;
 
-   if (ttf_get_glyph_worker(f, prev_ft_index, ft_index, prev_ch, ch, &glyph) == false)
+   if (ttf_get_glyph_worker(f, prev_ft_index, prev_ch, ch, &glyph) == false)
       return 0;
 
    if (glyph.bitmap != NULL) {
@@ -592,41 +1060,33 @@ static int ttf_font_height(ALLEGRO_FONT const *f)
 static int ttf_font_ascent(ALLEGRO_FONT const *f)
 {
     ALLEGRO_TTF_FONT_DATA *data;
-    FT_Face face;
 
     ASSERT(f);
 
     data = f->data;
-    face = data->face;
 
-    return face->size->metrics.ascender >> 6;
+    return data->size->metrics.ascender >> 6;
 }
 
 
 static int ttf_font_descent(ALLEGRO_FONT const *f)
 {
     ALLEGRO_TTF_FONT_DATA *data;
-    FT_Face face;
 
     ASSERT(f);
 
     data = f->data;
-    face = data->face;
 
-    return (-face->size->metrics.descender) >> 6;
+    return (-data->size->metrics.descender) >> 6;
 }
 
 
 static int ttf_render_char(ALLEGRO_FONT const *f, ALLEGRO_COLOR color,
    int ch, float xpos, float ypos)
 {
-   ALLEGRO_TTF_FONT_DATA *data = f->data;
-   FT_Face face = data->face;
    int advance = 0;
-   int32_t ch32 = (int32_t) ch;
 
-   int ft_index = FT_Get_Char_Index(face, ch32);
-   advance = render_glyph(f, color, -1, ft_index, -1, ch, xpos, ypos);
+   advance = render_glyph(f, color, -1, -1, ch, xpos, ypos);
 
    return advance;
 }
@@ -638,8 +1098,8 @@ static int ttf_char_length(ALLEGRO_FONT const *f, int ch)
    ALLEGRO_TTF_FONT_DATA *data = f->data;
    ALLEGRO_TTF_GLYPH_DATA *glyph;
    FT_Face face = data->face;
-   int ft_index = FT_Get_Char_Index(face, ch);
-   if (!get_glyph(data, ft_index, &glyph)) {
+   int ft_index;
+   if (!get_char_glyph(data, ch, &ft_index, &glyph)) {
       if (f->fallback) {
          return al_get_glyph_width(f, ch);
       }
@@ -648,7 +1108,11 @@ static int ttf_char_length(ALLEGRO_FONT const *f, int ch)
          ft_index = 0;
       }
    }
-   cache_glyph(data, face, ft_index, glyph, false);
+   if (!cache_glyph(data, face, ft_index, glyph, false)) {
+      if (f->fallback)
+         return al_get_glyph_width(f->fallback, ch);
+      return 0;
+   }
    result = glyph->region.w - 2;
 
    return result;
@@ -659,23 +1123,26 @@ static int ttf_render(ALLEGRO_FONT const *f, ALLEGRO_COLOR color,
    const ALLEGRO_USTR *text, float x, float y)
 {
    ALLEGRO_TTF_FONT_DATA *data = f->data;
-   FT_Face face = data->face;
+   int32_t chars[DECODE_CHUNK];
    int pos = 0;
    int advance = 0;
    int prev_ft_index = -1;
    int32_t prev_ch = -1;
    int32_t ch;
+   int i, n;
    bool hold;
 
    hold = al_is_bitmap_drawing_held();
    al_hold_bitmap_drawing(true);
 
-   while ((ch = al_ustr_get_next(text, &pos)) >= 0) {
-      int ft_index = FT_Get_Char_Index(face, ch);
-      advance += render_glyph(f, color, prev_ft_index, ft_index, prev_ch, ch,
-         x + advance, y);
-      prev_ft_index = ft_index;
-      prev_ch = ch;
+   while ((n = al_ustr_decode_to_array(text, &pos, chars, DECODE_CHUNK)) > 0) {
+      for (i = 0; i < n; i++) {
+         ch = chars[i];
+         advance += render_glyph(f, color, prev_ft_index, prev_ch, ch,
+            x + advance, y);
+         prev_ft_index = get_char_index(data, ch);
+         prev_ch = ch;
+      }
    }
 
    al_hold_bitmap_drawing(hold);
@@ -686,18 +1153,24 @@ static int ttf_render(ALLEGRO_FONT const *f, ALLEGRO_COLOR color,
 
 static int ttf_text_length(ALLEGRO_FONT const *f, const ALLEGRO_USTR *text)
 {
+   int32_t chars[DECODE_CHUNK];
    int pos = 0;
    int x = 0;
-   int32_t ch, nch;
-
-   nch = al_ustr_get_next(text, &pos);
-   while (nch >= 0) {
-      ch = nch;
-      nch = al_ustr_get_next(text, &pos);
+   int32_t ch = -1;
+   int i, n;
 
-      x += al_get_glyph_advance(f, ch, nch < 0 ?
-         ALLEGRO_NO_KERNING : nch);
+   /* The advance of each character depends on the next one for kerning,
+    * so the last character of a chunk is measured with the next chunk.
+    */
+   while ((n = al_ustr_decode_to_array(text, &pos, chars, DECODE_CHUNK)) > 0) {
+      for (i = 0; i < n; i++) {
+         if (ch >= 0)
+            x += al_get_glyph_advance(f, ch, chars[i]);
+         ch = chars[i];
+      }
    }
+   if (ch >= 0)
+      x += al_get_glyph_advance(f, ch, ALLEGRO_NO_KERNING);
 
    return x;
 }
@@ -756,7 +1229,7 @@ static void ttf_get_text_dimensions(ALLEGRO_FONT const *f,
 static void debug_cache(ALLEGRO_FONT *f)
 {
    ALLEGRO_TTF_FONT_DATA *data = f->data;
-   _AL_VECTOR *v = &data->page_bitmaps;
+   _AL_VECTOR *v = &data->pages->page_bitmaps;
    static int j = 0;
    int i;
 
@@ -773,28 +1246,413 @@ static void debug_cache(ALLEGRO_FONT *f)
 #endif
 
 
-static void ttf_destroy(ALLEGRO_FONT *f)
+static void set_face_size(FT_Face face, int w, int h)
 {
-   ALLEGRO_TTF_FONT_DATA *data = f->data;
-   int i;
+    if (h > 0) {
+       FT_Set_Pixel_Sizes(face, w, h);
+    }
+    else {
+       /* Set the "real dimension" of the font to be the passed size,
+        * in pixels.
+        */
+       FT_Size_RequestRec req;
+       ASSERT(w <= 0);
+       ASSERT(h <= 0);
+       req.type = FT_SIZE_REQUEST_TYPE_REAL_DIM;
+       req.width = (-w) << 6;
+       req.height = (-h) << 6;
+       req.horiResolution = 0;
+       req.vertResolution = 0;
+       FT_Request_Size(face, &req);
+    }
+}
 
-   unlock_current_page(data);
 
-#ifdef DEBUG_CACHE
-   debug_cache(f);
+static void set_sdf_spread(FT_Library library)
+{
+#ifdef TTF_HAVE_SDF
+   FT_Int spread = SDF_SPREAD;
+   FT_Property_Set(library, "sdf", "spread", &spread);
+   FT_Property_Set(library, "bsdf", "spread", &spread);
+#else
+   (void)library;
 #endif
+}
+
+
+static void rasterize_glyph(FT_Face face, int flags, int ft_index,
+   TTF_RASTERIZED_GLYPH *r)
+{
+   FT_Bitmap const *src;
+   int pitch;
+   int y;
+
+   memset(r, 0, sizeof *r);
+   r->ft_index = ft_index;
+
+   if (load_glyph(face, flags, ft_index)) {
+      ALLEGRO_WARN("Failed loading glyph %d from.\n", ft_index);
+      return;
+   }
+
+   src = &face->glyph->bitmap;
+   r->offset_x = face->glyph->bitmap_left;
+   r->offset_y = (face->size->metrics.ascender >> 6) - face->glyph->bitmap_top;
+   r->advance = face->glyph->advance.x >> 6;
+
+   pitch = src->pitch < 0 ? -src->pitch : src->pitch;
+   r->bitmap = *src;
+   r->bitmap.pitch = pitch;
+   r->bitmap.buffer = al_malloc(pitch * src->rows + 1);
+   if (!r->bitmap.buffer) {
+      r->bitmap.width = 0;
+      r->bitmap.rows = 0;
+      return;
+   }
+   for (y = 0; y < (int)src->rows; y++) {
+      memcpy(r->bitmap.buffer + pitch * y, src->buffer + src->pitch * y,
+         pitch);
+   }
+}
+
+
+static void *ttf_worker_proc(ALLEGRO_THREAD *thread, void *arg)
+{
+   (void)thread;
+   (void)arg;
+
+   al_lock_mutex(ttf_worker.mutex);
+   while (!ttf_worker.quit) {
+      TTF_GLYPH_JOB job;
+      TTF_RASTERIZED_GLYPH r;
+      TTF_ASYNC *async;
+
+      if (_al_vector_is_empty(&ttf_worker.jobs)) {
+         al_wait_cond(ttf_worker.work_cond, ttf_worker.mutex);
+         continue;
+      }
+      job = *(TTF_GLYPH_JOB *)_al_vector_ref_front(&ttf_worker.jobs);
+      _al_vector_delete_at(&ttf_worker.jobs, 0);
+      ttf_worker.busy = job.data;
+      al_unlock_mutex(ttf_worker.mutex);
+
+      /* The font can't go away while it is busy. */
+      async = job.data->async;
+      rasterize_glyph(async->face, job.data->flags, job.ft_index, &r);
+
+      al_lock_mutex(ttf_worker.mutex);
+      *(TTF_RASTERIZED_GLYPH *)_al_vector_alloc_back(&async->results) = r;
+      _al_store_release(&async->have_results, 1);
+      /* Cached layouts left the glyph out.  Laying them out again stores
+       * the results, as drawing them does not look at the font.
+       */
+      _al_font_invalidate_layout_cache();
+      ttf_worker.busy = NULL;
+      al_broadcast_cond(ttf_worker.done_cond);
+   }
+   al_unlock_mutex(ttf_worker.mutex);
+
+   return NULL;
+}
+
+
+static bool start_worker(void)
+{
+   if (ttf_worker.thread)
+      return true;
+
+   ttf_worker.mutex = al_create_mutex();
+   ttf_worker.work_cond = al_create_cond();
+   ttf_worker.done_cond = al_create_cond();
+   _al_vector_init(&ttf_worker.jobs, sizeof(TTF_GLYPH_JOB));
+   ttf_worker.quit = false;
+   if (ttf_worker.mutex && ttf_worker.work_cond && ttf_worker.done_cond)
+      ttf_worker.thread = al_create_thread(ttf_worker_proc, NULL);
+
+   if (!ttf_worker.thread) {
+      ALLEGRO_ERROR("Failed to start the glyph rasterizer thread.\n");
+      al_destroy_mutex(ttf_worker.mutex);
+      al_destroy_cond(ttf_worker.work_cond);
+      al_destroy_cond(ttf_worker.done_cond);
+      memset(&ttf_worker, 0, sizeof ttf_worker);
+      return false;
+   }
+   al_start_thread(ttf_worker.thread);
+   return true;
+}
+
+
+static void stop_worker(void)
+{
+   if (!ttf_worker.thread)
+      return;
+
+   al_lock_mutex(ttf_worker.mutex);
+   ttf_worker.quit = true;
+   al_broadcast_cond(ttf_worker.work_cond);
+   al_unlock_mutex(ttf_worker.mutex);
+
+   al_join_thread(ttf_worker.thread, NULL);
+   al_destroy_thread(ttf_worker.thread);
+   al_destroy_mutex(ttf_worker.mutex);
+   al_destroy_cond(ttf_worker.work_cond);
+   al_destroy_cond(ttf_worker.done_cond);
+   _al_vector_free(&ttf_worker.jobs);
+   memset(&ttf_worker, 0, sizeof ttf_worker);
+}
+
+
+static unsigned long async_ftread(FT_Stream stream, unsigned long offset,
+    unsigned char *buffer, unsigned long count)
+{
+    TTF_ASYNC *async = stream->pathname.pointer;
+    unsigned long bytes;
+
+    if (count == 0)
+       return 0;
+
+    if (offset != async->offset)
+       al_fseek(async->file, async->base_offset + offset, ALLEGRO_SEEK_SET);
+    bytes = al_fread(async->file, buffer, count);
+    async->offset = offset + bytes;
+    return bytes;
+}
+
+
+static void async_ftclose(FT_Stream stream)
+{
+    TTF_ASYNC *async = stream->pathname.pointer;
+    al_fclose(async->file);
+    async->file = NULL;
+}
+
+
+/* Opens the face for the worker, from a new handle of the file as a font
+ * loaded from a memory file or similar has nothing else to go by.
+ */
+static TTF_ASYNC *create_async(ALLEGRO_TTF_FONT_DATA *data,
+   char const *filename, int w, int h)
+{
+   TTF_ASYNC *async;
+   ALLEGRO_FILE *file = filename ? al_fopen(filename, "rb") : NULL;
+   FT_Open_Args args;
+
+   if (!file) {
+      ALLEGRO_WARN("Can't reopen %s, rasterizing its glyphs synchronously.\n",
+         filename ? filename : "a font loaded from an open file");
+      return NULL;
+   }
+   if (!start_worker()) {
+      al_fclose(file);
+      return NULL;
+   }
+
+   async = al_calloc(1, sizeof *async);
+   if (FT_Init_FreeType(&async->library) != 0) {
+      al_fclose(file);
+      al_free(async);
+      return NULL;
+   }
+   set_sdf_spread(async->library);
+
+   async->file = file;
+   async->base_offset = data->ttf_face->base_offset;
+   async->stream.read = async_ftread;
+   async->stream.close = async_ftclose;
+   async->stream.pathname.pointer = async;
+   async->stream.size = data->ttf_face->stream.size;
+   al_fseek(file, async->base_offset, ALLEGRO_SEEK_SET);
+
+   memset(&args, 0, sizeof args);
+   args.flags = FT_OPEN_STREAM;
+   args.stream = &async->stream;
+   if (FT_Open_Face(async->library, &args, 0, &async->face) != 0) {
+      ALLEGRO_WARN("Reopening %s failed, rasterizing its glyphs "
+         "synchronously.\n", filename);
+      /* Freetype already closed the file. */
+      FT_Done_FreeType(async->library);
+      al_free(async);
+      return NULL;
+   }
+   set_face_size(async->face, w, h);
+   _al_vector_init(&async->results, sizeof(TTF_RASTERIZED_GLYPH));
+
+   return async;
+}
+
+
+static void destroy_async(ALLEGRO_TTF_FONT_DATA *data)
+{
+   TTF_ASYNC *async = data->async;
+   int i;
+
+   al_lock_mutex(ttf_worker.mutex);
+   for (i = _al_vector_size(&ttf_worker.jobs) - 1; i >= 0; i--) {
+      TTF_GLYPH_JOB *job = _al_vector_ref(&ttf_worker.jobs, i);
+      if (job->data == data)
+         _al_vector_delete_at(&ttf_worker.jobs, i);
+   }
+   while (ttf_worker.busy == data)
+      al_wait_cond(ttf_worker.done_cond, ttf_worker.mutex);
+   al_unlock_mutex(ttf_worker.mutex);
+
+   for (i = 0; i < (int)_al_vector_size(&async->results); i++) {
+      TTF_RASTERIZED_GLYPH *r = _al_vector_ref(&async->results, i);
+      al_free(r->bitmap.buffer);
+   }
+   _al_vector_free(&async->results);
+   FT_Done_Face(async->face);
+   FT_Done_FreeType(async->library);
+   al_free(async);
+   data->async = NULL;
+}
+
+
+static TTF_PAGES *create_pages(TTF_PAGES const *params)
+{
+   TTF_PAGES *pages = al_calloc(1, sizeof *pages);
+
+   _al_vector_init(&pages->page_bitmaps, sizeof(ALLEGRO_BITMAP*));
+   pages->bitmap_format = params->bitmap_format;
+   pages->bitmap_flags = params->bitmap_flags;
+   pages->min_page_size = params->min_page_size;
+   pages->max_page_size = params->max_page_size;
+   pages->refcount = 1;
+   return pages;
+}
+
+
+/* Returns the pages small sizes of the face share for these parameters,
+ * creating them on the first use.
+ */
+static TTF_PAGES *get_shared_pages(TTF_FACE *ttf_face,
+   TTF_PAGES const *params)
+{
+   TTF_PAGES **back;
+   unsigned i;
+
+   for (i = 0; i < _al_vector_size(&ttf_face->shared_pages); i++) {
+      TTF_PAGES **pages = _al_vector_ref(&ttf_face->shared_pages, i);
+      if ((*pages)->bitmap_format == params->bitmap_format &&
+            (*pages)->bitmap_flags == params->bitmap_flags &&
+            (*pages)->min_page_size == params->min_page_size &&
+            (*pages)->max_page_size == params->max_page_size) {
+         (*pages)->refcount++;
+         return *pages;
+      }
+   }
+
+   back = _al_vector_alloc_back(&ttf_face->shared_pages);
+   *back = create_pages(params);
+   return *back;
+}
+
+
+static void clear_pages(TTF_PAGES *pages)
+{
+   int i;
+
+   for (i = _al_vector_size(&pages->page_bitmaps) - 1; i >= 0; i--) {
+      ALLEGRO_BITMAP **bmp = _al_vector_ref(&pages->page_bitmaps, i);
+      al_destroy_bitmap(*bmp);
+   }
+   _al_vector_free(&pages->page_bitmaps);
+
+   pages->page_pos_x = 0;
+   pages->page_pos_y = 0;
+   pages->page_line_height = 0;
+}
+
+
+static void release_pages(TTF_FACE *ttf_face, TTF_PAGES *pages)
+{
+   if (--pages->refcount > 0)
+      return;
+   clear_pages(pages);
+   _al_vector_find_and_delete(&ttf_face->shared_pages, &pages);
+   al_free(pages);
+}
+
+
+static void free_glyphs(ALLEGRO_TTF_FONT_DATA *data)
+{
+   int i;
+
+   clear_char_cache(data);
 
-   FT_Done_Face(data->face);
    for (i = _al_vector_size(&data->glyph_ranges) - 1; i >= 0; i--) {
       ALLEGRO_TTF_GLYPH_RANGE *range = _al_vector_ref(&data->glyph_ranges, i);
       al_free(range->glyphs);
    }
    _al_vector_free(&data->glyph_ranges);
-   for (i = _al_vector_size(&data->page_bitmaps) - 1; i >= 0; i--) {
-      ALLEGRO_BITMAP **bmp = _al_vector_ref(&data->page_bitmaps, i);
-      al_destroy_bitmap(*bmp);
+}
+
+
+/* Gives the font other pages.  The old ones are kept until the font is
+ * destroyed if they have any glyphs, as text layouts may still refer to
+ * them.
+ */
+static void retire_pages(ALLEGRO_TTF_FONT_DATA *data, TTF_PAGES *pages)
+{
+   unlock_current_page(data);
+
+   if (_al_vector_is_empty(&data->pages->page_bitmaps)) {
+      release_pages(data->ttf_face, data->pages);
+   }
+   else {
+      TTF_PAGES **back = _al_vector_alloc_back(&data->retired_pages);
+      *back = data->pages;
+   }
+   data->pages = pages;
+}
+
+
+static void release_face(TTF_FACE *ttf_face)
+{
+   al_lock_mutex(faces_mutex);
+   if (--ttf_face->refcount > 0) {
+      al_unlock_mutex(faces_mutex);
+      return;
+   }
+   if (ttf_face->key) {
+      _al_vector_find_and_delete(&ttf_faces, &ttf_face);
+      al_free(ttf_face->key);
+   }
+   /* This closes the file. */
+   FT_Done_Face(ttf_face->face);
+   al_unlock_mutex(faces_mutex);
+
+   _al_vector_free(&ttf_face->shared_pages);
+   al_destroy_mutex(ttf_face->mutex);
+   al_free(ttf_face);
+}
+
+
+static void ttf_destroy(ALLEGRO_FONT *f)
+{
+   ALLEGRO_TTF_FONT_DATA *data = f->data;
+   unsigned i;
+
+   lock_face(data->ttf_face);
+   unlock_current_page(data);
+
+#ifdef DEBUG_CACHE
+   debug_cache(f);
+#endif
+
+   if (data->async)
+      destroy_async(data);
+   free_glyphs(data);
+   release_pages(data->ttf_face, data->pages);
+   for (i = 0; i < _al_vector_size(&data->retired_pages); i++) {
+      TTF_PAGES **pages = _al_vector_ref(&data->retired_pages, i);
+      release_pages(data->ttf_face, *pages);
    }
-   _al_vector_free(&data->page_bitmaps);
+   FT_Done_Size(data->size);
+   unlock_face(data->ttf_face);
+   _al_vector_free(&data->retired_pages);
+   release_face(data->ttf_face);
+   al_free(data->kerning_cache);
    al_free(data);
    al_free(f);
 }
@@ -803,27 +1661,146 @@ static void ttf_destroy(ALLEGRO_FONT *f)
 static unsigned long ftread(FT_Stream stream, unsigned long offset,
     unsigned char *buffer, unsigned long count)
 {
-    ALLEGRO_TTF_FONT_DATA *data = stream->pathname.pointer;
+    TTF_FACE *ttf_face = stream->pathname.pointer;
     unsigned long bytes;
 
     if (count == 0)
        return 0;
 
-    if (offset != data->offset)
-       al_fseek(data->file, data->base_offset + offset, ALLEGRO_SEEK_SET);
-    bytes = al_fread(data->file, buffer, count);
-    data->offset = offset + bytes;
+    if (offset != ttf_face->offset)
+       al_fseek(ttf_face->file, ttf_face->base_offset + offset,
+          ALLEGRO_SEEK_SET);
+    bytes = al_fread(ttf_face->file, buffer, count);
+    ttf_face->offset = offset + bytes;
     return bytes;
 }
 
 
 static void ftclose(FT_Stream  stream)
 {
-    ALLEGRO_TTF_FONT_DATA *data = stream->pathname.pointer;
-    al_fclose(data->file);
-    data->file = NULL;
+    TTF_FACE *ttf_face = stream->pathname.pointer;
+    al_fclose(ttf_face->file);
+    ttf_face->file = NULL;
+}
+
+
+/* Returns the key fonts loaded from the file share their face by: the
+ * absolute path, as canonical as al_make_path_canonical makes it, and the
+ * file interface, as the same path may mean different files to different
+ * ones.
+ */
+static char *get_face_key(char const *filename)
+{
+    ALLEGRO_PATH *path = al_create_path(filename);
+    char *cwd = al_get_current_directory();
+    ALLEGRO_USTR *us;
+    char *key;
+
+    if (!path) {
+       al_free(cwd);
+       return NULL;
+    }
+    if (cwd) {
+       ALLEGRO_PATH *head = al_create_path_for_directory(cwd);
+       al_rebase_path(head, path);
+       al_destroy_path(head);
+       al_free(cwd);
+    }
+    al_make_path_canonical(path);
+
+    us = al_ustr_newf("%p:%s", (void *)al_get_new_file_interface(),
+       al_path_cstr(path, '/'));
+    al_destroy_path(path);
+    key = al_cstr_dup(us);
+    al_ustr_free(us);
+    return key;
 }
 
+
+/* Fonts loaded with the same key share one face, like the SDF stores.
+ * Only al_load_ttf_font passes a key: a file handle passed to
+ * al_load_ttf_font_f belongs to its font.  Takes over the file either way.
+ */
+static TTF_FACE *open_face(ALLEGRO_FILE *file, char const *filename,
+    char const *key)
+{
+    TTF_FACE *ttf_face;
+    ALLEGRO_PATH *path;
+    FT_Open_Args args;
+    int result;
+    unsigned i;
+
+    al_lock_mutex(faces_mutex);
+
+    if (key) {
+       for (i = 0; i < _al_vector_size(&ttf_faces); i++) {
+          TTF_FACE **shared = _al_vector_ref(&ttf_faces, i);
+          if (!strcmp((*shared)->key, key)) {
+             /* FreeType reads from the file of the first font. */
+             al_fclose(file);
+             (*shared)->refcount++;
+             al_unlock_mutex(faces_mutex);
+             return *shared;
+          }
+       }
+    }
+
+    ttf_face = al_calloc(1, sizeof *ttf_face);
+    ttf_face->stream.read = ftread;
+    ttf_face->stream.close = ftclose;
+    ttf_face->stream.pathname.pointer = ttf_face;
+    ttf_face->base_offset = al_ftell(file);
+    ttf_face->stream.size = al_fsize(file);
+    ttf_face->file = file;
+
+    memset(&args, 0, sizeof args);
+    args.flags = FT_OPEN_STREAM;
+    args.stream = &ttf_face->stream;
+
+    if ((result = FT_Open_Face(ft, &args, 0, &ttf_face->face)) != 0) {
+        ALLEGRO_ERROR("Reading %s failed. Freetype error code %d\n", filename,
+          result);
+        // Note: Freetype already closed the file for us.
+        al_free(ttf_face);
+        al_unlock_mutex(faces_mutex);
+        return NULL;
+    }
+
+    // FIXME: The below doesn't use Allegro's streaming.
+    /* Small hack for Type1 fonts which store kerning information in
+     * a separate file - and we try to guess the name of that file.
+     */
+    path = al_create_path(filename);
+    if (!strcmp(al_get_path_extension(path), ".pfa")) {
+        const char *helper;
+        ALLEGRO_DEBUG("Type1 font assumed for %s.\n", filename);
+
+        al_set_path_extension(path, ".afm");
+        helper = al_path_cstr(path, '/');
+        FT_Attach_File(ttf_face->face, helper);
+        ALLEGRO_DEBUG("Guessed afm file %s.\n", helper);
+
+        al_set_path_extension(path, ".tfm");
+        helper = al_path_cstr(path, '/');
+        FT_Attach_File(ttf_face->face, helper);
+        ALLEGRO_DEBUG("Guessed tfm file %s.\n", helper);
+    }
+    al_destroy_path(path);
+
+    _al_vector_init(&ttf_face->shared_pages, sizeof(TTF_PAGES *));
+    ttf_face->refcount = 1;
+    if (key) {
+       ttf_face->mutex = al_create_mutex_recursive();
+       ttf_face->key = al_malloc(strlen(key) + 1);
+       strcpy(ttf_face->key, key);
+       *(TTF_FACE **)_al_vector_alloc_back(&ttf_faces) = ttf_face;
+    }
+
+    al_unlock_mutex(faces_mutex);
+    return ttf_face;
+}
+
+
 /* Function: al_load_ttf_font_f
  */
 ALLEGRO_FONT *al_load_ttf_font_f(ALLEGRO_FILE *file,
@@ -833,17 +1810,19 @@ ALLEGRO_FONT *al_load_ttf_font_f(ALLEGRO_FILE *file,
 }
 
 
-/* Function: al_load_ttf_font_stretch_f
+/* Loads the face into a new font using the normal vtable, without
+ * registering a destructor for it.
  */
-ALLEGRO_FONT *al_load_ttf_font_stretch_f(ALLEGRO_FILE *file,
-    char const *filename, int w, int h, int flags)
+static ALLEGRO_FONT *load_face(ALLEGRO_FILE *file,
+    char const *filename, char const *key, int w, int h, int flags)
 {
     FT_Face face;
     ALLEGRO_TTF_FONT_DATA *data;
     ALLEGRO_FONT *f;
-    ALLEGRO_PATH *path;
-    FT_Open_Args args;
-    int result;
+    TTF_FACE *ttf_face;
+    TTF_PAGES params;
+    int pixel_size;
+    int shared_pages_max_size = 0;
     ALLEGRO_CONFIG* system_cfg = al_get_system_config();
     const char* min_page_size_str =
       al_get_config_value(system_cfg, "ttf", "min_page_size");
@@ -853,35 +1832,53 @@ ALLEGRO_FONT *al_load_ttf_font_stretch_f(ALLEGRO_FILE *file,
       al_get_config_value(system_cfg, "ttf", "cache_text");
     const char* skip_cache_misses_str =
       al_get_config_value(system_cfg, "ttf", "skip_cache_misses");
+    const char* async_str =
+      al_get_config_value(system_cfg, "ttf", "async_cache_misses");
+    const char* shared_pages_str =
+      al_get_config_value(system_cfg, "ttf", "shared_pages_max_size");
 
     if ((h > 0 && w < 0) || (h < 0 && w > 0)) {
        ALLEGRO_ERROR("Height/width have opposite signs (w = %d, h = %d).\n", w, h);
        return NULL;
     }
 
+    ttf_face = open_face(file, filename, key);
+    if (!ttf_face)
+       return NULL;
+    face = ttf_face->face;
+
     data = al_calloc(1, sizeof *data);
-    data->stream.read = ftread;
-    data->stream.close = ftclose;
-    data->stream.pathname.pointer = data;
-    data->base_offset = al_ftell(file);
-    data->stream.size = al_fsize(file);
-    data->file = file;
-    data->bitmap_format = al_get_new_bitmap_format();
-    data->bitmap_flags = al_get_new_bitmap_flags();
-    data->min_page_size = 256;
-    data->max_page_size = 8192;
+    data->ttf_face = ttf_face;
+    data->face = face;
+    lock_face(ttf_face);
+    if (FT_New_Size(face, &data->size) != 0) {
+       ALLEGRO_ERROR("Failed to create a size for %s.\n", filename);
+       unlock_face(ttf_face);
+       release_face(ttf_face);
+       al_free(data);
+       return NULL;
+    }
+    FT_Activate_Size(data->size);
+
+    memset(&params, 0, sizeof params);
+    params.bitmap_format = al_get_new_bitmap_format();
+    params.bitmap_flags = al_get_new_bitmap_flags();
+    if (flags & ALLEGRO_TTF_SDF)
+       params.bitmap_flags |= ALLEGRO_MIN_LINEAR | ALLEGRO_MAG_LINEAR;
+    params.min_page_size = 256;
+    params.max_page_size = 8192;
 
     if (min_page_size_str) {
       int min_page_size = atoi(min_page_size_str);
       if (min_page_size > 0) {
-         data->min_page_size = min_page_size;
+         params.min_page_size = min_page_size;
       }
     }
 
     if (max_page_size_str) {
       int max_page_size = atoi(max_page_size_str);
-      if (max_page_size > 0 && max_page_size >= data->min_page_size) {
-         data->max_page_size = max_page_size;
+      if (max_page_size > 0 && max_page_size >= params.min_page_size) {
+         params.max_page_size = max_page_size;
       }
     }
 
@@ -889,82 +1886,650 @@ ALLEGRO_FONT *al_load_ttf_font_stretch_f(ALLEGRO_FILE *file,
        data->skip_cache_misses = true;
     }
 
-    memset(&args, 0, sizeof args);
-    args.flags = FT_OPEN_STREAM;
-    args.stream = &data->stream;
+    if (shared_pages_str) {
+       shared_pages_max_size = atoi(shared_pages_str);
+    }
 
-    if ((result = FT_Open_Face(ft, &args, 0, &face)) != 0) {
-        ALLEGRO_ERROR("Reading %s failed. Freetype error code %d\n", filename,
-          result);
-        // Note: Freetype already closed the file for us.
-        al_free(data);
-        return NULL;
+    set_face_size(face, w, h);
+
+    ALLEGRO_DEBUG("Font %s loaded with pixel size %d x %d.\n", filename,
+        w, h);
+    ALLEGRO_DEBUG("    ascent=%.1f, descent=%.1f, height=%.1f\n",
+        face->size->metrics.ascender / 64.0,
+        face->size->metrics.descender / 64.0,
+        face->size->metrics.height / 64.0);
+
+    data->flags = flags;
+
+    /* Only other sizes of a shared face can use the shared pages. */
+    pixel_size = h != 0 ? abs(h) : abs(w);
+    if (ttf_face->key && pixel_size <= shared_pages_max_size) {
+       data->pages = get_shared_pages(ttf_face, &params);
+       ALLEGRO_DEBUG("    glyphs go on pages shared with %d other sizes\n",
+          data->pages->refcount - 1);
+    }
+    else {
+       data->pages = create_pages(&params);
     }
 
-    // FIXME: The below doesn't use Allegro's streaming.
-    /* Small hack for Type1 fonts which store kerning information in
-     * a separate file - and we try to guess the name of that file.
-     */
-    path = al_create_path(filename);
-    if (!strcmp(al_get_path_extension(path), ".pfa")) {
-        const char *helper;
-        ALLEGRO_DEBUG("Type1 font assumed for %s.\n", filename);
+    if (async_str && !strcmp(async_str, "true") && !data->skip_cache_misses) {
+       data->async = create_async(data, filename, w, h);
+    }
+
+    _al_vector_init(&data->glyph_ranges, sizeof(ALLEGRO_TTF_GLYPH_RANGE));
+    _al_vector_init(&data->retired_pages, sizeof(TTF_PAGES *));
+
+    if (data->skip_cache_misses) {
+       cache_glyphs(data, "\0", 1);
+    }
+    if (cache_str) {
+       cache_glyphs(data, cache_str, strlen(cache_str));
+    }
+    unlock_current_page(data);
+    unlock_face(ttf_face);
+
+    f = al_calloc(sizeof *f, 1);
+    f->height = data->size->metrics.height >> 6;
+    f->vtable = &vt;
+    f->data = data;
+
+    return f;
+}
+
+
+static void destroy_sdf_shader(void *shader)
+{
+   ASSERT(shader == sdf_shader);
+   al_destroy_shader(shader);
+   sdf_shader = NULL;
+}
+
+
+/* The fields of the glyphs are drawn with bilinear filtering, and this
+ * turns the filtered distance into coverage over about one screen pixel,
+ * whatever the scale.
+ */
+#ifdef ALLEGRO_CFG_SHADER_GLSL
+static const char *sdf_pixel_source =
+   "#ifdef GL_ES\n"
+   "#extension GL_OES_standard_derivatives : enable\n"
+   "precision mediump float;\n"
+   "#endif\n"
+   "uniform sampler2D " ALLEGRO_SHADER_VAR_TEX ";\n"
+   "uniform sampler2D " ALLEGRO_SHADER_VAR_TEX "1;\n"
+   "uniform sampler2D " ALLEGRO_SHADER_VAR_TEX "2;\n"
+   "uniform sampler2D " ALLEGRO_SHADER_VAR_TEX "3;\n"
+   "uniform bool sdf_premultiplied;\n"
+   "varying vec4 varying_color;\n"
+   "varying vec2 varying_texcoord;\n"
+   "varying float varying_tex_index;\n"
+   "\n"
+   "void main()\n"
+   "{\n"
+   "  float d;\n"
+   "  float a;\n"
+   "  if (varying_tex_index < 0.5)\n"
+   "    d = texture2D(" ALLEGRO_SHADER_VAR_TEX ", varying_texcoord).a;\n"
+   "  else if (varying_tex_index < 1.5)\n"
+   "    d = texture2D(" ALLEGRO_SHADER_VAR_TEX "1, varying_texcoord).a;\n"
+   "  else if (varying_tex_index < 2.5)\n"
+   "    d = texture2D(" ALLEGRO_SHADER_VAR_TEX "2, varying_texcoord).a;\n"
+   "  else\n"
+   "    d = texture2D(" ALLEGRO_SHADER_VAR_TEX "3, varying_texcoord).a;\n"
+   "  a = clamp((d - 0.5) / max(fwidth(d), 1e-4) + 0.5, 0.0, 1.0);\n"
+   "  if (sdf_premultiplied)\n"
+   "    gl_FragColor = varying_color * a;\n"
+   "  else\n"
+   "    gl_FragColor = vec4(varying_color.rgb, varying_color.a * a);\n"
+   "}\n";
+#endif
+
+
+/* Returns the shader drawing distance fields onto the target bitmap, or NULL
+ * if there is none and the raw fields have to be drawn instead.
+ */
+static ALLEGRO_SHADER *get_sdf_shader(ALLEGRO_BITMAP *target)
+{
+#ifdef ALLEGRO_CFG_SHADER_GLSL
+   ALLEGRO_DISPLAY *display;
+   ALLEGRO_SHADER *shader;
+   const char *vertex_source;
+
+   if (!target || (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP))
+      return NULL;
+   display = _al_get_bitmap_display(target);
+   if (!display || !(al_get_display_flags(display) & ALLEGRO_OPENGL) ||
+         !(al_get_display_flags(display) & ALLEGRO_PROGRAMMABLE_PIPELINE))
+      return NULL;
+   if (sdf_shader || sdf_shader_failed)
+      return sdf_shader;
+
+   /* The shader is destroyed through the destructor registered below, which
+    * also forgets the global.
+    */
+   _al_push_destructor_owner();
+   shader = al_create_shader(ALLEGRO_SHADER_GLSL);
+   _al_pop_destructor_owner();
+   if (!shader) {
+      sdf_shader_failed = true;
+      return NULL;
+   }
+
+   vertex_source = al_get_default_shader_source(ALLEGRO_SHADER_GLSL,
+      ALLEGRO_VERTEX_SHADER);
+   if (!vertex_source ||
+         !al_attach_shader_source(shader, ALLEGRO_VERTEX_SHADER,
+            vertex_source) ||
+         !al_attach_shader_source(shader, ALLEGRO_PIXEL_SHADER,
+            sdf_pixel_source) ||
+         !al_build_shader(shader)) {
+      ALLEGRO_ERROR("Failed to build the distance field shader: %s\n",
+         al_get_shader_log(shader));
+      al_destroy_shader(shader);
+      sdf_shader_failed = true;
+      return NULL;
+   }
+
+   sdf_shader = shader;
+   sdf_shader_dtor_item = _al_register_destructor(_al_dtor_list,
+      "ttf_sdf_shader", shader, destroy_sdf_shader);
+   return sdf_shader;
+#else
+   (void)target;
+   return NULL;
+#endif
+}
+
+
+static void begin_sdf_drawing(ALLEGRO_FONT const *f, SDF_DRAW_STATE *state)
+{
+   TTF_SDF_FONT_DATA *data = f->data;
+   ALLEGRO_BITMAP *target = al_get_target_bitmap();
+   ALLEGRO_SHADER *shader = get_sdf_shader(target);
+
+   state->held = al_is_bitmap_drawing_held();
+   state->shader_used = false;
+   state->prev_shader = NULL;
+
+   if (shader) {
+      /* Flush what was drawn with the previous shader. */
+      al_hold_bitmap_drawing(false);
+      state->prev_shader = target->shader;
+      if (al_use_shader(shader)) {
+         al_set_shader_bool("sdf_premultiplied",
+            !(data->flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA));
+         state->shader_used = true;
+      }
+   }
+
+   al_hold_bitmap_drawing(true);
+}
+
+
+static void end_sdf_drawing(SDF_DRAW_STATE *state)
+{
+   if (state->shader_used) {
+      al_hold_bitmap_drawing(false);
+      al_use_shader(state->prev_shader);
+   }
+   al_hold_bitmap_drawing(state->held);
+}
+
+
+/* Draws a glyph of some other font, with the shader it expects. */
+static int render_fallback_char(ALLEGRO_FONT const *f, SDF_DRAW_STATE *state,
+   ALLEGRO_COLOR color, int ch, float x, float y)
+{
+   ALLEGRO_SHADER *shader = get_sdf_shader(al_get_target_bitmap());
+   int advance;
+
+   if (!state->shader_used)
+      return f->fallback->vtable->render_char(f->fallback, color, ch, x, y);
+
+   al_hold_bitmap_drawing(false);
+   al_use_shader(state->prev_shader);
+   advance = f->fallback->vtable->render_char(f->fallback, color, ch, x, y);
+   al_hold_bitmap_drawing(false);
+   al_use_shader(shader);
+   al_set_shader_bool("sdf_premultiplied",
+      !(((TTF_SDF_FONT_DATA *)f->data)->flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA));
+   al_hold_bitmap_drawing(true);
+   return advance;
+}
+
+
+static int ttf_get_font_ranges(ALLEGRO_FONT *font, int ranges_count,
+   int *ranges);
+
+
+static ALLEGRO_TTF_FONT_DATA *sdf_base_data(ALLEGRO_FONT const *f)
+{
+   TTF_SDF_FONT_DATA *data = f->data;
+   return data->store->base->data;
+}
+
+
+static INLINE int sdf_round(float x)
+{
+   return (int)floorf(x + 0.5f);
+}
+
+
+/* Returns the glyph of the base font for the codepoint, or NULL if it is
+ * missing and should come from the fallback font.
+ */
+static ALLEGRO_TTF_GLYPH_DATA *sdf_get_base_glyph(ALLEGRO_FONT const *f,
+   int codepoint, int *ret_ft_index)
+{
+   ALLEGRO_TTF_FONT_DATA *base = sdf_base_data(f);
+   ALLEGRO_TTF_GLYPH_DATA *glyph;
+   int ft_index;
+
+   if (!get_char_glyph(base, codepoint, &ft_index, &glyph)) {
+      if (f->fallback)
+         return NULL;
+      get_glyph(base, 0, &glyph);
+      ft_index = 0;
+   }
+   if (!cache_glyph(base, base->face, ft_index, glyph, false) && f->fallback)
+      return NULL;
+   if (ret_ft_index)
+      *ret_ft_index = ft_index;
+   return glyph;
+}
+
+
+static int sdf_get_kerning(ALLEGRO_FONT const *f, int prev_ft_index,
+   int ft_index)
+{
+   TTF_SDF_FONT_DATA *data = f->data;
+   ALLEGRO_TTF_FONT_DATA *base = sdf_base_data(f);
+   FT_Vector delta;
+
+   if ((data->flags & ALLEGRO_TTF_NO_KERNING) || prev_ft_index < 0)
+      return 0;
+   lock_face(base->ttf_face);
+   FT_Get_Kerning(base->face, prev_ft_index, ft_index,
+      FT_KERNING_UNSCALED, &delta);
+   unlock_face(base->ttf_face);
+   return sdf_round(FT_MulFix(delta.x, base->size->metrics.x_scale)
+      / 64.0f * data->scale_x);
+}
+
+
+static bool sdf_get_glyph_worker(ALLEGRO_FONT const *f, int prev_ft_index,
+   int ft_index, ALLEGRO_TTF_GLYPH_DATA *glyph, ALLEGRO_GLYPH *info)
+{
+   TTF_SDF_FONT_DATA *data = f->data;
+   int kerning = sdf_get_kerning(f, prev_ft_index, ft_index);
+
+   if (glyph->page_bitmap) {
+      info->bitmap = glyph->page_bitmap;
+      info->x = glyph->region.x + 1;
+      info->y = glyph->region.y + 1;
+      info->w = glyph->region.w - 2;
+      info->h = glyph->region.h - 2;
+      info->offset_x = sdf_round(glyph->offset_x * data->scale_x);
+      info->offset_y = sdf_round(glyph->offset_y * data->scale_y);
+   }
+   else if (glyph->region.x > 0) {
+      ALLEGRO_ERROR("Glyph %d not on any page.\n", ft_index);
+      return false;
+   }
+   else {
+      info->bitmap = 0;
+   }
+
+   info->kerning = kerning;
+   info->advance = kerning + sdf_round(glyph->advance * data->scale_x);
+   return true;
+}
+
+
+/* The source region of the glyph is that of the distance field at the base
+ * size, everything else is scaled to the size of the font.
+ */
+static bool sdf_get_glyph(ALLEGRO_FONT const *f, int prev_codepoint,
+   int codepoint, ALLEGRO_GLYPH *info)
+{
+   ALLEGRO_TTF_FONT_DATA *base = sdf_base_data(f);
+   ALLEGRO_TTF_GLYPH_DATA *glyph;
+   int prev_ft_index = (prev_codepoint == -1) ? -1 :
+      get_char_index(base, prev_codepoint);
+   int ft_index;
+
+   glyph = sdf_get_base_glyph(f, codepoint, &ft_index);
+   if (!glyph)
+      return f->fallback->vtable->get_glyph(f->fallback, prev_codepoint,
+         codepoint, info);
+   return sdf_get_glyph_worker(f, prev_ft_index, ft_index, glyph, info);
+}
+
+
+static int sdf_render_glyph(ALLEGRO_FONT const *f, SDF_DRAW_STATE *state,
+   ALLEGRO_COLOR color, int prev_ft_index, int32_t ch, int *ret_ft_index,
+   float x, float y)
+{
+   TTF_SDF_FONT_DATA *data = f->data;
+   ALLEGRO_TTF_GLYPH_DATA *glyph;
+   ALLEGRO_GLYPH info;
+   int ft_index;
+
+   glyph = sdf_get_base_glyph(f, ch, &ft_index);
+   if (!glyph) {
+      *ret_ft_index = -1;
+      return render_fallback_char(f, state, color, ch, x, y);
+   }
+   *ret_ft_index = ft_index;
+
+   if (!sdf_get_glyph_worker(f, prev_ft_index, ft_index, glyph, &info))
+      return 0;
+
+   if (info.bitmap) {
+      /* Positioned unrounded, the fields don't need the pixel grid. */
+      al_draw_tinted_scaled_bitmap(info.bitmap, color,
+         info.x, info.y, info.w, info.h,
+         x + info.kerning + glyph->offset_x * data->scale_x,
+         y + glyph->offset_y * data->scale_y,
+         info.w * data->scale_x, info.h * data->scale_y, 0);
+   }
+
+   return info.advance;
+}
+
+
+static int sdf_font_height(ALLEGRO_FONT const *f)
+{
+   ASSERT(f);
+   return f->height;
+}
+
+
+static int sdf_font_ascent(ALLEGRO_FONT const *f)
+{
+   TTF_SDF_FONT_DATA *data = f->data;
+   return sdf_round(al_get_font_ascent(data->store->base) * data->scale_y);
+}
+
+
+static int sdf_font_descent(ALLEGRO_FONT const *f)
+{
+   TTF_SDF_FONT_DATA *data = f->data;
+   return sdf_round(al_get_font_descent(data->store->base) * data->scale_y);
+}
+
+
+static int sdf_render_char(ALLEGRO_FONT const *f, ALLEGRO_COLOR color,
+   int ch, float xpos, float ypos)
+{
+   SDF_DRAW_STATE state;
+   int ft_index;
+   int advance;
+
+   begin_sdf_drawing(f, &state);
+   advance = sdf_render_glyph(f, &state, color, -1, ch, &ft_index,
+      xpos, ypos);
+   end_sdf_drawing(&state);
+
+   return advance;
+}
+
+
+static int sdf_char_length(ALLEGRO_FONT const *f, int ch)
+{
+   TTF_SDF_FONT_DATA *data = f->data;
+   ALLEGRO_TTF_GLYPH_DATA *glyph = sdf_get_base_glyph(f, ch, NULL);
+
+   if (!glyph)
+      return al_get_glyph_width(f->fallback, ch);
+   if (glyph->region.w < 2 * SDF_SPREAD + 2)
+      return 0;
+   return sdf_round((glyph->region.w - 2 - 2 * SDF_SPREAD) * data->scale_x);
+}
+
+
+static int sdf_render(ALLEGRO_FONT const *f, ALLEGRO_COLOR color,
+   const ALLEGRO_USTR *text, float x, float y)
+{
+   SDF_DRAW_STATE state;
+   int pos = 0;
+   int advance = 0;
+   int prev_ft_index = -1;
+   int32_t ch;
+
+   begin_sdf_drawing(f, &state);
+
+   while ((ch = al_ustr_get_next(text, &pos)) >= 0) {
+      int ft_index;
+      advance += sdf_render_glyph(f, &state, color, prev_ft_index, ch,
+         &ft_index, x + advance, y);
+      prev_ft_index = ft_index;
+   }
+
+   end_sdf_drawing(&state);
+
+   return advance;
+}
+
+
+static int sdf_get_font_ranges(ALLEGRO_FONT *f, int ranges_count,
+   int *ranges)
+{
+   TTF_SDF_FONT_DATA *data = f->data;
+   return ttf_get_font_ranges(data->store->base, ranges_count, ranges);
+}
+
+
+/* The fields reach SDF_SPREAD pixels beyond the outline on every side, that
+ * is not part of the glyph's box.
+ */
+static bool sdf_get_glyph_dimensions(ALLEGRO_FONT const *f,
+   int codepoint, int *bbx, int *bby, int *bbw, int *bbh)
+{
+   TTF_SDF_FONT_DATA *data = f->data;
+   ALLEGRO_TTF_GLYPH_DATA *glyph = sdf_get_base_glyph(f, codepoint, NULL);
+   int w, h, pad;
+
+   if (!glyph)
+      return al_get_glyph_dimensions(f->fallback, codepoint,
+         bbx, bby, bbw, bbh);
+
+   if (glyph->region.w > 0) {
+      w = _ALLEGRO_MAX(glyph->region.w - 2 - 2 * SDF_SPREAD, 0);
+      h = _ALLEGRO_MAX(glyph->region.h - 2 - 2 * SDF_SPREAD, 0);
+      pad = SDF_SPREAD;
+   }
+   else {
+      w = h = pad = 0;
+   }
+   *bbx = sdf_round((glyph->offset_x + pad) * data->scale_x);
+   *bby = sdf_round((glyph->offset_y + pad) * data->scale_y);
+   *bbw = sdf_round(w * data->scale_x);
+   *bbh = sdf_round(h * data->scale_y);
+   return true;
+}
+
+
+static int sdf_get_glyph_advance(ALLEGRO_FONT const *f, int codepoint1,
+   int codepoint2)
+{
+   TTF_SDF_FONT_DATA *data = f->data;
+   ALLEGRO_TTF_FONT_DATA *base = sdf_base_data(f);
+   ALLEGRO_TTF_GLYPH_DATA *glyph;
+   int ft_index;
+   int kerning = 0;
+
+   if (codepoint1 == ALLEGRO_NO_KERNING)
+      return 0;
+
+   glyph = sdf_get_base_glyph(f, codepoint1, &ft_index);
+   if (!glyph)
+      return al_get_glyph_advance(f->fallback, codepoint1, codepoint2);
+
+   if (codepoint2 != ALLEGRO_NO_KERNING) {
+      kerning = sdf_get_kerning(f, ft_index,
+         get_char_index(base, codepoint2));
+   }
+
+   return sdf_round(glyph->advance * data->scale_x) + kerning;
+}
+
+
+static void sdf_destroy(ALLEGRO_FONT *f)
+{
+   TTF_SDF_FONT_DATA *data = f->data;
+   TTF_SDF_STORE *store = data->store;
+
+   al_lock_mutex(faces_mutex);
+   if (--store->refcount > 0) {
+      store = NULL;
+   }
+   else if (store->key) {
+      _al_vector_find_and_delete(&sdf_stores, &store);
+   }
+   al_unlock_mutex(faces_mutex);
+
+   if (store) {
+      ttf_destroy(store->base);
+      al_free(store->key);
+      al_free(store);
+   }
+   al_free(data);
+   al_free(f);
+}
+
+
+#ifdef TTF_HAVE_SDF
+static int get_sdf_size(void)
+{
+   const char *size_str = al_get_config_value(al_get_system_config(),
+      "ttf", "sdf_size");
+   int size = 64;
+
+   if (size_str && atoi(size_str) > 0)
+      size = atoi(size_str);
+   return size;
+}
+
+
+/* Stores are shared between fonts with the same face key, like the faces,
+ * and the same flags for the glyphs.  Call with faces_mutex held.
+ */
+static TTF_SDF_STORE *find_sdf_store(char const *key, int base_flags)
+{
+   unsigned i;
+
+   if (!key)
+      return NULL;
+
+   for (i = 0; i < _al_vector_size(&sdf_stores); i++) {
+      TTF_SDF_STORE **store = _al_vector_ref(&sdf_stores, i);
+      ALLEGRO_TTF_FONT_DATA *base = (*store)->base->data;
+      if (!strcmp((*store)->key, key) && base->flags == base_flags)
+         return *store;
+   }
+   return NULL;
+}
+#endif
+
+
+static ALLEGRO_FONT *load_sdf_font(ALLEGRO_FILE *file,
+    char const *filename, char const *key, int w, int h, int flags)
+{
+#ifdef TTF_HAVE_SDF
+   TTF_SDF_STORE *store;
+   TTF_SDF_FONT_DATA *data;
+   ALLEGRO_TTF_FONT_DATA *base;
+   ALLEGRO_FONT *f;
+   int sdf_size = get_sdf_size();
+   int base_flags = flags & ~ALLEGRO_TTF_NO_KERNING;
+   float sx, sy;
+
+   if ((h > 0 && w < 0) || (h < 0 && w > 0)) {
+      ALLEGRO_ERROR("Height/width have opposite signs (w = %d, h = %d).\n", w, h);
+      return NULL;
+   }
+   if (h == 0) {
+      ALLEGRO_ERROR("Invalid size for a distance field font.\n");
+      return NULL;
+   }
+
+   al_lock_mutex(faces_mutex);
+   store = find_sdf_store(key, base_flags);
+   if (store) {
+      /* FreeType reads from the file of the first font. */
+      al_fclose(file);
+   }
+   else {
+      store = al_calloc(1, sizeof *store);
+      store->base = load_face(file, filename, key, 0, sdf_size, base_flags);
+      if (!store->base) {
+         al_unlock_mutex(faces_mutex);
+         al_free(store);
+         return NULL;
+      }
+      if (key) {
+         store->key = al_malloc(strlen(key) + 1);
+         strcpy(store->key, key);
+         *(TTF_SDF_STORE **)_al_vector_alloc_back(&sdf_stores) = store;
+      }
+   }
+   store->refcount++;
+   al_unlock_mutex(faces_mutex);
+   base = store->base->data;
 
-        al_set_path_extension(path, ".afm");
-        helper = al_path_cstr(path, '/');
-        FT_Attach_File(face, helper);
-        ALLEGRO_DEBUG("Guessed afm file %s.\n", helper);
+   if (h > 0) {
+      sy = (float)h / sdf_size;
+      sx = w > 0 ? (float)w / sdf_size : sy;
+   }
+   else {
+      /* Scale by the "real dimension", as for normal fonts. */
+      int real_h = (base->size->metrics.ascender -
+         base->size->metrics.descender) >> 6;
+      sy = (float)-h / _ALLEGRO_MAX(real_h, 1);
+      sx = w < 0 ? (float)-w / _ALLEGRO_MAX(real_h, 1) : sy;
+   }
 
-        al_set_path_extension(path, ".tfm");
-        helper = al_path_cstr(path, '/');
-        FT_Attach_File(face, helper);
-        ALLEGRO_DEBUG("Guessed tfm file %s.\n", helper);
-    }
-    al_destroy_path(path);
+   data = al_calloc(1, sizeof *data);
+   data->store = store;
+   data->scale_x = sx;
+   data->scale_y = sy;
+   data->flags = flags;
 
-    if (h > 0) {
-       FT_Set_Pixel_Sizes(face, w, h);
-    }
-    else {
-       /* Set the "real dimension" of the font to be the passed size,
-        * in pixels.
-        */
-       FT_Size_RequestRec req;
-       ASSERT(w <= 0);
-       ASSERT(h <= 0);
-       req.type = FT_SIZE_REQUEST_TYPE_REAL_DIM;
-       req.width = (-w) << 6;
-       req.height = (-h) << 6;
-       req.horiResolution = 0;
-       req.vertResolution = 0;
-       FT_Request_Size(face, &req);
-    }
+   f = al_calloc(1, sizeof *f);
+   f->height = sdf_round(store->base->height * sy);
+   f->vtable = &sdf_vt;
+   f->data = data;
+   f->draws_own_glyphs = true;
 
-    ALLEGRO_DEBUG("Font %s loaded with pixel size %d x %d.\n", filename,
-        w, h);
-    ALLEGRO_DEBUG("    ascent=%.1f, descent=%.1f, height=%.1f\n",
-        face->size->metrics.ascender / 64.0,
-        face->size->metrics.descender / 64.0,
-        face->size->metrics.height / 64.0);
+   ALLEGRO_DEBUG("Distance field font %s at %d x %d, scale %.3f x %.3f.\n",
+      filename, w, h, sx, sy);
 
-    data->face = face;
-    data->flags = flags;
+   return f;
+#else
+   (void)key;
+   (void)w;
+   (void)h;
+   (void)flags;
+   ALLEGRO_ERROR("ALLEGRO_TTF_SDF needs FreeType 2.11 or newer (%s).\n",
+      filename);
+   al_fclose(file);
+   return NULL;
+#endif
+}
 
-    _al_vector_init(&data->glyph_ranges, sizeof(ALLEGRO_TTF_GLYPH_RANGE));
-    _al_vector_init(&data->page_bitmaps, sizeof(ALLEGRO_BITMAP*));
 
-    if (data->skip_cache_misses) {
-       cache_glyphs(data, "\0", 1);
-    }
-    if (cache_str) {
-       cache_glyphs(data, cache_str, strlen(cache_str));
-    }
-    unlock_current_page(data);
+static ALLEGRO_FONT *load_ttf_font(ALLEGRO_FILE *file,
+    char const *filename, char const *key, int w, int h, int flags)
+{
+    ALLEGRO_FONT *f;
 
-    f = al_calloc(sizeof *f, 1);
-    f->height = face->size->metrics.height >> 6;
-    f->vtable = &vt;
-    f->data = data;
+    if (flags & ALLEGRO_TTF_SDF)
+       f = load_sdf_font(file, filename, key, w, h, flags);
+    else
+       f = load_face(file, filename, key, w, h, flags);
+    if (!f)
+       return NULL;
 
     f->dtor_item = _al_register_destructor(_al_dtor_list, "ttf_font", f,
        (void (*)(void *))al_destroy_font);
@@ -973,6 +2538,15 @@ ALLEGRO_FONT *al_load_ttf_font_stretch_f(ALLEGRO_FILE *file,
 }
 
 
+/* Function: al_load_ttf_font_stretch_f
+ */
+ALLEGRO_FONT *al_load_ttf_font_stretch_f(ALLEGRO_FILE *file,
+    char const *filename, int w, int h, int flags)
+{
+    return load_ttf_font(file, filename, NULL, w, h, flags);
+}
+
+
 /* Function: al_load_ttf_font
  */
 ALLEGRO_FONT *al_load_ttf_font(char const *filename, int size, int flags)
@@ -988,6 +2562,7 @@ ALLEGRO_FONT *al_load_ttf_font_stretch(char const *filename, int w, int h,
 {
    ALLEGRO_FILE *f;
    ALLEGRO_FONT *font;
+   char *key;
    ASSERT(filename);
 
    f = al_fopen(filename, "rb");
@@ -1000,7 +2575,9 @@ ALLEGRO_FONT *al_load_ttf_font_stretch(char const *filename, int w, int h,
     * closed when the font is destroyed, in case Freetype has to load data
     * at a later time.
     */
-   font = al_load_ttf_font_stretch_f(f, filename, w, h, flags);
+   key = get_face_key(filename);
+   font = load_ttf_font(f, filename, key, w, h, flags);
+   al_free(key);
 
    return font;
 }
@@ -1011,8 +2588,10 @@ static int ttf_get_font_ranges(ALLEGRO_FONT *font, int ranges_count,
 {
    ALLEGRO_TTF_FONT_DATA *data = font->data;
    FT_UInt g;
-   FT_ULong unicode = FT_Get_First_Char(data->face, &g);
+   FT_ULong unicode;
    int i = 0;
+   lock_face(data->ttf_face);
+   unicode = FT_Get_First_Char(data->face, &g);
    if (i < ranges_count) {
       ranges[i * 2 + 0] = unicode;
       ranges[i * 2 + 1] = unicode;
@@ -1033,6 +2612,7 @@ static int ttf_get_font_ranges(ALLEGRO_FONT *font, int ranges_count,
       }
       unicode = unicode2;
    }
+   unlock_face(data->ttf_face);
    return i;
 }
 
@@ -1043,8 +2623,8 @@ static bool ttf_get_glyph_dimensions(ALLEGRO_FONT const *f,
    ALLEGRO_TTF_FONT_DATA *data = f->data;
    ALLEGRO_TTF_GLYPH_DATA *glyph;
    FT_Face face = data->face;
-   int ft_index = FT_Get_Char_Index(face, codepoint);
-   if (!get_glyph(data, ft_index, &glyph)) {
+   int ft_index;
+   if (!get_char_glyph(data, codepoint, &ft_index, &glyph)) {
       if (f->fallback) {
          return al_get_glyph_dimensions(f->fallback, codepoint,
             bbx, bby, bbw, bbh);
@@ -1054,7 +2634,14 @@ static bool ttf_get_glyph_dimensions(ALLEGRO_FONT const *f,
          ft_index = 0;
       }
    }
-   cache_glyph(data, face, ft_index, glyph, false);
+   if (!cache_glyph(data, face, ft_index, glyph, false)) {
+      if (f->fallback) {
+         return al_get_glyph_dimensions(f->fallback, codepoint,
+            bbx, bby, bbw, bbh);
+      }
+      *bbx = *bby = *bbw = *bbh = 0;
+      return true;
+   }
    *bbx = glyph->offset_x;
    *bbw = glyph->region.w - 2;
    *bbh = glyph->region.h - 2;
@@ -1068,7 +2655,7 @@ static int ttf_get_glyph_advance(ALLEGRO_FONT const *f, int codepoint1,
 {
    ALLEGRO_TTF_FONT_DATA *data = f->data;
    FT_Face face = data->face;
-   int ft_index = FT_Get_Char_Index(face, codepoint1);
+   int ft_index;
    ALLEGRO_TTF_GLYPH_DATA *glyph;
    int kerning = 0;
    int advance = 0;
@@ -1077,7 +2664,7 @@ static int ttf_get_glyph_advance(ALLEGRO_FONT const *f, int codepoint1,
       return 0;
    }
 
-   if (!get_glyph(data, ft_index, &glyph)) {
+   if (!get_char_glyph(data, codepoint1, &ft_index, &glyph)) {
       if (f->fallback) {
          return al_get_glyph_advance(f->fallback, codepoint1, codepoint2);
       }
@@ -1086,11 +2673,13 @@ static int ttf_get_glyph_advance(ALLEGRO_FONT const *f, int codepoint1,
          ft_index = 0;
       }
    }
-   cache_glyph(data, face, ft_index, glyph, false);
+   if (!cache_glyph(data, face, ft_index, glyph, false) && f->fallback) {
+      return al_get_glyph_advance(f->fallback, codepoint1, codepoint2);
+   }
 
    if (codepoint2 != ALLEGRO_NO_KERNING) {
-      int ft_index1 = FT_Get_Char_Index(face, codepoint1);
-      int ft_index2 = FT_Get_Char_Index(face, codepoint2);
+      int ft_index1 = get_char_index(data, codepoint1);
+      int ft_index2 = get_char_index(data, codepoint2);
       kerning = get_kerning(data, face, ft_index1, ft_index2);
    }
 
@@ -1099,6 +2688,489 @@ static int ttf_get_glyph_advance(ALLEGRO_FONT const *f, int codepoint1,
 }
 
 
+/* Returns the data of the font holding the glyphs, NULL if it is no
+ * TTF font.
+ */
+static ALLEGRO_TTF_FONT_DATA *get_glyph_cache(ALLEGRO_FONT *font)
+{
+   if (font->vtable == &vt)
+      return font->data;
+   if (font->vtable == &sdf_vt)
+      return sdf_base_data(font);
+   ALLEGRO_WARN("Not a TTF font.\n");
+   return NULL;
+}
+
+
+/* Function: al_prewarm_ttf_glyphs
+ */
+bool al_prewarm_ttf_glyphs(ALLEGRO_FONT *font, int ranges_n,
+   const int ranges[])
+{
+   ALLEGRO_TTF_FONT_DATA *data;
+   int i;
+   ASSERT(font);
+   ASSERT(ranges_n == 0 || ranges);
+
+   data = get_glyph_cache(font);
+   if (!data)
+      return false;
+
+   lock_face(data->ttf_face);
+   for (i = 0; i < ranges_n; i++) {
+      int ch;
+      for (ch = ranges[i * 2]; ch <= ranges[i * 2 + 1]; ch++) {
+         ALLEGRO_TTF_GLYPH_DATA *glyph;
+         int ft_index = FT_Get_Char_Index(data->face, ch);
+
+         /* Missing codepoints would all be the replacement glyph. */
+         if (ft_index == 0)
+            continue;
+         get_glyph(data, ft_index, &glyph);
+         if (!glyph->page_bitmap && glyph->region.x >= 0)
+            rasterize_glyph_now(data, data->face, ft_index, glyph, false);
+      }
+   }
+   unlock_face(data->ttf_face);
+
+   return true;
+}
+
+
+/* The glyph cache format, all numbers are little endian:
+ *
+ *    "A5GC", int32 version
+ *    int32 flags, num_glyphs, x_scale, y_scale of the face
+ *    int16 length + bytes of the family name, then of the style name
+ *    int32 number of pages, page_pos_x, page_pos_y, page_line_height
+ *    per page: int32 width, height, then the ABGR_8888_LE pixels
+ *    int32 number of glyphs
+ *    per glyph: int32 ft_index, page (-1 for empty glyphs),
+ *       int16 x, y, w, h, offset_x, offset_y, advance
+ *
+ * The header identifies the face and size the glyphs were rasterized for.
+ */
+#define GLYPH_CACHE_MAGIC     "A5GC"
+#define GLYPH_CACHE_VERSION   1
+#define GLYPH_CACHE_FLAGS     (ALLEGRO_TTF_MONOCHROME | ALLEGRO_TTF_NO_AUTOHINT \
+   | ALLEGRO_TTF_SDF | ALLEGRO_NO_PREMULTIPLIED_ALPHA)
+#define GLYPH_CACHE_MAX_PAGE  16384
+#define GLYPH_CACHE_MAX_NAME  255
+
+
+static void write_name(ALLEGRO_FILE *f, const char *name)
+{
+   size_t len = name ? strlen(name) : 0;
+   if (len > GLYPH_CACHE_MAX_NAME)
+      len = GLYPH_CACHE_MAX_NAME;
+   al_fwrite16le(f, len);
+   al_fwrite(f, name, len);
+}
+
+
+static bool check_name(ALLEGRO_FILE *f, const char *name)
+{
+   size_t len = name ? strlen(name) : 0;
+   int16_t saved = al_fread16le(f);
+   char buf[GLYPH_CACHE_MAX_NAME];
+
+   if (len > GLYPH_CACHE_MAX_NAME)
+      len = GLYPH_CACHE_MAX_NAME;
+   if (saved < 0 || (size_t)saved != len)
+      return false;
+   if (al_fread(f, buf, len) != len)
+      return false;
+   return len == 0 || memcmp(buf, name, len) == 0;
+}
+
+
+static void write_cache_header(ALLEGRO_FILE *f, ALLEGRO_TTF_FONT_DATA *data)
+{
+   FT_Face face = data->face;
+
+   al_fwrite(f, GLYPH_CACHE_MAGIC, 4);
+   al_fwrite32le(f, GLYPH_CACHE_VERSION);
+   al_fwrite32le(f, data->flags & GLYPH_CACHE_FLAGS);
+   al_fwrite32le(f, face->num_glyphs);
+   al_fwrite32le(f, data->size->metrics.x_scale);
+   al_fwrite32le(f, data->size->metrics.y_scale);
+   write_name(f, face->family_name);
+   write_name(f, face->style_name);
+}
+
+
+static bool check_cache_header(ALLEGRO_FILE *f, ALLEGRO_TTF_FONT_DATA *data)
+{
+   FT_Face face = data->face;
+   char magic[4];
+
+   if (al_fread(f, magic, 4) != 4 || memcmp(magic, GLYPH_CACHE_MAGIC, 4)) {
+      ALLEGRO_WARN("Not a glyph cache.\n");
+      return false;
+   }
+   if (al_fread32le(f) != GLYPH_CACHE_VERSION) {
+      ALLEGRO_WARN("Unsupported glyph cache version.\n");
+      return false;
+   }
+   if (al_fread32le(f) != (data->flags & GLYPH_CACHE_FLAGS) ||
+         al_fread32le(f) != face->num_glyphs ||
+         al_fread32le(f) != data->size->metrics.x_scale ||
+         al_fread32le(f) != data->size->metrics.y_scale ||
+         !check_name(f, face->family_name) ||
+         !check_name(f, face->style_name)) {
+      ALLEGRO_WARN("The glyph cache is for a different font, size or "
+         "flags.\n");
+      return false;
+   }
+   return true;
+}
+
+
+static bool save_glyph_cache(ALLEGRO_TTF_FONT_DATA *data, ALLEGRO_FILE *f)
+{
+   int num_glyphs = 0;
+   unsigned i, j;
+
+   unlock_current_page(data);
+
+   write_cache_header(f, data);
+   al_fwrite32le(f, _al_vector_size(&data->pages->page_bitmaps));
+   al_fwrite32le(f, data->pages->page_pos_x);
+   al_fwrite32le(f, data->pages->page_pos_y);
+   al_fwrite32le(f, data->pages->page_line_height);
+
+   for (i = 0; i < _al_vector_size(&data->pages->page_bitmaps); i++) {
+      ALLEGRO_BITMAP **page = _al_vector_ref(&data->pages->page_bitmaps, i);
+      int w = al_get_bitmap_width(*page);
+      int h = al_get_bitmap_height(*page);
+      ALLEGRO_LOCKED_REGION *lr;
+      int y;
+
+      al_fwrite32le(f, w);
+      al_fwrite32le(f, h);
+      lr = al_lock_bitmap(*page, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+         ALLEGRO_LOCK_READONLY);
+      if (!lr) {
+         ALLEGRO_ERROR("Failed to lock glyph page %d.\n", i);
+         return false;
+      }
+      for (y = 0; y < h; y++)
+         al_fwrite(f, (char *)lr->data + y * lr->pitch, w * 4);
+      al_unlock_bitmap(*page);
+   }
+
+   for (i = 0; i < _al_vector_size(&data->glyph_ranges); i++) {
+      ALLEGRO_TTF_GLYPH_RANGE *range = _al_vector_ref(&data->glyph_ranges, i);
+      for (j = 0; j < RANGE_SIZE; j++) {
+         ALLEGRO_TTF_GLYPH_DATA *glyph = &range->glyphs[j];
+         if (glyph->page_bitmap || glyph->region.x < 0)
+            num_glyphs++;
+      }
+   }
+   al_fwrite32le(f, num_glyphs);
+
+   for (i = 0; i < _al_vector_size(&data->glyph_ranges); i++) {
+      ALLEGRO_TTF_GLYPH_RANGE *range = _al_vector_ref(&data->glyph_ranges, i);
+      for (j = 0; j < RANGE_SIZE; j++) {
+         ALLEGRO_TTF_GLYPH_DATA *glyph = &range->glyphs[j];
+         if (!glyph->page_bitmap && glyph->region.x >= 0)
+            continue;
+         al_fwrite32le(f, range->range_start + j);
+         al_fwrite32le(f, glyph->page_bitmap ?
+            _al_vector_find(&data->pages->page_bitmaps, &glyph->page_bitmap) : -1);
+         al_fwrite16le(f, glyph->region.x);
+         al_fwrite16le(f, glyph->region.y);
+         al_fwrite16le(f, glyph->region.w);
+         al_fwrite16le(f, glyph->region.h);
+         al_fwrite16le(f, glyph->offset_x);
+         al_fwrite16le(f, glyph->offset_y);
+         al_fwrite16le(f, glyph->advance);
+      }
+   }
+
+   return !al_ferror(f);
+}
+
+
+/* Function: al_save_ttf_glyph_cache_f
+ */
+bool al_save_ttf_glyph_cache_f(ALLEGRO_FONT *font, ALLEGRO_FILE *f)
+{
+   ALLEGRO_TTF_FONT_DATA *data;
+   bool ret;
+   ASSERT(font);
+   ASSERT(f);
+
+   data = get_glyph_cache(font);
+   if (!data)
+      return false;
+
+   /* Shared pages may be filled by other threads meanwhile. */
+   lock_face(data->ttf_face);
+   ret = save_glyph_cache(data, f);
+   unlock_face(data->ttf_face);
+   return ret;
+}
+
+
+/* Function: al_save_ttf_glyph_cache
+ */
+bool al_save_ttf_glyph_cache(ALLEGRO_FONT *font, const char *filename)
+{
+   ALLEGRO_FILE *f;
+   bool ret;
+   ASSERT(filename);
+
+   f = al_fopen(filename, "wb");
+   if (!f) {
+      ALLEGRO_ERROR("Unable to open file for writing: %s\n", filename);
+      return false;
+   }
+   ret = al_save_ttf_glyph_cache_f(font, f);
+   if (!al_fclose(f))
+      ret = false;
+   return ret;
+}
+
+
+/* A glyph read from a cache, applied to the font once all are read. */
+typedef struct CACHE_GLYPH
+{
+   int ft_index;
+   int page;
+   REGION region;
+   short offset_x;
+   short offset_y;
+   short advance;
+} CACHE_GLYPH;
+
+
+static bool read_cache_pages(ALLEGRO_FILE *f, TTF_PAGES *pages, int num_pages)
+{
+   int i, y;
+
+   for (i = 0; i < num_pages; i++) {
+      int w = al_fread32le(f);
+      int h = al_fread32le(f);
+      ALLEGRO_BITMAP *page;
+      ALLEGRO_LOCKED_REGION *lr;
+      bool ok = true;
+
+      if (al_feof(f) || w <= 0 || h <= 0 || w > GLYPH_CACHE_MAX_PAGE ||
+            h > GLYPH_CACHE_MAX_PAGE || w > pages->max_page_size ||
+            h > pages->max_page_size)
+         return false;
+      page = add_page(pages, w, h);
+      if (!page)
+         return false;
+      lr = al_lock_bitmap(page, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+         ALLEGRO_LOCK_WRITEONLY);
+      if (!lr)
+         return false;
+      for (y = 0; y < h && ok; y++) {
+         ok = al_fread(f, (char *)lr->data + y * lr->pitch, w * 4)
+            == (size_t)w * 4;
+      }
+      al_unlock_bitmap(page);
+      if (!ok)
+         return false;
+   }
+
+   return true;
+}
+
+
+static bool read_cache_glyphs(ALLEGRO_FILE *f, ALLEGRO_TTF_FONT_DATA *data,
+   TTF_PAGES *pages, CACHE_GLYPH **glyphs_ret, int *num_glyphs_ret)
+{
+   int num_glyphs = al_fread32le(f);
+   int num_pages = _al_vector_size(&pages->page_bitmaps);
+   CACHE_GLYPH *glyphs;
+   int i;
+
+   if (al_feof(f) || num_glyphs < 0 || num_glyphs > data->face->num_glyphs)
+      return false;
+   glyphs = al_calloc(num_glyphs + 1, sizeof *glyphs);
+   if (!glyphs)
+      return false;
+
+   for (i = 0; i < num_glyphs; i++) {
+      CACHE_GLYPH *g = &glyphs[i];
+      REGION *r = &g->region;
+
+      g->ft_index = al_fread32le(f);
+      g->page = al_fread32le(f);
+      r->x = al_fread16le(f);
+      r->y = al_fread16le(f);
+      r->w = al_fread16le(f);
+      r->h = al_fread16le(f);
+      g->offset_x = al_fread16le(f);
+      g->offset_y = al_fread16le(f);
+      g->advance = al_fread16le(f);
+      if (al_feof(f) || g->ft_index < 0 ||
+            g->ft_index >= data->face->num_glyphs ||
+            g->page < -1 || g->page >= num_pages)
+         goto fail;
+
+      /* Empty glyphs are marked by a negative x, see store_glyph. */
+      if (g->page < 0) {
+         if (r->x >= 0)
+            goto fail;
+      }
+      else {
+         ALLEGRO_BITMAP **bmp = _al_vector_ref(&pages->page_bitmaps, g->page);
+         if (r->x < 0 || r->y < 0 || r->w <= 0 || r->h <= 0 ||
+               r->x + r->w > al_get_bitmap_width(*bmp) ||
+               r->y + r->h > al_get_bitmap_height(*bmp))
+            goto fail;
+      }
+   }
+
+   if (al_ferror(f))
+      goto fail;
+
+   *glyphs_ret = glyphs;
+   *num_glyphs_ret = num_glyphs;
+   return true;
+
+fail:
+   al_free(glyphs);
+   return false;
+}
+
+
+/* New glyphs are packed where the saved cache left off, so the position
+ * must be on the last page, behind all glyphs already there.
+ */
+static bool check_cache_position(TTF_PAGES *pages, const CACHE_GLYPH *glyphs,
+   int num_glyphs)
+{
+   int num_pages = _al_vector_size(&pages->page_bitmaps);
+   int x = pages->page_pos_x;
+   int y = pages->page_pos_y;
+   int line_height = pages->page_line_height;
+   ALLEGRO_BITMAP **last;
+   int i;
+
+   if (x < 0 || y < 0 || line_height < 0)
+      return false;
+   if (num_pages == 0)
+      return x == 0 && y == 0 && line_height == 0;
+
+   last = _al_vector_ref_back(&pages->page_bitmaps);
+   if (x > al_get_bitmap_width(*last) ||
+         y + line_height > al_get_bitmap_height(*last))
+      return false;
+
+   for (i = 0; i < num_glyphs; i++) {
+      const REGION *r = &glyphs[i].region;
+      if (glyphs[i].page != num_pages - 1)
+         continue;
+      /* Either on a line above, or on the current one left of x. */
+      if (r->y + r->h <= y)
+         continue;
+      if (r->y >= y && r->y + r->h <= y + line_height && r->x + r->w <= x)
+         continue;
+      return false;
+   }
+
+   return true;
+}
+
+
+static bool load_glyph_cache(ALLEGRO_TTF_FONT_DATA *data, ALLEGRO_FILE *f)
+{
+   TTF_PAGES *pages;
+   CACHE_GLYPH *glyphs = NULL;
+   int num_pages, num_glyphs, i;
+
+   if (!check_cache_header(f, data))
+      return false;
+
+   /* Everything is read and checked before the font is touched. */
+   pages = create_pages(data->pages);
+   num_pages = al_fread32le(f);
+   pages->page_pos_x = al_fread32le(f);
+   pages->page_pos_y = al_fread32le(f);
+   pages->page_line_height = al_fread32le(f);
+
+   if (al_feof(f) || num_pages < 0 || num_pages > data->face->num_glyphs ||
+         !read_cache_pages(f, pages, num_pages) ||
+         !read_cache_glyphs(f, data, pages, &glyphs, &num_glyphs) ||
+         !check_cache_position(pages, glyphs, num_glyphs)) {
+      ALLEGRO_ERROR("Corrupt glyph cache.\n");
+      al_free(glyphs);
+      release_pages(data->ttf_face, pages);
+      return false;
+   }
+
+   free_glyphs(data);
+   retire_pages(data, pages);
+
+   for (i = 0; i < num_glyphs; i++) {
+      const CACHE_GLYPH *g = &glyphs[i];
+      ALLEGRO_TTF_GLYPH_DATA *glyph;
+
+      get_glyph(data, g->ft_index, &glyph);
+      if (g->page >= 0) {
+         ALLEGRO_BITMAP **bmp = _al_vector_ref(&pages->page_bitmaps, g->page);
+         glyph->page_bitmap = *bmp;
+      }
+      glyph->region = g->region;
+      glyph->offset_x = g->offset_x;
+      glyph->offset_y = g->offset_y;
+      glyph->advance = g->advance;
+   }
+   al_free(glyphs);
+
+   ALLEGRO_DEBUG("Loaded glyph cache with %d pages.\n", num_pages);
+   return true;
+}
+
+
+/* Function: al_load_ttf_glyph_cache_f
+ */
+bool al_load_ttf_glyph_cache_f(ALLEGRO_FONT *font, ALLEGRO_FILE *f)
+{
+   ALLEGRO_TTF_FONT_DATA *data;
+   bool ret;
+   ASSERT(font);
+   ASSERT(f);
+
+   data = get_glyph_cache(font);
+   if (!data)
+      return false;
+
+   lock_face(data->ttf_face);
+   ret = load_glyph_cache(data, f);
+   unlock_face(data->ttf_face);
+
+   /* Cached layouts still draw the old glyphs. */
+   if (ret)
+      _al_font_clear_layout_cache();
+   return ret;
+}
+
+
+/* Function: al_load_ttf_glyph_cache
+ */
+bool al_load_ttf_glyph_cache(ALLEGRO_FONT *font, const char *filename)
+{
+   ALLEGRO_FILE *f;
+   bool ret;
+   ASSERT(filename);
+
+   f = al_fopen(filename, "rb");
+   if (!f) {
+      ALLEGRO_ERROR("Unable to open file for reading: %s\n", filename);
+      return false;
+   }
+   ret = al_load_ttf_glyph_cache_f(font, f);
+   al_fclose(f);
+   return ret;
+}
+
+
 
 /* Function: al_init_ttf_addon
  */
@@ -1110,6 +3182,7 @@ bool al_init_ttf_addon(void)
    }
 
    FT_Init_FreeType(&ft);
+   faces_mutex = al_create_mutex_recursive();
    vt.font_height = ttf_font_height;
    vt.font_ascent = ttf_font_ascent;
    vt.font_descent = ttf_font_descent;
@@ -1124,6 +3197,22 @@ bool al_init_ttf_addon(void)
    vt.get_glyph_advance = ttf_get_glyph_advance;
    vt.get_glyph = ttf_get_glyph;
 
+   sdf_vt.font_height = sdf_font_height;
+   sdf_vt.font_ascent = sdf_font_ascent;
+   sdf_vt.font_descent = sdf_font_descent;
+   sdf_vt.char_length = sdf_char_length;
+   sdf_vt.text_length = ttf_text_length;
+   sdf_vt.render_char = sdf_render_char;
+   sdf_vt.render = sdf_render;
+   sdf_vt.destroy = sdf_destroy;
+   sdf_vt.get_text_dimensions = ttf_get_text_dimensions;
+   sdf_vt.get_font_ranges = sdf_get_font_ranges;
+   sdf_vt.get_glyph_dimensions = sdf_get_glyph_dimensions;
+   sdf_vt.get_glyph_advance = sdf_get_glyph_advance;
+   sdf_vt.get_glyph = sdf_get_glyph;
+
+   set_sdf_spread(ft);
+
    al_register_font_loader(".ttf", al_load_ttf_font);
 
    _al_add_exit_func(al_shutdown_ttf_addon, "al_shutdown_ttf_addon");
@@ -1156,7 +3245,18 @@ void al_shutdown_ttf_addon(void)
 
    al_register_font_loader(".ttf", NULL);
 
+   if (sdf_shader) {
+      _al_unregister_destructor(_al_dtor_list, sdf_shader_dtor_item);
+      destroy_sdf_shader(sdf_shader);
+   }
+   sdf_shader_failed = false;
+   _al_vector_free(&sdf_stores);
+   _al_vector_free(&ttf_faces);
+   stop_worker();
+
    FT_Done_FreeType(ft);
+   al_destroy_mutex(faces_mutex);
+   faces_mutex = NULL;
 
    ttf_inited = false;
 }
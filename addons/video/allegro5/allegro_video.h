@@ -36,7 +36,10 @@ enum ALLEGRO_VIDEO_EVENT_TYPE
 {
    ALLEGRO_EVENT_VIDEO_FRAME_SHOW   = 550,
    ALLEGRO_EVENT_VIDEO_FINISHED     = 551,
-   _ALLEGRO_EVENT_VIDEO_SEEK        = 552   /* internal */
+   _ALLEGRO_EVENT_VIDEO_SEEK        = 552,  /* internal */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_VIDEO_SRC)
+   ALLEGRO_EVENT_VIDEO_FRAME_DROPPED = 553
+#endif
 };
 
 enum ALLEGRO_VIDEO_POSITION_TYPE
@@ -52,6 +55,25 @@ typedef enum ALLEGRO_VIDEO_POSITION_TYPE ALLEGRO_VIDEO_POSITION_TYPE;
 
 typedef struct ALLEGRO_VIDEO ALLEGRO_VIDEO;
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_VIDEO_SRC)
+/* Type: ALLEGRO_VIDEO_STATS
+ */
+typedef struct ALLEGRO_VIDEO_STATS ALLEGRO_VIDEO_STATS;
+struct ALLEGRO_VIDEO_STATS
+{
+   unsigned int frames_decoded;
+   unsigned int frames_shown;
+   unsigned int frames_dropped;
+   unsigned int frames_late;
+   double decode_time_avg;
+   double decode_time_max;
+   double convert_time_avg;
+   double convert_time_max;
+   unsigned int queued_frames;
+   double av_offset;
+};
+#endif
+
 ALLEGRO_VIDEO_FUNC(ALLEGRO_VIDEO *, al_open_video, (char const *filename));
 ALLEGRO_VIDEO_FUNC(void, al_close_video, (ALLEGRO_VIDEO *video));
 ALLEGRO_VIDEO_FUNC(void, al_start_video, (ALLEGRO_VIDEO *video, ALLEGRO_MIXER *mixer));
@@ -71,6 +93,14 @@ ALLEGRO_VIDEO_FUNC(bool, al_is_video_addon_initialized, (void));
 ALLEGRO_VIDEO_FUNC(void, al_shutdown_video_addon, (void));
 ALLEGRO_VIDEO_FUNC(uint32_t, al_get_allegro_video_version, (void));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_VIDEO_SRC)
+ALLEGRO_VIDEO_FUNC(ALLEGRO_BITMAP *, al_get_video_frame_at, (ALLEGRO_VIDEO *video, double time));
+ALLEGRO_VIDEO_FUNC(void, al_set_video_target_bitmap, (ALLEGRO_VIDEO *video, ALLEGRO_BITMAP *bitmap));
+ALLEGRO_VIDEO_FUNC(void, al_get_video_stats, (ALLEGRO_VIDEO *video, ALLEGRO_VIDEO_STATS *stats));
+ALLEGRO_VIDEO_FUNC(void, al_reset_video_stats, (ALLEGRO_VIDEO *video));
+ALLEGRO_VIDEO_FUNC(void, al_set_video_frame_dropped_events, (ALLEGRO_VIDEO *video, bool enabled));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
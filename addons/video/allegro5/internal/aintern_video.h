@@ -1,11 +1,28 @@
 
+/* The counters behind ALLEGRO_VIDEO_STATS. Backends update them through
+ * the _al_video_*() functions below, from any thread.
+ */
+typedef struct _AL_VIDEO_STATS {
+   unsigned int frames_decoded;
+   unsigned int frames_queued;
+   unsigned int frames_shown;
+   unsigned int frames_dropped;
+   unsigned int frames_late;
+   double decode_time_total;
+   double decode_time_max;
+   double convert_time_total;
+   double convert_time_max;
+   unsigned int queued_frames;
+   double av_offset;
+} _AL_VIDEO_STATS;
+
 typedef struct ALLEGRO_VIDEO_INTERFACE {
    bool (*open_video)(ALLEGRO_VIDEO *video);
    bool (*close_video)(ALLEGRO_VIDEO *video);
    bool (*start_video)(ALLEGRO_VIDEO *video);
    bool (*set_video_playing)(ALLEGRO_VIDEO *video);
    bool (*seek_video)(ALLEGRO_VIDEO *video, double seek_to);
-   bool (*update_video)(ALLEGRO_VIDEO *video);
+   bool (*update_video)(ALLEGRO_VIDEO *video, double time);
 } ALLEGRO_VIDEO_INTERFACE;
 
 struct ALLEGRO_VIDEO {
@@ -13,6 +30,7 @@ struct ALLEGRO_VIDEO {
    
    /* video */
    ALLEGRO_BITMAP *current_frame;
+   ALLEGRO_BITMAP *target_bitmap;   /* set by al_set_video_target_bitmap */
    double video_position;
    double fps;
    float scaled_width;
@@ -32,9 +50,26 @@ struct ALLEGRO_VIDEO {
    bool playing;
    double position;
 
+   /* statistics */
+   ALLEGRO_MUTEX *stats_mutex;
+   _AL_VIDEO_STATS stats;
+   bool frame_dropped_events;
+
    /* implementation specific */
    void *data;
 };
 
 ALLEGRO_VIDEO_INTERFACE *_al_video_ogv_vtable(void);
+void _al_video_frame_decoded(ALLEGRO_VIDEO *video, unsigned int skipped,
+   double time);
+void _al_video_frame_converted(ALLEGRO_VIDEO *video, double time);
+void _al_video_frame_shown(ALLEGRO_VIDEO *video, double pts, double time);
+void _al_video_frames_dropped(ALLEGRO_VIDEO *video, unsigned int count);
+void _al_video_set_queued_frames(ALLEGRO_VIDEO *video, unsigned int count);
+void _al_video_get_target_rect(ALLEGRO_VIDEO *video, float *x, float *y,
+   float *w, float *h);
+ALLEGRO_BITMAP *_al_video_create_frame_bitmap(int w, int h);
+void _al_video_destroy_frame_bitmap(ALLEGRO_BITMAP *bmp);
+void *_al_video_alloc_frame_buffer(size_t size);
+void _al_video_free_frame_buffer(void *buffer, size_t size);
 void _al_compute_scaled_dimensions(int frame_w, int frame_h, float aspect_ratio, float *scaled_w, float *scaled_h);
@@ -3,7 +3,6 @@
  * TODO:
  * - seeking
  * - generate video frame events
- * - better ycbcr->rgb
  * - improve frame skipping
  * - Ogg Skeleton support
  * - pass Theora test suite
@@ -13,7 +12,11 @@
  * difference.
  */
 
+#define ALLEGRO_INTERNAL_UNSTABLE
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "allegro5/allegro5.h"
 #include "allegro5/allegro_audio.h"
 #include "allegro5/allegro_video.h"
@@ -27,11 +30,42 @@
 
 ALLEGRO_DEBUG_CHANNEL("video")
 
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+   #if defined(_MSC_VER) || defined(__clang__) || \
+      (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+      #define SIMD_X86
+   #endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+   #define SIMD_NEON
+#endif
+
+#if defined(SIMD_X86)
+   #include <emmintrin.h>
+   #if defined(__GNUC__) || defined(__clang__)
+      #define TARGET(x) __attribute__((target(x)))
+   #else
+      #define TARGET(x)
+   #endif
+#elif defined(SIMD_NEON)
+   #include <arm_neon.h>
+#endif
+
 
 /* XXX probably should be based on stream parameters */
 static const int NUM_FRAGS    = 2;
 static const int FRAG_SAMPLES = 4096;
 static const int RGB_PIXEL_FORMAT = ALLEGRO_PIXEL_FORMAT_ABGR_8888;
+static const int DEFAULT_FRAME_QUEUE_SIZE = 4;
+
+/* The demuxer reads ahead until every stream has at least the minimum number
+ * of packets queued, but never beyond the maximum for any stream, so that a
+ * stream which ends early cannot make it buffer the rest of the file.
+ */
+static const int MIN_QUEUED_PACKETS = 32;
+static const int MAX_QUEUED_PACKETS = 256;
+
+/* Wakes up the decode threads so that they notice they should stop. */
+#define OGV_EVENT_WAKE_UP  ALLEGRO_GET_EVENT_TYPE('O', 'g', 'v', 'W')
 
 
 typedef struct OGG_VIDEO OGG_VIDEO;
@@ -39,6 +73,7 @@ typedef struct STREAM STREAM;
 typedef struct THEORA_STREAM THEORA_STREAM;
 typedef struct VORBIS_STREAM VORBIS_STREAM;
 typedef struct PACKET_NODE PACKET_NODE;
+typedef struct VIDEO_FRAME VIDEO_FRAME;
 
 enum {
    STREAM_TYPE_UNKNOWN = 0,
@@ -58,6 +93,7 @@ struct THEORA_STREAM {
    th_dec_ctx *ctx;
    ogg_int64_t prev_framenum;
    double frame_duration;
+   bool need_keyframe;              /* skip packets up to a keyframe */
 };
 
 struct VORBIS_STREAM {
@@ -67,8 +103,9 @@ struct VORBIS_STREAM {
    vorbis_dsp_state dsp;
    vorbis_block block;
    int channels;
-   float *next_fragment;            /* channels * FRAG_SAMPLES elements */
-   int next_fragment_pos;
+   float *fragment;                 /* being filled, owned by the stream */
+   int fragment_pos;
+   ogg_int64_t skip_to_sample;      /* drop samples before this, or -1 */
 };
 
 struct STREAM {
@@ -77,12 +114,20 @@ struct STREAM {
    bool headers_done;
    ogg_stream_state state;
    PACKET_NODE *packet_queue;
+   int num_packets;
    union {
       THEORA_STREAM theora;
       VORBIS_STREAM vorbis;
    } u;
 };
 
+/* A decoded frame, as copied out of the Theora decoder. */
+struct VIDEO_FRAME {
+   double pts;                      /* presentation time */
+   bool announced;                  /* ALLEGRO_EVENT_VIDEO_FRAME_SHOW sent */
+   unsigned char *plane_data[3];    /* Y, Cb, Cr */
+};
+
 struct OGG_VIDEO {
    ALLEGRO_FILE *fp;
    bool reached_eof;
@@ -90,26 +135,54 @@ struct OGG_VIDEO {
    _AL_VECTOR streams;              /* vector of STREAM pointers */
    STREAM *selected_video_stream;   /* one of the streams */
    STREAM *selected_audio_stream;   /* one of the streams */
-   int seek_counter;
+   _AL_VECTOR page_index;           /* PAGE_INDEX_ENTRY, built on seeking */
+   bool page_index_built;
 
    /* Video output. */
    th_pixel_fmt pixel_fmt;
-   th_ycbcr_buffer buffer;
-   bool buffer_dirty;
-   unsigned char* rgb_data;
    ALLEGRO_BITMAP *frame_bmp;
    ALLEGRO_BITMAP *pic_bmp;         /* frame_bmp, or subbitmap thereof */
-
-   ALLEGRO_EVENT_SOURCE evtsrc;
-   ALLEGRO_EVENT_QUEUE *queue;
+   bool have_frame;                 /* frame_bmp holds a decoded frame */
+
+   /* The decoder thread decodes ahead into a ring of frames, oldest first.
+    * It fills the slot after the last queued frame without holding the
+    * mutex, and only takes it to add the frame to the queue. The user
+    * thread converts the newest frame that is due into frame_bmp and frees
+    * the slots up to it: with the shader if there is one, else directly
+    * into the locked frame_bmp.
+    */
+   VIDEO_FRAME *frames;
+   int max_frames;
+   int first_frame;
+   int num_frames;
+   int xshift, yshift;              /* chroma subsampling */
+   int plane_w[3], plane_h[3];
+   ALLEGRO_SHADER *shader;
+   ALLEGRO_BITMAP *plane_bmp[3];
+
+   /* Threads. The demuxer reads pages and moves the packets of the
+    * selected streams into their packet queues, guarded by demux_mutex.
+    * The audio and video threads take packets from there independently, so
+    * a slow video frame does not starve the audio. mutex guards the frame
+    * queue.
+    */
+   bool started;
+   ALLEGRO_MUTEX *demux_mutex;
+   ALLEGRO_COND *demux_cond;
+   ALLEGRO_THREAD *demux_thread;
+   ALLEGRO_THREAD *audio_thread;
+   ALLEGRO_THREAD *video_thread;
+   ALLEGRO_EVENT_SOURCE evtsrc;     /* for OGV_EVENT_WAKE_UP */
+   ALLEGRO_EVENT_QUEUE *audio_queue;
+   ALLEGRO_EVENT_QUEUE *video_queue;
    ALLEGRO_MUTEX *mutex;
-   ALLEGRO_COND *cond;
-   ALLEGRO_THREAD *thread;
 };
 
 
 /* forward declarations */
 static bool ogv_close_video(ALLEGRO_VIDEO *video);
+static bool setup_frames(OGG_VIDEO *ogv, int frame_w, int frame_h);
+static void setup_gpu_conversion(OGG_VIDEO *ogv);
 
 
 /* Packet queue. */
@@ -140,6 +213,8 @@ static void add_tail_packet(STREAM *stream, PACKET_NODE *node)
 
    ASSERT(node->next == NULL);
 
+   stream->num_packets++;
+
    for (cur = stream->packet_queue; cur != NULL; cur = cur->next) {
       if (cur->next == NULL) {
          cur->next = node;
@@ -158,6 +233,7 @@ static void add_head_packet(STREAM *stream, PACKET_NODE *node)
 
    node->next = stream->packet_queue;
    stream->packet_queue = node;
+   stream->num_packets++;
 
    if (node->next) {
       ASSERT(node->pkt.packetno < node->next->pkt.packetno);
@@ -176,6 +252,7 @@ static PACKET_NODE *take_head_packet(STREAM *stream)
       ASSERT(cur->pkt.packetno < cur->next->pkt.packetno);
    }
    stream->packet_queue = cur->next;
+   stream->num_packets--;
    cur->next = NULL;
    return cur;
 }
@@ -188,6 +265,7 @@ static void free_packet_queue(STREAM *stream)
       node->next = NULL;
       free_packet_node(node);
    }
+   stream->num_packets = 0;
 }
 
 static void deactivate_stream(STREAM *stream)
@@ -272,7 +350,6 @@ static void free_stream(STREAM *stream)
                vorbis_block_clear(&vstream->block);
                vorbis_dsp_clear(&vstream->dsp);
             }
-            al_free(vstream->next_fragment);
          }
          break;
    }
@@ -286,7 +363,6 @@ static bool read_page(OGG_VIDEO *ogv, ogg_page *page)
    const int buffer_size = 4096;
 
    if (al_feof(ogv->fp) || al_ferror(ogv->fp)) {
-      ogv->reached_eof = true;
       return ogg_sync_pageout(&ogv->sync_state, page) == 1;
    }
 
@@ -309,31 +385,124 @@ static bool read_page(OGG_VIDEO *ogv, ogg_page *page)
    return true;
 }
 
-/* Return true if got a packet for the stream. */
-static bool read_packet(OGG_VIDEO *ogv, STREAM *stream, ogg_packet *packet)
+/* Demuxing. */
+
+/* Moves the complete packets of a stream into its packet queue.
+ * Must be called with demux_mutex held.
+ */
+static void queue_stream_packets(STREAM *stream)
 {
-   ogg_page page;
+   ogg_packet packet;
    int rc;
 
-   for (;;) {
-      rc = ogg_stream_packetout(&stream->state, packet);
+   while ((rc = ogg_stream_packetout(&stream->state, &packet)) != 0) {
       if (rc == 1) {
-         /* Got a packet for stream. */
-         return true;
+         add_tail_packet(stream, create_packet_node(&packet));
+      }
+      else {
+         ALLEGRO_WARN("No packet due to lost sync or hole in data.\n");
+      }
+   }
+}
+
+/* Returns true if some stream is running low on packets and none has too
+ * many. Must be called with demux_mutex held.
+ */
+static bool demux_wanted(OGG_VIDEO *ogv)
+{
+   STREAM *streams[2];
+   bool low = false;
+   int i;
+
+   streams[0] = ogv->selected_video_stream;
+   streams[1] = ogv->selected_audio_stream;
+
+   for (i = 0; i < 2; i++) {
+      if (!streams[i] || !streams[i]->active)
+         continue;
+      if (streams[i]->num_packets >= MAX_QUEUED_PACKETS)
+         return false;
+      if (streams[i]->num_packets < MIN_QUEUED_PACKETS)
+         low = true;
+   }
+
+   return low;
+}
+
+static void *demux_thread_func(ALLEGRO_THREAD *thread, void *_video)
+{
+   ALLEGRO_VIDEO * const video = _video;
+   OGG_VIDEO * const ogv = video->data;
+   ogg_page page;
+   int rc;
+
+   ALLEGRO_DEBUG("Demux thread started.\n");
+
+   al_lock_mutex(ogv->demux_mutex);
+
+   /* The last header pages may already have held some data packets. */
+   if (ogv->selected_video_stream && ogv->selected_video_stream->active)
+      queue_stream_packets(ogv->selected_video_stream);
+   if (ogv->selected_audio_stream && ogv->selected_audio_stream->active)
+      queue_stream_packets(ogv->selected_audio_stream);
+
+   while (!al_get_thread_should_stop(thread)) {
+      bool got_page;
+
+      if (ogv->reached_eof || !demux_wanted(ogv)) {
+         al_wait_cond(ogv->demux_cond, ogv->demux_mutex);
+         continue;
       }
 
-      if (read_page(ogv, &page)) {
-         STREAM *page_stream = find_stream(ogv, ogg_page_serialno(&page));
+      /* Don't hold up the decode threads while reading the file. */
+      al_unlock_mutex(ogv->demux_mutex);
+      got_page = read_page(ogv, &page);
+      al_lock_mutex(ogv->demux_mutex);
 
-         if (page_stream && page_stream->active) {
-            rc = ogg_stream_pagein(&page_stream->state, &page);
+      if (got_page) {
+         STREAM *stream = find_stream(ogv, ogg_page_serialno(&page));
+
+         if (stream && stream->active) {
+            rc = ogg_stream_pagein(&stream->state, &page);
             ASSERT(rc == 0);
+            queue_stream_packets(stream);
          }
       }
       else {
-         return false;
+         ALLEGRO_DEBUG("Demuxed to the end of the file.\n");
+         ogv->reached_eof = true;
       }
    }
+
+   al_unlock_mutex(ogv->demux_mutex);
+
+   ALLEGRO_DEBUG("Demux thread exit.\n");
+
+   return NULL;
+}
+
+/* Takes the next packet of a stream, or returns NULL if the demuxer has not
+ * got that far yet. The decode threads never wait for the demuxer.
+ */
+static PACKET_NODE *take_packet(OGG_VIDEO *ogv, STREAM *stream)
+{
+   PACKET_NODE *node;
+
+   al_lock_mutex(ogv->demux_mutex);
+   node = take_head_packet(stream);
+   if (stream->num_packets < MIN_QUEUED_PACKETS) {
+      al_signal_cond(ogv->demux_cond);
+   }
+   al_unlock_mutex(ogv->demux_mutex);
+
+   return node;
+}
+
+static void put_back_packet(OGG_VIDEO *ogv, STREAM *stream, PACKET_NODE *node)
+{
+   al_lock_mutex(ogv->demux_mutex);
+   add_head_packet(stream, node);
+   al_unlock_mutex(ogv->demux_mutex);
 }
 
 
@@ -532,8 +701,7 @@ static void setup_vorbis_stream_decode(ALLEGRO_VIDEO *video, STREAM *stream)
    video->audio_rate = vstream->info.rate;
    vstream->channels = vstream->info.channels;
 
-   vstream->next_fragment =
-      al_calloc(vstream->channels * FRAG_SAMPLES, sizeof(float));
+   vstream->skip_to_sample = -1;
 
    ALLEGRO_INFO("Audio rate: %f\n", video->audio_rate);
    ALLEGRO_INFO("Audio channels: %d\n", vstream->channels);
@@ -556,6 +724,7 @@ static void handle_vorbis_data(VORBIS_STREAM *vstream, ogg_packet *packet)
    }
 }
 
+/* Interleaves decoded samples straight into the stream fragment. */
 static bool generate_next_audio_fragment(VORBIS_STREAM *vstream)
 {
    float **pcm = NULL;
@@ -569,13 +738,12 @@ static bool generate_next_audio_fragment(VORBIS_STREAM *vstream)
       return false;
    }
 
-   if (samples > FRAG_SAMPLES - vstream->next_fragment_pos) {
-      samples = FRAG_SAMPLES - vstream->next_fragment_pos;
+   if (samples > FRAG_SAMPLES - vstream->fragment_pos) {
+      samples = FRAG_SAMPLES - vstream->fragment_pos;
    }
 
-   ASSERT(vstream->next_fragment);
-   p = &vstream->next_fragment[
-      vstream->channels * vstream->next_fragment_pos];
+   ASSERT(vstream->fragment);
+   p = &vstream->fragment[vstream->channels * vstream->fragment_pos];
 
    if (vstream->channels == 2) {
       for (i = 0; i < samples; i++) {
@@ -596,39 +764,68 @@ static bool generate_next_audio_fragment(VORBIS_STREAM *vstream)
       }
    }
 
-   vstream->next_fragment_pos += samples;
+   vstream->fragment_pos += samples;
 
    rc = vorbis_synthesis_read(&vstream->dsp, samples);
    ASSERT(rc == 0);
    return true;
 }
 
+/* After seeking, drops the decoded samples before skip_to_sample. Only
+ * packets which end a page have a granule position, so the samples are
+ * left pending in the decoder until one comes along.
+ */
+static void skip_audio_samples(VORBIS_STREAM *vstream, ogg_int64_t granulepos)
+{
+   ogg_int64_t first, drop;
+   int samples;
+   int rc;
+
+   if (granulepos == -1) {
+      return;
+   }
+
+   /* The pending samples end at the granule position. */
+   samples = vorbis_synthesis_pcmout(&vstream->dsp, NULL);
+   first = granulepos - samples;
+   drop = vstream->skip_to_sample - first;
+   if (drop > samples) {
+      drop = samples;
+   }
+   else {
+      vstream->skip_to_sample = -1;
+   }
+
+   if (drop > 0) {
+      rc = vorbis_synthesis_read(&vstream->dsp, drop);
+      ASSERT(rc == 0);
+   }
+}
+
 static void poll_vorbis_decode(OGG_VIDEO *ogv, STREAM *vstream_outer)
 {
    VORBIS_STREAM * const vstream = &vstream_outer->u.vorbis;
 
-   while (vstream->next_fragment_pos < FRAG_SAMPLES
+   while (vstream->skip_to_sample == -1
+      && vstream->fragment_pos < FRAG_SAMPLES
       && generate_next_audio_fragment(vstream))
    {
    }
 
-   while (vstream->next_fragment_pos < FRAG_SAMPLES) {
-      PACKET_NODE *node;
-      ogg_packet packet;
+   while (vstream->fragment_pos < FRAG_SAMPLES) {
+      PACKET_NODE *node = take_packet(ogv, vstream_outer);
 
-      node = take_head_packet(vstream_outer);
-      if (node) {
-         handle_vorbis_data(vstream, &node->pkt);
-         generate_next_audio_fragment(vstream);
-         free_packet_node(node);
+      if (!node) {
+         break;
       }
-      else if (read_packet(ogv, vstream_outer, &packet)) {
-         handle_vorbis_data(vstream, &packet);
-         generate_next_audio_fragment(vstream);
+      handle_vorbis_data(vstream, &node->pkt);
+      if (vstream->skip_to_sample != -1) {
+         skip_audio_samples(vstream, node->pkt.granulepos);
       }
-      else {
-         break;
+      if (vstream->skip_to_sample == -1) {
+         generate_next_audio_fragment(vstream);
       }
+      free_packet_node(node);
    }
 }
 
@@ -683,28 +880,58 @@ static ALLEGRO_AUDIO_STREAM *create_audio_stream(const ALLEGRO_VIDEO *video,
    return audio;
 }
 
-static void update_audio_fragment(ALLEGRO_AUDIO_STREAM *audio_stream,
-   VORBIS_STREAM *vstream, bool paused, bool reached_eof)
+/* Decodes into every free fragment of the audio stream, handing each over
+ * as soon as it is full. A fragment which cannot be filled yet is kept
+ * until the next call, so the stream starves rather than plays a gap.
+ */
+static void update_audio_fragments(ALLEGRO_VIDEO *video, OGG_VIDEO *ogv,
+   STREAM *vstream_outer)
 {
-   float *frag;
+   VORBIS_STREAM * const vstream = &vstream_outer->u.vorbis;
+   const size_t frag_bytes = vstream->channels * FRAG_SAMPLES * sizeof(float);
 
-   frag = al_get_audio_stream_fragment(audio_stream);
-   if (!frag)
+   if (!video->playing) {
+      float *frag = al_get_audio_stream_fragment(video->audio);
+      if (frag) {
+         memset(frag, 0, frag_bytes);
+         al_set_audio_stream_fragment(video->audio, frag);
+      }
       return;
+   }
+
+   for (;;) {
+      /* Read before decoding: if the demuxer was already done, whatever
+       * does not fit now never will.
+       */
+      const bool reached_eof = ogv->reached_eof;
 
-   if (paused || vstream->next_fragment_pos < FRAG_SAMPLES) {
-      if (!paused && !reached_eof) {
-         ALLEGRO_WARN("Next fragment not ready.\n");
+      if (!vstream->fragment) {
+         vstream->fragment = al_get_audio_stream_fragment(video->audio);
+         vstream->fragment_pos = 0;
+         if (!vstream->fragment) {
+            return;
+         }
       }
-      memset(frag, 0, vstream->channels * FRAG_SAMPLES * sizeof(float));
-   }
-   else {
-      memcpy(frag, vstream->next_fragment,
-         vstream->channels * FRAG_SAMPLES * sizeof(float));
-      vstream->next_fragment_pos = 0;
-   }
 
-   al_set_audio_stream_fragment(audio_stream, frag);
+      poll_vorbis_decode(ogv, vstream_outer);
+
+      if (vstream->fragment_pos < FRAG_SAMPLES) {
+         if (!reached_eof) {
+            ALLEGRO_DEBUG("Next fragment not ready.\n");
+            return;
+         }
+         memset(vstream->fragment + vstream->channels * vstream->fragment_pos,
+            0, frag_bytes - vstream->channels * vstream->fragment_pos
+               * sizeof(float));
+      }
+
+      al_set_audio_stream_fragment(video->audio, vstream->fragment);
+      vstream->fragment = NULL;
+
+      if (reached_eof) {
+         return;
+      }
+   }
 }
 
 
@@ -728,7 +955,7 @@ static void setup_theora_stream_decode(ALLEGRO_VIDEO *video, OGG_VIDEO *ogv,
    tstream->setup = NULL;
 
    ogv->pixel_fmt = tstream->info.pixel_fmt;
-   ogv->frame_bmp = al_create_bitmap(frame_w, frame_h);
+   ogv->frame_bmp = _al_video_create_frame_bitmap(frame_w, frame_h);
    if (pic_x == 0 && pic_y == 0 && pic_w == frame_w && pic_h == frame_h) {
       ogv->pic_bmp = ogv->frame_bmp;
    }
@@ -736,8 +963,9 @@ static void setup_theora_stream_decode(ALLEGRO_VIDEO *video, OGG_VIDEO *ogv,
       ogv->pic_bmp = al_create_sub_bitmap(ogv->frame_bmp,
          pic_x, pic_y, pic_w, pic_h);
    }
-   ogv->rgb_data =
-      al_malloc(al_get_pixel_size(RGB_PIXEL_FORMAT) * frame_w * frame_h);
+   if (setup_frames(ogv, frame_w, frame_h)) {
+      setup_gpu_conversion(ogv);
+   }
 
    video->fps =
       (double)tstream->info.fps_numerator /
@@ -780,6 +1008,17 @@ static bool handle_theora_data(ALLEGRO_VIDEO *video, THEORA_STREAM *tstream,
    int64_t framenum;
    int rc;
 
+   if (tstream->need_keyframe) {
+      /* After seeking, frames cannot be decoded before a keyframe. */
+      if (th_packet_iskeyframe(packet) != 1) {
+         tstream->prev_framenum = get_theora_framenum(tstream, packet);
+         video->video_position =
+            tstream->prev_framenum * tstream->frame_duration;
+         return true;
+      }
+      tstream->need_keyframe = false;
+   }
+
    expected_framenum = tstream->prev_framenum + 1;
    framenum = get_theora_framenum(tstream, packet);
 
@@ -815,312 +1054,194 @@ static bool handle_theora_data(ALLEGRO_VIDEO *video, THEORA_STREAM *tstream,
    return true;
 }
 
-/* Y'CrCb to RGB conversion. */
-/* XXX simple slow implementation */
+/* Y'CrCb to RGB conversion on the CPU.
+ *
+ * The row converters write ABGR_8888 pixels straight into the locked
+ * frame_bmp. The vectorized versions compute exactly the same values as
+ * the generic one; they convert as many whole blocks of 8 pixels as fit
+ * and return how many pixels they did.
+ */
 
-static unsigned char clamp(int x)
+static INLINE unsigned char clamp(int x)
 {
-   if (x < 0)
-      return 0;
-   if (x > 255)
-      return 255;
-   return x;
-}
-
-static INLINE void ycbcr_to_rgb(th_ycbcr_buffer buffer,
-   unsigned char* rgb_data, int pixel_size, int pitch, int xshift, int yshift)
-{
-   const int w = buffer[0].width;
-   const int h = buffer[0].height;
-   int x, y;
-
-   for (y = 0; y < h; y++) {
-      const int y2 = y >> yshift;
-      for (x = 0; x < w; x++) {
-         const int x2 = x >> xshift;
-         unsigned char * const data = rgb_data + y * pitch + x * pixel_size;
-         const int yp = buffer[0].data[y  * buffer[0].stride + x ];
-         const int cb = buffer[1].data[y2 * buffer[1].stride + x2];
-         const int cr = buffer[2].data[y2 * buffer[2].stride + x2];
-         const int C = yp - 16;
-         const int D = cb - 128;
-         const int E = cr - 128;
-
-         data[0] = clamp((298*C         + 409*E + 128) >> 8);
-         data[1] = clamp((298*C - 100*D - 208*E + 128) >> 8);
-         data[2] = clamp((298*C + 516*D         + 128) >> 8);
-         data[3] = 0xff;
-      }
-   }
+   return x < 0 ? 0 : x > 255 ? 255 : x;
 }
 
-static void convert_buffer_to_rgba(OGG_VIDEO *ogv)
+static void ycbcr_to_rgb_row_generic(unsigned char *data,
+   const unsigned char *yp, const unsigned char *cbp, const unsigned char *crp,
+   int x, int w, int xshift)
 {
-   const int pixel_size = al_get_pixel_size(RGB_PIXEL_FORMAT);
-   const int pitch = pixel_size * al_get_bitmap_width(ogv->frame_bmp);
+   for (; x < w; x++) {
+      const int x2 = x >> xshift;
+      const int C = yp[x] - 16;
+      const int D = cbp[x2] - 128;
+      const int E = crp[x2] - 128;
 
-   switch (ogv->pixel_fmt) {
-      case TH_PF_420:
-         ycbcr_to_rgb(ogv->buffer, ogv->rgb_data, pixel_size, pitch, 1, 1);
-         break;
-      case TH_PF_422:
-         ycbcr_to_rgb(ogv->buffer, ogv->rgb_data, pixel_size, pitch, 1, 0);
-         break;
-      case TH_PF_444:
-         ycbcr_to_rgb(ogv->buffer, ogv->rgb_data, pixel_size, pitch, 0, 0);
-         break;
-      default:
-         ALLEGRO_ERROR("Unsupported pixel format.\n");
-         break;
+      data[x*4 + 0] = clamp((298*C         + 409*E + 128) >> 8);
+      data[x*4 + 1] = clamp((298*C - 100*D - 208*E + 128) >> 8);
+      data[x*4 + 2] = clamp((298*C + 516*D         + 128) >> 8);
+      data[x*4 + 3] = 0xff;
    }
 }
 
-static int poll_theora_decode(ALLEGRO_VIDEO *video, STREAM *tstream_outer)
-{
-   OGG_VIDEO * const ogv = video->data;
-   THEORA_STREAM * const tstream = &tstream_outer->u.theora;
-   bool new_frame = false;
-   int num_frames = 0;
-   int rc;
 
-   while (video->video_position < video->position) {
-      PACKET_NODE *node;
-      ogg_packet packet;
+#if defined(SIMD_X86)
 
-      node = take_head_packet(tstream_outer);
-      if (node) {
-         if (handle_theora_data(video, tstream, &node->pkt, &new_frame)) {
-            free_packet_node(node);
-            num_frames++;
-         }
-         else {
-            add_head_packet(tstream_outer, node);
-         }
-      }
-      else if (read_packet(ogv, tstream_outer, &packet)) {
-         if (handle_theora_data(video, tstream, &packet, &new_frame)) {
-            num_frames++;
-         }
-         else {
-            add_head_packet(tstream_outer, create_packet_node(&packet));
-         }
-      }
-      else {
-         break;
-      }
+/* Loads the chroma samples for 8 pixels, widened to 16 bits and centered. */
+TARGET("sse2")
+static INLINE __m128i load_chroma_sse2(const unsigned char *p, int xshift)
+{
+   __m128i c;
 
-      /* Only skip frames if we are really falling behind, not just slightly
-       * ahead of the target position.
-       * XXX improve frame skipping algorithm
-       */
-      if (video->video_position
-            >= video->position - 3.0*tstream->frame_duration) {
-         break;
-      }
+   if (xshift) {
+      int32_t v;
+      memcpy(&v, p, 4);
+      c = _mm_cvtsi32_si128(v);
+      c = _mm_unpacklo_epi8(c, c);
    }
-
-   if (new_frame) {
-      ALLEGRO_EVENT event;
-      al_lock_mutex(ogv->mutex);
-
-      rc = th_decode_ycbcr_out(tstream->ctx, ogv->buffer);
-      ASSERT(rc == 0);
-
-      convert_buffer_to_rgba(ogv);
-
-      ogv->buffer_dirty = true;
-
-      event.type = ALLEGRO_EVENT_VIDEO_FRAME_SHOW;
-      event.user.data1 = (intptr_t)video;
-      al_emit_user_event(&video->es, &event, NULL);
-
-      al_unlock_mutex(ogv->mutex);
+   else {
+      c = _mm_loadl_epi64((const __m128i *)p);
    }
-
-   return num_frames;
+   c = _mm_unpacklo_epi8(c, _mm_setzero_si128());
+   return _mm_sub_epi16(c, _mm_set1_epi16(128));
 }
 
 
-/* Seeking. */
-
-static void seek_to_beginning(ALLEGRO_VIDEO *video, OGG_VIDEO *ogv,
-   THEORA_STREAM *tstream)
+/* The products do not fit into 16 bits, so they are formed with
+ * _mm_madd_epi16 on (Cb, Cr) and (Y, 1) pairs, like the generic version.
+ */
+TARGET("sse2")
+static int ycbcr_to_rgb_row_sse2(unsigned char *data,
+   const unsigned char *yp, const unsigned char *cbp, const unsigned char *crp,
+   int w, int xshift)
 {
-   unsigned i;
-   int rc;
-   bool seeked;
-
-   for (i = 0; i < _al_vector_size(&ogv->streams); i++) {
-      STREAM **slot = _al_vector_ref(&ogv->streams, i);
-      STREAM *stream = *slot;
-
-      ogg_stream_reset(&stream->state);
-      free_packet_queue(stream);
-   }
-
-   if (tstream) {
-      ogg_int64_t granpos = 0;
-
-      rc = th_decode_ctl(tstream->ctx, TH_DECCTL_SET_GRANPOS, &granpos,
-         sizeof(granpos));
-      ASSERT(rc == 0);
-
-      tstream->prev_framenum = -1;
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i one = _mm_set1_epi16(1);
+   const __m128i y_k = _mm_setr_epi16(298, 128, 298, 128, 298, 128, 298, 128);
+   const __m128i r_k = _mm_setr_epi16(0, 409, 0, 409, 0, 409, 0, 409);
+   const __m128i g_k = _mm_setr_epi16(-100, -208, -100, -208,
+      -100, -208, -100, -208);
+   const __m128i b_k = _mm_setr_epi16(516, 0, 516, 0, 516, 0, 516, 0);
+   const __m128i alpha = _mm_set1_epi8((char)0xff);
+   int x;
+
+   for (x = 0; x + 8 <= w; x += 8) {
+      __m128i c = _mm_loadl_epi64((const __m128i *)(yp + x));
+      __m128i d = load_chroma_sse2(cbp + (x >> xshift), xshift);
+      __m128i e = load_chroma_sse2(crp + (x >> xshift), xshift);
+      __m128i y_lo, y_hi, de_lo, de_hi, r, g, b, rg, ba;
+
+      c = _mm_sub_epi16(_mm_unpacklo_epi8(c, zero), _mm_set1_epi16(16));
+      y_lo = _mm_madd_epi16(_mm_unpacklo_epi16(c, one), y_k);
+      y_hi = _mm_madd_epi16(_mm_unpackhi_epi16(c, one), y_k);
+      de_lo = _mm_unpacklo_epi16(d, e);
+      de_hi = _mm_unpackhi_epi16(d, e);
+
+#define CHANNEL(k)                                                            \
+      _mm_packs_epi32(                                                        \
+         _mm_srai_epi32(_mm_add_epi32(y_lo, _mm_madd_epi16(de_lo, k)), 8),    \
+         _mm_srai_epi32(_mm_add_epi32(y_hi, _mm_madd_epi16(de_hi, k)), 8))
+
+      r = CHANNEL(r_k);
+      g = CHANNEL(g_k);
+      b = CHANNEL(b_k);
+
+#undef CHANNEL
+
+      /* Saturating to unsigned bytes does the clamping. */
+      r = _mm_packus_epi16(r, r);
+      g = _mm_packus_epi16(g, g);
+      b = _mm_packus_epi16(b, b);
+      rg = _mm_unpacklo_epi8(r, g);
+      ba = _mm_unpacklo_epi8(b, alpha);
+      _mm_storeu_si128((__m128i *)(data + x*4), _mm_unpacklo_epi16(rg, ba));
+      _mm_storeu_si128((__m128i *)(data + x*4 + 16), _mm_unpackhi_epi16(rg, ba));
    }
-
-   rc = ogg_sync_reset(&ogv->sync_state);
-   ASSERT(rc == 0);
-
-   seeked = al_fseek(ogv->fp, 0, SEEK_SET);
-   ASSERT(seeked);
-   /* XXX read enough file data to get into position */
-
-   ogv->reached_eof = false;
-   video->audio_position = 0.0;
-   video->video_position = 0.0;
-   video->position = 0.0;
-
-   /* XXX maybe clear backlog of time and stream fragment events */
+   return x;
 }
 
-/* Decode thread. */
+#elif defined(SIMD_NEON)
 
-static void *decode_thread_func(ALLEGRO_THREAD *thread, void *_video)
+/* Loads the chroma samples for 8 pixels, widened to 16 bits and centered. */
+static INLINE int16x8_t load_chroma_neon(const unsigned char *p, int xshift)
 {
-   ALLEGRO_VIDEO * const video = _video;
-   OGG_VIDEO * const ogv = video->data;
-   STREAM *tstream_outer;
-   THEORA_STREAM *tstream = NULL;
-   STREAM *vstream_outer;
-   VORBIS_STREAM *vstream = NULL;
-   ALLEGRO_TIMER *timer;
-   double audio_pos_step = 0.0;
-   double timer_dur;
-
-   ALLEGRO_DEBUG("Thread started.\n");
-
-   tstream_outer = ogv->selected_video_stream;
-   if (tstream_outer) {
-      ASSERT(tstream_outer->stream_type == STREAM_TYPE_THEORA);
-      tstream = &tstream_outer->u.theora;
-   }
-
-   vstream_outer = ogv->selected_audio_stream;
-   if (vstream_outer) {
-      ASSERT(vstream_outer->stream_type == STREAM_TYPE_VORBIS);
+   uint8x8_t c;
 
-      video->audio = create_audio_stream(video, vstream_outer);
-      if (video->audio) {
-         vstream = &vstream_outer->u.vorbis;
-         audio_pos_step = (double)FRAG_SAMPLES / vstream->info.rate;
-      }
-      else {
-         deactivate_stream(vstream_outer);
-         vstream_outer = NULL;
-      }
+   if (xshift) {
+      uint32_t v;
+      memcpy(&v, p, 4);
+      c = vreinterpret_u8_u32(vdup_n_u32(v));
+      c = vzip_u8(c, c).val[0];
    }
-
-   if (!tstream_outer && !vstream_outer) {
-      ALLEGRO_WARN("No audio or video stream found.\n");
-      return NULL;
+   else {
+      c = vld1_u8(p);
    }
+   return vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(c)), vdupq_n_s16(128));
+}
 
-   timer_dur = 1.0;
-   if (audio_pos_step != 0.0) {
-      timer_dur = audio_pos_step / NUM_FRAGS;
-   }
-   if (tstream && tstream->frame_duration < timer_dur) {
-      timer_dur = tstream->frame_duration;
-   }
-   timer = al_create_timer(timer_dur);
-   al_register_event_source(ogv->queue, al_get_timer_event_source(timer));
 
-   if (video->audio) {
-      al_register_event_source(ogv->queue,
-         al_get_audio_stream_event_source(video->audio));
+static int ycbcr_to_rgb_row_neon(unsigned char *data,
+   const unsigned char *yp, const unsigned char *cbp, const unsigned char *crp,
+   int w, int xshift)
+{
+   int x;
+
+   for (x = 0; x + 8 <= w; x += 8) {
+      int16x8_t c = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(yp + x))),
+         vdupq_n_s16(16));
+      int16x8_t d = load_chroma_neon(cbp + (x >> xshift), xshift);
+      int16x8_t e = load_chroma_neon(crp + (x >> xshift), xshift);
+      int32x4_t y_lo = vmlal_n_s16(vdupq_n_s32(128), vget_low_s16(c), 298);
+      int32x4_t y_hi = vmlal_n_s16(vdupq_n_s32(128), vget_high_s16(c), 298);
+      int32x4_t r_lo, r_hi, g_lo, g_hi, b_lo, b_hi;
+      uint8x8x4_t px;
+
+      r_lo = vmlal_n_s16(y_lo, vget_low_s16(e), 409);
+      r_hi = vmlal_n_s16(y_hi, vget_high_s16(e), 409);
+      g_lo = vmlsl_n_s16(vmlsl_n_s16(y_lo, vget_low_s16(d), 100),
+         vget_low_s16(e), 208);
+      g_hi = vmlsl_n_s16(vmlsl_n_s16(y_hi, vget_high_s16(d), 100),
+         vget_high_s16(e), 208);
+      b_lo = vmlal_n_s16(y_lo, vget_low_s16(d), 516);
+      b_hi = vmlal_n_s16(y_hi, vget_high_s16(d), 516);
+
+      /* Saturating to unsigned bytes does the clamping. */
+      px.val[0] = vqmovun_s16(vcombine_s16(vshrn_n_s32(r_lo, 8),
+         vshrn_n_s32(r_hi, 8)));
+      px.val[1] = vqmovun_s16(vcombine_s16(vshrn_n_s32(g_lo, 8),
+         vshrn_n_s32(g_hi, 8)));
+      px.val[2] = vqmovun_s16(vcombine_s16(vshrn_n_s32(b_lo, 8),
+         vshrn_n_s32(b_hi, 8)));
+      px.val[3] = vdup_n_u8(0xff);
+      vst4_u8(data + x*4, px);
    }
+   return x;
+}
 
-   ALLEGRO_DEBUG("Begin decode loop.\n");
-
-   al_start_timer(timer);
-
-   while (!al_get_thread_should_stop(thread)) {
-      ALLEGRO_EVENT ev;
-
-      al_wait_for_event(ogv->queue, &ev);
-
-      if (ev.type == _ALLEGRO_EVENT_VIDEO_SEEK) {
-         double seek_to = ev.user.data1 / 1.0e6;
-         /* XXX we only know how to seek to start of video */
-         ASSERT(seek_to <= 0.0);
-         al_lock_mutex(ogv->mutex);
-         seek_to_beginning(video, ogv, tstream);
-         ogv->seek_counter++;
-         al_broadcast_cond(ogv->cond);
-         al_unlock_mutex(ogv->mutex);
-         continue;
-      }
-
-      if (ev.type == ALLEGRO_EVENT_TIMER) {
-         if (vstream_outer && video->playing) {
-            poll_vorbis_decode(ogv, vstream_outer);
-         }
-
-         /* If no audio then video is master. */
-         if (!video->audio && video->playing && !ogv->reached_eof) {
-            video->position += tstream->frame_duration;
-         }
-
-         if (tstream_outer) {
-            poll_theora_decode(video, tstream_outer);
-         }
-
-         if (video->playing && ogv->reached_eof) {
-            ALLEGRO_EVENT event;
-            video->playing = false;
-
-            event.type = ALLEGRO_EVENT_VIDEO_FINISHED;
-            event.user.data1 = (intptr_t)video;
-            al_emit_user_event(&video->es, &event, NULL);
-         }
-      }
-
-      if (ev.type == ALLEGRO_EVENT_AUDIO_STREAM_FRAGMENT) {
-         /* Audio clock is master when it exists. */
-         /* XXX This doesn't work well when the process is paused then resumed,
-          * due to a problem with the audio addon.  We get a flood of
-          * fragment events which pushes the position field ahead of the
-          * real audio position.
-          */
-         if (video->playing && !ogv->reached_eof) {
-            video->audio_position += audio_pos_step;
-            video->position = video->audio_position - NUM_FRAGS * audio_pos_step;
-         }
-         update_audio_fragment(video->audio, vstream, !video->playing,
-            ogv->reached_eof);
-      }
-   }
+#endif
 
-   ALLEGRO_DEBUG("End decode loop.\n");
 
-   if (video->audio) {
-      al_drain_audio_stream(video->audio);
-      al_destroy_audio_stream(video->audio);
-      video->audio = NULL;
-   }
-   al_destroy_timer(timer);
+static void ycbcr_to_rgb_row(unsigned char *data, const unsigned char *yp,
+   const unsigned char *cbp, const unsigned char *crp, int w, int xshift)
+{
+   int done = 0;
 
-   ALLEGRO_DEBUG("Thread exit.\n");
+#if defined(SIMD_X86)
+   if (al_get_cpu_features() & ALLEGRO_CPU_SSE2)
+      done = ycbcr_to_rgb_row_sse2(data, yp, cbp, crp, w, xshift);
+#elif defined(SIMD_NEON)
+   if (al_get_cpu_features() & ALLEGRO_CPU_NEON)
+      done = ycbcr_to_rgb_row_neon(data, yp, cbp, crp, w, xshift);
+#endif
 
-   return NULL;
+   ycbcr_to_rgb_row_generic(data, yp, cbp, crp, done, w, xshift);
 }
 
 
-static bool update_frame_bmp(OGG_VIDEO *ogv)
+static bool convert_frame_bmp_on_cpu(OGG_VIDEO *ogv, VIDEO_FRAME *frame)
 {
    ALLEGRO_LOCKED_REGION *lr;
    int y;
-   int pitch = al_get_pixel_size(RGB_PIXEL_FORMAT) * al_get_bitmap_width(ogv->frame_bmp);
 
    lr = al_lock_bitmap(ogv->frame_bmp, RGB_PIXEL_FORMAT,
       ALLEGRO_LOCK_WRITEONLY);
@@ -1129,14 +1250,944 @@ static bool update_frame_bmp(OGG_VIDEO *ogv)
       return false;
    }
 
-   for (y = 0; y < al_get_bitmap_height(ogv->frame_bmp); y++) {
-      memcpy((unsigned char*)lr->data + y * lr->pitch, ogv->rgb_data + y * pitch, pitch);
+   for (y = 0; y < ogv->plane_h[0]; y++) {
+      const int y2 = y >> ogv->yshift;
+      ycbcr_to_rgb_row((unsigned char *)lr->data + y * lr->pitch,
+         frame->plane_data[0] + y * ogv->plane_w[0],
+         frame->plane_data[1] + y2 * ogv->plane_w[1],
+         frame->plane_data[2] + y2 * ogv->plane_w[2],
+         ogv->plane_w[0], ogv->xshift);
    }
 
    al_unlock_bitmap(ogv->frame_bmp);
    return true;
 }
 
+/* Y'CrCb to RGB conversion on the GPU. */
+
+#ifdef ALLEGRO_CFG_SHADER_GLSL
+static const char *ycbcr_pixel_source =
+   "#ifdef GL_ES\n"
+   "precision mediump float;\n"
+   "#endif\n"
+   "uniform sampler2D " ALLEGRO_SHADER_VAR_TEX ";\n"
+   "uniform sampler2D video_cb;\n"
+   "uniform sampler2D video_cr;\n"
+   "varying vec2 varying_texcoord;\n"
+   "\n"
+   "void main()\n"
+   "{\n"
+   "  float y = texture2D(" ALLEGRO_SHADER_VAR_TEX ", varying_texcoord).r - 16.0 / 255.0;\n"
+   "  float cb = texture2D(video_cb, varying_texcoord).r - 128.0 / 255.0;\n"
+   "  float cr = texture2D(video_cr, varying_texcoord).r - 128.0 / 255.0;\n"
+   "  vec3 rgb = vec3(1.164 * y + 1.598 * cr,\n"
+   "                  1.164 * y - 0.391 * cb - 0.813 * cr,\n"
+   "                  1.164 * y + 2.016 * cb);\n"
+   "  gl_FragColor = vec4(clamp(rgb, 0.0, 1.0), 1.0);\n"
+   "}\n";
+#endif
+
+static void free_gpu_conversion(OGG_VIDEO *ogv)
+{
+   int i;
+
+   for (i = 0; i < 3; i++) {
+      _al_video_destroy_frame_bitmap(ogv->plane_bmp[i]);
+      ogv->plane_bmp[i] = NULL;
+   }
+   if (ogv->shader) {
+      al_destroy_shader(ogv->shader);
+      ogv->shader = NULL;
+   }
+}
+
+/* Prepares the plane bitmaps and the shader for converting the frames on
+ * the GPU. If that fails the frames are converted on the CPU.
+ */
+static void setup_gpu_conversion(OGG_VIDEO *ogv)
+{
+#ifdef ALLEGRO_CFG_SHADER_GLSL
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+   ALLEGRO_STATE state;
+   const char *value;
+   const char *vertex_source;
+   int i;
+
+   value = al_get_config_value(al_get_system_config(), "video",
+      "gpu_conversion");
+   if (value && !strcmp(value, "false"))
+      return;
+
+   if (!ogv->frame_bmp ||
+         (al_get_bitmap_flags(ogv->frame_bmp) & ALLEGRO_MEMORY_BITMAP))
+      return;
+   if (!display || !(al_get_display_flags(display) & ALLEGRO_OPENGL) ||
+         !(al_get_display_flags(display) & ALLEGRO_PROGRAMMABLE_PIPELINE))
+      return;
+
+   ogv->shader = al_create_shader(ALLEGRO_SHADER_GLSL);
+   if (!ogv->shader)
+      return;
+   vertex_source = al_get_default_shader_source(ALLEGRO_SHADER_GLSL,
+      ALLEGRO_VERTEX_SHADER);
+   if (!vertex_source ||
+         !al_attach_shader_source(ogv->shader, ALLEGRO_VERTEX_SHADER,
+            vertex_source) ||
+         !al_attach_shader_source(ogv->shader, ALLEGRO_PIXEL_SHADER,
+            ycbcr_pixel_source) ||
+         !al_build_shader(ogv->shader)) {
+      ALLEGRO_WARN("Failed to build the Y'CbCr shader: %s\n",
+         al_get_shader_log(ogv->shader));
+      free_gpu_conversion(ogv);
+      return;
+   }
+
+   al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+   al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_SINGLE_CHANNEL_8);
+   for (i = 0; i < 3; i++) {
+      /* The chroma planes are scaled up with bilinear filtering. */
+      al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP |
+         (i ? ALLEGRO_MIN_LINEAR | ALLEGRO_MAG_LINEAR : 0));
+      ogv->plane_bmp[i] = _al_video_create_frame_bitmap(ogv->plane_w[i],
+         ogv->plane_h[i]);
+      if (!ogv->plane_bmp[i] ||
+            al_get_bitmap_format(ogv->plane_bmp[i]) !=
+               ALLEGRO_PIXEL_FORMAT_SINGLE_CHANNEL_8) {
+         break;
+      }
+   }
+   al_restore_state(&state);
+
+   if (i < 3) {
+      ALLEGRO_WARN("Single channel planes are not supported.\n");
+      free_gpu_conversion(ogv);
+      return;
+   }
+
+   ALLEGRO_INFO("Converting frames with a shader.\n");
+#else
+   (void)ogv;
+#endif
+}
+
+static void free_frames(OGG_VIDEO *ogv)
+{
+   int i, j;
+
+   if (!ogv->frames)
+      return;
+
+   for (i = 0; i < ogv->max_frames; i++) {
+      for (j = 0; j < 3; j++) {
+         _al_video_free_frame_buffer(ogv->frames[i].plane_data[j],
+            ogv->plane_w[j] * ogv->plane_h[j]);
+      }
+   }
+   al_free(ogv->frames);
+   ogv->frames = NULL;
+   ogv->max_frames = 0;
+}
+
+static int get_frame_queue_size(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "video",
+      "frame_queue_size");
+   int size = value ? atoi(value) : DEFAULT_FRAME_QUEUE_SIZE;
+
+   if (size < 1) {
+      ALLEGRO_WARN("frame_queue_size must be at least 1, got %s.\n", value);
+      size = 1;
+   }
+   return size;
+}
+
+static bool setup_frames(OGG_VIDEO *ogv, int frame_w, int frame_h)
+{
+   int i, j;
+
+   switch (ogv->pixel_fmt) {
+      case TH_PF_420:
+         ogv->xshift = 1;
+         ogv->yshift = 1;
+         break;
+      case TH_PF_422:
+         ogv->xshift = 1;
+         ogv->yshift = 0;
+         break;
+      case TH_PF_444:
+         ogv->xshift = 0;
+         ogv->yshift = 0;
+         break;
+      default:
+         ALLEGRO_ERROR("Unsupported pixel format.\n");
+         return false;
+   }
+
+   for (j = 0; j < 3; j++) {
+      ogv->plane_w[j] = j ? frame_w >> ogv->xshift : frame_w;
+      ogv->plane_h[j] = j ? frame_h >> ogv->yshift : frame_h;
+   }
+
+   ogv->max_frames = get_frame_queue_size();
+   ogv->frames = al_calloc(ogv->max_frames, sizeof(VIDEO_FRAME));
+   if (!ogv->frames) {
+      ogv->max_frames = 0;
+      return false;
+   }
+   for (i = 0; i < ogv->max_frames; i++) {
+      for (j = 0; j < 3; j++) {
+         ogv->frames[i].plane_data[j] =
+            _al_video_alloc_frame_buffer(ogv->plane_w[j] * ogv->plane_h[j]);
+         if (!ogv->frames[i].plane_data[j]) {
+            free_frames(ogv);
+            return false;
+         }
+      }
+   }
+
+   ALLEGRO_INFO("Frame queue size: %d\n", ogv->max_frames);
+   return true;
+}
+
+static VIDEO_FRAME *get_queued_frame(OGG_VIDEO *ogv, int i)
+{
+   return &ogv->frames[(ogv->first_frame + i) % ogv->max_frames];
+}
+
+/* Returns the slot after the last queued frame, or NULL if the queue is
+ * full.
+ */
+static VIDEO_FRAME *get_free_frame(OGG_VIDEO *ogv)
+{
+   VIDEO_FRAME *frame = NULL;
+
+   al_lock_mutex(ogv->mutex);
+   if (ogv->num_frames < ogv->max_frames)
+      frame = get_queued_frame(ogv, ogv->num_frames);
+   al_unlock_mutex(ogv->mutex);
+
+   return frame;
+}
+
+/* Returns how many of the queued frames are due at the given time.
+ * Must be called with the mutex held.
+ */
+static int count_due_frames(OGG_VIDEO *ogv, double time)
+{
+   int n = 0;
+
+   /* Allow for the rounding errors of accumulating positions. */
+   while (n < ogv->num_frames && get_queued_frame(ogv, n)->pts <= time + 1e-6)
+      n++;
+   return n;
+}
+
+/* Copies the planes out of the decoder's buffer, which is only valid until
+ * the next packet is decoded.
+ */
+static void copy_planes(OGG_VIDEO *ogv, th_ycbcr_buffer buffer,
+   VIDEO_FRAME *frame)
+{
+   int i, y;
+
+   for (i = 0; i < 3; i++) {
+      const th_img_plane *plane = &buffer[i];
+      const int w = ogv->plane_w[i];
+      const int h = ogv->plane_h[i];
+
+      ASSERT(plane->width == w);
+      ASSERT(plane->height == h);
+
+      for (y = 0; y < h; y++) {
+         memcpy(frame->plane_data[i] + y * w, plane->data + y * plane->stride,
+            w);
+      }
+   }
+}
+
+/* Decodes packets until a frame comes out. If the video has fallen far
+ * behind the playback position, the frames in between are skipped and
+ * counted in *skipped. Returns false if not enough packets have been
+ * demuxed yet.
+ */
+static bool decode_theora_frame(ALLEGRO_VIDEO *video, STREAM *tstream_outer,
+   unsigned int *skipped)
+{
+   OGG_VIDEO * const ogv = video->data;
+   THEORA_STREAM * const tstream = &tstream_outer->u.theora;
+   bool new_frame = false;
+
+   for (;;) {
+      PACKET_NODE *node = take_packet(ogv, tstream_outer);
+      bool got_frame = false;
+
+      if (!node) {
+         break;
+      }
+      if (handle_theora_data(video, tstream, &node->pkt, &got_frame)) {
+         free_packet_node(node);
+      }
+      else {
+         put_back_packet(ogv, tstream_outer, node);
+      }
+
+      if (got_frame) {
+         if (new_frame) {
+            (*skipped)++;
+         }
+         new_frame = true;
+      }
+
+      /* Only skip frames if we are really falling behind, not just slightly
+       * ahead of the target position.
+       * XXX improve frame skipping algorithm
+       */
+      if (new_frame && video->video_position
+            >= video->position - 3.0*tstream->frame_duration) {
+         break;
+      }
+   }
+
+   return new_frame;
+}
+
+/* Decodes ahead until the frame queue is full. Returns the number of frames
+ * added to the queue.
+ */
+static int poll_theora_decode(ALLEGRO_VIDEO *video, STREAM *tstream_outer)
+{
+   OGG_VIDEO * const ogv = video->data;
+   THEORA_STREAM * const tstream = &tstream_outer->u.theora;
+   VIDEO_FRAME *frame;
+   int num_frames = 0;
+   int queued;
+   int rc;
+
+   if (!ogv->frames)
+      return 0;
+
+   while ((frame = get_free_frame(ogv))) {
+      const double start = al_get_time();
+      unsigned int skipped = 0;
+      th_ycbcr_buffer buffer;
+
+      if (!decode_theora_frame(video, tstream_outer, &skipped)) {
+         if (skipped > 0) {
+            _al_video_frames_dropped(video, skipped);
+         }
+         break;
+      }
+
+      rc = th_decode_ycbcr_out(tstream->ctx, buffer);
+      ASSERT(rc == 0);
+
+      copy_planes(ogv, buffer, frame);
+      frame->pts = video->video_position;
+      frame->announced = false;
+
+      al_lock_mutex(ogv->mutex);
+      queued = ++ogv->num_frames;
+      al_unlock_mutex(ogv->mutex);
+
+      _al_video_frame_decoded(video, skipped, al_get_time() - start);
+      _al_video_set_queued_frames(video, queued);
+      num_frames++;
+   }
+
+   return num_frames;
+}
+
+/* Sends ALLEGRO_EVENT_VIDEO_FRAME_SHOW when a queued frame becomes due. */
+static void announce_due_frames(ALLEGRO_VIDEO *video)
+{
+   OGG_VIDEO * const ogv = video->data;
+   bool announce = false;
+   int i, n;
+
+   al_lock_mutex(ogv->mutex);
+   n = count_due_frames(ogv, video->position);
+   for (i = 0; i < n; i++) {
+      VIDEO_FRAME *frame = get_queued_frame(ogv, i);
+      if (!frame->announced) {
+         frame->announced = true;
+         announce = true;
+      }
+   }
+   al_unlock_mutex(ogv->mutex);
+
+   if (announce) {
+      ALLEGRO_EVENT event;
+      event.type = ALLEGRO_EVENT_VIDEO_FRAME_SHOW;
+      event.user.data1 = (intptr_t)video;
+      al_emit_user_event(&video->es, &event, NULL);
+   }
+}
+
+/* Returns true once the whole file has been demuxed, all packets have been
+ * decoded and all queued frames have become due.
+ */
+static bool playback_finished(ALLEGRO_VIDEO *video)
+{
+   OGG_VIDEO * const ogv = video->data;
+   bool finished;
+
+   al_lock_mutex(ogv->demux_mutex);
+   finished = ogv->reached_eof;
+   if (ogv->selected_video_stream && ogv->selected_video_stream->num_packets)
+      finished = false;
+   if (ogv->selected_audio_stream && ogv->selected_audio_stream->num_packets)
+      finished = false;
+   al_unlock_mutex(ogv->demux_mutex);
+
+   if (finished) {
+      al_lock_mutex(ogv->mutex);
+      finished = count_due_frames(ogv, video->position) == ogv->num_frames;
+      al_unlock_mutex(ogv->mutex);
+   }
+
+   return finished;
+}
+
+/* Sends ALLEGRO_EVENT_VIDEO_FINISHED once, from whichever decode thread
+ * notices it first.
+ */
+static void check_finished(ALLEGRO_VIDEO *video)
+{
+   OGG_VIDEO * const ogv = video->data;
+   bool send = false;
+
+   if (!video->playing || !playback_finished(video))
+      return;
+
+   al_lock_mutex(ogv->mutex);
+   if (video->playing) {
+      video->playing = false;
+      send = true;
+   }
+   al_unlock_mutex(ogv->mutex);
+
+   if (send) {
+      ALLEGRO_EVENT event;
+      event.type = ALLEGRO_EVENT_VIDEO_FINISHED;
+      event.user.data1 = (intptr_t)video;
+      al_emit_user_event(&video->es, &event, NULL);
+   }
+}
+
+
+/* Seeking. */
+
+/* A page of the video stream on which at least one packet ends. */
+typedef struct PAGE_INDEX_ENTRY {
+   ogg_int64_t granulepos;          /* of the last packet ending on the page */
+   int64_t next_offset;             /* of the next video page, or -1 */
+   bool next_continued;             /* next page continues a packet */
+} PAGE_INDEX_ENTRY;
+
+static ogg_int64_t read_le64(const unsigned char *p)
+{
+   ogg_int64_t v = 0;
+   int i;
+
+   for (i = 7; i >= 0; i--) {
+      v = (v << 8) | p[i];
+   }
+   return v;
+}
+
+static uint32_t read_le32(const unsigned char *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Records the pages of the video stream by reading only the page headers
+ * and seeking over the bodies, so this costs one small read per page.
+ */
+static void build_page_index(OGG_VIDEO *ogv)
+{
+   const uint32_t serial = ogv->selected_video_stream->state.serialno;
+   unsigned char header[27 + 255];
+   PAGE_INDEX_ENTRY *last = NULL;
+   int64_t offset = 0;
+
+   ogv->page_index_built = true;
+
+   while (al_fseek(ogv->fp, offset, ALLEGRO_SEEK_SET)
+         && al_fread(ogv->fp, header, 27) == 27) {
+      const int num_segments = header[26];
+      int64_t body_size = 0;
+      int i;
+
+      if (memcmp(header, "OggS", 4) != 0 || header[4] != 0) {
+         ALLEGRO_WARN("No Ogg page at offset %ld, index ends there.\n",
+            (long)offset);
+         break;
+      }
+      if (al_fread(ogv->fp, header + 27, num_segments) !=
+            (size_t)num_segments) {
+         break;
+      }
+      for (i = 0; i < num_segments; i++) {
+         body_size += header[27 + i];
+      }
+
+      if (read_le32(header + 14) == serial) {
+         const ogg_int64_t granulepos = read_le64(header + 6);
+
+         if (last) {
+            last->next_offset = offset;
+            last->next_continued = header[5] & 1;
+            last = NULL;
+         }
+         if (granulepos != -1) {
+            last = _al_vector_alloc_back(&ogv->page_index);
+            last->granulepos = granulepos;
+            last->next_offset = -1;
+            last->next_continued = false;
+         }
+      }
+
+      offset += 27 + num_segments + body_size;
+   }
+
+   ALLEGRO_DEBUG("Indexed %d video pages.\n",
+      (int)_al_vector_size(&ogv->page_index));
+}
+
+/* Returns the index of the first page whose last frame is at least frame,
+ * or the number of pages if there is none.
+ */
+static unsigned find_page(OGG_VIDEO *ogv, THEORA_STREAM *tstream,
+   int64_t frame)
+{
+   unsigned lo = 0;
+   unsigned hi = _al_vector_size(&ogv->page_index);
+
+   while (lo < hi) {
+      const unsigned mid = lo + (hi - lo) / 2;
+      const PAGE_INDEX_ENTRY *e = _al_vector_ref(&ogv->page_index, mid);
+
+      if (th_granule_frame(&tstream->info, e->granulepos) < frame)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return lo;
+}
+
+static void reset_streams(OGG_VIDEO *ogv)
+{
+   unsigned i;
+   int rc;
+
+   for (i = 0; i < _al_vector_size(&ogv->streams); i++) {
+      STREAM **slot = _al_vector_ref(&ogv->streams, i);
+      STREAM *stream = *slot;
+
+      ogg_stream_reset(&stream->state);
+      free_packet_queue(stream);
+
+      if (stream->stream_type == STREAM_TYPE_VORBIS &&
+            stream->u.vorbis.inited_for_data) {
+         VORBIS_STREAM *vstream = &stream->u.vorbis;
+         vorbis_synthesis_restart(&vstream->dsp);
+         vstream->fragment_pos = 0;
+         vstream->skip_to_sample = -1;
+      }
+   }
+
+   rc = ogg_sync_reset(&ogv->sync_state);
+   ASSERT(rc == 0);
+
+   ogv->reached_eof = false;
+   ogv->first_frame = 0;
+   ogv->num_frames = 0;
+}
+
+static void seek_to_beginning(ALLEGRO_VIDEO *video, OGG_VIDEO *ogv,
+   THEORA_STREAM *tstream)
+{
+   int rc;
+   bool seeked;
+
+   reset_streams(ogv);
+
+   if (tstream) {
+      ogg_int64_t granpos = 0;
+
+      rc = th_decode_ctl(tstream->ctx, TH_DECCTL_SET_GRANPOS, &granpos,
+         sizeof(granpos));
+      ASSERT(rc == 0);
+
+      tstream->prev_framenum = -1;
+      tstream->need_keyframe = false;
+   }
+
+   seeked = al_fseek(ogv->fp, 0, SEEK_SET);
+   ASSERT(seeked);
+   /* XXX read enough file data to get into position */
+
+   video->audio_position = 0.0;
+   video->video_position = 0.0;
+   video->position = 0.0;
+}
+
+/* Positions the file just before the keyframe that the frame at seek_to
+ * depends on. The video thread then decodes from the keyframe and skips
+ * the frames before seek_to, and the audio thread drops the samples before
+ * it. Returns false if seek_to is past the end of the video.
+ */
+static bool seek_to_time(ALLEGRO_VIDEO *video, OGG_VIDEO *ogv,
+   THEORA_STREAM *tstream, double seek_to)
+{
+   const PAGE_INDEX_ENTRY *e;
+   int64_t target, keyframe;
+   ogg_int64_t granulepos;
+   unsigned i;
+
+   if (!ogv->page_index_built) {
+      build_page_index(ogv);
+   }
+
+   target = (int64_t)(seek_to / tstream->frame_duration);
+   i = find_page(ogv, tstream, target);
+   if (i == _al_vector_size(&ogv->page_index)) {
+      return false;
+   }
+
+   e = _al_vector_ref(&ogv->page_index, i);
+   granulepos = e->granulepos >> tstream->info.keyframe_granule_shift
+      << tstream->info.keyframe_granule_shift;
+   keyframe = th_granule_frame(&tstream->info, granulepos);
+
+   /* Start on the page after the last one ending before the keyframe. If
+    * that page continues a packet, the packet is lost, so look for a page
+    * ending at least two frames before the keyframe.
+    */
+   i = find_page(ogv, tstream, keyframe - 1);
+   if (i == 0) {
+      seek_to_beginning(video, ogv, tstream);
+   }
+   else {
+      e = _al_vector_ref(&ogv->page_index, i - 1);
+      ASSERT(e->next_offset >= 0);
+
+      reset_streams(ogv);
+      if (!al_fseek(ogv->fp, e->next_offset, ALLEGRO_SEEK_SET)) {
+         ALLEGRO_ERROR("Failed to seek to %ld.\n", (long)e->next_offset);
+         return false;
+      }
+
+      tstream->prev_framenum = th_granule_frame(&tstream->info, e->granulepos);
+      if (e->next_continued) {
+         tstream->prev_framenum++;
+      }
+      tstream->need_keyframe = true;
+      video->video_position = tstream->prev_framenum * tstream->frame_duration;
+   }
+
+   if (ogv->selected_audio_stream && ogv->selected_audio_stream->active) {
+      VORBIS_STREAM *vstream = &ogv->selected_audio_stream->u.vorbis;
+      vstream->skip_to_sample = seek_to * vstream->info.rate;
+   }
+
+   video->audio_position = seek_to;
+   video->position = seek_to;
+
+   ALLEGRO_DEBUG("Seeking to frame %ld from keyframe %ld.\n",
+      (long)target, (long)keyframe);
+   return true;
+}
+
+/* Decode threads. */
+
+static void *audio_thread_func(ALLEGRO_THREAD *thread, void *_video)
+{
+   ALLEGRO_VIDEO * const video = _video;
+   OGG_VIDEO * const ogv = video->data;
+   STREAM * const vstream_outer = ogv->selected_audio_stream;
+   VORBIS_STREAM * const vstream = &vstream_outer->u.vorbis;
+   const double audio_pos_step = (double)FRAG_SAMPLES / vstream->info.rate;
+
+   ALLEGRO_DEBUG("Audio thread started.\n");
+
+   while (!al_get_thread_should_stop(thread)) {
+      ALLEGRO_EVENT ev;
+
+      al_wait_for_event(ogv->audio_queue, &ev);
+      if (ev.type != ALLEGRO_EVENT_AUDIO_STREAM_FRAGMENT) {
+         continue;
+      }
+
+      /* Audio clock is master when it exists. */
+      /* XXX This doesn't work well when the process is paused then resumed,
+       * due to a problem with the audio addon.  We get a flood of
+       * fragment events which pushes the position field ahead of the
+       * real audio position.
+       */
+      if (video->playing && !playback_finished(video)) {
+         video->audio_position += audio_pos_step;
+         video->position = video->audio_position - NUM_FRAGS * audio_pos_step;
+      }
+
+      update_audio_fragments(video, ogv, vstream_outer);
+
+      check_finished(video);
+   }
+
+   ALLEGRO_DEBUG("Audio thread exit.\n");
+
+   return NULL;
+}
+
+static void *video_thread_func(ALLEGRO_THREAD *thread, void *_video)
+{
+   ALLEGRO_VIDEO * const video = _video;
+   OGG_VIDEO * const ogv = video->data;
+   STREAM * const tstream_outer = ogv->selected_video_stream;
+   THEORA_STREAM * const tstream = &tstream_outer->u.theora;
+   ALLEGRO_TIMER *timer;
+
+   ALLEGRO_DEBUG("Video thread started.\n");
+
+   timer = al_create_timer(tstream->frame_duration);
+   if (!timer) {
+      ALLEGRO_ERROR("Could not create timer.\n");
+      return NULL;
+   }
+   al_register_event_source(ogv->video_queue, al_get_timer_event_source(timer));
+   al_start_timer(timer);
+
+   while (!al_get_thread_should_stop(thread)) {
+      ALLEGRO_EVENT ev;
+
+      al_wait_for_event(ogv->video_queue, &ev);
+      if (ev.type != ALLEGRO_EVENT_TIMER) {
+         continue;
+      }
+
+      /* If no audio then video is master. */
+      if (!video->audio && video->playing && !playback_finished(video)) {
+         video->position += tstream->frame_duration;
+      }
+
+      poll_theora_decode(video, tstream_outer);
+      announce_due_frames(video);
+      check_finished(video);
+   }
+
+   al_destroy_timer(timer);
+
+   ALLEGRO_DEBUG("Video thread exit.\n");
+
+   return NULL;
+}
+
+static void stop_threads(OGG_VIDEO *ogv)
+{
+   ALLEGRO_THREAD **threads[3];
+   ALLEGRO_EVENT ev;
+   int i;
+
+   threads[0] = &ogv->demux_thread;
+   threads[1] = &ogv->audio_thread;
+   threads[2] = &ogv->video_thread;
+
+   for (i = 0; i < 3; i++) {
+      if (*threads[i])
+         al_set_thread_should_stop(*threads[i]);
+   }
+
+   al_lock_mutex(ogv->demux_mutex);
+   al_broadcast_cond(ogv->demux_cond);
+   al_unlock_mutex(ogv->demux_mutex);
+
+   ev.user.type = OGV_EVENT_WAKE_UP;
+   ev.user.data1 = 0;
+   ev.user.data2 = 0;
+   ev.user.data3 = 0;
+   ev.user.data4 = 0;
+   al_emit_user_event(&ogv->evtsrc, &ev, NULL);
+
+   for (i = 0; i < 3; i++) {
+      if (*threads[i]) {
+         al_destroy_thread(*threads[i]);
+         *threads[i] = NULL;
+      }
+   }
+
+   al_flush_event_queue(ogv->audio_queue);
+   al_flush_event_queue(ogv->video_queue);
+}
+
+static bool start_threads(ALLEGRO_VIDEO *video)
+{
+   OGG_VIDEO * const ogv = video->data;
+
+   ogv->demux_thread = al_create_thread(demux_thread_func, video);
+   if (video->audio) {
+      ogv->audio_thread = al_create_thread(audio_thread_func, video);
+   }
+   if (ogv->selected_video_stream) {
+      ogv->video_thread = al_create_thread(video_thread_func, video);
+   }
+
+   if (!ogv->demux_thread ||
+         (video->audio && !ogv->audio_thread) ||
+         (ogv->selected_video_stream && !ogv->video_thread)) {
+      ALLEGRO_ERROR("Could not create threads.\n");
+      stop_threads(ogv);
+      return false;
+   }
+
+   al_start_thread(ogv->demux_thread);
+   if (ogv->audio_thread) {
+      al_start_thread(ogv->audio_thread);
+   }
+   if (ogv->video_thread) {
+      al_start_thread(ogv->video_thread);
+   }
+   return true;
+}
+
+
+static bool upload_plane(OGG_VIDEO *ogv, VIDEO_FRAME *frame, int i)
+{
+   ALLEGRO_BITMAP *bmp = ogv->plane_bmp[i];
+   ALLEGRO_LOCKED_REGION *lr;
+   int w = al_get_bitmap_width(bmp);
+   int y;
+
+   lr = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_SINGLE_CHANNEL_8,
+      ALLEGRO_LOCK_WRITEONLY);
+   if (!lr) {
+      ALLEGRO_ERROR("Failed to lock plane bitmap.\n");
+      return false;
+   }
+
+   for (y = 0; y < al_get_bitmap_height(bmp); y++) {
+      memcpy((unsigned char*)lr->data + y * lr->pitch,
+         frame->plane_data[i] + y * w, w);
+   }
+
+   al_unlock_bitmap(bmp);
+   return true;
+}
+
+/* Draws the uploaded planes with the conversion shader into the target
+ * bitmap, mapping the source rectangle of the frame onto the destination
+ * rectangle. The transformation of the target is left alone.
+ */
+static bool draw_planes(OGG_VIDEO *ogv, ALLEGRO_BITMAP *target,
+   float sx, float sy, float sw, float sh,
+   float dx, float dy, float dw, float dh)
+{
+   ALLEGRO_STATE state;
+   ALLEGRO_TRANSFORM old, identity;
+   bool ret = false;
+
+   al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+   al_set_target_bitmap(target);
+   al_copy_transform(&old, al_get_current_transform());
+   al_identity_transform(&identity);
+   al_use_transform(&identity);
+   if (al_use_shader(ogv->shader)) {
+      al_set_shader_sampler("video_cb", ogv->plane_bmp[1], 1);
+      al_set_shader_sampler("video_cr", ogv->plane_bmp[2], 2);
+      al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+      al_draw_scaled_bitmap(ogv->plane_bmp[0], sx, sy, sw, sh,
+         dx, dy, dw, dh, 0);
+      al_use_shader(NULL);
+      ret = true;
+   }
+   else {
+      ALLEGRO_ERROR("Failed to use the Y'CbCr shader.\n");
+   }
+   al_use_transform(&old);
+   al_restore_state(&state);
+
+   return ret;
+}
+
+static bool upload_planes(OGG_VIDEO *ogv, VIDEO_FRAME *frame)
+{
+   int i;
+
+   for (i = 0; i < 3; i++) {
+      if (!upload_plane(ogv, frame, i))
+         return false;
+   }
+   return true;
+}
+
+/* Uploads the planes and draws them into frame_bmp with the conversion
+ * shader.
+ */
+static bool convert_frame_bmp_on_gpu(OGG_VIDEO *ogv, VIDEO_FRAME *frame)
+{
+   const float w = al_get_bitmap_width(ogv->frame_bmp);
+   const float h = al_get_bitmap_height(ogv->frame_bmp);
+
+   if (!upload_planes(ogv, frame))
+      return false;
+   return draw_planes(ogv, ogv->frame_bmp, 0, 0, w, h, 0, 0, w, h);
+}
+
+static bool update_frame_bmp(OGG_VIDEO *ogv, VIDEO_FRAME *frame)
+{
+   if (ogv->shader)
+      return convert_frame_bmp_on_gpu(ogv, frame);
+   return convert_frame_bmp_on_cpu(ogv, frame);
+}
+
+/* Converts the picture of the frame straight into the target bitmap set
+ * with al_set_video_target_bitmap, scaled to fit. With the shader this is
+ * a single pass; otherwise the frame is converted into frame_bmp first and
+ * then drawn scaled.
+ */
+static bool draw_frame_to_target(ALLEGRO_VIDEO *video, OGG_VIDEO *ogv,
+   VIDEO_FRAME *frame)
+{
+   ALLEGRO_BITMAP *target = video->target_bitmap;
+   const float sx = al_get_bitmap_x(ogv->pic_bmp);
+   const float sy = al_get_bitmap_y(ogv->pic_bmp);
+   const float sw = al_get_bitmap_width(ogv->pic_bmp);
+   const float sh = al_get_bitmap_height(ogv->pic_bmp);
+   ALLEGRO_STATE state;
+   ALLEGRO_TRANSFORM old, identity;
+   float dx, dy, dw, dh;
+
+   _al_video_get_target_rect(video, &dx, &dy, &dw, &dh);
+
+   if (dw < al_get_bitmap_width(target) || dh < al_get_bitmap_height(target)) {
+      al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP);
+      al_set_target_bitmap(target);
+      al_clear_to_color(al_map_rgb(0, 0, 0));
+      al_restore_state(&state);
+   }
+
+   if (ogv->shader && !(al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP)) {
+      if (!upload_planes(ogv, frame))
+         return false;
+      return draw_planes(ogv, target, sx, sy, sw, sh, dx, dy, dw, dh);
+   }
+
+   if (!update_frame_bmp(ogv, frame))
+      return false;
+
+   al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+   al_set_target_bitmap(target);
+   al_copy_transform(&old, al_get_current_transform());
+   al_identity_transform(&identity);
+   al_use_transform(&identity);
+   al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+   al_draw_scaled_bitmap(ogv->pic_bmp, 0, 0, sw, sh, dx, dy, dw, dh, 0);
+   al_use_transform(&old);
+   al_restore_state(&state);
+
+   return true;
+}
+
 
 /* Video interface. */
 
@@ -1195,6 +2246,7 @@ static bool ogv_open_video(ALLEGRO_VIDEO *video)
    rc = ogg_sync_init(&ogv->sync_state);
    ASSERT(rc == 0);
    _al_vector_init(&ogv->streams, sizeof(STREAM *));
+   _al_vector_init(&ogv->page_index, sizeof(PAGE_INDEX_ENTRY));
 
    if (!do_open_video(video, ogv)) {
       ALLEGRO_ERROR("No audio or video stream found.\n");
@@ -1202,7 +2254,7 @@ static bool ogv_open_video(ALLEGRO_VIDEO *video)
       return false;
    }
 
-   /* ogv->mutex and ogv->thread are created in ogv_start_video. */
+   /* The mutexes and threads are created in ogv_start_video. */
 
    video->data = ogv;
    return true;
@@ -1215,13 +2267,19 @@ static bool ogv_close_video(ALLEGRO_VIDEO *video)
 
    ogv = video->data;
    if (ogv) {
-      if (ogv->thread) {
-         al_join_thread(ogv->thread, NULL);
+      if (ogv->started) {
+         stop_threads(ogv);
+         if (video->audio) {
+            al_drain_audio_stream(video->audio);
+            al_destroy_audio_stream(video->audio);
+            video->audio = NULL;
+         }
+         al_destroy_event_queue(ogv->audio_queue);
+         al_destroy_event_queue(ogv->video_queue);
          al_destroy_user_event_source(&ogv->evtsrc);
-         al_destroy_event_queue(ogv->queue);
          al_destroy_mutex(ogv->mutex);
-         al_destroy_cond(ogv->cond);
-         al_destroy_thread(ogv->thread);
+         al_destroy_mutex(ogv->demux_mutex);
+         al_destroy_cond(ogv->demux_cond);
       }
 
       al_fclose(ogv->fp);
@@ -1231,12 +2289,14 @@ static bool ogv_close_video(ALLEGRO_VIDEO *video)
          free_stream(*slot);
       }
       _al_vector_free(&ogv->streams);
+      _al_vector_free(&ogv->page_index);
       if (ogv->pic_bmp != ogv->frame_bmp) {
          al_destroy_bitmap(ogv->pic_bmp);
       }
-      al_destroy_bitmap(ogv->frame_bmp);
+      _al_video_destroy_frame_bitmap(ogv->frame_bmp);
 
-      al_free(ogv->rgb_data);
+      free_gpu_conversion(ogv);
+      free_frames(ogv);
 
       al_free(ogv);
    }
@@ -1250,32 +2310,45 @@ static bool ogv_start_video(ALLEGRO_VIDEO *video)
 {
    OGG_VIDEO *ogv = video->data;
 
-   if (ogv->thread != NULL) {
-      ALLEGRO_ERROR("Thread already created.\n");
+   if (ogv->started) {
+      ALLEGRO_ERROR("Threads already created.\n");
       return false;
    }
 
-   ogv->thread = al_create_thread(decode_thread_func, video);
-   if (!ogv->thread) {
-      ALLEGRO_ERROR("Could not create thread.\n");
+   if (ogv->selected_audio_stream) {
+      video->audio = create_audio_stream(video, ogv->selected_audio_stream);
+      if (!video->audio) {
+         deactivate_stream(ogv->selected_audio_stream);
+      }
+   }
+
+   if (!ogv->selected_video_stream && !video->audio) {
+      ALLEGRO_WARN("No audio or video stream found.\n");
       return false;
    }
 
    al_init_user_event_source(&ogv->evtsrc);
-   ogv->queue = al_create_event_queue();
+   ogv->audio_queue = al_create_event_queue();
+   ogv->video_queue = al_create_event_queue();
    ogv->mutex = al_create_mutex();
-   ogv->cond = al_create_cond();
+   ogv->demux_mutex = al_create_mutex();
+   ogv->demux_cond = al_create_cond();
+   ogv->started = true;
 
-   al_register_event_source(ogv->queue, &ogv->evtsrc);
+   al_register_event_source(ogv->audio_queue, &ogv->evtsrc);
+   al_register_event_source(ogv->video_queue, &ogv->evtsrc);
+   if (video->audio) {
+      al_register_event_source(ogv->audio_queue,
+         al_get_audio_stream_event_source(video->audio));
+   }
 
-   al_start_thread(ogv->thread);
-   return true;
+   return start_threads(video);
 }
 
 static bool ogv_set_video_playing(ALLEGRO_VIDEO *video)
 {
    OGG_VIDEO * const ogv = video->data;
-   if (ogv->reached_eof) {
+   if (ogv->started && playback_finished(video)) {
       video->playing = false;
    }
    return true;
@@ -1284,58 +2357,77 @@ static bool ogv_set_video_playing(ALLEGRO_VIDEO *video)
 static bool ogv_seek_video(ALLEGRO_VIDEO *video, double seek_to)
 {
    OGG_VIDEO *ogv = video->data;
-   ALLEGRO_EVENT ev;
-   int seek_counter;
+   THEORA_STREAM *tstream = NULL;
+   bool ret = true;
 
-   /* XXX we only know how to seek to beginning */
-   if (seek_to > 0.0) {
-      return false;
+   if (ogv->selected_video_stream) {
+      tstream = &ogv->selected_video_stream->u.theora;
    }
 
-   al_lock_mutex(ogv->mutex);
-
-   seek_counter = ogv->seek_counter;
-
-   ev.user.type = _ALLEGRO_EVENT_VIDEO_SEEK;
-   ev.user.data1 = seek_to * 1.0e6;
-   ev.user.data2 = 0;
-   ev.user.data3 = 0;
-   ev.user.data4 = 0;
-   al_emit_user_event(&ogv->evtsrc, &ev, NULL);
-
-   while (seek_counter == ogv->seek_counter) {
-      al_wait_cond(ogv->cond, ogv->mutex);
+   /* XXX without video there is no index to seek with */
+   if (seek_to > 0.0 && !tstream) {
+      return false;
    }
 
-   al_unlock_mutex(ogv->mutex);
-
-   return true;
+   /* The threads are restarted rather than paused, as the file, the Ogg
+    * streams and the decoders are all reset.
+    */
+   if (ogv->started) {
+      stop_threads(ogv);
+   }
+   if (seek_to > 0.0) {
+      ret = seek_to_time(video, ogv, tstream, seek_to);
+   }
+   else {
+      seek_to_beginning(video, ogv, tstream);
+   }
+   _al_video_set_queued_frames(video, 0);
+   if (ogv->started && !start_threads(video)) {
+      ret = false;
+   }
+   return ret;
 }
 
-static bool ogv_update_video(ALLEGRO_VIDEO *video)
+static bool ogv_update_video(ALLEGRO_VIDEO *video, double time)
 {
    OGG_VIDEO *ogv = video->data;
-   int w, h;
-   bool ret;
+   bool ret = true;
+   int n;
 
-   al_lock_mutex(ogv->mutex);
+   if (!ogv->frame_bmp || !ogv->frames)
+      return false;
 
-   w = ogv->buffer[0].width;
-   h = ogv->buffer[0].height;
+   al_lock_mutex(ogv->mutex);
 
-   if (w > 0 && h && h > 0 && ogv->frame_bmp) {
-      ASSERT(w == al_get_bitmap_width(ogv->frame_bmp));
-      ASSERT(h == al_get_bitmap_height(ogv->frame_bmp));
+   /* Show the newest frame that is due and drop the ones before it. Frames
+    * that are not due yet stay queued.
+    */
+   n = count_due_frames(ogv, time);
+   if (n > 0) {
+      VIDEO_FRAME *frame = get_queued_frame(ogv, n - 1);
+      const double start = al_get_time();
 
-      if (ogv->buffer_dirty) {
-         ret = update_frame_bmp(ogv);
-         ogv->buffer_dirty = false;
+      if (video->target_bitmap) {
+         ret = draw_frame_to_target(video, ogv, frame);
       }
       else {
-         ret = true;
+         ret = update_frame_bmp(ogv, frame);
       }
+      _al_video_frame_converted(video, al_get_time() - start);
+      _al_video_frame_shown(video, frame->pts, time);
+      if (n > 1) {
+         _al_video_frames_dropped(video, n - 1);
+      }
+
+      ogv->have_frame = true;
+      ogv->first_frame = (ogv->first_frame + n) % ogv->max_frames;
+      ogv->num_frames -= n;
+      _al_video_set_queued_frames(video, ogv->num_frames);
+   }
 
-      video->current_frame = ogv->pic_bmp;
+   if (ogv->have_frame) {
+      video->current_frame = video->target_bitmap ?
+         video->target_bitmap : ogv->pic_bmp;
    }
    else {
       /* No frame ready yet. */
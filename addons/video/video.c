@@ -40,9 +40,12 @@
  
 #include "allegro5/allegro5.h"
 #include "allegro5/allegro_video.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_video.h"
 #include "allegro5/internal/aintern_video_cfg.h"
 #include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_vector.h"
 
 ALLEGRO_DEBUG_CHANNEL("video")
 
@@ -50,27 +53,58 @@ ALLEGRO_DEBUG_CHANNEL("video")
 /* globals */
 static bool video_inited = false;
 
+/* Several handlers may be registered for the same extension, e.g. a
+ * hardware decoder and a software fallback. They are tried in the order
+ * they were added until one of them can open the file.
+ */
 typedef struct VideoHandler {
    struct VideoHandler *next;
    const char *extension;
+   const char *name;
    ALLEGRO_VIDEO_INTERFACE *vtable;
 } VideoHandler;
 
 static VideoHandler *handlers;
 
-static ALLEGRO_VIDEO_INTERFACE *find_handler(const char *extension)
+/* Frame bitmaps and buffers of closed videos are kept for reuse by the next
+ * video of the same size, so playing many short clips does not keep
+ * recreating textures. A bitmap is only reused if it was created with the
+ * same new bitmap format and flags, on the current display. At most
+ * frame_pool_size of each are kept; the oldest ones go first.
+ */
+typedef struct POOLED_BITMAP {
+   ALLEGRO_BITMAP *bmp;
+   int format;
+   int flags;
+} POOLED_BITMAP;
+
+typedef struct POOLED_BUFFER {
+   void *buffer;
+   size_t size;
+} POOLED_BUFFER;
+
+static ALLEGRO_MUTEX *pool_mutex;
+static _AL_VECTOR lent_bitmaps = _AL_VECTOR_INITIALIZER(POOLED_BITMAP);
+static _AL_VECTOR free_bitmaps = _AL_VECTOR_INITIALIZER(POOLED_BITMAP);
+static _AL_VECTOR free_buffers = _AL_VECTOR_INITIALIZER(POOLED_BUFFER);
+
+/* Returns the first handler after v (or the first one, if v is NULL) for
+ * the extension.
+ */
+static VideoHandler *find_handler(VideoHandler *v, const char *extension)
 {
-   VideoHandler *v = handlers;
+   v = v ? v->next : handlers;
    while (v) {
-      if (!strcmp(extension, v->extension)) {
-         return v->vtable;
+      if (!_al_stricmp(extension, v->extension)) {
+         return v;
       }
       v = v->next;
    }
    return NULL;
 }
 
-static void add_handler(const char *extension, ALLEGRO_VIDEO_INTERFACE *vtable)
+static void add_handler(const char *extension, const char *name,
+   ALLEGRO_VIDEO_INTERFACE *vtable)
 {
    VideoHandler *v;
    if (handlers == NULL) {
@@ -86,41 +120,234 @@ static void add_handler(const char *extension, ALLEGRO_VIDEO_INTERFACE *vtable)
       v = v->next;
    }
    v->extension = extension;
+   v->name = name;
    v->vtable = vtable;
 }
 
+static unsigned int get_frame_pool_size(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "video",
+      "frame_pool_size");
+   int size = value ? atoi(value) : 0;
+
+   return size > 0 ? size : 0;
+}
+
+static void free_frame_pool(void)
+{
+   unsigned i;
+
+   for (i = 0; i < _al_vector_size(&free_bitmaps); i++) {
+      POOLED_BITMAP *pb = _al_vector_ref(&free_bitmaps, i);
+      al_destroy_bitmap(pb->bmp);
+   }
+   for (i = 0; i < _al_vector_size(&free_buffers); i++) {
+      POOLED_BUFFER *pb = _al_vector_ref(&free_buffers, i);
+      al_free(pb->buffer);
+   }
+   _al_vector_free(&lent_bitmaps);
+   _al_vector_free(&free_bitmaps);
+   _al_vector_free(&free_buffers);
+}
+
+/* _al_video_create_frame_bitmap:
+ *  Like al_create_bitmap, but takes a pooled bitmap if there is one. The
+ *  contents of a pooled bitmap are undefined. Release the bitmap with
+ *  _al_video_destroy_frame_bitmap.
+ */
+ALLEGRO_BITMAP *_al_video_create_frame_bitmap(int w, int h)
+{
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+   const int format = al_get_new_bitmap_format();
+   const int flags = al_get_new_bitmap_flags();
+   ALLEGRO_BITMAP *bmp = NULL;
+   POOLED_BITMAP *pb;
+   unsigned i;
+
+   if (!pool_mutex)
+      return al_create_bitmap(w, h);
+
+   al_lock_mutex(pool_mutex);
+   for (i = 0; i < _al_vector_size(&free_bitmaps); i++) {
+      pb = _al_vector_ref(&free_bitmaps, i);
+      if (pb->format == format && pb->flags == flags &&
+            al_get_bitmap_width(pb->bmp) == w &&
+            al_get_bitmap_height(pb->bmp) == h &&
+            ((flags & ALLEGRO_MEMORY_BITMAP) ||
+               _al_get_bitmap_display(pb->bmp) == display)) {
+         bmp = pb->bmp;
+         _al_vector_delete_at(&free_bitmaps, i);
+         ALLEGRO_DEBUG("Reusing a %dx%d frame bitmap.\n", w, h);
+         break;
+      }
+   }
+   al_unlock_mutex(pool_mutex);
+
+   if (!bmp) {
+      bmp = al_create_bitmap(w, h);
+      if (!bmp)
+         return NULL;
+   }
+
+   al_lock_mutex(pool_mutex);
+   pb = _al_vector_alloc_back(&lent_bitmaps);
+   if (pb) {
+      pb->bmp = bmp;
+      pb->format = format;
+      pb->flags = flags;
+   }
+   al_unlock_mutex(pool_mutex);
+
+   return bmp;
+}
+
+/* _al_video_destroy_frame_bitmap:
+ *  Returns a bitmap from _al_video_create_frame_bitmap to the pool, or
+ *  destroys it if the pool is full or disabled.
+ */
+void _al_video_destroy_frame_bitmap(ALLEGRO_BITMAP *bmp)
+{
+   const unsigned int pool_size = get_frame_pool_size();
+   POOLED_BITMAP lent;
+   bool found = false;
+   unsigned i;
+
+   if (!bmp)
+      return;
+   if (!pool_mutex) {
+      al_destroy_bitmap(bmp);
+      return;
+   }
+
+   al_lock_mutex(pool_mutex);
+   for (i = 0; i < _al_vector_size(&lent_bitmaps); i++) {
+      POOLED_BITMAP *pb = _al_vector_ref(&lent_bitmaps, i);
+      if (pb->bmp == bmp) {
+         lent = *pb;
+         _al_vector_delete_at(&lent_bitmaps, i);
+         found = true;
+         break;
+      }
+   }
+
+   if (found && pool_size > 0) {
+      if (_al_vector_size(&free_bitmaps) >= pool_size) {
+         POOLED_BITMAP *oldest = _al_vector_ref_front(&free_bitmaps);
+         al_destroy_bitmap(oldest->bmp);
+         _al_vector_delete_at(&free_bitmaps, 0);
+      }
+      *(POOLED_BITMAP *)_al_vector_alloc_back(&free_bitmaps) = lent;
+      bmp = NULL;
+   }
+   al_unlock_mutex(pool_mutex);
+
+   if (bmp)
+      al_destroy_bitmap(bmp);
+}
+
+/* _al_video_alloc_frame_buffer:
+ *  Like al_malloc, but takes a pooled buffer of the same size if there is
+ *  one. Release the buffer with _al_video_free_frame_buffer.
+ */
+void *_al_video_alloc_frame_buffer(size_t size)
+{
+   void *buffer = NULL;
+   unsigned i;
+
+   if (pool_mutex) {
+      al_lock_mutex(pool_mutex);
+      for (i = 0; i < _al_vector_size(&free_buffers); i++) {
+         POOLED_BUFFER *pb = _al_vector_ref(&free_buffers, i);
+         if (pb->size == size) {
+            buffer = pb->buffer;
+            _al_vector_delete_at(&free_buffers, i);
+            break;
+         }
+      }
+      al_unlock_mutex(pool_mutex);
+   }
+
+   return buffer ? buffer : al_malloc(size);
+}
+
+/* _al_video_free_frame_buffer:
+ *  Returns a buffer from _al_video_alloc_frame_buffer to the pool, or frees
+ *  it if the pool is full or disabled.
+ */
+void _al_video_free_frame_buffer(void *buffer, size_t size)
+{
+   const unsigned int pool_size = get_frame_pool_size();
+   POOLED_BUFFER *pb;
+
+   if (!buffer)
+      return;
+   if (!pool_mutex || pool_size == 0) {
+      al_free(buffer);
+      return;
+   }
+
+   al_lock_mutex(pool_mutex);
+   if (_al_vector_size(&free_buffers) >= pool_size) {
+      pb = _al_vector_ref_front(&free_buffers);
+      al_free(pb->buffer);
+      _al_vector_delete_at(&free_buffers, 0);
+   }
+   pb = _al_vector_alloc_back(&free_buffers);
+   pb->buffer = buffer;
+   pb->size = size;
+   al_unlock_mutex(pool_mutex);
+}
+
 /* Function: al_open_video
  */
 ALLEGRO_VIDEO *al_open_video(char const *filename)
 {
    ALLEGRO_VIDEO *video;
+   VideoHandler *handler;
    const char *extension = filename + strlen(filename) - 1;
 
    while ((extension >= filename) && (*extension != '.'))
       extension--;
-   video = al_calloc(1, sizeof *video);
-   
-   video->vtable = find_handler(extension);
 
-   if (video->vtable == NULL) {
+   handler = find_handler(NULL, extension);
+   if (handler == NULL) {
       ALLEGRO_ERROR("No handler for video extension %s - "
          "therefore not trying to load %s.\n", extension, filename);
-      al_free(video);
       return NULL;
    }
-   
-   video->filename = al_create_path(filename);
-   video->playing = true;
 
-   if (!video->vtable->open_video(video)) {
-      ALLEGRO_ERROR("Could not open %s.\n", filename);
+   video = al_calloc(1, sizeof *video);
+   if (!video) {
+      ALLEGRO_ERROR("Out of memory.\n");
+      return NULL;
+   }
+
+   for (; handler; handler = find_handler(handler, extension)) {
+      memset(video, 0, sizeof *video);
+      video->vtable = handler->vtable;
+      video->filename = al_create_path(filename);
+      video->playing = true;
+
+      if (video->vtable->open_video(video)) {
+         ALLEGRO_DEBUG("Opened %s with the %s backend.\n", filename,
+            handler->name);
+         break;
+      }
+
+      ALLEGRO_WARN("The %s backend could not open %s.\n", handler->name,
+         filename);
       al_destroy_path(video->filename);
+   }
+
+   if (!handler) {
+      ALLEGRO_ERROR("Could not open %s.\n", filename);
       al_free(video);
       return NULL;
    }
    
    al_init_user_event_source(&video->es);
    video->es_inited = true;
+   video->stats_mutex = al_create_mutex();
    
    return video;
 }
@@ -135,6 +362,7 @@ void al_close_video(ALLEGRO_VIDEO *video)
          al_destroy_user_event_source(&video->es);
       }
       al_destroy_path(video->filename);
+      al_destroy_mutex(video->stats_mutex);
       al_free(video);
    }
 }
@@ -196,10 +424,50 @@ ALLEGRO_BITMAP *al_get_video_frame(ALLEGRO_VIDEO *video)
 {
    ASSERT(video);
 
-   video->vtable->update_video(video);
+   video->vtable->update_video(video, video->position);
    return video->current_frame;
 }
 
+/* Function: al_get_video_frame_at
+ */
+ALLEGRO_BITMAP *al_get_video_frame_at(ALLEGRO_VIDEO *video, double time)
+{
+   ASSERT(video);
+
+   video->vtable->update_video(video, time);
+   return video->current_frame;
+}
+
+/* Function: al_set_video_target_bitmap
+ */
+void al_set_video_target_bitmap(ALLEGRO_VIDEO *video, ALLEGRO_BITMAP *bitmap)
+{
+   ASSERT(video);
+   video->target_bitmap = bitmap;
+}
+
+/* _al_video_get_target_rect:
+ *  Returns where in the target bitmap the picture goes: as large as fits
+ *  with the aspect ratio of the scaled dimensions, and centred.
+ */
+void _al_video_get_target_rect(ALLEGRO_VIDEO *video, float *x, float *y,
+   float *w, float *h)
+{
+   const float tw = al_get_bitmap_width(video->target_bitmap);
+   const float th = al_get_bitmap_height(video->target_bitmap);
+
+   *w = tw;
+   *h = th;
+   if (video->scaled_width > 0 && video->scaled_height > 0) {
+      const float scale = _ALLEGRO_MIN(tw / video->scaled_width,
+         th / video->scaled_height);
+      *w = video->scaled_width * scale;
+      *h = video->scaled_height * scale;
+   }
+   *x = (tw - *w) / 2;
+   *y = (th - *h) / 2;
+}
+
 /* Function: al_get_video_position
  */
 double al_get_video_position(ALLEGRO_VIDEO *video, ALLEGRO_VIDEO_POSITION_TYPE which)
@@ -222,6 +490,130 @@ bool al_seek_video(ALLEGRO_VIDEO *video, double pos_in_seconds)
    return video->vtable->seek_video(video, pos_in_seconds);
 }
 
+/* Function: al_get_video_stats
+ */
+void al_get_video_stats(ALLEGRO_VIDEO *video, ALLEGRO_VIDEO_STATS *stats)
+{
+   _AL_VIDEO_STATS s;
+   ASSERT(video);
+   ASSERT(stats);
+
+   al_lock_mutex(video->stats_mutex);
+   s = video->stats;
+   al_unlock_mutex(video->stats_mutex);
+
+   stats->frames_decoded = s.frames_decoded;
+   stats->frames_shown = s.frames_shown;
+   stats->frames_dropped = s.frames_dropped;
+   stats->frames_late = s.frames_late;
+   stats->decode_time_avg = s.frames_queued ?
+      s.decode_time_total / s.frames_queued : 0.0;
+   stats->decode_time_max = s.decode_time_max;
+   stats->convert_time_avg = s.frames_shown ?
+      s.convert_time_total / s.frames_shown : 0.0;
+   stats->convert_time_max = s.convert_time_max;
+   stats->queued_frames = s.queued_frames;
+   stats->av_offset = s.av_offset;
+}
+
+/* Function: al_reset_video_stats
+ */
+void al_reset_video_stats(ALLEGRO_VIDEO *video)
+{
+   unsigned int queued;
+   double offset;
+   ASSERT(video);
+
+   al_lock_mutex(video->stats_mutex);
+   queued = video->stats.queued_frames;
+   offset = video->stats.av_offset;
+   memset(&video->stats, 0, sizeof(video->stats));
+   video->stats.queued_frames = queued;
+   video->stats.av_offset = offset;
+   al_unlock_mutex(video->stats_mutex);
+}
+
+/* Function: al_set_video_frame_dropped_events
+ */
+void al_set_video_frame_dropped_events(ALLEGRO_VIDEO *video, bool enabled)
+{
+   ASSERT(video);
+   video->frame_dropped_events = enabled;
+}
+
+/* _al_video_frame_decoded:
+ *  A frame has been queued after 'time' seconds of decoding, during which
+ *  'skipped' more frames were decoded and thrown away to catch up.
+ */
+void _al_video_frame_decoded(ALLEGRO_VIDEO *video, unsigned int skipped,
+   double time)
+{
+   al_lock_mutex(video->stats_mutex);
+   video->stats.frames_decoded += 1 + skipped;
+   video->stats.frames_queued++;
+   video->stats.decode_time_total += time;
+   if (time > video->stats.decode_time_max)
+      video->stats.decode_time_max = time;
+   al_unlock_mutex(video->stats_mutex);
+
+   if (skipped > 0)
+      _al_video_frames_dropped(video, skipped);
+}
+
+/* _al_video_frame_converted:
+ *  A frame has been converted to RGB in 'time' seconds.
+ */
+void _al_video_frame_converted(ALLEGRO_VIDEO *video, double time)
+{
+   al_lock_mutex(video->stats_mutex);
+   video->stats.convert_time_total += time;
+   if (time > video->stats.convert_time_max)
+      video->stats.convert_time_max = time;
+   al_unlock_mutex(video->stats_mutex);
+}
+
+/* _al_video_frame_shown:
+ *  The frame with presentation time 'pts' is shown at playback position
+ *  'time'. It counts as late if it was due more than a frame ago.
+ */
+void _al_video_frame_shown(ALLEGRO_VIDEO *video, double pts, double time)
+{
+   al_lock_mutex(video->stats_mutex);
+   video->stats.frames_shown++;
+   if (video->fps > 0.0 && time - pts > 1.0 / video->fps)
+      video->stats.frames_late++;
+   video->stats.av_offset = pts - time;
+   al_unlock_mutex(video->stats_mutex);
+}
+
+/* _al_video_frames_dropped:
+ *  'count' decoded frames will never be shown.
+ */
+void _al_video_frames_dropped(ALLEGRO_VIDEO *video, unsigned int count)
+{
+   al_lock_mutex(video->stats_mutex);
+   video->stats.frames_dropped += count;
+   al_unlock_mutex(video->stats_mutex);
+
+   if (video->frame_dropped_events) {
+      ALLEGRO_EVENT event;
+      event.type = ALLEGRO_EVENT_VIDEO_FRAME_DROPPED;
+      event.user.data1 = (intptr_t)video;
+      event.user.data2 = count;
+      al_emit_user_event(&video->es, &event, NULL);
+   }
+}
+
+/* _al_video_set_queued_frames:
+ *  The backend has 'count' decoded frames waiting to be shown.
+ */
+void _al_video_set_queued_frames(ALLEGRO_VIDEO *video, unsigned int count)
+{
+   al_lock_mutex(video->stats_mutex);
+   video->stats.queued_frames = count;
+   al_unlock_mutex(video->stats_mutex);
+}
+
 /* Function: al_get_video_audio_rate
  */
 double al_get_video_audio_rate(ALLEGRO_VIDEO *video)
@@ -261,8 +653,11 @@ bool al_init_video_addon(void)
    if (video_inited)
       return true;
 
+   /* Hardware decoders should be added before software ones, so that they
+    * are preferred and the software decoders remain as the fallback.
+    */
 #ifdef ALLEGRO_CFG_VIDEO_HAVE_OGV
-   add_handler(".ogv", _al_video_ogv_vtable());
+   add_handler(".ogv", "Ogg Theora", _al_video_ogv_vtable());
 #endif
 
    if (handlers == NULL) {
@@ -270,6 +665,9 @@ bool al_init_video_addon(void)
       return false;
    }
 
+   pool_mutex = al_create_mutex();
+
+   video_inited = true;
    _al_add_exit_func(al_shutdown_video_addon, "al_shutdown_video_addon");
 
    return true;
@@ -299,6 +697,10 @@ void al_shutdown_video_addon(void)
    }
    video_inited = false;
    handlers = NULL;
+
+   free_frame_pool();
+   al_destroy_mutex(pool_mutex);
+   pool_mutex = NULL;
 }
 
 
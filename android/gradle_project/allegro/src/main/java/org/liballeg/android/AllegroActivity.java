@@ -11,6 +11,7 @@ import android.hardware.display.DisplayManager;
 import android.os.Bundle;
 import android.os.Environment;
 import android.os.Handler;
+import android.os.PowerManager;
 import android.graphics.Rect;
 import android.util.Log;
 import android.view.Display;
@@ -224,6 +225,30 @@ public class AllegroActivity extends Activity
       return screenLock.inhibitScreenLock(inhibit);
    }
 
+   boolean setSustainedPerformanceMode(final boolean enable)
+   {
+      if (Build.VERSION.SDK_INT < 24) {
+         return false;
+      }
+
+      PowerManager pm = (PowerManager)getSystemService(Context.POWER_SERVICE);
+      if (pm == null || !pm.isSustainedPerformanceModeSupported()) {
+         return false;
+      }
+
+      try {
+         handler.post(new Runnable() {
+            public void run() {
+               getWindow().setSustainedPerformanceMode(enable);
+            }
+         });
+      } catch (Exception x) {
+         Log.d("AllegroActivity", "setSustainedPerformanceMode exception: " + x.getMessage());
+         return false;
+      }
+      return true;
+   }
+
    /* end of functions native code calls */
 
    public AllegroActivity(String userLibName)
@@ -69,9 +69,11 @@ class AllegroEGL
 
    void egl_Terminate()
    {
-      egl_makeCurrent();
-
-      egl_destroySurface();
+      /* The surface is already gone if the context was kept on pause. */
+      if (egl_Surface != null && egl_Surface != EGL10.EGL_NO_SURFACE) {
+         egl_makeCurrent();
+         egl_destroySurface();
+      }
       egl_destroyContext();
 
       EGL10 egl = (EGL10)EGLContext.getEGL();
@@ -250,7 +252,7 @@ class AllegroEGL
       return true;
    }
 
-   private void egl_destroySurface()
+   void egl_destroySurface()
    {
       EGL10 egl = (EGL10)EGLContext.getEGL();
       if (!egl.eglMakeCurrent(egl_Display, EGL10.EGL_NO_SURFACE,
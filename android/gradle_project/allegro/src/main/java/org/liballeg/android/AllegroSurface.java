@@ -12,7 +12,7 @@ class AllegroSurface extends SurfaceView implements SurfaceHolder.Callback
 {
    /** native functions we call */
    public native void nativeOnCreate();
-   public native boolean nativeOnDestroy();
+   public native int nativeOnDestroy();
    public native void nativeOnChange(int format, int width, int height);
    public native void nativeOnJoystickAxis(int index, int stick, int axis, float value);
    public native void nativeOnJoystickButton(int index, int button, boolean down);
@@ -20,6 +20,11 @@ class AllegroSurface extends SurfaceView implements SurfaceHolder.Callback
    private AllegroActivity activity;
    private AllegroJoystick joystick_listener;
 
+   /** return values of nativeOnDestroy */
+   private static final int SURFACE_NOT_CREATED = 0;
+   private static final int SURFACE_TERMINATE = 1;
+   private static final int SURFACE_KEEP_CONTEXT = 2;
+
    /** functions that native code calls */
 
    boolean egl_Init()
@@ -57,6 +62,11 @@ class AllegroSurface extends SurfaceView implements SurfaceHolder.Callback
       return egl.egl_createSurface(this);
    }
 
+   void egl_Terminate()
+   {
+      egl.egl_Terminate();
+   }
+
    void egl_clearCurrent()
    {
       egl.egl_clearCurrent();
@@ -122,13 +132,19 @@ class AllegroSurface extends SurfaceView implements SurfaceHolder.Callback
    {
       Log.d("AllegroSurface", "surfaceDestroyed");
 
-      if (!nativeOnDestroy()) {
-         Log.d("AllegroSurface", "No surface created, returning early");
-         return;
+      switch (nativeOnDestroy()) {
+         case SURFACE_NOT_CREATED:
+            Log.d("AllegroSurface", "No surface created, returning early");
+            return;
+         case SURFACE_KEEP_CONTEXT:
+            /* The context lives on without a surface until we come back. */
+            egl.egl_destroySurface();
+            break;
+         default:
+            egl.egl_Terminate();
+            break;
       }
 
-      egl.egl_Terminate();
-
       Log.d("AllegroSurface", "surfaceDestroyed end");
    }
 
@@ -38,6 +38,7 @@ final class Const
    static final int ALLEGRO_EVENT_TOUCH_END    = 51;
    static final int ALLEGRO_EVENT_TOUCH_MOVE   = 52;
    static final int ALLEGRO_EVENT_TOUCH_CANCEL = 53;
+   static final int ALLEGRO_EVENT_TOUCH_FRAME  = 54;
 
    static int toAndroidOrientation(int alleg_orientation)
    {
@@ -108,6 +108,9 @@ class TouchListener implements View.OnTouchListener
             primary);
       }
 
+      /* All pointers of the event have been reported. */
+      nativeOnTouch(-1, Const.ALLEGRO_EVENT_TOUCH_FRAME, 0, 0, false);
+
       return true;
    }
 }
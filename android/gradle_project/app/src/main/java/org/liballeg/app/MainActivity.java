@@ -31,6 +31,7 @@ public class MainActivity extends AllegroActivity {
         loadLibrary("allegro_image");
         loadLibrary("allegro_font");
         loadLibrary("allegro_ttf");
+        loadLibrary("allegro_perf");
         loadLibrary("allegro_audio");
         loadLibrary("allegro_acodec");
         loadLibrary("allegro_color");
@@ -1,32 +1,46 @@
 set(ALLEGRO_SRC_FILES
     src/allegro.c
     src/bitmap.c
+    src/bitmap_async.c
+    src/bitmap_atlas.c
+    src/bitmap_damage.c
     src/bitmap_draw.c
     src/bitmap_io.c
     src/bitmap_lock.c
     src/bitmap_pixel.c
+    src/bitmap_readback.c
     src/bitmap_type.c
     src/blenders.c
     src/clipboard.c
     src/config.c
     src/convert.c
+    src/convert_simd.c
     src/cpu.c
     src/debug.c
     src/display.c
     src/display_settings.c
+    src/display_vsync.c
+    src/draw_list.c
     src/drawing.c
     src/dtor.c
     src/events.c
     src/evtsrc.c
     src/exitfunc.c
     src/file.c
+    src/file_archive.c
+    src/file_async.c
+    src/file_mmap.c
     src/file_slice.c
+    src/file_stats.c
     src/file_stdio.c
     src/fshook.c
+    src/fshook_list.c
     src/fshook_stdio.c
     src/fullscreen_mode.c
     src/haptic.c
     src/inline.c
+    src/input_snapshot.c
+    src/jobs.c
     src/joynu.c
     src/keybdnu.c
     src/libc.c
@@ -39,7 +53,9 @@ set(ALLEGRO_SRC_FILES
     src/mouse_cursor.c
     src/path.c
     src/pixels.c
+    src/profile.c
     src/shader.c
+    src/shader_cache.c
     src/system.c
     src/threads.c
     src/timernu.c
@@ -48,9 +64,11 @@ set(ALLEGRO_SRC_FILES
     src/transformations.c
     src/tri_soft.c
     src/utf8.c
+    src/workers.c
     src/misc/aatree.c
     src/misc/bstrlib.c
     src/misc/list.c
+    src/misc/pool.c
     src/misc/vector.c
     )
 
@@ -95,6 +113,7 @@ set(ALLEGRO_SRC_OPENGL_FILES
     src/opengl/ogl_lock_es.c
     src/opengl/ogl_render_state.c
     src/opengl/ogl_shader.c
+    src/opengl/ogl_upload.c
     )
 
 set(ALLEGRO_SRC_WGL_FILES
@@ -124,6 +143,7 @@ set(ALLEGRO_SRC_X_FILES
     src/x/xkeyboard.c
     src/x/xmousenu.c
     src/x/xrandr.c
+    src/x/xsoftware.c
     src/x/xsystem.c
     src/x/xtouch.c
     src/x/xwindow.c
@@ -174,6 +194,7 @@ set(ALLEGRO_SRC_ANDROID_FILES
    src/android/android_joystick.c
    src/android/android_keyboard.c
    src/android/android_mouse.c
+   src/android/android_perf.c
    src/android/android_sensors.c
    src/android/android_system.c
    src/android/android_touch.c
@@ -196,6 +217,17 @@ set(ALLEGRO_SRC_RASPBERRYPI_FILES
    src/x/xwindow.c
    src/raspberrypi/pisystem.c
    src/raspberrypi/pidisplay.c
+   src/raspberrypi/pioverlay.c
+   )
+
+set(ALLEGRO_SRC_KMS_FILES
+   src/linux/lkeybdnu.c
+   src/linux/lmseev.c
+   src/linux/lmsedrv.c
+   src/linux/lhaptic.c
+   src/linux/ljoynu.c
+   src/kms/kmssystem.c
+   src/kms/kmsdisplay.c
    )
 
 set(ALLEGRO_SRC_SDL_FILES
@@ -327,6 +359,10 @@ set(ALLEGRO_INCLUDE_ALLEGRO_PLATFORM_FILES_GENERATED
     include/allegro5/platform/alplatf.h
     )
 
+set(ALLEGRO_INCLUDE_ALLEGRO_RASPBERRYPI_FILES
+    include/allegro5/allegro_raspberrypi.h
+    )
+
 set(ALLEGRO_INCLUDE_ALLEGRO_X_FILES
     include/allegro5/allegro_x.h
     )
@@ -42,6 +42,7 @@ set(PAGES
     main
     memfile
     native_dialog
+    perf
     physfs
     primitives
     shader
@@ -0,0 +1,204 @@
+/*
+ *    Benchmark for the audio mixer.
+ *
+ *    Every test attaches a number of looping sample instances to a mixer
+ *    that is not attached to a voice, and drives the mixer directly the way
+ *    a voice would, so no audio device is needed.  The samples are recorded
+ *    at 44100 Hz and the mixer runs at 48000 Hz, so every instance is
+ *    resampled with the mixer's quality.  The samples and the mixer have
+ *    the same depth and channel configuration.  Note that int16 mixers
+ *    interpolate linearly for the cubic and sinc qualities.
+ *
+ *    The results are printed as comma separated values, one line per test,
+ *    with the time it took to mix one output frame, in total and per
+ *    instance.  They can be compared between runs or used to estimate how
+ *    many instances a machine can mix in real time.
+ *
+ *    Usage: ex_audio_bench [seconds per test] [maximum instances]
+ */
+
+#define ALLEGRO_UNSTABLE
+#include <stdio.h>
+#include <stdlib.h>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_audio.h>
+
+/* The mixer is driven with the internal _al_kcm_mixer_read, and the inline
+ * functions of the internal headers use the library's name for asserts.
+ */
+#define ASSERT(x) ALLEGRO_ASSERT(x)
+#include <allegro5/internal/aintern_audio.h>
+
+#include "common.c"
+
+/* How many seconds each test takes approximately. */
+#define TEST_TIME 0.25
+
+#define SAMPLE_FREQUENCY 44100
+#define MIXER_FREQUENCY 48000
+
+/* Frames mixed per call, like a typical voice fragment. */
+#define FRAGMENT 1024
+
+#define MAX_INSTANCES 1024
+
+static struct {
+   char const *name;
+   ALLEGRO_MIXER_QUALITY quality;
+} const qualities[] = {
+   {"point", ALLEGRO_MIXER_QUALITY_POINT},
+   {"linear", ALLEGRO_MIXER_QUALITY_LINEAR},
+   {"cubic", ALLEGRO_MIXER_QUALITY_CUBIC},
+   {"sinc", ALLEGRO_MIXER_QUALITY_SINC}
+};
+
+static struct {
+   char const *name;
+   ALLEGRO_AUDIO_DEPTH depth;
+} const depths[] = {
+   {"int16", ALLEGRO_AUDIO_DEPTH_INT16},
+   {"float32", ALLEGRO_AUDIO_DEPTH_FLOAT32}
+};
+
+static ALLEGRO_CHANNEL_CONF const channel_confs[] = {
+   ALLEGRO_CHANNEL_CONF_1,
+   ALLEGRO_CHANNEL_CONF_2,
+   ALLEGRO_CHANNEL_CONF_4,
+   ALLEGRO_CHANNEL_CONF_5_1,
+   ALLEGRO_CHANNEL_CONF_7_1
+};
+
+#define COUNT(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+static double test_time = TEST_TIME;
+static int max_instances = MAX_INSTANCES;
+
+
+/* One second of noise, so that nothing can be skipped as silence. */
+static ALLEGRO_SAMPLE *create_sample(ALLEGRO_AUDIO_DEPTH depth,
+   ALLEGRO_CHANNEL_CONF chan_conf)
+{
+   int n = SAMPLE_FREQUENCY * al_get_channel_count(chan_conf);
+   unsigned seed = 1;
+   void *buf;
+   int i;
+
+   buf = al_malloc(n * al_get_audio_depth_size(depth));
+   if (!buf)
+      return NULL;
+
+   for (i = 0; i < n; i++) {
+      float x;
+      seed = seed * 1103515245 + 12345;
+      x = (float)((seed >> 16) & 0x7fff) / 0x7fff * 0.5f - 0.25f;
+      if (depth == ALLEGRO_AUDIO_DEPTH_INT16)
+         ((int16_t *)buf)[i] = x * 0x7fff;
+      else
+         ((float *)buf)[i] = x;
+   }
+
+   return al_create_sample(buf, SAMPLE_FREQUENCY, SAMPLE_FREQUENCY, depth,
+      chan_conf, true);
+}
+
+
+static void run_test(int num_instances, int quality, int depth,
+   ALLEGRO_CHANNEL_CONF chan_conf)
+{
+   ALLEGRO_SAMPLE_INSTANCE *instances[MAX_INSTANCES];
+   ALLEGRO_SAMPLE *spl;
+   ALLEGRO_MIXER *mixer;
+   long frames = 0;
+   double t0, t1, ns;
+   int i;
+
+   spl = create_sample(depths[depth].depth, chan_conf);
+   mixer = al_create_mixer(MIXER_FREQUENCY, depths[depth].depth, chan_conf);
+   if (!spl || !mixer)
+      abort_example("Could not create the sample or mixer.\n");
+   al_set_mixer_quality(mixer, qualities[quality].quality);
+
+   for (i = 0; i < num_instances; i++) {
+      instances[i] = al_create_sample_instance(spl);
+      if (!instances[i])
+         abort_example("Could not create sample instance.\n");
+      al_set_sample_instance_playmode(instances[i], ALLEGRO_PLAYMODE_LOOP);
+      /* Spread the instances over the sample, as in a real mix. */
+      al_set_sample_instance_position(instances[i],
+         (i * 7919) % SAMPLE_FREQUENCY);
+      al_attach_sample_instance_to_mixer(instances[i], mixer);
+      al_play_sample_instance(instances[i]);
+   }
+
+   /* Untimed fragment to get the buffers allocated. */
+   {
+      void *buf = NULL;
+      unsigned int n = FRAGMENT;
+      _al_kcm_mixer_read(mixer, &buf, &n, depths[depth].depth, 0);
+   }
+
+   t0 = al_get_time();
+   do {
+      void *buf = NULL;
+      unsigned int n = FRAGMENT;
+      _al_kcm_mixer_read(mixer, &buf, &n, depths[depth].depth, 0);
+      frames += FRAGMENT;
+      t1 = al_get_time();
+   } while (t1 - t0 < test_time);
+
+   ns = (t1 - t0) * 1e9 / frames;
+   printf("%d,%s,%s,%d,%.1f,%.2f,%.1f\n", num_instances,
+      qualities[quality].name, depths[depth].name,
+      (int)al_get_channel_count(chan_conf), ns, ns / num_instances,
+      1e9 / MIXER_FREQUENCY / ns * num_instances);
+   fflush(stdout);
+
+   for (i = 0; i < num_instances; i++)
+      al_destroy_sample_instance(instances[i]);
+   al_destroy_mixer(mixer);
+   al_destroy_sample(spl);
+}
+
+
+int main(int argc, char **argv)
+{
+   int num_instances, quality, depth, conf;
+
+   if (argc > 1) {
+      test_time = strtod(argv[1], NULL);
+      if (test_time <= 0)
+         test_time = TEST_TIME;
+   }
+   if (argc > 2) {
+      max_instances = atoi(argv[2]);
+      if (max_instances < 1 || max_instances > MAX_INSTANCES)
+         max_instances = MAX_INSTANCES;
+   }
+
+   if (!al_init())
+      abort_example("Could not init Allegro.\n");
+   init_platform_specific();
+
+   /* No voice is used, so audio need not be installed, but the mixer
+    * uses the configuration of the audio addon if it is.
+    */
+   al_install_audio();
+
+   printf("instances,quality,depth,channels,ns per frame,"
+      "ns per instance frame,real time instances\n");
+
+   for (conf = 0; conf < COUNT(channel_confs); conf++) {
+      for (depth = 0; depth < COUNT(depths); depth++) {
+         for (quality = 0; quality < COUNT(qualities); quality++) {
+            for (num_instances = 1; num_instances <= max_instances;
+                  num_instances *= 4) {
+               run_test(num_instances, quality, depth, channel_confs[conf]);
+            }
+         }
+      }
+   }
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
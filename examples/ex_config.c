@@ -4,6 +4,7 @@
  *    Test config file reading and writing.
  */
 
+#define ALLEGRO_UNSTABLE
 #include <stdio.h>
 #include "allegro5/allegro.h"
 
@@ -21,9 +22,31 @@ do {                                      \
    }                                      \
 } while (0)
 
+static bool same_contents(const char *filename1, const char *filename2)
+{
+   ALLEGRO_FILE *f1 = al_fopen(filename1, "rb");
+   ALLEGRO_FILE *f2 = al_fopen(filename2, "rb");
+   bool same = f1 && f2;
+   int c;
+
+   while (same) {
+      c = al_fgetc(f1);
+      same = (c == al_fgetc(f2));
+      if (c == EOF)
+         break;
+   }
+
+   if (f1)
+      al_fclose(f1);
+   if (f2)
+      al_fclose(f2);
+   return same;
+}
+
 int main(int argc, char **argv)
 {
    ALLEGRO_CONFIG *cfg;
+   ALLEGRO_CONFIG *frozen;
    const char *value;
    ALLEGRO_CONFIG_SECTION *iterator;
    ALLEGRO_CONFIG_ENTRY *iterator2;
@@ -107,10 +130,68 @@ int main(int argc, char **argv)
 
    TEST("save_config", al_save_config_file("test.cfg", cfg));
 
-   log_printf("Done\n");
+   al_destroy_config(cfg);
+
+   /* Test unusual lines, and that changes after loading are written back
+    * out like earlier versions did when they saved data/sample2_saved.cfg.
+    */
+   cfg = al_load_config_file("data/sample2.cfg");
+   if (!cfg) {
+      abort_example("Couldn't load data/sample2.cfg\n");
+   }
+
+   value = al_get_config_value(cfg, "", "key");
+   TEST("duplicate key", value && !strcmp(value, "global value twice"));
+
+   value = al_get_config_value(cfg, "", "spaced key");
+   TEST("spaced key", value && !strcmp(value, "spaced value"));
+
+   value = al_get_config_value(cfg, "", "equals");
+   TEST("equals in value", value && !strcmp(value, "a = b = c"));
 
+   value = al_get_config_value(cfg, "a]b", "inner");
+   TEST("bracket in section", value && !strcmp(value, "bracket"));
+
+   value = al_get_config_value(cfg, "", "in");
+   TEST("empty section", value && !strcmp(value, "empty name"));
+
+   value = al_get_config_value(cfg, "unterminated", "z");
+   TEST("unterminated section", value && !strcmp(value, "4"));
+
+   value = al_get_config_value(cfg, "last", "no_newline");
+   TEST("last line", value && !strcmp(value, "at end"));
+
+   al_set_config_value(cfg, "section", "x", "overwritten");
+   al_set_config_value(cfg, "section", "new", "added");
+   al_set_config_value(cfg, "", "key", "global set");
+   al_set_config_value(cfg, "brand new", "k", "v");
+   al_remove_config_key(cfg, "section", "y");
+   al_remove_config_key(cfg, "", "empty");
+   al_remove_config_section(cfg, "unterminated");
+   al_add_config_comment(cfg, "section", "added comment");
+
+   TEST("save sample2", al_save_config_file("test2.cfg", cfg));
+   TEST("sample2 saved", same_contents("test2.cfg", "data/sample2_saved.cfg"));
+
+   frozen = al_freeze_config(cfg);
+   TEST("freeze", frozen);
    al_destroy_config(cfg);
 
+   if (frozen) {
+      value = al_get_config_value(frozen, "section", "x");
+      TEST("frozen value", value && !strcmp(value, "overwritten"));
+
+      value = al_get_config_value(frozen, "unterminated", "z");
+      TEST("frozen removed", value == NULL);
+
+      TEST("save frozen", al_save_config_file("test3.cfg", frozen));
+      TEST("frozen saved", same_contents("test3.cfg", "data/sample2_saved.cfg"));
+
+      al_destroy_config(frozen);
+   }
+
+   log_printf("Done\n");
+
    close_log(true);
 
    return passed ? 0 : 1;
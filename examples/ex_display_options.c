@@ -40,6 +40,7 @@ struct {
     X(DEPTH_SIZE, 32),
     X(FLOAT_COLOR, 1),
     X(FLOAT_DEPTH, 1),
+    X(SRGB_FRAMEBUFFER, 1),
     X(STENCIL_SIZE, 32),
     X(SAMPLE_BUFFERS, 1),
     X(SAMPLES, 8),
@@ -0,0 +1,214 @@
+/*
+ *    Benchmark for text drawing and measuring with the different kinds of
+ *    fonts.
+ *
+ *    The results are printed as comma separated values, one line per test,
+ *    so they can be compared between runs.  Pass the number of seconds to
+ *    spend on each test as the first argument.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_font.h>
+#include <allegro5/allegro_image.h>
+#include <allegro5/allegro_ttf.h>
+
+#include "common.c"
+
+/* How many seconds each test takes approximately. */
+#define TEST_TIME 1.0
+
+/* How many strings are drawn between checking the time, and between flips
+ * when drawing to the display.
+ */
+#define STEPS 100
+
+enum Operation {
+   DRAW_TEXT,
+   TEXT_WIDTH,
+   MULTILINE
+};
+
+static char const *operation_names[] = {
+   "al_draw_text", "al_get_text_width", "al_do_multiline_text"
+};
+
+typedef struct FONT_INFO {
+   char const *name;
+   ALLEGRO_FONT *(*load)(void);
+} FONT_INFO;
+
+static char const *text =
+   "The quick brown fox jumps over the lazy dog. Pack my box with five "
+   "dozen liquor jugs! 0123456789 (AV) [To] {Wa} <yes> - VAT & WAVE.";
+
+static double test_time = TEST_TIME;
+static ALLEGRO_DISPLAY *display;
+
+
+static ALLEGRO_FONT *load_builtin(void)
+{
+   return al_create_builtin_font();
+}
+
+static ALLEGRO_FONT *load_bitmap(void)
+{
+   return al_load_bitmap_font("data/bmpfont.tga");
+}
+
+static ALLEGRO_FONT *load_bmfont(void)
+{
+   return al_load_font("data/a4_font.fnt", 0, 0);
+}
+
+static ALLEGRO_FONT *load_ttf(void)
+{
+   return al_load_font("data/DejaVuSans.ttf", 18, 0);
+}
+
+static FONT_INFO fonts[] = {
+   {"builtin", load_builtin},
+   {"bitmap", load_bitmap},
+   {"bmfont", load_bmfont},
+   {"ttf", load_ttf}
+};
+
+
+static bool multiline_cb(int line_num, const char *line, int size,
+   void *extra)
+{
+   (void)line_num;
+   (void)line;
+   (void)size;
+   (void)extra;
+   return true;
+}
+
+
+static void step(enum Operation op, ALLEGRO_FONT *font, int i)
+{
+   switch (op) {
+      case DRAW_TEXT:
+         al_draw_text(font, al_map_rgb(255, 255, 255), 0, (i % 20) * 20,
+            0, text);
+         break;
+      case TEXT_WIDTH:
+         al_get_text_width(font, text);
+         break;
+      case MULTILINE:
+         al_do_multiline_text(font, 200, text, multiline_cb, NULL);
+         break;
+   }
+}
+
+
+static void run_test(char const *font_name, ALLEGRO_FONT *font,
+   enum Operation op, char const *target_name, bool held)
+{
+   ALLEGRO_USTR_INFO info;
+   int glyphs_per_step = al_ustr_length(al_ref_cstr(&info, text));
+   long steps = 0;
+   double t0, t1;
+   int i;
+
+   /* Untimed run to get the glyphs cached. */
+   for (i = 0; i < STEPS; i++)
+      step(op, font, i);
+
+   t0 = al_get_time();
+   do {
+      if (held)
+         al_hold_bitmap_drawing(true);
+      for (i = 0; i < STEPS; i++)
+         step(op, font, i);
+      if (held)
+         al_hold_bitmap_drawing(false);
+      if (display && al_get_target_bitmap() == al_get_backbuffer(display))
+         al_flip_display();
+      steps += STEPS;
+      t1 = al_get_time();
+   } while (t1 - t0 < test_time);
+
+   printf("%s,%s,%s,%s,%ld,%.3f,%.0f\n", font_name, operation_names[op],
+      target_name, held ? "held" : "unheld", steps * glyphs_per_step,
+      t1 - t0, steps * glyphs_per_step / (t1 - t0));
+   fflush(stdout);
+}
+
+
+static void test_target(char const *target_name, ALLEGRO_BITMAP *target,
+   int bitmap_flags)
+{
+   unsigned i;
+
+   al_set_new_bitmap_flags(bitmap_flags);
+   al_set_target_bitmap(target);
+
+   for (i = 0; i < sizeof fonts / sizeof fonts[0]; i++) {
+      ALLEGRO_FONT *font = fonts[i].load();
+
+      if (!font) {
+         fprintf(stderr, "Could not load the %s font, skipping it.\n",
+            fonts[i].name);
+         continue;
+      }
+
+      al_clear_to_color(al_map_rgb(0, 0, 0));
+      run_test(fonts[i].name, font, DRAW_TEXT, target_name, false);
+      run_test(fonts[i].name, font, DRAW_TEXT, target_name, true);
+
+      /* Measuring doesn't depend on the target, so only do it once. */
+      if (bitmap_flags & ALLEGRO_MEMORY_BITMAP) {
+         run_test(fonts[i].name, font, TEXT_WIDTH, "none", false);
+         run_test(fonts[i].name, font, MULTILINE, "none", false);
+      }
+
+      al_destroy_font(font);
+   }
+}
+
+
+int main(int argc, char **argv)
+{
+   ALLEGRO_BITMAP *memory_target;
+
+   if (argc > 1) {
+      test_time = strtod(argv[1], NULL);
+      if (test_time <= 0)
+         test_time = TEST_TIME;
+   }
+
+   if (!al_init()) {
+      abort_example("Could not init Allegro\n");
+   }
+
+   al_init_image_addon();
+   al_init_font_addon();
+   al_init_ttf_addon();
+   init_platform_specific();
+
+   /* Flipping shouldn't wait for the monitor. */
+   al_set_new_display_option(ALLEGRO_VSYNC, 2, ALLEGRO_SUGGEST);
+   display = al_create_display(640, 480);
+   if (!display) {
+      fprintf(stderr, "Could not create a display, "
+         "only testing memory bitmaps.\n");
+   }
+
+   printf("font,operation,target,holding,glyphs,seconds,glyphs_per_second\n");
+
+   al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+   memory_target = al_create_bitmap(640, 480);
+   test_target("memory", memory_target, ALLEGRO_MEMORY_BITMAP);
+   al_destroy_bitmap(memory_target);
+
+   if (display) {
+      test_target("video", al_get_backbuffer(display), ALLEGRO_VIDEO_BITMAP);
+      al_destroy_display(display);
+   }
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
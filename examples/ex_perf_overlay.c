@@ -0,0 +1,127 @@
+/*
+ *    Example program for the Allegro library.
+ *
+ *    Shows the performance overlay on top of a scene whose load can be
+ *    changed. Up/Down change the number of circles, F1-F6 toggle the overlay
+ *    rows and S saves the recorded frames to perf.csv.
+ */
+
+#define ALLEGRO_UNSTABLE
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_font.h>
+#include <allegro5/allegro_perf.h>
+#include <allegro5/allegro_primitives.h>
+#include <math.h>
+
+#include "common.c"
+
+#define HISTORY   600
+
+int main(int argc, char **argv)
+{
+   ALLEGRO_DISPLAY *display;
+   ALLEGRO_TIMER *timer;
+   ALLEGRO_EVENT_QUEUE *queue;
+   ALLEGRO_PERF_OVERLAY *overlay;
+   int num_circles = 500;
+   int events_this_frame = 0;
+   bool redraw = false;
+   bool done = false;
+   double t = 0;
+   int i;
+
+   (void)argc;
+   (void)argv;
+
+   if (!al_init()) {
+      abort_example("Could not init Allegro.\n");
+   }
+   al_init_font_addon();
+   al_init_primitives_addon();
+   al_install_keyboard();
+   init_platform_specific();
+
+   display = al_create_display(800, 600);
+   if (!display) {
+      abort_example("Error creating display\n");
+   }
+
+   overlay = al_create_perf_overlay(display, HISTORY);
+   if (!overlay) {
+      abort_example("Error creating the overlay\n");
+   }
+
+   timer = al_create_timer(1.0 / 60);
+   queue = al_create_event_queue();
+   al_register_event_source(queue, al_get_keyboard_event_source());
+   al_register_event_source(queue, al_get_display_event_source(display));
+   al_register_event_source(queue, al_get_timer_event_source(timer));
+   al_start_timer(timer);
+
+   while (!done) {
+      ALLEGRO_EVENT event;
+
+      if (redraw && al_is_event_queue_empty(queue)) {
+         al_clear_to_color(al_map_rgb(20, 20, 40));
+         for (i = 0; i < num_circles; i++) {
+            float a = t + i * 0.1;
+            al_draw_filled_circle(400 + cos(a * 1.3) * (50 + i % 300),
+               300 + sin(a) * (40 + i % 250), 6,
+               al_map_rgb_f(0.5 + 0.5 * sin(i), 0.5, 0.5 + 0.5 * cos(i)));
+         }
+
+         /* Anything the program measures itself goes in a counter. */
+         al_set_perf_counter(overlay, "circles", num_circles);
+         al_set_perf_counter(overlay, "events", events_this_frame);
+         events_this_frame = 0;
+
+         al_draw_perf_overlay(overlay, 8, 8);
+         al_flip_display();
+         al_update_perf_overlay(overlay);
+         redraw = false;
+      }
+
+      al_wait_for_event(queue, &event);
+      events_this_frame++;
+
+      switch (event.type) {
+         case ALLEGRO_EVENT_DISPLAY_CLOSE:
+            done = true;
+            break;
+
+         case ALLEGRO_EVENT_KEY_CHAR:
+            if (event.keyboard.keycode == ALLEGRO_KEY_ESCAPE) {
+               done = true;
+            }
+            else if (event.keyboard.keycode == ALLEGRO_KEY_UP) {
+               num_circles *= 2;
+            }
+            else if (event.keyboard.keycode == ALLEGRO_KEY_DOWN) {
+               if (num_circles > 1)
+                  num_circles /= 2;
+            }
+            else if (event.keyboard.keycode >= ALLEGRO_KEY_F1 &&
+                  event.keyboard.keycode <= ALLEGRO_KEY_F6) {
+               int flag = 1 << (event.keyboard.keycode - ALLEGRO_KEY_F1);
+               al_set_perf_overlay_flags(overlay,
+                  al_get_perf_overlay_flags(overlay) ^ flag);
+            }
+            else if (event.keyboard.unichar == 's') {
+               if (!al_save_perf_overlay_csv(overlay, "perf.csv"))
+                  abort_example("Error saving perf.csv\n");
+            }
+            break;
+
+         case ALLEGRO_EVENT_TIMER:
+            t += 1.0 / 60;
+            redraw = true;
+            break;
+      }
+   }
+
+   al_destroy_perf_overlay(overlay);
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -51,6 +51,16 @@ const FORMAT formats[ALLEGRO_NUM_PIXEL_FORMATS] = {
    {ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1, "RGBA_DXT1"},
    {ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3, "RGBA_DXT3"},
    {ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5, "RGBA_DXT5"},
+   {ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4, "R_BC4"},
+   {ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5, "RG_BC5"},
+   {ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_BC7, "RGBA_BC7"},
+   {ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGB_ETC2, "RGB_ETC2"},
+   {ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ETC2, "RGBA_ETC2"},
+   {ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_4x4, "RGBA_ASTC_4x4"},
+   {ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_6x6, "RGBA_ASTC_6x6"},
+   {ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x8, "RGBA_ASTC_8x8"},
+   {ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB, "ARGB_SRGB"},
+   {ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB, "ABGR_SRGB"},
 };
 
 #define NUM_FORMATS ALLEGRO_NUM_PIXEL_FORMATS
@@ -0,0 +1,467 @@
+/*
+ *    Benchmark for the primitives addon.
+ *
+ *    Every test draws the same scene once per frame, first to a memory
+ *    bitmap (the software renderer) and then to the backbuffer of each
+ *    hardware backend that can be initialised.  The results are printed as
+ *    comma separated values, one line per test, with the number of drawing
+ *    calls made and triangles drawn per frame, the CPU time per frame and the
+ *    triangles drawn per second.
+ *
+ *    The last column compares the triangles per second to those of the same
+ *    test in a baseline file, by default data/ex_prim_bench.csv, which is
+ *    simply the output of an earlier run.  Numbers above 1 mean this run was
+ *    faster.
+ *
+ *    Usage: ex_prim_bench [seconds per test] [baseline file]
+ */
+
+#define ALLEGRO_UNSTABLE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_primitives.h>
+
+#include "common.c"
+
+/* How many seconds each test takes approximately. */
+#define TEST_TIME 1.0
+
+/* Size of the target and how many shapes make up the scene. */
+#define WIDTH 640
+#define HEIGHT 480
+#define NUM_SHAPES 500
+
+/* Number of points in the polyline. */
+#define NUM_POINTS 500
+
+#define MAX_BASELINE 64
+
+enum Test {
+   PRIM_LIST,
+   PRIM_SINGLE,
+   INDEXED_PRIM,
+   INSTANCED_PRIM,
+   FILLED_TRIANGLE,
+   FILLED_RECTANGLE,
+   POLYLINE,
+   POLYLINE_BUFFER,
+   VERTEX_BUFFER,
+   INDEXED_BUFFER,
+   NUM_TESTS
+};
+
+typedef struct TEST_INFO {
+   char const *name;
+   bool can_hold;
+   bool needs_display;
+} TEST_INFO;
+
+static TEST_INFO const tests[NUM_TESTS] = {
+   {"al_draw_prim_list", true, false},
+   {"al_draw_prim_single", true, false},
+   {"al_draw_indexed_prim", true, false},
+   {"al_draw_instanced_prim", false, false},
+   {"al_draw_filled_triangle", true, false},
+   {"al_draw_filled_rectangle", true, false},
+   {"al_draw_polyline", true, false},
+   {"al_draw_polyline_buffer", false, false},
+   {"al_draw_vertex_buffer", false, true},
+   {"al_draw_indexed_buffer", false, true}
+};
+
+typedef struct BASELINE {
+   char key[128];
+   double triangles_per_second;
+} BASELINE;
+
+static double test_time = TEST_TIME;
+static char const *baseline_name = "data/ex_prim_bench.csv";
+static BASELINE baseline[MAX_BASELINE];
+static int num_baseline;
+
+static ALLEGRO_VERTEX triangles[NUM_SHAPES * 3];
+static ALLEGRO_VERTEX quads[NUM_SHAPES * 4];
+static int quad_indices[NUM_SHAPES * 6];
+static ALLEGRO_VERTEX instance_shape[3];
+static ALLEGRO_PRIM_INSTANCE instances[NUM_SHAPES];
+static float points[NUM_POINTS * 2];
+
+static ALLEGRO_POLYLINE_BUFFER *polyline_buffer;
+static ALLEGRO_VERTEX_BUFFER *vertex_buffer;
+static ALLEGRO_VERTEX_BUFFER *quad_buffer;
+static ALLEGRO_INDEX_BUFFER *index_buffer;
+
+
+/* A small deterministic generator, so every run draws the same scene. */
+static float random_float(unsigned *seed, float max)
+{
+   *seed = *seed * 1103515245 + 12345;
+   return (float)((*seed >> 16) & 0x7fff) / 0x7fff * max;
+}
+
+
+static void init_scene(void)
+{
+   unsigned seed = 1;
+   int i, j;
+
+   for (i = 0; i < NUM_SHAPES; i++) {
+      float x = random_float(&seed, WIDTH - 20);
+      float y = random_float(&seed, HEIGHT - 20);
+      ALLEGRO_COLOR color = al_map_rgba(
+         55 + random_float(&seed, 200), 55 + random_float(&seed, 200),
+         55 + random_float(&seed, 200), 128);
+      ALLEGRO_VERTEX *t = triangles + i * 3;
+      ALLEGRO_VERTEX *q = quads + i * 4;
+
+      for (j = 0; j < 3; j++) {
+         t[j].x = x + (j == 1 ? 20 : 0);
+         t[j].y = y + (j == 2 ? 20 : 0);
+         t[j].z = 0;
+         t[j].u = t[j].v = 0;
+         t[j].color = color;
+      }
+      for (j = 0; j < 4; j++) {
+         q[j].x = x + (j == 1 || j == 2 ? 20 : 0);
+         q[j].y = y + (j >= 2 ? 20 : 0);
+         q[j].z = 0;
+         q[j].u = q[j].v = 0;
+         q[j].color = color;
+      }
+      quad_indices[i * 6 + 0] = i * 4 + 0;
+      quad_indices[i * 6 + 1] = i * 4 + 1;
+      quad_indices[i * 6 + 2] = i * 4 + 2;
+      quad_indices[i * 6 + 3] = i * 4 + 0;
+      quad_indices[i * 6 + 4] = i * 4 + 2;
+      quad_indices[i * 6 + 5] = i * 4 + 3;
+
+      instances[i].x = x;
+      instances[i].y = y;
+      instances[i].sx = instances[i].sy = 1;
+      instances[i].theta = 0;
+      instances[i].u = instances[i].v = 0;
+      instances[i].color = color;
+   }
+
+   /* The instances place copies of the first triangle moved to the origin. */
+   for (j = 0; j < 3; j++) {
+      instance_shape[j] = triangles[j];
+      instance_shape[j].x -= triangles[0].x;
+      instance_shape[j].y -= triangles[0].y;
+      instance_shape[j].color = al_map_rgb(255, 255, 255);
+   }
+
+   for (i = 0; i < NUM_POINTS; i++) {
+      points[i * 2 + 0] = 10 + random_float(&seed, WIDTH - 20);
+      points[i * 2 + 1] = 10 + random_float(&seed, HEIGHT - 20);
+   }
+}
+
+
+static void create_buffers(void)
+{
+   polyline_buffer = al_create_polyline_buffer(points, 2 * sizeof(float),
+      NUM_POINTS, ALLEGRO_LINE_JOIN_NONE, ALLEGRO_LINE_CAP_NONE, 0);
+
+   /* Vertex and index buffers can only be created with a display. */
+   if (!al_get_current_display())
+      return;
+   vertex_buffer = al_create_vertex_buffer(NULL, triangles,
+      NUM_SHAPES * 3, ALLEGRO_PRIM_BUFFER_STATIC);
+   quad_buffer = al_create_vertex_buffer(NULL, quads,
+      NUM_SHAPES * 4, ALLEGRO_PRIM_BUFFER_STATIC);
+   index_buffer = al_create_index_buffer(sizeof(int), quad_indices,
+      NUM_SHAPES * 6, ALLEGRO_PRIM_BUFFER_STATIC);
+}
+
+
+static void destroy_buffers(void)
+{
+   al_destroy_polyline_buffer(polyline_buffer);
+   polyline_buffer = NULL;
+   if (vertex_buffer)
+      al_destroy_vertex_buffer(vertex_buffer);
+   vertex_buffer = NULL;
+   if (quad_buffer)
+      al_destroy_vertex_buffer(quad_buffer);
+   quad_buffer = NULL;
+   if (index_buffer)
+      al_destroy_index_buffer(index_buffer);
+   index_buffer = NULL;
+}
+
+
+/* Draws one frame of the given test.  Returns the number of drawing calls
+ * made and stores the number of triangles drawn in *num_triangles.
+ */
+static int draw_frame(enum Test test, int *num_triangles)
+{
+   ALLEGRO_COLOR white = al_map_rgb(255, 255, 255);
+   int i;
+
+   switch (test) {
+      case PRIM_LIST:
+         *num_triangles = NUM_SHAPES;
+         al_draw_prim(triangles, NULL, NULL, 0, NUM_SHAPES * 3,
+            ALLEGRO_PRIM_TRIANGLE_LIST);
+         return 1;
+
+      case PRIM_SINGLE:
+         *num_triangles = NUM_SHAPES;
+         for (i = 0; i < NUM_SHAPES; i++) {
+            al_draw_prim(triangles, NULL, NULL, i * 3, i * 3 + 3,
+               ALLEGRO_PRIM_TRIANGLE_LIST);
+         }
+         return NUM_SHAPES;
+
+      case INDEXED_PRIM:
+         *num_triangles = NUM_SHAPES * 2;
+         al_draw_indexed_prim(quads, NULL, NULL, quad_indices,
+            NUM_SHAPES * 6, ALLEGRO_PRIM_TRIANGLE_LIST);
+         return 1;
+
+      case INSTANCED_PRIM:
+         *num_triangles = NUM_SHAPES;
+         al_draw_instanced_prim(instance_shape, NULL, NULL, 0, 3,
+            ALLEGRO_PRIM_TRIANGLE_LIST, instances, NUM_SHAPES);
+         return 1;
+
+      case FILLED_TRIANGLE:
+         *num_triangles = NUM_SHAPES;
+         for (i = 0; i < NUM_SHAPES; i++) {
+            ALLEGRO_VERTEX *t = triangles + i * 3;
+            al_draw_filled_triangle(t[0].x, t[0].y, t[1].x, t[1].y,
+               t[2].x, t[2].y, t[0].color);
+         }
+         return NUM_SHAPES;
+
+      case FILLED_RECTANGLE:
+         *num_triangles = NUM_SHAPES * 2;
+         for (i = 0; i < NUM_SHAPES; i++) {
+            ALLEGRO_VERTEX *q = quads + i * 4;
+            al_draw_filled_rectangle(q[0].x, q[0].y, q[2].x, q[2].y,
+               q[0].color);
+         }
+         return NUM_SHAPES;
+
+      case POLYLINE:
+         /* Without joins and caps every segment is one quad. */
+         *num_triangles = (NUM_POINTS - 1) * 2;
+         al_draw_polyline(points, 2 * sizeof(float), NUM_POINTS,
+            ALLEGRO_LINE_JOIN_NONE, ALLEGRO_LINE_CAP_NONE, white, 4, 0);
+         return 1;
+
+      case POLYLINE_BUFFER:
+         *num_triangles = (NUM_POINTS - 1) * 2;
+         al_draw_polyline_buffer(polyline_buffer, white, 4);
+         return 1;
+
+      case VERTEX_BUFFER:
+         *num_triangles = NUM_SHAPES;
+         al_draw_vertex_buffer(vertex_buffer, NULL, 0, NUM_SHAPES * 3,
+            ALLEGRO_PRIM_TRIANGLE_LIST);
+         return 1;
+
+      case INDEXED_BUFFER:
+         *num_triangles = NUM_SHAPES * 2;
+         al_draw_indexed_buffer(quad_buffer, NULL, index_buffer, 0,
+            NUM_SHAPES * 6, ALLEGRO_PRIM_TRIANGLE_LIST);
+         return 1;
+
+      case NUM_TESTS:
+         break;
+   }
+   *num_triangles = 0;
+   return 0;
+}
+
+
+static void load_baseline(void)
+{
+   char line[256];
+   FILE *f = fopen(baseline_name, "r");
+
+   if (!f) {
+      fprintf(stderr, "Could not open %s, not comparing against a "
+         "baseline.\n", baseline_name);
+      return;
+   }
+
+   while (fgets(line, sizeof line, f) && num_baseline < MAX_BASELINE) {
+      /* The key is made of the first three columns, the triangles per
+       * second are in the eighth.
+       */
+      char *p = line;
+      int column;
+
+      for (column = 0; column < 7 && p; column++) {
+         p = strchr(p, ',');
+         if (p && column == 2) {
+            size_t n = p - line;
+            if (n >= sizeof baseline[0].key)
+               break;
+            memcpy(baseline[num_baseline].key, line, n);
+            baseline[num_baseline].key[n] = '\0';
+         }
+         if (p)
+            p++;
+      }
+      if (column < 7 || !p || strtod(p, NULL) <= 0)
+         continue;
+      baseline[num_baseline].triangles_per_second = strtod(p, NULL);
+      num_baseline++;
+   }
+
+   fclose(f);
+}
+
+
+static double find_baseline(char const *key)
+{
+   int i;
+
+   for (i = 0; i < num_baseline; i++) {
+      if (strcmp(baseline[i].key, key) == 0)
+         return baseline[i].triangles_per_second;
+   }
+   return 0;
+}
+
+
+static void run_test(enum Test test, char const *backend_name, bool held)
+{
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+   bool flip = display && al_get_target_bitmap() == al_get_backbuffer(display);
+   char key[128];
+   long frames = 0;
+   int calls = 0;
+   int num_triangles = 0;
+   double t0, t1;
+   clock_t c0, c1;
+   double cpu_ms, tps, reference;
+
+   /* Untimed frame to get caches and shaders set up. */
+   draw_frame(test, &num_triangles);
+
+   t0 = al_get_time();
+   c0 = clock();
+   do {
+      if (held)
+         al_hold_primitive_drawing(true);
+      calls = draw_frame(test, &num_triangles);
+      if (held)
+         al_hold_primitive_drawing(false);
+      if (flip)
+         al_flip_display();
+      frames++;
+      t1 = al_get_time();
+   } while (t1 - t0 < test_time);
+   c1 = clock();
+
+   cpu_ms = (double)(c1 - c0) / CLOCKS_PER_SEC * 1000 / frames;
+   tps = frames * num_triangles / (t1 - t0);
+
+   snprintf(key, sizeof key, "%s,%s,%s", tests[test].name, backend_name,
+      held ? "held" : "unheld");
+   reference = find_baseline(key);
+
+   printf("%s,%d,%d,%ld,%.4f,%.0f,", key, calls, num_triangles, frames,
+      cpu_ms, tps);
+   if (reference > 0)
+      printf("%.2f\n", tps / reference);
+   else
+      printf("\n");
+   fflush(stdout);
+}
+
+
+static void test_target(char const *backend_name, ALLEGRO_BITMAP *target)
+{
+   bool has_display = al_get_current_display() != NULL;
+   int i;
+
+   al_set_target_bitmap(target);
+   create_buffers();
+
+   for (i = 0; i < NUM_TESTS; i++) {
+      if (tests[i].needs_display && (!has_display || !vertex_buffer ||
+            !quad_buffer || !index_buffer)) {
+         continue;
+      }
+      al_clear_to_color(al_map_rgb(0, 0, 0));
+      run_test(i, backend_name, false);
+      if (tests[i].can_hold)
+         run_test(i, backend_name, true);
+   }
+
+   destroy_buffers();
+}
+
+
+int main(int argc, char **argv)
+{
+   static struct {
+      char const *name;
+      int flags;
+   } const backends[] = {
+      {"opengl", ALLEGRO_OPENGL},
+#ifdef ALLEGRO_WINDOWS
+      {"direct3d", ALLEGRO_DIRECT3D},
+#endif
+   };
+   ALLEGRO_BITMAP *memory_target;
+   unsigned i;
+
+   if (argc > 1) {
+      test_time = strtod(argv[1], NULL);
+      if (test_time <= 0)
+         test_time = TEST_TIME;
+   }
+   if (argc > 2) {
+      baseline_name = argv[2];
+   }
+
+   if (!al_init()) {
+      abort_example("Could not init Allegro\n");
+   }
+
+   al_init_primitives_addon();
+   init_platform_specific();
+
+   init_scene();
+   load_baseline();
+
+   printf("test,backend,holding,calls_per_frame,triangles_per_frame,frames,"
+      "cpu_ms_per_frame,triangles_per_second,vs_baseline\n");
+
+   al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+   memory_target = al_create_bitmap(WIDTH, HEIGHT);
+   test_target("software", memory_target);
+   al_destroy_bitmap(memory_target);
+
+   /* Flipping shouldn't wait for the monitor. */
+   al_set_new_display_option(ALLEGRO_VSYNC, 2, ALLEGRO_SUGGEST);
+   al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
+
+   for (i = 0; i < sizeof backends / sizeof backends[0]; i++) {
+      ALLEGRO_DISPLAY *display;
+
+      al_set_new_display_flags(backends[i].flags);
+      display = al_create_display(WIDTH, HEIGHT);
+      if (!display) {
+         fprintf(stderr, "Could not create a display with the %s backend, "
+            "skipping it.\n",
+            backends[i].name);
+         continue;
+      }
+      test_target(backends[i].name, al_get_backbuffer(display));
+      al_destroy_display(display);
+   }
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
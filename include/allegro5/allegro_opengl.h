@@ -133,7 +133,7 @@
 
 #endif
 
-#ifdef ALLEGRO_RASPBERRYPI
+#if defined ALLEGRO_RASPBERRYPI || defined ALLEGRO_KMS
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #endif
@@ -202,6 +202,14 @@ AL_FUNC(GLuint,                al_get_opengl_program_object,     (ALLEGRO_SHADER
 AL_FUNC(void,                  al_set_current_opengl_context,    (ALLEGRO_DISPLAY *display));
 AL_FUNC(int,                   al_get_opengl_variant,            (void));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(void,                  al_invalidate_opengl_state,       (void));
+AL_FUNC(int,                   al_reserve_opengl_upload_contexts, (int count));
+AL_FUNC(bool,                  al_begin_opengl_upload,           (ALLEGRO_DISPLAY *display));
+AL_FUNC(void,                  al_end_opengl_upload,             (void));
+AL_FUNC(GLuint,                al_get_opengl_depth_texture,      (ALLEGRO_BITMAP *bitmap));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
@@ -0,0 +1,50 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Header file for Raspberry Pi specific functionality.
+ *
+ */
+
+#ifndef __al_included_allegro5_allegro_raspberrypi_h
+#define __al_included_allegro5_allegro_raspberrypi_h
+
+#include "allegro5/base.h"
+#include "allegro5/bitmap.h"
+#include "allegro5/display.h"
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+/*
+ *  Public Raspberry Pi-related API
+ */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+typedef struct ALLEGRO_RASPBERRYPI_OVERLAY ALLEGRO_RASPBERRYPI_OVERLAY;
+
+AL_FUNC(ALLEGRO_RASPBERRYPI_OVERLAY *, al_create_raspberrypi_overlay,
+   (ALLEGRO_DISPLAY *display, int layer, int width, int height));
+AL_FUNC(void, al_destroy_raspberrypi_overlay,
+   (ALLEGRO_RASPBERRYPI_OVERLAY *overlay));
+AL_FUNC(bool, al_update_raspberrypi_overlay,
+   (ALLEGRO_RASPBERRYPI_OVERLAY *overlay, ALLEGRO_BITMAP *bitmap));
+AL_FUNC(void, al_set_raspberrypi_overlay_region,
+   (ALLEGRO_RASPBERRYPI_OVERLAY *overlay, int x, int y, int w, int h));
+AL_FUNC(void, al_set_raspberrypi_overlay_opacity,
+   (ALLEGRO_RASPBERRYPI_OVERLAY *overlay, float opacity));
+#endif
+
+#ifdef __cplusplus
+   }
+#endif
+
+#endif
+
+/* vim: set sts=3 sw=3 et: */
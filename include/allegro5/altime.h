@@ -21,6 +21,10 @@ AL_FUNC(double, al_get_time, (void));
 AL_FUNC(void, al_rest, (double seconds));
 AL_FUNC(void, al_init_timeout, (ALLEGRO_TIMEOUT *timeout, double seconds));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(void, al_init_timeout_until, (ALLEGRO_TIMEOUT *timeout, double time));
+#endif
+
 
 
 #ifdef __cplusplus
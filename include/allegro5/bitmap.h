@@ -27,7 +27,13 @@ enum {
    ALLEGRO_MIPMAP                   = 0x0100,
    _ALLEGRO_NO_PREMULTIPLIED_ALPHA  = 0x0200,	/* now a bitmap loader flag */
    ALLEGRO_VIDEO_BITMAP             = 0x0400,
-   ALLEGRO_CONVERT_BITMAP           = 0x1000
+   ALLEGRO_CONVERT_BITMAP           = 0x1000,
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+   ALLEGRO_PARALLEL_CONVERSION      = 0x2000,
+   ALLEGRO_TILED_BITMAP             = 0x4000,
+   ALLEGRO_MANUAL_RESOLVE           = 0x8000,
+   ALLEGRO_DEPTH_TEXTURE            = 0x10000,
+#endif
 };
 
 
@@ -61,9 +67,24 @@ AL_FUNC(void, al_put_pixel, (int x, int y, ALLEGRO_COLOR color));
 AL_FUNC(void, al_put_blended_pixel, (int x, int y, ALLEGRO_COLOR color));
 AL_FUNC(ALLEGRO_COLOR, al_get_pixel, (ALLEGRO_BITMAP *bitmap, int x, int y));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(void, al_get_pixel_row, (ALLEGRO_BITMAP *bitmap, int x, int y, int n, ALLEGRO_COLOR *colors));
+AL_FUNC(void, al_put_pixel_span, (int x, int y, int n, const ALLEGRO_COLOR *colors));
+AL_FUNC(bool, al_get_pixel_row_format, (ALLEGRO_BITMAP *bitmap, int x, int y, int n, void *data, int format));
+AL_FUNC(bool, al_put_pixel_span_format, (int x, int y, int n, const void *data, int format));
+#endif
+
 /* Masking */
 AL_FUNC(void, al_convert_mask_to_alpha, (ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR mask_color));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(void, al_set_bitmap_color_key, (ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR key));
+AL_FUNC(void, al_clear_bitmap_color_key, (ALLEGRO_BITMAP *bitmap));
+AL_FUNC(bool, al_get_bitmap_color_key, (ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR *key));
+AL_FUNC(bool, al_premultiply_bitmap_alpha, (ALLEGRO_BITMAP *bitmap));
+AL_FUNC(bool, al_unpremultiply_bitmap_alpha, (ALLEGRO_BITMAP *bitmap));
+#endif
+
 /* Blending */
 #if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
 AL_FUNC(ALLEGRO_COLOR, al_get_bitmap_blend_color, (void));
@@ -89,12 +110,34 @@ AL_FUNC(int, al_get_bitmap_y, (ALLEGRO_BITMAP *bitmap));
 AL_FUNC(void, al_reparent_bitmap, (ALLEGRO_BITMAP *bitmap,
    ALLEGRO_BITMAP *parent, int x, int y, int w, int h));
 
+/* Bitmap atlases */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_BITMAP_ATLAS
+ */
+typedef struct ALLEGRO_BITMAP_ATLAS ALLEGRO_BITMAP_ATLAS;
+
+AL_FUNC(ALLEGRO_BITMAP_ATLAS *, al_create_bitmap_atlas, (int page_w, int page_h));
+AL_FUNC(void, al_destroy_bitmap_atlas, (ALLEGRO_BITMAP_ATLAS *atlas));
+AL_FUNC(ALLEGRO_BITMAP *, al_add_bitmap_to_atlas, (ALLEGRO_BITMAP_ATLAS *atlas, ALLEGRO_BITMAP *bitmap));
+AL_FUNC(int, al_get_num_bitmap_atlas_pages, (ALLEGRO_BITMAP_ATLAS *atlas));
+AL_FUNC(ALLEGRO_BITMAP *, al_get_bitmap_atlas_page, (ALLEGRO_BITMAP_ATLAS *atlas, int index));
+#endif
+
+/* Damage tracking */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(void, al_set_bitmap_damage_tracking, (ALLEGRO_BITMAP *bitmap, bool track));
+AL_FUNC(bool, al_get_bitmap_damage, (ALLEGRO_BITMAP *bitmap, int *x, int *y, int *w, int *h));
+AL_FUNC(void, al_reset_bitmap_damage, (ALLEGRO_BITMAP *bitmap));
+#endif
+
 /* Miscellaneous */
 AL_FUNC(ALLEGRO_BITMAP *, al_clone_bitmap, (ALLEGRO_BITMAP *bitmap));
 AL_FUNC(void, al_convert_bitmap, (ALLEGRO_BITMAP *bitmap));
 AL_FUNC(void, al_convert_memory_bitmaps, (void));
 #if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
 AL_FUNC(void, al_backup_dirty_bitmap, (ALLEGRO_BITMAP *bitmap));
+AL_FUNC(void, al_discard_bitmap_contents, (ALLEGRO_BITMAP *bitmap));
+AL_FUNC(bool, al_resolve_bitmap, (ALLEGRO_BITMAP *bitmap));
 #endif
 
 #ifdef __cplusplus
@@ -2,6 +2,7 @@
 #define __al_included_allegro5_bitmap_io_h
 
 #include "allegro5/bitmap.h"
+#include "allegro5/events.h"
 #include "allegro5/file.h"
 
 #ifdef __cplusplus
@@ -38,6 +39,14 @@ AL_FUNC(bool, al_save_bitmap_f, (ALLEGRO_FILE *fp, const char *ident, ALLEGRO_BI
 AL_FUNC(char const *, al_identify_bitmap_f, (ALLEGRO_FILE *fp));
 AL_FUNC(char const *, al_identify_bitmap, (char const *filename));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(int, al_load_bitmap_async, (const char *filename, int flags,
+   ALLEGRO_EVENT_QUEUE *queue));
+AL_FUNC(int, al_upload_async_bitmaps, (double max_time));
+AL_FUNC(int, al_load_bitmaps_batch, (const char * const *filenames, int count,
+   int flags, ALLEGRO_BITMAP **bitmaps));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
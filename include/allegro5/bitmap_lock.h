@@ -37,6 +37,18 @@ AL_FUNC(ALLEGRO_LOCKED_REGION*, al_lock_bitmap_region_blocked, (ALLEGRO_BITMAP *
 AL_FUNC(void, al_unlock_bitmap, (ALLEGRO_BITMAP *bitmap));
 AL_FUNC(bool, al_is_bitmap_locked, (ALLEGRO_BITMAP *bitmap));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_BITMAP_READBACK
+ */
+typedef struct ALLEGRO_BITMAP_READBACK ALLEGRO_BITMAP_READBACK;
+
+AL_FUNC(ALLEGRO_BITMAP_READBACK*, al_read_bitmap_region_async, (ALLEGRO_BITMAP *bitmap, int x, int y, int width, int height, int format));
+AL_FUNC(bool, al_is_bitmap_readback_ready, (ALLEGRO_BITMAP_READBACK *readback));
+AL_FUNC(ALLEGRO_LOCKED_REGION*, al_map_bitmap_readback, (ALLEGRO_BITMAP_READBACK *readback));
+AL_FUNC(void, al_unmap_bitmap_readback, (ALLEGRO_BITMAP_READBACK *readback));
+AL_FUNC(void, al_destroy_bitmap_readback, (ALLEGRO_BITMAP_READBACK *readback));
+#endif
+
 
 #ifdef __cplusplus
    }
@@ -27,6 +27,10 @@
 AL_FUNC(char *, al_get_clipboard_text, (ALLEGRO_DISPLAY *display));
 AL_FUNC(bool, al_set_clipboard_text, (ALLEGRO_DISPLAY *display, const char *text));
 AL_FUNC(bool, al_clipboard_has_text, (ALLEGRO_DISPLAY *display));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(bool, al_request_clipboard_text, (ALLEGRO_DISPLAY *display));
+AL_FUNC(const ALLEGRO_USTR *, al_get_clipboard_ustr, (ALLEGRO_DISPLAY *display));
+#endif
 
 #ifdef __cplusplus
    }
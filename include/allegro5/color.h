@@ -53,6 +53,16 @@ typedef enum ALLEGRO_PIXEL_FORMAT
    ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1  = 28,
    ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3  = 29,
    ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5  = 30,
+   ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4      = 31,
+   ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5     = 32,
+   ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_BC7   = 33,
+   ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGB_ETC2   = 34,
+   ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ETC2  = 35,
+   ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_4x4 = 36,
+   ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_6x6 = 37,
+   ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x8 = 38,
+   ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB        = 39,
+   ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB        = 40,
    ALLEGRO_NUM_PIXEL_FORMATS
 } ALLEGRO_PIXEL_FORMAT;
 
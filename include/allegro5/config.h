@@ -42,6 +42,10 @@ AL_FUNC(char const *, al_get_first_config_entry, (ALLEGRO_CONFIG const *config,
 	ALLEGRO_CONFIG_ENTRY **iterator));
 AL_FUNC(char const *, al_get_next_config_entry, (ALLEGRO_CONFIG_ENTRY **iterator));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(ALLEGRO_CONFIG *, al_freeze_config, (const ALLEGRO_CONFIG *config));
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,6 +25,24 @@
 AL_FUNC(int, al_get_cpu_count, (void));
 AL_FUNC(int, al_get_ram_size, (void));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Enum: ALLEGRO_CPU_FEATURES
+ */
+enum ALLEGRO_CPU_FEATURES {
+   ALLEGRO_CPU_SSE2     = 1 << 0,
+   ALLEGRO_CPU_SSSE3    = 1 << 1,
+   ALLEGRO_CPU_SSE41    = 1 << 2,
+   ALLEGRO_CPU_AVX2     = 1 << 3,
+   ALLEGRO_CPU_NEON     = 1 << 4,
+   ALLEGRO_CPU_AVX512F  = 1 << 5,
+   ALLEGRO_CPU_FMA      = 1 << 6
+};
+
+AL_FUNC(int, al_get_cpu_features, (void));
+AL_FUNC(int, al_get_cpu_cache_line_size, (void));
+AL_FUNC(int, al_get_cpu_cache_size, (int level));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
@@ -31,24 +31,42 @@ AL_FUNC(bool, _al_trace_prefix, (char const *channel, int level,
 
 AL_PRINTFUNC(void, _al_trace_suffix, (const char *msg, ...), 1, 2);
 
+AL_FUNC(int, _al_trace_cache_channel, (char const *channel));
+AL_VAR(int, _al_trace_generation);
+
 #if defined(DEBUGMODE) || defined(ALLEGRO_CFG_RELEASE_LOGGING)
    /* Must not be used with a trailing semicolon. */
    #ifdef ALLEGRO_GCC
       #define ALLEGRO_DEBUG_CHANNEL(x) \
-         static char const *__al_debug_channel __attribute__((unused)) = x;
+         static char const *__al_debug_channel __attribute__((unused)) = x; \
+         static int __al_debug_channel_cache __attribute__((unused));
    #else
       #define ALLEGRO_DEBUG_CHANNEL(x) \
-         static char const *__al_debug_channel = x;
+         static char const *__al_debug_channel = x; \
+         static int __al_debug_channel_cache;
    #endif
    #define ALLEGRO_TRACE_CHANNEL_LEVEL(channel, level)                        \
       !_al_trace_prefix(channel, level, __FILE__, __LINE__, __func__)         \
       ? (void)0 : _al_trace_suffix
+   /* The cache holds the lowest level logged on the channel in the low three
+    * bits, and the _al_trace_generation it was looked up in above them.
+    * Disabled messages then cost a comparison or two.
+    */
+   #define _ALLEGRO_TRACE_CACHED_CHANNEL_LEVEL(channel, cache, level)         \
+      ((((cache) >> 3) != _al_trace_generation                                \
+         ? ((cache) = _al_trace_cache_channel(channel)) : (cache)) & 7)       \
+         > (level)                                                            \
+      || !_al_trace_prefix(channel, level, __FILE__, __LINE__, __func__)      \
+      ? (void)0 : _al_trace_suffix
+   #define ALLEGRO_TRACE_LEVEL(x)                                             \
+      _ALLEGRO_TRACE_CACHED_CHANNEL_LEVEL(__al_debug_channel,                 \
+         __al_debug_channel_cache, x)
 #else
    #define ALLEGRO_TRACE_CHANNEL_LEVEL(channel, x)  1 ? (void) 0 : _al_trace_suffix
    #define ALLEGRO_DEBUG_CHANNEL(x)
+   #define ALLEGRO_TRACE_LEVEL(x)   ALLEGRO_TRACE_CHANNEL_LEVEL(__al_debug_channel, x)
 #endif
 
-#define ALLEGRO_TRACE_LEVEL(x)   ALLEGRO_TRACE_CHANNEL_LEVEL(__al_debug_channel, x)
 #define ALLEGRO_DEBUG            ALLEGRO_TRACE_LEVEL(0)
 #define ALLEGRO_INFO             ALLEGRO_TRACE_LEVEL(1)
 #define ALLEGRO_WARN             ALLEGRO_TRACE_LEVEL(2)
@@ -70,6 +70,8 @@ enum ALLEGRO_DISPLAY_OPTIONS {
    ALLEGRO_SUPPORTED_ORIENTATIONS = 32,
    ALLEGRO_OPENGL_MAJOR_VERSION = 33,
    ALLEGRO_OPENGL_MINOR_VERSION = 34,
+   ALLEGRO_MAX_FRAME_LATENCY = 35,
+   ALLEGRO_SRGB_FRAMEBUFFER = 36,
    ALLEGRO_DISPLAY_OPTIONS_COUNT
 };
 
@@ -179,6 +181,33 @@ AL_FUNC(void, al_acknowledge_drawing_halt, (ALLEGRO_DISPLAY *display));
 AL_FUNC(void, al_acknowledge_drawing_resume, (ALLEGRO_DISPLAY *display));
 #if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
 AL_FUNC(void, al_backup_dirty_bitmaps, (ALLEGRO_DISPLAY *display));
+
+/* Type: ALLEGRO_DISPLAY_STATS
+ */
+typedef struct ALLEGRO_DISPLAY_STATS ALLEGRO_DISPLAY_STATS;
+
+struct ALLEGRO_DISPLAY_STATS
+{
+   int frames;
+   int draw_calls;
+   int vertices;
+   int texture_flushes;
+   int state_changes;
+   int target_switches;
+   int texture_uploads;
+   int64_t texture_upload_bytes;
+   double gpu_frame_time;
+};
+
+AL_FUNC(void, al_get_display_stats, (ALLEGRO_DISPLAY *display, ALLEGRO_DISPLAY_STATS *stats));
+AL_FUNC(void, al_reset_display_stats, (ALLEGRO_DISPLAY *display));
+AL_FUNC(void, al_set_display_texture_budget, (ALLEGRO_DISPLAY *display, int64_t bytes));
+AL_FUNC(int64_t, al_get_display_texture_budget, (ALLEGRO_DISPLAY *display));
+AL_FUNC(bool, al_wait_for_frame_latency, (ALLEGRO_DISPLAY *display, int frames));
+AL_FUNC(void, al_flip_display_regions, (const int *rects, int num_rects));
+AL_FUNC(bool, al_set_display_vsync_events, (ALLEGRO_DISPLAY *display, bool onoff));
+AL_FUNC(void, al_request_display_redraw, (ALLEGRO_DISPLAY *display));
+AL_FUNC(bool, al_set_display_frame_time_hint, (ALLEGRO_DISPLAY *display, double seconds));
 #endif
 
 #ifdef __cplusplus
@@ -2,6 +2,7 @@
 #define __al_included_allegro5_drawing_h
 
 #include "allegro5/color.h"
+#include "allegro5/transformations.h"
 
 #ifdef __cplusplus
    extern "C" {
@@ -13,6 +14,18 @@ AL_FUNC(void, al_clear_to_color, (ALLEGRO_COLOR color));
 AL_FUNC(void, al_clear_depth_buffer, (float x));
 AL_FUNC(void, al_draw_pixel, (float x, float y, ALLEGRO_COLOR color));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_DRAW_LIST
+ */
+typedef struct ALLEGRO_DRAW_LIST ALLEGRO_DRAW_LIST;
+
+AL_FUNC(bool, al_begin_draw_recording, (void));
+AL_FUNC(ALLEGRO_DRAW_LIST *, al_end_draw_recording, (void));
+AL_FUNC(void, al_replay_draw_list, (const ALLEGRO_DRAW_LIST *list,
+   const ALLEGRO_TRANSFORM *trans));
+AL_FUNC(void, al_destroy_draw_list, (ALLEGRO_DRAW_LIST *list));
+#endif
+
 
 #ifdef __cplusplus
    }
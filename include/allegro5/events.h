@@ -47,9 +47,22 @@ enum
    ALLEGRO_EVENT_TOUCH_END                   = 51,
    ALLEGRO_EVENT_TOUCH_MOVE                  = 52,
    ALLEGRO_EVENT_TOUCH_CANCEL                = 53,
+   ALLEGRO_EVENT_TOUCH_FRAME                 = 54,
    
    ALLEGRO_EVENT_DISPLAY_CONNECTED           = 60,
-   ALLEGRO_EVENT_DISPLAY_DISCONNECTED        = 61
+   ALLEGRO_EVENT_DISPLAY_DISCONNECTED        = 61,
+   ALLEGRO_EVENT_DISPLAY_VSYNC               = 62,
+   ALLEGRO_EVENT_DISPLAY_REDRAW              = 63,
+   ALLEGRO_EVENT_DISPLAY_THERMAL_STATE       = 64,
+   ALLEGRO_EVENT_DISPLAY_CLIPBOARD_TEXT      = 65,
+   ALLEGRO_EVENT_DISPLAY_TOPOLOGY_CHANGED    = 66,
+
+   ALLEGRO_EVENT_BITMAP_LOADED               = 70,
+   ALLEGRO_EVENT_BITMAP_EVICTED              = 71,
+
+   ALLEGRO_EVENT_FILE_READ                   = 80,
+
+   ALLEGRO_EVENT_JOB_DONE                    = 90
 };
 
 
@@ -110,6 +123,9 @@ typedef struct ALLEGRO_DISPLAY_EVENT
    int x, y;
    int width, height;
    int orientation;
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+   int thermal_state;
+#endif
 } ALLEGRO_DISPLAY_EVENT;
 
 
@@ -181,6 +197,45 @@ typedef struct ALLEGRO_TOUCH_EVENT
 
 
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+typedef struct ALLEGRO_TOUCH_FRAME_EVENT
+{
+   _AL_EVENT_HEADER(struct ALLEGRO_TOUCH_INPUT)
+   struct ALLEGRO_DISPLAY *display;
+   /* (frame) Position of the touch input state in the state history, see
+    * al_get_touch_input_frame.
+    */
+   unsigned int frame;
+} ALLEGRO_TOUCH_FRAME_EVENT;
+
+typedef struct ALLEGRO_BITMAP_EVENT
+{
+   _AL_EVENT_HEADER(struct ALLEGRO_EVENT_SOURCE)
+   struct ALLEGRO_BITMAP *bitmap;
+   int id;
+} ALLEGRO_BITMAP_EVENT;
+
+typedef struct ALLEGRO_FILE_EVENT
+{
+   _AL_EVENT_HEADER(struct ALLEGRO_EVENT_SOURCE)
+   struct ALLEGRO_FILE *file;
+   void *buffer;
+   size_t size;
+   size_t bytes_read;
+   int id;
+   int error;
+} ALLEGRO_FILE_EVENT;
+
+typedef struct ALLEGRO_JOB_EVENT
+{
+   _AL_EVENT_HEADER(struct ALLEGRO_EVENT_SOURCE)
+   struct ALLEGRO_JOB *job;
+   void *result;
+} ALLEGRO_JOB_EVENT;
+#endif
+
+
+
 /* Type: ALLEGRO_USER_EVENT
  */
 typedef struct ALLEGRO_USER_EVENT ALLEGRO_USER_EVENT;
@@ -217,6 +272,12 @@ union ALLEGRO_EVENT
    ALLEGRO_TIMER_EVENT    timer;
    ALLEGRO_TOUCH_EVENT    touch;
    ALLEGRO_USER_EVENT     user;
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+   ALLEGRO_TOUCH_FRAME_EVENT touch_frame;
+   ALLEGRO_BITMAP_EVENT   bitmap;
+   ALLEGRO_FILE_EVENT     file;
+   ALLEGRO_JOB_EVENT      job;
+#endif
 };
 
 
@@ -233,6 +294,22 @@ AL_FUNC(bool, al_emit_user_event, (ALLEGRO_EVENT_SOURCE *, ALLEGRO_EVENT *,
 AL_FUNC(void, al_unref_user_event, (ALLEGRO_USER_EVENT *));
 AL_FUNC(void, al_set_event_source_data, (ALLEGRO_EVENT_SOURCE*, intptr_t data));
 AL_FUNC(intptr_t, al_get_event_source_data, (const ALLEGRO_EVENT_SOURCE*));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_EVENT_LATENCY
+ */
+typedef struct ALLEGRO_EVENT_LATENCY
+{
+   int count;
+   double last;
+   double min;
+   double max;
+   double mean;
+} ALLEGRO_EVENT_LATENCY;
+
+AL_FUNC(bool, al_get_event_source_latency, (ALLEGRO_EVENT_SOURCE *,
+   ALLEGRO_EVENT_LATENCY *latency));
+AL_FUNC(void, al_reset_event_source_latency, (ALLEGRO_EVENT_SOURCE *));
+#endif
 
 
 
@@ -243,6 +320,9 @@ AL_FUNC(intptr_t, al_get_event_source_data, (const ALLEGRO_EVENT_SOURCE*));
 typedef struct ALLEGRO_EVENT_QUEUE ALLEGRO_EVENT_QUEUE;
 
 AL_FUNC(ALLEGRO_EVENT_QUEUE*, al_create_event_queue, (void));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(ALLEGRO_EVENT_QUEUE*, al_create_lockfree_event_queue, (int capacity));
+#endif
 AL_FUNC(void, al_destroy_event_queue, (ALLEGRO_EVENT_QUEUE*));
 AL_FUNC(bool, al_is_event_source_registered, (ALLEGRO_EVENT_QUEUE *, 
          ALLEGRO_EVENT_SOURCE *));
@@ -263,6 +343,13 @@ AL_FUNC(bool, al_wait_for_event_timed, (ALLEGRO_EVENT_QUEUE*,
 AL_FUNC(bool, al_wait_for_event_until, (ALLEGRO_EVENT_QUEUE *queue,
                                         ALLEGRO_EVENT *ret_event,
                                         ALLEGRO_TIMEOUT *timeout));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(int, al_get_next_events, (ALLEGRO_EVENT_QUEUE *queue,
+                                  ALLEGRO_EVENT *ret_events, int max));
+AL_FUNC(int, al_wait_for_events_timed, (ALLEGRO_EVENT_QUEUE *queue,
+                                        ALLEGRO_EVENT *ret_events, int max,
+                                        float secs));
+#endif
 
 #ifdef __cplusplus
    }
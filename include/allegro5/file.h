@@ -2,6 +2,7 @@
 #define __al_included_allegro5_file_h
 
 #include "allegro5/base.h"
+#include "allegro5/events.h"
 #include "allegro5/path.h"
 #include "allegro5/utf8.h"
 
@@ -88,6 +89,71 @@ AL_FUNC(ALLEGRO_FILE*, al_make_temp_file, (const char *tmpl,
 AL_FUNC(ALLEGRO_FILE*, al_fopen_slice, (ALLEGRO_FILE *fp,
       size_t initial_size, const char *mode));
 
+/* Specific to memory-mapped files. */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(ALLEGRO_FILE*, al_fopen_mmap, (const char *path));
+AL_FUNC(const void *, al_fget_mapped_buffer, (ALLEGRO_FILE *f, size_t *size));
+#endif
+
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(bool, al_set_file_read_buffer_size, (ALLEGRO_FILE *f, size_t size));
+AL_FUNC(size_t, al_get_file_read_buffer_size, (ALLEGRO_FILE *f));
+AL_FUNC(int, al_fread_async, (ALLEGRO_FILE *f, int64_t offset, void *buf,
+   size_t size, ALLEGRO_EVENT_QUEUE *queue));
+#endif
+
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_ARCHIVE
+ */
+typedef struct ALLEGRO_ARCHIVE ALLEGRO_ARCHIVE;
+
+AL_FUNC(ALLEGRO_ARCHIVE *, al_open_archive, (const char *filename));
+AL_FUNC(void, al_close_archive, (ALLEGRO_ARCHIVE *archive));
+AL_FUNC(ALLEGRO_FILE *, al_fopen_archive_entry, (ALLEGRO_ARCHIVE *archive,
+   const char *path));
+AL_FUNC(bool, al_mount_archive, (ALLEGRO_ARCHIVE *archive));
+AL_FUNC(bool, al_unmount_archive, (ALLEGRO_ARCHIVE *archive));
+AL_FUNC(void, al_set_archive_file_interface, (void));
+#endif
+
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_FILE_STATS
+ */
+typedef struct ALLEGRO_FILE_STATS
+{
+   uint64_t opens;
+   double open_time;
+   uint64_t reads;
+   uint64_t bytes_read;
+   double read_time;
+   uint64_t writes;
+   uint64_t bytes_written;
+   uint64_t seeks;
+} ALLEGRO_FILE_STATS;
+
+/* Enum: ALLEGRO_FILE_IO_OPERATION
+ */
+enum ALLEGRO_FILE_IO_OPERATION
+{
+   ALLEGRO_FILE_IO_OPEN = 0,
+   ALLEGRO_FILE_IO_READ = 1
+};
+
+/* Type: ALLEGRO_FILE_IO_CALLBACK
+ */
+typedef void (*ALLEGRO_FILE_IO_CALLBACK)(ALLEGRO_FILE *f,
+   const ALLEGRO_FILE_INTERFACE *vt, int operation, const char *path,
+   size_t size, double seconds, void *extra);
+
+AL_FUNC(bool, al_set_file_stats_enabled, (bool enabled));
+AL_FUNC(bool, al_get_file_stats, (ALLEGRO_FILE *f, ALLEGRO_FILE_STATS *stats));
+AL_FUNC(bool, al_get_file_interface_stats, (const ALLEGRO_FILE_INTERFACE *vt,
+   ALLEGRO_FILE_STATS *stats));
+AL_FUNC(void, al_reset_file_interface_stats, (void));
+AL_FUNC(bool, al_set_slow_file_io_callback, (ALLEGRO_FILE_IO_CALLBACK callback,
+   double threshold, void *extra));
+#endif
+
 /* Thread-local state. */
 AL_FUNC(const ALLEGRO_FILE_INTERFACE *, al_get_new_file_interface, (void));
 AL_FUNC(void, al_set_new_file_interface, (const ALLEGRO_FILE_INTERFACE *
@@ -133,6 +133,38 @@ AL_FUNC(int,  al_for_each_fs_entry, (ALLEGRO_FS_ENTRY *dir,
                                      void *extra));
 
 
+/* Batch directory listings. */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+
+/* Type: ALLEGRO_FS_LISTING
+ */
+typedef struct ALLEGRO_FS_LISTING ALLEGRO_FS_LISTING;
+
+/* Type: ALLEGRO_FS_LISTING_ENTRY
+ */
+typedef struct ALLEGRO_FS_LISTING_ENTRY {
+   const char *name;
+   uint32_t mode;
+   off_t size;
+   time_t mtime;
+} ALLEGRO_FS_LISTING_ENTRY;
+
+/* Enum: ALLEGRO_LIST_DIRECTORY_FLAGS
+ */
+enum ALLEGRO_LIST_DIRECTORY_FLAGS {
+   ALLEGRO_LIST_DIRECTORY_RECURSIVE = 1 << 0,
+   ALLEGRO_LIST_DIRECTORY_PARALLEL  = 1 << 1
+};
+
+AL_FUNC(ALLEGRO_FS_LISTING *, al_list_directory, (const char *path, int flags));
+AL_FUNC(void, al_destroy_fs_listing, (ALLEGRO_FS_LISTING *listing));
+AL_FUNC(int, al_get_fs_listing_count, (const ALLEGRO_FS_LISTING *listing));
+AL_FUNC(const ALLEGRO_FS_LISTING_ENTRY *, al_get_fs_listing_entry,
+   (const ALLEGRO_FS_LISTING *listing, int index));
+
+#endif
+
+
 /* Thread-local state. */
 AL_FUNC(const ALLEGRO_FS_INTERFACE *, al_get_fs_interface, (void));
 AL_FUNC(void, al_set_fs_interface, (const ALLEGRO_FS_INTERFACE *vtable));
@@ -235,6 +235,7 @@ AL_FUNC(bool, al_is_haptic_effect_playing, (ALLEGRO_HAPTIC_EFFECT_ID *));
 AL_FUNC(bool, al_release_haptic_effect, (ALLEGRO_HAPTIC_EFFECT_ID *));
 AL_FUNC(double, al_get_haptic_effect_duration, (ALLEGRO_HAPTIC_EFFECT *));
 AL_FUNC(bool, al_rumble_haptic, (ALLEGRO_HAPTIC *, double, double, ALLEGRO_HAPTIC_EFFECT_ID *));
+AL_FUNC(bool, al_update_haptic_effect, (ALLEGRO_HAPTIC_EFFECT_ID *, ALLEGRO_HAPTIC_EFFECT *));
 
 #endif
 
@@ -1,6 +1,10 @@
 #ifndef __al_included_allegro5_aintern_aatree_h
 #define __al_included_allegro5_aintern_aatree_h
 
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
 typedef struct _AL_AATREE _AL_AATREE;
 
 struct _AL_AATREE
@@ -14,10 +18,14 @@ struct _AL_AATREE
 
 typedef int (*_al_cmp_t)(const void *a, const void *b);
 
-_AL_AATREE *_al_aa_insert(_AL_AATREE *T, const void *key, void *value, _al_cmp_t compare);
-void *_al_aa_search(const _AL_AATREE *T, const void *key, _al_cmp_t compare);
-_AL_AATREE *_al_aa_delete(_AL_AATREE *T, const void *key, _al_cmp_t compare, void **ret_value);
-void _al_aa_free(_AL_AATREE *T);
+AL_FUNC(_AL_AATREE *, _al_aa_insert, (_AL_AATREE *T, const void *key, void *value, _al_cmp_t compare));
+AL_FUNC(void *, _al_aa_search, (const _AL_AATREE *T, const void *key, _al_cmp_t compare));
+AL_FUNC(_AL_AATREE *, _al_aa_delete, (_AL_AATREE *T, const void *key, _al_cmp_t compare, void **ret_value));
+AL_FUNC(void, _al_aa_free, (_AL_AATREE *T));
+
+#ifdef __cplusplus
+   }
+#endif
 
 #endif
 
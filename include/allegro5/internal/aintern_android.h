@@ -7,6 +7,7 @@
 #include "allegro5/allegro_opengl.h"
 
 #include <jni.h>
+#include <android/asset_manager.h>
 
 typedef struct ALLEGRO_SYSTEM_ANDROID {
    ALLEGRO_SYSTEM system;
@@ -27,6 +28,11 @@ typedef struct ALLEGRO_DISPLAY_ANDROID {
    bool resumed;
    bool failed;
    bool is_destroy_display;
+   bool preserve_context;  /* keep the EGL context while in the background */
+   bool context_kept;      /* only the surface was destroyed */
+
+   void *hint_session;     /* APerformanceHintSession, see android_perf.c */
+   int64_t frame_start;
 } ALLEGRO_DISPLAY_ANDROID;
 
 ALLEGRO_SYSTEM_INTERFACE *_al_system_android_interface(void);
@@ -147,10 +153,18 @@ void _al_android_destroy_surface(JNIEnv *env, jobject obj, bool post);
 
 ALLEGRO_BITMAP *_al_android_load_image_f(ALLEGRO_FILE *fh, int flags);
 ALLEGRO_BITMAP *_al_android_load_image(const char *filename, int flags);
+bool _al_android_have_image_decoder(void);
+
+void _al_android_init_thermal_status(void);
+void _al_android_shutdown_thermal_status(void);
+bool _al_android_set_frame_time_hint(ALLEGRO_DISPLAY *display, double seconds);
+void _al_android_close_frame_time_hint(ALLEGRO_DISPLAY_ANDROID *d);
+void _al_android_report_frame_work(ALLEGRO_DISPLAY_ANDROID *d);
+void _al_android_begin_frame_work(ALLEGRO_DISPLAY_ANDROID *d);
 
 jobject _al_android_activity_object(void);
+AAssetManager *_al_android_asset_manager(void);
 jclass _al_android_input_stream_class(void);
-jclass _al_android_apk_stream_class(void);
 jclass _al_android_image_loader_class(void);
 jclass _al_android_clipboard_class(void);
 jclass _al_android_apk_fs_class(void);
@@ -19,6 +19,44 @@
       return __sync_sub_and_fetch(ptr, 1);
    })
 
+   AL_INLINE(void, _al_memory_barrier, (void),
+   {
+      __sync_synchronize();
+   })
+
+   #if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)
+
+   AL_INLINE(_AL_ATOMIC,
+      _al_load_acquire, (volatile _AL_ATOMIC *ptr),
+   {
+      return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+   })
+
+   AL_INLINE(void,
+      _al_store_release, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC value),
+   {
+      __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+   })
+
+   #else
+
+   AL_INLINE(_AL_ATOMIC,
+      _al_load_acquire, (volatile _AL_ATOMIC *ptr),
+   {
+      _AL_ATOMIC value = *ptr;
+      __sync_synchronize();
+      return value;
+   })
+
+   AL_INLINE(void,
+      _al_store_release, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC value),
+   {
+      __sync_synchronize();
+      *ptr = value;
+   })
+
+   #endif
+
 #elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
 
    /* gcc, x86 or x86-64 */
@@ -49,23 +87,70 @@
       return old - 1;
    })
 
-#elif defined(_MSC_VER) && _M_IX86 >= 400
+   AL_INLINE(void, _al_memory_barrier, (void),
+   {
+      /* xchg with a memory operand is implicitly locked. */
+      int dummy = 0, value = 0;
+      __asm__ __volatile__ ("xchgl %0, %1"
+         : "+r" (value), "+m" (dummy) : : "memory");
+   })
+
+   /* x86 loads and stores already are ordered this way, we just need to
+    * keep the compiler from moving things around.
+    */
+   AL_INLINE(_AL_ATOMIC,
+      _al_load_acquire, (volatile _AL_ATOMIC *ptr),
+   {
+      _AL_ATOMIC value = *ptr;
+      __asm__ __volatile__ ("" ::: "memory");
+      return value;
+   })
+
+   AL_INLINE(void,
+      _al_store_release, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC value),
+   {
+      __asm__ __volatile__ ("" ::: "memory");
+      *ptr = value;
+   })
+
+#elif defined(_MSC_VER)
 
-   /* MSVC, x86 */
+   /* MSVC */
    /* MinGW supports these too, but we already have asm code above. */
 
-   typedef LONG _AL_ATOMIC;
+   #include <intrin.h>
+
+   typedef long _AL_ATOMIC;
 
    AL_INLINE(_AL_ATOMIC,
       _al_fetch_and_add1, (volatile _AL_ATOMIC *ptr),
    {
-      return InterlockedIncrement(ptr) - 1;
+      return _InterlockedIncrement(ptr) - 1;
    })
 
    AL_INLINE(_AL_ATOMIC,
       _al_sub1_and_fetch, (volatile _AL_ATOMIC *ptr),
    {
-      return InterlockedDecrement(ptr);
+      return _InterlockedDecrement(ptr);
+   })
+
+   /* The interlocked functions are full barriers on every architecture. */
+   AL_INLINE(void, _al_memory_barrier, (void),
+   {
+      volatile _AL_ATOMIC dummy = 0;
+      _InterlockedExchange(&dummy, 1);
+   })
+
+   AL_INLINE(_AL_ATOMIC,
+      _al_load_acquire, (volatile _AL_ATOMIC *ptr),
+   {
+      return _InterlockedOr(ptr, 0);
+   })
+
+   AL_INLINE(void,
+      _al_store_release, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC value),
+   {
+      _InterlockedExchange(ptr, value);
    })
 
 #elif defined(ALLEGRO_HAVE_OSATOMIC_H)
@@ -93,6 +178,26 @@
       return OSAtomicDecrement32Barrier((_AL_ATOMIC *)ptr);
    })
 
+   AL_INLINE(void, _al_memory_barrier, (void),
+   {
+      OSMemoryBarrier();
+   })
+
+   AL_INLINE(_AL_ATOMIC,
+      _al_load_acquire, (volatile _AL_ATOMIC *ptr),
+   {
+      _AL_ATOMIC value = *ptr;
+      OSMemoryBarrier();
+      return value;
+   })
+
+   AL_INLINE(void,
+      _al_store_release, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC value),
+   {
+      OSMemoryBarrier();
+      *ptr = value;
+   })
+
 
 #else
 
@@ -113,6 +218,22 @@
       return --(*ptr);
    })
 
+   AL_INLINE(void, _al_memory_barrier, (void),
+   {
+   })
+
+   AL_INLINE(_AL_ATOMIC,
+      _al_load_acquire, (volatile _AL_ATOMIC *ptr),
+   {
+      return *ptr;
+   })
+
+   AL_INLINE(void,
+      _al_store_release, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC value),
+   {
+      *ptr = value;
+   })
+
 #endif
 
 #endif
@@ -7,7 +7,7 @@
 #include "allegro5/render_state.h"
 #include "allegro5/transformations.h"
 #include "allegro5/internal/aintern_display.h"
-#include "allegro5/internal/aintern_list.h"
+#include "allegro5/internal/aintern_dtor.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -15,6 +15,9 @@ extern "C" {
 
 typedef struct ALLEGRO_BITMAP_INTERFACE ALLEGRO_BITMAP_INTERFACE;
 
+/* Only typedef'd in the unstable API. */
+struct ALLEGRO_BITMAP_READBACK;
+
 struct ALLEGRO_BITMAP
 {
    ALLEGRO_BITMAP_INTERFACE *vt;
@@ -67,6 +70,14 @@ struct ALLEGRO_BITMAP
     * lock_flags - flags the region was locked with
     * lock_data - the pointer to the real locked data (see above)
     * locked_region - a copy of the locked rectangle
+    *
+    * Video bitmaps keep these in the parent. Memory bitmaps keep them in the
+    * bitmap or sub-bitmap which was locked, with lock_x/y in the coordinates
+    * of the parent, so that disjoint regions of one parent can be locked
+    * through different sub-bitmaps at the same time, by different threads.
+    * The parent links the locked ones through next_region_lock, see
+    * bitmap_lock.c, and lock_readers counts the threads sharing a read-only
+    * lock.
     */
    bool locked;
    int lock_x;
@@ -76,6 +87,9 @@ struct ALLEGRO_BITMAP
    void* lock_data;
    int lock_flags;
    ALLEGRO_LOCKED_REGION locked_region;
+   ALLEGRO_BITMAP *region_locks;
+   ALLEGRO_BITMAP *next_region_lock;
+   int lock_readers;
 
    /* Transformation for this bitmap */
    ALLEGRO_TRANSFORM transform;
@@ -103,12 +117,43 @@ struct ALLEGRO_BITMAP
    /* Extra data for display bitmaps, like texture id and so on. */
    void *extra;
 
-   _AL_LIST_ITEM *dtor_item;
+   _AL_DTOR_ITEM *dtor_item;
 
    /* set_target_bitmap and lock_bitmap mark bitmaps as dirty for preservation */
    bool dirty;
+
+   /* For the display's texture budget: the display's texture_frame when the
+    * bitmap was last drawn or targeted, and whether it was turned into a
+    * memory bitmap to stay within the budget. See bitmap_type.c.
+    */
+   int last_use_frame;
+   bool evicted;
+
+   /* The bounding rectangle of what was drawn since the damage was last
+    * reset, if tracked. Drawing to sub-bitmaps is added to their parent.
+    * See bitmap_damage.c.
+    */
+   bool track_damage;
+   bool damaged;
+   int damage_x1, damage_y1;
+   int damage_x2, damage_y2;  /* exclusive */
+
+   /* Pixels of this color are skipped when the bitmap is drawn with a
+    * translation only to a memory bitmap. Set on the parent only.
+    */
+   bool use_color_key;
+   ALLEGRO_COLOR color_key;
 };
 
+/* A source region of a bitmap and where to draw it, for
+ * _al_draw_tinted_bitmap_regions.
+ */
+typedef struct _AL_BITMAP_REGION
+{
+   float sx, sy, sw, sh;
+   float dx, dy;
+} _AL_BITMAP_REGION;
+
 struct ALLEGRO_BITMAP_INTERFACE
 {
    int id;
@@ -117,6 +162,14 @@ struct ALLEGRO_BITMAP_INTERFACE
       ALLEGRO_COLOR tint,float sx, float sy,
       float sw, float sh, int flags);
 
+   /* Draws many regions of the bitmap with the current transformation in
+    * one go. The regions are already checked to lie inside the bitmap.
+    * Returns false if the driver can't, the regions are then drawn one by
+    * one with draw_bitmap_region. May be NULL.
+    */
+   bool (*draw_bitmap_regions)(ALLEGRO_BITMAP *bitmap,
+      ALLEGRO_COLOR tint, const _AL_BITMAP_REGION *regions, int count);
+
    /* After the memory-copy of the bitmap has been modified, need to call this
     * to update the display-specific copy. E.g. with an OpenGL driver, this
     * might create/update a texture. Returns false on failure.
@@ -142,6 +195,65 @@ struct ALLEGRO_BITMAP_INTERFACE
 
    /* Back up texture to system RAM */
    void (*backup_dirty_bitmap)(ALLEGRO_BITMAP *bitmap);
+
+   /* Tells the driver the current contents of the bitmap are not needed
+    * anymore, see al_discard_bitmap_contents. May be NULL.
+    */
+   void (*discard_contents)(ALLEGRO_BITMAP *bitmap);
+
+   /* Replaces a mipmap level of the texture, see _al_upload_bitmap_mipmap.
+    * Returns false if the driver can't. May be NULL.
+    */
+   bool (*upload_mipmap)(ALLEGRO_BITMAP *bitmap, int level,
+      const void *data, int pitch);
+
+   /* Starts copying a region of the bitmap into memory owned by the driver
+    * without waiting for the GPU, see al_read_bitmap_region_async. Fills in
+    * the vt, extra and native format of the readback. Returns false if the
+    * driver can't, the region is then copied synchronously. May be NULL.
+    */
+   bool (*start_readback)(ALLEGRO_BITMAP *bitmap,
+      struct ALLEGRO_BITMAP_READBACK *rb, int x, int y, int w, int h);
+
+   /* Resolves the multisample buffer of the bitmap into the bitmap, see
+    * al_resolve_bitmap. Returns false on failure. May be NULL.
+    */
+   bool (*resolve_bitmap)(ALLEGRO_BITMAP *bitmap);
+};
+
+typedef struct _AL_READBACK_INTERFACE _AL_READBACK_INTERFACE;
+
+struct _AL_READBACK_INTERFACE
+{
+   /* Returns true if map would not have to wait for the GPU. */
+   bool (*is_ready)(struct ALLEGRO_BITMAP_READBACK *rb);
+   /* Waits for the copy to finish and fills in rb->native. */
+   bool (*map)(struct ALLEGRO_BITMAP_READBACK *rb);
+   void (*unmap)(struct ALLEGRO_BITMAP_READBACK *rb);
+   void (*destroy)(struct ALLEGRO_BITMAP_READBACK *rb);
+};
+
+struct ALLEGRO_BITMAP_READBACK
+{
+   /* NULL if the region was copied synchronously into buffer. */
+   const _AL_READBACK_INTERFACE *vt;
+   void *extra;
+
+   ALLEGRO_DISPLAY *display;
+   int w, h;
+   /* The requested format, or ALLEGRO_PIXEL_FORMAT_ANY for the native one. */
+   int format;
+
+   /* The pixels as the driver has them, and as returned to the user.  If the
+    * formats differ, the pixels are converted once into converted.
+    */
+   ALLEGRO_LOCKED_REGION native;
+   ALLEGRO_LOCKED_REGION region;
+   void *buffer;
+   void *converted;
+   bool mapped;
+
+   _AL_DTOR_ITEM *dtor_item;
 };
 
 ALLEGRO_BITMAP *_al_create_bitmap_params(ALLEGRO_DISPLAY *current_display,
@@ -149,34 +261,93 @@ ALLEGRO_BITMAP *_al_create_bitmap_params(ALLEGRO_DISPLAY *current_display,
 
 AL_FUNC(ALLEGRO_DISPLAY*, _al_get_bitmap_display, (ALLEGRO_BITMAP *bitmap));
 
+AL_FUNC(void, _al_draw_tinted_bitmap_regions, (ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_COLOR tint, const _AL_BITMAP_REGION *regions, int count));
+
+AL_FUNC(bool, _al_upload_bitmap_mipmap, (ALLEGRO_BITMAP *bitmap, int level,
+   const void *data, int pitch));
+
 extern void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
    [ALLEGRO_NUM_PIXEL_FORMATS])(const void *, int, void *, int,
    int, int, int, int, int, int);
 
+/* Memory bitmaps created with ALLEGRO_TILED_BITMAP keep their pixels in
+ * square tiles, each stored row by row, one row of tiles after the other.
+ * Their pitch is the size of a row of tiles. Locking copies the pixels to
+ * or from a linear buffer, see bitmap_lock.c.
+ */
+#define _AL_TILE_SHIFT  3
+#define _AL_TILE_SIZE   (1 << _AL_TILE_SHIFT)
+#define _AL_TILE_MASK   (_AL_TILE_SIZE - 1)
+
+#define _AL_TILED_OFFSET(pitch, pixel_size, x, y)                       \
+   (((y) >> _AL_TILE_SHIFT) * (pitch) +                                 \
+    ((((x) >> _AL_TILE_SHIFT) << (2 * _AL_TILE_SHIFT)) +                \
+     (((y) & _AL_TILE_MASK) << _AL_TILE_SHIFT) + ((x) & _AL_TILE_MASK)) \
+    * (pixel_size))
+
+bool _al_bitmap_is_tiled(ALLEGRO_BITMAP *bitmap);
+
+/* Locking */
+#define _AL_LOCK_HOLDER(bitmap) \
+   ((bitmap)->parent && !(bitmap)->locked ? (bitmap)->parent : (bitmap))
+
+void _al_init_region_locks(void);
+AL_FUNC(ALLEGRO_LOCKED_REGION *, _al_lock_bitmap_region, (
+   ALLEGRO_BITMAP *bitmap, int x, int y, int width, int height,
+   int format, int flags, bool damage));
+
+/* Damage tracking */
+#define _AL_TRACKS_DAMAGE(bitmap) \
+   ((bitmap)->parent ? (bitmap)->parent->track_damage : (bitmap)->track_damage)
+
+AL_FUNC(void, _al_damage_bitmap, (ALLEGRO_BITMAP *bitmap,
+   int x1, int y1, int x2, int y2));
+AL_FUNC(void, _al_damage_target, (ALLEGRO_BITMAP *target,
+   const ALLEGRO_TRANSFORM *trans, float x1, float y1, float x2, float y2));
+AL_FUNC(void, _al_damage_clipping_rectangle, (ALLEGRO_BITMAP *target));
+AL_FUNC(ALLEGRO_LOCKED_REGION *, _al_lock_drawn_region, (ALLEGRO_BITMAP *bitmap,
+   int x, int y, int width, int height));
+
 /* Bitmap conversion */
-void _al_convert_bitmap_data(
+AL_FUNC(void, _al_convert_bitmap_data, (
 	const void *src, int src_format, int src_pitch,
 	void *dst, int dst_format, int dst_pitch,
 	int sx, int sy, int dx, int dy,
-	int width, int height);
+	int width, int height));
+
+void _al_parallel_convert_bitmap_data(
+   const void *src, int src_format, int src_pitch,
+   void *dst, int dst_format, int dst_pitch,
+   int sx, int sy, int dx, int dy,
+   int width, int height);
 
 void _al_copy_bitmap_data(
    const void *src, int src_pitch, void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height,
    int format);
 
+AL_FUNC(void, _al_premultiply_alpha, (void *data, int format, int pitch,
+   int width, int height));
+AL_FUNC(void, _al_unpremultiply_alpha, (void *data, int format, int pitch,
+   int width, int height));
+
 /* Bitmap type conversion */ 
 void _al_init_convert_bitmap_list(void);
 void _al_register_convert_bitmap(ALLEGRO_BITMAP *bitmap);
 void _al_unregister_convert_bitmap(ALLEGRO_BITMAP *bitmap);
 void _al_convert_to_display_bitmap(ALLEGRO_BITMAP *bitmap);
 void _al_convert_to_memory_bitmap(ALLEGRO_BITMAP *bitmap);
+AL_FUNC(void, _al_mark_bitmap_used, (ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_DISPLAY *display));
+void _al_enforce_texture_budget(ALLEGRO_DISPLAY *display);
 
 /* Simple bitmap drawing */
 void _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color);
 
 /* Bitmap I/O */
 void _al_init_iio_table(void);
+void _al_init_async_bitmap_loading(void);
 
 
 int _al_get_bitmap_memory_format(ALLEGRO_BITMAP *bitmap);
@@ -246,6 +246,33 @@ void _al_blend_memory(ALLEGRO_COLOR *src_color, ALLEGRO_BITMAP *dest,
    int dx, int dy, ALLEGRO_COLOR *result);
 
 
+/* Maximum number of pixels the scanline drawers pass to a span blender
+ * at once.
+ */
+#define _AL_BLEND_SPAN_SIZE 64
+
+typedef struct _AL_SPAN_BLENDER _AL_SPAN_BLENDER;
+
+/* A blend equation resolved once per draw call. blend_span blends the n
+ * colors in src onto the n colors in dst and stores the result in dst.
+ */
+struct _AL_SPAN_BLENDER {
+   int op, src_mode, dst_mode;
+   int op_alpha, src_alpha, dst_alpha;
+   ALLEGRO_COLOR const_color;
+   /* Only used if none of the factors depend on the pixels. */
+   ALLEGRO_COLOR src_factor;
+   ALLEGRO_COLOR dst_factor;
+   void (*blend_span)(const _AL_SPAN_BLENDER *blender,
+      const ALLEGRO_COLOR *src, ALLEGRO_COLOR *dst, int n);
+};
+
+void _al_init_span_blender(_AL_SPAN_BLENDER *blender,
+   int op, int src_mode, int dst_mode,
+   int op_alpha, int src_alpha, int dst_alpha,
+   const ALLEGRO_COLOR *const_color);
+
+
 #ifdef __cplusplus
    }
 #endif
@@ -1,29 +1,54 @@
 #ifndef __al_included_allegro5_aintern_config_h
 #define __al_included_allegro5_aintern_config_h
 
-#include "allegro5/internal/aintern_aatree.h"
+typedef struct _AL_CONFIG_NODE _AL_CONFIG_NODE;
+
+/* Common head of sections and entries, for the hash tables. */
+struct _AL_CONFIG_NODE {
+   const ALLEGRO_USTR *name;
+   uint32_t hash;
+   _AL_CONFIG_NODE *hash_next;
+};
+
+/* Chained hash table; num_buckets is 0 or a power of two. */
+typedef struct _AL_CONFIG_TABLE {
+   _AL_CONFIG_NODE **buckets;
+   unsigned num_buckets;
+   unsigned count;
+} _AL_CONFIG_TABLE;
 
 struct ALLEGRO_CONFIG_ENTRY {
+   _AL_CONFIG_NODE node; /* must be first; not hashed if is_comment */
    bool is_comment;
    ALLEGRO_USTR *key;    /* comment if is_comment is true */
    ALLEGRO_USTR *value;
    ALLEGRO_CONFIG_ENTRY *prev, *next;
+   /* If set, the entry and its key resp. value live in the config's arena. */
+   bool in_arena;
+   bool value_in_arena;
 };
 
 struct ALLEGRO_CONFIG_SECTION {
+   _AL_CONFIG_NODE node; /* must be first */
    ALLEGRO_USTR *name;
    ALLEGRO_CONFIG_ENTRY *head;
    ALLEGRO_CONFIG_ENTRY *last;
-   _AL_AATREE *tree;
+   _AL_CONFIG_TABLE entries;
    ALLEGRO_CONFIG_SECTION *prev, *next;
+   bool in_arena;        /* The section and its name live in the arena. */
 };
 
 struct ALLEGRO_CONFIG {
    ALLEGRO_CONFIG_SECTION *head;
    ALLEGRO_CONFIG_SECTION *last;
-   _AL_AATREE *tree;
+   _AL_CONFIG_TABLE sections;
+   /* Blocks filled by al_load_config_file_f, each starting with a pointer
+    * to the next one.
+    */
+   void *arena;
+   /* Made by al_freeze_config: everything lives in this one allocation. */
+   bool frozen;
 };
 
 
 #endif
-
@@ -78,6 +78,12 @@
     (((x) & 0x00f00000) >>  8)        /* R */)   
 #define ALLEGRO_CONVERT_ARGB_8888_TO_SINGLE_CHANNEL_8(x) \
    (((x) >> 16) & 0xff)
+#define ALLEGRO_CONVERT_ARGB_8888_TO_ARGB_8888_SRGB(x) \
+   (((x) & 0xffffffff)              /* ABGR */)   
+#define ALLEGRO_CONVERT_ARGB_8888_TO_ABGR_8888_SRGB(x) \
+   ((((x) & 0x000000ff) << 16)        /* B */ | \
+    (((x) & 0x00ff0000) >> 16)        /* R */ | \
+    ((x) & 0xff00ff00)              /* AG */)   
 #define ALLEGRO_CONVERT_RGBA_8888_TO_ARGB_8888(x) \
    ((((x) & 0x000000ff) << 24)        /* A */ | \
     (((x) & 0xffffff00) >>  8)        /* BGR */)   
@@ -153,6 +159,14 @@
     (((x) & 0xf0000000) >> 16)        /* R */)   
 #define ALLEGRO_CONVERT_RGBA_8888_TO_SINGLE_CHANNEL_8(x) \
    (((x) >> 24) & 0xff)
+#define ALLEGRO_CONVERT_RGBA_8888_TO_ARGB_8888_SRGB(x) \
+   ((((x) & 0x000000ff) << 24)        /* A */ | \
+    (((x) & 0xffffff00) >>  8)        /* BGR */)   
+#define ALLEGRO_CONVERT_RGBA_8888_TO_ABGR_8888_SRGB(x) \
+   ((((x) & 0x000000ff) << 24)        /* A */ | \
+    (((x) & 0x0000ff00) <<  8)        /* B */ | \
+    (((x) & 0x00ff0000) >>  8)        /* G */ | \
+    (((x) & 0xff000000) >> 24)        /* R */)   
 #define ALLEGRO_CONVERT_ARGB_4444_TO_ARGB_8888(x) \
    ((_al_rgb_scale_4[((x) & 0xf000) >> 12] << 24) /* A */ | \
     (_al_rgb_scale_4[((x) & 0x000f) >>  0]       ) /* B */ | \
@@ -237,6 +251,16 @@
     (((x) & 0x0fff) <<  4)        /* BGR */)   
 #define ALLEGRO_CONVERT_ARGB_4444_TO_SINGLE_CHANNEL_8(x) \
    (_al_rgb_scale_4[(((x) >> 8) & 0xf)])
+#define ALLEGRO_CONVERT_ARGB_4444_TO_ARGB_8888_SRGB(x) \
+   ((_al_rgb_scale_4[((x) & 0xf000) >> 12] << 24) /* A */ | \
+    (_al_rgb_scale_4[((x) & 0x000f) >>  0]       ) /* B */ | \
+    (_al_rgb_scale_4[((x) & 0x00f0) >>  4] <<  8) /* G */ | \
+    (_al_rgb_scale_4[((x) & 0x0f00) >>  8] << 16) /* R */)   
+#define ALLEGRO_CONVERT_ARGB_4444_TO_ABGR_8888_SRGB(x) \
+   ((_al_rgb_scale_4[((x) & 0xf000) >> 12] << 24) /* A */ | \
+    (_al_rgb_scale_4[((x) & 0x000f) >>  0] << 16) /* B */ | \
+    (_al_rgb_scale_4[((x) & 0x00f0) >>  4] <<  8) /* G */ | \
+    (_al_rgb_scale_4[((x) & 0x0f00) >>  8]       ) /* R */)   
 #define ALLEGRO_CONVERT_RGB_888_TO_ARGB_8888(x) \
    ((0xff000000)        /* A */ | \
     ((x) & 0xffffff)              /* BGR */)   
@@ -313,6 +337,14 @@
     (((x) & 0xf00000) >>  8)        /* R */)   
 #define ALLEGRO_CONVERT_RGB_888_TO_SINGLE_CHANNEL_8(x) \
    (((x) >> 16) & 0xff)
+#define ALLEGRO_CONVERT_RGB_888_TO_ARGB_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    ((x) & 0xffffff)              /* BGR */)   
+#define ALLEGRO_CONVERT_RGB_888_TO_ABGR_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (((x) & 0x0000ff) << 16)        /* B */ | \
+    ((x) & 0x00ff00)              /* G */ | \
+    (((x) & 0xff0000) >> 16)        /* R */)   
 #define ALLEGRO_CONVERT_RGB_565_TO_ARGB_8888(x) \
    ((0xff000000)        /* A */ | \
     (_al_rgb_scale_5[((x) & 0x001f) >>  0]       ) /* B */ | \
@@ -396,6 +428,16 @@
     ((x) & 0xf000)              /* R */)   
 #define ALLEGRO_CONVERT_RGB_565_TO_SINGLE_CHANNEL_8(x) \
    (_al_rgb_scale_5[(((x) >> 11) & 0x1f)])
+#define ALLEGRO_CONVERT_RGB_565_TO_ARGB_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (_al_rgb_scale_5[((x) & 0x001f) >>  0]       ) /* B */ | \
+    (_al_rgb_scale_6[((x) & 0x07e0) >>  5] <<  8) /* G */ | \
+    (_al_rgb_scale_5[((x) & 0xf800) >> 11] << 16) /* R */)   
+#define ALLEGRO_CONVERT_RGB_565_TO_ABGR_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (_al_rgb_scale_5[((x) & 0x001f) >>  0] << 16) /* B */ | \
+    (_al_rgb_scale_6[((x) & 0x07e0) >>  5] <<  8) /* G */ | \
+    (_al_rgb_scale_5[((x) & 0xf800) >> 11]       ) /* R */)   
 #define ALLEGRO_CONVERT_RGB_555_TO_ARGB_8888(x) \
    ((0xff000000)        /* A */ | \
     (_al_rgb_scale_5[((x) & 0x01f) >>  0]       ) /* B */ | \
@@ -477,6 +519,16 @@
     (((x) & 0x7800) <<  1)        /* R */)   
 #define ALLEGRO_CONVERT_RGB_555_TO_SINGLE_CHANNEL_8(x) \
    (_al_rgb_scale_5[(((x) >> 10) & 0x1f)])
+#define ALLEGRO_CONVERT_RGB_555_TO_ARGB_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (_al_rgb_scale_5[((x) & 0x01f) >>  0]       ) /* B */ | \
+    (_al_rgb_scale_5[((x) & 0x3e0) >>  5] <<  8) /* G */ | \
+    (_al_rgb_scale_5[((x) & 0x7c00) >> 10] << 16) /* R */)   
+#define ALLEGRO_CONVERT_RGB_555_TO_ABGR_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (_al_rgb_scale_5[((x) & 0x01f) >>  0] << 16) /* B */ | \
+    (_al_rgb_scale_5[((x) & 0x3e0) >>  5] <<  8) /* G */ | \
+    (_al_rgb_scale_5[((x) & 0x7c00) >> 10]       ) /* R */)   
 #define ALLEGRO_CONVERT_RGBA_5551_TO_ARGB_8888(x) \
    ((_al_rgb_scale_1[((x) & 0x0001) >>  0] << 24) /* A */ | \
     (_al_rgb_scale_5[((x) & 0x003e) >>  1]       ) /* B */ | \
@@ -558,6 +610,16 @@
     ((x) & 0xf000)              /* R */)   
 #define ALLEGRO_CONVERT_RGBA_5551_TO_SINGLE_CHANNEL_8(x) \
    (_al_rgb_scale_5[(((x) >> 11) & 0x1f)])
+#define ALLEGRO_CONVERT_RGBA_5551_TO_ARGB_8888_SRGB(x) \
+   ((_al_rgb_scale_1[((x) & 0x0001) >>  0] << 24) /* A */ | \
+    (_al_rgb_scale_5[((x) & 0x003e) >>  1]       ) /* B */ | \
+    (_al_rgb_scale_5[((x) & 0x07c0) >>  6] <<  8) /* G */ | \
+    (_al_rgb_scale_5[((x) & 0xf800) >> 11] << 16) /* R */)   
+#define ALLEGRO_CONVERT_RGBA_5551_TO_ABGR_8888_SRGB(x) \
+   ((_al_rgb_scale_1[((x) & 0x0001) >>  0] << 24) /* A */ | \
+    (_al_rgb_scale_5[((x) & 0x003e) >>  1] << 16) /* B */ | \
+    (_al_rgb_scale_5[((x) & 0x07c0) >>  6] <<  8) /* G */ | \
+    (_al_rgb_scale_5[((x) & 0xf800) >> 11]       ) /* R */)   
 #define ALLEGRO_CONVERT_ARGB_1555_TO_ARGB_8888(x) \
    ((_al_rgb_scale_1[((x) & 0x8000) >> 15] << 24) /* A */ | \
     (_al_rgb_scale_5[((x) & 0x001f) >>  0]       ) /* B */ | \
@@ -639,6 +701,16 @@
     (((x) & 0x7800) <<  1)        /* R */)   
 #define ALLEGRO_CONVERT_ARGB_1555_TO_SINGLE_CHANNEL_8(x) \
    (_al_rgb_scale_5[(((x) >> 10) & 0x1f)])
+#define ALLEGRO_CONVERT_ARGB_1555_TO_ARGB_8888_SRGB(x) \
+   ((_al_rgb_scale_1[((x) & 0x8000) >> 15] << 24) /* A */ | \
+    (_al_rgb_scale_5[((x) & 0x001f) >>  0]       ) /* B */ | \
+    (_al_rgb_scale_5[((x) & 0x03e0) >>  5] <<  8) /* G */ | \
+    (_al_rgb_scale_5[((x) & 0x7c00) >> 10] << 16) /* R */)   
+#define ALLEGRO_CONVERT_ARGB_1555_TO_ABGR_8888_SRGB(x) \
+   ((_al_rgb_scale_1[((x) & 0x8000) >> 15] << 24) /* A */ | \
+    (_al_rgb_scale_5[((x) & 0x001f) >>  0] << 16) /* B */ | \
+    (_al_rgb_scale_5[((x) & 0x03e0) >>  5] <<  8) /* G */ | \
+    (_al_rgb_scale_5[((x) & 0x7c00) >> 10]       ) /* R */)   
 #define ALLEGRO_CONVERT_ABGR_8888_TO_ARGB_8888(x) \
    ((((x) & 0x00ff0000) >> 16)        /* B */ | \
     (((x) & 0x000000ff) << 16)        /* R */ | \
@@ -717,6 +789,12 @@
     (((x) & 0x000000f0) <<  8)        /* R */)   
 #define ALLEGRO_CONVERT_ABGR_8888_TO_SINGLE_CHANNEL_8(x) \
    (((x) >> 0) & 0xff)
+#define ALLEGRO_CONVERT_ABGR_8888_TO_ARGB_8888_SRGB(x) \
+   ((((x) & 0x00ff0000) >> 16)        /* B */ | \
+    (((x) & 0x000000ff) << 16)        /* R */ | \
+    ((x) & 0xff00ff00)              /* AG */)   
+#define ALLEGRO_CONVERT_ABGR_8888_TO_ABGR_8888_SRGB(x) \
+   (((x) & 0xffffffff)              /* ABGR */)   
 #define ALLEGRO_CONVERT_XBGR_8888_TO_ARGB_8888(x) \
    ((0xff000000)        /* A */ | \
     (((x) & 0x00ff0000) >> 16)        /* B */ | \
@@ -797,6 +875,14 @@
     (((x) & 0x000000f0) <<  8)        /* R */)   
 #define ALLEGRO_CONVERT_XBGR_8888_TO_SINGLE_CHANNEL_8(x) \
    (((x) >> 0) & 0xff)
+#define ALLEGRO_CONVERT_XBGR_8888_TO_ARGB_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (((x) & 0x00ff0000) >> 16)        /* B */ | \
+    ((x) & 0x0000ff00)              /* G */ | \
+    (((x) & 0x000000ff) << 16)        /* R */)   
+#define ALLEGRO_CONVERT_XBGR_8888_TO_ABGR_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    ((x) & 0x00ffffff)              /* BGR */)   
 #define ALLEGRO_CONVERT_BGR_888_TO_ARGB_8888(x) \
    ((0xff000000)        /* A */ | \
     (((x) & 0xff0000) >> 16)        /* B */ | \
@@ -877,6 +963,14 @@
     (((x) & 0x0000f0) <<  8)        /* R */)   
 #define ALLEGRO_CONVERT_BGR_888_TO_SINGLE_CHANNEL_8(x) \
    (((x) >> 0) & 0xff)
+#define ALLEGRO_CONVERT_BGR_888_TO_ARGB_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (((x) & 0xff0000) >> 16)        /* B */ | \
+    ((x) & 0x00ff00)              /* G */ | \
+    (((x) & 0x0000ff) << 16)        /* R */)   
+#define ALLEGRO_CONVERT_BGR_888_TO_ABGR_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    ((x) & 0xffffff)              /* BGR */)   
 #define ALLEGRO_CONVERT_BGR_565_TO_ARGB_8888(x) \
    ((0xff000000)        /* A */ | \
     (_al_rgb_scale_5[((x) & 0xf800) >> 11]       ) /* B */ | \
@@ -962,6 +1056,16 @@
     (((x) & 0x001e) << 11)        /* R */)   
 #define ALLEGRO_CONVERT_BGR_565_TO_SINGLE_CHANNEL_8(x) \
    (_al_rgb_scale_5[(((x) >> 0) & 0x1f)])
+#define ALLEGRO_CONVERT_BGR_565_TO_ARGB_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (_al_rgb_scale_5[((x) & 0xf800) >> 11]       ) /* B */ | \
+    (_al_rgb_scale_6[((x) & 0x07e0) >>  5] <<  8) /* G */ | \
+    (_al_rgb_scale_5[((x) & 0x001f) >>  0] << 16) /* R */)   
+#define ALLEGRO_CONVERT_BGR_565_TO_ABGR_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (_al_rgb_scale_5[((x) & 0xf800) >> 11] << 16) /* B */ | \
+    (_al_rgb_scale_6[((x) & 0x07e0) >>  5] <<  8) /* G */ | \
+    (_al_rgb_scale_5[((x) & 0x001f) >>  0]       ) /* R */)   
 #define ALLEGRO_CONVERT_BGR_555_TO_ARGB_8888(x) \
    ((0xff000000)        /* A */ | \
     (_al_rgb_scale_5[((x) & 0x7c00) >> 10]       ) /* B */ | \
@@ -1047,6 +1151,16 @@
     (((x) & 0x01e) << 11)        /* R */)   
 #define ALLEGRO_CONVERT_BGR_555_TO_SINGLE_CHANNEL_8(x) \
    (_al_rgb_scale_5[(((x) >> 0) & 0x1f)])
+#define ALLEGRO_CONVERT_BGR_555_TO_ARGB_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (_al_rgb_scale_5[((x) & 0x7c00) >> 10]       ) /* B */ | \
+    (_al_rgb_scale_5[((x) & 0x3e0) >>  5] <<  8) /* G */ | \
+    (_al_rgb_scale_5[((x) & 0x01f) >>  0] << 16) /* R */)   
+#define ALLEGRO_CONVERT_BGR_555_TO_ABGR_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (_al_rgb_scale_5[((x) & 0x7c00) >> 10] << 16) /* B */ | \
+    (_al_rgb_scale_5[((x) & 0x3e0) >>  5] <<  8) /* G */ | \
+    (_al_rgb_scale_5[((x) & 0x01f) >>  0]       ) /* R */)   
 #define ALLEGRO_CONVERT_RGBX_8888_TO_ARGB_8888(x) \
    ((0xff000000)        /* A */ | \
     (((x) & 0xffffff00) >>  8)        /* BGR */)   
@@ -1123,6 +1237,14 @@
     (((x) & 0xf0000000) >> 16)        /* R */)   
 #define ALLEGRO_CONVERT_RGBX_8888_TO_SINGLE_CHANNEL_8(x) \
    (((x) >> 24) & 0xff)
+#define ALLEGRO_CONVERT_RGBX_8888_TO_ARGB_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (((x) & 0xffffff00) >>  8)        /* BGR */)   
+#define ALLEGRO_CONVERT_RGBX_8888_TO_ABGR_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (((x) & 0x0000ff00) <<  8)        /* B */ | \
+    (((x) & 0x00ff0000) >>  8)        /* G */ | \
+    (((x) & 0xff000000) >> 24)        /* R */)   
 #define ALLEGRO_CONVERT_XRGB_8888_TO_ARGB_8888(x) \
    ((0xff000000)        /* A */ | \
     ((x) & 0x00ffffff)              /* BGR */)   
@@ -1199,6 +1321,14 @@
     (((x) & 0x00f00000) >>  8)        /* R */)   
 #define ALLEGRO_CONVERT_XRGB_8888_TO_SINGLE_CHANNEL_8(x) \
    (((x) >> 16) & 0xff)
+#define ALLEGRO_CONVERT_XRGB_8888_TO_ARGB_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    ((x) & 0x00ffffff)              /* BGR */)   
+#define ALLEGRO_CONVERT_XRGB_8888_TO_ABGR_8888_SRGB(x) \
+   ((0xff000000)        /* A */ | \
+    (((x) & 0x000000ff) << 16)        /* B */ | \
+    ((x) & 0x0000ff00)              /* G */ | \
+    (((x) & 0x00ff0000) >> 16)        /* R */)   
 #define ALLEGRO_CONVERT_ABGR_F32_TO_ARGB_8888(x) \
    (((uint32_t)((x).a * 255) << 24) | \
     ((uint32_t)((x).b * 255) << 0) | \
@@ -1285,6 +1415,16 @@
     ((uint32_t)((x).r * 15) << 12))
 #define ALLEGRO_CONVERT_ABGR_F32_TO_SINGLE_CHANNEL_8(x) \
    (uint32_t)((x).r * 255)
+#define ALLEGRO_CONVERT_ABGR_F32_TO_ARGB_8888_SRGB(x) \
+   (((uint32_t)((x).a * 255) << 24) | \
+    ((uint32_t)((x).b * 255) << 0) | \
+    ((uint32_t)((x).g * 255) << 8) | \
+    ((uint32_t)((x).r * 255) << 16))
+#define ALLEGRO_CONVERT_ABGR_F32_TO_ABGR_8888_SRGB(x) \
+   (((uint32_t)((x).a * 255) << 24) | \
+    ((uint32_t)((x).b * 255) << 16) | \
+    ((uint32_t)((x).g * 255) << 8) | \
+    ((uint32_t)((x).r * 255) << 0))
 #ifdef ALLEGRO_BIG_ENDIAN
 #define ALLEGRO_CONVERT_ABGR_8888_LE_TO_ARGB_8888(x) \
    ((((x) & 0x000000ff) << 24)        /* A */ | \
@@ -1476,6 +1616,26 @@
 #define ALLEGRO_CONVERT_ABGR_8888_LE_TO_SINGLE_CHANNEL_8(x) \
    (((x) >> 0) & 0xff)
 #endif
+#ifdef ALLEGRO_BIG_ENDIAN
+#define ALLEGRO_CONVERT_ABGR_8888_LE_TO_ARGB_8888_SRGB(x) \
+   ((((x) & 0x000000ff) << 24)        /* A */ | \
+    (((x) & 0xffffff00) >>  8)        /* BGR */)   
+#else
+#define ALLEGRO_CONVERT_ABGR_8888_LE_TO_ARGB_8888_SRGB(x) \
+   ((((x) & 0x00ff0000) >> 16)        /* B */ | \
+    (((x) & 0x000000ff) << 16)        /* R */ | \
+    ((x) & 0xff00ff00)              /* AG */)   
+#endif
+#ifdef ALLEGRO_BIG_ENDIAN
+#define ALLEGRO_CONVERT_ABGR_8888_LE_TO_ABGR_8888_SRGB(x) \
+   ((((x) & 0x000000ff) << 24)        /* A */ | \
+    (((x) & 0x0000ff00) <<  8)        /* B */ | \
+    (((x) & 0x00ff0000) >>  8)        /* G */ | \
+    (((x) & 0xff000000) >> 24)        /* R */)   
+#else
+#define ALLEGRO_CONVERT_ABGR_8888_LE_TO_ABGR_8888_SRGB(x) \
+   (((x) & 0xffffffff)              /* ABGR */)   
+#endif
 #define ALLEGRO_CONVERT_RGBA_4444_TO_ARGB_8888(x) \
    ((_al_rgb_scale_4[((x) & 0x000f) >>  0] << 24) /* A */ | \
     (_al_rgb_scale_4[((x) & 0x00f0) >>  4]       ) /* B */ | \
@@ -1560,6 +1720,16 @@
 #endif
 #define ALLEGRO_CONVERT_RGBA_4444_TO_SINGLE_CHANNEL_8(x) \
    (_al_rgb_scale_4[(((x) >> 12) & 0xf)])
+#define ALLEGRO_CONVERT_RGBA_4444_TO_ARGB_8888_SRGB(x) \
+   ((_al_rgb_scale_4[((x) & 0x000f) >>  0] << 24) /* A */ | \
+    (_al_rgb_scale_4[((x) & 0x00f0) >>  4]       ) /* B */ | \
+    (_al_rgb_scale_4[((x) & 0x0f00) >>  8] <<  8) /* G */ | \
+    (_al_rgb_scale_4[((x) & 0xf000) >> 12] << 16) /* R */)   
+#define ALLEGRO_CONVERT_RGBA_4444_TO_ABGR_8888_SRGB(x) \
+   ((_al_rgb_scale_4[((x) & 0x000f) >>  0] << 24) /* A */ | \
+    (_al_rgb_scale_4[((x) & 0x00f0) >>  4] << 16) /* B */ | \
+    (_al_rgb_scale_4[((x) & 0x0f00) >>  8] <<  8) /* G */ | \
+    (_al_rgb_scale_4[((x) & 0xf000) >> 12]       ) /* R */)   
 #define ALLEGRO_CONVERT_SINGLE_CHANNEL_8_TO_ARGB_8888(x) \
    (0xff000000 | \
    (((x) << 16) & 0xff0000))
@@ -1610,5 +1780,175 @@
 #define ALLEGRO_CONVERT_SINGLE_CHANNEL_8_TO_RGBA_4444(x) \
    (0xf | \
    (((x) << 8) & 0xf000))
+#define ALLEGRO_CONVERT_SINGLE_CHANNEL_8_TO_ARGB_8888_SRGB(x) \
+   (0xff000000 | \
+   (((x) << 16) & 0xff0000))
+#define ALLEGRO_CONVERT_SINGLE_CHANNEL_8_TO_ABGR_8888_SRGB(x) \
+   (0xff000000 | \
+   ((x) & 0xff))
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ARGB_8888(x) \
+   (((x) & 0xffffffff)              /* ABGR */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGBA_8888(x) \
+   ((((x) & 0xff000000) >> 24)        /* A */ | \
+    (((x) & 0x00ffffff) <<  8)        /* BGR */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ARGB_4444(x) \
+   ((((x) & 0xf0000000) >> 16)        /* A */ | \
+    (((x) & 0x000000f0) >>  4)        /* B */ | \
+    (((x) & 0x0000f000) >>  8)        /* G */ | \
+    (((x) & 0x00f00000) >> 12)        /* R */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGB_888(x) \
+   (((x) & 0x00ffffff)              /* BGR */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGB_565(x) \
+   ((((x) & 0x000000f8) >>  3)        /* B */ | \
+    (((x) & 0x0000fc00) >>  5)        /* G */ | \
+    (((x) & 0x00f80000) >>  8)        /* R */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGB_555(x) \
+   ((((x) & 0x000000f8) >>  3)        /* B */ | \
+    (((x) & 0x0000f800) >>  6)        /* G */ | \
+    (((x) & 0x00f80000) >>  9)        /* R */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGBA_5551(x) \
+   ((((x) & 0x80000000) >> 31)        /* A */ | \
+    (((x) & 0x000000f8) >>  2)        /* B */ | \
+    (((x) & 0x0000f800) >>  5)        /* G */ | \
+    (((x) & 0x00f80000) >>  8)        /* R */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ARGB_1555(x) \
+   ((((x) & 0x80000000) >> 16)        /* A */ | \
+    (((x) & 0x000000f8) >>  3)        /* B */ | \
+    (((x) & 0x0000f800) >>  6)        /* G */ | \
+    (((x) & 0x00f80000) >>  9)        /* R */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ABGR_8888(x) \
+   ((((x) & 0x000000ff) << 16)        /* B */ | \
+    (((x) & 0x00ff0000) >> 16)        /* R */ | \
+    ((x) & 0xff00ff00)              /* AG */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_XBGR_8888(x) \
+   ((((x) & 0x000000ff) << 16)        /* B */ | \
+    ((x) & 0x0000ff00)              /* G */ | \
+    (((x) & 0x00ff0000) >> 16)        /* R */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_BGR_888(x) \
+   ((((x) & 0x000000ff) << 16)        /* B */ | \
+    ((x) & 0x0000ff00)              /* G */ | \
+    (((x) & 0x00ff0000) >> 16)        /* R */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_BGR_565(x) \
+   ((((x) & 0x000000f8) <<  8)        /* B */ | \
+    (((x) & 0x0000fc00) >>  5)        /* G */ | \
+    (((x) & 0x00f80000) >> 19)        /* R */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_BGR_555(x) \
+   ((((x) & 0x000000f8) <<  7)        /* B */ | \
+    (((x) & 0x0000f800) >>  6)        /* G */ | \
+    (((x) & 0x00f80000) >> 19)        /* R */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGBX_8888(x) \
+   ((((x) & 0x00ffffff) <<  8)        /* BGR */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_XRGB_8888(x) \
+   (((x) & 0x00ffffff)              /* BGR */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ABGR_F32(x) \
+   al_map_rgba(((x) >> 16) & 255,\
+   ((x) >> 8) & 255,\
+   ((x) >> 0) & 255,\
+   ((x) >> 24) & 255)
+#ifdef ALLEGRO_BIG_ENDIAN
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ABGR_8888_LE(x) \
+   ((((x) & 0xff000000) >> 24)        /* A */ | \
+    (((x) & 0x00ffffff) <<  8)        /* BGR */)   
+#else
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ABGR_8888_LE(x) \
+   ((((x) & 0x000000ff) << 16)        /* B */ | \
+    (((x) & 0x00ff0000) >> 16)        /* R */ | \
+    ((x) & 0xff00ff00)              /* AG */)   
+#endif
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGBA_4444(x) \
+   ((((x) & 0xf0000000) >> 28)        /* A */ | \
+    ((x) & 0x000000f0)              /* B */ | \
+    (((x) & 0x0000f000) >>  4)        /* G */ | \
+    (((x) & 0x00f00000) >>  8)        /* R */)   
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_SINGLE_CHANNEL_8(x) \
+   (((x) >> 16) & 0xff)
+#define ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ABGR_8888_SRGB(x) \
+   ((((x) & 0x000000ff) << 16)        /* B */ | \
+    (((x) & 0x00ff0000) >> 16)        /* R */ | \
+    ((x) & 0xff00ff00)              /* AG */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ARGB_8888(x) \
+   ((((x) & 0x00ff0000) >> 16)        /* B */ | \
+    (((x) & 0x000000ff) << 16)        /* R */ | \
+    ((x) & 0xff00ff00)              /* AG */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGBA_8888(x) \
+   ((((x) & 0xff000000) >> 24)        /* A */ | \
+    (((x) & 0x00ff0000) >>  8)        /* B */ | \
+    (((x) & 0x0000ff00) <<  8)        /* G */ | \
+    (((x) & 0x000000ff) << 24)        /* R */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ARGB_4444(x) \
+   ((((x) & 0xf0000000) >> 16)        /* A */ | \
+    (((x) & 0x00f00000) >> 20)        /* B */ | \
+    (((x) & 0x0000f000) >>  8)        /* G */ | \
+    (((x) & 0x000000f0) <<  4)        /* R */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGB_888(x) \
+   ((((x) & 0x00ff0000) >> 16)        /* B */ | \
+    ((x) & 0x0000ff00)              /* G */ | \
+    (((x) & 0x000000ff) << 16)        /* R */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGB_565(x) \
+   ((((x) & 0x00f80000) >> 19)        /* B */ | \
+    (((x) & 0x0000fc00) >>  5)        /* G */ | \
+    (((x) & 0x000000f8) <<  8)        /* R */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGB_555(x) \
+   ((((x) & 0x00f80000) >> 19)        /* B */ | \
+    (((x) & 0x0000f800) >>  6)        /* G */ | \
+    (((x) & 0x000000f8) <<  7)        /* R */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGBA_5551(x) \
+   ((((x) & 0x80000000) >> 31)        /* A */ | \
+    (((x) & 0x00f80000) >> 18)        /* B */ | \
+    (((x) & 0x0000f800) >>  5)        /* G */ | \
+    (((x) & 0x000000f8) <<  8)        /* R */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ARGB_1555(x) \
+   ((((x) & 0x80000000) >> 16)        /* A */ | \
+    (((x) & 0x00f80000) >> 19)        /* B */ | \
+    (((x) & 0x0000f800) >>  6)        /* G */ | \
+    (((x) & 0x000000f8) <<  7)        /* R */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ABGR_8888(x) \
+   (((x) & 0xffffffff)              /* ABGR */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_XBGR_8888(x) \
+   (((x) & 0x00ffffff)              /* BGR */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_BGR_888(x) \
+   (((x) & 0x00ffffff)              /* BGR */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_BGR_565(x) \
+   ((((x) & 0x00f80000) >>  8)        /* B */ | \
+    (((x) & 0x0000fc00) >>  5)        /* G */ | \
+    (((x) & 0x000000f8) >>  3)        /* R */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_BGR_555(x) \
+   ((((x) & 0x00f80000) >>  9)        /* B */ | \
+    (((x) & 0x0000f800) >>  6)        /* G */ | \
+    (((x) & 0x000000f8) >>  3)        /* R */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGBX_8888(x) \
+   ((((x) & 0x00ff0000) >>  8)        /* B */ | \
+    (((x) & 0x0000ff00) <<  8)        /* G */ | \
+    (((x) & 0x000000ff) << 24)        /* R */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_XRGB_8888(x) \
+   ((((x) & 0x00ff0000) >> 16)        /* B */ | \
+    ((x) & 0x0000ff00)              /* G */ | \
+    (((x) & 0x000000ff) << 16)        /* R */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ABGR_F32(x) \
+   al_map_rgba(((x) >> 0) & 255,\
+   ((x) >> 8) & 255,\
+   ((x) >> 16) & 255,\
+   ((x) >> 24) & 255)
+#ifdef ALLEGRO_BIG_ENDIAN
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ABGR_8888_LE(x) \
+   ((((x) & 0xff000000) >> 24)        /* A */ | \
+    (((x) & 0x00ff0000) >>  8)        /* B */ | \
+    (((x) & 0x0000ff00) <<  8)        /* G */ | \
+    (((x) & 0x000000ff) << 24)        /* R */)   
+#else
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ABGR_8888_LE(x) \
+   (((x) & 0xffffffff)              /* ABGR */)   
+#endif
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGBA_4444(x) \
+   ((((x) & 0xf0000000) >> 28)        /* A */ | \
+    (((x) & 0x00f00000) >> 16)        /* B */ | \
+    (((x) & 0x0000f000) >>  4)        /* G */ | \
+    (((x) & 0x000000f0) <<  8)        /* R */)   
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_SINGLE_CHANNEL_8(x) \
+   (((x) >> 0) & 0xff)
+#define ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ARGB_8888_SRGB(x) \
+   ((((x) & 0x00ff0000) >> 16)        /* B */ | \
+    (((x) & 0x000000ff) << 16)        /* R */ | \
+    ((x) & 0xff00ff00)              /* AG */)   
 #endif
 // Warning: This file was created by make_converters.py - do not edit.
@@ -0,0 +1,19 @@
+#ifndef __al_included_allegro5_aintern_cpu_h
+#define __al_included_allegro5_aintern_cpu_h
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+
+/* Replaces entries of _al_convert_funcs with vectorized versions. */
+void _al_init_convert_simd(void);
+
+
+#ifdef __cplusplus
+   }
+#endif
+
+#endif
+
+/* vim: set ts=8 sts=3 sw=3 et: */
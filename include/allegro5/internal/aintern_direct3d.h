@@ -20,6 +20,12 @@ typedef struct ALLEGRO_BITMAP_EXTRA_D3D
    LPDIRECT3DTEXTURE9 system_texture;
    int system_format;
 
+   /* Set for ALLEGRO_NO_PRESERVE_TEXTURE bitmaps: they have no copy of
+    * their pixels in bitmap->memory, and the system texture only exists
+    * while they are locked.
+    */
+   bool no_shadow;
+
    bool initialized;
    bool is_backbuffer;
 
@@ -32,6 +38,12 @@ typedef struct ALLEGRO_BITMAP_EXTRA_D3D
    bool dirty;
 } ALLEGRO_BITMAP_EXTRA_D3D;
 
+/* Number of frame timer queries in flight for al_get_display_stats. */
+#define _AL_D3D_GPU_TIMERS 4
+
+/* Size in bytes of the dynamic vertex buffer held drawing is flushed into. */
+#define _AL_D3D_VERTEX_BUFFER_SIZE (1024 * 1024)
+
 typedef struct ALLEGRO_DISPLAY_D3D
 {
    ALLEGRO_DISPLAY_WIN win_display; /* This must be the first member. */
@@ -54,6 +66,11 @@ typedef struct ALLEGRO_DISPLAY_D3D
    bool device_lost;
    bool suppress_lost_events;
 
+   /* Created with CreateDeviceEx. Such a device keeps its textures when it
+    * is occluded, so they are only backed up before an explicit reset.
+    */
+   bool device_ex;
+
    bool faux_fullscreen;
 
    bool supports_separate_alpha_blend;
@@ -78,6 +95,33 @@ typedef struct ALLEGRO_DISPLAY_D3D
 #ifdef ALLEGRO_CFG_SHADER_HLSL
    LPD3DXEFFECT effect;
 #endif
+
+   /* Timestamp queries for al_get_display_stats, used round-robin like
+    * the OpenGL ones. Released before the device is reset.
+    */
+   LPDIRECT3DQUERY9 timer_disjoint[_AL_D3D_GPU_TIMERS];
+   LPDIRECT3DQUERY9 timer_freq[_AL_D3D_GPU_TIMERS];
+   LPDIRECT3DQUERY9 timer_begin[_AL_D3D_GPU_TIMERS];
+   LPDIRECT3DQUERY9 timer_end[_AL_D3D_GPU_TIMERS];
+   int timer_next;
+   int timers_pending;
+   bool timer_running;
+   bool timer_unsupported;
+
+   /* Dynamic vertex buffer for d3d_flush_vertex_cache, filled front to back
+    * with D3DLOCK_NOOVERWRITE and discarded when full. In the default pool,
+    * so released before the device is reset.
+    */
+   LPDIRECT3DVERTEXBUFFER9 vertex_buffer;
+   int vertex_buffer_pos;
+
+   /* Event queries marking the end of each presented frame, used
+    * round-robin like the timers. Released before the device is reset.
+    */
+   LPDIRECT3DQUERY9 frame_fences[_AL_MAX_FRAME_LATENCY];
+   int frame_fence_next;
+   int frame_fences_pending;
+   bool frame_fences_unsupported;
 } ALLEGRO_DISPLAY_D3D;
 
 
@@ -100,11 +144,17 @@ void _al_d3d_update_render_state(ALLEGRO_DISPLAY *display);
       CONST D3DXMACRO*, LPD3DXINCLUDE, DWORD, LPD3DXEFFECTPOOL, LPD3DXEFFECT*,
       LPD3DXBUFFER*);
 
+   typedef HRESULT (WINAPI *_ALLEGRO_D3DXCREATEEFFECTCOMPILERPROC)(LPCSTR, UINT,
+      CONST D3DXMACRO*, LPD3DXINCLUDE, DWORD, LPD3DXEFFECTCOMPILER*,
+      LPD3DXBUFFER*);
+
    bool _al_load_d3dx9_module();
    void _al_unload_d3dx9_module();
 
    extern _ALLEGRO_D3DXLSFLSPROC _al_imp_D3DXLoadSurfaceFromSurface;
    extern _ALLEGRO_D3DXCREATEEFFECTPROC _al_imp_D3DXCreateEffect;
+   /* Optional, only used to fill the shader cache. */
+   extern _ALLEGRO_D3DXCREATEEFFECTCOMPILERPROC _al_imp_D3DXCreateEffectCompiler;
 #endif
 
 #ifdef __cplusplus
@@ -11,6 +11,11 @@
 extern "C" {
 #endif
 
+/* Upper limit for ALLEGRO_MAX_FRAME_LATENCY, the size of the frame fence
+ * rings of the drivers.
+ */
+#define _AL_MAX_FRAME_LATENCY 8
+
 typedef struct ALLEGRO_DISPLAY_INTERFACE ALLEGRO_DISPLAY_INTERFACE;
 
 struct ALLEGRO_DISPLAY_INTERFACE
@@ -25,6 +30,12 @@ struct ALLEGRO_DISPLAY_INTERFACE
    void (*flip_display)(ALLEGRO_DISPLAY *d);
    void (*update_display_region)(ALLEGRO_DISPLAY *d, int x, int y,
    	int width, int height);
+   /* Presents num_rects rectangles of four ints each, x, y, width and
+    * height. Optional, without it al_flip_display_regions calls
+    * update_display_region with their bounding box.
+    */
+   void (*flip_display_regions)(ALLEGRO_DISPLAY *d, const int *rects,
+      int num_rects);
    bool (*acknowledge_resize)(ALLEGRO_DISPLAY *d);
    bool (*resize_display)(ALLEGRO_DISPLAY *d, int width, int height);
    void (*quick_size)(ALLEGRO_DISPLAY *d);
@@ -80,9 +91,47 @@ struct ALLEGRO_DISPLAY_INTERFACE
    char *(*get_clipboard_text)(ALLEGRO_DISPLAY *display);
    bool  (*set_clipboard_text)(ALLEGRO_DISPLAY *display, const char *text);
    bool  (*has_clipboard_text)(ALLEGRO_DISPLAY *display);
+   /* Starts reading the clipboard, which ends with a call of
+    * _al_clipboard_text_received. Optional.
+    */
+   bool  (*request_clipboard_text)(ALLEGRO_DISPLAY *display);
 
    /* Issue #725 */
    void (*apply_window_constraints)(ALLEGRO_DISPLAY *display, bool onoff);
+
+   /* Hidden contexts sharing the display's objects, see ogl_upload.c.
+    * make_upload_context_current with a NULL context releases the calling
+    * thread's context.
+    */
+   void *(*create_upload_context)(ALLEGRO_DISPLAY *display);
+   bool (*make_upload_context_current)(ALLEGRO_DISPLAY *display, void *context);
+   void (*destroy_upload_context)(ALLEGRO_DISPLAY *display, void *context);
+
+   /* Called by al_flip_display before flipping once GPU timing is on. Ends
+    * the timer query of the frame just drawn, begins the next one and
+    * stores the time of the newest finished frame in display->stats.
+    */
+   void (*update_gpu_timer)(ALLEGRO_DISPLAY *display);
+
+   /* Frame fences for ALLEGRO_MAX_FRAME_LATENCY and al_wait_for_frame_latency.
+    * insert_frame_fence is called by al_flip_display after flipping and
+    * marks the end of the frame just presented, waiting for the oldest one
+    * if _AL_MAX_FRAME_LATENCY are already pending. wait_for_frame_latency
+    * blocks until at most the given number of marked frames are still being
+    * processed by the GPU.
+    */
+   void (*insert_frame_fence)(ALLEGRO_DISPLAY *display);
+   bool (*wait_for_frame_latency)(ALLEGRO_DISPLAY *display, int frames);
+
+   /* Blocks until the next vertical blank, or returns false right away if
+    * the driver cannot tell. Called from the thread behind
+    * al_set_display_vsync_events, which has an upload context of the
+    * display current if the driver supports them.
+    */
+   bool (*wait_for_vblank)(ALLEGRO_DISPLAY *display);
+
+   /* See al_set_display_frame_time_hint. Optional. */
+   bool (*set_frame_time_hint)(ALLEGRO_DISPLAY *display, double seconds);
 };
 
 
@@ -120,6 +169,22 @@ typedef struct
    int index, score;
 } ALLEGRO_EXTRA_DISPLAY_SETTINGS;
 
+/* The counters behind ALLEGRO_DISPLAY_STATS, which is only available in
+ * the unstable API.
+ */
+typedef struct _AL_DISPLAY_STATS
+{
+   int frames;
+   int draw_calls;
+   int vertices;
+   int texture_flushes;
+   int state_changes;
+   int target_switches;
+   int texture_uploads;
+   int64_t texture_upload_bytes;
+   double gpu_frame_time;
+} _AL_DISPLAY_STATS;
+
 struct ALLEGRO_DISPLAY
 {
    /* Must be first, so the display can be used as event source. */
@@ -138,6 +203,12 @@ struct ALLEGRO_DISPLAY
 
    /* A list of bitmaps created for this display, sub-bitmaps not included. */
    _AL_VECTOR bitmaps;
+   /* Guards bitmaps while other threads may create bitmaps for the display,
+    * otherwise NULL. See al_reserve_opengl_upload_contexts.
+    */
+   struct ALLEGRO_MUTEX *bitmaps_mutex;
+   /* Upload contexts currently borrowed, guarded by bitmaps_mutex. */
+   int num_uploads;
 
    int num_cache_vertices;
    bool cache_enabled;
@@ -163,6 +234,38 @@ struct ALLEGRO_DISPLAY
     * manual resize we need to add this number to the height for things
     * to work correctly. See issue #860. */
    int extra_resize_height;
+
+   /* Counters for al_get_display_stats, updated by the drivers. GPU timing
+    * starts with the first al_get_display_stats call.
+    */
+   _AL_DISPLAY_STATS stats;
+   bool gpu_timing;
+
+   /* See al_set_display_texture_budget. texture_frame counts flips, unlike
+    * stats.frames it is never reset.
+    */
+   int64_t texture_budget;
+   int texture_frame;
+
+   /* Set by the first al_wait_for_frame_latency call, after which frame
+    * fences are inserted even without ALLEGRO_MAX_FRAME_LATENCY.
+    */
+   bool frame_fences;
+
+   /* See display_vsync.c. Both are protected by the event source lock. */
+   struct _AL_DISPLAY_VSYNC *vsync;
+   bool redraw_pending;
+
+   /* See draw_list.c. */
+   struct ALLEGRO_DRAW_LIST *draw_recording;
+
+   /* The text received after al_request_clipboard_text, see clipboard.c.
+    * Protected by the event source lock.
+    */
+   char *clipboard_text;
+   ALLEGRO_USTR_INFO clipboard_info;
+   const ALLEGRO_USTR *clipboard_ustr;
+   bool clipboard_closed;
 };
 
 int  _al_score_display_settings(ALLEGRO_EXTRA_DISPLAY_SETTINGS *eds, ALLEGRO_EXTRA_DISPLAY_SETTINGS *ref);
@@ -184,8 +287,37 @@ AL_FUNC(void, _al_remove_display_invalidated_callback, (ALLEGRO_DISPLAY *display
 AL_FUNC(void, _al_remove_display_validated_callback, (ALLEGRO_DISPLAY *display,
    void (*display_validated)(ALLEGRO_DISPLAY*)));
 
+void _al_count_texture_upload(ALLEGRO_DISPLAY *display, int format,
+   int w, int h);
+
+void _al_display_vsync_flipped(ALLEGRO_DISPLAY *display);
+void _al_stop_display_vsync_events(ALLEGRO_DISPLAY *display);
+
+/* Defined in fullscreen_mode.c */
+void _al_init_display_modes(void);
+void _al_invalidate_display_modes(void);
+void _al_display_topology_changed(ALLEGRO_DISPLAY *display);
+
+/* Defined in clipboard.c */
+void _al_clipboard_text_received(ALLEGRO_DISPLAY *display, char *text);
+void _al_close_clipboard(ALLEGRO_DISPLAY *display);
+
+/* Defined in draw_list.c, also used by the primitives addon. */
+AL_FUNC(struct ALLEGRO_DRAW_LIST *, _al_get_draw_recording,
+   (ALLEGRO_DISPLAY *display));
+AL_FUNC(void, _al_update_draw_recording_blender,
+   (struct ALLEGRO_DRAW_LIST *list));
+AL_FUNC(bool, _al_draw_list_add, (struct ALLEGRO_DRAW_LIST *list,
+   void (*replay)(ALLEGRO_DISPLAY *display, void *data),
+   void (*destroy)(void *data), void *data));
+ALLEGRO_TRANSFORM *_al_get_thread_recording_transform(void);
+AL_FUNC(void *, _al_draw_list_last_data, (struct ALLEGRO_DRAW_LIST *list,
+   void (*replay)(ALLEGRO_DISPLAY *display, void *data)));
+
 /* Defined in tls.c */
 bool _al_set_current_display_only(ALLEGRO_DISPLAY *display);
+void _al_set_current_upload_context(ALLEGRO_DISPLAY *display, void *context);
+void *_al_get_current_upload_context(void);
 void _al_set_new_display_settings(ALLEGRO_EXTRA_DISPLAY_SETTINGS *settings);
 ALLEGRO_EXTRA_DISPLAY_SETTINGS *_al_get_new_display_settings(void);
 
@@ -11,11 +11,21 @@
 
 typedef struct ALLEGRO_EVENT_SOURCE_REAL ALLEGRO_EVENT_SOURCE_REAL;
 
+typedef struct _AL_EVENT_LATENCY
+{
+   int count;
+   double last;
+   double min;
+   double max;
+   double total;
+} _AL_EVENT_LATENCY;
+
 struct ALLEGRO_EVENT_SOURCE_REAL
 {
    _AL_MUTEX mutex;
    _AL_VECTOR queues;
    intptr_t data;
+   _AL_EVENT_LATENCY *latency;   /* allocated on the first measurement */
 };
 
 typedef struct ALLEGRO_USER_EVENT_DESCRIPTOR
@@ -33,8 +43,10 @@ void _al_event_source_lock(ALLEGRO_EVENT_SOURCE*);
 void _al_event_source_unlock(ALLEGRO_EVENT_SOURCE*);
 void _al_event_source_on_registration_to_queue(ALLEGRO_EVENT_SOURCE*, ALLEGRO_EVENT_QUEUE*);
 void _al_event_source_on_unregistration_from_queue(ALLEGRO_EVENT_SOURCE*, ALLEGRO_EVENT_QUEUE*);
+bool _al_event_source_is_registered(ALLEGRO_EVENT_SOURCE*, ALLEGRO_EVENT_QUEUE*);
 bool _al_event_source_needs_to_generate_event(ALLEGRO_EVENT_SOURCE*);
 void _al_event_source_emit_event(ALLEGRO_EVENT_SOURCE *, ALLEGRO_EVENT*);
+double _al_event_source_input_time(ALLEGRO_EVENT_SOURCE *, double os_time);
 
 void _al_event_queue_push_event(ALLEGRO_EVENT_QUEUE*, const ALLEGRO_EVENT*);
 
@@ -16,8 +16,31 @@ struct ALLEGRO_FILE
    void *userdata;
    unsigned char ungetc[ALLEGRO_UNGETC_SIZE];
    int ungetc_len;
+   /* Optional read-ahead buffer, see al_set_file_read_buffer_size. The
+    * underlying file position is rbuf_len - rbuf_pos bytes ahead of ours.
+    */
+   unsigned char *rbuf;
+   size_t rbuf_size;
+   size_t rbuf_pos;
+   size_t rbuf_len;
+   /* Only set for files opened while statistics are enabled. */
+   struct _AL_FILE_STATS *stats;
 };
 
+bool _al_file_stdio_pread(ALLEGRO_FILE *f, int64_t offset, void *ptr,
+   size_t size, size_t *bytes_read, int *error);
+bool _al_file_mmap_pread(ALLEGRO_FILE *f, int64_t offset, void *ptr,
+   size_t size, size_t *bytes_read);
+void _al_init_async_file_reading(void);
+
+extern bool _al_file_stats_active;
+void _al_file_stats_open(ALLEGRO_FILE *f, const ALLEGRO_FILE_INTERFACE *vtable,
+   const char *path, double start);
+void _al_file_stats_close(ALLEGRO_FILE *f);
+size_t _al_file_stats_fread(ALLEGRO_FILE *f, void *ptr, size_t size);
+size_t _al_file_stats_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size);
+bool _al_file_stats_fseek(ALLEGRO_FILE *f, int64_t offset, int whence);
+
 #ifdef __cplusplus
    }
 #endif
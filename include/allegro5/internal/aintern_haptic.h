@@ -50,6 +50,7 @@ typedef struct ALLEGRO_HAPTIC_DRIVER
    AL_METHOD(bool, release, (ALLEGRO_HAPTIC *));
    AL_METHOD(double, get_autocenter, (ALLEGRO_HAPTIC *));
    AL_METHOD(bool, set_autocenter, (ALLEGRO_HAPTIC *, double));
+   AL_METHOD(bool, update_effect, (ALLEGRO_HAPTIC_EFFECT_ID *, ALLEGRO_HAPTIC_EFFECT *));
 } ALLEGRO_HAPTIC_DRIVER;
 
 
@@ -0,0 +1,56 @@
+#ifndef __al_included_allegro5_aintern_input_snapshot_h
+#define __al_included_allegro5_aintern_input_snapshot_h
+
+#include "allegro5/internal/aintern_atomicops.h"
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+
+/* A copy of an input device state that the thread handling the input
+ * publishes whenever the state changes, so that any number of threads can
+ * read it without taking a lock. It is protected by a sequence lock: the
+ * counter is odd while the writer is updating, and a reader retries if the
+ * counter was odd or changed while it was copying.
+ *
+ * The last states are also kept in a ring buffer with their timestamps.
+ *
+ * There must only be one writer at a time; the drivers publish with their
+ * event source locked.
+ */
+typedef struct _AL_INPUT_SNAPSHOT
+{
+   volatile _AL_ATOMIC seq;
+   size_t size;
+   char *state;
+   int history_size;       /* a power of two, or 0 */
+   unsigned int history_count;
+   double *history_times;
+   char *history;
+} _AL_INPUT_SNAPSHOT;
+
+
+AL_FUNC(bool, _al_init_input_snapshot, (_AL_INPUT_SNAPSHOT *snap, size_t size));
+AL_FUNC(void, _al_destroy_input_snapshot, (_AL_INPUT_SNAPSHOT *snap));
+AL_FUNC(void, _al_publish_input_snapshot, (_AL_INPUT_SNAPSHOT *snap,
+   const void *state, double timestamp));
+AL_FUNC(void, _al_read_input_snapshot, (_AL_INPUT_SNAPSHOT *snap, void *state));
+AL_FUNC(int, _al_read_input_snapshot_history, (_AL_INPUT_SNAPSHOT *snap,
+   double since, void *states, double *timestamps, int max));
+AL_FUNC(bool, _al_read_input_snapshot_at, (_AL_INPUT_SNAPSHOT *snap,
+   unsigned int index, void *state, double *timestamp));
+
+#define _al_input_snapshot_is_active(snap)   ((snap)->state != NULL)
+
+/* Only meaningful for the writer, right after publishing. */
+#define _al_input_snapshot_last_index(snap)  ((snap)->history_count - 1)
+
+
+#ifdef __cplusplus
+   }
+#endif
+
+#endif
+
+/* vim: set sts=3 sw=3 et: */
@@ -56,6 +56,7 @@ void _al_iphone_touch_input_handle_begin(int id, double timestamp, float x, floa
 void _al_iphone_touch_input_handle_end(int id, double timestamp, float x, float y, bool primary, ALLEGRO_DISPLAY *disp);
 void _al_iphone_touch_input_handle_move(int id, double timestamp, float x, float y, bool primary, ALLEGRO_DISPLAY *disp);
 void _al_iphone_touch_input_handle_cancel(int id, double timestamp, float x, float y, bool primary, ALLEGRO_DISPLAY *disp);
+void _al_iphone_touch_input_end_frame(void);
 
 void _al_iphone_disconnect(ALLEGRO_DISPLAY *display);
 void _al_iphone_add_clipboard_functions(ALLEGRO_DISPLAY_INTERFACE *vt);
@@ -3,6 +3,7 @@
 
 #include "allegro5/internal/aintern_driver.h"
 #include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_input_snapshot.h"
 
 #ifdef __cplusplus
    extern "C" {
@@ -80,6 +81,8 @@ struct ALLEGRO_JOYSTICK
 {
    _AL_JOYSTICK_INFO info;
    ALLEGRO_JOYSTICK_DRIVER * driver;
+   /* Used by al_get_joystick_state if the driver publishes its state. */
+   _AL_INPUT_SNAPSHOT snapshot;
 };
 
 void _al_generate_joystick_event(ALLEGRO_EVENT *event);
@@ -2,6 +2,7 @@
 #define __al_included_allegro5_aintern_keyboard_h
 
 #include "allegro5/internal/aintern_driver.h"
+#include "allegro5/internal/aintern_input_snapshot.h"
 
 #ifdef __cplusplus
    extern "C" {
@@ -34,6 +35,8 @@ int _al_parse_key_binding(const char *s, unsigned int *modifiers);
 struct ALLEGRO_KEYBOARD
 {
    ALLEGRO_EVENT_SOURCE es;
+   /* Used by al_get_keyboard_state if the driver publishes its state. */
+   _AL_INPUT_SNAPSHOT snapshot;
 };
 
 
@@ -0,0 +1,91 @@
+#ifndef __al_included_allegro5_aintern_kms_h
+#define __al_included_allegro5_aintern_kms_h
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern_display.h"
+#include "allegro5/internal/aintern_mouse.h"
+#include "allegro5/internal/aintern_system.h"
+
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <gbm.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+/* Property IDs needed for atomic commits, looked up once per object. */
+typedef struct ALLEGRO_KMS_PROPS
+{
+   uint32_t connector_crtc_id;
+   uint32_t crtc_mode_id;
+   uint32_t crtc_active;
+   uint32_t plane_fb_id;
+   uint32_t plane_crtc_id;
+   uint32_t plane_src_x, plane_src_y, plane_src_w, plane_src_h;
+   uint32_t plane_crtc_x, plane_crtc_y, plane_crtc_w, plane_crtc_h;
+} ALLEGRO_KMS_PROPS;
+
+typedef struct ALLEGRO_SYSTEM_KMS
+{
+   ALLEGRO_SYSTEM system;
+
+   int fd;                     /* The DRM device. */
+   struct gbm_device *gbm;
+   bool atomic;                /* Else legacy drmModeSetCrtc/PageFlip. */
+
+   uint32_t connector_id;
+   uint32_t crtc_id;
+   uint32_t plane_id;          /* Primary plane of the CRTC, atomic only. */
+   ALLEGRO_KMS_PROPS props;
+
+   drmModeModeInfo *modes;     /* Modes of the connector. */
+   int num_modes;
+   int default_mode;           /* Index of the preferred mode. */
+   int mm_width, mm_height;    /* Physical size of the output. */
+
+   drmModeCrtc *saved_crtc;    /* To restore the console on exit. */
+
+   ALLEGRO_DISPLAY *mouse_grab_display; /* Best effort: may be inaccurate. */
+   bool inhibit_screensaver;
+} ALLEGRO_SYSTEM_KMS;
+
+typedef struct ALLEGRO_DISPLAY_KMS
+{
+   ALLEGRO_DISPLAY display;
+
+   drmModeModeInfo mode;
+   uint32_t mode_blob_id;
+   bool mode_set;              /* The first flip also sets the mode. */
+
+   struct gbm_surface *gbm_surface;
+   struct gbm_bo *front_bo;    /* Being scanned out. */
+   struct gbm_bo *pending_bo;  /* Queued for the next vblank. */
+   bool flip_pending;
+
+   EGLDisplay egl_display;
+   EGLConfig egl_config;
+   EGLContext egl_context;
+   EGLSurface egl_surface;
+   EGLint egl_context_version;
+
+   /* Hardware cursor. */
+   struct gbm_bo *cursor_bo;
+   int cursor_focus_x, cursor_focus_y;
+   bool cursor_shown;
+} ALLEGRO_DISPLAY_KMS;
+
+typedef struct ALLEGRO_MOUSE_CURSOR_KMS
+{
+   ALLEGRO_BITMAP *bitmap;
+   int focus_x, focus_y;
+} ALLEGRO_MOUSE_CURSOR_KMS;
+
+ALLEGRO_SYSTEM_INTERFACE *_al_system_kms_driver(void);
+ALLEGRO_DISPLAY_INTERFACE *_al_display_kms_driver(void);
+
+bool _al_evdev_set_mouse_range(int x1, int y1, int x2, int y2); // used by console mouse driver
+
+extern ALLEGRO_MOUSE_DRIVER _al_mousedrv_linux_evdev;
+
+#endif
+
+/* vim: set sts=3 sw=3 et: */
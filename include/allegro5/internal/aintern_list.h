@@ -13,6 +13,7 @@ typedef void (*_AL_LIST_ITEM_DTOR)(void* value, void* userdata);
 
 AL_FUNC(_AL_LIST*, _al_list_create, (void));
 AL_FUNC(_AL_LIST*, _al_list_create_static, (size_t capacity));
+AL_FUNC(_AL_LIST*, _al_list_create_frame_static, (size_t capacity));
 AL_FUNC(void, _al_list_destroy, (_AL_LIST* list));
 
 AL_FUNC(void, _al_list_set_dtor, (_AL_LIST* list, _AL_LIST_DTOR dtor));
@@ -62,6 +62,15 @@ typedef struct ALLEGRO_JOYSTICK_LINUX
    BUTTON_MAPPING button_mapping[_AL_MAX_JOYSTICK_BUTTONS];
    ALLEGRO_JOYSTICK_STATE joystate;
    char name[100];
+
+   /* Axes which moved since the last axis events were generated. */
+   bool axis_dirty[TOTAL_JOYSTICK_AXES];
+   int num_dirty_axes;
+   /* Set after SYN_DROPPED until the next SYN_REPORT. */
+   bool dropped;
+   /* Kernel time of the report being processed, and its al_get_time(). */
+   struct timeval report_tv;
+   double report_time;
 } ALLEGRO_JOYSTICK_LINUX;
 
 
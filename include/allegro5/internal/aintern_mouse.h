@@ -3,6 +3,7 @@
 
 #include "allegro5/internal/aintern_driver.h"
 #include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_input_snapshot.h"
 
 #ifdef __cplusplus
    extern "C" {
@@ -32,6 +33,8 @@ extern _AL_DRIVER_INFO _al_mouse_driver_list[];
 struct ALLEGRO_MOUSE
 {
    ALLEGRO_EVENT_SOURCE es;
+   /* Used by al_get_mouse_state if the driver publishes its state. */
+   _AL_INPUT_SNAPSHOT snapshot;
 };
 
 
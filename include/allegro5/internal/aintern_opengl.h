@@ -4,6 +4,7 @@
 #include "allegro5/opengl/gl_ext.h"
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_display.h"
+#include "allegro5/internal/aintern_shader.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,10 +26,40 @@ enum {
    _ALLEGRO_OPENGL_VERSION_3_1   = 0x03010000,
    _ALLEGRO_OPENGL_VERSION_3_2   = 0x03020000,
    _ALLEGRO_OPENGL_VERSION_3_3   = 0x03030000,
-   _ALLEGRO_OPENGL_VERSION_4_0   = 0x04000000
+   _ALLEGRO_OPENGL_VERSION_4_0   = 0x04000000,
+   _ALLEGRO_OPENGL_VERSION_4_1   = 0x04010000,
+   _ALLEGRO_OPENGL_VERSION_4_2   = 0x04020000,
+   _ALLEGRO_OPENGL_VERSION_4_3   = 0x04030000,
+   _ALLEGRO_OPENGL_VERSION_4_4   = 0x04040000
 };
 
-#define ALLEGRO_MAX_OPENGL_FBOS 8
+/* Capacity of the transient FBO pool.  The number of FBOs actually used
+ * is read from the fbo_pool_size key in the [opengl] config section.
+ */
+#define ALLEGRO_MAX_OPENGL_FBOS 64
+#define _AL_OGL_DEFAULT_FBO_POOL_SIZE 16
+
+/* Layout of the persistently mapped vertex cache ring buffer. */
+#define _AL_OGL_STREAM_SEGMENTS 3
+#define _AL_OGL_STREAM_SEGMENT_VERTICES 16384
+
+/* Number of segments in the pixel unpack ring used by WRITEONLY locks. */
+#define _AL_OGL_UPLOAD_SEGMENTS 3
+
+/* Maximum number of distinct blocks set with al_set_shader_uniform_block. */
+#define _AL_MAX_UNIFORM_BLOCKS 16
+
+/* Maximum number of hidden contexts per display for worker thread uploads. */
+#define _AL_MAX_UPLOAD_CONTEXTS 16
+
+/* Number of frame timer queries in flight for al_get_display_stats. */
+#define _AL_OGL_GPU_TIMERS 4
+
+/* Number of renderbuffers the display keeps track of for reuse, and how
+ * many of them are kept when no FBO uses them.
+ */
+#define _AL_OGL_MAX_RENDERBUFFERS 32
+#define _AL_OGL_IDLE_RENDERBUFFERS 8
 
 enum {
    FBO_INFO_UNUSED      = 0,
@@ -50,12 +81,18 @@ typedef struct ALLEGRO_FBO_BUFFERS
     * buffers Allegro will create before recycling them. This will
     * work very well in the case where you only have one or a few
     * bitmaps you regularly draw into.
+    *
+    * The renderbuffers come from the display's pool, so FBOs which give
+    * them up hand them on to the next FBO needing the same kind.
     */
    GLuint depth_buffer;
-   int dw, dh, depth;
-   
+   int dw, dh, depth, dsamples;
+   /* Depth texture of the owner attached instead of depth_buffer. */
+   GLuint depth_texture;
+
    GLuint multisample_buffer;
    int mw, mh, samples;
+   GLenum mformat;
 } ALLEGRO_FBO_BUFFERS;
 
 typedef struct ALLEGRO_FBO_INFO
@@ -66,9 +103,29 @@ typedef struct ALLEGRO_FBO_INFO
    ALLEGRO_FBO_BUFFERS buffers;
       
    ALLEGRO_BITMAP *owner;
-   double last_use_time;
+   /* Texture and depth buffer of the owner that were last found complete,
+    * so binding the FBO for the same owner again can skip re-attaching.
+    */
+   GLuint attached_texture;
+   GLuint attached_depth_buffer;
+   /* Value of the display's fbo_use_count when last bound; 0 if unused. */
+   uint64_t last_use;
+   /* The multisample buffer may hold samples the texture lacks. */
+   bool unresolved;
 } ALLEGRO_FBO_INFO;
 
+/* A depth or multisample renderbuffer attached to refs FBOs. Only shared
+ * renderbuffers may be attached to more than one.
+ */
+typedef struct ALLEGRO_OGL_RENDERBUFFER
+{
+   GLuint buffer;
+   int w, h, samples;
+   GLenum format;
+   int refs;
+   bool shared;
+} ALLEGRO_OGL_RENDERBUFFER;
+
 typedef struct ALLEGRO_BITMAP_EXTRA_OPENGL
 {
    /* Driver specifics. */
@@ -78,6 +135,11 @@ typedef struct ALLEGRO_BITMAP_EXTRA_OPENGL
 
    GLuint texture; /* 0 means, not uploaded yet. */
 
+   /* Depth texture of ALLEGRO_DEPTH_TEXTURE bitmaps, created when the
+    * bitmap first becomes the target.
+    */
+   GLuint depth_texture;
+
    ALLEGRO_FBO_INFO *fbo_info;
 
    /* When an OpenGL bitmap is locked, the locked region is usually backed by a
@@ -86,12 +148,26 @@ typedef struct ALLEGRO_BITMAP_EXTRA_OPENGL
     * On GLES, a locked backbuffer may be backed by a texture bitmap pointed to
     * by lock_proxy instead, and lock_buffer is NULL.  Upon unlocking the proxy
     * bitmap is drawn onto the backbuffer.
+    *
+    * A large WRITEONLY lock in the texture's own format may instead be backed
+    * by a segment of the display's upload ring, lock_segment (plus one), or
+    * failing that by a mapped pixel unpack buffer, lock_pbo, with lock_buffer
+    * NULL.  The texture is then updated straight from that buffer when
+    * unlocking.
     */
    unsigned char *lock_buffer;
    ALLEGRO_BITMAP *lock_proxy;
+   GLuint lock_pbo;
+   int lock_segment;
 
    float left, top, right, bottom; /* Texture coordinates. */
    bool is_backbuffer; /* This is not a real bitmap, but the backbuffer. */
+
+   /* Set by al_discard_bitmap_contents while the bitmap is not the target;
+    * the contents are discarded when it next becomes the target, unless it
+    * is uploaded to first.
+    */
+   bool discard_pending;
 } ALLEGRO_BITMAP_EXTRA_OPENGL;
 
 typedef struct OPENGL_INFO {
@@ -123,8 +199,49 @@ typedef struct ALLEGRO_OGL_VARLOCS
    GLint alpha_func_loc;
    GLint alpha_test_val_loc;
    GLint user_attr_loc[_ALLEGRO_PRIM_MAX_USER_ATTR];
+   GLint tex_index_loc;
+   /* al_tex1, al_tex2, ... */
+   GLint batch_tex_loc[_AL_MAX_BATCH_TEXTURES - 1];
 } ALLEGRO_OGL_VARLOCS;
 
+/* Bits of ALLEGRO_OGL_STATE_CACHE.known */
+enum {
+   _AL_OGL_STATE_BLENDER      = 1 << 0,
+   _AL_OGL_STATE_RENDER_STATE = 1 << 1,
+   _AL_OGL_STATE_PROGRAM      = 1 << 2,
+   _AL_OGL_STATE_FRAMEBUFFER  = 1 << 3,
+   _AL_OGL_STATE_VIEWPORT     = 1 << 4,
+   _AL_OGL_STATE_SCISSOR      = 1 << 5,
+   _AL_OGL_STATE_PROJVIEW     = 1 << 6,
+   _AL_OGL_STATE_FRAMEBUFFER_SRGB = 1 << 7,
+   _AL_OGL_STATE_ALL          = (1 << 8) - 1
+};
+
+/* What we last told the context about the state we set on every draw or
+ * target change, so that setting it to the same value again can be skipped.
+ * A group is only trusted while its bit is set in known; anything that
+ * changes the state behind our back clears the bit.
+ */
+typedef struct ALLEGRO_OGL_STATE_CACHE
+{
+   bool enabled;
+   int known;
+
+   int blender[6];
+   ALLEGRO_COLOR blend_color;
+   _ALLEGRO_RENDER_STATE render_state;
+   GLuint program;
+   GLint framebuffer;
+   bool framebuffer_srgb;
+   int viewport[4];
+   bool scissor_test;
+   int scissor[4];
+   /* The program whose al_projview_matrix was last set to the display's
+    * projview_transform.
+    */
+   GLuint projview_program;
+} ALLEGRO_OGL_STATE_CACHE;
+
 typedef struct ALLEGRO_OGL_EXTRAS
 {
    /* A list of extensions supported by Allegro, for this context. */
@@ -138,10 +255,43 @@ typedef struct ALLEGRO_OGL_EXTRAS
 
    ALLEGRO_BITMAP *backbuffer;
 
+   ALLEGRO_OGL_STATE_CACHE state_cache;
+
    /* True if display resources are shared among displays. */
    bool is_shared;
 
+   /* Hidden contexts lent to worker threads by al_begin_opengl_upload,
+    * guarded by the display's bitmaps_mutex. See ogl_upload.c.
+    */
+   void *upload_contexts[_AL_MAX_UPLOAD_CONTEXTS];
+   bool upload_context_busy[_AL_MAX_UPLOAD_CONTEXTS];
+   int num_upload_contexts;
+
+   /* Transient FBOs, recycled in least recently used order. Only the
+    * first num_fbos entries are used; zero until the pool is first needed.
+    */
    ALLEGRO_FBO_INFO fbos[ALLEGRO_MAX_OPENGL_FBOS];
+   int num_fbos;
+   uint64_t fbo_use_count;
+
+   /* Depth and multisample renderbuffers attached to FBOs or kept for
+    * reuse, and the FBO multisample buffers are resolved through. See
+    * ogl_fbo.c.
+    */
+   ALLEGRO_OGL_RENDERBUFFER renderbuffers[_AL_OGL_MAX_RENDERBUFFERS];
+   int num_renderbuffers;
+   GLuint resolve_fbo;
+
+   /* Whether GL_EXT_multisampled_render_to_texture lets multisampled
+    * bitmaps be drawn into without a multisample buffer of their own.
+    */
+   bool multisampled_render_to_texture;
+
+   /* How framebuffer contents are discarded, and whether the target's depth
+    * buffer is discarded when switching targets. See ogl_fbo.c.
+    */
+   int discard_method;
+   bool discard_depth_on_switch;
 
    /* In non-programmable pipe mode this should be zero.
     * In programmable pipeline mode this should be non-zero.
@@ -149,8 +299,64 @@ typedef struct ALLEGRO_OGL_EXTRAS
    GLuint program_object;
    ALLEGRO_OGL_VARLOCS varlocs;
 
+   /* Textures used by the vertices in the vertex cache, see
+    * _al_ogl_batch_texture.
+    */
+   GLuint batch_textures[_AL_MAX_BATCH_TEXTURES];
+   int num_batch_textures;
+
    /* For OpenGL 3.0+ we use a single vao and vbo. */
    GLuint vao, vbo;
+   /* The vbo is orphaned once full, then appended to. */
+   int vbo_size, vbo_offset;
+
+   /* With GL_ARB_buffer_storage the vertex cache is instead written
+    * straight into a persistently mapped ring of segments. Each segment is
+    * fenced once we move on from it, and the fence is waited for before the
+    * segment is written again.
+    */
+#ifndef ALLEGRO_CFG_OPENGLES
+   GLuint stream_vbo;
+   void *stream_ptr;
+   int stream_segment;
+   int stream_first;
+   GLsync stream_fences[_AL_OGL_STREAM_SEGMENTS];
+   bool stream_unsupported;
+
+   /* Large WRITEONLY locks are staged in a persistently mapped pixel unpack
+    * ring, fenced the same way.  A segment belongs to one lock at a time
+    * (upload_busy) and is fenced once the texture upload from it is queued.
+    * The ring is recreated with bigger segments if a lock doesn't fit.
+    */
+   GLuint upload_pbo;
+   unsigned char *upload_ptr;
+   int upload_segment_size;
+   int upload_segment;
+   GLsync upload_fences[_AL_OGL_UPLOAD_SEGMENTS];
+   bool upload_busy[_AL_OGL_UPLOAD_SEGMENTS];
+   bool upload_unsupported;
+
+   /* Buffers holding the blocks set with al_set_shader_uniform_block,
+    * indexed by binding point.
+    */
+   GLuint uniform_blocks[_AL_MAX_UNIFORM_BLOCKS];
+
+   /* GL_TIME_ELAPSED queries for al_get_display_stats, used round-robin.
+    * gpu_timer_next is the next one to begin; the gpu_timers_pending ones
+    * before it have ended but not been read yet.
+    */
+   GLuint gpu_timers[_AL_OGL_GPU_TIMERS];
+   int gpu_timer_next;
+   int gpu_timers_pending;
+   bool gpu_timer_running;
+
+   /* Fences marking the end of each presented frame, used round-robin like
+    * the timer queries.
+    */
+   GLsync frame_fences[_AL_MAX_FRAME_LATENCY];
+   int frame_fence_next;
+   int frame_fences_pending;
+#endif
 
 } ALLEGRO_OGL_EXTRAS;
 
@@ -159,6 +365,7 @@ typedef struct ALLEGRO_OGL_BITMAP_VERTEX
    float x, y, z;
    float tx, ty;
    float r, g, b, a;
+   float tex_index;
 } ALLEGRO_OGL_BITMAP_VERTEX;
 
 
@@ -174,11 +381,16 @@ ALLEGRO_BITMAP *_al_ogl_create_bitmap(ALLEGRO_DISPLAY *d, int w, int h,
     int format, int flags);
 void _al_ogl_upload_bitmap_memory(ALLEGRO_BITMAP *bitmap, int format, void *ptr);
 
+/* upload contexts */
+void _al_ogl_destroy_upload_contexts(ALLEGRO_DISPLAY *display);
+
 /* locking */
 #ifndef ALLEGRO_CFG_OPENGLES
    ALLEGRO_LOCKED_REGION *_al_ogl_lock_region_new(ALLEGRO_BITMAP *bitmap,
       int x, int y, int w, int h, int format, int flags);
    void _al_ogl_unlock_region_new(ALLEGRO_BITMAP *bitmap);
+   bool _al_ogl_start_readback(ALLEGRO_BITMAP *bitmap,
+      struct ALLEGRO_BITMAP_READBACK *rb, int x, int y, int w, int h);
 #else
    ALLEGRO_LOCKED_REGION *_al_ogl_lock_region_gles(ALLEGRO_BITMAP *bitmap,
       int x, int y, int w, int h, int format, int flags);
@@ -203,6 +415,9 @@ void _al_ogl_setup_gl(ALLEGRO_DISPLAY *d);
 void _al_ogl_set_target_bitmap(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitmap);
 void _al_ogl_unset_target_bitmap(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitmap);
 void _al_ogl_finalize_fbo(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitmap);
+bool _al_ogl_resolve_fbo(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitmap);
+void _al_ogl_discard_framebuffer(ALLEGRO_DISPLAY *display,
+   ALLEGRO_BITMAP *target, bool color, bool depth);
 void _al_ogl_setup_bitmap_clipping(const ALLEGRO_BITMAP *bitmap);
 ALLEGRO_BITMAP *_al_ogl_get_backbuffer(ALLEGRO_DISPLAY *d);
 ALLEGRO_BITMAP* _al_ogl_create_backbuffer(ALLEGRO_DISPLAY *disp);
@@ -213,12 +428,19 @@ void _al_opengl_backup_dirty_bitmaps(ALLEGRO_DISPLAY *d, bool flip);
 /* draw */
 struct ALLEGRO_DISPLAY_INTERFACE;
 void _al_ogl_add_drawing_functions(struct ALLEGRO_DISPLAY_INTERFACE *vt);
+float _al_ogl_batch_texture(ALLEGRO_DISPLAY *disp, GLuint texture);
 
 AL_FUNC(bool, _al_opengl_set_blender, (ALLEGRO_DISPLAY *disp));
 AL_FUNC(char const *, _al_gl_error_string, (GLenum e));
 
 void _al_ogl_update_render_state(ALLEGRO_DISPLAY *display);
 
+/* state cache */
+void _al_ogl_init_state_cache(ALLEGRO_DISPLAY *display);
+void _al_ogl_invalidate_state_cache(ALLEGRO_DISPLAY *display, int which);
+void _al_ogl_remember_state(ALLEGRO_OGL_STATE_CACHE *cache, int which);
+ALLEGRO_OGL_STATE_CACHE *_al_ogl_current_state_cache(void);
+
 /* shader */
 #ifdef ALLEGRO_CFG_SHADER_GLSL
    bool _al_glsl_set_projview_matrix(GLint projview_matrix_loc,
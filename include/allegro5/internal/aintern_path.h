@@ -1,12 +1,19 @@
 #ifndef __al_included_allegro5_aintern_path_h
 #define __al_included_allegro5_aintern_path_h
 
+/* The number of directory components a path holds without allocating. */
+#define _AL_PATH_INLINE_COMPONENTS  16
+
 struct ALLEGRO_PATH {
    ALLEGRO_USTR *drive;
    ALLEGRO_USTR *filename;
-   _AL_VECTOR segments;    /* vector of ALLEGRO_USTR * */
-   ALLEGRO_USTR *basename;
-   ALLEGRO_USTR *full_string;
+   /* All directory components, each followed by a NUL byte. */
+   ALLEGRO_USTR *segments;
+   _AL_VECTOR offsets;     /* vector of int, where each component starts */
+   int inline_offsets[_AL_PATH_INLINE_COMPONENTS];
+   ALLEGRO_USTR *basename;       /* NULL until needed */
+   ALLEGRO_USTR *full_string;    /* NULL until needed */
+   int full_string_delim;        /* -1 if full_string is out of date */
 };
 
 #endif
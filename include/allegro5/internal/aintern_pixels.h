@@ -20,6 +20,7 @@
 #define _AL_INLINE_GET_PIXEL(format, data, color, advance)                    \
    do {                                                                       \
       switch (format) {                                                       \
+         case ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB:                            \
          case ALLEGRO_PIXEL_FORMAT_ARGB_8888: {                               \
             uint32_t _gp_pixel = *(uint32_t *)(data);                         \
             _AL_MAP_RGBA(color,                                               \
@@ -116,6 +117,7 @@
             break;                                                            \
          }                                                                    \
                                                                               \
+         case ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB:                            \
          case ALLEGRO_PIXEL_FORMAT_ABGR_8888: {                               \
             uint32_t _gp_pixel = *(uint32_t *)(data);                         \
             _AL_MAP_RGBA(color,                                               \
@@ -255,6 +257,14 @@
          case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1:                                 \
          case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3:                                 \
          case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5:                                 \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4:                                     \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5:                                    \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_BC7:                                  \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGB_ETC2:                                  \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ETC2:                                 \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_4x4:                             \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_6x6:                             \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x8:                             \
             ALLEGRO_ERROR("INLINE_GET got compressed format: %d\n", format); \
             abort();                                                          \
             break;                                                            \
@@ -272,6 +282,7 @@
    do {                                                                       \
       uint32_t _pp_pixel;                                                     \
       switch (format) {                                                       \
+         case ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB:                            \
          case ALLEGRO_PIXEL_FORMAT_ARGB_8888:                                 \
             _pp_pixel  = _al_fast_float_to_int(color.a * 255) << 24;          \
             _pp_pixel |= _al_fast_float_to_int(color.r * 255) << 16;          \
@@ -349,6 +360,7 @@
                data += 2;                                                     \
             break;                                                            \
                                                                               \
+         case ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB:                            \
          case ALLEGRO_PIXEL_FORMAT_ABGR_8888:                                 \
             _pp_pixel  = _al_fast_float_to_int(color.a * 0xff) << 24;         \
             _pp_pixel |= _al_fast_float_to_int(color.b * 0xff) << 16;         \
@@ -470,6 +482,14 @@
          case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1:                      \
          case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3:                      \
          case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5:                      \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4:                          \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5:                         \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_BC7:                       \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGB_ETC2:                       \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ETC2:                      \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_4x4:                  \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_6x6:                  \
+         case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x8:                  \
             ALLEGRO_ERROR("INLINE_PUT got compressed format: %d\n", format); \
             abort();                                                          \
             break;                                                            \
@@ -491,6 +511,7 @@ AL_FUNC(bool, _al_pixel_format_has_alpha, (int format));
 AL_FUNC(bool, _al_pixel_format_is_real, (int format));
 AL_FUNC(bool, _al_pixel_format_is_video_only, (int format));
 AL_FUNC(bool, _al_pixel_format_is_compressed, (int format));
+AL_FUNC(bool, _al_pixel_format_is_srgb, (int format));
 AL_FUNC(int, _al_get_real_pixel_format, (ALLEGRO_DISPLAY *display, int format));
 AL_FUNC(char const*, _al_pixel_format_name, (ALLEGRO_PIXEL_FORMAT format));
 
@@ -0,0 +1,44 @@
+#ifndef __al_included_allegro5_aintern_pool_h
+#define __al_included_allegro5_aintern_pool_h
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+
+/* A pool of fixed-size items for small objects which are created and
+ * destroyed often. Define one statically with _AL_POOL_INITIALIZER, the
+ * fields after the name are private to pool.c.
+ *
+ * Until al_install_system is called the first time, _al_pool_alloc simply
+ * falls back to al_malloc. _al_pool_free handles both kinds of items.
+ *
+ * [thread-safe]
+ */
+typedef struct _AL_POOL
+{
+   size_t item_size;
+   const char *name;
+
+   void *free_list;
+   void *chunks;
+   size_t live;
+   bool registered;
+} _AL_POOL;
+
+#define _AL_POOL_INITIALIZER(type, name) \
+   { sizeof(type), (name), NULL, NULL, 0, false }
+
+void _al_init_pools(void);
+void _al_shutdown_pools(void);
+void *_al_pool_alloc(_AL_POOL *pool);
+void _al_pool_free(void *item);
+
+
+#ifdef __cplusplus
+   }
+#endif
+
+#endif
+
+/* vim: set ts=8 sts=3 sw=3 et: */
@@ -34,6 +34,7 @@ typedef struct ALLEGRO_DISPLAY_RASPBERRYPI {
    int cursor_height;
    int cursor_offset_x, cursor_offset_y;
    Atom wm_delete_window_atom;
+   _AL_VECTOR overlays;
 } ALLEGRO_DISPLAY_RASPBERRYPI;
 
 typedef struct ALLEGRO_MOUSE_CURSOR_RASPBERRYPI {
@@ -44,6 +45,8 @@ ALLEGRO_SYSTEM_INTERFACE *_al_system_raspberrypi_driver(void);
 ALLEGRO_DISPLAY_INTERFACE *_al_get_raspberrypi_display_interface(void);
 void _al_raspberrypi_get_screen_info(int *dx, int *dy,
    int *screen_width, int *screen_height);
+uint32_t _al_raspberrypi_get_dispmanx_display(void);
+void _al_raspberrypi_destroy_overlays(ALLEGRO_DISPLAY_RASPBERRYPI *d);
 
 bool _al_evdev_set_mouse_range(int x1, int y1, int x2, int y2); // used by console mouse driver
 void _al_raspberrypi_get_mouse_scale_ratios(float *x, float *y); // used by X mouse driver
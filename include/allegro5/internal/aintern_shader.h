@@ -1,13 +1,21 @@
 #ifndef __al_included_allegro5_internal_aintern_shader_h
 #define __al_included_allegro5_internal_aintern_shader_h
 
-#include "allegro5/internal/aintern_list.h"
+#include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_vector.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Held bitmap drawing can mix up to this many textures in one draw call if
+ * the shader declares the _AL_SHADER_VAR_TEX_INDEX attribute and the extra
+ * samplers al_tex1, al_tex2, ... next to al_tex. The default GLSL shader
+ * does.
+ */
+#define _AL_MAX_BATCH_TEXTURES      4
+#define _AL_SHADER_VAR_TEX_INDEX    "al_tex_index"
+
 typedef struct ALLEGRO_SHADER_INTERFACE ALLEGRO_SHADER_INTERFACE;
 
 struct ALLEGRO_SHADER_INTERFACE
@@ -33,6 +41,8 @@ struct ALLEGRO_SHADER_INTERFACE
    bool (*set_shader_float_vector)(ALLEGRO_SHADER *shader, const char *name,
          int elem_size, const float *f, int num_elems);
    bool (*set_shader_bool)(ALLEGRO_SHADER *shader, const char *name, bool b);
+   bool (*set_shader_uniform_block)(ALLEGRO_SHADER *shader, const char *name,
+         const void *data, size_t size);
 };
 
 struct ALLEGRO_SHADER
@@ -43,7 +53,7 @@ struct ALLEGRO_SHADER
    ALLEGRO_SHADER_PLATFORM platform;
    ALLEGRO_SHADER_INTERFACE *vt;
    _AL_VECTOR bitmaps; /* of ALLEGRO_BITMAP pointers */
-   _AL_LIST_ITEM *dtor_item;
+   _AL_DTOR_ITEM *dtor_item;
 };
 
 /* In most cases you should use _al_set_bitmap_shader_field. */
@@ -53,6 +63,14 @@ void _al_unregister_shader_bitmap(ALLEGRO_SHADER *shader, ALLEGRO_BITMAP *bmp);
 
 ALLEGRO_SHADER *_al_create_default_shader(int display_flags);
 
+/* On-disk cache of compiled shaders, see shader_cache.c. */
+#define _AL_SHADER_CACHE_HASH_INIT  UINT64_C(14695981039346656037)
+
+const char *_al_get_shader_cache_path(void);
+uint64_t _al_shader_cache_hash(uint64_t hash, const void *data, size_t size);
+void *_al_load_shader_cache(uint64_t key, size_t *size);
+void _al_save_shader_cache(uint64_t key, const void *data, size_t size);
+
 #ifdef ALLEGRO_CFG_SHADER_GLSL
 ALLEGRO_SHADER *_al_create_shader_glsl(ALLEGRO_SHADER_PLATFORM platform);
 void _al_set_shader_glsl(ALLEGRO_DISPLAY *display, ALLEGRO_SHADER *shader);
@@ -51,6 +51,8 @@ struct ALLEGRO_SYSTEM_INTERFACE
    double (*get_time)(void);
    void (*rest)(double seconds);
    void (*init_timeout)(ALLEGRO_TIMEOUT *timeout, double seconds);
+   void (*rest_until)(double time);
+   void (*init_timeout_until)(ALLEGRO_TIMEOUT *timeout, double time);
 };
 
 struct ALLEGRO_SYSTEM
@@ -71,6 +73,8 @@ AL_VAR(_AL_DTOR_LIST *, _al_dtor_list);
 AL_FUNC(void *, _al_open_library, (const char *filename));
 AL_FUNC(void *, _al_import_symbol, (void *library, const char *symbol));
 AL_FUNC(void, _al_close_library, (void *library));
+void _al_rest_until(double time);
+AL_FUNC(void, _al_set_thermal_state, (int state));
 
 #ifdef __cplusplus
 }
@@ -10,6 +10,21 @@ void _al_tls_init_once(void);
 void _al_reinitialize_tls_values(void);
 
 int *_al_tls_get_dtor_owner_count(void);
+int *_al_tls_get_dtor_bucket(void);
+
+void *_al_tls_get_job_worker(void);
+void _al_tls_set_job_worker(void *worker);
+
+void *_al_tls_get_frame_arena(void);
+void _al_tls_set_frame_arena(void *arena);
+
+void _al_tls_forget_draw_state(void);
+
+void *_al_tls_get_profile_thread(void);
+void _al_tls_set_profile_thread(void *pt);
+
+void *_al_tls_get_draw_recording(void);
+void _al_tls_set_draw_recording(void *list);
 
 
 #ifdef __cplusplus
@@ -3,6 +3,7 @@
 
 #include "allegro5/internal/aintern_driver.h"
 #include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_input_snapshot.h"
 
 #ifdef __cplusplus
    extern "C" {
@@ -26,10 +27,27 @@ struct ALLEGRO_TOUCH_INPUT
    ALLEGRO_EVENT_SOURCE es;
    ALLEGRO_EVENT_SOURCE mouse_emulation_es;
    int mouse_emulation_mode;
+
+   /* Drivers that support frame events and the state history initialise
+    * these with _al_init_touch_input_frames, and publish their state to
+    * the snapshot whenever it changes. The rest is protected by the lock of
+    * the event source.
+    */
+   _AL_INPUT_SNAPSHOT snapshot;
+   bool frame_mode;
+   bool frame_pending;
+   double frame_timestamp;
+   struct ALLEGRO_DISPLAY *frame_display;
 };
 
 extern _AL_DRIVER_INFO _al_touch_input_driver_list[];
 
+AL_FUNC(bool, _al_init_touch_input_frames, (ALLEGRO_TOUCH_INPUT *ti));
+AL_FUNC(void, _al_destroy_touch_input_frames, (ALLEGRO_TOUCH_INPUT *ti));
+AL_FUNC(bool, _al_touch_input_defer_event, (ALLEGRO_TOUCH_INPUT *ti,
+   unsigned int type, double timestamp, struct ALLEGRO_DISPLAY *disp));
+AL_FUNC(void, _al_touch_input_end_frame, (ALLEGRO_TOUCH_INPUT *ti));
+
 #ifdef __cplusplus
    }
 #endif
@@ -13,12 +13,15 @@ typedef struct _AL_VECTOR
    char*  _items;  /* total size == (size + unused) * itemsize */
    size_t _size;
    size_t _unused;
+   bool   _inline; /* _items is storage owned by the caller */
 } _AL_VECTOR;
 
-#define _AL_VECTOR_INITIALIZER(typ) { sizeof(typ), 0, 0, 0 }
+#define _AL_VECTOR_INITIALIZER(typ) { sizeof(typ), 0, 0, 0, false }
 
 
 AL_FUNC(void,  _al_vector_init, (_AL_VECTOR*, size_t itemsize));
+AL_FUNC(void,  _al_vector_init_inline, (_AL_VECTOR*, size_t itemsize, void *buf, size_t capacity));
+AL_FUNC(bool,  _al_vector_reserve, (_AL_VECTOR*, size_t capacity));
 AL_INLINE(size_t, _al_vector_size, (const _AL_VECTOR *vec),
 {
    return vec->_size;
@@ -42,7 +45,9 @@ AL_FUNC(void*, _al_vector_alloc_mid, (_AL_VECTOR*, unsigned int index));
 AL_FUNC(int,  _al_vector_find, (const _AL_VECTOR*, const void *ptr_item));
 AL_FUNC(bool, _al_vector_contains, (const _AL_VECTOR*, const void *ptr_item));
 AL_FUNC(void, _al_vector_delete_at, (_AL_VECTOR*, unsigned int index));
+AL_FUNC(bool, _al_vector_delete_at_unordered, (_AL_VECTOR*, unsigned int index));
 AL_FUNC(bool, _al_vector_find_and_delete, (_AL_VECTOR*, const void *ptr_item));
+AL_FUNC(bool, _al_vector_find_and_delete_unordered, (_AL_VECTOR*, const void *ptr_item));
 AL_FUNC(void, _al_vector_free, (_AL_VECTOR*));
 
 
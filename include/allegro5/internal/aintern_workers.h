@@ -0,0 +1,21 @@
+#ifndef __al_included_allegro5_aintern_workers_h
+#define __al_included_allegro5_aintern_workers_h
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+
+void _al_init_workers(void);
+AL_FUNC(int, _al_get_worker_count, (void));
+AL_FUNC(void, _al_run_parallel, (int count,
+   void (*func)(int index, void *arg), void *arg));
+
+
+#ifdef __cplusplus
+   }
+#endif
+
+#endif
+
+/* vim: set ts=8 sts=3 sw=3 et: */
@@ -6,6 +6,8 @@
 
 void _al_xwin_display_selection_notify(ALLEGRO_DISPLAY  *display, XSelectionEvent *xselection);
 void _al_xwin_display_selection_request(ALLEGRO_DISPLAY *display, XSelectionRequestEvent *xselectionrequest);
+void _al_xwin_display_property_notify(ALLEGRO_DISPLAY *display, XPropertyEvent *xproperty);
+void _al_xwin_destroy_clipboard(ALLEGRO_DISPLAY *display);
 void _al_xwin_add_clipboard_functions(ALLEGRO_DISPLAY_INTERFACE *vt);
 
 #endif
@@ -14,6 +14,7 @@
 
 typedef struct ALLEGRO_DISPLAY_XGLX_GTK ALLEGRO_DISPLAY_XGLX_GTK;
 typedef struct ALLEGRO_XWIN_DISPLAY_OVERRIDABLE_INTERFACE ALLEGRO_XWIN_DISPLAY_OVERRIDABLE_INTERFACE;
+typedef struct ALLEGRO_XSOFT_BACKBUFFER ALLEGRO_XSOFT_BACKBUFFER;
 
 /* This is our version of ALLEGRO_DISPLAY with driver specific extra data. */
 struct ALLEGRO_DISPLAY_XGLX
@@ -34,6 +35,7 @@ struct ALLEGRO_DISPLAY_XGLX
    XVisualInfo *xvinfo; /* Used when selecting the X11 visual to use. */
    GLXFBConfig *fbc; /* Used when creating the OpenGL context. */
    int glx_version; /* 130 means 1 major and 3 minor, aka 1.3 */
+   int context_major, context_minor; /* As requested, 0 for the default. */
 
    /* Points to a structure if this display is contained by a GTK top-level
     * window, otherwise it is NULL.
@@ -68,6 +70,20 @@ struct ALLEGRO_DISPLAY_XGLX
    _AL_COND selectioned; /* Condition variable to wait for a selection event a window. */
    bool is_selectioned;  /* Set to true when selection event received. */
 
+   /* Reading the clipboard, see xclipboard.c. Protected by the system lock. */
+   int clipboard_transfer;
+   bool clipboard_async;
+   double clipboard_time;     /* of the last progress */
+   char *clipboard_buf;
+   size_t clipboard_size, clipboard_capacity;
+   char *clipboard_result;    /* for al_get_clipboard_text */
+   size_t clipboard_result_size;
+
+   /* Set for displays of the software driver, which have no GLX context and
+    * draw into soft instead.
+    */
+   bool software;
+   ALLEGRO_XSOFT_BACKBUFFER *soft;
 };
 
 void _al_display_xglx_await_resize(ALLEGRO_DISPLAY *d, int old_resize_count, bool delay_hack);
@@ -78,6 +94,18 @@ void _al_xwin_display_switch_handler(ALLEGRO_DISPLAY *d,
 void _al_xwin_display_switch_handler_inner(ALLEGRO_DISPLAY *d, bool focus_in);
 void _al_xwin_display_expose(ALLEGRO_DISPLAY *display, XExposeEvent *xevent);
 
+/* xsoftware.c */
+bool _al_xsoft_select_visual(ALLEGRO_DISPLAY_XGLX *d);
+bool _al_xsoft_create_backbuffer(ALLEGRO_DISPLAY_XGLX *d);
+void _al_xsoft_resize_backbuffer(ALLEGRO_DISPLAY_XGLX *d);
+void _al_xsoft_destroy_backbuffer(ALLEGRO_DISPLAY_XGLX *d);
+ALLEGRO_BITMAP *_al_xsoft_get_backbuffer(ALLEGRO_DISPLAY *display);
+void _al_xsoft_flip_display(ALLEGRO_DISPLAY *display);
+void _al_xsoft_update_display_region(ALLEGRO_DISPLAY *display, int x, int y,
+   int w, int h);
+void _al_xsoft_flip_display_regions(ALLEGRO_DISPLAY *display,
+   const int *rects, int num_rects);
+
 
 /* An ad-hoc interface to allow the GTK backend to override some of the
  * normal X display interface implementation.
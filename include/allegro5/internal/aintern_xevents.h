@@ -6,5 +6,6 @@
 void _al_xwin_background_thread(_AL_THREAD *self, void *arg);
 
 void _al_display_xglx_closebutton(ALLEGRO_DISPLAY *d, XEvent *xevent);
+double _al_xwin_event_time(Time time);
 
 #endif
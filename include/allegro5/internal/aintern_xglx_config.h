@@ -5,5 +5,8 @@
 
 void _al_xglx_config_select_visual(ALLEGRO_DISPLAY_XGLX *glx);
 bool _al_xglx_config_create_context(ALLEGRO_DISPLAY_XGLX *glx);
+void *_al_xglx_config_create_upload_context(ALLEGRO_DISPLAY_XGLX *glx);
+bool _al_xglx_config_make_upload_context_current(void *context);
+void _al_xglx_config_destroy_upload_context(void *context);
 
 #endif
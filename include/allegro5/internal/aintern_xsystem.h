@@ -45,6 +45,10 @@ struct ALLEGRO_SYSTEM_XGLX
     * only use this in the main thread.
     */
    Display *gfxdisplay;
+   /* We only connect when a display, input device or monitor query first
+    * needs it, see xglx_connect in xsystem.c.
+    */
+   bool connect_tried;
 
    Atom AllegroAtom;
    Atom XEmbedAtom;
@@ -4,5 +4,6 @@
 #include "allegro5/internal/aintern_touch_input.h"
 
 void _al_x_handle_touch_event(ALLEGRO_SYSTEM_XGLX *s, ALLEGRO_DISPLAY_XGLX *d, XEvent *e);
+void _al_x_end_touch_frame(void);
 
 #endif
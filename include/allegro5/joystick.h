@@ -81,6 +81,11 @@ AL_FUNC(int,            al_get_joystick_num_buttons,  (ALLEGRO_JOYSTICK *));
 AL_FUNC(const char*,    al_get_joystick_button_name,  (ALLEGRO_JOYSTICK *, int buttonn));
 
 AL_FUNC(void,           al_get_joystick_state,  (ALLEGRO_JOYSTICK *, ALLEGRO_JOYSTICK_STATE *ret_state));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(int,            al_get_joystick_state_history, (ALLEGRO_JOYSTICK *,
+   double since, ALLEGRO_JOYSTICK_STATE *ret_states, double *ret_timestamps,
+   int max));
+#endif
 
 AL_FUNC(ALLEGRO_EVENT_SOURCE *, al_get_joystick_event_source, (void));
 
@@ -51,6 +51,8 @@ AL_FUNC(const char *, al_keycode_to_name, (int keycode));
 AL_FUNC(void,         al_get_keyboard_state, (ALLEGRO_KEYBOARD_STATE *ret_state));
 #if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
 AL_FUNC(void,         al_clear_keyboard_state, (ALLEGRO_DISPLAY *display));
+AL_FUNC(int,          al_get_keyboard_state_history, (double since,
+   ALLEGRO_KEYBOARD_STATE *ret_states, double *ret_timestamps, int max));
 #endif
 AL_FUNC(bool,         al_key_down,           (const ALLEGRO_KEYBOARD_STATE *, int keycode));
 
@@ -67,6 +67,15 @@ AL_FUNC(void *, al_realloc_with_context, (void *ptr, size_t n,
 AL_FUNC(void *, al_calloc_with_context, (size_t count, size_t n,
    int line, const char *file, const char *func));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Frame arenas */
+AL_FUNC(void *, al_frame_alloc, (size_t size));
+AL_FUNC(size_t, al_get_frame_arena_mark, (void));
+AL_FUNC(void, al_rewind_frame_arena, (size_t mark));
+AL_FUNC(void, al_reset_frame_arena, (void));
+AL_FUNC(void, al_free_frame_arena, (void));
+#endif
+
 
 #ifdef __cplusplus
    }
@@ -68,6 +68,12 @@ AL_FUNC(int,            al_get_mouse_state_axis, (const ALLEGRO_MOUSE_STATE *sta
 AL_FUNC(bool, al_get_mouse_cursor_position, (int *ret_x, int *ret_y));
 AL_FUNC(bool, al_grab_mouse, (struct ALLEGRO_DISPLAY *display));
 AL_FUNC(bool, al_ungrab_mouse, (void));
+
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(int,            al_get_mouse_state_history, (double since,
+   ALLEGRO_MOUSE_STATE *ret_states, double *ret_timestamps, int max));
+#endif
+
 AL_FUNC(void, al_set_mouse_wheel_precision, (int precision));
 AL_FUNC(int, al_get_mouse_wheel_precision, (void));
 
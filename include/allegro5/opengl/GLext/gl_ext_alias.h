@@ -988,6 +988,15 @@
 #define glGetQueryIndexediv _al_glGetQueryIndexediv
 #endif
 
+#if defined _ALLEGRO_GL_ARB_buffer_storage
+#define glBufferStorage _al_glBufferStorage
+#endif
+
+#if defined _ALLEGRO_GL_ARB_get_program_binary
+#define glGetProgramBinary _al_glGetProgramBinary
+#define glProgramBinary _al_glProgramBinary
+#endif
+
 
 /*</ARB>*/
 
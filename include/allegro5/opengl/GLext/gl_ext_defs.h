@@ -2141,6 +2141,27 @@ typedef struct __GLsync *GLsync;
 #define GL_MAX_TRANSFORM_FEEDBACK_BUFFERS 0x8E70
 #endif
 
+#ifndef GL_ARB_buffer_storage
+#define GL_ARB_buffer_storage
+#define _ALLEGRO_GL_ARB_buffer_storage
+#define GL_MAP_PERSISTENT_BIT             0x0040
+#define GL_MAP_COHERENT_BIT               0x0080
+#define GL_DYNAMIC_STORAGE_BIT            0x0100
+#define GL_CLIENT_STORAGE_BIT             0x0200
+#define GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT 0x00004000
+#define GL_BUFFER_IMMUTABLE_STORAGE       0x821F
+#define GL_BUFFER_STORAGE_FLAGS           0x8220
+#endif
+
+#ifndef GL_ARB_get_program_binary
+#define GL_ARB_get_program_binary
+#define _ALLEGRO_GL_ARB_get_program_binary
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH          0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS     0x87FE
+#define GL_PROGRAM_BINARY_FORMATS         0x87FF
+#endif
+
 
 /* </ARB> */
 
@@ -5462,3 +5483,28 @@ typedef uint64_t GLuint64EXT;
 #define GL_AMD_conservative_depth
 #define _ALLEGRO_GL_AMD_conservative_depth
 #endif
+
+#ifndef GL_ARB_ES3_compatibility
+#define GL_ARB_ES3_compatibility
+#define _ALLEGRO_GL_ARB_ES3_compatibility
+/* reuse GL_COMPRESSED_RGB8_ETC2 and GL_COMPRESSED_RGBA8_ETC2_EAC */
+#endif
+
+#ifndef GL_KHR_texture_compression_astc_ldr
+#define GL_KHR_texture_compression_astc_ldr
+#define _ALLEGRO_GL_KHR_texture_compression_astc_ldr
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR   0x93B0
+#define GL_COMPRESSED_RGBA_ASTC_5x4_KHR   0x93B1
+#define GL_COMPRESSED_RGBA_ASTC_5x5_KHR   0x93B2
+#define GL_COMPRESSED_RGBA_ASTC_6x5_KHR   0x93B3
+#define GL_COMPRESSED_RGBA_ASTC_6x6_KHR   0x93B4
+#define GL_COMPRESSED_RGBA_ASTC_8x5_KHR   0x93B5
+#define GL_COMPRESSED_RGBA_ASTC_8x6_KHR   0x93B6
+#define GL_COMPRESSED_RGBA_ASTC_8x8_KHR   0x93B7
+#endif
+
+#ifndef GL_EXT_sRGB
+#define GL_EXT_sRGB
+#define _ALLEGRO_GL_EXT_sRGB
+/* OpenGL ES only, reuse GL_SRGB8_ALPHA8 */
+#endif
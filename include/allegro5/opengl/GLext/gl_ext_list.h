@@ -81,6 +81,8 @@ AGL_EXT(ARB_tessellation_shader,       4_0)
 AGL_EXT(ARB_texture_buffer_object_rgb32, 4_0)
 AGL_EXT(ARB_transform_feedback2,       4_0)
 AGL_EXT(ARB_transform_feedback3,       4_0)
+AGL_EXT(ARB_buffer_storage,            4_4)
+AGL_EXT(ARB_get_program_binary,        4_1)
 
 AGL_EXT(EXT_abgr,                      0)
 AGL_EXT(EXT_blend_color,             1_1)
@@ -357,3 +359,6 @@ AGL_EXT(NV_texture_barrier,            0)
 AGL_EXT(AMD_shader_stencil_export,     0)
 AGL_EXT(AMD_seamless_cubemap_per_texture, 0)
 AGL_EXT(AMD_conservative_depth,        0)
+AGL_EXT(ARB_ES3_compatibility,       4_3)
+AGL_EXT(KHR_texture_compression_astc_ldr, 0)
+AGL_EXT(EXT_sRGB,                      0)
@@ -513,3 +513,9 @@ typedef XID GLXVideoCaptureDeviceNV;
 #define GLX_CONTEXT_ES_PROFILE_BIT_EXT		0x00000004
 #define GLX_CONTEXT_ES2_PROFILE_BIT_EXT		0x00000004
 #endif
+
+#ifndef GLX_EXT_swap_control_tear
+#define GLX_EXT_swap_control_tear
+#define _ALLEGRO_GLX_EXT_swap_control_tear
+#define GLX_LATE_SWAPS_TEAR_EXT            0x20F3
+#endif
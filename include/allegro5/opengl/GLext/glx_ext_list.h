@@ -39,3 +39,4 @@ AGL_EXT(EXT_swap_control,             0)
 AGL_EXT(NV_copy_image,                0)
 AGL_EXT(INTEL_swap_event,             0)
 AGL_EXT(EXT_create_context_es_profile, 0)
+AGL_EXT(EXT_swap_control_tear,        0)
@@ -384,3 +384,8 @@ DECLARE_HANDLE(HVIDEOINPUTDEVICENV);
 #ifndef WGL_NV_copy_image
 #define WGL_NV_copy_image
 #endif
+
+#ifndef WGL_EXT_swap_control_tear
+#define WGL_EXT_swap_control_tear
+#define _ALLEGRO_WGL_EXT_swap_control_tear
+#endif
@@ -36,3 +36,4 @@ AGL_EXT(ARB_create_context,           0)
 AGL_EXT(AMD_gpu_association,          0)
 AGL_EXT(NV_copy_image,                0)
 AGL_EXT(NV_video_capture,             0)
+AGL_EXT(EXT_swap_control_tear,        0)
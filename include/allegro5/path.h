@@ -49,6 +49,11 @@ AL_FUNC(const char*, al_get_path_basename, (const ALLEGRO_PATH *path));
 
 AL_FUNC(bool, al_make_path_canonical, (ALLEGRO_PATH *path));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(void, al_assign_path, (ALLEGRO_PATH *path, const ALLEGRO_PATH *src));
+AL_FUNC(bool, al_assign_path_cstr, (ALLEGRO_PATH *path, const char *str));
+#endif
+
 
 #ifdef __cplusplus
    }
@@ -34,7 +34,9 @@ extern "C" {
 ALLEGRO_PATH *_al_unix_get_path(int id);
 double _al_unix_get_time(void);
 void _al_unix_rest(double seconds);
+void _al_unix_rest_until(double time);
 void _al_unix_init_timeout(ALLEGRO_TIMEOUT *timeout, double seconds);
+void _al_unix_init_timeout_until(ALLEGRO_TIMEOUT *timeout, double time);
 
 
 #ifdef __cplusplus
@@ -56,6 +58,7 @@ void _al_unix_init_timeout(ALLEGRO_TIMEOUT *timeout, double seconds);
 
 /* TODO: integrate this above */
 
+#include <sys/time.h>
 #include "allegro5/platform/aintuthr.h"
 
 
@@ -65,6 +68,7 @@ void _al_unix_init_timeout(ALLEGRO_TIMEOUT *timeout, double seconds);
 
 /* time */
 void _al_unix_init_time(void);
+double _al_unix_time_from_timeval(const struct timeval *tv);
 
 /* fdwatch */
 void _al_unix_start_watching_fd(int fd, void (*callback)(void *), void *cb_data);
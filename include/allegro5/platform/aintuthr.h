@@ -5,6 +5,8 @@
 #define __al_included_allegro5_aintuthr_h
 
 #include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 #include "allegro5/internal/aintern_thread.h"
 
 #ifdef __cplusplus
@@ -12,6 +14,16 @@
 #endif
 
 
+/* Timeouts and al_get_time use CLOCK_MONOTONIC where condition variables can
+ * wait on it, so that changing the system time does not affect them.
+ */
+#if defined(_POSIX_CLOCK_SELECTION) && (_POSIX_CLOCK_SELECTION > 0) && \
+    defined(_POSIX_MONOTONIC_CLOCK) && (_POSIX_MONOTONIC_CLOCK > 0) && \
+    !defined(ALLEGRO_MACOSX)
+   #define ALLEGRO_UNIX_MONOTONIC_CLOCK
+#endif
+
+
 /* threads */
 struct _AL_THREAD
 {
@@ -68,10 +80,7 @@ AL_INLINE(void, _al_mutex_unlock, (struct _AL_MUTEX *m),
       pthread_mutex_unlock(&m->mutex);
 })
 
-AL_INLINE(void, _al_cond_init, (struct _AL_COND *cond),
-{
-   pthread_cond_init(&cond->cond, NULL);
-})
+AL_FUNC(void, _al_cond_init, (struct _AL_COND *cond));
 
 AL_INLINE(void, _al_cond_destroy, (struct _AL_COND *cond),
 {
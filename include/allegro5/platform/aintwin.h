@@ -116,6 +116,7 @@ void _al_win_fix_modifiers(void);
 
 /* mouse routines */
 void _al_win_mouse_handle_move(int x, int y, bool abs, ALLEGRO_DISPLAY_WIN *win_disp);
+void _al_win_mouse_handle_raw_input(HRAWINPUT input, ALLEGRO_DISPLAY_WIN *win_disp);
 void _al_win_mouse_handle_wheel(int raw_dz, bool abs, ALLEGRO_DISPLAY_WIN *win_disp);
 void _al_win_mouse_handle_hwheel(int raw_dw, bool abs, ALLEGRO_DISPLAY_WIN *win_disp);
 void _al_win_mouse_handle_button(int button, bool down, int x, int y, bool abs, ALLEGRO_DISPLAY_WIN *win_disp);
@@ -282,6 +283,7 @@ void _al_win_touch_input_handle_begin(int id, size_t timestamp, float x, float y
 void _al_win_touch_input_handle_end(int id, size_t timestamp, float x, float y, bool primary, ALLEGRO_DISPLAY_WIN *win_disp);
 void _al_win_touch_input_handle_move(int id, size_t timestamp, float x, float y, bool primary, ALLEGRO_DISPLAY_WIN *win_disp);
 void _al_win_touch_input_handle_cancel(int id, size_t timestamp, float x, float y, bool primary, ALLEGRO_DISPLAY_WIN *win_disp);
+void _al_win_touch_input_end_frame(void);
 
 /* Helpers for getting Windows system errors 
  * May be called from addons 
@@ -292,7 +294,9 @@ AL_FUNC(const char*, _al_win_last_error, (void));
 /* Time handling */
 double _al_win_get_time(void);
 void _al_win_rest(double seconds);
+void _al_win_rest_until(double time);
 void _al_win_init_timeout(ALLEGRO_TIMEOUT *timeout, double seconds);
+double _al_win_message_input_time(ALLEGRO_EVENT_SOURCE *es);
 
 #ifdef __cplusplus
    }
@@ -7,6 +7,7 @@
 #cmakedefine ALLEGRO_IPHONE
 #cmakedefine ALLEGRO_ANDROID
 #cmakedefine ALLEGRO_RASPBERRYPI
+#cmakedefine ALLEGRO_KMS
 #cmakedefine ALLEGRO_CFG_NO_FPU
 #cmakedefine ALLEGRO_CFG_DLL_TLS
 #cmakedefine ALLEGRO_CFG_PTHREADS_TLS
@@ -50,6 +51,7 @@
 #cmakedefine ALLEGRO_HAVE_SYS_TYPES_H
 #cmakedefine ALLEGRO_HAVE_OSATOMIC_H
 #cmakedefine ALLEGRO_HAVE_SYS_INOTIFY_H
+#cmakedefine ALLEGRO_HAVE_SYS_EPOLL_H
 #cmakedefine ALLEGRO_HAVE_SAL_H
 
 /* Define to 1 if the corresponding functions are available. */
@@ -103,6 +105,9 @@
 /* Define if XScreenSaver extension is supported. */
 #cmakedefine ALLEGRO_XWINDOWS_WITH_XSCREENSAVER
 
+/* Define if MIT-SHM extension is supported. */
+#cmakedefine ALLEGRO_XWINDOWS_WITH_XSHM
+
 /* Define if XIM extension is supported. */
 #cmakedefine ALLEGRO_XWINDOWS_WITH_XIM
 
@@ -34,6 +34,11 @@
 /* Include configuration information.  */
 #include "allegro5/platform/alplatf.h"
 
+/* The DRM/KMS backend renders through EGL, never GLX. */
+#ifdef ALLEGRO_KMS
+#define ALLEGRO_EXCLUDE_GLX
+#endif
+
 /* Enable OpenGL if GLX is available. */
 #ifdef ALLEGRO_GLX
 #define ALLEGRO_CFG_OPENGL
@@ -48,6 +48,16 @@ typedef enum ALLEGRO_WRITE_MASK_FLAGS {
 
 AL_FUNC(void, al_set_render_state, (ALLEGRO_RENDER_STATE state, int value));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_DRAW_STATE
+ */
+typedef struct ALLEGRO_DRAW_STATE ALLEGRO_DRAW_STATE;
+
+AL_FUNC(ALLEGRO_DRAW_STATE *, al_create_draw_state, (void));
+AL_FUNC(void, al_destroy_draw_state, (ALLEGRO_DRAW_STATE *state));
+AL_FUNC(void, al_use_draw_state, (const ALLEGRO_DRAW_STATE *state));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
@@ -69,6 +69,12 @@ AL_FUNC(bool, al_set_shader_float_vector, (const char *name, int num_components,
    const float *f, int num_elems));
 AL_FUNC(bool, al_set_shader_bool, (const char *name, bool b));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(bool, al_set_shader_uniform_block, (const char *name, const void *data,
+   size_t size));
+AL_FUNC(void, al_set_shader_cache_path, (const char *path));
+#endif
+
 AL_FUNC(char const *, al_get_default_shader_source, (ALLEGRO_SHADER_PLATFORM platform,
    ALLEGRO_SHADER_TYPE type));
 
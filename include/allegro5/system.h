@@ -21,7 +21,8 @@ enum ALLEGRO_SYSTEM_ID {
   ALLEGRO_SYSTEM_ID_IPHONE = AL_ID('I', 'P', 'H', 'O'),
   ALLEGRO_SYSTEM_ID_GP2XWIZ = AL_ID('W', 'I', 'Z', ' '),
   ALLEGRO_SYSTEM_ID_RASPBERRYPI = AL_ID('R', 'A', 'S', 'P'),
-  ALLEGRO_SYSTEM_ID_SDL = AL_ID('S', 'D', 'L', '2')
+  ALLEGRO_SYSTEM_ID_SDL = AL_ID('S', 'D', 'L', '2'),
+  ALLEGRO_SYSTEM_ID_KMS = AL_ID('K', 'M', 'S', ' ')
 };
 typedef enum ALLEGRO_SYSTEM_ID ALLEGRO_SYSTEM_ID;
 
@@ -57,6 +58,29 @@ AL_FUNC(const char *, al_get_app_name, (void));
 
 AL_FUNC(bool, al_inhibit_screensaver, (bool inhibit));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(bool, al_set_profiling_enabled, (bool enabled));
+AL_FUNC(bool, al_is_profiling_enabled, (void));
+AL_FUNC(void, al_profile_begin, (const char *name));
+AL_FUNC(void, al_profile_end, (void));
+AL_FUNC(void, al_clear_profile, (void));
+AL_FUNC(bool, al_save_profile_trace, (const char *filename));
+AL_FUNC(bool, al_save_profile_trace_f, (ALLEGRO_FILE *f));
+
+/* Enum: ALLEGRO_THERMAL_STATE
+ */
+typedef enum ALLEGRO_THERMAL_STATE
+{
+   ALLEGRO_THERMAL_STATE_UNKNOWN = 0,
+   ALLEGRO_THERMAL_STATE_NOMINAL = 1,
+   ALLEGRO_THERMAL_STATE_FAIR = 2,
+   ALLEGRO_THERMAL_STATE_SERIOUS = 3,
+   ALLEGRO_THERMAL_STATE_CRITICAL = 4
+} ALLEGRO_THERMAL_STATE;
+
+AL_FUNC(ALLEGRO_THERMAL_STATE, al_get_thermal_state, (void));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
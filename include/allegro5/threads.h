@@ -17,6 +17,7 @@
 #define __al_included_allegro5_threads_h
 
 #include "allegro5/altime.h"
+#include "allegro5/events.h"
 
 #ifdef __cplusplus
    extern "C" {
@@ -62,6 +63,28 @@ AL_FUNC(int, al_wait_cond_until, (ALLEGRO_COND *cond, ALLEGRO_MUTEX *mutex,
 AL_FUNC(void, al_broadcast_cond, (ALLEGRO_COND *cond));
 AL_FUNC(void, al_signal_cond, (ALLEGRO_COND *cond));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_JOB_POOL
+ */
+typedef struct ALLEGRO_JOB_POOL ALLEGRO_JOB_POOL;
+
+/* Type: ALLEGRO_JOB
+ */
+typedef struct ALLEGRO_JOB ALLEGRO_JOB;
+
+AL_FUNC(ALLEGRO_JOB_POOL *, al_create_job_pool, (int num_threads));
+AL_FUNC(void, al_destroy_job_pool, (ALLEGRO_JOB_POOL *pool));
+AL_FUNC(ALLEGRO_JOB_POOL *, al_get_default_job_pool, (void));
+AL_FUNC(int, al_get_job_pool_size, (ALLEGRO_JOB_POOL *pool));
+AL_FUNC(ALLEGRO_EVENT_SOURCE *, al_get_job_pool_event_source,
+   (ALLEGRO_JOB_POOL *pool));
+AL_FUNC(ALLEGRO_JOB *, al_submit_job, (ALLEGRO_JOB_POOL *pool,
+   void *(*func)(void *arg), void *arg));
+AL_FUNC(bool, al_is_job_done, (ALLEGRO_JOB *job));
+AL_FUNC(void *, al_wait_job, (ALLEGRO_JOB *job));
+AL_FUNC(void, al_release_job, (ALLEGRO_JOB *job));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
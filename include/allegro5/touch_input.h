@@ -89,6 +89,10 @@ AL_FUNC(ALLEGRO_EVENT_SOURCE *, al_get_touch_input_event_source, (void));
 AL_FUNC(void,           al_set_mouse_emulation_mode,     (int mode));
 AL_FUNC(int,            al_get_mouse_emulation_mode,     (void));
 AL_FUNC(ALLEGRO_EVENT_SOURCE *, al_get_touch_input_mouse_emulation_event_source, (void));
+AL_FUNC(bool,           al_set_touch_input_frame_mode,   (bool onoff));
+AL_FUNC(bool,           al_get_touch_input_frame_mode,   (void));
+AL_FUNC(bool,           al_get_touch_input_frame,        (const ALLEGRO_EVENT *event, ALLEGRO_TOUCH_INPUT_STATE *ret_state));
+AL_FUNC(int,            al_get_touch_input_state_history, (double since, ALLEGRO_TOUCH_INPUT_STATE *ret_states, double *ret_timestamps, int max));
 #endif
 
 #ifdef __cplusplus
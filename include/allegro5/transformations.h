@@ -50,6 +50,13 @@ AL_FUNC(void, al_perspective_transform, (ALLEGRO_TRANSFORM *trans, float left, f
 AL_FUNC(void, al_horizontal_shear_transform, (ALLEGRO_TRANSFORM *trans, float theta));
 AL_FUNC(void, al_vertical_shear_transform, (ALLEGRO_TRANSFORM *trans, float theta));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(void, al_transform_coordinates_array, (const ALLEGRO_TRANSFORM *trans,
+   float *xy, int num, int stride));
+AL_FUNC(void, al_transform_coordinates_3d_array, (const ALLEGRO_TRANSFORM *trans,
+   float *xyz, int num, int stride));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
@@ -46,6 +46,22 @@ AL_FUNC(const ALLEGRO_USTR *, al_ref_buffer, (ALLEGRO_USTR_INFO *info, const cha
 AL_FUNC(const ALLEGRO_USTR *, al_ref_ustr, (ALLEGRO_USTR_INFO *info,
       const ALLEGRO_USTR *us, int start_pos, int end_pos));
 
+/* String arenas */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_USTR_ARENA
+ */
+typedef struct ALLEGRO_USTR_ARENA ALLEGRO_USTR_ARENA;
+
+AL_FUNC(ALLEGRO_USTR_ARENA *, al_create_ustr_arena, (void));
+AL_FUNC(void, al_destroy_ustr_arena, (ALLEGRO_USTR_ARENA *arena));
+AL_FUNC(const ALLEGRO_USTR *, al_ustr_new_in_arena, (ALLEGRO_USTR_ARENA *arena,
+      const char *s));
+AL_FUNC(const ALLEGRO_USTR *, al_ustr_new_from_buffer_in_arena,
+      (ALLEGRO_USTR_ARENA *arena, const char *s, size_t size));
+AL_FUNC(const ALLEGRO_USTR *, al_ustr_dup_in_arena, (ALLEGRO_USTR_ARENA *arena,
+      const ALLEGRO_USTR *us));
+#endif
+
 /* Sizes and offsets */
 AL_FUNC(size_t, al_ustr_size, (const ALLEGRO_USTR *us));
 AL_FUNC(size_t, al_ustr_length, (const ALLEGRO_USTR *us));
@@ -57,6 +73,10 @@ AL_FUNC(bool, al_ustr_prev, (const ALLEGRO_USTR *us, int *pos));
 AL_FUNC(int32_t, al_ustr_get, (const ALLEGRO_USTR *us, int pos));
 AL_FUNC(int32_t, al_ustr_get_next, (const ALLEGRO_USTR *us, int *pos));
 AL_FUNC(int32_t, al_ustr_prev_get, (const ALLEGRO_USTR *us, int *pos));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(int, al_ustr_decode_to_array, (const ALLEGRO_USTR *us, int *pos,
+      int32_t *out, int max));
+#endif
 
 /* Insert */
 AL_FUNC(bool, al_ustr_insert, (ALLEGRO_USTR *us1, int pos,
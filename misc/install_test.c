@@ -15,6 +15,7 @@
 #include <allegro5/allegro_color.h>
 #include <allegro5/allegro_physfs.h>
 #include <allegro5/allegro_memfile.h>
+#include <allegro5/allegro_perf.h>
 
 #include <stdio.h>
 
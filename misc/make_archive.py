@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""
+Pack a directory tree into an archive for al_open_archive.
+
+The layout is described at the top of src/file_archive.c. With --lz4, entries
+are compressed when that makes them smaller; this needs the Python "lz4"
+module.
+"""
+import optparse, os, struct, sys
+
+HEADER = struct.Struct("<8sIIQII")
+ENTRY = struct.Struct("<QQQIHBB")
+VERSION = 1
+COMPRESSION_NONE = 0
+COMPRESSION_LZ4 = 1
+ALIGN = 16
+
+def collect(root):
+    """
+    Return a list of (name, path) for all files below root, with names
+    relative to root, '/'-separated and sorted bytewise.
+    """
+    files = []
+    for dirpath, dirnames, filenames in os.walk(root):
+        for filename in filenames:
+            path = os.path.join(dirpath, filename)
+            name = os.path.relpath(path, root).replace(os.sep, "/")
+            files.append((name.encode("utf8"), path))
+    files.sort()
+    return files
+
+def main(argv):
+    p = optparse.OptionParser(usage="%prog [options] archive directory")
+    p.add_option("--lz4", action="store_true",
+        help="compress entries with LZ4")
+    options, args = p.parse_args(argv)
+    if len(args) != 2:
+        p.error("expected an archive and a directory")
+
+    compress = None
+    if options.lz4:
+        import lz4.block
+        compress = lambda data: lz4.block.compress(data, store_size=False)
+
+    entries = []
+    names = b""
+    with open(args[0], "wb") as out:
+        out.write(b"\0" * HEADER.size)
+        for name, path in collect(args[1]):
+            if len(name) >= 1024:
+                sys.stderr.write("Name too long: %s\n" % path)
+                return 1
+            with open(path, "rb") as f:
+                data = f.read()
+            stored, compression = data, COMPRESSION_NONE
+            if compress and data:
+                packed = compress(data)
+                if len(packed) < len(data):
+                    stored, compression = packed, COMPRESSION_LZ4
+
+            out.write(b"\0" * (-out.tell() % ALIGN))
+            entries.append(ENTRY.pack(out.tell(), len(data), len(stored),
+                len(names), len(name), compression, 0))
+            names += name
+            out.write(stored)
+
+        index_offset = out.tell()
+        for entry in entries:
+            out.write(entry)
+        out.write(names)
+        out.seek(0)
+        out.write(HEADER.pack(b"AL5ARCH\0", VERSION, len(entries),
+            index_offset, len(names), 0))
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -68,7 +68,7 @@ def make_drawer(name):
          x1 += target->xofs;
          x2 += target->xofs;
          y += target->yofs;
-         target = target->parent;
+         target = _AL_LOCK_HOLDER(target);
       }
 
       x1 -= target->lock_x;
@@ -106,22 +106,12 @@ def make_drawer(name):
       """)
 
    print("{")
-   if shade:
-      print("""\
-      int op, src_mode, dst_mode;
-      int op_alpha, src_alpha, dst_alpha;
-      ALLEGRO_COLOR const_color;
-      al_get_separate_bitmap_blender(&op, &src_mode, &dst_mode,
-         &op_alpha, &src_alpha, &dst_alpha);
-      const_color = al_get_blend_color();
-      """)
-
    print("{")
    if texture:
       print("""\
       const int offset_x = s->texture->parent ? s->texture->xofs : 0;
       const int offset_y = s->texture->parent ? s->texture->yofs : 0;
-      ALLEGRO_BITMAP* texture = s->texture->parent ? s->texture->parent : s->texture;
+      ALLEGRO_BITMAP* texture = _AL_LOCK_HOLDER(s->texture);
       const int src_format = texture->locked_region.format;
       const int src_size = texture->locked_region.pixel_size;
 
@@ -142,44 +132,6 @@ def make_drawer(name):
          + x1 * target->locked_region.pixel_size;
       """)
 
-   if shade:
-      make_if_blender_loop(
-            op='ALLEGRO_ADD',
-            src_mode='ALLEGRO_ONE',
-            src_alpha='ALLEGRO_ONE',
-            op_alpha='ALLEGRO_ADD',
-            dst_mode='ALLEGRO_INVERSE_ALPHA',
-            dst_alpha='ALLEGRO_INVERSE_ALPHA',
-            const_color='NULL',
-            if_format='ALLEGRO_PIXEL_FORMAT_ARGB_8888',
-            alpha_only=True
-            )
-      print("else")
-      make_if_blender_loop(
-            op='ALLEGRO_ADD',
-            src_mode='ALLEGRO_ALPHA',
-            src_alpha='ALLEGRO_ALPHA',
-            op_alpha='ALLEGRO_ADD',
-            dst_mode='ALLEGRO_INVERSE_ALPHA',
-            dst_alpha='ALLEGRO_INVERSE_ALPHA',
-            const_color='NULL',
-            if_format='ALLEGRO_PIXEL_FORMAT_ARGB_8888',
-            alpha_only=True
-            )
-      print("else")
-      make_if_blender_loop(
-            op='ALLEGRO_ADD',
-            src_mode='ALLEGRO_ONE',
-            src_alpha='ALLEGRO_ONE',
-            op_alpha='ALLEGRO_ADD',
-            dst_mode='ALLEGRO_ONE',
-            dst_alpha='ALLEGRO_ONE',
-            const_color='NULL',
-            if_format='ALLEGRO_PIXEL_FORMAT_ARGB_8888',
-            alpha_only=True
-            )
-      print("else")
-
    if opaque and white:
       make_loop(copy_format=True, src_size='4')
       print("else")
@@ -202,68 +154,12 @@ def make_drawer(name):
    }
    """)
 
-def make_if_blender_loop(
-      op='op',
-      src_mode='src_mode',
-      dst_mode='dst_mode',
-      op_alpha='op_alpha',
-      src_alpha='src_alpha',
-      dst_alpha='dst_alpha',
-      src_format='src_format',
-      dst_format='dst_format',
-      const_color='NULL',
-      if_format=None,
-      alpha_only=False
-      ):
-   print(interp("""\
-      if (op == #{op} &&
-            src_mode == #{src_mode} &&
-            src_alpha == #{src_alpha} &&
-            op_alpha == #{op_alpha} &&
-            dst_mode == #{dst_mode} &&
-            dst_alpha == #{dst_alpha}) {
-      """))
-
-   if texture and if_format:
-      make_loop(
-            op=op,
-            src_mode=src_mode,
-            src_alpha=src_alpha,
-            op_alpha=op_alpha,
-            dst_mode=dst_mode,
-            dst_alpha=dst_alpha,
-            const_color=const_color,
-            if_format=if_format,
-            alpha_only=alpha_only
-            )
-      print("else")
-
-   make_loop(
-      op=op,
-      src_mode=src_mode,
-      src_alpha=src_alpha,
-      op_alpha=op_alpha,
-      dst_mode=dst_mode,
-      dst_alpha=dst_alpha,
-      const_color=const_color,
-      alpha_only=alpha_only)
-
-   print("}")
-
 def make_loop(
-      op='op',
-      src_mode='src_mode',
-      dst_mode='dst_mode',
-      op_alpha='op_alpha',
-      src_alpha='src_alpha',
-      dst_alpha='dst_alpha',
       src_format='src_format',
       dst_format='dst_format',
       src_size='src_size',
-      const_color='&const_color',
       if_format=None,
-      copy_format=False,
-      alpha_only=False
+      copy_format=False
       ):
 
    if if_format:
@@ -298,53 +194,29 @@ def make_loop(
             if (end_u >= 0 && end_u < s->w && end_v >= 0 && end_v < s->h) {
             """)
          make_innermost_loop(
-            op=op,
-            src_mode=src_mode,
-            dst_mode=dst_mode,
-            op_alpha=op_alpha,
-            src_alpha=src_alpha,
-            dst_alpha=dst_alpha,
             src_format=src_format,
             dst_format=dst_format,
-            const_color=const_color,
             src_size=src_size,
             copy_format=copy_format,
-            tiling=False,
-            alpha_only=alpha_only
+            tiling=False
             )
          print("} else")
 
    make_innermost_loop(
-      op=op,
-      src_mode=src_mode,
-      dst_mode=dst_mode,
-      op_alpha=op_alpha,
-      src_alpha=src_alpha,
-      dst_alpha=dst_alpha,
       src_format=src_format,
       dst_format=dst_format,
-      const_color=const_color,
       src_size=src_size,
-      copy_format=copy_format,
-      alpha_only=alpha_only
+      copy_format=copy_format
       )
 
    print("}")
 
 def make_innermost_loop(
-      op='op',
-      src_mode='src_mode',
-      dst_mode='dst_mode',
-      op_alpha='op_alpha',
-      src_alpha='src_alpha',
-      dst_alpha='dst_alpha',
       src_format='src_format',
       dst_format='dst_format',
-      const_color='&const_color',
       src_size='src_size',
       copy_format=False,
-      tiling=True,
-      alpha_only=True
+      tiling=True
       ):
 
    print("{")
@@ -369,7 +241,20 @@ def make_innermost_loop(
             """)
          uu_ofs = vv_ofs = "0"
 
-   print("for (; x1 <= x2; x1++) {")
+   if shade:
+      # Gather up to _AL_BLEND_SPAN_SIZE source and destination colors, then
+      # blend them all with a single call.
+      print("""\
+         while (x1 <= x2) {
+            ALLEGRO_COLOR src_span[_AL_BLEND_SPAN_SIZE];
+            ALLEGRO_COLOR dst_span[_AL_BLEND_SPAN_SIZE];
+            uint8_t *span_data = dst_data;
+            const int n = _ALLEGRO_MIN(x2 - x1 + 1, _AL_BLEND_SPAN_SIZE);
+            int i;
+
+            for (i = 0; i < n; i++) {""")
+   else:
+      print("for (; x1 <= x2; x1++) {")
 
    if not texture:
       print("""\
@@ -421,20 +306,9 @@ def make_innermost_loop(
          }
          """))
    elif shade:
-      blend = "_al_blend_inline"
-      if alpha_only:
-         blend = "_al_blend_alpha_inline"
       print(interp("""\
-         {
-            ALLEGRO_COLOR dst_color;
-            ALLEGRO_COLOR result;
-            _AL_INLINE_GET_PIXEL(#{dst_format}, dst_data, dst_color, false);
-            #{blend}(&src_color, &dst_color,
-               #{op}, #{src_mode}, #{dst_mode},
-               #{op_alpha}, #{src_alpha}, #{dst_alpha},
-               #{const_color}, &result);
-            _AL_INLINE_PUT_PIXEL(#{dst_format}, dst_data, result, true);
-         }
+         src_span[i] = src_color;
+         _AL_INLINE_GET_PIXEL(#{dst_format}, dst_data, dst_span[i], true);
          """))
    else:
       print(interp("""\
@@ -468,6 +342,17 @@ def make_innermost_loop(
          cur_color.a += gs->color_dx.a;
          """)
 
+   if shade:
+      print(interp("""\
+            }
+
+            s->blender->blend_span(s->blender, src_span, dst_span, n);
+
+            for (i = 0; i < n; i++) {
+               _AL_INLINE_PUT_PIXEL(#{dst_format}, span_data, dst_span[i], true);
+            }
+            x1 += n;"""))
+
    print("""\
       }
    }""")
@@ -414,6 +414,7 @@ _add_dll("allegro_ttf")
 _add_dll("allegro_image")
 _add_dll("allegro_dialog")
 _add_dll("allegro_memfile")
+_add_dll("allegro_perf")
 _add_dll("allegro_physfs")
 _add_dll("allegro_shader")
 _add_dll("allegro_main")
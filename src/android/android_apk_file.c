@@ -1,3 +1,6 @@
+#include <stdio.h>
+#include <unistd.h>
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_android.h"
 #include "allegro5/internal/aintern_android.h"
@@ -7,11 +10,19 @@
 ALLEGRO_DEBUG_CHANNEL("android")
 
 
+/* Assets are read with the NDK asset manager, so no access goes through
+ * Java. Uncompressed assets, which is what the build tools store most file
+ * types as, are mapped into memory and read straight from there.
+ */
 typedef struct ALLEGRO_FILE_APK ALLEGRO_FILE_APK;
 
 struct ALLEGRO_FILE_APK
 {
-   jobject apk;
+   AAsset *asset;
+   const char *buffer;  /* the mapped data, or NULL to use AAsset_read */
+   int64_t size;
+   int64_t pos;         /* only used with the buffer */
+   bool eof_indicator;
    bool error_indicator;
 };
 
@@ -32,110 +43,106 @@ static void apk_set_errno(ALLEGRO_FILE_APK *fp)
 }
 
 
-static jobject APK_openRead(const char *filename)
-{
-   JNIEnv *jnienv;
-   jmethodID ctor;
-   jstring str;
-   jobject is, ref;
-   jboolean res;
-
-   jnienv = _al_android_get_jnienv();
-   ctor = _jni_call(jnienv, jclass, GetMethodID,
-      _al_android_apk_stream_class(), "<init>",
-      "(L" ALLEGRO_ANDROID_PACKAGE_NAME_SLASH "/AllegroActivity;Ljava/lang/String;)V");
-   str = (*jnienv)->NewStringUTF(jnienv, filename);
-
-   ref = _jni_call(jnienv, jobject, NewObject, _al_android_apk_stream_class(),
-      ctor, _al_android_activity_object(), str);
-
-   is = _jni_call(jnienv, jobject, NewGlobalRef, ref);
-   _jni_callv(jnienv, DeleteLocalRef, ref);
-   _jni_callv(jnienv, DeleteLocalRef, str);
-
-   res = _jni_callBooleanMethodV(_al_android_get_jnienv(), is, "open", "()Z");
-
-   return (res) ? is : NULL;
-}
-
-
-static bool APK_close(jobject apk_stream)
+/* simplify_path:
+ *  The asset manager does not interpret the path, so remove empty, "." and
+ *  ".." components and the leading slash here. The result is no longer
+ *  than the input.
+ */
+static void simplify_path(const char *path, char *out)
 {
-   jboolean ret = _jni_callBooleanMethodV(_al_android_get_jnienv(), apk_stream,
-      "close", "()Z");
-   _jni_callv(_al_android_get_jnienv(), DeleteGlobalRef, apk_stream);
-
-   if (ret) {
-      apk_set_errno(NULL);
+   char *o = out;
+
+   while (*path) {
+      const char *end = strchr(path, '/');
+      size_t len = end ? (size_t)(end - path) : strlen(path);
+
+      if (len == 0 || (len == 1 && path[0] == '.')) {
+         /* skip */
+      }
+      else if (len == 2 && path[0] == '.' && path[1] == '.') {
+         while (o > out && o[-1] != '/')
+            o--;
+         if (o > out)
+            o--;
+      }
+      else {
+         if (o > out)
+            *o++ = '/';
+         memcpy(o, path, len);
+         o += len;
+      }
+
+      path += len;
+      if (*path == '/')
+         path++;
    }
-   return ret;
-}
-
-
-static bool APK_seek(jobject apk_stream, long bytes)
-{
-   jboolean res = _jni_callBooleanMethodV(_al_android_get_jnienv(),
-      apk_stream, "seek", "(J)Z", (jlong)bytes);
-   return res;
-}
 
-
-static long APK_tell(jobject apk_stream)
-{
-   long res = _jni_callLongMethodV(_al_android_get_jnienv(),
-      apk_stream, "tell", "()J");
-   return res;
+   *o = '\0';
 }
 
 
-static int APK_read(jobject apk_stream, char *buf, int len)
+/* map_asset:
+ *  Return the data of the asset if it can be mapped rather than
+ *  decompressed into memory. Only uncompressed assets have a file
+ *  descriptor.
+ */
+static const char *map_asset(AAsset *asset)
 {
-   JNIEnv *jnienv = _al_android_get_jnienv();
-
-   jbyteArray b = (*jnienv)->NewByteArray(jnienv, len);
-
-   jint res = _jni_callIntMethodV(jnienv, apk_stream, "read", "([B)I", b);
-
-   if (res > 0) {
-      (*jnienv)->GetByteArrayRegion(jnienv, b, 0, res, (jbyte *)buf);
-   }
-
-   _jni_callv(jnienv, DeleteLocalRef, b);
-
-   return res;
-}
+   off64_t start, length;
+   int fd;
 
+   fd = AAsset_openFileDescriptor64(asset, &start, &length);
+   if (fd < 0)
+      return NULL;
+   close(fd);
 
-static long APK_size(jobject apk_stream)
-{
-   long res = _jni_callLongMethod(_al_android_get_jnienv(), apk_stream, "size");
-   return res;
+   return AAsset_getBuffer(asset);
 }
 
 
 static void *file_apk_fopen(const char *filename, const char *mode)
 {
    ALLEGRO_FILE_APK *fp;
-   jobject apk;
+   AAssetManager *mgr;
+   AAsset *asset;
+   char *name;
 
-   if (streq(mode, "r") || streq(mode, "rb"))
-      apk = APK_openRead(filename);
-   else
+   if (!streq(mode, "r") && !streq(mode, "rb"))
       return NULL;
 
-   if (!apk) {
+   mgr = _al_android_asset_manager();
+   if (!mgr) {
+      apk_set_errno(NULL);
+      return NULL;
+   }
+
+   name = al_malloc(strlen(filename) + 1);
+   if (!name) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+   simplify_path(filename, name);
+   asset = AAssetManager_open(mgr, name, AASSET_MODE_RANDOM);
+   if (!asset) {
+      ALLEGRO_DEBUG("Could not open asset %s\n", name);
+      al_free(name);
       apk_set_errno(NULL);
       return NULL;
    }
+   al_free(name);
 
    fp = al_malloc(sizeof(*fp));
    if (!fp) {
       al_set_errno(ENOMEM);
-      APK_close(apk);
+      AAsset_close(asset);
       return NULL;
    }
 
-   fp->apk = apk;
+   fp->asset = asset;
+   fp->buffer = map_asset(asset);
+   fp->size = AAsset_getLength64(asset);
+   fp->pos = 0;
+   fp->eof_indicator = false;
    fp->error_indicator = false;
 
    return fp;
@@ -145,29 +152,43 @@ static void *file_apk_fopen(const char *filename, const char *mode)
 static bool file_apk_fclose(ALLEGRO_FILE *f)
 {
    ALLEGRO_FILE_APK *fp = cast_stream(f);
-   bool ret;
-
-   ret = APK_close(fp->apk);
 
+   AAsset_close(fp->asset);
    al_free(fp);
 
-   return ret;
+   return true;
 }
 
 
 static size_t file_apk_fread(ALLEGRO_FILE *f, void *buf, size_t buf_size)
 {
    ALLEGRO_FILE_APK *fp = cast_stream(f);
-   int n;
+   size_t n;
 
    if (buf_size == 0)
       return 0;
 
-   n = APK_read(fp->apk, buf, buf_size);
-   if (n < 0) {
-      apk_set_errno(fp);
-      return 0;
+   if (fp->buffer) {
+      n = 0;
+      if (fp->pos < fp->size) {
+         n = fp->size - fp->pos;
+         if (n > buf_size)
+            n = buf_size;
+         memcpy(buf, fp->buffer + fp->pos, n);
+         fp->pos += n;
+      }
+   }
+   else {
+      int res = AAsset_read(fp->asset, buf, buf_size);
+      if (res < 0) {
+         apk_set_errno(fp);
+         return 0;
+      }
+      n = res;
    }
+
+   if (n < buf_size)
+      fp->eof_indicator = true;
    return n;
 }
 
@@ -194,14 +215,17 @@ static bool file_apk_fflush(ALLEGRO_FILE *f)
 static int64_t file_apk_ftell(ALLEGRO_FILE *f)
 {
    ALLEGRO_FILE_APK *fp = cast_stream(f);
-   return APK_tell(fp->apk);
+
+   if (fp->buffer)
+      return fp->pos;
+   return fp->size - AAsset_getRemainingLength64(fp->asset);
 }
 
 
 static bool file_apk_seek(ALLEGRO_FILE *f, int64_t offset, int whence)
 {
    ALLEGRO_FILE_APK *fp = cast_stream(f);
-   long base;
+   int64_t base;
 
    switch (whence) {
       case ALLEGRO_SEEK_SET:
@@ -209,19 +233,11 @@ static bool file_apk_seek(ALLEGRO_FILE *f, int64_t offset, int whence)
          break;
 
       case ALLEGRO_SEEK_CUR:
-         base = APK_tell(fp->apk);
-         if (base < 0) {
-            apk_set_errno(fp);
-            return false;
-         }
+         base = file_apk_ftell(f);
          break;
 
       case ALLEGRO_SEEK_END:
-         base = APK_size(fp->apk);
-         if (base < 0) {
-            apk_set_errno(fp);
-            return false;
-         }
+         base = fp->size;
          break;
 
       default:
@@ -229,11 +245,20 @@ static bool file_apk_seek(ALLEGRO_FILE *f, int64_t offset, int whence)
          return false;
    }
 
-   if (!APK_seek(fp->apk, base + offset)) {
+   if (base + offset < 0) {
+      al_set_errno(EINVAL);
+      return false;
+   }
+
+   if (fp->buffer) {
+      fp->pos = base + offset;
+   }
+   else if (AAsset_seek64(fp->asset, base + offset, SEEK_SET) < 0) {
       apk_set_errno(fp);
       return false;
    }
 
+   fp->eof_indicator = false;
    return true;
 }
 
@@ -241,9 +266,8 @@ static bool file_apk_seek(ALLEGRO_FILE *f, int64_t offset, int whence)
 static bool file_apk_feof(ALLEGRO_FILE *f)
 {
    ALLEGRO_FILE_APK *fp = cast_stream(f);
-   jboolean res = _jni_callBooleanMethodV(_al_android_get_jnienv(), fp->apk,
-      "eof", "()Z");
-   return res;
+
+   return fp->eof_indicator;
 }
 
 
@@ -267,13 +291,14 @@ static void file_apk_fclearerr(ALLEGRO_FILE *f)
    ALLEGRO_FILE_APK *fp = cast_stream(f);
 
    fp->error_indicator = false;
+   fp->eof_indicator = false;
 }
 
 
 static off_t file_apk_fsize(ALLEGRO_FILE *f)
 {
    ALLEGRO_FILE_APK *fp = cast_stream(f);
-   return APK_size(fp->apk);
+   return fp->size;
 }
 
 
@@ -55,7 +55,12 @@ JNI_FUNC(void, AllegroSurface, nativeOnCreate, (JNIEnv *env, jobject obj))
    d->recreate = true;
 }
 
-JNI_FUNC(bool, AllegroSurface, nativeOnDestroy, (JNIEnv *env, jobject obj))
+/* What AllegroSurface.surfaceDestroyed has to do with EGL afterwards. */
+#define SURFACE_NOT_CREATED   0
+#define SURFACE_TERMINATE     1
+#define SURFACE_KEEP_CONTEXT  2
+
+JNI_FUNC(jint, AllegroSurface, nativeOnDestroy, (JNIEnv *env, jobject obj))
 {
    ALLEGRO_SYSTEM *sys = (void *)al_get_system_driver();
    ASSERT(sys != NULL);
@@ -72,15 +77,21 @@ JNI_FUNC(bool, AllegroSurface, nativeOnDestroy, (JNIEnv *env, jobject obj))
 
    if (!display->created) {
       ALLEGRO_DEBUG("Display creation failed, not sending HALT");
-      return false;
+      return SURFACE_NOT_CREATED;
    }
 
    display->created = false;
 
    if (display->is_destroy_display) {
-      return true;
+      display->context_kept = false;
+      return SURFACE_TERMINATE;
    }
 
+   /* Only the window surface goes away, so the textures stay valid unless
+    * the context gets lost anyway, see _al_android_init_display.
+    */
+   display->context_kept = display->preserve_context;
+
    ALLEGRO_DEBUG("locking display event source: %p %p", d, &d->es);
 
    _al_event_source_lock(&d->es);
@@ -102,7 +113,7 @@ JNI_FUNC(bool, AllegroSurface, nativeOnDestroy, (JNIEnv *env, jobject obj))
 
    ALLEGRO_DEBUG("AllegroSurface_nativeOnDestroy end");
 
-   return true;
+   return display->context_kept ? SURFACE_KEEP_CONTEXT : SURFACE_TERMINATE;
 }
 
 // FIXME: need to loop over the display list looking for the right surface
@@ -248,6 +259,23 @@ static bool _al_android_init_display(JNIEnv *env,
    ASSERT(system != NULL);
    ASSERT(display != NULL);
 
+   if (display->context_kept) {
+      ALLEGRO_DEBUG("calling egl_createSurface for the kept context");
+      if (_jni_callBooleanMethodV(env, display->surface_object,
+            "egl_createSurface", "()Z"))
+      {
+         return true;
+      }
+
+      /* The system may still throw the context away, e.g. under memory
+       * pressure. Start over, and restore the bitmaps from memory.
+       */
+      ALLEGRO_WARN("The EGL context was lost, creating a new one.\n");
+      _jni_callVoidMethodV(env, display->surface_object,
+         "egl_Terminate", "()V");
+      display->context_kept = false;
+   }
+
    ALLEGRO_DEBUG("calling egl_Init");
 
    if (!_jni_callBooleanMethodV(env, display->surface_object,
@@ -542,6 +570,10 @@ static ALLEGRO_DISPLAY *android_create_display(int w, int h)
    d->recreate = true;
    d->first_run = true;
    d->failed = false;
+   const char *value = al_get_config_value(al_get_system_config(), "opengl",
+      "android_preserve_context");
+   d->preserve_context = value && _al_stricmp(value, "true") == 0;
+   d->context_kept = false;
 
    ALLEGRO_SYSTEM *system = (void *)al_get_system_driver();
    ASSERT(system != NULL);
@@ -597,6 +629,8 @@ static void android_destroy_display(ALLEGRO_DISPLAY *dpy)
 {
    ALLEGRO_DISPLAY_ANDROID *d = (ALLEGRO_DISPLAY_ANDROID*)dpy;
 
+   _al_android_close_frame_time_hint(d);
+
    ALLEGRO_DEBUG("clear current");
 
    if (!d->created) {
@@ -685,15 +719,20 @@ static void android_flip_display(ALLEGRO_DISPLAY *dpy)
    ALLEGRO_BITMAP *old_target = al_get_target_bitmap();
    al_set_target_backbuffer(dpy);
 
+   _al_android_report_frame_work((ALLEGRO_DISPLAY_ANDROID *)dpy);
+
    _jni_callVoidMethod(_al_android_get_jnienv(),
       ((ALLEGRO_DISPLAY_ANDROID *)dpy)->surface_object, "egl_SwapBuffers");
 
+   _al_android_begin_frame_work((ALLEGRO_DISPLAY_ANDROID *)dpy);
+
    al_set_target_bitmap(old_target);
 
    /* Backup bitmaps created without ALLEGRO_NO_PRESERVE_TEXTURE that are
-    * dirty, to system memory.
+    * dirty, to system memory. Not needed if the context outlives pauses.
     */
-   al_backup_dirty_bitmaps(dpy);
+   if (!((ALLEGRO_DISPLAY_ANDROID *)dpy)->preserve_context)
+      al_backup_dirty_bitmaps(dpy);
 }
 
 static void android_update_display_region(ALLEGRO_DISPLAY *dpy, int x, int y,
@@ -816,10 +855,11 @@ static bool android_hide_mouse_cursor(ALLEGRO_DISPLAY *dpy)
 
 static void android_acknowledge_drawing_halt(ALLEGRO_DISPLAY *dpy)
 {
+   ALLEGRO_DISPLAY_ANDROID *d = (ALLEGRO_DISPLAY_ANDROID *)dpy;
    int i;
    ALLEGRO_DEBUG("android_acknowledge_drawing_halt");
 
-   for (i = 0; i < (int)dpy->bitmaps._size; i++) {
+   for (i = 0; i < (int)dpy->bitmaps._size && !d->context_kept; i++) {
       ALLEGRO_BITMAP **bptr = _al_vector_ref(&dpy->bitmaps, i);
       ALLEGRO_BITMAP *bmp = *bptr;
       int bitmap_flags = al_get_bitmap_flags(bmp);
@@ -835,8 +875,6 @@ static void android_acknowledge_drawing_halt(ALLEGRO_DISPLAY *dpy)
       }
    }
 
-   ALLEGRO_DISPLAY_ANDROID *d = (ALLEGRO_DISPLAY_ANDROID *)dpy;
-
    _al_android_clear_current(_al_android_get_jnienv(), d);
 
    /* XXX mutex? */
@@ -866,6 +904,14 @@ static void android_acknowledge_drawing_resume(ALLEGRO_DISPLAY *dpy)
 
    ALLEGRO_DEBUG("made current");
 
+   if (d->context_kept) {
+      /* Textures, FBOs and shaders are all still there. */
+      dpy->vt->update_transformation(dpy, al_get_target_bitmap());
+      android_broadcast_resume(d);
+      ALLEGRO_DEBUG("acknowledge_drawing_resume end (context kept)");
+      return;
+   }
+
    if (dpy->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
       dpy->default_shader = _al_create_default_shader(dpy->flags);
    }
@@ -939,6 +985,7 @@ ALLEGRO_DISPLAY_INTERFACE *_al_get_android_display_driver(void)
    vt->get_window_position = android_get_window_position;
    vt->set_display_flag = android_set_display_flag;
    vt->wait_for_vsync = android_wait_for_vsync;
+   vt->set_frame_time_hint = _al_android_set_frame_time_hint;
 
    vt->set_mouse_cursor = android_set_mouse_cursor;
    vt->set_system_mouse_cursor = android_set_system_mouse_cursor;
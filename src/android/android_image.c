@@ -18,10 +18,75 @@
 #include "allegro5/internal/aintern_android.h"
 #include "allegro5/internal/aintern_bitmap.h"
 
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
 #include <jni.h>
+#include <android/bitmap.h>
 
 ALLEGRO_DEBUG_CHANNEL("android")
 
+/* ANDROID_IMAGE_DECODER_SUCCESS */
+#define IMAGE_DECODER_SUCCESS 0
+
+/* The NDK's AImageDecoder only exists from API level 30, so it is looked
+ * up at run time to keep working on older devices. It decodes straight
+ * into the bitmap, without going through Java.
+ */
+static struct {
+   bool available;
+   int (*create_from_buffer)(const void *buffer, size_t length,
+      void **decoder);
+   const void *(*get_header_info)(const void *decoder);
+   int32_t (*get_width)(const void *info);
+   int32_t (*get_height)(const void *info);
+   int (*set_format)(void *decoder, int32_t format);
+   int (*set_unpremultiplied)(void *decoder, bool required);
+   int (*set_target_size)(void *decoder, int32_t width, int32_t height);
+   size_t (*get_minimum_stride)(void *decoder);
+   int (*decode)(void *decoder, void *pixels, size_t stride, size_t size);
+   void (*destroy)(void *decoder);
+} image_decoder;
+
+static pthread_once_t image_decoder_once = PTHREAD_ONCE_INIT;
+
+static void init_image_decoder(void)
+{
+   void *lib = dlopen("libjnigraphics.so", RTLD_NOW);
+   if (!lib)
+      return;
+
+#define GET(field, name) \
+   (*(void **)&image_decoder.field = dlsym(lib, name))
+
+   if (GET(create_from_buffer, "AImageDecoder_createFromBuffer") &&
+       GET(get_header_info, "AImageDecoder_getHeaderInfo") &&
+       GET(get_width, "AImageDecoderHeaderInfo_getWidth") &&
+       GET(get_height, "AImageDecoderHeaderInfo_getHeight") &&
+       GET(set_format, "AImageDecoder_setAndroidBitmapFormat") &&
+       GET(set_unpremultiplied, "AImageDecoder_setUnpremultipliedRequired") &&
+       GET(set_target_size, "AImageDecoder_setTargetSize") &&
+       GET(get_minimum_stride, "AImageDecoder_getMinimumStride") &&
+       GET(decode, "AImageDecoder_decodeImage") &&
+       GET(destroy, "AImageDecoder_delete")) {
+      ALLEGRO_INFO("Using AImageDecoder.\n");
+      image_decoder.available = true;
+   }
+
+#undef GET
+
+   /* The library stays loaded if the decoder is used. */
+   if (!image_decoder.available)
+      dlclose(lib);
+}
+
+bool _al_android_have_image_decoder(void)
+{
+   pthread_once(&image_decoder_once, init_image_decoder);
+   return image_decoder.available;
+}
+
 static void
 copy_bitmap_data(ALLEGRO_BITMAP *bitmap,
    const uint32_t *src, ALLEGRO_PIXEL_FORMAT src_format, int src_pitch,
@@ -112,8 +177,147 @@ copy_bitmap_data_demultiply_alpha(ALLEGRO_BITMAP *bitmap, const uint32_t *src,
    al_unlock_bitmap(bitmap);
 }
 
-/* Note: This is not used when loading an image from the .apk.
- * 
+/* get_max_decode_size:
+ *  Return the size that images are scaled down to fit while they are
+ *  decoded, or 0 to keep them as they are.
+ */
+static int get_max_decode_size(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "image",
+      "android_max_size");
+   ALLEGRO_DISPLAY *display;
+
+   if (!value || value[0] == '\0')
+      return 0;
+   if (strcmp(value, "display") != 0)
+      return atoi(value);
+
+   display = al_get_current_display();
+   if (!display || (al_get_new_bitmap_flags() & ALLEGRO_MEMORY_BITMAP))
+      return 0;
+   return al_get_display_option(display, ALLEGRO_MAX_BITMAP_SIZE);
+}
+
+/* read_file:
+ *  Read the rest of the file into memory, since that is what the decoder
+ *  takes.
+ */
+static uint8_t *read_file(ALLEGRO_FILE *fh, size_t *ret_size)
+{
+   int64_t fsize = al_fsize(fh);
+   size_t size = 0;
+   /* One byte extra to see the end of the file without growing. */
+   size_t capacity = (fsize > 0) ? (size_t)fsize + 1 : 65536;
+   uint8_t *data = al_malloc(capacity);
+
+   while (data) {
+      size += al_fread(fh, data + size, capacity - size);
+      if (size < capacity)
+         break;
+      capacity *= 2;
+      {
+         uint8_t *new_data = al_realloc(data, capacity);
+         if (!new_data)
+            al_free(data);
+         data = new_data;
+      }
+   }
+
+   *ret_size = size;
+   return data;
+}
+
+static ALLEGRO_BITMAP *decode_image(ALLEGRO_FILE *fh, int flags)
+{
+   uint8_t *data;
+   size_t size;
+   void *decoder;
+   const void *info;
+   int w, h, max;
+   size_t stride;
+   ALLEGRO_BITMAP *bitmap = NULL;
+   ALLEGRO_LOCKED_REGION *lr;
+   int res;
+
+   data = read_file(fh, &size);
+   if (!data)
+      return NULL;
+
+   if (image_decoder.create_from_buffer(data, size, &decoder)
+         != IMAGE_DECODER_SUCCESS) {
+      ALLEGRO_ERROR("AImageDecoder could not read the image.\n");
+      al_free(data);
+      return NULL;
+   }
+
+   info = image_decoder.get_header_info(decoder);
+   w = image_decoder.get_width(info);
+   h = image_decoder.get_height(info);
+
+   image_decoder.set_format(decoder, ANDROID_BITMAP_FORMAT_RGBA_8888);
+   if (flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA)
+      image_decoder.set_unpremultiplied(decoder, true);
+
+   max = get_max_decode_size();
+   if (max > 0 && (w > max || h > max)) {
+      int tw = (w >= h) ? max : _ALLEGRO_MAX(1, (int)((int64_t)w * max / h));
+      int th = (w >= h) ? _ALLEGRO_MAX(1, (int)((int64_t)h * max / w)) : max;
+      if (image_decoder.set_target_size(decoder, tw, th)
+            == IMAGE_DECODER_SUCCESS) {
+         ALLEGRO_DEBUG("Scaling %dx%d image to %dx%d\n", w, h, tw, th);
+         w = tw;
+         h = th;
+      }
+   }
+
+   stride = image_decoder.get_minimum_stride(decoder);
+
+   bitmap = al_create_bitmap(w, h);
+   if (!bitmap)
+      goto done;
+
+   lr = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888,
+      ALLEGRO_LOCK_WRITEONLY);
+   if (!lr) {
+      al_destroy_bitmap(bitmap);
+      bitmap = NULL;
+      goto done;
+   }
+
+   if (lr->pitch > 0 && (size_t)lr->pitch >= stride) {
+      res = image_decoder.decode(decoder, lr->data, lr->pitch,
+         (size_t)lr->pitch * h);
+   }
+   else {
+      uint8_t *pixels = al_malloc(stride * h);
+      res = -1;
+      if (pixels) {
+         res = image_decoder.decode(decoder, pixels, stride, stride * h);
+         if (res == IMAGE_DECODER_SUCCESS) {
+            _al_convert_bitmap_data(pixels, ALLEGRO_PIXEL_FORMAT_ABGR_8888,
+               stride, lr->data, lr->format, lr->pitch, 0, 0, 0, 0, w, h);
+         }
+         al_free(pixels);
+      }
+   }
+
+   al_unlock_bitmap(bitmap);
+
+   if (res != IMAGE_DECODER_SUCCESS) {
+      ALLEGRO_ERROR("AImageDecoder failed to decode the image: %d\n", res);
+      al_destroy_bitmap(bitmap);
+      bitmap = NULL;
+   }
+
+done:
+   image_decoder.destroy(decoder);
+   al_free(data);
+   return bitmap;
+}
+
+/* Note: This is not used when loading an image from the .apk without
+ * AImageDecoder.
+ *
  * The ImageLoader class uses Java to load a bitmap. To support
  * Allegro's filesystem functions, the bitmap is read from an
  * AllegroInputStream which in turn calls back into C to use Allegro's
@@ -140,6 +344,9 @@ ALLEGRO_BITMAP *_al_android_load_image_f(ALLEGRO_FILE *fh, int flags)
       return NULL;
    }
 
+   if (_al_android_have_image_decoder())
+      return decode_image(fh, flags);
+
    jnienv = (JNIEnv *)_al_android_get_jnienv();
    // Note: This is always ImageLoader
    image_loader_class = _al_android_image_loader_class();
@@ -291,11 +498,11 @@ ALLEGRO_BITMAP *_al_android_load_image(const char *filename, int flags)
    ALLEGRO_FILE *fp;
    ALLEGRO_BITMAP *bmp;
 
-   /* Bypass the ALLEGRO_FILE interface when we know the underlying stream
-    * implementation, to avoid a lot of shunting between C and Java.
-    * We could probably do this for normal filesystem as well.
+   /* Without AImageDecoder, bypass the ALLEGRO_FILE interface when we know
+    * the underlying stream implementation, and let Java read the asset.
     */
-   if (al_get_new_file_interface() == _al_get_apk_file_vtable()) {
+   if (al_get_new_file_interface() == _al_get_apk_file_vtable() &&
+         !_al_android_have_image_decoder()) {
       return android_load_image_asset(filename, flags);
    }
 
@@ -0,0 +1,231 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Android performance hints and thermal status.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_android.h"
+#include "allegro5/internal/aintern_android.h"
+#include "allegro5/internal/aintern_system.h"
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+ALLEGRO_DEBUG_CHANNEL("android")
+
+/* AThermalStatus */
+#define THERMAL_STATUS_NONE      0
+#define THERMAL_STATUS_LIGHT     1
+#define THERMAL_STATUS_MODERATE  2
+#define THERMAL_STATUS_SEVERE    3
+
+/* APerformanceHint needs API level 33 and AThermal API level 30, so they
+ * are looked up at run time to keep working on older devices.
+ */
+static struct {
+   bool hints;
+   bool thermal;
+   void *(*get_hint_manager)(void);
+   void *(*create_session)(void *manager, const int32_t *tids, size_t size,
+      int64_t target_nanos);
+   int (*update_target)(void *session, int64_t target_nanos);
+   int (*report_actual)(void *session, int64_t actual_nanos);
+   void (*close_session)(void *session);
+   void *(*acquire_thermal)(void);
+   void (*release_thermal)(void *manager);
+   int (*get_thermal_status)(void *manager);
+   int (*register_listener)(void *manager,
+      void (*callback)(void *data, int status), void *data);
+   int (*unregister_listener)(void *manager,
+      void (*callback)(void *data, int status), void *data);
+} perf;
+
+static pthread_once_t perf_once = PTHREAD_ONCE_INIT;
+static void *thermal_manager;
+
+static void init_perf(void)
+{
+   void *lib = dlopen("libandroid.so", RTLD_NOW);
+   if (!lib)
+      return;
+
+#define GET(field, name) \
+   (*(void **)&perf.field = dlsym(lib, name))
+
+   if (GET(get_hint_manager, "APerformanceHint_getManager") &&
+       GET(create_session, "APerformanceHint_createSession") &&
+       GET(update_target, "APerformanceHint_updateTargetWorkDuration") &&
+       GET(report_actual, "APerformanceHint_reportActualWorkDuration") &&
+       GET(close_session, "APerformanceHint_closeSession")) {
+      ALLEGRO_INFO("Performance hints available.\n");
+      perf.hints = true;
+   }
+
+   if (GET(acquire_thermal, "AThermal_acquireManager") &&
+       GET(release_thermal, "AThermal_releaseManager") &&
+       GET(get_thermal_status, "AThermal_getCurrentThermalStatus") &&
+       GET(register_listener, "AThermal_registerThermalStatusListener") &&
+       GET(unregister_listener, "AThermal_unregisterThermalStatusListener")) {
+      ALLEGRO_INFO("Thermal status available.\n");
+      perf.thermal = true;
+   }
+
+#undef GET
+
+   /* libandroid.so is loaded by the app anyway, this only drops our
+    * reference if there was nothing to use.
+    */
+   if (!perf.hints && !perf.thermal)
+      dlclose(lib);
+}
+
+static int64_t now_nanos(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static ALLEGRO_THERMAL_STATE thermal_state_from_status(int status)
+{
+   switch (status) {
+      case THERMAL_STATUS_NONE:
+         return ALLEGRO_THERMAL_STATE_NOMINAL;
+      case THERMAL_STATUS_LIGHT:
+      case THERMAL_STATUS_MODERATE:
+         return ALLEGRO_THERMAL_STATE_FAIR;
+      case THERMAL_STATUS_SEVERE:
+         return ALLEGRO_THERMAL_STATE_SERIOUS;
+      default:
+         /* Critical, emergency and shutdown; negative is an error. */
+         return status < 0 ? ALLEGRO_THERMAL_STATE_UNKNOWN :
+            ALLEGRO_THERMAL_STATE_CRITICAL;
+   }
+}
+
+/* Called on a binder thread. */
+static void thermal_status_changed(void *data, int status)
+{
+   (void)data;
+   _al_set_thermal_state(thermal_state_from_status(status));
+}
+
+/* _al_android_init_thermal_status:
+ *  Start following the thermal status, if the device can report it.
+ */
+void _al_android_init_thermal_status(void)
+{
+   pthread_once(&perf_once, init_perf);
+   if (!perf.thermal || thermal_manager)
+      return;
+
+   thermal_manager = perf.acquire_thermal();
+   if (!thermal_manager)
+      return;
+
+   _al_set_thermal_state(thermal_state_from_status(
+      perf.get_thermal_status(thermal_manager)));
+
+   if (perf.register_listener(thermal_manager, thermal_status_changed,
+         NULL) != 0) {
+      ALLEGRO_WARN("Could not register the thermal status listener.\n");
+   }
+}
+
+void _al_android_shutdown_thermal_status(void)
+{
+   if (!thermal_manager)
+      return;
+
+   perf.unregister_listener(thermal_manager, thermal_status_changed, NULL);
+   perf.release_thermal(thermal_manager);
+   thermal_manager = NULL;
+}
+
+/* _al_android_set_frame_time_hint:
+ *  Display driver hook for al_set_display_frame_time_hint. The session is
+ *  tied to the calling thread, which should be the one drawing.
+ */
+bool _al_android_set_frame_time_hint(ALLEGRO_DISPLAY *display, double seconds)
+{
+   ALLEGRO_DISPLAY_ANDROID *d = (ALLEGRO_DISPLAY_ANDROID *)display;
+   int64_t target = (int64_t)(seconds * 1e9);
+   int32_t tid;
+   void *manager;
+
+   pthread_once(&perf_once, init_perf);
+   if (!perf.hints)
+      return false;
+
+   if (target <= 0) {
+      _al_android_close_frame_time_hint(d);
+      return true;
+   }
+
+   if (d->hint_session)
+      return perf.update_target(d->hint_session, target) == 0;
+
+   manager = perf.get_hint_manager();
+   if (!manager)
+      return false;
+
+   tid = gettid();
+   d->hint_session = perf.create_session(manager, &tid, 1, target);
+   if (!d->hint_session) {
+      ALLEGRO_WARN("Could not create a performance hint session.\n");
+      return false;
+   }
+
+   d->frame_start = now_nanos();
+   return true;
+}
+
+void _al_android_close_frame_time_hint(ALLEGRO_DISPLAY_ANDROID *d)
+{
+   if (d->hint_session) {
+      perf.close_session(d->hint_session);
+      d->hint_session = NULL;
+   }
+}
+
+/* _al_android_report_frame_work:
+ *  Called by al_flip_display before swapping. Reports how long the frame
+ *  took since the last flip returned.
+ */
+void _al_android_report_frame_work(ALLEGRO_DISPLAY_ANDROID *d)
+{
+   if (d->hint_session)
+      perf.report_actual(d->hint_session, now_nanos() - d->frame_start);
+}
+
+/* _al_android_begin_frame_work:
+ *  Called by al_flip_display after swapping.
+ */
+void _al_android_begin_frame_work(ALLEGRO_DISPLAY_ANDROID *d)
+{
+   if (d->hint_session)
+      d->frame_start = now_nanos();
+}
+
+/* Function: al_android_set_sustained_performance_mode
+ */
+bool al_android_set_sustained_performance_mode(bool onoff)
+{
+   return _jni_callBooleanMethodV(_al_android_get_jnienv(),
+      _al_android_activity_object(), "setSustainedPerformanceMode", "(Z)Z",
+      onoff);
+}
+
+/* vim: set sts=3 sw=3 et: */
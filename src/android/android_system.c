@@ -34,9 +34,10 @@ ALLEGRO_DEBUG_CHANNEL("android")
 struct system_data_t {
    JNIEnv *env;
    jobject activity_object;
+   jobject asset_manager_object;
+   AAssetManager *asset_manager;
    jclass input_stream_class;
    jclass illegal_argument_exception_class;
-   jclass apk_stream_class;
    jclass image_loader_class;
    jclass clipboard_class;
    jclass apk_fs_class;
@@ -83,9 +84,9 @@ jclass _al_android_input_stream_class(void)
    return system_data.input_stream_class;
 }
 
-jclass _al_android_apk_stream_class(void)
+AAssetManager *_al_android_asset_manager(void)
 {
-   return system_data.apk_stream_class;
+   return system_data.asset_manager;
 }
 
 jclass _al_android_image_loader_class(void)
@@ -176,6 +177,7 @@ JNI_FUNC(bool, AllegroActivity, nativeOnCreate, (JNIEnv *env, jobject obj))
    jclass iae;
    jclass aisc;
    jclass asc;
+   jobject am;
 
    ALLEGRO_DEBUG("entered nativeOnCreate");
 
@@ -200,9 +202,6 @@ JNI_FUNC(bool, AllegroActivity, nativeOnCreate, (JNIEnv *env, jobject obj))
    aisc = (*env)->FindClass(env, ALLEGRO_ANDROID_PACKAGE_NAME_SLASH "/AllegroInputStream");
    system_data.input_stream_class = (*env)->NewGlobalRef(env, aisc);
 
-   asc = (*env)->FindClass(env, ALLEGRO_ANDROID_PACKAGE_NAME_SLASH "/AllegroAPKStream");
-   system_data.apk_stream_class = (*env)->NewGlobalRef(env, asc);
-
    asc = (*env)->FindClass(env, ALLEGRO_ANDROID_PACKAGE_NAME_SLASH "/ImageLoader");
    system_data.image_loader_class = (*env)->NewGlobalRef(env, asc);
 
@@ -212,6 +211,14 @@ JNI_FUNC(bool, AllegroActivity, nativeOnCreate, (JNIEnv *env, jobject obj))
    asc = (*env)->FindClass(env, ALLEGRO_ANDROID_PACKAGE_NAME_SLASH "/AllegroAPKList");
    system_data.apk_fs_class = (*env)->NewGlobalRef(env, asc);
 
+   ALLEGRO_DEBUG("get asset manager");
+   am = _jni_callObjectMethod(env, system_data.activity_object, "getAssets",
+      "()Landroid/content/res/AssetManager;");
+   system_data.asset_manager_object = (*env)->NewGlobalRef(env, am);
+   (*env)->DeleteLocalRef(env, am);
+   system_data.asset_manager = AAssetManager_fromJava(env,
+      system_data.asset_manager_object);
+
    ALLEGRO_DEBUG("create mutex and cond objects");
    system_data.mutex = al_create_mutex();
    system_data.cond  = al_create_cond();
@@ -394,6 +401,7 @@ JNI_FUNC(void, AllegroActivity, nativeOnDestroy, (JNIEnv *env, jobject obj))
    (*env)->DeleteGlobalRef(env, system_data.activity_object);
    (*env)->DeleteGlobalRef(env, system_data.illegal_argument_exception_class);
    (*env)->DeleteGlobalRef(env, system_data.input_stream_class);
+   (*env)->DeleteGlobalRef(env, system_data.asset_manager_object);
 
    free(system_data.system);
 
@@ -475,6 +483,8 @@ static ALLEGRO_SYSTEM *android_initialize(int flags)
     */
    _al_android_set_jnienv(main_env);
 
+   _al_android_init_thermal_status();
+
    return &system_data.system->system;
 }
 
@@ -516,6 +526,8 @@ static void android_shutdown_system(void)
       al_destroy_display(d);
    }
    _al_vector_free(&s->displays);
+
+   _al_android_shutdown_thermal_status();
 }
 
 static bool android_inhibit_screensaver(bool inhibit)
@@ -548,6 +560,8 @@ ALLEGRO_SYSTEM_INTERFACE *_al_system_android_interface()
    android_vt->get_time = _al_unix_get_time;
    android_vt->rest = _al_unix_rest;
    android_vt->init_timeout = _al_unix_init_timeout;
+   android_vt->rest_until = _al_unix_rest_until;
+   android_vt->init_timeout_until = _al_unix_init_timeout_until;
 
    return android_vt;
 }
@@ -46,6 +46,14 @@ static void reset_touch_input_state(void)
 }
 
 
+/* Must be called with the event source locked. */
+static void publish_state(double timestamp)
+{
+   _al_publish_input_snapshot(&touch_input.snapshot, &touch_input_state,
+      timestamp);
+}
+
+
 static void generate_touch_input_event(unsigned int type, double timestamp,
    int id, float x, float y, float dx, float dy, bool primary,
    ALLEGRO_DISPLAY *disp)
@@ -69,6 +77,9 @@ static void generate_touch_input_event(unsigned int type, double timestamp,
    else if (touch_input.mouse_emulation_mode == ALLEGRO_MOUSE_EMULATION_EXCLUSIVE)
       want_touch_event = al_is_mouse_installed() ? false : want_touch_event;
 
+   if (want_touch_event &&
+         _al_touch_input_defer_event(&touch_input, type, timestamp, disp))
+      want_touch_event = false;
    
    if (!want_touch_event && !want_mouse_emulation_event)
       return;
@@ -146,6 +157,9 @@ static bool init_touch_input(void)
    reset_touch_input_state();
    memset(&mouse_state, 0, sizeof(mouse_state));
 
+   if (!_al_init_touch_input_frames(&touch_input))
+      ALLEGRO_WARN("Touch frame events are not available.\n");
+
    _al_event_source_init(&touch_input.es);
    _al_event_source_init(&touch_input.mouse_emulation_es);
    touch_input.mouse_emulation_mode = ALLEGRO_MOUSE_EMULATION_TRANSPARENT;
@@ -166,6 +180,7 @@ static void exit_touch_input(void)
 
    _al_event_source_free(&touch_input.es);
    _al_event_source_free(&touch_input.mouse_emulation_es);
+   _al_destroy_touch_input_frames(&touch_input);
 
    installed = false;
 }
@@ -247,6 +262,7 @@ static void android_touch_input_handle_begin(int id, double timestamp,
    state->dy      = 0.0f;
    state->primary = primary;
    state->display = disp;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_BEGIN, timestamp,
@@ -269,6 +285,7 @@ static void android_touch_input_handle_end(int id, double timestamp,
    state->dy      = y - state->y;
    state->x       = x;
    state->y       = y;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_END, timestamp,
@@ -277,6 +294,7 @@ static void android_touch_input_handle_end(int id, double timestamp,
 
    _al_event_source_lock(&touch_input.es);
    state->id = -1;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 }
 
@@ -295,6 +313,7 @@ static void android_touch_input_handle_move(int id, double timestamp,
    state->dy      = y - state->y;
    state->x       = x;
    state->y       = y;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_MOVE, timestamp,
@@ -317,6 +336,7 @@ static void android_touch_input_handle_cancel(int id, double timestamp,
    state->dy      = y - state->y;
    state->x       = x;
    state->y       = y;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_CANCEL, timestamp,
@@ -324,6 +344,7 @@ static void android_touch_input_handle_cancel(int id, double timestamp,
 
    _al_event_source_lock(&touch_input.es);
    state->id = -1;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 }
 
@@ -362,6 +383,11 @@ JNI_FUNC(void, TouchListener, nativeOnTouch, (JNIEnv *env, jobject obj,
             primary, display);
          break;
 
+      /* Sent after all pointers of a MotionEvent. */
+      case ALLEGRO_EVENT_TOUCH_FRAME:
+         _al_touch_input_end_frame(&touch_input);
+         break;
+
       default:
          ALLEGRO_ERROR("unknown touch action: %i", action);
          break;
@@ -27,6 +27,7 @@
 #include "allegro5/internal/aintern_pixels.h"
 #include "allegro5/internal/aintern_shader.h"
 #include "allegro5/internal/aintern_system.h"
+#include "allegro5/internal/aintern_workers.h"
 
 ALLEGRO_DEBUG_CHANNEL("bitmap")
 
@@ -38,6 +39,7 @@ static ALLEGRO_BITMAP *create_memory_bitmap(ALLEGRO_DISPLAY *current_display,
 {
    ALLEGRO_BITMAP *bitmap;
    int pitch;
+   int rows;
 
    if (_al_pixel_format_is_video_only(format)) {
       /* Can't have a video-only memory bitmap... */
@@ -48,7 +50,21 @@ static ALLEGRO_BITMAP *create_memory_bitmap(ALLEGRO_DISPLAY *current_display,
 
    bitmap = al_calloc(1, sizeof *bitmap);
 
-   pitch = w * al_get_pixel_size(format);
+   if (al_get_pixel_block_width(format) != 1 ||
+         al_get_pixel_block_height(format) != 1) {
+      flags &= ~ALLEGRO_TILED_BITMAP;
+   }
+
+   if (flags & ALLEGRO_TILED_BITMAP) {
+      /* A row of tiles. */
+      pitch = _al_get_least_multiple(w, _AL_TILE_SIZE) * _AL_TILE_SIZE *
+         al_get_pixel_size(format);
+      rows = _al_get_least_multiple(h, _AL_TILE_SIZE) / _AL_TILE_SIZE;
+   }
+   else {
+      pitch = w * al_get_pixel_size(format);
+      rows = h;
+   }
 
    bitmap->vt = NULL;
    bitmap->_format = format;
@@ -73,7 +89,7 @@ static ALLEGRO_BITMAP *create_memory_bitmap(ALLEGRO_DISPLAY *current_display,
    al_orthographic_transform(&bitmap->proj_transform, 0, 0, -1.0, w, h, 1.0);
    bitmap->parent = NULL;
    bitmap->xofs = bitmap->yofs = 0;
-   bitmap->memory = al_malloc(pitch * h);
+   bitmap->memory = al_malloc(pitch * rows);
    bitmap->use_bitmap_blender = false;
    bitmap->blender.blend_color = al_map_rgba(0, 0, 0, 0);
    
@@ -83,6 +99,16 @@ static ALLEGRO_BITMAP *create_memory_bitmap(ALLEGRO_DISPLAY *current_display,
 
 
 
+/* _al_bitmap_is_tiled:
+ *  Whether the pixels of the bitmap, or of its parent, are kept in tiles.
+ */
+bool _al_bitmap_is_tiled(ALLEGRO_BITMAP *bitmap)
+{
+   int flags = al_get_bitmap_flags(bitmap);
+   return (flags & ALLEGRO_MEMORY_BITMAP) && (flags & ALLEGRO_TILED_BITMAP);
+}
+
+
 static void destroy_memory_bitmap(ALLEGRO_BITMAP *bmp)
 {
    _al_unregister_convert_bitmap(bmp);
@@ -151,6 +177,8 @@ ALLEGRO_BITMAP *_al_create_bitmap_params(ALLEGRO_DISPLAY *current_display,
    bitmap->yofs = 0;
    bitmap->_flags |= ALLEGRO_VIDEO_BITMAP;
    bitmap->dirty = !(bitmap->_flags & ALLEGRO_NO_PRESERVE_TEXTURE);
+   bitmap->last_use_frame = current_display->texture_frame;
+   bitmap->evicted = false;
    bitmap->_depth = depth;
    bitmap->_samples = samples;
    bitmap->use_bitmap_blender = false;
@@ -175,8 +203,12 @@ ALLEGRO_BITMAP *_al_create_bitmap_params(ALLEGRO_DISPLAY *current_display,
    
    /* We keep a list of bitmaps depending on the current display so that we can
     * convert them to memory bimaps when the display is destroyed. */
+   if (current_display->bitmaps_mutex)
+      al_lock_mutex(current_display->bitmaps_mutex);
    back = _al_vector_alloc_back(&current_display->bitmaps);
    *back = bitmap;
+   if (current_display->bitmaps_mutex)
+      al_unlock_mutex(current_display->bitmaps_mutex);
 
    return bitmap;
 }
@@ -223,6 +255,10 @@ void al_destroy_bitmap(ALLEGRO_BITMAP *bitmap)
 
    _al_unregister_destructor(_al_dtor_list, bitmap->dtor_item);
 
+   /* Locked memory sub-bitmaps are linked into their parent. */
+   if (al_is_sub_bitmap(bitmap) && bitmap->locked)
+      al_unlock_bitmap(bitmap);
+
    if (!al_is_sub_bitmap(bitmap)) {
       ALLEGRO_DISPLAY* disp = _al_get_bitmap_display(bitmap);
       if (al_get_bitmap_flags(bitmap) & ALLEGRO_MEMORY_BITMAP) {
@@ -238,8 +274,13 @@ void al_destroy_bitmap(ALLEGRO_BITMAP *bitmap)
       if (bitmap->vt)
          bitmap->vt->destroy_bitmap(bitmap);
 
-      if (disp)
-         _al_vector_find_and_delete(&disp->bitmaps, &bitmap);
+      if (disp) {
+         if (disp->bitmaps_mutex)
+            al_lock_mutex(disp->bitmaps_mutex);
+         _al_vector_find_and_delete_unordered(&disp->bitmaps, &bitmap);
+         if (disp->bitmaps_mutex)
+            al_unlock_mutex(disp->bitmaps_mutex);
+      }
 
       if (bitmap->memory)
          al_free(bitmap->memory);
@@ -254,33 +295,140 @@ void al_destroy_bitmap(ALLEGRO_BITMAP *bitmap)
 void al_convert_mask_to_alpha(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR mask_color)
 {
    ALLEGRO_LOCKED_REGION *lr;
-   int x, y;
    ALLEGRO_COLOR pixel;
    ALLEGRO_COLOR alpha_pixel;
-   ALLEGRO_STATE state;
+   uint32_t key[4] = {0, 0, 0, 0};
+   uint32_t clear[4] = {0, 0, 0, 0};
+   int size;
+   char *data;
+   int x, y;
 
    if (!(lr = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ANY, 0))) {
       ALLEGRO_ERROR("Couldn't lock bitmap.");
       return;
    }
 
-   al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP);
-   al_set_target_bitmap(bitmap);
-
    alpha_pixel = al_map_rgba(0, 0, 0, 0);
-
-   for (y = 0; y < bitmap->h; y++) {
-      for (x = 0; x < bitmap->w; x++) {
-         pixel = al_get_pixel(bitmap, x, y);
-         if (memcmp(&pixel, &mask_color, sizeof(ALLEGRO_COLOR)) == 0) {
-            al_put_pixel(x, y, alpha_pixel);
+   size = al_get_pixel_size(lr->format);
+
+   /* A mask color the format cannot store matches no pixel. */
+   data = (char *)key;
+   _AL_INLINE_PUT_PIXEL(lr->format, data, mask_color, false);
+   data = (char *)key;
+   _AL_INLINE_GET_PIXEL(lr->format, data, pixel, false);
+   if (memcmp(&pixel, &mask_color, sizeof(ALLEGRO_COLOR)) != 0) {
+      al_unlock_bitmap(bitmap);
+      return;
+   }
+   data = (char *)clear;
+   _AL_INLINE_PUT_PIXEL(lr->format, data, alpha_pixel, false);
+
+   switch (lr->format) {
+      /* Every bit of these is part of the color, so pixels match the mask
+       * color exactly if they are stored the same way. The loop has no
+       * branches, so that the compiler can vectorize it.
+       */
+      case ALLEGRO_PIXEL_FORMAT_ARGB_8888:
+      case ALLEGRO_PIXEL_FORMAT_RGBA_8888:
+      case ALLEGRO_PIXEL_FORMAT_ABGR_8888:
+      case ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE:
+      case ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB:
+      case ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB:
+         for (y = 0; y < bitmap->h; y++) {
+            uint32_t *row = (uint32_t *)((char *)lr->data + y * lr->pitch);
+            for (x = 0; x < bitmap->w; x++)
+               row[x] = (row[x] == key[0]) ? clear[0] : row[x];
          }
-      }
+         break;
+
+      default:
+         for (y = 0; y < bitmap->h; y++) {
+            data = (char *)lr->data + y * lr->pitch;
+            for (x = 0; x < bitmap->w; x++) {
+               char *p = data;
+               _AL_INLINE_GET_PIXEL(lr->format, p, pixel, false);
+               if (memcmp(&pixel, &mask_color, sizeof(ALLEGRO_COLOR)) == 0)
+                  memcpy(data, clear, size);
+               data += size;
+            }
+         }
+         break;
    }
 
    al_unlock_bitmap(bitmap);
+}
 
-   al_restore_state(&state);
+
+/* Function: al_set_bitmap_color_key
+ */
+void al_set_bitmap_color_key(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR key)
+{
+   ASSERT(bitmap);
+
+   if (bitmap->parent)
+      bitmap = bitmap->parent;
+   bitmap->use_color_key = true;
+   bitmap->color_key = key;
+}
+
+
+/* Function: al_clear_bitmap_color_key
+ */
+void al_clear_bitmap_color_key(ALLEGRO_BITMAP *bitmap)
+{
+   ASSERT(bitmap);
+
+   if (bitmap->parent)
+      bitmap = bitmap->parent;
+   bitmap->use_color_key = false;
+}
+
+
+/* Function: al_get_bitmap_color_key
+ */
+bool al_get_bitmap_color_key(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR *key)
+{
+   ASSERT(bitmap);
+
+   if (bitmap->parent)
+      bitmap = bitmap->parent;
+   if (key && bitmap->use_color_key)
+      *key = bitmap->color_key;
+   return bitmap->use_color_key;
+}
+
+
+static bool convert_alpha(ALLEGRO_BITMAP *bitmap,
+   void (*convert)(void *data, int format, int pitch, int width, int height))
+{
+   ALLEGRO_LOCKED_REGION *lr;
+
+   ASSERT(bitmap);
+
+   if (!(lr = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ANY,
+         ALLEGRO_LOCK_READWRITE))) {
+      ALLEGRO_ERROR("Couldn't lock bitmap.\n");
+      return false;
+   }
+   convert(lr->data, lr->format, lr->pitch, bitmap->w, bitmap->h);
+   al_unlock_bitmap(bitmap);
+   return true;
+}
+
+
+/* Function: al_premultiply_bitmap_alpha
+ */
+bool al_premultiply_bitmap_alpha(ALLEGRO_BITMAP *bitmap)
+{
+   return convert_alpha(bitmap, _al_premultiply_alpha);
+}
+
+
+/* Function: al_unpremultiply_bitmap_alpha
+ */
+bool al_unpremultiply_bitmap_alpha(ALLEGRO_BITMAP *bitmap)
+{
+   return convert_alpha(bitmap, _al_unpremultiply_alpha);
 }
 
 
@@ -704,10 +852,18 @@ static bool transfer_bitmap_data(ALLEGRO_BITMAP *src, ALLEGRO_BITMAP *dst)
       }
    }
 
-   _al_convert_bitmap_data(
-      src_region->data, src_region->format, src_region->pitch,
-      dst_region->data, dst_region->format, dst_region->pitch,
-      0, 0, 0, 0, copy_w, copy_h);
+   if ((src->_flags | dst->_flags) & ALLEGRO_PARALLEL_CONVERSION) {
+      _al_parallel_convert_bitmap_data(
+         src_region->data, src_region->format, src_region->pitch,
+         dst_region->data, dst_region->format, dst_region->pitch,
+         0, 0, 0, 0, copy_w, copy_h);
+   }
+   else {
+      _al_convert_bitmap_data(
+         src_region->data, src_region->format, src_region->pitch,
+         dst_region->data, dst_region->format, dst_region->pitch,
+         0, 0, 0, 0, copy_w, copy_h);
+   }
 
    al_unlock_bitmap(src);
    al_unlock_bitmap(dst);
@@ -785,6 +941,87 @@ void _al_convert_bitmap_data(
 }
 
 
+/* Conversions smaller than this many pixels per band are not worth handing
+ * to the worker threads.
+ */
+#define MIN_PIXELS_PER_BAND (128 * 1024)
+
+typedef struct CONVERT_BANDS {
+   const void *src;
+   int src_format;
+   int src_pitch;
+   void *dst;
+   int dst_format;
+   int dst_pitch;
+   int sx, sy, dx, dy;
+   int width, height;
+   int band_height;
+} CONVERT_BANDS;
+
+
+static void convert_band(int index, void *arg)
+{
+   CONVERT_BANDS *bands = arg;
+   int y = index * bands->band_height;
+   int h = _ALLEGRO_MIN(bands->band_height, bands->height - y);
+
+   _al_convert_bitmap_data(
+      bands->src, bands->src_format, bands->src_pitch,
+      bands->dst, bands->dst_format, bands->dst_pitch,
+      bands->sx, bands->sy + y, bands->dx, bands->dy + y,
+      bands->width, h);
+}
+
+
+/* Like _al_convert_bitmap_data, but splits large conversions into bands of
+ * rows which are converted in parallel by the worker threads.
+ */
+void _al_parallel_convert_bitmap_data(
+   const void *src, int src_format, int src_pitch,
+   void *dst, int dst_format, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   CONVERT_BANDS bands;
+   int block_height;
+   int num_bands;
+
+   ASSERT(src);
+   ASSERT(dst);
+
+   num_bands = (int)(((int64_t)width * height) / MIN_PIXELS_PER_BAND);
+   if (num_bands >= 2)
+      num_bands = _ALLEGRO_MIN(num_bands, _al_get_worker_count());
+
+   /* Bands of compressed formats must start on block boundaries. */
+   block_height = _ALLEGRO_MAX(al_get_pixel_block_height(src_format),
+      al_get_pixel_block_height(dst_format));
+
+   if (num_bands < 2 || height < 2 * block_height) {
+      _al_convert_bitmap_data(src, src_format, src_pitch,
+         dst, dst_format, dst_pitch, sx, sy, dx, dy, width, height);
+      return;
+   }
+
+   bands.src = src;
+   bands.src_format = src_format;
+   bands.src_pitch = src_pitch;
+   bands.dst = dst;
+   bands.dst_format = dst_format;
+   bands.dst_pitch = dst_pitch;
+   bands.sx = sx;
+   bands.sy = sy;
+   bands.dx = dx;
+   bands.dy = dy;
+   bands.width = width;
+   bands.height = height;
+   bands.band_height = _al_get_least_multiple(
+      (height + num_bands - 1) / num_bands, block_height);
+   num_bands = (height + bands.band_height - 1) / bands.band_height;
+
+   _al_run_parallel(num_bands, convert_band, &bands);
+}
+
+
 /* Function: al_clone_bitmap
  */
 ALLEGRO_BITMAP *al_clone_bitmap(ALLEGRO_BITMAP *bitmap)
@@ -810,4 +1047,32 @@ void al_backup_dirty_bitmap(ALLEGRO_BITMAP *bitmap)
       bitmap->vt->backup_dirty_bitmap(bitmap);
 }
 
+/* Function: al_discard_bitmap_contents
+ */
+void al_discard_bitmap_contents(ALLEGRO_BITMAP *bitmap)
+{
+   ASSERT(bitmap);
+
+   /* Only whole bitmaps can be discarded. */
+   if (bitmap->parent || bitmap->locked)
+      return;
+
+   if (bitmap->vt && bitmap->vt->discard_contents)
+      bitmap->vt->discard_contents(bitmap);
+}
+
+/* Function: al_resolve_bitmap
+ */
+bool al_resolve_bitmap(ALLEGRO_BITMAP *bitmap)
+{
+   ASSERT(bitmap);
+
+   if (bitmap->parent)
+      bitmap = bitmap->parent;
+
+   if (bitmap->vt && bitmap->vt->resolve_bitmap)
+      return bitmap->vt->resolve_bitmap(bitmap);
+   return true;
+}
+
 /* vim: set ts=8 sts=3 sw=3 et: */
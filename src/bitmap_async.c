@@ -0,0 +1,486 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Asynchronous and parallel bitmap loading.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_dtor.h"
+#include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_system.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_vector.h"
+#include "allegro5/internal/aintern_workers.h"
+
+ALLEGRO_DEBUG_CHANNEL("bitmap")
+
+#define MAX_LOAD_THREADS 16
+
+
+/*
+ * Files are decoded into memory bitmaps by a small pool of loader threads.
+ * Bitmaps which should end up as video bitmaps then wait in the upload list
+ * until al_upload_async_bitmaps is called on a thread with a current
+ * display. Until it is announced with an event, a bitmap is owned by its job
+ * and not registered as a destructor, so that al_uninstall_system does not
+ * destroy it behind our back.
+ *
+ * Events are emitted by one internal event source per queue. A source is
+ * reused for another queue only once its queue is gone and no job refers to
+ * it any more.
+ */
+
+typedef struct LOAD_SOURCE
+{
+   ALLEGRO_EVENT_SOURCE es;
+   int num_jobs;
+} LOAD_SOURCE;
+
+typedef struct LOAD_JOB LOAD_JOB;
+
+struct LOAD_JOB
+{
+   LOAD_JOB *next;
+   int id;
+   char *filename;
+   int flags;
+   ALLEGRO_STATE state;
+   LOAD_SOURCE *source;
+   ALLEGRO_BITMAP *bitmap;
+   bool needs_upload;
+};
+
+typedef struct JOB_LIST
+{
+   LOAD_JOB *head;
+   LOAD_JOB *tail;
+} JOB_LIST;
+
+typedef struct BATCH
+{
+   const char * const *filenames;
+   int flags;
+   ALLEGRO_BITMAP **bitmaps;
+   ALLEGRO_STATE state;
+   int decode_bitmap_flags;
+} BATCH;
+
+static ALLEGRO_MUTEX *async_mutex = NULL;
+static ALLEGRO_COND *async_cond = NULL;
+static _AL_THREAD *load_threads = NULL;
+static int num_load_threads = 0;
+static bool stop_load_threads = false;
+
+static JOB_LIST pending_jobs;
+static JOB_LIST upload_jobs;
+static int num_unfinished = 0;
+static int next_id = 1;
+
+static _AL_VECTOR load_sources = _AL_VECTOR_INITIALIZER(LOAD_SOURCE *);
+
+
+static void push_job(JOB_LIST *list, LOAD_JOB *job)
+{
+   job->next = NULL;
+   if (list->tail)
+      list->tail->next = job;
+   else
+      list->head = job;
+   list->tail = job;
+}
+
+
+static LOAD_JOB *pop_job(JOB_LIST *list)
+{
+   LOAD_JOB *job = list->head;
+
+   if (job) {
+      list->head = job->next;
+      if (!list->head)
+         list->tail = NULL;
+   }
+   return job;
+}
+
+
+static void free_job(LOAD_JOB *job)
+{
+   al_free(job->filename);
+   al_free(job);
+}
+
+
+/* Emits the event for a finished job and frees it. The bitmap becomes the
+ * user's at this point, unless nobody is listening any more.
+ * Must be called with async_mutex held.
+ */
+static void finish_job(LOAD_JOB *job)
+{
+   ALLEGRO_EVENT_SOURCE *es = &job->source->es;
+   ALLEGRO_EVENT event;
+
+   _al_event_source_lock(es);
+   if (_al_event_source_needs_to_generate_event(es)) {
+      if (job->bitmap) {
+         job->bitmap->dtor_item = _al_register_destructor(_al_dtor_list,
+            "bitmap", job->bitmap, (void (*)(void *))al_destroy_bitmap);
+      }
+      event.bitmap.type = ALLEGRO_EVENT_BITMAP_LOADED;
+      event.bitmap.timestamp = al_get_time();
+      event.bitmap.bitmap = job->bitmap;
+      event.bitmap.id = job->id;
+      _al_event_source_emit_event(es, &event);
+   }
+   else {
+      al_destroy_bitmap(job->bitmap);
+   }
+   _al_event_source_unlock(es);
+
+   job->source->num_jobs--;
+   num_unfinished--;
+   free_job(job);
+}
+
+
+static void load_job(LOAD_JOB *job)
+{
+   int bitmap_flags;
+
+   al_restore_state(&job->state);
+
+   /* Decode into a memory bitmap unless the user wants a video bitmap, which
+    * can only be created by al_upload_async_bitmaps.
+    */
+   bitmap_flags = al_get_new_bitmap_flags();
+   if (!(bitmap_flags & ALLEGRO_MEMORY_BITMAP)) {
+      bitmap_flags &= ~(ALLEGRO_VIDEO_BITMAP | ALLEGRO_CONVERT_BITMAP);
+      al_set_new_bitmap_flags(bitmap_flags | ALLEGRO_MEMORY_BITMAP);
+   }
+
+   _al_push_destructor_owner();
+   job->bitmap = al_load_bitmap_flags(job->filename, job->flags);
+   _al_pop_destructor_owner();
+
+   job->needs_upload = job->bitmap &&
+      (al_get_new_bitmap_flags() != bitmap_flags) &&
+      (al_get_bitmap_flags(job->bitmap) & ALLEGRO_MEMORY_BITMAP);
+}
+
+
+static void load_thread_proc(_AL_THREAD *self, void *unused)
+{
+   (void)self;
+   (void)unused;
+
+   al_lock_mutex(async_mutex);
+   while (!stop_load_threads) {
+      LOAD_JOB *job = pop_job(&pending_jobs);
+
+      if (!job) {
+         al_wait_cond(async_cond, async_mutex);
+         continue;
+      }
+
+      al_unlock_mutex(async_mutex);
+      load_job(job);
+      al_lock_mutex(async_mutex);
+
+      if (job->needs_upload)
+         push_job(&upload_jobs, job);
+      else
+         finish_job(job);
+   }
+   al_unlock_mutex(async_mutex);
+}
+
+
+static int get_thread_count(void)
+{
+   const char *p;
+   int n = al_get_cpu_count() - 1;
+
+   p = al_get_config_value(al_get_system_config(), "image",
+      "async_load_threads");
+   if (p && p[0] != '\0')
+      n = atoi(p);
+
+   if (n < 1)
+      n = 1;
+   if (n > MAX_LOAD_THREADS)
+      n = MAX_LOAD_THREADS;
+   return n;
+}
+
+
+/* Must be called with async_mutex held. */
+static void start_load_threads(void)
+{
+   int n = get_thread_count();
+   int i;
+
+   load_threads = al_calloc(n, sizeof(_AL_THREAD));
+   if (!load_threads)
+      return;
+   for (i = 0; i < n; i++)
+      _al_thread_create(&load_threads[i], load_thread_proc, NULL);
+   num_load_threads = n;
+   ALLEGRO_INFO("Started %d bitmap loading threads\n", n);
+}
+
+
+/* Must be called with async_mutex held. */
+static LOAD_SOURCE *get_source(ALLEGRO_EVENT_QUEUE *queue)
+{
+   LOAD_SOURCE **slot;
+   LOAD_SOURCE *unused = NULL;
+   unsigned i;
+
+   for (i = 0; i < _al_vector_size(&load_sources); i++) {
+      LOAD_SOURCE *source = *(LOAD_SOURCE **)_al_vector_ref(&load_sources, i);
+
+      if (al_is_event_source_registered(queue, &source->es))
+         return source;
+      if (!unused && source->num_jobs == 0 &&
+            !_al_event_source_needs_to_generate_event(&source->es)) {
+         unused = source;
+      }
+   }
+
+   if (!unused) {
+      unused = al_calloc(1, sizeof *unused);
+      if (!unused)
+         return NULL;
+      slot = _al_vector_alloc_back(&load_sources);
+      if (!slot) {
+         al_free(unused);
+         return NULL;
+      }
+      *slot = unused;
+      _al_event_source_init(&unused->es);
+   }
+
+   al_register_event_source(queue, &unused->es);
+   return unused;
+}
+
+
+static void shutdown_async_loading(void)
+{
+   LOAD_JOB *job;
+   unsigned i;
+   int j;
+
+   if (load_threads) {
+      al_lock_mutex(async_mutex);
+      stop_load_threads = true;
+      al_broadcast_cond(async_cond);
+      al_unlock_mutex(async_mutex);
+
+      for (j = 0; j < num_load_threads; j++)
+         _al_thread_join(&load_threads[j]);
+      al_free(load_threads);
+      load_threads = NULL;
+   }
+   num_load_threads = 0;
+   stop_load_threads = false;
+
+   while ((job = pop_job(&pending_jobs)))
+      free_job(job);
+   while ((job = pop_job(&upload_jobs))) {
+      al_destroy_bitmap(job->bitmap);
+      free_job(job);
+   }
+   num_unfinished = 0;
+
+   for (i = 0; i < _al_vector_size(&load_sources); i++) {
+      LOAD_SOURCE *source = *(LOAD_SOURCE **)_al_vector_ref(&load_sources, i);
+      _al_event_source_free(&source->es);
+      al_free(source);
+   }
+   _al_vector_free(&load_sources);
+
+   al_destroy_cond(async_cond);
+   al_destroy_mutex(async_mutex);
+   async_cond = NULL;
+   async_mutex = NULL;
+}
+
+
+void _al_init_async_bitmap_loading(void)
+{
+   async_mutex = al_create_mutex();
+   async_cond = al_create_cond();
+   _al_add_exit_func(shutdown_async_loading, "shutdown_async_loading");
+}
+
+
+/* Function: al_load_bitmap_async
+ */
+int al_load_bitmap_async(const char *filename, int flags,
+   ALLEGRO_EVENT_QUEUE *queue)
+{
+   LOAD_JOB *job;
+   int id;
+
+   ASSERT(filename);
+   ASSERT(queue);
+
+   if (!async_mutex)
+      return 0;
+
+   job = al_calloc(1, sizeof *job);
+   if (!job)
+      return 0;
+   job->filename = al_malloc(strlen(filename) + 1);
+   if (!job->filename) {
+      al_free(job);
+      return 0;
+   }
+   strcpy(job->filename, filename);
+   job->flags = flags;
+   al_store_state(&job->state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS |
+      ALLEGRO_STATE_NEW_FILE_INTERFACE);
+
+   al_lock_mutex(async_mutex);
+
+   if (!load_threads)
+      start_load_threads();
+   job->source = load_threads ? get_source(queue) : NULL;
+   if (!job->source) {
+      al_unlock_mutex(async_mutex);
+      ALLEGRO_ERROR("Could not queue %s for loading.\n", filename);
+      free_job(job);
+      return 0;
+   }
+
+   id = job->id = next_id;
+   if (++next_id <= 0)
+      next_id = 1;
+   job->source->num_jobs++;
+   num_unfinished++;
+   push_job(&pending_jobs, job);
+   al_signal_cond(async_cond);
+
+   al_unlock_mutex(async_mutex);
+
+   return id;
+}
+
+
+/* Function: al_upload_async_bitmaps
+ */
+int al_upload_async_bitmaps(double max_time)
+{
+   ALLEGRO_STATE state;
+   double t0 = al_get_time();
+   int remaining;
+
+   if (!async_mutex)
+      return 0;
+
+   al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS |
+      ALLEGRO_STATE_NEW_FILE_INTERFACE);
+
+   al_lock_mutex(async_mutex);
+   for (;;) {
+      LOAD_JOB *job = pop_job(&upload_jobs);
+
+      if (!job)
+         break;
+
+      al_unlock_mutex(async_mutex);
+      al_restore_state(&job->state);
+      _al_push_destructor_owner();
+      al_convert_bitmap(job->bitmap);
+      _al_pop_destructor_owner();
+      al_lock_mutex(async_mutex);
+
+      finish_job(job);
+
+      if (al_get_time() - t0 >= max_time)
+         break;
+   }
+   remaining = num_unfinished;
+   al_unlock_mutex(async_mutex);
+
+   al_restore_state(&state);
+
+   return remaining;
+}
+
+
+/* [worker thread] */
+static void load_batch_bitmap(int index, void *arg)
+{
+   BATCH *batch = arg;
+
+   al_restore_state(&batch->state);
+   al_set_new_bitmap_flags(batch->decode_bitmap_flags);
+   batch->bitmaps[index] = al_load_bitmap_flags(batch->filenames[index],
+      batch->flags);
+}
+
+
+/* Function: al_load_bitmaps_batch
+ */
+int al_load_bitmaps_batch(const char * const *filenames, int count,
+   int flags, ALLEGRO_BITMAP **bitmaps)
+{
+   BATCH batch;
+   int bitmap_flags;
+   bool upload;
+   int loaded = 0;
+   int i;
+
+   ASSERT(filenames);
+   ASSERT(bitmaps);
+
+   batch.filenames = filenames;
+   batch.flags = flags;
+   batch.bitmaps = bitmaps;
+   al_store_state(&batch.state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS |
+      ALLEGRO_STATE_NEW_FILE_INTERFACE);
+
+   /* The worker threads have no display, so decode into memory bitmaps and
+    * convert those which should be video bitmaps here afterwards.
+    */
+   bitmap_flags = al_get_new_bitmap_flags();
+   upload = !(bitmap_flags & ALLEGRO_MEMORY_BITMAP) && al_get_current_display();
+   if (upload) {
+      bitmap_flags &= ~(ALLEGRO_VIDEO_BITMAP | ALLEGRO_CONVERT_BITMAP);
+      bitmap_flags |= ALLEGRO_MEMORY_BITMAP;
+   }
+   batch.decode_bitmap_flags = bitmap_flags;
+
+   _al_run_parallel(count, load_batch_bitmap, &batch);
+
+   /* The calling thread did its share of the work, too. */
+   al_restore_state(&batch.state);
+
+   for (i = 0; i < count; i++) {
+      if (!bitmaps[i])
+         continue;
+      if (upload)
+         al_convert_bitmap(bitmaps[i]);
+      loaded++;
+   }
+
+   return loaded;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -0,0 +1,339 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Bitmap atlases, packing bitmaps into shared pages.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("bitmap")
+
+
+/* Every bitmap gets a border of this many pixels, filled with copies of its
+ * edge pixels so filtering doesn't pick up its neighbours.
+ */
+#define ATLAS_PADDING 1
+
+
+/* The pages are packed with the skyline bottom-left heuristic. The skyline
+ * is a list of segments covering the width of the page, each at the height
+ * up to which that part of the page is used.
+ */
+typedef struct SKYLINE_NODE
+{
+   int x, y, w;
+} SKYLINE_NODE;
+
+typedef struct ATLAS_PAGE
+{
+   ALLEGRO_BITMAP *bitmap;
+   _AL_VECTOR skyline;  /* of SKYLINE_NODE */
+} ATLAS_PAGE;
+
+struct ALLEGRO_BITMAP_ATLAS
+{
+   int page_w, page_h;
+   int format;
+   int flags;
+   _AL_VECTOR pages;    /* of ATLAS_PAGE */
+};
+
+
+/* Function: al_create_bitmap_atlas
+ */
+ALLEGRO_BITMAP_ATLAS *al_create_bitmap_atlas(int page_w, int page_h)
+{
+   ALLEGRO_BITMAP_ATLAS *atlas;
+   ASSERT(page_w > 0);
+   ASSERT(page_h > 0);
+
+   atlas = al_calloc(1, sizeof *atlas);
+   if (!atlas)
+      return NULL;
+
+   atlas->page_w = page_w;
+   atlas->page_h = page_h;
+   atlas->format = al_get_new_bitmap_format();
+   atlas->flags = al_get_new_bitmap_flags();
+   _al_vector_init(&atlas->pages, sizeof(ATLAS_PAGE));
+
+   return atlas;
+}
+
+
+/* Function: al_destroy_bitmap_atlas
+ */
+void al_destroy_bitmap_atlas(ALLEGRO_BITMAP_ATLAS *atlas)
+{
+   unsigned i;
+
+   if (!atlas)
+      return;
+
+   for (i = 0; i < _al_vector_size(&atlas->pages); i++) {
+      ATLAS_PAGE *page = _al_vector_ref(&atlas->pages, i);
+      al_destroy_bitmap(page->bitmap);
+      _al_vector_free(&page->skyline);
+   }
+   _al_vector_free(&atlas->pages);
+   al_free(atlas);
+}
+
+
+static ATLAS_PAGE *add_page(ALLEGRO_BITMAP_ATLAS *atlas)
+{
+   ALLEGRO_STATE state;
+   ALLEGRO_BITMAP *bitmap;
+   ATLAS_PAGE *page;
+   SKYLINE_NODE *node;
+
+   al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS |
+      ALLEGRO_STATE_TARGET_BITMAP);
+   al_set_new_bitmap_format(atlas->format);
+   al_set_new_bitmap_flags(atlas->flags);
+   bitmap = al_create_bitmap(atlas->page_w, atlas->page_h);
+   if (bitmap) {
+      al_set_target_bitmap(bitmap);
+      al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+   }
+   al_restore_state(&state);
+
+   if (!bitmap) {
+      ALLEGRO_ERROR("Failed to create a %dx%d atlas page.\n",
+         atlas->page_w, atlas->page_h);
+      return NULL;
+   }
+
+   page = _al_vector_alloc_back(&atlas->pages);
+   page->bitmap = bitmap;
+   _al_vector_init(&page->skyline, sizeof(SKYLINE_NODE));
+   node = _al_vector_alloc_back(&page->skyline);
+   node->x = 0;
+   node->y = 0;
+   node->w = atlas->page_w;
+
+   ALLEGRO_DEBUG("Added atlas page %d.\n",
+      (int)_al_vector_size(&atlas->pages) - 1);
+   return page;
+}
+
+
+/* Returns the y position a w*h rectangle gets if its left edge is put at
+ * the start of the given skyline node, or -1 if it doesn't fit there.
+ */
+static int skyline_fit(ATLAS_PAGE *page, int page_h, unsigned index,
+   int w, int h)
+{
+   SKYLINE_NODE *node = _al_vector_ref(&page->skyline, index);
+   int page_w = al_get_bitmap_width(page->bitmap);
+   int width_left = w;
+   int y = node->y;
+
+   if (node->x + w > page_w)
+      return -1;
+
+   while (width_left > 0) {
+      node = _al_vector_ref(&page->skyline, index);
+      if (node->y > y)
+         y = node->y;
+      if (y + h > page_h)
+         return -1;
+      width_left -= node->w;
+      index++;
+   }
+
+   return y;
+}
+
+
+/* Finds the position with the lowest top edge for a w*h rectangle.
+ * Returns the index of the skyline node it starts at, or -1.
+ */
+static int skyline_find(ATLAS_PAGE *page, int page_h, int w, int h,
+   int *ret_x, int *ret_y)
+{
+   int best = -1;
+   int best_top = INT_MAX;
+   int best_w = INT_MAX;
+   unsigned i;
+
+   for (i = 0; i < _al_vector_size(&page->skyline); i++) {
+      SKYLINE_NODE *node = _al_vector_ref(&page->skyline, i);
+      int y = skyline_fit(page, page_h, i, w, h);
+
+      if (y < 0)
+         continue;
+      if (y + h < best_top || (y + h == best_top && node->w < best_w)) {
+         best = i;
+         best_top = y + h;
+         best_w = node->w;
+         *ret_x = node->x;
+         *ret_y = y;
+      }
+   }
+
+   return best;
+}
+
+
+static void skyline_add(ATLAS_PAGE *page, int index, int x, int y,
+   int w, int h)
+{
+   SKYLINE_NODE *node;
+   unsigned i;
+
+   node = _al_vector_alloc_mid(&page->skyline, index);
+   node->x = x;
+   node->y = y + h;
+   node->w = w;
+
+   /* Cut away what the new node covers from the following ones. */
+   for (i = index + 1; i < _al_vector_size(&page->skyline); i++) {
+      SKYLINE_NODE *prev = _al_vector_ref(&page->skyline, i - 1);
+      SKYLINE_NODE *cur = _al_vector_ref(&page->skyline, i);
+      int shrink = prev->x + prev->w - cur->x;
+
+      if (shrink <= 0)
+         break;
+      cur->x += shrink;
+      cur->w -= shrink;
+      if (cur->w > 0)
+         break;
+      _al_vector_delete_at(&page->skyline, i);
+      i--;
+   }
+
+   /* Merge neighbours at the same height. */
+   for (i = 1; i < _al_vector_size(&page->skyline); i++) {
+      SKYLINE_NODE *prev = _al_vector_ref(&page->skyline, i - 1);
+      SKYLINE_NODE *cur = _al_vector_ref(&page->skyline, i);
+
+      if (prev->y == cur->y) {
+         prev->w += cur->w;
+         _al_vector_delete_at(&page->skyline, i);
+         i--;
+      }
+   }
+}
+
+
+/* Copies the bitmap to (x, y) of the target, extruding its edges into the
+ * padding around it.
+ */
+static void copy_padded(ALLEGRO_BITMAP *bitmap, int x, int y)
+{
+   int w = al_get_bitmap_width(bitmap);
+   int h = al_get_bitmap_height(bitmap);
+   int i, j;
+
+   al_draw_bitmap(bitmap, x, y, 0);
+
+   for (i = 1; i <= ATLAS_PADDING; i++) {
+      al_draw_bitmap_region(bitmap, 0, 0, w, 1, x, y - i, 0);
+      al_draw_bitmap_region(bitmap, 0, h - 1, w, 1, x, y + h - 1 + i, 0);
+      al_draw_bitmap_region(bitmap, 0, 0, 1, h, x - i, y, 0);
+      al_draw_bitmap_region(bitmap, w - 1, 0, 1, h, x + w - 1 + i, y, 0);
+
+      for (j = 1; j <= ATLAS_PADDING; j++) {
+         al_draw_bitmap_region(bitmap, 0, 0, 1, 1, x - i, y - j, 0);
+         al_draw_bitmap_region(bitmap, w - 1, 0, 1, 1,
+            x + w - 1 + i, y - j, 0);
+         al_draw_bitmap_region(bitmap, 0, h - 1, 1, 1,
+            x - i, y + h - 1 + j, 0);
+         al_draw_bitmap_region(bitmap, w - 1, h - 1, 1, 1,
+            x + w - 1 + i, y + h - 1 + j, 0);
+      }
+   }
+}
+
+
+/* Function: al_add_bitmap_to_atlas
+ */
+ALLEGRO_BITMAP *al_add_bitmap_to_atlas(ALLEGRO_BITMAP_ATLAS *atlas,
+   ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_STATE state;
+   ALLEGRO_TRANSFORM identity;
+   ATLAS_PAGE *page = NULL;
+   int bw = al_get_bitmap_width(bitmap);
+   int bh = al_get_bitmap_height(bitmap);
+   int w = bw + 2 * ATLAS_PADDING;
+   int h = bh + 2 * ATLAS_PADDING;
+   int index = -1;
+   int x = 0, y = 0;
+   unsigned i;
+   ASSERT(atlas);
+   ASSERT(bitmap);
+
+   if (w > atlas->page_w || h > atlas->page_h) {
+      ALLEGRO_WARN("%dx%d bitmap doesn't fit into %dx%d atlas pages.\n",
+         bw, bh, atlas->page_w, atlas->page_h);
+      return NULL;
+   }
+
+   for (i = 0; i < _al_vector_size(&atlas->pages); i++) {
+      page = _al_vector_ref(&atlas->pages, i);
+      index = skyline_find(page, atlas->page_h, w, h, &x, &y);
+      if (index >= 0)
+         break;
+   }
+   if (index < 0) {
+      page = add_page(atlas);
+      if (!page)
+         return NULL;
+      index = skyline_find(page, atlas->page_h, w, h, &x, &y);
+      ASSERT(index == 0);
+   }
+   skyline_add(page, index, x, y, w, h);
+
+   al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP |
+      ALLEGRO_STATE_BLENDER | ALLEGRO_STATE_TRANSFORM);
+   al_set_target_bitmap(page->bitmap);
+   al_identity_transform(&identity);
+   al_use_transform(&identity);
+   al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+   copy_padded(bitmap, x + ATLAS_PADDING, y + ATLAS_PADDING);
+   al_restore_state(&state);
+
+   return al_create_sub_bitmap(page->bitmap, x + ATLAS_PADDING,
+      y + ATLAS_PADDING, bw, bh);
+}
+
+
+/* Function: al_get_num_bitmap_atlas_pages
+ */
+int al_get_num_bitmap_atlas_pages(ALLEGRO_BITMAP_ATLAS *atlas)
+{
+   ASSERT(atlas);
+   return _al_vector_size(&atlas->pages);
+}
+
+
+/* Function: al_get_bitmap_atlas_page
+ */
+ALLEGRO_BITMAP *al_get_bitmap_atlas_page(ALLEGRO_BITMAP_ATLAS *atlas,
+   int index)
+{
+   ATLAS_PAGE *page;
+   ASSERT(atlas);
+
+   if (index < 0 || index >= (int)_al_vector_size(&atlas->pages))
+      return NULL;
+   page = _al_vector_ref(&atlas->pages, index);
+   return page->bitmap;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
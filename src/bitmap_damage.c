@@ -0,0 +1,188 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Tracking the area of a bitmap which was drawn to.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <math.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
+
+
+/* The drawing functions add the rectangles they clip to only while the
+ * target, or its parent, tracks damage; see _AL_TRACKS_DAMAGE. A single
+ * bounding rectangle is kept, which is what al_update_display_region can
+ * use.
+ */
+
+
+/* Function: al_set_bitmap_damage_tracking
+ */
+void al_set_bitmap_damage_tracking(ALLEGRO_BITMAP *bitmap, bool track)
+{
+   ASSERT(bitmap);
+
+   if (bitmap->parent)
+      bitmap = bitmap->parent;
+
+   bitmap->track_damage = track;
+   bitmap->damaged = false;
+}
+
+
+/* Function: al_get_bitmap_damage
+ */
+bool al_get_bitmap_damage(ALLEGRO_BITMAP *bitmap, int *x, int *y,
+   int *w, int *h)
+{
+   ASSERT(bitmap);
+
+   if (bitmap->parent)
+      bitmap = bitmap->parent;
+
+   if (!bitmap->damaged) {
+      if (x) *x = 0;
+      if (y) *y = 0;
+      if (w) *w = 0;
+      if (h) *h = 0;
+      return false;
+   }
+
+   if (x) *x = bitmap->damage_x1;
+   if (y) *y = bitmap->damage_y1;
+   if (w) *w = bitmap->damage_x2 - bitmap->damage_x1;
+   if (h) *h = bitmap->damage_y2 - bitmap->damage_y1;
+   return true;
+}
+
+
+/* Function: al_reset_bitmap_damage
+ */
+void al_reset_bitmap_damage(ALLEGRO_BITMAP *bitmap)
+{
+   ASSERT(bitmap);
+
+   if (bitmap->parent)
+      bitmap = bitmap->parent;
+
+   bitmap->damaged = false;
+}
+
+
+/* _al_damage_bitmap:
+ *  Add the rectangle from (x1, y1) up to but not including (x2, y2), in
+ *  the coordinates of the bitmap, to the damage of the bitmap or its parent.
+ */
+void _al_damage_bitmap(ALLEGRO_BITMAP *bitmap, int x1, int y1, int x2, int y2)
+{
+   x1 = _ALLEGRO_MAX(x1, 0);
+   y1 = _ALLEGRO_MAX(y1, 0);
+   x2 = _ALLEGRO_MIN(x2, bitmap->w);
+   y2 = _ALLEGRO_MIN(y2, bitmap->h);
+
+   if (bitmap->parent) {
+      x1 += bitmap->xofs;
+      y1 += bitmap->yofs;
+      x2 += bitmap->xofs;
+      y2 += bitmap->yofs;
+      bitmap = bitmap->parent;
+   }
+
+   if (!bitmap->track_damage || x1 >= x2 || y1 >= y2)
+      return;
+
+   if (!bitmap->damaged) {
+      bitmap->damage_x1 = x1;
+      bitmap->damage_y1 = y1;
+      bitmap->damage_x2 = x2;
+      bitmap->damage_y2 = y2;
+      bitmap->damaged = true;
+      return;
+   }
+
+   bitmap->damage_x1 = _ALLEGRO_MIN(bitmap->damage_x1, x1);
+   bitmap->damage_y1 = _ALLEGRO_MIN(bitmap->damage_y1, y1);
+   bitmap->damage_x2 = _ALLEGRO_MAX(bitmap->damage_x2, x2);
+   bitmap->damage_y2 = _ALLEGRO_MAX(bitmap->damage_y2, y2);
+}
+
+
+/* _al_damage_target:
+ *  Add the bounding box of the rectangle from (x1, y1) to (x2, y2),
+ *  transformed by trans unless it is NULL, clipped to the clipping
+ *  rectangle of the target. Every pixel the rectangle touches counts,
+ *  so lines and points have an area too.
+ */
+void _al_damage_target(ALLEGRO_BITMAP *target, const ALLEGRO_TRANSFORM *trans,
+   float x1, float y1, float x2, float y2)
+{
+   float min_x = _ALLEGRO_MIN(x1, x2);
+   float min_y = _ALLEGRO_MIN(y1, y2);
+   float max_x = _ALLEGRO_MAX(x1, x2);
+   float max_y = _ALLEGRO_MAX(y1, y2);
+
+   if (trans) {
+      float xs[4] = {x1, x2, x2, x1};
+      float ys[4] = {y1, y1, y2, y2};
+      int i;
+
+      for (i = 0; i < 4; i++)
+         al_transform_coordinates(trans, &xs[i], &ys[i]);
+      min_x = max_x = xs[0];
+      min_y = max_y = ys[0];
+      for (i = 1; i < 4; i++) {
+         min_x = _ALLEGRO_MIN(min_x, xs[i]);
+         min_y = _ALLEGRO_MIN(min_y, ys[i]);
+         max_x = _ALLEGRO_MAX(max_x, xs[i]);
+         max_y = _ALLEGRO_MAX(max_y, ys[i]);
+      }
+   }
+
+   /* Clip before converting, the coordinates can be anything. */
+   min_x = _ALLEGRO_MAX(min_x, target->cl);
+   min_y = _ALLEGRO_MAX(min_y, target->ct);
+   max_x = _ALLEGRO_MIN(max_x, target->cr_excl - 1);
+   max_y = _ALLEGRO_MIN(max_y, target->cb_excl - 1);
+   if (!(min_x <= max_x && min_y <= max_y))
+      return;
+
+   _al_damage_bitmap(target, (int)floorf(min_x), (int)floorf(min_y),
+      (int)floorf(max_x) + 1, (int)floorf(max_y) + 1);
+}
+
+
+/* _al_damage_clipping_rectangle:
+ *  Add the whole clipping rectangle of the target, for drawing whose area
+ *  is not known.
+ */
+void _al_damage_clipping_rectangle(ALLEGRO_BITMAP *target)
+{
+   _al_damage_bitmap(target, target->cl, target->ct,
+      target->cr_excl, target->cb_excl);
+}
+
+
+/* _al_lock_drawn_region:
+ *  Lock a region of the target for software drawing, which added what it
+ *  draws to the damage already. The region locked may be larger, so it
+ *  is not added.
+ */
+ALLEGRO_LOCKED_REGION *_al_lock_drawn_region(ALLEGRO_BITMAP *bitmap,
+   int x, int y, int width, int height)
+{
+   return _al_lock_bitmap_region(bitmap, x, y, width, height,
+      ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READWRITE, false);
+}
+
+/* vim: set sts=3 sw=3 et: */
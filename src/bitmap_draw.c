@@ -13,17 +13,39 @@
  *      See LICENSE.txt for copyright information.
  */
 
+#include <string.h>
 
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_memblit.h"
 #include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_tls.h"
+#include "allegro5/internal/aintern_vector.h"
 
 
 static ALLEGRO_COLOR solid_white = {1, 1, 1, 1};
 
 
+/* Bitmaps drawn into a display independent draw list, usually on a thread
+ * without a display, keep the transformation the region is drawn with.
+ * Consecutive regions of one bitmap become a single command, replayed with
+ * drawing held.
+ */
+typedef struct RECORDED_REGION {
+   ALLEGRO_TRANSFORM transform;
+   ALLEGRO_COLOR tint;
+   float sx, sy, sw, sh;
+   int flags;
+} RECORDED_REGION;
+
+typedef struct RECORDED_REGIONS {
+   ALLEGRO_BITMAP *bitmap;
+   _AL_VECTOR regions;
+} RECORDED_REGIONS;
+
+
 static void _bitmap_drawer(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR tint,
    float sx, float sy, float sw, float sh, int flags)
 {
@@ -33,6 +55,9 @@ static void _bitmap_drawer(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR tint,
    ASSERT(!(flags & (ALLEGRO_FLIP_HORIZONTAL | ALLEGRO_FLIP_VERTICAL)));
    ASSERT(bitmap != dest && bitmap != dest->parent);
 
+   if (_AL_TRACKS_DAMAGE(dest))
+      _al_damage_target(dest, al_get_current_transform(), 0, 0, sw, sh);
+
    /* If destination is memory, do a memory blit */
    if (al_get_bitmap_flags(dest) & ALLEGRO_MEMORY_BITMAP ||
        _al_pixel_format_is_compressed(al_get_bitmap_format(dest))) {
@@ -59,6 +84,83 @@ static void _bitmap_drawer(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR tint,
 }
 
 
+static void replay_regions(ALLEGRO_DISPLAY *display, void *data)
+{
+   RECORDED_REGIONS *rec = data;
+   ALLEGRO_TRANSFORM base;
+   ALLEGRO_TRANSFORM t;
+   bool identity;
+   bool held;
+   unsigned i;
+   (void)display;
+
+   al_copy_transform(&base, al_get_current_transform());
+   al_identity_transform(&t);
+   identity = (memcmp(&base, &t, sizeof(t)) == 0);
+
+   _al_mark_bitmap_used(rec->bitmap,
+      _al_get_bitmap_display(al_get_target_bitmap()));
+
+   held = al_is_bitmap_drawing_held();
+   al_hold_bitmap_drawing(true);
+   for (i = 0; i < _al_vector_size(&rec->regions); i++) {
+      const RECORDED_REGION *r = _al_vector_ref(&rec->regions, i);
+      if (identity) {
+         al_use_transform(&r->transform);
+      }
+      else {
+         al_copy_transform(&t, &r->transform);
+         al_compose_transform(&t, &base);
+         al_use_transform(&t);
+      }
+      _bitmap_drawer(rec->bitmap, r->tint, r->sx, r->sy, r->sw, r->sh,
+         r->flags);
+   }
+   al_use_transform(&base);
+   al_hold_bitmap_drawing(held);
+}
+
+
+static void destroy_regions(void *data)
+{
+   RECORDED_REGIONS *rec = data;
+   _al_vector_free(&rec->regions);
+   al_free(rec);
+}
+
+
+static void record_region(ALLEGRO_DRAW_LIST *list, ALLEGRO_BITMAP *parent,
+   ALLEGRO_COLOR tint, const ALLEGRO_TRANSFORM *t,
+   float sx, float sy, float sw, float sh, int flags)
+{
+   RECORDED_REGIONS *rec;
+   RECORDED_REGION *r;
+
+   _al_update_draw_recording_blender(list);
+   rec = _al_draw_list_last_data(list, replay_regions);
+   if (!rec || rec->bitmap != parent) {
+      rec = al_malloc(sizeof(*rec));
+      if (!rec)
+         return;
+      rec->bitmap = parent;
+      _al_vector_init(&rec->regions, sizeof(RECORDED_REGION));
+      if (!_al_draw_list_add(list, replay_regions, destroy_regions, rec))
+         return;
+   }
+
+   r = _al_vector_alloc_back(&rec->regions);
+   if (!r)
+      return;
+   al_copy_transform(&r->transform, t);
+   r->tint = tint;
+   r->sx = sx;
+   r->sy = sy;
+   r->sw = sw;
+   r->sh = sh;
+   r->flags = flags;
+}
+
+
 static void _draw_tinted_rotated_scaled_bitmap_region(ALLEGRO_BITMAP *bitmap,
    ALLEGRO_COLOR tint, float cx, float cy, float angle,
    float xscale, float yscale,
@@ -70,8 +172,13 @@ static void _draw_tinted_rotated_scaled_bitmap_region(ALLEGRO_BITMAP *bitmap,
    ALLEGRO_BITMAP *parent = bitmap;
    float const orig_sw = sw;
    float const orig_sh = sh;
+   ALLEGRO_DRAW_LIST *recording = _al_tls_get_draw_recording();
    ASSERT(bitmap);
 
+   if (!recording)
+      _al_mark_bitmap_used(bitmap,
+         _al_get_bitmap_display(al_get_target_bitmap()));
+
    al_copy_transform(&backup, al_get_current_transform());
    al_identity_transform(&t);
    
@@ -114,6 +221,11 @@ static void _draw_tinted_rotated_scaled_bitmap_region(ALLEGRO_BITMAP *bitmap,
    al_translate_transform(&t, dx, dy);
    al_compose_transform(&t, &backup);
 
+   if (recording) {
+      record_region(recording, parent, tint, &t, sx, sy, sw, sh, flags);
+      return;
+   }
+
    al_use_transform(&t);
    _bitmap_drawer(parent, tint, sx, sy, sw, sh, flags);
    al_use_transform(&backup);
@@ -250,4 +362,125 @@ void al_draw_scaled_rotated_bitmap(ALLEGRO_BITMAP *bitmap,
 }
 
 
+/* Returns true if the regions can be handed to the bitmap driver in one go,
+ * which needs the same conditions as the accelerated path in _bitmap_drawer
+ * and all regions inside the bitmap so no clipping is needed.
+ */
+static bool can_draw_regions(ALLEGRO_BITMAP *bitmap, float xofs, float yofs,
+   const _AL_BITMAP_REGION *regions, int count)
+{
+   ALLEGRO_BITMAP *dest = al_get_target_bitmap();
+   int i;
+
+   if (!bitmap->vt || !bitmap->vt->draw_bitmap_regions)
+      return false;
+   if (al_get_bitmap_flags(dest) & ALLEGRO_MEMORY_BITMAP ||
+       _al_pixel_format_is_compressed(al_get_bitmap_format(dest)))
+      return false;
+   if ((al_get_bitmap_flags(bitmap) & ALLEGRO_MEMORY_BITMAP) ||
+       !al_is_compatible_bitmap(bitmap))
+      return false;
+   if (bitmap == dest || bitmap == dest->parent)
+      return false;
+
+   for (i = 0; i < count; i++) {
+      const _AL_BITMAP_REGION *r = &regions[i];
+      if (r->sx + xofs < 0 || r->sy + yofs < 0 ||
+          r->sx + xofs + r->sw > bitmap->w ||
+          r->sy + yofs + r->sh > bitmap->h)
+         return false;
+   }
+   return true;
+}
+
+
+static void damage_regions(const _AL_BITMAP_REGION *regions, int count)
+{
+   float x1 = regions[0].dx;
+   float y1 = regions[0].dy;
+   float x2 = regions[0].dx + regions[0].sw;
+   float y2 = regions[0].dy + regions[0].sh;
+   int i;
+
+   for (i = 1; i < count; i++) {
+      const _AL_BITMAP_REGION *r = &regions[i];
+      x1 = _ALLEGRO_MIN(x1, r->dx);
+      y1 = _ALLEGRO_MIN(y1, r->dy);
+      x2 = _ALLEGRO_MAX(x2, r->dx + r->sw);
+      y2 = _ALLEGRO_MAX(y2, r->dy + r->sh);
+   }
+   _al_damage_target(al_get_target_bitmap(), al_get_current_transform(),
+      x1, y1, x2, y2);
+}
+
+
+/* Internal function: _al_draw_tinted_bitmap_regions
+ *
+ * Draws a number of regions of one bitmap with the same tint, as if by
+ * calling al_draw_tinted_bitmap_region for each of them. Where the driver
+ * supports it, they are all added to the vertex cache in one go without
+ * setting up a transformation per region, whether drawing is held or not.
+ * A thread recording a display independent draw list records them one by
+ * one.
+ */
+void _al_draw_tinted_bitmap_regions(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_COLOR tint, const _AL_BITMAP_REGION *regions, int count)
+{
+   ALLEGRO_BITMAP *parent = bitmap->parent ? bitmap->parent : bitmap;
+   bool held;
+   int i;
+   ASSERT(bitmap);
+   ASSERT(regions || count == 0);
+
+   if (count <= 0)
+      return;
+
+   if (_al_tls_get_draw_recording())
+      goto one_by_one;
+
+   _al_mark_bitmap_used(bitmap, _al_get_bitmap_display(al_get_target_bitmap()));
+
+   if (_AL_TRACKS_DAMAGE(al_get_target_bitmap()))
+      damage_regions(regions, count);
+
+   if (!bitmap->parent) {
+      if (can_draw_regions(bitmap, 0, 0, regions, count) &&
+          bitmap->vt->draw_bitmap_regions(bitmap, tint, regions, count))
+         return;
+   }
+   else if (can_draw_regions(parent, bitmap->xofs, bitmap->yofs,
+         regions, count)) {
+      _AL_BITMAP_REGION moved[64];
+      int done = 0;
+
+      while (done < count) {
+         int n = _ALLEGRO_MIN(count - done, 64);
+
+         for (i = 0; i < n; i++) {
+            moved[i] = regions[done + i];
+            moved[i].sx += bitmap->xofs;
+            moved[i].sy += bitmap->yofs;
+         }
+         if (!parent->vt->draw_bitmap_regions(parent, tint, moved, n))
+            break;
+         done += n;
+      }
+      if (done == count)
+         return;
+      regions += done;
+      count -= done;
+   }
+
+one_by_one:
+   held = al_is_bitmap_drawing_held();
+   al_hold_bitmap_drawing(true);
+   for (i = 0; i < count; i++) {
+      const _AL_BITMAP_REGION *r = &regions[i];
+      al_draw_tinted_bitmap_region(bitmap, tint, r->sx, r->sy, r->sw, r->sh,
+         r->dx, r->dy, 0);
+   }
+   al_hold_bitmap_drawing(held);
+}
+
+
 /* vim: set ts=8 sts=3 sw=3 et: */
@@ -204,7 +204,9 @@ ALLEGRO_BITMAP *al_load_bitmap_flags(const char *filename, int flags)
 
    h = find_handler(ext, false);
    if (h && h->loader) {
+      al_profile_begin("al_load_bitmap");
       ret = h->loader(filename, flags);
+      al_profile_end();
       if (!ret)
          ALLEGRO_ERROR("Failed loading bitmap %s with %s handler.\n",
             filename, ext);
@@ -268,8 +270,13 @@ ALLEGRO_BITMAP *al_load_bitmap_flags_f(ALLEGRO_FILE *fp,
       h = find_handler(ident, false);
    else
       h = find_handler_for_file(fp);
-   if (h && h->fs_loader)
-      return h->fs_loader(fp, flags);
+   if (h && h->fs_loader) {
+      ALLEGRO_BITMAP *ret;
+      al_profile_begin("al_load_bitmap_f");
+      ret = h->fs_loader(fp, flags);
+      al_profile_end();
+      return ret;
+   }
    else
       return NULL;
 }
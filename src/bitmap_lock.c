@@ -17,15 +17,316 @@
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_display.h"
+#include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_thread.h"
 
 
-/* Function: al_lock_bitmap_region
+/* copy_tiled:
+ *  Copy a region of a tiled memory bitmap to or from a linear buffer in
+ *  the given format, one tile at a time.
  */
-ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
-   int x, int y, int width, int height, int format, int flags)
+static void copy_tiled(ALLEGRO_BITMAP *bitmap, int x, int y, int w, int h,
+   void *data, int format, int pitch, bool to_tiled)
+{
+   const int bitmap_format = bitmap->_format;
+   const int pixel_size = al_get_pixel_size(bitmap_format);
+   const int tile_pitch = _AL_TILE_SIZE * pixel_size;
+   int tx, ty;
+
+   for (ty = y & ~_AL_TILE_MASK; ty < y + h; ty += _AL_TILE_SIZE) {
+      const int y1 = _ALLEGRO_MAX(ty, y);
+      const int y2 = _ALLEGRO_MIN(ty + _AL_TILE_SIZE, y + h);
+
+      for (tx = x & ~_AL_TILE_MASK; tx < x + w; tx += _AL_TILE_SIZE) {
+         const int x1 = _ALLEGRO_MAX(tx, x);
+         const int x2 = _ALLEGRO_MIN(tx + _AL_TILE_SIZE, x + w);
+         unsigned char *tile = bitmap->memory +
+            _AL_TILED_OFFSET(bitmap->pitch, pixel_size, tx, ty);
+
+         if (to_tiled) {
+            _al_convert_bitmap_data(data, format, pitch,
+               tile, bitmap_format, tile_pitch,
+               x1 - x, y1 - y, x1 - tx, y1 - ty, x2 - x1, y2 - y1);
+         }
+         else {
+            _al_convert_bitmap_data(tile, bitmap_format, tile_pitch,
+               data, format, pitch,
+               x1 - tx, y1 - ty, x1 - x, y1 - y, x2 - x1, y2 - y1);
+         }
+      }
+   }
+}
+
+
+/* Memory bitmaps are locked without touching the parent, except to link
+ * the lock into its list. Two locks of one parent may not overlap unless
+ * both are read-only. A read-only lock which reads the pixels in place can
+ * also be shared by other threads locking the same region of the same
+ * bitmap or sub-bitmap the same way, as the drawing functions do with the
+ * bitmaps they draw; lock_readers counts them.
+ *
+ * The lists are guarded by a few mutexes picked by the address of the
+ * parent, held just while a list is searched or changed, so threads locking
+ * different bitmaps rarely wait for each other.
+ */
+#define NUM_REGION_LOCK_MUTEXES  16
+
+static _AL_MUTEX region_lock_mutexes[NUM_REGION_LOCK_MUTEXES];
+static bool region_lock_mutexes_inited = false;
+
+
+static void destroy_region_locks(void)
+{
+   int i;
+
+   for (i = 0; i < NUM_REGION_LOCK_MUTEXES; i++)
+      _al_mutex_destroy(&region_lock_mutexes[i]);
+   region_lock_mutexes_inited = false;
+}
+
+
+/* This is called in al_install_system. */
+void _al_init_region_locks(void)
+{
+   int i;
+
+   if (region_lock_mutexes_inited)
+      return;
+   for (i = 0; i < NUM_REGION_LOCK_MUTEXES; i++)
+      _al_mutex_init(&region_lock_mutexes[i]);
+   region_lock_mutexes_inited = true;
+   _al_add_exit_func(destroy_region_locks, "destroy_region_locks");
+}
+
+
+static _AL_MUTEX *region_lock_mutex(ALLEGRO_BITMAP *parent)
+{
+   uintptr_t h = (uintptr_t)parent;
+
+   if (!region_lock_mutexes_inited)
+      return NULL;
+   return &region_lock_mutexes[((h >> 6) ^ (h >> 12)) % NUM_REGION_LOCK_MUTEXES];
+}
+
+
+static bool region_locks_overlap(ALLEGRO_BITMAP *a, ALLEGRO_BITMAP *b)
+{
+   if ((a->lock_flags & ALLEGRO_LOCK_READONLY) &&
+         (b->lock_flags & ALLEGRO_LOCK_READONLY))
+      return false;
+   return a->lock_x < b->lock_x + b->lock_w && b->lock_x < a->lock_x + a->lock_w &&
+      a->lock_y < b->lock_y + b->lock_h && b->lock_y < a->lock_y + a->lock_h;
+}
+
+
+/* Must be called with the mutex of the parent held. */
+static void unlink_region_lock(ALLEGRO_BITMAP *parent, ALLEGRO_BITMAP *lock)
+{
+   ALLEGRO_BITMAP **link;
+
+   for (link = &parent->region_locks; *link; link = &(*link)->next_region_lock) {
+      if (*link == lock) {
+         *link = lock->next_region_lock;
+         break;
+      }
+   }
+   lock->next_region_lock = NULL;
+   lock->lock_readers = 0;
+   lock->locked = false;
+}
+
+
+static void remove_region_lock(ALLEGRO_BITMAP *parent, ALLEGRO_BITMAP *lock)
+{
+   _AL_MUTEX *mutex = region_lock_mutex(parent);
+
+   if (mutex)
+      _al_mutex_lock(mutex);
+   unlink_region_lock(parent, lock);
+   if (mutex)
+      _al_mutex_unlock(mutex);
+}
+
+
+/* lock_memory_bitmap:
+ *  Lock a region of the memory bitmap through lock, which is the bitmap or
+ *  one of its sub-bitmaps. The region is in the coordinates of the bitmap.
+ */
+static ALLEGRO_LOCKED_REGION *lock_memory_bitmap(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_BITMAP *lock, int x, int y, int width, int height, int format,
+   int flags)
+{
+   ALLEGRO_LOCKED_REGION *lr = &lock->locked_region;
+   _AL_MUTEX *mutex = region_lock_mutex(bitmap);
+   const int bitmap_format = bitmap->_format;
+   const int bitmap_flags = bitmap->_flags;
+   ALLEGRO_BITMAP *other;
+   bool in_place;
+   int f;
+
+   f = _al_get_real_pixel_format(al_get_current_display(), format);
+   if (f < 0) {
+      return NULL;
+   }
+   ASSERT(bitmap->memory);
+   in_place = !(bitmap_flags & ALLEGRO_TILED_BITMAP) &&
+      (format == ALLEGRO_PIXEL_FORMAT_ANY || bitmap_format == format ||
+       bitmap_format == f);
+
+   if (mutex)
+      _al_mutex_lock(mutex);
+
+   if (lock->locked) {
+      if (lock->lock_readers > 0 && in_place &&
+            flags == ALLEGRO_LOCK_READONLY &&
+            lock->lock_x == x && lock->lock_y == y &&
+            lock->lock_w == width && lock->lock_h == height) {
+         lock->lock_readers++;
+      }
+      else {
+         lr = NULL;
+      }
+      if (mutex)
+         _al_mutex_unlock(mutex);
+      return lr;
+   }
+
+   lock->lock_x = x;
+   lock->lock_y = y;
+   lock->lock_w = width;
+   lock->lock_h = height;
+   lock->lock_flags = flags;
+
+   for (other = bitmap->region_locks; other; other = other->next_region_lock) {
+      if (region_locks_overlap(other, lock)) {
+         if (mutex)
+            _al_mutex_unlock(mutex);
+         return NULL;
+      }
+   }
+   lock->next_region_lock = bitmap->region_locks;
+   bitmap->region_locks = lock;
+   lock->lock_readers = 0;
+   lock->locked = true;
+
+   if (in_place) {
+      lr->data = bitmap->memory
+         + bitmap->pitch * y + x * al_get_pixel_size(bitmap_format);
+      lr->format = bitmap_format;
+      lr->pitch = bitmap->pitch;
+      lr->pixel_size = al_get_pixel_size(bitmap_format);
+      lock->lock_data = lr->data;
+      if (flags == ALLEGRO_LOCK_READONLY)
+         lock->lock_readers = 1;
+   }
+
+   if (mutex)
+      _al_mutex_unlock(mutex);
+
+   if (in_place)
+      return lr;
+
+   /* The pixels are copied, from the tiles or into another format. */
+   if ((bitmap_flags & ALLEGRO_TILED_BITMAP) &&
+         (format == ALLEGRO_PIXEL_FORMAT_ANY || bitmap_format == format))
+      f = bitmap_format;
+   lr->pitch = al_get_pixel_size(f) * width;
+   lr->data = al_malloc(lr->pitch * height);
+   if (!lr->data) {
+      remove_region_lock(bitmap, lock);
+      return NULL;
+   }
+   lr->format = f;
+   lr->pixel_size = al_get_pixel_size(f);
+
+   if (!(flags & ALLEGRO_LOCK_WRITEONLY)) {
+      if (bitmap_flags & ALLEGRO_TILED_BITMAP) {
+         copy_tiled(bitmap, x, y, width, height, lr->data, f, lr->pitch,
+            false);
+      }
+      else if (bitmap_flags & ALLEGRO_PARALLEL_CONVERSION) {
+         _al_parallel_convert_bitmap_data(
+            bitmap->memory, bitmap_format, bitmap->pitch,
+            lr->data, f, lr->pitch,
+            x, y, 0, 0, width, height);
+      }
+      else {
+         _al_convert_bitmap_data(
+            bitmap->memory, bitmap_format, bitmap->pitch,
+            lr->data, f, lr->pitch,
+            x, y, 0, 0, width, height);
+      }
+   }
+
+   lock->lock_data = lr->data;
+   return lr;
+}
+
+
+/* unlock_memory_bitmap:
+ *  Write back and free the copy made by lock_memory_bitmap, if any, and
+ *  unlink the lock once the last thread sharing it unlocks it.
+ */
+static void unlock_memory_bitmap(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *lock)
+{
+   ALLEGRO_LOCKED_REGION *lr = &lock->locked_region;
+   _AL_MUTEX *mutex = region_lock_mutex(bitmap);
+   const int bitmap_format = bitmap->_format;
+   const int bitmap_flags = bitmap->_flags;
+
+   if (mutex)
+      _al_mutex_lock(mutex);
+   if (lock->lock_readers > 0) {
+      if (--lock->lock_readers == 0)
+         unlink_region_lock(bitmap, lock);
+      if (mutex)
+         _al_mutex_unlock(mutex);
+      return;
+   }
+   if (mutex)
+      _al_mutex_unlock(mutex);
+
+   if (bitmap_flags & ALLEGRO_TILED_BITMAP) {
+      if (!(lock->lock_flags & ALLEGRO_LOCK_READONLY)) {
+         copy_tiled(bitmap, lock->lock_x, lock->lock_y,
+            lock->lock_w, lock->lock_h, lr->data,
+            lr->format, lr->pitch, true);
+      }
+      al_free(lr->data);
+   }
+   else if (lr->format != 0 && lr->format != bitmap_format) {
+      if (!(lock->lock_flags & ALLEGRO_LOCK_READONLY)) {
+         if (bitmap_flags & ALLEGRO_PARALLEL_CONVERSION) {
+            _al_parallel_convert_bitmap_data(
+               lr->data, lr->format, lr->pitch,
+               bitmap->memory, bitmap_format, bitmap->pitch,
+               0, 0, lock->lock_x, lock->lock_y, lock->lock_w, lock->lock_h);
+         }
+         else {
+            _al_convert_bitmap_data(
+               lr->data, lr->format, lr->pitch,
+               bitmap->memory, bitmap_format, bitmap->pitch,
+               0, 0, lock->lock_x, lock->lock_y, lock->lock_w, lock->lock_h);
+         }
+      }
+      al_free(lr->data);
+   }
+
+   remove_region_lock(bitmap, lock);
+}
+
+
+/* _al_lock_bitmap_region:
+ *  Like al_lock_bitmap_region, but only adds the locked region to the
+ *  damage of the bitmap if damage is true.
+ */
+ALLEGRO_LOCKED_REGION *_al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
+   int x, int y, int width, int height, int format, int flags, bool damage)
 {
    ALLEGRO_LOCKED_REGION *lr;
+   ALLEGRO_BITMAP *lock = bitmap;
    int bitmap_format = al_get_bitmap_format(bitmap);
    int bitmap_flags = al_get_bitmap_flags(bitmap);
    int block_width = al_get_pixel_block_width(bitmap_format);
@@ -48,16 +349,24 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
       bitmap = bitmap->parent;
    }
 
+   ASSERT(x+width <= bitmap->w);
+   ASSERT(y+height <= bitmap->h);
+
+   if (bitmap_flags & ALLEGRO_MEMORY_BITMAP) {
+      lr = lock_memory_bitmap(bitmap, lock, x, y, width, height, format,
+         flags);
+      if (lr && damage && !(flags & ALLEGRO_LOCK_READONLY) &&
+            bitmap->track_damage)
+         _al_damage_bitmap(bitmap, x, y, x + width, y + height);
+      return lr;
+   }
+
    if (bitmap->locked)
       return NULL;
 
-   if (!(bitmap_flags & ALLEGRO_MEMORY_BITMAP) &&
-         !(flags & ALLEGRO_LOCK_READONLY))
+   if (!(flags & ALLEGRO_LOCK_READONLY))
       bitmap->dirty = true;
 
-   ASSERT(x+width <= bitmap->w);
-   ASSERT(y+height <= bitmap->h);
-
    xc = (x / block_width) * block_width;
    yc = (y / block_height) * block_height;
    wc = _al_get_least_multiple(x + width, block_width) - xc;
@@ -77,40 +386,14 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
       flags = ALLEGRO_LOCK_READWRITE;
    }
 
-   if (bitmap_flags & ALLEGRO_MEMORY_BITMAP) {
-      int f = _al_get_real_pixel_format(al_get_current_display(), format);
-      if (f < 0) {
-         return NULL;
-      }
-      ASSERT(bitmap->memory);
-      if (format == ALLEGRO_PIXEL_FORMAT_ANY || bitmap_format == format || bitmap_format == f) {
-         bitmap->locked_region.data = bitmap->memory
-            + bitmap->pitch * yc + xc * al_get_pixel_size(bitmap_format);
-         bitmap->locked_region.format = bitmap_format;
-         bitmap->locked_region.pitch = bitmap->pitch;
-         bitmap->locked_region.pixel_size = al_get_pixel_size(bitmap_format);
-      }
-      else {
-         bitmap->locked_region.pitch = al_get_pixel_size(f) * wc;
-         bitmap->locked_region.data = al_malloc(bitmap->locked_region.pitch*hc);
-         bitmap->locked_region.format = f;
-         bitmap->locked_region.pixel_size = al_get_pixel_size(f);
-         if (!(bitmap->lock_flags & ALLEGRO_LOCK_WRITEONLY)) {
-            _al_convert_bitmap_data(
-               bitmap->memory, bitmap_format, bitmap->pitch,
-               bitmap->locked_region.data, f, bitmap->locked_region.pitch,
-               xc, yc, 0, 0, wc, hc);
-         }
-      }
-      lr = &bitmap->locked_region;
-   }
-   else {
-      lr = bitmap->vt->lock_region(bitmap, xc, yc, wc, hc, format, flags);
-      if (!lr) {
-         return NULL;
-      }
+   lr = bitmap->vt->lock_region(bitmap, xc, yc, wc, hc, format, flags);
+   if (!lr) {
+      return NULL;
    }
 
+   if (damage && !(flags & ALLEGRO_LOCK_READONLY) && bitmap->track_damage)
+      _al_damage_bitmap(bitmap, x, y, x + width, y + height);
+
    bitmap->lock_data = lr->data;
    /* Fixup the data pointer for unaligned access */
    lr->data = (char*)lr->data + (x - xc) * lr->pixel_size + (y - yc) * lr->pitch;
@@ -121,6 +404,16 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
 }
 
 
+/* Function: al_lock_bitmap_region
+ */
+ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
+   int x, int y, int width, int height, int format, int flags)
+{
+   return _al_lock_bitmap_region(bitmap, x, y, width, height, format, flags,
+      true);
+}
+
+
 /* Function: al_lock_bitmap
  */
 ALLEGRO_LOCKED_REGION *al_lock_bitmap(ALLEGRO_BITMAP *bitmap,
@@ -134,29 +427,27 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap(ALLEGRO_BITMAP *bitmap,
  */
 void al_unlock_bitmap(ALLEGRO_BITMAP *bitmap)
 {
-   int bitmap_format = al_get_bitmap_format(bitmap);
+   ALLEGRO_BITMAP *lock = _AL_LOCK_HOLDER(bitmap);
+
    /* For sub-bitmaps */
    if (bitmap->parent) {
       bitmap = bitmap->parent;
    }
 
-   if (!(al_get_bitmap_flags(bitmap) & ALLEGRO_MEMORY_BITMAP)) {
-      if (_al_pixel_format_is_compressed(bitmap->locked_region.format))
-         bitmap->vt->unlock_compressed_region(bitmap);
-      else
-         bitmap->vt->unlock_region(bitmap);
+   if (al_get_bitmap_flags(bitmap) & ALLEGRO_MEMORY_BITMAP) {
+      if (lock->locked)
+         unlock_memory_bitmap(bitmap, lock);
+      return;
    }
-   else {
-      if (bitmap->locked_region.format != 0 && bitmap->locked_region.format != bitmap_format) {
-         if (!(bitmap->lock_flags & ALLEGRO_LOCK_READONLY)) {
-            _al_convert_bitmap_data(
-               bitmap->locked_region.data, bitmap->locked_region.format, bitmap->locked_region.pitch,
-               bitmap->memory, bitmap_format, bitmap->pitch,
-               0, 0, bitmap->lock_x, bitmap->lock_y, bitmap->lock_w, bitmap->lock_h);
-         }
-         al_free(bitmap->locked_region.data);
-      }
+
+   if (!(bitmap->lock_flags & ALLEGRO_LOCK_READONLY)) {
+      _al_count_texture_upload(_al_get_bitmap_display(bitmap),
+         bitmap->locked_region.format, bitmap->lock_w, bitmap->lock_h);
    }
+   if (_al_pixel_format_is_compressed(bitmap->locked_region.format))
+      bitmap->vt->unlock_compressed_region(bitmap);
+   else
+      bitmap->vt->unlock_region(bitmap);
 
    bitmap->locked = false;
 }
@@ -242,9 +533,52 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region_blocked(ALLEGRO_BITMAP *bitmap,
       return NULL;
    }
 
+   if (!(flags & ALLEGRO_LOCK_READONLY) && bitmap->track_damage) {
+      _al_damage_bitmap(bitmap, bitmap->lock_x, bitmap->lock_y,
+         bitmap->lock_x + bitmap->lock_w, bitmap->lock_y + bitmap->lock_h);
+   }
+
    bitmap->locked = true;
 
    return lr;
 }
 
+
+/* Internal function: _al_upload_bitmap_mipmap
+ *
+ * Replaces one mipmap level of a video bitmap with pixel data in the
+ * bitmap's own format, or blocks for compressed formats, top row first.
+ * Level 0 is the bitmap itself, the other levels need ALLEGRO_MIPMAP. This
+ * lets loaders use the levels stored in a file instead of generating them.
+ * Returns false if the driver can't do it.
+ */
+bool _al_upload_bitmap_mipmap(ALLEGRO_BITMAP *bitmap, int level,
+   const void *data, int pitch)
+{
+   int bitmap_flags = al_get_bitmap_flags(bitmap);
+   ASSERT(bitmap);
+   ASSERT(data);
+   ASSERT(level >= 0);
+
+   if (bitmap->parent || bitmap->locked)
+      return false;
+   if (bitmap_flags & ALLEGRO_MEMORY_BITMAP)
+      return false;
+   if (level > 0 && !(bitmap_flags & ALLEGRO_MIPMAP))
+      return false;
+   if (!bitmap->vt->upload_mipmap)
+      return false;
+
+   if (!bitmap->vt->upload_mipmap(bitmap, level, data, pitch))
+      return false;
+
+   _al_count_texture_upload(_al_get_bitmap_display(bitmap),
+      al_get_bitmap_format(bitmap), _ALLEGRO_MAX(1, bitmap->w >> level),
+      _ALLEGRO_MAX(1, bitmap->h >> level));
+
+   if (level == 0)
+      bitmap->dirty = true;
+   return true;
+}
+
 /* vim: set ts=8 sts=3 sw=3 et: */
@@ -15,6 +15,7 @@
 
 #include <string.h> /* for memset */
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_blend.h"
 #include "allegro5/internal/aintern_pixels.h"
@@ -22,10 +23,38 @@
 ALLEGRO_DEBUG_CHANNEL("bitmap")
 
 
+/* lock_pixels:
+ *  Lock a row of n pixels at (x, y), in the coordinates of the parent of a
+ *  sub-bitmap, through the sub-bitmap if the row is inside it. Threads with
+ *  their own sub-bitmaps of one memory bitmap then don't lock each other
+ *  out. Sets *locked to the bitmap to unlock.
+ */
+static ALLEGRO_LOCKED_REGION *lock_pixels(ALLEGRO_BITMAP *bitmap,
+   int x, int y, int n, int flags, ALLEGRO_BITMAP **locked)
+{
+   if (bitmap->parent) {
+      const int sx = x - bitmap->xofs;
+      const int sy = y - bitmap->yofs;
+
+      if (sx >= 0 && sy >= 0 && sx + n <= bitmap->w && sy < bitmap->h) {
+         *locked = bitmap;
+         return al_lock_bitmap_region(bitmap, sx, sy, n, 1,
+            ALLEGRO_PIXEL_FORMAT_ANY, flags);
+      }
+      bitmap = bitmap->parent;
+   }
+   *locked = bitmap;
+   return al_lock_bitmap_region(bitmap, x, y, n, 1, ALLEGRO_PIXEL_FORMAT_ANY,
+      flags);
+}
+
+
 /* Function: al_get_pixel
  */
 ALLEGRO_COLOR al_get_pixel(ALLEGRO_BITMAP *bitmap, int x, int y)
 {
+   ALLEGRO_BITMAP *handle = bitmap;
+   ALLEGRO_BITMAP *lock = _AL_LOCK_HOLDER(bitmap);
    ALLEGRO_LOCKED_REGION *lr;
    char *data;
    ALLEGRO_COLOR color = al_map_rgba_f(0, 0, 0, 0);
@@ -36,23 +65,23 @@ ALLEGRO_COLOR al_get_pixel(ALLEGRO_BITMAP *bitmap, int x, int y)
       bitmap = bitmap->parent;
    }
 
-   if (bitmap->locked) {
-      if (_al_pixel_format_is_video_only(bitmap->locked_region.format)) {
+   if (lock->locked) {
+      if (_al_pixel_format_is_video_only(lock->locked_region.format)) {
          ALLEGRO_ERROR("Invalid lock format.");
          return color;
       }
-      x -= bitmap->lock_x;
-      y -= bitmap->lock_y;
-      if (x < 0 || y < 0 || x >= bitmap->lock_w || y >= bitmap->lock_h) {
+      x -= lock->lock_x;
+      y -= lock->lock_y;
+      if (x < 0 || y < 0 || x >= lock->lock_w || y >= lock->lock_h) {
          ALLEGRO_ERROR("Out of bounds.");
          return color;
       }
 
-      data = bitmap->locked_region.data;
-      data += y * bitmap->locked_region.pitch;
-      data += x * al_get_pixel_size(bitmap->locked_region.format);
+      data = lock->locked_region.data;
+      data += y * lock->locked_region.pitch;
+      data += x * al_get_pixel_size(lock->locked_region.format);
 
-      _AL_INLINE_GET_PIXEL(bitmap->locked_region.format, data, color, false);
+      _AL_INLINE_GET_PIXEL(lock->locked_region.format, data, color, false);
    }
    else {
       /* FIXME: must use clip not full bitmap */
@@ -60,17 +89,17 @@ ALLEGRO_COLOR al_get_pixel(ALLEGRO_BITMAP *bitmap, int x, int y)
          return color;
       }
 
-      if (!(lr = al_lock_bitmap_region(bitmap, x, y, 1, 1,
-            ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY))) {
+      if (!(lr = lock_pixels(handle, x, y, 1, ALLEGRO_LOCK_READONLY,
+            &lock))) {
          return color;
       }
 
       /* FIXME: check for valid pixel format */
 
-      data = bitmap->lock_data;
+      data = _AL_LOCK_HOLDER(lock)->lock_data;
       _AL_INLINE_GET_PIXEL(lr->format, data, color, false);
 
-      al_unlock_bitmap(bitmap);
+      al_unlock_bitmap(lock);
    }
 
    return color;
@@ -79,6 +108,8 @@ ALLEGRO_COLOR al_get_pixel(ALLEGRO_BITMAP *bitmap, int x, int y)
 
 void _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color)
 {
+   ALLEGRO_BITMAP *handle = bitmap;
+   ALLEGRO_BITMAP *lock = _AL_LOCK_HOLDER(bitmap);
    ALLEGRO_LOCKED_REGION *lr;
    char *data;
 
@@ -93,35 +124,34 @@ void _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color)
       return;
    }
 
-   if (bitmap->locked) {
-      if (_al_pixel_format_is_video_only(bitmap->locked_region.format)) {
+   if (lock->locked) {
+      if (_al_pixel_format_is_video_only(lock->locked_region.format)) {
          ALLEGRO_ERROR("Invalid lock format.");
          return;
       }
-      x -= bitmap->lock_x;
-      y -= bitmap->lock_y;
-      if (x < 0 || y < 0 || x >= bitmap->lock_w || y >= bitmap->lock_h) {
+      x -= lock->lock_x;
+      y -= lock->lock_y;
+      if (x < 0 || y < 0 || x >= lock->lock_w || y >= lock->lock_h) {
          return;
       }
 
-      data = bitmap->locked_region.data;
-      data += y * bitmap->locked_region.pitch;
-      data += x * al_get_pixel_size(bitmap->locked_region.format);
+      data = lock->locked_region.data;
+      data += y * lock->locked_region.pitch;
+      data += x * al_get_pixel_size(lock->locked_region.format);
 
-      _AL_INLINE_PUT_PIXEL(bitmap->locked_region.format, data, color, false);
+      _AL_INLINE_PUT_PIXEL(lock->locked_region.format, data, color, false);
    }
    else {
-      lr = al_lock_bitmap_region(bitmap, x, y, 1, 1,
-         ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_WRITEONLY);
+      lr = lock_pixels(handle, x, y, 1, ALLEGRO_LOCK_WRITEONLY, &lock);
       if (!lr)
          return;
 
       /* FIXME: check for valid pixel format */
 
-      data = bitmap->lock_data;
+      data = _AL_LOCK_HOLDER(lock)->lock_data;
       _AL_INLINE_PUT_PIXEL(lr->format, data, color, false);
 
-      al_unlock_bitmap(bitmap);
+      al_unlock_bitmap(lock);
    }
 }
 
@@ -134,6 +164,249 @@ void al_put_pixel(int x, int y, ALLEGRO_COLOR color)
 }
 
 
+/* A run of pixels on one row of a bitmap, clipped to what can be accessed. */
+typedef struct PIXEL_SPAN
+{
+   ALLEGRO_BITMAP *bitmap;
+   char *data;          /* the first pixel inside */
+   int format;
+   int skip;            /* pixels before the first one inside */
+   int n;               /* pixels inside, may be 0 */
+   bool locked_here;
+} PIXEL_SPAN;
+
+
+/* Clips the span to the bitmap, or to its clipping rectangle when writing,
+ * and to the locked region if the bitmap is locked. Otherwise locks the
+ * part that is left, just once for the whole span. Returns false if the
+ * pixels can not be accessed.
+ */
+static bool lock_span(PIXEL_SPAN *span, ALLEGRO_BITMAP *bitmap,
+   int x, int y, int n, bool write)
+{
+   ALLEGRO_BITMAP *handle = bitmap;
+   ALLEGRO_BITMAP *lock = _AL_LOCK_HOLDER(bitmap);
+   int l, t, r, b;
+
+   if (bitmap->parent) {
+      x += bitmap->xofs;
+      y += bitmap->yofs;
+      bitmap = bitmap->parent;
+   }
+
+   if (write) {
+      l = bitmap->cl;
+      t = bitmap->ct;
+      r = bitmap->cr_excl;
+      b = bitmap->cb_excl;
+   }
+   else {
+      l = 0;
+      t = 0;
+      r = bitmap->w;
+      b = bitmap->h;
+   }
+   if (lock->locked) {
+      l = _ALLEGRO_MAX(l, lock->lock_x);
+      t = _ALLEGRO_MAX(t, lock->lock_y);
+      r = _ALLEGRO_MIN(r, lock->lock_x + lock->lock_w);
+      b = _ALLEGRO_MIN(b, lock->lock_y + lock->lock_h);
+   }
+
+   span->bitmap = bitmap;
+   span->skip = 0;
+   span->n = 0;
+   span->locked_here = false;
+
+   if (y < t || y >= b)
+      return true;
+   if (x < l) {
+      span->skip = l - x;
+      n -= l - x;
+      x = l;
+   }
+   if (x + n > r)
+      n = r - x;
+   if (n <= 0)
+      return true;
+
+   if (lock->locked) {
+      span->format = lock->locked_region.format;
+      span->data = (char *)lock->lock_data
+         + (y - lock->lock_y) * lock->locked_region.pitch
+         + (x - lock->lock_x) * lock->locked_region.pixel_size;
+   }
+   else {
+      ALLEGRO_LOCKED_REGION *lr = lock_pixels(handle, x, y, n,
+         write ? ALLEGRO_LOCK_WRITEONLY : ALLEGRO_LOCK_READONLY,
+         &span->bitmap);
+      if (!lr)
+         return false;
+      span->format = lr->format;
+      span->data = lr->data;
+      span->locked_here = true;
+   }
+
+   if (_al_pixel_format_is_video_only(span->format) ||
+         _al_pixel_format_is_compressed(span->format)) {
+      ALLEGRO_ERROR("Invalid lock format.\n");
+      if (span->locked_here)
+         al_unlock_bitmap(span->bitmap);
+      return false;
+   }
+
+   span->n = n;
+   return true;
+}
+
+
+static void unlock_span(PIXEL_SPAN *span)
+{
+   if (span->locked_here)
+      al_unlock_bitmap(span->bitmap);
+}
+
+
+static bool check_span_format(int format)
+{
+   if (format < 0 || format >= ALLEGRO_NUM_PIXEL_FORMATS ||
+         !_al_pixel_format_is_real(format) ||
+         _al_pixel_format_is_video_only(format) ||
+         _al_pixel_format_is_compressed(format)) {
+      ALLEGRO_ERROR("Invalid pixel format %d.\n", format);
+      return false;
+   }
+   return true;
+}
+
+
+/* Function: al_get_pixel_row
+ */
+void al_get_pixel_row(ALLEGRO_BITMAP *bitmap, int x, int y, int n,
+   ALLEGRO_COLOR *colors)
+{
+   const ALLEGRO_COLOR transparent = al_map_rgba_f(0, 0, 0, 0);
+   PIXEL_SPAN span;
+   char *data;
+   int i;
+
+   ASSERT(bitmap);
+   ASSERT(colors || n <= 0);
+
+   if (n <= 0)
+      return;
+
+   if (!lock_span(&span, bitmap, x, y, n, false)) {
+      span.skip = 0;
+      span.n = 0;
+   }
+
+   for (i = 0; i < span.skip; i++)
+      colors[i] = transparent;
+
+   data = span.data;
+   for (i = span.skip; i < span.skip + span.n; i++) {
+      _AL_INLINE_GET_PIXEL(span.format, data, colors[i], true);
+   }
+
+   for (; i < n; i++)
+      colors[i] = transparent;
+
+   unlock_span(&span);
+}
+
+
+/* Function: al_put_pixel_span
+ */
+void al_put_pixel_span(int x, int y, int n, const ALLEGRO_COLOR *colors)
+{
+   PIXEL_SPAN span;
+   char *data;
+   int i;
+
+   ASSERT(colors || n <= 0);
+
+   if (n <= 0)
+      return;
+
+   if (!lock_span(&span, al_get_target_bitmap(), x, y, n, true))
+      return;
+
+   data = span.data;
+   for (i = span.skip; i < span.skip + span.n; i++) {
+      _AL_INLINE_PUT_PIXEL(span.format, data, colors[i], true);
+   }
+
+   unlock_span(&span);
+}
+
+
+/* Function: al_get_pixel_row_format
+ */
+bool al_get_pixel_row_format(ALLEGRO_BITMAP *bitmap, int x, int y, int n,
+   void *data, int format)
+{
+   PIXEL_SPAN span;
+   int size;
+
+   ASSERT(bitmap);
+   ASSERT(data || n <= 0);
+
+   if (!check_span_format(format))
+      return false;
+   if (n <= 0)
+      return true;
+
+   size = al_get_pixel_size(format);
+   if (!lock_span(&span, bitmap, x, y, n, false)) {
+      memset(data, 0, n * size);
+      return false;
+   }
+
+   memset(data, 0, span.skip * size);
+   if (span.n > 0) {
+      _al_convert_bitmap_data(span.data, span.format, 0,
+         (char *)data + span.skip * size, format, 0,
+         0, 0, 0, 0, span.n, 1);
+   }
+   memset((char *)data + (span.skip + span.n) * size, 0,
+      (n - span.skip - span.n) * size);
+
+   unlock_span(&span);
+   return true;
+}
+
+
+/* Function: al_put_pixel_span_format
+ */
+bool al_put_pixel_span_format(int x, int y, int n, const void *data,
+   int format)
+{
+   PIXEL_SPAN span;
+   int size;
+
+   ASSERT(data || n <= 0);
+
+   if (!check_span_format(format))
+      return false;
+   if (n <= 0)
+      return true;
+
+   size = al_get_pixel_size(format);
+   if (!lock_span(&span, al_get_target_bitmap(), x, y, n, true))
+      return false;
+
+   if (span.n > 0) {
+      _al_convert_bitmap_data((const char *)data + span.skip * size, format, 0,
+         span.data, span.format, 0,
+         0, 0, 0, 0, span.n, 1);
+   }
+
+   unlock_span(&span);
+   return true;
+}
+
+
 /* Function: al_put_blended_pixel
  */
 void al_put_blended_pixel(int x, int y, ALLEGRO_COLOR color)
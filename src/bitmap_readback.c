@@ -0,0 +1,225 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Asynchronous bitmap readback.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_dtor.h"
+#include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_system.h"
+
+ALLEGRO_DEBUG_CHANNEL("bitmap")
+
+
+/* Used for memory bitmaps and when the driver can't read back
+ * asynchronously: lock the region now and keep a copy.
+ */
+static bool copy_region(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP_READBACK *rb,
+   int x, int y)
+{
+   ALLEGRO_LOCKED_REGION *lr;
+   int pitch;
+   int i;
+
+   lr = al_lock_bitmap_region(bitmap, x, y, rb->w, rb->h, rb->format,
+      ALLEGRO_LOCK_READONLY);
+   if (!lr)
+      return false;
+
+   pitch = lr->pixel_size * rb->w;
+   rb->buffer = al_malloc(pitch * rb->h);
+   if (!rb->buffer) {
+      al_unlock_bitmap(bitmap);
+      return false;
+   }
+
+   for (i = 0; i < rb->h; i++) {
+      memcpy((char *)rb->buffer + i * pitch, (char *)lr->data + i * lr->pitch,
+         pitch);
+   }
+
+   rb->native.data = rb->buffer;
+   rb->native.format = lr->format;
+   rb->native.pitch = pitch;
+   rb->native.pixel_size = lr->pixel_size;
+
+   al_unlock_bitmap(bitmap);
+   return true;
+}
+
+
+/* Function: al_read_bitmap_region_async
+ */
+ALLEGRO_BITMAP_READBACK *al_read_bitmap_region_async(ALLEGRO_BITMAP *bitmap,
+   int x, int y, int width, int height, int format)
+{
+   ALLEGRO_BITMAP_READBACK *rb;
+   int bitmap_format;
+   ASSERT(bitmap);
+   ASSERT(x >= 0);
+   ASSERT(y >= 0);
+   ASSERT(width > 0);
+   ASSERT(height > 0);
+   ASSERT(!_al_pixel_format_is_video_only(format));
+   ASSERT(!_al_pixel_format_is_compressed(format));
+
+   /* For sub-bitmaps */
+   if (bitmap->parent) {
+      x += bitmap->xofs;
+      y += bitmap->yofs;
+      bitmap = bitmap->parent;
+   }
+
+   ASSERT(x + width <= bitmap->w);
+   ASSERT(y + height <= bitmap->h);
+
+   if (bitmap->locked)
+      return NULL;
+
+   if (format != ALLEGRO_PIXEL_FORMAT_ANY) {
+      format = _al_get_real_pixel_format(al_get_current_display(), format);
+      if (format < 0)
+         return NULL;
+   }
+
+   rb = al_calloc(1, sizeof(*rb));
+   if (!rb)
+      return NULL;
+   rb->display = _al_get_bitmap_display(bitmap);
+   rb->w = width;
+   rb->h = height;
+   rb->format = format;
+
+   bitmap_format = al_get_bitmap_format(bitmap);
+   if (!(al_get_bitmap_flags(bitmap) & ALLEGRO_MEMORY_BITMAP) &&
+         !_al_pixel_format_is_compressed(bitmap_format) &&
+         bitmap->vt->start_readback &&
+         bitmap->vt->start_readback(bitmap, rb, x, y, width, height)) {
+      ASSERT(rb->vt);
+   }
+   else {
+      ALLEGRO_DEBUG("Reading back %dx%d synchronously.\n", width, height);
+      rb->vt = NULL;
+      if (!copy_region(bitmap, rb, x, y)) {
+         al_free(rb);
+         return NULL;
+      }
+   }
+
+   rb->dtor_item = _al_register_destructor(_al_dtor_list, "readback", rb,
+      (void (*)(void *))al_destroy_bitmap_readback);
+
+   return rb;
+}
+
+
+/* Function: al_is_bitmap_readback_ready
+ */
+bool al_is_bitmap_readback_ready(ALLEGRO_BITMAP_READBACK *rb)
+{
+   ASSERT(rb);
+
+   if (!rb->vt || rb->mapped || rb->converted)
+      return true;
+   return rb->vt->is_ready(rb);
+}
+
+
+/* Function: al_map_bitmap_readback
+ */
+ALLEGRO_LOCKED_REGION *al_map_bitmap_readback(ALLEGRO_BITMAP_READBACK *rb)
+{
+   int pitch;
+   ASSERT(rb);
+
+   if (rb->mapped)
+      return &rb->region;
+
+   if (rb->converted) {
+      rb->mapped = true;
+      return &rb->region;
+   }
+
+   if (rb->vt && !rb->vt->map(rb))
+      return NULL;
+
+   if (rb->format == ALLEGRO_PIXEL_FORMAT_ANY ||
+         rb->native.format == rb->format) {
+      rb->region = rb->native;
+      rb->mapped = true;
+      return &rb->region;
+   }
+
+   /* The driver could not read the pixels in the requested format.  Convert
+    * them once and let go of the driver's copy.
+    */
+   pitch = al_get_pixel_size(rb->format) * rb->w;
+   rb->converted = al_malloc(pitch * rb->h);
+   if (!rb->converted) {
+      if (rb->vt)
+         rb->vt->unmap(rb);
+      return NULL;
+   }
+   _al_convert_bitmap_data(
+      rb->native.data, rb->native.format, rb->native.pitch,
+      rb->converted, rb->format, pitch,
+      0, 0, 0, 0, rb->w, rb->h);
+   if (rb->vt)
+      rb->vt->unmap(rb);
+
+   rb->region.data = rb->converted;
+   rb->region.format = rb->format;
+   rb->region.pitch = pitch;
+   rb->region.pixel_size = al_get_pixel_size(rb->format);
+   rb->mapped = true;
+   return &rb->region;
+}
+
+
+/* Function: al_unmap_bitmap_readback
+ */
+void al_unmap_bitmap_readback(ALLEGRO_BITMAP_READBACK *rb)
+{
+   ASSERT(rb);
+
+   if (!rb->mapped)
+      return;
+   rb->mapped = false;
+
+   if (rb->vt && !rb->converted)
+      rb->vt->unmap(rb);
+}
+
+
+/* Function: al_destroy_bitmap_readback
+ */
+void al_destroy_bitmap_readback(ALLEGRO_BITMAP_READBACK *rb)
+{
+   if (!rb)
+      return;
+
+   al_unmap_bitmap_readback(rb);
+   if (rb->vt)
+      rb->vt->destroy(rb);
+
+   _al_unregister_destructor(_al_dtor_list, rb->dtor_item);
+   al_free(rb->buffer);
+   al_free(rb->converted);
+   al_free(rb);
+}
+
+
+/* vim: set sts=3 sw=3 et: */
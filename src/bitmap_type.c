@@ -17,7 +17,9 @@
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_events.h"
 #include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_pixels.h"
 #include "allegro5/internal/aintern_shader.h"
 #include "allegro5/internal/aintern_system.h"
 #include "allegro5/internal/aintern_vector.h"
@@ -76,7 +78,7 @@ void _al_unregister_convert_bitmap(ALLEGRO_BITMAP *bitmap)
       return;
    if (bitmap_flags & ALLEGRO_CONVERT_BITMAP) {
       al_lock_mutex(convert_bitmap_list.mutex);
-      _al_vector_find_and_delete(&convert_bitmap_list.bitmaps, &bitmap);
+      _al_vector_find_and_delete_unordered(&convert_bitmap_list.bitmaps, &bitmap);
       al_unlock_mutex(convert_bitmap_list.mutex);
    }
 }
@@ -85,8 +87,8 @@ void _al_unregister_convert_bitmap(ALLEGRO_BITMAP *bitmap)
 static void swap_bitmaps(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *other)
 {
    ALLEGRO_BITMAP temp;
-   _AL_LIST_ITEM *bitmap_dtor_item = bitmap->dtor_item;
-   _AL_LIST_ITEM *other_dtor_item = other->dtor_item;
+   _AL_DTOR_ITEM *bitmap_dtor_item = bitmap->dtor_item;
+   _AL_DTOR_ITEM *other_dtor_item = other->dtor_item;
    ALLEGRO_DISPLAY *bitmap_display, *other_display;
 
    _al_unregister_convert_bitmap(bitmap);
@@ -107,6 +109,14 @@ static void swap_bitmaps(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *other)
    bitmap->dtor_item = bitmap_dtor_item;
    other->dtor_item = other_dtor_item;
 
+   /* The contents stay the same, and so does what was drawn to them. */
+   bitmap->track_damage = temp.track_damage;
+   bitmap->damaged = temp.damaged;
+   bitmap->damage_x1 = temp.damage_x1;
+   bitmap->damage_y1 = temp.damage_y1;
+   bitmap->damage_x2 = temp.damage_x2;
+   bitmap->damage_y2 = temp.damage_y2;
+
    bitmap_display = _al_get_bitmap_display(bitmap);
    other_display = _al_get_bitmap_display(other);
 
@@ -114,23 +124,34 @@ static void swap_bitmaps(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *other)
     * possibly referencing any of the two bitmaps.
     */
 
+   /* Upload contexts add to the list from other threads. */
    if (bitmap_display && !other_display) {
       /* This means before the swap, other was the display bitmap, and we
        * now should replace it with the swapped pointer.
        */
       ALLEGRO_BITMAP **back;
-      int pos = _al_vector_find(&bitmap_display->bitmaps, &other);
+      int pos;
+      if (bitmap_display->bitmaps_mutex)
+         al_lock_mutex(bitmap_display->bitmaps_mutex);
+      pos = _al_vector_find(&bitmap_display->bitmaps, &other);
       ASSERT(pos >= 0);
       back = _al_vector_ref(&bitmap_display->bitmaps, pos);
       *back = bitmap;
+      if (bitmap_display->bitmaps_mutex)
+         al_unlock_mutex(bitmap_display->bitmaps_mutex);
    }
 
    if (other_display && !bitmap_display) {
       ALLEGRO_BITMAP **back;
-      int pos = _al_vector_find(&other_display->bitmaps, &bitmap);
+      int pos;
+      if (other_display->bitmaps_mutex)
+         al_lock_mutex(other_display->bitmaps_mutex);
+      pos = _al_vector_find(&other_display->bitmaps, &bitmap);
       ASSERT(pos >= 0);
       back = _al_vector_ref(&other_display->bitmaps, pos);
       *back = other;
+      if (other_display->bitmaps_mutex)
+         al_unlock_mutex(other_display->bitmaps_mutex);
    }
 
    if (other->shader)
@@ -315,4 +336,185 @@ void _al_convert_to_memory_bitmap(ALLEGRO_BITMAP *bitmap)
 }
 
 
+/*
+ * Texture budget
+ *
+ * Once a display's video bitmaps take up more than its texture budget, the
+ * ones drawn least recently are turned into memory bitmaps at the end of a
+ * frame, just like when the display is destroyed. The bitmap pointer stays
+ * valid, and the bitmap is turned back into a video bitmap the next time it
+ * is drawn to a video bitmap or made the target.
+ */
+
+
+/* Function: al_set_display_texture_budget
+ */
+void al_set_display_texture_budget(ALLEGRO_DISPLAY *display, int64_t bytes)
+{
+   ASSERT(display);
+   display->texture_budget = bytes > 0 ? bytes : 0;
+}
+
+
+/* Function: al_get_display_texture_budget
+ */
+int64_t al_get_display_texture_budget(ALLEGRO_DISPLAY *display)
+{
+   ASSERT(display);
+   return display->texture_budget;
+}
+
+
+/* Called whenever a bitmap is drawn or targeted while display is current.
+ * display is NULL when drawing to a memory bitmap, an evicted bitmap then
+ * stays in memory.
+ */
+void _al_mark_bitmap_used(ALLEGRO_BITMAP *bitmap, ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_DISPLAY *bitmap_display;
+
+   if (bitmap->parent)
+      bitmap = bitmap->parent;
+
+   if (bitmap->evicted && display && display == al_get_current_display() &&
+         !bitmap->locked) {
+      /* The bitmap may be part of what's held for drawing already. */
+      if (display->vt->flush_vertex_cache)
+         display->vt->flush_vertex_cache(display);
+
+      ALLEGRO_DEBUG("restoring evicted bitmap %p\n", bitmap);
+      _al_convert_to_display_bitmap(bitmap);
+      bitmap->evicted = (al_get_bitmap_flags(bitmap) & ALLEGRO_MEMORY_BITMAP) != 0;
+   }
+
+   bitmap_display = bitmap->_display;
+   if (bitmap_display)
+      bitmap->last_use_frame = bitmap_display->texture_frame;
+}
+
+
+static int64_t video_bitmap_size(ALLEGRO_BITMAP *bitmap)
+{
+   int format = al_get_bitmap_format(bitmap);
+
+   if (_al_pixel_format_is_compressed(format)) {
+      int bw = al_get_pixel_block_width(format);
+      int bh = al_get_pixel_block_height(format);
+      return (int64_t)((bitmap->w + bw - 1) / bw) *
+         ((bitmap->h + bh - 1) / bh) * al_get_pixel_block_size(format);
+   }
+   return (int64_t)bitmap->w * bitmap->h * al_get_pixel_size(format);
+}
+
+
+static bool can_evict(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_BITMAP *target)
+{
+   if (bitmap->last_use_frame == display->texture_frame)
+      return false;
+   if (bitmap->locked)
+      return false;
+   if (target && (bitmap == target || bitmap == target->parent))
+      return false;
+   if (bitmap == al_get_backbuffer(display))
+      return false;
+   return true;
+}
+
+
+static int compare_last_use(const void *a, const void *b)
+{
+   const ALLEGRO_BITMAP *ba = *(ALLEGRO_BITMAP * const *)a;
+   const ALLEGRO_BITMAP *bb = *(ALLEGRO_BITMAP * const *)b;
+   return ba->last_use_frame - bb->last_use_frame;
+}
+
+
+static void emit_evicted_event(ALLEGRO_DISPLAY *display,
+   ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_EVENT_SOURCE *es = &display->es;
+   ALLEGRO_EVENT event;
+
+   _al_event_source_lock(es);
+   if (_al_event_source_needs_to_generate_event(es)) {
+      event.bitmap.type = ALLEGRO_EVENT_BITMAP_EVICTED;
+      event.bitmap.timestamp = al_get_time();
+      event.bitmap.bitmap = bitmap;
+      event.bitmap.id = 0;
+      _al_event_source_emit_event(es, &event);
+   }
+   _al_event_source_unlock(es);
+}
+
+
+/* Called by al_flip_display after the frame was shown. */
+void _al_enforce_texture_budget(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_BITMAP *target = al_get_target_bitmap();
+   ALLEGRO_BITMAP **candidates = NULL;
+   int num_candidates = 0;
+   int64_t total = 0;
+   unsigned int i;
+
+   if (display->texture_budget <= 0 || _al_get_current_upload_context())
+      goto done;
+
+   if (display->bitmaps_mutex)
+      al_lock_mutex(display->bitmaps_mutex);
+   /* A worker may still be filling the bitmaps it just created, which have
+    * never been drawn and so would be evicted first.  Wait for the next
+    * frame.
+    */
+   if (display->num_uploads > 0) {
+      al_unlock_mutex(display->bitmaps_mutex);
+      goto done;
+   }
+   for (i = 0; i < _al_vector_size(&display->bitmaps); i++) {
+      ALLEGRO_BITMAP **bptr = _al_vector_ref(&display->bitmaps, i);
+      if (!(*bptr)->parent)
+         total += video_bitmap_size(*bptr);
+   }
+   if (total > display->texture_budget) {
+      candidates = al_malloc(_al_vector_size(&display->bitmaps) *
+         sizeof(*candidates));
+      for (i = 0; candidates && i < _al_vector_size(&display->bitmaps); i++) {
+         ALLEGRO_BITMAP **bptr = _al_vector_ref(&display->bitmaps, i);
+         if (!(*bptr)->parent && can_evict(display, *bptr, target))
+            candidates[num_candidates++] = *bptr;
+      }
+   }
+   if (display->bitmaps_mutex)
+      al_unlock_mutex(display->bitmaps_mutex);
+
+   if (num_candidates > 0) {
+      int evicted = 0;
+      int n;
+
+      qsort(candidates, num_candidates, sizeof(*candidates), compare_last_use);
+
+      for (n = 0; n < num_candidates && total > display->texture_budget; n++) {
+         ALLEGRO_BITMAP *bitmap = candidates[n];
+         int64_t size = video_bitmap_size(bitmap);
+
+         _al_convert_to_memory_bitmap(bitmap);
+         if (!(al_get_bitmap_flags(bitmap) & ALLEGRO_MEMORY_BITMAP))
+            continue;
+
+         bitmap->evicted = true;
+         total -= size;
+         evicted++;
+         emit_evicted_event(display, bitmap);
+      }
+
+      ALLEGRO_DEBUG("evicted %d bitmaps, %.1f MB of %.1f MB left\n", evicted,
+         total / 1048576.0, display->texture_budget / 1048576.0);
+   }
+   al_free(candidates);
+
+done:
+   display->texture_frame++;
+}
+
+
 /* vim: set ts=8 sts=3 sw=3 et: */
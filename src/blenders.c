@@ -40,3 +40,375 @@ void _al_blend_memory(ALLEGRO_COLOR *scol,
                     &constcol, result);
    (void) _al_blend_alpha_inline; // silence compiler
 }
+
+
+/*
+ * Span blending. The blend equation is looked at once in
+ * _al_init_span_blender and the common ones get a loop with the blend
+ * modes folded in at compile time, optionally vectorized. Anything else
+ * falls back to _al_blend_inline for every pixel.
+ */
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+   #if defined(_MSC_VER) || defined(__clang__) || \
+      (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+      #define SIMD_X86
+   #endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+   #define SIMD_NEON
+#endif
+
+#if defined(SIMD_X86)
+   #include <emmintrin.h>
+   #if defined(__GNUC__) || defined(__clang__)
+      #define TARGET(x) __attribute__((target(x)))
+   #else
+      #define TARGET(x)
+   #endif
+#elif defined(SIMD_NEON)
+   #include <arm_neon.h>
+#endif
+
+
+typedef void (*BLEND_SPAN_FUNC)(const _AL_SPAN_BLENDER *,
+   const ALLEGRO_COLOR *, ALLEGRO_COLOR *, int);
+
+
+#define DEFINE_BLEND_SPAN(name, src_mode, dst_mode)                           \
+static void name(const _AL_SPAN_BLENDER *blender,                             \
+   const ALLEGRO_COLOR *src, ALLEGRO_COLOR *dst, int n)                       \
+{                                                                             \
+   ALLEGRO_COLOR result;                                                      \
+   int i;                                                                     \
+   (void)blender;                                                             \
+                                                                              \
+   for (i = 0; i < n; i++) {                                                  \
+      _al_blend_alpha_inline(&src[i], &dst[i],                                \
+         ALLEGRO_ADD, src_mode, dst_mode,                                     \
+         ALLEGRO_ADD, src_mode, dst_mode,                                     \
+         NULL, &result);                                                      \
+      dst[i] = result;                                                        \
+   }                                                                          \
+}
+
+DEFINE_BLEND_SPAN(blend_premul_alpha, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA)
+DEFINE_BLEND_SPAN(blend_alpha, ALLEGRO_ALPHA, ALLEGRO_INVERSE_ALPHA)
+DEFINE_BLEND_SPAN(blend_add, ALLEGRO_ONE, ALLEGRO_ONE)
+DEFINE_BLEND_SPAN(blend_alpha_add, ALLEGRO_ALPHA, ALLEGRO_ONE)
+
+
+/* Computes the blending factors for a whole span. The blend mode is only
+ * looked at once, get_factor and get_alpha_factor are inlined with a
+ * constant mode into each loop.
+ */
+static void get_span_factors(int mode, int alpha_mode,
+   const ALLEGRO_COLOR *src, const ALLEGRO_COLOR *dst,
+   ALLEGRO_COLOR *const_color, ALLEGRO_COLOR *factor, int n)
+{
+   int i;
+
+   #define CASE(m)                                                         \
+      case m:                                                              \
+         for (i = 0; i < n; i++)                                           \
+            get_factor(m, &src[i], &dst[i], const_color, &factor[i]);      \
+         break;
+   switch (mode) {
+      CASE(ALLEGRO_ZERO)
+      CASE(ALLEGRO_ONE)
+      CASE(ALLEGRO_ALPHA)
+      CASE(ALLEGRO_INVERSE_ALPHA)
+      CASE(ALLEGRO_SRC_COLOR)
+      CASE(ALLEGRO_DEST_COLOR)
+      CASE(ALLEGRO_INVERSE_SRC_COLOR)
+      CASE(ALLEGRO_INVERSE_DEST_COLOR)
+      CASE(ALLEGRO_CONST_COLOR)
+      CASE(ALLEGRO_INVERSE_CONST_COLOR)
+      default:
+         ASSERT(false);
+         memset(factor, 0, n * sizeof(*factor));
+         break;
+   }
+   #undef CASE
+
+   #define CASE(m)                                                         \
+      case m:                                                              \
+         for (i = 0; i < n; i++)                                           \
+            factor[i].a = get_alpha_factor(m, src[i].a, dst[i].a,          \
+               const_color);                                               \
+         break;
+   switch (alpha_mode) {
+      CASE(ALLEGRO_ZERO)
+      CASE(ALLEGRO_ONE)
+      CASE(ALLEGRO_ALPHA)
+      CASE(ALLEGRO_INVERSE_ALPHA)
+      CASE(ALLEGRO_SRC_COLOR)
+      CASE(ALLEGRO_DEST_COLOR)
+      CASE(ALLEGRO_INVERSE_SRC_COLOR)
+      CASE(ALLEGRO_INVERSE_DEST_COLOR)
+      CASE(ALLEGRO_CONST_COLOR)
+      CASE(ALLEGRO_INVERSE_CONST_COLOR)
+      default:
+         ASSERT(false);
+         for (i = 0; i < n; i++)
+            factor[i].a = 0;
+         break;
+   }
+   #undef CASE
+}
+
+
+/* Applies the blend operations given the factors. A factor step of 0 means
+ * the same factor is used for every pixel.
+ */
+static _AL_ALWAYS_INLINE void blend_span_factors(const _AL_SPAN_BLENDER *blender,
+   const ALLEGRO_COLOR *src, ALLEGRO_COLOR *dst,
+   const ALLEGRO_COLOR *sf, int sf_step,
+   const ALLEGRO_COLOR *df, int df_step, int n)
+{
+   int i;
+
+   #define BLEND(c) \
+      dst[i].c = OP(src[i].c * sf[i * sf_step].c, dst[i].c * df[i * df_step].c)
+   switch (blender->op) {
+      case ALLEGRO_ADD:
+         #define OP(x, y) _ALLEGRO_MIN(1, x + y)
+         for (i = 0; i < n; i++) { BLEND(r); BLEND(g); BLEND(b); }
+         #undef OP
+         break;
+      case ALLEGRO_SRC_MINUS_DEST:
+         #define OP(x, y) _ALLEGRO_MAX(0, x - y)
+         for (i = 0; i < n; i++) { BLEND(r); BLEND(g); BLEND(b); }
+         #undef OP
+         break;
+      case ALLEGRO_DEST_MINUS_SRC:
+         #define OP(x, y) _ALLEGRO_MAX(0, y - x)
+         for (i = 0; i < n; i++) { BLEND(r); BLEND(g); BLEND(b); }
+         #undef OP
+         break;
+   }
+
+   switch (blender->op_alpha) {
+      case ALLEGRO_ADD:
+         #define OP(x, y) _ALLEGRO_MIN(1, x + y)
+         for (i = 0; i < n; i++) BLEND(a);
+         #undef OP
+         break;
+      case ALLEGRO_SRC_MINUS_DEST:
+         #define OP(x, y) _ALLEGRO_MAX(0, x - y)
+         for (i = 0; i < n; i++) BLEND(a);
+         #undef OP
+         break;
+      case ALLEGRO_DEST_MINUS_SRC:
+         #define OP(x, y) _ALLEGRO_MAX(0, y - x)
+         for (i = 0; i < n; i++) BLEND(a);
+         #undef OP
+         break;
+   }
+   #undef BLEND
+}
+
+
+static void blend_generic(const _AL_SPAN_BLENDER *blender,
+   const ALLEGRO_COLOR *src, ALLEGRO_COLOR *dst, int n)
+{
+   ALLEGRO_COLOR sf[_AL_BLEND_SPAN_SIZE];
+   ALLEGRO_COLOR df[_AL_BLEND_SPAN_SIZE];
+   ALLEGRO_COLOR const_color = blender->const_color;
+
+   while (n > 0) {
+      const int m = _ALLEGRO_MIN(n, _AL_BLEND_SPAN_SIZE);
+
+      /* Both factors have to be computed before dst is overwritten. */
+      get_span_factors(blender->src_mode, blender->src_alpha,
+         src, dst, &const_color, sf, m);
+      get_span_factors(blender->dst_mode, blender->dst_alpha,
+         src, dst, &const_color, df, m);
+      blend_span_factors(blender, src, dst, sf, 1, df, 1, m);
+
+      src += m;
+      dst += m;
+      n -= m;
+   }
+}
+
+
+/* For equations made up of ALLEGRO_ZERO, ALLEGRO_ONE and the constant color
+ * factors only, which are computed up front.
+ */
+static void blend_const_factors(const _AL_SPAN_BLENDER *blender,
+   const ALLEGRO_COLOR *src, ALLEGRO_COLOR *dst, int n)
+{
+   blend_span_factors(blender, src, dst,
+      &blender->src_factor, 0, &blender->dst_factor, 0, n);
+}
+
+
+#if defined(SIMD_X86)
+
+/* The _ALLEGRO_MIN(1, x) in the scalar code is _mm_min_ps(one, x), NaNs
+ * included.
+ */
+#define DEFINE_BLEND_SPAN_SSE2(name, SRC_FACTOR, DST_FACTOR)                  \
+TARGET("sse2")                                                                \
+static void name(const _AL_SPAN_BLENDER *blender,                             \
+   const ALLEGRO_COLOR *src, ALLEGRO_COLOR *dst, int n)                       \
+{                                                                             \
+   const __m128 one = _mm_set1_ps(1.0f);                                      \
+   int i;                                                                     \
+   (void)blender;                                                             \
+                                                                              \
+   for (i = 0; i < n; i++) {                                                  \
+      __m128 s = _mm_loadu_ps(&src[i].r);                                     \
+      __m128 d = _mm_loadu_ps(&dst[i].r);                                     \
+      __m128 sa = _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3));              \
+      __m128 x = SRC_FACTOR;                                                  \
+      __m128 y = DST_FACTOR;                                                  \
+      (void)sa;                                                               \
+      _mm_storeu_ps(&dst[i].r, _mm_min_ps(one, _mm_add_ps(x, y)));            \
+   }                                                                          \
+}
+
+DEFINE_BLEND_SPAN_SSE2(blend_premul_alpha_sse2,
+   s, _mm_mul_ps(d, _mm_sub_ps(one, sa)))
+DEFINE_BLEND_SPAN_SSE2(blend_alpha_sse2,
+   _mm_mul_ps(s, sa), _mm_mul_ps(d, _mm_sub_ps(one, sa)))
+DEFINE_BLEND_SPAN_SSE2(blend_add_sse2,
+   s, d)
+DEFINE_BLEND_SPAN_SSE2(blend_alpha_add_sse2,
+   _mm_mul_ps(s, sa), d)
+
+#elif defined(SIMD_NEON)
+
+#define DEFINE_BLEND_SPAN_NEON(name, SRC_FACTOR, DST_FACTOR)                  \
+static void name(const _AL_SPAN_BLENDER *blender,                             \
+   const ALLEGRO_COLOR *src, ALLEGRO_COLOR *dst, int n)                       \
+{                                                                             \
+   const float32x4_t one = vdupq_n_f32(1.0f);                                 \
+   int i;                                                                     \
+   (void)blender;                                                             \
+                                                                              \
+   for (i = 0; i < n; i++) {                                                  \
+      float32x4_t s = vld1q_f32(&src[i].r);                                   \
+      float32x4_t d = vld1q_f32(&dst[i].r);                                   \
+      float32x4_t sa = vdupq_n_f32(src[i].a);                                 \
+      float32x4_t x = SRC_FACTOR;                                             \
+      float32x4_t y = DST_FACTOR;                                             \
+      (void)sa;                                                               \
+      vst1q_f32(&dst[i].r, vminq_f32(one, vaddq_f32(x, y)));                  \
+   }                                                                          \
+}
+
+DEFINE_BLEND_SPAN_NEON(blend_premul_alpha_neon,
+   s, vmulq_f32(d, vsubq_f32(one, sa)))
+DEFINE_BLEND_SPAN_NEON(blend_alpha_neon,
+   vmulq_f32(s, sa), vmulq_f32(d, vsubq_f32(one, sa)))
+DEFINE_BLEND_SPAN_NEON(blend_add_neon,
+   s, d)
+DEFINE_BLEND_SPAN_NEON(blend_alpha_add_neon,
+   vmulq_f32(s, sa), d)
+
+#endif
+
+
+static BLEND_SPAN_FUNC choose_span_func(BLEND_SPAN_FUNC scalar,
+   BLEND_SPAN_FUNC sse2, BLEND_SPAN_FUNC neon)
+{
+   int features = al_get_cpu_features();
+
+   if (sse2 && (features & ALLEGRO_CPU_SSE2))
+      return sse2;
+   if (neon && (features & ALLEGRO_CPU_NEON))
+      return neon;
+   return scalar;
+}
+
+
+static bool is_const_factor(int mode)
+{
+   return mode == ALLEGRO_ZERO || mode == ALLEGRO_ONE ||
+      mode == ALLEGRO_CONST_COLOR || mode == ALLEGRO_INVERSE_CONST_COLOR;
+}
+
+
+/* Internal function: _al_init_span_blender
+ *
+ * Picks the fastest blend_span implementation for the given blend equation.
+ */
+void _al_init_span_blender(_AL_SPAN_BLENDER *blender,
+   int op, int src_mode, int dst_mode,
+   int op_alpha, int src_alpha, int dst_alpha,
+   const ALLEGRO_COLOR *const_color)
+{
+   BLEND_SPAN_FUNC sse2 = NULL;
+   BLEND_SPAN_FUNC neon = NULL;
+
+   blender->op = op;
+   blender->src_mode = src_mode;
+   blender->dst_mode = dst_mode;
+   blender->op_alpha = op_alpha;
+   blender->src_alpha = src_alpha;
+   blender->dst_alpha = dst_alpha;
+   blender->const_color = *const_color;
+
+   #define IS_EQUATION(s, d) \
+      (src_mode == (s) && dst_mode == (d) && \
+      src_alpha == (s) && dst_alpha == (d))
+
+   if (op == ALLEGRO_ADD && op_alpha == ALLEGRO_ADD) {
+      if (IS_EQUATION(ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA)) {
+#if defined(SIMD_X86)
+         sse2 = blend_premul_alpha_sse2;
+#elif defined(SIMD_NEON)
+         neon = blend_premul_alpha_neon;
+#endif
+         blender->blend_span = choose_span_func(blend_premul_alpha, sse2, neon);
+         return;
+      }
+      if (IS_EQUATION(ALLEGRO_ALPHA, ALLEGRO_INVERSE_ALPHA)) {
+#if defined(SIMD_X86)
+         sse2 = blend_alpha_sse2;
+#elif defined(SIMD_NEON)
+         neon = blend_alpha_neon;
+#endif
+         blender->blend_span = choose_span_func(blend_alpha, sse2, neon);
+         return;
+      }
+      if (IS_EQUATION(ALLEGRO_ONE, ALLEGRO_ONE)) {
+#if defined(SIMD_X86)
+         sse2 = blend_add_sse2;
+#elif defined(SIMD_NEON)
+         neon = blend_add_neon;
+#endif
+         blender->blend_span = choose_span_func(blend_add, sse2, neon);
+         return;
+      }
+      if (IS_EQUATION(ALLEGRO_ALPHA, ALLEGRO_ONE)) {
+#if defined(SIMD_X86)
+         sse2 = blend_alpha_add_sse2;
+#elif defined(SIMD_NEON)
+         neon = blend_alpha_add_neon;
+#endif
+         blender->blend_span = choose_span_func(blend_alpha_add, sse2, neon);
+         return;
+      }
+   }
+
+   #undef IS_EQUATION
+
+   if (is_const_factor(src_mode) && is_const_factor(dst_mode) &&
+         is_const_factor(src_alpha) && is_const_factor(dst_alpha)) {
+      ALLEGRO_COLOR cc = *const_color;
+      ALLEGRO_COLOR dummy = {0, 0, 0, 0};
+
+      get_factor(src_mode, &dummy, &dummy, &cc, &blender->src_factor);
+      get_factor(dst_mode, &dummy, &dummy, &cc, &blender->dst_factor);
+      blender->src_factor.a = get_alpha_factor(src_alpha, 0, 0, &cc);
+      blender->dst_factor.a = get_alpha_factor(dst_alpha, 0, 0, &cc);
+      blender->blend_span = blend_const_factors;
+      return;
+   }
+
+   blender->blend_span = blend_generic;
+}
+
+/* vim: set sts=3 sw=3 et: */
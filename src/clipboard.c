@@ -76,4 +76,98 @@ bool al_clipboard_has_text(ALLEGRO_DISPLAY *display)
 }
 
 
+/* Function: al_request_clipboard_text
+ */
+bool al_request_clipboard_text(ALLEGRO_DISPLAY *display)
+{
+   if (!display)
+      display = al_get_current_display();
+
+   if (!display)
+      return false;
+
+   if (display->vt->request_clipboard_text)
+      return display->vt->request_clipboard_text(display);
+
+   /* Drivers which cannot read the clipboard in the background. */
+   if (!display->vt->get_clipboard_text)
+      return false;
+
+   _al_clipboard_text_received(display,
+      display->vt->get_clipboard_text(display));
+   return true;
+}
+
+
+/* Function: al_get_clipboard_ustr
+ */
+const ALLEGRO_USTR *al_get_clipboard_ustr(ALLEGRO_DISPLAY *display)
+{
+   const ALLEGRO_USTR *us;
+
+   if (!display)
+      display = al_get_current_display();
+
+   if (!display)
+      return NULL;
+
+   _al_event_source_lock(&display->es);
+   us = display->clipboard_ustr;
+   _al_event_source_unlock(&display->es);
+   return us;
+}
+
+
+/* _al_clipboard_text_received:
+ *  Called by the drivers when a read started by al_request_clipboard_text
+ *  is done. Takes over text, which was allocated with al_malloc and is NULL
+ *  if there was none.
+ */
+void _al_clipboard_text_received(ALLEGRO_DISPLAY *display, char *text)
+{
+   ALLEGRO_EVENT event;
+
+   _al_event_source_lock(&display->es);
+
+   if (display->clipboard_closed) {
+      _al_event_source_unlock(&display->es);
+      al_free(text);
+      return;
+   }
+
+   al_free(display->clipboard_text);
+   display->clipboard_text = text;
+   display->clipboard_ustr = text ?
+      al_ref_cstr(&display->clipboard_info, text) : NULL;
+
+   if (_al_event_source_needs_to_generate_event(&display->es)) {
+      event.display.type = ALLEGRO_EVENT_DISPLAY_CLIPBOARD_TEXT;
+      event.display.timestamp = al_get_time();
+      event.display.x = 0;
+      event.display.y = 0;
+      event.display.width = 0;
+      event.display.height = 0;
+      event.display.orientation = 0;
+      _al_event_source_emit_event(&display->es, &event);
+   }
+
+   _al_event_source_unlock(&display->es);
+}
+
+
+/* _al_close_clipboard:
+ *  Free the received text of a display about to be destroyed. Text which
+ *  arrives later is dropped.
+ */
+void _al_close_clipboard(ALLEGRO_DISPLAY *display)
+{
+   _al_event_source_lock(&display->es);
+   display->clipboard_closed = true;
+   al_free(display->clipboard_text);
+   display->clipboard_text = NULL;
+   display->clipboard_ustr = NULL;
+   _al_event_source_unlock(&display->es);
+}
+
+
 /* vim: set sts=3 sw=3 et: */
@@ -21,14 +21,110 @@
 #include <ctype.h>
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
-#include "allegro5/internal/aintern_aatree.h"
 #include "allegro5/internal/aintern_config.h"
 
+#define MIN_BUCKETS 8
+#define TEXT_CHUNK_SIZE 4096
+#define ARENA_HEADER_SIZE 16
+#define ALIGN_SIZE(n)   (((n) + 15) & ~(size_t)15)
 
 
-static int cmp_ustr(void const *a, void const *b)
+
+/* FNV-1a. */
+static uint32_t hash_ustr(const ALLEGRO_USTR *us)
+{
+   const unsigned char *p = (const unsigned char *)al_cstr(us);
+   size_t n = al_ustr_size(us);
+   uint32_t h = 2166136261u;
+
+   while (n--) {
+      h ^= *p++;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+static _AL_CONFIG_NODE *table_find(const _AL_CONFIG_TABLE *table,
+   const ALLEGRO_USTR *name)
+{
+   _AL_CONFIG_NODE *node;
+   uint32_t hash;
+
+   if (table->count == 0)
+      return NULL;
+
+   hash = hash_ustr(name);
+   node = table->buckets[hash & (table->num_buckets - 1)];
+   for (; node; node = node->hash_next) {
+      if (node->hash == hash && al_ustr_equal(node->name, name))
+         return node;
+   }
+   return NULL;
+}
+
+
+/* Adds a node whose name and hash are set, without growing the table. */
+static void table_link(_AL_CONFIG_TABLE *table, _AL_CONFIG_NODE *node)
+{
+   _AL_CONFIG_NODE **bucket =
+      &table->buckets[node->hash & (table->num_buckets - 1)];
+
+   node->hash_next = *bucket;
+   *bucket = node;
+   table->count++;
+}
+
+
+static void table_insert(_AL_CONFIG_TABLE *table, _AL_CONFIG_NODE *node,
+   const ALLEGRO_USTR *name)
+{
+   node->name = name;
+   node->hash = hash_ustr(name);
+
+   /* Keep the load factor at most 1. */
+   if (table->count >= table->num_buckets) {
+      unsigned n = table->num_buckets ? table->num_buckets * 2 : MIN_BUCKETS;
+      _AL_CONFIG_NODE **old = table->buckets;
+      unsigned old_n = table->num_buckets;
+      unsigned i;
+
+      table->buckets = al_calloc(n, sizeof(_AL_CONFIG_NODE *));
+      ASSERT(table->buckets);
+      table->num_buckets = n;
+      table->count = 0;
+      for (i = 0; i < old_n; i++) {
+         _AL_CONFIG_NODE *it = old[i];
+         while (it) {
+            _AL_CONFIG_NODE *next = it->hash_next;
+            table_link(table, it);
+            it = next;
+         }
+      }
+      al_free(old);
+   }
+
+   table_link(table, node);
+}
+
+
+static void table_remove(_AL_CONFIG_TABLE *table, _AL_CONFIG_NODE *node)
 {
-   return al_ustr_compare(a, b);
+   _AL_CONFIG_NODE **it = &table->buckets[node->hash & (table->num_buckets - 1)];
+
+   while (*it != node)
+      it = &(*it)->hash_next;
+   *it = node->hash_next;
+   table->count--;
+}
+
+
+static void table_free(_AL_CONFIG_TABLE *table)
+{
+   al_free(table->buckets);
+   table->buckets = NULL;
+   table->num_buckets = 0;
+   table->count = 0;
 }
 
 
@@ -46,33 +142,14 @@ ALLEGRO_CONFIG *al_create_config(void)
 static ALLEGRO_CONFIG_SECTION *find_section(const ALLEGRO_CONFIG *config,
    const ALLEGRO_USTR *section)
 {
-   return _al_aa_search(config->tree, section, cmp_ustr);
+   return (ALLEGRO_CONFIG_SECTION *)table_find(&config->sections, section);
 }
 
 
 static ALLEGRO_CONFIG_ENTRY *find_entry(const ALLEGRO_CONFIG_SECTION *section,
    const ALLEGRO_USTR *key)
 {
-   return _al_aa_search(section->tree, key, cmp_ustr);
-}
-
-
-static void get_key_and_value(const ALLEGRO_USTR *buf,
-   ALLEGRO_USTR *key, ALLEGRO_USTR *value)
-{
-   int eq = al_ustr_find_chr(buf, 0, '=');
-
-   if (eq == -1) {
-      al_ustr_assign(key, buf);
-      al_ustr_assign_cstr(value, "");
-   }
-   else {
-      al_ustr_assign_substr(key, buf, 0, eq);
-      al_ustr_assign_substr(value, buf, eq + 1, al_ustr_size(buf));
-   }
-
-   al_ustr_trim_ws(key);
-   al_ustr_trim_ws(value);
+   return (ALLEGRO_CONFIG_ENTRY *)table_find(&section->entries, key);
 }
 
 
@@ -99,7 +176,7 @@ static ALLEGRO_CONFIG_SECTION *config_add_section(ALLEGRO_CONFIG *config,
       config->last = section;
    }
 
-   config->tree = _al_aa_insert(config->tree, section->name, section, cmp_ustr);
+   table_insert(&config->sections, &section->node, section->name);
 
    return section;
 }
@@ -112,6 +189,10 @@ void al_add_config_section(ALLEGRO_CONFIG *config, const char *name)
    ALLEGRO_USTR_INFO name_info;
    const ALLEGRO_USTR *uname;
 
+   ASSERT(!config->frozen);
+   if (config->frozen)
+      return;
+
    uname = al_ref_cstr(&name_info, name);
    config_add_section(config, uname);
 }
@@ -128,7 +209,13 @@ static void config_set_value(ALLEGRO_CONFIG *config,
    if (s) {
       entry = find_entry(s, key);
       if (entry) {
-         al_ustr_assign(entry->value, value);
+         if (entry->value_in_arena) {
+            entry->value = al_ustr_dup(value);
+            entry->value_in_arena = false;
+         }
+         else {
+            al_ustr_assign(entry->value, value);
+         }
          al_ustr_trim_ws(entry->value);
          return;
       }
@@ -155,7 +242,7 @@ static void config_set_value(ALLEGRO_CONFIG *config,
       s->last = entry;
    }
 
-   s->tree = _al_aa_insert(s->tree, entry->key, entry, cmp_ustr);
+   table_insert(&s->entries, &entry->node, entry->key);
 }
 
 
@@ -177,6 +264,9 @@ void al_set_config_value(ALLEGRO_CONFIG *config,
 
    ASSERT(key);
    ASSERT(value);
+   ASSERT(!config->frozen);
+   if (config->frozen)
+      return;
 
    usection = al_ref_cstr(&section_info, section);
    ukey = al_ref_cstr(&key_info, key);
@@ -235,6 +325,9 @@ void al_add_config_comment(ALLEGRO_CONFIG *config,
    }
 
    ASSERT(comment);
+   ASSERT(!config->frozen);
+   if (config->frozen)
+      return;
 
    usection = al_ref_cstr(&section_info, section);
    ucomment = al_ref_cstr(&comment_info, comment);
@@ -288,21 +381,207 @@ const char *al_get_config_value(const ALLEGRO_CONFIG *config,
 }
 
 
-static bool readline(ALLEGRO_FILE *file, ALLEGRO_USTR *line)
+/* Reads the rest of the file into a new arena block, with room for a
+ * terminating NUL. Returns the text, or NULL on failure.
+ *
+ * If the size is known, one byte more than that is asked for, so that the
+ * read comes back short at the end of the file and the block is never grown.
+ */
+static char *read_text(ALLEGRO_CONFIG *config, ALLEGRO_FILE *file,
+   size_t *ret_size)
 {
-   char buf[128];
-
-   if (!al_fgets(file, buf, sizeof(buf))) {
-      return false;
+   size_t header = ARENA_HEADER_SIZE;
+   size_t capacity = TEXT_CHUNK_SIZE;
+   size_t size = 0;
+   int64_t remaining;
+   char *block;
+
+   remaining = al_fsize(file);
+   if (remaining >= 0) {
+      int64_t pos = al_ftell(file);
+      if (pos >= 0 && pos <= remaining)
+         capacity = (size_t)(remaining - pos) + 2;
    }
 
-   do {
-      al_ustr_append_cstr(line, buf);
-      if (al_ustr_has_suffix_cstr(line, "\n"))
+   block = al_malloc(header + capacity);
+   if (!block)
+      return NULL;
+
+   for (;;) {
+      size_t n = al_fread(file, block + header + size, capacity - size - 1);
+      size += n;
+      if (size < capacity - 1)
          break;
-   } while (al_fgets(file, buf, sizeof(buf)));
 
-   return true;
+      /* The size was not known or has changed; keep going. */
+      if (al_feof(file))
+         break;
+      capacity *= 2;
+      {
+         char *p = al_realloc(block, header + capacity);
+         if (!p) {
+            al_free(block);
+            return NULL;
+         }
+         block = p;
+      }
+   }
+
+   *(void **)block = config->arena;
+   config->arena = block;
+   block[header + size] = '\0';
+   *ret_size = size;
+   return block + header;
+}
+
+
+static void *arena_alloc(char **pos, size_t size)
+{
+   void *p = *pos;
+   *pos += ALIGN_SIZE(size);
+   return p;
+}
+
+
+static ALLEGRO_USTR *arena_ustr(char **pos, char *start, char *end)
+{
+   ALLEGRO_USTR_INFO *info = arena_alloc(pos, sizeof *info);
+
+   if (start == end)
+      return (ALLEGRO_USTR *)al_ref_buffer(info, "", 0);
+
+   /* The terminator replaces a separator or line end, see parse_text. */
+   *end = '\0';
+   return (ALLEGRO_USTR *)al_ref_buffer(info, start, end - start);
+}
+
+
+static ALLEGRO_CONFIG_SECTION *arena_section(ALLEGRO_CONFIG *config,
+   char **pos, char *start, char *end)
+{
+   ALLEGRO_USTR_INFO name_info;
+   ALLEGRO_CONFIG_SECTION *section;
+
+   section = find_section(config,
+      al_ref_buffer(&name_info, start, end - start));
+   if (section)
+      return section;
+
+   section = arena_alloc(pos, sizeof *section);
+   memset(section, 0, sizeof *section);
+   section->in_arena = true;
+   section->name = arena_ustr(pos, start, end);
+
+   section->prev = config->last;
+   if (config->last)
+      config->last->next = section;
+   else
+      config->head = section;
+   config->last = section;
+
+   table_insert(&config->sections, &section->node, section->name);
+   return section;
+}
+
+
+static void arena_entry(char **pos, ALLEGRO_CONFIG_SECTION *s, bool is_comment,
+   char *key, char *key_end, char *value, char *value_end)
+{
+   ALLEGRO_CONFIG_ENTRY *entry;
+
+   if (!is_comment) {
+      ALLEGRO_USTR_INFO key_info;
+      const ALLEGRO_USTR *ukey = al_ref_buffer(&key_info, key, key_end - key);
+
+      entry = find_entry(s, ukey);
+      if (entry) {
+         if (!entry->value_in_arena)
+            al_ustr_free(entry->value);
+         entry->value = arena_ustr(pos, value, value_end);
+         entry->value_in_arena = true;
+         return;
+      }
+   }
+
+   entry = arena_alloc(pos, sizeof *entry);
+   memset(entry, 0, sizeof *entry);
+   entry->in_arena = true;
+   entry->is_comment = is_comment;
+   entry->key = arena_ustr(pos, key, key_end);
+   if (!is_comment) {
+      entry->value = arena_ustr(pos, value, value_end);
+      entry->value_in_arena = true;
+      table_insert(&s->entries, &entry->node, entry->key);
+   }
+
+   entry->prev = s->last;
+   if (s->last)
+      s->last->next = entry;
+   else
+      s->head = entry;
+   s->last = entry;
+}
+
+
+static void trim(char **start, char **end)
+{
+   while (*start < *end && isspace((unsigned char)**start))
+      (*start)++;
+   while (*end > *start && isspace((unsigned char)(*end)[-1]))
+      (*end)--;
+}
+
+
+/* Parses the text in place: every string ends up NUL-terminated inside the
+ * text, and the sections and entries are carved from the arena block
+ * starting at pos, which has room for one of either per line.
+ */
+static void parse_text(ALLEGRO_CONFIG *config, char *text, size_t size,
+   char *pos)
+{
+   ALLEGRO_CONFIG_SECTION *current = NULL;
+   char *text_end = text + size;
+   char *line = text;
+
+   while (line < text_end) {
+      char *eol = memchr(line, '\n', text_end - line);
+      char *next = eol ? eol + 1 : text_end;
+      char *start = line;
+      char *end = eol ? eol : text_end;
+
+      trim(&start, &end);
+
+      if (start == end || *start == '#') {
+         /* Preserve comments and blank lines */
+         if (!current)
+            current = arena_section(config, &pos, start, start);
+         arena_entry(&pos, current, true, start, end, NULL, NULL);
+      }
+      else if (*start == '[') {
+         char *name = start + 1;
+         char *rbracket = end;
+
+         while (rbracket > name && rbracket[-1] != ']')
+            rbracket--;
+         current = arena_section(config, &pos, name,
+            rbracket > name ? rbracket - 1 : end);
+      }
+      else {
+         char *eq = memchr(start, '=', end - start);
+         char *key_end = eq ? eq : end;
+         char *value = eq ? eq + 1 : end;
+         char *value_end = end;
+
+         trim(&start, &key_end);
+         trim(&value, &value_end);
+         if (!current)
+            current = arena_section(config, &pos, start, start);
+         arena_entry(&pos, current, false, start, key_end,
+            value, value_end);
+      }
+
+      line = next;
+   }
 }
 
 
@@ -328,11 +607,12 @@ ALLEGRO_CONFIG *al_load_config_file(const char *filename)
 ALLEGRO_CONFIG *al_load_config_file_f(ALLEGRO_FILE *file)
 {
    ALLEGRO_CONFIG *config;
-   ALLEGRO_CONFIG_SECTION *current_section = NULL;
-   ALLEGRO_USTR *line;
-   ALLEGRO_USTR *section;
-   ALLEGRO_USTR *key;
-   ALLEGRO_USTR *value;
+   char *text;
+   size_t size;
+   size_t num_lines;
+   size_t per_line;
+   char *block;
+   char *p;
    ASSERT(file);
 
    config = al_create_config();
@@ -340,63 +620,50 @@ ALLEGRO_CONFIG *al_load_config_file_f(ALLEGRO_FILE *file)
       return NULL;
    }
 
-   line = al_ustr_new("");
-   section = al_ustr_new("");
-   key = al_ustr_new("");
-   value = al_ustr_new("");
-
-   while (1) {
-      al_ustr_assign_cstr(line, "");
-      if (!readline(file, line))
-         break;
-      al_ustr_trim_ws(line);
+   /* Read everything at once and parse it in place. The strings stay in the
+    * text and the sections and entries go into one more arena block, so a
+    * large file needs just two allocations plus the hash tables.
+    */
+   text = read_text(config, file, &size);
+   if (!text) {
+      al_destroy_config(config);
+      return NULL;
+   }
 
-      if (al_ustr_has_prefix_cstr(line, "#") || al_ustr_size(line) == 0) {
-         /* Preserve comments and blank lines */
-         const ALLEGRO_USTR *name;
-         if (current_section)
-            name = current_section->name;
-         else
-            name = al_ustr_empty_string();
-         config_add_comment(config, name, line);
-      }
-      else if (al_ustr_has_prefix_cstr(line, "[")) {
-         int rbracket = al_ustr_rfind_chr(line, al_ustr_size(line), ']');
-         if (rbracket == -1)
-            rbracket = al_ustr_size(line);
-         al_ustr_assign_substr(section, line, 1, rbracket);
-         current_section = config_add_section(config, section);
-      }
-      else {
-         get_key_and_value(line, key, value);
-         if (current_section == NULL)
-            config_set_value(config, al_ustr_empty_string(), key, value);
-         else
-            config_set_value(config, current_section->name, key, value);
-      }
+   num_lines = 1;
+   for (p = text; (p = memchr(p, '\n', text + size - p)); p++)
+      num_lines++;
+
+   /* Either a section with its name, or an entry with its key and value. */
+   per_line = _ALLEGRO_MAX(
+      ALIGN_SIZE(sizeof(ALLEGRO_CONFIG_SECTION)) +
+         ALIGN_SIZE(sizeof(ALLEGRO_USTR_INFO)),
+      ALIGN_SIZE(sizeof(ALLEGRO_CONFIG_ENTRY)) +
+         2 * ALIGN_SIZE(sizeof(ALLEGRO_USTR_INFO)));
+   /* Plus the "" section which leading comments or keys may need. */
+   block = al_malloc(ARENA_HEADER_SIZE + (num_lines + 1) * per_line);
+   if (!block) {
+      al_destroy_config(config);
+      return NULL;
    }
+   *(void **)block = config->arena;
+   config->arena = block;
 
-   al_ustr_free(line);
-   al_ustr_free(section);
-   al_ustr_free(key);
-   al_ustr_free(value);
+   parse_text(config, text, size, block + ARENA_HEADER_SIZE);
 
    return config;
 }
 
 
-static bool config_write_section(ALLEGRO_FILE *file,
+static void config_write_section(ALLEGRO_USTR *out,
    const ALLEGRO_CONFIG_SECTION *s)
 {
    ALLEGRO_CONFIG_ENTRY *e;
 
    if (al_ustr_size(s->name) > 0) {
-      al_fputc(file, '[');
-      al_fputs(file, al_cstr(s->name));
-      al_fputs(file, "]\n");
-      if (al_ferror(file)) {
-         return false;
-      }
+      al_ustr_append_chr(out, '[');
+      al_ustr_append(out, s->name);
+      al_ustr_append_cstr(out, "]\n");
    }
 
    e = s->head;
@@ -404,26 +671,21 @@ static bool config_write_section(ALLEGRO_FILE *file,
       if (e->is_comment) {
          if (al_ustr_size(e->key) > 0) {
             if (!al_ustr_has_prefix_cstr(e->key, "#")) {
-               al_fputs(file, "# ");
+               al_ustr_append_cstr(out, "# ");
             }
-            al_fputs(file, al_cstr(e->key));
+            al_ustr_append(out, e->key);
          }
-         al_fputc(file, '\n');
+         al_ustr_append_chr(out, '\n');
       }
       else {
-         al_fputs(file, al_cstr(e->key));
-         al_fputc(file, '=');
-         al_fputs(file, al_cstr(e->value));
-         al_fputc(file, '\n');
-      }
-      if (al_ferror(file)) {
-         return false;
+         al_ustr_append(out, e->key);
+         al_ustr_append_chr(out, '=');
+         al_ustr_append(out, e->value);
+         al_ustr_append_chr(out, '\n');
       }
 
       e = e->next;
    }
-
-   return !al_feof(file);
 }
 
 
@@ -449,14 +711,18 @@ bool al_save_config_file(const char *filename, const ALLEGRO_CONFIG *config)
 bool al_save_config_file_f(ALLEGRO_FILE *file, const ALLEGRO_CONFIG *config)
 {
    ALLEGRO_CONFIG_SECTION *s;
+   ALLEGRO_USTR *out;
+   size_t size;
+   bool ret;
+
+   /* Format everything first, then write it in one go. */
+   out = al_ustr_new("");
 
    /* Save global section */
    s = config->head;
    while (s != NULL) {
       if (al_ustr_size(s->name) == 0) {
-         if (!config_write_section(file, s)) {
-            return false;
-         }
+         config_write_section(out, s);
          break;
       }
       s = s->next;
@@ -466,14 +732,16 @@ bool al_save_config_file_f(ALLEGRO_FILE *file, const ALLEGRO_CONFIG *config)
    s = config->head;
    while (s != NULL) {
       if (al_ustr_size(s->name) > 0) {
-         if (!config_write_section(file, s)) {
-            return false;
-         }
+         config_write_section(out, s);
       }
       s = s->next;
    }
 
-   return !al_feof(file);
+   size = al_ustr_size(out);
+   ret = al_fwrite(file, al_cstr(out), size) == size && !al_ferror(file);
+   al_ustr_free(out);
+
+   return ret;
 }
 
 
@@ -486,8 +754,9 @@ static void do_config_merge_into(ALLEGRO_CONFIG *master,
    ALLEGRO_CONFIG_SECTION *s;
    ALLEGRO_CONFIG_ENTRY *e;
    ASSERT(master);
+   ASSERT(!master->frozen);
 
-   if (!add) {
+   if (!add || master->frozen) {
       return;
    }
 
@@ -532,11 +801,146 @@ ALLEGRO_CONFIG *al_merge_config(const ALLEGRO_CONFIG *cfg1,
 }
 
 
+static unsigned frozen_buckets(unsigned count)
+{
+   unsigned n = 1;
+
+   /* A load factor of at most 0.5 keeps most chains at one node. */
+   while (n < count * 2)
+      n *= 2;
+   return n;
+}
+
+
+/* Copies a string into the frozen block and returns a reference to it. */
+static ALLEGRO_USTR *freeze_ustr(ALLEGRO_USTR_INFO **info, char **chars,
+   const ALLEGRO_USTR *us)
+{
+   size_t size = al_ustr_size(us);
+   const ALLEGRO_USTR *ref;
+
+   memcpy(*chars, al_cstr(us), size);
+   (*chars)[size] = '\0';
+   ref = al_ref_buffer(*info, *chars, size);
+   (*info)++;
+   *chars += size + 1;
+   return (ALLEGRO_USTR *)ref;
+}
+
+
+/* Function: al_freeze_config
+ */
+ALLEGRO_CONFIG *al_freeze_config(const ALLEGRO_CONFIG *config)
+{
+   const ALLEGRO_CONFIG_SECTION *s;
+   const ALLEGRO_CONFIG_ENTRY *e;
+   size_t num_sections = 0;
+   size_t num_entries = 0;
+   size_t num_ustrs = 0;
+   size_t num_buckets;
+   size_t num_chars = 0;
+   size_t sections_ofs, entries_ofs, ustrs_ofs, buckets_ofs, chars_ofs;
+   unsigned char *block;
+   ALLEGRO_CONFIG *frozen;
+   ALLEGRO_CONFIG_SECTION *fs;
+   ALLEGRO_CONFIG_ENTRY *fe;
+   ALLEGRO_USTR_INFO *info;
+   _AL_CONFIG_NODE **buckets;
+   char *chars;
+   ASSERT(config);
+
+   /* Everything goes into a single block: the sections, the entries and
+    * their strings, in order, so that lookups touch little memory.
+    */
+   num_buckets = frozen_buckets(config->sections.count);
+   for (s = config->head; s; s = s->next) {
+      num_sections++;
+      num_ustrs++;
+      num_chars += al_ustr_size(s->name) + 1;
+      num_buckets += frozen_buckets(s->entries.count);
+      for (e = s->head; e; e = e->next) {
+         num_entries++;
+         num_ustrs++;
+         num_chars += al_ustr_size(e->key) + 1;
+         if (!e->is_comment) {
+            num_ustrs++;
+            num_chars += al_ustr_size(e->value) + 1;
+         }
+      }
+   }
+
+   sections_ofs = ALIGN_SIZE(sizeof(ALLEGRO_CONFIG));
+   entries_ofs = sections_ofs +
+      ALIGN_SIZE(num_sections * sizeof(ALLEGRO_CONFIG_SECTION));
+   ustrs_ofs = entries_ofs +
+      ALIGN_SIZE(num_entries * sizeof(ALLEGRO_CONFIG_ENTRY));
+   buckets_ofs = ustrs_ofs + ALIGN_SIZE(num_ustrs * sizeof(ALLEGRO_USTR_INFO));
+   chars_ofs = buckets_ofs + ALIGN_SIZE(num_buckets * sizeof(_AL_CONFIG_NODE *));
+
+   block = al_calloc(1, chars_ofs + num_chars);
+   if (!block)
+      return NULL;
+
+   frozen = (ALLEGRO_CONFIG *)block;
+   fs = (ALLEGRO_CONFIG_SECTION *)(block + sections_ofs);
+   fe = (ALLEGRO_CONFIG_ENTRY *)(block + entries_ofs);
+   info = (ALLEGRO_USTR_INFO *)(block + ustrs_ofs);
+   buckets = (_AL_CONFIG_NODE **)(block + buckets_ofs);
+   chars = (char *)(block + chars_ofs);
+
+   frozen->frozen = true;
+   frozen->sections.buckets = buckets;
+   frozen->sections.num_buckets = frozen_buckets(config->sections.count);
+   buckets += frozen->sections.num_buckets;
+
+   for (s = config->head; s; s = s->next, fs++) {
+      fs->name = freeze_ustr(&info, &chars, s->name);
+      fs->node.name = fs->name;
+      fs->node.hash = s->node.hash;
+      table_link(&frozen->sections, &fs->node);
+
+      fs->entries.buckets = buckets;
+      fs->entries.num_buckets = frozen_buckets(s->entries.count);
+      buckets += fs->entries.num_buckets;
+
+      for (e = s->head; e; e = e->next, fe++) {
+         fe->is_comment = e->is_comment;
+         fe->key = freeze_ustr(&info, &chars, e->key);
+         if (!e->is_comment) {
+            fe->value = freeze_ustr(&info, &chars, e->value);
+            fe->node.name = fe->key;
+            fe->node.hash = e->node.hash;
+            table_link(&fs->entries, &fe->node);
+         }
+
+         fe->prev = fs->last;
+         if (fs->last)
+            fs->last->next = fe;
+         else
+            fs->head = fe;
+         fs->last = fe;
+      }
+
+      fs->prev = frozen->last;
+      if (frozen->last)
+         frozen->last->next = fs;
+      else
+         frozen->head = fs;
+      frozen->last = fs;
+   }
+
+   return frozen;
+}
+
+
 static void destroy_entry(ALLEGRO_CONFIG_ENTRY *e)
 {
-   al_ustr_free(e->key);
-   al_ustr_free(e->value);
-   al_free(e);
+   if (!e->value_in_arena)
+      al_ustr_free(e->value);
+   if (!e->in_arena) {
+      al_ustr_free(e->key);
+      al_free(e);
+   }
 }
 
 
@@ -548,9 +952,11 @@ static void destroy_section(ALLEGRO_CONFIG_SECTION *s)
       destroy_entry(e);
       e = tmp;
    }
-   al_ustr_free(s->name);
-   _al_aa_free(s->tree);
-   al_free(s);
+   table_free(&s->entries);
+   if (!s->in_arena) {
+      al_ustr_free(s->name);
+      al_free(s);
+   }
 }
 
 
@@ -564,6 +970,11 @@ void al_destroy_config(ALLEGRO_CONFIG *config)
       return;
    }
 
+   if (config->frozen) {
+      al_free(config);
+      return;
+   }
+
    s = config->head;
    while (s) {
       ALLEGRO_CONFIG_SECTION *tmp = s->next;
@@ -571,7 +982,12 @@ void al_destroy_config(ALLEGRO_CONFIG *config)
       s = tmp;
    }
 
-   _al_aa_free(config->tree);
+   table_free(&config->sections);
+   while (config->arena) {
+      void *next = *(void **)config->arena;
+      al_free(config->arena);
+      config->arena = next;
+   }
    al_free(config);
 }
 
@@ -659,20 +1075,21 @@ bool al_remove_config_section(ALLEGRO_CONFIG *config, char const *section)
 {
    ALLEGRO_USTR_INFO section_info;
    ALLEGRO_USTR const *usection;
-   void *value;
    ALLEGRO_CONFIG_SECTION *s;
 
+   ASSERT(!config->frozen);
+   if (config->frozen)
+      return false;
+
    if (section == NULL)
       section = "";
 
    usection = al_ref_cstr(&section_info, section);
 
-   value = NULL;
-   config->tree = _al_aa_delete(config->tree, usection, cmp_ustr, &value);
-   if (!value)
+   s = find_section(config, usection);
+   if (!s)
       return false;
-
-   s = value;
+   table_remove(&config->sections, &s->node);
 
    if (s->prev) {
       s->prev->next = s->next;
@@ -704,9 +1121,12 @@ bool al_remove_config_key(ALLEGRO_CONFIG *config, char const *section,
    ALLEGRO_USTR_INFO key_info;
    ALLEGRO_USTR const *usection;
    ALLEGRO_USTR const *ukey = al_ref_cstr(&key_info, key);
-   void *value;
    ALLEGRO_CONFIG_ENTRY * e;
 
+   ASSERT(!config->frozen);
+   if (config->frozen)
+      return false;
+
    if (section == NULL)
       section = "";
 
@@ -716,12 +1136,10 @@ bool al_remove_config_key(ALLEGRO_CONFIG *config, char const *section,
    if (!s)
       return false;
 
-   value = NULL;
-   s->tree = _al_aa_delete(s->tree, ukey, cmp_ustr, &value);
-   if (!value)
+   e = find_entry(s, ukey);
+   if (!e)
       return false;
-
-   e = value;
+   table_remove(&s->entries, &e->node);
 
    if (e->prev) {
       e->prev->next = e->next;
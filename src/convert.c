@@ -416,6 +416,50 @@ static void argb_8888_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void argb_8888_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void rgba_8888_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -830,6 +874,50 @@ static void rgba_8888_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void rgba_8888_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_RGBA_8888_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void rgba_8888_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_RGBA_8888_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void argb_4444_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -1244,6 +1332,50 @@ static void argb_4444_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void argb_4444_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_4444_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_4444_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_4444_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void rgb_888_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -1739,6 +1871,60 @@ static void rgb_888_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void rgb_888_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint8_t *src_ptr = (const uint8_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 1 - width * 3;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx * 3;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         #ifdef ALLEGRO_BIG_ENDIAN
+         int src_pixel = src_ptr[2] | (src_ptr[1] << 8) | (src_ptr[0] << 16);
+         #else
+         int src_pixel = src_ptr[0] | (src_ptr[1] << 8) | (src_ptr[2] << 16);
+         #endif
+         *dst_ptr = ALLEGRO_CONVERT_RGB_888_TO_ARGB_8888_SRGB(src_pixel);
+         src_ptr += 1 * 3;
+         dst_ptr += 1;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void rgb_888_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint8_t *src_ptr = (const uint8_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 1 - width * 3;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx * 3;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         #ifdef ALLEGRO_BIG_ENDIAN
+         int src_pixel = src_ptr[2] | (src_ptr[1] << 8) | (src_ptr[0] << 16);
+         #else
+         int src_pixel = src_ptr[0] | (src_ptr[1] << 8) | (src_ptr[2] << 16);
+         #endif
+         *dst_ptr = ALLEGRO_CONVERT_RGB_888_TO_ABGR_8888_SRGB(src_pixel);
+         src_ptr += 1 * 3;
+         dst_ptr += 1;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void rgb_565_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -2153,6 +2339,50 @@ static void rgb_565_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void rgb_565_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_RGB_565_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void rgb_565_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_RGB_565_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void rgb_555_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -2567,6 +2797,50 @@ static void rgb_555_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void rgb_555_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_RGB_555_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void rgb_555_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_RGB_555_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void rgba_5551_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -2981,7 +3255,7 @@ static void rgba_5551_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
-static void argb_1555_to_argb_8888(const void *src, int src_pitch,
+static void rgba_5551_to_argb_8888_srgb(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
 {
@@ -2995,7 +3269,7 @@ static void argb_1555_to_argb_8888(const void *src, int src_pitch,
    for (y = 0; y < height; y++) {
       uint32_t *dst_end = dst_ptr + width;
       while (dst_ptr < dst_end) {
-         *dst_ptr = ALLEGRO_CONVERT_ARGB_1555_TO_ARGB_8888(*src_ptr);
+         *dst_ptr = ALLEGRO_CONVERT_RGBA_5551_TO_ARGB_8888_SRGB(*src_ptr);
          dst_ptr++;
          src_ptr++;
       }
@@ -3003,7 +3277,7 @@ static void argb_1555_to_argb_8888(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
-static void argb_1555_to_rgba_8888(const void *src, int src_pitch,
+static void rgba_5551_to_abgr_8888_srgb(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
 {
@@ -3017,7 +3291,7 @@ static void argb_1555_to_rgba_8888(const void *src, int src_pitch,
    for (y = 0; y < height; y++) {
       uint32_t *dst_end = dst_ptr + width;
       while (dst_ptr < dst_end) {
-         *dst_ptr = ALLEGRO_CONVERT_ARGB_1555_TO_RGBA_8888(*src_ptr);
+         *dst_ptr = ALLEGRO_CONVERT_RGBA_5551_TO_ABGR_8888_SRGB(*src_ptr);
          dst_ptr++;
          src_ptr++;
       }
@@ -3025,7 +3299,51 @@ static void argb_1555_to_rgba_8888(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
-static void argb_1555_to_argb_4444(const void *src, int src_pitch,
+static void argb_1555_to_argb_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_1555_TO_ARGB_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_1555_to_rgba_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_1555_TO_RGBA_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_1555_to_argb_4444(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
 {
@@ -3395,6 +3713,50 @@ static void argb_1555_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void argb_1555_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_1555_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_1555_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_1555_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void abgr_8888_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -3809,6 +4171,50 @@ static void abgr_8888_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void abgr_8888_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void xbgr_8888_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -4223,6 +4629,50 @@ static void xbgr_8888_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void xbgr_8888_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_XBGR_8888_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void xbgr_8888_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_XBGR_8888_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void bgr_888_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -4718,6 +5168,60 @@ static void bgr_888_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void bgr_888_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint8_t *src_ptr = (const uint8_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 1 - width * 3;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx * 3;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         #ifdef ALLEGRO_BIG_ENDIAN
+         int src_pixel = src_ptr[2] | (src_ptr[1] << 8) | (src_ptr[0] << 16);
+         #else
+         int src_pixel = src_ptr[0] | (src_ptr[1] << 8) | (src_ptr[2] << 16);
+         #endif
+         *dst_ptr = ALLEGRO_CONVERT_BGR_888_TO_ARGB_8888_SRGB(src_pixel);
+         src_ptr += 1 * 3;
+         dst_ptr += 1;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void bgr_888_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint8_t *src_ptr = (const uint8_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 1 - width * 3;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx * 3;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         #ifdef ALLEGRO_BIG_ENDIAN
+         int src_pixel = src_ptr[2] | (src_ptr[1] << 8) | (src_ptr[0] << 16);
+         #else
+         int src_pixel = src_ptr[0] | (src_ptr[1] << 8) | (src_ptr[2] << 16);
+         #endif
+         *dst_ptr = ALLEGRO_CONVERT_BGR_888_TO_ABGR_8888_SRGB(src_pixel);
+         src_ptr += 1 * 3;
+         dst_ptr += 1;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void bgr_565_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -5132,6 +5636,50 @@ static void bgr_565_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void bgr_565_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_BGR_565_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void bgr_565_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_BGR_565_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void bgr_555_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -5546,12 +6094,56 @@ static void bgr_555_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
-static void rgbx_8888_to_argb_8888(const void *src, int src_pitch,
+static void bgr_555_to_argb_8888_srgb(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
 {
    int y;
-   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_BGR_555_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void bgr_555_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_BGR_555_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void rgbx_8888_to_argb_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
    uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
    int src_gap = src_pitch / 4 - width;
    int dst_gap = dst_pitch / 4 - width;
@@ -5960,6 +6552,50 @@ static void rgbx_8888_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void rgbx_8888_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_RGBX_8888_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void rgbx_8888_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_RGBX_8888_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void xrgb_8888_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -6374,6 +7010,50 @@ static void xrgb_8888_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void xrgb_8888_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_XRGB_8888_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void xrgb_8888_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_XRGB_8888_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void abgr_f32_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -6788,6 +7468,50 @@ static void abgr_f32_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void abgr_f32_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const ALLEGRO_COLOR *src_ptr = (const ALLEGRO_COLOR *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 16 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_F32_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_f32_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const ALLEGRO_COLOR *src_ptr = (const ALLEGRO_COLOR *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 16 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_F32_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void abgr_8888_le_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -7202,6 +7926,50 @@ static void abgr_8888_le_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void abgr_8888_le_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_LE_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_le_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_LE_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void rgba_4444_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -7616,6 +8384,50 @@ static void rgba_4444_to_single_channel_8(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
+static void rgba_4444_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_RGBA_4444_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void rgba_4444_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint16_t *src_ptr = (const uint16_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 2 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_RGBA_4444_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
 static void single_channel_8_to_argb_8888(const void *src, int src_pitch,
    void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
@@ -8030,20 +8842,980 @@ static void single_channel_8_to_rgba_4444(const void *src, int src_pitch,
       dst_ptr += dst_gap;
    }
 }
-void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
-   [ALLEGRO_NUM_PIXEL_FORMATS])(const void *, int, void *, int,
-   int, int, int, int, int, int) = {
-   {NULL},
-   {NULL},
-   {NULL},
-   {NULL},
-   {NULL},
-   {NULL},
-   {NULL},
-   {NULL},
-   {NULL},
-   {
-      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+static void single_channel_8_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint8_t *src_ptr = (const uint8_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 1 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_SINGLE_CHANNEL_8_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void single_channel_8_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint8_t *src_ptr = (const uint8_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 1 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_SINGLE_CHANNEL_8_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_argb_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ARGB_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_rgba_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGBA_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_argb_4444(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ARGB_4444(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_rgb_888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint8_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 1 - width * 3;
+   src_ptr += sx;
+   dst_ptr += dx * 3;
+   for (y = 0; y < height; y++) {
+      uint8_t *dst_end = dst_ptr + width * 3;
+      while (dst_ptr < dst_end) {
+         int dst_pixel = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGB_888(*src_ptr);
+         #ifdef ALLEGRO_BIG_ENDIAN
+         dst_ptr[0] = dst_pixel >> 16;
+         dst_ptr[1] = dst_pixel >> 8;
+         dst_ptr[2] = dst_pixel;
+         #else
+         dst_ptr[0] = dst_pixel;
+         dst_ptr[1] = dst_pixel >> 8;
+         dst_ptr[2] = dst_pixel >> 16;
+         #endif
+         src_ptr += 1;
+         dst_ptr += 1 * 3;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_rgb_565(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGB_565(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_rgb_555(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGB_555(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_rgba_5551(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGBA_5551(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_argb_1555(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ARGB_1555(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_abgr_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ABGR_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_xbgr_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_XBGR_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_bgr_888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint8_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 1 - width * 3;
+   src_ptr += sx;
+   dst_ptr += dx * 3;
+   for (y = 0; y < height; y++) {
+      uint8_t *dst_end = dst_ptr + width * 3;
+      while (dst_ptr < dst_end) {
+         int dst_pixel = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_BGR_888(*src_ptr);
+         #ifdef ALLEGRO_BIG_ENDIAN
+         dst_ptr[0] = dst_pixel >> 16;
+         dst_ptr[1] = dst_pixel >> 8;
+         dst_ptr[2] = dst_pixel;
+         #else
+         dst_ptr[0] = dst_pixel;
+         dst_ptr[1] = dst_pixel >> 8;
+         dst_ptr[2] = dst_pixel >> 16;
+         #endif
+         src_ptr += 1;
+         dst_ptr += 1 * 3;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_bgr_565(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_BGR_565(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_bgr_555(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_BGR_555(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_rgbx_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGBX_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_xrgb_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_XRGB_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_abgr_f32(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   ALLEGRO_COLOR *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 16 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      ALLEGRO_COLOR *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ABGR_F32(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_abgr_8888_le(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ABGR_8888_LE(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_rgba_4444(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_RGBA_4444(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_single_channel_8(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint8_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 1 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint8_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_SINGLE_CHANNEL_8(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void argb_8888_srgb_to_abgr_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ARGB_8888_SRGB_TO_ABGR_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_argb_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ARGB_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_rgba_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGBA_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_argb_4444(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ARGB_4444(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_rgb_888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint8_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 1 - width * 3;
+   src_ptr += sx;
+   dst_ptr += dx * 3;
+   for (y = 0; y < height; y++) {
+      uint8_t *dst_end = dst_ptr + width * 3;
+      while (dst_ptr < dst_end) {
+         int dst_pixel = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGB_888(*src_ptr);
+         #ifdef ALLEGRO_BIG_ENDIAN
+         dst_ptr[0] = dst_pixel >> 16;
+         dst_ptr[1] = dst_pixel >> 8;
+         dst_ptr[2] = dst_pixel;
+         #else
+         dst_ptr[0] = dst_pixel;
+         dst_ptr[1] = dst_pixel >> 8;
+         dst_ptr[2] = dst_pixel >> 16;
+         #endif
+         src_ptr += 1;
+         dst_ptr += 1 * 3;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_rgb_565(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGB_565(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_rgb_555(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGB_555(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_rgba_5551(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGBA_5551(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_argb_1555(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ARGB_1555(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_abgr_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ABGR_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_xbgr_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_XBGR_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_bgr_888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint8_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 1 - width * 3;
+   src_ptr += sx;
+   dst_ptr += dx * 3;
+   for (y = 0; y < height; y++) {
+      uint8_t *dst_end = dst_ptr + width * 3;
+      while (dst_ptr < dst_end) {
+         int dst_pixel = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_BGR_888(*src_ptr);
+         #ifdef ALLEGRO_BIG_ENDIAN
+         dst_ptr[0] = dst_pixel >> 16;
+         dst_ptr[1] = dst_pixel >> 8;
+         dst_ptr[2] = dst_pixel;
+         #else
+         dst_ptr[0] = dst_pixel;
+         dst_ptr[1] = dst_pixel >> 8;
+         dst_ptr[2] = dst_pixel >> 16;
+         #endif
+         src_ptr += 1;
+         dst_ptr += 1 * 3;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_bgr_565(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_BGR_565(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_bgr_555(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_BGR_555(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_rgbx_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGBX_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_xrgb_8888(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_XRGB_8888(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_abgr_f32(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   ALLEGRO_COLOR *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 16 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      ALLEGRO_COLOR *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ABGR_F32(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_abgr_8888_le(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ABGR_8888_LE(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_rgba_4444(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint16_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 2 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint16_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_RGBA_4444(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_single_channel_8(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint8_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 1 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint8_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_SINGLE_CHANNEL_8(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+static void abgr_8888_srgb_to_argb_8888_srgb(const void *src, int src_pitch,
+   void *dst, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   int y;
+   const uint32_t *src_ptr = (const uint32_t *)((const char *)src + sy * src_pitch);
+   uint32_t *dst_ptr = (void *)((char *)dst + dy * dst_pitch);
+   int src_gap = src_pitch / 4 - width;
+   int dst_gap = dst_pitch / 4 - width;
+   src_ptr += sx;
+   dst_ptr += dx;
+   for (y = 0; y < height; y++) {
+      uint32_t *dst_end = dst_ptr + width;
+      while (dst_ptr < dst_end) {
+         *dst_ptr = ALLEGRO_CONVERT_ABGR_8888_SRGB_TO_ARGB_8888_SRGB(*src_ptr);
+         dst_ptr++;
+         src_ptr++;
+      }
+      src_ptr += src_gap;
+      dst_ptr += dst_gap;
+   }
+}
+void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
+   [ALLEGRO_NUM_PIXEL_FORMATS])(const void *, int, void *, int,
+   int, int, int, int, int, int) = {
+   {NULL},
+   {NULL},
+   {NULL},
+   {NULL},
+   {NULL},
+   {NULL},
+   {NULL},
+   {NULL},
+   {NULL},
+   {
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
       argb_8888_to_rgba_8888,
       argb_8888_to_argb_4444,
       argb_8888_to_rgb_888,
@@ -8062,7 +9834,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       argb_8888_to_abgr_8888_le,
       argb_8888_to_rgba_4444,
       argb_8888_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      argb_8888_to_argb_8888_srgb,
+      argb_8888_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8085,7 +9859,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       rgba_8888_to_abgr_8888_le,
       rgba_8888_to_rgba_4444,
       rgba_8888_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      rgba_8888_to_argb_8888_srgb,
+      rgba_8888_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8108,7 +9884,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       argb_4444_to_abgr_8888_le,
       argb_4444_to_rgba_4444,
       argb_4444_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      argb_4444_to_argb_8888_srgb,
+      argb_4444_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8131,7 +9909,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       rgb_888_to_abgr_8888_le,
       rgb_888_to_rgba_4444,
       rgb_888_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      rgb_888_to_argb_8888_srgb,
+      rgb_888_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8154,7 +9934,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       rgb_565_to_abgr_8888_le,
       rgb_565_to_rgba_4444,
       rgb_565_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      rgb_565_to_argb_8888_srgb,
+      rgb_565_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8177,7 +9959,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       rgb_555_to_abgr_8888_le,
       rgb_555_to_rgba_4444,
       rgb_555_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      rgb_555_to_argb_8888_srgb,
+      rgb_555_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8200,7 +9984,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       rgba_5551_to_abgr_8888_le,
       rgba_5551_to_rgba_4444,
       rgba_5551_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      rgba_5551_to_argb_8888_srgb,
+      rgba_5551_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8223,7 +10009,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       argb_1555_to_abgr_8888_le,
       argb_1555_to_rgba_4444,
       argb_1555_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      argb_1555_to_argb_8888_srgb,
+      argb_1555_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8246,7 +10034,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       abgr_8888_to_abgr_8888_le,
       abgr_8888_to_rgba_4444,
       abgr_8888_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      abgr_8888_to_argb_8888_srgb,
+      abgr_8888_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8269,7 +10059,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       xbgr_8888_to_abgr_8888_le,
       xbgr_8888_to_rgba_4444,
       xbgr_8888_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      xbgr_8888_to_argb_8888_srgb,
+      xbgr_8888_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8292,7 +10084,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       bgr_888_to_abgr_8888_le,
       bgr_888_to_rgba_4444,
       bgr_888_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      bgr_888_to_argb_8888_srgb,
+      bgr_888_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8315,7 +10109,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       bgr_565_to_abgr_8888_le,
       bgr_565_to_rgba_4444,
       bgr_565_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      bgr_565_to_argb_8888_srgb,
+      bgr_565_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8338,7 +10134,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       bgr_555_to_abgr_8888_le,
       bgr_555_to_rgba_4444,
       bgr_555_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      bgr_555_to_argb_8888_srgb,
+      bgr_555_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8361,7 +10159,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       rgbx_8888_to_abgr_8888_le,
       rgbx_8888_to_rgba_4444,
       rgbx_8888_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      rgbx_8888_to_argb_8888_srgb,
+      rgbx_8888_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8384,7 +10184,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       xrgb_8888_to_abgr_8888_le,
       xrgb_8888_to_rgba_4444,
       xrgb_8888_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      xrgb_8888_to_argb_8888_srgb,
+      xrgb_8888_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8407,7 +10209,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       abgr_f32_to_abgr_8888_le,
       abgr_f32_to_rgba_4444,
       abgr_f32_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      abgr_f32_to_argb_8888_srgb,
+      abgr_f32_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8430,7 +10234,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       NULL,
       abgr_8888_le_to_rgba_4444,
       abgr_8888_le_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      abgr_8888_le_to_argb_8888_srgb,
+      abgr_8888_le_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8453,7 +10259,9 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       rgba_4444_to_abgr_8888_le,
       NULL,
       rgba_4444_to_single_channel_8,
-      NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      rgba_4444_to_argb_8888_srgb,
+      rgba_4444_to_abgr_8888_srgb,
    },
    {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
@@ -8475,11 +10283,70 @@ void (*_al_convert_funcs[ALLEGRO_NUM_PIXEL_FORMATS]
       single_channel_8_to_abgr_f32,
       single_channel_8_to_abgr_8888_le,
       single_channel_8_to_rgba_4444,
-      NULL, NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      single_channel_8_to_argb_8888_srgb,
+      single_channel_8_to_abgr_8888_srgb,
    },
    {NULL},
    {NULL},
    {NULL},
+   {NULL},
+   {NULL},
+   {NULL},
+   {NULL},
+   {NULL},
+   {NULL},
+   {NULL},
+   {NULL},
+   {
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      argb_8888_srgb_to_argb_8888,
+      argb_8888_srgb_to_rgba_8888,
+      argb_8888_srgb_to_argb_4444,
+      argb_8888_srgb_to_rgb_888,
+      argb_8888_srgb_to_rgb_565,
+      argb_8888_srgb_to_rgb_555,
+      argb_8888_srgb_to_rgba_5551,
+      argb_8888_srgb_to_argb_1555,
+      argb_8888_srgb_to_abgr_8888,
+      argb_8888_srgb_to_xbgr_8888,
+      argb_8888_srgb_to_bgr_888,
+      argb_8888_srgb_to_bgr_565,
+      argb_8888_srgb_to_bgr_555,
+      argb_8888_srgb_to_rgbx_8888,
+      argb_8888_srgb_to_xrgb_8888,
+      argb_8888_srgb_to_abgr_f32,
+      argb_8888_srgb_to_abgr_8888_le,
+      argb_8888_srgb_to_rgba_4444,
+      argb_8888_srgb_to_single_channel_8,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      argb_8888_srgb_to_abgr_8888_srgb,
+   },
+   {
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      abgr_8888_srgb_to_argb_8888,
+      abgr_8888_srgb_to_rgba_8888,
+      abgr_8888_srgb_to_argb_4444,
+      abgr_8888_srgb_to_rgb_888,
+      abgr_8888_srgb_to_rgb_565,
+      abgr_8888_srgb_to_rgb_555,
+      abgr_8888_srgb_to_rgba_5551,
+      abgr_8888_srgb_to_argb_1555,
+      abgr_8888_srgb_to_abgr_8888,
+      abgr_8888_srgb_to_xbgr_8888,
+      abgr_8888_srgb_to_bgr_888,
+      abgr_8888_srgb_to_bgr_565,
+      abgr_8888_srgb_to_bgr_555,
+      abgr_8888_srgb_to_rgbx_8888,
+      abgr_8888_srgb_to_xrgb_8888,
+      abgr_8888_srgb_to_abgr_f32,
+      abgr_8888_srgb_to_abgr_8888_le,
+      abgr_8888_srgb_to_rgba_4444,
+      abgr_8888_srgb_to_single_channel_8,
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+      abgr_8888_srgb_to_argb_8888_srgb,
+      NULL,
+   },
 };
 
 // Warning: This file was created by make_converters.py - do not edit.
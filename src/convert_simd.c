@@ -0,0 +1,958 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Vectorized pixel format converters.
+ *
+ *      The converters generated by misc/make_converters.py are the
+ *      reference implementation. The functions in here replace a few of
+ *      the most commonly used ones in _al_convert_funcs if the CPU
+ *      supports it, and fall back to the generated ones for the pixels
+ *      at the end of each row which do not fill a whole vector.
+ *      Results are identical to the generated converters for all
+ *      in-range inputs.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_cpu.h"
+#include "allegro5/internal/aintern_pixels.h"
+
+#include <string.h>
+
+ALLEGRO_DEBUG_CHANNEL("pixels")
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+   #if defined(_MSC_VER) || defined(__clang__) || \
+      (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+      #define SIMD_X86
+   #endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+   #define SIMD_NEON
+   #if defined(__aarch64__) || defined(_M_ARM64)
+      #define SIMD_NEON_DIV
+   #endif
+#endif
+
+/* All the byte shuffles below assume little endian pixel storage. */
+#ifndef ALLEGRO_LITTLE_ENDIAN
+   #undef SIMD_X86
+   #undef SIMD_NEON
+#endif
+
+#if defined(SIMD_X86)
+   #include <immintrin.h>
+   #if defined(__GNUC__) || defined(__clang__)
+      #define TARGET(x) __attribute__((target(x)))
+   #else
+      #define TARGET(x)
+   #endif
+#elif defined(SIMD_NEON)
+   #include <arm_neon.h>
+#endif
+
+
+#define NUM_FORMATS ALLEGRO_NUM_PIXEL_FORMATS
+
+typedef void (*CONVERT_FUNC)(const void *, int, void *, int,
+   int, int, int, int, int, int);
+
+/* The generated converters, saved before we patch _al_convert_funcs. */
+static CONVERT_FUNC scalar_funcs[NUM_FORMATS][NUM_FORMATS];
+static bool scalar_funcs_saved = false;
+
+
+/* Defines a converter with the _al_convert_funcs signature. The row function
+ * converts a multiple of `block' pixels, the rest of each column range is
+ * passed on to the generated converter.
+ */
+#define DEFINE_CONVERTER(name, row, src_fmt, dst_fmt, src_size, dst_size, block) \
+static void name(const void *src, int src_pitch,                           \
+   void *dst, int dst_pitch,                                                \
+   int sx, int sy, int dx, int dy, int width, int height)                   \
+{                                                                           \
+   const char *src_row = (const char *)src + sy * src_pitch + sx * (src_size); \
+   char *dst_row = (char *)dst + dy * dst_pitch + dx * (dst_size);          \
+   int vec_width = width - width % (block);                                 \
+   int y;                                                                   \
+                                                                            \
+   if (vec_width > 0) {                                                     \
+      for (y = 0; y < height; y++) {                                        \
+         row(src_row, dst_row, vec_width);                                  \
+         src_row += src_pitch;                                              \
+         dst_row += dst_pitch;                                              \
+      }                                                                     \
+   }                                                                        \
+   if (vec_width < width) {                                                 \
+      scalar_funcs[src_fmt][dst_fmt](src, src_pitch, dst, dst_pitch,        \
+         sx + vec_width, sy, dx + vec_width, dy, width - vec_width, height); \
+   }                                                                        \
+}
+
+
+#ifdef SIMD_X86
+
+/* 32 bit <-> 32 bit: swapping the red and blue channels. */
+
+TARGET("sse2")
+static void swap_rb_sse2(const void *src, void *dst, int n)
+{
+   const __m128i *s = src;
+   __m128i *d = dst;
+   const __m128i ag_mask = _mm_set1_epi32((int)0xff00ff00);
+   const __m128i rb_mask = _mm_set1_epi32(0x00ff00ff);
+   int i;
+
+   for (i = 0; i < n; i += 4) {
+      __m128i v = _mm_loadu_si128(s++);
+      __m128i ag = _mm_and_si128(v, ag_mask);
+      __m128i rb = _mm_and_si128(v, rb_mask);
+      rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+      _mm_storeu_si128(d++, _mm_or_si128(ag, rb));
+   }
+}
+
+TARGET("ssse3")
+static void swap_rb_ssse3(const void *src, void *dst, int n)
+{
+   const __m128i *s = src;
+   __m128i *d = dst;
+   const __m128i mask = _mm_setr_epi8(
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+   int i;
+
+   for (i = 0; i < n; i += 4) {
+      __m128i v = _mm_loadu_si128(s++);
+      _mm_storeu_si128(d++, _mm_shuffle_epi8(v, mask));
+   }
+}
+
+TARGET("avx2")
+static void swap_rb_avx2(const void *src, void *dst, int n)
+{
+   const __m256i *s = src;
+   __m256i *d = dst;
+   const __m256i mask = _mm256_setr_epi8(
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+   int i;
+
+   for (i = 0; i < n; i += 8) {
+      __m256i v = _mm256_loadu_si256(s++);
+      _mm256_storeu_si256(d++, _mm256_shuffle_epi8(v, mask));
+   }
+}
+
+/* 32 bit -> RGB_565. */
+#define ARGB_8888_TO_RGB_565_SSE2(v)                                         \
+   _mm_or_si128(_mm_or_si128(                                                \
+      _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xf80000)), 8),         \
+      _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xfc00)), 5)),          \
+      _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xf8)), 3))
+
+#define ABGR_8888_TO_RGB_565_SSE2(v)                                         \
+   _mm_or_si128(_mm_or_si128(                                                \
+      _mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xf8)), 8),             \
+      _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xfc00)), 5)),          \
+      _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xf80000)), 19))
+
+#define DEFINE_TO_565(name, to_565)                                          \
+TARGET("sse2")                                                               \
+static void name(const void *src, void *dst, int n)                          \
+{                                                                            \
+   const __m128i *s = src;                                                   \
+   __m128i *d = dst;                                                         \
+   int i;                                                                    \
+                                                                             \
+   for (i = 0; i < n; i += 8) {                                              \
+      __m128i v0 = _mm_loadu_si128(s++);                                     \
+      __m128i v1 = _mm_loadu_si128(s++);                                     \
+      __m128i p0 = to_565(v0);                                               \
+      __m128i p1 = to_565(v1);                                               \
+      /* Sign extend the low halves so the saturating pack is exact. */      \
+      p0 = _mm_srai_epi32(_mm_slli_epi32(p0, 16), 16);                       \
+      p1 = _mm_srai_epi32(_mm_slli_epi32(p1, 16), 16);                       \
+      _mm_storeu_si128(d++, _mm_packs_epi32(p0, p1));                        \
+   }                                                                         \
+}
+
+DEFINE_TO_565(argb_8888_to_rgb_565_row_sse2, ARGB_8888_TO_RGB_565_SSE2)
+DEFINE_TO_565(abgr_8888_to_rgb_565_row_sse2, ABGR_8888_TO_RGB_565_SSE2)
+
+/* RGB_565 -> 32 bit. The 5 and 6 bit channels are scaled exactly like the
+ * _al_rgb_scale_5/6 tables do, i.e. floor(x * 255 / 31) and
+ * floor(x * 255 / 63), using a multiply-high.
+ */
+#define DEFINE_FROM_565(name, abgr)                                          \
+TARGET("sse2")                                                               \
+static void name(const void *src, void *dst, int n)                          \
+{                                                                            \
+   const __m128i *s = src;                                                   \
+   __m128i *d = dst;                                                         \
+   const __m128i mask5_lo = _mm_set1_epi16(0x001f);                          \
+   const __m128i mask6 = _mm_set1_epi16(0x07e0);                             \
+   const __m128i mask5_hi = _mm_set1_epi16((short)0xf800);                   \
+   const __m128i scale5 = _mm_set1_epi16(1053);                              \
+   const __m128i scale6 = _mm_set1_epi16(4145);                              \
+   const __m128i alpha = _mm_set1_epi16((short)0xff00);                      \
+   int i;                                                                    \
+                                                                             \
+   for (i = 0; i < n; i += 8) {                                              \
+      __m128i v = _mm_loadu_si128(s++);                                      \
+      __m128i b = _mm_mulhi_epu16(                                           \
+         _mm_slli_epi16(_mm_and_si128(v, mask5_lo), 9), scale5);             \
+      __m128i g = _mm_mulhi_epu16(                                           \
+         _mm_slli_epi16(_mm_and_si128(v, mask6), 1), scale6);                \
+      __m128i r = _mm_mulhi_epu16(                                           \
+         _mm_srli_epi16(_mm_and_si128(v, mask5_hi), 2), scale5);             \
+      __m128i lo, hi;                                                        \
+      if (abgr) {                                                            \
+         lo = _mm_or_si128(r, _mm_slli_epi16(g, 8));                         \
+         hi = _mm_or_si128(b, alpha);                                        \
+      }                                                                      \
+      else {                                                                 \
+         lo = _mm_or_si128(b, _mm_slli_epi16(g, 8));                         \
+         hi = _mm_or_si128(r, alpha);                                        \
+      }                                                                      \
+      _mm_storeu_si128(d++, _mm_unpacklo_epi16(lo, hi));                     \
+      _mm_storeu_si128(d++, _mm_unpackhi_epi16(lo, hi));                     \
+   }                                                                         \
+}
+
+DEFINE_FROM_565(rgb_565_to_argb_8888_row_sse2, false)
+DEFINE_FROM_565(rgb_565_to_abgr_8888_row_sse2, true)
+
+/* 32 bit -> ABGR_F32. `shuf' reorders the channels of one pixel into
+ * r, g, b, a order.
+ */
+#define DEFINE_TO_F32(name, shuf)                                            \
+TARGET("sse2")                                                               \
+static void name(const void *src, void *dst, int n)                          \
+{                                                                            \
+   const __m128i *s = src;                                                   \
+   float *d = dst;                                                           \
+   const __m128i zero = _mm_setzero_si128();                                 \
+   const __m128 scale = _mm_set1_ps(255.0f);                                 \
+   int i;                                                                    \
+                                                                             \
+   for (i = 0; i < n; i += 4) {                                              \
+      __m128i v = _mm_loadu_si128(s++);                                      \
+      __m128i lo = _mm_unpacklo_epi8(v, zero);                               \
+      __m128i hi = _mm_unpackhi_epi8(v, zero);                               \
+      __m128i p0 = _mm_shuffle_epi32(_mm_unpacklo_epi16(lo, zero), shuf);    \
+      __m128i p1 = _mm_shuffle_epi32(_mm_unpackhi_epi16(lo, zero), shuf);    \
+      __m128i p2 = _mm_shuffle_epi32(_mm_unpacklo_epi16(hi, zero), shuf);    \
+      __m128i p3 = _mm_shuffle_epi32(_mm_unpackhi_epi16(hi, zero), shuf);    \
+      _mm_storeu_ps(d + 0, _mm_div_ps(_mm_cvtepi32_ps(p0), scale));          \
+      _mm_storeu_ps(d + 4, _mm_div_ps(_mm_cvtepi32_ps(p1), scale));          \
+      _mm_storeu_ps(d + 8, _mm_div_ps(_mm_cvtepi32_ps(p2), scale));          \
+      _mm_storeu_ps(d + 12, _mm_div_ps(_mm_cvtepi32_ps(p3), scale));         \
+      d += 16;                                                               \
+   }                                                                         \
+}
+
+DEFINE_TO_F32(argb_8888_to_abgr_f32_row_sse2, _MM_SHUFFLE(3, 0, 1, 2))
+DEFINE_TO_F32(abgr_8888_to_abgr_f32_row_sse2, _MM_SHUFFLE(3, 2, 1, 0))
+
+/* ABGR_F32 -> 32 bit. Truncates like the generated converters but
+ * saturates out-of-range components instead of letting them spill into
+ * the neighbouring channels.
+ */
+#define DEFINE_FROM_F32(name, shuf)                                          \
+TARGET("sse2")                                                               \
+static void name(const void *src, void *dst, int n)                          \
+{                                                                            \
+   const float *s = src;                                                     \
+   __m128i *d = dst;                                                         \
+   const __m128 scale = _mm_set1_ps(255.0f);                                 \
+   int i;                                                                    \
+                                                                             \
+   for (i = 0; i < n; i += 4) {                                              \
+      __m128i p0 = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(s + 0), scale)); \
+      __m128i p1 = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(s + 4), scale)); \
+      __m128i p2 = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(s + 8), scale)); \
+      __m128i p3 = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(s + 12), scale)); \
+      p0 = _mm_shuffle_epi32(p0, shuf);                                      \
+      p1 = _mm_shuffle_epi32(p1, shuf);                                      \
+      p2 = _mm_shuffle_epi32(p2, shuf);                                      \
+      p3 = _mm_shuffle_epi32(p3, shuf);                                      \
+      _mm_storeu_si128(d++, _mm_packus_epi16(                                \
+         _mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3)));                 \
+      s += 16;                                                               \
+   }                                                                         \
+}
+
+DEFINE_FROM_F32(abgr_f32_to_argb_8888_row_sse2, _MM_SHUFFLE(3, 0, 1, 2))
+DEFINE_FROM_F32(abgr_f32_to_abgr_8888_row_sse2, _MM_SHUFFLE(3, 2, 1, 0))
+
+/* 32 bit -> 24 bit. 16 pixels are packed into three full vectors so we
+ * never write past the end of the row.
+ */
+#define DEFINE_PACK_24(name, m0, m1, m2)                                     \
+TARGET("ssse3")                                                              \
+static void name(const void *src, void *dst, int n)                          \
+{                                                                            \
+   const __m128i *s = src;                                                   \
+   __m128i *d = dst;                                                         \
+   const __m128i mask = _mm_setr_epi8(                                       \
+      m0, m1, m2, m0 + 4, m1 + 4, m2 + 4, m0 + 8, m1 + 8, m2 + 8,            \
+      m0 + 12, m1 + 12, m2 + 12, -1, -1, -1, -1);                            \
+   int i;                                                                    \
+                                                                             \
+   for (i = 0; i < n; i += 16) {                                             \
+      __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(s + 0), mask);            \
+      __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(s + 1), mask);            \
+      __m128i c = _mm_shuffle_epi8(_mm_loadu_si128(s + 2), mask);            \
+      __m128i e = _mm_shuffle_epi8(_mm_loadu_si128(s + 3), mask);            \
+      _mm_storeu_si128(d + 0, _mm_or_si128(a, _mm_slli_si128(b, 12)));       \
+      _mm_storeu_si128(d + 1,                                                \
+         _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));          \
+      _mm_storeu_si128(d + 2,                                                \
+         _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(e, 4)));          \
+      s += 4;                                                                \
+      d += 3;                                                                \
+   }                                                                         \
+}
+
+DEFINE_PACK_24(argb_8888_to_rgb_888_row_ssse3, 0, 1, 2)
+DEFINE_PACK_24(argb_8888_to_bgr_888_row_ssse3, 2, 1, 0)
+DEFINE_PACK_24(abgr_8888_to_rgb_888_row_ssse3, 2, 1, 0)
+DEFINE_PACK_24(abgr_8888_to_bgr_888_row_ssse3, 0, 1, 2)
+
+/* 24 bit -> 32 bit with opaque alpha. */
+#define DEFINE_UNPACK_24(name, m0, m1, m2)                                   \
+TARGET("ssse3")                                                              \
+static void name(const void *src, void *dst, int n)                          \
+{                                                                            \
+   const __m128i *s = src;                                                   \
+   __m128i *d = dst;                                                         \
+   const __m128i mask = _mm_setr_epi8(                                       \
+      m0, m1, m2, -1, m0 + 3, m1 + 3, m2 + 3, -1,                           \
+      m0 + 6, m1 + 6, m2 + 6, -1, m0 + 9, m1 + 9, m2 + 9, -1);               \
+   const __m128i alpha = _mm_set1_epi32((int)0xff000000);                         \
+   int i;                                                                    \
+                                                                             \
+   for (i = 0; i < n; i += 16) {                                             \
+      __m128i in0 = _mm_loadu_si128(s + 0);                                  \
+      __m128i in1 = _mm_loadu_si128(s + 1);                                  \
+      __m128i in2 = _mm_loadu_si128(s + 2);                                  \
+      __m128i v0 = in0;                                                      \
+      __m128i v1 = _mm_alignr_epi8(in1, in0, 12);                            \
+      __m128i v2 = _mm_alignr_epi8(in2, in1, 8);                             \
+      __m128i v3 = _mm_srli_si128(in2, 4);                                   \
+      _mm_storeu_si128(d + 0, _mm_or_si128(_mm_shuffle_epi8(v0, mask), alpha)); \
+      _mm_storeu_si128(d + 1, _mm_or_si128(_mm_shuffle_epi8(v1, mask), alpha)); \
+      _mm_storeu_si128(d + 2, _mm_or_si128(_mm_shuffle_epi8(v2, mask), alpha)); \
+      _mm_storeu_si128(d + 3, _mm_or_si128(_mm_shuffle_epi8(v3, mask), alpha)); \
+      s += 3;                                                                \
+      d += 4;                                                                \
+   }                                                                         \
+}
+
+DEFINE_UNPACK_24(rgb_888_to_argb_8888_row_ssse3, 0, 1, 2)
+DEFINE_UNPACK_24(bgr_888_to_argb_8888_row_ssse3, 2, 1, 0)
+DEFINE_UNPACK_24(rgb_888_to_abgr_8888_row_ssse3, 2, 1, 0)
+DEFINE_UNPACK_24(bgr_888_to_abgr_8888_row_ssse3, 0, 1, 2)
+
+#define ARGB ALLEGRO_PIXEL_FORMAT_ARGB_8888
+#define ABGR ALLEGRO_PIXEL_FORMAT_ABGR_8888
+
+DEFINE_CONVERTER(argb_8888_to_abgr_8888_sse2, swap_rb_sse2, ARGB, ABGR, 4, 4, 4)
+DEFINE_CONVERTER(abgr_8888_to_argb_8888_sse2, swap_rb_sse2, ABGR, ARGB, 4, 4, 4)
+DEFINE_CONVERTER(argb_8888_to_abgr_8888_ssse3, swap_rb_ssse3, ARGB, ABGR, 4, 4, 4)
+DEFINE_CONVERTER(abgr_8888_to_argb_8888_ssse3, swap_rb_ssse3, ABGR, ARGB, 4, 4, 4)
+DEFINE_CONVERTER(argb_8888_to_abgr_8888_avx2, swap_rb_avx2, ARGB, ABGR, 4, 4, 8)
+DEFINE_CONVERTER(abgr_8888_to_argb_8888_avx2, swap_rb_avx2, ABGR, ARGB, 4, 4, 8)
+
+DEFINE_CONVERTER(argb_8888_to_rgb_565_sse2, argb_8888_to_rgb_565_row_sse2,
+   ARGB, ALLEGRO_PIXEL_FORMAT_RGB_565, 4, 2, 8)
+DEFINE_CONVERTER(abgr_8888_to_rgb_565_sse2, abgr_8888_to_rgb_565_row_sse2,
+   ABGR, ALLEGRO_PIXEL_FORMAT_RGB_565, 4, 2, 8)
+DEFINE_CONVERTER(rgb_565_to_argb_8888_sse2, rgb_565_to_argb_8888_row_sse2,
+   ALLEGRO_PIXEL_FORMAT_RGB_565, ARGB, 2, 4, 8)
+DEFINE_CONVERTER(rgb_565_to_abgr_8888_sse2, rgb_565_to_abgr_8888_row_sse2,
+   ALLEGRO_PIXEL_FORMAT_RGB_565, ABGR, 2, 4, 8)
+
+DEFINE_CONVERTER(argb_8888_to_abgr_f32_sse2, argb_8888_to_abgr_f32_row_sse2,
+   ARGB, ALLEGRO_PIXEL_FORMAT_ABGR_F32, 4, 16, 4)
+DEFINE_CONVERTER(abgr_8888_to_abgr_f32_sse2, abgr_8888_to_abgr_f32_row_sse2,
+   ABGR, ALLEGRO_PIXEL_FORMAT_ABGR_F32, 4, 16, 4)
+DEFINE_CONVERTER(abgr_f32_to_argb_8888_sse2, abgr_f32_to_argb_8888_row_sse2,
+   ALLEGRO_PIXEL_FORMAT_ABGR_F32, ARGB, 16, 4, 4)
+DEFINE_CONVERTER(abgr_f32_to_abgr_8888_sse2, abgr_f32_to_abgr_8888_row_sse2,
+   ALLEGRO_PIXEL_FORMAT_ABGR_F32, ABGR, 16, 4, 4)
+
+DEFINE_CONVERTER(argb_8888_to_rgb_888_ssse3, argb_8888_to_rgb_888_row_ssse3,
+   ARGB, ALLEGRO_PIXEL_FORMAT_RGB_888, 4, 3, 16)
+DEFINE_CONVERTER(argb_8888_to_bgr_888_ssse3, argb_8888_to_bgr_888_row_ssse3,
+   ARGB, ALLEGRO_PIXEL_FORMAT_BGR_888, 4, 3, 16)
+DEFINE_CONVERTER(abgr_8888_to_rgb_888_ssse3, abgr_8888_to_rgb_888_row_ssse3,
+   ABGR, ALLEGRO_PIXEL_FORMAT_RGB_888, 4, 3, 16)
+DEFINE_CONVERTER(abgr_8888_to_bgr_888_ssse3, abgr_8888_to_bgr_888_row_ssse3,
+   ABGR, ALLEGRO_PIXEL_FORMAT_BGR_888, 4, 3, 16)
+DEFINE_CONVERTER(rgb_888_to_argb_8888_ssse3, rgb_888_to_argb_8888_row_ssse3,
+   ALLEGRO_PIXEL_FORMAT_RGB_888, ARGB, 3, 4, 16)
+DEFINE_CONVERTER(bgr_888_to_argb_8888_ssse3, bgr_888_to_argb_8888_row_ssse3,
+   ALLEGRO_PIXEL_FORMAT_BGR_888, ARGB, 3, 4, 16)
+DEFINE_CONVERTER(rgb_888_to_abgr_8888_ssse3, rgb_888_to_abgr_8888_row_ssse3,
+   ALLEGRO_PIXEL_FORMAT_RGB_888, ABGR, 3, 4, 16)
+DEFINE_CONVERTER(bgr_888_to_abgr_8888_ssse3, bgr_888_to_abgr_8888_row_ssse3,
+   ALLEGRO_PIXEL_FORMAT_BGR_888, ABGR, 3, 4, 16)
+
+#undef ARGB
+#undef ABGR
+
+#endif /* SIMD_X86 */
+
+
+#ifdef SIMD_NEON
+
+/* With NEON the de-interleaving loads and interleaving stores do most of
+ * the work: every channel ends up in its own register.
+ */
+
+static void swap_rb_neon(const void *src, void *dst, int n)
+{
+   const uint8_t *s = src;
+   uint8_t *d = dst;
+   int i;
+
+   for (i = 0; i < n; i += 16) {
+      uint8x16x4_t v = vld4q_u8(s);
+      uint8x16_t t = v.val[0];
+      v.val[0] = v.val[2];
+      v.val[2] = t;
+      vst4q_u8(d, v);
+      s += 64;
+      d += 64;
+   }
+}
+
+/* c0..c2 select which source channels end up in the three bytes. */
+#define DEFINE_PACK_24_NEON(name, c0, c1, c2)                                \
+static void name(const void *src, void *dst, int n)                          \
+{                                                                            \
+   const uint8_t *s = src;                                                   \
+   uint8_t *d = dst;                                                         \
+   int i;                                                                    \
+                                                                             \
+   for (i = 0; i < n; i += 16) {                                             \
+      uint8x16x4_t v = vld4q_u8(s);                                          \
+      uint8x16x3_t o;                                                        \
+      o.val[0] = v.val[c0];                                                  \
+      o.val[1] = v.val[c1];                                                  \
+      o.val[2] = v.val[c2];                                                  \
+      vst3q_u8(d, o);                                                        \
+      s += 64;                                                               \
+      d += 48;                                                               \
+   }                                                                         \
+}
+
+#define DEFINE_UNPACK_24_NEON(name, c0, c1, c2)                              \
+static void name(const void *src, void *dst, int n)                          \
+{                                                                            \
+   const uint8_t *s = src;                                                   \
+   uint8_t *d = dst;                                                         \
+   int i;                                                                    \
+                                                                             \
+   for (i = 0; i < n; i += 16) {                                             \
+      uint8x16x3_t v = vld3q_u8(s);                                          \
+      uint8x16x4_t o;                                                        \
+      o.val[0] = v.val[c0];                                                  \
+      o.val[1] = v.val[c1];                                                  \
+      o.val[2] = v.val[c2];                                                  \
+      o.val[3] = vdupq_n_u8(255);                                            \
+      vst4q_u8(d, o);                                                        \
+      s += 48;                                                               \
+      d += 64;                                                               \
+   }                                                                         \
+}
+
+DEFINE_PACK_24_NEON(argb_8888_to_rgb_888_row_neon, 0, 1, 2)
+DEFINE_PACK_24_NEON(argb_8888_to_bgr_888_row_neon, 2, 1, 0)
+DEFINE_PACK_24_NEON(abgr_8888_to_rgb_888_row_neon, 2, 1, 0)
+DEFINE_PACK_24_NEON(abgr_8888_to_bgr_888_row_neon, 0, 1, 2)
+DEFINE_UNPACK_24_NEON(rgb_888_to_argb_8888_row_neon, 0, 1, 2)
+DEFINE_UNPACK_24_NEON(bgr_888_to_argb_8888_row_neon, 2, 1, 0)
+DEFINE_UNPACK_24_NEON(rgb_888_to_abgr_8888_row_neon, 2, 1, 0)
+DEFINE_UNPACK_24_NEON(bgr_888_to_abgr_8888_row_neon, 0, 1, 2)
+
+/* r is the index of the red channel in memory: 2 for ARGB, 0 for ABGR. */
+#define DEFINE_TO_565_NEON(name, r)                                          \
+static void name(const void *src, void *dst, int n)                          \
+{                                                                            \
+   const uint8_t *s = src;                                                   \
+   uint16_t *d = dst;                                                        \
+   int i;                                                                    \
+                                                                             \
+   for (i = 0; i < n; i += 8) {                                              \
+      uint8x8x4_t v = vld4_u8(s);                                            \
+      uint16x8_t red = vshlq_n_u16(vmovl_u8(vshr_n_u8(v.val[r], 3)), 11);    \
+      uint16x8_t green = vshlq_n_u16(vmovl_u8(vshr_n_u8(v.val[1], 2)), 5);   \
+      uint16x8_t blue = vmovl_u8(vshr_n_u8(v.val[2 - r], 3));                \
+      vst1q_u16(d, vorrq_u16(vorrq_u16(red, green), blue));                  \
+      s += 32;                                                               \
+      d += 8;                                                                \
+   }                                                                         \
+}
+
+/* Same scaling as the _al_rgb_scale_5/6 tables, see the SSE2 version. */
+#define DEFINE_FROM_565_NEON(name, r)                                        \
+static void name(const void *src, void *dst, int n)                          \
+{                                                                            \
+   const uint16_t *s = src;                                                  \
+   uint8_t *d = dst;                                                         \
+   int i;                                                                    \
+                                                                             \
+   for (i = 0; i < n; i += 8) {                                              \
+      uint16x8_t v = vld1q_u16(s);                                           \
+      uint16x8_t r5 = vshrq_n_u16(v, 11);                                    \
+      uint16x8_t g6 = vandq_u16(vshrq_n_u16(v, 5), vdupq_n_u16(0x3f));       \
+      uint16x8_t b5 = vandq_u16(v, vdupq_n_u16(0x1f));                       \
+      uint32x4_t g_lo = vmull_u16(vget_low_u16(g6), vdup_n_u16(4145));       \
+      uint32x4_t g_hi = vmull_u16(vget_high_u16(g6), vdup_n_u16(4145));      \
+      uint8x8x4_t o;                                                         \
+      o.val[r] = vmovn_u16(vshrq_n_u16(vmulq_n_u16(r5, 1053), 7));           \
+      o.val[1] = vmovn_u16(vcombine_u16(                                     \
+         vshrn_n_u32(g_lo, 10), vshrn_n_u32(g_hi, 10)));                     \
+      o.val[2 - r] = vmovn_u16(vshrq_n_u16(vmulq_n_u16(b5, 1053), 7));       \
+      o.val[3] = vdup_n_u8(255);                                             \
+      vst4_u8(d, o);                                                         \
+      s += 8;                                                                \
+      d += 32;                                                               \
+   }                                                                         \
+}
+
+DEFINE_TO_565_NEON(argb_8888_to_rgb_565_row_neon, 2)
+DEFINE_TO_565_NEON(abgr_8888_to_rgb_565_row_neon, 0)
+DEFINE_FROM_565_NEON(rgb_565_to_argb_8888_row_neon, 2)
+DEFINE_FROM_565_NEON(rgb_565_to_abgr_8888_row_neon, 0)
+
+#ifdef SIMD_NEON_DIV
+
+/* Converts 8 channel values to floats in two halves. */
+#define U8_TO_F32_LO(x) \
+   vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(x)))), scale)
+#define U8_TO_F32_HI(x) \
+   vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(vmovl_u8(x)))), scale)
+
+#define DEFINE_TO_F32_NEON(name, r)                                          \
+static void name(const void *src, void *dst, int n)                          \
+{                                                                            \
+   const uint8_t *s = src;                                                   \
+   float *d = dst;                                                           \
+   const float32x4_t scale = vdupq_n_f32(255.0f);                            \
+   int i;                                                                    \
+                                                                             \
+   for (i = 0; i < n; i += 8) {                                              \
+      uint8x8x4_t v = vld4_u8(s);                                            \
+      float32x4x4_t lo, hi;                                                  \
+      lo.val[0] = U8_TO_F32_LO(v.val[r]);                                    \
+      lo.val[1] = U8_TO_F32_LO(v.val[1]);                                    \
+      lo.val[2] = U8_TO_F32_LO(v.val[2 - r]);                                \
+      lo.val[3] = U8_TO_F32_LO(v.val[3]);                                    \
+      hi.val[0] = U8_TO_F32_HI(v.val[r]);                                    \
+      hi.val[1] = U8_TO_F32_HI(v.val[1]);                                    \
+      hi.val[2] = U8_TO_F32_HI(v.val[2 - r]);                                \
+      hi.val[3] = U8_TO_F32_HI(v.val[3]);                                    \
+      vst4q_f32(d, lo);                                                      \
+      vst4q_f32(d + 16, hi);                                                 \
+      s += 32;                                                               \
+      d += 32;                                                               \
+   }                                                                         \
+}
+
+/* Truncates like the generated converters, saturating out-of-range input. */
+#define F32_TO_U8(lo, hi) \
+   vqmovn_u16(vcombine_u16( \
+      vqmovn_u32(vcvtq_u32_f32(vmulq_f32(lo, scale))), \
+      vqmovn_u32(vcvtq_u32_f32(vmulq_f32(hi, scale)))))
+
+#define DEFINE_FROM_F32_NEON(name, r)                                        \
+static void name(const void *src, void *dst, int n)                          \
+{                                                                            \
+   const float *s = src;                                                     \
+   uint8_t *d = dst;                                                         \
+   const float32x4_t scale = vdupq_n_f32(255.0f);                            \
+   int i;                                                                    \
+                                                                             \
+   for (i = 0; i < n; i += 8) {                                              \
+      float32x4x4_t lo = vld4q_f32(s);                                       \
+      float32x4x4_t hi = vld4q_f32(s + 16);                                  \
+      uint8x8x4_t o;                                                         \
+      o.val[r] = F32_TO_U8(lo.val[0], hi.val[0]);                            \
+      o.val[1] = F32_TO_U8(lo.val[1], hi.val[1]);                            \
+      o.val[2 - r] = F32_TO_U8(lo.val[2], hi.val[2]);                        \
+      o.val[3] = F32_TO_U8(lo.val[3], hi.val[3]);                            \
+      vst4_u8(d, o);                                                         \
+      s += 32;                                                               \
+      d += 32;                                                               \
+   }                                                                         \
+}
+
+DEFINE_TO_F32_NEON(argb_8888_to_abgr_f32_row_neon, 2)
+DEFINE_TO_F32_NEON(abgr_8888_to_abgr_f32_row_neon, 0)
+DEFINE_FROM_F32_NEON(abgr_f32_to_argb_8888_row_neon, 2)
+DEFINE_FROM_F32_NEON(abgr_f32_to_abgr_8888_row_neon, 0)
+
+#endif /* SIMD_NEON_DIV */
+
+#define ARGB ALLEGRO_PIXEL_FORMAT_ARGB_8888
+#define ABGR ALLEGRO_PIXEL_FORMAT_ABGR_8888
+
+DEFINE_CONVERTER(argb_8888_to_abgr_8888_neon, swap_rb_neon, ARGB, ABGR, 4, 4, 16)
+DEFINE_CONVERTER(abgr_8888_to_argb_8888_neon, swap_rb_neon, ABGR, ARGB, 4, 4, 16)
+
+DEFINE_CONVERTER(argb_8888_to_rgb_565_neon, argb_8888_to_rgb_565_row_neon,
+   ARGB, ALLEGRO_PIXEL_FORMAT_RGB_565, 4, 2, 8)
+DEFINE_CONVERTER(abgr_8888_to_rgb_565_neon, abgr_8888_to_rgb_565_row_neon,
+   ABGR, ALLEGRO_PIXEL_FORMAT_RGB_565, 4, 2, 8)
+DEFINE_CONVERTER(rgb_565_to_argb_8888_neon, rgb_565_to_argb_8888_row_neon,
+   ALLEGRO_PIXEL_FORMAT_RGB_565, ARGB, 2, 4, 8)
+DEFINE_CONVERTER(rgb_565_to_abgr_8888_neon, rgb_565_to_abgr_8888_row_neon,
+   ALLEGRO_PIXEL_FORMAT_RGB_565, ABGR, 2, 4, 8)
+
+DEFINE_CONVERTER(argb_8888_to_rgb_888_neon, argb_8888_to_rgb_888_row_neon,
+   ARGB, ALLEGRO_PIXEL_FORMAT_RGB_888, 4, 3, 16)
+DEFINE_CONVERTER(argb_8888_to_bgr_888_neon, argb_8888_to_bgr_888_row_neon,
+   ARGB, ALLEGRO_PIXEL_FORMAT_BGR_888, 4, 3, 16)
+DEFINE_CONVERTER(abgr_8888_to_rgb_888_neon, abgr_8888_to_rgb_888_row_neon,
+   ABGR, ALLEGRO_PIXEL_FORMAT_RGB_888, 4, 3, 16)
+DEFINE_CONVERTER(abgr_8888_to_bgr_888_neon, abgr_8888_to_bgr_888_row_neon,
+   ABGR, ALLEGRO_PIXEL_FORMAT_BGR_888, 4, 3, 16)
+DEFINE_CONVERTER(rgb_888_to_argb_8888_neon, rgb_888_to_argb_8888_row_neon,
+   ALLEGRO_PIXEL_FORMAT_RGB_888, ARGB, 3, 4, 16)
+DEFINE_CONVERTER(bgr_888_to_argb_8888_neon, bgr_888_to_argb_8888_row_neon,
+   ALLEGRO_PIXEL_FORMAT_BGR_888, ARGB, 3, 4, 16)
+DEFINE_CONVERTER(rgb_888_to_abgr_8888_neon, rgb_888_to_abgr_8888_row_neon,
+   ALLEGRO_PIXEL_FORMAT_RGB_888, ABGR, 3, 4, 16)
+DEFINE_CONVERTER(bgr_888_to_abgr_8888_neon, bgr_888_to_abgr_8888_row_neon,
+   ALLEGRO_PIXEL_FORMAT_BGR_888, ABGR, 3, 4, 16)
+
+#ifdef SIMD_NEON_DIV
+DEFINE_CONVERTER(argb_8888_to_abgr_f32_neon, argb_8888_to_abgr_f32_row_neon,
+   ARGB, ALLEGRO_PIXEL_FORMAT_ABGR_F32, 4, 16, 8)
+DEFINE_CONVERTER(abgr_8888_to_abgr_f32_neon, abgr_8888_to_abgr_f32_row_neon,
+   ABGR, ALLEGRO_PIXEL_FORMAT_ABGR_F32, 4, 16, 8)
+DEFINE_CONVERTER(abgr_f32_to_argb_8888_neon, abgr_f32_to_argb_8888_row_neon,
+   ALLEGRO_PIXEL_FORMAT_ABGR_F32, ARGB, 16, 4, 8)
+DEFINE_CONVERTER(abgr_f32_to_abgr_8888_neon, abgr_f32_to_abgr_8888_row_neon,
+   ALLEGRO_PIXEL_FORMAT_ABGR_F32, ABGR, 16, 4, 8)
+#endif
+
+#undef ARGB
+#undef ABGR
+
+#endif /* SIMD_NEON */
+
+
+/* Premultiplying alpha in place, as the image loaders do: every color
+ * channel x becomes x * a / 255, truncated. (v + 1 + (v >> 8)) >> 8 is
+ * exactly v / 255 for all v up to 255 * 255.
+ */
+#define DIV_255(v) (((v) + 1 + ((v) >> 8)) >> 8)
+
+/* For four 8 bit channels, `alpha' is the byte index of the alpha channel. */
+static void premultiply_row_8888(void *data, int alpha, int n)
+{
+   uint8_t *p = data;
+   int i;
+
+   for (i = 0; i < n; i++, p += 4) {
+      int a = p[alpha];
+      if (a == 255)
+         continue;
+      p[(alpha + 1) & 3] = DIV_255(p[(alpha + 1) & 3] * a);
+      p[(alpha + 2) & 3] = DIV_255(p[(alpha + 2) & 3] * a);
+      p[(alpha + 3) & 3] = DIV_255(p[(alpha + 3) & 3] * a);
+   }
+}
+
+#ifdef SIMD_X86
+
+/* Alpha in byte 3, 4 pixels at a time. */
+TARGET("sse2")
+static void premultiply_row_sse2(void *data, int n)
+{
+   __m128i *p = data;
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i one = _mm_set1_epi16(1);
+   const __m128i alpha_mask = _mm_set1_epi32((int)0xff000000);
+   int i;
+
+   for (i = 0; i < n; i += 4, p++) {
+      __m128i v = _mm_loadu_si128(p);
+      __m128i lo = _mm_unpacklo_epi8(v, zero);
+      __m128i hi = _mm_unpackhi_epi8(v, zero);
+      __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff);
+      __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff);
+      lo = _mm_mullo_epi16(lo, a_lo);
+      hi = _mm_mullo_epi16(hi, a_hi);
+      lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, one),
+         _mm_srli_epi16(lo, 8)), 8);
+      hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, one),
+         _mm_srli_epi16(hi, 8)), 8);
+      /* Alpha itself is kept. */
+      _mm_storeu_si128(p, _mm_or_si128(
+         _mm_andnot_si128(alpha_mask, _mm_packus_epi16(lo, hi)),
+         _mm_and_si128(v, alpha_mask)));
+   }
+}
+
+#endif /* SIMD_X86 */
+
+#ifdef SIMD_NEON
+
+/* Alpha in byte 3, 8 pixels at a time. */
+static void premultiply_row_neon(void *data, int n)
+{
+   uint8_t *p = data;
+   const uint16x8_t one = vdupq_n_u16(1);
+   int i, c;
+
+   for (i = 0; i < n; i += 8, p += 32) {
+      uint8x8x4_t v = vld4_u8(p);
+      for (c = 0; c < 3; c++) {
+         uint16x8_t x = vmull_u8(v.val[c], v.val[3]);
+         x = vaddq_u16(vaddq_u16(x, one), vshrq_n_u16(x, 8));
+         v.val[c] = vshrn_n_u16(x, 8);
+      }
+      vst4_u8(p, v);
+   }
+}
+
+#endif /* SIMD_NEON */
+
+/* The vectorized row function for alpha in byte 3, and how many pixels it
+ * handles at once.
+ */
+static void (*premultiply_row_simd)(void *data, int n);
+static int premultiply_block;
+
+
+/* Returns the byte index of the alpha channel for formats with four 8 bit
+ * channels, or -1.
+ */
+static int alpha_byte_8888(int format)
+{
+   switch (format) {
+      case ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE:
+         return 3;
+      case ALLEGRO_PIXEL_FORMAT_ARGB_8888:
+      case ALLEGRO_PIXEL_FORMAT_ABGR_8888:
+      case ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB:
+      case ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB:
+#ifdef ALLEGRO_BIG_ENDIAN
+         return 0;
+#else
+         return 3;
+#endif
+      case ALLEGRO_PIXEL_FORMAT_RGBA_8888:
+#ifdef ALLEGRO_BIG_ENDIAN
+         return 3;
+#else
+         return 0;
+#endif
+      default:
+         return -1;
+   }
+}
+
+
+/* Internal function: _al_premultiply_alpha
+ *
+ * Multiplies the color channels of width x height pixels starting at data
+ * with their alpha, in place. Straight rows can be handed over as they are
+ * read and premultiplied in one pass. Formats with four 8 bit channels are
+ * vectorized, others go through ALLEGRO_COLOR.
+ */
+void _al_premultiply_alpha(void *data, int format, int pitch,
+   int width, int height)
+{
+   int alpha = alpha_byte_8888(format);
+   int x, y;
+
+   ASSERT(_al_pixel_format_is_real(format));
+   ASSERT(!_al_pixel_format_is_compressed(format));
+
+   if (!_al_pixel_format_has_alpha(format))
+      return;
+
+   if (alpha >= 0) {
+      int vec_width = 0;
+      if (alpha == 3 && premultiply_row_simd)
+         vec_width = width - width % premultiply_block;
+      for (y = 0; y < height; y++) {
+         char *row = (char *)data + y * pitch;
+         if (vec_width > 0)
+            premultiply_row_simd(row, vec_width);
+         premultiply_row_8888(row + vec_width * 4, alpha, width - vec_width);
+      }
+      return;
+   }
+
+   for (y = 0; y < height; y++) {
+      char *p = (char *)data + y * pitch;
+      for (x = 0; x < width; x++) {
+         ALLEGRO_COLOR color;
+         char *q = p;
+         _AL_INLINE_GET_PIXEL(format, q, color, false);
+         color.r *= color.a;
+         color.g *= color.a;
+         color.b *= color.a;
+         _AL_INLINE_PUT_PIXEL(format, p, color, true);
+      }
+   }
+}
+
+
+/* Internal function: _al_unpremultiply_alpha
+ *
+ * The inverse of _al_premultiply_alpha, rounding to nearest. Fully
+ * transparent pixels become black.
+ */
+void _al_unpremultiply_alpha(void *data, int format, int pitch,
+   int width, int height)
+{
+   int alpha = alpha_byte_8888(format);
+   int x, y;
+
+   ASSERT(_al_pixel_format_is_real(format));
+   ASSERT(!_al_pixel_format_is_compressed(format));
+
+   if (!_al_pixel_format_has_alpha(format))
+      return;
+
+   for (y = 0; y < height; y++) {
+      char *p = (char *)data + y * pitch;
+
+      if (alpha >= 0) {
+         uint8_t *q = (uint8_t *)p;
+         for (x = 0; x < width; x++, q += 4) {
+            int a = q[alpha];
+            int c;
+            if (a == 255)
+               continue;
+            for (c = 1; c < 4; c++) {
+               int i = (alpha + c) & 3;
+               q[i] = a ? _ALLEGRO_MIN(255, (q[i] * 255 + a / 2) / a) : 0;
+            }
+         }
+         continue;
+      }
+
+      for (x = 0; x < width; x++) {
+         ALLEGRO_COLOR color;
+         char *q = p;
+         _AL_INLINE_GET_PIXEL(format, q, color, false);
+         if (color.a > 0) {
+            color.r = _ALLEGRO_MIN(1.0f, color.r / color.a);
+            color.g = _ALLEGRO_MIN(1.0f, color.g / color.a);
+            color.b = _ALLEGRO_MIN(1.0f, color.b / color.a);
+         }
+         else {
+            color.r = color.g = color.b = 0;
+         }
+         _AL_INLINE_PUT_PIXEL(format, p, color, true);
+      }
+   }
+}
+
+
+#define SET(src, dst, func) \
+   _al_convert_funcs[ALLEGRO_PIXEL_FORMAT_##src][ALLEGRO_PIXEL_FORMAT_##dst] = func
+
+
+/* Internal function: _al_init_convert_simd
+ *
+ * Installs the best available converters into _al_convert_funcs. May be
+ * called repeatedly, the generated converters are only saved once.
+ */
+void _al_init_convert_simd(void)
+{
+   int features = al_get_cpu_features();
+
+   if (!scalar_funcs_saved) {
+      memcpy(scalar_funcs, _al_convert_funcs, sizeof(scalar_funcs));
+      scalar_funcs_saved = true;
+   }
+   else {
+      memcpy(_al_convert_funcs, scalar_funcs, sizeof(scalar_funcs));
+   }
+
+   premultiply_row_simd = NULL;
+   premultiply_block = 1;
+
+#ifdef SIMD_X86
+   if (features & ALLEGRO_CPU_SSE2) {
+      premultiply_row_simd = premultiply_row_sse2;
+      premultiply_block = 4;
+      SET(ARGB_8888, ABGR_8888, argb_8888_to_abgr_8888_sse2);
+      SET(ABGR_8888, ARGB_8888, abgr_8888_to_argb_8888_sse2);
+      SET(ARGB_8888, RGB_565, argb_8888_to_rgb_565_sse2);
+      SET(ABGR_8888, RGB_565, abgr_8888_to_rgb_565_sse2);
+      SET(RGB_565, ARGB_8888, rgb_565_to_argb_8888_sse2);
+      SET(RGB_565, ABGR_8888, rgb_565_to_abgr_8888_sse2);
+      SET(ARGB_8888, ABGR_F32, argb_8888_to_abgr_f32_sse2);
+      SET(ABGR_8888, ABGR_F32, abgr_8888_to_abgr_f32_sse2);
+      SET(ABGR_F32, ARGB_8888, abgr_f32_to_argb_8888_sse2);
+      SET(ABGR_F32, ABGR_8888, abgr_f32_to_abgr_8888_sse2);
+   }
+   if (features & ALLEGRO_CPU_SSSE3) {
+      SET(ARGB_8888, ABGR_8888, argb_8888_to_abgr_8888_ssse3);
+      SET(ABGR_8888, ARGB_8888, abgr_8888_to_argb_8888_ssse3);
+      SET(ARGB_8888, RGB_888, argb_8888_to_rgb_888_ssse3);
+      SET(ARGB_8888, BGR_888, argb_8888_to_bgr_888_ssse3);
+      SET(ABGR_8888, RGB_888, abgr_8888_to_rgb_888_ssse3);
+      SET(ABGR_8888, BGR_888, abgr_8888_to_bgr_888_ssse3);
+      SET(RGB_888, ARGB_8888, rgb_888_to_argb_8888_ssse3);
+      SET(BGR_888, ARGB_8888, bgr_888_to_argb_8888_ssse3);
+      SET(RGB_888, ABGR_8888, rgb_888_to_abgr_8888_ssse3);
+      SET(BGR_888, ABGR_8888, bgr_888_to_abgr_8888_ssse3);
+   }
+   if (features & ALLEGRO_CPU_AVX2) {
+      SET(ARGB_8888, ABGR_8888, argb_8888_to_abgr_8888_avx2);
+      SET(ABGR_8888, ARGB_8888, abgr_8888_to_argb_8888_avx2);
+   }
+#endif
+
+#ifdef SIMD_NEON
+   if (features & ALLEGRO_CPU_NEON) {
+      premultiply_row_simd = premultiply_row_neon;
+      premultiply_block = 8;
+      SET(ARGB_8888, ABGR_8888, argb_8888_to_abgr_8888_neon);
+      SET(ABGR_8888, ARGB_8888, abgr_8888_to_argb_8888_neon);
+      SET(ARGB_8888, RGB_565, argb_8888_to_rgb_565_neon);
+      SET(ABGR_8888, RGB_565, abgr_8888_to_rgb_565_neon);
+      SET(RGB_565, ARGB_8888, rgb_565_to_argb_8888_neon);
+      SET(RGB_565, ABGR_8888, rgb_565_to_abgr_8888_neon);
+      SET(ARGB_8888, RGB_888, argb_8888_to_rgb_888_neon);
+      SET(ARGB_8888, BGR_888, argb_8888_to_bgr_888_neon);
+      SET(ABGR_8888, RGB_888, abgr_8888_to_rgb_888_neon);
+      SET(ABGR_8888, BGR_888, abgr_8888_to_bgr_888_neon);
+      SET(RGB_888, ARGB_8888, rgb_888_to_argb_8888_neon);
+      SET(BGR_888, ARGB_8888, bgr_888_to_argb_8888_neon);
+      SET(RGB_888, ABGR_8888, rgb_888_to_abgr_8888_neon);
+      SET(BGR_888, ABGR_8888, bgr_888_to_abgr_8888_neon);
+#ifdef SIMD_NEON_DIV
+      SET(ARGB_8888, ABGR_F32, argb_8888_to_abgr_f32_neon);
+      SET(ABGR_8888, ABGR_F32, abgr_8888_to_abgr_f32_neon);
+      SET(ABGR_F32, ARGB_8888, abgr_f32_to_argb_8888_neon);
+      SET(ABGR_F32, ABGR_8888, abgr_f32_to_abgr_8888_neon);
+#endif
+   }
+#endif
+
+   (void)features;
+}
+
+/* vim: set ts=8 sts=3 sw=3 et: */
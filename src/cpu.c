@@ -18,6 +18,7 @@
 #include "allegro5/allegro.h"
 #include "allegro5/cpu.h"
 #include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_cpu.h"
 
 /* 
 * The CPU and pysical memory detection functions below use 
@@ -39,11 +40,22 @@
 
 #ifdef ALLEGRO_WINDOWS
 #ifndef WINVER
-#define WINVER 0x0500
+#define WINVER 0x0501
 #endif
 #include <windows.h>
 #endif
 
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+   #define CPU_X86
+   #if defined(_MSC_VER)
+      #include <intrin.h>
+   #elif defined(__GNUC__)
+      #include <cpuid.h>
+   #else
+      #undef CPU_X86
+   #endif
+#endif
+
 
 /* Function: al_get_cpu_count
  */
@@ -107,5 +119,256 @@ int al_get_ram_size(void)
 }
 
 
+#ifdef CPU_X86
+static void cpuid(int leaf, int subleaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+   int r[4];
+   __cpuidex(r, leaf, subleaf);
+   regs[0] = r[0];
+   regs[1] = r[1];
+   regs[2] = r[2];
+   regs[3] = r[3];
+#else
+   __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/* Returns the XCR0 register, i.e. the register state the OS saves on context
+ * switches. Only valid if CPUID reports OSXSAVE.
+ */
+static uint64_t read_xcr0(void)
+{
+#if defined(_MSC_VER)
+   return _xgetbv(0);
+#else
+   unsigned int eax, edx;
+   __asm__ volatile (".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx) : "c" (0));
+   return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static int detect_cpu_features(void)
+{
+   unsigned int regs[4];
+   unsigned int max_leaf;
+   unsigned int ecx1;
+   int features = 0;
+
+   cpuid(0, 0, regs);
+   max_leaf = regs[0];
+   if (max_leaf < 1)
+      return 0;
+
+   cpuid(1, 0, regs);
+   ecx1 = regs[2];
+   if (regs[3] & (1 << 26))
+      features |= ALLEGRO_CPU_SSE2;
+   if (ecx1 & (1 << 9))
+      features |= ALLEGRO_CPU_SSSE3;
+   if (ecx1 & (1 << 19))
+      features |= ALLEGRO_CPU_SSE41;
+
+   /* AVX and everything built on it additionally need the OS to preserve
+    * the YMM registers, AVX-512 also the opmask and ZMM registers.
+    */
+   if ((ecx1 & (1 << 27)) && (ecx1 & (1 << 28))) {
+      uint64_t xcr0 = read_xcr0();
+
+      if ((xcr0 & 0x6) == 0x6) {
+         if (ecx1 & (1 << 12))
+            features |= ALLEGRO_CPU_FMA;
+
+         if (max_leaf >= 7) {
+            cpuid(7, 0, regs);
+            if (regs[1] & (1 << 5))
+               features |= ALLEGRO_CPU_AVX2;
+            if ((regs[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6)
+               features |= ALLEGRO_CPU_AVX512F;
+         }
+      }
+   }
+
+   return features;
+}
+
+/* Fills in the cache line size and the L1 data, L2 and L3 cache sizes from
+ * CPUID, where the CPU reports them.
+ */
+static void cpuid_cache_info(int *line_size, int sizes[3])
+{
+   unsigned int regs[4];
+   unsigned int max_leaf;
+   unsigned int max_ext_leaf;
+   int i;
+
+   cpuid(0, 0, regs);
+   max_leaf = regs[0];
+
+   /* Intel: deterministic cache parameters. */
+   if (max_leaf >= 4) {
+      for (i = 0; i < 16; i++) {
+         int type, level, line, size;
+
+         cpuid(4, i, regs);
+         type = regs[0] & 0x1f;
+         if (type == 0)
+            break;
+         /* Skip instruction caches. */
+         if (type == 2)
+            continue;
+         level = (regs[0] >> 5) & 0x7;
+         line = (regs[1] & 0xfff) + 1;
+         size = (((regs[1] >> 22) & 0x3ff) + 1) *
+            (((regs[1] >> 12) & 0x3ff) + 1) * line * (regs[2] + 1);
+         if (level == 1 && *line_size <= 0)
+            *line_size = line;
+         if (level >= 1 && level <= 3 && sizes[level - 1] <= 0)
+            sizes[level - 1] = size;
+      }
+   }
+
+   /* AMD: the extended leaves, leaf 4 returns nothing there. */
+   cpuid(0x80000000, 0, regs);
+   max_ext_leaf = regs[0];
+   if (max_ext_leaf >= 0x80000005) {
+      cpuid(0x80000005, 0, regs);
+      if (*line_size <= 0)
+         *line_size = regs[2] & 0xff;
+      if (sizes[0] <= 0)
+         sizes[0] = (regs[2] >> 24) * 1024;
+   }
+   if (max_ext_leaf >= 0x80000006) {
+      cpuid(0x80000006, 0, regs);
+      if (sizes[1] <= 0)
+         sizes[1] = (regs[2] >> 16) * 1024;
+      if (sizes[2] <= 0)
+         sizes[2] = (regs[3] >> 18) * 512 * 1024;
+   }
+}
+#else
+static int detect_cpu_features(void)
+{
+#if defined(__aarch64__) || defined(_M_ARM64)
+   /* NEON and the fused multiply-add instructions are mandatory on AArch64. */
+   return ALLEGRO_CPU_NEON | ALLEGRO_CPU_FMA;
+#elif defined(__ARM_NEON)
+   /* On 32-bit ARM we only get here if the compiler was told it may use NEON
+    * anyway.
+    */
+   return ALLEGRO_CPU_NEON;
+#else
+   return 0;
+#endif
+}
+#endif
+
+/* Function: al_get_cpu_features
+ */
+int al_get_cpu_features(void)
+{
+   /* The detection is cheap but the result is cached anyway as this is
+    * queried from dispatch code.
+    */
+   static int features = -1;
+
+   if (features < 0)
+      features = detect_cpu_features();
+   return features;
+}
+
+
+/* Index 0 is the cache line size, 1 to 3 are the L1 data, L2 and L3 cache
+ * sizes in bytes. A value <= 0 means unknown.
+ */
+static int cache_info[4];
+static bool cache_info_done = false;
+
+static void detect_cache_info(void)
+{
+   int i;
+
+#if defined(ALLEGRO_HAVE_SYSCONF) && defined(_SC_LEVEL1_DCACHE_LINESIZE)
+   cache_info[0] = (int)sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+   cache_info[1] = (int)sysconf(_SC_LEVEL1_DCACHE_SIZE);
+   cache_info[2] = (int)sysconf(_SC_LEVEL2_CACHE_SIZE);
+   cache_info[3] = (int)sysconf(_SC_LEVEL3_CACHE_SIZE);
+#elif defined(ALLEGRO_HAVE_SYSCTL) && defined(__APPLE__)
+   {
+      static const char *names[4] = {
+         "hw.cachelinesize", "hw.l1dcachesize", "hw.l2cachesize",
+         "hw.l3cachesize"
+      };
+      for (i = 0; i < 4; i++) {
+         int64_t value = 0;
+         size_t len = sizeof(value);
+         if (sysctlbyname(names[i], &value, &len, NULL, 0) == 0)
+            cache_info[i] = (int)value;
+      }
+   }
+#elif defined(ALLEGRO_WINDOWS)
+   {
+      SYSTEM_LOGICAL_PROCESSOR_INFORMATION *info = NULL;
+      DWORD len = 0;
+      DWORD n;
+
+      if (!GetLogicalProcessorInformation(NULL, &len) &&
+            GetLastError() == ERROR_INSUFFICIENT_BUFFER) {
+         info = al_malloc(len);
+      }
+      if (info && GetLogicalProcessorInformation(info, &len)) {
+         for (n = 0; n < len / sizeof(*info); n++) {
+            CACHE_DESCRIPTOR *cache = &info[n].Cache;
+            if (info[n].Relationship != RelationCache)
+               continue;
+            if (cache->Type == CacheInstruction || cache->Level < 1 ||
+                  cache->Level > 3)
+               continue;
+            if (cache->Level == 1 && cache_info[0] <= 0)
+               cache_info[0] = cache->LineSize;
+            if (cache_info[cache->Level] <= 0)
+               cache_info[cache->Level] = cache->Size;
+         }
+      }
+      al_free(info);
+   }
+#endif
+
+#ifdef CPU_X86
+   /* Fill in whatever the OS didn't tell us. */
+   if (cache_info[0] <= 0 || cache_info[1] <= 0 || cache_info[2] <= 0 ||
+         cache_info[3] <= 0) {
+      cpuid_cache_info(&cache_info[0], cache_info + 1);
+   }
+#endif
+
+   for (i = 0; i < 4; i++) {
+      if (cache_info[i] <= 0)
+         cache_info[i] = -1;
+   }
+   cache_info_done = true;
+}
+
+/* Function: al_get_cpu_cache_line_size
+ */
+int al_get_cpu_cache_line_size(void)
+{
+   if (!cache_info_done)
+      detect_cache_info();
+   return cache_info[0];
+}
+
+/* Function: al_get_cpu_cache_size
+ */
+int al_get_cpu_cache_size(int level)
+{
+   if (level < 1 || level > 3)
+      return -1;
+   if (!cache_info_done)
+      detect_cache_info();
+   return cache_info[level];
+}
+
+
 /* vi: set ts=4 sw=4 expandtab: */
       
@@ -15,8 +15,10 @@
 
 
 #include <stdio.h>
+#include <string.h>
 
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_debug.h"
 #include "allegro5/internal/aintern_thread.h"
 #include "allegro5/internal/aintern_vector.h"
@@ -64,6 +66,30 @@ static TRACE_INFO trace_info =
 
 static char static_trace_buffer[2048];
 
+/* With "async" set in the [trace] section, messages for the trace file are
+ * queued in a ring buffer and written by a thread of their own. head and
+ * tail only grow, and are guarded by trace_mutex like the rest.
+ */
+#define TRACE_RING_SIZE (64 * 1024)
+
+typedef struct TRACE_WRITER
+{
+   bool running;
+   bool quit;
+   _AL_THREAD thread;
+   _AL_COND cond;
+   size_t head;
+   size_t tail;
+   char ring[TRACE_RING_SIZE];
+} TRACE_WRITER;
+
+static TRACE_WRITER trace_writer;
+
+/* Bumped whenever the configuration changes, so that the levels cached by
+ * ALLEGRO_DEBUG_CHANNEL are looked up again.
+ */
+int _al_trace_generation = 0;
+
 /* run-time assertions */
 void (*_al_user_assert_handler)(char const *expr, char const *file,
    int line, char const *func);
@@ -83,6 +109,96 @@ static void delete_string_list(_AL_VECTOR *v)
 }
 
 
+static void trace_writer_proc(_AL_THREAD *thread, void *arg)
+{
+   TRACE_WRITER *w = arg;
+   (void)thread;
+
+   _al_mutex_lock(&trace_info.trace_mutex);
+   for (;;) {
+      size_t start, n;
+      FILE *f;
+
+      while (w->head == w->tail && !w->quit)
+         _al_cond_wait(&w->cond, &trace_info.trace_mutex);
+      if (w->head == w->tail)
+         break;
+
+      /* Messages are only queued while there is space, so the part between
+       * tail and head is left alone while it is written.
+       */
+      start = w->tail % TRACE_RING_SIZE;
+      n = _ALLEGRO_MIN(w->head - w->tail, TRACE_RING_SIZE - start);
+      f = trace_info.trace_file;
+      _al_mutex_unlock(&trace_info.trace_mutex);
+
+      if (f) {
+         fwrite(w->ring + start, 1, n, f);
+         fflush(f);
+      }
+
+      _al_mutex_lock(&trace_info.trace_mutex);
+      w->tail += n;
+      _al_cond_broadcast(&w->cond);
+   }
+   _al_mutex_unlock(&trace_info.trace_mutex);
+}
+
+
+static void start_trace_writer(void)
+{
+   TRACE_WRITER *w = &trace_writer;
+
+   w->quit = false;
+   w->head = w->tail = 0;
+   _al_cond_init(&w->cond);
+   _al_thread_create(&w->thread, trace_writer_proc, w);
+   w->running = true;
+}
+
+
+static void stop_trace_writer(void)
+{
+   TRACE_WRITER *w = &trace_writer;
+
+   _al_mutex_lock(&trace_info.trace_mutex);
+   w->quit = true;
+   _al_cond_broadcast(&w->cond);
+   _al_mutex_unlock(&trace_info.trace_mutex);
+
+   _al_thread_join(&w->thread);
+   _al_cond_destroy(&w->cond);
+   w->running = false;
+}
+
+
+/* queue_trace:
+ *  Queue the message in static_trace_buffer for the writer thread. Called
+ *  with trace_mutex held. A message is queued as a whole, so that waiting
+ *  for space does not interleave it with others.
+ */
+static void queue_trace(void)
+{
+   TRACE_WRITER *w = &trace_writer;
+   char msg[sizeof(static_trace_buffer)];
+   size_t len = strlen(static_trace_buffer);
+   size_t start, n;
+
+   memcpy(msg, static_trace_buffer, len);
+   static_trace_buffer[0] = '\0';
+
+   while (w->head - w->tail + len > TRACE_RING_SIZE)
+      _al_cond_wait(&w->cond, &trace_info.trace_mutex);
+
+   start = w->head % TRACE_RING_SIZE;
+   n = _ALLEGRO_MIN(len, TRACE_RING_SIZE - start);
+   memcpy(w->ring + start, msg, n);
+   memcpy(w->ring, msg + n, len - n);
+   w->head += len;
+   _al_cond_broadcast(&w->cond);
+}
+
+
 void _al_configure_logging(void)
 {
    ALLEGRO_CONFIG *config;
@@ -164,7 +280,12 @@ void _al_configure_logging(void)
    if (!trace_info.configured)
       _al_mutex_init(&trace_info.trace_mutex);
 
+   v = al_get_config_value(config, "trace", "async");
+   if (v && strcmp(v, "0") && strcmp(v, "false") && !trace_writer.running)
+      start_trace_writer();
+
    trace_info.configured = true;
+   _al_trace_generation++;
 }
 
 
@@ -200,6 +321,53 @@ static void do_trace(const char *msg, ...)
 }
 
 
+static bool channel_is_logged(char const *channel)
+{
+   size_t i;
+   _AL_VECTOR const *v;
+
+   v = &trace_info.channels;
+   if (_al_vector_is_nonempty(v)) {
+      for (i = 0; i < _al_vector_size(v); i++) {
+         ALLEGRO_USTR **iter = _al_vector_ref(v, i);
+         if (!strcmp(al_cstr(*iter), channel))
+            break;
+      }
+      if (i == _al_vector_size(v))
+         return false;
+   }
+
+   v = &trace_info.excluded;
+   for (i = 0; i < _al_vector_size(v); i++) {
+      ALLEGRO_USTR **iter = _al_vector_ref(v, i);
+      if (!strcmp(al_cstr(*iter), channel))
+         return false;
+   }
+
+   return true;
+}
+
+
+/* _al_trace_cache_channel:
+ *  Returns the value cached by ALLEGRO_DEBUG_CHANNEL: the lowest level
+ *  logged on the channel, 4 for none, or'ed with the generation of the
+ *  configuration shifted left by 3.
+ */
+int _al_trace_cache_channel(char const *channel)
+{
+   int level = 4;
+
+   if (!trace_info.configured) {
+      _al_configure_logging();
+   }
+
+   if (trace_info.level < level && channel_is_logged(channel))
+      level = trace_info.level;
+
+   return (_al_trace_generation << 3) | level;
+}
+
+
 /* _al_trace_prefix:
  *  Conditionally write the initial part of a trace message.  If we do, return true
  *  and continue to hold the trace_mutex lock.
@@ -207,9 +375,7 @@ static void do_trace(const char *msg, ...)
 bool _al_trace_prefix(char const *channel, int level,
    char const *file, int line, char const *function)
 {
-   size_t i;
    char *name;
-   _AL_VECTOR const *v;
 
    if (!trace_info.configured) {
       _al_configure_logging();
@@ -218,28 +384,8 @@ bool _al_trace_prefix(char const *channel, int level,
    if (level < trace_info.level)
       return false;
 
-   v = &trace_info.channels;
-   if (_al_vector_is_empty(v))
-      goto channel_included;
-
-   for (i = 0; i < _al_vector_size(v); i++) {
-      ALLEGRO_USTR **iter = _al_vector_ref(v, i);
-      if (!strcmp(al_cstr(*iter), channel))
-         goto channel_included;
-   }
-
-   return false;
-
-channel_included:
-
-   v = &trace_info.excluded;
-   if (_al_vector_is_nonempty(v)) {
-      for (i = 0; i < _al_vector_size(v); i++) {
-         ALLEGRO_USTR **iter = _al_vector_ref(v, i);
-         if (!strcmp(al_cstr(*iter), channel))
-            return false;
-      }
-   }
+   if (!channel_is_logged(channel))
+      return false;
 
    /* Avoid interleaved output from different threads. */
    _al_mutex_lock(&trace_info.trace_mutex);
@@ -321,7 +467,10 @@ void _al_trace_suffix(const char *msg, ...)
 
    /* We're intentially still writing to a file if it's set even with the
     * additional logging options above. */
-   if (trace_info.trace_file) {
+   if (trace_info.trace_file && trace_writer.running) {
+      queue_trace();
+   }
+   else if (trace_info.trace_file) {
       fprintf(trace_info.trace_file, "%s", static_trace_buffer);
       fflush(trace_info.trace_file);
    }
@@ -335,6 +484,9 @@ void _al_trace_suffix(const char *msg, ...)
 
 void _al_shutdown_logging(void)
 {
+   if (trace_writer.running)
+      stop_trace_writer();
+
    if (trace_info.configured) {
       _al_mutex_destroy(&trace_info.trace_mutex);
 
@@ -350,6 +502,7 @@ void _al_shutdown_logging(void)
 
    trace_info.trace_file = NULL;
    trace_info.trace_virgin = true;
+   _al_trace_generation++;
 }
 
 
@@ -26,8 +26,10 @@
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_display.h"
+#include "allegro5/internal/aintern_pixels.h"
 #include "allegro5/internal/aintern_shader.h"
 #include "allegro5/internal/aintern_system.h"
+#include "allegro5/internal/aintern_tls.h"
 
 
 ALLEGRO_DEBUG_CHANNEL("display")
@@ -63,6 +65,11 @@ ALLEGRO_DISPLAY *al_create_display(int w, int h)
    if (!(flags & (1 << ALLEGRO_AUTO_CONVERT_BITMAPS))) {
       settings->settings[ALLEGRO_AUTO_CONVERT_BITMAPS] = 1;
    }
+   settings->settings[ALLEGRO_MAX_FRAME_LATENCY] =
+      al_get_new_display_option(ALLEGRO_MAX_FRAME_LATENCY, NULL);
+   /* A buffer which could encode sRGB only does so on request. */
+   if (!al_get_new_display_option(ALLEGRO_SRGB_FRAMEBUFFER, NULL))
+      settings->settings[ALLEGRO_SRGB_FRAMEBUFFER] = 0;
 
    display->min_w = 0;
    display->min_h = 0;
@@ -160,6 +167,10 @@ void al_destroy_display(ALLEGRO_DISPLAY *display)
          _al_set_current_display_only(NULL);
 #endif
 
+      _al_stop_display_vsync_events(display);
+      _al_close_clipboard(display);
+      al_destroy_draw_list(display->draw_recording);
+
       al_destroy_shader(display->default_shader);
       display->default_shader = NULL;
 
@@ -183,6 +194,28 @@ ALLEGRO_BITMAP *al_get_backbuffer(ALLEGRO_DISPLAY *display)
 
 
 
+/* With ALLEGRO_MAX_FRAME_LATENCY, wait after each flip until the GPU has
+ * caught up to within that many frames, so that the driver cannot queue up
+ * more and add to the input latency.
+ */
+static void limit_frame_latency(ALLEGRO_DISPLAY *display)
+{
+   int frames = display->extra_settings.settings[ALLEGRO_MAX_FRAME_LATENCY];
+
+   if (!display->vt->insert_frame_fence)
+      return;
+   if (frames <= 0 && !display->frame_fences)
+      return;
+
+   display->vt->insert_frame_fence(display);
+   if (frames > 0) {
+      display->vt->wait_for_frame_latency(display,
+         _ALLEGRO_MIN(frames, _AL_MAX_FRAME_LATENCY));
+   }
+}
+
+
+
 /* Function: al_flip_display
  */
 void al_flip_display(void)
@@ -191,8 +224,78 @@ void al_flip_display(void)
 
    if (display) {
       ASSERT(display->vt);
+      al_profile_begin("al_flip_display");
+      if (display->gpu_timing && display->vt->update_gpu_timer)
+         display->vt->update_gpu_timer(display);
       display->vt->flip_display(display);
+      _al_display_vsync_flipped(display);
+      display->stats.frames++;
+      limit_frame_latency(display);
+      _al_enforce_texture_budget(display);
+      al_profile_end();
+   }
+}
+
+
+
+/* Function: al_flip_display_regions
+ */
+void al_flip_display_regions(const int *rects, int num_rects)
+{
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+   int x1, y1, x2, y2;
+   int i;
+
+   ASSERT(rects || num_rects == 0);
+
+   if (!display)
+      return;
+   if (num_rects <= 0) {
+      al_flip_display();
+      return;
+   }
+
+   ASSERT(display->vt);
+   if (display->gpu_timing && display->vt->update_gpu_timer)
+      display->vt->update_gpu_timer(display);
+
+   if (display->vt->flip_display_regions) {
+      display->vt->flip_display_regions(display, rects, num_rects);
    }
+   else {
+      /* Present the bounding box of all the rectangles. */
+      x1 = rects[0];
+      y1 = rects[1];
+      x2 = rects[0] + rects[2];
+      y2 = rects[1] + rects[3];
+      for (i = 1; i < num_rects; i++) {
+         const int *r = rects + i * 4;
+         x1 = _ALLEGRO_MIN(x1, r[0]);
+         y1 = _ALLEGRO_MIN(y1, r[1]);
+         x2 = _ALLEGRO_MAX(x2, r[0] + r[2]);
+         y2 = _ALLEGRO_MAX(y2, r[1] + r[3]);
+      }
+      display->vt->update_display_region(display, x1, y1, x2 - x1, y2 - y1);
+   }
+
+   _al_display_vsync_flipped(display);
+   display->stats.frames++;
+   limit_frame_latency(display);
+   _al_enforce_texture_budget(display);
+}
+
+
+
+/* Function: al_set_display_frame_time_hint
+ */
+bool al_set_display_frame_time_hint(ALLEGRO_DISPLAY *display, double seconds)
+{
+   ASSERT(display);
+   ASSERT(seconds >= 0);
+
+   if (display->vt->set_frame_time_hint)
+      return display->vt->set_frame_time_hint(display, seconds);
+   return false;
 }
 
 
@@ -206,6 +309,7 @@ void al_update_display_region(int x, int y, int width, int height)
    if (display) {
       ASSERT(display->vt);
       display->vt->update_display_region(display, x, y, width, height);
+      _al_display_vsync_flipped(display);
    }
 }
 
@@ -340,6 +444,22 @@ bool al_wait_for_vsync(void)
 
 
 
+/* Function: al_wait_for_frame_latency
+ */
+bool al_wait_for_frame_latency(ALLEGRO_DISPLAY *display, int frames)
+{
+   ASSERT(display);
+   ASSERT(frames >= 0);
+
+   if (!display->vt->wait_for_frame_latency)
+      return false;
+
+   display->frame_fences = true;
+   return display->vt->wait_for_frame_latency(display, frames);
+}
+
+
+
 /* Function: al_set_display_icon
  */
 void al_set_display_icon(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *icon)
@@ -597,6 +717,8 @@ void al_set_render_state(ALLEGRO_RENDER_STATE state, int value)
    if (!display)
       return;
 
+   _al_tls_forget_draw_state();
+
    switch (state) {
       case ALLEGRO_ALPHA_TEST:
          display->render_state.alpha_test = value;
@@ -643,6 +765,66 @@ void al_backup_dirty_bitmaps(ALLEGRO_DISPLAY *display)
    }
 }
 
+/* Function: al_get_display_stats
+ */
+void al_get_display_stats(ALLEGRO_DISPLAY *display,
+   ALLEGRO_DISPLAY_STATS *stats)
+{
+   ASSERT(display);
+   ASSERT(stats);
+
+   display->gpu_timing = true;
+
+   stats->frames = display->stats.frames;
+   stats->draw_calls = display->stats.draw_calls;
+   stats->vertices = display->stats.vertices;
+   stats->texture_flushes = display->stats.texture_flushes;
+   stats->state_changes = display->stats.state_changes;
+   stats->target_switches = display->stats.target_switches;
+   stats->texture_uploads = display->stats.texture_uploads;
+   stats->texture_upload_bytes = display->stats.texture_upload_bytes;
+   stats->gpu_frame_time = display->stats.gpu_frame_time;
+}
+
+/* Counts an upload of w x h pixels in the given format for
+ * al_get_display_stats. Uploads from worker threads are not counted.
+ */
+void _al_count_texture_upload(ALLEGRO_DISPLAY *display, int format,
+   int w, int h)
+{
+   int64_t bytes;
+
+   if (!display || _al_get_current_upload_context())
+      return;
+
+   if (_al_pixel_format_is_compressed(format)) {
+      int bw = al_get_pixel_block_width(format);
+      int bh = al_get_pixel_block_height(format);
+      bytes = (int64_t)((w + bw - 1) / bw) * ((h + bh - 1) / bh) *
+         al_get_pixel_block_size(format);
+   }
+   else {
+      bytes = (int64_t)w * h * al_get_pixel_size(format);
+   }
+
+   display->stats.texture_uploads++;
+   display->stats.texture_upload_bytes += bytes;
+}
+
+/* Function: al_reset_display_stats
+ */
+void al_reset_display_stats(ALLEGRO_DISPLAY *display)
+{
+   double gpu_frame_time;
+
+   ASSERT(display);
+
+   /* This is a measurement rather than a counter. */
+   gpu_frame_time = display->stats.gpu_frame_time;
+   memset(&display->stats, 0, sizeof(display->stats));
+   display->stats.gpu_frame_time = gpu_frame_time;
+}
+
 /* Function: al_apply_window_constraints
  */
 void al_apply_window_constraints(ALLEGRO_DISPLAY *display, bool onoff)
@@ -524,6 +524,22 @@ int _al_score_display_settings(ALLEGRO_EXTRA_DISPLAY_SETTINGS *eds,
       }
    }
 
+   /* An sRGB capable buffer does no harm if nobody asked for one, as the
+    * encoding is only switched on by request.
+    */
+   if (ref->settings[ALLEGRO_SRGB_FRAMEBUFFER] &&
+         !eds->settings[ALLEGRO_SRGB_FRAMEBUFFER]) {
+      if (req & ((int64_t)1 << ALLEGRO_SRGB_FRAMEBUFFER)) {
+         ALLEGRO_DEBUG("sRGB framebuffer requirement not met.\n");
+         return -1;
+      }
+   }
+   else if (ref->settings[ALLEGRO_SRGB_FRAMEBUFFER]) {
+      if (sug & ((int64_t)1 << ALLEGRO_SRGB_FRAMEBUFFER)) {
+         score += 128;
+      }
+   }
+
    ALLEGRO_DEBUG("Score is : %i\n", score);
    return score;
 }
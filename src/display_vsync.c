@@ -0,0 +1,272 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Vertical blank events and redraw requests.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <math.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_display.h"
+#include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_thread.h"
+
+ALLEGRO_DEBUG_CHANNEL("display")
+
+
+#define DEFAULT_REFRESH_RATE  60
+
+
+/* A thread per display that waits for the vertical blanks and emits an
+ * event for each. Drivers which can tell when a vertical blank happens
+ * implement wait_for_vblank; otherwise the times are estimated from the
+ * refresh rate, lined up with the flips if vsync is on.
+ */
+typedef struct _AL_DISPLAY_VSYNC
+{
+   ALLEGRO_DISPLAY *display;
+   _AL_THREAD thread;
+   void *upload_context;
+   double period;
+   double phase;           /* time of the last flip, if it waited for vsync */
+   double last_tick;
+   bool redraw_requested;  /* emit a redraw event with the next vsync event */
+} _AL_DISPLAY_VSYNC;
+
+
+/* emit_redraw:
+ *  Emit a redraw event. The event source must be locked.
+ */
+static void emit_redraw(ALLEGRO_DISPLAY *display, double timestamp)
+{
+   ALLEGRO_EVENT event;
+
+   if (!_al_event_source_needs_to_generate_event(&display->es))
+      return;
+
+   event.display.type = ALLEGRO_EVENT_DISPLAY_REDRAW;
+   event.display.timestamp = timestamp;
+   event.display.x = 0;
+   event.display.y = 0;
+   event.display.width = display->w;
+   event.display.height = display->h;
+   event.display.orientation = 0;
+   _al_event_source_emit_event(&display->es, &event);
+
+   display->redraw_pending = true;
+}
+
+
+static void emit_vsync(_AL_DISPLAY_VSYNC *vs, double timestamp)
+{
+   ALLEGRO_DISPLAY *display = vs->display;
+   ALLEGRO_EVENT event;
+
+   _al_event_source_lock(&display->es);
+
+   if (_al_event_source_needs_to_generate_event(&display->es)) {
+      event.display.type = ALLEGRO_EVENT_DISPLAY_VSYNC;
+      event.display.timestamp = timestamp;
+      event.display.x = 0;
+      event.display.y = 0;
+      event.display.width = display->w;
+      event.display.height = display->h;
+      event.display.orientation = 0;
+      _al_event_source_emit_event(&display->es, &event);
+   }
+
+   if (vs->redraw_requested) {
+      vs->redraw_requested = false;
+      emit_redraw(display, timestamp);
+   }
+
+   _al_event_source_unlock(&display->es);
+}
+
+
+/* wait_for_estimated_vblank:
+ *  Sleep until the next multiple of the refresh period after the last flip
+ *  and return that time.
+ */
+static double wait_for_estimated_vblank(_AL_DISPLAY_VSYNC *vs)
+{
+   ALLEGRO_DISPLAY *display = vs->display;
+   double now = al_get_time();
+   double phase, next;
+
+   _al_event_source_lock(&display->es);
+   phase = vs->phase;
+   _al_event_source_unlock(&display->es);
+
+   next = phase + (floor((now - phase) / vs->period) + 1.0) * vs->period;
+   /* al_rest may return a little early. */
+   if (next < vs->last_tick + vs->period / 2)
+      next += vs->period;
+
+   al_rest(next - now);
+   vs->last_tick = next;
+   return next;
+}
+
+
+static void vsync_thread_proc(_AL_THREAD *self, void *arg)
+{
+   _AL_DISPLAY_VSYNC *vs = arg;
+   ALLEGRO_DISPLAY *display = vs->display;
+   bool exact = (display->vt->wait_for_vblank != NULL);
+   bool have_context = false;
+
+   /* Drivers with upload contexts need one to wait for the vblank. */
+   if (exact && display->vt->create_upload_context) {
+      if (vs->upload_context &&
+         display->vt->make_upload_context_current(display, vs->upload_context))
+      {
+         _al_set_current_upload_context(display, vs->upload_context);
+         have_context = true;
+      }
+      else {
+         exact = false;
+      }
+   }
+
+   while (!_al_get_thread_should_stop(self)) {
+      double timestamp;
+
+      if (exact && display->vt->wait_for_vblank(display)) {
+         timestamp = al_get_time();
+      }
+      else {
+         if (exact) {
+            ALLEGRO_INFO("Estimating the vertical blank times.\n");
+            exact = false;
+         }
+         timestamp = wait_for_estimated_vblank(vs);
+      }
+
+      emit_vsync(vs, timestamp);
+   }
+
+   if (have_context) {
+      display->vt->make_upload_context_current(display, NULL);
+      _al_set_current_upload_context(NULL, NULL);
+   }
+}
+
+
+/* Function: al_set_display_vsync_events
+ */
+bool al_set_display_vsync_events(ALLEGRO_DISPLAY *display, bool onoff)
+{
+   _AL_DISPLAY_VSYNC *vs;
+   int refresh_rate;
+
+   ASSERT(display);
+
+   if (!onoff) {
+      _al_stop_display_vsync_events(display);
+      return true;
+   }
+   if (display->vsync)
+      return true;
+
+   vs = al_calloc(1, sizeof(*vs));
+   if (!vs)
+      return false;
+
+   refresh_rate = display->refresh_rate;
+   if (refresh_rate <= 0)
+      refresh_rate = DEFAULT_REFRESH_RATE;
+
+   vs->display = display;
+   vs->period = 1.0 / refresh_rate;
+   vs->phase = al_get_time();
+   vs->last_tick = vs->phase;
+
+   if (display->vt->wait_for_vblank && display->vt->create_upload_context &&
+      (display->flags & ALLEGRO_OPENGL))
+   {
+      vs->upload_context = display->vt->create_upload_context(display);
+   }
+
+   _al_event_source_lock(&display->es);
+   display->vsync = vs;
+   _al_event_source_unlock(&display->es);
+
+   _al_thread_create(&vs->thread, vsync_thread_proc, vs);
+   return true;
+}
+
+
+/* _al_stop_display_vsync_events:
+ *  Stop the thread of al_set_display_vsync_events, if any. Called while
+ *  destroying the display.
+ */
+void _al_stop_display_vsync_events(ALLEGRO_DISPLAY *display)
+{
+   _AL_DISPLAY_VSYNC *vs = display->vsync;
+
+   if (!vs)
+      return;
+
+   _al_thread_join(&vs->thread);
+
+   _al_event_source_lock(&display->es);
+   display->vsync = NULL;
+   if (vs->redraw_requested)
+      emit_redraw(display, al_get_time());
+   _al_event_source_unlock(&display->es);
+
+   if (vs->upload_context)
+      display->vt->destroy_upload_context(display, vs->upload_context);
+   al_free(vs);
+}
+
+
+/* Function: al_request_display_redraw
+ */
+void al_request_display_redraw(ALLEGRO_DISPLAY *display)
+{
+   ASSERT(display);
+
+   _al_event_source_lock(&display->es);
+
+   if (!display->redraw_pending) {
+      if (display->vsync)
+         display->vsync->redraw_requested = true;
+      else
+         emit_redraw(display, al_get_time());
+   }
+
+   _al_event_source_unlock(&display->es);
+}
+
+
+/* _al_display_vsync_flipped:
+ *  Called by al_flip_display after flipping. Allows the next redraw event
+ *  and lines the estimated vertical blanks up with the flip.
+ */
+void _al_display_vsync_flipped(ALLEGRO_DISPLAY *display)
+{
+   _al_event_source_lock(&display->es);
+
+   display->redraw_pending = false;
+   if (display->vsync &&
+      display->extra_settings.settings[ALLEGRO_VSYNC] == 1)
+   {
+      display->vsync->phase = al_get_time();
+   }
+
+   _al_event_source_unlock(&display->es);
+}
+
+/* vim: set sts=3 sw=3 et: */
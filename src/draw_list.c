@@ -0,0 +1,332 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Recorded drawing command lists.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_display.h"
+#include "allegro5/internal/aintern_tls.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("display")
+
+
+/* While recording, the drivers and addons hand over the vertices they
+ * would have drawn, already transformed, together with a function which
+ * draws them again. Bitmap vertices collect in the display's vertex cache
+ * as if drawing was held and become a command whenever the cache would be
+ * flushed; every command keeps the blender it was recorded with.
+ *
+ * A list recorded by a thread without a display, or with a memory target,
+ * is display independent instead. It belongs to the thread, which only
+ * touches its own list, so any number of threads can record at once. Such
+ * lists are made of commands which draw through the public API and can be
+ * replayed on any display.
+ */
+typedef struct _AL_DRAW_COMMAND
+{
+   ALLEGRO_BLENDER blender;
+   void (*replay)(ALLEGRO_DISPLAY *display, void *data);
+   void (*destroy)(void *data);
+   void *data;
+} _AL_DRAW_COMMAND;
+
+
+struct ALLEGRO_DRAW_LIST
+{
+   ALLEGRO_DISPLAY *display;     /* NULL if display independent */
+   ALLEGRO_BITMAP *target;
+   /* The blender of the vertices in the display's vertex cache. */
+   ALLEGRO_BLENDER blender;
+   /* Used by a recording thread without a target bitmap. */
+   ALLEGRO_TRANSFORM transform;
+   _AL_VECTOR commands;
+};
+
+
+static void get_current_blender(ALLEGRO_BLENDER *b)
+{
+   /* Recording threads need not have a target. */
+   if (!al_get_target_bitmap()) {
+      al_get_separate_blender(&b->blend_op, &b->blend_source,
+         &b->blend_dest, &b->blend_alpha_op, &b->blend_alpha_source,
+         &b->blend_alpha_dest);
+      b->blend_color = al_get_blend_color();
+      return;
+   }
+   al_get_separate_bitmap_blender(&b->blend_op, &b->blend_source,
+      &b->blend_dest, &b->blend_alpha_op, &b->blend_alpha_source,
+      &b->blend_alpha_dest);
+   b->blend_color = al_get_bitmap_blend_color();
+}
+
+
+static ALLEGRO_DRAW_LIST *create_list(ALLEGRO_DISPLAY *display,
+   ALLEGRO_BITMAP *target)
+{
+   ALLEGRO_DRAW_LIST *list = al_calloc(1, sizeof(*list));
+   if (!list)
+      return NULL;
+
+   list->display = display;
+   list->target = target;
+   get_current_blender(&list->blender);
+   al_identity_transform(&list->transform);
+   _al_vector_init(&list->commands, sizeof(_AL_DRAW_COMMAND));
+   return list;
+}
+
+
+/* Function: al_begin_draw_recording
+ */
+bool al_begin_draw_recording(void)
+{
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+   ALLEGRO_BITMAP *target = al_get_target_bitmap();
+   ALLEGRO_DRAW_LIST *list;
+
+   if (_al_tls_get_draw_recording() ||
+         (display && display->draw_recording)) {
+      ALLEGRO_WARN("Already recording.\n");
+      return false;
+   }
+
+   if (!display || !target ||
+         (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP)) {
+      list = create_list(NULL, NULL);
+      if (!list)
+         return false;
+      _al_tls_set_draw_recording(list);
+      return true;
+   }
+
+   if (!(display->flags & ALLEGRO_OPENGL)) {
+      ALLEGRO_WARN("Draw recording is only supported with OpenGL.\n");
+      return false;
+   }
+
+   list = create_list(display, target);
+   if (!list)
+      return false;
+
+   /* Whatever is held so far is drawn, not recorded. */
+   if (display->num_cache_vertices > 0)
+      display->vt->flush_vertex_cache(display);
+
+   display->draw_recording = list;
+   return true;
+}
+
+
+/* Function: al_end_draw_recording
+ */
+ALLEGRO_DRAW_LIST *al_end_draw_recording(void)
+{
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+   ALLEGRO_DRAW_LIST *list = _al_tls_get_draw_recording();
+
+   if (list) {
+      _al_tls_set_draw_recording(NULL);
+   }
+   else {
+      if (!display || !display->draw_recording)
+         return NULL;
+
+      list = display->draw_recording;
+      if (display->num_cache_vertices > 0)
+         display->vt->flush_vertex_cache(display);
+      display->draw_recording = NULL;
+   }
+
+   ALLEGRO_DEBUG("Recorded %d draw commands.\n",
+      (int)_al_vector_size(&list->commands));
+   return list;
+}
+
+
+/* Function: al_replay_draw_list
+ */
+void al_replay_draw_list(const ALLEGRO_DRAW_LIST *list,
+   const ALLEGRO_TRANSFORM *trans)
+{
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+   ALLEGRO_STATE state;
+   bool held;
+   unsigned i;
+
+   ASSERT(list);
+
+   if (list->display && display != list->display) {
+      ALLEGRO_WARN("The draw list was recorded for another display.\n");
+      return;
+   }
+   if (_al_tls_get_draw_recording() ||
+         (display && display->draw_recording)) {
+      ALLEGRO_WARN("Cannot replay a draw list while recording.\n");
+      return;
+   }
+
+   /* The recorded vertices are drawn with the hardware transformation. */
+   held = al_is_bitmap_drawing_held();
+   if (held)
+      al_hold_bitmap_drawing(false);
+
+   al_store_state(&state, ALLEGRO_STATE_BLENDER | ALLEGRO_STATE_TRANSFORM);
+   if (trans)
+      al_use_transform(trans);
+
+   /* Recorded vertices are drawn without looking at them again. */
+   if (list->display && _AL_TRACKS_DAMAGE(list->target))
+      _al_damage_clipping_rectangle(list->target);
+
+   for (i = 0; i < _al_vector_size(&list->commands); i++) {
+      const _AL_DRAW_COMMAND *cmd = _al_vector_ref(&list->commands, i);
+      const ALLEGRO_BLENDER *b = &cmd->blender;
+
+      al_set_separate_blender(b->blend_op, b->blend_source, b->blend_dest,
+         b->blend_alpha_op, b->blend_alpha_source, b->blend_alpha_dest);
+      al_set_blend_color(b->blend_color);
+      cmd->replay(display, cmd->data);
+   }
+
+   al_restore_state(&state);
+
+   if (held)
+      al_hold_bitmap_drawing(true);
+}
+
+
+/* Function: al_destroy_draw_list
+ */
+void al_destroy_draw_list(ALLEGRO_DRAW_LIST *list)
+{
+   unsigned i;
+
+   if (!list)
+      return;
+
+   if (list->display && list->display->draw_recording == list)
+      list->display->draw_recording = NULL;
+   if (_al_tls_get_draw_recording() == list)
+      _al_tls_set_draw_recording(NULL);
+
+   for (i = 0; i < _al_vector_size(&list->commands); i++) {
+      _AL_DRAW_COMMAND *cmd = _al_vector_ref(&list->commands, i);
+      cmd->destroy(cmd->data);
+   }
+   _al_vector_free(&list->commands);
+   al_free(list);
+}
+
+
+/* _al_get_draw_recording:
+ *  Returns the list drawing to the current target is recorded into, or
+ *  NULL if it should be drawn. The display independent list of the calling
+ *  thread takes everything.
+ */
+ALLEGRO_DRAW_LIST *_al_get_draw_recording(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_DRAW_LIST *list = _al_tls_get_draw_recording();
+
+   if (list)
+      return list;
+   if (!display || !display->draw_recording)
+      return NULL;
+   if (al_get_target_bitmap() != display->draw_recording->target)
+      return NULL;
+   return display->draw_recording;
+}
+
+
+/* _al_get_thread_recording_transform:
+ *  Returns the transformation of the list the calling thread records into,
+ *  which stands in for the one of the target bitmap while there is none.
+ */
+ALLEGRO_TRANSFORM *_al_get_thread_recording_transform(void)
+{
+   ALLEGRO_DRAW_LIST *list = _al_tls_get_draw_recording();
+   return list ? &list->transform : NULL;
+}
+
+
+/* _al_update_draw_recording_blender:
+ *  Called before vertices are recorded. The vertices in the display's
+ *  cache are recorded first if they were added with another blender.
+ */
+void _al_update_draw_recording_blender(ALLEGRO_DRAW_LIST *list)
+{
+   ALLEGRO_DISPLAY *display = list->display;
+   ALLEGRO_BLENDER b;
+
+   get_current_blender(&b);
+   if (memcmp(&b, &list->blender, sizeof(b)) == 0)
+      return;
+
+   if (display && display->num_cache_vertices > 0)
+      display->vt->flush_vertex_cache(display);
+   list->blender = b;
+}
+
+
+/* _al_draw_list_add:
+ *  Append a command which calls replay with data when the list is
+ *  replayed, and destroy with data when the list is destroyed. The vertices
+ *  in the display's cache are recorded first, to keep the drawing order.
+ */
+bool _al_draw_list_add(ALLEGRO_DRAW_LIST *list,
+   void (*replay)(ALLEGRO_DISPLAY *display, void *data),
+   void (*destroy)(void *data), void *data)
+{
+   ALLEGRO_DISPLAY *display = list->display;
+   _AL_DRAW_COMMAND *cmd;
+
+   if (display && display->num_cache_vertices > 0)
+      display->vt->flush_vertex_cache(display);
+
+   cmd = _al_vector_alloc_back(&list->commands);
+   if (!cmd) {
+      destroy(data);
+      return false;
+   }
+   cmd->blender = list->blender;
+   cmd->replay = replay;
+   cmd->destroy = destroy;
+   cmd->data = data;
+   return true;
+}
+
+
+/* _al_draw_list_last_data:
+ *  Returns the data of the last command if it was added with replay and
+ *  the current blender of the list, so that it can be extended instead of
+ *  adding another command. Returns NULL otherwise.
+ */
+void *_al_draw_list_last_data(ALLEGRO_DRAW_LIST *list,
+   void (*replay)(ALLEGRO_DISPLAY *display, void *data))
+{
+   _AL_DRAW_COMMAND *cmd;
+
+   if (_al_vector_is_empty(&list->commands))
+      return NULL;
+   cmd = _al_vector_ref_back(&list->commands);
+   if (cmd->replay != replay ||
+         memcmp(&cmd->blender, &list->blender, sizeof(cmd->blender)) != 0)
+      return NULL;
+   return cmd->data;
+}
+
+/* vim: set sts=3 sw=3 et: */
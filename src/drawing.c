@@ -28,6 +28,9 @@ void al_clear_to_color(ALLEGRO_COLOR color)
    ALLEGRO_BITMAP *target = al_get_target_bitmap();
    ASSERT(target);
 
+   if (_AL_TRACKS_DAMAGE(target))
+      _al_damage_clipping_rectangle(target);
+
    if (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP ||
        _al_pixel_format_is_compressed(al_get_bitmap_format(target))) {
       _al_clear_bitmap_by_locking(target, &color);
@@ -67,6 +70,9 @@ void al_draw_pixel(float x, float y, ALLEGRO_COLOR color)
 
    ASSERT(target);
 
+   if (_AL_TRACKS_DAMAGE(target))
+      _al_damage_target(target, al_get_current_transform(), x, y, x, y);
+
    if (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP ||
        _al_pixel_format_is_compressed(al_get_bitmap_format(target))) {
       _al_draw_pixel_memory(target, x, y, &color);
@@ -21,15 +21,21 @@
  * itself, that need to be destroyed when Allegro is shut down.  Strictly
  * speaking, this list should not be necessary if the user is careful to
  * destroy all the objects he creates.
+ *
+ * Registrations go to one of several buckets, each with its own mutex, so
+ * threads creating and destroying objects at the same time rarely contend.
+ * Each thread sticks to one bucket. The handle returned for an object is its
+ * entry, which knows its bucket and can be unlinked in constant time. A
+ * global sequence number keeps the registration order across buckets.
  */
 
 
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_atomicops.h"
 #include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_thread.h"
 #include "allegro5/internal/aintern_tls.h"
-#include "allegro5/internal/aintern_list.h"
 
 /* XXX The dependency on tls.c is not nice but the DllMain stuff for Windows
  * does not it easy to make abstract away TLS API differences.
@@ -38,17 +44,67 @@
 ALLEGRO_DEBUG_CHANNEL("dtor")
 
 
-struct _AL_DTOR_LIST {
-   _AL_MUTEX mutex;
-   _AL_LIST* dtors;
-};
+#define NUM_BUCKETS  16
 
 
-typedef struct DTOR {
+struct _AL_DTOR_ITEM {
+   _AL_DTOR_ITEM *prev;
+   _AL_DTOR_ITEM *next;
+   uint64_t seq;
+   int bucket;
    char const *name;
    void *object;
    void (*func)(void*);
-} DTOR;
+};
+
+
+typedef struct DTOR_BUCKET {
+   _AL_MUTEX mutex;
+   /* Oldest and newest registration. */
+   _AL_DTOR_ITEM *first;
+   _AL_DTOR_ITEM *last;
+   /* Unregistered entries, linked through next. */
+   _AL_DTOR_ITEM *free_list;
+   /* Keep the buckets on separate cache lines. */
+   char pad[64];
+} DTOR_BUCKET;
+
+
+struct _AL_DTOR_LIST {
+   DTOR_BUCKET buckets[NUM_BUCKETS];
+};
+
+
+/* Returns the next registration sequence number. This is 64-bit where
+ * possible so that it never wraps around.
+ */
+static uint64_t next_sequence(void)
+{
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+   static volatile uint64_t counter = 0;
+   return __sync_fetch_and_add(&counter, 1);
+#elif defined(_MSC_VER)
+   static volatile __int64 counter = 0;
+   return _InterlockedExchangeAdd64(&counter, 1);
+#else
+   static volatile _AL_ATOMIC counter = 0;
+   return (unsigned)_al_fetch_and_add1(&counter);
+#endif
+}
+
+
+/* Returns the bucket of the calling thread. Threads are spread over the
+ * buckets round-robin the first time they register something.
+ */
+static DTOR_BUCKET *get_bucket(_AL_DTOR_LIST *dtors)
+{
+   static volatile _AL_ATOMIC next_bucket = 0;
+   int *bucket = _al_tls_get_dtor_bucket();
+
+   if (*bucket == 0)
+      *bucket = 1 + (unsigned)_al_fetch_and_add1(&next_bucket) % NUM_BUCKETS;
+   return &dtors->buckets[*bucket - 1];
+}
 
 
 /* Internal function: _al_init_destructors
@@ -56,11 +112,16 @@ typedef struct DTOR {
  */
 _AL_DTOR_LIST *_al_init_destructors(void)
 {
-   _AL_DTOR_LIST *dtors = al_malloc(sizeof(*dtors));
+   _AL_DTOR_LIST *dtors = al_calloc(1, sizeof(*dtors));
+   int i;
 
-   _AL_MARK_MUTEX_UNINITED(dtors->mutex);
-   _al_mutex_init(&dtors->mutex);
-   dtors->dtors = _al_list_create();
+   if (!dtors)
+      return NULL;
+
+   for (i = 0; i < NUM_BUCKETS; i++) {
+      _AL_MARK_MUTEX_UNINITED(dtors->buckets[i].mutex);
+      _al_mutex_init(&dtors->buckets[i].mutex);
+   }
 
    return dtors;
 }
@@ -104,28 +165,38 @@ void _al_run_destructors(_AL_DTOR_LIST *dtors)
       return;
    }
 
-   /* call the destructors in reverse order */
-   _al_mutex_lock(&dtors->mutex);
-   {
-      _AL_LIST_ITEM *iter = _al_list_back(dtors->dtors);
-      while (iter) {
-         DTOR *dtor = _al_list_item_data(iter);
-         void *object = dtor->object;
-         void (*func)(void *) = dtor->func;
-
-         ALLEGRO_DEBUG("calling dtor for %s %p, func %p\n",
-            dtor->name, object, func);
-         _al_mutex_unlock(&dtors->mutex);
-         {
-            (*func)(object);
+   /* Call the destructors in reverse order. Each destructor unregisters its
+    * object and possibly others too, so look for the newest entry of all
+    * buckets anew every time.
+    */
+   for (;;) {
+      bool found = false;
+      uint64_t seq = 0;
+      char const *name = NULL;
+      void *object = NULL;
+      void (*func)(void *) = NULL;
+      int i;
+
+      for (i = 0; i < NUM_BUCKETS; i++) {
+         DTOR_BUCKET *bucket = &dtors->buckets[i];
+
+         _al_mutex_lock(&bucket->mutex);
+         if (bucket->last && (!found || bucket->last->seq > seq)) {
+            found = true;
+            seq = bucket->last->seq;
+            name = bucket->last->name;
+            object = bucket->last->object;
+            func = bucket->last->func;
          }
-         _al_mutex_lock(&dtors->mutex);
-         /* Don't do normal iteration as the destructors will possibly run
-          * multiple destructors at once. */
-         iter = _al_list_back(dtors->dtors);
+         _al_mutex_unlock(&bucket->mutex);
       }
+
+      if (!found)
+         break;
+
+      ALLEGRO_DEBUG("calling dtor for %s %p, func %p\n", name, object, func);
+      (*func)(object);
    }
-   _al_mutex_unlock(&dtors->mutex);
 }
 
 
@@ -135,15 +206,24 @@ void _al_run_destructors(_AL_DTOR_LIST *dtors)
  */
 void _al_shutdown_destructors(_AL_DTOR_LIST *dtors)
 {
+   int i;
+
    if (!dtors) {
       return;
    }
 
    /* free resources used by the destructor subsystem */
-   ASSERT(_al_list_is_empty(dtors->dtors));
-   _al_list_destroy(dtors->dtors);
-
-   _al_mutex_destroy(&dtors->mutex);
+   for (i = 0; i < NUM_BUCKETS; i++) {
+      DTOR_BUCKET *bucket = &dtors->buckets[i];
+
+      ASSERT(bucket->first == NULL);
+      while (bucket->free_list) {
+         _AL_DTOR_ITEM *item = bucket->free_list;
+         bucket->free_list = item->next;
+         al_free(item);
+      }
+      _al_mutex_destroy(&bucket->mutex);
+   }
 
    al_free(dtors);
 }
@@ -154,16 +234,16 @@ void _al_shutdown_destructors(_AL_DTOR_LIST *dtors)
  *  Register OBJECT to be destroyed by FUNC during Allegro shutdown.
  *  This would be done in the object's constructor function.
  *
- *  Returns a list item representing the destructor's position in the list
- *  (possibly null).
+ *  Returns a handle for unregistering the object again (possibly null).
  *
  *  [thread-safe]
  */
-_AL_LIST_ITEM *_al_register_destructor(_AL_DTOR_LIST *dtors, char const *name,
+_AL_DTOR_ITEM *_al_register_destructor(_AL_DTOR_LIST *dtors, char const *name,
    void *object, void (*func)(void*))
 {
    int *dtor_owner_count;
-   _AL_LIST_ITEM *ret = NULL;
+   DTOR_BUCKET *bucket;
+   _AL_DTOR_ITEM *item;
    ASSERT(object);
    ASSERT(func);
 
@@ -171,40 +251,55 @@ _AL_LIST_ITEM *_al_register_destructor(_AL_DTOR_LIST *dtors, char const *name,
    if (*dtor_owner_count > 0)
       return NULL;
 
-   _al_mutex_lock(&dtors->mutex);
-   {
 #ifdef DEBUGMODE
-      /* make sure the object is not registered twice */
-      {
-         _AL_LIST_ITEM *iter = _al_list_front(dtors->dtors);
-
-         while (iter) {
-            DTOR *dtor = _al_list_item_data(iter);
-            ASSERT(dtor->object != object);
-            iter = _al_list_next(dtors->dtors, iter);
-         }
+   /* make sure the object is not registered twice */
+   {
+      int i;
+
+      for (i = 0; i < NUM_BUCKETS; i++) {
+         _al_mutex_lock(&dtors->buckets[i].mutex);
+         for (item = dtors->buckets[i].first; item; item = item->next)
+            ASSERT(item->object != object);
+         _al_mutex_unlock(&dtors->buckets[i].mutex);
       }
+   }
 #endif /* DEBUGMODE */
 
-      /* add the destructor to the list */
-      {
-         DTOR *new_dtor = al_malloc(sizeof(DTOR));
-         if (new_dtor) {
-            new_dtor->object = object;
-            new_dtor->func = func;
-            new_dtor->name = name;
-            ALLEGRO_DEBUG("added dtor for %s %p, func %p\n", name,
-               object, func);
-            ret = _al_list_push_back(dtors->dtors, new_dtor);
-         }
-         else {
-            ALLEGRO_WARN("failed to add dtor for %s %p\n", name,
-               object);
-         }
+   bucket = get_bucket(dtors);
+
+   _al_mutex_lock(&bucket->mutex);
+   {
+      item = bucket->free_list;
+      if (item)
+         bucket->free_list = item->next;
+      else
+         item = al_malloc(sizeof(*item));
+
+      if (item) {
+         item->seq = next_sequence();
+         item->bucket = bucket - dtors->buckets;
+         item->name = name;
+         item->object = object;
+         item->func = func;
+
+         item->prev = bucket->last;
+         item->next = NULL;
+         if (bucket->last)
+            bucket->last->next = item;
+         else
+            bucket->first = item;
+         bucket->last = item;
+
+         ALLEGRO_DEBUG("added dtor for %s %p, func %p\n", name,
+            object, func);
+      }
+      else {
+         ALLEGRO_WARN("failed to add dtor for %s %p\n", name,
+            object);
       }
    }
-   _al_mutex_unlock(&dtors->mutex);
-   return ret;
+   _al_mutex_unlock(&bucket->mutex);
+   return item;
 }
 
 
@@ -215,43 +310,72 @@ _AL_LIST_ITEM *_al_register_destructor(_AL_DTOR_LIST *dtors, char const *name,
  *
  *  [thread-safe]
  */
-void _al_unregister_destructor(_AL_DTOR_LIST *dtors, _AL_LIST_ITEM *dtor_item)
+void _al_unregister_destructor(_AL_DTOR_LIST *dtors, _AL_DTOR_ITEM *dtor_item)
 {
+   DTOR_BUCKET *bucket;
+
    if (!dtor_item) {
       return;
    }
 
-   _al_mutex_lock(&dtors->mutex);
+   bucket = &dtors->buckets[dtor_item->bucket];
+
+   _al_mutex_lock(&bucket->mutex);
    {
-      DTOR *dtor = _al_list_item_data(dtor_item);
-      ALLEGRO_DEBUG("removed dtor for %s %p\n", dtor->name, dtor->object);
-      al_free(dtor);
-      _al_list_erase(dtors->dtors, dtor_item);
+      ALLEGRO_DEBUG("removed dtor for %s %p\n", dtor_item->name,
+         dtor_item->object);
+
+      if (dtor_item->prev)
+         dtor_item->prev->next = dtor_item->next;
+      else
+         bucket->first = dtor_item->next;
+      if (dtor_item->next)
+         dtor_item->next->prev = dtor_item->prev;
+      else
+         bucket->last = dtor_item->prev;
+
+      dtor_item->next = bucket->free_list;
+      bucket->free_list = dtor_item;
    }
-   _al_mutex_unlock(&dtors->mutex);
+   _al_mutex_unlock(&bucket->mutex);
 }
 
 
 
 /* Internal function: _al_foreach_destructor
- *  Call the callback for each registered object.
+ *  Call the callback for each registered object, in the order they were
+ *  registered.
  *  [thread-safe]
  */
 void _al_foreach_destructor(_AL_DTOR_LIST *dtors,
    void (*callback)(void *object, void (*func)(void *), void *udata),
    void *userdata)
 {
-   _al_mutex_lock(&dtors->mutex);
-   {
-      _AL_LIST_ITEM *iter = _al_list_front(dtors->dtors);
+   _AL_DTOR_ITEM *iter[NUM_BUCKETS];
+   int i;
+
+   /* Always lock the buckets in the same order. */
+   for (i = 0; i < NUM_BUCKETS; i++) {
+      _al_mutex_lock(&dtors->buckets[i].mutex);
+      iter[i] = dtors->buckets[i].first;
+   }
 
-      while (iter) {
-         DTOR *dtor = _al_list_item_data(iter);
-         callback(dtor->object, dtor->func, userdata);
-         iter = _al_list_next(dtors->dtors, iter);
+   for (;;) {
+      int oldest = -1;
+
+      for (i = 0; i < NUM_BUCKETS; i++) {
+         if (iter[i] && (oldest < 0 || iter[i]->seq < iter[oldest]->seq))
+            oldest = i;
       }
+      if (oldest < 0)
+         break;
+
+      callback(iter[oldest]->object, iter[oldest]->func, userdata);
+      iter[oldest] = iter[oldest]->next;
    }
-   _al_mutex_unlock(&dtors->mutex);
+
+   for (i = NUM_BUCKETS - 1; i >= 0; i--)
+      _al_mutex_unlock(&dtors->buckets[i].mutex);
 }
 
 
@@ -26,23 +26,48 @@
 
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_atomicops.h"
 #include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_events.h"
 #include "allegro5/internal/aintern_system.h"
 
+ALLEGRO_DEBUG_CHANNEL("events")
 
 
+
+/* Most queues only ever have a handful of sources. */
+#define INLINE_SOURCES  8
+
 struct ALLEGRO_EVENT_QUEUE
 {
-   _AL_VECTOR sources;  /* vector of (ALLEGRO_EVENT_SOURCE *) */
+   _AL_VECTOR sources;  /* vector of (ALLEGRO_EVENT_SOURCE *), unordered */
+   ALLEGRO_EVENT_SOURCE *inline_sources[INLINE_SOURCES];
    _AL_VECTOR events;   /* vector of ALLEGRO_EVENT, used as circular array */
    unsigned int events_head;  /* write end of circular array */
    unsigned int events_tail;  /* read end of circular array */
    bool paused;
    _AL_MUTEX mutex;
    _AL_COND cond;
-   _AL_LIST_ITEM *dtor_item;
+   _AL_DTOR_ITEM *dtor_item;
+
+   /* If not NULL, events go through this fixed size ring instead, see
+    * al_create_lockfree_event_queue.  Head and tail are free running
+    * counters, the producer only writes head and the consumer only writes
+    * tail.  The mutex and condition variable are only used to sleep.
+    * When a source is unregistered, its events up to ring_discard are
+    * left for the consumer to drop, which it does once it sees
+    * ring_discards differ from the count it has handled.
+    */
+   ALLEGRO_EVENT *ring;
+   unsigned int ring_mask;
+   volatile _AL_ATOMIC ring_head;
+   volatile _AL_ATOMIC ring_tail;
+   volatile _AL_ATOMIC ring_discard;
+   volatile _AL_ATOMIC ring_discards;
+   unsigned int ring_discards_seen;
+   volatile _AL_ATOMIC ring_waiting;
+   bool ring_overflowed;
 };
 
 
@@ -61,6 +86,7 @@ static void ref_if_user_event(ALLEGRO_EVENT *event);
 static void unref_if_user_event(ALLEGRO_EVENT *event);
 static void discard_events_of_source(ALLEGRO_EVENT_QUEUE *queue,
    const ALLEGRO_EVENT_SOURCE *source);
+static void ring_discard_events(ALLEGRO_EVENT_QUEUE *queue);
 
 
 
@@ -94,7 +120,18 @@ ALLEGRO_EVENT_QUEUE *al_create_event_queue(void)
    ASSERT(queue);
 
    if (queue) {
-      _al_vector_init(&queue->sources, sizeof(ALLEGRO_EVENT_SOURCE *));
+      queue->ring = NULL;
+      queue->ring_mask = 0;
+      queue->ring_head = 0;
+      queue->ring_tail = 0;
+      queue->ring_discard = 0;
+      queue->ring_discards = 0;
+      queue->ring_discards_seen = 0;
+      queue->ring_waiting = 0;
+      queue->ring_overflowed = false;
+
+      _al_vector_init_inline(&queue->sources, sizeof(ALLEGRO_EVENT_SOURCE *),
+         queue->inline_sources, INLINE_SOURCES);
 
       _al_vector_init(&queue->events, sizeof(ALLEGRO_EVENT));
       _al_vector_alloc_back(&queue->events);
@@ -115,6 +152,33 @@ ALLEGRO_EVENT_QUEUE *al_create_event_queue(void)
 
 
 
+/* Function: al_create_lockfree_event_queue
+ */
+ALLEGRO_EVENT_QUEUE *al_create_lockfree_event_queue(int capacity)
+{
+   ALLEGRO_EVENT_QUEUE *queue;
+   unsigned int size = 1;
+   ASSERT(capacity > 0);
+
+   while ((int)size < capacity)
+      size *= 2;
+
+   queue = al_create_event_queue();
+   if (!queue)
+      return NULL;
+
+   queue->ring = al_malloc(size * sizeof(ALLEGRO_EVENT));
+   if (!queue->ring) {
+      al_destroy_event_queue(queue);
+      return NULL;
+   }
+   queue->ring_mask = size - 1;
+
+   return queue;
+}
+
+
+
 /* Function: al_destroy_event_queue
  */
 void al_destroy_event_queue(ALLEGRO_EVENT_QUEUE *queue)
@@ -132,8 +196,11 @@ void al_destroy_event_queue(ALLEGRO_EVENT_QUEUE *queue)
    ASSERT(_al_vector_is_empty(&queue->sources));
    _al_vector_free(&queue->sources);
 
+   if (queue->ring)
+      ring_discard_events(queue);
    ASSERT(queue->events_head == queue->events_tail);
    _al_vector_free(&queue->events);
+   al_free(queue->ring);
 
    _al_cond_destroy(&queue->cond);
    _al_mutex_destroy(&queue->mutex);
@@ -150,10 +217,7 @@ bool al_is_event_source_registered(ALLEGRO_EVENT_QUEUE *queue,
    ASSERT(queue);
    ASSERT(source);
 
-   if(_al_vector_contains(&queue->sources, &source))
-      return true;
-   else
-      return false;
+   return _al_event_source_is_registered(source, queue);
 }
 
 /* Function: al_register_event_source
@@ -165,7 +229,11 @@ void al_register_event_source(ALLEGRO_EVENT_QUEUE *queue,
    ASSERT(queue);
    ASSERT(source);
 
-   if (!_al_vector_contains(&queue->sources, &source)) {
+   if (!_al_event_source_is_registered(source, queue)) {
+      if (queue->ring && _al_vector_is_nonempty(&queue->sources)) {
+         ALLEGRO_WARN("A lock-free event queue takes only one event source.\n");
+         return;
+      }
       _al_event_source_on_registration_to_queue(source, queue);
       _al_mutex_lock(&queue->mutex);
       slot = _al_vector_alloc_back(&queue->sources);
@@ -187,7 +255,7 @@ void al_unregister_event_source(ALLEGRO_EVENT_QUEUE *queue,
 
    /* Remove source from our list. */
    _al_mutex_lock(&queue->mutex);
-   found = _al_vector_find_and_delete(&queue->sources, &source);
+   found = _al_vector_find_and_delete_unordered(&queue->sources, &source);
    _al_mutex_unlock(&queue->mutex);
 
    if (found) {
@@ -195,9 +263,20 @@ void al_unregister_event_source(ALLEGRO_EVENT_QUEUE *queue,
       _al_event_source_on_unregistration_from_queue(source, queue);
 
       /* Drop all the events in the queue that belonged to the source. */
-      _al_mutex_lock(&queue->mutex);
-      discard_events_of_source(queue, source);
-      _al_mutex_unlock(&queue->mutex);
+      if (queue->ring) {
+         /* The source was the only producer and is gone now, but the
+          * consumer may be reading the ring on another thread, so only
+          * mark its events for the consumer to drop.
+          */
+         _al_store_release(&queue->ring_discard,
+            _al_load_acquire(&queue->ring_head));
+         _al_fetch_and_add1(&queue->ring_discards);
+      }
+      else {
+         _al_mutex_lock(&queue->mutex);
+         discard_events_of_source(queue, source);
+         _al_mutex_unlock(&queue->mutex);
+      }
    }
 }
 
@@ -236,13 +315,147 @@ static void heartbeat(void)
 
 
 
+static ALLEGRO_EVENT *ring_front(ALLEGRO_EVENT_QUEUE *queue);
+
 static bool is_event_queue_empty(ALLEGRO_EVENT_QUEUE *queue)
 {
+   if (queue->ring)
+      return ring_front(queue) == NULL;
    return (queue->events_head == queue->events_tail);
 }
 
 
 
+/* ring_is_empty:
+ *  Like is_event_queue_empty, but counts events still to be dropped.
+ */
+static bool ring_is_empty(ALLEGRO_EVENT_QUEUE *queue)
+{
+   return _al_load_acquire(&queue->ring_head) == queue->ring_tail;
+}
+
+
+
+/* ring_front: [consumer thread]
+ *  Returns the oldest event in a lock-free queue without removing it, or
+ *  NULL.  First drops the events of an unregistered source.
+ */
+static ALLEGRO_EVENT *ring_front(ALLEGRO_EVENT_QUEUE *queue)
+{
+   unsigned int discards = _al_load_acquire(&queue->ring_discards);
+   unsigned int tail = queue->ring_tail;
+
+   if (discards != queue->ring_discards_seen) {
+      unsigned int discard = _al_load_acquire(&queue->ring_discard);
+      queue->ring_discards_seen = discards;
+      while ((int)(discard - tail) > 0) {
+         unref_if_user_event(&queue->ring[tail & queue->ring_mask]);
+         tail++;
+         _al_store_release(&queue->ring_tail, tail);
+      }
+   }
+
+   if ((unsigned int)_al_load_acquire(&queue->ring_head) == tail)
+      return NULL;
+   return &queue->ring[tail & queue->ring_mask];
+}
+
+
+
+/* ring_pop: [consumer thread]
+ *  Removes the event returned by ring_front.
+ */
+static void ring_pop(ALLEGRO_EVENT_QUEUE *queue)
+{
+   _al_store_release(&queue->ring_tail, queue->ring_tail + 1);
+}
+
+
+
+/* ring_push: [producer thread]
+ */
+static void ring_push(ALLEGRO_EVENT_QUEUE *queue, const ALLEGRO_EVENT *event)
+{
+   unsigned int head = queue->ring_head;
+   unsigned int tail = _al_load_acquire(&queue->ring_tail);
+
+   if (head - tail > queue->ring_mask) {
+      /* Full.  We can't wait for the consumer while the source is locked. */
+      if (!queue->ring_overflowed) {
+         ALLEGRO_WARN("Lock-free event queue is full, dropping events.\n");
+         queue->ring_overflowed = true;
+      }
+      return;
+   }
+   queue->ring_overflowed = false;
+
+   copy_event(&queue->ring[head & queue->ring_mask], event);
+   ref_if_user_event(&queue->ring[head & queue->ring_mask]);
+   _al_store_release(&queue->ring_head, head + 1);
+
+   /* Pairs with the barrier in ring_wait: either we see the consumer is
+    * about to sleep, or it sees the new event.
+    */
+   _al_memory_barrier();
+   if (_al_load_acquire(&queue->ring_waiting)) {
+      _al_mutex_lock(&queue->mutex);
+      _al_cond_broadcast(&queue->cond);
+      _al_mutex_unlock(&queue->mutex);
+   }
+}
+
+
+
+/* ring_wait: [consumer thread]
+ *  Waits until a lock-free queue is non-empty and returns the oldest event
+ *  like ring_front, or NULL on timeout.
+ */
+static ALLEGRO_EVENT *ring_wait(ALLEGRO_EVENT_QUEUE *queue,
+   ALLEGRO_TIMEOUT *timeout)
+{
+   ALLEGRO_EVENT *event;
+   int result = 0;
+
+   /* Events are dropped outside the mutex, as that may call the
+    * destructors of user events.
+    */
+   while (!(event = ring_front(queue))) {
+      if (result == -1)
+         return NULL;
+
+      _al_mutex_lock(&queue->mutex);
+      _al_store_release(&queue->ring_waiting, 1);
+      _al_memory_barrier();
+      while (ring_is_empty(queue) && (result != -1)) {
+         if (timeout)
+            result = _al_cond_timedwait(&queue->cond, &queue->mutex, timeout);
+         else
+            _al_cond_wait(&queue->cond, &queue->mutex);
+      }
+      _al_store_release(&queue->ring_waiting, 0);
+      _al_mutex_unlock(&queue->mutex);
+   }
+
+   return event;
+}
+
+
+
+/* ring_discard_events: [consumer thread]
+ *  Drops all events in a lock-free queue.
+ */
+static void ring_discard_events(ALLEGRO_EVENT_QUEUE *queue)
+{
+   ALLEGRO_EVENT *event;
+
+   while ((event = ring_front(queue))) {
+      unref_if_user_event(event);
+      ring_pop(queue);
+   }
+}
+
+
+
 /* Function: al_is_event_queue_empty
  */
 bool al_is_event_queue_empty(ALLEGRO_EVENT_QUEUE *queue)
@@ -301,6 +514,15 @@ bool al_get_next_event(ALLEGRO_EVENT_QUEUE *queue, ALLEGRO_EVENT *ret_event)
 
    heartbeat();
 
+   if (queue->ring) {
+      next_event = ring_front(queue);
+      if (next_event) {
+         copy_event(ret_event, next_event);
+         ring_pop(queue);
+      }
+      return (next_event ? true : false);
+   }
+
    _al_mutex_lock(&queue->mutex);
 
    next_event = get_next_event_if_any(queue, true);
@@ -316,6 +538,98 @@ bool al_get_next_event(ALLEGRO_EVENT_QUEUE *queue, ALLEGRO_EVENT *ret_event)
 
 
 
+/* copy_events_out:
+ *  Moves up to max events from the circular array into ret_events, with
+ *  at most two copies.  The queue must be locked.  Returns the number of
+ *  events moved.
+ */
+static int copy_events_out(ALLEGRO_EVENT_QUEUE *queue,
+   ALLEGRO_EVENT *ret_events, int max)
+{
+   unsigned int size = _al_vector_size(&queue->events);
+   unsigned int tail = queue->events_tail;
+   unsigned int head = queue->events_head;
+   unsigned int count = (head + size - tail) % size;
+   unsigned int run;
+
+   if (count > (unsigned int)max)
+      count = max;
+   if (count == 0)
+      return 0;
+
+   run = size - tail;
+   if (run > count)
+      run = count;
+   memcpy(ret_events, _al_vector_ref(&queue->events, tail),
+      run * sizeof(ALLEGRO_EVENT));
+   if (run < count) {
+      memcpy(ret_events + run, _al_vector_ref(&queue->events, 0),
+         (count - run) * sizeof(ALLEGRO_EVENT));
+   }
+
+   queue->events_tail = (tail + count) % size;
+   return count;
+}
+
+
+
+/* ring_copy_events_out: [consumer thread]
+ *  Like copy_events_out, for lock-free queues.
+ */
+static int ring_copy_events_out(ALLEGRO_EVENT_QUEUE *queue,
+   ALLEGRO_EVENT *ret_events, int max)
+{
+   unsigned int size = queue->ring_mask + 1;
+   unsigned int tail = queue->ring_tail;
+   unsigned int count = (unsigned int)_al_load_acquire(&queue->ring_head) - tail;
+   unsigned int start = tail & queue->ring_mask;
+   unsigned int run;
+
+   if (count > (unsigned int)max)
+      count = max;
+   if (count == 0)
+      return 0;
+
+   run = size - start;
+   if (run > count)
+      run = count;
+   memcpy(ret_events, queue->ring + start, run * sizeof(ALLEGRO_EVENT));
+   if (run < count) {
+      memcpy(ret_events + run, queue->ring,
+         (count - run) * sizeof(ALLEGRO_EVENT));
+   }
+
+   _al_store_release(&queue->ring_tail, tail + count);
+   return count;
+}
+
+
+
+/* Function: al_get_next_events
+ */
+int al_get_next_events(ALLEGRO_EVENT_QUEUE *queue, ALLEGRO_EVENT *ret_events,
+   int max)
+{
+   int count;
+   ASSERT(queue);
+   ASSERT(ret_events);
+   ASSERT(max >= 0);
+
+   heartbeat();
+
+   if (queue->ring)
+      return ring_copy_events_out(queue, ret_events, max);
+
+   _al_mutex_lock(&queue->mutex);
+   count = copy_events_out(queue, ret_events, max);
+   _al_mutex_unlock(&queue->mutex);
+
+   /* Don't increment reference count on user events. */
+   return count;
+}
+
+
+
 /* Function: al_peek_next_event
  */
 bool al_peek_next_event(ALLEGRO_EVENT_QUEUE *queue, ALLEGRO_EVENT *ret_event)
@@ -326,6 +640,15 @@ bool al_peek_next_event(ALLEGRO_EVENT_QUEUE *queue, ALLEGRO_EVENT *ret_event)
 
    heartbeat();
 
+   if (queue->ring) {
+      next_event = ring_front(queue);
+      if (next_event) {
+         copy_event(ret_event, next_event);
+         ref_if_user_event(ret_event);
+      }
+      return (next_event ? true : false);
+   }
+
    _al_mutex_lock(&queue->mutex);
 
    next_event = get_next_event_if_any(queue, false);
@@ -350,6 +673,15 @@ bool al_drop_next_event(ALLEGRO_EVENT_QUEUE *queue)
 
    heartbeat();
 
+   if (queue->ring) {
+      next_event = ring_front(queue);
+      if (next_event) {
+         unref_if_user_event(next_event);
+         ring_pop(queue);
+      }
+      return (next_event ? true : false);
+   }
+
    _al_mutex_lock(&queue->mutex);
 
    next_event = get_next_event_if_any(queue, true);
@@ -373,6 +705,11 @@ void al_flush_event_queue(ALLEGRO_EVENT_QUEUE *queue)
 
    heartbeat();
 
+   if (queue->ring) {
+      ring_discard_events(queue);
+      return;
+   }
+
    _al_mutex_lock(&queue->mutex);
 
    /* Decrement reference counts on all user events. */
@@ -400,6 +737,15 @@ void al_wait_for_event(ALLEGRO_EVENT_QUEUE *queue, ALLEGRO_EVENT *ret_event)
 
    heartbeat();
 
+   if (queue->ring) {
+      next_event = ring_wait(queue, NULL);
+      if (ret_event) {
+         copy_event(ret_event, next_event);
+         ring_pop(queue);
+      }
+      return;
+   }
+
    _al_mutex_lock(&queue->mutex);
    {
       while (is_event_queue_empty(queue)) {
@@ -453,12 +799,70 @@ bool al_wait_for_event_until(ALLEGRO_EVENT_QUEUE *queue,
 
 
 
+/* Function: al_wait_for_events_timed
+ */
+int al_wait_for_events_timed(ALLEGRO_EVENT_QUEUE *queue,
+   ALLEGRO_EVENT *ret_events, int max, float secs)
+{
+   ALLEGRO_TIMEOUT timeout;
+   int count = 0;
+
+   ASSERT(queue);
+   ASSERT(ret_events);
+   ASSERT(max >= 0);
+   ASSERT(secs >= 0);
+
+   heartbeat();
+
+   if (secs < 0.0)
+      al_init_timeout(&timeout, 0);
+   else
+      al_init_timeout(&timeout, secs);
+
+   if (max == 0)
+      return 0;
+
+   if (queue->ring) {
+      if (ring_wait(queue, &timeout))
+         count = ring_copy_events_out(queue, ret_events, max);
+      return count;
+   }
+
+   _al_mutex_lock(&queue->mutex);
+   {
+      int result = 0;
+
+      while (is_event_queue_empty(queue) && (result != -1)) {
+         result = _al_cond_timedwait(&queue->cond, &queue->mutex, &timeout);
+      }
+
+      if (result != -1)
+         count = copy_events_out(queue, ret_events, max);
+   }
+   _al_mutex_unlock(&queue->mutex);
+
+   return count;
+}
+
+
+
 static bool do_wait_for_event(ALLEGRO_EVENT_QUEUE *queue,
    ALLEGRO_EVENT *ret_event, ALLEGRO_TIMEOUT *timeout)
 {
    bool timed_out = false;
    ALLEGRO_EVENT *next_event = NULL;
 
+   if (queue->ring) {
+      next_event = ring_wait(queue, timeout);
+      if (!next_event)
+         return false;
+      if (ret_event) {
+         copy_event(ret_event, next_event);
+         ring_pop(queue);
+      }
+      return true;
+   }
+
    _al_mutex_lock(&queue->mutex);
    {
       int result = 0;
@@ -598,6 +1002,11 @@ void _al_event_queue_push_event(ALLEGRO_EVENT_QUEUE *queue,
    if (queue->paused)
       return;
 
+   if (queue->ring) {
+      ring_push(queue, orig_event);
+      return;
+   }
+
    _al_mutex_lock(&queue->mutex);
    {
       new_event = alloc_event(queue);
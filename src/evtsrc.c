@@ -30,6 +30,10 @@ ALLEGRO_STATIC_ASSERT(evtsrc,
    sizeof(ALLEGRO_EVENT_SOURCE_REAL) <= sizeof(ALLEGRO_EVENT_SOURCE));
 
 
+/* Input captured longer ago than this is assumed to have a bogus time. */
+#define MAX_INPUT_AGE   1.0
+
+
 
 /* Internal function: _al_event_source_init
  *  Initialise an event source structure.
@@ -63,6 +67,8 @@ void _al_event_source_free(ALLEGRO_EVENT_SOURCE *es)
    }
 
    _al_vector_free(&this->queues);
+   al_free(this->latency);
+   this->latency = NULL;
 
    _al_mutex_destroy(&this->mutex);
 }
@@ -126,13 +132,33 @@ void _al_event_source_on_unregistration_from_queue(ALLEGRO_EVENT_SOURCE *es,
    {
       ALLEGRO_EVENT_SOURCE_REAL *this = (ALLEGRO_EVENT_SOURCE_REAL *)es;
 
-      _al_vector_find_and_delete(&this->queues, &queue);
+      _al_vector_find_and_delete_unordered(&this->queues, &queue);
    }
    _al_event_source_unlock(es);
 }
 
 
 
+/* Internal function: _al_event_source_is_registered
+ *  Returns true if the event source is registered with the given queue.
+ *  A source is usually registered with very few queues, so this is cheaper
+ *  than searching through the sources of the queue.
+ */
+bool _al_event_source_is_registered(ALLEGRO_EVENT_SOURCE *es,
+   ALLEGRO_EVENT_QUEUE *queue)
+{
+   ALLEGRO_EVENT_SOURCE_REAL *this = (ALLEGRO_EVENT_SOURCE_REAL *)es;
+   bool found;
+
+   _al_event_source_lock(es);
+   found = _al_vector_contains(&this->queues, &queue);
+   _al_event_source_unlock(es);
+
+   return found;
+}
+
+
+
 /* Internal function: _al_event_source_needs_to_generate_event
  *  This function is called by modules that implement event sources
  *  when some interesting thing happens.  They call this to check if
@@ -190,6 +216,47 @@ void _al_event_source_emit_event(ALLEGRO_EVENT_SOURCE *es, ALLEGRO_EVENT *event)
 
 
 
+/* Internal function: _al_event_source_input_time
+ *  Given the time at which the operating system captured some input,
+ *  already converted to al_get_time() terms, return the timestamp to put
+ *  in the events for it, and record how long the input took to get here.
+ *  Times that cannot be right are replaced with the current time; this
+ *  happens when the clocks are not what we expected them to be.
+ *
+ *  The event source must be _locked_ before calling this function.
+ *
+ *  [runs in background threads]
+ */
+double _al_event_source_input_time(ALLEGRO_EVENT_SOURCE *es, double os_time)
+{
+   ALLEGRO_EVENT_SOURCE_REAL *this = (ALLEGRO_EVENT_SOURCE_REAL *)es;
+   _AL_EVENT_LATENCY *lat;
+   double now = al_get_time();
+   double age = now - os_time;
+
+   if (!(age >= 0.0 && age < MAX_INPUT_AGE))
+      return now;
+
+   if (!this->latency) {
+      this->latency = al_calloc(1, sizeof *this->latency);
+      if (!this->latency)
+         return os_time;
+   }
+
+   lat = this->latency;
+   if (lat->count == 0 || age < lat->min)
+      lat->min = age;
+   if (lat->count == 0 || age > lat->max)
+      lat->max = age;
+   lat->last = age;
+   lat->total += age;
+   lat->count++;
+
+   return os_time;
+}
+
+
+
 /* Function: al_init_user_event_source
  */
 void al_init_user_event_source(ALLEGRO_EVENT_SOURCE *src)
@@ -279,6 +346,48 @@ intptr_t al_get_event_source_data(const ALLEGRO_EVENT_SOURCE *source)
 
 
 
+/* Function: al_get_event_source_latency
+ */
+bool al_get_event_source_latency(ALLEGRO_EVENT_SOURCE *source,
+   ALLEGRO_EVENT_LATENCY *latency)
+{
+   ALLEGRO_EVENT_SOURCE_REAL *rsource = (ALLEGRO_EVENT_SOURCE_REAL *)source;
+   ASSERT(source);
+   ASSERT(latency);
+
+   memset(latency, 0, sizeof *latency);
+
+   _al_event_source_lock(source);
+   if (rsource->latency && rsource->latency->count > 0) {
+      _AL_EVENT_LATENCY *lat = rsource->latency;
+      latency->count = lat->count;
+      latency->last = lat->last;
+      latency->min = lat->min;
+      latency->max = lat->max;
+      latency->mean = lat->total / lat->count;
+   }
+   _al_event_source_unlock(source);
+
+   return latency->count > 0;
+}
+
+
+
+/* Function: al_reset_event_source_latency
+ */
+void al_reset_event_source_latency(ALLEGRO_EVENT_SOURCE *source)
+{
+   ALLEGRO_EVENT_SOURCE_REAL *rsource = (ALLEGRO_EVENT_SOURCE_REAL *)source;
+   ASSERT(source);
+
+   _al_event_source_lock(source);
+   if (rsource->latency)
+      memset(rsource->latency, 0, sizeof *rsource->latency);
+   _al_event_source_unlock(source);
+}
+
+
+
 /*
  * Local Variables:
  * c-basic-offset: 3
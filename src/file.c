@@ -44,13 +44,20 @@ ALLEGRO_FILE *al_fopen_interface(const ALLEGRO_FILE_INTERFACE *drv,
          al_set_errno(ENOMEM);
       }
       else {
+         double start = _al_file_stats_active ? al_get_time() : 0.0;
+
          f->vtable = drv;
          f->userdata = drv->fi_fopen(path, mode);
          f->ungetc_len = 0;
+         f->rbuf = NULL;
+         f->rbuf_size = f->rbuf_pos = f->rbuf_len = 0;
+         f->stats = NULL;
          if (!f->userdata) {
             al_free(f);
             f = NULL;
          }
+         if (_al_file_stats_active)
+            _al_file_stats_open(f, drv, path, start);
       }
    }
 
@@ -75,6 +82,11 @@ ALLEGRO_FILE *al_create_file_handle(const ALLEGRO_FILE_INTERFACE *drv,
       f->vtable = drv;
       f->userdata = userdata;
       f->ungetc_len = 0;
+      f->rbuf = NULL;
+      f->rbuf_size = f->rbuf_pos = f->rbuf_len = 0;
+      f->stats = NULL;
+      if (_al_file_stats_active)
+         _al_file_stats_open(f, drv, NULL, 0.0);
    }
 
    return f;
@@ -87,6 +99,9 @@ bool al_fclose(ALLEGRO_FILE *f)
 {
    if (f) {
       bool ret = f->vtable->fi_fclose(f);
+      if (f->stats)
+         _al_file_stats_close(f);
+      al_free(f->rbuf);
       al_free(f);
       return ret;
    }
@@ -96,6 +111,104 @@ bool al_fclose(ALLEGRO_FILE *f)
 }
 
 
+/* Calls into the file interface, counting the calls for files with
+ * statistics.
+ */
+static size_t interface_read(ALLEGRO_FILE *f, void *ptr, size_t size)
+{
+   if (f->stats)
+      return _al_file_stats_fread(f, ptr, size);
+   return f->vtable->fi_fread(f, ptr, size);
+}
+
+
+static size_t interface_write(ALLEGRO_FILE *f, const void *ptr, size_t size)
+{
+   if (f->stats)
+      return _al_file_stats_fwrite(f, ptr, size);
+   return f->vtable->fi_fwrite(f, ptr, size);
+}
+
+
+static bool interface_seek(ALLEGRO_FILE *f, int64_t offset, int whence)
+{
+   if (f->stats)
+      return _al_file_stats_fseek(f, offset, whence);
+   return f->vtable->fi_fseek(f, offset, whence);
+}
+
+
+/* Number of bytes read ahead but not yet returned. */
+static size_t buffered(const ALLEGRO_FILE *f)
+{
+   return f->rbuf_len - f->rbuf_pos;
+}
+
+
+/* Throws away the read-ahead data, moving the underlying file back to our
+ * position. If that fails the data is kept.
+ */
+static bool discard_buffer(ALLEGRO_FILE *f)
+{
+   size_t n = buffered(f);
+
+   if (n > 0 && !interface_seek(f, -(int64_t)n, ALLEGRO_SEEK_CUR))
+      return false;
+   f->rbuf_pos = f->rbuf_len = 0;
+   return true;
+}
+
+
+/* Reads through the read-ahead buffer. Requests at least as large as the
+ * buffer bypass it once it is drained.
+ */
+static size_t buffered_read(ALLEGRO_FILE *f, unsigned char *ptr, size_t size)
+{
+   size_t done = 0;
+
+   while (size > 0) {
+      size_t n = buffered(f);
+
+      if (n == 0) {
+         int old_errno = al_get_errno();
+
+         /* The drained buffer no longer lies just behind the file
+          * position, so al_fseek must not seek back into it.
+          */
+         f->rbuf_pos = f->rbuf_len = 0;
+         if (size >= f->rbuf_size)
+            return done + interface_read(f, ptr, size);
+         f->rbuf_len = interface_read(f, f->rbuf, f->rbuf_size);
+         n = f->rbuf_len;
+         if (n == 0)
+            break;
+         /* Reading ahead into the end of the file is not an error for the
+          * bytes actually asked for.
+          */
+         al_set_errno(old_errno);
+      }
+
+      if (n > size)
+         n = size;
+      memcpy(ptr, f->rbuf + f->rbuf_pos, n);
+      f->rbuf_pos += n;
+      ptr += n;
+      size -= n;
+      done += n;
+   }
+
+   return done;
+}
+
+
+static size_t raw_read(ALLEGRO_FILE *f, unsigned char *ptr, size_t size)
+{
+   if (f->rbuf)
+      return buffered_read(f, ptr, size);
+   return interface_read(f, ptr, size);
+}
+
+
 /* Function: al_fread
  */
 size_t al_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
@@ -103,6 +216,13 @@ size_t al_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
    ASSERT(f);
    ASSERT(ptr || size == 0);
 
+   /* Whole reads from the buffer need no indirect call at all. */
+   if (f->rbuf && f->ungetc_len == 0 && buffered(f) >= size) {
+      memcpy(ptr, f->rbuf + f->rbuf_pos, size);
+      f->rbuf_pos += size;
+      return size;
+   }
+
    if (f->ungetc_len) {
       int bytes_ungetc = 0;
       unsigned char *cptr = ptr;
@@ -113,10 +233,10 @@ size_t al_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
          --size;
       }
 
-      return bytes_ungetc + f->vtable->fi_fread(f, cptr, size);
+      return bytes_ungetc + raw_read(f, cptr, size);
    }
    else {
-      return f->vtable->fi_fread(f, ptr, size);
+      return raw_read(f, ptr, size);
    }
 }
 
@@ -129,7 +249,8 @@ size_t al_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
    ASSERT(ptr || size == 0);
 
    f->ungetc_len = 0;
-   return f->vtable->fi_fwrite(f, ptr, size);
+   discard_buffer(f);
+   return interface_write(f, ptr, size);
 }
 
 
@@ -149,7 +270,7 @@ int64_t al_ftell(ALLEGRO_FILE *f)
 {
    ASSERT(f);
 
-   return f->vtable->fi_ftell(f) - f->ungetc_len;
+   return f->vtable->fi_ftell(f) - f->ungetc_len - (int64_t)buffered(f);
 }
 
 
@@ -172,7 +293,23 @@ bool al_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
       f->ungetc_len = 0;
    }
 
-   return f->vtable->fi_fseek(f, offset, whence);
+   if (f->rbuf_len > 0) {
+      /* Short relative skips, as loaders do over headers, stay within the
+       * buffer.
+       */
+      if (whence == ALLEGRO_SEEK_CUR &&
+            offset >= -(int64_t)f->rbuf_pos &&
+            offset <= (int64_t)buffered(f)) {
+         f->rbuf_pos += offset;
+         return true;
+      }
+      if (whence == ALLEGRO_SEEK_CUR) {
+         offset -= buffered(f);
+      }
+      f->rbuf_pos = f->rbuf_len = 0;
+   }
+
+   return interface_seek(f, offset, whence);
 }
 
 
@@ -182,7 +319,7 @@ bool al_feof(ALLEGRO_FILE *f)
 {
    ASSERT(f);
 
-   return f->ungetc_len == 0 && f->vtable->fi_feof(f);
+   return f->ungetc_len == 0 && buffered(f) == 0 && f->vtable->fi_feof(f);
 }
 
 
@@ -226,6 +363,10 @@ int al_fgetc(ALLEGRO_FILE *f)
    uint8_t c;
    ASSERT(f);
 
+   if (f->rbuf_pos < f->rbuf_len && f->ungetc_len == 0) {
+      return f->rbuf[f->rbuf_pos++];
+   }
+
    if (al_fread(f, &c, 1) != 1) {
       return EOF;
    }
@@ -498,7 +639,8 @@ int al_fungetc(ALLEGRO_FILE *f, int c)
 {
    ASSERT(f != NULL);
 
-   if (f->vtable->fi_fungetc) {
+   /* The interface's own ungetc would act on the read-ahead position. */
+   if (f->vtable->fi_fungetc && !f->rbuf) {
       return f->vtable->fi_fungetc(f, c);
    }
    else {
@@ -518,6 +660,46 @@ int al_fungetc(ALLEGRO_FILE *f, int c)
 }
 
 
+/* Function: al_set_file_read_buffer_size
+ */
+bool al_set_file_read_buffer_size(ALLEGRO_FILE *f, size_t size)
+{
+   unsigned char *rbuf = NULL;
+   ASSERT(f);
+
+   if (size == f->rbuf_size)
+      return true;
+
+   if (size > 0) {
+      rbuf = al_malloc(size);
+      if (!rbuf) {
+         al_set_errno(ENOMEM);
+         return false;
+      }
+   }
+
+   if (!discard_buffer(f)) {
+      al_free(rbuf);
+      return false;
+   }
+
+   al_free(f->rbuf);
+   f->rbuf = rbuf;
+   f->rbuf_size = size;
+   return true;
+}
+
+
+/* Function: al_get_file_read_buffer_size
+ */
+size_t al_get_file_read_buffer_size(ALLEGRO_FILE *f)
+{
+   ASSERT(f);
+
+   return f->rbuf_size;
+}
+
+
 /* Function: al_fsize
  */
 int64_t al_fsize(ALLEGRO_FILE *f)
@@ -0,0 +1,1040 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Read-only packed archives.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_file.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("archive")
+
+
+/*
+ * Archive layout, all numbers little endian:
+ *
+ *    header   "AL5ARCH\0", u32 version, u32 entry count,
+ *             u64 index offset, u32 size of the name table, u32 reserved
+ *    data     the entries' contents, anywhere in the file
+ *    index    one INDEX_ENTRY_SIZE record per entry, sorted by name:
+ *             u64 data offset, u64 size, u64 stored size,
+ *             u32 name offset, u16 name length, u8 compression, u8 reserved
+ *    names    entry names, relative to the name table and not terminated
+ *
+ * Names use '/' as separator and have no leading slash. Since the index is
+ * sorted bytewise, all entries of a directory are adjacent and a lookup is a
+ * binary search. The archive is mapped with al_fopen_mmap and never changes
+ * while open, so any number of threads may open entries at once. Stored
+ * entries are read straight from the mapping; compressed ones are unpacked
+ * into memory when opened.
+ *
+ * misc/make_archive.py creates archives.
+ */
+
+#define HEADER_SIZE        32
+#define INDEX_ENTRY_SIZE   32
+#define ARCHIVE_VERSION    1
+#define MAX_PATH_LEN       1024
+
+enum {
+   COMPRESSION_NONE = 0,
+   COMPRESSION_LZ4 = 1
+};
+
+typedef struct ARCHIVE_ENTRY
+{
+   const char *name;
+   int name_len;
+   int compression;
+   uint64_t offset;
+   uint64_t size;
+   uint64_t stored_size;
+} ARCHIVE_ENTRY;
+
+struct ALLEGRO_ARCHIVE
+{
+   ALLEGRO_FILE *mapping;
+   const unsigned char *data;
+   size_t size;
+   ARCHIVE_ENTRY *entries;
+   int num_entries;
+};
+
+typedef struct ARCHIVE_FILE
+{
+   const unsigned char *data;
+   size_t size;
+   size_t pos;
+   bool eof;
+   unsigned char *unpacked;   /* Owned copy of a compressed entry. */
+} ARCHIVE_FILE;
+
+typedef struct ALLEGRO_FS_ENTRY_ARCHIVE
+{
+   ALLEGRO_FS_ENTRY fs_entry; /* must be first */
+   char *path;                /* Normalised, without leading slash. */
+   char *name;                /* The same with a leading slash. */
+
+   /* For directory listing. */
+   bool is_dir_open;
+   int list_archive;
+   int list_pos;
+   char *last_child;
+} ALLEGRO_FS_ENTRY_ARCHIVE;
+
+/* Archives searched by the archive file interface, the last mounted first.
+ * Mounting is not synchronised with lookups.
+ */
+static _AL_VECTOR mounted = _AL_VECTOR_INITIALIZER(ALLEGRO_ARCHIVE *);
+
+/* Current directory of the archive filesystem, normalised. */
+static char archive_cwd[MAX_PATH_LEN] = "";
+
+/* forward declarations */
+static const ALLEGRO_FILE_INTERFACE archive_file_vtable;
+static const ALLEGRO_FS_INTERFACE archive_fs_vtable;
+
+
+static uint16_t get16(const unsigned char *p)
+{
+   return p[0] | (p[1] << 8);
+}
+
+
+static uint32_t get32(const unsigned char *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+static uint64_t get64(const unsigned char *p)
+{
+   return get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+
+/* Decodes one LZ4 block. Returns false unless the input was well-formed and
+ * unpacked to exactly dst_size bytes.
+ */
+static bool lz4_decode(const unsigned char *src, size_t src_size,
+   unsigned char *dst, size_t dst_size)
+{
+   const unsigned char *ip = src;
+   const unsigned char *iend = src + src_size;
+   unsigned char *op = dst;
+   unsigned char *oend = dst + dst_size;
+
+   while (ip < iend) {
+      unsigned token = *ip++;
+      size_t len = token >> 4;
+      size_t offset;
+
+      if (len == 15) {
+         unsigned b;
+         do {
+            if (ip >= iend)
+               return false;
+            b = *ip++;
+            len += b;
+         } while (b == 255);
+      }
+      if (len > (size_t)(iend - ip) || len > (size_t)(oend - op))
+         return false;
+      memcpy(op, ip, len);
+      ip += len;
+      op += len;
+
+      /* The last sequence has literals only. */
+      if (ip == iend)
+         break;
+
+      if (iend - ip < 2)
+         return false;
+      offset = get16(ip);
+      ip += 2;
+      if (offset == 0 || offset > (size_t)(op - dst))
+         return false;
+
+      len = token & 15;
+      if (len == 15) {
+         unsigned b;
+         do {
+            if (ip >= iend)
+               return false;
+            b = *ip++;
+            len += b;
+         } while (b == 255);
+      }
+      len += 4;
+      if (len > (size_t)(oend - op))
+         return false;
+
+      /* Matches may overlap their own output. */
+      while (len--) {
+         *op = *(op - offset);
+         op++;
+      }
+   }
+
+   return op == oend;
+}
+
+
+/* Turns path into an archive name in buf, resolving it against the
+ * directory cwd and removing ".", ".." and empty components. Both '/' and
+ * '\' separate components.
+ */
+static bool normalise_path(const char *path, const char *cwd, char *buf,
+   size_t buf_size)
+{
+   const char *parts[2];
+   size_t len = 0;
+   int i;
+
+   parts[0] = (path[0] == '/' || path[0] == '\\') ? "" : cwd;
+   parts[1] = path;
+
+   for (i = 0; i < 2; i++) {
+      const char *p = parts[i];
+
+      while (*p) {
+         const char *start;
+         size_t n;
+
+         while (*p == '/' || *p == '\\')
+            p++;
+         start = p;
+         while (*p && *p != '/' && *p != '\\')
+            p++;
+         n = p - start;
+
+         if (n == 0 || (n == 1 && start[0] == '.'))
+            continue;
+         if (n == 2 && start[0] == '.' && start[1] == '.') {
+            while (len > 0 && buf[len - 1] != '/')
+               len--;
+            if (len > 0)
+               len--;
+            continue;
+         }
+         if (len + (len > 0) + n + 1 > buf_size)
+            return false;
+         if (len > 0)
+            buf[len++] = '/';
+         memcpy(buf + len, start, n);
+         len += n;
+      }
+   }
+
+   buf[len] = '\0';
+   return true;
+}
+
+
+static int compare_name(const ARCHIVE_ENTRY *e, const char *name, size_t len)
+{
+   size_t n = _ALLEGRO_MIN((size_t)e->name_len, len);
+   int c = memcmp(e->name, name, n);
+
+   if (c != 0)
+      return c;
+   if ((size_t)e->name_len < len)
+      return -1;
+   return (size_t)e->name_len > len;
+}
+
+
+/* Returns the index of the first entry not less than the given name. */
+static int lower_bound(const ALLEGRO_ARCHIVE *archive, const char *name,
+   size_t len)
+{
+   int lo = 0;
+   int hi = archive->num_entries;
+
+   while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (compare_name(&archive->entries[mid], name, len) < 0)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return lo;
+}
+
+
+static const ARCHIVE_ENTRY *find_file(const ALLEGRO_ARCHIVE *archive,
+   const char *name)
+{
+   size_t len = strlen(name);
+   int i = lower_bound(archive, name, len);
+
+   if (i < archive->num_entries &&
+         compare_name(&archive->entries[i], name, len) == 0) {
+      return &archive->entries[i];
+   }
+   return NULL;
+}
+
+
+/* A directory exists implicitly if any entry lies below it. */
+static bool is_directory(const ALLEGRO_ARCHIVE *archive, const char *name)
+{
+   char prefix[MAX_PATH_LEN + 1];
+   size_t len = strlen(name);
+   int i;
+
+   if (len == 0)
+      return true;
+
+   memcpy(prefix, name, len);
+   prefix[len++] = '/';
+   i = lower_bound(archive, prefix, len);
+
+   return i < archive->num_entries &&
+      (size_t)archive->entries[i].name_len > len &&
+      memcmp(archive->entries[i].name, prefix, len) == 0;
+}
+
+
+static bool read_index(ALLEGRO_ARCHIVE *archive)
+{
+   const unsigned char *p = archive->data;
+   uint64_t index_offset;
+   uint64_t names_offset;
+   uint32_t names_size;
+   uint32_t count;
+   uint32_t i;
+
+   if (archive->size < HEADER_SIZE || memcmp(p, "AL5ARCH\0", 8) != 0) {
+      ALLEGRO_ERROR("Not an archive.\n");
+      return false;
+   }
+   if (get32(p + 8) != ARCHIVE_VERSION) {
+      ALLEGRO_ERROR("Unsupported archive version %u.\n", get32(p + 8));
+      return false;
+   }
+
+   count = get32(p + 12);
+   index_offset = get64(p + 16);
+   names_size = get32(p + 24);
+   names_offset = index_offset + (uint64_t)count * INDEX_ENTRY_SIZE;
+   if (index_offset > archive->size || names_offset > archive->size ||
+         names_size > archive->size - names_offset) {
+      ALLEGRO_ERROR("Archive index out of bounds.\n");
+      return false;
+   }
+
+   archive->entries = al_calloc(count ? count : 1, sizeof(ARCHIVE_ENTRY));
+   if (!archive->entries)
+      return false;
+
+   for (i = 0; i < count; i++) {
+      const unsigned char *r = p + index_offset + (size_t)i * INDEX_ENTRY_SIZE;
+      ARCHIVE_ENTRY *e = &archive->entries[i];
+      uint32_t name_offset = get32(r + 24);
+
+      e->offset = get64(r);
+      e->size = get64(r + 8);
+      e->stored_size = get64(r + 16);
+      e->name_len = get16(r + 28);
+      e->compression = r[30];
+      e->name = (const char *)p + names_offset + name_offset;
+
+      if (name_offset > names_size ||
+            (uint32_t)e->name_len > names_size - name_offset ||
+            e->name_len >= MAX_PATH_LEN ||
+            e->offset > archive->size ||
+            e->stored_size > archive->size - e->offset ||
+            e->size > SIZE_MAX ||
+            (e->compression == COMPRESSION_NONE &&
+               e->stored_size != e->size) ||
+            e->compression > COMPRESSION_LZ4) {
+         ALLEGRO_ERROR("Invalid archive entry %u.\n", i);
+         return false;
+      }
+      if (i > 0 && compare_name(&archive->entries[i - 1], e->name,
+            e->name_len) >= 0) {
+         ALLEGRO_ERROR("Archive index is not sorted.\n");
+         return false;
+      }
+   }
+
+   archive->num_entries = count;
+   return true;
+}
+
+
+/* Function: al_open_archive
+ */
+ALLEGRO_ARCHIVE *al_open_archive(const char *filename)
+{
+   ALLEGRO_ARCHIVE *archive;
+   size_t size;
+   ASSERT(filename);
+
+   archive = al_calloc(1, sizeof *archive);
+   if (!archive)
+      return NULL;
+
+   archive->mapping = al_fopen_mmap(filename);
+   if (!archive->mapping) {
+      ALLEGRO_ERROR("Unable to open %s.\n", filename);
+      al_free(archive);
+      return NULL;
+   }
+   archive->data = al_fget_mapped_buffer(archive->mapping, &size);
+   archive->size = size;
+
+   if (!read_index(archive)) {
+      al_close_archive(archive);
+      return NULL;
+   }
+
+   ALLEGRO_INFO("Opened %s with %d entries.\n", filename,
+      archive->num_entries);
+   return archive;
+}
+
+
+/* Function: al_close_archive
+ */
+void al_close_archive(ALLEGRO_ARCHIVE *archive)
+{
+   if (!archive)
+      return;
+
+   al_unmount_archive(archive);
+   al_fclose(archive->mapping);
+   al_free(archive->entries);
+   al_free(archive);
+}
+
+
+/* Function: al_mount_archive
+ */
+bool al_mount_archive(ALLEGRO_ARCHIVE *archive)
+{
+   ALLEGRO_ARCHIVE **slot;
+   ASSERT(archive);
+
+   if (_al_vector_contains(&mounted, &archive))
+      return true;
+   slot = _al_vector_alloc_back(&mounted);
+   if (!slot)
+      return false;
+   *slot = archive;
+   return true;
+}
+
+
+/* Function: al_unmount_archive
+ */
+bool al_unmount_archive(ALLEGRO_ARCHIVE *archive)
+{
+   bool found = _al_vector_find_and_delete(&mounted, &archive);
+
+   if (_al_vector_is_empty(&mounted))
+      _al_vector_free(&mounted);
+   return found;
+}
+
+
+static ALLEGRO_ARCHIVE *get_mounted(int i)
+{
+   return *(ALLEGRO_ARCHIVE **)_al_vector_ref(&mounted, i);
+}
+
+
+static ARCHIVE_FILE *open_entry(const ALLEGRO_ARCHIVE *archive,
+   const ARCHIVE_ENTRY *e)
+{
+   ARCHIVE_FILE *af = al_calloc(1, sizeof *af);
+   const unsigned char *src = archive->data + e->offset;
+
+   if (!af)
+      return NULL;
+
+   af->size = e->size;
+   if (e->compression == COMPRESSION_NONE) {
+      af->data = src;
+      return af;
+   }
+
+   af->unpacked = al_malloc(e->size ? e->size : 1);
+   if (!af->unpacked) {
+      al_free(af);
+      return NULL;
+   }
+   if (!lz4_decode(src, e->stored_size, af->unpacked, e->size)) {
+      ALLEGRO_ERROR("Corrupt archive entry %.*s.\n", e->name_len, e->name);
+      al_set_errno(EIO);
+      al_free(af->unpacked);
+      al_free(af);
+      return NULL;
+   }
+   af->data = af->unpacked;
+   return af;
+}
+
+
+/* Function: al_fopen_archive_entry
+ */
+ALLEGRO_FILE *al_fopen_archive_entry(ALLEGRO_ARCHIVE *archive,
+   const char *path)
+{
+   char name[MAX_PATH_LEN];
+   const ARCHIVE_ENTRY *e;
+   ARCHIVE_FILE *af;
+   ALLEGRO_FILE *f;
+   ASSERT(archive);
+   ASSERT(path);
+
+   /* Entries of a given archive are always named from its root. */
+   if (!normalise_path(path, "", name, sizeof name) ||
+         !(e = find_file(archive, name))) {
+      al_set_errno(ENOENT);
+      return NULL;
+   }
+
+   af = open_entry(archive, e);
+   if (!af)
+      return NULL;
+   f = al_create_file_handle(&archive_file_vtable, af);
+   if (!f) {
+      al_free(af->unpacked);
+      al_free(af);
+   }
+   return f;
+}
+
+
+static void *archive_fopen(const char *path, const char *mode)
+{
+   char name[MAX_PATH_LEN];
+   int i;
+
+   if (strpbrk(mode, "wa+")) {
+      al_set_errno(EACCES);
+      return NULL;
+   }
+   if (!normalise_path(path, archive_cwd, name, sizeof name)) {
+      al_set_errno(ENOENT);
+      return NULL;
+   }
+
+   for (i = _al_vector_size(&mounted) - 1; i >= 0; i--) {
+      ALLEGRO_ARCHIVE *archive = get_mounted(i);
+      const ARCHIVE_ENTRY *e = find_file(archive, name);
+      if (e)
+         return open_entry(archive, e);
+   }
+
+   al_set_errno(ENOENT);
+   return NULL;
+}
+
+
+static bool archive_fclose(ALLEGRO_FILE *f)
+{
+   ARCHIVE_FILE *af = al_get_file_userdata(f);
+
+   al_free(af->unpacked);
+   al_free(af);
+   return true;
+}
+
+
+static size_t archive_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
+{
+   ARCHIVE_FILE *af = al_get_file_userdata(f);
+   size_t n = size;
+
+   if (af->size - af->pos < size) {
+      n = af->size - af->pos;
+      af->eof = true;
+   }
+
+   memcpy(ptr, af->data + af->pos, n);
+   af->pos += n;
+
+   return n;
+}
+
+
+static size_t archive_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
+{
+   (void)f;
+   (void)ptr;
+   (void)size;
+   al_set_errno(EPERM);
+   return 0;
+}
+
+
+static bool archive_fflush(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return true;
+}
+
+
+static int64_t archive_ftell(ALLEGRO_FILE *f)
+{
+   ARCHIVE_FILE *af = al_get_file_userdata(f);
+   return af->pos;
+}
+
+
+static bool archive_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
+{
+   ARCHIVE_FILE *af = al_get_file_userdata(f);
+   int64_t pos;
+
+   switch (whence) {
+      case ALLEGRO_SEEK_SET: pos = offset; break;
+      case ALLEGRO_SEEK_CUR: pos = (int64_t)af->pos + offset; break;
+      case ALLEGRO_SEEK_END: pos = (int64_t)af->size + offset; break;
+      default:
+         al_set_errno(EINVAL);
+         return false;
+   }
+
+   if (pos < 0) {
+      al_set_errno(EINVAL);
+      return false;
+   }
+   if (pos > (int64_t)af->size)
+      pos = af->size;
+
+   af->pos = pos;
+   af->eof = false;
+   return true;
+}
+
+
+static bool archive_feof(ALLEGRO_FILE *f)
+{
+   ARCHIVE_FILE *af = al_get_file_userdata(f);
+   return af->eof;
+}
+
+
+static int archive_ferror(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return 0;
+}
+
+
+static const char *archive_ferrmsg(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return "";
+}
+
+
+static void archive_fclearerr(ALLEGRO_FILE *f)
+{
+   ARCHIVE_FILE *af = al_get_file_userdata(f);
+   af->eof = false;
+}
+
+
+static off_t archive_fsize(ALLEGRO_FILE *f)
+{
+   ARCHIVE_FILE *af = al_get_file_userdata(f);
+   return af->size;
+}
+
+
+static const ALLEGRO_FILE_INTERFACE archive_file_vtable =
+{
+   archive_fopen,
+   archive_fclose,
+   archive_fread,
+   archive_fwrite,
+   archive_fflush,
+   archive_ftell,
+   archive_fseek,
+   archive_feof,
+   archive_ferror,
+   archive_ferrmsg,
+   archive_fclearerr,
+   NULL,    /* ungetc */
+   archive_fsize
+};
+
+
+/*
+ * Filesystem interface over the mounted archives.
+ */
+
+static const ARCHIVE_ENTRY *find_mounted_file(const char *name)
+{
+   int i;
+
+   for (i = _al_vector_size(&mounted) - 1; i >= 0; i--) {
+      const ARCHIVE_ENTRY *e = find_file(get_mounted(i), name);
+      if (e)
+         return e;
+   }
+   return NULL;
+}
+
+
+static bool is_mounted_directory(const char *name)
+{
+   int i;
+
+   if (name[0] == '\0')
+      return true;
+   for (i = _al_vector_size(&mounted) - 1; i >= 0; i--) {
+      if (is_directory(get_mounted(i), name))
+         return true;
+   }
+   return false;
+}
+
+
+static char *dup_string(const char *s, size_t len)
+{
+   char *d = al_malloc(len + 1);
+
+   if (d) {
+      memcpy(d, s, len);
+      d[len] = '\0';
+   }
+   return d;
+}
+
+
+static ALLEGRO_FS_ENTRY *make_entry(const char *path, size_t len)
+{
+   ALLEGRO_FS_ENTRY_ARCHIVE *e = al_calloc(1, sizeof *e);
+
+   if (!e)
+      return NULL;
+   e->fs_entry.vtable = &archive_fs_vtable;
+   e->name = al_malloc(len + 2);
+   if (!e->name) {
+      al_free(e);
+      return NULL;
+   }
+   e->name[0] = '/';
+   memcpy(e->name + 1, path, len);
+   e->name[len + 1] = '\0';
+   e->path = e->name + 1;
+   return &e->fs_entry;
+}
+
+
+static ALLEGRO_FS_ENTRY *fs_archive_create_entry(const char *path)
+{
+   char name[MAX_PATH_LEN];
+
+   if (!normalise_path(path, archive_cwd, name, sizeof name))
+      return NULL;
+   return make_entry(name, strlen(name));
+}
+
+
+static bool fs_archive_close_directory(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_ARCHIVE *e = (ALLEGRO_FS_ENTRY_ARCHIVE *)fse;
+
+   al_free(e->last_child);
+   e->last_child = NULL;
+   e->is_dir_open = false;
+   return true;
+}
+
+
+static void fs_archive_destroy_entry(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_ARCHIVE *e = (ALLEGRO_FS_ENTRY_ARCHIVE *)fse;
+
+   if (e->is_dir_open)
+      fs_archive_close_directory(fse);
+   al_free(e->name);
+   al_free(e);
+}
+
+
+static const char *fs_archive_entry_name(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_ARCHIVE *e = (ALLEGRO_FS_ENTRY_ARCHIVE *)fse;
+   return e->name;
+}
+
+
+static bool fs_archive_update_entry(ALLEGRO_FS_ENTRY *fse)
+{
+   (void)fse;
+   return true;
+}
+
+
+static uint32_t fs_archive_entry_mode(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_ARCHIVE *e = (ALLEGRO_FS_ENTRY_ARCHIVE *)fse;
+
+   if (find_mounted_file(e->path))
+      return ALLEGRO_FILEMODE_READ | ALLEGRO_FILEMODE_ISFILE;
+   if (is_mounted_directory(e->path))
+      return ALLEGRO_FILEMODE_READ | ALLEGRO_FILEMODE_ISDIR |
+         ALLEGRO_FILEMODE_EXECUTE;
+   return 0;
+}
+
+
+static time_t fs_archive_entry_time(ALLEGRO_FS_ENTRY *fse)
+{
+   (void)fse;
+   return 0;
+}
+
+
+static off_t fs_archive_entry_size(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_ARCHIVE *e = (ALLEGRO_FS_ENTRY_ARCHIVE *)fse;
+   const ARCHIVE_ENTRY *ae = find_mounted_file(e->path);
+
+   return ae ? (off_t)ae->size : 0;
+}
+
+
+static bool fs_archive_entry_exists(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_ARCHIVE *e = (ALLEGRO_FS_ENTRY_ARCHIVE *)fse;
+   return find_mounted_file(e->path) || is_mounted_directory(e->path);
+}
+
+
+static bool fs_archive_remove_entry(ALLEGRO_FS_ENTRY *fse)
+{
+   (void)fse;
+   al_set_errno(EACCES);
+   return false;
+}
+
+
+static bool fs_archive_open_directory(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_ARCHIVE *e = (ALLEGRO_FS_ENTRY_ARCHIVE *)fse;
+
+   if (!is_mounted_directory(e->path))
+      return false;
+   if (e->is_dir_open)
+      fs_archive_close_directory(fse);
+
+   e->list_archive = _al_vector_size(&mounted);
+   e->list_pos = -1;
+   e->is_dir_open = true;
+   return true;
+}
+
+
+/* Whether an archive mounted after the given one, which therefore shadows
+ * it, already contains name.
+ */
+static bool is_shadowed(int archive_index, const char *name)
+{
+   unsigned i;
+
+   for (i = archive_index + 1; i < _al_vector_size(&mounted); i++) {
+      ALLEGRO_ARCHIVE *archive = get_mounted(i);
+      if (find_file(archive, name) || is_directory(archive, name))
+         return true;
+   }
+   return false;
+}
+
+
+static ALLEGRO_FS_ENTRY *fs_archive_read_directory(ALLEGRO_FS_ENTRY *fse)
+{
+   ALLEGRO_FS_ENTRY_ARCHIVE *e = (ALLEGRO_FS_ENTRY_ARCHIVE *)fse;
+   char prefix[MAX_PATH_LEN + 1];
+   size_t prefix_len = strlen(e->path);
+   ALLEGRO_FS_ENTRY *next;
+
+   if (!e->is_dir_open)
+      return NULL;
+   if ((unsigned)e->list_archive > _al_vector_size(&mounted)) {
+      e->list_archive = _al_vector_size(&mounted);
+      e->list_pos = -1;
+   }
+
+   memcpy(prefix, e->path, prefix_len);
+   if (prefix_len > 0)
+      prefix[prefix_len++] = '/';
+
+   /* The archives are listed from the last mounted one. Each archive's
+    * entries below the directory are adjacent in its index, and so are those
+    * below each child directory.
+    */
+   for (;;) {
+      ALLEGRO_ARCHIVE *archive;
+
+      if (e->list_pos < 0) {
+         if (e->list_archive == 0)
+            return NULL;
+         e->list_archive--;
+         e->list_pos = lower_bound(get_mounted(e->list_archive), prefix,
+            prefix_len);
+         al_free(e->last_child);
+         e->last_child = NULL;
+      }
+      archive = get_mounted(e->list_archive);
+
+      while (e->list_pos < archive->num_entries) {
+         const ARCHIVE_ENTRY *ae = &archive->entries[e->list_pos];
+         const char *child;
+         const char *slash;
+         size_t child_len;
+
+         if ((size_t)ae->name_len <= prefix_len ||
+               memcmp(ae->name, prefix, prefix_len) != 0) {
+            break;
+         }
+         e->list_pos++;
+
+         child = ae->name + prefix_len;
+         slash = memchr(child, '/', ae->name_len - prefix_len);
+         child_len = slash ? (size_t)(slash - child)
+            : ae->name_len - prefix_len;
+
+         if (e->last_child && strlen(e->last_child) == child_len &&
+               memcmp(e->last_child, child, child_len) == 0) {
+            continue;
+         }
+         al_free(e->last_child);
+         e->last_child = dup_string(child, child_len);
+
+         next = make_entry(ae->name, prefix_len + child_len);
+         if (next && is_shadowed(e->list_archive,
+               ((ALLEGRO_FS_ENTRY_ARCHIVE *)next)->path)) {
+            fs_archive_destroy_entry(next);
+            continue;
+         }
+         return next;
+      }
+
+      e->list_pos = -1;
+   }
+}
+
+
+static bool fs_archive_filename_exists(const char *path)
+{
+   char name[MAX_PATH_LEN];
+
+   if (!normalise_path(path, archive_cwd, name, sizeof name))
+      return false;
+   return find_mounted_file(name) || is_mounted_directory(name);
+}
+
+
+static bool fs_archive_remove_filename(const char *path)
+{
+   (void)path;
+   al_set_errno(EACCES);
+   return false;
+}
+
+
+static char *fs_archive_get_current_directory(void)
+{
+   size_t len = strlen(archive_cwd);
+   char *s = al_malloc(len + 3);
+
+   if (s) {
+      s[0] = '/';
+      memcpy(s + 1, archive_cwd, len);
+      if (len > 0)
+         s[++len] = '/';
+      s[len + 1] = '\0';
+   }
+   return s;
+}
+
+
+static bool fs_archive_change_directory(const char *path)
+{
+   char name[MAX_PATH_LEN];
+
+   if (!normalise_path(path, archive_cwd, name, sizeof name) ||
+         !is_mounted_directory(name)) {
+      al_set_errno(ENOENT);
+      return false;
+   }
+   strcpy(archive_cwd, name);
+   return true;
+}
+
+
+static bool fs_archive_make_directory(const char *path)
+{
+   (void)path;
+   al_set_errno(EACCES);
+   return false;
+}
+
+
+static ALLEGRO_FILE *fs_archive_open_file(ALLEGRO_FS_ENTRY *fse,
+   const char *mode)
+{
+   ALLEGRO_FS_ENTRY_ARCHIVE *e = (ALLEGRO_FS_ENTRY_ARCHIVE *)fse;
+   return al_fopen_interface(&archive_file_vtable, e->name, mode);
+}
+
+
+static const ALLEGRO_FS_INTERFACE archive_fs_vtable =
+{
+   fs_archive_create_entry,
+   fs_archive_destroy_entry,
+   fs_archive_entry_name,
+   fs_archive_update_entry,
+   fs_archive_entry_mode,
+   fs_archive_entry_time,
+   fs_archive_entry_time,
+   fs_archive_entry_time,
+   fs_archive_entry_size,
+   fs_archive_entry_exists,
+   fs_archive_remove_entry,
+
+   fs_archive_open_directory,
+   fs_archive_read_directory,
+   fs_archive_close_directory,
+
+   fs_archive_filename_exists,
+   fs_archive_remove_filename,
+   fs_archive_get_current_directory,
+   fs_archive_change_directory,
+   fs_archive_make_directory,
+
+   fs_archive_open_file
+};
+
+
+/* Function: al_set_archive_file_interface
+ */
+void al_set_archive_file_interface(void)
+{
+   al_set_new_file_interface(&archive_file_vtable);
+   al_set_fs_interface(&archive_fs_vtable);
+}
+
+/* vim: set sts=3 sw=3 et: */
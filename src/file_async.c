@@ -0,0 +1,351 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Asynchronous file reads.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <stdlib.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_file.h"
+#include "allegro5/internal/aintern_system.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("file")
+
+#define DEFAULT_READ_THREADS 4
+#define MAX_READ_THREADS 32
+
+
+/*
+ * Reads are carried out by a small pool of I/O threads, so that several
+ * requests can be in flight at once. Standard and memory-mapped files are
+ * read with positional reads which leave the file position alone and need no
+ * locking. All other file interfaces (PhysFS, slices, user interfaces) only
+ * have fseek and fread, so those reads are serialised by generic_mutex.
+ *
+ * Events are emitted by one internal event source per queue, reused like the
+ * ones in bitmap_async.c.
+ */
+
+typedef struct READ_SOURCE
+{
+   ALLEGRO_EVENT_SOURCE es;
+   int num_jobs;
+} READ_SOURCE;
+
+typedef struct READ_JOB READ_JOB;
+
+struct READ_JOB
+{
+   READ_JOB *next;
+   int id;
+   ALLEGRO_FILE *file;
+   int64_t offset;
+   void *buffer;
+   size_t size;
+   size_t bytes_read;
+   int error;
+   READ_SOURCE *source;
+};
+
+typedef struct JOB_LIST
+{
+   READ_JOB *head;
+   READ_JOB *tail;
+} JOB_LIST;
+
+static ALLEGRO_MUTEX *async_mutex = NULL;
+static ALLEGRO_COND *async_cond = NULL;
+static ALLEGRO_MUTEX *generic_mutex = NULL;
+static _AL_THREAD *read_threads = NULL;
+static int num_read_threads = 0;
+static bool stop_read_threads = false;
+
+static JOB_LIST pending_jobs;
+static int next_id = 1;
+
+static _AL_VECTOR read_sources = _AL_VECTOR_INITIALIZER(READ_SOURCE *);
+
+
+static void push_job(JOB_LIST *list, READ_JOB *job)
+{
+   job->next = NULL;
+   if (list->tail)
+      list->tail->next = job;
+   else
+      list->head = job;
+   list->tail = job;
+}
+
+
+static READ_JOB *pop_job(JOB_LIST *list)
+{
+   READ_JOB *job = list->head;
+
+   if (job) {
+      list->head = job->next;
+      if (!list->head)
+         list->tail = NULL;
+   }
+   return job;
+}
+
+
+/* Emits the event for a finished job and frees it.
+ * Must be called with async_mutex held.
+ */
+static void finish_job(READ_JOB *job)
+{
+   ALLEGRO_EVENT_SOURCE *es = &job->source->es;
+   ALLEGRO_EVENT event;
+
+   _al_event_source_lock(es);
+   if (_al_event_source_needs_to_generate_event(es)) {
+      event.file.type = ALLEGRO_EVENT_FILE_READ;
+      event.file.timestamp = al_get_time();
+      event.file.file = job->file;
+      event.file.buffer = job->buffer;
+      event.file.size = job->size;
+      event.file.bytes_read = job->bytes_read;
+      event.file.id = job->id;
+      event.file.error = job->error;
+      _al_event_source_emit_event(es, &event);
+   }
+   _al_event_source_unlock(es);
+
+   job->source->num_jobs--;
+   al_free(job);
+}
+
+
+static void read_job(READ_JOB *job)
+{
+   ALLEGRO_FILE *f = job->file;
+
+   if (_al_file_stdio_pread(f, job->offset, job->buffer, job->size,
+         &job->bytes_read, &job->error)) {
+      return;
+   }
+   if (_al_file_mmap_pread(f, job->offset, job->buffer, job->size,
+         &job->bytes_read)) {
+      return;
+   }
+
+   al_lock_mutex(generic_mutex);
+   al_set_errno(0);
+   if (al_fseek(f, job->offset, ALLEGRO_SEEK_SET)) {
+      job->bytes_read = al_fread(f, job->buffer, job->size);
+      if (job->bytes_read < job->size && al_ferror(f))
+         job->error = al_get_errno() ? al_get_errno() : EIO;
+   }
+   else {
+      job->error = al_get_errno() ? al_get_errno() : EINVAL;
+   }
+   al_unlock_mutex(generic_mutex);
+}
+
+
+static void read_thread_proc(_AL_THREAD *self, void *unused)
+{
+   (void)self;
+   (void)unused;
+
+   al_lock_mutex(async_mutex);
+   while (!stop_read_threads) {
+      READ_JOB *job = pop_job(&pending_jobs);
+
+      if (!job) {
+         al_wait_cond(async_cond, async_mutex);
+         continue;
+      }
+
+      al_unlock_mutex(async_mutex);
+      read_job(job);
+      al_lock_mutex(async_mutex);
+
+      finish_job(job);
+   }
+   al_unlock_mutex(async_mutex);
+}
+
+
+static int get_thread_count(void)
+{
+   const char *p;
+   int n = DEFAULT_READ_THREADS;
+
+   p = al_get_config_value(al_get_system_config(), "file",
+      "async_read_threads");
+   if (p && p[0] != '\0')
+      n = atoi(p);
+
+   if (n < 1)
+      n = 1;
+   if (n > MAX_READ_THREADS)
+      n = MAX_READ_THREADS;
+   return n;
+}
+
+
+/* Must be called with async_mutex held. */
+static void start_read_threads(void)
+{
+   int n = get_thread_count();
+   int i;
+
+   read_threads = al_calloc(n, sizeof(_AL_THREAD));
+   if (!read_threads)
+      return;
+   for (i = 0; i < n; i++)
+      _al_thread_create(&read_threads[i], read_thread_proc, NULL);
+   num_read_threads = n;
+   ALLEGRO_INFO("Started %d file reading threads\n", n);
+}
+
+
+/* Must be called with async_mutex held. */
+static READ_SOURCE *get_source(ALLEGRO_EVENT_QUEUE *queue)
+{
+   READ_SOURCE **slot;
+   READ_SOURCE *unused = NULL;
+   unsigned i;
+
+   for (i = 0; i < _al_vector_size(&read_sources); i++) {
+      READ_SOURCE *source = *(READ_SOURCE **)_al_vector_ref(&read_sources, i);
+
+      if (al_is_event_source_registered(queue, &source->es))
+         return source;
+      if (!unused && source->num_jobs == 0 &&
+            !_al_event_source_needs_to_generate_event(&source->es)) {
+         unused = source;
+      }
+   }
+
+   if (!unused) {
+      unused = al_calloc(1, sizeof *unused);
+      if (!unused)
+         return NULL;
+      slot = _al_vector_alloc_back(&read_sources);
+      if (!slot) {
+         al_free(unused);
+         return NULL;
+      }
+      *slot = unused;
+      _al_event_source_init(&unused->es);
+   }
+
+   al_register_event_source(queue, &unused->es);
+   return unused;
+}
+
+
+static void shutdown_async_reading(void)
+{
+   READ_JOB *job;
+   unsigned i;
+   int j;
+
+   if (read_threads) {
+      al_lock_mutex(async_mutex);
+      stop_read_threads = true;
+      al_broadcast_cond(async_cond);
+      al_unlock_mutex(async_mutex);
+
+      for (j = 0; j < num_read_threads; j++)
+         _al_thread_join(&read_threads[j]);
+      al_free(read_threads);
+      read_threads = NULL;
+   }
+   num_read_threads = 0;
+   stop_read_threads = false;
+
+   while ((job = pop_job(&pending_jobs)))
+      al_free(job);
+
+   for (i = 0; i < _al_vector_size(&read_sources); i++) {
+      READ_SOURCE *source = *(READ_SOURCE **)_al_vector_ref(&read_sources, i);
+      _al_event_source_free(&source->es);
+      al_free(source);
+   }
+   _al_vector_free(&read_sources);
+
+   al_destroy_mutex(generic_mutex);
+   al_destroy_cond(async_cond);
+   al_destroy_mutex(async_mutex);
+   generic_mutex = NULL;
+   async_cond = NULL;
+   async_mutex = NULL;
+}
+
+
+void _al_init_async_file_reading(void)
+{
+   async_mutex = al_create_mutex();
+   async_cond = al_create_cond();
+   generic_mutex = al_create_mutex();
+   _al_add_exit_func(shutdown_async_reading, "shutdown_async_reading");
+}
+
+
+/* Function: al_fread_async
+ */
+int al_fread_async(ALLEGRO_FILE *f, int64_t offset, void *buf, size_t size,
+   ALLEGRO_EVENT_QUEUE *queue)
+{
+   READ_JOB *job;
+   int id;
+
+   ASSERT(f);
+   ASSERT(buf);
+   ASSERT(queue);
+
+   if (!async_mutex || offset < 0)
+      return 0;
+
+   job = al_calloc(1, sizeof *job);
+   if (!job)
+      return 0;
+   job->file = f;
+   job->offset = offset;
+   job->buffer = buf;
+   job->size = size;
+
+   al_lock_mutex(async_mutex);
+
+   if (!read_threads)
+      start_read_threads();
+   job->source = read_threads ? get_source(queue) : NULL;
+   if (!job->source) {
+      al_unlock_mutex(async_mutex);
+      ALLEGRO_ERROR("Could not queue read request.\n");
+      al_free(job);
+      return 0;
+   }
+
+   id = job->id = next_id;
+   if (++next_id <= 0)
+      next_id = 1;
+   job->source->num_jobs++;
+   push_job(&pending_jobs, job);
+   al_signal_cond(async_cond);
+
+   al_unlock_mutex(async_mutex);
+
+   return id;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -0,0 +1,413 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Memory-mapped, read-only files.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_file.h"
+
+#if defined(ALLEGRO_WINDOWS)
+   #include <windows.h>
+   #include "allegro5/internal/aintern_wunicode.h"
+#elif defined(ALLEGRO_HAVE_MMAP)
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <unistd.h>
+#endif
+
+ALLEGRO_DEBUG_CHANNEL("mmap")
+
+
+typedef struct MMAP_DATA MMAP_DATA;
+
+struct MMAP_DATA
+{
+   const unsigned char *data;
+   size_t size;
+   size_t pos;
+   bool eof;
+   bool mapped;   /* false if data came from al_malloc */
+#ifdef ALLEGRO_WINDOWS
+   HANDLE mapping;
+#endif
+};
+
+
+static void unmap_data(MMAP_DATA *mm)
+{
+   if (mm->mapped) {
+#if defined(ALLEGRO_WINDOWS)
+      UnmapViewOfFile((void *)mm->data);
+      CloseHandle(mm->mapping);
+#elif defined(ALLEGRO_HAVE_MMAP)
+      munmap((void *)mm->data, mm->size);
+#endif
+   }
+   else {
+      al_free((void *)mm->data);
+   }
+
+   al_free(mm);
+}
+
+
+static bool mmap_fclose(ALLEGRO_FILE *f)
+{
+   unmap_data(al_get_file_userdata(f));
+   return true;
+}
+
+
+static size_t mmap_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
+{
+   MMAP_DATA *mm = al_get_file_userdata(f);
+   size_t n = size;
+
+   if (mm->size - mm->pos < size) {
+      n = mm->size - mm->pos;
+      mm->eof = true;
+   }
+
+   memcpy(ptr, mm->data + mm->pos, n);
+   mm->pos += n;
+
+   return n;
+}
+
+
+static size_t mmap_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
+{
+   (void)f;
+   (void)ptr;
+   (void)size;
+   al_set_errno(EPERM);
+   return 0;
+}
+
+
+static bool mmap_fflush(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return true;
+}
+
+
+static int64_t mmap_ftell(ALLEGRO_FILE *f)
+{
+   MMAP_DATA *mm = al_get_file_userdata(f);
+   return mm->pos;
+}
+
+
+static bool mmap_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
+{
+   MMAP_DATA *mm = al_get_file_userdata(f);
+   int64_t pos;
+
+   switch (whence) {
+      case ALLEGRO_SEEK_SET: pos = offset; break;
+      case ALLEGRO_SEEK_CUR: pos = (int64_t)mm->pos + offset; break;
+      case ALLEGRO_SEEK_END: pos = (int64_t)mm->size + offset; break;
+      default:
+         al_set_errno(EINVAL);
+         return false;
+   }
+
+   if (pos < 0) {
+      al_set_errno(EINVAL);
+      return false;
+   }
+   if (pos > (int64_t)mm->size)
+      pos = mm->size;
+
+   mm->pos = pos;
+   mm->eof = false;
+   return true;
+}
+
+
+static bool mmap_feof(ALLEGRO_FILE *f)
+{
+   MMAP_DATA *mm = al_get_file_userdata(f);
+   return mm->eof;
+}
+
+
+static int mmap_ferror(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return 0;
+}
+
+
+static const char *mmap_ferrmsg(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return "";
+}
+
+
+static void mmap_fclearerr(ALLEGRO_FILE *f)
+{
+   MMAP_DATA *mm = al_get_file_userdata(f);
+   mm->eof = false;
+}
+
+
+static off_t mmap_fsize(ALLEGRO_FILE *f)
+{
+   MMAP_DATA *mm = al_get_file_userdata(f);
+   return mm->size;
+}
+
+
+static const ALLEGRO_FILE_INTERFACE mmap_vtable =
+{
+   NULL,    /* open */
+   mmap_fclose,
+   mmap_fread,
+   mmap_fwrite,
+   mmap_fflush,
+   mmap_ftell,
+   mmap_fseek,
+   mmap_feof,
+   mmap_ferror,
+   mmap_ferrmsg,
+   mmap_fclearerr,
+   NULL,    /* ungetc */
+   mmap_fsize
+};
+
+
+/* Used by al_fread_async. The mapping is never written to, so this needs no
+ * locking.
+ */
+bool _al_file_mmap_pread(ALLEGRO_FILE *f, int64_t offset, void *ptr,
+   size_t size, size_t *bytes_read)
+{
+   MMAP_DATA *mm;
+   size_t n = 0;
+
+   if (f->vtable != &mmap_vtable)
+      return false;
+   mm = al_get_file_userdata(f);
+
+   if (offset >= 0 && (uint64_t)offset < mm->size) {
+      n = _ALLEGRO_MIN(size, mm->size - (size_t)offset);
+      memcpy(ptr, mm->data + offset, n);
+   }
+   *bytes_read = n;
+   return true;
+}
+
+
+#if defined(ALLEGRO_WINDOWS)
+
+static bool map_file(MMAP_DATA *mm, const char *path)
+{
+   wchar_t *wpath = _al_win_utf8_to_utf16(path);
+   HANDLE file;
+   LARGE_INTEGER size;
+
+   if (!wpath)
+      return false;
+   file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   al_free(wpath);
+   if (file == INVALID_HANDLE_VALUE) {
+      al_set_errno(ENOENT);
+      return false;
+   }
+
+   if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart > SIZE_MAX) {
+      CloseHandle(file);
+      al_set_errno(EFBIG);
+      return false;
+   }
+   mm->size = (size_t)size.QuadPart;
+
+   /* Windows refuses to map empty files. */
+   if (mm->size == 0) {
+      CloseHandle(file);
+      return true;
+   }
+
+   mm->mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+   CloseHandle(file);
+   if (!mm->mapping) {
+      ALLEGRO_WARN("CreateFileMapping failed for %s\n", path);
+      al_set_errno(EACCES);
+      return false;
+   }
+
+   mm->data = MapViewOfFile(mm->mapping, FILE_MAP_READ, 0, 0, 0);
+   if (!mm->data) {
+      ALLEGRO_WARN("MapViewOfFile failed for %s\n", path);
+      CloseHandle(mm->mapping);
+      al_set_errno(ENOMEM);
+      return false;
+   }
+
+   mm->mapped = true;
+   return true;
+}
+
+#elif defined(ALLEGRO_HAVE_MMAP)
+
+static bool map_file(MMAP_DATA *mm, const char *path)
+{
+   struct stat st;
+   void *data;
+   int fd;
+
+   fd = open(path, O_RDONLY);
+   if (fd == -1) {
+      al_set_errno(errno);
+      return false;
+   }
+
+   if (fstat(fd, &st) != 0) {
+      al_set_errno(errno);
+      close(fd);
+      return false;
+   }
+   if ((uint64_t)st.st_size > SIZE_MAX) {
+      al_set_errno(EFBIG);
+      close(fd);
+      return false;
+   }
+   mm->size = st.st_size;
+
+   /* mmap() does not accept a zero length. */
+   if (mm->size == 0) {
+      close(fd);
+      return true;
+   }
+
+   data = mmap(NULL, mm->size, PROT_READ, MAP_PRIVATE, fd, 0);
+   /* The mapping keeps its own reference to the file. */
+   close(fd);
+   if (data == MAP_FAILED) {
+      ALLEGRO_WARN("mmap failed for %s\n", path);
+      al_set_errno(errno);
+      return false;
+   }
+
+   mm->data = data;
+   mm->mapped = true;
+   return true;
+}
+
+#else
+
+/* No mapping support; read the whole file into memory instead so that
+ * al_fget_mapped_buffer still works.
+ */
+static bool map_file(MMAP_DATA *mm, const char *path)
+{
+   ALLEGRO_FILE *fp;
+   int64_t size;
+   void *data;
+
+   fp = al_fopen_interface(&_al_file_interface_stdio, path, "rb");
+   if (!fp)
+      return false;
+
+   size = al_fsize(fp);
+   if (size < 0 || (uint64_t)size > SIZE_MAX) {
+      al_fclose(fp);
+      al_set_errno(EFBIG);
+      return false;
+   }
+   mm->size = size;
+
+   if (mm->size > 0) {
+      data = al_malloc(mm->size);
+      if (!data) {
+         al_fclose(fp);
+         al_set_errno(ENOMEM);
+         return false;
+      }
+      if (al_fread(fp, data, mm->size) != mm->size) {
+         al_free(data);
+         al_fclose(fp);
+         return false;
+      }
+      mm->data = data;
+   }
+
+   al_fclose(fp);
+   return true;
+}
+
+#endif
+
+
+/* Function: al_fopen_mmap
+ */
+ALLEGRO_FILE *al_fopen_mmap(const char *path)
+{
+   ALLEGRO_FILE *f;
+   MMAP_DATA *mm;
+
+   ASSERT(path);
+
+   mm = al_calloc(1, sizeof(*mm));
+   if (!mm) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   ALLEGRO_DEBUG("mapping %s\n", path);
+
+   if (!map_file(mm, path)) {
+      al_free(mm);
+      return NULL;
+   }
+
+   f = al_create_file_handle(&mmap_vtable, mm);
+   if (!f) {
+      unmap_data(mm);
+      return NULL;
+   }
+
+   return f;
+}
+
+
+/* Function: al_fget_mapped_buffer
+ */
+const void *al_fget_mapped_buffer(ALLEGRO_FILE *f, size_t *size)
+{
+   static const unsigned char empty[1] = {0};
+   MMAP_DATA *mm;
+   size_t pos;
+
+   ASSERT(f);
+
+   /* Bytes pushed back with al_fungetc are not part of the mapping. */
+   if (f->vtable != &mmap_vtable || f->ungetc_len > 0)
+      return NULL;
+
+   /* Our position trails the mapping's by whatever was read ahead. */
+   mm = f->userdata;
+   pos = mm->pos - (f->rbuf_len - f->rbuf_pos);
+   if (size)
+      *size = mm->size - pos;
+   return mm->data ? mm->data + pos : empty;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
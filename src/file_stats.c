@@ -0,0 +1,313 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      File I/O statistics.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_file.h"
+#include "allegro5/internal/aintern_vector.h"
+
+
+/*
+ * Files opened while statistics are enabled get a _AL_FILE_STATS, and
+ * al_fread etc. only take the timed paths below for those. The totals per
+ * file interface are kept in a small table guarded by stats_mutex; each
+ * file remembers its slot so that no lookup is needed per call.
+ */
+
+struct _AL_FILE_STATS
+{
+   ALLEGRO_FILE_STATS stats;
+   int slot;
+};
+
+typedef struct INTERFACE_STATS
+{
+   const ALLEGRO_FILE_INTERFACE *vtable;
+   ALLEGRO_FILE_STATS stats;
+} INTERFACE_STATS;
+
+bool _al_file_stats_active = false;
+
+static bool stats_enabled = false;
+static ALLEGRO_MUTEX *stats_mutex = NULL;
+static _AL_VECTOR interface_stats = _AL_VECTOR_INITIALIZER(INTERFACE_STATS);
+
+static ALLEGRO_FILE_IO_CALLBACK slow_callback = NULL;
+static double slow_threshold = 0.0;
+static void *slow_extra = NULL;
+
+
+static void shutdown_file_stats(void)
+{
+   _al_file_stats_active = false;
+   stats_enabled = false;
+   slow_callback = NULL;
+   _al_vector_free(&interface_stats);
+   al_destroy_mutex(stats_mutex);
+   stats_mutex = NULL;
+}
+
+
+static bool init_file_stats(void)
+{
+   if (!stats_mutex) {
+      stats_mutex = al_create_mutex();
+      if (!stats_mutex)
+         return false;
+      _al_add_exit_func(shutdown_file_stats, "shutdown_file_stats");
+   }
+   return true;
+}
+
+
+/* Must be called with stats_mutex held. */
+static int find_slot(const ALLEGRO_FILE_INTERFACE *vtable)
+{
+   INTERFACE_STATS *is;
+   unsigned i;
+
+   for (i = 0; i < _al_vector_size(&interface_stats); i++) {
+      is = _al_vector_ref(&interface_stats, i);
+      if (is->vtable == vtable)
+         return i;
+   }
+
+   is = _al_vector_alloc_back(&interface_stats);
+   if (!is)
+      return -1;
+   memset(is, 0, sizeof *is);
+   is->vtable = vtable;
+   return i;
+}
+
+
+/* Adds delta to the totals of a file's interface. */
+static void add_to_interface(int slot, const ALLEGRO_FILE_STATS *delta)
+{
+   ALLEGRO_FILE_STATS *s;
+
+   if (slot < 0)
+      return;
+
+   al_lock_mutex(stats_mutex);
+   s = &((INTERFACE_STATS *)_al_vector_ref(&interface_stats, slot))->stats;
+   s->opens += delta->opens;
+   s->open_time += delta->open_time;
+   s->reads += delta->reads;
+   s->bytes_read += delta->bytes_read;
+   s->read_time += delta->read_time;
+   s->writes += delta->writes;
+   s->bytes_written += delta->bytes_written;
+   s->seeks += delta->seeks;
+   al_unlock_mutex(stats_mutex);
+}
+
+
+static void report_slow(ALLEGRO_FILE *f, const ALLEGRO_FILE_INTERFACE *vtable,
+   int op, const char *path, size_t size, double seconds)
+{
+   ALLEGRO_FILE_IO_CALLBACK cb = slow_callback;
+
+   if (cb && seconds >= slow_threshold)
+      cb(f, vtable, op, path, size, seconds, slow_extra);
+}
+
+
+void _al_file_stats_open(ALLEGRO_FILE *f, const ALLEGRO_FILE_INTERFACE *vtable,
+   const char *path, double start)
+{
+   ALLEGRO_FILE_STATS delta;
+   double seconds = al_get_time() - start;
+   int slot;
+
+   if (f) {
+      f->stats = al_calloc(1, sizeof *f->stats);
+      if (!f->stats)
+         return;
+   }
+
+   al_lock_mutex(stats_mutex);
+   slot = find_slot(vtable);
+   al_unlock_mutex(stats_mutex);
+
+   memset(&delta, 0, sizeof delta);
+   if (path) {
+      delta.opens = 1;
+      delta.open_time = seconds;
+   }
+   add_to_interface(slot, &delta);
+
+   if (f) {
+      f->stats->stats = delta;
+      f->stats->slot = slot;
+   }
+
+   if (path)
+      report_slow(f, vtable, ALLEGRO_FILE_IO_OPEN, path, 0, seconds);
+}
+
+
+void _al_file_stats_close(ALLEGRO_FILE *f)
+{
+   al_free(f->stats);
+   f->stats = NULL;
+}
+
+
+size_t _al_file_stats_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
+{
+   ALLEGRO_FILE_STATS delta;
+   double start = al_get_time();
+   size_t n = f->vtable->fi_fread(f, ptr, size);
+   double seconds = al_get_time() - start;
+
+   memset(&delta, 0, sizeof delta);
+   delta.reads = 1;
+   delta.bytes_read = n;
+   delta.read_time = seconds;
+
+   f->stats->stats.reads++;
+   f->stats->stats.bytes_read += n;
+   f->stats->stats.read_time += seconds;
+   add_to_interface(f->stats->slot, &delta);
+
+   report_slow(f, f->vtable, ALLEGRO_FILE_IO_READ, NULL, n, seconds);
+   return n;
+}
+
+
+size_t _al_file_stats_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
+{
+   ALLEGRO_FILE_STATS delta;
+   size_t n = f->vtable->fi_fwrite(f, ptr, size);
+
+   memset(&delta, 0, sizeof delta);
+   delta.writes = 1;
+   delta.bytes_written = n;
+
+   f->stats->stats.writes++;
+   f->stats->stats.bytes_written += n;
+   add_to_interface(f->stats->slot, &delta);
+   return n;
+}
+
+
+bool _al_file_stats_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
+{
+   ALLEGRO_FILE_STATS delta;
+
+   memset(&delta, 0, sizeof delta);
+   delta.seeks = 1;
+
+   f->stats->stats.seeks++;
+   add_to_interface(f->stats->slot, &delta);
+   return f->vtable->fi_fseek(f, offset, whence);
+}
+
+
+/* Function: al_set_file_stats_enabled
+ */
+bool al_set_file_stats_enabled(bool enabled)
+{
+   if (enabled && !init_file_stats())
+      return false;
+   stats_enabled = enabled;
+   _al_file_stats_active = stats_enabled || slow_callback;
+   return true;
+}
+
+
+/* Function: al_get_file_stats
+ */
+bool al_get_file_stats(ALLEGRO_FILE *f, ALLEGRO_FILE_STATS *stats)
+{
+   ASSERT(f);
+   ASSERT(stats);
+
+   if (!f->stats) {
+      memset(stats, 0, sizeof *stats);
+      return false;
+   }
+   *stats = f->stats->stats;
+   return true;
+}
+
+
+/* Function: al_get_file_interface_stats
+ */
+bool al_get_file_interface_stats(const ALLEGRO_FILE_INTERFACE *vtable,
+   ALLEGRO_FILE_STATS *stats)
+{
+   bool found = false;
+   unsigned i;
+
+   ASSERT(vtable);
+   ASSERT(stats);
+
+   memset(stats, 0, sizeof *stats);
+   if (!stats_mutex)
+      return false;
+
+   al_lock_mutex(stats_mutex);
+   for (i = 0; i < _al_vector_size(&interface_stats); i++) {
+      INTERFACE_STATS *is = _al_vector_ref(&interface_stats, i);
+      if (is->vtable == vtable) {
+         *stats = is->stats;
+         found = true;
+         break;
+      }
+   }
+   al_unlock_mutex(stats_mutex);
+
+   return found;
+}
+
+
+/* Function: al_reset_file_interface_stats
+ */
+void al_reset_file_interface_stats(void)
+{
+   unsigned i;
+
+   if (!stats_mutex)
+      return;
+
+   al_lock_mutex(stats_mutex);
+   for (i = 0; i < _al_vector_size(&interface_stats); i++) {
+      INTERFACE_STATS *is = _al_vector_ref(&interface_stats, i);
+      memset(&is->stats, 0, sizeof is->stats);
+   }
+   al_unlock_mutex(stats_mutex);
+}
+
+
+/* Function: al_set_slow_file_io_callback
+ */
+bool al_set_slow_file_io_callback(ALLEGRO_FILE_IO_CALLBACK callback,
+   double threshold, void *extra)
+{
+   if (callback && !init_file_stats())
+      return false;
+   slow_threshold = threshold;
+   slow_extra = extra;
+   slow_callback = callback;
+   _al_file_stats_active = stats_enabled || slow_callback;
+   return true;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -39,6 +39,16 @@
 #include <sys/stat.h>
 #endif
 
+#ifdef ALLEGRO_WINDOWS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
 ALLEGRO_DEBUG_CHANNEL("stdio")
 
 /* forward declaration */
@@ -102,6 +112,41 @@ ALLEGRO_FILE *al_fopen_fd(int fd, const char *mode)
 }
 
 
+#ifdef __EMSCRIPTEN__
+/* fetch_missing_file:
+ *  Download a file that is not in the virtual file system from the same
+ *  path relative to the page. With Asyncify the browser keeps running
+ *  while it arrives, so assets need not be preloaded before main() starts.
+ */
+static bool fetch_missing_file(const char *path)
+{
+   const char *value;
+   const char *url = path;
+   ALLEGRO_PATH *dir;
+
+   if (!emscripten_has_asyncify())
+      return false;
+
+   value = al_get_config_value(al_get_system_config(), "emscripten",
+      "fetch_missing_files");
+   if (value && _al_stricmp(value, "false") == 0)
+      return false;
+
+   dir = al_create_path(path);
+   if (dir) {
+      al_set_path_filename(dir, NULL);
+      al_make_directory(al_path_cstr(dir, '/'));
+      al_destroy_path(dir);
+   }
+
+   while (*url == '/')
+      url++;
+   ALLEGRO_DEBUG("fetching %s\n", url);
+   return emscripten_wget(url, path) == 0;
+}
+#endif
+
+
 static void *file_stdio_fopen(const char *path, const char *mode)
 {
    FILE *fp;
@@ -119,6 +164,10 @@ static void *file_stdio_fopen(const char *path, const char *mode)
    }
 #else
    fp = fopen(path, mode);
+#ifdef __EMSCRIPTEN__
+   if (!fp && errno == ENOENT && mode[0] == 'r' && fetch_missing_file(path))
+      fp = fopen(path, mode);
+#endif
 #endif
 
    if (!fp) {
@@ -380,6 +429,102 @@ const struct ALLEGRO_FILE_INTERFACE _al_file_interface_stdio =
 };
 
 
+#ifdef ALLEGRO_WINDOWS
+typedef HANDLE (WINAPI *REOPENFILE_PROC)(HANDLE, DWORD, DWORD, DWORD);
+
+/* ReOpenFile is only available from Windows Vista on. */
+static REOPENFILE_PROC get_reopen_file(void)
+{
+   static REOPENFILE_PROC proc;
+   static bool looked_up;
+
+   if (!looked_up) {
+      HMODULE kernel32 = GetModuleHandleA("kernel32.dll");
+      if (kernel32)
+         proc = (REOPENFILE_PROC)GetProcAddress(kernel32, "ReOpenFile");
+      looked_up = true;
+   }
+   return proc;
+}
+#endif
+
+
+/* Reads from an absolute offset without touching the file position, so that
+ * several threads can read from the same file at once. Returns false if the
+ * file does not use the stdio interface, or on Windows if it can't be opened
+ * a second time. Used by al_fread_async.
+ */
+bool _al_file_stdio_pread(ALLEGRO_FILE *f, int64_t offset, void *ptr,
+   size_t size, size_t *bytes_read, int *error)
+{
+   USERDATA *userdata;
+   unsigned char *p = ptr;
+   size_t done = 0;
+
+   if (f->vtable != &_al_file_interface_stdio)
+      return false;
+   userdata = get_userdata(f);
+   *error = 0;
+
+#ifdef ALLEGRO_WINDOWS
+   {
+      /* ReadFile moves the position of a handle not opened for overlapped
+       * I/O even when given an offset, so read through a handle of our own.
+       */
+      REOPENFILE_PROC reopen = get_reopen_file();
+      HANDLE handle = INVALID_HANDLE_VALUE;
+
+      if (reopen) {
+         handle = reopen((HANDLE)_get_osfhandle(_fileno(userdata->fp)),
+            GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE |
+            FILE_SHARE_DELETE, 0);
+      }
+      if (handle == INVALID_HANDLE_VALUE)
+         return false;
+
+      while (done < size) {
+         OVERLAPPED ov;
+         DWORD chunk = (DWORD)_ALLEGRO_MIN(size - done, 0x40000000);
+         DWORD n = 0;
+
+         memset(&ov, 0, sizeof(ov));
+         ov.Offset = (DWORD)(offset + done);
+         ov.OffsetHigh = (DWORD)((uint64_t)(offset + done) >> 32);
+         if (!ReadFile(handle, p + done, chunk, &n, &ov)) {
+            if (GetLastError() != ERROR_HANDLE_EOF)
+               *error = EIO;
+            break;
+         }
+         if (n == 0)
+            break;
+         done += n;
+      }
+      CloseHandle(handle);
+   }
+#else
+   {
+      int fd = fileno(userdata->fp);
+
+      while (done < size) {
+         ssize_t n = pread(fd, p + done, size - done, offset + done);
+         if (n < 0) {
+            if (errno == EINTR)
+               continue;
+            *error = errno;
+            break;
+         }
+         if (n == 0)
+            break;
+         done += n;
+      }
+   }
+#endif
+
+   *bytes_read = done;
+   return true;
+}
+
+
 /* Function: al_set_standard_file_interface
  */
 void al_set_standard_file_interface(void)
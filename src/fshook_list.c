@@ -0,0 +1,765 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Batch directory listings.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+/* For statx() and AT_STATX_DONT_SYNC. */
+#if defined __linux__ && !defined _GNU_SOURCE
+   #define _GNU_SOURCE
+#endif
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_fshook.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_vector.h"
+
+#include <string.h>
+
+#if defined(ALLEGRO_WINDOWS)
+   #include <windows.h>
+   #include "allegro5/internal/aintern_wunicode.h"
+#else
+   #include <sys/types.h>
+   #include <sys/stat.h>
+   #include <dirent.h>
+   #include <fcntl.h>
+   #include <unistd.h>
+   #if defined(ALLEGRO_LINUX)
+      #include <sys/syscall.h>
+   #endif
+#endif
+
+ALLEGRO_DEBUG_CHANNEL("fshook")
+
+#define MAX_LIST_THREADS 16
+
+#if defined(ALLEGRO_LINUX) && defined(SYS_getdents64)
+   #define USE_GETDENTS64
+#endif
+
+
+/*
+ * Entries are accumulated with their names in one growing text block and
+ * the name pointers are only filled in once the listing is complete, as the
+ * block may move while it grows.
+ *
+ * For the standard file system interface directories are read natively,
+ * with each entry's metadata queried relative to the open directory rather
+ * than through its full path. A recursive walk keeps a stack of directories
+ * still to be read, so that it can be shared between several threads; each
+ * thread collects its own partial listing and these are merged at the end.
+ * Any other file system interface is walked through the ALLEGRO_FS_ENTRY
+ * functions on the calling thread.
+ */
+
+typedef struct LIST_ENTRY
+{
+   ALLEGRO_FS_LISTING_ENTRY pub;
+   size_t name_offset;
+} LIST_ENTRY;
+
+struct ALLEGRO_FS_LISTING
+{
+   _AL_VECTOR entries;
+   char *names;
+   size_t names_size;
+   size_t names_capacity;
+};
+
+typedef struct LIST_WALK
+{
+   const char *root;
+   bool recursive;
+   ALLEGRO_MUTEX *mutex;
+   ALLEGRO_COND *cond;
+   _AL_VECTOR pending;  /* char *, relative paths of directories to read */
+   int busy;
+} LIST_WALK;
+
+typedef struct LIST_WORKER
+{
+   _AL_THREAD thread;
+   LIST_WALK *walk;
+   ALLEGRO_FS_LISTING listing;
+} LIST_WORKER;
+
+
+static void init_listing(ALLEGRO_FS_LISTING *listing)
+{
+   _al_vector_init(&listing->entries, sizeof(LIST_ENTRY));
+   listing->names = NULL;
+   listing->names_size = 0;
+   listing->names_capacity = 0;
+}
+
+
+static void free_listing(ALLEGRO_FS_LISTING *listing)
+{
+   _al_vector_free(&listing->entries);
+   al_free(listing->names);
+}
+
+
+/* Reserves room for a NUL terminated name of the given length and returns
+ * its offset, or (size_t)-1 on failure.
+ */
+static size_t alloc_name(ALLEGRO_FS_LISTING *listing, size_t len)
+{
+   size_t offset = listing->names_size;
+
+   if (offset + len + 1 > listing->names_capacity) {
+      size_t capacity = listing->names_capacity ? listing->names_capacity : 4096;
+      char *names;
+
+      while (offset + len + 1 > capacity)
+         capacity *= 2;
+      names = al_realloc(listing->names, capacity);
+      if (!names)
+         return (size_t)-1;
+      listing->names = names;
+      listing->names_capacity = capacity;
+   }
+
+   listing->names_size += len + 1;
+   return offset;
+}
+
+
+/* Appends an entry named dir/name, or just name if dir is empty. */
+static bool add_entry(ALLEGRO_FS_LISTING *listing, const char *dir,
+   const char *name, uint32_t mode, off_t size, time_t mtime)
+{
+   size_t dir_len = strlen(dir);
+   size_t name_len = strlen(name);
+   size_t len = dir_len ? dir_len + 1 + name_len : name_len;
+   size_t offset;
+   LIST_ENTRY *e;
+   char *p;
+
+   offset = alloc_name(listing, len);
+   if (offset == (size_t)-1)
+      return false;
+   e = _al_vector_alloc_back(&listing->entries);
+   if (!e) {
+      listing->names_size = offset;
+      return false;
+   }
+
+   p = listing->names + offset;
+   if (dir_len) {
+      memcpy(p, dir, dir_len);
+      p[dir_len] = '/';
+      p += dir_len + 1;
+   }
+   memcpy(p, name, name_len + 1);
+
+   e->name_offset = offset;
+   e->pub.name = NULL;
+   e->pub.mode = mode;
+   e->pub.size = size;
+   e->pub.mtime = mtime;
+   return true;
+}
+
+
+static const char *entry_name(ALLEGRO_FS_LISTING *listing, unsigned i)
+{
+   LIST_ENTRY *e = _al_vector_ref(&listing->entries, i);
+   return listing->names + e->name_offset;
+}
+
+
+/* Moves all entries of src to the end of dst. */
+static bool merge_listing(ALLEGRO_FS_LISTING *dst, ALLEGRO_FS_LISTING *src)
+{
+   size_t base;
+   unsigned i;
+
+   if (src->names_size == 0)
+      return true;
+
+   base = alloc_name(dst, src->names_size - 1);
+   if (base == (size_t)-1)
+      return false;
+   memcpy(dst->names + base, src->names, src->names_size);
+
+   for (i = 0; i < _al_vector_size(&src->entries); i++) {
+      LIST_ENTRY *from = _al_vector_ref(&src->entries, i);
+      LIST_ENTRY *to = _al_vector_alloc_back(&dst->entries);
+      if (!to)
+         return false;
+      *to = *from;
+      to->name_offset += base;
+   }
+   return true;
+}
+
+
+static void finish_listing(ALLEGRO_FS_LISTING *listing)
+{
+   unsigned i;
+
+   for (i = 0; i < _al_vector_size(&listing->entries); i++) {
+      LIST_ENTRY *e = _al_vector_ref(&listing->entries, i);
+      e->pub.name = listing->names + e->name_offset;
+   }
+}
+
+
+/* Returns a newly allocated "dir/name", or name if dir is empty. */
+static char *join_path(const char *dir, const char *name)
+{
+   size_t dir_len = strlen(dir);
+   size_t name_len = strlen(name);
+   char *path = al_malloc(dir_len + 1 + name_len + 1);
+
+   if (!path)
+      return NULL;
+   memcpy(path, dir, dir_len);
+   if (dir_len && name_len && dir[dir_len - 1] != '/' &&
+         dir[dir_len - 1] != ALLEGRO_NATIVE_PATH_SEP) {
+      path[dir_len++] = '/';
+   }
+   memcpy(path + dir_len, name, name_len + 1);
+   return path;
+}
+
+
+/* Remembers the directory rel/name to be read later. */
+static bool push_subdir(_AL_VECTOR *subdirs, const char *rel, const char *name)
+{
+   char *sub = join_path(rel, name);
+   char **slot;
+
+   if (!sub)
+      return false;
+   slot = _al_vector_alloc_back(subdirs);
+   if (!slot) {
+      al_free(sub);
+      return false;
+   }
+   *slot = sub;
+   return true;
+}
+
+
+#if defined(ALLEGRO_WINDOWS)
+
+static time_t filetime_to_time_t(FILETIME ft)
+{
+   uint64_t t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+
+   /* 100ns intervals since 1601 to seconds since 1970. */
+   return (time_t)((t - UINT64_C(116444736000000000)) / 10000000);
+}
+
+
+static uint32_t attributes_to_mode(DWORD attrib)
+{
+   uint32_t mode = ALLEGRO_FILEMODE_READ | ALLEGRO_FILEMODE_EXECUTE;
+
+   if (attrib & FILE_ATTRIBUTE_DIRECTORY)
+      mode |= ALLEGRO_FILEMODE_ISDIR;
+   else
+      mode |= ALLEGRO_FILEMODE_ISFILE;
+   if (!(attrib & FILE_ATTRIBUTE_READONLY))
+      mode |= ALLEGRO_FILEMODE_WRITE;
+   if (attrib & FILE_ATTRIBUTE_HIDDEN)
+      mode |= ALLEGRO_FILEMODE_HIDDEN;
+   return mode;
+}
+
+
+static bool read_native_dir(const char *path, const char *rel,
+   ALLEGRO_FS_LISTING *listing, _AL_VECTOR *subdirs)
+{
+   WIN32_FIND_DATAW data;
+   wchar_t *wpattern;
+   char *pattern;
+   HANDLE h;
+   bool ok = true;
+
+   pattern = join_path(path, "*");
+   if (!pattern)
+      return false;
+   wpattern = _al_win_utf8_to_utf16(pattern);
+   al_free(pattern);
+   if (!wpattern)
+      return false;
+
+   h = FindFirstFileExW(wpattern, FindExInfoBasic, &data,
+      FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+   al_free(wpattern);
+   if (h == INVALID_HANDLE_VALUE) {
+      al_set_errno(ENOENT);
+      return false;
+   }
+
+   do {
+      uint32_t mode;
+      char *name;
+
+      if (wcscmp(data.cFileName, L".") == 0 ||
+            wcscmp(data.cFileName, L"..") == 0) {
+         continue;
+      }
+      name = _al_win_utf16_to_utf8(data.cFileName);
+      if (!name) {
+         ok = false;
+         break;
+      }
+
+      mode = attributes_to_mode(data.dwFileAttributes);
+      ok = add_entry(listing, rel, name, mode,
+         (off_t)(((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow),
+         filetime_to_time_t(data.ftLastWriteTime));
+      if (ok && subdirs && (mode & ALLEGRO_FILEMODE_ISDIR))
+         ok = push_subdir(subdirs, rel, name);
+      al_free(name);
+   } while (ok && FindNextFileW(h, &data));
+
+   FindClose(h);
+   return ok;
+}
+
+#else /* !ALLEGRO_WINDOWS */
+
+static bool is_dot_or_dotdot(const char *name)
+{
+   return name[0] == '.' &&
+      (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+
+static uint32_t stat_to_mode(mode_t st_mode, const char *name)
+{
+   uint32_t mode = 0;
+
+   /* This follows fs_update_stat_mode in fshook_stdio.c. */
+   if (S_ISDIR(st_mode))
+      mode |= ALLEGRO_FILEMODE_ISDIR;
+   else
+      mode |= ALLEGRO_FILEMODE_ISFILE;
+   if (st_mode & (S_IRUSR | S_IRGRP))
+      mode |= ALLEGRO_FILEMODE_READ;
+   if (st_mode & (S_IWUSR | S_IWGRP))
+      mode |= ALLEGRO_FILEMODE_WRITE;
+   if (st_mode & (S_IXUSR | S_IXGRP))
+      mode |= ALLEGRO_FILEMODE_EXECUTE;
+   if (name[0] == '.')
+      mode |= ALLEGRO_FILEMODE_HIDDEN;
+   return mode;
+}
+
+
+/* Queries an entry relative to an open directory and adds it. Entries which
+ * cannot be queried, e.g. dangling symbolic links, are added with everything
+ * but their name zeroed, as al_read_directory would return them.
+ */
+static bool add_native_entry(int dirfd, const char *name, const char *rel,
+   ALLEGRO_FS_LISTING *listing, _AL_VECTOR *subdirs)
+{
+   uint32_t mode = 0;
+   off_t size = 0;
+   time_t mtime = 0;
+   bool done = false;
+
+#if defined(STATX_BASIC_STATS) && defined(AT_STATX_DONT_SYNC)
+   {
+      static bool no_statx = false;
+      struct statx stx;
+
+      if (!no_statx) {
+         if (statx(dirfd, name, AT_STATX_DONT_SYNC,
+               STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME,
+               &stx) == 0) {
+            mode = stat_to_mode(stx.stx_mode, name);
+            size = stx.stx_size;
+            mtime = stx.stx_mtime.tv_sec;
+            done = true;
+         }
+         else if (errno == ENOSYS) {
+            no_statx = true;
+         }
+         else {
+            done = true;
+         }
+      }
+   }
+#endif
+
+   if (!done) {
+      struct stat st;
+      if (fstatat(dirfd, name, &st, 0) == 0) {
+         mode = stat_to_mode(st.st_mode, name);
+#if defined(ALLEGRO_MACOSX) && defined(UF_HIDDEN)
+         if (st.st_flags & UF_HIDDEN)
+            mode |= ALLEGRO_FILEMODE_HIDDEN;
+#endif
+         size = st.st_size;
+         mtime = st.st_mtime;
+      }
+   }
+
+   if (!add_entry(listing, rel, name, mode, size, mtime))
+      return false;
+   if (subdirs && (mode & ALLEGRO_FILEMODE_ISDIR))
+      return push_subdir(subdirs, rel, name);
+   return true;
+}
+
+
+#if defined(USE_GETDENTS64)
+
+/* Not declared by older C libraries. */
+struct linux_dirent64
+{
+   uint64_t d_ino;
+   int64_t d_off;
+   unsigned short d_reclen;
+   unsigned char d_type;
+   char d_name[];
+};
+
+static bool read_native_dir(const char *path, const char *rel,
+   ALLEGRO_FS_LISTING *listing, _AL_VECTOR *subdirs)
+{
+   char buf[32 * 1024];
+   bool ok = true;
+   long n;
+   int fd;
+
+   fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if (fd < 0) {
+      al_set_errno(errno);
+      return false;
+   }
+
+   while (ok && (n = syscall(SYS_getdents64, fd, buf, sizeof buf)) > 0) {
+      long pos = 0;
+      while (ok && pos < n) {
+         struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + pos);
+         if (!is_dot_or_dotdot(d->d_name))
+            ok = add_native_entry(fd, d->d_name, rel, listing, subdirs);
+         pos += d->d_reclen;
+      }
+   }
+   if (n < 0) {
+      al_set_errno(errno);
+      ok = false;
+   }
+
+   close(fd);
+   return ok;
+}
+
+#else /* !USE_GETDENTS64 */
+
+static bool read_native_dir(const char *path, const char *rel,
+   ALLEGRO_FS_LISTING *listing, _AL_VECTOR *subdirs)
+{
+   struct dirent *d;
+   bool ok = true;
+   DIR *dir;
+
+   dir = opendir(path);
+   if (!dir) {
+      al_set_errno(errno);
+      return false;
+   }
+
+   while (ok && (d = readdir(dir))) {
+      if (!is_dot_or_dotdot(d->d_name))
+         ok = add_native_entry(dirfd(dir), d->d_name, rel, listing, subdirs);
+   }
+
+   closedir(dir);
+   return ok;
+}
+
+#endif /* !USE_GETDENTS64 */
+
+#endif /* !ALLEGRO_WINDOWS */
+
+
+static bool read_walk_dir(LIST_WALK *walk, const char *rel,
+   ALLEGRO_FS_LISTING *listing, _AL_VECTOR *subdirs)
+{
+   char *path = join_path(walk->root, rel);
+   bool ok;
+
+   if (!path)
+      return false;
+   ok = read_native_dir(path, rel, listing, walk->recursive ? subdirs : NULL);
+   al_free(path);
+   return ok;
+}
+
+
+/* Reads directories off the walk's stack until no thread has any left.
+ * Unreadable subdirectories are skipped.
+ */
+static void walk_proc(_AL_THREAD *thread, void *arg)
+{
+   LIST_WORKER *worker = arg;
+   LIST_WALK *walk = worker->walk;
+   _AL_VECTOR subdirs = _AL_VECTOR_INITIALIZER(char *);
+   (void)thread;
+
+   al_lock_mutex(walk->mutex);
+   for (;;) {
+      char *rel;
+      unsigned i;
+
+      if (_al_vector_is_empty(&walk->pending)) {
+         if (walk->busy == 0)
+            break;
+         al_wait_cond(walk->cond, walk->mutex);
+         continue;
+      }
+      rel = *(char **)_al_vector_ref_back(&walk->pending);
+      _al_vector_delete_at(&walk->pending, _al_vector_size(&walk->pending) - 1);
+      walk->busy++;
+      al_unlock_mutex(walk->mutex);
+
+      read_walk_dir(walk, rel, &worker->listing, &subdirs);
+      al_free(rel);
+
+      al_lock_mutex(walk->mutex);
+      for (i = 0; i < _al_vector_size(&subdirs); i++) {
+         char **slot = _al_vector_alloc_back(&walk->pending);
+         char *sub = *(char **)_al_vector_ref(&subdirs, i);
+         if (slot)
+            *slot = sub;
+         else
+            al_free(sub);
+      }
+      _al_vector_free(&subdirs);
+      walk->busy--;
+      al_broadcast_cond(walk->cond);
+   }
+   al_broadcast_cond(walk->cond);
+   al_unlock_mutex(walk->mutex);
+}
+
+
+static int get_thread_count(int flags)
+{
+   int n;
+
+   if (!(flags & ALLEGRO_LIST_DIRECTORY_PARALLEL))
+      return 1;
+   n = al_get_cpu_count();
+   if (n < 2)
+      n = 2;
+   if (n > MAX_LIST_THREADS)
+      n = MAX_LIST_THREADS;
+   return n;
+}
+
+
+static bool list_native(ALLEGRO_FS_LISTING *listing, const char *path,
+   int flags)
+{
+   LIST_WORKER workers[MAX_LIST_THREADS];
+   LIST_WALK walk;
+   char **slot;
+   int num_threads;
+   bool ok = true;
+   int i;
+
+   /* The top directory is read on the calling thread, so that failure to
+    * read it can be reported.
+    */
+   walk.root = path;
+   walk.recursive = (flags & ALLEGRO_LIST_DIRECTORY_RECURSIVE) != 0;
+   walk.busy = 0;
+   _al_vector_init(&walk.pending, sizeof(char *));
+   if (!read_walk_dir(&walk, "", listing, &walk.pending)) {
+      for (i = 0; i < (int)_al_vector_size(&walk.pending); i++)
+         al_free(*(char **)_al_vector_ref(&walk.pending, i));
+      _al_vector_free(&walk.pending);
+      return false;
+   }
+   if (_al_vector_is_empty(&walk.pending))
+      return true;
+
+   walk.mutex = al_create_mutex();
+   walk.cond = al_create_cond();
+   if (!walk.mutex || !walk.cond) {
+      al_destroy_mutex(walk.mutex);
+      al_destroy_cond(walk.cond);
+      while (!_al_vector_is_empty(&walk.pending)) {
+         slot = _al_vector_ref_back(&walk.pending);
+         al_free(*slot);
+         _al_vector_delete_at(&walk.pending,
+            _al_vector_size(&walk.pending) - 1);
+      }
+      _al_vector_free(&walk.pending);
+      return false;
+   }
+
+   num_threads = get_thread_count(flags);
+   for (i = 0; i < num_threads; i++) {
+      workers[i].walk = &walk;
+      init_listing(&workers[i].listing);
+   }
+   for (i = 1; i < num_threads; i++)
+      _al_thread_create(&workers[i].thread, walk_proc, &workers[i]);
+   walk_proc(NULL, &workers[0]);
+   for (i = 1; i < num_threads; i++)
+      _al_thread_join(&workers[i].thread);
+
+   if (num_threads > 1)
+      ALLEGRO_DEBUG("Listed %s with %d threads\n", path, num_threads);
+
+   for (i = 0; i < num_threads; i++) {
+      if (ok)
+         ok = merge_listing(listing, &workers[i].listing);
+      free_listing(&workers[i].listing);
+   }
+
+   _al_vector_free(&walk.pending);
+   al_destroy_cond(walk.cond);
+   al_destroy_mutex(walk.mutex);
+   return ok;
+}
+
+
+/* Returns the last component of an entry name. */
+static const char *base_name(const char *path)
+{
+   const char *p = path + strlen(path);
+
+   while (p > path && p[-1] != '/' && p[-1] != ALLEGRO_NATIVE_PATH_SEP)
+      p--;
+   return p;
+}
+
+
+static bool list_fs_entries(ALLEGRO_FS_LISTING *listing, ALLEGRO_FS_ENTRY *dir,
+   const char *rel, bool recursive)
+{
+   ALLEGRO_FS_ENTRY *e;
+   bool ok = true;
+
+   if (!al_open_directory(dir))
+      return false;
+
+   while (ok && (e = al_read_directory(dir))) {
+      uint32_t mode = al_get_fs_entry_mode(e);
+      unsigned i = _al_vector_size(&listing->entries);
+
+      ok = add_entry(listing, rel, base_name(al_get_fs_entry_name(e)), mode,
+         al_get_fs_entry_size(e), al_get_fs_entry_mtime(e));
+      if (ok && recursive && (mode & ALLEGRO_FILEMODE_ISDIR)) {
+         /* The name is copied as the text block may move. */
+         char *sub = join_path(entry_name(listing, i), "");
+         if (sub) {
+            list_fs_entries(listing, e, sub, true);
+            al_free(sub);
+         }
+         else {
+            ok = false;
+         }
+      }
+      al_destroy_fs_entry(e);
+   }
+
+   al_close_directory(dir);
+   return ok;
+}
+
+
+static bool list_generic(ALLEGRO_FS_LISTING *listing, const char *path,
+   int flags)
+{
+   ALLEGRO_FS_ENTRY *dir = al_create_fs_entry(path);
+   bool ok;
+
+   if (!dir)
+      return false;
+   ok = list_fs_entries(listing, dir, "",
+      (flags & ALLEGRO_LIST_DIRECTORY_RECURSIVE) != 0);
+   al_destroy_fs_entry(dir);
+   return ok;
+}
+
+
+/* Function: al_list_directory
+ */
+ALLEGRO_FS_LISTING *al_list_directory(const char *path, int flags)
+{
+   ALLEGRO_FS_LISTING *listing;
+   bool ok;
+   ASSERT(path);
+
+   listing = al_malloc(sizeof *listing);
+   if (!listing) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+   init_listing(listing);
+
+   if (al_get_fs_interface() == &_al_fs_interface_stdio)
+      ok = list_native(listing, path, flags);
+   else
+      ok = list_generic(listing, path, flags);
+
+   if (!ok) {
+      ALLEGRO_WARN("Failed to list directory %s\n", path);
+      al_destroy_fs_listing(listing);
+      return NULL;
+   }
+
+   finish_listing(listing);
+   return listing;
+}
+
+
+/* Function: al_destroy_fs_listing
+ */
+void al_destroy_fs_listing(ALLEGRO_FS_LISTING *listing)
+{
+   if (listing) {
+      free_listing(listing);
+      al_free(listing);
+   }
+}
+
+
+/* Function: al_get_fs_listing_count
+ */
+int al_get_fs_listing_count(const ALLEGRO_FS_LISTING *listing)
+{
+   ASSERT(listing);
+   return _al_vector_size(&listing->entries);
+}
+
+
+/* Function: al_get_fs_listing_entry
+ */
+const ALLEGRO_FS_LISTING_ENTRY *al_get_fs_listing_entry(
+   const ALLEGRO_FS_LISTING *listing, int index)
+{
+   const LIST_ENTRY *e;
+   ASSERT(listing);
+
+   if (index < 0 || index >= (int)_al_vector_size(&listing->entries))
+      return NULL;
+   e = _al_vector_ref(&listing->entries, index);
+   return &e->pub;
+}
+
+/* vim: set sts=3 sw=3 et: */
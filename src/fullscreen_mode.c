@@ -14,8 +14,186 @@
  */
 
 
+#include <string.h>
+
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_display.h"
+#include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_system.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("display")
+
+
+/* Enumerating the modes is a round trip to the X server or the driver for
+ * every mode, so the modes for the last adapter and new display settings
+ * asked about are kept until the platform reports that the monitors
+ * changed. The drivers are never called with mode_cache_mutex held, as
+ * they may report a change from a thread which holds their own locks.
+ */
+typedef struct CACHED_MODE {
+   ALLEGRO_DISPLAY_MODE mode;
+   bool valid;
+} CACHED_MODE;
+
+typedef struct MODE_CACHE_KEY {
+   int adapter;
+   int format;
+   int refresh_rate;
+   int flags;
+} MODE_CACHE_KEY;
+
+static _AL_MUTEX mode_cache_mutex = _AL_MUTEX_UNINITED;
+static _AL_VECTOR mode_cache = _AL_VECTOR_INITIALIZER(CACHED_MODE);
+static MODE_CACHE_KEY mode_cache_key;
+static bool mode_cache_valid = false;
+static unsigned int mode_cache_generation = 0;
+
+
+static void get_cache_key(MODE_CACHE_KEY *key)
+{
+   key->adapter = al_get_new_display_adapter();
+   key->format = _al_deduce_color_format(_al_get_new_display_settings());
+   key->refresh_rate = al_get_new_display_refresh_rate();
+   key->flags = al_get_new_display_flags();
+}
+
+
+/* shutdown_display_modes:
+ *  Clean up after _al_init_display_modes.
+ */
+static void shutdown_display_modes(void)
+{
+   _al_vector_free(&mode_cache);
+   mode_cache_valid = false;
+   _al_mutex_destroy(&mode_cache_mutex);
+}
+
+
+/* _al_init_display_modes:
+ *  Initialise the display mode cache.
+ */
+void _al_init_display_modes(void)
+{
+   _al_mutex_init(&mode_cache_mutex);
+   _al_add_exit_func(shutdown_display_modes, "shutdown_display_modes");
+}
+
+
+/* fill_cache:
+ *  Asks the driver for all modes for key and keeps them, unless the cache
+ *  was invalidated in the meantime.
+ */
+static void fill_cache(ALLEGRO_SYSTEM *system, const MODE_CACHE_KEY *key)
+{
+   _AL_VECTOR modes = _AL_VECTOR_INITIALIZER(CACHED_MODE);
+   unsigned int generation;
+   int n, i;
+
+   _al_mutex_lock(&mode_cache_mutex);
+   generation = mode_cache_generation;
+   _al_mutex_unlock(&mode_cache_mutex);
+
+   /* No modes usually means the driver could not be asked yet. */
+   n = system->vt->get_num_display_modes();
+   if (n <= 0)
+      return;
+
+   for (i = 0; i < n; i++) {
+      CACHED_MODE *cm = _al_vector_alloc_back(&modes);
+      if (!cm) {
+         _al_vector_free(&modes);
+         return;
+      }
+      memset(&cm->mode, 0, sizeof(cm->mode));
+      cm->valid = system->vt->get_display_mode(i, &cm->mode) != NULL;
+   }
+
+   _al_mutex_lock(&mode_cache_mutex);
+   if (generation == mode_cache_generation) {
+      _al_vector_free(&mode_cache);
+      mode_cache = modes;
+      mode_cache_key = *key;
+      mode_cache_valid = true;
+      _al_vector_init(&modes, sizeof(CACHED_MODE));
+      ALLEGRO_DEBUG("Cached %d display modes.\n", n);
+   }
+   _al_mutex_unlock(&mode_cache_mutex);
+
+   _al_vector_free(&modes);
+}
+
+
+/* lookup_cache:
+ *  Returns whether the cache holds the modes for key, and if so their
+ *  number and a copy of the one at index. Mode may be NULL.
+ */
+static bool lookup_cache(const MODE_CACHE_KEY *key, int index,
+   ALLEGRO_DISPLAY_MODE *mode, int *num, bool *valid)
+{
+   bool found = false;
+
+   _al_mutex_lock(&mode_cache_mutex);
+   if (mode_cache_valid &&
+         memcmp(key, &mode_cache_key, sizeof(*key)) == 0) {
+      found = true;
+      *num = _al_vector_size(&mode_cache);
+      if (mode && index >= 0 && index < *num) {
+         const CACHED_MODE *cm = _al_vector_ref(&mode_cache, index);
+         *mode = cm->mode;
+         *valid = cm->valid;
+      }
+   }
+   _al_mutex_unlock(&mode_cache_mutex);
+
+   return found;
+}
+
+
+/* _al_invalidate_display_modes:
+ *  Forget the cached modes, so that they are enumerated again. Called by
+ *  the drivers when monitors are added, removed or reconfigured.
+ */
+void _al_invalidate_display_modes(void)
+{
+   _al_mutex_lock(&mode_cache_mutex);
+   mode_cache_valid = false;
+   mode_cache_generation++;
+   _al_mutex_unlock(&mode_cache_mutex);
+}
+
+
+/* _al_display_topology_changed:
+ *  Called by the drivers when the monitors attached to the system, their
+ *  arrangement or their modes changed. Invalidates the cached modes and
+ *  emits ALLEGRO_EVENT_DISPLAY_TOPOLOGY_CHANGED from display, which may be
+ *  NULL.
+ */
+void _al_display_topology_changed(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_EVENT event;
+
+   _al_invalidate_display_modes();
+
+   if (!display)
+      return;
+
+   _al_event_source_lock(&display->es);
+   if (_al_event_source_needs_to_generate_event(&display->es)) {
+      event.display.type = ALLEGRO_EVENT_DISPLAY_TOPOLOGY_CHANGED;
+      event.display.timestamp = al_get_time();
+      event.display.x = 0;
+      event.display.y = 0;
+      event.display.width = 0;
+      event.display.height = 0;
+      event.display.orientation = 0;
+      _al_event_source_emit_event(&display->es, &event);
+   }
+   _al_event_source_unlock(&display->es);
+}
 
 
 /* Function: al_get_num_display_modes
@@ -23,6 +201,17 @@
 int al_get_num_display_modes(void)
 {
    ALLEGRO_SYSTEM *system = al_get_system_driver();
+   MODE_CACHE_KEY key;
+   int num;
+
+   get_cache_key(&key);
+   if (lookup_cache(&key, 0, NULL, &num, NULL))
+      return num;
+
+   fill_cache(system, &key);
+   if (lookup_cache(&key, 0, NULL, &num, NULL))
+      return num;
+
    return system->vt->get_num_display_modes();
 }
 
@@ -32,7 +221,21 @@ int al_get_num_display_modes(void)
 ALLEGRO_DISPLAY_MODE *al_get_display_mode(int index, ALLEGRO_DISPLAY_MODE *mode)
 {
    ALLEGRO_SYSTEM *system = al_get_system_driver();
-   return system->vt->get_display_mode(index, mode);
+   MODE_CACHE_KEY key;
+   int num;
+   bool valid;
+
+   get_cache_key(&key);
+   if (!lookup_cache(&key, index, mode, &num, &valid)) {
+      fill_cache(system, &key);
+      if (!lookup_cache(&key, index, mode, &num, &valid))
+         return system->vt->get_display_mode(index, mode);
+   }
+
+   if (index < 0 || index >= num)
+      return system->vt->get_display_mode(index, mode);
+
+   return valid ? mode : NULL;
 }
 
 
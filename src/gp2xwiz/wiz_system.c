@@ -159,6 +159,8 @@ ALLEGRO_SYSTEM_INTERFACE *_al_system_gp2xwiz_driver(void)
    gp2xwiz_vt->get_time = _al_unix_get_time;
    gp2xwiz_vt->rest = _al_unix_rest;
    gp2xwiz_vt->init_timeout = _al_unix_init_timeout;
+   gp2xwiz_vt->rest_until = _al_unix_rest_until;
+   gp2xwiz_vt->init_timeout_until = _al_unix_init_timeout_until;
 
    return gp2xwiz_vt;
 }
@@ -16,6 +16,8 @@
  */
 
 
+#include <stdlib.h>
+
 #include "allegro5/allegro.h"
 #include "allegro5/haptic.h"
 #include "allegro5/internal/aintern.h"
@@ -23,11 +25,207 @@
 #include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_haptic.h"
 #include "allegro5/internal/aintern_system.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("haptic")
+
+
+/* How many times per second pending effect updates are sent to the
+ * devices by default.
+ */
+#define DEFAULT_UPDATE_RATE   100
+
+
+/* An effect update that has not been sent to the device yet. */
+typedef struct HAPTIC_UPDATE
+{
+   ALLEGRO_HAPTIC_EFFECT_ID *id;
+   ALLEGRO_HAPTIC_EFFECT effect;
+} HAPTIC_UPDATE;
 
 
 /* the active haptic driver */
 static ALLEGRO_HAPTIC_DRIVER *haptic_driver = NULL;
 
+/* Effect updates are coalesced and sent by a background thread, which is
+ * started on the first update. The mutex is also held while the updates
+ * are sent, so that an effect cannot be released under the thread's feet.
+ */
+static ALLEGRO_MUTEX *update_mutex = NULL;
+static ALLEGRO_COND *update_cond = NULL;
+static ALLEGRO_THREAD *update_thread = NULL;
+static _AL_VECTOR pending_updates = _AL_VECTOR_INITIALIZER(HAPTIC_UPDATE);
+static double update_interval = 0.0;
+
+
+/* get_update_interval:
+ *  Read the minimum time between two updates of the same effect from the
+ *  configuration. Zero means the updates are not deferred.
+ */
+static double get_update_interval(void)
+{
+   const char *p;
+   int rate = DEFAULT_UPDATE_RATE;
+
+   p = al_get_config_value(al_get_system_config(), "haptic", "update_rate");
+   if (p && p[0] != '\0')
+      rate = atoi(p);
+
+   if (rate <= 0)
+      return 0.0;
+   if (rate > 1000)
+      rate = 1000;
+   return 1.0 / rate;
+}
+
+
+/* apply_update:
+ *  Send new parameters for an uploaded effect to the device. Drivers which
+ *  cannot modify an effect in place get it uploaded again.
+ */
+static bool apply_update(ALLEGRO_HAPTIC_EFFECT_ID *id,
+   ALLEGRO_HAPTIC_EFFECT *effect)
+{
+   ALLEGRO_HAPTIC *hap;
+   bool playing;
+
+   if (haptic_driver->update_effect)
+      return haptic_driver->update_effect(id, effect);
+
+   hap = id->_haptic;
+   if (!hap)
+      return false;
+   playing = haptic_driver->is_effect_playing(id);
+   haptic_driver->release_effect(id);
+   if (!haptic_driver->upload_effect(hap, effect, id))
+      return false;
+   return !playing || haptic_driver->play_effect(id, 1);
+}
+
+
+/* flush_pending_updates:
+ *  Send all pending updates. The update mutex must be held.
+ */
+static void flush_pending_updates(void)
+{
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&pending_updates); i++) {
+      HAPTIC_UPDATE *u = _al_vector_ref(&pending_updates, i);
+      if (!apply_update(u->id, &u->effect))
+         ALLEGRO_WARN("Could not update haptic effect %d.\n", u->id->_id);
+   }
+   _al_vector_free(&pending_updates);
+}
+
+
+/* drop_pending_updates:
+ *  Forget the pending updates of an effect, or of all effects of a device
+ *  if `id' is NULL. The update mutex must be held.
+ */
+static void drop_pending_updates(ALLEGRO_HAPTIC_EFFECT_ID *id,
+   ALLEGRO_HAPTIC *hap)
+{
+   unsigned int i = 0;
+
+   while (i < _al_vector_size(&pending_updates)) {
+      HAPTIC_UPDATE *u = _al_vector_ref(&pending_updates, i);
+      if (u->id == id || (!id && u->id->_haptic == hap))
+         _al_vector_delete_at(&pending_updates, i);
+      else
+         i++;
+   }
+}
+
+
+/* update_thread_proc:
+ *  Send the pending updates, at most once per update interval, so that
+ *  any number of updates of an effect in between cost one driver call.
+ */
+static void *update_thread_proc(ALLEGRO_THREAD *thread, void *arg)
+{
+   double next = 0.0;
+   (void)arg;
+
+   al_lock_mutex(update_mutex);
+   while (!al_get_thread_should_stop(thread)) {
+      double now;
+
+      if (_al_vector_is_empty(&pending_updates)) {
+         al_wait_cond(update_cond, update_mutex);
+         continue;
+      }
+
+      now = al_get_time();
+      if (now < next) {
+         ALLEGRO_TIMEOUT timeout;
+         al_init_timeout(&timeout, next - now);
+         al_wait_cond_until(update_cond, update_mutex, &timeout);
+         continue;
+      }
+
+      flush_pending_updates();
+      next = now + update_interval;
+   }
+   al_unlock_mutex(update_mutex);
+
+   return NULL;
+}
+
+
+/* start_update_thread:
+ *  Create the update thread and its synchronisation objects if they don't
+ *  exist yet.
+ */
+static bool start_update_thread(void)
+{
+   if (update_thread)
+      return true;
+
+   update_mutex = al_create_mutex();
+   update_cond = al_create_cond();
+   if (update_mutex && update_cond)
+      update_thread = al_create_thread(update_thread_proc, NULL);
+
+   if (!update_thread) {
+      ALLEGRO_ERROR("Could not create the haptic update thread.\n");
+      if (update_cond)
+         al_destroy_cond(update_cond);
+      if (update_mutex)
+         al_destroy_mutex(update_mutex);
+      update_cond = NULL;
+      update_mutex = NULL;
+      return false;
+   }
+
+   al_start_thread(update_thread);
+   return true;
+}
+
+
+/* stop_update_thread:
+ *  Send the remaining updates and destroy the update thread.
+ */
+static void stop_update_thread(void)
+{
+   if (!update_thread)
+      return;
+
+   al_lock_mutex(update_mutex);
+   al_set_thread_should_stop(update_thread);
+   al_broadcast_cond(update_cond);
+   al_unlock_mutex(update_mutex);
+   al_join_thread(update_thread, NULL);
+   al_destroy_thread(update_thread);
+   update_thread = NULL;
+
+   flush_pending_updates();
+   al_destroy_cond(update_cond);
+   al_destroy_mutex(update_mutex);
+   update_cond = NULL;
+   update_mutex = NULL;
+}
+
 
 /* Function: al_install_haptic
  */
@@ -50,6 +248,7 @@ bool al_install_haptic(void)
        */
       if (hapdrv && hapdrv->init_haptic()) {
          haptic_driver = hapdrv;
+         update_interval = get_update_interval();
          _al_add_exit_func(al_uninstall_haptic, "al_uninstall_haptic");
          return true;
       }
@@ -63,6 +262,8 @@ bool al_install_haptic(void)
  */
 void al_uninstall_haptic(void)
 {
+   stop_update_thread();
+
    if (haptic_driver) {
       /* perform driver clean up */
       haptic_driver->exit_haptic();
@@ -373,10 +574,64 @@ bool al_rumble_haptic(ALLEGRO_HAPTIC *hap,
  */
 bool al_release_haptic_effect(ALLEGRO_HAPTIC_EFFECT_ID *id)
 {
+   bool ret;
+
+   ASSERT(haptic_driver);
+   ASSERT(id);
+
+   if (!update_thread)
+      return haptic_driver->release_effect(id);
+
+   al_lock_mutex(update_mutex);
+   drop_pending_updates(id, NULL);
+   ret = haptic_driver->release_effect(id);
+   al_unlock_mutex(update_mutex);
+   return ret;
+}
+
+
+/* Function: al_update_haptic_effect
+ */
+bool al_update_haptic_effect(ALLEGRO_HAPTIC_EFFECT_ID *id,
+   ALLEGRO_HAPTIC_EFFECT *effect)
+{
+   HAPTIC_UPDATE *u = NULL;
+   unsigned int i;
+
    ASSERT(haptic_driver);
    ASSERT(id);
+   ASSERT(effect);
 
-   return haptic_driver->release_effect(id);
+   if (!id->_haptic)
+      return false;
+
+   if (update_interval <= 0.0 || !start_update_thread())
+      return apply_update(id, effect);
+
+   al_lock_mutex(update_mutex);
+
+   /* Only the latest parameters of an effect are of interest. */
+   for (i = 0; i < _al_vector_size(&pending_updates); i++) {
+      HAPTIC_UPDATE *p = _al_vector_ref(&pending_updates, i);
+      if (p->id == id) {
+         u = p;
+         break;
+      }
+   }
+   if (!u) {
+      u = _al_vector_alloc_back(&pending_updates);
+      if (!u) {
+         al_unlock_mutex(update_mutex);
+         return false;
+      }
+      u->id = id;
+      if (_al_vector_size(&pending_updates) == 1)
+         al_signal_cond(update_cond);
+   }
+   u->effect = *effect;
+
+   al_unlock_mutex(update_mutex);
+   return true;
 }
 
 
@@ -384,10 +639,19 @@ bool al_release_haptic_effect(ALLEGRO_HAPTIC_EFFECT_ID *id)
  */
 bool al_release_haptic(ALLEGRO_HAPTIC *haptic)
 {
+   bool ret;
+
    ASSERT(haptic_driver);
    ASSERT(haptic);
 
-   return haptic_driver->release(haptic);
+   if (!update_thread)
+      return haptic_driver->release(haptic);
+
+   al_lock_mutex(update_mutex);
+   drop_pending_updates(NULL, haptic);
+   ret = haptic_driver->release(haptic);
+   al_unlock_mutex(update_mutex);
+   return ret;
 }
 
 
@@ -0,0 +1,238 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Lock-free snapshots of input device states.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_input_snapshot.h"
+
+ALLEGRO_DEBUG_CHANNEL("input")
+
+
+#define DEFAULT_HISTORY_SIZE  64
+#define MAX_HISTORY_SIZE      4096
+
+
+/* get_history_size:
+ *  Read the number of states to keep from the configuration, rounded up to
+ *  a power of two.
+ */
+static int get_history_size(void)
+{
+   const char *p;
+   int n = DEFAULT_HISTORY_SIZE;
+   int size;
+
+   p = al_get_config_value(al_get_system_config(), "input", "state_history");
+   if (p && p[0] != '\0')
+      n = atoi(p);
+
+   if (n <= 0)
+      return 0;
+   if (n > MAX_HISTORY_SIZE)
+      n = MAX_HISTORY_SIZE;
+
+   for (size = 1; size < n; size *= 2)
+      ;
+   return size;
+}
+
+
+/* _al_init_input_snapshot:
+ *  Set up a snapshot for states of `size' bytes, initially all zero.
+ */
+bool _al_init_input_snapshot(_AL_INPUT_SNAPSHOT *snap, size_t size)
+{
+   memset(snap, 0, sizeof *snap);
+
+   snap->size = size;
+   snap->state = al_calloc(1, size);
+   if (!snap->state)
+      return false;
+
+   snap->history_size = get_history_size();
+   if (snap->history_size > 0) {
+      snap->history = al_calloc(snap->history_size, size);
+      snap->history_times = al_calloc(snap->history_size, sizeof(double));
+      if (!snap->history || !snap->history_times) {
+         ALLEGRO_WARN("Could not allocate the input state history.\n");
+         al_free(snap->history);
+         al_free(snap->history_times);
+         snap->history = NULL;
+         snap->history_times = NULL;
+         snap->history_size = 0;
+      }
+   }
+
+   return true;
+}
+
+
+/* _al_destroy_input_snapshot:
+ *  Free the snapshot. Nobody may be reading it any more.
+ */
+void _al_destroy_input_snapshot(_AL_INPUT_SNAPSHOT *snap)
+{
+   al_free(snap->state);
+   al_free(snap->history);
+   al_free(snap->history_times);
+   memset(snap, 0, sizeof *snap);
+}
+
+
+/* _al_publish_input_snapshot:
+ *  Make `state' the current state, and append it to the history. Only one
+ *  thread may publish at a time.
+ */
+void _al_publish_input_snapshot(_AL_INPUT_SNAPSHOT *snap, const void *state,
+   double timestamp)
+{
+   _AL_ATOMIC seq;
+
+   if (!snap->state)
+      return;
+
+   seq = snap->seq;
+   _al_store_release(&snap->seq, seq + 1);
+   /* The odd counter must be visible before any of the data changes. */
+   _al_memory_barrier();
+
+   memcpy(snap->state, state, snap->size);
+   if (snap->history_size > 0) {
+      unsigned int i = snap->history_count & (snap->history_size - 1);
+      memcpy(snap->history + i * snap->size, state, snap->size);
+      snap->history_times[i] = timestamp;
+      snap->history_count++;
+   }
+
+   _al_store_release(&snap->seq, seq + 2);
+}
+
+
+/* begin_read:
+ *  Wait until no update is in progress and return the counter.
+ */
+static _AL_ATOMIC begin_read(_AL_INPUT_SNAPSHOT *snap)
+{
+   _AL_ATOMIC seq;
+
+   /* Updates are a few memcpys, so spinning is cheaper than sleeping. */
+   while ((seq = _al_load_acquire(&snap->seq)) & 1)
+      ;
+   return seq;
+}
+
+
+/* end_read:
+ *  Return true if the data read since begin_read is consistent.
+ */
+static bool end_read(_AL_INPUT_SNAPSHOT *snap, _AL_ATOMIC seq)
+{
+   _al_memory_barrier();
+   return _al_load_acquire(&snap->seq) == seq;
+}
+
+
+/* _al_read_input_snapshot:
+ *  Copy the current state without blocking the writer.
+ */
+void _al_read_input_snapshot(_AL_INPUT_SNAPSHOT *snap, void *state)
+{
+   _AL_ATOMIC seq;
+
+   do {
+      seq = begin_read(snap);
+      memcpy(state, snap->state, snap->size);
+   } while (!end_read(snap, seq));
+}
+
+
+/* _al_read_input_snapshot_history:
+ *  Copy up to `max' states published after time `since', oldest first.
+ *  Returns the number of states copied.
+ */
+int _al_read_input_snapshot_history(_AL_INPUT_SNAPSHOT *snap, double since,
+   void *states, double *timestamps, int max)
+{
+   char *out = states;
+   _AL_ATOMIC seq;
+   int n;
+
+   if (snap->history_size == 0 || max <= 0)
+      return 0;
+
+   do {
+      unsigned int count, avail, i;
+
+      seq = begin_read(snap);
+
+      count = snap->history_count;
+      avail = count;
+      if (avail > (unsigned int)snap->history_size)
+         avail = snap->history_size;
+
+      n = 0;
+      for (i = count - avail; i != count && n < max; i++) {
+         unsigned int j = i & (snap->history_size - 1);
+
+         if (snap->history_times[j] <= since)
+            continue;
+         memcpy(out + n * snap->size, snap->history + j * snap->size,
+            snap->size);
+         if (timestamps)
+            timestamps[n] = snap->history_times[j];
+         n++;
+      }
+   } while (!end_read(snap, seq));
+
+   return n;
+}
+
+
+/* _al_read_input_snapshot_at:
+ *  Copy the state that was stored at position `index' of the history, as
+ *  returned by _al_input_snapshot_last_index after publishing it. Returns
+ *  false if it has been overwritten since.
+ */
+bool _al_read_input_snapshot_at(_AL_INPUT_SNAPSHOT *snap, unsigned int index,
+   void *state, double *timestamp)
+{
+   _AL_ATOMIC seq;
+   bool found;
+
+   if (snap->history_size == 0)
+      return false;
+
+   do {
+      unsigned int count, j;
+
+      seq = begin_read(snap);
+
+      count = snap->history_count;
+      found = (count - index - 1 < (unsigned int)snap->history_size);
+      if (found) {
+         j = index & (snap->history_size - 1);
+         memcpy(state, snap->history + j * snap->size, snap->size);
+         if (timestamp)
+            *timestamp = snap->history_times[j];
+      }
+   } while (!end_read(snap, seq));
+
+   return found;
+}
+
+/* vim: set sts=3 sw=3 et: */
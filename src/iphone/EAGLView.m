@@ -328,6 +328,8 @@ static touch_t* find_touch(_AL_LIST* list, UITouch* nativeTouch)
          p.x*scale, p.y*scale, primary_touch == nativeTouch, allegro_display);
       }
    }
+
+   _al_iphone_touch_input_end_frame();
 }
 
 // Handles the end of a touch event.
@@ -7,6 +7,7 @@
 #include "allegro5/allegro_opengl.h"
 #include "allegro5/allegro_iphone.h"
 #include "allegro5/internal/aintern_opengl.h"
+#include "allegro5/internal/aintern_system.h"
 
 ALLEGRO_DEBUG_CHANNEL("iphone")
 
@@ -383,6 +384,30 @@ int _al_iphone_get_orientation(ALLEGRO_DISPLAY *display)
       return ALLEGRO_DISPLAY_ORIENTATION_UNKNOWN;
 }
 
+static void update_thermal_state(void)
+{
+   ALLEGRO_THERMAL_STATE state = ALLEGRO_THERMAL_STATE_UNKNOWN;
+
+   if (@available(iOS 11.0, *)) {
+      switch ([[NSProcessInfo processInfo] thermalState]) {
+         case NSProcessInfoThermalStateNominal:
+            state = ALLEGRO_THERMAL_STATE_NOMINAL;
+            break;
+         case NSProcessInfoThermalStateFair:
+            state = ALLEGRO_THERMAL_STATE_FAIR;
+            break;
+         case NSProcessInfoThermalStateSerious:
+            state = ALLEGRO_THERMAL_STATE_SERIOUS;
+            break;
+         case NSProcessInfoThermalStateCritical:
+            state = ALLEGRO_THERMAL_STATE_CRITICAL;
+            break;
+      }
+   }
+
+   _al_set_thermal_state(state);
+}
+
 @implementation allegroAppDelegate
 
 + (void)run:(int)argc:(char **)argv {
@@ -401,6 +426,14 @@ int _al_iphone_get_orientation(ALLEGRO_DISPLAY *display)
    iphone_send_orientation_event(main_display, orientation);
 }
 
+/* Posted on an arbitrary thread. */
+- (void)thermal_state_change:(NSNotification *)notification
+{
+   (void)notification;
+
+   update_thermal_state();
+}
+
 - (void)applicationDidFinishLaunching:(UIApplication *)application {
    ALLEGRO_INFO("App launched.\n");
 
@@ -418,6 +451,12 @@ int _al_iphone_get_orientation(ALLEGRO_DISPLAY *display)
    // Register for screen connect/disconnect notifications
    [self setupScreenConnectionNotificationHandlers];
 
+   if (@available(iOS 11.0, *)) {
+      [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(thermal_state_change:)
+           name:NSProcessInfoThermalStateDidChangeNotification object:nil];
+      update_thermal_state();
+   }
+
    _al_iphone_run_user_main();
 }
 
@@ -25,6 +25,13 @@ static ALLEGRO_MOUSE_STATE mouse_state;
 static ALLEGRO_TOUCH_INPUT touch_input;
 static bool installed = false;
 
+/* Must be called with the event source locked. */
+static void publish_state(double timestamp)
+{
+   _al_publish_input_snapshot(&touch_input.snapshot, &touch_input_state,
+      timestamp);
+}
+
 static void generate_touch_input_event(unsigned int type, double timestamp, int id, float x, float y, float dx, float dy, bool primary, ALLEGRO_DISPLAY *disp)
 {
    ALLEGRO_EVENT event;
@@ -46,6 +53,9 @@ static void generate_touch_input_event(unsigned int type, double timestamp, int
    else if (touch_input.mouse_emulation_mode == ALLEGRO_MOUSE_EMULATION_EXCLUSIVE)
       want_touch_event = al_is_mouse_installed() ? false : want_touch_event;
 
+   if (want_touch_event &&
+         _al_touch_input_defer_event(&touch_input, type, timestamp, disp))
+      want_touch_event = false;
    
    if (!want_touch_event && !want_mouse_emulation_event)
       return;
@@ -122,6 +132,8 @@ static bool init_touch_input(void)
    memset(&touch_input_state, 0, sizeof(touch_input_state));
    memset(&mouse_state, 0, sizeof(mouse_state));
 
+   _al_init_touch_input_frames(&touch_input);
+
    _al_event_source_init(&touch_input.es);
    _al_event_source_init(&touch_input.mouse_emulation_es);
    touch_input.mouse_emulation_mode = ALLEGRO_MOUSE_EMULATION_TRANSPARENT;
@@ -142,6 +154,7 @@ static void exit_touch_input(void)
 
    _al_event_source_free(&touch_input.es);
    _al_event_source_free(&touch_input.mouse_emulation_es);
+   _al_destroy_touch_input_frames(&touch_input);
 
    installed = false;
 }
@@ -223,6 +236,7 @@ void _al_iphone_touch_input_handle_begin(int id, double timestamp, float x, floa
    state->dy      = 0.0f;
    state->primary = primary;
    state->display = disp;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_BEGIN, timestamp,
@@ -243,6 +257,7 @@ void _al_iphone_touch_input_handle_end(int id, double timestamp, float x, float
    state->dy      = y - state->y;
    state->x       = x;
    state->y       = y;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_END, timestamp,
@@ -250,6 +265,7 @@ void _al_iphone_touch_input_handle_end(int id, double timestamp, float x, float
 
    _al_event_source_lock(&touch_input.es);
    memset(state, 0, sizeof(ALLEGRO_TOUCH_STATE));
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 }
 
@@ -267,6 +283,7 @@ void _al_iphone_touch_input_handle_move(int id, double timestamp, float x, float
    state->dy      = y - state->y;
    state->x       = x;
    state->y       = y;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_MOVE, timestamp,
@@ -287,6 +304,7 @@ void _al_iphone_touch_input_handle_cancel(int id, double timestamp, float x, flo
    state->dy      = y - state->y;
    state->x       = x;
    state->y       = y;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_CANCEL, timestamp,
@@ -294,10 +312,17 @@ void _al_iphone_touch_input_handle_cancel(int id, double timestamp, float x, flo
 
    _al_event_source_lock(&touch_input.es);
    memset(state, 0, sizeof(ALLEGRO_TOUCH_STATE));
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 }
 
 
+void _al_iphone_touch_input_end_frame(void)
+{
+   _al_touch_input_end_frame(&touch_input);
+}
+
+
 /* the driver vtable */
 #define TOUCH_INPUT_IPHONE AL_ID('I','T','I','D')
 
@@ -0,0 +1,470 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Job pools.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_tls.h"
+
+ALLEGRO_DEBUG_CHANNEL("jobs")
+
+#define MAX_JOB_THREADS 64
+
+
+/*
+ * Every worker owns a deque of jobs. A worker pushes the jobs it submits
+ * itself onto the bottom of its own deque and takes work from there too,
+ * so related jobs tend to stay on one thread. Jobs from other threads are
+ * spread over the deques round robin. A worker whose deque is empty steals
+ * from the top of the others' deques, i.e. takes their oldest jobs.
+ *
+ * Each deque has its own mutex, so workers mostly do not contend. The pool
+ * mutex only protects job states and the count of queued jobs, which idle
+ * workers sleep on. Threads waiting for a job run queued jobs meanwhile,
+ * which also makes it safe to wait for jobs from within jobs.
+ */
+
+enum {
+   JOB_QUEUED,
+   JOB_RUNNING,
+   JOB_DONE
+};
+
+struct ALLEGRO_JOB
+{
+   ALLEGRO_JOB_POOL *pool;
+   void *(*func)(void *arg);
+   void *arg;
+   void *result;
+   int state;
+   bool released;
+};
+
+typedef struct JOB_DEQUE
+{
+   ALLEGRO_MUTEX *mutex;
+   ALLEGRO_JOB **jobs;  /* ring buffer */
+   int first;
+   int count;
+   int capacity;
+} JOB_DEQUE;
+
+typedef struct JOB_WORKER
+{
+   _AL_THREAD thread;
+   ALLEGRO_JOB_POOL *pool;
+   JOB_DEQUE deque;
+   int index;
+} JOB_WORKER;
+
+struct ALLEGRO_JOB_POOL
+{
+   JOB_WORKER *workers;
+   int num_workers;
+   ALLEGRO_MUTEX *mutex;
+   ALLEGRO_COND *work_cond;
+   ALLEGRO_COND *done_cond;
+   int queued;
+   int unfinished;
+   int next_deque;
+   bool stop;
+   ALLEGRO_EVENT_SOURCE es;
+};
+
+
+static bool push_bottom(JOB_DEQUE *d, ALLEGRO_JOB *job)
+{
+   bool ok = true;
+
+   al_lock_mutex(d->mutex);
+   if (d->count == d->capacity) {
+      int capacity = d->capacity ? d->capacity * 2 : 64;
+      ALLEGRO_JOB **jobs = al_malloc(capacity * sizeof *jobs);
+      int i;
+
+      if (jobs) {
+         for (i = 0; i < d->count; i++)
+            jobs[i] = d->jobs[(d->first + i) % d->capacity];
+         al_free(d->jobs);
+         d->jobs = jobs;
+         d->first = 0;
+         d->capacity = capacity;
+      }
+      else {
+         ok = false;
+      }
+   }
+   if (ok) {
+      d->jobs[(d->first + d->count) % d->capacity] = job;
+      d->count++;
+   }
+   al_unlock_mutex(d->mutex);
+   return ok;
+}
+
+
+static ALLEGRO_JOB *pop_bottom(JOB_DEQUE *d)
+{
+   ALLEGRO_JOB *job = NULL;
+
+   al_lock_mutex(d->mutex);
+   if (d->count > 0) {
+      d->count--;
+      job = d->jobs[(d->first + d->count) % d->capacity];
+   }
+   al_unlock_mutex(d->mutex);
+   return job;
+}
+
+
+static ALLEGRO_JOB *steal_top(JOB_DEQUE *d)
+{
+   ALLEGRO_JOB *job = NULL;
+
+   al_lock_mutex(d->mutex);
+   if (d->count > 0) {
+      job = d->jobs[d->first];
+      d->first = (d->first + 1) % d->capacity;
+      d->count--;
+   }
+   al_unlock_mutex(d->mutex);
+   return job;
+}
+
+
+/* Returns the worker of the pool running on this thread, if any. */
+static JOB_WORKER *current_worker(ALLEGRO_JOB_POOL *pool)
+{
+   JOB_WORKER *w = _al_tls_get_job_worker();
+
+   return (w && w->pool == pool) ? w : NULL;
+}
+
+
+/* Takes a queued job, preferring the newest one of self's own deque, or
+ * NULL if there is none.
+ */
+static ALLEGRO_JOB *take_job(ALLEGRO_JOB_POOL *pool, JOB_WORKER *self)
+{
+   ALLEGRO_JOB *job = NULL;
+   int start = self ? self->index : 0;
+   int i;
+
+   if (self)
+      job = pop_bottom(&self->deque);
+   for (i = 0; !job && i < pool->num_workers; i++) {
+      int victim = (start + i) % pool->num_workers;
+      if (!self || victim != self->index)
+         job = steal_top(&pool->workers[victim].deque);
+   }
+
+   if (job) {
+      al_lock_mutex(pool->mutex);
+      pool->queued--;
+      job->state = JOB_RUNNING;
+      al_unlock_mutex(pool->mutex);
+   }
+   return job;
+}
+
+
+static void run_job(ALLEGRO_JOB_POOL *pool, ALLEGRO_JOB *job)
+{
+   void *result = job->func(job->arg);
+   ALLEGRO_EVENT_SOURCE *es = &pool->es;
+
+   al_lock_mutex(pool->mutex);
+   job->result = result;
+   job->state = JOB_DONE;
+   pool->unfinished--;
+
+   _al_event_source_lock(es);
+   if (_al_event_source_needs_to_generate_event(es)) {
+      ALLEGRO_EVENT event;
+      event.job.type = ALLEGRO_EVENT_JOB_DONE;
+      event.job.timestamp = al_get_time();
+      event.job.job = job;
+      event.job.result = result;
+      _al_event_source_emit_event(es, &event);
+   }
+   _al_event_source_unlock(es);
+
+   if (job->released)
+      al_free(job);
+   al_broadcast_cond(pool->done_cond);
+   al_unlock_mutex(pool->mutex);
+}
+
+
+static void worker_proc(_AL_THREAD *thread, void *arg)
+{
+   JOB_WORKER *self = arg;
+   ALLEGRO_JOB_POOL *pool = self->pool;
+   (void)thread;
+
+   _al_tls_set_job_worker(self);
+
+   for (;;) {
+      ALLEGRO_JOB *job = take_job(pool, self);
+
+      if (job) {
+         run_job(pool, job);
+         continue;
+      }
+
+      al_lock_mutex(pool->mutex);
+      if (pool->stop) {
+         al_unlock_mutex(pool->mutex);
+         break;
+      }
+      if (pool->queued <= 0)
+         al_wait_cond(pool->work_cond, pool->mutex);
+      al_unlock_mutex(pool->mutex);
+   }
+
+   _al_tls_set_job_worker(NULL);
+   al_free_frame_arena();
+}
+
+
+/* Function: al_create_job_pool
+ */
+ALLEGRO_JOB_POOL *al_create_job_pool(int num_threads)
+{
+   ALLEGRO_JOB_POOL *pool;
+   int i;
+
+   if (num_threads <= 0)
+      num_threads = al_get_cpu_count();
+   if (num_threads < 1)
+      num_threads = 1;
+   if (num_threads > MAX_JOB_THREADS)
+      num_threads = MAX_JOB_THREADS;
+
+   pool = al_calloc(1, sizeof *pool);
+   if (!pool)
+      return NULL;
+   pool->mutex = al_create_mutex();
+   pool->work_cond = al_create_cond();
+   pool->done_cond = al_create_cond();
+   pool->workers = al_calloc(num_threads, sizeof(JOB_WORKER));
+   if (!pool->mutex || !pool->work_cond || !pool->done_cond ||
+         !pool->workers) {
+      goto Error;
+   }
+   for (i = 0; i < num_threads; i++) {
+      JOB_WORKER *w = &pool->workers[i];
+      w->pool = pool;
+      w->index = i;
+      w->deque.mutex = al_create_mutex();
+      if (!w->deque.mutex)
+         goto Error;
+   }
+   _al_event_source_init(&pool->es);
+
+   pool->num_workers = num_threads;
+   for (i = 0; i < num_threads; i++)
+      _al_thread_create(&pool->workers[i].thread, worker_proc,
+         &pool->workers[i]);
+
+   ALLEGRO_DEBUG("Created job pool with %d threads\n", num_threads);
+   return pool;
+
+Error:
+   ALLEGRO_ERROR("Failed to create job pool.\n");
+   for (i = 0; pool->workers && i < num_threads; i++)
+      al_destroy_mutex(pool->workers[i].deque.mutex);
+   al_free(pool->workers);
+   al_destroy_cond(pool->done_cond);
+   al_destroy_cond(pool->work_cond);
+   al_destroy_mutex(pool->mutex);
+   al_free(pool);
+   return NULL;
+}
+
+
+/* Function: al_destroy_job_pool
+ */
+void al_destroy_job_pool(ALLEGRO_JOB_POOL *pool)
+{
+   int i;
+
+   if (!pool)
+      return;
+
+   /* Released jobs may still be outstanding. */
+   al_lock_mutex(pool->mutex);
+   while (pool->unfinished > 0)
+      al_wait_cond(pool->done_cond, pool->mutex);
+   pool->stop = true;
+   al_broadcast_cond(pool->work_cond);
+   al_unlock_mutex(pool->mutex);
+
+   for (i = 0; i < pool->num_workers; i++)
+      _al_thread_join(&pool->workers[i].thread);
+
+   for (i = 0; i < pool->num_workers; i++) {
+      al_destroy_mutex(pool->workers[i].deque.mutex);
+      al_free(pool->workers[i].deque.jobs);
+   }
+   _al_event_source_free(&pool->es);
+   al_free(pool->workers);
+   al_destroy_cond(pool->done_cond);
+   al_destroy_cond(pool->work_cond);
+   al_destroy_mutex(pool->mutex);
+   al_free(pool);
+}
+
+
+/* Function: al_get_job_pool_size
+ */
+int al_get_job_pool_size(ALLEGRO_JOB_POOL *pool)
+{
+   ASSERT(pool);
+   return pool->num_workers;
+}
+
+
+/* Function: al_get_job_pool_event_source
+ */
+ALLEGRO_EVENT_SOURCE *al_get_job_pool_event_source(ALLEGRO_JOB_POOL *pool)
+{
+   ASSERT(pool);
+   return &pool->es;
+}
+
+
+/* Function: al_submit_job
+ */
+ALLEGRO_JOB *al_submit_job(ALLEGRO_JOB_POOL *pool, void *(*func)(void *arg),
+   void *arg)
+{
+   JOB_WORKER *self;
+   JOB_DEQUE *d;
+   ALLEGRO_JOB *job;
+
+   ASSERT(pool);
+   ASSERT(func);
+
+   job = al_malloc(sizeof *job);
+   if (!job)
+      return NULL;
+   job->pool = pool;
+   job->func = func;
+   job->arg = arg;
+   job->result = NULL;
+   job->state = JOB_QUEUED;
+   job->released = false;
+
+   self = current_worker(pool);
+   if (self) {
+      d = &self->deque;
+   }
+   else {
+      al_lock_mutex(pool->mutex);
+      d = &pool->workers[pool->next_deque].deque;
+      pool->next_deque = (pool->next_deque + 1) % pool->num_workers;
+      al_unlock_mutex(pool->mutex);
+   }
+   if (!push_bottom(d, job)) {
+      al_free(job);
+      return NULL;
+   }
+
+   al_lock_mutex(pool->mutex);
+   pool->queued++;
+   pool->unfinished++;
+   al_signal_cond(pool->work_cond);
+   al_unlock_mutex(pool->mutex);
+
+   return job;
+}
+
+
+/* Function: al_is_job_done
+ */
+bool al_is_job_done(ALLEGRO_JOB *job)
+{
+   ALLEGRO_JOB_POOL *pool;
+   bool done;
+
+   ASSERT(job);
+   pool = job->pool;
+
+   al_lock_mutex(pool->mutex);
+   done = (job->state == JOB_DONE);
+   al_unlock_mutex(pool->mutex);
+   return done;
+}
+
+
+/* Function: al_wait_job
+ */
+void *al_wait_job(ALLEGRO_JOB *job)
+{
+   ALLEGRO_JOB_POOL *pool;
+   JOB_WORKER *self;
+   void *result;
+
+   ASSERT(job);
+   ASSERT(!job->released);
+   pool = job->pool;
+   self = current_worker(pool);
+
+   al_lock_mutex(pool->mutex);
+   while (job->state != JOB_DONE) {
+      ALLEGRO_JOB *other;
+
+      if (pool->queued <= 0) {
+         al_wait_cond(pool->done_cond, pool->mutex);
+         continue;
+      }
+      al_unlock_mutex(pool->mutex);
+      other = take_job(pool, self);
+      if (other)
+         run_job(pool, other);
+      al_lock_mutex(pool->mutex);
+   }
+   result = job->result;
+   al_unlock_mutex(pool->mutex);
+
+   al_free(job);
+   return result;
+}
+
+
+/* Function: al_release_job
+ */
+void al_release_job(ALLEGRO_JOB *job)
+{
+   ALLEGRO_JOB_POOL *pool;
+   bool done;
+
+   if (!job)
+      return;
+   pool = job->pool;
+
+   al_lock_mutex(pool->mutex);
+   done = (job->state == JOB_DONE);
+   job->released = true;
+   al_unlock_mutex(pool->mutex);
+
+   if (done)
+      al_free(job);
+}
+
+/* vim: set sts=3 sw=3 et: */
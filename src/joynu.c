@@ -297,9 +297,32 @@ void al_get_joystick_state(ALLEGRO_JOYSTICK *joy, ALLEGRO_JOYSTICK_STATE *ret_st
    ASSERT(joy);
    ASSERT(ret_state);
 
+   if (_al_input_snapshot_is_active(&joy->snapshot)) {
+      _al_read_input_snapshot(&joy->snapshot, ret_state);
+      return;
+   }
+
    new_joystick_driver->get_joystick_state(joy, ret_state);
 }
 
+
+
+/* Function: al_get_joystick_state_history
+ */
+int al_get_joystick_state_history(ALLEGRO_JOYSTICK *joy, double since,
+   ALLEGRO_JOYSTICK_STATE *ret_states, double *ret_timestamps, int max)
+{
+   ASSERT(new_joystick_driver);
+   ASSERT(joy);
+   ASSERT(ret_states);
+
+   if (!_al_input_snapshot_is_active(&joy->snapshot))
+      return 0;
+
+   return _al_read_input_snapshot_history(&joy->snapshot, since,
+      ret_states, ret_timestamps, max);
+}
+
 /*
  * Local Variables:
  * c-basic-offset: 3
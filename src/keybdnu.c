@@ -238,14 +238,42 @@ const char *al_keycode_to_name(int keycode)
  */
 void al_get_keyboard_state(ALLEGRO_KEYBOARD_STATE *ret_state)
 {
+   ALLEGRO_KEYBOARD *keyboard;
+
    ASSERT(new_keyboard_driver);
    ASSERT(ret_state);
 
+   keyboard = new_keyboard_driver->get_keyboard();
+   if (keyboard && _al_input_snapshot_is_active(&keyboard->snapshot)) {
+      _al_read_input_snapshot(&keyboard->snapshot, ret_state);
+      return;
+   }
+
    new_keyboard_driver->get_keyboard_state(ret_state);
 }
 
 
 
+/* Function: al_get_keyboard_state_history
+ */
+int al_get_keyboard_state_history(double since,
+   ALLEGRO_KEYBOARD_STATE *ret_states, double *ret_timestamps, int max)
+{
+   ALLEGRO_KEYBOARD *keyboard;
+
+   ASSERT(new_keyboard_driver);
+   ASSERT(ret_states);
+
+   keyboard = new_keyboard_driver->get_keyboard();
+   if (!keyboard || !_al_input_snapshot_is_active(&keyboard->snapshot))
+      return 0;
+
+   return _al_read_input_snapshot_history(&keyboard->snapshot, since,
+      ret_states, ret_timestamps, max);
+}
+
+
+
 /* Function: al_clear_keyboard_state
  */
 void al_clear_keyboard_state(ALLEGRO_DISPLAY *display)
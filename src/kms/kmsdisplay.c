@@ -0,0 +1,968 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      DRM/KMS display driver, rendering with EGL on GBM surfaces.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <errno.h>
+#include <poll.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_opengl.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_opengl.h"
+#include "allegro5/internal/aintern_vector.h"
+#include "allegro5/internal/aintern_kms.h"
+
+ALLEGRO_DEBUG_CHANNEL("display")
+
+#define CURSOR_SIZE 64
+
+#ifndef EGL_PLATFORM_GBM_KHR
+#define EGL_PLATFORM_GBM_KHR 0x31D7
+#endif
+
+typedef EGLDisplay (*GET_PLATFORM_DISPLAY)(EGLenum platform,
+   void *native_display, const EGLint *attrib_list);
+
+static ALLEGRO_DISPLAY_INTERFACE *vt;
+
+
+static void setup_gl(ALLEGRO_DISPLAY *d)
+{
+   ALLEGRO_OGL_EXTRAS *ogl = d->ogl_extras;
+
+   if (ogl->backbuffer)
+      _al_ogl_resize_backbuffer(ogl->backbuffer, d->w, d->h);
+   else
+      ogl->backbuffer = _al_ogl_create_backbuffer(d);
+}
+
+
+/* Picks the connector mode closest to what was asked for. A size of 0x0
+ * means the preferred mode.
+ */
+static int choose_mode(ALLEGRO_SYSTEM_KMS *s, int w, int h, int refresh)
+{
+   int i;
+
+   if (w <= 0 || h <= 0)
+      return s->default_mode;
+
+   for (i = 0; i < s->num_modes; i++) {
+      if (s->modes[i].hdisplay == w && s->modes[i].vdisplay == h &&
+            (refresh == 0 || (int)s->modes[i].vrefresh == refresh)) {
+         return i;
+      }
+   }
+
+   ALLEGRO_WARN("No %dx%d mode, using %s.\n", w, h,
+      s->modes[s->default_mode].name);
+   return s->default_mode;
+}
+
+
+static bool init_egl(ALLEGRO_DISPLAY_KMS *d)
+{
+   ALLEGRO_SYSTEM_KMS *s = (void *)al_get_system_driver();
+   ALLEGRO_DISPLAY *display = (void *)d;
+   ALLEGRO_EXTRA_DISPLAY_SETTINGS *eds = _al_get_new_display_settings();
+   GET_PLATFORM_DISPLAY get_platform_display;
+   EGLConfig *configs;
+   EGLint num_configs = 0;
+   EGLint major, minor;
+   int i;
+
+   EGLint attrib_list[] = {
+      EGL_DEPTH_SIZE, 0,
+      EGL_STENCIL_SIZE, 0,
+      EGL_RED_SIZE, 8,
+      EGL_GREEN_SIZE, 8,
+      EGL_BLUE_SIZE, 8,
+      EGL_ALPHA_SIZE, 0,
+      EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_ES_BIT,
+      EGL_NONE
+   };
+   EGLint ctxattr[] = {
+      EGL_CONTEXT_CLIENT_VERSION, 0,
+      EGL_NONE
+   };
+
+   get_platform_display = (GET_PLATFORM_DISPLAY)
+      eglGetProcAddress("eglGetPlatformDisplayEXT");
+   if (get_platform_display)
+      d->egl_display = get_platform_display(EGL_PLATFORM_GBM_KHR, s->gbm, NULL);
+   else
+      d->egl_display = eglGetDisplay((EGLNativeDisplayType)s->gbm);
+   if (d->egl_display == EGL_NO_DISPLAY) {
+      ALLEGRO_ERROR("No EGL display for the GBM device.\n");
+      return false;
+   }
+
+   if (!eglInitialize(d->egl_display, &major, &minor)) {
+      ALLEGRO_ERROR("eglInitialize failed.\n");
+      return false;
+   }
+   ALLEGRO_INFO("EGL %d.%d\n", major, minor);
+
+   d->egl_context_version =
+      (display->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) ? 2 : 1;
+
+   attrib_list[1] = eds->settings[ALLEGRO_DEPTH_SIZE];
+   attrib_list[3] = eds->settings[ALLEGRO_STENCIL_SIZE];
+   if (d->egl_context_version == 2)
+      attrib_list[15] = EGL_OPENGL_ES2_BIT;
+
+   /* The scanout buffers are XRGB8888, so the config has to match exactly
+    * rather than being the "best" one eglChooseConfig sorts first.
+    */
+   if (!eglChooseConfig(d->egl_display, attrib_list, NULL, 0, &num_configs) ||
+         num_configs == 0) {
+      ALLEGRO_ERROR("No matching EGL configs.\n");
+      return false;
+   }
+   configs = al_malloc(num_configs * sizeof *configs);
+   eglChooseConfig(d->egl_display, attrib_list, configs, num_configs,
+      &num_configs);
+   for (i = 0; i < num_configs; i++) {
+      EGLint id = 0;
+      eglGetConfigAttrib(d->egl_display, configs[i], EGL_NATIVE_VISUAL_ID, &id);
+      if (id == GBM_FORMAT_XRGB8888) {
+         d->egl_config = configs[i];
+         break;
+      }
+   }
+   al_free(configs);
+   if (i == num_configs) {
+      ALLEGRO_ERROR("No EGL config for GBM_FORMAT_XRGB8888.\n");
+      return false;
+   }
+
+   eglBindAPI(EGL_OPENGL_ES_API);
+
+   ctxattr[1] = d->egl_context_version;
+   d->egl_context = eglCreateContext(d->egl_display, d->egl_config,
+      EGL_NO_CONTEXT, ctxattr);
+   if (d->egl_context == EGL_NO_CONTEXT) {
+      ALLEGRO_ERROR("eglCreateContext failed.\n");
+      return false;
+   }
+
+   d->egl_surface = eglCreateWindowSurface(d->egl_display, d->egl_config,
+      (EGLNativeWindowType)d->gbm_surface, NULL);
+   if (d->egl_surface == EGL_NO_SURFACE) {
+      ALLEGRO_ERROR("eglCreateWindowSurface failed.\n");
+      return false;
+   }
+
+   if (!eglMakeCurrent(d->egl_display, d->egl_surface, d->egl_surface,
+         d->egl_context)) {
+      ALLEGRO_ERROR("eglMakeCurrent failed.\n");
+      return false;
+   }
+
+   return true;
+}
+
+
+static void destroy_fb(struct gbm_bo *bo, void *data)
+{
+   int fd = gbm_device_get_fd(gbm_bo_get_device(bo));
+   uint32_t fb_id = (uint32_t)(uintptr_t)data;
+
+   drmModeRmFB(fd, fb_id);
+}
+
+
+/* Returns the framebuffer for a GBM buffer. GBM recycles a handful of
+ * buffers, so the framebuffer is created once and kept with the buffer.
+ */
+static uint32_t get_fb(ALLEGRO_SYSTEM_KMS *s, struct gbm_bo *bo)
+{
+   uint32_t fb_id = (uint32_t)(uintptr_t)gbm_bo_get_user_data(bo);
+   uint32_t handles[4] = {0};
+   uint32_t pitches[4] = {0};
+   uint32_t offsets[4] = {0};
+
+   if (fb_id)
+      return fb_id;
+
+   handles[0] = gbm_bo_get_handle(bo).u32;
+   pitches[0] = gbm_bo_get_stride(bo);
+
+   if (drmModeAddFB2(s->fd, gbm_bo_get_width(bo), gbm_bo_get_height(bo),
+         GBM_FORMAT_XRGB8888, handles, pitches, offsets, &fb_id, 0) != 0) {
+      ALLEGRO_ERROR("drmModeAddFB2 failed: %s\n", strerror(errno));
+      return 0;
+   }
+
+   gbm_bo_set_user_data(bo, (void *)(uintptr_t)fb_id, destroy_fb);
+   return fb_id;
+}
+
+
+static void page_flip_handler(int fd, unsigned int frame,
+   unsigned int sec, unsigned int usec, void *data)
+{
+   ALLEGRO_DISPLAY_KMS *d = data;
+   (void)fd;
+   (void)frame;
+   (void)sec;
+   (void)usec;
+
+   if (d->front_bo)
+      gbm_surface_release_buffer(d->gbm_surface, d->front_bo);
+   d->front_bo = d->pending_bo;
+   d->pending_bo = NULL;
+   d->flip_pending = false;
+}
+
+
+static void wait_for_flip(ALLEGRO_DISPLAY_KMS *d)
+{
+   ALLEGRO_SYSTEM_KMS *s = (void *)al_get_system_driver();
+   drmEventContext ev;
+   struct pollfd pfd;
+
+   memset(&ev, 0, sizeof ev);
+   ev.version = 2;
+   ev.page_flip_handler = page_flip_handler;
+
+   pfd.fd = s->fd;
+   pfd.events = POLLIN;
+
+   while (d->flip_pending) {
+      if (poll(&pfd, 1, -1) < 0) {
+         if (errno == EINTR)
+            continue;
+         ALLEGRO_ERROR("poll failed: %s\n", strerror(errno));
+         break;
+      }
+      drmHandleEvent(s->fd, &ev);
+   }
+}
+
+
+static bool atomic_commit(ALLEGRO_SYSTEM_KMS *s, ALLEGRO_DISPLAY_KMS *d,
+   uint32_t fb_id)
+{
+   ALLEGRO_KMS_PROPS *p = &s->props;
+   drmModeAtomicReq *req;
+   uint32_t flags = DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT;
+   int w = d->mode.hdisplay;
+   int h = d->mode.vdisplay;
+   int ret;
+
+   req = drmModeAtomicAlloc();
+   if (!req)
+      return false;
+
+   if (!d->mode_set) {
+      if (!d->mode_blob_id &&
+            drmModeCreatePropertyBlob(s->fd, &d->mode, sizeof d->mode,
+               &d->mode_blob_id) != 0) {
+         drmModeAtomicFree(req);
+         return false;
+      }
+      drmModeAtomicAddProperty(req, s->connector_id, p->connector_crtc_id,
+         s->crtc_id);
+      drmModeAtomicAddProperty(req, s->crtc_id, p->crtc_mode_id,
+         d->mode_blob_id);
+      drmModeAtomicAddProperty(req, s->crtc_id, p->crtc_active, 1);
+      flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+   }
+
+   drmModeAtomicAddProperty(req, s->plane_id, p->plane_fb_id, fb_id);
+   drmModeAtomicAddProperty(req, s->plane_id, p->plane_crtc_id, s->crtc_id);
+   drmModeAtomicAddProperty(req, s->plane_id, p->plane_src_x, 0);
+   drmModeAtomicAddProperty(req, s->plane_id, p->plane_src_y, 0);
+   drmModeAtomicAddProperty(req, s->plane_id, p->plane_src_w, w << 16);
+   drmModeAtomicAddProperty(req, s->plane_id, p->plane_src_h, h << 16);
+   drmModeAtomicAddProperty(req, s->plane_id, p->plane_crtc_x, 0);
+   drmModeAtomicAddProperty(req, s->plane_id, p->plane_crtc_y, 0);
+   drmModeAtomicAddProperty(req, s->plane_id, p->plane_crtc_w, w);
+   drmModeAtomicAddProperty(req, s->plane_id, p->plane_crtc_h, h);
+
+   ret = drmModeAtomicCommit(s->fd, req, flags, d);
+   drmModeAtomicFree(req);
+   if (ret != 0) {
+      ALLEGRO_ERROR("drmModeAtomicCommit failed: %s\n", strerror(errno));
+      return false;
+   }
+
+   d->mode_set = true;
+   return true;
+}
+
+
+static bool legacy_flip(ALLEGRO_SYSTEM_KMS *s, ALLEGRO_DISPLAY_KMS *d,
+   uint32_t fb_id)
+{
+   if (!d->mode_set) {
+      if (drmModeSetCrtc(s->fd, s->crtc_id, fb_id, 0, 0, &s->connector_id, 1,
+            &d->mode) != 0) {
+         ALLEGRO_ERROR("drmModeSetCrtc failed: %s\n", strerror(errno));
+         return false;
+      }
+      d->mode_set = true;
+      /* The buffer is on screen right away, no event will follow. */
+      page_flip_handler(s->fd, 0, 0, 0, d);
+      return true;
+   }
+
+   if (drmModePageFlip(s->fd, s->crtc_id, fb_id, DRM_MODE_PAGE_FLIP_EVENT,
+         d) != 0) {
+      ALLEGRO_ERROR("drmModePageFlip failed: %s\n", strerror(errno));
+      return false;
+   }
+   return true;
+}
+
+
+static void move_cursor(ALLEGRO_DISPLAY_KMS *d)
+{
+   ALLEGRO_SYSTEM_KMS *s = (void *)al_get_system_driver();
+   ALLEGRO_MOUSE_STATE state;
+
+   if (!d->cursor_shown || !d->cursor_bo || !al_is_mouse_installed())
+      return;
+
+   al_get_mouse_state(&state);
+   drmModeMoveCursor(s->fd, s->crtc_id, state.x - d->cursor_focus_x,
+      state.y - d->cursor_focus_y);
+}
+
+
+/* Queues the current back buffer for scanout at the next vblank. Only one
+ * flip can be outstanding, so this blocks on the previous one, which is
+ * also what throttles rendering to the refresh rate.
+ */
+static void present(ALLEGRO_DISPLAY_KMS *d)
+{
+   ALLEGRO_SYSTEM_KMS *s = (void *)al_get_system_driver();
+   struct gbm_bo *bo;
+   uint32_t fb_id;
+   bool ok;
+
+   wait_for_flip(d);
+
+   bo = gbm_surface_lock_front_buffer(d->gbm_surface);
+   if (!bo) {
+      ALLEGRO_ERROR("gbm_surface_lock_front_buffer failed.\n");
+      return;
+   }
+
+   fb_id = get_fb(s, bo);
+   if (!fb_id) {
+      gbm_surface_release_buffer(d->gbm_surface, bo);
+      return;
+   }
+
+   d->pending_bo = bo;
+   d->flip_pending = true;
+
+   if (s->atomic)
+      ok = atomic_commit(s, d, fb_id);
+   else
+      ok = legacy_flip(s, d, fb_id);
+
+   if (!ok) {
+      gbm_surface_release_buffer(d->gbm_surface, bo);
+      d->pending_bo = NULL;
+      d->flip_pending = false;
+   }
+
+   move_cursor(d);
+}
+
+
+static ALLEGRO_DISPLAY *kms_create_display(int w, int h)
+{
+   ALLEGRO_SYSTEM_KMS *system = (void *)al_get_system_driver();
+   ALLEGRO_DISPLAY_KMS *d;
+   ALLEGRO_DISPLAY *display;
+   ALLEGRO_DISPLAY_KMS **add;
+   ALLEGRO_OGL_EXTRAS *ogl;
+   int v;
+
+   if (_al_vector_size(&system->system.displays) > 0) {
+      ALLEGRO_ERROR("Only one display is supported.\n");
+      return NULL;
+   }
+
+   d = al_calloc(1, sizeof *d);
+   display = (void *)d;
+   ogl = al_calloc(1, sizeof *ogl);
+   display->ogl_extras = ogl;
+   display->vt = _al_display_kms_driver();
+   display->flags = al_get_new_display_flags();
+   display->refresh_rate = al_get_new_display_refresh_rate();
+
+   d->mode = system->modes[choose_mode(system, w, h, display->refresh_rate)];
+   display->w = d->mode.hdisplay;
+   display->h = d->mode.vdisplay;
+   display->refresh_rate = d->mode.vrefresh;
+
+   display->flags |= ALLEGRO_OPENGL | ALLEGRO_FULLSCREEN;
+#ifdef ALLEGRO_CFG_OPENGLES2
+   display->flags |= ALLEGRO_PROGRAMMABLE_PIPELINE;
+#endif
+#ifdef ALLEGRO_CFG_OPENGLES
+   display->flags |= ALLEGRO_OPENGL_ES_PROFILE;
+#endif
+
+   d->gbm_surface = gbm_surface_create(system->gbm, display->w, display->h,
+      GBM_FORMAT_XRGB8888, GBM_BO_USE_SCANOUT | GBM_BO_USE_RENDERING);
+   if (!d->gbm_surface) {
+      ALLEGRO_ERROR("gbm_surface_create failed.\n");
+      al_free(ogl);
+      al_free(d);
+      return NULL;
+   }
+
+   /* Add ourself to the list of displays. */
+   add = _al_vector_alloc_back(&system->system.displays);
+   *add = d;
+
+   /* Each display is an event source. */
+   _al_event_source_init(&display->es);
+
+   if (!init_egl(d)) {
+      al_destroy_display(display);
+      return NULL;
+   }
+
+   display->extra_settings.settings[ALLEGRO_COMPATIBLE_DISPLAY] = 1;
+   display->extra_settings.settings[ALLEGRO_VSYNC] = 1;
+
+   _al_ogl_manage_extensions(display);
+   _al_ogl_set_extensions(ogl->extension_api);
+
+   setup_gl(display);
+
+   al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA);
+
+   if (al_is_mouse_installed()) {
+      _al_evdev_set_mouse_range(0, 0, display->w-1, display->h-1);
+   }
+
+   /* Fill in opengl version */
+   v = display->ogl_extras->ogl_info.version;
+   display->extra_settings.settings[ALLEGRO_OPENGL_MAJOR_VERSION] = (v >> 24) & 0xFF;
+   display->extra_settings.settings[ALLEGRO_OPENGL_MINOR_VERSION] = (v >> 16) & 0xFF;
+
+   ALLEGRO_INFO("Created %dx%d@%d display.\n", display->w, display->h,
+      display->refresh_rate);
+
+   return display;
+}
+
+
+static void kms_destroy_display(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_DISPLAY_KMS *d = (void *)display;
+   ALLEGRO_SYSTEM_KMS *system = (void *)al_get_system_driver();
+   drmModeCrtc *crtc = system->saved_crtc;
+
+   if (d->egl_context != EGL_NO_CONTEXT) {
+      _al_set_current_display_only(display);
+
+      while (display->bitmaps._size > 0) {
+         ALLEGRO_BITMAP **bptr = _al_vector_ref_back(&display->bitmaps);
+         ALLEGRO_BITMAP *b = *bptr;
+         _al_convert_to_memory_bitmap(b);
+      }
+
+      _al_ogl_destroy_upload_contexts(display);
+   }
+
+   wait_for_flip(d);
+
+   if (d->cursor_bo) {
+      drmModeSetCursor(system->fd, system->crtc_id, 0, 0, 0);
+      gbm_bo_destroy(d->cursor_bo);
+   }
+
+   /* Give the screen back to the console before the buffers go away. */
+   if (d->mode_set && crtc) {
+      drmModeSetCrtc(system->fd, crtc->crtc_id, crtc->buffer_id, crtc->x,
+         crtc->y, &system->connector_id, 1, &crtc->mode);
+   }
+
+   if (d->egl_display != EGL_NO_DISPLAY) {
+      eglMakeCurrent(d->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+         EGL_NO_CONTEXT);
+      if (d->egl_surface != EGL_NO_SURFACE)
+         eglDestroySurface(d->egl_display, d->egl_surface);
+      if (d->egl_context != EGL_NO_CONTEXT)
+         eglDestroyContext(d->egl_display, d->egl_context);
+      eglTerminate(d->egl_display);
+   }
+
+   if (d->front_bo)
+      gbm_surface_release_buffer(d->gbm_surface, d->front_bo);
+   gbm_surface_destroy(d->gbm_surface);
+
+   if (d->mode_blob_id)
+      drmModeDestroyPropertyBlob(system->fd, d->mode_blob_id);
+
+   _al_event_source_free(&display->es);
+   _al_vector_find_and_delete(&system->system.displays, &display);
+
+   if (system->mouse_grab_display == display) {
+      system->mouse_grab_display = NULL;
+   }
+
+   al_free(display->ogl_extras);
+   al_free(d);
+}
+
+
+/* A context sharing the display's objects. With EGL_KHR_surfaceless_context
+ * it needs no surface at all, otherwise a 1x1 pbuffer.
+ */
+typedef struct KMS_UPLOAD_CONTEXT
+{
+   EGLContext context;
+   EGLSurface surface;
+} KMS_UPLOAD_CONTEXT;
+
+
+static void kms_destroy_upload_context(ALLEGRO_DISPLAY *display,
+   void *context)
+{
+   ALLEGRO_DISPLAY_KMS *d = (void *)display;
+   KMS_UPLOAD_CONTEXT *uc = context;
+
+   if (uc->surface != EGL_NO_SURFACE)
+      eglDestroySurface(d->egl_display, uc->surface);
+   if (uc->context != EGL_NO_CONTEXT)
+      eglDestroyContext(d->egl_display, uc->context);
+   al_free(uc);
+}
+
+
+static void *kms_create_upload_context(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_DISPLAY_KMS *d = (void *)display;
+   const EGLint ctxattr[] = {
+      EGL_CONTEXT_CLIENT_VERSION, d->egl_context_version,
+      EGL_NONE
+   };
+   const EGLint surfattr[] = {
+      EGL_WIDTH, 1,
+      EGL_HEIGHT, 1,
+      EGL_NONE
+   };
+   const char *ext = eglQueryString(d->egl_display, EGL_EXTENSIONS);
+   KMS_UPLOAD_CONTEXT *uc;
+
+   uc = al_calloc(1, sizeof(*uc));
+   if (!uc)
+      return NULL;
+
+   uc->context = eglCreateContext(d->egl_display, d->egl_config,
+      d->egl_context, ctxattr);
+   uc->surface = EGL_NO_SURFACE;
+   if (!ext || !strstr(ext, "EGL_KHR_surfaceless_context")) {
+      uc->surface = eglCreatePbufferSurface(d->egl_display, d->egl_config,
+         surfattr);
+      if (uc->surface == EGL_NO_SURFACE) {
+         ALLEGRO_WARN("Neither surfaceless contexts nor pbuffers.\n");
+         kms_destroy_upload_context(display, uc);
+         return NULL;
+      }
+   }
+   if (uc->context == EGL_NO_CONTEXT) {
+      ALLEGRO_ERROR("Failed to create an upload context.\n");
+      kms_destroy_upload_context(display, uc);
+      return NULL;
+   }
+
+   return uc;
+}
+
+
+static bool kms_make_upload_context_current(ALLEGRO_DISPLAY *display,
+   void *context)
+{
+   ALLEGRO_DISPLAY_KMS *d = (void *)display;
+   KMS_UPLOAD_CONTEXT *uc = context;
+
+   if (!uc) {
+      return eglMakeCurrent(d->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+         EGL_NO_CONTEXT);
+   }
+   return eglMakeCurrent(d->egl_display, uc->surface, uc->surface,
+      uc->context);
+}
+
+
+static bool kms_set_current_display(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_DISPLAY_KMS *d = (void *)display;
+
+   if (!eglMakeCurrent(d->egl_display, d->egl_surface, d->egl_surface,
+         d->egl_context)) {
+      return false;
+   }
+   _al_ogl_update_render_state(display);
+   return true;
+}
+
+
+static void kms_unset_current_display(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_DISPLAY_KMS *d = (void *)display;
+
+   eglMakeCurrent(d->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+      EGL_NO_CONTEXT);
+}
+
+
+static int kms_get_orientation(ALLEGRO_DISPLAY *d)
+{
+   (void)d;
+   return ALLEGRO_DISPLAY_ORIENTATION_0_DEGREES;
+}
+
+
+/* There can be only one display and only one OpenGL context, so all
+ * bitmaps are compatible.
+ */
+static bool kms_is_compatible_bitmap(ALLEGRO_DISPLAY *display,
+   ALLEGRO_BITMAP *bitmap)
+{
+   (void)display;
+   (void)bitmap;
+   return true;
+}
+
+
+/* Resizing would need a modeset to another connector mode. */
+static bool kms_resize_display(ALLEGRO_DISPLAY *d, int w, int h)
+{
+   (void)d;
+   (void)w;
+   (void)h;
+   return false;
+}
+
+
+/* There is no window manager to show icons or titles. */
+static void kms_set_icons(ALLEGRO_DISPLAY *d, int num_icons,
+   ALLEGRO_BITMAP *bitmaps[])
+{
+   (void)d;
+   (void)num_icons;
+   (void)bitmaps;
+}
+
+
+static void kms_set_window_title(ALLEGRO_DISPLAY *display, char const *title)
+{
+   (void)display;
+   (void)title;
+}
+
+
+/* The display always spans the entire screen. */
+static void kms_set_window_position(ALLEGRO_DISPLAY *display, int x, int y)
+{
+   (void)display;
+   (void)x;
+   (void)y;
+}
+
+
+static void kms_get_window_position(ALLEGRO_DISPLAY *display, int *x, int *y)
+{
+   (void)display;
+   *x = 0;
+   *y = 0;
+}
+
+
+static bool kms_set_window_constraints(ALLEGRO_DISPLAY *display,
+   int min_w, int min_h, int max_w, int max_h)
+{
+   (void)display;
+   (void)min_w;
+   (void)min_h;
+   (void)max_w;
+   (void)max_h;
+   return false;
+}
+
+
+static bool kms_get_window_constraints(ALLEGRO_DISPLAY *display,
+   int *min_w, int *min_h, int *max_w, int *max_h)
+{
+   (void)display;
+   (void)min_w;
+   (void)min_h;
+   (void)max_w;
+   (void)max_h;
+   return false;
+}
+
+
+/* Always fullscreen. */
+static bool kms_set_display_flag(ALLEGRO_DISPLAY *display, int flag,
+   bool onoff)
+{
+   (void)display;
+   (void)flag;
+   (void)onoff;
+   return false;
+}
+
+
+static bool kms_wait_for_vsync(ALLEGRO_DISPLAY *display)
+{
+   wait_for_flip((ALLEGRO_DISPLAY_KMS *)display);
+   return true;
+}
+
+
+static void kms_flip_display(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_DISPLAY_KMS *d = (void *)display;
+
+   eglSwapBuffers(d->egl_display, d->egl_surface);
+   present(d);
+}
+
+
+static void kms_update_display_region(ALLEGRO_DISPLAY *d, int x, int y,
+   int w, int h)
+{
+   (void)x;
+   (void)y;
+   (void)w;
+   (void)h;
+   kms_flip_display(d);
+}
+
+
+/* EGL_KHR_swap_buffers_with_damage, looked up on first use. Older EGL
+ * headers don't declare it, so we have our own typedef.
+ */
+typedef EGLBoolean (*SWAP_BUFFERS_WITH_DAMAGE)(EGLDisplay dpy,
+   EGLSurface surface, EGLint *rects, EGLint n_rects);
+
+static SWAP_BUFFERS_WITH_DAMAGE get_swap_buffers_with_damage(
+   EGLDisplay egl_display)
+{
+   static SWAP_BUFFERS_WITH_DAMAGE swap_with_damage;
+   static bool looked_up = false;
+
+   if (!looked_up) {
+      const char *ext = eglQueryString(egl_display, EGL_EXTENSIONS);
+      if (ext && strstr(ext, "EGL_KHR_swap_buffers_with_damage")) {
+         swap_with_damage = (SWAP_BUFFERS_WITH_DAMAGE)
+            eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+      }
+      else if (ext && strstr(ext, "EGL_EXT_swap_buffers_with_damage")) {
+         swap_with_damage = (SWAP_BUFFERS_WITH_DAMAGE)
+            eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+      }
+      ALLEGRO_DEBUG("eglSwapBuffersWithDamage: %s\n",
+         swap_with_damage ? "yes" : "no");
+      looked_up = true;
+   }
+   return swap_with_damage;
+}
+
+
+static void kms_flip_display_regions(ALLEGRO_DISPLAY *display,
+   const int *rects, int num_rects)
+{
+   ALLEGRO_DISPLAY_KMS *d = (void *)display;
+   SWAP_BUFFERS_WITH_DAMAGE swap_with_damage =
+      get_swap_buffers_with_damage(d->egl_display);
+   EGLint *damage;
+   int i;
+
+   if (!swap_with_damage) {
+      kms_flip_display(display);
+      return;
+   }
+
+   damage = al_malloc(num_rects * 4 * sizeof(EGLint));
+   if (!damage) {
+      kms_flip_display(display);
+      return;
+   }
+
+   /* EGL counts y from the bottom. */
+   for (i = 0; i < num_rects; i++) {
+      const int *r = rects + i * 4;
+      damage[i * 4 + 0] = r[0];
+      damage[i * 4 + 1] = display->h - r[1] - r[3];
+      damage[i * 4 + 2] = r[2];
+      damage[i * 4 + 3] = r[3];
+   }
+   swap_with_damage(d->egl_display, d->egl_surface, damage, num_rects);
+   al_free(damage);
+
+   present(d);
+}
+
+
+static bool kms_acknowledge_resize(ALLEGRO_DISPLAY *d)
+{
+   setup_gl(d);
+   return true;
+}
+
+
+static bool kms_show_mouse_cursor(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_DISPLAY_KMS *d = (void *)display;
+   ALLEGRO_SYSTEM_KMS *s = (void *)al_get_system_driver();
+
+   if (!d->cursor_bo)
+      return false;
+
+   if (drmModeSetCursor2(s->fd, s->crtc_id, gbm_bo_get_handle(d->cursor_bo).u32,
+         CURSOR_SIZE, CURSOR_SIZE, d->cursor_focus_x, d->cursor_focus_y) != 0) {
+      return false;
+   }
+   d->cursor_shown = true;
+   move_cursor(d);
+   return true;
+}
+
+
+static bool kms_hide_mouse_cursor(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_DISPLAY_KMS *d = (void *)display;
+   ALLEGRO_SYSTEM_KMS *s = (void *)al_get_system_driver();
+
+   drmModeSetCursor(s->fd, s->crtc_id, 0, 0, 0);
+   d->cursor_shown = false;
+   return true;
+}
+
+
+/* Copies the cursor image into a hardware cursor buffer, which must be
+ * exactly CURSOR_SIZE square.
+ */
+static bool kms_set_mouse_cursor(ALLEGRO_DISPLAY *display,
+   ALLEGRO_MOUSE_CURSOR *cursor)
+{
+   ALLEGRO_DISPLAY_KMS *d = (void *)display;
+   ALLEGRO_SYSTEM_KMS *s = (void *)al_get_system_driver();
+   ALLEGRO_MOUSE_CURSOR_KMS *kms_cursor = (void *)cursor;
+   int w = _ALLEGRO_MIN(al_get_bitmap_width(kms_cursor->bitmap), CURSOR_SIZE);
+   int h = _ALLEGRO_MIN(al_get_bitmap_height(kms_cursor->bitmap), CURSOR_SIZE);
+   uint32_t *data;
+   ALLEGRO_LOCKED_REGION *lr;
+   int y;
+
+   if (!d->cursor_bo) {
+      d->cursor_bo = gbm_bo_create(s->gbm, CURSOR_SIZE, CURSOR_SIZE,
+         GBM_FORMAT_ARGB8888, GBM_BO_USE_CURSOR | GBM_BO_USE_WRITE);
+      if (!d->cursor_bo) {
+         ALLEGRO_WARN("No hardware cursor buffer.\n");
+         return false;
+      }
+   }
+
+   lr = al_lock_bitmap(kms_cursor->bitmap, ALLEGRO_PIXEL_FORMAT_ARGB_8888,
+      ALLEGRO_LOCK_READONLY);
+   if (!lr)
+      return false;
+
+   data = al_calloc(CURSOR_SIZE * CURSOR_SIZE, sizeof(uint32_t));
+   for (y = 0; y < h; y++) {
+      memcpy(data + y * CURSOR_SIZE, (uint8_t *)lr->data + lr->pitch * y,
+         w * sizeof(uint32_t));
+   }
+   al_unlock_bitmap(kms_cursor->bitmap);
+
+   gbm_bo_write(d->cursor_bo, data, CURSOR_SIZE * CURSOR_SIZE * sizeof(uint32_t));
+   al_free(data);
+
+   d->cursor_focus_x = kms_cursor->focus_x;
+   d->cursor_focus_y = kms_cursor->focus_y;
+
+   if (d->cursor_shown)
+      kms_show_mouse_cursor(display);
+   return true;
+}
+
+
+/* There is no system cursor theme to draw from. */
+static bool kms_set_system_mouse_cursor(ALLEGRO_DISPLAY *display,
+   ALLEGRO_SYSTEM_MOUSE_CURSOR cursor_id)
+{
+   if (cursor_id == ALLEGRO_SYSTEM_MOUSE_CURSOR_NONE) {
+      kms_hide_mouse_cursor(display);
+      return true;
+   }
+   return false;
+}
+
+
+/* Obtain a reference to this driver. */
+ALLEGRO_DISPLAY_INTERFACE *_al_display_kms_driver(void)
+{
+   if (vt)
+      return vt;
+
+   vt = al_calloc(1, sizeof *vt);
+
+   vt->id = ALLEGRO_SYSTEM_ID_KMS;
+   vt->create_display = kms_create_display;
+   vt->destroy_display = kms_destroy_display;
+   vt->set_current_display = kms_set_current_display;
+   vt->unset_current_display = kms_unset_current_display;
+   vt->flip_display = kms_flip_display;
+   vt->update_display_region = kms_update_display_region;
+   vt->flip_display_regions = kms_flip_display_regions;
+   vt->acknowledge_resize = kms_acknowledge_resize;
+   vt->create_bitmap = _al_ogl_create_bitmap;
+   vt->get_backbuffer = _al_ogl_get_backbuffer;
+   vt->set_target_bitmap = _al_ogl_set_target_bitmap;
+
+   vt->get_orientation = kms_get_orientation;
+
+   vt->is_compatible_bitmap = kms_is_compatible_bitmap;
+   vt->resize_display = kms_resize_display;
+   vt->set_icons = kms_set_icons;
+   vt->set_window_title = kms_set_window_title;
+   vt->set_window_position = kms_set_window_position;
+   vt->get_window_position = kms_get_window_position;
+   vt->set_window_constraints = kms_set_window_constraints;
+   vt->get_window_constraints = kms_get_window_constraints;
+   vt->set_display_flag = kms_set_display_flag;
+   vt->wait_for_vsync = kms_wait_for_vsync;
+
+   vt->update_render_state = _al_ogl_update_render_state;
+   vt->create_upload_context = kms_create_upload_context;
+   vt->make_upload_context_current = kms_make_upload_context_current;
+   vt->destroy_upload_context = kms_destroy_upload_context;
+
+   _al_ogl_add_drawing_functions(vt);
+
+   vt->set_mouse_cursor = kms_set_mouse_cursor;
+   vt->set_system_mouse_cursor = kms_set_system_mouse_cursor;
+   vt->show_mouse_cursor = kms_show_mouse_cursor;
+   vt->hide_mouse_cursor = kms_hide_mouse_cursor;
+
+   return vt;
+}
+
+/* vim: set sts=3 sw=3 et: */
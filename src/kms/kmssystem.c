@@ -0,0 +1,498 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      DRM/KMS system driver.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_kms.h"
+#include "allegro5/platform/aintunix.h"
+#include "allegro5/platform/aintlnx.h"
+
+ALLEGRO_DEBUG_CHANNEL("system")
+
+#define MAX_CARDS 8
+
+static ALLEGRO_SYSTEM_INTERFACE *kms_vt;
+
+
+/* Returns the ID of the named property of a KMS object, or 0. */
+static uint32_t get_prop(int fd, uint32_t obj_id, uint32_t obj_type,
+   const char *name, uint64_t *value)
+{
+   drmModeObjectProperties *props;
+   uint32_t id = 0;
+   uint32_t i;
+
+   props = drmModeObjectGetProperties(fd, obj_id, obj_type);
+   if (!props)
+      return 0;
+
+   for (i = 0; i < props->count_props && !id; i++) {
+      drmModePropertyRes *prop = drmModeGetProperty(fd, props->props[i]);
+      if (!prop)
+         continue;
+      if (strcmp(prop->name, name) == 0) {
+         id = prop->prop_id;
+         if (value)
+            *value = props->prop_values[i];
+      }
+      drmModeFreeProperty(prop);
+   }
+
+   drmModeFreeObjectProperties(props);
+   return id;
+}
+
+
+static uint32_t find_primary_plane(int fd, int crtc_index)
+{
+   drmModePlaneRes *res = drmModeGetPlaneResources(fd);
+   uint32_t plane_id = 0;
+   uint32_t i;
+
+   if (!res)
+      return 0;
+
+   for (i = 0; i < res->count_planes && !plane_id; i++) {
+      drmModePlane *plane = drmModeGetPlane(fd, res->planes[i]);
+      uint64_t type = 0;
+      if (!plane)
+         continue;
+      if ((plane->possible_crtcs & (1 << crtc_index)) &&
+            get_prop(fd, plane->plane_id, DRM_MODE_OBJECT_PLANE, "type",
+               &type) &&
+            type == DRM_PLANE_TYPE_PRIMARY) {
+         plane_id = plane->plane_id;
+      }
+      drmModeFreePlane(plane);
+   }
+
+   drmModeFreePlaneResources(res);
+   return plane_id;
+}
+
+
+static bool init_atomic(ALLEGRO_SYSTEM_KMS *s, int crtc_index)
+{
+   ALLEGRO_KMS_PROPS *p = &s->props;
+   int fd = s->fd;
+
+   if (drmSetClientCap(fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) != 0 ||
+         drmSetClientCap(fd, DRM_CLIENT_CAP_ATOMIC, 1) != 0) {
+      return false;
+   }
+
+   s->plane_id = find_primary_plane(fd, crtc_index);
+   if (!s->plane_id)
+      return false;
+
+#define CONNECTOR_PROP(name) \
+   get_prop(fd, s->connector_id, DRM_MODE_OBJECT_CONNECTOR, name, NULL)
+#define CRTC_PROP(name) \
+   get_prop(fd, s->crtc_id, DRM_MODE_OBJECT_CRTC, name, NULL)
+#define PLANE_PROP(name) \
+   get_prop(fd, s->plane_id, DRM_MODE_OBJECT_PLANE, name, NULL)
+
+   p->connector_crtc_id = CONNECTOR_PROP("CRTC_ID");
+   p->crtc_mode_id = CRTC_PROP("MODE_ID");
+   p->crtc_active = CRTC_PROP("ACTIVE");
+   p->plane_fb_id = PLANE_PROP("FB_ID");
+   p->plane_crtc_id = PLANE_PROP("CRTC_ID");
+   p->plane_src_x = PLANE_PROP("SRC_X");
+   p->plane_src_y = PLANE_PROP("SRC_Y");
+   p->plane_src_w = PLANE_PROP("SRC_W");
+   p->plane_src_h = PLANE_PROP("SRC_H");
+   p->plane_crtc_x = PLANE_PROP("CRTC_X");
+   p->plane_crtc_y = PLANE_PROP("CRTC_Y");
+   p->plane_crtc_w = PLANE_PROP("CRTC_W");
+   p->plane_crtc_h = PLANE_PROP("CRTC_H");
+
+#undef CONNECTOR_PROP
+#undef CRTC_PROP
+#undef PLANE_PROP
+
+   return p->connector_crtc_id && p->crtc_mode_id && p->crtc_active &&
+      p->plane_fb_id && p->plane_crtc_id && p->plane_src_x &&
+      p->plane_src_y && p->plane_src_w && p->plane_src_h &&
+      p->plane_crtc_x && p->plane_crtc_y && p->plane_crtc_w &&
+      p->plane_crtc_h;
+}
+
+
+/* Picks the CRTC currently driving the connector, or else the first one
+ * any of its encoders can use. Returns the index of the CRTC or -1.
+ */
+static int find_crtc(int fd, drmModeRes *res, drmModeConnector *connector,
+   uint32_t *crtc_id)
+{
+   drmModeEncoder *encoder;
+   int i, j;
+
+   if (connector->encoder_id) {
+      encoder = drmModeGetEncoder(fd, connector->encoder_id);
+      if (encoder) {
+         *crtc_id = encoder->crtc_id;
+         drmModeFreeEncoder(encoder);
+         for (i = 0; i < res->count_crtcs && *crtc_id; i++) {
+            if (res->crtcs[i] == *crtc_id)
+               return i;
+         }
+      }
+   }
+
+   for (j = 0; j < connector->count_encoders; j++) {
+      encoder = drmModeGetEncoder(fd, connector->encoders[j]);
+      if (!encoder)
+         continue;
+      for (i = 0; i < res->count_crtcs; i++) {
+         if (encoder->possible_crtcs & (1 << i)) {
+            *crtc_id = res->crtcs[i];
+            drmModeFreeEncoder(encoder);
+            return i;
+         }
+      }
+      drmModeFreeEncoder(encoder);
+   }
+
+   return -1;
+}
+
+
+/* Finds the first connected output of the device. */
+static bool init_output(ALLEGRO_SYSTEM_KMS *s)
+{
+   drmModeRes *res = drmModeGetResources(s->fd);
+   drmModeConnector *connector = NULL;
+   int crtc_index = -1;
+   int i;
+
+   if (!res)
+      return false;
+
+   for (i = 0; i < res->count_connectors; i++) {
+      connector = drmModeGetConnector(s->fd, res->connectors[i]);
+      if (connector && connector->connection == DRM_MODE_CONNECTED &&
+            connector->count_modes > 0) {
+         crtc_index = find_crtc(s->fd, res, connector, &s->crtc_id);
+         if (crtc_index >= 0)
+            break;
+      }
+      drmModeFreeConnector(connector);
+      connector = NULL;
+   }
+   drmModeFreeResources(res);
+
+   if (!connector)
+      return false;
+
+   s->connector_id = connector->connector_id;
+   s->mm_width = connector->mmWidth;
+   s->mm_height = connector->mmHeight;
+   s->num_modes = connector->count_modes;
+   s->modes = al_malloc(s->num_modes * sizeof *s->modes);
+   memcpy(s->modes, connector->modes, s->num_modes * sizeof *s->modes);
+   s->default_mode = 0;
+   for (i = 0; i < s->num_modes; i++) {
+      if (s->modes[i].type & DRM_MODE_TYPE_PREFERRED) {
+         s->default_mode = i;
+         break;
+      }
+   }
+   drmModeFreeConnector(connector);
+
+   s->saved_crtc = drmModeGetCrtc(s->fd, s->crtc_id);
+
+   s->atomic = init_atomic(s, crtc_index);
+   if (!s->atomic) {
+      /* The atomic cap may have been granted before something else was
+       * missing, but the legacy API works either way.
+       */
+      ALLEGRO_WARN("No atomic modesetting, using legacy page flips.\n");
+   }
+
+   ALLEGRO_INFO("Connector %u, CRTC %u, plane %u, %d modes, default %s.\n",
+      s->connector_id, s->crtc_id, s->plane_id, s->num_modes,
+      s->modes[s->default_mode].name);
+   return true;
+}
+
+
+static bool open_device(ALLEGRO_SYSTEM_KMS *s, const char *path)
+{
+   s->fd = open(path, O_RDWR | O_CLOEXEC);
+   if (s->fd < 0)
+      return false;
+
+   if (init_output(s)) {
+      s->gbm = gbm_create_device(s->fd);
+      if (s->gbm) {
+         ALLEGRO_INFO("Using %s.\n", path);
+         return true;
+      }
+      ALLEGRO_ERROR("gbm_create_device failed for %s.\n", path);
+   }
+
+   al_free(s->modes);
+   s->modes = NULL;
+   if (s->saved_crtc) {
+      drmModeFreeCrtc(s->saved_crtc);
+      s->saved_crtc = NULL;
+   }
+   close(s->fd);
+   s->fd = -1;
+   return false;
+}
+
+
+static ALLEGRO_SYSTEM *kms_initialize(int flags)
+{
+   ALLEGRO_SYSTEM_KMS *s;
+   const char *device;
+   char path[32];
+   int i;
+   (void)flags;
+
+   s = al_calloc(1, sizeof *s);
+   s->fd = -1;
+
+   device = al_get_config_value(al_get_system_config(), "kms", "device");
+   if (device && device[0]) {
+      open_device(s, device);
+   }
+   else {
+      for (i = 0; i < MAX_CARDS && s->fd < 0; i++) {
+         snprintf(path, sizeof(path), "/dev/dri/card%d", i);
+         open_device(s, path);
+      }
+   }
+
+   if (s->fd < 0) {
+      ALLEGRO_ERROR("No DRM device with a connected output.\n");
+      al_free(s);
+      return NULL;
+   }
+
+   _al_vector_init(&s->system.displays, sizeof (ALLEGRO_DISPLAY_KMS *));
+
+   _al_unix_init_time();
+
+   s->inhibit_screensaver = false;
+
+   s->system.vt = kms_vt;
+
+   return &s->system;
+}
+
+
+static void kms_shutdown_system(void)
+{
+   ALLEGRO_SYSTEM *s = al_get_system_driver();
+   ALLEGRO_SYSTEM_KMS *skms = (void *)s;
+
+   ALLEGRO_INFO("shutting down.\n");
+
+   /* Close all open displays. */
+   while (_al_vector_size(&s->displays) > 0) {
+      ALLEGRO_DISPLAY **dptr = _al_vector_ref(&s->displays, 0);
+      ALLEGRO_DISPLAY *d = *dptr;
+      al_destroy_display(d);
+   }
+   _al_vector_free(&s->displays);
+
+   if (skms->saved_crtc)
+      drmModeFreeCrtc(skms->saved_crtc);
+   gbm_device_destroy(skms->gbm);
+   close(skms->fd);
+   al_free(skms->modes);
+
+   al_free(skms);
+}
+
+
+static ALLEGRO_KEYBOARD_DRIVER *kms_get_keyboard_driver(void)
+{
+   return _al_linux_keyboard_driver_list[0].driver;
+}
+
+
+static ALLEGRO_MOUSE_DRIVER *kms_get_mouse_driver(void)
+{
+   return _al_linux_mouse_driver_list[0].driver;
+}
+
+
+static ALLEGRO_JOYSTICK_DRIVER *kms_get_joystick_driver(void)
+{
+   return _al_joystick_driver_list[0].driver;
+}
+
+
+static ALLEGRO_HAPTIC_DRIVER *kms_get_haptic_driver(void)
+{
+   return _al_haptic_driver_list[0].driver;
+}
+
+
+static int kms_get_num_video_adapters(void)
+{
+   return 1;
+}
+
+
+static bool kms_get_monitor_info(int adapter, ALLEGRO_MONITOR_INFO *info)
+{
+   ALLEGRO_SYSTEM_KMS *s = (void *)al_get_system_driver();
+   drmModeModeInfo *mode = &s->modes[s->default_mode];
+
+   if (adapter != 0)
+      return false;
+
+   info->x1 = 0;
+   info->y1 = 0;
+   info->x2 = mode->hdisplay;
+   info->y2 = mode->vdisplay;
+   return true;
+}
+
+
+static int kms_get_monitor_dpi(int adapter)
+{
+   ALLEGRO_SYSTEM_KMS *s = (void *)al_get_system_driver();
+   drmModeModeInfo *mode = &s->modes[s->default_mode];
+
+   if (adapter != 0 || s->mm_width <= 0)
+      return 0;
+
+   return (int)(mode->hdisplay * 25.4f / s->mm_width + 0.5f);
+}
+
+
+static bool kms_get_cursor_position(int *ret_x, int *ret_y)
+{
+   /* There is no desktop, so nothing but our own displays. */
+   (void)ret_x;
+   (void)ret_y;
+   return false;
+}
+
+
+static bool kms_inhibit_screensaver(bool inhibit)
+{
+   ALLEGRO_SYSTEM_KMS *system = (void *)al_get_system_driver();
+
+   system->inhibit_screensaver = inhibit;
+   return true;
+}
+
+
+static int kms_get_num_display_modes(void)
+{
+   ALLEGRO_SYSTEM_KMS *s = (void *)al_get_system_driver();
+   return s->num_modes;
+}
+
+
+static ALLEGRO_DISPLAY_MODE *kms_get_display_mode(int mode,
+   ALLEGRO_DISPLAY_MODE *dm)
+{
+   ALLEGRO_SYSTEM_KMS *s = (void *)al_get_system_driver();
+
+   if (mode < 0 || mode >= s->num_modes)
+      return NULL;
+
+   dm->width = s->modes[mode].hdisplay;
+   dm->height = s->modes[mode].vdisplay;
+   dm->format = ALLEGRO_PIXEL_FORMAT_XRGB_8888;
+   dm->refresh_rate = s->modes[mode].vrefresh;
+   return dm;
+}
+
+
+static ALLEGRO_MOUSE_CURSOR *kms_create_mouse_cursor(ALLEGRO_BITMAP *bmp,
+   int focus_x, int focus_y)
+{
+   ALLEGRO_MOUSE_CURSOR_KMS *cursor;
+   ALLEGRO_STATE state;
+
+   cursor = al_malloc(sizeof *cursor);
+   if (!cursor)
+      return NULL;
+
+   al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+   al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ARGB_8888);
+   al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+   cursor->bitmap = al_clone_bitmap(bmp);
+   al_restore_state(&state);
+
+   if (!cursor->bitmap) {
+      al_free(cursor);
+      return NULL;
+   }
+
+   cursor->focus_x = focus_x;
+   cursor->focus_y = focus_y;
+   return (ALLEGRO_MOUSE_CURSOR *)cursor;
+}
+
+
+static void kms_destroy_mouse_cursor(ALLEGRO_MOUSE_CURSOR *cursor)
+{
+   ALLEGRO_MOUSE_CURSOR_KMS *kms_cursor = (void *)cursor;
+   al_destroy_bitmap(kms_cursor->bitmap);
+   al_free(kms_cursor);
+}
+
+
+/* Internal function to get a reference to this driver. */
+ALLEGRO_SYSTEM_INTERFACE *_al_system_kms_driver(void)
+{
+   if (kms_vt)
+      return kms_vt;
+
+   kms_vt = al_calloc(1, sizeof *kms_vt);
+
+   kms_vt->id = ALLEGRO_SYSTEM_ID_KMS;
+   kms_vt->initialize = kms_initialize;
+   kms_vt->get_display_driver = _al_display_kms_driver;
+   kms_vt->get_keyboard_driver = kms_get_keyboard_driver;
+   kms_vt->get_mouse_driver = kms_get_mouse_driver;
+   kms_vt->get_joystick_driver = kms_get_joystick_driver;
+   kms_vt->get_haptic_driver = kms_get_haptic_driver;
+   kms_vt->get_num_display_modes = kms_get_num_display_modes;
+   kms_vt->get_display_mode = kms_get_display_mode;
+   kms_vt->shutdown_system = kms_shutdown_system;
+   kms_vt->get_num_video_adapters = kms_get_num_video_adapters;
+   kms_vt->get_monitor_info = kms_get_monitor_info;
+   kms_vt->get_monitor_dpi = kms_get_monitor_dpi;
+   kms_vt->create_mouse_cursor = kms_create_mouse_cursor;
+   kms_vt->destroy_mouse_cursor = kms_destroy_mouse_cursor;
+   kms_vt->get_cursor_position = kms_get_cursor_position;
+   kms_vt->get_path = _al_unix_get_path;
+   kms_vt->inhibit_screensaver = kms_inhibit_screensaver;
+   kms_vt->get_time = _al_unix_get_time;
+   kms_vt->rest = _al_unix_rest;
+   kms_vt->init_timeout = _al_unix_init_timeout;
+   kms_vt->rest_until = _al_unix_rest_until;
+   kms_vt->init_timeout_until = _al_unix_init_timeout_until;
+
+   return kms_vt;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
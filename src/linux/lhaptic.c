@@ -92,6 +92,8 @@ static bool lhap_play_effect(ALLEGRO_HAPTIC_EFFECT_ID *id, int loop);
 static bool lhap_stop_effect(ALLEGRO_HAPTIC_EFFECT_ID *id);
 static bool lhap_is_effect_playing(ALLEGRO_HAPTIC_EFFECT_ID *id);
 static bool lhap_release_effect(ALLEGRO_HAPTIC_EFFECT_ID *id);
+static bool lhap_update_effect(ALLEGRO_HAPTIC_EFFECT_ID *id,
+                               ALLEGRO_HAPTIC_EFFECT *eff);
 
 static double lhap_get_autocenter(ALLEGRO_HAPTIC *dev);
 static bool lhap_set_autocenter(ALLEGRO_HAPTIC *dev, double);
@@ -133,7 +135,8 @@ ALLEGRO_HAPTIC_DRIVER _al_hapdrv_linux =
    lhap_release,
    
    lhap_get_autocenter,
-   lhap_set_autocenter
+   lhap_set_autocenter,
+   lhap_update_effect
 };
 
 
@@ -839,6 +842,34 @@ static bool lhap_release_effect(ALLEGRO_HAPTIC_EFFECT_ID *id)
 }
 
 
+static bool lhap_update_effect(ALLEGRO_HAPTIC_EFFECT_ID *id,
+   ALLEGRO_HAPTIC_EFFECT *effect)
+{
+   ALLEGRO_HAPTIC_LINUX *lhap = (ALLEGRO_HAPTIC_LINUX *)id->_haptic;
+   struct ff_effect leff;
+
+   if (!lhap)
+      return false;
+
+   if (!lhap_effect2lin(&leff, effect)) {
+      ALLEGRO_WARN("lhap_effect2lin failed");
+      return false;
+   }
+
+   /* Uploading with the id of an existing effect modifies it in place, even
+    * while it is playing.
+    */
+   leff.id = id->_handle;
+   if (ioctl(lhap->fd, EVIOCSFF, &leff) < 0) {
+      ALLEGRO_ERROR("EVIOCSFF failed for fd %d\n", lhap->fd);
+      return false;
+   }
+
+   id->_effect_duration = al_get_haptic_effect_duration(effect);
+   return true;
+}
+
+
 static bool lhap_release(ALLEGRO_HAPTIC *haptic)
 {
    ALLEGRO_HAPTIC_LINUX *lhap = lhap_from_al(haptic);
@@ -42,6 +42,12 @@
 #include <sys/types.h>
 #include <linux/input.h>
 
+/* Newer headers hide the layout of the time in struct input_event. */
+#ifndef input_event_sec
+   #define input_event_sec  time.tv_sec
+   #define input_event_usec time.tv_usec
+#endif
+
 #if defined(ALLEGRO_HAVE_SYS_INOTIFY_H)
    #define SUPPORT_HOTPLUG
    #include <sys/inotify.h>
@@ -294,6 +300,10 @@ static ALLEGRO_JOYSTICK_LINUX *ljoy_allocate_structure(void)
    }
 
    joy = al_calloc(1, sizeof *joy);
+   /* The snapshot lives as long as the structure, since it is read without
+    * any locking even while the device is being disconnected.
+    */
+   _al_init_input_snapshot(&joy->parent.snapshot, sizeof joy->joystate);
    slot = _al_vector_alloc_back(&joysticks);
    *slot = joy;
    return joy;
@@ -301,6 +311,24 @@ static ALLEGRO_JOYSTICK_LINUX *ljoy_allocate_structure(void)
 
 
 
+/* set_event_clock:
+ *  Ask the kernel to stamp the events of the device with the clock that
+ *  al_get_time() is based on, rather than the real time clock.
+ */
+static void set_event_clock(int fd)
+{
+#if defined(ALLEGRO_UNIX_MONOTONIC_CLOCK) && defined(EVIOCSCLOCKID)
+   int clk = CLOCK_MONOTONIC;
+
+   if (ioctl(fd, EVIOCSCLOCKID, &clk) < 0)
+      ALLEGRO_DEBUG("Could not select the monotonic clock for events.\n");
+#else
+   (void)fd;
+#endif
+}
+
+
+
 static void inactivate_joy(ALLEGRO_JOYSTICK_LINUX *joy)
 {
    int i;
@@ -319,6 +347,12 @@ static void inactivate_joy(ALLEGRO_JOYSTICK_LINUX *joy)
       al_free((void *)joy->parent.info.button[i].name);
    memset(&joy->parent.info, 0, sizeof(joy->parent.info));
    memset(&joy->joystate, 0, sizeof(joy->joystate));
+   memset(joy->axis_mapping, 0, sizeof(joy->axis_mapping));
+   memset(joy->axis_dirty, 0, sizeof(joy->axis_dirty));
+   joy->num_dirty_axes = 0;
+   joy->dropped = false;
+   _al_publish_input_snapshot(&joy->parent.snapshot, &joy->joystate,
+      al_get_time());
 
    al_ustr_free(joy->device_name);
    joy->device_name = NULL;
@@ -494,6 +528,8 @@ static void ljoy_device(ALLEGRO_USTR *device_name) {
    if (ioctl(fd, EVIOCGNAME(sizeof(joy->name)), joy->name) < 0)
       strcpy(joy->name, "Unknown");
 
+   set_event_clock(fd);
+
    /* Map Linux input API axis and button numbers to ours, and fill in
     * information.
     */
@@ -757,6 +793,7 @@ static void ljoy_exit_joystick(void)
    for (i = 0; i < (int)_al_vector_size(&joysticks); i++) {
       ALLEGRO_JOYSTICK_LINUX **slot = _al_vector_ref(&joysticks, i);
       inactivate_joy(*slot);
+      _al_destroy_input_snapshot(&(*slot)->parent.snapshot);
       al_free(*slot);
    }
    _al_vector_free(&joysticks);
@@ -897,9 +934,128 @@ static float norm_pos(const AXIS_MAPPING *map, float value)
 
 
 
+/* ljoy_update_axis: [fdwatch thread]
+ *
+ *  Store a new axis value. The event is only generated by
+ *  ljoy_flush_axis_events, so several moves of the same axis within one
+ *  batch of input result in a single event.
+ */
+static void ljoy_update_axis(ALLEGRO_JOYSTICK_LINUX *joy, int code, int value)
+{
+   const AXIS_MAPPING *map = &joy->axis_mapping[code];
+   float *axis_pos;
+   float pos;
+
+   if (map->max == map->min)
+      return;
+
+   axis_pos = &joy->joystate.stick[map->stick].axis[map->axis];
+   pos = norm_pos(map, value);
+   if (*axis_pos == pos)
+      return;
+
+   *axis_pos = pos;
+   if (!joy->axis_dirty[code]) {
+      joy->axis_dirty[code] = true;
+      joy->num_dirty_axes++;
+   }
+}
+
+
+
+/* ljoy_flush_axis_events: [fdwatch thread]
+ *
+ *  Generate one event for every axis which moved since the last flush,
+ *  with its latest position.
+ */
+static void ljoy_flush_axis_events(ALLEGRO_JOYSTICK_LINUX *joy)
+{
+   int code;
+
+   for (code = 0; code < TOTAL_JOYSTICK_AXES && joy->num_dirty_axes > 0;
+         code++) {
+      const AXIS_MAPPING *map = &joy->axis_mapping[code];
+
+      if (!joy->axis_dirty[code])
+         continue;
+
+      joy->axis_dirty[code] = false;
+      joy->num_dirty_axes--;
+      ljoy_generate_axis_event(joy, map->stick, map->axis,
+         joy->joystate.stick[map->stick].axis[map->axis]);
+   }
+}
+
+
+
+/* ljoy_update_button: [fdwatch thread]
+ *
+ *  Store a new button state and generate its event. Pending axis events
+ *  are generated first so that the order of events is kept.
+ */
+static void ljoy_update_button(ALLEGRO_JOYSTICK_LINUX *joy, int number,
+   bool down)
+{
+   ljoy_flush_axis_events(joy);
+
+   joy->joystate.button[number] = down ? 32767 : 0;
+   ljoy_generate_button_event(joy, number,
+      (down
+       ? ALLEGRO_EVENT_JOYSTICK_BUTTON_DOWN
+       : ALLEGRO_EVENT_JOYSTICK_BUTTON_UP));
+}
+
+
+
+/* ljoy_resync: [fdwatch thread]
+ *
+ *  The kernel dropped events because we did not read them fast enough.
+ *  Query the current state of the device and generate events for
+ *  whatever changed.
+ */
+static void ljoy_resync(ALLEGRO_JOYSTICK_LINUX *joy)
+{
+   unsigned long key_bits[NLONGS(KEY_CNT)] = {0};
+   int code, b;
+
+   ALLEGRO_DEBUG("Events dropped on %s, resyncing\n", joy->name);
+
+   for (code = LJOY_AXIS_RANGE_START; code < LJOY_AXIS_RANGE_END; code++) {
+      struct input_absinfo absinfo;
+
+      if (code >= TOTAL_JOYSTICK_AXES)
+         break;
+      if (joy->axis_mapping[code].max == joy->axis_mapping[code].min)
+         continue;
+      if (ioctl(joy->fd, EVIOCGABS(code), &absinfo) == 0)
+         ljoy_update_axis(joy, code, absinfo.value);
+   }
+
+   if (ioctl(joy->fd, EVIOCGKEY(sizeof(key_bits)), key_bits) < 0)
+      return;
+
+   for (b = 0; b < _AL_MAX_JOYSTICK_BUTTONS; b++) {
+      int ev_code = joy->button_mapping[b].ev_code;
+      bool down;
+
+      if (ev_code < 0)
+         break;
+      down = TEST_BIT(ev_code, key_bits);
+      if (down != (joy->joystate.button[b] != 0))
+         ljoy_update_button(joy, b, down);
+   }
+}
+
+
+
 /* ljoy_process_new_data: [fdwatch thread]
  *
  *  Process new data arriving in the joystick's fd.
+ *
+ *  All input that is waiting is read in batches and processed with the
+ *  event source locked once. Axis events are coalesced: each axis that
+ *  moved gets one event with its final position at the end, instead of
+ *  one event per report from the device.
  */
 static void ljoy_process_new_data(void *data)
 {
@@ -913,7 +1069,7 @@ static void ljoy_process_new_data(void *data)
 
    _al_event_source_lock(es);
    {
-      struct input_event input_events[32];
+      struct input_event input_events[64];
       int bytes, nr, i;
 
       while ((bytes = read(joy->fd, &input_events, sizeof input_events)) > 0) {
@@ -924,34 +1080,45 @@ static void ljoy_process_new_data(void *data)
             int code = input_events[i].code;
             int value = input_events[i].value;
 
-            if (type == EV_KEY) {
-               int number = map_button_number(joy, code);
-               if (number >= 0) {
-                  if (value)
-                     joy->joystate.button[number] = 32767;
-                  else
-                     joy->joystate.button[number] = 0;
-
-                  ljoy_generate_button_event(joy, number,
-                     (value
-                      ? ALLEGRO_EVENT_JOYSTICK_BUTTON_DOWN
-                      : ALLEGRO_EVENT_JOYSTICK_BUTTON_UP));
+            /* All events of a report have the time of the report. */
+            if (input_events[i].input_event_sec != joy->report_tv.tv_sec ||
+                  input_events[i].input_event_usec != joy->report_tv.tv_usec) {
+               joy->report_tv.tv_sec = input_events[i].input_event_sec;
+               joy->report_tv.tv_usec = input_events[i].input_event_usec;
+               joy->report_time = _al_event_source_input_time(es,
+                  _al_unix_time_from_timeval(&joy->report_tv));
+            }
+
+            if (type == EV_SYN) {
+               if (code == SYN_DROPPED) {
+                  joy->dropped = true;
+               }
+               else if (code == SYN_REPORT) {
+                  if (joy->dropped) {
+                     joy->dropped = false;
+                     ljoy_resync(joy);
+                  }
+                  /* Every report is a complete sample of the device. */
+                  _al_publish_input_snapshot(&joy->parent.snapshot,
+                     &joy->joystate, joy->report_time);
                }
             }
+            else if (joy->dropped) {
+               /* Incomplete report, resynced at the next SYN_REPORT. */
+            }
+            else if (type == EV_KEY) {
+               int number = map_button_number(joy, code);
+               if (number >= 0)
+                  ljoy_update_button(joy, number, value != 0);
+            }
             else if (type == EV_ABS) {
-               int number = code;
-               if (number < TOTAL_JOYSTICK_AXES) {
-                  const AXIS_MAPPING *map = &joy->axis_mapping[number];
-                  int stick = map->stick;
-                  int axis = map->axis;
-                  float pos = norm_pos(map, value);
-
-                  joy->joystate.stick[stick].axis[axis] = pos;
-                  ljoy_generate_axis_event(joy, stick, axis, pos);
-               }
+               if (code < TOTAL_JOYSTICK_AXES)
+                  ljoy_update_axis(joy, code, value);
             }
          }
       }
+
+      ljoy_flush_axis_events(joy);
    }
    _al_event_source_unlock(es);
 }
@@ -972,7 +1139,7 @@ static void ljoy_generate_axis_event(ALLEGRO_JOYSTICK_LINUX *joy, int stick, int
       return;
 
    event.joystick.type = ALLEGRO_EVENT_JOYSTICK_AXIS;
-   event.joystick.timestamp = al_get_time();
+   event.joystick.timestamp = joy->report_time;
    event.joystick.id = (ALLEGRO_JOYSTICK *)joy;
    event.joystick.stick = stick;
    event.joystick.axis = axis;
@@ -998,7 +1165,7 @@ static void ljoy_generate_button_event(ALLEGRO_JOYSTICK_LINUX *joy, int button,
       return;
 
    event.joystick.type = event_type;
-   event.joystick.timestamp = al_get_time();
+   event.joystick.timestamp = joy->report_time;
    event.joystick.id = (ALLEGRO_JOYSTICK *)joy;
    event.joystick.stick = 0;
    event.joystick.axis = 0;
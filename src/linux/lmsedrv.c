@@ -24,6 +24,8 @@
 
 #ifdef ALLEGRO_RASPBERRYPI
 #include "allegro5/internal/aintern_raspberrypi.h"
+#elif defined ALLEGRO_KMS
+#include "allegro5/internal/aintern_kms.h"
 #endif
 
 /* list the available drivers */
@@ -38,7 +40,7 @@ _AL_DRIVER_INFO _al_linux_mouse_driver_list[] =
 /* {  MOUSEDRV_LINUX_IMS,      &mousedrv_linux_ims,      true  },*/
 /* {  MOUSEDRV_LINUX_PS2,      &mousedrv_linux_ps2,      true  },*/
 /* {  MOUSEDRV_LINUX_IPS2,     &mousedrv_linux_ips2,     true  },*/
-#if defined ALLEGRO_HAVE_LINUX_INPUT_H || defined ALLEGRO_RASPBERRYPI
+#if defined ALLEGRO_HAVE_LINUX_INPUT_H || defined ALLEGRO_RASPBERRYPI || defined ALLEGRO_KMS
    {  AL_MOUSEDRV_LINUX_EVDEV, &_al_mousedrv_linux_evdev, true  },
 #endif
    {  0,                       NULL,                     0     }
@@ -63,9 +63,13 @@ typedef struct {
    CONFIG_STATE cfg_state;
    ALLEGRO_JOYSTICK_STATE state;
    IOHIDDeviceRef ident;
+   /* Axes which moved since the last flush, one bit per axis. */
+   uint8_t moved_axes[_AL_MAX_JOYSTICK_STICKS];
+   bool moved;
 } ALLEGRO_JOYSTICK_OSX;
 
 static IOHIDManagerRef hidManagerRef;
+static CFRunLoopObserverRef flush_observer;
 static _AL_VECTOR joysticks;
 static CONFIG_STATE new_joystick_state = JOY_STATE_ALIVE;
 static bool initialized = false;
@@ -143,6 +147,23 @@ static ALLEGRO_JOYSTICK_OSX *find_joystick(IOHIDDeviceRef ident)
    return NULL;
 }
 
+/* find_unused_joystick:
+ *  Return the slot of a joystick which was unplugged and reconfigured away,
+ *  so that plugging devices in and out does not grow the list.
+ */
+static ALLEGRO_JOYSTICK_OSX *find_unused_joystick(void)
+{
+   int i;
+   for (i = 0; i < (int)_al_vector_size(&joysticks); i++) {
+      ALLEGRO_JOYSTICK_OSX *joy = *(ALLEGRO_JOYSTICK_OSX **)_al_vector_ref(&joysticks, i);
+      if (joy->cfg_state == JOY_STATE_UNUSED) {
+         return joy;
+      }
+   }
+
+   return NULL;
+}
+
 static const char *get_element_name(IOHIDElementRef elem, const char *default_name)
 {
    CFStringRef name = IOHIDElementGetName(elem);
@@ -311,12 +332,19 @@ static void device_add_callback(
    al_lock_mutex(add_mutex);
 
    ALLEGRO_JOYSTICK_OSX *joy = find_joystick(ref);
+   if (joy == NULL)
+      joy = find_unused_joystick();
    if (joy == NULL) {
       joy = al_calloc(1, sizeof(ALLEGRO_JOYSTICK_OSX));
-      joy->ident = ref;
       ALLEGRO_JOYSTICK_OSX **back = _al_vector_alloc_back(&joysticks);
       *back = joy;
    }
+   else if (joy->cfg_state != JOY_STATE_UNUSED) {
+      /* Matched again without being removed; nothing has changed. */
+      al_unlock_mutex(add_mutex);
+      return;
+   }
+   joy->ident = ref;
    joy->cfg_state = new_joystick_state;
 
    CFArrayRef elements = IOHIDDeviceCopyMatchingElements(
@@ -348,21 +376,38 @@ static void device_remove_callback(
    (void)result;
    (void)sender;
 
-   int i;
-   for (i = 0; i < (int)_al_vector_size(&joysticks); i++) {
-      ALLEGRO_JOYSTICK_OSX *joy = *(ALLEGRO_JOYSTICK_OSX **)_al_vector_ref(&joysticks, i);
-      if (joy->ident == ref) {
-         joy->cfg_state = JOY_STATE_DYING;
-         osx_joy_generate_configure_event();
-         return;
-      }
+   al_lock_mutex(add_mutex);
+   ALLEGRO_JOYSTICK_OSX *joy = find_joystick(ref);
+   bool removed = false;
+   if (joy && joy->cfg_state != JOY_STATE_UNUSED &&
+         joy->cfg_state != JOY_STATE_DYING) {
+      joy->cfg_state = JOY_STATE_DYING;
+      /* The reference may be reused by the next device plugged in. */
+      joy->ident = NULL;
+      removed = true;
    }
+   al_unlock_mutex(add_mutex);
+
+   if (removed)
+      osx_joy_generate_configure_event();
 }
 
-static void osx_joy_generate_axis_event(ALLEGRO_JOYSTICK_OSX *joy, int stick, int axis, float pos)
+/* osx_joy_move_axis:
+ *  Record a new axis position. The event is emitted by flush_axis_events,
+ *  so an axis which changes several times before then only generates one.
+ */
+static void osx_joy_move_axis(ALLEGRO_JOYSTICK_OSX *joy, int stick, int axis, float pos)
 {
+   if (joy->state.stick[stick].axis[axis] == pos)
+      return;
+
    joy->state.stick[stick].axis[axis] = pos;
+   joy->moved_axes[stick] |= 1 << axis;
+   joy->moved = true;
+}
 
+static void osx_joy_generate_axis_event(ALLEGRO_JOYSTICK_OSX *joy, int stick, int axis, float pos)
+{
    ALLEGRO_EVENT event;
    ALLEGRO_EVENT_SOURCE *es = al_get_joystick_event_source();
 
@@ -456,8 +501,8 @@ static void value_callback(
 
    if (joy->dpad == elem){
       if (int_value >= 0 && int_value < MAX_HAT_DIRECTIONS) {
-         osx_joy_generate_axis_event(joy, joy->dpad_stick, joy->dpad_axis_vert,  (float)hat_mapping[int_value].axisV);
-         osx_joy_generate_axis_event(joy, joy->dpad_stick, joy->dpad_axis_horiz, (float)hat_mapping[int_value].axisH);
+         osx_joy_move_axis(joy, joy->dpad_stick, joy->dpad_axis_vert,  (float)hat_mapping[int_value].axisV);
+         osx_joy_move_axis(joy, joy->dpad_stick, joy->dpad_axis_horiz, (float)hat_mapping[int_value].axisH);
       }
       goto done;
    }
@@ -490,13 +535,55 @@ gen_axis_event:
          pos = ((float)int_value/max*2) - 1;
       }
 
-      osx_joy_generate_axis_event(joy, stick, axis, pos);
+      osx_joy_move_axis(joy, stick, axis, pos);
    }
 
 done:
    _al_event_source_unlock(es);
 }
 
+/* flush_axis_events:
+ *  Run loop observer which emits the axis events collected by value_callback.
+ *  IOKit calls value_callback for every element of every report delivered
+ *  in a pass of the run loop, and this runs once the pass is done, so a
+ *  controller streaming reports costs one event per axis that moved.
+ */
+static void flush_axis_events(CFRunLoopObserverRef observer,
+   CFRunLoopActivity activity, void *info)
+{
+   (void)observer;
+   (void)activity;
+   (void)info;
+
+   if (!initialized) return;
+
+   ALLEGRO_EVENT_SOURCE *es = al_get_joystick_event_source();
+   _al_event_source_lock(es);
+
+   int i;
+   for (i = 0; i < (int)_al_vector_size(&joysticks); i++) {
+      ALLEGRO_JOYSTICK_OSX *joy = *(ALLEGRO_JOYSTICK_OSX **)_al_vector_ref(&joysticks, i);
+      if (!joy->moved)
+         continue;
+      joy->moved = false;
+
+      int stick, axis;
+      for (stick = 0; stick < _AL_MAX_JOYSTICK_STICKS; stick++) {
+         if (!joy->moved_axes[stick])
+            continue;
+         for (axis = 0; axis < _AL_MAX_JOYSTICK_AXES; axis++) {
+            if (joy->moved_axes[stick] & (1 << axis)) {
+               osx_joy_generate_axis_event(joy, stick, axis,
+                  joy->state.stick[stick].axis[axis]);
+            }
+         }
+         joy->moved_axes[stick] = 0;
+      }
+   }
+
+   _al_event_source_unlock(es);
+}
+
 /* init_joystick:
  *  Initializes the HID joystick driver.
  */
@@ -561,6 +648,20 @@ static bool init_joystick(void)
       NULL
    );
 
+   // Emit the axis events once the reports of a run loop pass are handled
+   flush_observer = CFRunLoopObserverCreate(
+      kCFAllocatorDefault,
+      kCFRunLoopBeforeWaiting | kCFRunLoopExit,
+      true, 0,
+      flush_axis_events,
+      NULL
+   );
+   CFRunLoopAddObserver(
+      CFRunLoopGetMain(),
+      flush_observer,
+      kCFRunLoopCommonModes
+   );
+
    IOHIDManagerScheduleWithRunLoop(
       hidManagerRef,
       CFRunLoopGetMain(),
@@ -612,6 +713,13 @@ static void exit_joystick(void)
 {
    al_destroy_mutex(add_mutex);
 
+   CFRunLoopRemoveObserver(
+      CFRunLoopGetMain(),
+      flush_observer,
+      kCFRunLoopCommonModes
+   );
+   CFRelease(flush_observer);
+
    IOHIDManagerUnscheduleFromRunLoop(
       hidManagerRef,
       CFRunLoopGetCurrent(),
@@ -697,28 +805,47 @@ static void get_joystick_state(ALLEGRO_JOYSTICK *joy_, ALLEGRO_JOYSTICK_STATE *r
    _al_event_source_unlock(es);
 }
 
+/* joy_clear:
+ *  Free the names of an unplugged joystick and forget its elements, so
+ *  that the slot can be used by the next device plugged in.
+ */
+static void joy_clear(ALLEGRO_JOYSTICK_OSX *joy)
+{
+   int i, j;
+
+   for (i = 0; i < _AL_MAX_JOYSTICK_BUTTONS; i++) {
+      al_free((char *)joy->parent.info.button[i].name);
+   }
+   for (i = 0; i < _AL_MAX_JOYSTICK_STICKS; i++) {
+      al_free(joy->parent.info.stick[i].name);
+      for (j = 0; j < _AL_MAX_JOYSTICK_AXES; j++) {
+         al_free(joy->parent.info.stick[i].axis[j].name);
+      }
+   }
+   memset(&joy->parent.info, 0, sizeof(joy->parent.info));
+   memset(joy->buttons, 0, sizeof(joy->buttons));
+   memset(joy->axes, 0, sizeof(joy->axes));
+   memset(&joy->state, 0, sizeof(joy->state));
+   memset(joy->moved_axes, 0, sizeof(joy->moved_axes));
+   joy->moved = false;
+   joy->dpad = 0;
+}
+
+/* reconfigure_joysticks:
+ *  Only the joysticks which were plugged in or out since the last call
+ *  change; the others keep their slots and state.
+ */
 static bool reconfigure_joysticks(void)
 {
    int i;
    bool ret = false;
+
+   al_lock_mutex(add_mutex);
    for (i = 0; i < (int)_al_vector_size(&joysticks); i++) {
       ALLEGRO_JOYSTICK_OSX *joy = *(ALLEGRO_JOYSTICK_OSX **)_al_vector_ref(&joysticks, i);
       if (joy->cfg_state == JOY_STATE_DYING) {
          joy->cfg_state = JOY_STATE_UNUSED;
-         for (i = 0; i < _AL_MAX_JOYSTICK_BUTTONS; i++) {
-            al_free((char *)joy->parent.info.button[i].name);
-         }
-         for (i = 0; i < _AL_MAX_JOYSTICK_STICKS; i++) {
-            int j;
-            al_free(joy->parent.info.stick[i].name);
-            for (j = 0; j < _AL_MAX_JOYSTICK_AXES; j++) {
-               al_free(joy->parent.info.stick[i].axis[j].name);
-            }
-         }
-	      joy_null(joy);
-         memset(joy->buttons, 0, _AL_MAX_JOYSTICK_BUTTONS*sizeof(IOHIDElementRef));
-         memset(&joy->state, 0, sizeof(ALLEGRO_JOYSTICK_STATE));
-         joy->dpad=0;
+         joy_clear(joy);
       }
       else if (joy->cfg_state == JOY_STATE_BORN)
          joy->cfg_state = JOY_STATE_ALIVE;
@@ -726,6 +853,7 @@ static bool reconfigure_joysticks(void)
          continue;
       ret = true;
    }
+   al_unlock_mutex(add_mutex);
 
    return ret;
 }
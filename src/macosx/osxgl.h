@@ -39,6 +39,7 @@ typedef struct ALLEGRO_DISPLAY_OSX_WIN {
    ALLEGRO_MUTEX *flip_mutex;
    ALLEGRO_COND *flip_cond;
    int num_flips;
+   int num_vblanks;  /* never reset, for osx_wait_for_vblank */
 } ALLEGRO_DISPLAY_OSX_WIN;
 
 /* This is our version of ALLEGRO_MOUSE_CURSOR */
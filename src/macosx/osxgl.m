@@ -1018,6 +1018,34 @@ static void osx_run_fullscreen_display(ALLEGRO_DISPLAY_OSX_WIN* dpy)
    }
 }
 
+/* enable_multithreaded_engine:
+ *
+ * Let the OpenGL framework process the commands of the context on a thread
+ * of its own, if the configuration asks for it. That takes most of the
+ * driver overhead off the thread that draws, which matters on machines where
+ * OpenGL is implemented on top of Metal. Every call that reads something
+ * back from OpenGL has to wait for that thread, though, so programs which
+ * do that a lot can get slower.
+ */
+static void enable_multithreaded_engine(NSOpenGLContext *ctx)
+{
+   const char *value = al_get_config_value(al_get_system_config(),
+      "opengl", "osx_multithreaded_engine");
+   CGLError err;
+
+   if (!value || _al_stricmp(value, "true") != 0)
+      return;
+
+   err = CGLEnable([ctx CGLContextObj], kCGLCEMPEngine);
+   if (err != kCGLNoError) {
+      ALLEGRO_WARN("Could not enable the multithreaded OpenGL engine: %s\n",
+         CGLErrorString(err));
+   }
+   else {
+      ALLEGRO_INFO("Enabled the multithreaded OpenGL engine\n");
+   }
+}
+
 /* osx_create_shareable_context:
  *
  * Create an NSOpenGLContext with a given pixel format. If possible, make
@@ -1057,6 +1085,9 @@ static NSOpenGLContext* osx_create_shareable_context(NSOpenGLPixelFormat* fmt, u
       ALLEGRO_DEBUG("Creating new display group %d\n", *group);
       compat = [[NSOpenGLContext alloc] initWithFormat:fmt shareContext: nil];
    }
+   if (compat != nil) {
+      enable_multithreaded_engine(compat);
+   }
    return compat;
 }
 
@@ -1080,7 +1111,8 @@ static CVReturn display_link_callback(CVDisplayLinkRef display_link,
 
    al_lock_mutex(dpy->flip_mutex);
    dpy->num_flips += 1;
-   al_signal_cond(dpy->flip_cond);
+   dpy->num_vblanks += 1;
+   al_broadcast_cond(dpy->flip_cond);
    al_unlock_mutex(dpy->flip_mutex);
 
    return kCVReturnSuccess;
@@ -1855,6 +1887,27 @@ static void flip_display(ALLEGRO_DISPLAY *disp)
    }
 }
 
+/* osx_wait_for_vblank:
+ * Wait for the next tick of the display link. There only is one with
+ * vsync turned on.
+ */
+static bool osx_wait_for_vblank(ALLEGRO_DISPLAY *disp)
+{
+   ALLEGRO_DISPLAY_OSX_WIN *dpy = (ALLEGRO_DISPLAY_OSX_WIN *)disp;
+   int old_vblanks;
+
+   if (!dpy->flip_mutex)
+      return false;
+
+   al_lock_mutex(dpy->flip_mutex);
+   old_vblanks = dpy->num_vblanks;
+   while (dpy->num_vblanks == old_vblanks) {
+      al_wait_cond(dpy->flip_cond, dpy->flip_mutex);
+   }
+   al_unlock_mutex(dpy->flip_mutex);
+   return true;
+}
+
 static void update_display_region(ALLEGRO_DISPLAY *disp,
    int x, int y, int width, int height)
 {
@@ -2468,6 +2521,7 @@ ALLEGRO_DISPLAY_INTERFACE* _al_osx_get_display_driver_win(void)
       vt->set_display_flag = set_display_flag;
       vt->set_icons = set_icons;
       vt->update_render_state = _al_ogl_update_render_state;
+      vt->wait_for_vblank = osx_wait_for_vblank;
       _al_ogl_add_drawing_functions(vt);
       _al_osx_add_clipboard_functions(vt);
    }
@@ -2494,6 +2548,7 @@ ALLEGRO_DISPLAY_INTERFACE* _al_osx_get_display_driver_fs(void)
       vt->get_backbuffer = _al_ogl_get_backbuffer;
       vt->is_compatible_bitmap = is_compatible_bitmap;
       vt->update_render_state = _al_ogl_update_render_state;
+      vt->wait_for_vblank = osx_wait_for_vblank;
       _al_ogl_add_drawing_functions(vt);
    }
    return vt;
@@ -547,6 +547,8 @@ ALLEGRO_SYSTEM_INTERFACE *_al_system_osx_driver(void)
       vt->get_time = _al_unix_get_time;
       vt->rest = _al_unix_rest;
       vt->init_timeout = _al_unix_init_timeout;
+      vt->rest_until = _al_unix_rest_until;
+      vt->init_timeout_until = _al_unix_init_timeout_until;
 
    };
 
@@ -19,9 +19,13 @@
 #include "allegro5/internal/aintern_blend.h"
 #include "allegro5/internal/aintern_convert.h"
 #include "allegro5/internal/aintern_memblit.h"
+#include "allegro5/internal/aintern_pixels.h"
 #include "allegro5/internal/aintern_transform.h"
 #include "allegro5/internal/aintern_tri_soft.h"
 #include <math.h>
+#include <string.h>
+
+ALLEGRO_DEBUG_CHANNEL("bitmap")
 
 #define MIN _ALLEGRO_MIN
 #define MAX _ALLEGRO_MAX
@@ -33,6 +37,9 @@ static void _al_draw_transformed_scaled_bitmap_memory(
 static void _al_draw_bitmap_region_memory_fast(ALLEGRO_BITMAP *bitmap,
    int sx, int sy, int sw, int sh,
    int dx, int dy, int flags);
+static void _al_draw_bitmap_region_memory_keyed(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_COLOR tint, int sx, int sy, int sw, int sh,
+   int dx, int dy, int flags);
 
 
 /* The CLIPPER macro takes pre-clipped coordinates for both the source
@@ -130,6 +137,47 @@ static void _al_draw_bitmap_region_memory_fast(ALLEGRO_BITMAP *bitmap,
 }
 
 
+/* lock_source_region:
+ *  Lock a region of the bitmap drawn for reading. Memory bitmaps which are
+ *  read in place are locked as a whole, a lock which other threads drawing
+ *  the same bitmap share, and lr is set to the region.
+ */
+static ALLEGRO_LOCKED_REGION *lock_source_region(ALLEGRO_BITMAP *src,
+   int sx, int sy, int sw, int sh, ALLEGRO_LOCKED_REGION *lr)
+{
+   ALLEGRO_LOCKED_REGION *whole;
+
+   if (!(al_get_bitmap_flags(src) & ALLEGRO_MEMORY_BITMAP) ||
+         _al_bitmap_is_tiled(src)) {
+      return al_lock_bitmap_region(src, sx, sy, sw, sh,
+         ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY);
+   }
+   if (!(whole = al_lock_bitmap(src, ALLEGRO_PIXEL_FORMAT_ANY,
+         ALLEGRO_LOCK_READONLY)))
+      return NULL;
+   *lr = *whole;
+   lr->data = (char *)whole->data + sy * whole->pitch + sx * whole->pixel_size;
+   return lr;
+}
+
+
+/* lock_target_region:
+ *  Lock a region of the target, in the coordinates of its parent, through
+ *  the target itself, so that threads drawing into different sub-bitmaps
+ *  of one memory bitmap don't lock each other out.
+ */
+static ALLEGRO_LOCKED_REGION *lock_target_region(ALLEGRO_BITMAP *target,
+   int x, int y, int w, int h, int flags)
+{
+   if (target->parent) {
+      x -= target->xofs;
+      y -= target->yofs;
+   }
+   return al_lock_bitmap_region(target, x, y, w, h, ALLEGRO_PIXEL_FORMAT_ANY,
+      flags);
+}
+
+
 void _al_draw_bitmap_region_memory(ALLEGRO_BITMAP *src,
    ALLEGRO_COLOR tint,
    int sx, int sy, int sw, int sh,
@@ -144,6 +192,14 @@ void _al_draw_bitmap_region_memory(ALLEGRO_BITMAP *src,
    al_get_separate_bitmap_blender(&op,
       &src_mode, &dst_mode, &op_alpha, &src_alpha, &dst_alpha);
 
+   if (src->use_color_key &&
+      _al_transform_is_translation(al_get_current_transform(), &xtrans, &ytrans))
+   {
+      _al_draw_bitmap_region_memory_keyed(src, tint, sx, sy, sw, sh,
+         dx + xtrans, dy + ytrans, flags);
+      return;
+   }
+
    if (_AL_DEST_IS_ZERO && _AL_SRC_NOT_MODIFIED_TINT_WHITE &&
       _al_transform_is_translation(al_get_current_transform(), &xtrans, &ytrans))
    {
@@ -236,6 +292,15 @@ static void _al_draw_transformed_bitmap_memory(ALLEGRO_BITMAP *src,
    v[bl].v = sy + sh;
    v[bl].color = tint;
 
+   /* Tiled bitmaps are read from the tiles, or locked by the triangle
+    * drawer only if it has to.
+    */
+   if (_al_bitmap_is_tiled(src)) {
+      _al_triangle_2d(src, &v[tl], &v[tr], &v[br]);
+      _al_triangle_2d(src, &v[tl], &v[br], &v[bl]);
+      return;
+   }
+
    al_lock_bitmap(src, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY);
 
    _al_triangle_2d(src, &v[tl], &v[tr], &v[br]);
@@ -264,9 +329,11 @@ static void _al_draw_bitmap_region_memory_fast(ALLEGRO_BITMAP *bitmap,
    int sx, int sy, int sw, int sh,
    int dx, int dy, int flags)
 {
+   ALLEGRO_LOCKED_REGION src_lr;
    ALLEGRO_LOCKED_REGION *src_region;
    ALLEGRO_LOCKED_REGION *dst_region;
-   ALLEGRO_BITMAP *dest = al_get_target_bitmap();
+   ALLEGRO_BITMAP *target = al_get_target_bitmap();
+   ALLEGRO_BITMAP *dest = target;
    int dw = sw, dh = sh;
 
    ASSERT(_al_pixel_format_is_real(al_get_bitmap_format(bitmap)));
@@ -281,13 +348,12 @@ static void _al_draw_bitmap_region_memory_fast(ALLEGRO_BITMAP *bitmap,
 
    CLIPPER(bitmap, sx, sy, sw, sh, dest, dx, dy, dw, dh, 1, 1, flags)
 
-   if (!(src_region = al_lock_bitmap_region(bitmap, sx, sy, sw, sh,
-         ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY))) {
+   if (!(src_region = lock_source_region(bitmap, sx, sy, sw, sh, &src_lr))) {
       return;
    }
 
-   if (!(dst_region = al_lock_bitmap_region(dest, dx, dy, sw, sh,
-         ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_WRITEONLY))) {
+   if (!(dst_region = lock_target_region(target, dx, dy, sw, sh,
+         ALLEGRO_LOCK_WRITEONLY))) {
       al_unlock_bitmap(bitmap);
       return;
    }
@@ -299,7 +365,126 @@ static void _al_draw_bitmap_region_memory_fast(ALLEGRO_BITMAP *bitmap,
       0, 0, 0, 0, sw, sh);
 
    al_unlock_bitmap(bitmap);
-   al_unlock_bitmap(dest);
+   al_unlock_bitmap(target);
+}
+
+
+/* Draws the pixels which are not the color key of the bitmap. The key is
+ * compared with the stored pixels, so the bitmap need not be converted.
+ * Runs of other pixels are copied with the converters if the blender
+ * would copy them anyway, or blended a span at a time.
+ */
+static void _al_draw_bitmap_region_memory_keyed(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_COLOR tint, int sx, int sy, int sw, int sh,
+   int dx, int dy, int flags)
+{
+   ALLEGRO_LOCKED_REGION src_lr;
+   ALLEGRO_LOCKED_REGION *src_region;
+   ALLEGRO_LOCKED_REGION *dst_region;
+   ALLEGRO_BITMAP *target = al_get_target_bitmap();
+   ALLEGRO_BITMAP *dest = target;
+   ALLEGRO_COLOR src_colors[_AL_BLEND_SPAN_SIZE];
+   ALLEGRO_COLOR dst_colors[_AL_BLEND_SPAN_SIZE];
+   ALLEGRO_COLOR pixel;
+   _AL_SPAN_BLENDER blender;
+   int op, src_mode, dst_mode;
+   int op_alpha, src_alpha, dst_alpha;
+   int src_size, dst_size;
+   uint32_t key[4] = {0, 0, 0, 0};
+   bool has_key, copy;
+   int dw = sw, dh = sh;
+   char *data;
+   int x, y, i, n;
+
+   ASSERT(_al_pixel_format_is_real(al_get_bitmap_format(bitmap)));
+   ASSERT(_al_pixel_format_is_real(al_get_bitmap_format(dest)));
+   ASSERT(bitmap->parent == NULL);
+   ASSERT(flags == 0);
+   (void)flags;
+
+   CLIPPER(bitmap, sx, sy, sw, sh, dest, dx, dy, dw, dh, 1, 1, flags)
+
+   al_get_separate_bitmap_blender(&op,
+      &src_mode, &dst_mode, &op_alpha, &src_alpha, &dst_alpha);
+   copy = _AL_DEST_IS_ZERO && _AL_SRC_NOT_MODIFIED_TINT_WHITE;
+
+   if (!(src_region = lock_source_region(bitmap, sx, sy, sw, sh, &src_lr))) {
+      return;
+   }
+
+   if (!(dst_region = lock_target_region(target, dx, dy, sw, sh,
+         ALLEGRO_LOCK_READWRITE))) {
+      al_unlock_bitmap(bitmap);
+      return;
+   }
+
+   src_size = al_get_pixel_size(src_region->format);
+   dst_size = al_get_pixel_size(dst_region->format);
+
+   /* A key the format cannot store matches no pixel. */
+   data = (char *)key;
+   _AL_INLINE_PUT_PIXEL(src_region->format, data, bitmap->color_key, false);
+   data = (char *)key;
+   _AL_INLINE_GET_PIXEL(src_region->format, data, pixel, false);
+   has_key = memcmp(&pixel, &bitmap->color_key, sizeof(pixel)) == 0;
+
+   if (!copy) {
+      ALLEGRO_COLOR const_color = al_get_blend_color();
+      _al_init_span_blender(&blender, op, src_mode, dst_mode,
+         op_alpha, src_alpha, dst_alpha, &const_color);
+   }
+
+   for (y = 0; y < sh; y++) {
+      char *src_row = (char *)src_region->data + y * src_region->pitch;
+      char *dst_row = (char *)dst_region->data + y * dst_region->pitch;
+
+      x = 0;
+      while (x < sw) {
+         /* Skip the key, then find the run of pixels up to the next one. */
+         if (has_key) {
+            while (x < sw && memcmp(src_row + x * src_size, key, src_size) == 0)
+               x++;
+         }
+         n = 0;
+         while (x + n < sw && !(has_key &&
+               memcmp(src_row + (x + n) * src_size, key, src_size) == 0)) {
+            n++;
+         }
+         if (n == 0)
+            break;
+
+         if (copy) {
+            _al_convert_bitmap_data(src_row, src_region->format, 0,
+               dst_row, dst_region->format, 0, x, 0, x, 0, n, 1);
+            x += n;
+            continue;
+         }
+
+         while (n > 0) {
+            int m = _ALLEGRO_MIN(n, _AL_BLEND_SPAN_SIZE);
+            char *s = src_row + x * src_size;
+            char *d = dst_row + x * dst_size;
+
+            for (i = 0; i < m; i++) {
+               _AL_INLINE_GET_PIXEL(src_region->format, s, pixel, true);
+               src_colors[i].r = pixel.r * tint.r;
+               src_colors[i].g = pixel.g * tint.g;
+               src_colors[i].b = pixel.b * tint.b;
+               src_colors[i].a = pixel.a * tint.a;
+               _AL_INLINE_GET_PIXEL(dst_region->format, d, dst_colors[i], true);
+            }
+            blender.blend_span(&blender, src_colors, dst_colors, m);
+            d = dst_row + x * dst_size;
+            for (i = 0; i < m; i++)
+               _AL_INLINE_PUT_PIXEL(dst_region->format, d, dst_colors[i], true);
+            x += m;
+            n -= m;
+         }
+      }
+   }
+
+   al_unlock_bitmap(bitmap);
+   al_unlock_bitmap(target);
 }
 
 
@@ -17,6 +17,8 @@
 
 
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_tls.h"
 
 
 /* globals */
@@ -84,4 +86,214 @@ void *al_calloc_with_context(size_t count, size_t n,
 }
 
 
+
+/*
+ * Frame arenas. Each thread has a list of chunks which are filled from the
+ * front. A mark is the number of bytes in front of the current position,
+ * counting every chunk before the current one as completely used, so marks
+ * grow monotonically and rewinding just finds the chunk a mark falls into.
+ * Chunks after the current one are kept around for reuse.
+ */
+
+#define FRAME_ALIGN        16
+#define FRAME_CHUNK_SIZE   (64 * 1024)
+
+typedef struct FRAME_CHUNK FRAME_CHUNK;
+
+struct FRAME_CHUNK {
+   FRAME_CHUNK *next;
+   size_t base;
+   size_t size;
+   size_t used;
+};
+
+typedef struct FRAME_ARENA {
+   FRAME_CHUNK *first;
+   FRAME_CHUNK *current;
+   /* Size for the first chunk after a reset. */
+   size_t size_hint;
+} FRAME_ARENA;
+
+
+static FRAME_ARENA *get_frame_arena(bool create)
+{
+   FRAME_ARENA *arena = _al_tls_get_frame_arena();
+
+   if (!arena && create) {
+      arena = al_calloc(1, sizeof *arena);
+      if (arena)
+         _al_tls_set_frame_arena(arena);
+   }
+   return arena;
+}
+
+
+static void free_chunks(FRAME_CHUNK *chunk)
+{
+   while (chunk) {
+      FRAME_CHUNK *next = chunk->next;
+      al_free(chunk);
+      chunk = next;
+   }
+}
+
+
+static FRAME_CHUNK *new_chunk(size_t base, size_t min_size, size_t hint)
+{
+   size_t size = FRAME_CHUNK_SIZE;
+   FRAME_CHUNK *chunk;
+
+   if (size < hint)
+      size = hint;
+   if (size < min_size + FRAME_ALIGN)
+      size = min_size + FRAME_ALIGN;
+
+   chunk = al_malloc(sizeof *chunk + size);
+   if (!chunk)
+      return NULL;
+   chunk->next = NULL;
+   chunk->base = base;
+   chunk->size = size;
+   chunk->used = 0;
+   return chunk;
+}
+
+
+/* Returns the address of an allocation of size bytes in chunk, or NULL if
+ * it does not fit.
+ */
+static void *chunk_alloc(FRAME_CHUNK *chunk, size_t size)
+{
+   char *data = (char *)(chunk + 1);
+   uintptr_t p = (uintptr_t)(data + chunk->used);
+   size_t pad = (FRAME_ALIGN - (p & (FRAME_ALIGN - 1))) & (FRAME_ALIGN - 1);
+
+   if (pad + size > chunk->size - chunk->used)
+      return NULL;
+   chunk->used += pad + size;
+   return (void *)(p + pad);
+}
+
+
+/* Function: al_frame_alloc
+ */
+void *al_frame_alloc(size_t size)
+{
+   FRAME_ARENA *arena = get_frame_arena(true);
+   FRAME_CHUNK *cur;
+   FRAME_CHUNK *next;
+   void *ptr;
+
+   if (!arena)
+      return NULL;
+
+   if (size == 0)
+      size = 1;
+
+   cur = arena->current;
+   if (cur && (ptr = chunk_alloc(cur, size)))
+      return ptr;
+
+   /* Move on to the next chunk, replacing the ones after the current chunk
+    * if the next one is too small.
+    */
+   next = cur ? cur->next : arena->first;
+   if (next && next->size >= size + FRAME_ALIGN) {
+      next->used = 0;
+   }
+   else {
+      size_t base = cur ? cur->base + cur->size : 0;
+      FRAME_CHUNK *chunk = new_chunk(base, size,
+         cur ? 0 : arena->size_hint);
+      if (!chunk)
+         return NULL;
+      free_chunks(next);
+      if (cur)
+         cur->next = chunk;
+      else
+         arena->first = chunk;
+      next = chunk;
+   }
+
+   arena->current = next;
+   return chunk_alloc(next, size);
+}
+
+
+/* Function: al_get_frame_arena_mark
+ */
+size_t al_get_frame_arena_mark(void)
+{
+   FRAME_ARENA *arena = get_frame_arena(false);
+
+   if (!arena || !arena->current)
+      return 0;
+   return arena->current->base + arena->current->used;
+}
+
+
+/* Function: al_rewind_frame_arena
+ */
+void al_rewind_frame_arena(size_t mark)
+{
+   FRAME_ARENA *arena = get_frame_arena(false);
+   FRAME_CHUNK *chunk;
+
+   if (!arena || !arena->current)
+      return;
+
+   ASSERT(mark <= al_get_frame_arena_mark());
+
+   for (chunk = arena->first; chunk != arena->current; chunk = chunk->next) {
+      if (mark <= chunk->base + chunk->size)
+         break;
+   }
+   arena->current = chunk;
+   chunk->used = mark - chunk->base;
+}
+
+
+/* Function: al_reset_frame_arena
+ */
+void al_reset_frame_arena(void)
+{
+   FRAME_ARENA *arena = get_frame_arena(false);
+   FRAME_CHUNK *last;
+
+   if (!arena || !arena->current)
+      return;
+
+   /* If more than one chunk was needed, replace them all by a single one
+    * big enough for everything next time.
+    */
+   if (arena->first->next) {
+      for (last = arena->first; last->next; last = last->next)
+         ;
+      arena->size_hint = last->base + last->size;
+      free_chunks(arena->first);
+      arena->first = NULL;
+      arena->current = NULL;
+      return;
+   }
+
+   arena->current = arena->first;
+   arena->first->used = 0;
+}
+
+
+/* Function: al_free_frame_arena
+ */
+void al_free_frame_arena(void)
+{
+   FRAME_ARENA *arena = get_frame_arena(false);
+
+   if (!arena)
+      return;
+
+   free_chunks(arena->first);
+   al_free(arena);
+   _al_tls_set_frame_arena(NULL);
+}
+
+
 /* vim: set ts=8 sts=3 sw=3 et: */
@@ -26,6 +26,7 @@
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_list.h"
+#include "allegro5/internal/aintern_pool.h"
 
 
 ALLEGRO_DEBUG_CHANNEL("list")
@@ -44,6 +45,8 @@ struct _AL_LIST {
    _AL_LIST_ITEM* next_free;
    void*          user_data;
    _AL_LIST_DTOR  dtor;
+   /* Memory comes from the frame arena and is not freed. */
+   bool           in_frame_arena;
 };
 
 /* List item, holds user data and destructor. */
@@ -56,8 +59,12 @@ struct _AL_LIST_ITEM {
 };
 
 
+/* Items of all dynamic lists come from here. */
+static _AL_POOL item_pool = _AL_POOL_INITIALIZER(_AL_LIST_ITEM, "list items");
+
+
 /* List of the internal functions. */
-static _AL_LIST* list_do_create(size_t capacity, size_t item_extra_size);
+static _AL_LIST* list_do_create(size_t capacity, size_t item_extra_size, bool in_frame_arena);
 static bool      list_is_static(_AL_LIST* list);
 
 static _AL_LIST_ITEM* list_get_free_item(_AL_LIST* list);
@@ -79,6 +86,10 @@ static void           list_destroy_item(_AL_LIST* list, _AL_LIST_ITEM* item);
  *        Number of extra bytes which should be left after each list item.
  *        It is currently not used, so default value is zero.
  *
+ *     in_frame_arena [in]
+ *        Take the memory of a static list from the frame arena of the
+ *        calling thread instead of the heap.
+ *
  *  Returns:
  *     Pointer to new instance of double linked list.
  *
@@ -91,7 +102,7 @@ static void           list_destroy_item(_AL_LIST* list, _AL_LIST_ITEM* item);
  *     piece of memory. This kind of list have capacity, but adding and
  *     removing elements is very cheap operation.
  */
-static _AL_LIST* list_do_create(size_t capacity, size_t extra_item_size)
+static _AL_LIST* list_do_create(size_t capacity, size_t extra_item_size, bool in_frame_arena)
 {
    size_t i;
    size_t memory_size;
@@ -107,7 +118,10 @@ static _AL_LIST* list_do_create(size_t capacity, size_t extra_item_size)
     */
    memory_size = sizeof(_AL_LIST) + (capacity + 1) * (sizeof(_AL_LIST_ITEM) + extra_item_size);
 
-   memory_ptr = (uint8_t*)al_malloc(memory_size);
+   if (in_frame_arena)
+      memory_ptr = (uint8_t*)al_frame_alloc(memory_size);
+   else
+      memory_ptr = (uint8_t*)al_malloc(memory_size);
    if (NULL == memory_ptr) {
       ALLEGRO_ERROR("Out of memory.");
       return NULL;
@@ -122,6 +136,7 @@ static _AL_LIST* list_do_create(size_t capacity, size_t extra_item_size)
    list->next_free            = (_AL_LIST_ITEM*)memory_ptr;
    list->user_data            = NULL;
    list->dtor                 = NULL;
+   list->in_frame_arena       = in_frame_arena;
 
    /* Initialize free item list.
     */
@@ -194,9 +209,14 @@ static _AL_LIST_ITEM* list_create_item(_AL_LIST* list)
    }
    else {
 
-      item = (_AL_LIST_ITEM*)al_malloc(list->item_size_with_extra);
+      /* Items without extra space are common enough to be pooled. */
+      if (list->item_size_with_extra == sizeof(_AL_LIST_ITEM))
+         item = (_AL_LIST_ITEM*)_al_pool_alloc(&item_pool);
+      else
+         item = (_AL_LIST_ITEM*)al_malloc(list->item_size_with_extra);
 
-      item->list = list;
+      if (NULL != item)
+         item->list = list;
    }
 
    return item;
@@ -218,6 +238,8 @@ static void list_destroy_item(_AL_LIST* list, _AL_LIST_ITEM* item)
       item->next      = list->next_free;
       list->next_free = item;
    }
+   else if (list->item_size_with_extra == sizeof(_AL_LIST_ITEM))
+      _al_pool_free(item);
    else
       al_free(item);
 }
@@ -231,7 +253,7 @@ static void list_destroy_item(_AL_LIST* list, _AL_LIST_ITEM* item)
  */
 _AL_LIST* _al_list_create(void)
 {
-   return list_do_create(0, 0);
+   return list_do_create(0, 0, false);
 }
 
 
@@ -250,7 +272,27 @@ _AL_LIST* _al_list_create_static(size_t capacity)
       return NULL;
    }
 
-   return list_do_create(capacity, 0);
+   return list_do_create(capacity, 0, false);
+}
+
+
+/*
+ *  Like _al_list_create_static, but the memory is taken from the frame
+ *  arena of the calling thread. _al_list_destroy still calls the
+ *  destructors, the memory itself is released by rewinding the arena.
+ *
+ *  See:
+ *     list_do_create
+ */
+_AL_LIST* _al_list_create_frame_static(size_t capacity)
+{
+   if (capacity < 1) {
+
+      ALLEGRO_ERROR("Cannot create static list without any capacity.");
+      return NULL;
+   }
+
+   return list_do_create(capacity, 0, true);
 }
 
 
@@ -268,7 +310,8 @@ void _al_list_destroy(_AL_LIST* list)
 
    _al_list_clear(list);
 
-   al_free(list);
+   if (!list->in_frame_arena)
+      al_free(list);
 }
 
 
@@ -0,0 +1,203 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Fixed-size item pools.
+ *
+ *      See LICENSE.txt for copyright information.
+ *
+ *
+ *      Each item is preceded by a header which points back to its pool, or
+ *      is NULL for items which were allocated with al_malloc because the
+ *      pools were not set up yet. Free items are linked through the same
+ *      header. Items are carved from chunks of about 4 KiB, which are only
+ *      given back when the system is shut down with no item in use.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_pool.h"
+#include "allegro5/internal/aintern_thread.h"
+
+ALLEGRO_DEBUG_CHANNEL("pool")
+
+
+#define CHUNK_BYTES  4096
+#define MIN_ITEMS    8
+#define MAX_POOLS    16
+
+typedef union POOL_HEADER POOL_HEADER;
+
+union POOL_HEADER {
+   _AL_POOL *pool;
+   POOL_HEADER *next;
+   /* Keep the items suitably aligned for anything. */
+   double align_double;
+   int64_t align_int64;
+   void *align_ptr;
+};
+
+typedef union POOL_CHUNK POOL_CHUNK;
+
+union POOL_CHUNK {
+   POOL_CHUNK *next;
+   POOL_HEADER align;
+};
+
+
+/* The mutex is created on the first al_install_system and then kept, as
+ * items may still be given back after the system was shut down.
+ */
+static _AL_MUTEX pool_mutex = _AL_MUTEX_UNINITED;
+static bool pool_mutex_inited = false;
+static _AL_POOL *pools[MAX_POOLS];
+static int num_pools = 0;
+
+
+static size_t item_stride(const _AL_POOL *pool)
+{
+   size_t h = sizeof(POOL_HEADER);
+   return h + (pool->item_size + h - 1) / h * h;
+}
+
+
+/* Must be called with pool_mutex held. */
+static bool grow_pool(_AL_POOL *pool)
+{
+   size_t stride = item_stride(pool);
+   size_t count = CHUNK_BYTES / stride;
+   POOL_CHUNK *chunk;
+   char *p;
+   size_t i;
+
+   if (count < MIN_ITEMS)
+      count = MIN_ITEMS;
+
+   if (!pool->registered) {
+      if (num_pools == MAX_POOLS)
+         return false;
+      pools[num_pools++] = pool;
+      pool->registered = true;
+   }
+
+   chunk = al_malloc(sizeof(POOL_CHUNK) + count * stride);
+   if (!chunk)
+      return false;
+   chunk->next = pool->chunks;
+   pool->chunks = chunk;
+
+   p = (char *)(chunk + 1);
+   for (i = 0; i < count; i++, p += stride) {
+      POOL_HEADER *h = (POOL_HEADER *)p;
+      h->next = pool->free_list;
+      pool->free_list = h;
+   }
+   return true;
+}
+
+
+/* Internal function: _al_init_pools
+ */
+void _al_init_pools(void)
+{
+   if (!pool_mutex_inited) {
+      _al_mutex_init(&pool_mutex);
+      pool_mutex_inited = true;
+   }
+}
+
+
+/* Internal function: _al_shutdown_pools
+ *  Frees the chunks of all pools with no items in use.
+ */
+void _al_shutdown_pools(void)
+{
+   int i, j;
+
+   if (!pool_mutex_inited)
+      return;
+
+   _al_mutex_lock(&pool_mutex);
+   for (i = j = 0; i < num_pools; i++) {
+      _AL_POOL *pool = pools[i];
+
+      if (pool->live > 0) {
+         ALLEGRO_DEBUG("%s: %d items still in use\n", pool->name,
+            (int)pool->live);
+         pools[j++] = pool;
+         continue;
+      }
+      while (pool->chunks) {
+         POOL_CHUNK *chunk = pool->chunks;
+         pool->chunks = chunk->next;
+         al_free(chunk);
+      }
+      pool->free_list = NULL;
+      pool->registered = false;
+   }
+   num_pools = j;
+   _al_mutex_unlock(&pool_mutex);
+}
+
+
+/* Internal function: _al_pool_alloc
+ *  Returns an uninitialised item of pool->item_size bytes, or NULL.
+ */
+void *_al_pool_alloc(_AL_POOL *pool)
+{
+   POOL_HEADER *h = NULL;
+
+   if (pool_mutex_inited) {
+      _al_mutex_lock(&pool_mutex);
+      if (pool->free_list || grow_pool(pool)) {
+         h = pool->free_list;
+         pool->free_list = h->next;
+         pool->live++;
+      }
+      _al_mutex_unlock(&pool_mutex);
+      if (h) {
+         h->pool = pool;
+         return h + 1;
+      }
+   }
+
+   h = al_malloc(sizeof(POOL_HEADER) + pool->item_size);
+   if (!h)
+      return NULL;
+   h->pool = NULL;
+   return h + 1;
+}
+
+
+/* Internal function: _al_pool_free
+ *  Gives back an item returned by _al_pool_alloc. NULL is ignored.
+ */
+void _al_pool_free(void *item)
+{
+   POOL_HEADER *h;
+   _AL_POOL *pool;
+
+   if (!item)
+      return;
+
+   h = (POOL_HEADER *)item - 1;
+   pool = h->pool;
+   if (!pool) {
+      al_free(h);
+      return;
+   }
+
+   _al_mutex_lock(&pool_mutex);
+   h->next = pool->free_list;
+   pool->free_list = h;
+   pool->live--;
+   _al_mutex_unlock(&pool_mutex);
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -16,10 +16,13 @@
  *
  *
  *      This is a simple growing array to hold objects of various sizes,
- *      growing by powers of two as needed.  At the moment the vector never
- *      shrinks, except when it is freed.  Usually the vector would hold
- *      pointers to objects, not the objects themselves, as the vector is
- *      allowed to move the objects around.
+ *      growing by powers of two as needed, starting at MIN_CAPACITY items.
+ *      At the moment the vector never shrinks, except when it is freed.
+ *      Usually the vector would hold pointers to objects, not the objects
+ *      themselves, as the vector is allowed to move the objects around.
+ *
+ *      A vector may start out in a small buffer provided by its owner (see
+ *      _al_vector_init_inline) and only moves to the heap once that is full.
  *
  *      This module is NOT thread-safe.
  */
@@ -39,6 +42,47 @@
 /* return the given item's starting address in the vector */
 #define ITEM_START(vec, idx)    (vec->_items + ((idx) * vec->_itemsize))
 
+/* the number of items allocated when the first item is added */
+#define MIN_CAPACITY    4
+
+
+
+/* grow:
+ *  Make room for at least MIN_ITEMS more items, doubling the capacity as
+ *  often as needed.
+ */
+static bool grow(_AL_VECTOR *vec, size_t min_items)
+{
+   size_t capacity = vec->_size + vec->_unused;
+   size_t needed = vec->_size + min_items;
+   char *new_items;
+
+   if (needed <= capacity)
+      return true;
+
+   if (capacity < MIN_CAPACITY)
+      capacity = MIN_CAPACITY;
+   while (capacity < needed)
+      capacity *= 2;
+
+   if (vec->_inline) {
+      new_items = al_malloc(capacity * vec->_itemsize);
+      if (new_items && vec->_size > 0)
+         memcpy(new_items, vec->_items, vec->_size * vec->_itemsize);
+   }
+   else {
+      new_items = al_realloc(vec->_items, capacity * vec->_itemsize);
+   }
+   ASSERT(new_items);
+   if (!new_items)
+      return false;
+
+   vec->_items = new_items;
+   vec->_unused = capacity - vec->_size;
+   vec->_inline = false;
+   return true;
+}
+
 
 
 /* Internal function: _al_vector_init
@@ -58,6 +102,46 @@ void _al_vector_init(_AL_VECTOR *vec, size_t itemsize)
    vec->_items = NULL;
    vec->_size = 0;
    vec->_unused = 0;
+   vec->_inline = false;
+}
+
+
+
+/* Internal function: _al_vector_init_inline
+ *
+ *  Initialise a vector which keeps its first CAPACITY items in BUF, usually
+ *  an array next to the vector in the same structure.  Only once more items
+ *  are added they are moved to the heap.  BUF must stay valid for as long
+ *  as the vector is used, so such a vector must not be copied by value.
+ */
+void _al_vector_init_inline(_AL_VECTOR *vec, size_t itemsize, void *buf,
+   size_t capacity)
+{
+   ASSERT(vec);
+   ASSERT(itemsize > 0);
+   ASSERT(buf);
+
+   vec->_itemsize = itemsize;
+   vec->_items = buf;
+   vec->_size = 0;
+   vec->_unused = capacity;
+   vec->_inline = true;
+}
+
+
+
+/* Internal function: _al_vector_reserve
+ *
+ *  Make sure the vector can hold CAPACITY items in total without having to
+ *  grow again.  Returns false if the memory could not be allocated.
+ */
+bool _al_vector_reserve(_AL_VECTOR *vec, size_t capacity)
+{
+   ASSERT(vec);
+
+   if (capacity <= vec->_size)
+      return true;
+   return grow(vec, capacity - vec->_size);
 }
 
 
@@ -121,27 +205,8 @@ bool _al_vector_append_array(_AL_VECTOR *vec, unsigned int num, const void *arr)
    ASSERT(arr);
    ASSERT(num);
 
-   if (vec->_items == NULL) {
-      ASSERT(vec->_size == 0);
-      ASSERT(vec->_unused == 0);
-
-      vec->_items = al_malloc(vec->_itemsize * num);
-      ASSERT(vec->_items);
-      if (!vec->_items)
-         return false;
-
-      vec->_unused = num;
-   }
-   else if (vec->_unused < num) {
-      char *new_items;
-      new_items = al_realloc(vec->_items, (vec->_size + num) * vec->_itemsize);
-      ASSERT(new_items);
-      if (!new_items)
-         return false;
-
-      vec->_items = new_items;
-      vec->_unused = num;
-   }
+   if (!grow(vec, num))
+      return false;
 
    memcpy(vec->_items + (vec->_size * vec->_itemsize),
       arr, vec->_itemsize * num);
@@ -173,27 +238,9 @@ void* _al_vector_alloc_back(_AL_VECTOR *vec)
    ASSERT(vec);
    ASSERT(vec->_itemsize > 0);
    {
-      if (vec->_items == NULL) {
-         ASSERT(vec->_size == 0);
-         ASSERT(vec->_unused == 0);
-
-         vec->_items = al_malloc(vec->_itemsize);
-         ASSERT(vec->_items);
-         if (!vec->_items)
-            return NULL;
-
-         vec->_unused = 1;
-      }
-      else if (vec->_unused == 0) {
-         char *new_items = al_realloc(vec->_items, 2 * vec->_size * vec->_itemsize);
-         ASSERT(new_items);
-         if (!new_items)
-            return NULL;
-
-         vec->_items = new_items;
-         vec->_unused = vec->_size;
-      }
-   
+      if (vec->_unused == 0 && !grow(vec, 1))
+         return NULL;
+
       vec->_size++;
       vec->_unused--;
 
@@ -217,20 +264,10 @@ void* _al_vector_alloc_mid(_AL_VECTOR *vec, unsigned int index)
    ASSERT(vec);
    ASSERT(vec->_itemsize > 0);
    {
-      if (vec->_items == NULL) {
-         ASSERT(index == 0);
-         return _al_vector_alloc_back(vec);
-      }
-
-      if (vec->_unused == 0) {
-         char *new_items = al_realloc(vec->_items, 2 * vec->_size * vec->_itemsize);
-         ASSERT(new_items);
-         if (!new_items)
-            return NULL;
+      ASSERT(index <= vec->_size);
 
-         vec->_items = new_items;
-         vec->_unused = vec->_size;
-      }
+      if (vec->_unused == 0 && !grow(vec, 1))
+         return NULL;
 
       memmove(ITEM_START(vec, index + 1), ITEM_START(vec, index),
       vec->_itemsize * (vec->_size - index));
@@ -315,6 +352,31 @@ void _al_vector_delete_at(_AL_VECTOR *vec, unsigned int idx)
 
 
 
+/* Internal function: _al_vector_delete_at_unordered
+ *
+ *  Delete the slot given by index by moving the last item into it.  This
+ *  takes constant time but does not keep the order of the items.  Returns
+ *  true if an item was moved, so that callers which remember the index of
+ *  their items can update the moved one.
+ */
+bool _al_vector_delete_at_unordered(_AL_VECTOR *vec, unsigned int idx)
+{
+   unsigned int last;
+
+   ASSERT(vec);
+   ASSERT(idx < vec->_size);
+
+   last = vec->_size - 1;
+   if (idx != last)
+      memcpy(ITEM_START(vec, idx), ITEM_START(vec, last), vec->_itemsize);
+   vec->_size--;
+   vec->_unused++;
+   memset(ITEM_START(vec, vec->_size), 0, vec->_itemsize);
+   return idx != last;
+}
+
+
+
 /* Internal function: _al_vector_find_and_delete
  *
  *  Similar to _al_vector_delete_at(_al_vector_find(vec, ptr_item)) but is
@@ -334,6 +396,24 @@ bool _al_vector_find_and_delete(_AL_VECTOR *vec, const void *ptr_item)
 
 
 
+/* Internal function: _al_vector_find_and_delete_unordered
+ *
+ *  Like _al_vector_find_and_delete but the last item takes the place of the
+ *  deleted one, see _al_vector_delete_at_unordered.
+ */
+bool _al_vector_find_and_delete_unordered(_AL_VECTOR *vec,
+   const void *ptr_item)
+{
+   int idx = _al_vector_find(vec, ptr_item);
+   if (idx >= 0) {
+      _al_vector_delete_at_unordered(vec, idx);
+      return true;
+   }
+   return false;
+}
+
+
+
 /* Internal function: _al_vector_free
  * 
  *  Free the space used by the vector.  You really must do this at some
@@ -344,12 +424,12 @@ void _al_vector_free(_AL_VECTOR *vec)
 {
    ASSERT(vec);
 
-   if (vec->_items != NULL) {
+   if (vec->_items != NULL && !vec->_inline)
       al_free(vec->_items);
-      vec->_items = NULL;
-   }
+   vec->_items = NULL;
    vec->_size = 0;
    vec->_unused = 0;
+   vec->_inline = false;
 }
 
 
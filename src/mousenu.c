@@ -208,14 +208,42 @@ bool al_set_mouse_axis(int which, int value)
  */
 void al_get_mouse_state(ALLEGRO_MOUSE_STATE *ret_state)
 {
+   ALLEGRO_MOUSE *mouse;
+
    ASSERT(new_mouse_driver);
    ASSERT(ret_state);
 
+   mouse = new_mouse_driver->get_mouse();
+   if (mouse && _al_input_snapshot_is_active(&mouse->snapshot)) {
+      _al_read_input_snapshot(&mouse->snapshot, ret_state);
+      return;
+   }
+
    new_mouse_driver->get_mouse_state(ret_state);
 }
 
 
 
+/* Function: al_get_mouse_state_history
+ */
+int al_get_mouse_state_history(double since, ALLEGRO_MOUSE_STATE *ret_states,
+   double *ret_timestamps, int max)
+{
+   ALLEGRO_MOUSE *mouse;
+
+   ASSERT(new_mouse_driver);
+   ASSERT(ret_states);
+
+   mouse = new_mouse_driver->get_mouse();
+   if (!mouse || !_al_input_snapshot_is_active(&mouse->snapshot))
+      return 0;
+
+   return _al_read_input_snapshot_history(&mouse->snapshot, since,
+      ret_states, ret_timestamps, max);
+}
+
+
+
 /* Function: al_get_mouse_state_axis
  */
 int al_get_mouse_state_axis(const ALLEGRO_MOUSE_STATE *state, int axis)
@@ -59,7 +59,7 @@ ALLEGRO_DEBUG_CHANNEL("opengl")
     */
    #if defined ALLEGRO_GLXGETPROCADDRESSARB
       #define alXGetProcAddress glXGetProcAddressARB
-   #elif defined ALLEGRO_RASPBERRYPI
+   #elif defined ALLEGRO_RASPBERRYPI || defined ALLEGRO_KMS
       #define alXGetProcAddress eglGetProcAddress
    #else
       #define alXGetProcAddress glXGetProcAddress
@@ -613,7 +613,7 @@ void *al_get_opengl_proc_address(const char *name)
        * address. Unfortunately glXGetProcAddress is an extension
        * and may not be available on all platforms
        */
-#if defined ALLEGRO_RASPBERRYPI
+#if defined ALLEGRO_RASPBERRYPI || defined ALLEGRO_KMS
       symbol = alXGetProcAddress(name);
 #else
       symbol = alXGetProcAddress((const GLubyte *)name);
@@ -889,6 +889,14 @@ void _al_ogl_manage_extensions(ALLEGRO_DISPLAY *gl_disp)
          ext_list->ALLEGRO_GL_OES_texture_npot;
    ALLEGRO_INFO("Use of non-power-of-two textures %s.\n",
       s[ALLEGRO_SUPPORT_NPOT_BITMAP] ? "enabled" : "disabled");
+#if defined ALLEGRO_CFG_OPENGLES3 && !defined ALLEGRO_IPHONE
+   gl_disp->ogl_extras->multisampled_render_to_texture =
+      _ogl_is_extension_supported("GL_EXT_multisampled_render_to_texture",
+         gl_disp);
+   ALLEGRO_INFO("Use of multisampled render to texture %s.\n",
+      gl_disp->ogl_extras->multisampled_render_to_texture ? "enabled" :
+      "disabled");
+#endif
 #if defined ALLEGRO_CFG_OPENGLES
    if (gl_disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
       s[ALLEGRO_CAN_DRAW_INTO_BITMAP] = true;
@@ -122,6 +122,16 @@ int _al_ogl_get_glformat(int format, int component)
       {GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GL_UNSIGNED_INT_8_8_8_8, GL_RGBA}, /* RGBA_DXT1 */
       {GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, GL_UNSIGNED_INT_8_8_8_8, GL_RGBA}, /* RGBA_DXT3 */
       {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_UNSIGNED_INT_8_8_8_8, GL_RGBA}, /* RGBA_DXT5 */
+      {GL_COMPRESSED_RED_RGTC1, GL_UNSIGNED_BYTE, GL_RED}, /* R_BC4 */
+      {GL_COMPRESSED_RG_RGTC2, GL_UNSIGNED_BYTE, GL_RG}, /* RG_BC5 */
+      {GL_COMPRESSED_RGBA_BPTC_UNORM_ARB, GL_UNSIGNED_INT_8_8_8_8, GL_RGBA}, /* RGBA_BC7 */
+      {GL_COMPRESSED_RGB8_ETC2, GL_UNSIGNED_INT_8_8_8_8, GL_RGBA}, /* RGB_ETC2 */
+      {GL_COMPRESSED_RGBA8_ETC2_EAC, GL_UNSIGNED_INT_8_8_8_8, GL_RGBA}, /* RGBA_ETC2 */
+      {GL_COMPRESSED_RGBA_ASTC_4x4_KHR, GL_UNSIGNED_INT_8_8_8_8, GL_RGBA}, /* RGBA_ASTC_4x4 */
+      {GL_COMPRESSED_RGBA_ASTC_6x6_KHR, GL_UNSIGNED_INT_8_8_8_8, GL_RGBA}, /* RGBA_ASTC_6x6 */
+      {GL_COMPRESSED_RGBA_ASTC_8x8_KHR, GL_UNSIGNED_INT_8_8_8_8, GL_RGBA}, /* RGBA_ASTC_8x8 */
+      {GL_SRGB8_ALPHA8, GL_UNSIGNED_INT_8_8_8_8_REV, GL_BGRA}, /* ARGB_8888_SRGB */
+      {GL_SRGB8_ALPHA8, GL_UNSIGNED_INT_8_8_8_8_REV, GL_RGBA}, /* ABGR_8888_SRGB */
    };
   
    if (al_get_opengl_version() >= _ALLEGRO_OPENGL_VERSION_3_0) {
@@ -164,6 +174,16 @@ int _al_ogl_get_glformat(int format, int component)
       {0, 0, 0},
       {0, 0, 0},
       {0, 0, 0},
+      {0, 0, 0},
+      {0, 0, 0},
+      {0, 0, 0},
+      {GL_COMPRESSED_RGB8_ETC2, GL_UNSIGNED_BYTE, GL_RGBA}, /* RGB_ETC2 */
+      {GL_COMPRESSED_RGBA8_ETC2_EAC, GL_UNSIGNED_BYTE, GL_RGBA}, /* RGBA_ETC2 */
+      {GL_COMPRESSED_RGBA_ASTC_4x4_KHR, GL_UNSIGNED_BYTE, GL_RGBA}, /* RGBA_ASTC_4x4 */
+      {GL_COMPRESSED_RGBA_ASTC_6x6_KHR, GL_UNSIGNED_BYTE, GL_RGBA}, /* RGBA_ASTC_6x6 */
+      {GL_COMPRESSED_RGBA_ASTC_8x8_KHR, GL_UNSIGNED_BYTE, GL_RGBA}, /* RGBA_ASTC_8x8 */
+      {0, 0, 0},
+      {GL_SRGB8_ALPHA8, GL_UNSIGNED_BYTE, GL_RGBA}, /* ABGR_8888_SRGB */
    };
    #endif
    
@@ -196,9 +216,10 @@ char const *_al_gl_error_string(GLenum e)
 }
 #undef ERR
 
-static INLINE void transform_vertex(float* x, float* y, float* z)
+static INLINE void transform_vertices(ALLEGRO_OGL_BITMAP_VERTEX *v, int n)
 {
-   al_transform_coordinates_3d(al_get_current_transform(), x, y, z);
+   al_transform_coordinates_3d_array(al_get_current_transform(), &v->x, n,
+      sizeof(*v));
 }
 
 static void draw_quad(ALLEGRO_BITMAP *bitmap,
@@ -211,13 +232,15 @@ static void draw_quad(ALLEGRO_BITMAP *bitmap,
    ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap = bitmap->extra;
    ALLEGRO_OGL_BITMAP_VERTEX *verts;
    ALLEGRO_DISPLAY *disp = al_get_current_display();
+   ALLEGRO_DRAW_LIST *recording = _al_get_draw_recording(disp);
+   float tex_index;
    
    (void)flags;
 
-   if (disp->num_cache_vertices != 0 && ogl_bitmap->texture != disp->cache_texture) {
-      disp->vt->flush_vertex_cache(disp);
-   }
-   disp->cache_texture = ogl_bitmap->texture;
+   if (recording)
+      _al_update_draw_recording_blender(recording);
+
+   tex_index = _al_ogl_batch_texture(disp, ogl_bitmap->texture);
 
    verts = disp->vt->prepare_vertex_cache(disp, 6);
 
@@ -245,6 +268,7 @@ static void draw_quad(ALLEGRO_BITMAP *bitmap,
    verts[0].g = tint.g;
    verts[0].b = tint.b;
    verts[0].a = tint.a;
+   verts[0].tex_index = tex_index;
    
    verts[1].x = 0;
    verts[1].y = 0;
@@ -255,6 +279,7 @@ static void draw_quad(ALLEGRO_BITMAP *bitmap,
    verts[1].g = tint.g;
    verts[1].b = tint.b;
    verts[1].a = tint.a;
+   verts[1].tex_index = tex_index;
    
    verts[2].x = dw;
    verts[2].y = dh;
@@ -265,6 +290,7 @@ static void draw_quad(ALLEGRO_BITMAP *bitmap,
    verts[2].g = tint.g;
    verts[2].b = tint.b;
    verts[2].a = tint.a;
+   verts[2].tex_index = tex_index;
    
    verts[4].x = dw;
    verts[4].y = 0;
@@ -275,18 +301,17 @@ static void draw_quad(ALLEGRO_BITMAP *bitmap,
    verts[4].g = tint.g;
    verts[4].b = tint.b;
    verts[4].a = tint.a;
+   verts[4].tex_index = tex_index;
    
-   if (disp->cache_enabled) {
+   if (disp->cache_enabled || recording) {
       /* If drawing is batched, we apply transformations manually. */
-      transform_vertex(&verts[0].x, &verts[0].y, &verts[0].z);
-      transform_vertex(&verts[1].x, &verts[1].y, &verts[1].z);
-      transform_vertex(&verts[2].x, &verts[2].y, &verts[2].z);
-      transform_vertex(&verts[4].x, &verts[4].y, &verts[4].z);
+      transform_vertices(verts, 3);
+      transform_vertices(verts + 4, 1);
    }
    verts[3] = verts[1];
    verts[5] = verts[2];
    
-   if (!disp->cache_enabled)
+   if (!disp->cache_enabled && !recording)
       disp->vt->flush_vertex_cache(disp);
 }
 #undef SWAP
@@ -380,6 +405,103 @@ static void ogl_draw_bitmap_region(ALLEGRO_BITMAP *bitmap,
 }
 
 
+/* Adds the regions to the vertex cache, all with the texture coordinates
+ * and transformation worked out here instead of one draw_quad call each.
+ */
+static bool ogl_draw_bitmap_regions(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_COLOR tint, const _AL_BITMAP_REGION *regions, int count)
+{
+   ALLEGRO_BITMAP *target = al_get_target_bitmap();
+   ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap = bitmap->extra;
+   ALLEGRO_DISPLAY *disp = _al_get_bitmap_display(target);
+   ALLEGRO_DRAW_LIST *recording;
+   float tex_l, tex_t, tex_w, tex_h;
+   float tex_index;
+   int i, j;
+
+   if (target->parent)
+      target = target->parent;
+
+   if (bitmap->locked || target->locked || ogl_bitmap->is_backbuffer)
+      return false;
+   if (!disp || disp->ogl_extras->opengl_target != target)
+      return false;
+
+   recording = _al_get_draw_recording(disp);
+   if (recording)
+      _al_update_draw_recording_blender(recording);
+
+   tex_index = _al_ogl_batch_texture(disp, ogl_bitmap->texture);
+
+   tex_l = ogl_bitmap->left;
+   tex_t = ogl_bitmap->top;
+   tex_w = 1.0f / ogl_bitmap->true_w;
+   tex_h = 1.0f / ogl_bitmap->true_h;
+
+   while (count > 0) {
+      /* The vertex cache may not be able to take more at once. */
+      int n = _ALLEGRO_MIN(count, 1024);
+      ALLEGRO_OGL_BITMAP_VERTEX *verts;
+
+      verts = disp->vt->prepare_vertex_cache(disp, 6 * n);
+
+      for (i = 0; i < n; i++) {
+         const _AL_BITMAP_REGION *r = &regions[i];
+         ALLEGRO_OGL_BITMAP_VERTEX *v = verts + 6 * i;
+         float l = tex_l + r->sx * tex_w;
+         float t = tex_t - r->sy * tex_h;
+         float rt = l + r->sw * tex_w;
+         float b = t - r->sh * tex_h;
+
+         v[0].x = r->dx;
+         v[0].y = r->dy + r->sh;
+         v[0].tx = l;
+         v[0].ty = b;
+
+         v[1].x = r->dx;
+         v[1].y = r->dy;
+         v[1].tx = l;
+         v[1].ty = t;
+
+         v[2].x = r->dx + r->sw;
+         v[2].y = r->dy + r->sh;
+         v[2].tx = rt;
+         v[2].ty = b;
+
+         v[4].x = r->dx + r->sw;
+         v[4].y = r->dy;
+         v[4].tx = rt;
+         v[4].ty = t;
+
+         for (j = 0; j < 5; j++) {
+            if (j == 3)
+               continue;
+            v[j].z = 0;
+            v[j].r = tint.r;
+            v[j].g = tint.g;
+            v[j].b = tint.b;
+            v[j].a = tint.a;
+            v[j].tex_index = tex_index;
+         }
+         v[3] = v[1];
+         v[5] = v[2];
+      }
+
+      if (disp->cache_enabled || recording) {
+         /* If drawing is batched, we apply transformations manually. */
+         transform_vertices(verts, 6 * n);
+      }
+
+      regions += n;
+      count -= n;
+   }
+
+   if (!disp->cache_enabled && !recording)
+      disp->vt->flush_vertex_cache(disp);
+   return true;
+}
+
+
 /* Helper to get smallest fitting power of two. */
 static int pot(int x)
 {
@@ -407,6 +529,8 @@ static bool ogl_upload_bitmap(ALLEGRO_BITMAP *bitmap)
       GL_NEAREST_MIPMAP_LINEAR, GL_LINEAR_MIPMAP_LINEAR
    };
 
+   ogl_bitmap->discard_pending = false;
+
    if (ogl_bitmap->texture == 0) {
       glGenTextures(1, &ogl_bitmap->texture);
       e = glGetError();
@@ -461,7 +585,10 @@ static bool ogl_upload_bitmap(ALLEGRO_BITMAP *bitmap)
       if (al_get_opengl_extension_list()->ALLEGRO_GL_EXT_framebuffer_object ||
           al_get_opengl_extension_list()->ALLEGRO_GL_OES_framebuffer_object ||
           IS_OPENGLES /* FIXME */) {
-         post_generate_mipmap = true;
+         /* Compressed textures get their mipmaps once they have content,
+          * either uploaded by the loader or generated on unlock.
+          */
+         post_generate_mipmap = !_al_pixel_format_is_compressed(bitmap_format);
       }
       else {
 #ifdef ALLEGRO_CFG_OPENGL_FIXED_FUNCTION
@@ -481,7 +608,20 @@ static bool ogl_upload_bitmap(ALLEGRO_BITMAP *bitmap)
     * NaN values in the texture cause some blending modes to fail on
     * those pixels
     */
-   if (!IS_OPENGLES) {
+   if (_al_pixel_format_is_compressed(bitmap_format)) {
+      /* OpenGL ES cannot compress pixel data, and desktop drivers need not
+       * be able to compress to every format, so start with zeroed blocks.
+       */
+      int size = ogl_bitmap->true_w / al_get_pixel_block_width(bitmap_format) *
+         (ogl_bitmap->true_h / al_get_pixel_block_height(bitmap_format)) *
+         al_get_pixel_block_size(bitmap_format);
+      unsigned char *buf = al_calloc(1, size);
+      glCompressedTexImage2D(GL_TEXTURE_2D, 0, get_glformat(bitmap_format, 0),
+         ogl_bitmap->true_w, ogl_bitmap->true_h, 0, size, buf);
+      e = glGetError();
+      al_free(buf);
+   }
+   else if (!IS_OPENGLES) {
       if (ogl_bitmap->true_w != bitmap->w ||
             ogl_bitmap->true_h != bitmap->h ||
             bitmap_format == ALLEGRO_PIXEL_FORMAT_ABGR_F32) {
@@ -584,6 +724,9 @@ static void ogl_destroy_bitmap(ALLEGRO_BITMAP *bitmap)
      bmp_disp->ogl_extras->opengl_target = NULL;
    }
 
+   /* Nothing needs to be resolved any more. */
+   if (ogl_bitmap->fbo_info)
+      ogl_bitmap->fbo_info->unresolved = false;
    al_remove_opengl_fbo(bitmap);
 
    if (ogl_bitmap->texture) {
@@ -591,6 +734,11 @@ static void ogl_destroy_bitmap(ALLEGRO_BITMAP *bitmap)
       ogl_bitmap->texture = 0;
    }
 
+   if (ogl_bitmap->depth_texture) {
+      glDeleteTextures(1, &ogl_bitmap->depth_texture);
+      ogl_bitmap->depth_texture = 0;
+   }
+
    if (old_disp) {
       _al_set_current_display_only(old_disp);
    }
@@ -611,25 +759,37 @@ static void ogl_bitmap_pointer_changed(ALLEGRO_BITMAP *bitmap,
 }
 
 
-static bool can_flip_blocks(ALLEGRO_PIXEL_FORMAT format)
+/* Flips the 3 bit indices of a DXT5 alpha block, which is also the layout
+ * of BC4 and BC5 channels. The row points past the two endpoints.
+ */
+static void flip_alpha_bits(unsigned char *row)
 {
-   switch (format) {
-      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1:
-      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3:
-      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5:
-         return true;
-      default:
-         return false;
-   }
+   uint16_t bit_row0, bit_row1, bit_row2, bit_row3;
+
+   bit_row0 = (((uint16_t)row[0]) | (uint16_t)row[1] << 8) << 4;
+   bit_row1 = (((uint16_t)row[1]) | (uint16_t)row[2] << 8) >> 4;
+   bit_row2 = (((uint16_t)row[3]) | (uint16_t)row[4] << 8) << 4;
+   bit_row3 = (((uint16_t)row[4]) | (uint16_t)row[5] << 8) >> 4;
+
+   row[0] = (unsigned char)(bit_row3 & 0x00ff);
+   row[1] = (unsigned char)((bit_row2 & 0x00ff) | ((bit_row3 & 0xff00) >> 8));
+   row[2] = (unsigned char)((bit_row2 & 0xff00) >> 8);
+
+   row[3] = (unsigned char)(bit_row1 & 0x00ff);
+   row[4] = (unsigned char)((bit_row0 & 0x00ff) | ((bit_row1 & 0xff00) >> 8));
+   row[5] = (unsigned char)((bit_row0 & 0xff00) >> 8);
 }
 
 
+/* The pixels inside BC7, ETC2 and ASTC blocks cannot be reordered without
+ * re-encoding them, so those formats are locked with their block rows
+ * flipped but the blocks themselves left as they are.
+ */
 static void ogl_flip_blocks(ALLEGRO_LOCKED_REGION *lr, int wc, int hc)
 {
 #define SWAP(x, y) do { unsigned char t = x; x = y; y = t; } while (0)
    int x, y;
    unsigned char* data = lr->data;
-   ASSERT(can_flip_blocks(lr->format));
    switch (lr->format) {
       case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1: {
          for (y = 0; y < hc; y++) {
@@ -680,23 +840,10 @@ static void ogl_flip_blocks(ALLEGRO_LOCKED_REGION *lr, int wc, int hc)
          for (y = 0; y < hc; y++) {
             unsigned char* row = data;
             for (x = 0; x < wc; x++) {
-               uint16_t bit_row0, bit_row1, bit_row2, bit_row3;
-
                /* Skip the alpha table */
                row += 2;
 
-               bit_row0 = (((uint16_t)row[0]) | (uint16_t)row[1] << 8) << 4;
-               bit_row1 = (((uint16_t)row[1]) | (uint16_t)row[2] << 8) >> 4;
-               bit_row2 = (((uint16_t)row[3]) | (uint16_t)row[4] << 8) << 4;
-               bit_row3 = (((uint16_t)row[4]) | (uint16_t)row[5] << 8) >> 4;
-
-               row[0] = (unsigned char)(bit_row3 & 0x00ff);
-               row[1] = (unsigned char)((bit_row2 & 0x00ff) | ((bit_row3 & 0xff00) >> 8));
-               row[2] = (unsigned char)((bit_row2 & 0xff00) >> 8);
-
-               row[3] = (unsigned char)(bit_row1 & 0x00ff);
-               row[4] = (unsigned char)((bit_row0 & 0x00ff) | ((bit_row1 & 0xff00) >> 8));
-               row[5] = (unsigned char)((bit_row0 & 0xff00) >> 8);
+               flip_alpha_bits(row);
 
                /* Skip the alpha bit-map */
                row += 6;
@@ -715,6 +862,24 @@ static void ogl_flip_blocks(ALLEGRO_LOCKED_REGION *lr, int wc, int hc)
          }
          break;
       }
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4:
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5: {
+         int channels = (lr->format == ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5) ? 2 : 1;
+         for (y = 0; y < hc; y++) {
+            unsigned char* row = data;
+            for (x = 0; x < wc * channels; x++) {
+               /* Skip the endpoints */
+               row += 2;
+
+               flip_alpha_bits(row);
+
+               /* Skip the bit-map */
+               row += 6;
+            }
+            data += lr->pitch;
+         }
+         break;
+      }
       default:
          (void)x;
          (void)y;
@@ -728,27 +893,24 @@ static void ogl_flip_blocks(ALLEGRO_LOCKED_REGION *lr, int wc, int hc)
 static ALLEGRO_LOCKED_REGION *ogl_lock_compressed_region(ALLEGRO_BITMAP *bitmap,
    int x, int y, int w, int h, int flags)
 {
-#if !defined ALLEGRO_CFG_OPENGLES
    ALLEGRO_BITMAP_EXTRA_OPENGL *const ogl_bitmap = bitmap->extra;
-   ALLEGRO_DISPLAY *disp;
-   ALLEGRO_DISPLAY *old_disp = NULL;
-   GLenum e;
-   bool ok = true;
    int bitmap_format = al_get_bitmap_format(bitmap);
    int block_width = al_get_pixel_block_width(bitmap_format);
    int block_height = al_get_pixel_block_height(bitmap_format);
    int block_size = al_get_pixel_block_size(bitmap_format);
-   int xc = x / block_width;
-   int yc = y / block_width;
    int wc = w / block_width;
-   int hc = h / block_width;
+   int hc = h / block_height;
+#if !defined ALLEGRO_CFG_OPENGLES
+   ALLEGRO_DISPLAY *disp;
+   ALLEGRO_DISPLAY *old_disp = NULL;
+   GLenum e;
+   bool ok = true;
+   int xc = x / block_width;
+   int yc = y / block_height;
    int true_wc = ogl_bitmap->true_w / block_width;
    int true_hc = ogl_bitmap->true_h / block_height;
    int gl_yc = _al_get_least_multiple(bitmap->h, block_height) / block_height - yc - hc;
-
-   if (!can_flip_blocks(bitmap_format)) {
-      return NULL;
-   }
+#endif
 
    if (flags & ALLEGRO_LOCK_WRITEONLY) {
       int pitch = wc * block_size;
@@ -764,6 +926,7 @@ static ALLEGRO_LOCKED_REGION *ogl_lock_compressed_region(ALLEGRO_BITMAP *bitmap,
       return &bitmap->locked_region;
    }
 
+#if !defined ALLEGRO_CFG_OPENGLES
    disp = al_get_current_display();
 
    /* Change OpenGL context if necessary. */
@@ -858,20 +1021,42 @@ static ALLEGRO_LOCKED_REGION *ogl_lock_compressed_region(ALLEGRO_BITMAP *bitmap,
    ASSERT(ogl_bitmap->lock_buffer == NULL);
    return NULL;
 #else
-   (void)bitmap;
+   /* OpenGL ES has no way to read back compressed textures. */
    (void)x;
    (void)y;
-   (void)w;
-   (void)h;
-   (void)flags;
    return NULL;
 #endif
 }
 
 
+/* Compressed textures start out without mipmaps, see ogl_upload_bitmap. Not
+ * all drivers can generate them (OpenGL ES never can), in that case the
+ * texture is limited to its base level so it can still be drawn.
+ */
+static void ogl_generate_compressed_mipmaps(ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap)
+{
+   GLenum e;
+
+   if (!al_get_opengl_extension_list()->ALLEGRO_GL_EXT_framebuffer_object &&
+       !IS_OPENGLES) {
+      /* GL_GENERATE_MIPMAP takes care of it. */
+      return;
+   }
+
+   glGenerateMipmapEXT(GL_TEXTURE_2D);
+   e = glGetError();
+   if (e) {
+      ALLEGRO_WARN("glGenerateMipmapEXT for texture %d failed (%s).\n",
+         ogl_bitmap->texture, _al_gl_error_string(e));
+#ifdef GL_TEXTURE_MAX_LEVEL
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+#endif
+   }
+}
+
+
 static void ogl_unlock_compressed_region(ALLEGRO_BITMAP *bitmap)
 {
-#if !defined ALLEGRO_CFG_OPENGLES
    ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap = bitmap->extra;
    int lock_format = bitmap->locked_region.format;
    ALLEGRO_DISPLAY *old_disp = NULL;
@@ -884,10 +1069,6 @@ static void ogl_unlock_compressed_region(ALLEGRO_BITMAP *bitmap)
       (block_width * block_height) * block_size;
    int gl_y = _al_get_least_multiple(bitmap->h, block_height) - bitmap->lock_y - bitmap->lock_h;
 
-   /* It shouldn't be possible for this to fail, as we wouldn't have been able
-    * to lock earlier */
-   ASSERT(can_flip_blocks(bitmap->locked_region.format));
-
    if ((bitmap->lock_flags & ALLEGRO_LOCK_READONLY)) {
       goto EXIT;
    }
@@ -931,6 +1112,9 @@ static void ogl_unlock_compressed_region(ALLEGRO_BITMAP *bitmap)
       ALLEGRO_ERROR("glCompressedTexSubImage2D for format %s failed (%s).\n",
          _al_pixel_format_name(lock_format), _al_gl_error_string(e));
    }
+   else if (al_get_bitmap_flags(bitmap) & ALLEGRO_MIPMAP) {
+      ogl_generate_compressed_mipmaps(ogl_bitmap);
+   }
 
    if (previous_alignment != 1) {
       glPixelStorei(GL_UNPACK_ALIGNMENT, previous_alignment);
@@ -943,9 +1127,104 @@ static void ogl_unlock_compressed_region(ALLEGRO_BITMAP *bitmap)
 EXIT:
    al_free(ogl_bitmap->lock_buffer);
    ogl_bitmap->lock_buffer = NULL;
-#else
-   (void)bitmap;
+}
+
+/* Uploads one mipmap level given top row first. The level sizes follow from
+ * the texture size, so this only works if the texture has no padding.
+ */
+static bool ogl_upload_mipmap(ALLEGRO_BITMAP *bitmap, int level,
+   const void *data, int pitch)
+{
+   ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap = bitmap->extra;
+   int format = al_get_bitmap_format(bitmap);
+   bool compressed = _al_pixel_format_is_compressed(format);
+   int block_width = al_get_pixel_block_width(format);
+   int block_height = al_get_pixel_block_height(format);
+   int block_size = al_get_pixel_block_size(format);
+   int level_w = _ALLEGRO_MAX(1, ogl_bitmap->true_w >> level);
+   int level_h = _ALLEGRO_MAX(1, ogl_bitmap->true_h >> level);
+   int wc = (level_w + block_width - 1) / block_width;
+   int hc = (level_h + block_height - 1) / block_height;
+   int row_size = wc * block_size;
+   ALLEGRO_DISPLAY *old_disp = NULL;
+   ALLEGRO_DISPLAY *disp;
+   unsigned char *buf;
+   int previous_alignment;
+   GLenum e;
+   int y;
+
+   if (ogl_bitmap->is_backbuffer || ogl_bitmap->texture == 0 ||
+       ogl_bitmap->true_w != bitmap->w || ogl_bitmap->true_h != bitmap->h) {
+      return false;
+   }
+
+   buf = al_malloc(row_size * hc);
+   if (!buf) {
+      return false;
+   }
+
+   /* OpenGL wants the bottom row first. */
+   for (y = 0; y < hc; y++) {
+      memcpy(buf + row_size * (hc - 1 - y),
+         (const char *)data + pitch * y, row_size);
+   }
+   if (compressed) {
+      ALLEGRO_LOCKED_REGION lr;
+      lr.data = buf;
+      lr.format = format;
+      lr.pitch = row_size;
+      lr.pixel_size = block_size;
+      ogl_flip_blocks(&lr, wc, hc);
+   }
+
+   disp = al_get_current_display();
+
+   /* Change OpenGL context if necessary. */
+   if (!disp ||
+      (_al_get_bitmap_display(bitmap)->ogl_extras->is_shared == false &&
+       _al_get_bitmap_display(bitmap) != disp))
+   {
+      old_disp = disp;
+      _al_set_current_display_only(_al_get_bitmap_display(bitmap));
+   }
+
+   glGetIntegerv(GL_UNPACK_ALIGNMENT, &previous_alignment);
+   if (previous_alignment != 1) {
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+   }
+
+   glBindTexture(GL_TEXTURE_2D, ogl_bitmap->texture);
+   if (compressed) {
+      glCompressedTexImage2D(GL_TEXTURE_2D, level, get_glformat(format, 0),
+         level_w, level_h, 0, row_size * hc, buf);
+   }
+   else {
+      glTexImage2D(GL_TEXTURE_2D, level, get_glformat(format, 0),
+         level_w, level_h, 0, get_glformat(format, 2),
+         get_glformat(format, 1), buf);
+   }
+   e = glGetError();
+   if (e) {
+      ALLEGRO_ERROR("Uploading mipmap level %d for format %s failed (%s).\n",
+         level, _al_pixel_format_name(format), _al_gl_error_string(e));
+   }
+#ifdef GL_TEXTURE_MAX_LEVEL
+   else {
+      /* The levels come in order, so this is the smallest one so far. */
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+   }
 #endif
+
+   if (previous_alignment != 1) {
+      glPixelStorei(GL_UNPACK_ALIGNMENT, previous_alignment);
+   }
+
+   if (old_disp) {
+      _al_set_current_display_only(old_disp);
+   }
+
+   al_free(buf);
+   return e == 0;
 }
 
 static void ogl_backup_dirty_bitmap(ALLEGRO_BITMAP *b)
@@ -988,6 +1267,40 @@ static void ogl_backup_dirty_bitmap(ALLEGRO_BITMAP *b)
    }
 }
 
+static void ogl_discard_contents(ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap = bitmap->extra;
+   ALLEGRO_DISPLAY *disp = _al_get_bitmap_display(bitmap);
+
+   if (disp == al_get_current_display() &&
+         disp->ogl_extras->opengl_target == bitmap) {
+      ogl_bitmap->discard_pending = false;
+      _al_ogl_discard_framebuffer(disp, bitmap, true, true);
+   }
+   else {
+      ogl_bitmap->discard_pending = true;
+   }
+}
+
+static bool ogl_resolve_bitmap(ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_DISPLAY *disp = _al_get_bitmap_display(bitmap);
+   ALLEGRO_DISPLAY *old_disp = NULL;
+   bool ok;
+
+   /* FBOs are not shared between contexts. */
+   if (disp != al_get_current_display()) {
+      old_disp = al_get_current_display();
+      _al_set_current_display_only(disp);
+   }
+
+   ok = _al_ogl_resolve_fbo(disp, bitmap);
+
+   if (old_disp)
+      _al_set_current_display_only(old_disp);
+   return ok;
+}
+
 /* Obtain a reference to this driver. */
 static ALLEGRO_BITMAP_INTERFACE *ogl_bitmap_driver(void)
 {
@@ -996,6 +1309,7 @@ static ALLEGRO_BITMAP_INTERFACE *ogl_bitmap_driver(void)
    }
 
    glbmp_vt.draw_bitmap_region = ogl_draw_bitmap_region;
+   glbmp_vt.draw_bitmap_regions = ogl_draw_bitmap_regions;
    glbmp_vt.upload_bitmap = ogl_upload_bitmap;
    glbmp_vt.update_clipping_rectangle = ogl_update_clipping_rectangle;
    glbmp_vt.destroy_bitmap = ogl_destroy_bitmap;
@@ -1006,16 +1320,68 @@ static ALLEGRO_BITMAP_INTERFACE *ogl_bitmap_driver(void)
 #else
    glbmp_vt.lock_region = _al_ogl_lock_region_new;
    glbmp_vt.unlock_region = _al_ogl_unlock_region_new;
+   glbmp_vt.start_readback = _al_ogl_start_readback;
 #endif
    glbmp_vt.lock_compressed_region = ogl_lock_compressed_region;
    glbmp_vt.unlock_compressed_region = ogl_unlock_compressed_region;
    glbmp_vt.backup_dirty_bitmap = ogl_backup_dirty_bitmap;
+   glbmp_vt.discard_contents = ogl_discard_contents;
+   glbmp_vt.upload_mipmap = ogl_upload_mipmap;
+   glbmp_vt.resolve_bitmap = ogl_resolve_bitmap;
 
    return &glbmp_vt;
 }
 
 
 
+static bool ogl_compressed_format_supported(int format)
+{
+   ALLEGRO_OGL_EXT_LIST *ext = al_get_opengl_extension_list();
+
+   if (get_glformat(format, 0) == 0)
+      return false;
+
+   switch (format) {
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1:
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3:
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5:
+         return ext->ALLEGRO_GL_EXT_texture_compression_s3tc;
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4:
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5:
+         return ext->ALLEGRO_GL_ARB_texture_compression_rgtc ||
+            ext->ALLEGRO_GL_EXT_texture_compression_rgtc;
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_BC7:
+         return ext->ALLEGRO_GL_ARB_texture_compression_bptc;
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGB_ETC2:
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ETC2:
+         /* Core in OpenGL ES 3.0. */
+         return ext->ALLEGRO_GL_ARB_ES3_compatibility ||
+            (IS_OPENGLES && al_get_opengl_version() >= _ALLEGRO_OPENGL_VERSION_3_0);
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_4x4:
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_6x6:
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x8:
+         return ext->ALLEGRO_GL_KHR_texture_compression_astc_ldr;
+      default:
+         return false;
+   }
+}
+
+static bool ogl_srgb_format_supported(int format)
+{
+   ALLEGRO_OGL_EXT_LIST *ext = al_get_opengl_extension_list();
+
+   if (get_glformat(format, 0) == 0)
+      return false;
+
+   /* Core in OpenGL 2.1 and OpenGL ES 3.0. */
+   if (IS_OPENGLES) {
+      return ext->ALLEGRO_GL_EXT_sRGB ||
+         al_get_opengl_version() >= _ALLEGRO_OPENGL_VERSION_3_0;
+   }
+   return ext->ALLEGRO_GL_EXT_texture_sRGB ||
+      al_get_opengl_version() >= _ALLEGRO_OPENGL_VERSION_2_1;
+}
+
 ALLEGRO_BITMAP *_al_ogl_create_bitmap(ALLEGRO_DISPLAY *d, int w, int h,
    int format, int flags)
 {
@@ -1032,17 +1398,24 @@ ALLEGRO_BITMAP *_al_ogl_create_bitmap(ALLEGRO_DISPLAY *d, int w, int h,
    ASSERT(_al_pixel_format_is_real(format));
 
    block_width = al_get_pixel_block_width(format);
-   block_height = al_get_pixel_block_width(format);
+   block_height = al_get_pixel_block_height(format);
    true_w = _al_get_least_multiple(w, block_width);
    true_h = _al_get_least_multiple(h, block_height);
 
    if (_al_pixel_format_is_compressed(format)) {
-      if (!al_get_opengl_extension_list()->ALLEGRO_GL_EXT_texture_compression_s3tc) {
-         ALLEGRO_DEBUG("Device does not support S3TC compressed textures.\n");
+      if (!ogl_compressed_format_supported(format)) {
+         ALLEGRO_DEBUG("Device does not support %s compressed textures.\n",
+            _al_pixel_format_name(format));
          return NULL;
       }
    }
 
+   if (_al_pixel_format_is_srgb(format) && !ogl_srgb_format_supported(format)) {
+      ALLEGRO_DEBUG("Device does not support %s textures.\n",
+         _al_pixel_format_name(format));
+      return NULL;
+   }
+
    if (!d->extra_settings.settings[ALLEGRO_SUPPORT_NPOT_BITMAP]) {
       true_w = pot(true_w);
       true_h = pot(true_h);
@@ -1065,8 +1438,11 @@ ALLEGRO_BITMAP *_al_ogl_create_bitmap(ALLEGRO_DISPLAY *d, int w, int h,
       }
    }
 
-   ASSERT(true_w % block_width == 0);
-   ASSERT(true_h % block_height == 0);
+   /* The adjustments above keep whole blocks only for block sizes which
+    * are powers of two.
+    */
+   true_w = _al_get_least_multiple(true_w, block_width);
+   true_h = _al_get_least_multiple(true_h, block_height);
 
    bitmap = al_calloc(1, sizeof *bitmap);
    ASSERT(bitmap);
@@ -1150,6 +1526,19 @@ GLuint al_get_opengl_texture(ALLEGRO_BITMAP *bitmap)
    return extra->texture;
 }
 
+/* Function: al_get_opengl_depth_texture
+ */
+GLuint al_get_opengl_depth_texture(ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_BITMAP_EXTRA_OPENGL *extra;
+   if (bitmap->parent)
+      bitmap = bitmap->parent;
+   if (!(al_get_bitmap_flags(bitmap) & _ALLEGRO_INTERNAL_OPENGL))
+      return 0;
+   extra = bitmap->extra;
+   return extra->depth_texture;
+}
+
 /* Function: al_remove_opengl_fbo
  */
 void al_remove_opengl_fbo(ALLEGRO_BITMAP *bitmap)
@@ -1167,6 +1556,8 @@ void al_remove_opengl_fbo(ALLEGRO_BITMAP *bitmap)
    ASSERT(ogl_bitmap->fbo_info->fbo != 0);
 
    ALLEGRO_FBO_INFO *info = ogl_bitmap->fbo_info;
+   if (info->unresolved)
+      _al_ogl_resolve_fbo(_al_get_bitmap_display(bitmap), bitmap);
    _al_ogl_del_fbo(info);
 
    if (info->fbo_state == FBO_INFO_PERSISTENT) {
@@ -38,6 +38,9 @@ void _al_ogl_setup_gl(ALLEGRO_DISPLAY *d)
 {
    ALLEGRO_OGL_EXTRAS *ogl = d->ogl_extras;
 
+   /* The context may be new, or have been recreated. */
+   _al_ogl_init_state_cache(d);
+
    if (ogl->backbuffer) {
       ALLEGRO_BITMAP *target = al_get_target_bitmap();
       _al_ogl_resize_backbuffer(ogl->backbuffer, d->w, d->h);
@@ -69,6 +72,12 @@ void _al_ogl_set_target_bitmap(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitmap)
    if (bitmap->parent && bitmap->parent->locked)
       return;
 
+   /* FBOs are not shared between contexts. */
+   if (_al_get_current_upload_context()) {
+      ALLEGRO_WARN("Cannot draw to bitmaps with an upload context.\n");
+      return;
+   }
+
    _al_ogl_setup_fbo(display, bitmap);
    if (display->ogl_extras->opengl_target == target) {
       _al_ogl_setup_bitmap_clipping(bitmap);
@@ -106,6 +115,53 @@ void al_set_current_opengl_context(ALLEGRO_DISPLAY *display)
 }
 
 
+static void set_scissor_test(bool enable)
+{
+   ALLEGRO_OGL_STATE_CACHE *cache = _al_ogl_current_state_cache();
+
+   if (cache && (cache->known & _AL_OGL_STATE_SCISSOR) &&
+         cache->scissor_test == enable) {
+      return;
+   }
+
+   if (enable)
+      glEnable(GL_SCISSOR_TEST);
+   else
+      glDisable(GL_SCISSOR_TEST);
+
+   if (cache) {
+      /* The rectangle is not known yet if the test was never enabled. */
+      if (!(cache->known & _AL_OGL_STATE_SCISSOR))
+         cache->scissor[2] = -1;
+      cache->scissor_test = enable;
+      _al_ogl_remember_state(cache, _AL_OGL_STATE_SCISSOR);
+   }
+}
+
+
+#ifndef ALLEGRO_IPHONE
+static void set_scissor(int x, int y, int w, int h)
+{
+   ALLEGRO_OGL_STATE_CACHE *cache = _al_ogl_current_state_cache();
+
+   if (cache && (cache->known & _AL_OGL_STATE_SCISSOR) &&
+         cache->scissor[0] == x && cache->scissor[1] == y &&
+         cache->scissor[2] == w && cache->scissor[3] == h) {
+      return;
+   }
+
+   glScissor(x, y, w, h);
+
+   if (cache) {
+      cache->scissor[0] = x;
+      cache->scissor[1] = y;
+      cache->scissor[2] = w;
+      cache->scissor[3] = h;
+   }
+}
+#endif
+
+
 void _al_ogl_setup_bitmap_clipping(const ALLEGRO_BITMAP *bitmap)
 {
    int x_1, y_1, x_2, y_2, h;
@@ -142,16 +198,16 @@ void _al_ogl_setup_bitmap_clipping(const ALLEGRO_BITMAP *bitmap)
       }
    }
    if (!use_scissor) {
-      glDisable(GL_SCISSOR_TEST);
+      set_scissor_test(false);
    }
    else {
-      glEnable(GL_SCISSOR_TEST);
+      set_scissor_test(true);
        
       #ifdef ALLEGRO_IPHONE
       _al_iphone_clip(bitmap, x_1, y_1, x_2, y_2);
       #else
       /* OpenGL is upside down, so must adjust y_2 to the height. */
-      glScissor(x_1, h - y_2, x_2 - x_1, y_2 - y_1);
+      set_scissor(x_1, h - y_2, x_2 - x_1, y_2 - y_1);
       #endif
    }
 }
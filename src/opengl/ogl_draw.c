@@ -13,8 +13,11 @@
  *      By Elias Pschernig.
  */
 
+#include <string.h>
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_opengl.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_memdraw.h"
 #include "allegro5/internal/aintern_opengl.h"
@@ -27,6 +30,16 @@
 
 ALLEGRO_DEBUG_CHANNEL("opengl")
 
+/* The programmable pipeline draws the vertex cache from a vbo. WebGL has
+ * no client-side arrays, and Emscripten emulates them by copying the
+ * vertices into a temporary buffer for every draw call, so the vbo is used
+ * there even though it is a GLES port.
+ */
+#if (!defined(ALLEGRO_CFG_OPENGLES) && !defined(ALLEGRO_MACOSX)) || \
+   defined(__EMSCRIPTEN__)
+#define VERTEX_CACHE_VBO
+#endif
+
 /* FIXME: For some reason x86_64 Android crashes for me when calling
  * glBlendColor - so adding this hack to disable it.
  */
@@ -70,11 +83,23 @@ bool _al_opengl_set_blender(ALLEGRO_DISPLAY *ogl_disp)
       GL_FUNC_ADD, GL_FUNC_SUBTRACT, GL_FUNC_REVERSE_SUBTRACT
    };
 
-   (void)ogl_disp;
+   ALLEGRO_OGL_STATE_CACHE *cache = &ogl_disp->ogl_extras->state_cache;
 
    al_get_separate_bitmap_blender(&op, &src_color, &dst_color,
       &op_alpha, &src_alpha, &dst_alpha);
    const_color = al_get_bitmap_blend_color();
+
+   if ((cache->known & _AL_OGL_STATE_BLENDER) &&
+         cache->blender[0] == op &&
+         cache->blender[1] == src_color &&
+         cache->blender[2] == dst_color &&
+         cache->blender[3] == op_alpha &&
+         cache->blender[4] == src_alpha &&
+         cache->blender[5] == dst_alpha &&
+         memcmp(&cache->blend_color, &const_color, sizeof(const_color)) == 0) {
+      return true;
+   }
+
    /* glBlendFuncSeparate was only included with OpenGL 1.4 */
 #if !defined ALLEGRO_CFG_OPENGLES
    if (ogl_disp->ogl_extras->ogl_info.version >= _ALLEGRO_OPENGL_VERSION_1_4) {
@@ -115,6 +140,15 @@ bool _al_opengl_set_blender(ALLEGRO_DISPLAY *ogl_disp)
          return false;
       }
    }
+
+   cache->blender[0] = op;
+   cache->blender[1] = src_color;
+   cache->blender[2] = dst_color;
+   cache->blender[3] = op_alpha;
+   cache->blender[4] = src_alpha;
+   cache->blender[5] = dst_alpha;
+   cache->blend_color = const_color;
+   _al_ogl_remember_state(cache, _AL_OGL_STATE_BLENDER);
    return true;
 }
 
@@ -225,10 +259,26 @@ static void tex_ptr_off(ALLEGRO_DISPLAY *display)
    }
 }
 
+/* Returns true if clearing bitmap overwrites all of its parent's (or its
+ * own) pixels.
+ */
+static bool clears_whole_target(ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_BITMAP *target = bitmap->parent ? bitmap->parent : bitmap;
+   int xofs = bitmap->parent ? bitmap->xofs : 0;
+   int yofs = bitmap->parent ? bitmap->yofs : 0;
+
+   return xofs + bitmap->cl <= 0 && yofs + bitmap->ct <= 0 &&
+      xofs + bitmap->cr_excl >= target->w &&
+      yofs + bitmap->cb_excl >= target->h;
+}
+
+
 static void ogl_clear(ALLEGRO_DISPLAY *d, ALLEGRO_COLOR *color)
 {
    ALLEGRO_DISPLAY *ogl_disp = (void *)d;
-   ALLEGRO_BITMAP *target = al_get_target_bitmap();
+   ALLEGRO_BITMAP *bitmap = al_get_target_bitmap();
+   ALLEGRO_BITMAP *target = bitmap;
    ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_target;
    float r, g, b, a;
 
@@ -245,6 +295,12 @@ static void ogl_clear(ALLEGRO_DISPLAY *d, ALLEGRO_COLOR *color)
       return;
    }
 
+   /* The clear is scissored, so the driver might not notice that the old
+    * contents can be thrown away instead of loaded.
+    */
+   if (clears_whole_target(bitmap))
+      _al_ogl_discard_framebuffer(d, target, true, false);
+
    al_unmap_rgba_f(*color, &r, &g, &b, &a);
 
    glClearColor(r, g, b, a);
@@ -291,14 +347,169 @@ static void ogl_draw_pixel(ALLEGRO_DISPLAY *d, float x, float y,
    }
 
    glDrawArrays(GL_POINTS, 0, 1);
+   d->stats.draw_calls++;
+   d->stats.vertices++;
 
    vert_ptr_off(d);
    color_ptr_off(d);
 }
 
+/* Returns how many textures the current shader can sample from in a single
+ * draw call.
+ */
+static int max_batch_textures(ALLEGRO_DISPLAY *disp)
+{
+#ifdef ALLEGRO_CFG_OPENGL_PROGRAMMABLE_PIPELINE
+   ALLEGRO_OGL_VARLOCS *varlocs = &disp->ogl_extras->varlocs;
+   int n = 1;
+
+   if (!(disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) ||
+         varlocs->tex_index_loc < 0)
+      return 1;
+   while (n < _AL_MAX_BATCH_TEXTURES && varlocs->batch_tex_loc[n - 1] >= 0)
+      n++;
+   return n;
+#else
+   (void)disp;
+   return 1;
+#endif
+}
+
+/* Internal function: _al_ogl_batch_texture
+ *
+ * Makes the texture available to the vertices about to be added to the
+ * vertex cache, and returns the value to put into their tex_index. The cache
+ * is only flushed if the shader can't sample from any more textures.
+ */
+float _al_ogl_batch_texture(ALLEGRO_DISPLAY *disp, GLuint texture)
+{
+   ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+   int i;
+
+   if (disp->num_cache_vertices == 0)
+      o->num_batch_textures = 0;
+
+   for (i = 0; i < o->num_batch_textures; i++) {
+      if (o->batch_textures[i] == texture)
+         return i;
+   }
+
+   if (o->num_batch_textures >= max_batch_textures(disp)) {
+      disp->stats.texture_flushes++;
+      disp->vt->flush_vertex_cache(disp);
+      o->num_batch_textures = 0;
+   }
+
+   if (o->num_batch_textures == 0)
+      disp->cache_texture = texture;
+   o->batch_textures[o->num_batch_textures] = texture;
+   return o->num_batch_textures++;
+}
+
+/* Minimum size of the orphaned vbo used without GL_ARB_buffer_storage. */
+#define MIN_VBO_SIZE (64 * 1024)
+
+#if !defined(ALLEGRO_CFG_OPENGLES) && !defined(ALLEGRO_MACOSX)
+#define STREAM_SEGMENT_BYTES \
+   (_AL_OGL_STREAM_SEGMENT_VERTICES * sizeof(ALLEGRO_OGL_BITMAP_VERTEX))
+
+static bool init_stream_buffer(ALLEGRO_DISPLAY *disp)
+{
+   ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+   GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+      GL_MAP_COHERENT_BIT;
+   GLsizeiptr size = _AL_OGL_STREAM_SEGMENTS * STREAM_SEGMENT_BYTES;
+
+   if (o->stream_ptr)
+      return true;
+   if (o->stream_unsupported)
+      return false;
+
+   if (!(disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) ||
+         !o->extension_list->ALLEGRO_GL_ARB_buffer_storage ||
+         !o->extension_list->ALLEGRO_GL_ARB_sync ||
+         !o->extension_list->ALLEGRO_GL_ARB_map_buffer_range) {
+      o->stream_unsupported = true;
+      return false;
+   }
+
+   glGenBuffers(1, &o->stream_vbo);
+   glBindBuffer(GL_ARRAY_BUFFER, o->stream_vbo);
+   glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+   o->stream_ptr = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   if (!o->stream_ptr) {
+      ALLEGRO_WARN("Could not map the vertex cache stream buffer.\n");
+      glDeleteBuffers(1, &o->stream_vbo);
+      o->stream_vbo = 0;
+      o->stream_unsupported = true;
+      return false;
+   }
+
+   ALLEGRO_DEBUG("new stream VBO: %u\n", o->stream_vbo);
+   o->stream_segment = 0;
+   o->stream_first = 0;
+   memset(o->stream_fences, 0, sizeof(o->stream_fences));
+   return true;
+}
+
+/* Fences the current segment and waits until the GPU is done with the
+ * next one.
+ */
+static void next_stream_segment(ALLEGRO_OGL_EXTRAS *o)
+{
+   GLsync fence;
+
+   o->stream_fences[o->stream_segment] =
+      glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+   o->stream_segment = (o->stream_segment + 1) % _AL_OGL_STREAM_SEGMENTS;
+   o->stream_first = 0;
+
+   fence = o->stream_fences[o->stream_segment];
+   if (fence) {
+      GLbitfield wait_flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+      for (;;) {
+         GLenum r = glClientWaitSync(fence, wait_flags, 1000000000);
+         if (r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED)
+            break;
+         if (r == GL_WAIT_FAILED) {
+            ALLEGRO_WARN("glClientWaitSync failed.\n");
+            break;
+         }
+         wait_flags = 0;
+      }
+      glDeleteSync(fence);
+      o->stream_fences[o->stream_segment] = 0;
+   }
+}
+#endif
+
 static void* ogl_prepare_vertex_cache(ALLEGRO_DISPLAY* disp, 
                                       int num_new_vertices)
 {
+#if !defined(ALLEGRO_CFG_OPENGLES) && !defined(ALLEGRO_MACOSX)
+   ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+
+   /* Recorded vertices are copied out of the cache, which may be large. */
+   if (!_al_get_draw_recording(disp) && init_stream_buffer(disp)) {
+      ALLEGRO_OGL_BITMAP_VERTEX *segment;
+
+      ASSERT(num_new_vertices <= _AL_OGL_STREAM_SEGMENT_VERTICES);
+      if (o->stream_first + disp->num_cache_vertices + num_new_vertices >
+            _AL_OGL_STREAM_SEGMENT_VERTICES) {
+         disp->vt->flush_vertex_cache(disp);
+         next_stream_segment(o);
+      }
+
+      segment = (ALLEGRO_OGL_BITMAP_VERTEX *)o->stream_ptr +
+         o->stream_segment * _AL_OGL_STREAM_SEGMENT_VERTICES;
+      disp->num_cache_vertices += num_new_vertices;
+      return segment + o->stream_first +
+         (disp->num_cache_vertices - num_new_vertices);
+   }
+#endif
+
    disp->num_cache_vertices += num_new_vertices;
    if (!disp->vertex_cache) {
       disp->vertex_cache = al_malloc(num_new_vertices * sizeof(ALLEGRO_OGL_BITMAP_VERTEX));
@@ -314,22 +525,109 @@ static void* ogl_prepare_vertex_cache(ALLEGRO_DISPLAY* disp,
          (disp->num_cache_vertices - num_new_vertices);
 }
 
+/* The vertex cache of a draw list, see al_begin_draw_recording. */
+typedef struct RECORDED_VERTICES
+{
+   int num_vertices;
+   int num_textures;
+   GLuint textures[_AL_MAX_BATCH_TEXTURES];
+   ALLEGRO_OGL_BITMAP_VERTEX *vertices;    /* follow the struct */
+} RECORDED_VERTICES;
+
+/* Replayed vertices go through the cache in pieces it can always take. */
+#define REPLAY_VERTICES  (_AL_OGL_STREAM_SEGMENT_VERTICES / 6 * 6)
+
+static void replay_vertices(ALLEGRO_DISPLAY *disp, void *data)
+{
+   RECORDED_VERTICES *rec = data;
+   ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+   int done = 0;
+
+   while (done < rec->num_vertices) {
+      int n = _ALLEGRO_MIN(rec->num_vertices - done, REPLAY_VERTICES);
+      void *verts = disp->vt->prepare_vertex_cache(disp, n);
+
+      memcpy(verts, rec->vertices + done, n * sizeof(ALLEGRO_OGL_BITMAP_VERTEX));
+      memcpy(o->batch_textures, rec->textures,
+         rec->num_textures * sizeof(GLuint));
+      o->num_batch_textures = rec->num_textures;
+      disp->cache_texture = rec->textures[0];
+
+      disp->vt->flush_vertex_cache(disp);
+      done += n;
+   }
+}
+
+static void destroy_recorded_vertices(void *data)
+{
+   al_free(data);
+}
+
+/* Moves the vertices in the cache into the draw list being recorded,
+ * together with the textures they sample.
+ */
+static void record_vertex_cache(ALLEGRO_DISPLAY *disp, ALLEGRO_DRAW_LIST *list)
+{
+   ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+   int n = disp->num_cache_vertices;
+   RECORDED_VERTICES *rec;
+
+   disp->num_cache_vertices = 0;
+
+   rec = al_malloc(sizeof(*rec) + n * sizeof(ALLEGRO_OGL_BITMAP_VERTEX));
+   if (!rec) {
+      ALLEGRO_ERROR("Out of memory recording %d vertices.\n", n);
+      return;
+   }
+
+   rec->vertices = (ALLEGRO_OGL_BITMAP_VERTEX *)(rec + 1);
+   rec->num_vertices = n;
+   if (o->num_batch_textures > 0) {
+      rec->num_textures = o->num_batch_textures;
+      memcpy(rec->textures, o->batch_textures,
+         o->num_batch_textures * sizeof(GLuint));
+   }
+   else {
+      rec->num_textures = 1;
+      rec->textures[0] = disp->cache_texture;
+   }
+   memcpy(rec->vertices, disp->vertex_cache,
+      n * sizeof(ALLEGRO_OGL_BITMAP_VERTEX));
+
+   _al_draw_list_add(list, replay_vertices, destroy_recorded_vertices, rec);
+}
+
 static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
 {
    GLuint current_texture;
    ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+   ALLEGRO_DRAW_LIST *recording;
+   GLint first = 0;
    (void)o; /* not used in all ports */
    
+#if !defined(ALLEGRO_CFG_OPENGLES) && !defined(ALLEGRO_MACOSX)
+   if (!disp->vertex_cache && !o->stream_ptr)
+      return;
+#else
    if (!disp->vertex_cache)
       return;
+#endif
    if (disp->num_cache_vertices == 0)
       return;
 
+   recording = _al_get_draw_recording(disp);
+   if (recording) {
+      record_vertex_cache(disp, recording);
+      return;
+   }
+
    if (!_al_opengl_set_blender(disp)) {
       disp->num_cache_vertices = 0;
       return;
    }
 
+   al_profile_begin("ogl_flush_vertex_cache");
+
    if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
 #ifdef ALLEGRO_CFG_OPENGL_PROGRAMMABLE_PIPELINE
       if (disp->ogl_extras->varlocs.use_tex_loc >= 0) {
@@ -344,24 +642,43 @@ static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
       glEnable(GL_TEXTURE_2D);
    }
 
-   glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*)&current_texture);
-   if (current_texture != disp->cache_texture) {
-      if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
 #ifdef ALLEGRO_CFG_OPENGL_PROGRAMMABLE_PIPELINE
-         /* Use texture unit 0 */
-         glActiveTexture(GL_TEXTURE0);
-         if (disp->ogl_extras->varlocs.tex_loc >= 0)
-            glUniform1i(disp->ogl_extras->varlocs.tex_loc, 0);
+   if (o->num_batch_textures > 1) {
+      int i;
+
+      /* Go backwards so texture unit 0 ends up active. */
+      for (i = o->num_batch_textures - 1; i >= 0; i--) {
+         glActiveTexture(GL_TEXTURE0 + i);
+         glBindTexture(GL_TEXTURE_2D, o->batch_textures[i]);
+         if (i > 0)
+            glUniform1i(o->varlocs.batch_tex_loc[i - 1], i);
+      }
+      if (o->varlocs.tex_loc >= 0)
+         glUniform1i(o->varlocs.tex_loc, 0);
+   }
+   else
+#endif
+   {
+      glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*)&current_texture);
+      if (current_texture != disp->cache_texture) {
+         if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
+#ifdef ALLEGRO_CFG_OPENGL_PROGRAMMABLE_PIPELINE
+            /* Use texture unit 0 */
+            glActiveTexture(GL_TEXTURE0);
+            if (disp->ogl_extras->varlocs.tex_loc >= 0)
+               glUniform1i(disp->ogl_extras->varlocs.tex_loc, 0);
 #endif
+         }
+         glBindTexture(GL_TEXTURE_2D, disp->cache_texture);
       }
-      glBindTexture(GL_TEXTURE_2D, disp->cache_texture);
    }
 
-#if !defined(ALLEGRO_CFG_OPENGLES) && !defined(ALLEGRO_MACOSX)
+#ifdef VERTEX_CACHE_VBO
    if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
       int stride = sizeof(ALLEGRO_OGL_BITMAP_VERTEX);
       int bytes = disp->num_cache_vertices * stride;
 
+#if !defined(ALLEGRO_CFG_OPENGLES) && !defined(ALLEGRO_MACOSX)
       /* We create the VAO and VBO on first use. */
       if (o->vao == 0) {
          glGenVertexArrays(1, &o->vao);
@@ -369,14 +686,35 @@ static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
       }
       glBindVertexArray(o->vao);
 
-      if (o->vbo == 0) {
-         glGenBuffers(1, &o->vbo);
-         ALLEGRO_DEBUG("new VBO: %u\n", o->vbo);
+      if (o->stream_ptr) {
+         /* The vertices already are in the mapped buffer. */
+         glBindBuffer(GL_ARRAY_BUFFER, o->stream_vbo);
+         first = o->stream_segment * _AL_OGL_STREAM_SEGMENT_VERTICES +
+            o->stream_first;
+         o->stream_first += disp->num_cache_vertices;
       }
-      glBindBuffer(GL_ARRAY_BUFFER, o->vbo);
+      else
+#endif
+      {
+         if (o->vbo == 0) {
+            glGenBuffers(1, &o->vbo);
+            ALLEGRO_DEBUG("new VBO: %u\n", o->vbo);
+         }
+         glBindBuffer(GL_ARRAY_BUFFER, o->vbo);
 
-      /* Then we upload data into it. */
-      glBufferData(GL_ARRAY_BUFFER, bytes, disp->vertex_cache, GL_STREAM_DRAW);
+         /* Then we upload data into it, orphaning the old storage if it is
+          * full so we never wait for draws still using it.
+          */
+         if (o->vbo_offset + bytes > o->vbo_size) {
+            o->vbo_size = _ALLEGRO_MAX(bytes, MIN_VBO_SIZE);
+            o->vbo_offset = 0;
+            glBufferData(GL_ARRAY_BUFFER, o->vbo_size, NULL, GL_STREAM_DRAW);
+         }
+         glBufferSubData(GL_ARRAY_BUFFER, o->vbo_offset, bytes,
+            disp->vertex_cache);
+         first = o->vbo_offset / stride;
+         o->vbo_offset += bytes;
+      }
 
       /* Finally set the "pos", "texccord" and "color" attributes used by our
        * shader and enable them.
@@ -398,6 +736,12 @@ static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
             (void *)offsetof(ALLEGRO_OGL_BITMAP_VERTEX, r));
          glEnableVertexAttribArray(o->varlocs.color_loc);
       }
+
+      if (o->varlocs.tex_index_loc >= 0) {
+         glVertexAttribPointer(o->varlocs.tex_index_loc, 1, GL_FLOAT, false, stride,
+            (void *)offsetof(ALLEGRO_OGL_BITMAP_VERTEX, tex_index));
+         glEnableVertexAttribArray(o->varlocs.tex_index_loc);
+      }
    }
    else
 #endif
@@ -409,6 +753,16 @@ static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
       color_ptr_on(disp, 4, GL_FLOAT, sizeof(ALLEGRO_OGL_BITMAP_VERTEX),
          (char*)(disp->vertex_cache) + offsetof(ALLEGRO_OGL_BITMAP_VERTEX, r));
 
+#ifdef ALLEGRO_CFG_OPENGL_PROGRAMMABLE_PIPELINE
+      if ((disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) &&
+            o->varlocs.tex_index_loc >= 0) {
+         glVertexAttribPointer(o->varlocs.tex_index_loc, 1, GL_FLOAT, false,
+            sizeof(ALLEGRO_OGL_BITMAP_VERTEX),
+            (char*)(disp->vertex_cache) + offsetof(ALLEGRO_OGL_BITMAP_VERTEX, tex_index));
+         glEnableVertexAttribArray(o->varlocs.tex_index_loc);
+      }
+#endif
+
 #ifdef ALLEGRO_CFG_OPENGL_FIXED_FUNCTION
       if (!(disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE))
          glDisableClientState(GL_NORMAL_ARRAY);
@@ -416,7 +770,9 @@ static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
    }
 
    glGetError(); /* clear error */
-   glDrawArrays(GL_TRIANGLES, 0, disp->num_cache_vertices);
+   glDrawArrays(GL_TRIANGLES, first, disp->num_cache_vertices);
+   disp->stats.draw_calls++;
+   disp->stats.vertices += disp->num_cache_vertices;
 
 #ifdef DEBUGMODE
    {
@@ -427,7 +783,7 @@ static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
    }
 #endif
 
-#if !defined ALLEGRO_CFG_OPENGLES && !defined ALLEGRO_MACOSX
+#ifdef VERTEX_CACHE_VBO
    if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
       if (o->varlocs.pos_loc >= 0)
          glDisableVertexAttribArray(o->varlocs.pos_loc);
@@ -435,8 +791,12 @@ static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
          glDisableVertexAttribArray(o->varlocs.texcoord_loc);
       if (o->varlocs.color_loc >= 0)
          glDisableVertexAttribArray(o->varlocs.color_loc);
+      if (o->varlocs.tex_index_loc >= 0)
+         glDisableVertexAttribArray(o->varlocs.tex_index_loc);
       glBindBuffer(GL_ARRAY_BUFFER, 0);
+#if !defined ALLEGRO_CFG_OPENGLES && !defined ALLEGRO_MACOSX
       glBindVertexArray(0);
+#endif
    }
    else
 #endif
@@ -444,6 +804,11 @@ static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
       vert_ptr_off(disp);
       tex_ptr_off(disp);
       color_ptr_off(disp);
+#ifdef ALLEGRO_CFG_OPENGL_PROGRAMMABLE_PIPELINE
+      if ((disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) &&
+            o->varlocs.tex_index_loc >= 0)
+         glDisableVertexAttribArray(o->varlocs.tex_index_loc);
+#endif
    }
 
    disp->num_cache_vertices = 0;
@@ -457,6 +822,26 @@ static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
    else {
       glDisable(GL_TEXTURE_2D);
    }
+
+   al_profile_end();
+}
+
+static void set_viewport(ALLEGRO_DISPLAY *disp, int x, int y, int w, int h)
+{
+   ALLEGRO_OGL_STATE_CACHE *cache = &disp->ogl_extras->state_cache;
+
+   if ((cache->known & _AL_OGL_STATE_VIEWPORT) &&
+         cache->viewport[0] == x && cache->viewport[1] == y &&
+         cache->viewport[2] == w && cache->viewport[3] == h) {
+      return;
+   }
+
+   glViewport(x, y, w, h);
+   cache->viewport[0] = x;
+   cache->viewport[1] = y;
+   cache->viewport[2] = w;
+   cache->viewport[3] = h;
+   _al_ogl_remember_state(cache, _AL_OGL_STATE_VIEWPORT);
 }
 
 static void ogl_update_transformation(ALLEGRO_DISPLAY* disp,
@@ -465,13 +850,25 @@ static void ogl_update_transformation(ALLEGRO_DISPLAY* disp,
    if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
 #ifdef ALLEGRO_CFG_SHADER_GLSL
       GLint loc = disp->ogl_extras->varlocs.projview_matrix_loc;
+      GLuint program = disp->ogl_extras->program_object;
+      ALLEGRO_OGL_STATE_CACHE *cache = &disp->ogl_extras->state_cache;
       ALLEGRO_TRANSFORM projview;
       al_copy_transform(&projview, &target->transform);
       al_compose_transform(&projview, &target->proj_transform);
-      al_copy_transform(&disp->projview_transform, &projview);
 
-      if (disp->ogl_extras->program_object > 0 && loc >= 0) {
-         _al_glsl_set_projview_matrix(loc, &disp->projview_transform);
+      /* Switching between targets with the same transformations, e.g. many
+       * render targets of the same size, leaves the uniform as it is.
+       */
+      if (!(cache->known & _AL_OGL_STATE_PROJVIEW) ||
+            cache->projview_program != program ||
+            memcmp(&projview, &disp->projview_transform, sizeof projview) != 0) {
+         al_copy_transform(&disp->projview_transform, &projview);
+         _al_ogl_invalidate_state_cache(disp, _AL_OGL_STATE_PROJVIEW);
+         if (program > 0 && loc >= 0) {
+            _al_glsl_set_projview_matrix(loc, &disp->projview_transform);
+            cache->projview_program = program;
+            _al_ogl_remember_state(cache, _AL_OGL_STATE_PROJVIEW);
+         }
       }
 #endif
    } else {
@@ -486,9 +883,10 @@ static void ogl_update_transformation(ALLEGRO_DISPLAY* disp,
    if (target->parent) {
       ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_extra = target->parent->extra;
       /* glViewport requires the bottom-left coordinate of the corner. */
-      glViewport(target->xofs, ogl_extra->true_h - (target->yofs + target->h), target->w, target->h);
+      set_viewport(disp, target->xofs,
+         ogl_extra->true_h - (target->yofs + target->h), target->w, target->h);
    } else {
-      glViewport(0, 0, target->w, target->h);
+      set_viewport(disp, 0, 0, target->w, target->h);
    }
 }
 
@@ -508,6 +906,110 @@ static void ogl_clear_depth_buffer(ALLEGRO_DISPLAY *display, float x)
    glClear(GL_DEPTH_BUFFER_BIT);
 }
 
+/* GL_TIME_ELAPSED queries are issued around each frame and read back a few
+ * frames later, once they are available, so we never wait for the GPU.
+ */
+static void ogl_update_gpu_timer(ALLEGRO_DISPLAY *disp)
+{
+#if !defined ALLEGRO_CFG_OPENGLES
+   ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+   int n = _AL_OGL_GPU_TIMERS;
+
+   if (!o->extension_list->ALLEGRO_GL_ARB_timer_query)
+      return;
+
+   if (o->gpu_timers[0] == 0)
+      glGenQueries(n, o->gpu_timers);
+
+   if (o->gpu_timer_running) {
+      glEndQuery(GL_TIME_ELAPSED);
+      o->gpu_timer_running = false;
+      o->gpu_timers_pending++;
+   }
+
+   while (o->gpu_timers_pending > 0) {
+      GLuint query = o->gpu_timers[(o->gpu_timer_next - o->gpu_timers_pending
+         + n) % n];
+      GLint available = 0;
+      GLuint64 elapsed;
+
+      glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available)
+         break;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+      disp->stats.gpu_frame_time = elapsed / 1e9;
+      o->gpu_timers_pending--;
+   }
+
+   /* If the GPU is that far behind, skip timing this frame. */
+   if (o->gpu_timers_pending < n) {
+      glBeginQuery(GL_TIME_ELAPSED, o->gpu_timers[o->gpu_timer_next]);
+      o->gpu_timer_next = (o->gpu_timer_next + 1) % n;
+      o->gpu_timer_running = true;
+   }
+#else
+   (void)disp;
+#endif
+}
+
+/* Frame fences need ARB_sync and, like the upload fences in ogl_upload.c,
+ * are left out on OS X.
+ */
+static bool ogl_wait_for_frame_latency(ALLEGRO_DISPLAY *disp, int frames)
+{
+#if !defined(ALLEGRO_CFG_OPENGLES) && !defined(ALLEGRO_MACOSX)
+   ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+   int n = _AL_MAX_FRAME_LATENCY;
+
+   if (!o->extension_list->ALLEGRO_GL_ARB_sync)
+      return false;
+
+   while (o->frame_fences_pending > frames) {
+      GLsync fence = o->frame_fences[(o->frame_fence_next -
+         o->frame_fences_pending + n) % n];
+      GLenum r = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+         1000000000);
+
+      if (r == GL_TIMEOUT_EXPIRED)
+         continue;
+      if (r == GL_WAIT_FAILED)
+         ALLEGRO_WARN("glClientWaitSync failed.\n");
+      glDeleteSync(fence);
+      o->frame_fences_pending--;
+   }
+   return true;
+#else
+   (void)disp;
+   (void)frames;
+   return false;
+#endif
+}
+
+
+static void ogl_insert_frame_fence(ALLEGRO_DISPLAY *disp)
+{
+#if !defined(ALLEGRO_CFG_OPENGLES) && !defined(ALLEGRO_MACOSX)
+   ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+   int n = _AL_MAX_FRAME_LATENCY;
+   GLsync fence;
+
+   if (!o->extension_list->ALLEGRO_GL_ARB_sync)
+      return;
+
+   if (o->frame_fences_pending == n)
+      ogl_wait_for_frame_latency(disp, n - 1);
+
+   fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+   if (!fence)
+      return;
+   o->frame_fences[o->frame_fence_next] = fence;
+   o->frame_fence_next = (o->frame_fence_next + 1) % n;
+   o->frame_fences_pending++;
+#else
+   (void)disp;
+#endif
+}
+
 /* Add drawing commands to the vtable. */
 void _al_ogl_add_drawing_functions(ALLEGRO_DISPLAY_INTERFACE *vt)
 {
@@ -518,6 +1020,9 @@ void _al_ogl_add_drawing_functions(ALLEGRO_DISPLAY_INTERFACE *vt)
    vt->flush_vertex_cache = ogl_flush_vertex_cache;
    vt->prepare_vertex_cache = ogl_prepare_vertex_cache;
    vt->update_transformation = ogl_update_transformation;
+   vt->update_gpu_timer = ogl_update_gpu_timer;
+   vt->insert_frame_fence = ogl_insert_frame_fence;
+   vt->wait_for_frame_latency = ogl_wait_for_frame_latency;
 }
 
 /* vim: set sts=3 sw=3 et: */
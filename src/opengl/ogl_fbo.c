@@ -13,7 +13,7 @@
  *      See LICENSE.txt for copyright information.
  */
 
-#include <float.h>
+#include <string.h>
 
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_opengl.h"
@@ -39,6 +39,14 @@ static void use_fbo_for_bitmap(ALLEGRO_DISPLAY *display,
    ALLEGRO_BITMAP *bitmap, ALLEGRO_FBO_INFO *info);
 
 
+static void count_target_switch(void)
+{
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+   if (display)
+      display->stats.target_switches++;
+}
+
+
 /* glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT..) not supported on some Androids.
  * We keep track of it manually.
  */
@@ -73,6 +81,8 @@ GLint _al_ogl_bind_framebuffer(GLint fbo)
          _al_gl_error_string(e));
    }
    _al_android_set_curr_fbo(fbo);
+   if (old_fbo != fbo)
+      count_target_switch();
    return old_fbo;
 }
 
@@ -80,15 +90,45 @@ GLint _al_ogl_bind_framebuffer(GLint fbo)
 
 GLint _al_ogl_bind_framebuffer(GLint fbo)
 {
+#ifdef ALLEGRO_IPHONE
+   /* EAGLView binds its own framebuffer behind our back. */
+   ALLEGRO_OGL_STATE_CACHE *cache = NULL;
+#else
+   ALLEGRO_OGL_STATE_CACHE *cache = _al_ogl_current_state_cache();
+#endif
    GLint old_fbo;
-   glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &old_fbo);
+
+   if (cache && (cache->known & _AL_OGL_STATE_FRAMEBUFFER)) {
+      old_fbo = cache->framebuffer;
+      if (old_fbo == fbo)
+         return old_fbo;
+   }
+   else {
+      glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &old_fbo);
+   }
+
    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+   if (old_fbo != fbo)
+      count_target_switch();
+
+   if (cache) {
+      cache->framebuffer = fbo;
+      _al_ogl_remember_state(cache, _AL_OGL_STATE_FRAMEBUFFER);
+   }
    return old_fbo;
 }
 
 #endif /* !ALLEGRO_ANDROID */
 
 
+static void forget_framebuffer(GLuint fbo)
+{
+   ALLEGRO_OGL_STATE_CACHE *cache = _al_ogl_current_state_cache();
+   if (cache && (GLuint)cache->framebuffer == fbo)
+      cache->framebuffer = 0;
+}
+
+
 void _al_ogl_reset_fbo_info(ALLEGRO_FBO_INFO *info)
 {
    info->fbo_state = FBO_INFO_UNUSED;
@@ -99,8 +139,12 @@ void _al_ogl_reset_fbo_info(ALLEGRO_FBO_INFO *info)
    info->buffers.dh = 0;
    info->buffers.mw = 0;
    info->buffers.mh = 0;
+   info->buffers.depth_texture = 0;
    info->owner = NULL;
-   info->last_use_time = 0.0;
+   info->attached_texture = 0;
+   info->attached_depth_buffer = 0;
+   info->last_use = 0;
+   info->unresolved = false;
 }
 
 
@@ -116,38 +160,368 @@ static void check_gl_error(void)
 #endif
 
 
-static void detach_depth_buffer(ALLEGRO_FBO_INFO *info)
+/* How the contents of a framebuffer are discarded, found out on first use.
+ * On tiled GPUs this saves loading them into tile memory before drawing,
+ * and storing them back afterwards.
+ */
+enum {
+   DISCARD_UNKNOWN = 0,
+   DISCARD_NONE,
+   DISCARD_INVALIDATE,     /* glInvalidateFramebuffer, GL 4.3 / GLES 3.0 */
+   DISCARD_EXT             /* glDiscardFramebufferEXT */
+};
+
+#ifndef GL_COLOR
+#define GL_COLOR     0x1800
+#define GL_DEPTH     0x1801
+#define GL_STENCIL   0x1802
+#endif
+
+ALLEGRO_DEFINE_PROC_TYPE(void, DISCARD_FRAMEBUFFER_PROC,
+   (GLenum target, GLsizei num_attachments, const GLenum *attachments));
+
+static DISCARD_FRAMEBUFFER_PROC discard_framebuffer_ext;
+
+
+static int get_discard_method(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_OGL_EXTRAS *o = display->ogl_extras;
+   const char *value;
+
+   if (o->discard_method != DISCARD_UNKNOWN)
+      return o->discard_method;
+
+   o->discard_method = DISCARD_NONE;
+#if defined ALLEGRO_CFG_OPENGLES
+#ifdef ALLEGRO_CFG_OPENGLES3
+   if (o->ogl_info.version >= _ALLEGRO_OPENGL_VERSION_3_0)
+      o->discard_method = DISCARD_INVALIDATE;
+   else
+#endif
+   if (al_have_opengl_extension("GL_EXT_discard_framebuffer")) {
+      discard_framebuffer_ext = (DISCARD_FRAMEBUFFER_PROC)
+         al_get_opengl_proc_address("glDiscardFramebufferEXT");
+      if (discard_framebuffer_ext)
+         o->discard_method = DISCARD_EXT;
+   }
+#else
+   if (o->ogl_info.version >= _ALLEGRO_OPENGL_VERSION_4_3 ||
+         al_have_opengl_extension("GL_ARB_invalidate_subdata")) {
+      o->discard_method = DISCARD_INVALIDATE;
+   }
+#endif
+
+   /* Depth buffers are rarely needed once drawing has moved on to another
+    * bitmap, so by default we let tiled GPUs skip storing them.
+    */
+   value = al_get_config_value(al_get_system_config(), "opengl",
+      "discard_depth_on_switch");
+   if (value)
+      o->discard_depth_on_switch = _al_stricmp(value, "true") == 0;
+   else
+      o->discard_depth_on_switch = IS_OPENGLES;
+
+   ALLEGRO_DEBUG("Framebuffer discard method: %d\n", o->discard_method);
+   return o->discard_method;
+}
+
+
+/* Tells the driver that the color and/or depth contents of target, whose
+ * framebuffer must be bound, are no longer needed.
+ */
+void _al_ogl_discard_framebuffer(ALLEGRO_DISPLAY *display,
+   ALLEGRO_BITMAP *target, bool color, bool depth)
+{
+   ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_target = target->extra;
+   GLenum attachments[3];
+   int n = 0;
+   int method = get_discard_method(display);
+
+   if (method == DISCARD_NONE)
+      return;
+
+   if (ogl_target->is_backbuffer) {
+      if (color)
+         attachments[n++] = GL_COLOR;
+      if (depth) {
+         attachments[n++] = GL_DEPTH;
+         attachments[n++] = GL_STENCIL;
+      }
+   }
+   else {
+      ALLEGRO_FBO_INFO *info = ogl_target->fbo_info;
+      if (!info || display->ogl_extras->opengl_target != target)
+         return;
+      if (color)
+         attachments[n++] = GL_COLOR_ATTACHMENT0_EXT;
+      if (depth && info->buffers.depth_buffer)
+         attachments[n++] = GL_DEPTH_ATTACHMENT_EXT;
+   }
+
+   if (n == 0)
+      return;
+
+#if !defined ALLEGRO_CFG_OPENGLES || defined ALLEGRO_CFG_OPENGLES3
+   if (method == DISCARD_INVALIDATE)
+      glInvalidateFramebuffer(GL_FRAMEBUFFER_EXT, n, attachments);
+#endif
+   if (method == DISCARD_EXT)
+      discard_framebuffer_ext(GL_FRAMEBUFFER_EXT, n, attachments);
+}
+
+
+/* Consumes a discard requested with al_discard_bitmap_contents while the
+ * bitmap was not the target.
+ */
+static void discard_pending_contents(ALLEGRO_DISPLAY *display,
+   ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap = bitmap->extra;
+
+   if (ogl_bitmap->discard_pending) {
+      ogl_bitmap->discard_pending = false;
+      _al_ogl_discard_framebuffer(display, bitmap, true, true);
+   }
+}
+
+
+#ifdef ALLEGRO_CFG_OPENGLES
+/* renders_to_multisampled_texture:
+ *  Whether GL_EXT_multisampled_render_to_texture is used to draw into the
+ *  multisampled bitmap instead of a multisample buffer.
+ */
+static bool renders_to_multisampled_texture(ALLEGRO_DISPLAY *display,
+   ALLEGRO_BITMAP *bitmap)
+{
+   return al_get_bitmap_samples(bitmap) > 0 &&
+      display->ogl_extras->multisampled_render_to_texture;
+}
+#endif
+
+
+#ifndef ALLEGRO_RASPBERRYPI
+/* get_renderbuffer:
+ *  Returns a renderbuffer with the given storage, or 0 on failure. One
+ *  which no FBO uses is reused if there is one. If shared is true, the
+ *  renderbuffer may also be attached to other FBOs which asked for a shared
+ *  one, and its contents are not kept when drawing into them.
+ */
+static GLuint get_renderbuffer(ALLEGRO_DISPLAY *display, int w, int h,
+   int samples, GLenum format, bool shared)
+{
+   ALLEGRO_OGL_EXTRAS *extras = display->ogl_extras;
+   ALLEGRO_OGL_RENDERBUFFER *rb;
+   GLuint buffer;
+   GLint e;
+   int i;
+
+   for (i = 0; i < extras->num_renderbuffers; i++) {
+      rb = &extras->renderbuffers[i];
+      if (rb->w != w || rb->h != h || rb->samples != samples ||
+            rb->format != format)
+         continue;
+      if (rb->refs == 0 || (shared && rb->shared)) {
+         rb->refs++;
+         rb->shared = shared;
+         ALLEGRO_DEBUG("Reusing render buffer: %u\n", rb->buffer);
+         return rb->buffer;
+      }
+   }
+
+   glGenRenderbuffersEXT(1, &buffer);
+   glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, buffer);
+#if !defined ALLEGRO_CFG_OPENGLES || defined ALLEGRO_CFG_OPENGLES3
+   check_gl_error();
+   if (samples > 0)
+      glRenderbufferStorageMultisampleEXT(GL_RENDERBUFFER_EXT,
+         samples, format, w, h);
+   else
+#endif
+      glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, format, w, h);
+   e = glGetError();
+   glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, 0);
+   if (e) {
+      ALLEGRO_ERROR("glRenderbufferStorage failed! samples=%d w=%d h=%d (%s)\n",
+         samples, w, h, _al_gl_error_string(e));
+      glDeleteRenderbuffersEXT(1, &buffer);
+      return 0;
+   }
+   ALLEGRO_DEBUG("Render buffer created: %u\n", buffer);
+
+   /* Untracked renderbuffers are deleted when they are given up. */
+   if (extras->num_renderbuffers < _AL_OGL_MAX_RENDERBUFFERS) {
+      rb = &extras->renderbuffers[extras->num_renderbuffers++];
+      rb->buffer = buffer;
+      rb->w = w;
+      rb->h = h;
+      rb->samples = samples;
+      rb->format = format;
+      rb->refs = 1;
+      rb->shared = shared;
+   }
+   return buffer;
+}
+
+
+/* put_renderbuffer:
+ *  Gives up a renderbuffer returned by get_renderbuffer. Up to
+ *  _AL_OGL_IDLE_RENDERBUFFERS which no FBO uses are kept for reuse; the one
+ *  given up first is deleted first.
+ */
+static void put_renderbuffer(ALLEGRO_DISPLAY *display, GLuint buffer)
+{
+   ALLEGRO_OGL_EXTRAS *extras = display->ogl_extras;
+   ALLEGRO_OGL_RENDERBUFFER rb;
+   int i, idle, oldest;
+
+   for (i = 0; i < extras->num_renderbuffers; i++) {
+      if (extras->renderbuffers[i].buffer == buffer)
+         break;
+   }
+   if (i == extras->num_renderbuffers) {
+      ALLEGRO_DEBUG("Deleting render buffer: %u\n", buffer);
+      glDeleteRenderbuffersEXT(1, &buffer);
+      return;
+   }
+   if (--extras->renderbuffers[i].refs > 0)
+      return;
+
+   /* Idle renderbuffers are kept in the order they were given up. */
+   rb = extras->renderbuffers[i];
+   memmove(&extras->renderbuffers[i], &extras->renderbuffers[i + 1],
+      (extras->num_renderbuffers - i - 1) * sizeof(rb));
+   extras->renderbuffers[extras->num_renderbuffers - 1] = rb;
+
+   idle = 0;
+   oldest = -1;
+   for (i = 0; i < extras->num_renderbuffers; i++) {
+      if (extras->renderbuffers[i].refs == 0) {
+         if (oldest < 0)
+            oldest = i;
+         idle++;
+      }
+   }
+   if (idle > _AL_OGL_IDLE_RENDERBUFFERS) {
+      ALLEGRO_DEBUG("Deleting render buffer: %u\n",
+         extras->renderbuffers[oldest].buffer);
+      glDeleteRenderbuffersEXT(1, &extras->renderbuffers[oldest].buffer);
+      extras->num_renderbuffers--;
+      memmove(&extras->renderbuffers[oldest],
+         &extras->renderbuffers[oldest + 1],
+         (extras->num_renderbuffers - oldest) * sizeof(rb));
+   }
+}
+
+
+/* shares_depth_buffers:
+ *  Depth buffers are shared by FBOs of the same size if they are discarded
+ *  when switching targets anyway.
+ */
+static bool shares_depth_buffers(ALLEGRO_DISPLAY *display)
+{
+   get_discard_method(display);
+   return display->ogl_extras->discard_depth_on_switch;
+}
+
+
+/* uses_depth_texture:
+ *  Whether the depth of the bitmap goes into a texture of its own.
+ */
+static bool uses_depth_texture(ALLEGRO_BITMAP *bitmap)
+{
+#if !defined ALLEGRO_CFG_OPENGLES || defined ALLEGRO_CFG_OPENGLES3
+   return (al_get_bitmap_flags(bitmap) & ALLEGRO_DEPTH_TEXTURE) &&
+      al_get_bitmap_depth(bitmap) > 0 &&
+      al_get_bitmap_samples(bitmap) == 0;
+#else
+   (void)bitmap;
+   return false;
+#endif
+}
+#endif
+
+
+static void detach_depth_buffer(ALLEGRO_DISPLAY *display,
+   ALLEGRO_FBO_INFO *info)
 {
 #ifndef ALLEGRO_RASPBERRYPI
    if (info->buffers.depth_buffer == 0)
       return;
-   ALLEGRO_DEBUG("Deleting depth render buffer: %u\n",
-            info->buffers.depth_buffer);
-   glDeleteRenderbuffersEXT(1, &info->buffers.depth_buffer);
+   put_renderbuffer(display, info->buffers.depth_buffer);
    info->buffers.depth_buffer = 0;
-    info->buffers.dw = 0;
+   info->buffers.dw = 0;
    info->buffers.dh = 0;
    info->buffers.depth = 0;
+   info->buffers.dsamples = 0;
+#else
+   (void)display;
+   (void)info;
 #endif
 }
 
 
-static void detach_multisample_buffer(ALLEGRO_FBO_INFO *info)
+static void detach_multisample_buffer(ALLEGRO_DISPLAY *display,
+   ALLEGRO_FBO_INFO *info)
 {
-#ifndef ALLEGRO_RASPBERRYPI
+#ifndef ALLEGRO_CFG_OPENGLES
    if (info->buffers.multisample_buffer == 0)
       return;
-   ALLEGRO_DEBUG("Deleting multisample render buffer: %u\n",
-            info->buffers.depth_buffer);
-   glDeleteRenderbuffersEXT(1, &info->buffers.multisample_buffer);
+   put_renderbuffer(display, info->buffers.multisample_buffer);
    info->buffers.multisample_buffer = 0;
    info->buffers.mw = 0;
    info->buffers.mh = 0;
    info->buffers.samples = 0;
+   info->buffers.mformat = 0;
+#else
+   (void)display;
+   (void)info;
 #endif
 }
 
 
+#if !defined ALLEGRO_CFG_OPENGLES || defined ALLEGRO_CFG_OPENGLES3
+/* attach_depth_texture:
+ *  Attach the depth texture of the owner, creating it the first time.
+ */
+static void attach_depth_texture(ALLEGRO_FBO_INFO *info, GLenum gldepth)
+{
+   ALLEGRO_BITMAP_EXTRA_OPENGL *extra = info->owner->extra;
+   GLint e;
+
+   if (!extra->depth_texture) {
+      glGenTextures(1, &extra->depth_texture);
+      glBindTexture(GL_TEXTURE_2D, extra->depth_texture);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexImage2D(GL_TEXTURE_2D, 0, gldepth, extra->true_w, extra->true_h,
+         0, GL_DEPTH_COMPONENT, gldepth == GL_DEPTH_COMPONENT16 ?
+         GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, NULL);
+      e = glGetError();
+      if (e) {
+         ALLEGRO_ERROR("glTexImage2D failed for depth texture! w=%d h=%d (%s)\n",
+            extra->true_w, extra->true_h, _al_gl_error_string(e));
+         glDeleteTextures(1, &extra->depth_texture);
+         extra->depth_texture = 0;
+         return;
+      }
+      ALLEGRO_DEBUG("Depth texture created: %u\n", extra->depth_texture);
+   }
+
+   if (info->buffers.depth_texture == extra->depth_texture)
+      return;
+
+   glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+      GL_TEXTURE_2D, extra->depth_texture, 0);
+   if (glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) != GL_FRAMEBUFFER_COMPLETE_EXT) {
+      ALLEGRO_ERROR("attaching depth texture failed\n");
+   }
+   info->buffers.depth_texture = extra->depth_texture;
+}
+#endif
+
+
 
 static void attach_depth_buffer(ALLEGRO_FBO_INFO *info)
 {
@@ -156,131 +530,119 @@ static void attach_depth_buffer(ALLEGRO_FBO_INFO *info)
    GLenum gldepth = GL_DEPTH_COMPONENT16;
 
    ALLEGRO_BITMAP *b = info->owner;
+   ALLEGRO_DISPLAY *display = _al_get_bitmap_display(b);
    int bits = al_get_bitmap_depth(b);
-
-   if (info->buffers.depth_buffer != 0) {
-
-      if (info->buffers.depth != bits ||
-            info->buffers.dw != al_get_bitmap_width(b) ||
-            info->buffers.dh != al_get_bitmap_height(b)) {
-         detach_depth_buffer(info);
-      }
-   }
-   
-   if (!bits)
-      return;
-
-   if (info->buffers.depth_buffer == 0) {
-      ALLEGRO_DISPLAY *display = _al_get_bitmap_display(info->owner);
-      int w = al_get_bitmap_width(info->owner);
-      int h = al_get_bitmap_height(info->owner);
+   int samples = al_get_bitmap_samples(b);
+   int w = al_get_bitmap_width(b);
+   int h = al_get_bitmap_height(b);
+   bool depth_texture = uses_depth_texture(b);
 
 #if !defined ALLEGRO_CFG_OPENGLES || defined ALLEGRO_CFG_OPENGLES3
-      if (bits == 24) gldepth = GL_DEPTH_COMPONENT24;
+   if (bits == 24) gldepth = GL_DEPTH_COMPONENT24;
 #endif
-   
-      glGenRenderbuffersEXT(1, &rb);
-      glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, rb);
-
-      int samples = al_get_bitmap_samples(info->owner);
 
+   if (samples > 0) {
       bool extension_supported;
 #ifdef ALLEGRO_CFG_OPENGLES
-      (void)display;
-      extension_supported = al_have_opengl_extension("EXT_multisampled_render_to_texture");
+      extension_supported = renders_to_multisampled_texture(display, b);
 #else
       extension_supported = display->ogl_extras->extension_list->ALLEGRO_GL_EXT_framebuffer_multisample;
 #endif
+      if (!extension_supported)
+         samples = 0;
+   }
 
-      if (samples == 0 || !extension_supported)
-         glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, gldepth, w, h);
-#if !defined ALLEGRO_CFG_OPENGLES || defined ALLEGRO_CFG_OPENGLES3
-      else
-         glRenderbufferStorageMultisampleEXT(GL_RENDERBUFFER_EXT,
-            samples, gldepth, w, h);
-#else
-      else {
-         return;
+   if (info->buffers.depth_buffer != 0) {
+
+      if (depth_texture ||
+            info->buffers.depth != bits ||
+            info->buffers.dsamples != samples ||
+            info->buffers.dw != w ||
+            info->buffers.dh != h) {
+         detach_depth_buffer(display, info);
+         glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT,
+            GL_DEPTH_ATTACHMENT_EXT, GL_RENDERBUFFER_EXT, 0);
       }
+   }
+
+   if (info->buffers.depth_texture != 0 && !depth_texture) {
+      glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+         GL_TEXTURE_2D, 0, 0);
+      info->buffers.depth_texture = 0;
+   }
+
+#if !defined ALLEGRO_CFG_OPENGLES || defined ALLEGRO_CFG_OPENGLES3
+   if (depth_texture) {
+      attach_depth_texture(info, gldepth);
+      return;
+   }
 #endif
 
+   if (!bits)
+      return;
+
+   if (info->buffers.depth_buffer == 0) {
+      rb = get_renderbuffer(display, w, h, samples, gldepth,
+         shares_depth_buffers(display));
+      if (!rb)
+         return;
+
       info->buffers.depth_buffer = rb;
       info->buffers.dw = w;
       info->buffers.dh = h;
       info->buffers.depth = bits;
-      GLint e = glGetError();
-      if (e) {
-         ALLEGRO_ERROR("glRenderbufferStorage failed! bits=%d w=%d h=%d (%s)\n",
-            bits, w, h, _al_gl_error_string(e));
-      }
-      else {
-         ALLEGRO_DEBUG("Depth render buffer created: %u\n",
-            info->buffers.depth_buffer);
-      }
+      info->buffers.dsamples = samples;
    
       glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
           GL_RENDERBUFFER_EXT, rb);
       if (glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) != GL_FRAMEBUFFER_COMPLETE_EXT) {
          ALLEGRO_ERROR("attaching depth renderbuffer failed\n");
       }
-
-      glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, 0);
    }
+#else
+   (void)info;
 #endif
 }
 
 
 static void attach_multisample_buffer(ALLEGRO_FBO_INFO *info)
 {
-#if !defined ALLEGRO_CFG_OPENGLES || defined ALLEGRO_CFG_OPENGLES3
+#ifndef ALLEGRO_CFG_OPENGLES
    ALLEGRO_BITMAP *b = info->owner;
+   ALLEGRO_DISPLAY *display = _al_get_bitmap_display(b);
    int samples = al_get_bitmap_samples(b);
+   int w = al_get_bitmap_width(b);
+   int h = al_get_bitmap_height(b);
+   GLenum format = _al_ogl_get_glformat(al_get_bitmap_format(b), 0);
 
    if (info->buffers.multisample_buffer != 0) {
 
       if (info->buffers.samples != samples ||
-            info->buffers.mw != al_get_bitmap_width(b) ||
-            info->buffers.mh != al_get_bitmap_height(b)) {
-         detach_multisample_buffer(info);
+            info->buffers.mw != w ||
+            info->buffers.mh != h ||
+            info->buffers.mformat != format) {
+         detach_multisample_buffer(display, info);
       }
    }
    
    if (!samples)
       return;
-   ALLEGRO_DISPLAY *display = _al_get_bitmap_display(info->owner);
    if (!display->ogl_extras->extension_list->ALLEGRO_GL_EXT_framebuffer_multisample)
       return;
 
-#ifdef ALLEGRO_CFG_OPENGLES
-   (void)display;
-#else
-
    if (info->buffers.multisample_buffer == 0) {
-      GLuint rb;
-      GLint e;
-      int w = al_get_bitmap_width(info->owner);
-      int h = al_get_bitmap_height(info->owner);
-
-      glGenRenderbuffersEXT(1, &rb);
-      glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, rb);
-      check_gl_error();
+      /* Multisample buffers hold samples until they are resolved, so they
+       * are never shared.
+       */
+      GLuint rb = get_renderbuffer(display, w, h, samples, format, false);
+      if (!rb)
+         return;
 
-      glRenderbufferStorageMultisampleEXT(GL_RENDERBUFFER_EXT,
-         samples, _al_ogl_get_glformat(
-            al_get_bitmap_format(info->owner), 0), w, h);
       info->buffers.multisample_buffer = rb;
       info->buffers.mw = w;
       info->buffers.mh = h;
       info->buffers.samples = samples;
-      e = glGetError();
-      if (e) {
-         ALLEGRO_ERROR("glRenderbufferStorage failed! samples=%d w=%d h=%d (%s)\n",
-            samples, w, h, _al_gl_error_string(e));
-      }
-      else {
-         ALLEGRO_DEBUG("Multisample render buffer created: %u\n",
-            info->buffers.multisample_buffer);
-      }
+      info->buffers.mformat = format;
 
       glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT,
          GL_COLOR_ATTACHMENT0_EXT, GL_RENDERBUFFER_EXT, rb);
@@ -288,10 +650,7 @@ static void attach_multisample_buffer(ALLEGRO_FBO_INFO *info)
       if (glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) != GL_FRAMEBUFFER_COMPLETE_EXT) {
          ALLEGRO_ERROR("attaching multisample renderbuffer failed\n");
       }
-
-      glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, 0);
    }
-   #endif
 #else
    (void)info;
 #endif
@@ -321,6 +680,7 @@ bool _al_ogl_create_persistent_fbo(ALLEGRO_BITMAP *bitmap)
    ASSERT(!ogl_bitmap->fbo_info);
 
    info = al_malloc(sizeof(ALLEGRO_FBO_INFO));
+   _al_ogl_reset_fbo_info(info);
    info->owner = bitmap;
    if (ANDROID_PROGRAMMABLE_PIPELINE(al_get_current_display())) {
       glGenFramebuffers(1, &info->fbo);
@@ -368,7 +728,7 @@ bool _al_ogl_create_persistent_fbo(ALLEGRO_BITMAP *bitmap)
    _al_ogl_bind_framebuffer(old_fbo);
 
    info->fbo_state = FBO_INFO_PERSISTENT;
-   info->last_use_time = al_get_time();
+   info->last_use = 0;
    ogl_bitmap->fbo_info = info;
    ALLEGRO_DEBUG("Persistent FBO: %u\n", info->fbo);
    return true;
@@ -382,7 +742,7 @@ ALLEGRO_FBO_INFO *_al_ogl_persist_fbo(ALLEGRO_DISPLAY *display,
    int i;
    ASSERT(transient_fbo_info->fbo_state == FBO_INFO_TRANSIENT);
 
-   for (i = 0; i < ALLEGRO_MAX_OPENGL_FBOS; i++) {
+   for (i = 0; i < extras->num_fbos; i++) {
       if (transient_fbo_info == &extras->fbos[i]) {
          ALLEGRO_FBO_INFO *new_info = al_malloc(sizeof(ALLEGRO_FBO_INFO));
          *new_info = *transient_fbo_info;
@@ -398,23 +758,44 @@ ALLEGRO_FBO_INFO *_al_ogl_persist_fbo(ALLEGRO_DISPLAY *display,
 }
 
 
+static int get_fbo_pool_size(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "opengl",
+      "fbo_pool_size");
+   int size = value ? atoi(value) : _AL_OGL_DEFAULT_FBO_POOL_SIZE;
+
+   if (size < 1 || size > ALLEGRO_MAX_OPENGL_FBOS) {
+      ALLEGRO_WARN("fbo_pool_size must be between 1 and %d, got %s.\n",
+         ALLEGRO_MAX_OPENGL_FBOS, value);
+      size = _ALLEGRO_CLAMP(1, size, ALLEGRO_MAX_OPENGL_FBOS);
+   }
+   return size;
+}
+
+
+/* Returns an unused pool entry if there is one, otherwise the least
+ * recently used transient one.
+ */
 static ALLEGRO_FBO_INFO *ogl_find_unused_fbo(ALLEGRO_DISPLAY *display)
 {
    ALLEGRO_OGL_EXTRAS *extras = display->ogl_extras;
-   double min_time = DBL_MAX;
-   int min_time_index = -1;
+   ALLEGRO_FBO_INFO *lru = NULL;
    int i;
 
-   for (i = 0; i < ALLEGRO_MAX_OPENGL_FBOS; i++) {
-      if (extras->fbos[i].fbo_state == FBO_INFO_UNUSED)
-         return &extras->fbos[i];
-      if (extras->fbos[i].last_use_time < min_time) {
-         min_time = extras->fbos[i].last_use_time;
-         min_time_index = i;
-      }
+   if (extras->num_fbos == 0) {
+      extras->num_fbos = get_fbo_pool_size();
+      ALLEGRO_DEBUG("FBO pool size: %d\n", extras->num_fbos);
+   }
+
+   for (i = 0; i < extras->num_fbos; i++) {
+      ALLEGRO_FBO_INFO *info = &extras->fbos[i];
+      if (info->fbo_state == FBO_INFO_UNUSED)
+         return info;
+      if (!lru || info->last_use < lru->last_use)
+         lru = info;
    }
 
-   return &extras->fbos[min_time_index];
+   return lru;
 }
 
 
@@ -429,9 +810,12 @@ void _al_ogl_del_fbo(ALLEGRO_FBO_INFO *info)
    else {
       glDeleteFramebuffersEXT(1, &info->fbo);
    }
+   /* Deleting the bound FBO reverts to the default framebuffer. */
+   forget_framebuffer(info->fbo);
 
-   detach_depth_buffer(info);
-   detach_multisample_buffer(info);
+   detach_depth_buffer(_al_get_bitmap_display(info->owner), info);
+   detach_multisample_buffer(_al_get_bitmap_display(info->owner), info);
+   info->buffers.depth_texture = 0;
 
    info->fbo = 0;
 }
@@ -446,13 +830,21 @@ static ALLEGRO_FBO_INFO *ogl_new_fbo(ALLEGRO_DISPLAY *display)
    ASSERT(info->fbo_state != FBO_INFO_PERSISTENT);
 
    if (info->fbo_state == FBO_INFO_TRANSIENT) {
-      _al_ogl_del_fbo(info);
-      _al_ogl_reset_fbo_info(info);
-   }
-   else {
-      /* FBO_INFO_UNUSED */
+      /* Take the FBO away from its previous owner but keep the GL object
+       * and its renderbuffers; use_fbo_for_bitmap re-attaches the new
+       * texture, and the renderbuffers are only re-created if the size,
+       * depth or sample count differ.
+       */
+      ALLEGRO_BITMAP_EXTRA_OPENGL *extra = info->owner->extra;
+      if (info->unresolved)
+         _al_ogl_resolve_fbo(display, info->owner);
+      extra->fbo_info = NULL;
+      info->owner = NULL;
+      ALLEGRO_DEBUG("Reusing FBO: %u\n", info->fbo);
+      return info;
    }
 
+   /* FBO_INFO_UNUSED */
    if (ANDROID_PROGRAMMABLE_PIPELINE(al_get_current_display())) {
       glGenFramebuffers(1, &info->fbo);
    }
@@ -474,6 +866,7 @@ static ALLEGRO_FBO_INFO *ogl_new_fbo(ALLEGRO_DISPLAY *display)
 void _al_ogl_setup_fbo(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitmap)
 {
    ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap;
+   ALLEGRO_BITMAP *old_target = display->ogl_extras->opengl_target;
 
    if (bitmap->parent)
       bitmap = bitmap->parent;
@@ -486,7 +879,14 @@ void _al_ogl_setup_fbo(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitmap)
    if (false && display->ogl_extras->opengl_target == bitmap)
       return;
 
-   _al_ogl_unset_target_bitmap(display, display->ogl_extras->opengl_target);
+   if (old_target && old_target != bitmap &&
+         !((ALLEGRO_BITMAP_EXTRA_OPENGL *)old_target->extra)->is_backbuffer &&
+         get_discard_method(display) != DISCARD_NONE &&
+         display->ogl_extras->discard_depth_on_switch) {
+      _al_ogl_discard_framebuffer(display, old_target, false, true);
+   }
+
+   _al_ogl_unset_target_bitmap(display, old_target);
 
    if (ogl_bitmap->is_backbuffer)
       setup_fbo_backbuffer(display, bitmap);
@@ -500,44 +900,111 @@ void _al_ogl_setup_fbo(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitmap)
  * framebuffer_blit extension. [1]
  *
  * This is what we do in this function - if there is a multisample
- * buffer, downsample it back into the texture.
+ * buffer, downsample it back into the texture. Bitmaps created with
+ * ALLEGRO_MANUAL_RESOLVE are left alone until al_resolve_bitmap.
  *
  * [1] https://www.opengl.org/registry/specs/EXT/framebuffer_multisample.txt 
  */
 void _al_ogl_finalize_fbo(ALLEGRO_DISPLAY *display,
    ALLEGRO_BITMAP *bitmap)
+{
+   if (al_get_bitmap_flags(bitmap) & ALLEGRO_MANUAL_RESOLVE)
+      return;
+   _al_ogl_resolve_fbo(display, bitmap);
+}
+
+
+/* _al_ogl_resolve_fbo:
+ *  Downsample the multisample buffer of the bitmap into its texture if it
+ *  has samples the texture lacks. The bitmap stays the target if it is.
+ */
+bool _al_ogl_resolve_fbo(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitmap)
 {
    ALLEGRO_BITMAP_EXTRA_OPENGL *extra = bitmap->extra;
+   ALLEGRO_FBO_INFO *info;
    if (!extra)
-      return;
-   ALLEGRO_FBO_INFO *info = extra->fbo_info;
-   (void)display;
-   if (!info)
-      return;
-   if (!info->buffers.multisample_buffer)
-      return;
+      return true;
+   info = extra->fbo_info;
+   if (!info || !info->buffers.multisample_buffer || !info->unresolved)
+      return true;
    #ifndef ALLEGRO_CFG_OPENGLES
    int w = al_get_bitmap_width(bitmap);
    int h = al_get_bitmap_height(bitmap);
+   bool is_target = (display->ogl_extras->opengl_target == bitmap);
+   GLint e;
+
+   if (is_target && display->num_cache_vertices > 0)
+      display->vt->flush_vertex_cache(display);
 
-   GLuint blit_fbo;
-   glGenFramebuffersEXT(1, &blit_fbo);
-   glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, blit_fbo);
+   /* The FBO the texture is attached to is kept for the next resolve. */
+   if (!display->ogl_extras->resolve_fbo) {
+      glGenFramebuffersEXT(1, &display->ogl_extras->resolve_fbo);
+      ALLEGRO_DEBUG("Created resolve FBO: %u\n",
+         display->ogl_extras->resolve_fbo);
+   }
+   glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, display->ogl_extras->resolve_fbo);
    glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT,
       GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, extra->texture, 0);
 
    glBindFramebufferEXT(GL_READ_FRAMEBUFFER_EXT, info->fbo);
-   glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, blit_fbo);
+   glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT,
+      display->ogl_extras->resolve_fbo);
    glBlitFramebufferEXT(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-   check_gl_error();
+   e = glGetError();
+   if (e) {
+      ALLEGRO_ERROR("glBlitFramebufferEXT failed! w=%d h=%d (%s)\n",
+         w, h, _al_gl_error_string(e));
+   }
+
+   /* The read and draw bindings now differ. */
+   _al_ogl_invalidate_state_cache(NULL, _AL_OGL_STATE_FRAMEBUFFER);
+   if (is_target)
+      _al_ogl_bind_framebuffer(info->fbo);
 
-   glDeleteFramebuffersEXT(1, &blit_fbo);
+   info->unresolved = false;
+   return e == 0;
    #else
-   (void)bitmap;
+   (void)display;
+   return true;
    #endif
 }
 
 
+/* Drawing into sRGB targets blends in linear space and encodes the result.
+ * Desktop OpenGL only does that with GL_FRAMEBUFFER_SRGB enabled, and
+ * would also encode into the backbuffer if it happens to be sRGB capable.
+ * OpenGL ES always encodes into sRGB targets.
+ */
+static void set_framebuffer_srgb(ALLEGRO_DISPLAY *display, bool srgb)
+{
+#ifndef ALLEGRO_CFG_OPENGLES
+   ALLEGRO_OGL_EXT_LIST *ext = display->ogl_extras->extension_list;
+   ALLEGRO_OGL_STATE_CACHE *cache = _al_ogl_current_state_cache();
+
+   if (!ext->ALLEGRO_GL_ARB_framebuffer_sRGB &&
+         !ext->ALLEGRO_GL_EXT_framebuffer_sRGB)
+      return;
+
+   if (cache && (cache->known & _AL_OGL_STATE_FRAMEBUFFER_SRGB) &&
+         cache->framebuffer_srgb == srgb)
+      return;
+
+   if (srgb)
+      glEnable(GL_FRAMEBUFFER_SRGB_EXT);
+   else
+      glDisable(GL_FRAMEBUFFER_SRGB_EXT);
+
+   if (cache) {
+      cache->framebuffer_srgb = srgb;
+      _al_ogl_remember_state(cache, _AL_OGL_STATE_FRAMEBUFFER_SRGB);
+   }
+#else
+   (void)display;
+   (void)srgb;
+#endif
+}
+
+
 static void setup_fbo_backbuffer(ALLEGRO_DISPLAY *display,
    ALLEGRO_BITMAP *bitmap)
 {
@@ -551,9 +1018,14 @@ static void setup_fbo_backbuffer(ALLEGRO_DISPLAY *display,
       _al_ogl_bind_framebuffer(0);
    }
 
+   set_framebuffer_srgb(display,
+      display->extra_settings.settings[ALLEGRO_SRGB_FRAMEBUFFER] != 0);
+
 #ifdef ALLEGRO_IPHONE
    _al_iphone_setup_opengl_view(display, false);
 #endif
+
+   discard_pending_contents(display, bitmap);
 }
 
 
@@ -594,20 +1066,42 @@ static void use_fbo_for_bitmap(ALLEGRO_DISPLAY *display,
    ALLEGRO_BITMAP *bitmap, ALLEGRO_FBO_INFO *info)
 {
    ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap = bitmap->extra;
+   bool reentry;
    GLint e;
 
+   /* Switching back to a target whose FBO still has its texture attached
+    * needs no re-attaching and no completeness check, which is most of the
+    * cost of a target switch.
+    */
+   reentry = (info->owner == bitmap &&
+      info->attached_texture == ogl_bitmap->texture &&
+      info->attached_texture != 0);
+
    if (info->fbo_state == FBO_INFO_UNUSED)
       info->fbo_state = FBO_INFO_TRANSIENT;
    info->owner = bitmap;
-   info->last_use_time = al_get_time();
+   info->last_use = ++display->ogl_extras->fbo_use_count;
    ogl_bitmap->fbo_info = info;
 
    /* Bind to the FBO. */
    _al_ogl_bind_framebuffer(info->fbo);
+   set_framebuffer_srgb(display,
+      _al_pixel_format_is_srgb(al_get_bitmap_format(bitmap)));
 
    attach_multisample_buffer(info);
    attach_depth_buffer(info);
 
+   if (info->buffers.multisample_buffer)
+      info->unresolved = true;
+
+   if (reentry && !info->buffers.multisample_buffer &&
+         info->attached_depth_buffer == info->buffers.depth_buffer) {
+      display->ogl_extras->opengl_target = bitmap;
+      discard_pending_contents(display, bitmap);
+      return;
+   }
+   info->attached_texture = 0;
+
    /* If we have a multisample renderbuffer, we can only syncronize
     * it back to the texture once we stop drawing into it - i.e.
     * when the target bitmap is changed to something else.
@@ -615,20 +1109,21 @@ static void use_fbo_for_bitmap(ALLEGRO_DISPLAY *display,
    if (!info->buffers.multisample_buffer) {
 
       /* Attach the texture. */
+#if defined ALLEGRO_CFG_OPENGLES3 && !defined ALLEGRO_IPHONE
+      /* The samples live in tile memory and are resolved as the tiles are
+       * written back, so no multisample buffer is needed.
+       */
+      if (renders_to_multisampled_texture(display, bitmap)) {
+         glFramebufferTexture2DMultisampleEXT(GL_FRAMEBUFFER,
+            GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ogl_bitmap->texture,
+            0, al_get_bitmap_samples(bitmap));
+      }
+      else
+#endif
 #ifdef ALLEGRO_CFG_OPENGLES
       if (ANDROID_PROGRAMMABLE_PIPELINE(al_get_current_display())) {
-         if (al_get_bitmap_samples(bitmap) == 0 || !al_have_opengl_extension("EXT_multisampled_render_to_texture")) {
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-               GL_TEXTURE_2D, ogl_bitmap->texture, 0);
-         }
-#if ((!defined ALLEGRO_CFG_OPENGLES || defined ALLEGRO_CFG_OPENGLES3) && !defined ALLEGRO_IPHONE)
-         else {
-            glFramebufferTexture2DMultisampleEXT(GL_FRAMEBUFFER,
-               GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ogl_bitmap->texture, 
-               0, al_get_bitmap_samples(bitmap));
-      
-         }
-#endif
+         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, ogl_bitmap->texture, 0);
       }
       else
 #endif
@@ -661,7 +1156,12 @@ static void use_fbo_for_bitmap(ALLEGRO_DISPLAY *display,
       ogl_bitmap->fbo_info = NULL;
    }
    else {
+      if (!info->buffers.multisample_buffer) {
+         info->attached_texture = ogl_bitmap->texture;
+         info->attached_depth_buffer = info->buffers.depth_buffer;
+      }
       display->ogl_extras->opengl_target = bitmap;
+      discard_pending_contents(display, bitmap);
    }
 }
 
@@ -91,6 +91,26 @@
    #define glDeleteRenderbuffersEXT     glDeleteRenderbuffersOES
 #endif
 
+/* Texture formats which OpenGL ES headers older than 3.0 (or without the
+ * ASTC extension) do not define.
+ */
+#if defined ALLEGRO_CFG_OPENGLES
+   #ifndef GL_COMPRESSED_RGB8_ETC2
+   #define GL_COMPRESSED_RGB8_ETC2         0x9274
+   #endif
+   #ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+   #define GL_COMPRESSED_RGBA8_ETC2_EAC    0x9278
+   #endif
+   #ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+   #define GL_COMPRESSED_RGBA_ASTC_4x4_KHR 0x93B0
+   #define GL_COMPRESSED_RGBA_ASTC_6x6_KHR 0x93B4
+   #define GL_COMPRESSED_RGBA_ASTC_8x8_KHR 0x93B7
+   #endif
+   #ifndef GL_SRGB8_ALPHA8
+   #define GL_SRGB8_ALPHA8                 0x8C43
+   #endif
+#endif
+
 #endif
 
 /* vim: set sts=3 sw=3 et: */
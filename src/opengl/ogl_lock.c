@@ -32,6 +32,15 @@ ALLEGRO_DEBUG_CHANNEL("opengl")
 
 #define get_glformat(f, c) _al_ogl_get_glformat((f), (c))
 
+/* Smaller WRITEONLY locks are not worth a pixel unpack buffer. */
+#define MIN_PBO_LOCK_PIXELS (64 * 64)
+
+/* Bounds on the size of each upload ring segment.  Bigger locks get a
+ * pixel unpack buffer of their own.
+ */
+#define MIN_UPLOAD_SEGMENT_BYTES (1024 * 1024)
+#define MAX_UPLOAD_SEGMENT_BYTES (16 * 1024 * 1024)
+
 
 /*
  * Helpers - duplicates code in ogl_bitmap.c for now
@@ -68,6 +77,158 @@ static bool exactly_15bpp(int pixel_format)
       || pixel_format == ALLEGRO_PIXEL_FORMAT_BGR_555;
 }
 
+/* Undoes _al_ogl_setup_fbo_non_backbuffer on a bitmap which is not the
+ * target bitmap.
+ */
+static void restore_target_fbo(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_BITMAP *old_target)
+{
+   if (!old_target) {
+      /* Old target was NULL; release the context. */
+      _al_set_current_display_only(NULL);
+   }
+   else if (!_al_get_bitmap_display(old_target)) {
+      /* Old target was memory bitmap; leave the current display alone. */
+   }
+   else if (old_target != bitmap) {
+      /* Old target was another OpenGL bitmap. */
+      _al_ogl_setup_fbo(_al_get_bitmap_display(old_target), old_target);
+   }
+}
+
+
+/*
+ * Upload ring
+ */
+
+#if !defined(ALLEGRO_MACOSX)
+
+static void wait_upload_fence(ALLEGRO_OGL_EXTRAS *o, int segment)
+{
+   GLsync fence = o->upload_fences[segment];
+   GLbitfield wait_flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+
+   if (!fence)
+      return;
+
+   for (;;) {
+      GLenum r = glClientWaitSync(fence, wait_flags, 1000000000);
+      if (r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED)
+         break;
+      if (r == GL_WAIT_FAILED) {
+         ALLEGRO_WARN("glClientWaitSync failed.\n");
+         break;
+      }
+      wait_flags = 0;
+   }
+   glDeleteSync(fence);
+   o->upload_fences[segment] = 0;
+}
+
+
+/* Makes sure the upload ring exists with segments of at least size bytes. */
+static bool init_upload_ring(ALLEGRO_DISPLAY *disp, int size)
+{
+   ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+   ALLEGRO_OGL_EXT_LIST *ext = o->extension_list;
+   GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+      GL_MAP_COHERENT_BIT;
+   int segment_size;
+   int i;
+
+   if (o->upload_ptr && size <= o->upload_segment_size)
+      return true;
+   if (o->upload_unsupported || size > MAX_UPLOAD_SEGMENT_BYTES)
+      return false;
+
+   if (!ext->ALLEGRO_GL_ARB_buffer_storage ||
+         !ext->ALLEGRO_GL_ARB_sync ||
+         !ext->ALLEGRO_GL_ARB_map_buffer_range) {
+      o->upload_unsupported = true;
+      return false;
+   }
+
+   if (o->upload_ptr) {
+      /* Too small; replace it once no lock is using it. */
+      for (i = 0; i < _AL_OGL_UPLOAD_SEGMENTS; i++) {
+         if (o->upload_busy[i])
+            return false;
+      }
+      for (i = 0; i < _AL_OGL_UPLOAD_SEGMENTS; i++)
+         wait_upload_fence(o, i);
+      glDeleteBuffers(1, &o->upload_pbo);
+      o->upload_pbo = 0;
+      o->upload_ptr = NULL;
+   }
+
+   segment_size = _ALLEGRO_MAX(size, MIN_UPLOAD_SEGMENT_BYTES);
+   segment_size = (segment_size + 0xffff) & ~0xffff;
+
+   glGenBuffers(1, &o->upload_pbo);
+   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, o->upload_pbo);
+   glBufferStorage(GL_PIXEL_UNPACK_BUFFER,
+      _AL_OGL_UPLOAD_SEGMENTS * segment_size, NULL, flags);
+   o->upload_ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+      _AL_OGL_UPLOAD_SEGMENTS * segment_size, flags);
+   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+   if (!o->upload_ptr) {
+      ALLEGRO_WARN("Could not map the upload ring (%s).\n",
+         _al_gl_error_string(glGetError()));
+      glDeleteBuffers(1, &o->upload_pbo);
+      o->upload_pbo = 0;
+      o->upload_unsupported = true;
+      return false;
+   }
+
+   ALLEGRO_DEBUG("new upload ring: %u, %d byte segments\n", o->upload_pbo,
+      segment_size);
+   o->upload_segment_size = segment_size;
+   o->upload_segment = 0;
+   memset(o->upload_fences, 0, sizeof(o->upload_fences));
+   memset(o->upload_busy, 0, sizeof(o->upload_busy));
+   return true;
+}
+
+
+/* Hands out the next segment of the upload ring, waiting for the GPU to
+ * finish reading it if necessary.  Returns -1 if there is no ring or the
+ * segment still belongs to another lock.
+ */
+static int acquire_upload_segment(ALLEGRO_DISPLAY *disp, int size)
+{
+   ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+   int segment;
+
+   /* The ring belongs to the display's own context. */
+   if (_al_get_current_upload_context())
+      return -1;
+
+   if (!init_upload_ring(disp, size))
+      return -1;
+
+   segment = o->upload_segment;
+   if (o->upload_busy[segment])
+      return -1;
+
+   wait_upload_fence(o, segment);
+   o->upload_busy[segment] = true;
+   o->upload_segment = (segment + 1) % _AL_OGL_UPLOAD_SEGMENTS;
+   return segment;
+}
+
+
+/* Call after queueing the upload from the segment. */
+static void release_upload_segment(ALLEGRO_DISPLAY *disp, int segment)
+{
+   ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+
+   o->upload_fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+   o->upload_busy[segment] = false;
+}
+
+#endif
+
 
 
 /*
@@ -80,6 +241,9 @@ static bool ogl_lock_region_backbuffer(
 static bool ogl_lock_region_nonbb_writeonly(
    ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap,
    int x, int gl_y, int w, int h, int format);
+static bool ogl_lock_region_nonbb_pbo(
+   ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap,
+   int w, int h, int format);
 static bool ogl_lock_region_nonbb_readwrite(
    ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap,
    int x, int gl_y, int w, int h, int format, bool* restore_fbo);
@@ -177,17 +341,7 @@ ALLEGRO_LOCKED_REGION *_al_ogl_lock_region_new(ALLEGRO_BITMAP *bitmap,
 
    /* Restore state after switching FBO. */
    if (restore_fbo) {
-      if (!old_target) {
-         /* Old target was NULL; release the context. */
-         _al_set_current_display_only(NULL);
-      }
-      else if (!_al_get_bitmap_display(old_target)) {
-         /* Old target was memory bitmap; leave the current display alone. */
-      }
-      else if (old_target != bitmap) {
-         /* Old target was another OpenGL bitmap. */
-         _al_ogl_setup_fbo(_al_get_bitmap_display(old_target), old_target);
-      }
+      restore_target_fbo(bitmap, old_target);
    }
 
    ASSERT(al_get_target_bitmap() == old_target);
@@ -251,6 +405,11 @@ static bool ogl_lock_region_nonbb_writeonly(
    (void) x;
    (void) gl_y;
 
+   if (ogl_lock_region_nonbb_pbo(bitmap, ogl_bitmap, w, h, format)) {
+      ALLEGRO_DEBUG("Locked into a pixel unpack buffer\n");
+      return true;
+   }
+
    ogl_bitmap->lock_buffer = al_malloc(pitch * h);
    if (ogl_bitmap->lock_buffer == NULL) {
       return false;
@@ -264,6 +423,75 @@ static bool ogl_lock_region_nonbb_writeonly(
 }
 
 
+/* Maps a pixel unpack buffer for the locked region, so the caller writes
+ * directly into memory the driver can upload from, without a copy of its own.
+ * This is only done if the unlock would not convert the pixels anyway.
+ * A segment of the persistently mapped upload ring is preferred, as that
+ * never waits on the driver; otherwise a buffer is created for this lock.
+ */
+static bool ogl_lock_region_nonbb_pbo(
+   ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap,
+   int w, int h, int format)
+{
+#if !defined(ALLEGRO_MACOSX)
+   ALLEGRO_DISPLAY *disp = _al_get_bitmap_display(bitmap);
+   ALLEGRO_OGL_EXT_LIST *ext = disp->ogl_extras->extension_list;
+   const int pitch = ogl_pitch(w, al_get_pixel_size(format));
+   unsigned char *ptr;
+   int segment;
+
+   if (w * h < MIN_PBO_LOCK_PIXELS) {
+      return false;
+   }
+   if (format != _al_get_real_pixel_format(disp,
+         _al_get_bitmap_memory_format(bitmap))) {
+      return false;
+   }
+
+   segment = acquire_upload_segment(disp, pitch * h);
+   if (segment >= 0) {
+      ptr = disp->ogl_extras->upload_ptr +
+         segment * disp->ogl_extras->upload_segment_size;
+      ogl_bitmap->lock_segment = segment + 1;
+   }
+   else {
+      if (!ext->ALLEGRO_GL_ARB_pixel_buffer_object ||
+            !ext->ALLEGRO_GL_ARB_map_buffer_range) {
+         return false;
+      }
+
+      glGenBuffers(1, &ogl_bitmap->lock_pbo);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ogl_bitmap->lock_pbo);
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, pitch * h, NULL, GL_STREAM_DRAW);
+      ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, pitch * h,
+         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+      if (!ptr) {
+         ALLEGRO_WARN("Could not map a pixel unpack buffer (%s).\n",
+            _al_gl_error_string(glGetError()));
+         glDeleteBuffers(1, &ogl_bitmap->lock_pbo);
+         ogl_bitmap->lock_pbo = 0;
+         return false;
+      }
+   }
+
+   bitmap->locked_region.data = ptr + pitch * (h - 1);
+   bitmap->locked_region.format = format;
+   bitmap->locked_region.pitch = -pitch;
+   bitmap->locked_region.pixel_size = al_get_pixel_size(format);
+   return true;
+#else
+   (void)bitmap;
+   (void)ogl_bitmap;
+   (void)w;
+   (void)h;
+   (void)format;
+   return false;
+#endif
+}
+
+
 static bool ogl_lock_region_nonbb_readwrite(
    ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap,
    int x, int gl_y, int w, int h, int format, bool* restore_fbo)
@@ -402,6 +630,269 @@ static bool ogl_lock_region_nonbb_readwrite_nonfbo(
 
 
 
+/*
+ * Asynchronous readback
+ */
+
+#if !defined(ALLEGRO_MACOSX)
+
+typedef struct OGL_READBACK
+{
+   GLuint pbo;
+   GLsync fence;
+   int pitch;
+} OGL_READBACK;
+
+
+/* Makes the display's context current if needed.  Returns the display to
+ * switch back to afterwards, or NULL.
+ */
+static ALLEGRO_DISPLAY *use_readback_display(ALLEGRO_DISPLAY *disp)
+{
+   ALLEGRO_DISPLAY *old_disp = al_get_current_display();
+
+   if (!old_disp ||
+         (disp->ogl_extras->is_shared == false && disp != old_disp)) {
+      _al_set_current_display_only(disp);
+      return old_disp;
+   }
+   return NULL;
+}
+
+
+static bool ogl_readback_is_ready(ALLEGRO_BITMAP_READBACK *rb)
+{
+   OGL_READBACK *data = rb->extra;
+   ALLEGRO_DISPLAY *old_disp;
+   GLenum r;
+
+   if (!data->fence)
+      return true;
+
+   old_disp = use_readback_display(rb->display);
+   r = glClientWaitSync(data->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+   if (old_disp)
+      _al_set_current_display_only(old_disp);
+
+   return r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED
+      || r == GL_WAIT_FAILED;
+}
+
+
+static bool ogl_readback_map(ALLEGRO_BITMAP_READBACK *rb)
+{
+   OGL_READBACK *data = rb->extra;
+   ALLEGRO_DISPLAY *old_disp = use_readback_display(rb->display);
+   unsigned char *ptr;
+
+   if (data->fence) {
+      GLbitfield wait_flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+      for (;;) {
+         GLenum r = glClientWaitSync(data->fence, wait_flags, 1000000000);
+         if (r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED)
+            break;
+         if (r == GL_WAIT_FAILED) {
+            ALLEGRO_WARN("glClientWaitSync failed.\n");
+            break;
+         }
+         wait_flags = 0;
+      }
+      glDeleteSync(data->fence);
+      data->fence = 0;
+   }
+
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, data->pbo);
+   ptr = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, data->pitch * rb->h,
+      GL_MAP_READ_BIT);
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+   if (old_disp)
+      _al_set_current_display_only(old_disp);
+
+   if (!ptr) {
+      ALLEGRO_ERROR("Could not map a pixel pack buffer (%s).\n",
+         _al_gl_error_string(glGetError()));
+      return false;
+   }
+
+   rb->native.data = ptr + data->pitch * (rb->h - 1);
+   rb->native.pitch = -data->pitch;
+   return true;
+}
+
+
+static void ogl_readback_unmap(ALLEGRO_BITMAP_READBACK *rb)
+{
+   OGL_READBACK *data = rb->extra;
+   ALLEGRO_DISPLAY *old_disp = use_readback_display(rb->display);
+
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, data->pbo);
+   glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+   if (old_disp)
+      _al_set_current_display_only(old_disp);
+}
+
+
+static void ogl_readback_destroy(ALLEGRO_BITMAP_READBACK *rb)
+{
+   OGL_READBACK *data = rb->extra;
+   ALLEGRO_DISPLAY *old_disp = use_readback_display(rb->display);
+
+   if (data->fence)
+      glDeleteSync(data->fence);
+   glDeleteBuffers(1, &data->pbo);
+
+   if (old_disp)
+      _al_set_current_display_only(old_disp);
+
+   al_free(data);
+   rb->extra = NULL;
+}
+
+
+static const _AL_READBACK_INTERFACE ogl_readback_vt =
+{
+   ogl_readback_is_ready,
+   ogl_readback_map,
+   ogl_readback_unmap,
+   ogl_readback_destroy
+};
+
+
+/* Reads the region of the given framebuffer into a new pixel pack buffer and
+ * fences it.  glReadPixels returns at once since the destination is a buffer
+ * object; the copy happens whenever the GPU gets to it.
+ */
+static bool ogl_readback_into_pbo(ALLEGRO_BITMAP_READBACK *rb, GLuint fbo,
+   int x, int gl_y, int format)
+{
+   OGL_READBACK *data;
+   GLint old_fbo;
+   GLenum e;
+
+   data = al_calloc(1, sizeof(*data));
+   if (!data)
+      return false;
+   data->pitch = ogl_pitch(rb->w, al_get_pixel_size(format));
+
+   glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &old_fbo);
+   glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+
+   glGenBuffers(1, &data->pbo);
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, data->pbo);
+   glBufferData(GL_PIXEL_PACK_BUFFER, data->pitch * rb->h, NULL,
+      GL_STREAM_READ);
+   glReadPixels(x, gl_y, rb->w, rb->h,
+      get_glformat(format, 2),
+      get_glformat(format, 1),
+      NULL);
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+   glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, old_fbo);
+
+   e = glGetError();
+   if (e) {
+      ALLEGRO_ERROR("glReadPixels into a pixel pack buffer for format %s "
+         "failed (%s).\n", _al_pixel_format_name(format),
+         _al_gl_error_string(e));
+      glDeleteBuffers(1, &data->pbo);
+      al_free(data);
+      return false;
+   }
+
+   data->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+   /* Submit the commands, so the fence signals without a later flush. */
+   glFlush();
+
+   rb->vt = &ogl_readback_vt;
+   rb->extra = data;
+   rb->native.format = format;
+   rb->native.pixel_size = al_get_pixel_size(format);
+   return true;
+}
+
+#endif
+
+
+bool _al_ogl_start_readback(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_BITMAP_READBACK *rb, int x, int y, int w, int h)
+{
+#if !defined(ALLEGRO_MACOSX)
+   ALLEGRO_BITMAP_EXTRA_OPENGL * const ogl_bitmap = bitmap->extra;
+   ALLEGRO_DISPLAY *bitmap_disp = _al_get_bitmap_display(bitmap);
+   ALLEGRO_OGL_EXT_LIST *ext = bitmap_disp->ogl_extras->extension_list;
+   const GLint gl_y = bitmap->h - y - h;
+   ALLEGRO_DISPLAY *old_disp;
+   ALLEGRO_BITMAP *old_target = al_get_target_bitmap();
+   int format = rb->format;
+   int previous_alignment;
+   int pixel_alignment;
+   bool restore_fbo = false;
+   bool ok;
+   (void)w;
+
+   if (!ext->ALLEGRO_GL_ARB_pixel_buffer_object ||
+         !ext->ALLEGRO_GL_ARB_sync ||
+         !ext->ALLEGRO_GL_ARB_map_buffer_range) {
+      return false;
+   }
+
+   if (format == ALLEGRO_PIXEL_FORMAT_ANY)
+      format = al_get_bitmap_format(bitmap);
+   format = _al_get_real_pixel_format(bitmap_disp, format);
+
+   old_disp = use_readback_display(bitmap_disp);
+
+   glGetIntegerv(GL_PACK_ALIGNMENT, &previous_alignment);
+   pixel_alignment = ogl_pixel_alignment(al_get_pixel_size(format));
+   if (previous_alignment != pixel_alignment)
+      glPixelStorei(GL_PACK_ALIGNMENT, pixel_alignment);
+
+   if (ogl_bitmap->is_backbuffer) {
+      ALLEGRO_DEBUG("Reading back backbuffer into a pixel pack buffer\n");
+      ok = ogl_readback_into_pbo(rb, 0, x, gl_y, format);
+   }
+   else {
+      restore_fbo = _al_ogl_setup_fbo_non_backbuffer(bitmap_disp, bitmap);
+      if (ogl_bitmap->fbo_info) {
+         ALLEGRO_DEBUG("Reading back non-backbuffer into a pixel pack buffer\n");
+         ok = ogl_readback_into_pbo(rb, ogl_bitmap->fbo_info->fbo,
+            x, gl_y, format);
+      }
+      else {
+         ok = false;
+      }
+   }
+
+   if (previous_alignment != pixel_alignment)
+      glPixelStorei(GL_PACK_ALIGNMENT, previous_alignment);
+
+   if (restore_fbo) {
+      restore_target_fbo(bitmap, old_target);
+   }
+
+   ASSERT(al_get_target_bitmap() == old_target);
+
+   if (old_disp != NULL) {
+      _al_set_current_display_only(old_disp);
+   }
+
+   return ok;
+#else
+   (void)bitmap;
+   (void)rb;
+   (void)x;
+   (void)y;
+   (void)w;
+   (void)h;
+   return false;
+#endif
+}
+
+
+
 /*
  * Unlocking
  */
@@ -418,6 +909,8 @@ static void ogl_unlock_region_nonbb_fbo_readwrite(ALLEGRO_BITMAP *bitmap,
    ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap, int gl_y);
 static void ogl_unlock_region_nonbb_nonfbo(ALLEGRO_BITMAP *bitmap,
    ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap, int gl_y);
+static void ogl_unlock_region_nonbb_pbo(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap, int gl_y);
 
 
 void _al_ogl_unlock_region_new(ALLEGRO_BITMAP *bitmap)
@@ -429,6 +922,7 @@ void _al_ogl_unlock_region_new(ALLEGRO_BITMAP *bitmap)
    }
    else {
       ogl_unlock_region_non_readonly(bitmap, ogl_bitmap);
+      ogl_bitmap->discard_pending = false;
    }
 
    al_free(ogl_bitmap->lock_buffer);
@@ -490,7 +984,11 @@ static void ogl_unlock_region_non_readonly(ALLEGRO_BITMAP *bitmap,
    }
    else {
       glBindTexture(GL_TEXTURE_2D, ogl_bitmap->texture);
-      if (ogl_bitmap->fbo_info) {
+      if (ogl_bitmap->lock_pbo || ogl_bitmap->lock_segment) {
+         ALLEGRO_DEBUG("Unlocking non-backbuffer (pixel unpack buffer)\n");
+         ogl_unlock_region_nonbb_pbo(bitmap, ogl_bitmap, gl_y);
+      }
+      else if (ogl_bitmap->fbo_info) {
          ALLEGRO_DEBUG("Unlocking non-backbuffer (FBO)\n");
          ogl_unlock_region_nonbb_fbo(bitmap, ogl_bitmap, gl_y, orig_format);
       }
@@ -567,6 +1065,7 @@ static void ogl_unlock_region_backbuffer(ALLEGRO_BITMAP *bitmap,
 
    glDisable(GL_TEXTURE_2D);
    glDisable(GL_BLEND);
+   _al_ogl_invalidate_state_cache(display, _AL_OGL_STATE_BLENDER);
    glDrawPixels(bitmap->lock_w, bitmap->lock_h,
       get_glformat(lock_format, 2),
       get_glformat(lock_format, 1),
@@ -602,24 +1101,115 @@ static void ogl_unlock_region_nonbb_fbo(ALLEGRO_BITMAP *bitmap,
 }
 
 
+#if !defined(ALLEGRO_MACOSX)
+/* Converts the lock buffer into a segment of the upload ring and updates the
+ * texture from there, so the upload does not wait on the driver.
+ */
+static void ogl_unlock_region_nonbb_fbo_writeonly_ring(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap, int gl_y, int orig_format,
+   int segment)
+{
+   ALLEGRO_DISPLAY *disp = _al_get_bitmap_display(bitmap);
+   ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+   const int dst_pitch = bitmap->lock_w * al_get_pixel_size(orig_format);
+   const int offset = segment * o->upload_segment_size;
+   GLenum e;
+
+   if (bitmap->_flags & ALLEGRO_PARALLEL_CONVERSION) {
+      _al_parallel_convert_bitmap_data(
+         ogl_bitmap->lock_buffer,
+         bitmap->locked_region.format,
+         -bitmap->locked_region.pitch,
+         o->upload_ptr + offset,
+         orig_format,
+         dst_pitch,
+         0, 0, 0, 0,
+         bitmap->lock_w, bitmap->lock_h);
+   }
+   else {
+      _al_convert_bitmap_data(
+         ogl_bitmap->lock_buffer,
+         bitmap->locked_region.format,
+         -bitmap->locked_region.pitch,
+         o->upload_ptr + offset,
+         orig_format,
+         dst_pitch,
+         0, 0, 0, 0,
+         bitmap->lock_w, bitmap->lock_h);
+   }
+
+   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, o->upload_pbo);
+   glTexSubImage2D(GL_TEXTURE_2D, 0,
+      bitmap->lock_x, gl_y,
+      bitmap->lock_w, bitmap->lock_h,
+      get_glformat(orig_format, 2),
+      get_glformat(orig_format, 1),
+      (void *)(intptr_t)offset);
+   e = glGetError();
+   if (e) {
+      ALLEGRO_ERROR("glTexSubImage2D from the upload ring for format %s "
+         "failed (%s).\n", _al_pixel_format_name(orig_format),
+         _al_gl_error_string(e));
+   }
+   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+   release_upload_segment(disp, segment);
+}
+#endif
+
+
 static void ogl_unlock_region_nonbb_fbo_writeonly(ALLEGRO_BITMAP *bitmap,
    ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap, int gl_y, int orig_format)
 {
    const int lock_format = bitmap->locked_region.format;
    const int orig_pixel_size = al_get_pixel_size(orig_format);
    const int dst_pitch = bitmap->lock_w * orig_pixel_size;
-   unsigned char * const tmpbuf = al_malloc(dst_pitch * bitmap->lock_h);
+   unsigned char *tmpbuf;
    GLenum e;
 
-   _al_convert_bitmap_data(
-      ogl_bitmap->lock_buffer,
-      bitmap->locked_region.format,
-      -bitmap->locked_region.pitch,
-      tmpbuf,
-      orig_format,
-      dst_pitch,
-      0, 0, 0, 0,
-      bitmap->lock_w, bitmap->lock_h);
+   /* The lock buffer is laid out just like the upload needs it. */
+   if (lock_format == orig_format) {
+      ogl_unlock_region_nonbb_nonfbo(bitmap, ogl_bitmap, gl_y);
+      return;
+   }
+
+#if !defined(ALLEGRO_MACOSX)
+   /* Convert straight into the upload ring if possible. */
+   if (bitmap->lock_w * bitmap->lock_h >= MIN_PBO_LOCK_PIXELS) {
+      ALLEGRO_DISPLAY *disp = _al_get_bitmap_display(bitmap);
+      int segment = acquire_upload_segment(disp, dst_pitch * bitmap->lock_h);
+      if (segment >= 0) {
+         ogl_unlock_region_nonbb_fbo_writeonly_ring(bitmap, ogl_bitmap, gl_y,
+            orig_format, segment);
+         return;
+      }
+   }
+#endif
+
+   tmpbuf = al_malloc(dst_pitch * bitmap->lock_h);
+
+   if (bitmap->_flags & ALLEGRO_PARALLEL_CONVERSION) {
+      _al_parallel_convert_bitmap_data(
+         ogl_bitmap->lock_buffer,
+         bitmap->locked_region.format,
+         -bitmap->locked_region.pitch,
+         tmpbuf,
+         orig_format,
+         dst_pitch,
+         0, 0, 0, 0,
+         bitmap->lock_w, bitmap->lock_h);
+   }
+   else {
+      _al_convert_bitmap_data(
+         ogl_bitmap->lock_buffer,
+         bitmap->locked_region.format,
+         -bitmap->locked_region.pitch,
+         tmpbuf,
+         orig_format,
+         dst_pitch,
+         0, 0, 0, 0,
+         bitmap->lock_w, bitmap->lock_h);
+   }
 
    glTexSubImage2D(GL_TEXTURE_2D, 0,
       bitmap->lock_x, gl_y,
@@ -696,6 +1286,54 @@ static void ogl_unlock_region_nonbb_nonfbo(ALLEGRO_BITMAP *bitmap,
 }
 
 
+static void ogl_unlock_region_nonbb_pbo(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap, int gl_y)
+{
+#if !defined(ALLEGRO_MACOSX)
+   ALLEGRO_DISPLAY *disp = _al_get_bitmap_display(bitmap);
+   const int lock_format = bitmap->locked_region.format;
+   const int segment = ogl_bitmap->lock_segment - 1;
+   intptr_t offset = 0;
+   GLenum e;
+
+   if (segment >= 0) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, disp->ogl_extras->upload_pbo);
+      offset = segment * disp->ogl_extras->upload_segment_size;
+   }
+   else {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ogl_bitmap->lock_pbo);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+   }
+
+   glTexSubImage2D(GL_TEXTURE_2D, 0,
+      bitmap->lock_x, gl_y,
+      bitmap->lock_w, bitmap->lock_h,
+      get_glformat(lock_format, 2),
+      get_glformat(lock_format, 1),
+      (void *)offset);
+
+   e = glGetError();
+   if (e) {
+      ALLEGRO_ERROR("glTexSubImage2D from a pixel unpack buffer for format "
+         "%s failed (%s).\n",
+         _al_pixel_format_name(lock_format), _al_gl_error_string(e));
+   }
+
+   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+   if (segment >= 0) {
+      release_upload_segment(disp, segment);
+   }
+   else {
+      glDeleteBuffers(1, &ogl_bitmap->lock_pbo);
+   }
+#else
+   (void)bitmap;
+   (void)gl_y;
+#endif
+   ogl_bitmap->lock_pbo = 0;
+   ogl_bitmap->lock_segment = 0;
+}
+
 #endif
 
 /* vim: set sts=3 sw=3 et: */
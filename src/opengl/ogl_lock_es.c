@@ -501,9 +501,11 @@ void _al_ogl_unlock_region_gles(ALLEGRO_BITMAP *bitmap)
    }
    else if (ogl_bitmap->lock_proxy != NULL) {
       ogl_unlock_region_bb_proxy(bitmap, ogl_bitmap);
+      ogl_bitmap->discard_pending = false;
    }
    else {
       ogl_unlock_region_nonbb(bitmap, ogl_bitmap);
+      ogl_bitmap->discard_pending = false;
    }
 
    al_free(ogl_bitmap->lock_buffer);
@@ -1,5 +1,6 @@
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_opengl.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_opengl.h"
 
@@ -17,16 +18,72 @@ static int _gl_funcs[] = {
    GL_GEQUAL
 };
 
+void _al_ogl_init_state_cache(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_OGL_STATE_CACHE *cache = &display->ogl_extras->state_cache;
+   const char *value = al_get_config_value(al_get_system_config(), "opengl",
+      "state_cache");
+
+   cache->enabled = !(value && _al_stricmp(value, "false") == 0);
+   cache->known = 0;
+}
+
+
+void _al_ogl_invalidate_state_cache(ALLEGRO_DISPLAY *display, int which)
+{
+   /* An upload context has no effect on the display's own state. */
+   if (_al_get_current_upload_context())
+      return;
+   if (!display)
+      display = al_get_current_display();
+   if (!display || !(display->flags & ALLEGRO_OPENGL) || !display->ogl_extras)
+      return;
+   display->ogl_extras->state_cache.known &= ~which;
+}
+
+
+/* Called after the state was actually changed. */
+void _al_ogl_remember_state(ALLEGRO_OGL_STATE_CACHE *cache, int which)
+{
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+
+   if (cache->enabled)
+      cache->known |= which;
+   if (display)
+      display->stats.state_changes++;
+}
+
+
+/* Returns the state cache of the display whose context is current on this
+ * thread, or NULL if there is none.
+ */
+ALLEGRO_OGL_STATE_CACHE *_al_ogl_current_state_cache(void)
+{
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+   if (!display || !(display->flags & ALLEGRO_OPENGL) || !display->ogl_extras)
+      return NULL;
+   if (_al_get_current_upload_context())
+      return NULL;
+   return &display->ogl_extras->state_cache;
+}
+
+
+/* Function: al_invalidate_opengl_state
+ */
+void al_invalidate_opengl_state(void)
+{
+   _al_ogl_invalidate_state_cache(NULL, _AL_OGL_STATE_ALL);
+}
+
+
 void _al_ogl_update_render_state(ALLEGRO_DISPLAY *display)
 {
    _ALLEGRO_RENDER_STATE *r = &display->render_state;
-
-   /* TODO: We could store the previous state and/or mark updated states to
-    * avoid so many redundant OpenGL calls.
-    */
+   ALLEGRO_OGL_STATE_CACHE *cache = &display->ogl_extras->state_cache;
 
    if (display->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
 #ifdef ALLEGRO_CFG_SHADER_GLSL
+      /* Uniforms belong to the program, so they are always set. */
       GLint atloc = display->ogl_extras->varlocs.alpha_test_loc;
       GLint floc = display->ogl_extras->varlocs.alpha_func_loc;
       GLint tvloc = display->ogl_extras->varlocs.alpha_test_val_loc;
@@ -38,7 +95,13 @@ void _al_ogl_update_render_state(ALLEGRO_DISPLAY *display)
       }
 #endif
    }
-   else {
+
+   if ((cache->known & _AL_OGL_STATE_RENDER_STATE) &&
+         memcmp(&cache->render_state, r, sizeof(*r)) == 0) {
+      return;
+   }
+
+   if (!(display->flags & ALLEGRO_PROGRAMMABLE_PIPELINE)) {
 #ifdef ALLEGRO_CFG_OPENGL_FIXED_FUNCTION
       if (r->alpha_test == 0)
          glDisable(GL_ALPHA_TEST);
@@ -60,4 +123,7 @@ void _al_ogl_update_render_state(ALLEGRO_DISPLAY *display)
       (r->write_mask & ALLEGRO_MASK_GREEN) ? GL_TRUE : GL_FALSE,
       (r->write_mask & ALLEGRO_MASK_BLUE) ? GL_TRUE : GL_FALSE,
       (r->write_mask & ALLEGRO_MASK_ALPHA) ? GL_TRUE : GL_FALSE);
+
+   cache->render_state = *r;
+   _al_ogl_remember_state(cache, _AL_OGL_STATE_RENDER_STATE);
 }
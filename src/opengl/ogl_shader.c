@@ -35,6 +35,13 @@ static ALLEGRO_MUTEX *shaders_mutex;
 
 typedef struct ALLEGRO_SHADER_GLSL_S ALLEGRO_SHADER_GLSL_S;
 
+typedef struct UNIFORM_LOCATION
+{
+   char *name;          /* NULL for an empty slot */
+   uint32_t hash;
+   GLint location;
+} UNIFORM_LOCATION;
+
 struct ALLEGRO_SHADER_GLSL_S
 {
    ALLEGRO_SHADER shader;
@@ -42,12 +49,36 @@ struct ALLEGRO_SHADER_GLSL_S
    GLuint pixel_shader;
    GLuint program_object;
    ALLEGRO_OGL_VARLOCS varlocs;
+
+   /* Uniform locations looked up so far, by name. An open addressing hash
+    * table with a power of two size, emptied when the program is relinked.
+    */
+   UNIFORM_LOCATION *locations;
+   int locations_size;
+   int num_locations;
+
+   /* How many of the shared uniform blocks have been bound in the program. */
+   int num_blocks_bound;
+
+   /* The display that last used the program. With shared contexts another
+    * display may have changed al_projview_matrix since.
+    */
+   ALLEGRO_DISPLAY *projview_display;
 };
 
+/* Names of the blocks set with al_set_shader_uniform_block. The index of a
+ * name is the binding point of that block in every program.
+ */
+static char *block_names[_AL_MAX_UNIFORM_BLOCKS];
+static int num_block_names;
+
 
 /* forward declarations */
 static struct ALLEGRO_SHADER_INTERFACE shader_glsl_vt;
 static void lookup_varlocs(ALLEGRO_OGL_VARLOCS *varlocs, GLuint program);
+#ifndef ALLEGRO_CFG_OPENGLES
+static void bind_uniform_blocks(ALLEGRO_SHADER_GLSL_S *gl_shader);
+#endif
 
 
 static bool check_gl_error(const char* name)
@@ -61,6 +92,105 @@ static bool check_gl_error(const char* name)
 }
 
 
+static uint32_t hash_name(const char *name)
+{
+   /* FNV-1a */
+   uint32_t h = 2166136261u;
+   while (*name) {
+      h ^= (unsigned char)*name++;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+static void clear_uniform_locations(ALLEGRO_SHADER_GLSL_S *gl_shader)
+{
+   int i;
+
+   for (i = 0; i < gl_shader->locations_size; i++)
+      al_free(gl_shader->locations[i].name);
+   al_free(gl_shader->locations);
+   gl_shader->locations = NULL;
+   gl_shader->locations_size = 0;
+   gl_shader->num_locations = 0;
+}
+
+
+static UNIFORM_LOCATION *find_location_slot(UNIFORM_LOCATION *table,
+   int size, const char *name, uint32_t hash)
+{
+   int i = hash & (size - 1);
+
+   while (table[i].name) {
+      if (table[i].hash == hash && strcmp(table[i].name, name) == 0)
+         break;
+      i = (i + 1) & (size - 1);
+   }
+   return &table[i];
+}
+
+
+static bool grow_uniform_locations(ALLEGRO_SHADER_GLSL_S *gl_shader)
+{
+   int new_size = gl_shader->locations_size ? gl_shader->locations_size * 2 : 16;
+   UNIFORM_LOCATION *table = al_calloc(new_size, sizeof(*table));
+   int i;
+
+   if (!table)
+      return false;
+
+   for (i = 0; i < gl_shader->locations_size; i++) {
+      UNIFORM_LOCATION *old = &gl_shader->locations[i];
+      if (old->name)
+         *find_location_slot(table, new_size, old->name, old->hash) = *old;
+   }
+
+   al_free(gl_shader->locations);
+   gl_shader->locations = table;
+   gl_shader->locations_size = new_size;
+   return true;
+}
+
+
+/* Like glGetUniformLocation, but each name is only looked up once per link.
+ * Names which do not exist are remembered as well.
+ */
+static GLint get_uniform_location(ALLEGRO_SHADER_GLSL_S *gl_shader,
+   const char *name)
+{
+   uint32_t hash = hash_name(name);
+   UNIFORM_LOCATION *slot;
+   GLint location;
+
+   if (gl_shader->locations_size > 0) {
+      slot = find_location_slot(gl_shader->locations,
+         gl_shader->locations_size, name, hash);
+      if (slot->name)
+         return slot->location;
+   }
+
+   location = glGetUniformLocation(gl_shader->program_object, name);
+
+   /* Keep the table at most half full. */
+   if ((gl_shader->num_locations + 1) * 2 > gl_shader->locations_size &&
+         !grow_uniform_locations(gl_shader)) {
+      return location;
+   }
+
+   slot = find_location_slot(gl_shader->locations, gl_shader->locations_size,
+      name, hash);
+   slot->name = al_malloc(strlen(name) + 1);
+   if (slot->name) {
+      strcpy(slot->name, name);
+      slot->hash = hash;
+      slot->location = location;
+      gl_shader->num_locations++;
+   }
+   return location;
+}
+
+
 ALLEGRO_SHADER *_al_create_shader_glsl(ALLEGRO_SHADER_PLATFORM platform)
 {
    ALLEGRO_SHADER_GLSL_S *shader = al_calloc(1, sizeof(ALLEGRO_SHADER_GLSL_S));
@@ -82,16 +212,97 @@ ALLEGRO_SHADER *_al_create_shader_glsl(ALLEGRO_SHADER_PLATFORM platform)
    return (ALLEGRO_SHADER *)shader;
 }
 
-static bool glsl_attach_shader_source(ALLEGRO_SHADER *shader,
-   ALLEGRO_SHADER_TYPE type, const char *source)
+/* Whether programs go through the shader cache. The sources are then only
+ * compiled by al_build_shader, and only if the cache has no binary for them.
+ */
+static bool use_shader_cache(ALLEGRO_DISPLAY *display)
+{
+#ifdef ALLEGRO_CFG_OPENGLES
+   (void)display;
+   return false;
+#else
+   return display->ogl_extras->extension_list->ALLEGRO_GL_ARB_get_program_binary &&
+      _al_get_shader_cache_path() != NULL;
+#endif
+}
+
+static void set_source_copy(ALLEGRO_USTR **copy, const char *source)
+{
+   if (!*copy)
+      *copy = al_ustr_new("");
+   else
+      al_ustr_truncate(*copy, 0);
+   if (source)
+      al_ustr_append_cstr(*copy, source);
+}
+
+static bool compile_shader(ALLEGRO_SHADER *shader, ALLEGRO_SHADER_TYPE type,
+   const char *source)
 {
    GLint status;
    GLchar error_buf[4096];
+   ALLEGRO_SHADER_GLSL_S *gl_shader = (ALLEGRO_SHADER_GLSL_S *)shader;
+   GLuint *handle;
+   GLenum gl_type;
+
+   if (type == ALLEGRO_VERTEX_SHADER) {
+      handle = &(gl_shader->vertex_shader);
+      gl_type = GL_VERTEX_SHADER;
+   }
+   else {
+      handle = &(gl_shader->pixel_shader);
+      gl_type = GL_FRAGMENT_SHADER;
+   }
+   *handle = glCreateShader(gl_type);
+   if ((*handle) == 0) {
+      return false;
+   }
+   glShaderSource(*handle, 1, &source, NULL);
+   glCompileShader(*handle);
+   glGetShaderiv(*handle, GL_COMPILE_STATUS, &status);
+   if (status == 0) {
+      glGetShaderInfoLog(*handle, sizeof(error_buf), NULL, error_buf);
+      if (shader->log) {
+         al_ustr_truncate(shader->log, 0);
+         al_ustr_append_cstr(shader->log, error_buf);
+      }
+      else {
+         shader->log = al_ustr_new(error_buf);
+      }
+      ALLEGRO_ERROR("Compile error: %s\n", error_buf);
+      glDeleteShader(*handle);
+      *handle = 0;
+      return false;
+   }
+
+   return true;
+}
+
+static bool glsl_attach_shader_source(ALLEGRO_SHADER *shader,
+   ALLEGRO_SHADER_TYPE type, const char *source)
+{
    ALLEGRO_SHADER_GLSL_S *gl_shader = (ALLEGRO_SHADER_GLSL_S *)shader;
    ALLEGRO_DISPLAY *display = al_get_current_display();
    ASSERT(display);
    ASSERT(display->flags & ALLEGRO_OPENGL);
 
+   if (use_shader_cache(display)) {
+      GLuint *handle;
+      if (type == ALLEGRO_VERTEX_SHADER) {
+         set_source_copy(&shader->vertex_copy, source);
+         handle = &gl_shader->vertex_shader;
+      }
+      else {
+         set_source_copy(&shader->pixel_copy, source);
+         handle = &gl_shader->pixel_shader;
+      }
+      if (*handle) {
+         glDeleteShader(*handle);
+         *handle = 0;
+      }
+      return true;
+   }
+
    if (source == NULL) {
       if (type == ALLEGRO_VERTEX_SHADER) {
          if (gl_shader->vertex_shader) {
@@ -110,63 +321,178 @@ static bool glsl_attach_shader_source(ALLEGRO_SHADER *shader,
       return true;
    }
    else {
-      GLuint *handle;
-      GLenum gl_type;
-      if (type == ALLEGRO_VERTEX_SHADER) {
-         handle = &(gl_shader->vertex_shader);
-         gl_type = GL_VERTEX_SHADER;
-      }
-      else {
-         handle = &(gl_shader->pixel_shader);
-         gl_type = GL_FRAGMENT_SHADER;
-      }
-      *handle = glCreateShader(gl_type);
-      if ((*handle) == 0) {
-         return false;
-      }
-      glShaderSource(*handle, 1, &source, NULL);
-      glCompileShader(*handle);
-      glGetShaderiv(*handle, GL_COMPILE_STATUS, &status);
-      if (status == 0) {
-         glGetShaderInfoLog(*handle, sizeof(error_buf), NULL, error_buf);
-         if (shader->log) {
-            al_ustr_truncate(shader->log, 0);
-            al_ustr_append_cstr(shader->log, error_buf);
-         }
-         else {
-            shader->log = al_ustr_new(error_buf);
-         }
-         ALLEGRO_ERROR("Compile error: %s\n", error_buf);
-         glDeleteShader(*handle);
-         return false;
-      }
+      return compile_shader(shader, type, source);
+   }
+}
+
+static bool has_source_copy(const ALLEGRO_USTR *copy)
+{
+   return copy && al_ustr_size(copy) > 0;
+}
+
+#ifndef ALLEGRO_CFG_OPENGLES
+
+static uint64_t hash_gl_string(uint64_t key, GLenum name)
+{
+   const char *str = (const char *)glGetString(name);
+   if (str)
+      key = _al_shader_cache_hash(key, str, strlen(str) + 1);
+   return key;
+}
+
+/* The key covers everything that can make a stored binary unusable. */
+static uint64_t get_shader_cache_key(ALLEGRO_SHADER *shader)
+{
+   uint64_t key = _AL_SHADER_CACHE_HASH_INIT;
+   int version = ALLEGRO_VERSION_INT;
+
+   if (has_source_copy(shader->vertex_copy)) {
+      key = _al_shader_cache_hash(key, al_cstr(shader->vertex_copy),
+         al_ustr_size(shader->vertex_copy));
+   }
+   key = _al_shader_cache_hash(key, "", 1);
+   if (has_source_copy(shader->pixel_copy)) {
+      key = _al_shader_cache_hash(key, al_cstr(shader->pixel_copy),
+         al_ustr_size(shader->pixel_copy));
+   }
+   key = _al_shader_cache_hash(key, "", 1);
+   key = hash_gl_string(key, GL_VENDOR);
+   key = hash_gl_string(key, GL_RENDERER);
+   key = hash_gl_string(key, GL_VERSION);
+   key = _al_shader_cache_hash(key, &version, sizeof(version));
+   return key;
+}
+
+/* Cache entries hold the binary format followed by the program binary. */
+static bool load_program_binary(GLuint program, uint64_t key)
+{
+   GLint status = 0;
+   uint32_t format;
+   size_t size;
+   char *data;
+
+   data = _al_load_shader_cache(key, &size);
+   if (!data)
+      return false;
+
+   if (size > sizeof(format)) {
+      memcpy(&format, data, sizeof(format));
+      glGetError(); /* clear error */
+      glProgramBinary(program, format, data + sizeof(format),
+         size - sizeof(format));
+      if (glGetError() == GL_NO_ERROR)
+         glGetProgramiv(program, GL_LINK_STATUS, &status);
    }
+   al_free(data);
 
+   if (status == 0) {
+      /* Typically after a driver update. */
+      ALLEGRO_DEBUG("Program binary rejected by the driver\n");
+      return false;
+   }
    return true;
 }
 
+static void save_program_binary(GLuint program, uint64_t key)
+{
+   GLint length = 0;
+   GLenum format;
+   uint32_t format32;
+   char *data;
+
+   glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+   if (length <= 0)
+      return;
+
+   data = al_malloc(sizeof(format32) + length);
+   if (!data)
+      return;
+
+   glGetError(); /* clear error */
+   glGetProgramBinary(program, length, &length, &format,
+      data + sizeof(format32));
+   if (glGetError() == GL_NO_ERROR) {
+      format32 = format;
+      memcpy(data, &format32, sizeof(format32));
+      _al_save_shader_cache(key, data, sizeof(format32) + length);
+   }
+   al_free(data);
+}
+
+#endif
+
 static bool glsl_build_shader(ALLEGRO_SHADER *shader)
 {
    GLint status;
    ALLEGRO_SHADER_GLSL_S *gl_shader = (ALLEGRO_SHADER_GLSL_S *)shader;
    GLchar error_buf[4096];
+   bool cached = use_shader_cache(al_get_current_display());
+#ifndef ALLEGRO_CFG_OPENGLES
+   uint64_t key = 0;
+#endif
 
-   if (gl_shader->vertex_shader == 0 && gl_shader->pixel_shader == 0)
+   if (gl_shader->vertex_shader == 0 && gl_shader->pixel_shader == 0 &&
+         !(cached && (has_source_copy(shader->vertex_copy) ||
+            has_source_copy(shader->pixel_copy))))
       return false;
 
    if (gl_shader->program_object != 0) {
       glDeleteProgram(gl_shader->program_object);
+      _al_ogl_invalidate_state_cache(NULL,
+         _AL_OGL_STATE_PROGRAM | _AL_OGL_STATE_PROJVIEW);
    }
+   clear_uniform_locations(gl_shader);
+   gl_shader->num_blocks_bound = 0;
 
    gl_shader->program_object = glCreateProgram();
    if (gl_shader->program_object == 0)
       return false;
 
+#ifndef ALLEGRO_CFG_OPENGLES
+   if (cached) {
+      key = get_shader_cache_key(shader);
+      if (load_program_binary(gl_shader->program_object, key)) {
+         lookup_varlocs(&gl_shader->varlocs, gl_shader->program_object);
+         return true;
+      }
+
+      /* Start over with a program that has not seen glProgramBinary. */
+      glDeleteProgram(gl_shader->program_object);
+      gl_shader->program_object = glCreateProgram();
+      if (gl_shader->program_object == 0)
+         return false;
+
+      if (gl_shader->vertex_shader == 0 &&
+            has_source_copy(shader->vertex_copy) &&
+            !compile_shader(shader, ALLEGRO_VERTEX_SHADER,
+               al_cstr(shader->vertex_copy))) {
+         return false;
+      }
+      if (gl_shader->pixel_shader == 0 &&
+            has_source_copy(shader->pixel_copy) &&
+            !compile_shader(shader, ALLEGRO_PIXEL_SHADER,
+               al_cstr(shader->pixel_copy))) {
+         return false;
+      }
+
+      if (glProgramParameteri) {
+         glProgramParameteri(gl_shader->program_object,
+            GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+      }
+   }
+#endif
+
    if (gl_shader->vertex_shader)
       glAttachShader(gl_shader->program_object, gl_shader->vertex_shader);
    if (gl_shader->pixel_shader)
       glAttachShader(gl_shader->program_object, gl_shader->pixel_shader);
 
+   /* Attribute 0 has to be an enabled array on some drivers. Make sure it is
+    * the position rather than e.g. the texture index, which is only supplied
+    * for bitmap drawing.
+    */
+   glBindAttribLocation(gl_shader->program_object, 0, ALLEGRO_SHADER_VAR_POS);
+
    glLinkProgram(gl_shader->program_object);
 
    glGetProgramiv(gl_shader->program_object, GL_LINK_STATUS, &status);
@@ -186,6 +512,11 @@ static bool glsl_build_shader(ALLEGRO_SHADER *shader)
       return false;
    }
 
+#ifndef ALLEGRO_CFG_OPENGLES
+   if (cached)
+      save_program_binary(gl_shader->program_object, key);
+#endif
+
    /* Look up variable locations. */
    lookup_varlocs(&gl_shader->varlocs, gl_shader->program_object);
 
@@ -196,6 +527,7 @@ static bool glsl_use_shader(ALLEGRO_SHADER *shader, ALLEGRO_DISPLAY *display,
    bool set_projview_matrix_from_display)
 {
    ALLEGRO_SHADER_GLSL_S *gl_shader;
+   ALLEGRO_OGL_STATE_CACHE *cache;
    GLuint program_object;
    GLenum err;
 
@@ -205,19 +537,36 @@ static bool glsl_use_shader(ALLEGRO_SHADER *shader, ALLEGRO_DISPLAY *display,
 
    gl_shader = (ALLEGRO_SHADER_GLSL_S *)shader;
    program_object = gl_shader->program_object;
-
-   glGetError(); /* clear error */
-   glUseProgram(program_object);
-   err = glGetError();
-   if (err != GL_NO_ERROR) {
-      ALLEGRO_WARN("glUseProgram(%u) failed: %s\n", program_object,
-         _al_gl_error_string(err));
-      display->ogl_extras->program_object = 0;
-      return false;
+   cache = &display->ogl_extras->state_cache;
+
+   if (!(cache->known & _AL_OGL_STATE_PROGRAM) ||
+         cache->program != program_object) {
+      glGetError(); /* clear error */
+      glUseProgram(program_object);
+      err = glGetError();
+      if (err != GL_NO_ERROR) {
+         ALLEGRO_WARN("glUseProgram(%u) failed: %s\n", program_object,
+            _al_gl_error_string(err));
+         display->ogl_extras->program_object = 0;
+         _al_ogl_invalidate_state_cache(display, _AL_OGL_STATE_PROGRAM);
+         return false;
+      }
+      cache->program = program_object;
+      _al_ogl_remember_state(cache, _AL_OGL_STATE_PROGRAM);
    }
 
    display->ogl_extras->program_object = program_object;
 
+   if (gl_shader->projview_display != display) {
+      _al_ogl_invalidate_state_cache(display, _AL_OGL_STATE_PROJVIEW);
+      gl_shader->projview_display = display;
+   }
+
+#ifndef ALLEGRO_CFG_OPENGLES
+   if (display->ogl_extras->extension_list->ALLEGRO_GL_ARB_uniform_buffer_object)
+      bind_uniform_blocks(gl_shader);
+#endif
+
    /* Copy variable locations. */
    display->ogl_extras->varlocs = gl_shader->varlocs;
 
@@ -225,9 +574,15 @@ static bool glsl_use_shader(ALLEGRO_SHADER *shader, ALLEGRO_DISPLAY *display,
     * matrices in the display are out of date and are about to be clobbered
     * itself.
     */
-   if (set_projview_matrix_from_display) {
-      _al_glsl_set_projview_matrix(
-         display->ogl_extras->varlocs.projview_matrix_loc, &display->projview_transform);
+   if (set_projview_matrix_from_display &&
+         (!(cache->known & _AL_OGL_STATE_PROJVIEW) ||
+          cache->projview_program != program_object)) {
+      if (_al_glsl_set_projview_matrix(
+            display->ogl_extras->varlocs.projview_matrix_loc,
+            &display->projview_transform)) {
+         cache->projview_program = program_object;
+         _al_ogl_remember_state(cache, _AL_OGL_STATE_PROJVIEW);
+      }
    }
 
    /* Alpha testing may be done in the shader and so when a shader is
@@ -240,9 +595,14 @@ static bool glsl_use_shader(ALLEGRO_SHADER *shader, ALLEGRO_DISPLAY *display,
 
 static void glsl_unuse_shader(ALLEGRO_SHADER *shader, ALLEGRO_DISPLAY *display)
 {
+   ALLEGRO_OGL_STATE_CACHE *cache = &display->ogl_extras->state_cache;
    (void)shader;
-   (void)display;
+
+   if ((cache->known & _AL_OGL_STATE_PROGRAM) && cache->program == 0)
+      return;
    glUseProgram(0);
+   cache->program = 0;
+   _al_ogl_remember_state(cache, _AL_OGL_STATE_PROGRAM);
 }
 
 static void glsl_destroy_shader(ALLEGRO_SHADER *shader)
@@ -256,6 +616,10 @@ static void glsl_destroy_shader(ALLEGRO_SHADER *shader)
    glDeleteShader(gl_shader->vertex_shader);
    glDeleteShader(gl_shader->pixel_shader);
    glDeleteProgram(gl_shader->program_object);
+   /* The name may be handed out again. */
+   _al_ogl_invalidate_state_cache(NULL,
+      _AL_OGL_STATE_PROGRAM | _AL_OGL_STATE_PROJVIEW);
+   clear_uniform_locations(gl_shader);
    al_free(shader);
 }
 
@@ -271,7 +635,7 @@ static bool glsl_set_shader_sampler(ALLEGRO_SHADER *shader,
       return false;
    }
 
-   handle = glGetUniformLocation(gl_shader->program_object, name);
+   handle = get_uniform_location(gl_shader, name);
 
    if (handle < 0) {
       ALLEGRO_WARN("No uniform variable '%s' in shader program\n", name);
@@ -294,7 +658,7 @@ static bool glsl_set_shader_matrix(ALLEGRO_SHADER *shader,
    ALLEGRO_SHADER_GLSL_S *gl_shader = (ALLEGRO_SHADER_GLSL_S *)shader;
    GLint handle;
 
-   handle = glGetUniformLocation(gl_shader->program_object, name);
+   handle = get_uniform_location(gl_shader, name);
 
    if (handle < 0) {
       ALLEGRO_WARN("No uniform variable '%s' in shader program\n", name);
@@ -302,6 +666,8 @@ static bool glsl_set_shader_matrix(ALLEGRO_SHADER *shader,
    }
 
    glUniformMatrix4fv(handle, 1, false, (const float *)matrix->m);
+   if (handle == gl_shader->varlocs.projview_matrix_loc)
+      _al_ogl_invalidate_state_cache(NULL, _AL_OGL_STATE_PROJVIEW);
 
    return check_gl_error(name);
 }
@@ -312,7 +678,7 @@ static bool glsl_set_shader_int(ALLEGRO_SHADER *shader,
    ALLEGRO_SHADER_GLSL_S *gl_shader = (ALLEGRO_SHADER_GLSL_S *)shader;
    GLint handle;
 
-   handle = glGetUniformLocation(gl_shader->program_object, name);
+   handle = get_uniform_location(gl_shader, name);
 
    if (handle < 0) {
       ALLEGRO_WARN("No uniform variable '%s' in shader program\n", name);
@@ -330,7 +696,7 @@ static bool glsl_set_shader_float(ALLEGRO_SHADER *shader,
    ALLEGRO_SHADER_GLSL_S *gl_shader = (ALLEGRO_SHADER_GLSL_S *)shader;
    GLint handle;
 
-   handle = glGetUniformLocation(gl_shader->program_object, name);
+   handle = get_uniform_location(gl_shader, name);
 
    if (handle < 0) {
       ALLEGRO_WARN("No uniform variable '%s' in shader program\n", name);
@@ -348,7 +714,7 @@ static bool glsl_set_shader_int_vector(ALLEGRO_SHADER *shader,
    ALLEGRO_SHADER_GLSL_S *gl_shader = (ALLEGRO_SHADER_GLSL_S *)shader;
    GLint handle;
 
-   handle = glGetUniformLocation(gl_shader->program_object, name);
+   handle = get_uniform_location(gl_shader, name);
 
    if (handle < 0) {
       ALLEGRO_WARN("No uniform variable '%s' in shader program\n", name);
@@ -382,7 +748,7 @@ static bool glsl_set_shader_float_vector(ALLEGRO_SHADER *shader,
    ALLEGRO_SHADER_GLSL_S *gl_shader = (ALLEGRO_SHADER_GLSL_S *)shader;
    GLint handle;
 
-   handle = glGetUniformLocation(gl_shader->program_object, name);
+   handle = get_uniform_location(gl_shader, name);
 
    if (handle < 0) {
       ALLEGRO_WARN("No uniform variable '%s' in shader program\n", name);
@@ -416,6 +782,105 @@ static bool glsl_set_shader_bool(ALLEGRO_SHADER *shader,
    return glsl_set_shader_int(shader, name, b);
 }
 
+#ifndef ALLEGRO_CFG_OPENGLES
+/* Returns the binding point of the named block, giving it the next free one
+ * if it is new, or -1 if all are taken.
+ */
+static int get_block_binding(const char *name)
+{
+   int i;
+
+   al_lock_mutex(shaders_mutex);
+   for (i = 0; i < num_block_names; i++) {
+      if (strcmp(block_names[i], name) == 0)
+         break;
+   }
+   if (i == num_block_names) {
+      if (i == _AL_MAX_UNIFORM_BLOCKS ||
+            !(block_names[i] = al_malloc(strlen(name) + 1))) {
+         i = -1;
+      }
+      else {
+         strcpy(block_names[i], name);
+         num_block_names++;
+      }
+   }
+   al_unlock_mutex(shaders_mutex);
+
+   return i;
+}
+
+
+/* Connects the blocks the program has to their binding points, if not done
+ * yet.  Programs keep this across uses, so only new names are looked up.
+ */
+static void bind_uniform_blocks(ALLEGRO_SHADER_GLSL_S *gl_shader)
+{
+   int i;
+
+   if (gl_shader->num_blocks_bound == num_block_names)
+      return;
+
+   al_lock_mutex(shaders_mutex);
+   for (i = gl_shader->num_blocks_bound; i < num_block_names; i++) {
+      GLuint index = glGetUniformBlockIndex(gl_shader->program_object,
+         block_names[i]);
+      if (index != GL_INVALID_INDEX)
+         glUniformBlockBinding(gl_shader->program_object, index, i);
+   }
+   gl_shader->num_blocks_bound = num_block_names;
+   al_unlock_mutex(shaders_mutex);
+}
+#endif
+
+static bool glsl_set_shader_uniform_block(ALLEGRO_SHADER *shader,
+   const char *name, const void *data, size_t size)
+{
+#ifndef ALLEGRO_CFG_OPENGLES
+   ALLEGRO_SHADER_GLSL_S *gl_shader = (ALLEGRO_SHADER_GLSL_S *)shader;
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+   ALLEGRO_OGL_EXTRAS *o;
+   int binding;
+
+   if (!display || !(display->flags & ALLEGRO_OPENGL))
+      return false;
+   o = display->ogl_extras;
+   if (!o->extension_list->ALLEGRO_GL_ARB_uniform_buffer_object) {
+      ALLEGRO_WARN("Uniform blocks are not supported\n");
+      return false;
+   }
+
+   binding = get_block_binding(name);
+   if (binding < 0) {
+      ALLEGRO_WARN("Too many uniform blocks, cannot add '%s'\n", name);
+      return false;
+   }
+
+   if (o->uniform_blocks[binding] == 0) {
+      glGenBuffers(1, &o->uniform_blocks[binding]);
+      ALLEGRO_DEBUG("Uniform block '%s' at binding %d\n", name, binding);
+   }
+
+   /* Specifying new storage orphans the old one, so draws still reading
+    * the previous contents do not hold up the upload.
+    */
+   glBindBuffer(GL_UNIFORM_BUFFER, o->uniform_blocks[binding]);
+   glBufferData(GL_UNIFORM_BUFFER, size, data, GL_STREAM_DRAW);
+   glBindBuffer(GL_UNIFORM_BUFFER, 0);
+   glBindBufferBase(GL_UNIFORM_BUFFER, binding, o->uniform_blocks[binding]);
+
+   bind_uniform_blocks(gl_shader);
+
+   return check_gl_error(name);
+#else
+   (void)shader;
+   (void)data;
+   (void)size;
+   ALLEGRO_WARN("Uniform blocks are not supported, cannot set '%s'\n", name);
+   return false;
+#endif
+}
+
 static struct ALLEGRO_SHADER_INTERFACE shader_glsl_vt =
 {
    glsl_attach_shader_source,
@@ -431,7 +896,8 @@ static struct ALLEGRO_SHADER_INTERFACE shader_glsl_vt =
    glsl_set_shader_float,
    glsl_set_shader_int_vector,
    glsl_set_shader_float_vector,
-   glsl_set_shader_bool
+   glsl_set_shader_bool,
+   glsl_set_shader_uniform_block
 };
 
 static void lookup_varlocs(ALLEGRO_OGL_VARLOCS *varlocs, GLuint program)
@@ -458,6 +924,15 @@ static void lookup_varlocs(ALLEGRO_OGL_VARLOCS *varlocs, GLuint program)
       varlocs->user_attr_loc[i] = glGetAttribLocation(program, user_attr_name);
    }
 
+   varlocs->tex_index_loc = glGetAttribLocation(program, _AL_SHADER_VAR_TEX_INDEX);
+   for (i = 0; i < _AL_MAX_BATCH_TEXTURES - 1; i++) {
+      /* al_tex1, al_tex2, ... */
+      char batch_tex_name[sizeof(ALLEGRO_SHADER_VAR_TEX "999")];
+
+      snprintf(batch_tex_name, sizeof(batch_tex_name), ALLEGRO_SHADER_VAR_TEX "%d", i + 1);
+      varlocs->batch_tex_loc[i] = glGetUniformLocation(program, batch_tex_name);
+   }
+
    check_gl_error("glGetAttribLocation, glGetUniformLocation");
 }
 
@@ -480,6 +955,14 @@ void _al_glsl_init_shaders(void)
 
 void _al_glsl_shutdown_shaders(void)
 {
+   int i;
+
+   for (i = 0; i < num_block_names; i++) {
+      al_free(block_names[i]);
+      block_names[i] = NULL;
+   }
+   num_block_names = 0;
+
    _al_vector_free(&shaders);
    al_destroy_mutex(shaders_mutex);
    shaders_mutex = NULL;
@@ -0,0 +1,222 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      OpenGL uploads from worker threads.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_opengl.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_display.h"
+#include "allegro5/internal/aintern_opengl.h"
+
+ALLEGRO_DEBUG_CHANNEL("opengl")
+
+
+/*
+ * Each display can have a pool of hidden contexts sharing its textures and
+ * buffers, created up front on the thread that owns the display, as not
+ * every platform allows creating a context sharing with one that is current
+ * elsewhere. A worker thread borrows one of them between
+ * al_begin_opengl_upload and al_end_opengl_upload. Meanwhile the display is
+ * its current display, so that bitmaps get created for it, but none of the
+ * display's own state (the state cache, the upload ring, FBOs) is touched
+ * from that thread.
+ *
+ * The pool and the display's bitmap list are guarded by bitmaps_mutex,
+ * which exists from the first al_reserve_opengl_upload_contexts on.
+ */
+
+
+/* Function: al_reserve_opengl_upload_contexts
+ */
+int al_reserve_opengl_upload_contexts(int count)
+{
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+   ALLEGRO_OGL_EXTRAS *o;
+   int num;
+
+   ASSERT(count >= 0);
+
+   if (!display || !(display->flags & ALLEGRO_OPENGL) ||
+         _al_get_current_upload_context()) {
+      return 0;
+   }
+   if (!display->vt->create_upload_context) {
+      ALLEGRO_WARN("Upload contexts are not supported by this driver.\n");
+      return 0;
+   }
+
+   if (!display->bitmaps_mutex) {
+      display->bitmaps_mutex = al_create_mutex();
+      if (!display->bitmaps_mutex)
+         return 0;
+   }
+
+   o = display->ogl_extras;
+   count = _ALLEGRO_MIN(count, _AL_MAX_UPLOAD_CONTEXTS);
+
+   al_lock_mutex(display->bitmaps_mutex);
+   while (o->num_upload_contexts < count) {
+      void *context = display->vt->create_upload_context(display);
+      if (!context) {
+         ALLEGRO_WARN("Could only create %d upload contexts.\n",
+            o->num_upload_contexts);
+         break;
+      }
+      o->upload_contexts[o->num_upload_contexts] = context;
+      o->upload_context_busy[o->num_upload_contexts] = false;
+      o->num_upload_contexts++;
+   }
+   num = o->num_upload_contexts;
+   al_unlock_mutex(display->bitmaps_mutex);
+
+   ALLEGRO_DEBUG("%d upload contexts\n", num);
+   return num;
+}
+
+
+/* Function: al_begin_opengl_upload
+ */
+bool al_begin_opengl_upload(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_OGL_EXTRAS *o;
+   void *context = NULL;
+   int i;
+
+   ASSERT(display);
+
+   if (al_get_current_display()) {
+      ALLEGRO_ERROR("The calling thread already has a current display.\n");
+      return false;
+   }
+   if (!(display->flags & ALLEGRO_OPENGL) || !display->bitmaps_mutex)
+      return false;
+
+   o = display->ogl_extras;
+
+   al_lock_mutex(display->bitmaps_mutex);
+   for (i = 0; i < o->num_upload_contexts; i++) {
+      if (!o->upload_context_busy[i]) {
+         o->upload_context_busy[i] = true;
+         context = o->upload_contexts[i];
+         display->num_uploads++;
+         break;
+      }
+   }
+   al_unlock_mutex(display->bitmaps_mutex);
+
+   if (!context) {
+      ALLEGRO_WARN("All %d upload contexts are in use.\n",
+         o->num_upload_contexts);
+      return false;
+   }
+
+   if (!display->vt->make_upload_context_current(display, context)) {
+      ALLEGRO_ERROR("Could not make the upload context current.\n");
+      al_lock_mutex(display->bitmaps_mutex);
+      o->upload_context_busy[i] = false;
+      display->num_uploads--;
+      al_unlock_mutex(display->bitmaps_mutex);
+      return false;
+   }
+
+   _al_set_current_upload_context(display, context);
+   return true;
+}
+
+
+/* Blocks until the GPU is done with everything queued on this context, so
+ * that the objects are complete by the time another context uses them.
+ */
+static void wait_for_uploads(ALLEGRO_DISPLAY *display)
+{
+#if !defined(ALLEGRO_CFG_OPENGLES) && !defined(ALLEGRO_MACOSX)
+   if (display->ogl_extras->extension_list->ALLEGRO_GL_ARB_sync) {
+      GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      GLbitfield wait_flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+
+      if (fence) {
+         for (;;) {
+            GLenum r = glClientWaitSync(fence, wait_flags, 1000000000);
+            if (r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED)
+               break;
+            if (r == GL_WAIT_FAILED) {
+               ALLEGRO_WARN("glClientWaitSync failed.\n");
+               glFinish();
+               break;
+            }
+            wait_flags = 0;
+         }
+         glDeleteSync(fence);
+         return;
+      }
+   }
+#else
+   (void)display;
+#endif
+
+   glFinish();
+}
+
+
+/* Function: al_end_opengl_upload
+ */
+void al_end_opengl_upload(void)
+{
+   ALLEGRO_DISPLAY *display = al_get_current_display();
+   void *context = _al_get_current_upload_context();
+   ALLEGRO_OGL_EXTRAS *o;
+   int i;
+
+   if (!context)
+      return;
+
+   wait_for_uploads(display);
+   display->vt->make_upload_context_current(display, NULL);
+   _al_set_current_upload_context(NULL, NULL);
+
+   o = display->ogl_extras;
+   al_lock_mutex(display->bitmaps_mutex);
+   for (i = 0; i < o->num_upload_contexts; i++) {
+      if (o->upload_contexts[i] == context)
+         o->upload_context_busy[i] = false;
+   }
+   display->num_uploads--;
+   al_unlock_mutex(display->bitmaps_mutex);
+}
+
+
+/* Called by the display drivers while destroying the display. */
+void _al_ogl_destroy_upload_contexts(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_OGL_EXTRAS *o = display->ogl_extras;
+   int i;
+
+   if (!o)
+      return;
+
+   for (i = 0; i < o->num_upload_contexts; i++) {
+      if (o->upload_context_busy[i])
+         ALLEGRO_WARN("Destroying upload context %d while in use.\n", i);
+      display->vt->destroy_upload_context(display, o->upload_contexts[i]);
+   }
+   o->num_upload_contexts = 0;
+
+   if (display->bitmaps_mutex) {
+      al_destroy_mutex(display->bitmaps_mutex);
+      display->bitmaps_mutex = NULL;
+   }
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -19,28 +19,124 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_vector.h"
 #include "allegro5/internal/aintern_path.h"
+#include "allegro5/internal/aintern_pool.h"
 
 
-/* get_segment:
- *  Return the i'th directory component of a path.
+static _AL_POOL path_pool = _AL_POOL_INITIALIZER(ALLEGRO_PATH, "paths");
+
+
+/* The directory components are kept in a single string, each one followed
+ * by a NUL byte so that al_get_path_component can return a pointer into it,
+ * and their start offsets in a vector. Parsing, cloning and joining paths
+ * then copy whole strings instead of creating a string per component, and
+ * al_path_cstr only builds the full string again after the path changed.
+ */
+
+
+/* path_changed:
+ *  Called whenever any part of the path is modified.
  */
-static ALLEGRO_USTR *get_segment(const ALLEGRO_PATH *path, unsigned i)
+static void path_changed(ALLEGRO_PATH *path)
 {
-   ALLEGRO_USTR **seg = _al_vector_ref(&path->segments, i);
-   return *seg;
+   path->full_string_delim = -1;
+}
+
+
+/* num_segments:
+ *  Return the number of directory components.
+ */
+static int num_segments(const ALLEGRO_PATH *path)
+{
+   return _al_vector_size(&path->offsets);
+}
+
+
+/* segment_start:
+ *  Return the offset of the i'th directory component.
+ */
+static int segment_start(const ALLEGRO_PATH *path, int i)
+{
+   if (i >= num_segments(path))
+      return al_ustr_size(path->segments);
+   return *(int *)_al_vector_ref(&path->offsets, i);
+}
+
+
+/* segment_size:
+ *  Return the size of the i'th directory component in bytes.
+ */
+static int segment_size(const ALLEGRO_PATH *path, int i)
+{
+   return segment_start(path, i + 1) - segment_start(path, i) - 1;
 }
 
 
 /* get_segment_cstr:
  *  Return the i'th directory component of a path as a C string.
  */
-static const char *get_segment_cstr(const ALLEGRO_PATH *path, unsigned i)
+static const char *get_segment_cstr(const ALLEGRO_PATH *path, int i)
+{
+   return al_cstr(path->segments) + segment_start(path, i);
+}
+
+
+/* shift_segments:
+ *  Move the start of the directory components from the i'th on by delta.
+ */
+static void shift_segments(ALLEGRO_PATH *path, int i, int delta)
+{
+   for (; i < num_segments(path); i++) {
+      int *start = _al_vector_ref(&path->offsets, i);
+      *start += delta;
+   }
+}
+
+
+/* insert_segment:
+ *  Insert the size bytes at s as the i'th directory component.
+ */
+static void insert_segment(ALLEGRO_PATH *path, int i, const char *s, int size)
+{
+   ALLEGRO_USTR_INFO info;
+   int start = segment_start(path, i);
+   int *slot;
+
+   al_ustr_insert(path->segments, start, al_ref_buffer(&info, s, size));
+   al_ustr_insert_chr(path->segments, start + size, '\0');
+   shift_segments(path, i, size + 1);
+
+   slot = _al_vector_alloc_mid(&path->offsets, i);
+   *slot = start;
+   path_changed(path);
+}
+
+
+/* clear_path:
+ *  Make path empty, keeping the memory.
+ */
+static void clear_path(ALLEGRO_PATH *path)
+{
+   al_ustr_truncate(path->drive, 0);
+   al_ustr_truncate(path->filename, 0);
+   al_ustr_truncate(path->segments, 0);
+   while (!_al_vector_is_empty(&path->offsets))
+      _al_vector_delete_at(&path->offsets, _al_vector_size(&path->offsets) - 1);
+   path_changed(path);
+}
+
+
+/* is_dot_or_dotdot:
+ *  Return whether the size bytes at s are "." or "..".
+ */
+static bool is_dot_or_dotdot(const char *s, int size)
 {
-   return al_cstr(get_segment(path, i));
+   return (size == 1 && s[0] == '.') ||
+      (size == 2 && s[0] == '.' && s[1] == '.');
 }
 
 
@@ -78,12 +174,7 @@ static void replace_backslashes(ALLEGRO_USTR *path)
  */
 static bool parse_path_string(const ALLEGRO_USTR *str, ALLEGRO_PATH *path)
 {
-   ALLEGRO_USTR_INFO    dot_info;
-   ALLEGRO_USTR_INFO    dotdot_info;
-   const ALLEGRO_USTR *  dot = al_ref_cstr(&dot_info, ".");
-   const ALLEGRO_USTR *  dotdot = al_ref_cstr(&dotdot_info, "..");
-
-   ALLEGRO_USTR *piece = al_ustr_new("");
+   const char *cstr = al_cstr(str);
    int pos = 0;
    bool on_windows;
 
@@ -101,7 +192,7 @@ static bool parse_path_string(const ALLEGRO_USTR *str, ALLEGRO_PATH *path)
          int slash = al_ustr_find_chr(str, 2, '/');
          if (slash == -1 || slash == 2) {
             /* Missing slash or server component is empty. */
-            goto Error;
+            return false;
          }
          al_ustr_assign_substr(path->drive, str, pos, slash);
          // Note: The slash will be parsed again, so we end up with
@@ -124,30 +215,23 @@ static bool parse_path_string(const ALLEGRO_USTR *str, ALLEGRO_PATH *path)
 
       if (slash == -1) {
          /* Last component. */
-         al_ustr_assign_substr(piece, str, pos, al_ustr_size(str));
-         if (al_ustr_equal(piece, dot) || al_ustr_equal(piece, dotdot)) {
-            al_append_path_component(path, al_cstr(piece));
+         int size = al_ustr_size(str) - pos;
+         if (is_dot_or_dotdot(cstr + pos, size)) {
+            insert_segment(path, num_segments(path), cstr + pos, size);
          }
          else {
             /* This might be an empty string, but that's okay. */
-            al_ustr_assign(path->filename, piece);
+            al_ustr_assign_substr(path->filename, str, pos, pos + size);
          }
          break;
       }
 
       /* Non-last component. */
-      al_ustr_assign_substr(piece, str, pos, slash);
-      al_append_path_component(path, al_cstr(piece));
+      insert_segment(path, num_segments(path), cstr + pos, slash - pos);
       pos = slash + 1;
    }
 
-   al_ustr_free(piece);
    return true;
-
-Error:
-
-   al_ustr_free(piece);
-   return false;
 }
 
 
@@ -157,26 +241,22 @@ ALLEGRO_PATH *al_create_path(const char *str)
 {
    ALLEGRO_PATH *path;
 
-   path = al_malloc(sizeof(ALLEGRO_PATH));
+   path = _al_pool_alloc(&path_pool);
    if (!path)
       return NULL;
 
    path->drive = al_ustr_new("");
    path->filename = al_ustr_new("");
-   _al_vector_init(&path->segments, sizeof(ALLEGRO_USTR *));
-   path->basename = al_ustr_new("");
-   path->full_string = al_ustr_new("");
-
-   if (str != NULL) {
-      ALLEGRO_USTR *copy = al_ustr_new(str);
-      replace_backslashes(copy);
-
-      if (!parse_path_string(copy, path)) {
-         al_destroy_path(path);
-         path = NULL;
-      }
-
-      al_ustr_free(copy);
+   path->segments = al_ustr_new("");
+   _al_vector_init_inline(&path->offsets, sizeof(int), path->inline_offsets,
+      _AL_PATH_INLINE_COMPONENTS);
+   path->basename = NULL;
+   path->full_string = NULL;
+   path->full_string_delim = -1;
+
+   if (str != NULL && !al_assign_path_cstr(path, str)) {
+      al_destroy_path(path);
+      path = NULL;
    }
 
    return path;
@@ -189,10 +269,9 @@ ALLEGRO_PATH *al_create_path_for_directory(const char *str)
 {
    ALLEGRO_PATH *path = al_create_path(str);
    if (al_ustr_length(path->filename)) {
-      ALLEGRO_USTR *last = path->filename;
-      path->filename = al_ustr_new("");
-      al_append_path_component(path, al_cstr(last));
-      al_ustr_free(last);
+      insert_segment(path, num_segments(path), al_cstr(path->filename),
+         al_ustr_size(path->filename));
+      al_ustr_truncate(path->filename, 0);
    }
    return path;
 }
@@ -203,7 +282,6 @@ ALLEGRO_PATH *al_create_path_for_directory(const char *str)
 ALLEGRO_PATH *al_clone_path(const ALLEGRO_PATH *path)
 {
    ALLEGRO_PATH *clone;
-   unsigned int i;
 
    ASSERT(path);
 
@@ -212,15 +290,61 @@ ALLEGRO_PATH *al_clone_path(const ALLEGRO_PATH *path)
       return NULL;
    }
 
-   al_ustr_assign(clone->drive, path->drive);
-   al_ustr_assign(clone->filename, path->filename);
+   al_assign_path(clone, path);
+   return clone;
+}
+
+
+/* Function: al_assign_path
+ */
+void al_assign_path(ALLEGRO_PATH *path, const ALLEGRO_PATH *src)
+{
+   ASSERT(path);
+   ASSERT(src);
 
-   for (i = 0; i < _al_vector_size(&path->segments); i++) {
-      ALLEGRO_USTR **slot = _al_vector_alloc_back(&clone->segments);
-      (*slot) = al_ustr_dup(get_segment(path, i));
+   if (path == src)
+      return;
+
+   clear_path(path);
+   al_ustr_assign(path->drive, src->drive);
+   al_ustr_assign(path->filename, src->filename);
+   al_ustr_assign(path->segments, src->segments);
+   if (num_segments(src) > 0) {
+      _al_vector_append_array(&path->offsets, num_segments(src),
+         _al_vector_ref_front(&src->offsets));
    }
+}
 
-   return clone;
+
+/* Function: al_assign_path_cstr
+ */
+bool al_assign_path_cstr(ALLEGRO_PATH *path, const char *str)
+{
+   ALLEGRO_USTR_INFO info;
+   ALLEGRO_USTR *copy = NULL;
+   const ALLEGRO_USTR *us;
+   bool ret;
+
+   ASSERT(path);
+   ASSERT(str);
+
+   clear_path(path);
+
+   if (strchr(str, '\\')) {
+      copy = al_ustr_new(str);
+      replace_backslashes(copy);
+      us = copy;
+   }
+   else {
+      us = al_ref_cstr(&info, str);
+   }
+
+   ret = parse_path_string(us, path);
+   if (!ret)
+      clear_path(path);
+
+   al_ustr_free(copy);
+   return ret;
 }
 
 
@@ -230,7 +354,7 @@ int al_get_path_num_components(const ALLEGRO_PATH *path)
 {
    ASSERT(path);
 
-   return _al_vector_size(&path->segments);
+   return num_segments(path);
 }
 
 
@@ -239,10 +363,10 @@ int al_get_path_num_components(const ALLEGRO_PATH *path)
 const char *al_get_path_component(const ALLEGRO_PATH *path, int i)
 {
    ASSERT(path);
-   ASSERT(i < (int)_al_vector_size(&path->segments));
+   ASSERT(i < num_segments(path));
 
    if (i < 0)
-      i = _al_vector_size(&path->segments) + i;
+      i = num_segments(path) + i;
 
    ASSERT(i >= 0);
 
@@ -254,16 +378,25 @@ const char *al_get_path_component(const ALLEGRO_PATH *path, int i)
  */
 void al_replace_path_component(ALLEGRO_PATH *path, int i, const char *s)
 {
+   ALLEGRO_USTR_INFO info;
+   int start, size, new_size;
+
    ASSERT(path);
    ASSERT(s);
-   ASSERT(i < (int)_al_vector_size(&path->segments));
+   ASSERT(i < num_segments(path));
 
    if (i < 0)
-      i = _al_vector_size(&path->segments) + i;
+      i = num_segments(path) + i;
 
    ASSERT(i >= 0);
 
-   al_ustr_assign_cstr(get_segment(path, i), s);
+   start = segment_start(path, i);
+   size = segment_size(path, i);
+   new_size = strlen(s);
+   al_ustr_replace_range(path->segments, start, start + size,
+      al_ref_buffer(&info, s, new_size));
+   shift_segments(path, i + 1, new_size - size);
+   path_changed(path);
 }
 
 
@@ -271,16 +404,22 @@ void al_replace_path_component(ALLEGRO_PATH *path, int i, const char *s)
  */
 void al_remove_path_component(ALLEGRO_PATH *path, int i)
 {
+   int start, size;
+
    ASSERT(path);
-   ASSERT(i < (int)_al_vector_size(&path->segments));
+   ASSERT(i < num_segments(path));
 
    if (i < 0)
-      i = _al_vector_size(&path->segments) + i;
+      i = num_segments(path) + i;
 
    ASSERT(i >= 0);
 
-   al_ustr_free(get_segment(path, i));
-   _al_vector_delete_at(&path->segments, i);
+   start = segment_start(path, i);
+   size = segment_size(path, i);
+   al_ustr_remove_range(path->segments, start, start + size + 1);
+   shift_segments(path, i + 1, -(size + 1));
+   _al_vector_delete_at(&path->offsets, i);
+   path_changed(path);
 }
 
 
@@ -288,17 +427,15 @@ void al_remove_path_component(ALLEGRO_PATH *path, int i)
  */
 void al_insert_path_component(ALLEGRO_PATH *path, int i, const char *s)
 {
-   ALLEGRO_USTR **slot;
    ASSERT(path);
-   ASSERT(i <= (int)_al_vector_size(&path->segments));
+   ASSERT(i <= num_segments(path));
 
    if (i < 0)
-      i = _al_vector_size(&path->segments) + i;
+      i = num_segments(path) + i;
 
    ASSERT(i >= 0);
 
-   slot = _al_vector_alloc_mid(&path->segments, i);
-   (*slot) = al_ustr_new(s);
+   insert_segment(path, i, s, strlen(s));
 }
 
 
@@ -329,16 +466,14 @@ void al_drop_path_tail(ALLEGRO_PATH *path)
  */
 void al_append_path_component(ALLEGRO_PATH *path, const char *s)
 {
-   ALLEGRO_USTR **slot = _al_vector_alloc_back(&path->segments);
-   (*slot) = al_ustr_new(s);
+   insert_segment(path, num_segments(path), s, strlen(s));
 }
 
 
 static bool path_is_absolute(const ALLEGRO_PATH *path)
 {
    /* If the first segment is empty, we have an absolute path. */
-   return (_al_vector_size(&path->segments) > 0)
-      && (al_ustr_size(get_segment(path, 0)) == 0);
+   return (num_segments(path) > 0) && (segment_size(path, 0) == 0);
 }
 
 
@@ -346,7 +481,7 @@ static bool path_is_absolute(const ALLEGRO_PATH *path)
  */
 bool al_join_paths(ALLEGRO_PATH *path, const ALLEGRO_PATH *tail)
 {
-   unsigned i;
+   int n, i, size;
    ASSERT(path);
    ASSERT(tail);
 
@@ -361,10 +496,16 @@ bool al_join_paths(ALLEGRO_PATH *path, const ALLEGRO_PATH *tail)
 
    al_ustr_assign(path->filename, tail->filename);
 
-   for (i = 0; i < _al_vector_size(&tail->segments); i++) {
-      al_append_path_component(path, get_segment_cstr(tail, i));
+   /* Tail may be path itself. */
+   n = num_segments(tail);
+   size = al_ustr_size(path->segments);
+   al_ustr_append(path->segments, tail->segments);
+   for (i = 0; i < n; i++) {
+      int *slot = _al_vector_alloc_back(&path->offsets);
+      *slot = size + segment_start(tail, i);
    }
 
+   path_changed(path);
    return true;
 }
 
@@ -373,7 +514,7 @@ bool al_join_paths(ALLEGRO_PATH *path, const ALLEGRO_PATH *tail)
  */
 bool al_rebase_path(const ALLEGRO_PATH *head, ALLEGRO_PATH *tail)
 {
-   unsigned i;
+   int i, size;
    ASSERT(head);
    ASSERT(tail);
 
@@ -384,10 +525,15 @@ bool al_rebase_path(const ALLEGRO_PATH *head, ALLEGRO_PATH *tail)
 
    al_set_path_drive(tail, al_get_path_drive(head));
 
-   for (i = 0; i < _al_vector_size(&head->segments); i++) {
-      al_insert_path_component(tail, i, get_segment_cstr(head, i));
+   size = al_ustr_size(head->segments);
+   al_ustr_insert(tail->segments, 0, head->segments);
+   shift_segments(tail, 0, size);
+   for (i = 0; i < num_segments(head); i++) {
+      int *slot = _al_vector_alloc_mid(&tail->offsets, i);
+      *slot = segment_start(head, i);
    }
 
+   path_changed(tail);
    return true;
 }
 
@@ -395,13 +541,18 @@ bool al_rebase_path(const ALLEGRO_PATH *head, ALLEGRO_PATH *tail)
 static void path_to_ustr(const ALLEGRO_PATH *path, int32_t delim,
    ALLEGRO_USTR *str)
 {
-   unsigned i;
+   int start;
+   int i;
 
    al_ustr_assign(str, path->drive);
+   start = al_ustr_size(str);
+   al_ustr_append(str, path->segments);
 
-   for (i = 0; i < _al_vector_size(&path->segments); i++) {
-      al_ustr_append(str, get_segment(path, i));
-      al_ustr_append_chr(str, delim);
+   /* Going backwards, a delimiter of more than one byte does not move the
+    * NUL bytes still to be replaced.
+    */
+   for (i = num_segments(path) - 1; i >= 0; i--) {
+      al_ustr_set_chr(str, start + segment_start(path, i + 1) - 1, delim);
    }
 
    al_ustr_append(str, path->filename);
@@ -419,8 +570,17 @@ const char *al_path_cstr(const ALLEGRO_PATH *path, char delim)
  */
 const ALLEGRO_USTR *al_path_ustr(const ALLEGRO_PATH *path, char delim)
 {
-   path_to_ustr(path, delim, path->full_string);
-   return path->full_string;
+   /* Only the cached string changes. */
+   ALLEGRO_PATH *cache = (ALLEGRO_PATH *)path;
+
+   if (!cache->full_string)
+      cache->full_string = al_ustr_new("");
+
+   if (cache->full_string_delim != (unsigned char)delim) {
+      path_to_ustr(path, delim, cache->full_string);
+      cache->full_string_delim = (unsigned char)delim;
+   }
+   return cache->full_string;
 }
 
 
@@ -428,8 +588,6 @@ const ALLEGRO_USTR *al_path_ustr(const ALLEGRO_PATH *path, char delim)
  */
 void al_destroy_path(ALLEGRO_PATH *path)
 {
-   unsigned i;
-
    if (!path) {
       return;
    }
@@ -444,10 +602,11 @@ void al_destroy_path(ALLEGRO_PATH *path)
       path->filename = NULL;
    }
 
-   for (i = 0; i < _al_vector_size(&path->segments); i++) {
-      al_ustr_free(get_segment(path, i));
+   if (path->segments) {
+      al_ustr_free(path->segments);
+      path->segments = NULL;
    }
-   _al_vector_free(&path->segments);
+   _al_vector_free(&path->offsets);
 
    if (path->basename) {
       al_ustr_free(path->basename);
@@ -459,7 +618,7 @@ void al_destroy_path(ALLEGRO_PATH *path)
       path->full_string = NULL;
    }
 
-   al_free(path);
+   _al_pool_free(path);
 }
 
 
@@ -473,6 +632,7 @@ void al_set_path_drive(ALLEGRO_PATH *path, const char *drive)
       al_ustr_assign_cstr(path->drive, drive);
    else
       al_ustr_truncate(path->drive, 0);
+   path_changed(path);
 }
 
 
@@ -496,6 +656,7 @@ void al_set_path_filename(ALLEGRO_PATH *path, const char *filename)
       al_ustr_assign_cstr(path->filename, filename);
    else
       al_ustr_truncate(path->filename, 0);
+   path_changed(path);
 }
 
 
@@ -540,6 +701,7 @@ bool al_set_path_extension(ALLEGRO_PATH *path, char const *extension)
       al_ustr_truncate(path->filename, dot);
    }
    al_ustr_append_cstr(path->filename, extension);
+   path_changed(path);
    return true;
 }
 
@@ -553,8 +715,12 @@ const char *al_get_path_basename(const ALLEGRO_PATH *path)
 
    dot = al_ustr_rfind_chr(path->filename, al_ustr_size(path->filename), '.');
    if (dot >= 0) {
-      al_ustr_assign_substr(path->basename, path->filename, 0, dot);
-      return al_cstr(path->basename);
+      /* Only the cached string changes. */
+      ALLEGRO_PATH *cache = (ALLEGRO_PATH *)path;
+      if (!cache->basename)
+         cache->basename = al_ustr_new("");
+      al_ustr_assign_substr(cache->basename, path->filename, 0, dot);
+      return al_cstr(cache->basename);
    }
 
    return al_cstr(path->filename);
@@ -565,10 +731,10 @@ const char *al_get_path_basename(const ALLEGRO_PATH *path)
  */
 bool al_make_path_canonical(ALLEGRO_PATH *path)
 {
-   unsigned i;
+   int i;
    ASSERT(path);
 
-   for (i = 0; i < _al_vector_size(&path->segments); ) {
+   for (i = 0; i < num_segments(path); ) {
       if (strcmp(get_segment_cstr(path, i), ".") == 0)
          al_remove_path_component(path, i);
       else
@@ -576,10 +742,8 @@ bool al_make_path_canonical(ALLEGRO_PATH *path)
    }
 
    /* Remove leading '..'s on absolute paths. */
-   if (_al_vector_size(&path->segments) >= 1 &&
-      al_ustr_size(get_segment(path, 0)) == 0)
-   {
-      while (_al_vector_size(&path->segments) >= 2 &&
+   if (path_is_absolute(path)) {
+      while (num_segments(path) >= 2 &&
          strcmp(get_segment_cstr(path, 1), "..") == 0)
       {
          al_remove_path_component(path, 1);
@@ -56,6 +56,16 @@ static int pixel_sizes[] = {
    0,
    0,
    0,
+   0,
+   0,
+   0,
+   0,
+   0,
+   0,
+   0,
+   0,
+   4, /* ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB */
+   4, /* ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB */
 };
 
 static int pixel_bits[] = {
@@ -90,6 +100,16 @@ static int pixel_bits[] = {
    0,
    0,
    0,
+   0,
+   0,
+   0,
+   0,
+   0,
+   0,
+   0,
+   0,
+   32, /* ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB */
+   32, /* ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB */
 };
 
 static int pixel_block_widths[] = {
@@ -124,6 +144,16 @@ static int pixel_block_widths[] = {
    4,
    4,
    4,
+   4, /* ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4 */
+   4,
+   4,
+   4,
+   4,
+   4,
+   6,
+   8,
+   1, /* ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB */
+   1, /* ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB */
 };
 
 static int pixel_block_heights[] = {
@@ -158,6 +188,16 @@ static int pixel_block_heights[] = {
    4,
    4,
    4,
+   4, /* ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4 */
+   4,
+   4,
+   4,
+   4,
+   4,
+   6,
+   8,
+   1, /* ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB */
+   1, /* ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB */
 };
 
 static int pixel_block_sizes[] = {
@@ -192,6 +232,16 @@ static int pixel_block_sizes[] = {
    8,
    16,
    16,
+   8,  /* ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4 */
+   16,
+   16,
+   8,
+   16,
+   16,
+   16,
+   16,
+   4, /* ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB */
+   4, /* ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB */
 };
 
 static bool format_alpha_table[ALLEGRO_NUM_PIXEL_FORMATS] = {
@@ -226,6 +276,16 @@ static bool format_alpha_table[ALLEGRO_NUM_PIXEL_FORMATS] = {
    true,
    true,
    true,
+   false, /* ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4 */
+   false,
+   true,
+   false,
+   true,
+   true,
+   true,
+   true,
+   true, /* ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB */
+   true, /* ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB */
 };
 
 static char const *pixel_format_names[ALLEGRO_NUM_PIXEL_FORMATS + 1] = {
@@ -260,6 +320,16 @@ static char const *pixel_format_names[ALLEGRO_NUM_PIXEL_FORMATS + 1] = {
    "RGBA_DXT1",
    "RGBA_DXT3",
    "RGBA_DXT5",
+   "R_BC4",
+   "RG_BC5",
+   "RGBA_BC7",
+   "RGB_ETC2",
+   "RGBA_ETC2",
+   "RGBA_ASTC_4x4",
+   "RGBA_ASTC_6x6",
+   "RGBA_ASTC_8x8",
+   "ARGB_8888_SRGB",
+   "ABGR_8888_SRGB",
    "INVALID"
 };
 
@@ -296,6 +366,16 @@ static bool format_is_real[ALLEGRO_NUM_PIXEL_FORMATS] =
    true,
    true,
    true,
+   true, /* ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4 */
+   true,
+   true,
+   true,
+   true,
+   true,
+   true,
+   true,
+   true, /* ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB */
+   true, /* ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB */
 };
 
 static bool format_is_video_only[ALLEGRO_NUM_PIXEL_FORMATS] =
@@ -331,6 +411,16 @@ static bool format_is_video_only[ALLEGRO_NUM_PIXEL_FORMATS] =
    true,
    true,
    true,
+   true, /* ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4 */
+   true,
+   true,
+   true,
+   true,
+   true,
+   true,
+   true,
+   false, /* ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB */
+   false, /* ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB */
 };
 
 static bool format_is_compressed[ALLEGRO_NUM_PIXEL_FORMATS] =
@@ -366,6 +456,16 @@ static bool format_is_compressed[ALLEGRO_NUM_PIXEL_FORMATS] =
    true,
    true,
    true,
+   true, /* ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4 */
+   true,
+   true,
+   true,
+   true,
+   true,
+   true,
+   true,
+   false, /* ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB */
+   false, /* ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB */
 };
 
 
@@ -439,6 +539,15 @@ bool _al_pixel_format_is_compressed(int format)
    return format_is_compressed[format];
 }
 
+/* The sRGB formats store the same bytes as their plain counterparts, only
+ * the video drivers treat them differently.
+ */
+bool _al_pixel_format_is_srgb(int format)
+{
+   return format == ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB ||
+      format == ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB;
+}
+
 
 /* We use al_get_display_format() as a hint for the preferred RGB ordering when
  * nothing else is specified.
@@ -0,0 +1,352 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Profiling zones.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <stdlib.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_tls.h"
+
+ALLEGRO_DEBUG_CHANNEL("profile")
+
+
+/*
+ * Every thread that records a zone gets a PROFILE_THREAD, linked into a
+ * global list so that al_save_profile_trace can find it. al_profile_begin
+ * only pushes onto a small stack; al_profile_end pops it and writes the
+ * finished zone into a ring buffer, overwriting the oldest zones once the
+ * ring is full. The ring is guarded by a mutex of its own, which is never
+ * contended except while saving.
+ *
+ * The buffers live until the system is shut down. Threads compare the
+ * generation of their buffer with the current one so that they do not use
+ * a buffer freed by an earlier shutdown.
+ */
+
+#define MAX_DEPTH       64
+#define DEFAULT_ZONES   16384
+
+typedef struct PROFILE_ZONE
+{
+   const char *name;
+   double start;
+   double duration;
+} PROFILE_ZONE;
+
+typedef struct PROFILE_THREAD
+{
+   struct PROFILE_THREAD *next;
+   int id;
+   int generation;
+   int session;
+
+   int depth;
+   const char *stack_name[MAX_DEPTH];
+   double stack_start[MAX_DEPTH];
+
+   _AL_MUTEX mutex;
+   PROFILE_ZONE *zones;
+   unsigned int capacity;
+   unsigned int count;  /* zones written, at most capacity */
+   unsigned int next_zone;
+} PROFILE_THREAD;
+
+static volatile bool profiling_enabled = false;
+static ALLEGRO_MUTEX *threads_mutex = NULL;
+static PROFILE_THREAD *first_thread = NULL;
+static int num_threads = 0;
+static int generation = 1;
+static int session = 0;
+static double start_time = 0.0;
+
+
+static void shutdown_profiling(void)
+{
+   PROFILE_THREAD *pt, *next;
+
+   profiling_enabled = false;
+
+   for (pt = first_thread; pt; pt = next) {
+      next = pt->next;
+      _al_mutex_destroy(&pt->mutex);
+      al_free(pt->zones);
+      al_free(pt);
+   }
+   first_thread = NULL;
+   num_threads = 0;
+   generation++;
+
+   al_destroy_mutex(threads_mutex);
+   threads_mutex = NULL;
+}
+
+
+static unsigned int get_zones_per_thread(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "trace",
+      "profile_zones");
+   int zones = value ? atoi(value) : DEFAULT_ZONES;
+
+   if (zones < 16) {
+      ALLEGRO_WARN("profile_zones must be at least 16, got %s.\n", value);
+      zones = 16;
+   }
+   return zones;
+}
+
+
+static PROFILE_THREAD *create_thread_buffer(void)
+{
+   PROFILE_THREAD *pt = al_calloc(1, sizeof *pt);
+
+   if (!pt)
+      return NULL;
+
+   pt->capacity = get_zones_per_thread();
+   pt->zones = al_malloc(pt->capacity * sizeof *pt->zones);
+   if (!pt->zones) {
+      al_free(pt);
+      return NULL;
+   }
+   _AL_MARK_MUTEX_UNINITED(pt->mutex);
+   _al_mutex_init(&pt->mutex);
+
+   al_lock_mutex(threads_mutex);
+   pt->id = ++num_threads;
+   pt->generation = generation;
+   pt->session = session;
+   pt->next = first_thread;
+   first_thread = pt;
+   al_unlock_mutex(threads_mutex);
+
+   return pt;
+}
+
+
+static PROFILE_THREAD *get_thread_buffer(void)
+{
+   PROFILE_THREAD *pt = _al_tls_get_profile_thread();
+
+   if (!pt || pt->generation != generation) {
+      pt = create_thread_buffer();
+      _al_tls_set_profile_thread(pt);
+   }
+   else if (pt->session != session) {
+      /* Zones begun before profiling was last enabled never end. */
+      pt->depth = 0;
+      pt->session = session;
+   }
+   return pt;
+}
+
+
+/* Function: al_set_profiling_enabled
+ */
+bool al_set_profiling_enabled(bool enabled)
+{
+   if (enabled && !threads_mutex) {
+      threads_mutex = al_create_mutex();
+      if (!threads_mutex)
+         return false;
+      _al_add_exit_func(shutdown_profiling, "shutdown_profiling");
+      start_time = al_get_time();
+   }
+   if (enabled && !profiling_enabled)
+      session++;
+   profiling_enabled = enabled;
+   return true;
+}
+
+
+/* Function: al_is_profiling_enabled
+ */
+bool al_is_profiling_enabled(void)
+{
+   return profiling_enabled;
+}
+
+
+/* Function: al_profile_begin
+ */
+void al_profile_begin(const char *name)
+{
+   PROFILE_THREAD *pt;
+
+   if (!profiling_enabled)
+      return;
+
+   pt = get_thread_buffer();
+   if (!pt)
+      return;
+
+   /* Zones nested too deeply are counted but not recorded. */
+   if (pt->depth < MAX_DEPTH) {
+      pt->stack_name[pt->depth] = name;
+      pt->stack_start[pt->depth] = al_get_time();
+   }
+   pt->depth++;
+}
+
+
+/* Function: al_profile_end
+ */
+void al_profile_end(void)
+{
+   PROFILE_THREAD *pt;
+   PROFILE_ZONE *zone;
+   double now;
+
+   if (!profiling_enabled)
+      return;
+
+   pt = get_thread_buffer();
+   if (!pt || pt->depth == 0)
+      return;
+
+   pt->depth--;
+   if (pt->depth >= MAX_DEPTH)
+      return;
+
+   now = al_get_time();
+
+   _al_mutex_lock(&pt->mutex);
+   zone = &pt->zones[pt->next_zone];
+   zone->name = pt->stack_name[pt->depth];
+   zone->start = pt->stack_start[pt->depth];
+   zone->duration = now - zone->start;
+   if (++pt->next_zone == pt->capacity)
+      pt->next_zone = 0;
+   if (pt->count < pt->capacity)
+      pt->count++;
+   _al_mutex_unlock(&pt->mutex);
+}
+
+
+/* Function: al_clear_profile
+ */
+void al_clear_profile(void)
+{
+   PROFILE_THREAD *pt;
+
+   if (!threads_mutex)
+      return;
+
+   al_lock_mutex(threads_mutex);
+   for (pt = first_thread; pt; pt = pt->next) {
+      _al_mutex_lock(&pt->mutex);
+      pt->count = 0;
+      pt->next_zone = 0;
+      _al_mutex_unlock(&pt->mutex);
+   }
+   al_unlock_mutex(threads_mutex);
+}
+
+
+static void write_json_string(ALLEGRO_FILE *f, const char *s)
+{
+   al_fputc(f, '"');
+   for (; *s; s++) {
+      unsigned char c = *s;
+      if (c == '"' || c == '\\') {
+         al_fputc(f, '\\');
+         al_fputc(f, c);
+      }
+      else if (c < 0x20) {
+         al_fprintf(f, "\\u%04x", c);
+      }
+      else {
+         al_fputc(f, c);
+      }
+   }
+   al_fputc(f, '"');
+}
+
+
+static void write_thread(ALLEGRO_FILE *f, PROFILE_THREAD *pt, bool *first)
+{
+   unsigned int i, index;
+
+   _al_mutex_lock(&pt->mutex);
+
+   al_fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+      "\"tid\":%d,\"args\":{\"name\":\"Thread %d\"}}",
+      *first ? "" : ",", pt->id, pt->id);
+   *first = false;
+
+   index = (pt->next_zone + pt->capacity - pt->count) % pt->capacity;
+   for (i = 0; i < pt->count; i++) {
+      PROFILE_ZONE *zone = &pt->zones[index];
+      al_fputs(f, ",\n{\"name\":");
+      write_json_string(f, zone->name ? zone->name : "");
+      al_fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+         "\"ts\":%.3f,\"dur\":%.3f}",
+         pt->id,
+         (zone->start - start_time) * 1e6,
+         zone->duration * 1e6);
+      if (++index == pt->capacity)
+         index = 0;
+   }
+
+   _al_mutex_unlock(&pt->mutex);
+}
+
+
+/* Function: al_save_profile_trace_f
+ */
+bool al_save_profile_trace_f(ALLEGRO_FILE *f)
+{
+   PROFILE_THREAD *pt;
+   bool first = true;
+
+   ASSERT(f);
+
+   al_fputs(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+   if (threads_mutex) {
+      al_lock_mutex(threads_mutex);
+      for (pt = first_thread; pt; pt = pt->next)
+         write_thread(f, pt, &first);
+      al_unlock_mutex(threads_mutex);
+   }
+   al_fputs(f, "\n]}\n");
+
+   return !al_ferror(f);
+}
+
+
+/* Function: al_save_profile_trace
+ */
+bool al_save_profile_trace(const char *filename)
+{
+   ALLEGRO_FILE *f;
+   bool ret;
+
+   ASSERT(filename);
+
+   f = al_fopen(filename, "wb");
+   if (!f) {
+      ALLEGRO_ERROR("Unable to open %s for writing.\n", filename);
+      return false;
+   }
+
+   ret = al_save_profile_trace_f(f);
+   if (!al_fclose(f))
+      ret = false;
+
+   return ret;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -2,6 +2,7 @@
 
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_opengl.h"
+#include "allegro5/allegro_raspberrypi.h"
 #include "allegro5/internal/aintern_opengl.h"
 #include "allegro5/internal/aintern_vector.h"
 #include "allegro5/internal/aintern_raspberrypi.h"
@@ -15,6 +16,9 @@
 #include <bcm_host.h>
 
 #include "picursor.h"
+
+ALLEGRO_DEBUG_CHANNEL("display")
+
 #define DEFAULT_CURSOR_WIDTH 17
 #define DEFAULT_CURSOR_HEIGHT 28
 
@@ -23,6 +27,8 @@ static ALLEGRO_DISPLAY_INTERFACE *vt;
 static EGLDisplay egl_display;
 static EGLSurface egl_window;
 static EGLContext egl_context;
+static EGLConfig egl_config;
+static EGLint egl_context_version;
 static DISPMANX_UPDATE_HANDLE_T dispman_update;
 static DISPMANX_RESOURCE_HANDLE_T cursor_resource;
 static DISPMANX_DISPLAY_HANDLE_T dispman_display;
@@ -168,6 +174,12 @@ static void hide_cursor(ALLEGRO_DISPLAY_RASPBERRYPI *d)
    cursor_added = false;
 }
 
+/* The overlays are elements on the same dispmanx display. */
+uint32_t _al_raspberrypi_get_dispmanx_display(void)
+{
+   return dispman_display;
+}
+
 /* Helper to set up GL state as we want it. */
 static void setup_gl(ALLEGRO_DISPLAY *d)
 {
@@ -315,6 +327,7 @@ static bool pi_create_display(ALLEGRO_DISPLAY *display)
    if (!eglChooseConfig(egl_display, attrib_list, &config, 1, &num_configs)) {
       return false;
    }
+   egl_config = config;
 
    eglBindAPI(EGL_OPENGL_ES_API);
 
@@ -327,6 +340,7 @@ static bool pi_create_display(ALLEGRO_DISPLAY *display)
    };
 
    ctxattr[1] = es_ver;
+   egl_context_version = es_ver;
 
    egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, ctxattr);
    if (egl_context == EGL_NO_CONTEXT) {
@@ -415,6 +429,8 @@ static ALLEGRO_DISPLAY *raspberrypi_create_display(int w, int h)
     /* Each display is an event source. */
     _al_event_source_init(&display->es);
 
+    _al_vector_init(&d->overlays, sizeof(ALLEGRO_RASPBERRYPI_OVERLAY *));
+
     display->extra_settings.settings[ALLEGRO_COMPATIBLE_DISPLAY] = 1;
 
    display->w = w;
@@ -497,6 +513,7 @@ static void raspberrypi_destroy_display(ALLEGRO_DISPLAY *d)
 
    hide_cursor(pidisplay);
    delete_cursor_data(pidisplay);
+   _al_raspberrypi_destroy_overlays(pidisplay);
 
    _al_set_current_display_only(d);
 
@@ -506,6 +523,8 @@ static void raspberrypi_destroy_display(ALLEGRO_DISPLAY *d)
       _al_convert_to_memory_bitmap(b);
    }
 
+   _al_ogl_destroy_upload_contexts(d);
+
    _al_event_source_free(&d->es);
 
    ALLEGRO_SYSTEM_RASPBERRYPI *system = (void *)al_get_system_driver();
@@ -528,6 +547,75 @@ static void raspberrypi_destroy_display(ALLEGRO_DISPLAY *d)
    }
 }
 
+/* A context sharing the display's objects, made current on a 1x1 pbuffer. */
+typedef struct PI_UPLOAD_CONTEXT
+{
+   EGLContext context;
+   EGLSurface surface;
+} PI_UPLOAD_CONTEXT;
+
+static void raspberrypi_destroy_upload_context(ALLEGRO_DISPLAY *d,
+   void *context)
+{
+   PI_UPLOAD_CONTEXT *uc = context;
+   (void)d;
+
+   if (uc->surface != EGL_NO_SURFACE)
+      eglDestroySurface(egl_display, uc->surface);
+   if (uc->context != EGL_NO_CONTEXT)
+      eglDestroyContext(egl_display, uc->context);
+   al_free(uc);
+}
+
+static void *raspberrypi_create_upload_context(ALLEGRO_DISPLAY *d)
+{
+   const EGLint ctxattr[] = {
+      EGL_CONTEXT_CLIENT_VERSION, egl_context_version,
+      EGL_NONE
+   };
+   const EGLint surfattr[] = {
+      EGL_WIDTH, 1,
+      EGL_HEIGHT, 1,
+      EGL_NONE
+   };
+   PI_UPLOAD_CONTEXT *uc;
+   EGLint surface_type = 0;
+
+   eglGetConfigAttrib(egl_display, egl_config, EGL_SURFACE_TYPE, &surface_type);
+   if (!(surface_type & EGL_PBUFFER_BIT)) {
+      ALLEGRO_WARN("The display's EGL config does not support pbuffers.\n");
+      return NULL;
+   }
+
+   uc = al_calloc(1, sizeof(*uc));
+   if (!uc)
+      return NULL;
+
+   uc->context = eglCreateContext(egl_display, egl_config, egl_context,
+      ctxattr);
+   uc->surface = eglCreatePbufferSurface(egl_display, egl_config, surfattr);
+   if (uc->context == EGL_NO_CONTEXT || uc->surface == EGL_NO_SURFACE) {
+      ALLEGRO_ERROR("Failed to create an upload context.\n");
+      raspberrypi_destroy_upload_context(d, uc);
+      return NULL;
+   }
+
+   return uc;
+}
+
+static bool raspberrypi_make_upload_context_current(ALLEGRO_DISPLAY *d,
+   void *context)
+{
+   PI_UPLOAD_CONTEXT *uc = context;
+   (void)d;
+
+   if (!uc) {
+      return eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+         EGL_NO_CONTEXT);
+   }
+   return eglMakeCurrent(egl_display, uc->surface, uc->surface, uc->context);
+}
+
 static bool raspberrypi_set_current_display(ALLEGRO_DISPLAY *d)
 {
    (void)d;
@@ -655,6 +743,68 @@ static void raspberrypi_update_display_region(ALLEGRO_DISPLAY *d, int x, int y,
     raspberrypi_flip_display(d);
 }
 
+/* EGL_KHR_swap_buffers_with_damage, looked up on first use. Older EGL
+ * headers don't declare it, so we have our own typedef.
+ */
+typedef EGLBoolean (*SWAP_BUFFERS_WITH_DAMAGE)(EGLDisplay dpy,
+   EGLSurface surface, EGLint *rects, EGLint n_rects);
+
+static SWAP_BUFFERS_WITH_DAMAGE get_swap_buffers_with_damage(void)
+{
+   static SWAP_BUFFERS_WITH_DAMAGE swap_with_damage;
+   static bool looked_up = false;
+
+   if (!looked_up) {
+      const char *ext = eglQueryString(egl_display, EGL_EXTENSIONS);
+      if (ext && strstr(ext, "EGL_KHR_swap_buffers_with_damage")) {
+         swap_with_damage = (SWAP_BUFFERS_WITH_DAMAGE)
+            eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+      }
+      else if (ext && strstr(ext, "EGL_EXT_swap_buffers_with_damage")) {
+         swap_with_damage = (SWAP_BUFFERS_WITH_DAMAGE)
+            eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+      }
+      ALLEGRO_DEBUG("eglSwapBuffersWithDamage: %s\n",
+         swap_with_damage ? "yes" : "no");
+      looked_up = true;
+   }
+   return swap_with_damage;
+}
+
+static void raspberrypi_flip_display_regions(ALLEGRO_DISPLAY *d,
+   const int *rects, int num_rects)
+{
+   SWAP_BUFFERS_WITH_DAMAGE swap_with_damage = get_swap_buffers_with_damage();
+   EGLint *damage;
+   int i;
+
+   if (!swap_with_damage) {
+      raspberrypi_flip_display(d);
+      return;
+   }
+
+   damage = al_malloc(num_rects * 4 * sizeof(EGLint));
+   if (!damage) {
+      raspberrypi_flip_display(d);
+      return;
+   }
+
+   /* EGL counts y from the bottom. */
+   for (i = 0; i < num_rects; i++) {
+      const int *r = rects + i * 4;
+      damage[i * 4 + 0] = r[0];
+      damage[i * 4 + 1] = d->h - r[1] - r[3];
+      damage[i * 4 + 2] = r[2];
+      damage[i * 4 + 3] = r[3];
+   }
+   swap_with_damage(egl_display, egl_window, damage, num_rects);
+   al_free(damage);
+
+   if (cursor_added) {
+      show_cursor((ALLEGRO_DISPLAY_RASPBERRYPI *)d);
+   }
+}
+
 static bool raspberrypi_acknowledge_resize(ALLEGRO_DISPLAY *d)
 {
    setup_gl(d);
@@ -724,6 +874,7 @@ ALLEGRO_DISPLAY_INTERFACE *_al_get_raspberrypi_display_interface(void)
     vt->set_current_display = raspberrypi_set_current_display;
     vt->flip_display = raspberrypi_flip_display;
     vt->update_display_region = raspberrypi_update_display_region;
+    vt->flip_display_regions = raspberrypi_flip_display_regions;
     vt->acknowledge_resize = raspberrypi_acknowledge_resize;
     vt->create_bitmap = _al_ogl_create_bitmap;
     vt->get_backbuffer = _al_ogl_get_backbuffer;
@@ -743,6 +894,9 @@ ALLEGRO_DISPLAY_INTERFACE *_al_get_raspberrypi_display_interface(void)
     vt->wait_for_vsync = raspberrypi_wait_for_vsync;
 
     vt->update_render_state = _al_ogl_update_render_state;
+    vt->create_upload_context = raspberrypi_create_upload_context;
+    vt->make_upload_context_current = raspberrypi_make_upload_context_current;
+    vt->destroy_upload_context = raspberrypi_destroy_upload_context;
 
     _al_ogl_add_drawing_functions(vt);
 
@@ -0,0 +1,331 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Raspberry Pi overlays composed by the display hardware.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_raspberrypi.h"
+#include "allegro5/internal/aintern_raspberrypi.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_vector.h"
+
+#include <bcm_host.h>
+
+ALLEGRO_DEBUG_CHANNEL("display")
+
+#define ELEMENT_CHANGE_OPACITY   (1 << 1)
+#define ELEMENT_CHANGE_DEST_RECT (1 << 2)
+
+/* Each overlay is a dispmanx element of its own, which the HVS blends with
+ * the EGL surface while scanning out, so it costs no GPU time. There are two
+ * resources: one is on screen while the other one is written.
+ */
+struct ALLEGRO_RASPBERRYPI_OVERLAY
+{
+   ALLEGRO_DISPLAY *display;
+   int layer;
+   int width, height;
+   int pitch;
+   uint32_t *buffer;       /* the rows are copied here before uploading */
+   DISPMANX_RESOURCE_HANDLE_T resources[2];
+   int back;
+   DISPMANX_ELEMENT_HANDLE_T element;
+   int x, y, w, h;         /* in display coordinates */
+   uint8_t opacity;
+
+   /* An update is pending until the vertical blank it takes effect in. */
+   _AL_MUTEX mutex;
+   _AL_COND cond;
+   bool pending;
+};
+
+
+static void update_done(DISPMANX_UPDATE_HANDLE_T update, void *arg)
+{
+   ALLEGRO_RASPBERRYPI_OVERLAY *overlay = arg;
+   (void)update;
+
+   _al_mutex_lock(&overlay->mutex);
+   overlay->pending = false;
+   _al_cond_broadcast(&overlay->cond);
+   _al_mutex_unlock(&overlay->mutex);
+}
+
+
+static void wait_for_update(ALLEGRO_RASPBERRYPI_OVERLAY *overlay)
+{
+   _al_mutex_lock(&overlay->mutex);
+   while (overlay->pending)
+      _al_cond_wait(&overlay->cond, &overlay->mutex);
+   _al_mutex_unlock(&overlay->mutex);
+}
+
+
+/* submit:
+ *  Submit the update without waiting for the vertical blank. The next one
+ *  has to wait for this one, so that the resource taken off the screen is
+ *  not written while it is still shown.
+ */
+static void submit(ALLEGRO_RASPBERRYPI_OVERLAY *overlay,
+   DISPMANX_UPDATE_HANDLE_T update)
+{
+   _al_mutex_lock(&overlay->mutex);
+   overlay->pending = true;
+   _al_mutex_unlock(&overlay->mutex);
+
+   if (vc_dispmanx_update_submit(update, update_done, overlay) != 0) {
+      ALLEGRO_WARN("vc_dispmanx_update_submit failed.\n");
+      update_done(update, overlay);
+   }
+}
+
+
+/* get_dest_rect:
+ *  The EGL surface is scaled to the screen, so overlays are too.
+ */
+static void get_dest_rect(ALLEGRO_RASPBERRYPI_OVERLAY *overlay, VC_RECT_T *r)
+{
+   ALLEGRO_DISPLAY_RASPBERRYPI *d = (void *)overlay->display;
+   ALLEGRO_DISPLAY *display = overlay->display;
+
+   r->x = overlay->x * d->screen_width / display->w + d->cursor_offset_x;
+   r->y = overlay->y * d->screen_height / display->h + d->cursor_offset_y;
+   r->width = overlay->w * d->screen_width / display->w;
+   r->height = overlay->h * d->screen_height / display->h;
+}
+
+
+/* Function: al_create_raspberrypi_overlay
+ */
+ALLEGRO_RASPBERRYPI_OVERLAY *al_create_raspberrypi_overlay(
+   ALLEGRO_DISPLAY *display, int layer, int width, int height)
+{
+   ALLEGRO_DISPLAY_RASPBERRYPI *d = (void *)display;
+   ALLEGRO_RASPBERRYPI_OVERLAY *overlay;
+   ALLEGRO_RASPBERRYPI_OVERLAY **add;
+   uint32_t unused;
+   int i;
+
+   ASSERT(display);
+   ASSERT(width > 0 && height > 0);
+
+   overlay = al_calloc(1, sizeof(*overlay));
+   if (!overlay)
+      return NULL;
+
+   overlay->display = display;
+   overlay->layer = layer;
+   overlay->width = width;
+   overlay->height = height;
+   overlay->pitch = (width * 4 + 31) & ~31;
+   overlay->x = 0;
+   overlay->y = 0;
+   overlay->w = display->w;
+   overlay->h = display->h;
+   overlay->opacity = 255;
+
+   overlay->buffer = al_malloc(overlay->pitch * height);
+   if (!overlay->buffer) {
+      al_free(overlay);
+      return NULL;
+   }
+
+   for (i = 0; i < 2; i++) {
+      overlay->resources[i] = vc_dispmanx_resource_create(VC_IMAGE_ARGB8888,
+         width, height, &unused);
+      if (!overlay->resources[i]) {
+         ALLEGRO_ERROR("Could not create a %dx%d dispmanx resource.\n",
+            width, height);
+         if (i > 0)
+            vc_dispmanx_resource_delete(overlay->resources[0]);
+         al_free(overlay->buffer);
+         al_free(overlay);
+         return NULL;
+      }
+   }
+
+   _al_mutex_init(&overlay->mutex);
+   _al_cond_init(&overlay->cond);
+
+   add = _al_vector_alloc_back(&d->overlays);
+   *add = overlay;
+
+   return overlay;
+}
+
+
+/* Function: al_destroy_raspberrypi_overlay
+ */
+void al_destroy_raspberrypi_overlay(ALLEGRO_RASPBERRYPI_OVERLAY *overlay)
+{
+   ALLEGRO_DISPLAY_RASPBERRYPI *d;
+   DISPMANX_UPDATE_HANDLE_T update;
+
+   if (!overlay)
+      return;
+
+   d = (void *)overlay->display;
+   _al_vector_find_and_delete(&d->overlays, &overlay);
+
+   wait_for_update(overlay);
+
+   if (overlay->element) {
+      update = vc_dispmanx_update_start(0);
+      vc_dispmanx_element_remove(update, overlay->element);
+      vc_dispmanx_update_submit_sync(update);
+   }
+
+   vc_dispmanx_resource_delete(overlay->resources[0]);
+   vc_dispmanx_resource_delete(overlay->resources[1]);
+
+   _al_cond_destroy(&overlay->cond);
+   _al_mutex_destroy(&overlay->mutex);
+   al_free(overlay->buffer);
+   al_free(overlay);
+}
+
+
+/* _al_raspberrypi_destroy_overlays:
+ *  Destroy the overlays left over when the display is destroyed.
+ */
+void _al_raspberrypi_destroy_overlays(ALLEGRO_DISPLAY_RASPBERRYPI *d)
+{
+   while (_al_vector_is_nonempty(&d->overlays)) {
+      ALLEGRO_RASPBERRYPI_OVERLAY **overlay = _al_vector_ref_back(&d->overlays);
+      al_destroy_raspberrypi_overlay(*overlay);
+   }
+   _al_vector_free(&d->overlays);
+}
+
+
+/* Function: al_update_raspberrypi_overlay
+ */
+bool al_update_raspberrypi_overlay(ALLEGRO_RASPBERRYPI_OVERLAY *overlay,
+   ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_LOCKED_REGION *lr;
+   DISPMANX_UPDATE_HANDLE_T update;
+   DISPMANX_RESOURCE_HANDLE_T resource;
+   VC_RECT_T rect;
+   int w, h, y;
+
+   ASSERT(overlay);
+   ASSERT(bitmap);
+
+   w = _ALLEGRO_MIN(al_get_bitmap_width(bitmap), overlay->width);
+   h = _ALLEGRO_MIN(al_get_bitmap_height(bitmap), overlay->height);
+
+   lr = al_lock_bitmap_region(bitmap, 0, 0, w, h, ALLEGRO_PIXEL_FORMAT_ARGB_8888,
+      ALLEGRO_LOCK_READONLY);
+   if (!lr)
+      return false;
+
+   /* Locked video bitmaps are upside down, and dispmanx wants the rows
+    * aligned anyway.
+    */
+   for (y = 0; y < h; y++) {
+      memcpy((char *)overlay->buffer + y * overlay->pitch,
+         (char *)lr->data + y * lr->pitch, w * 4);
+   }
+   al_unlock_bitmap(bitmap);
+
+   wait_for_update(overlay);
+
+   resource = overlay->resources[overlay->back];
+   vc_dispmanx_rect_set(&rect, 0, 0, w, h);
+   if (vc_dispmanx_resource_write_data(resource, VC_IMAGE_ARGB8888,
+         overlay->pitch, overlay->buffer, &rect) != 0) {
+      ALLEGRO_ERROR("vc_dispmanx_resource_write_data failed.\n");
+      return false;
+   }
+
+   update = vc_dispmanx_update_start(0);
+
+   if (!overlay->element) {
+      VC_DISPMANX_ALPHA_T alpha = {
+         DISPMANX_FLAGS_ALPHA_FROM_SOURCE | DISPMANX_FLAGS_ALPHA_MIX |
+            DISPMANX_FLAGS_ALPHA_PREMULT,
+         overlay->opacity, 0
+      };
+      VC_RECT_T src, dst;
+
+      vc_dispmanx_rect_set(&src, 0, 0, overlay->width << 16,
+         overlay->height << 16);
+      get_dest_rect(overlay, &dst);
+      overlay->element = vc_dispmanx_element_add(update,
+         _al_raspberrypi_get_dispmanx_display(), overlay->layer, &dst,
+         resource, &src, DISPMANX_PROTECTION_NONE, &alpha, 0,
+         DISPMANX_NO_ROTATE);
+   }
+   else {
+      vc_dispmanx_element_change_source(update, overlay->element, resource);
+   }
+
+   submit(overlay, update);
+   overlay->back ^= 1;
+
+   return true;
+}
+
+
+/* Function: al_set_raspberrypi_overlay_region
+ */
+void al_set_raspberrypi_overlay_region(ALLEGRO_RASPBERRYPI_OVERLAY *overlay,
+   int x, int y, int w, int h)
+{
+   DISPMANX_UPDATE_HANDLE_T update;
+   VC_RECT_T src, dst;
+
+   ASSERT(overlay);
+
+   overlay->x = x;
+   overlay->y = y;
+   overlay->w = w;
+   overlay->h = h;
+
+   if (!overlay->element)
+      return;
+
+   wait_for_update(overlay);
+   vc_dispmanx_rect_set(&src, 0, 0, overlay->width << 16,
+      overlay->height << 16);
+   get_dest_rect(overlay, &dst);
+   update = vc_dispmanx_update_start(0);
+   vc_dispmanx_element_change_attributes(update, overlay->element,
+      ELEMENT_CHANGE_DEST_RECT, 0, 0, &dst, &src, 0, 0);
+   submit(overlay, update);
+}
+
+
+/* Function: al_set_raspberrypi_overlay_opacity
+ */
+void al_set_raspberrypi_overlay_opacity(ALLEGRO_RASPBERRYPI_OVERLAY *overlay,
+   float opacity)
+{
+   DISPMANX_UPDATE_HANDLE_T update;
+
+   ASSERT(overlay);
+
+   overlay->opacity = _ALLEGRO_CLAMP(0, (int)(opacity * 255.0f + 0.5f), 255);
+
+   if (!overlay->element)
+      return;
+
+   wait_for_update(overlay);
+   update = vc_dispmanx_update_start(0);
+   vc_dispmanx_element_change_attributes(update, overlay->element,
+      ELEMENT_CHANGE_OPACITY, 0, overlay->opacity, NULL, NULL, 0, 0);
+   submit(overlay, update);
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -198,6 +198,8 @@ ALLEGRO_SYSTEM_INTERFACE *_al_system_raspberrypi_driver(void)
    pi_vt->get_time = _al_unix_get_time;
    pi_vt->rest = _al_unix_rest;
    pi_vt->init_timeout = _al_unix_init_timeout;
+   pi_vt->rest_until = _al_unix_rest_until;
+   pi_vt->init_timeout_until = _al_unix_init_timeout_until;
 
    return pi_vt;
 }
@@ -24,6 +24,10 @@
 #include "allegro5/internal/aintern_shader.h"
 #include "allegro5/platform/allegro_internal_sdl.h"
 
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#endif
+
 ALLEGRO_DEBUG_CHANNEL("display")
 
 int _al_win_determine_adapter(void);
@@ -133,6 +137,9 @@ static ALLEGRO_DISPLAY *sdl_create_display_locked(int w, int h)
       SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
 #ifdef ALLEGRO_CFG_OPENGLES1
       SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 1);
+#elif defined(ALLEGRO_CFG_OPENGLES3)
+      /* WebGL 2 under Emscripten. */
+      SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
 #else
       SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
 #endif
@@ -315,13 +322,46 @@ static void sdl_unset_current_display(ALLEGRO_DISPLAY *d)
    (void)d;
 }
 
+#ifdef __EMSCRIPTEN__
+EM_ASYNC_JS(void, wait_for_animation_frame, (void), {
+   await new Promise(function(resolve) { requestAnimationFrame(resolve); });
+});
+
+/* flip_waits_for_animation_frame:
+ *  The browser only presents the canvas once the code returns to it. With
+ *  Asyncify, al_flip_display can do that itself, paced by
+ *  requestAnimationFrame, so that a normal game loop works without
+ *  emscripten_set_main_loop.
+ */
+static bool flip_waits_for_animation_frame(void)
+{
+   static int wait = -1;
+
+   if (wait < 0) {
+      const char *value = al_get_config_value(al_get_system_config(),
+         "emscripten", "wait_for_animation_frame");
+      wait = emscripten_has_asyncify() &&
+         !(value && _al_stricmp(value, "false") == 0);
+   }
+   return wait;
+}
+#endif
+
 static void sdl_flip_display(ALLEGRO_DISPLAY *d)
 {
    ALLEGRO_DISPLAY_SDL *sdl = (void *)d;
    SDL_GL_SwapWindow(sdl->window);
 
+#ifdef __EMSCRIPTEN__
+   /* WebGL keeps the textures until the context is lost, so there is no
+    * need to read back every drawn-to bitmap after each frame.
+    */
+   if (flip_waits_for_animation_frame())
+      wait_for_animation_frame();
+#else
    // SDL loses texture contents, for example on resize.
    al_backup_dirty_bitmaps(d);
+#endif
 }
 
 static void sdl_update_display_region(ALLEGRO_DISPLAY *d, int x, int y,
@@ -19,6 +19,7 @@
 #include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_shader.h"
 #include "allegro5/internal/aintern_system.h"
+#include "allegro5/internal/aintern_tls.h"
 
 #ifdef ALLEGRO_CFG_SHADER_GLSL
 #include "allegro5/allegro_opengl.h"
@@ -152,6 +153,8 @@ bool al_use_shader(ALLEGRO_SHADER *shader)
    ALLEGRO_BITMAP *bmp = al_get_target_bitmap();
    ALLEGRO_DISPLAY *disp;
 
+   _al_tls_forget_draw_state();
+
    if (!bmp) {
       ALLEGRO_WARN("No current target bitmap.\n");
       return false;
@@ -242,6 +245,8 @@ bool al_set_shader_sampler(const char *name,
 
    if ((bmp = al_get_target_bitmap()) != NULL) {
       if ((shader = bmp->shader) != NULL) {
+         if (bitmap)
+            _al_mark_bitmap_used(bitmap, _al_get_bitmap_display(bmp));
          return shader->vt->set_shader_sampler(shader, name, bitmap, unit);
       }
       else {
@@ -376,6 +381,34 @@ bool al_set_shader_bool(const char *name, bool b)
    }
 }
 
+/* Function: al_set_shader_uniform_block
+ */
+bool al_set_shader_uniform_block(const char *name, const void *data,
+   size_t size)
+{
+   ALLEGRO_BITMAP *bmp;
+   ALLEGRO_SHADER *shader;
+   ALLEGRO_DISPLAY *display;
+
+   ASSERT(name);
+   ASSERT(data);
+
+   if ((bmp = al_get_target_bitmap()) == NULL)
+      return false;
+
+   /* Blocks are shared by all shaders, so the default one will do. */
+   shader = bmp->shader;
+   if (!shader && (display = _al_get_bitmap_display(bmp)) != NULL)
+      shader = display->default_shader;
+
+   if (shader && shader->vt->set_shader_uniform_block) {
+      return shader->vt->set_shader_uniform_block(shader, name, data, size);
+   }
+   else {
+      return false;
+   }
+}
+
 /* Function: al_get_default_shader_source
  */
 char const *al_get_default_shader_source(ALLEGRO_SHADER_PLATFORM platform,
@@ -442,7 +475,7 @@ void _al_unregister_shader_bitmap(ALLEGRO_SHADER *shader, ALLEGRO_BITMAP *bmp)
    ASSERT(shader);
    ASSERT(bmp);
 
-   deleted = _al_vector_find_and_delete(&shader->bitmaps, &bmp);
+   deleted = _al_vector_find_and_delete_unordered(&shader->bitmaps, &bmp);
    ASSERT(deleted);
 }
 
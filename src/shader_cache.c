@@ -0,0 +1,178 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      On-disk cache of compiled shaders.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include <stdio.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_file.h"
+#include "allegro5/internal/aintern_fshook.h"
+#include "allegro5/internal/aintern_shader.h"
+
+ALLEGRO_DEBUG_CHANNEL("shader")
+
+/* Every cache file starts with this, followed by the 64 bit key and the
+ * 32 bit size of the data, all little endian.
+ */
+#define CACHE_MAGIC "A5SC"
+
+static char *cache_path;
+static bool cache_path_set;
+
+
+static void free_cache_path(void)
+{
+   al_free(cache_path);
+   cache_path = NULL;
+   cache_path_set = false;
+}
+
+
+/* Function: al_set_shader_cache_path
+ */
+void al_set_shader_cache_path(const char *path)
+{
+   if (!cache_path_set)
+      _al_add_exit_func(free_cache_path, "free_cache_path");
+
+   al_free(cache_path);
+   cache_path = NULL;
+   cache_path_set = true;
+
+   if (path && path[0]) {
+      cache_path = al_malloc(strlen(path) + 1);
+      if (cache_path)
+         strcpy(cache_path, path);
+   }
+}
+
+
+const char *_al_get_shader_cache_path(void)
+{
+   const char *path;
+
+   if (cache_path_set)
+      return cache_path;
+
+   path = al_get_config_value(al_get_system_config(), "shader", "cache_path");
+   return (path && path[0]) ? path : NULL;
+}
+
+
+uint64_t _al_shader_cache_hash(uint64_t hash, const void *data, size_t size)
+{
+   /* FNV-1a */
+   const unsigned char *p = data;
+   size_t i;
+
+   for (i = 0; i < size; i++) {
+      hash ^= p[i];
+      hash *= UINT64_C(1099511628211);
+   }
+   return hash;
+}
+
+
+static bool get_cache_file_name(uint64_t key, char *buf, size_t size)
+{
+   const char *path = _al_get_shader_cache_path();
+   if (!path)
+      return false;
+   snprintf(buf, size, "%s%c%08x%08x.bin", path, ALLEGRO_NATIVE_PATH_SEP,
+      (unsigned)(key >> 32), (unsigned)key);
+   return true;
+}
+
+
+void *_al_load_shader_cache(uint64_t key, size_t *size)
+{
+   char filename[PATH_MAX];
+   ALLEGRO_FILE *fp;
+   char magic[4];
+   void *data = NULL;
+   uint32_t data_size;
+
+   if (!get_cache_file_name(key, filename, sizeof(filename)))
+      return NULL;
+
+   fp = al_fopen_interface(&_al_file_interface_stdio, filename, "rb");
+   if (!fp)
+      return NULL;
+
+   if (al_fread(fp, magic, 4) != 4 || memcmp(magic, CACHE_MAGIC, 4) != 0 ||
+         (uint32_t)al_fread32le(fp) != (uint32_t)key ||
+         (uint32_t)al_fread32le(fp) != (uint32_t)(key >> 32)) {
+      ALLEGRO_WARN("Ignoring invalid shader cache file %s\n", filename);
+      goto done;
+   }
+
+   data_size = al_fread32le(fp);
+   if (al_feof(fp) || data_size == 0)
+      goto done;
+
+   data = al_malloc(data_size);
+   if (data && al_fread(fp, data, data_size) != data_size) {
+      ALLEGRO_WARN("Truncated shader cache file %s\n", filename);
+      al_free(data);
+      data = NULL;
+   }
+
+done:
+   al_fclose(fp);
+   if (data) {
+      ALLEGRO_DEBUG("Loaded %u bytes from %s\n", data_size, filename);
+      *size = data_size;
+   }
+   return data;
+}
+
+
+void _al_save_shader_cache(uint64_t key, const void *data, size_t size)
+{
+   char filename[PATH_MAX];
+   ALLEGRO_FILE *fp;
+   bool ok;
+
+   if (!get_cache_file_name(key, filename, sizeof(filename)))
+      return;
+
+   if (!_al_fs_interface_stdio.fs_filename_exists(_al_get_shader_cache_path()))
+      _al_fs_interface_stdio.fs_make_directory(_al_get_shader_cache_path());
+
+   fp = al_fopen_interface(&_al_file_interface_stdio, filename, "wb");
+   if (!fp) {
+      ALLEGRO_WARN("Could not create shader cache file %s\n", filename);
+      return;
+   }
+
+   ok = al_fwrite(fp, CACHE_MAGIC, 4) == 4 &&
+      al_fwrite32le(fp, (uint32_t)key) == 4 &&
+      al_fwrite32le(fp, (uint32_t)(key >> 32)) == 4 &&
+      al_fwrite32le(fp, (uint32_t)size) == 4 &&
+      al_fwrite(fp, data, size) == size;
+   ok = al_fclose(fp) && ok;
+
+   if (!ok) {
+      ALLEGRO_WARN("Could not write shader cache file %s\n", filename);
+      remove(filename);
+   }
+   else {
+      ALLEGRO_DEBUG("Saved %u bytes to %s\n", (unsigned)size, filename);
+   }
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -26,15 +26,20 @@
 #endif
 #include ALLEGRO_INTERNAL_HEADER
 #include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_cpu.h"
 #include "allegro5/internal/aintern_debug.h"
+#include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_file.h"
 #include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_pool.h"
 #include "allegro5/internal/aintern_system.h"
 #include "allegro5/internal/aintern_thread.h"
 #include "allegro5/internal/aintern_timer.h"
 #include "allegro5/internal/aintern_tls.h"
 #include "allegro5/internal/aintern_vector.h"
+#include "allegro5/internal/aintern_workers.h"
 
 ALLEGRO_DEBUG_CHANNEL("system")
 
@@ -218,6 +223,7 @@ bool al_install_system(int version, int (*atexit_ptr)(void (*)(void)))
    ALLEGRO_SYSTEM bootstrap;
    ALLEGRO_SYSTEM *real_system;
    int library_version = al_get_allegro_version();
+   double t0;
 
    if (active_sysdrv) {
       return true;
@@ -232,6 +238,7 @@ bool al_install_system(int version, int (*atexit_ptr)(void (*)(void)))
 
    _al_tls_init_once();
    _al_reinitialize_tls_values();
+   _al_init_pools();
 
    _al_vector_init(&_al_system_interfaces, sizeof(ALLEGRO_SYSTEM_INTERFACE *));
 
@@ -263,6 +270,7 @@ bool al_install_system(int version, int (*atexit_ptr)(void (*)(void)))
    
    active_sysdrv = real_system;
    active_sysdrv->mouse_wheel_precision = 1;
+   t0 = al_get_time();
 
    const char *min_bitmap_size = al_get_config_value(
       al_get_system_config(), "graphics", "min_bitmap_size");
@@ -280,12 +288,24 @@ bool al_install_system(int version, int (*atexit_ptr)(void (*)(void)))
 
    _al_init_events();
 
+   _al_init_display_modes();
+
    _al_init_iio_table();
+
+   _al_init_async_bitmap_loading();
+
+   _al_init_async_file_reading();
    
    _al_init_convert_bitmap_list();
 
+   _al_init_region_locks();
+
+   _al_init_convert_simd();
+
    _al_init_timers();
 
+   _al_init_workers();
+
 #ifdef ALLEGRO_CFG_SHADER_GLSL
    _al_glsl_init_shaders();
 #endif
@@ -293,6 +313,12 @@ bool al_install_system(int version, int (*atexit_ptr)(void (*)(void)))
    if (active_sysdrv->vt->heartbeat_init)
       active_sysdrv->vt->heartbeat_init();
 
+   /* Display and audio drivers are only probed when first used, and log
+    * their own times.
+    */
+   ALLEGRO_INFO("Core subsystems took %.2f ms to initialize.\n",
+      (al_get_time() - t0) * 1000.0);
+
    if (atexit_ptr && atexit_virgin) {
 #ifndef ALLEGRO_ANDROID
       atexit_ptr(al_uninstall_system);
@@ -329,6 +355,7 @@ void al_uninstall_system(void)
    _al_glsl_shutdown_shaders();
 #endif
 
+   _al_shutdown_pools();
    _al_shutdown_logging();
 
    /* shutdown_system_driver is registered as an exit func so we don't need
@@ -521,6 +548,26 @@ void al_rest(double seconds)
 }
 
 
+/* Internal function: _al_rest_until
+ *  Sleeps until al_get_time() reaches the given time.  System drivers
+ *  which can wait for an absolute deadline do so, which avoids the error
+ *  of converting the deadline to a relative interval first.
+ */
+void _al_rest_until(double time)
+{
+   ASSERT(active_sysdrv);
+
+   if (active_sysdrv->vt->rest_until) {
+      active_sysdrv->vt->rest_until(time);
+   }
+   else {
+      double seconds = time - al_get_time();
+      if (seconds > 0)
+         al_rest(seconds);
+   }
+}
+
+
 /* Function: al_init_timeout
  */
 void al_init_timeout(ALLEGRO_TIMEOUT *timeout, double seconds)
@@ -531,4 +578,62 @@ void al_init_timeout(ALLEGRO_TIMEOUT *timeout, double seconds)
       active_sysdrv->vt->init_timeout(timeout, seconds);
 }
 
+
+/* Function: al_init_timeout_until
+ */
+void al_init_timeout_until(ALLEGRO_TIMEOUT *timeout, double time)
+{
+   ASSERT(active_sysdrv);
+
+   if (active_sysdrv->vt->init_timeout_until)
+      active_sysdrv->vt->init_timeout_until(timeout, time);
+   else
+      al_init_timeout(timeout, time - al_get_time());
+}
+
+
+/* Set by the platform code from whatever thread the OS notifies. */
+static volatile int thermal_state = ALLEGRO_THERMAL_STATE_UNKNOWN;
+
+
+/* Function: al_get_thermal_state
+ */
+ALLEGRO_THERMAL_STATE al_get_thermal_state(void)
+{
+   return (ALLEGRO_THERMAL_STATE)thermal_state;
+}
+
+
+/* _al_set_thermal_state:
+ *  Record a new thermal state and tell all displays about it.
+ */
+void _al_set_thermal_state(int state)
+{
+   unsigned int i;
+
+   if (state == thermal_state)
+      return;
+
+   ALLEGRO_INFO("Thermal state %d\n", state);
+   thermal_state = state;
+
+   if (!active_sysdrv || !active_sysdrv->installed)
+      return;
+
+   for (i = 0; i < _al_vector_size(&active_sysdrv->displays); i++) {
+      ALLEGRO_DISPLAY **dptr = _al_vector_ref(&active_sysdrv->displays, i);
+      ALLEGRO_DISPLAY *display = *dptr;
+      ALLEGRO_EVENT event;
+
+      _al_event_source_lock(&display->es);
+      if (_al_event_source_needs_to_generate_event(&display->es)) {
+         event.display.type = ALLEGRO_EVENT_DISPLAY_THERMAL_STATE;
+         event.display.timestamp = al_get_time();
+         event.display.thermal_state = state;
+         _al_event_source_emit_event(&display->es, &event);
+      }
+      _al_event_source_unlock(&display->es);
+   }
+}
+
 /* vim: set sts=3 sw=3 et: */
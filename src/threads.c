@@ -80,6 +80,8 @@ static void thread_func_trampoline(_AL_THREAD *inner, void *_outer)
          ((void *(*)(ALLEGRO_THREAD *, void *))outer->proc)(outer, outer->arg);
    }
 
+   al_free_frame_arena();
+
    if (system && system->vt && system->vt->thread_exit) {
       system->vt->thread_exit(outer);
    }
@@ -92,6 +94,7 @@ static void detached_thread_func_trampoline(_AL_THREAD *inner, void *_outer)
    (void)inner;
 
    ((void *(*)(void *))outer->proc)(outer->arg);
+   al_free_frame_arena();
    al_free(outer);
 }
 
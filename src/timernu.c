@@ -34,7 +34,7 @@
 
 
 /* forward declarations */
-static void timer_handle_tick(ALLEGRO_TIMER *timer);
+static void timer_handle_tick(ALLEGRO_TIMER *timer, double error);
 
 
 struct ALLEGRO_TIMER
@@ -43,8 +43,10 @@ struct ALLEGRO_TIMER
    bool started;
    double speed_secs;
    int64_t count;
-   double counter;		/* counts down to zero=blastoff */
-   _AL_LIST_ITEM *dtor_item;
+   double counter;		/* time left to the next tick while stopped */
+   double deadline;		/* al_get_time() of the next tick while started */
+   int heap_index;		/* position in active_timers while started */
+   _AL_DTOR_ITEM *dtor_item;
 };
 
 
@@ -60,6 +62,121 @@ static ALLEGRO_COND *timer_cond = NULL;
 static bool destroy_thread = false;
 
 
+/* The timer thread waits on timer_cond until this long before the next
+ * deadline, so that it notices timers being started or changed, and then
+ * sleeps through the rest with _al_rest_until() for accuracy.  Condition
+ * variable timeouts are only millisecond precise on some platforms.
+ */
+#define TIMER_WAIT_SLACK 0.002
+
+
+
+/*
+ * active_timers is a binary min-heap ordered by deadline, so the timer
+ * thread only ever has to look at the front, and starting or stopping a
+ * timer is O(log n).  All of these must be called with timers_mutex held.
+ */
+
+static ALLEGRO_TIMER *heap_get(unsigned int i)
+{
+   ALLEGRO_TIMER **slot = _al_vector_ref(&active_timers, i);
+   return *slot;
+}
+
+
+static void heap_set(unsigned int i, ALLEGRO_TIMER *timer)
+{
+   ALLEGRO_TIMER **slot = _al_vector_ref(&active_timers, i);
+   *slot = timer;
+   timer->heap_index = i;
+}
+
+
+static void heap_sift_up(unsigned int i)
+{
+   ALLEGRO_TIMER *timer = heap_get(i);
+
+   while (i > 0) {
+      unsigned int parent = (i - 1) / 2;
+      ALLEGRO_TIMER *p = heap_get(parent);
+      if (p->deadline <= timer->deadline)
+         break;
+      heap_set(i, p);
+      i = parent;
+   }
+   heap_set(i, timer);
+}
+
+
+static void heap_sift_down(unsigned int i)
+{
+   unsigned int size = _al_vector_size(&active_timers);
+   ALLEGRO_TIMER *timer = heap_get(i);
+
+   for (;;) {
+      unsigned int child = 2 * i + 1;
+      ALLEGRO_TIMER *c;
+      if (child >= size)
+         break;
+      c = heap_get(child);
+      if (child + 1 < size && heap_get(child + 1)->deadline < c->deadline) {
+         child++;
+         c = heap_get(child);
+      }
+      if (timer->deadline <= c->deadline)
+         break;
+      heap_set(i, c);
+      i = child;
+   }
+   heap_set(i, timer);
+}
+
+
+static void heap_insert(ALLEGRO_TIMER *timer)
+{
+   _al_vector_alloc_back(&active_timers);
+   heap_set(_al_vector_size(&active_timers) - 1, timer);
+   heap_sift_up(timer->heap_index);
+}
+
+
+static void heap_remove(ALLEGRO_TIMER *timer)
+{
+   unsigned int i = timer->heap_index;
+   unsigned int last = _al_vector_size(&active_timers) - 1;
+   ALLEGRO_TIMER *moved = heap_get(last);
+
+   ASSERT(heap_get(i) == timer);
+
+   _al_vector_delete_at(&active_timers, last);
+   if (moved != timer) {
+      heap_set(i, moved);
+      heap_sift_up(i);
+      heap_sift_down(moved->heap_index);
+   }
+}
+
+
+
+/* fire_due_timers: [timer thread]
+ *  Ticks every timer whose deadline has passed, as many times as it has
+ *  passed.
+ */
+static void fire_due_timers(double now)
+{
+   while (!_al_vector_is_empty(&active_timers)) {
+      ALLEGRO_TIMER *timer = heap_get(0);
+
+      if (timer->deadline > now)
+         break;
+
+      timer_handle_tick(timer, now - timer->deadline);
+      timer->deadline += timer->speed_secs;
+      heap_sift_down(0);
+   }
+}
+
+
 /* timer_thread_proc: [timer thread]
  *  The timer thread procedure itself.
  */
@@ -95,63 +212,63 @@ static void timer_thread_proc(_AL_THREAD *self, void *unused)
    }
 #endif
 
-   double old_time = al_get_time();
-   double new_time;
-   double interval = 0.032768;
+   al_lock_mutex(timers_mutex);
 
-   while (!_al_get_thread_should_stop(self)) {
-      al_lock_mutex(timers_mutex);
-      while (_al_vector_size(&active_timers) == 0 && !destroy_thread) {
+   while (!destroy_thread && !_al_get_thread_should_stop(self)) {
+      double deadline;
+      double wait;
+
+      if (_al_vector_is_empty(&active_timers)) {
          al_wait_cond(timer_cond, timers_mutex);
-         old_time = al_get_time() - interval;
+         continue;
       }
-      al_unlock_mutex(timers_mutex);
 
-      al_rest(interval);
+      deadline = heap_get(0)->deadline;
+      wait = deadline - al_get_time();
 
-      al_lock_mutex(timers_mutex);
-      {
-         /* Calculate actual time elapsed.  */
-         new_time = al_get_time();
-         interval = new_time - old_time;
-         old_time = new_time;
+      if (wait > TIMER_WAIT_SLACK) {
+         ALLEGRO_TIMEOUT timeout;
+         al_init_timeout_until(&timeout, deadline - TIMER_WAIT_SLACK);
+         al_wait_cond_until(timer_cond, timers_mutex, &timeout);
+         continue;
+      }
 
-         /* Handle a tick.  */
-         interval = _al_timer_thread_handle_tick(interval);
+      if (wait > 0) {
+         al_unlock_mutex(timers_mutex);
+         _al_rest_until(deadline);
+         al_lock_mutex(timers_mutex);
       }
-      al_unlock_mutex(timers_mutex);
+
+      fire_due_timers(al_get_time());
    }
 
+   al_unlock_mutex(timers_mutex);
+
    (void)unused;
 }
 
 
 
 /* timer_thread_handle_tick: [timer thread]
- *  Call handle_tick() method of every timer in active_timers, and
- *  returns the duration that the timer thread should try to sleep
- *  next time.
+ *  Ticks all the timers which are due, for system drivers which drive the
+ *  timers themselves instead of using the timer thread, and returns the
+ *  duration until the next timer is due.  The interval since the last
+ *  call is unused, since timers are kept as absolute deadlines.
  */
 double _al_timer_thread_handle_tick(double interval)
 {
    double new_delay = 0.032768;
-   unsigned int i;
+   double now = al_get_time();
 
-   for (i = 0; i < _al_vector_size(&active_timers); i++) {
-      ALLEGRO_TIMER **slot = _al_vector_ref(&active_timers, i);
-      ALLEGRO_TIMER *timer = *slot;
+   fire_due_timers(now);
 
-      timer->counter -= interval;
-
-      while (timer->counter <= 0) {
-         timer_handle_tick(timer);
-         timer->counter += timer->speed_secs;
-      }
-
-      if ((timer->counter > 0) && (timer->counter < new_delay))
-         new_delay = timer->counter;
+   if (!_al_vector_is_empty(&active_timers)) {
+      double next = heap_get(0)->deadline - now;
+      if (next < new_delay)
+         new_delay = next;
    }
 
+   (void)interval;
    return new_delay;
 }
 
@@ -194,15 +311,13 @@ static void enable_timer(ALLEGRO_TIMER *timer, bool reset_counter)
 
       al_lock_mutex(timers_mutex);
       {
-         ALLEGRO_TIMER **slot;
-
          timer->started = true;
 
          if (reset_counter)
             timer->counter = timer->speed_secs;
 
-         slot = _al_vector_alloc_back(&active_timers);
-         *slot = timer;
+         timer->deadline = al_get_time() + timer->counter;
+         heap_insert(timer);
 
          al_signal_cond(timer_cond);
       }
@@ -254,6 +369,8 @@ ALLEGRO_TIMER *al_create_timer(double speed_secs)
          timer->count = 0;
          timer->speed_secs = speed_secs;
          timer->counter = 0;
+         timer->deadline = 0;
+         timer->heap_index = -1;
 
          timer->dtor_item = _al_register_destructor(_al_dtor_list, "timer", timer,
             (void (*)(void *)) al_destroy_timer);
@@ -310,7 +427,10 @@ void al_stop_timer(ALLEGRO_TIMER *timer)
 
       al_lock_mutex(timers_mutex);
       {
-         _al_vector_find_and_delete(&active_timers, &timer);
+         heap_remove(timer);
+         timer->counter = timer->deadline - al_get_time();
+         if (timer->counter < 0)
+            timer->counter = 0;
          timer->started = false;
       }
       al_unlock_mutex(timers_mutex);
@@ -351,8 +471,11 @@ void al_set_timer_speed(ALLEGRO_TIMER *timer, double new_speed_secs)
    al_lock_mutex(timers_mutex);
    {
       if (timer->started) {
-         timer->counter -= timer->speed_secs;
-         timer->counter += new_speed_secs;
+         timer->deadline -= timer->speed_secs;
+         timer->deadline += new_speed_secs;
+         heap_sift_up(timer->heap_index);
+         heap_sift_down(timer->heap_index);
+         al_signal_cond(timer_cond);
       }
 
       timer->speed_secs = new_speed_secs;
@@ -403,9 +526,9 @@ void al_add_timer_count(ALLEGRO_TIMER *timer, int64_t diff)
 
 
 /* timer_handle_tick: [timer thread]
- *  Handle a single tick.
+ *  Handle a single tick, which is error seconds late.
  */
-static void timer_handle_tick(ALLEGRO_TIMER *timer)
+static void timer_handle_tick(ALLEGRO_TIMER *timer, double error)
 {
    /* Lock out event source helper functions (e.g. the release hook
     * could be invoked simultaneously with this function).
@@ -421,7 +544,7 @@ static void timer_handle_tick(ALLEGRO_TIMER *timer)
          event.timer.type = ALLEGRO_EVENT_TIMER;
          event.timer.timestamp = al_get_time();
          event.timer.count = timer->count;
-         event.timer.error = -timer->counter;
+         event.timer.error = error;
          _al_event_source_emit_event(&timer->es, &event);
       }
    }
@@ -38,6 +38,7 @@
 #include <string.h>
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_atomicops.h"
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_file.h"
@@ -79,6 +80,9 @@ typedef struct thread_local_state {
    /* Current display */
    ALLEGRO_DISPLAY *current_display;
 
+   /* Hidden context used instead of current_display's own, if any. */
+   void *upload_context;
+
    /* Target bitmap */
    ALLEGRO_BITMAP *target_bitmap;
 
@@ -107,6 +111,30 @@ typedef struct thread_local_state {
 
    /* Destructor ownership count */
    int dtor_owner_count;
+
+   /* Destructor list bucket used by this thread plus one, see dtor.c */
+   int dtor_bucket;
+
+   /* Job pool worker running on this thread, see jobs.c */
+   void *job_worker;
+
+   /* Scratch memory of this thread, see memory.c */
+   void *frame_arena;
+
+   /* Profiling zones of this thread, see profile.c */
+   void *profile_thread;
+
+   /* Display independent draw list this thread records into, see
+    * draw_list.c
+    */
+   void *draw_recording;
+
+   /* Draw state last applied with al_use_draw_state, as long as nothing
+    * it covers was changed since. The id guards against a destroyed state
+    * whose memory is reused by a new one.
+    */
+   const ALLEGRO_DRAW_STATE *draw_state;
+   int draw_state_id;
 } thread_local_state;
 
 
@@ -385,6 +413,35 @@ bool _al_set_current_display_only(ALLEGRO_DISPLAY *display)
 
 
 
+/* Make the given display current without making its context current. The
+ * calling thread uses the given upload context, which shares the display's
+ * objects, instead. Pass NULL for both to stop.
+ */
+void _al_set_current_upload_context(ALLEGRO_DISPLAY *display, void *context)
+{
+   thread_local_state *tls;
+
+   if ((tls = tls_get()) == NULL)
+      return;
+
+   tls->current_display = display;
+   tls->upload_context = context;
+   tls->target_bitmap = NULL;
+}
+
+
+
+void *_al_get_current_upload_context(void)
+{
+   thread_local_state *tls;
+
+   if ((tls = tls_get()) == NULL)
+      return NULL;
+   return tls->upload_context;
+}
+
+
+
 /* Function: al_get_current_display
  */
 ALLEGRO_DISPLAY *al_get_current_display(void)
@@ -408,23 +465,43 @@ void al_set_target_bitmap(ALLEGRO_BITMAP *bitmap)
    ALLEGRO_SHADER *old_shader;
    ALLEGRO_SHADER *new_shader;
    bool same_shader;
-   int bitmap_flags = bitmap ? al_get_bitmap_flags(bitmap) : 0;
+   int bitmap_flags;
 
    ASSERT(!al_is_bitmap_drawing_held());
 
    if (bitmap) {
-      if (bitmap->parent) {
-         bitmap->parent->dirty = true;
-      }
-      else {
-         bitmap->dirty = true;
+      _al_mark_bitmap_used(bitmap, al_get_current_display());
+      bitmap_flags = al_get_bitmap_flags(bitmap);
+
+      /* Only video bitmaps are backed up. Threads may target sub-bitmaps
+       * of one memory bitmap at once.
+       */
+      if (!(bitmap_flags & ALLEGRO_MEMORY_BITMAP)) {
+         if (bitmap->parent) {
+            bitmap->parent->dirty = true;
+         }
+         else {
+            bitmap->dirty = true;
+         }
       }
    }
+   else {
+      bitmap_flags = 0;
+   }
 
    if ((tls = tls_get()) == NULL)
       return;
 
+   al_profile_begin("al_set_target_bitmap");
+
    old_display = tls->current_display;
+   tls->draw_state = NULL;
+
+   /* Vertices recorded for the old target go into the list first. */
+   if (old_display && old_display->num_cache_vertices > 0 &&
+         _al_get_draw_recording(old_display)) {
+      old_display->vt->flush_vertex_cache(old_display);
+   }
 
    if (tls->target_bitmap)
       old_shader = tls->target_bitmap->shader;
@@ -437,8 +514,12 @@ void al_set_target_bitmap(ALLEGRO_BITMAP *bitmap)
       new_shader = NULL;
    }
    else if (bitmap_flags & ALLEGRO_MEMORY_BITMAP) {
-      /* Setting a memory bitmap doesn't change the rendering context. */
-      new_display = old_display;
+      /* Setting a memory bitmap doesn't change the rendering context, unless
+       * it is the backbuffer of a software display.
+       */
+      new_display = _al_get_bitmap_display(bitmap);
+      if (!new_display)
+         new_display = old_display;
       new_shader = NULL;
    }
    else {
@@ -491,6 +572,8 @@ void al_set_target_bitmap(ALLEGRO_BITMAP *bitmap)
 
       new_display->vt->update_transformation(new_display, bitmap);
    }
+
+   al_profile_end();
 }
 
 
@@ -536,6 +619,7 @@ void al_set_blend_color(ALLEGRO_COLOR color)
       return;
 
    tls->current_blender.blend_color = color;
+   tls->draw_state = NULL;
 }
 
 
@@ -565,6 +649,7 @@ void al_set_separate_blender(int op, int src, int dst,
    b->blend_alpha_op = alpha_op;
    b->blend_alpha_source = alpha_src;
    b->blend_alpha_dest = alpha_dst;
+   tls->draw_state = NULL;
 }
 
 
@@ -625,6 +710,135 @@ void al_get_separate_blender(int *op, int *src, int *dst,
 
 
 
+struct ALLEGRO_DRAW_STATE
+{
+   int id;
+   ALLEGRO_BLENDER blender;
+   _ALLEGRO_RENDER_STATE render_state;
+   ALLEGRO_SHADER *shader;
+};
+
+static _AL_ATOMIC draw_state_count = 0;
+
+
+/* Function: al_create_draw_state
+ */
+ALLEGRO_DRAW_STATE *al_create_draw_state(void)
+{
+   thread_local_state *tls;
+   ALLEGRO_DRAW_STATE *state;
+   ALLEGRO_DISPLAY *display;
+   ALLEGRO_BITMAP *target;
+
+   if ((tls = tls_get()) == NULL)
+      return NULL;
+
+   state = al_malloc(sizeof *state);
+   if (!state)
+      return NULL;
+
+   state->id = _al_fetch_and_add1(&draw_state_count) + 1;
+   state->blender = tls->current_blender;
+
+   display = tls->current_display;
+   if (display) {
+      state->render_state = display->render_state;
+   }
+   else {
+      state->render_state.write_mask = ALLEGRO_MASK_RGBA | ALLEGRO_MASK_DEPTH;
+      state->render_state.depth_test = false;
+      state->render_state.depth_function = ALLEGRO_RENDER_LESS;
+      state->render_state.alpha_test = false;
+      state->render_state.alpha_function = ALLEGRO_RENDER_ALWAYS;
+      state->render_state.alpha_test_value = 0;
+   }
+
+   target = tls->target_bitmap;
+   state->shader = target ? target->shader : NULL;
+
+   return state;
+}
+
+
+/* Function: al_destroy_draw_state
+ */
+void al_destroy_draw_state(ALLEGRO_DRAW_STATE *state)
+{
+   thread_local_state *tls;
+
+   if (!state)
+      return;
+
+   if ((tls = tls_get()) != NULL && tls->draw_state == state)
+      tls->draw_state = NULL;
+
+   al_free(state);
+}
+
+
+/* Function: al_use_draw_state
+ */
+void al_use_draw_state(const ALLEGRO_DRAW_STATE *state)
+{
+   thread_local_state *tls;
+   ALLEGRO_DISPLAY *display;
+   ALLEGRO_BITMAP *target;
+   bool render_state_changed;
+
+   ASSERT(state);
+
+   if ((tls = tls_get()) == NULL)
+      return;
+
+   /* Nothing the state covers was changed since it was last applied. */
+   if (tls->draw_state == state && tls->draw_state_id == state->id)
+      return;
+
+   display = tls->current_display;
+   target = tls->target_bitmap;
+
+   render_state_changed = display &&
+      memcmp(&display->render_state, &state->render_state,
+         sizeof state->render_state) != 0;
+
+   /* Vertices held so far must still be drawn with the old state. */
+   if (display && display->cache_enabled && display->num_cache_vertices > 0 &&
+         display->vt && display->vt->flush_vertex_cache &&
+         (render_state_changed ||
+          memcmp(&tls->current_blender, &state->blender,
+             sizeof state->blender) != 0 ||
+          (target && target->shader != state->shader))) {
+      display->vt->flush_vertex_cache(display);
+   }
+
+   tls->current_blender = state->blender;
+
+   if (render_state_changed) {
+      display->render_state = state->render_state;
+      if (display->vt && display->vt->update_render_state)
+         display->vt->update_render_state(display);
+   }
+
+   if (target && !(al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP) &&
+         target->shader != state->shader) {
+      al_use_shader(state->shader);
+   }
+
+   tls->draw_state = state;
+   tls->draw_state_id = state->id;
+}
+
+
+void _al_tls_forget_draw_state(void)
+{
+   thread_local_state *tls;
+
+   if ((tls = tls_get()) != NULL)
+      tls->draw_state = NULL;
+}
+
+
+
 /* Function: al_set_new_bitmap_format
  */
 void al_set_new_bitmap_format(int format)
@@ -807,6 +1021,7 @@ void al_restore_state(ALLEGRO_STATE const *state)
 
    if (flags & ALLEGRO_STATE_BLENDER) {
       tls->current_blender = stored->stored_blender;
+      tls->draw_state = NULL;
    }
 
    if (flags & ALLEGRO_STATE_NEW_FILE_INTERFACE) {
@@ -973,4 +1188,45 @@ int *_al_tls_get_dtor_owner_count(void)
 }
 
 
+int *_al_tls_get_dtor_bucket(void)
+{
+   thread_local_state *tls;
+
+   tls = tls_get();
+   return &tls->dtor_bucket;
+}
+
+
+void *_al_tls_get_job_worker(void)
+GETTER(job_worker, NULL)
+
+
+void _al_tls_set_job_worker(void *worker)
+SETTER(job_worker, worker)
+
+
+void *_al_tls_get_frame_arena(void)
+GETTER(frame_arena, NULL)
+
+
+void _al_tls_set_frame_arena(void *arena)
+SETTER(frame_arena, arena)
+
+
+void *_al_tls_get_profile_thread(void)
+GETTER(profile_thread, NULL)
+
+
+void _al_tls_set_profile_thread(void *pt)
+SETTER(profile_thread, pt)
+
+
+void *_al_tls_get_draw_recording(void)
+GETTER(draw_recording, NULL)
+
+
+void _al_tls_set_draw_recording(void *list)
+SETTER(draw_recording, list)
+
+
 /* vim: set sts=3 sw=3 et: */
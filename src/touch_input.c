@@ -135,6 +135,148 @@ ALLEGRO_EVENT_SOURCE *al_get_touch_input_event_source(void)
 }
 
 
+/* _al_init_touch_input_frames:
+ *  Set up the state history of a driver that supports frame events.
+ */
+bool _al_init_touch_input_frames(ALLEGRO_TOUCH_INPUT *ti)
+{
+   ti->frame_mode = false;
+   ti->frame_pending = false;
+   return _al_init_input_snapshot(&ti->snapshot,
+      sizeof(ALLEGRO_TOUCH_INPUT_STATE));
+}
+
+
+/* _al_destroy_touch_input_frames:
+ *  Free the state history.
+ */
+void _al_destroy_touch_input_frames(ALLEGRO_TOUCH_INPUT *ti)
+{
+   _al_destroy_input_snapshot(&ti->snapshot);
+}
+
+
+/* emit_frame:
+ *  Generate the frame event for the moves since the last one. The event
+ *  source must be locked.
+ */
+static void emit_frame(ALLEGRO_TOUCH_INPUT *ti)
+{
+   ALLEGRO_EVENT event;
+
+   ti->frame_pending = false;
+
+   if (!_al_event_source_needs_to_generate_event(&ti->es))
+      return;
+
+   event.touch_frame.type = ALLEGRO_EVENT_TOUCH_FRAME;
+   event.touch_frame.timestamp = ti->frame_timestamp;
+   event.touch_frame.display = ti->frame_display;
+   event.touch_frame.frame = _al_input_snapshot_last_index(&ti->snapshot);
+   _al_event_source_emit_event(&ti->es, &event);
+}
+
+
+/* _al_touch_input_defer_event:
+ *  Called by the drivers before they emit a touch event. In frame mode, a
+ *  move is merged into the next frame event and true is returned; the driver
+ *  must not emit it then. Any other event first flushes the pending frame,
+ *  so that the order of the events is kept.
+ */
+bool _al_touch_input_defer_event(ALLEGRO_TOUCH_INPUT *ti, unsigned int type,
+   double timestamp, ALLEGRO_DISPLAY *disp)
+{
+   bool deferred = false;
+
+   _al_event_source_lock(&ti->es);
+   if (ti->frame_mode && type == ALLEGRO_EVENT_TOUCH_MOVE) {
+      ti->frame_pending = true;
+      ti->frame_timestamp = timestamp;
+      ti->frame_display = disp;
+      deferred = true;
+   }
+   else if (ti->frame_pending) {
+      emit_frame(ti);
+   }
+   _al_event_source_unlock(&ti->es);
+
+   return deferred;
+}
+
+
+/* _al_touch_input_end_frame:
+ *  Called by the drivers after a batch of touch events from the system, to
+ *  emit one frame event for all the moves in it.
+ */
+void _al_touch_input_end_frame(ALLEGRO_TOUCH_INPUT *ti)
+{
+   _al_event_source_lock(&ti->es);
+   if (ti->frame_pending)
+      emit_frame(ti);
+   _al_event_source_unlock(&ti->es);
+}
+
+
+/* Function: al_set_touch_input_frame_mode
+ */
+bool al_set_touch_input_frame_mode(bool onoff)
+{
+   ALLEGRO_TOUCH_INPUT *touch_input = get_touch_input();
+
+   if (!_al_input_snapshot_is_active(&touch_input->snapshot))
+      return false;
+
+   _al_event_source_lock(&touch_input->es);
+   if (!onoff && touch_input->frame_pending)
+      emit_frame(touch_input);
+   touch_input->frame_mode = onoff;
+   _al_event_source_unlock(&touch_input->es);
+
+   return true;
+}
+
+
+/* Function: al_get_touch_input_frame_mode
+ */
+bool al_get_touch_input_frame_mode(void)
+{
+   return get_touch_input()->frame_mode;
+}
+
+
+/* Function: al_get_touch_input_frame
+ */
+bool al_get_touch_input_frame(const ALLEGRO_EVENT *event,
+   ALLEGRO_TOUCH_INPUT_STATE *ret_state)
+{
+   ALLEGRO_TOUCH_INPUT *touch_input = get_touch_input();
+
+   ASSERT(event);
+   ASSERT(event->type == ALLEGRO_EVENT_TOUCH_FRAME);
+   ASSERT(ret_state);
+
+   return _al_read_input_snapshot_at(&touch_input->snapshot,
+      event->touch_frame.frame, ret_state, NULL);
+}
+
+
+/* Function: al_get_touch_input_state_history
+ */
+int al_get_touch_input_state_history(double since,
+   ALLEGRO_TOUCH_INPUT_STATE *ret_states, double *ret_timestamps, int max)
+{
+   ALLEGRO_TOUCH_INPUT *touch_input = get_touch_input();
+
+   ASSERT(ret_states);
+
+   if (!_al_input_snapshot_is_active(&touch_input->snapshot))
+      return 0;
+
+   return _al_read_input_snapshot_history(&touch_input->snapshot, since,
+      ret_states, ret_timestamps, max);
+}
+
+
 /* Function: al_get_touch_input_mouse_emulation_event_source
  */
 ALLEGRO_EVENT_SOURCE *al_get_touch_input_mouse_emulation_event_source(void)
@@ -42,8 +42,12 @@ void al_use_transform(const ALLEGRO_TRANSFORM *trans)
    ALLEGRO_BITMAP *target = al_get_target_bitmap();
    ALLEGRO_DISPLAY *display;
 
-   if (!target)
+   if (!target) {
+      ALLEGRO_TRANSFORM *recording = _al_get_thread_recording_transform();
+      if (recording && trans != recording)
+         al_copy_transform(recording, trans);
       return;
+   }
 
    /* Changes to a back buffer should affect the front buffer, and vice versa.
     * Currently we rely on the fact that in the OpenGL drivers the back buffer
@@ -106,7 +110,7 @@ const ALLEGRO_TRANSFORM *al_get_current_transform(void)
    ALLEGRO_BITMAP *target = al_get_target_bitmap();
 
    if (!target)
-      return NULL;
+      return _al_get_thread_recording_transform();
 
    return &target->transform;
 }
@@ -489,6 +493,85 @@ void al_transform_coordinates_3d_projective(const ALLEGRO_TRANSFORM *trans,
    *z /= w;
 }
 
+/* Function: al_transform_coordinates_array
+ */
+void al_transform_coordinates_array(const ALLEGRO_TRANSFORM *trans,
+   float *xy, int num, int stride)
+{
+   char *p = (char *)xy;
+   float m00, m01, m10, m11, m30, m31;
+   int i;
+   ASSERT(trans);
+   ASSERT(xy || num == 0);
+
+   if (stride == 0)
+      stride = 2 * sizeof(float);
+
+   if (_al_transform_is_translation(trans, &m30, &m31)) {
+      for (i = 0; i < num; i++, p += stride) {
+         float *v = (float *)p;
+         v[0] += m30;
+         v[1] += m31;
+      }
+      return;
+   }
+
+   /* Copied so the compiler knows the points do not alias the matrix. */
+   m00 = trans->m[0][0];
+   m01 = trans->m[0][1];
+   m10 = trans->m[1][0];
+   m11 = trans->m[1][1];
+   m30 = trans->m[3][0];
+   m31 = trans->m[3][1];
+
+   for (i = 0; i < num; i++, p += stride) {
+      float *v = (float *)p;
+      float x = v[0];
+      float y = v[1];
+      v[0] = x * m00 + y * m10 + m30;
+      v[1] = x * m01 + y * m11 + m31;
+   }
+}
+
+/* Function: al_transform_coordinates_3d_array
+ */
+void al_transform_coordinates_3d_array(const ALLEGRO_TRANSFORM *trans,
+   float *xyz, int num, int stride)
+{
+   char *p = (char *)xyz;
+   float m[4][3];
+   int i, j;
+   ASSERT(trans);
+   ASSERT(xyz || num == 0);
+
+   if (stride == 0)
+      stride = 3 * sizeof(float);
+
+   if (_al_transform_is_translation(trans, &m[3][0], &m[3][1])) {
+      for (i = 0; i < num; i++, p += stride) {
+         float *v = (float *)p;
+         v[0] += m[3][0];
+         v[1] += m[3][1];
+      }
+      return;
+   }
+
+   for (i = 0; i < 4; i++) {
+      for (j = 0; j < 3; j++)
+         m[i][j] = trans->m[i][j];
+   }
+
+   for (i = 0; i < num; i++, p += stride) {
+      float *v = (float *)p;
+      float x = v[0];
+      float y = v[1];
+      float z = v[2];
+      v[0] = x * m[0][0] + y * m[1][0] + z * m[2][0] + m[3][0];
+      v[1] = x * m[0][1] + y * m[1][1] + z * m[2][1] + m[3][1];
+      v[2] = x * m[0][2] + y * m[1][2] + z * m[2][2] + m[3][2];
+   }
+}
+
 /* Function: al_compose_transform
  */
 void al_compose_transform(ALLEGRO_TRANSFORM *trans, const ALLEGRO_TRANSFORM *other)
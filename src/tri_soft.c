@@ -23,6 +23,8 @@
 #include "allegro5/internal/aintern_blend.h"
 #include "allegro5/internal/aintern_pixels.h"
 #include "allegro5/internal/aintern_tri_soft.h"
+#include "allegro5/internal/aintern_workers.h"
+#include <limits.h>
 #include <math.h>
 
 ALLEGRO_DEBUG_CHANNEL("tri_soft")
@@ -38,12 +40,12 @@ typedef void (*shader_step)(uintptr_t, int);
 typedef struct {
    ALLEGRO_BITMAP *target;
    ALLEGRO_COLOR cur_color;
+   const _AL_SPAN_BLENDER *blender;
 } state_solid_any_2d;
 
 static void shader_solid_any_init(uintptr_t state, ALLEGRO_VERTEX* v1, ALLEGRO_VERTEX* v2, ALLEGRO_VERTEX* v3)
 {
    state_solid_any_2d* s = (state_solid_any_2d*)state;
-   s->target = al_get_target_bitmap();
    s->cur_color = v1->color;
 
    (void)v2;
@@ -131,7 +133,6 @@ static void shader_grad_any_init(uintptr_t state, ALLEGRO_VERTEX* v1, ALLEGRO_VE
 
    state_grad_any_2d* s = (state_grad_any_2d*)state;
 
-   s->solid.target = al_get_target_bitmap();
    
    s->off_x = v1->x - 0.5f;
    s->off_y = v1->y + 0.5f;
@@ -223,6 +224,8 @@ typedef struct {
 
    ALLEGRO_BITMAP* texture;
    int w, h;
+
+   const _AL_SPAN_BLENDER *blender;
 } state_texture_solid_any_2d;
 
 static void shader_texture_solid_any_init(uintptr_t state, ALLEGRO_VERTEX* v1, ALLEGRO_VERTEX* v2, ALLEGRO_VERTEX* v3)
@@ -234,7 +237,6 @@ static void shader_texture_solid_any_init(uintptr_t state, ALLEGRO_VERTEX* v1, A
 
    state_texture_solid_any_2d* s = (state_texture_solid_any_2d*)state;
 
-   s->target = al_get_target_bitmap();
    s->cur_color = v1->color;
 
    s->off_x = v1->x - 0.5f;
@@ -320,7 +322,6 @@ static void shader_texture_grad_any_init(uintptr_t state, ALLEGRO_VERTEX* v1, AL
 
    state_texture_grad_any_2d* s = (state_texture_grad_any_2d*)state;
    
-   s->solid.target = al_get_target_bitmap();
    s->solid.w = al_get_bitmap_width(s->solid.texture);
    s->solid.h = al_get_bitmap_height(s->solid.texture);
 
@@ -408,9 +409,452 @@ static void shader_texture_grad_any_step(uintptr_t state, int minor)
 #include "scanline_drawers.inc"
 
 
+/*========================== 8888 Shaders ====================================*/
+
+/*
+These handle textured drawing with a constant tint between ARGB_8888 and
+ABGR_8888 bitmaps for the most common blenders. Opaque and fully transparent
+texels, untinted copies and untinted additive blending only need integer
+operations. Everything else computes exactly what the generic drawers do, so
+the results are identical.
+
+They also read the texels of unlocked tiled memory bitmaps straight from
+the tiles, which keeps rotated and scaled drawing close in memory.
+*/
+
+enum {
+   BLEND_8888_COPY,
+   BLEND_8888_PREMUL_ALPHA,
+   BLEND_8888_ALPHA,
+   BLEND_8888_ADD
+};
+
+typedef struct {
+   state_texture_solid_any_2d solid;
+
+   int blend;
+   bool white;
+   bool tiled;
+
+   /*
+   Used if the locked formats turn out not to be 8888 ones after all
+   */
+   shader_draw fallback;
+} state_texture_8888_2d;
+
+static bool is_8888_format(int format)
+{
+   return format == ALLEGRO_PIXEL_FORMAT_ARGB_8888 ||
+      format == ALLEGRO_PIXEL_FORMAT_ABGR_8888;
+}
+
+#define SWAP_RB_8888(p) \
+   (((p) & 0xFF00FF00) | (((p) & 0xFF) << 16) | (((p) >> 16) & 0xFF))
+
+/*
+Blends a color onto a destination pixel and packs the result.
+*/
+static _AL_ALWAYS_INLINE uint32_t blend_8888_color(int blend,
+   const ALLEGRO_COLOR *src, uint32_t dp)
+{
+   ALLEGRO_COLOR src_color = *src;
+   ALLEGRO_COLOR dst_color, result;
+
+   if (blend == BLEND_8888_COPY) {
+      result = src_color;
+   }
+   else {
+      _AL_MAP_RGBA(dst_color, (dp >> 16) & 0xFF, (dp >> 8) & 0xFF, dp & 0xFF, dp >> 24);
+      switch (blend) {
+         case BLEND_8888_PREMUL_ALPHA:
+            _al_blend_alpha_inline(&src_color, &dst_color,
+               ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA,
+               ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA,
+               NULL, &result);
+            break;
+         case BLEND_8888_ALPHA:
+            _al_blend_alpha_inline(&src_color, &dst_color,
+               ALLEGRO_ADD, ALLEGRO_ALPHA, ALLEGRO_INVERSE_ALPHA,
+               ALLEGRO_ADD, ALLEGRO_ALPHA, ALLEGRO_INVERSE_ALPHA,
+               NULL, &result);
+            break;
+         default:
+            _al_blend_alpha_inline(&src_color, &dst_color,
+               ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ONE,
+               ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ONE,
+               NULL, &result);
+            break;
+      }
+   }
+
+   return (_al_fast_float_to_int(result.a * 255) << 24) |
+      (_al_fast_float_to_int(result.r * 255) << 16) |
+      (_al_fast_float_to_int(result.g * 255) << 8) |
+      _al_fast_float_to_int(result.b * 255);
+}
+
+
+/*
+Both formats keep alpha in the top byte, and the blenders treat the color
+channels alike, so we work in the destination channel order and only need
+the tint in that order.
+*/
+static _AL_ALWAYS_INLINE uint32_t blend_8888_pixel(int blend, bool white,
+   uint32_t sp, uint32_t dp, const ALLEGRO_COLOR *tint)
+{
+   const uint32_t sa = sp >> 24;
+   ALLEGRO_COLOR src_color;
+
+   if (white) {
+      switch (blend) {
+         case BLEND_8888_COPY:
+            return sp;
+         case BLEND_8888_PREMUL_ALPHA:
+            if (sa == 255)
+               return sp;
+            if (sp == 0)
+               return dp;
+            break;
+         case BLEND_8888_ALPHA:
+            if (sa == 255)
+               return sp;
+            if (sa == 0)
+               return dp;
+            break;
+         case BLEND_8888_ADD: {
+            /* (int)(MIN(1, s + d) * 255) is a saturated addition for all
+             * the 8-bit values.
+             */
+            uint32_t lo = (sp & 0x00FF00FF) + (dp & 0x00FF00FF);
+            uint32_t hi = ((sp >> 8) & 0x00FF00FF) + ((dp >> 8) & 0x00FF00FF);
+            lo |= ((lo >> 8) & 0x00010001) * 0xFF;
+            hi |= ((hi >> 8) & 0x00010001) * 0xFF;
+            return (lo & 0x00FF00FF) | ((hi & 0x00FF00FF) << 8);
+         }
+      }
+   }
+   else {
+      if (blend == BLEND_8888_PREMUL_ALPHA && sp == 0)
+         return dp;
+      if (blend == BLEND_8888_ALPHA && sa == 0)
+         return dp;
+   }
+
+   _AL_MAP_RGBA(src_color, (sp >> 16) & 0xFF, (sp >> 8) & 0xFF, sp & 0xFF, sa);
+   SHADE_COLORS(src_color, (*tint));
+
+   return blend_8888_color(blend, &src_color, dp);
+}
+
+#define FETCH_LINEAR(x, y) \
+   (*(uint32_t *)(lock_data + (y) * src_pitch + (x) * 4))
+
+#define FETCH_TILED(x, y) \
+   (*(uint32_t *)(lock_data + _AL_TILED_OFFSET(src_pitch, 4, x, y)))
+
+#define DRAW_8888_LOOP(blend, white, fetch)                                   \
+   for (; x1 <= x2; x1++) {                                                   \
+      const int src_x = (uu >> 16) + uu_ofs;                                  \
+      const int src_y = (vv >> 16) + vv_ofs;                                  \
+      uint32_t sp = fetch(src_x, src_y);                                      \
+                                                                              \
+      if (swap)                                                               \
+         sp = SWAP_RB_8888(sp);                                               \
+      *dst_data = blend_8888_pixel(blend, white, sp, *dst_data, &tint);       \
+      dst_data++;                                                             \
+                                                                              \
+      uu += du_dx;                                                            \
+      vv += dv_dx;                                                            \
+                                                                              \
+      if (_AL_EXPECT_FAIL(uu < 0))                                            \
+         uu += w;                                                             \
+      else if (_AL_EXPECT_FAIL(uu >= w))                                      \
+         uu -= w;                                                             \
+                                                                              \
+      if (_AL_EXPECT_FAIL(vv < 0))                                            \
+         vv += h;                                                             \
+      else if (_AL_EXPECT_FAIL(vv >= h))                                      \
+         vv -= h;                                                             \
+   }
+
+static void shader_texture_8888_draw(uintptr_t state, int x1, int y, int x2)
+{
+   state_texture_8888_2d *fs = (state_texture_8888_2d *)state;
+   state_texture_solid_any_2d *s = &fs->solid;
+   ALLEGRO_BITMAP *target = _AL_LOCK_HOLDER(s->target);
+   ALLEGRO_BITMAP *texture = _AL_LOCK_HOLDER(s->texture);
+   const int offset_x = s->texture->parent ? s->texture->xofs : 0;
+   const int offset_y = s->texture->parent ? s->texture->yofs : 0;
+   const int texture_format = fs->tiled ? texture->_format :
+      texture->locked_region.format;
+   float u = s->u;
+   float v = s->v;
+   ALLEGRO_COLOR tint;
+   bool swap;
+
+   if (!is_8888_format(target->locked_region.format) ||
+         !is_8888_format(texture_format)) {
+      /* Ruled out for tiled textures, which have no linear copy. */
+      ASSERT(!fs->tiled);
+      fs->fallback(state, x1, y, x2);
+      return;
+   }
+
+   if (s->target->parent) {
+      x1 += s->target->xofs;
+      x2 += s->target->xofs;
+      y += s->target->yofs;
+   }
+
+   x1 -= target->lock_x;
+   x2 -= target->lock_x;
+   y -= target->lock_y;
+   y--;
+
+   if (y < 0 || y >= target->lock_h) {
+      return;
+   }
+
+   if (x1 < 0) {
+      u += s->du_dx * -x1;
+      v += s->dv_dx * -x1;
+      x1 = 0;
+   }
+
+   if (x2 > target->lock_w - 1) {
+      x2 = target->lock_w - 1;
+   }
+
+   /* Ensure u in [0, s->w) and v in [0, s->h). */
+   while (u < 0)
+      u += s->w;
+   while (v < 0)
+      v += s->h;
+   u = fmodf(u, s->w);
+   v = fmodf(v, s->h);
+   ASSERT(0 <= u);
+   ASSERT(u < s->w);
+   ASSERT(0 <= v);
+   ASSERT(v < s->h);
+
+   swap = target->locked_region.format != texture_format;
+   tint = s->cur_color;
+   if (target->locked_region.format == ALLEGRO_PIXEL_FORMAT_ABGR_8888) {
+      tint.r = s->cur_color.b;
+      tint.b = s->cur_color.r;
+   }
+
+   {
+      uint32_t *dst_data = (uint32_t *)((uint8_t *)target->lock_data
+         + y * target->locked_region.pitch) + x1;
+      uint8_t *lock_data = fs->tiled ? texture->memory :
+         (uint8_t *)texture->locked_region.data;
+      const int src_pitch = fs->tiled ? texture->pitch :
+         texture->locked_region.pitch;
+      const al_fixed du_dx = al_ftofix(s->du_dx);
+      const al_fixed dv_dx = al_ftofix(s->dv_dx);
+      al_fixed uu = al_ftofix(u);
+      al_fixed vv = al_ftofix(v);
+      const int uu_ofs = offset_x - (fs->tiled ? 0 : texture->lock_x);
+      const int vv_ofs = offset_y - (fs->tiled ? 0 : texture->lock_y);
+      const al_fixed w = al_ftofix(s->w);
+      const al_fixed h = al_ftofix(s->h);
+
+      #define CASE(blend, fetch)                                              \
+         case blend:                                                          \
+            if (fs->white) {                                                  \
+               DRAW_8888_LOOP(blend, true, fetch)                             \
+            }                                                                 \
+            else {                                                            \
+               DRAW_8888_LOOP(blend, false, fetch)                            \
+            }                                                                 \
+            break;
+      if (fs->tiled) {
+         switch (fs->blend) {
+            CASE(BLEND_8888_COPY, FETCH_TILED)
+            CASE(BLEND_8888_PREMUL_ALPHA, FETCH_TILED)
+            CASE(BLEND_8888_ALPHA, FETCH_TILED)
+            CASE(BLEND_8888_ADD, FETCH_TILED)
+         }
+      }
+      else {
+         switch (fs->blend) {
+            CASE(BLEND_8888_COPY, FETCH_LINEAR)
+            CASE(BLEND_8888_PREMUL_ALPHA, FETCH_LINEAR)
+            CASE(BLEND_8888_ALPHA, FETCH_LINEAR)
+            CASE(BLEND_8888_ADD, FETCH_LINEAR)
+         }
+      }
+      #undef CASE
+   }
+}
+
+#undef DRAW_8888_LOOP
+#undef FETCH_LINEAR
+#undef FETCH_TILED
+
+
+/*
+The same for untextured triangles of one color. The color is packed once per
+scanline, and as it doesn't change, the result of blending it onto a pixel is
+reused for runs of equal destination pixels.
+*/
+typedef struct {
+   state_solid_any_2d solid;
+
+   int blend;
+
+   /*
+   Used if the locked format turns out not to be an 8888 one after all
+   */
+   shader_draw fallback;
+} state_solid_8888_2d;
+
+#define DRAW_SOLID_8888_LOOP(blend)                                           \
+   for (; x1 <= x2; x1++) {                                                   \
+      const uint32_t dp = *dst_data;                                          \
+                                                                              \
+      if (dp != last_dp) {                                                    \
+         last_dp = dp;                                                        \
+         last_pixel = blend_8888_color(blend, &color, dp);                    \
+      }                                                                       \
+      *dst_data = last_pixel;                                                 \
+      dst_data++;                                                             \
+   }
+
+static void shader_solid_8888_draw(uintptr_t state, int x1, int y, int x2)
+{
+   state_solid_8888_2d *fs = (state_solid_8888_2d *)state;
+   state_solid_any_2d *s = &fs->solid;
+   ALLEGRO_BITMAP *target = _AL_LOCK_HOLDER(s->target);
+   ALLEGRO_COLOR color = s->cur_color;
+   int blend = fs->blend;
+
+   if (!is_8888_format(target->locked_region.format)) {
+      fs->fallback(state, x1, y, x2);
+      return;
+   }
+
+   if (s->target->parent) {
+      x1 += s->target->xofs;
+      x2 += s->target->xofs;
+      y += s->target->yofs;
+   }
+
+   x1 -= target->lock_x;
+   x2 -= target->lock_x;
+   y -= target->lock_y;
+   y--;
+
+   if (y < 0 || y >= target->lock_h) {
+      return;
+   }
+
+   if (x1 < 0) {
+      x1 = 0;
+   }
+
+   if (x2 > target->lock_w - 1) {
+      x2 = target->lock_w - 1;
+   }
+
+   if (target->locked_region.format == ALLEGRO_PIXEL_FORMAT_ABGR_8888) {
+      color.r = s->cur_color.b;
+      color.b = s->cur_color.r;
+   }
+
+   /*
+   An opaque color replaces the pixels, a fully transparent one leaves them
+   alone.
+   */
+   if ((blend == BLEND_8888_PREMUL_ALPHA || blend == BLEND_8888_ALPHA) &&
+         color.a == 1) {
+      blend = BLEND_8888_COPY;
+   }
+   if ((blend == BLEND_8888_ALPHA && color.a == 0) ||
+         ((blend == BLEND_8888_PREMUL_ALPHA || blend == BLEND_8888_ADD) &&
+         color.r == 0 && color.g == 0 && color.b == 0 && color.a == 0)) {
+      return;
+   }
+
+   {
+      uint32_t *dst_data = (uint32_t *)((uint8_t *)target->lock_data
+         + y * target->locked_region.pitch) + x1;
+      uint32_t last_dp;
+      uint32_t last_pixel;
+
+      if (blend == BLEND_8888_COPY) {
+         const uint32_t pixel = blend_8888_color(BLEND_8888_COPY, &color, 0);
+         for (; x1 <= x2; x1++)
+            *dst_data++ = pixel;
+         return;
+      }
+
+      last_dp = *dst_data;
+      last_pixel = blend_8888_color(blend, &color, last_dp);
+
+      #define CASE(blend)                                                     \
+         case blend:                                                          \
+            DRAW_SOLID_8888_LOOP(blend)                                       \
+            break;
+      switch (blend) {
+         CASE(BLEND_8888_PREMUL_ALPHA)
+         CASE(BLEND_8888_ALPHA)
+         CASE(BLEND_8888_ADD)
+      }
+      #undef CASE
+   }
+}
+
+#undef DRAW_SOLID_8888_LOOP
+
+
+/*
+Returns the 8888 blender to use for the current blend mode, or -1. The
+texture may be NULL.
+*/
+static int get_8888_blend(ALLEGRO_BITMAP *target, ALLEGRO_BITMAP *texture,
+   int shade, ALLEGRO_COLOR tint,
+   int op, int src_mode, int dst_mode, int op_alpha, int src_alpha, int dst_alpha)
+{
+   if ((texture && !is_8888_format(al_get_bitmap_format(texture))) ||
+         !is_8888_format(al_get_bitmap_format(target)))
+      return -1;
+
+   /*
+   With out of range tints, the generic drawers would write nonsense into the
+   neighbouring channels.
+   */
+   if (tint.r < 0 || tint.r > 1 || tint.g < 0 || tint.g > 1 ||
+         tint.b < 0 || tint.b > 1 || tint.a < 0 || tint.a > 1)
+      return -1;
+
+   if (!shade)
+      return BLEND_8888_COPY;
+
+   if (op != ALLEGRO_ADD || op_alpha != ALLEGRO_ADD ||
+         src_mode != src_alpha || dst_mode != dst_alpha)
+      return -1;
+
+   if (src_mode == ALLEGRO_ONE && dst_mode == ALLEGRO_INVERSE_ALPHA)
+      return BLEND_8888_PREMUL_ALPHA;
+   if (src_mode == ALLEGRO_ALPHA && dst_mode == ALLEGRO_INVERSE_ALPHA)
+      return BLEND_8888_ALPHA;
+   if (src_mode == ALLEGRO_ONE && dst_mode == ALLEGRO_ONE)
+      return BLEND_8888_ADD;
+   return -1;
+}
+
+
+/*
+Only the pixel rows from min_y up to but not including max_y are drawn. The
+scanlines above are still stepped over, so the shaders see the same sequence
+of calls whichever part of the triangle is drawn.
+*/
 static void triangle_stepper(uintptr_t state,
    shader_init init, shader_first first, shader_step step, shader_draw draw,
-   ALLEGRO_VERTEX* vtx1, ALLEGRO_VERTEX* vtx2, ALLEGRO_VERTEX* vtx3)
+   ALLEGRO_VERTEX* vtx1, ALLEGRO_VERTEX* vtx2, ALLEGRO_VERTEX* vtx3,
+   int min_y, int max_y)
 {
    float Coords[6] = {vtx1->x - 0.5f, vtx1->y + 0.5f, vtx2->x - 0.5f, vtx2->y + 0.5f, vtx3->x - 0.5f, vtx3->y + 0.5f};
    float *V1 = Coords, *V2 = &Coords[2], *V3 = &Coords[4], *s;
@@ -461,9 +905,18 @@ static void triangle_stepper(uintptr_t state,
    mid_y = ceilf(V2[1]);
    end_y = ceilf(V3[1]);
 
-   if (cur_y == end_y)
+   /*
+   The drawers put scanline y into pixel row y - 1, the rows are limited
+   accordingly
+   */
+   if (cur_y == end_y || cur_y - 1 >= max_y)
       return;
 
+   if (mid_y - 1 > max_y)
+      mid_y = max_y + 1;
+   if (end_y - 1 > max_y)
+      end_y = max_y + 1;
+
    /*
    As per definition, we take the ceiling
    */
@@ -554,7 +1007,7 @@ static void triangle_stepper(uintptr_t state,
 
          first(state, left_x, cur_y, left_step, left_step - 1);
 
-         if (right_x >= left_x) {
+         if (right_x >= left_x && cur_y > min_y) {
             draw(state, left_x, cur_y, right_x);
          }
 
@@ -590,7 +1043,7 @@ static void triangle_stepper(uintptr_t state,
             right_x -= 1;
          }
 
-         if (right_x >= left_x) {
+         if (right_x >= left_x && cur_y > min_y) {
             draw(state, left_x, cur_y, right_x);
          }
 
@@ -644,7 +1097,7 @@ static void triangle_stepper(uintptr_t state,
 
          first(state, left_x, cur_y, left_step, left_step - 1);
 
-         if (right_x >= left_x) {
+         if (right_x >= left_x && cur_y > min_y) {
             draw(state, left_x, cur_y, right_x);
          }
 
@@ -672,7 +1125,7 @@ static void triangle_stepper(uintptr_t state,
             right_x -= 1;
          }
 
-         if (right_x >= left_x) {
+         if (right_x >= left_x && cur_y > min_y) {
             draw(state, left_x, cur_y, right_x);
          }
 
@@ -684,88 +1137,96 @@ static void triangle_stepper(uintptr_t state,
 }
 
 /*
-This one will check to see what exactly we need to draw...
-I.e. this will call all of the actual renderers and set the appropriate callbacks
+Everything about the target that the triangles need, read once from the
+calling thread, so triangles can also be drawn from worker threads.
 */
-void _al_triangle_2d(ALLEGRO_BITMAP* texture, ALLEGRO_VERTEX* v1, ALLEGRO_VERTEX* v2, ALLEGRO_VERTEX* v3)
-{
-   int shade = 1;
-   int grad = 1;
+typedef struct {
+   ALLEGRO_BITMAP *target;
+   int clip_min_x, clip_min_y, clip_max_x, clip_max_y;
+   int band_min_y, band_max_y;
+   bool locked;   /* The clipping rectangle is locked already. */
+
    int op, src_mode, dst_mode, op_alpha, src_alpha, dst_alpha;
-   ALLEGRO_COLOR v1c, v2c, v3c;
+   int shade;
+   _AL_SPAN_BLENDER blender;
+} triangle_context;
 
-   v1c = v1->color;
-   v2c = v2->color;
-   v3c = v3->color;
+static void init_target_context(triangle_context *ctx)
+{
+   ctx->target = al_get_target_bitmap();
+   al_get_clipping_rectangle(&ctx->clip_min_x, &ctx->clip_min_y,
+      &ctx->clip_max_x, &ctx->clip_max_y);
+   ctx->clip_max_x += ctx->clip_min_x;
+   ctx->clip_max_y += ctx->clip_min_y;
+   ctx->band_min_y = INT_MIN;
+   ctx->band_max_y = INT_MAX;
+   ctx->locked = false;
+}
+
+static void init_blender_context(triangle_context *ctx)
+{
+   int op, src_mode, dst_mode, op_alpha, src_alpha, dst_alpha;
 
    al_get_separate_bitmap_blender(&op,
       &src_mode, &dst_mode, &op_alpha, &src_alpha, &dst_alpha);
+   ctx->op = op;
+   ctx->src_mode = src_mode;
+   ctx->dst_mode = dst_mode;
+   ctx->op_alpha = op_alpha;
+   ctx->src_alpha = src_alpha;
+   ctx->dst_alpha = dst_alpha;
    if (_AL_DEST_IS_ZERO && _AL_SRC_NOT_MODIFIED) {
-      shade = 0;
+      ctx->shade = 0;
    }
-
-   if ((v1c.r == v2c.r && v2c.r == v3c.r) &&
-         (v1c.g == v2c.g && v2c.g == v3c.g) &&
-         (v1c.b == v2c.b && v2c.b == v3c.b) &&
-         (v1c.a == v2c.a && v2c.a == v3c.a)) {
-      grad = 0;
+   else {
+      ALLEGRO_COLOR const_color = al_get_blend_color();
+      ctx->shade = 1;
+      _al_init_span_blender(&ctx->blender, op, src_mode, dst_mode,
+         op_alpha, src_alpha, dst_alpha, &const_color);
    }
+}
 
-   if (texture) {
-      if (grad) {
-         state_texture_grad_any_2d state;
-         state.solid.texture = texture;
-
-         if (shade) {
-            _al_draw_soft_triangle(v1, v2, v3, (uintptr_t)&state, shader_texture_grad_any_init, shader_texture_grad_any_first, shader_texture_grad_any_step, shader_texture_grad_any_draw_shade);
-         } else {
-            _al_draw_soft_triangle(v1, v2, v3, (uintptr_t)&state, shader_texture_grad_any_init, shader_texture_grad_any_first, shader_texture_grad_any_step, shader_texture_grad_any_draw_opaque);
-         }
-      } else {
-         int white = 0;
-         state_texture_solid_any_2d state;
+/*
+Whether the 8888 drawer can read the tiles of an unlocked tiled texture. It
+has no generic fallback then, so a target locked in another format needs a
+linear copy of the texture.
+*/
+static bool can_read_tiles(ALLEGRO_BITMAP *target, ALLEGRO_BITMAP *texture,
+   int blend_8888)
+{
+   ALLEGRO_BITMAP *lock = _AL_LOCK_HOLDER(target);
+
+   if (blend_8888 < 0 || !_al_bitmap_is_tiled(texture) ||
+         al_is_bitmap_locked(texture))
+      return false;
+   if (al_is_bitmap_locked(lock) &&
+         !is_8888_format(lock->locked_region.format))
+      return false;
+   return true;
+}
 
-         if (v1c.r == 1 && v1c.g == 1 && v1c.b == 1 && v1c.a == 1) {
-            white = 1;
-         }
-         state.texture = texture;
-         if (shade) {
-            if (white) {
-               _al_draw_soft_triangle(v1, v2, v3, (uintptr_t)&state, shader_texture_solid_any_init, shader_texture_solid_any_first, shader_texture_solid_any_step, shader_texture_solid_any_draw_shade_white);
-            } else {
-               _al_draw_soft_triangle(v1, v2, v3, (uintptr_t)&state, shader_texture_solid_any_init, shader_texture_solid_any_first, shader_texture_solid_any_step, shader_texture_solid_any_draw_shade);
-            }
-         } else {
-            if (white) {
-               _al_draw_soft_triangle(v1, v2, v3, (uintptr_t)&state, shader_texture_solid_any_init, shader_texture_solid_any_first, shader_texture_solid_any_step, shader_texture_solid_any_draw_opaque_white);
-            } else {
-               _al_draw_soft_triangle(v1, v2, v3, (uintptr_t)&state, shader_texture_solid_any_init, shader_texture_solid_any_first, shader_texture_solid_any_step, shader_texture_solid_any_draw_opaque);
-            }
-         }
-      }
-   } else {
-      if (grad) {
-         state_grad_any_2d state;
-         if (shade) {
-            _al_draw_soft_triangle(v1, v2, v3, (uintptr_t)&state, shader_grad_any_init, shader_grad_any_first, shader_grad_any_step, shader_grad_any_draw_shade);
-         } else {
-            _al_draw_soft_triangle(v1, v2, v3, (uintptr_t)&state, shader_grad_any_init, shader_grad_any_first, shader_grad_any_step, shader_grad_any_draw_opaque);
-         }
-      } else {
-         state_solid_any_2d state;
-         if (shade) {
-            _al_draw_soft_triangle(v1, v2, v3, (uintptr_t)&state, shader_solid_any_init, shader_solid_any_first, shader_solid_any_step, shader_solid_any_draw_shade);
-         } else {
-            _al_draw_soft_triangle(v1, v2, v3, (uintptr_t)&state, shader_solid_any_init, shader_solid_any_first, shader_solid_any_step, shader_solid_any_draw_opaque);
-         }
-      }
-   }
+/*
+Tiled textures which are not read from the tiles are locked for the drawers
+reading the locked region. Returns whether the texture has to be unlocked.
+*/
+static bool lock_tiled_texture(ALLEGRO_BITMAP *texture)
+{
+   if (!_al_bitmap_is_tiled(texture) || al_is_bitmap_locked(texture))
+      return false;
+   return al_lock_bitmap(texture, ALLEGRO_PIXEL_FORMAT_ANY,
+      ALLEGRO_LOCK_READONLY) != NULL;
 }
 
 static int bitmap_region_is_locked(ALLEGRO_BITMAP* bmp, int x1, int y1, int w, int h)
 {
    ASSERT(bmp);
 
+   /* The locked region is in the coordinates of the parent. */
+   if (bmp->parent) {
+      x1 += bmp->xofs;
+      y1 += bmp->yofs;
+      bmp = _AL_LOCK_HOLDER(bmp);
+   }
    if (!al_is_bitmap_locked(bmp))
       return 0;
    if (x1 + w > bmp->lock_x && y1 + h > bmp->lock_y && x1 < bmp->lock_x + bmp->lock_w && y1 < bmp->lock_y + bmp->lock_h)
@@ -773,12 +1234,9 @@ static int bitmap_region_is_locked(ALLEGRO_BITMAP* bmp, int x1, int y1, int w, i
    return 0;
 }
 
-void _al_draw_soft_triangle(
+static void draw_soft_triangle(const triangle_context *ctx,
    ALLEGRO_VERTEX* v1, ALLEGRO_VERTEX* v2, ALLEGRO_VERTEX* v3, uintptr_t state,
-   void (*init)(uintptr_t, ALLEGRO_VERTEX*, ALLEGRO_VERTEX*, ALLEGRO_VERTEX*),
-   void (*first)(uintptr_t, int, int, int, int),
-   void (*step)(uintptr_t, int),
-   void (*draw)(uintptr_t, int, int, int))
+   shader_init init, shader_first first, shader_step step, shader_draw draw)
 {
    /*
    ALLEGRO_VERTEX copy_v1, copy_v2; <- may be needed for clipping later on
@@ -786,15 +1244,14 @@ void _al_draw_soft_triangle(
    ALLEGRO_VERTEX* vtx1 = v1;
    ALLEGRO_VERTEX* vtx2 = v2;
    ALLEGRO_VERTEX* vtx3 = v3;
-   ALLEGRO_BITMAP *target = al_get_target_bitmap();
+   ALLEGRO_BITMAP *target = ctx->target;
    int need_unlock = 0;
    ALLEGRO_LOCKED_REGION *lr;
    int min_x, max_x, min_y, max_y;
-   int clip_min_x, clip_min_y, clip_max_x, clip_max_y;
-
-   al_get_clipping_rectangle(&clip_min_x, &clip_min_y, &clip_max_x, &clip_max_y);
-   clip_max_x += clip_min_x;
-   clip_max_y += clip_min_y;
+   int clip_min_x = ctx->clip_min_x;
+   int clip_min_y = ctx->clip_min_y;
+   int clip_max_x = ctx->clip_max_x;
+   int clip_max_y = ctx->clip_max_y;
 
    /*
    TODO: Need to clip them first, make a copy of the vertices first then
@@ -829,20 +1286,338 @@ void _al_draw_soft_triangle(
    if (min_y < clip_min_y)
       min_y = clip_min_y;
 
-   if (al_is_bitmap_locked(target)) {
+   if (ctx->locked) {
+      /* Nothing to do. */
+   } else if (al_is_bitmap_locked(target)) {
       if (!bitmap_region_is_locked(target, min_x, min_y, max_x - min_x, max_y - min_y) ||
           _al_pixel_format_is_video_only(target->locked_region.format))
          return;
    } else {
-      if (!(lr = al_lock_bitmap_region(target, min_x, min_y, max_x - min_x, max_y - min_y, ALLEGRO_PIXEL_FORMAT_ANY, 0)))
+      if (!(lr = _al_lock_drawn_region(target, min_x, min_y, max_x - min_x, max_y - min_y)))
          return;
       need_unlock = 1;
    }
 
-   triangle_stepper(state, init, first, step, draw, v1, v2, v3);
+   triangle_stepper(state, init, first, step, draw, v1, v2, v3,
+      ctx->band_min_y, ctx->band_max_y);
 
    if (need_unlock)
       al_unlock_bitmap(target);
 }
 
+/*
+This one will check to see what exactly we need to draw...
+I.e. this will call all of the actual renderers and set the appropriate callbacks
+*/
+static void triangle_2d(const triangle_context *ctx, ALLEGRO_BITMAP* texture,
+   ALLEGRO_VERTEX* v1, ALLEGRO_VERTEX* v2, ALLEGRO_VERTEX* v3)
+{
+   int shade = ctx->shade;
+   int grad = 1;
+   ALLEGRO_COLOR v1c, v2c, v3c;
+   const _AL_SPAN_BLENDER *blender = &ctx->blender;
+
+   v1c = v1->color;
+   v2c = v2->color;
+   v3c = v3->color;
+
+   if ((v1c.r == v2c.r && v2c.r == v3c.r) &&
+         (v1c.g == v2c.g && v2c.g == v3c.g) &&
+         (v1c.b == v2c.b && v2c.b == v3c.b) &&
+         (v1c.a == v2c.a && v2c.a == v3c.a)) {
+      grad = 0;
+   }
+
+   if (texture) {
+      if (grad) {
+         state_texture_grad_any_2d state;
+         bool unlock = lock_tiled_texture(texture);
+         state.solid.target = ctx->target;
+         state.solid.texture = texture;
+         state.solid.blender = blender;
+
+         if (shade) {
+            draw_soft_triangle(ctx, v1, v2, v3, (uintptr_t)&state, shader_texture_grad_any_init, shader_texture_grad_any_first, shader_texture_grad_any_step, shader_texture_grad_any_draw_shade);
+         } else {
+            draw_soft_triangle(ctx, v1, v2, v3, (uintptr_t)&state, shader_texture_grad_any_init, shader_texture_grad_any_first, shader_texture_grad_any_step, shader_texture_grad_any_draw_opaque);
+         }
+         if (unlock)
+            al_unlock_bitmap(texture);
+      } else {
+         int white = 0;
+         int blend_8888;
+         state_texture_8888_2d state;
+         shader_draw draw;
+         bool unlock = false;
+
+         if (v1c.r == 1 && v1c.g == 1 && v1c.b == 1 && v1c.a == 1) {
+            white = 1;
+         }
+         state.solid.target = ctx->target;
+         state.solid.texture = texture;
+         state.solid.blender = blender;
+         if (shade) {
+            if (white) {
+               draw = shader_texture_solid_any_draw_shade_white;
+            } else {
+               draw = shader_texture_solid_any_draw_shade;
+            }
+         } else {
+            if (white) {
+               draw = shader_texture_solid_any_draw_opaque_white;
+            } else {
+               draw = shader_texture_solid_any_draw_opaque;
+            }
+         }
+
+         blend_8888 = get_8888_blend(ctx->target, texture, shade, v1c,
+            ctx->op, ctx->src_mode, ctx->dst_mode,
+            ctx->op_alpha, ctx->src_alpha, ctx->dst_alpha);
+         state.tiled = can_read_tiles(ctx->target, texture, blend_8888);
+         if (!state.tiled)
+            unlock = lock_tiled_texture(texture);
+         if (blend_8888 >= 0) {
+            state.blend = blend_8888;
+            state.white = white;
+            state.fallback = draw;
+            draw = shader_texture_8888_draw;
+         }
+
+         draw_soft_triangle(ctx, v1, v2, v3, (uintptr_t)&state, shader_texture_solid_any_init, shader_texture_solid_any_first, shader_texture_solid_any_step, draw);
+         if (unlock)
+            al_unlock_bitmap(texture);
+      }
+   } else {
+      if (grad) {
+         state_grad_any_2d state;
+         state.solid.target = ctx->target;
+         state.solid.blender = blender;
+         if (shade) {
+            draw_soft_triangle(ctx, v1, v2, v3, (uintptr_t)&state, shader_grad_any_init, shader_grad_any_first, shader_grad_any_step, shader_grad_any_draw_shade);
+         } else {
+            draw_soft_triangle(ctx, v1, v2, v3, (uintptr_t)&state, shader_grad_any_init, shader_grad_any_first, shader_grad_any_step, shader_grad_any_draw_opaque);
+         }
+      } else {
+         int blend_8888;
+         state_solid_8888_2d state;
+         shader_draw draw;
+
+         state.solid.target = ctx->target;
+         state.solid.blender = blender;
+         if (shade) {
+            draw = shader_solid_any_draw_shade;
+         } else {
+            draw = shader_solid_any_draw_opaque;
+         }
+
+         blend_8888 = get_8888_blend(ctx->target, NULL, shade, v1c,
+            ctx->op, ctx->src_mode, ctx->dst_mode,
+            ctx->op_alpha, ctx->src_alpha, ctx->dst_alpha);
+         if (blend_8888 >= 0) {
+            state.blend = blend_8888;
+            state.fallback = draw;
+            draw = shader_solid_8888_draw;
+         }
+
+         draw_soft_triangle(ctx, v1, v2, v3, (uintptr_t)&state, shader_solid_any_init, shader_solid_any_first, shader_solid_any_step, draw);
+      }
+   }
+}
+
+void _al_triangle_2d(ALLEGRO_BITMAP* texture, ALLEGRO_VERTEX* v1, ALLEGRO_VERTEX* v2, ALLEGRO_VERTEX* v3)
+{
+   triangle_context ctx;
+
+   init_target_context(&ctx);
+   init_blender_context(&ctx);
+   triangle_2d(&ctx, texture, v1, v2, v3);
+}
+
+/*========================== Tiled drawing ===================================*/
+
+/*
+Many triangles going to a memory bitmap are drawn on the worker threads. The
+clipping rectangle is cut into horizontal bands, the triangles are binned by
+the bands they overlap, and every band draws its triangles in order, so the
+result is the same as drawing them one after another. Bands never share a
+scanline, so the threads write to the locked region without contention.
+*/
+
+/* Bands are at least this high, so the edges aren't walked too often. */
+#define BAND_MIN_HEIGHT  16
+
+/* Bands per thread, to even out bands with more work than others. */
+#define BANDS_PER_THREAD  4
+
+/* Smaller jobs, by the total area of the triangles' bounding boxes, are
+ * drawn on the calling thread.
+ */
+#define PARALLEL_MIN_PIXELS  (128 * 128)
+
+typedef struct {
+   const triangle_context *ctx;
+   ALLEGRO_BITMAP *texture;
+   ALLEGRO_VERTEX *vtxs;
+   const int *indices;
+   int band_height;
+   const int *bin_start;
+   const int *bins;
+} triangles_job;
+
+static void draw_band(int band, void *arg)
+{
+   const triangles_job *job = arg;
+   triangle_context ctx = *job->ctx;
+   int i;
+
+   ctx.band_min_y = ctx.clip_min_y + band * job->band_height;
+   ctx.band_max_y = ctx.band_min_y + job->band_height;
+
+   for (i = job->bin_start[band]; i < job->bin_start[band + 1]; i++) {
+      const int *t = job->indices + 3 * job->bins[i];
+      triangle_2d(&ctx, job->texture,
+         &job->vtxs[t[0]], &job->vtxs[t[1]], &job->vtxs[t[2]]);
+   }
+}
+
+/*
+Returns the first and last band touched by the triangle, or false if it is
+outside the clipping rectangle.
+*/
+static bool triangle_bands(const triangle_context *ctx, int band_height,
+   int num_bands, const ALLEGRO_VERTEX *v1, const ALLEGRO_VERTEX *v2,
+   const ALLEGRO_VERTEX *v3, int *first, int *last, int *area)
+{
+   int min_x = (int)floorf(MIN(v1->x, MIN(v2->x, v3->x))) - 1;
+   int min_y = (int)floorf(MIN(v1->y, MIN(v2->y, v3->y))) - 1;
+   int max_x = (int)ceilf(MAX(v1->x, MAX(v2->x, v3->x))) + 1;
+   int max_y = (int)ceilf(MAX(v1->y, MAX(v2->y, v3->y))) + 1;
+
+   min_x = MAX(min_x, ctx->clip_min_x);
+   min_y = MAX(min_y, ctx->clip_min_y);
+   max_x = MIN(max_x, ctx->clip_max_x);
+   max_y = MIN(max_y, ctx->clip_max_y);
+   if (min_x >= max_x || min_y >= max_y)
+      return false;
+
+   *first = (min_y - ctx->clip_min_y) / band_height;
+   *last = MIN((max_y - 1 - ctx->clip_min_y) / band_height, num_bands - 1);
+   *area = (max_x - min_x) * (max_y - min_y);
+   return true;
+}
+
+/*
+Draws num_triangles triangles, given by three indices into vtxs each.
+*/
+void _al_draw_soft_triangles(ALLEGRO_BITMAP* texture, ALLEGRO_VERTEX* vtxs,
+   const int* indices, int num_triangles)
+{
+   triangle_context ctx;
+   triangles_job job;
+   int num_threads;
+   int num_bands;
+   int band_height;
+   int clip_h;
+   int *bin_start = NULL;
+   int *bins = NULL;
+   int total_area = 0;
+   int i, b;
+
+   init_target_context(&ctx);
+   init_blender_context(&ctx);
+
+   num_threads = 1;
+   if (al_get_bitmap_flags(ctx.target) & ALLEGRO_MEMORY_BITMAP)
+      num_threads = _al_get_worker_count();
+
+   clip_h = ctx.clip_max_y - ctx.clip_min_y;
+   band_height = MAX(BAND_MIN_HEIGHT,
+      (clip_h + num_threads * BANDS_PER_THREAD - 1) /
+      (num_threads * BANDS_PER_THREAD));
+   num_bands = (clip_h + band_height - 1) / band_height;
+   if (num_threads < 2 || num_bands < 2 || al_is_bitmap_locked(
+         _AL_LOCK_HOLDER(ctx.target)))
+      goto serial;
+
+   bin_start = al_calloc(num_bands + 1, sizeof(int));
+   if (!bin_start)
+      goto serial;
+
+   /* Count the triangles in each band, then place them. */
+   for (i = 0; i < num_triangles; i++) {
+      const int *t = indices + 3 * i;
+      int first, last, area;
+      if (!triangle_bands(&ctx, band_height, num_bands,
+            &vtxs[t[0]], &vtxs[t[1]], &vtxs[t[2]], &first, &last, &area))
+         continue;
+      for (b = first; b <= last; b++)
+         bin_start[b + 1]++;
+      if (total_area < PARALLEL_MIN_PIXELS)
+         total_area += area;
+   }
+   if (total_area < PARALLEL_MIN_PIXELS)
+      goto serial;
+
+   for (b = 0; b < num_bands; b++)
+      bin_start[b + 1] += bin_start[b];
+   bins = al_malloc(MAX(bin_start[num_bands], 1) * sizeof(int));
+   if (!bins)
+      goto serial;
+
+   for (i = 0; i < num_triangles; i++) {
+      const int *t = indices + 3 * i;
+      int first, last, area;
+      if (!triangle_bands(&ctx, band_height, num_bands,
+            &vtxs[t[0]], &vtxs[t[1]], &vtxs[t[2]], &first, &last, &area))
+         continue;
+      for (b = first; b <= last; b++)
+         bins[bin_start[b]++] = i;
+   }
+   /* Placing moved every start to the next band's start. */
+   for (b = num_bands; b > 0; b--)
+      bin_start[b] = bin_start[b - 1];
+   bin_start[0] = 0;
+
+   /* Lock the whole clipping rectangle up front, the threads only draw. */
+   if (!_al_lock_drawn_region(ctx.target, ctx.clip_min_x, ctx.clip_min_y,
+         ctx.clip_max_x - ctx.clip_min_x, clip_h))
+      goto serial;
+   ctx.locked = true;
+
+   job.ctx = &ctx;
+   job.texture = texture;
+   job.vtxs = vtxs;
+   job.indices = indices;
+   job.band_height = band_height;
+   job.bin_start = bin_start;
+   job.bins = bins;
+   _al_run_parallel(num_bands, draw_band, &job);
+
+   al_unlock_bitmap(ctx.target);
+   al_free(bin_start);
+   al_free(bins);
+   return;
+
+serial:
+   al_free(bin_start);
+   al_free(bins);
+   for (i = 0; i < num_triangles; i++) {
+      const int *t = indices + 3 * i;
+      triangle_2d(&ctx, texture, &vtxs[t[0]], &vtxs[t[1]], &vtxs[t[2]]);
+   }
+}
+
+void _al_draw_soft_triangle(
+   ALLEGRO_VERTEX* v1, ALLEGRO_VERTEX* v2, ALLEGRO_VERTEX* v3, uintptr_t state,
+   void (*init)(uintptr_t, ALLEGRO_VERTEX*, ALLEGRO_VERTEX*, ALLEGRO_VERTEX*),
+   void (*first)(uintptr_t, int, int, int, int),
+   void (*step)(uintptr_t, int),
+   void (*draw)(uintptr_t, int, int, int))
+{
+   triangle_context ctx;
+
+   init_target_context(&ctx);
+   draw_soft_triangle(&ctx, v1, v2, v3, state, init, first, step, draw);
+}
+
 /* vim: set sts=3 sw=3 et: */
@@ -32,6 +32,11 @@
 #include "allegro5/internal/aintern_vector.h"
 #include "allegro5/platform/aintunix.h"
 
+#ifdef ALLEGRO_HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+ALLEGRO_DEBUG_CHANNEL("system")
 
 
 typedef struct WATCH_ITEM
@@ -46,68 +51,136 @@ static _AL_THREAD fd_watch_thread;
 static _AL_MUTEX fd_watch_mutex = _AL_MUTEX_UNINITED;
 static _AL_VECTOR fd_watch_list = _AL_VECTOR_INITIALIZER(WATCH_ITEM);
 
+#ifdef ALLEGRO_HAVE_SYS_EPOLL_H
+/* With epoll the kernel keeps the set of watched fds, so the thread does
+ * not have to rebuild and rescan an fd_set on every wakeup.  If the epoll
+ * instance cannot be created we fall back to select.
+ */
+static int fd_watch_epoll = -1;
+#endif
 
+#define FD_WATCH_TIMEOUT_MS   250
 
-/* fd_watch_thread_func: [fdwatch thread]
- *  The thread loop function.
+
+
+#ifdef ALLEGRO_HAVE_SYS_EPOLL_H
+/* dispatch_fd: [fdwatch thread]
+ *  Call the callback for `fd', if it is still being watched.
  */
-static void fd_watch_thread_func(_AL_THREAD *self, void *unused)
+static void dispatch_fd(int fd)
 {
-   (void)unused;
+   _al_mutex_lock(&fd_watch_mutex);
+   {
+      WATCH_ITEM *wi;
+      unsigned int i;
 
-   while (!_al_get_thread_should_stop(self)) {
+      for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
+         wi = _al_vector_ref(&fd_watch_list, i);
+         if (wi->fd == fd) {
+            /* The callback is allowed to modify the watch list so the mutex
+             * must be recursive.
+             */
+            wi->callback(wi->cb_data);
+            break;
+         }
+      }
+   }
+   _al_mutex_unlock(&fd_watch_mutex);
+}
 
-      fd_set rfds;
-      int max_fd;
 
-      /* set up max_fd and rfds */
-      _al_mutex_lock(&fd_watch_mutex);
-      {
-         WATCH_ITEM *wi;
-         unsigned int i;
 
-         FD_ZERO(&rfds);
-         max_fd = -1;
+/* wait_epoll: [fdwatch thread]
+ *  Wait for activity with epoll and dispatch to the callbacks.
+ */
+static void wait_epoll(void)
+{
+   struct epoll_event events[16];
+   int n, i;
 
-         for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
-            wi = _al_vector_ref(&fd_watch_list, i);
-            FD_SET(wi->fd, &rfds);
-            if (wi->fd > max_fd)
-               max_fd = wi->fd;
-         }
-      }
-      _al_mutex_unlock(&fd_watch_mutex);
+   n = epoll_wait(fd_watch_epoll, events, 16, FD_WATCH_TIMEOUT_MS);
+   for (i = 0; i < n; i++)
+      dispatch_fd(events[i].data.fd);
+}
+#endif
 
-      /* wait for something to happen on one of the fds */
-      {
-         struct timeval tv;
-         int retval;
 
-         tv.tv_sec = 0;
-         tv.tv_usec = 250000;
 
-         retval = select(max_fd+1, &rfds, NULL, NULL, &tv);
-         if (retval < 1)
-            continue;
+/* wait_select: [fdwatch thread]
+ *  Wait for activity with select and dispatch to the callbacks.
+ */
+static void wait_select(void)
+{
+   fd_set rfds;
+   int max_fd;
+
+   /* set up max_fd and rfds */
+   _al_mutex_lock(&fd_watch_mutex);
+   {
+      WATCH_ITEM *wi;
+      unsigned int i;
+
+      FD_ZERO(&rfds);
+      max_fd = -1;
+
+      for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
+         wi = _al_vector_ref(&fd_watch_list, i);
+         FD_SET(wi->fd, &rfds);
+         if (wi->fd > max_fd)
+            max_fd = wi->fd;
       }
+   }
+   _al_mutex_unlock(&fd_watch_mutex);
+
+   /* wait for something to happen on one of the fds */
+   {
+      struct timeval tv;
+      int retval;
+
+      tv.tv_sec = 0;
+      tv.tv_usec = FD_WATCH_TIMEOUT_MS * 1000;
+
+      retval = select(max_fd+1, &rfds, NULL, NULL, &tv);
+      if (retval < 1)
+         return;
+   }
 
-      /* one or more of the fds has activity */
-      _al_mutex_lock(&fd_watch_mutex);
-      {
-         WATCH_ITEM *wi;
-         unsigned int i;
-
-         for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
-            wi = _al_vector_ref(&fd_watch_list, i);
-            if (FD_ISSET(wi->fd, &rfds)) {
-               /* The callback is allowed to modify the watch list so the mutex
-                * must be recursive.
-                */
-               wi->callback(wi->cb_data);
-            }
+   /* one or more of the fds has activity */
+   _al_mutex_lock(&fd_watch_mutex);
+   {
+      WATCH_ITEM *wi;
+      unsigned int i;
+
+      for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
+         wi = _al_vector_ref(&fd_watch_list, i);
+         if (FD_ISSET(wi->fd, &rfds)) {
+            /* The callback is allowed to modify the watch list so the mutex
+             * must be recursive.
+             */
+            wi->callback(wi->cb_data);
          }
       }
-      _al_mutex_unlock(&fd_watch_mutex);
+   }
+   _al_mutex_unlock(&fd_watch_mutex);
+}
+
+
+
+/* fd_watch_thread_func: [fdwatch thread]
+ *  The thread loop function.
+ */
+static void fd_watch_thread_func(_AL_THREAD *self, void *unused)
+{
+   (void)unused;
+
+   while (!_al_get_thread_should_stop(self)) {
+#ifdef ALLEGRO_HAVE_SYS_EPOLL_H
+      if (fd_watch_epoll >= 0) {
+         wait_epoll();
+         continue;
+      }
+#endif
+      wait_select();
    }
 }
 
@@ -135,6 +208,11 @@ void _al_unix_start_watching_fd(int fd, void (*callback)(void *), void *cb_data)
        * list.
        */
       _al_mutex_init_recursive(&fd_watch_mutex);
+#ifdef ALLEGRO_HAVE_SYS_EPOLL_H
+      fd_watch_epoll = epoll_create1(EPOLL_CLOEXEC);
+      if (fd_watch_epoll < 0)
+         ALLEGRO_WARN("epoll_create1 failed, falling back to select.\n");
+#endif
       _al_thread_create(&fd_watch_thread, fd_watch_thread_func, NULL);
    }
 
@@ -146,6 +224,18 @@ void _al_unix_start_watching_fd(int fd, void (*callback)(void *), void *cb_data)
       wi->fd = fd;
       wi->callback = callback;
       wi->cb_data = cb_data;
+
+#ifdef ALLEGRO_HAVE_SYS_EPOLL_H
+      if (fd_watch_epoll >= 0) {
+         struct epoll_event ev;
+
+         ev.events = EPOLLIN;
+         ev.data.u64 = 0;
+         ev.data.fd = fd;
+         if (epoll_ctl(fd_watch_epoll, EPOLL_CTL_ADD, fd, &ev) != 0)
+            ALLEGRO_WARN("epoll_ctl failed to add fd %d.\n", fd);
+      }
+#endif
    }
    _al_mutex_unlock(&fd_watch_mutex);
 }
@@ -172,6 +262,10 @@ void _al_unix_stop_watching_fd(int fd)
       for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
          wi = _al_vector_ref(&fd_watch_list, i);
          if (wi->fd == fd) {
+#ifdef ALLEGRO_HAVE_SYS_EPOLL_H
+            if (fd_watch_epoll >= 0)
+               epoll_ctl(fd_watch_epoll, EPOLL_CTL_DEL, fd, NULL);
+#endif
             _al_vector_delete_at(&fd_watch_list, i);
             list_empty = _al_vector_is_empty(&fd_watch_list);
             break;
@@ -183,6 +277,12 @@ void _al_unix_stop_watching_fd(int fd)
    /* if no more fd's are being watched, stop the background thread */
    if (list_empty) {
       _al_thread_join(&fd_watch_thread);
+#ifdef ALLEGRO_HAVE_SYS_EPOLL_H
+      if (fd_watch_epoll >= 0) {
+         close(fd_watch_epoll);
+         fd_watch_epoll = -1;
+      }
+#endif
       _al_mutex_destroy(&fd_watch_mutex);
       _al_vector_free(&fd_watch_list);
    }
@@ -24,7 +24,7 @@
 
 
 _AL_BEGIN_HAPTIC_DRIVER_LIST
-#if defined ALLEGRO_HAVE_LINUX_INPUT_H && (defined ALLEGRO_WITH_XWINDOWS || defined ALLEGRO_RASPBERRYPI)
+#if defined ALLEGRO_HAVE_LINUX_INPUT_H && (defined ALLEGRO_WITH_XWINDOWS || defined ALLEGRO_RASPBERRYPI || defined ALLEGRO_KMS)
    { _ALLEGRO_HAPDRV_LINUX,   &_al_hapdrv_linux,   true  },
 #endif
 _AL_END_HAPTIC_DRIVER_LIST
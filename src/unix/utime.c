@@ -17,7 +17,10 @@
 
 
 #include <sys/time.h>
+#include <errno.h>
 #include <math.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "allegro5/altime.h"
 #include "allegro5/debug.h"
@@ -29,7 +32,47 @@ ALLEGRO_STATIC_ASSERT(utime,
 
 
 /* Marks the time Allegro was initialised, for al_get_time(). */
-struct timeval _al_unix_initial_time;
+static struct timespec initial_time;
+
+
+
+#ifdef ALLEGRO_UNIX_MONOTONIC_CLOCK
+   #define TIMEOUT_CLOCK   CLOCK_MONOTONIC
+#else
+   #define TIMEOUT_CLOCK   CLOCK_REALTIME
+#endif
+
+
+
+/* get_now:
+ *  Reads the clock that timeouts are measured on.
+ */
+static void get_now(struct timespec *now)
+{
+#ifdef ALLEGRO_UNIX_MONOTONIC_CLOCK
+   clock_gettime(CLOCK_MONOTONIC, now);
+#else
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   now->tv_sec = tv.tv_sec;
+   now->tv_nsec = tv.tv_usec * 1000;
+#endif
+}
+
+
+
+/* add_seconds:
+ *  Adds a non-negative number of seconds to a timespec.
+ */
+static void add_seconds(struct timespec *ts, double seconds)
+{
+   double fsecs = floor(seconds);
+
+   ts->tv_sec += (time_t) fsecs;
+   ts->tv_nsec += (long) ((seconds - fsecs) * 1e9);
+   ts->tv_sec += ts->tv_nsec / 1000000000L;
+   ts->tv_nsec = ts->tv_nsec % 1000000000L;
+}
 
 
 
@@ -38,24 +81,36 @@ struct timeval _al_unix_initial_time;
  */
 void _al_unix_init_time(void)
 {
-   gettimeofday(&_al_unix_initial_time, NULL);
+   get_now(&initial_time);
 }
 
 
 
 double _al_unix_get_time(void)
 {
-   struct timeval now;
+   struct timespec now;
    double time;
 
-   gettimeofday(&now, NULL);
-   time = (double) (now.tv_sec - _al_unix_initial_time.tv_sec)
-      + (double) (now.tv_usec - _al_unix_initial_time.tv_usec) * 1.0e-6;
+   get_now(&now);
+   time = (double) (now.tv_sec - initial_time.tv_sec)
+      + (double) (now.tv_nsec - initial_time.tv_nsec) * 1.0e-9;
    return time;
 }
 
 
 
+/* _al_unix_time_from_timeval:
+ *  Converts a time read from the clock that al_get_time() is based on, like
+ *  that of an evdev input event, to al_get_time() terms.
+ */
+double _al_unix_time_from_timeval(const struct timeval *tv)
+{
+   return (double) (tv->tv_sec - initial_time.tv_sec)
+      + ((double) tv->tv_usec * 1000.0 - initial_time.tv_nsec) * 1.0e-9;
+}
+
+
+
 void _al_unix_rest(double seconds)
 {
    struct timespec timeout;
@@ -67,29 +122,57 @@ void _al_unix_rest(double seconds)
 
 
 
+/* _al_unix_rest_until:
+ *  Sleeps until al_get_time() reaches the given time.  Where available this
+ *  is an absolute wait on the same clock as al_get_time(), so the wake up
+ *  time doesn't depend on how long it took to get here.
+ */
+void _al_unix_rest_until(double time)
+{
+#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) && !defined(ALLEGRO_MACOSX)
+   struct timespec abstime = initial_time;
+
+   if (time > 0)
+      add_seconds(&abstime, time);
+
+   while (clock_nanosleep(TIMEOUT_CLOCK, TIMER_ABSTIME, &abstime, NULL)
+         == EINTR)
+      ;
+#else
+   double seconds = time - _al_unix_get_time();
+   if (seconds > 0)
+      _al_unix_rest(seconds);
+#endif
+}
+
+
+
 void _al_unix_init_timeout(ALLEGRO_TIMEOUT *timeout, double seconds)
 {
    ALLEGRO_TIMEOUT_UNIX *ut = (ALLEGRO_TIMEOUT_UNIX *) timeout;
-   struct timeval now;
-   double integral;
-   double frac;
 
    ASSERT(ut);
 
-   gettimeofday(&now, NULL);
+   get_now(&ut->abstime);
+   if (seconds > 0.0)
+      add_seconds(&ut->abstime, seconds);
+}
+
 
-   if (seconds <= 0.0) {
-      ut->abstime.tv_sec = now.tv_sec;
-      ut->abstime.tv_nsec = now.tv_usec * 1000;
-   }
-   else {
-      frac = modf(seconds, &integral);
 
-      ut->abstime.tv_sec = now.tv_sec + integral;
-      ut->abstime.tv_nsec = (now.tv_usec * 1000) + (frac * 1000000000L);
-      ut->abstime.tv_sec += ut->abstime.tv_nsec / 1000000000L;
-      ut->abstime.tv_nsec = ut->abstime.tv_nsec % 1000000000L;
-   }
+/* _al_unix_init_timeout_until:
+ *  Like _al_unix_init_timeout, but for a deadline given in al_get_time()
+ *  terms.  This needs no clock reading at all.
+ */
+void _al_unix_init_timeout_until(ALLEGRO_TIMEOUT *timeout, double time)
+{
+   ALLEGRO_TIMEOUT_UNIX *ut = (ALLEGRO_TIMEOUT_UNIX *) timeout;
+
+   ASSERT(ut);
+
+   ut->abstime = initial_time;
+   if (time > 0.0)
+      add_seconds(&ut->abstime, time);
 }
 
 /* vim: set sts=3 sw=3 et */
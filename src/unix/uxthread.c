@@ -180,6 +180,22 @@ void _al_mutex_destroy(_AL_MUTEX *mutex)
 /* condition variables */
 /* most of the condition variable implementation is actually inline */
 
+void _al_cond_init(_AL_COND *cond)
+{
+#ifdef ALLEGRO_UNIX_MONOTONIC_CLOCK
+   pthread_condattr_t attr;
+
+   /* The timeouts from _al_unix_init_timeout are on this clock. */
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&cond->cond, &attr);
+   pthread_condattr_destroy(&attr);
+#else
+   pthread_cond_init(&cond->cond, NULL);
+#endif
+}
+
+
 int _al_cond_timedwait(_AL_COND *cond, _AL_MUTEX *mutex,
    const ALLEGRO_TIMEOUT *timeout)
 {
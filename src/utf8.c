@@ -17,6 +17,7 @@
 
 
 #include <stdarg.h>
+#include <string.h>
 #include "allegro5/allegro.h"
 #include "allegro5/utf8.h"
 #include "allegro5/internal/bstrlib.h"
@@ -41,6 +42,52 @@ ALLEGRO_STATIC_ASSERT(utf8,
 #define IS_LEAD_BYTE(c)    (((unsigned)(c) - 0xC0) < 0x3E)
 #define IS_TRAIL_BYTE(c)   (((unsigned)(c) & 0xC0) == 0x80)
 
+/* SSE2 and NEON are part of the baseline on x86-64 and AArch64, so ASCII
+ * scanning needs no runtime dispatch there.
+ */
+#if defined(__SSE2__) || defined(_M_X64) || \
+   (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+   #define UTF8_SSE2
+   #include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+   #define UTF8_NEON
+   #include <arm_neon.h>
+#endif
+
+
+/* Return the first byte offset at or after pos, but before size, which does
+ * not hold an ASCII character, or size if there is none.
+ */
+static int ascii_run_end(const unsigned char *data, int pos, int size)
+{
+#if defined(UTF8_SSE2)
+   while (pos + 16 <= size) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(data + pos));
+      if (_mm_movemask_epi8(v) != 0)
+         break;
+      pos += 16;
+   }
+#elif defined(UTF8_NEON)
+   while (pos + 16 <= size) {
+      if (vmaxvq_u8(vld1q_u8(data + pos)) >= 0x80)
+         break;
+      pos += 16;
+   }
+#else
+   while (pos + 8 <= size) {
+      uint64_t w;
+      memcpy(&w, data + pos, 8);
+      if (w & UINT64_C(0x8080808080808080))
+         break;
+      pos += 8;
+   }
+#endif
+
+   while (pos < size && IS_SINGLE_BYTE(data[pos]))
+      pos++;
+   return pos;
+}
+
 
 static bool all_ascii(const ALLEGRO_USTR *us)
 {
@@ -192,6 +239,138 @@ const ALLEGRO_USTR *al_ref_ustr(ALLEGRO_USTR_INFO *info, const ALLEGRO_USTR *us,
 }
 
 
+/* String arenas hand out read-only strings from large chunks, so that many
+ * small strings cost no allocation each and are freed together.
+ */
+
+#define ARENA_CHUNK_SIZE   4096
+#define ARENA_ALIGN(n)     (((n) + 7) & ~(size_t)7)
+
+typedef struct ARENA_CHUNK ARENA_CHUNK;
+
+struct ARENA_CHUNK
+{
+   ARENA_CHUNK *next;
+   size_t size;
+   size_t used;
+};
+
+struct ALLEGRO_USTR_ARENA
+{
+   ARENA_CHUNK *chunks;
+};
+
+#define CHUNK_HEADER_SIZE  ARENA_ALIGN(sizeof(ARENA_CHUNK))
+
+
+static void *arena_alloc(ALLEGRO_USTR_ARENA *arena, size_t size)
+{
+   ARENA_CHUNK *chunk = arena->chunks;
+   void *p;
+
+   size = ARENA_ALIGN(size);
+
+   if (!chunk || chunk->size - chunk->used < size) {
+      size_t chunk_size = _ALLEGRO_MAX(size, ARENA_CHUNK_SIZE);
+
+      /* A big string gets a chunk to itself, behind the current one, so
+       * that the space left in the current chunk is not wasted.
+       */
+      ARENA_CHUNK *c = al_malloc(CHUNK_HEADER_SIZE + chunk_size);
+      if (!c)
+         return NULL;
+      c->size = chunk_size;
+      c->used = 0;
+      if (chunk && size > ARENA_CHUNK_SIZE / 2) {
+         c->next = chunk->next;
+         chunk->next = c;
+      }
+      else {
+         c->next = chunk;
+         arena->chunks = c;
+      }
+      chunk = c;
+   }
+
+   p = (char *)chunk + CHUNK_HEADER_SIZE + chunk->used;
+   chunk->used += size;
+   return p;
+}
+
+
+/* Function: al_create_ustr_arena
+ */
+ALLEGRO_USTR_ARENA *al_create_ustr_arena(void)
+{
+   return al_calloc(1, sizeof(ALLEGRO_USTR_ARENA));
+}
+
+
+/* Function: al_destroy_ustr_arena
+ */
+void al_destroy_ustr_arena(ALLEGRO_USTR_ARENA *arena)
+{
+   ARENA_CHUNK *chunk;
+
+   if (!arena)
+      return;
+
+   chunk = arena->chunks;
+   while (chunk) {
+      ARENA_CHUNK *next = chunk->next;
+      al_free(chunk);
+      chunk = next;
+   }
+   al_free(arena);
+}
+
+
+/* Function: al_ustr_new_from_buffer_in_arena
+ */
+const ALLEGRO_USTR *al_ustr_new_from_buffer_in_arena(ALLEGRO_USTR_ARENA *arena,
+   const char *s, size_t size)
+{
+   ALLEGRO_USTR_INFO *info;
+   char *data;
+   ASSERT(arena);
+   ASSERT(s || size == 0);
+
+   info = arena_alloc(arena, ARENA_ALIGN(sizeof *info) + size + 1);
+   if (!info)
+      return NULL;
+
+   /* The string is stored right behind its header, NUL-terminated so that
+    * al_cstr works.
+    */
+   data = (char *)info + ARENA_ALIGN(sizeof *info);
+   if (size > 0)
+      memcpy(data, s, size);
+   data[size] = '\0';
+   return al_ref_buffer(info, data, size);
+}
+
+
+/* Function: al_ustr_new_in_arena
+ */
+const ALLEGRO_USTR *al_ustr_new_in_arena(ALLEGRO_USTR_ARENA *arena,
+   const char *s)
+{
+   ASSERT(s);
+   return al_ustr_new_from_buffer_in_arena(arena, s, strlen(s));
+}
+
+
+/* Function: al_ustr_dup_in_arena
+ */
+const ALLEGRO_USTR *al_ustr_dup_in_arena(ALLEGRO_USTR_ARENA *arena,
+   const ALLEGRO_USTR *us)
+{
+   ASSERT(us);
+   return al_ustr_new_from_buffer_in_arena(arena, al_cstr(us),
+      al_ustr_size(us));
+}
+
+
 /* Function: al_ustr_size
  */
 size_t al_ustr_size(const ALLEGRO_USTR *us)
@@ -204,11 +383,28 @@ size_t al_ustr_size(const ALLEGRO_USTR *us)
  */
 size_t al_ustr_length(const ALLEGRO_USTR *us)
 {
-   int pos = 0;
-   int c = 0;
+   const unsigned char *data = (const unsigned char *) _al_bdata(us);
+   int size = _al_blength(us);
+   int pos, end;
+   size_t c;
 
-   while (al_ustr_next(us, &pos))
-      c++;
+   if (size <= 0)
+      return 0;
+
+   /* Count the positions al_ustr_next would stop at.  The first byte always
+    * starts a code point, whatever it is.
+    */
+   c = 1;
+   pos = 1;
+   for (;;) {
+      end = ascii_run_end(data, pos, size);
+      c += end - pos;
+      if (end >= size)
+         break;
+      if (IS_LEAD_BYTE(data[end]))
+         c++;
+      pos = end + 1;
+   }
 
    return c;
 }
@@ -218,14 +414,32 @@ size_t al_ustr_length(const ALLEGRO_USTR *us)
  */
 int al_ustr_offset(const ALLEGRO_USTR *us, int index)
 {
+   const unsigned char *data = (const unsigned char *) _al_bdata(us);
+   int size = _al_blength(us);
    int pos = 0;
+   int run;
 
    if (index < 0)
       index += al_ustr_length(us);
 
-   while (index-- > 0) {
+   while (index > 0) {
+      /* Within a run of ASCII characters every byte is a code point.  The
+       * byte after the run may be a trailing byte though, so only the end
+       * of the string may be skipped to directly.
+       */
+      run = ascii_run_end(data, pos, size) - pos;
+      if (pos + run < size)
+         run--;
+      if (run > 0) {
+         if (run > index)
+            run = index;
+         pos += run;
+         index -= run;
+         continue;
+      }
       if (!al_ustr_next(us, &pos))
          return pos;
+      index--;
    }
 
    return pos;
@@ -367,7 +581,15 @@ int32_t al_ustr_get(const ALLEGRO_USTR *ub, int pos)
  */
 int32_t al_ustr_get_next(const ALLEGRO_USTR *us, int *pos)
 {
-   int32_t c = al_ustr_get(us, *pos);
+   const unsigned char *data = (const unsigned char *) _al_bdata(us);
+   int32_t c;
+
+   /* Fast path for ASCII characters. */
+   if (*pos >= 0 && *pos < _al_blength(us) && IS_SINGLE_BYTE(data[*pos])) {
+      return data[(*pos)++];
+   }
+
+   c = al_ustr_get(us, *pos);
 
    if (c >= 0) {
       (*pos) += al_utf8_width(c);
@@ -398,6 +620,42 @@ int32_t al_ustr_prev_get(const ALLEGRO_USTR *us, int *pos)
 }
 
 
+/* Function: al_ustr_decode_to_array
+ */
+int al_ustr_decode_to_array(const ALLEGRO_USTR *us, int *pos, int32_t *out,
+   int max)
+{
+   const unsigned char *data = (const unsigned char *) _al_bdata(us);
+   int size = _al_blength(us);
+   int n = 0;
+   int end;
+   int32_t c;
+   ASSERT(pos);
+   ASSERT(out || max <= 0);
+
+   if (*pos < 0)
+      return 0;
+
+   while (n < max && *pos < size) {
+      end = ascii_run_end(data, *pos, size);
+      if (end - *pos > max - n)
+         end = *pos + (max - n);
+      while (*pos < end)
+         out[n++] = data[(*pos)++];
+      if (n == max || *pos >= size)
+         break;
+
+      c = al_ustr_get(us, *pos);
+      if (c < 0)
+         break;
+      out[n++] = c;
+      *pos += al_utf8_width(c);
+   }
+
+   return n;
+}
+
+
 /* Function: al_ustr_insert
  */
 bool al_ustr_insert(ALLEGRO_USTR *us1, int pos, const ALLEGRO_USTR *us2)
@@ -769,6 +1027,8 @@ int al_ustr_find_set_cstr(const ALLEGRO_USTR *us, int start_pos,
 int al_ustr_find_cset(const ALLEGRO_USTR *us, int start_pos,
    const ALLEGRO_USTR *reject)
 {
+   const unsigned char *data = (const unsigned char *) _al_bdata(us);
+   unsigned char ascii_reject[128];
    int rc;
    int32_t c, d;
    int pos;
@@ -780,8 +1040,17 @@ int al_ustr_find_cset(const ALLEGRO_USTR *us, int start_pos,
       return (rc == _AL_BSTR_ERR) ? -1 : rc;
    }
 
-   /* Non-ASCII. */
-   pos = 0;
+   /* Non-ASCII.  ASCII characters in the string are still looked up in a
+    * table rather than by scanning the reject set.
+    */
+   memset(ascii_reject, 0, sizeof ascii_reject);
+   set_pos = 0;
+   while ((d = al_ustr_get_next(reject, &set_pos)) != -1) {
+      if (d >= 0 && d < 128)
+         ascii_reject[d] = 1;
+   }
+
+   pos = (start_pos > 0) ? start_pos : 0;
    while ((c = al_ustr_get(us, pos)) != -1) {
       if (c == -2) {
          /* Invalid byte sequence. */
@@ -789,6 +1058,18 @@ int al_ustr_find_cset(const ALLEGRO_USTR *us, int start_pos,
          continue;
       }
 
+      if (c < 128) {
+         if (!ascii_reject[c])
+            return pos;
+         pos++;
+         while (pos < _al_blength(us) && IS_SINGLE_BYTE(data[pos])) {
+            if (!ascii_reject[data[pos]])
+               return pos;
+            pos++;
+         }
+         continue;
+      }
+
       set_pos = 0;
       while ((d = al_ustr_get_next(reject, &set_pos)) != -1) {
          if (c == d)
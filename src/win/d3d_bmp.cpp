@@ -129,9 +129,10 @@ void _al_d3d_bmp_destroy(void)
    vt = NULL;
 }
 
-static INLINE void transform_vertex(float* x, float* y, float* z)
+static INLINE void transform_vertices(float *xyz, int n, int stride)
 {
-   al_transform_coordinates_3d(al_get_current_transform(), x, y, z);
+   al_transform_coordinates_3d_array(al_get_current_transform(), xyz, n,
+      stride);
 }
 
 /*
@@ -156,6 +157,7 @@ static void d3d_draw_textured_quad(
    ALLEGRO_DISPLAY* aldisp = (ALLEGRO_DISPLAY*)disp;
 
    if (aldisp->num_cache_vertices != 0 && (uintptr_t)bmp != aldisp->cache_texture) {
+      aldisp->stats.texture_flushes++;
       aldisp->vt->flush_vertex_cache(aldisp);
    }
    aldisp->cache_texture = (uintptr_t)bmp;
@@ -213,10 +215,8 @@ static void d3d_draw_textured_quad(
    vertices[5].v = tv_end; \
 \
    if (aldisp->cache_enabled) { \
-      transform_vertex(&vertices[0].x, &vertices[0].y, &vertices[0].z); \
-      transform_vertex(&vertices[1].x, &vertices[1].y, &vertices[1].z); \
-      transform_vertex(&vertices[2].x, &vertices[2].y, &vertices[2].z); \
-      transform_vertex(&vertices[5].x, &vertices[5].y, &vertices[5].z); \
+      transform_vertices(&vertices[0].x, 3, sizeof(vertices[0])); \
+      transform_vertices(&vertices[5].x, 1, sizeof(vertices[0])); \
    } \
     \
    vertices[3] = vertices[0]; \
@@ -306,14 +306,80 @@ static void d3d_sync_bitmap_texture(ALLEGRO_BITMAP *bitmap,
    }
 }
 
+/* Creates the system texture of a bitmap without a shadow copy, to stage
+ * a lock in.
+ */
+static bool d3d_create_system_texture(ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_BITMAP_EXTRA_D3D *d3d_bmp = get_extra(bitmap);
+
+   if (d3d_bmp->system_texture)
+      return true;
+
+   if (d3d_bmp->display->device->CreateTexture(
+         d3d_bmp->texture_w, d3d_bmp->texture_h, 1, 0,
+         (D3DFORMAT)_al_pixel_format_to_d3d(d3d_bmp->system_format),
+         D3DPOOL_SYSTEMMEM, &d3d_bmp->system_texture, NULL) != D3D_OK) {
+      ALLEGRO_ERROR("d3d_create_system_texture: Unable to create system texture.\n");
+      d3d_bmp->system_texture = NULL;
+      return false;
+   }
+   return true;
+}
+
+static void d3d_release_system_texture(ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_BITMAP_EXTRA_D3D *d3d_bmp = get_extra(bitmap);
+
+   if (d3d_bmp->no_shadow && d3d_bmp->system_texture) {
+      d3d_bmp->system_texture->Release();
+      d3d_bmp->system_texture = NULL;
+   }
+}
+
 static void d3d_do_upload(ALLEGRO_BITMAP *bmp, int x, int y, int width,
    int height, bool sync_from_memory)
 {
+   /* Without a shadow copy there is nothing to upload outside of a lock. */
+   if (get_extra(bmp)->no_shadow && !get_extra(bmp)->system_texture)
+      return;
+
    if (sync_from_memory) {
       d3d_sync_bitmap_texture(bmp, x, y, width, height);
    }
 
-   if (_al_d3d_render_to_texture_supported()
+   if (get_extra(bmp)->no_shadow) {
+      /* A fresh system texture counts as dirty everywhere, but only the
+       * locked region holds pixels, so update just that.
+       */
+      ALLEGRO_BITMAP_EXTRA_D3D *d3d_bitmap = get_extra(bmp);
+      LPDIRECT3DSURFACE9 system_surface = NULL;
+      LPDIRECT3DSURFACE9 video_surface = NULL;
+      RECT rect;
+      POINT point;
+
+      rect.left = x;
+      rect.top = y;
+      rect.right = x + width;
+      rect.bottom = y + height;
+      point.x = x;
+      point.y = y;
+
+      if (d3d_bitmap->system_texture->GetSurfaceLevel(0, &system_surface) != D3D_OK ||
+            d3d_bitmap->video_texture->GetSurfaceLevel(0, &video_surface) != D3D_OK ||
+            d3d_bitmap->display->device->UpdateSurface(system_surface, &rect,
+               video_surface, &point) != D3D_OK) {
+         ALLEGRO_ERROR("d3d_do_upload: Couldn't update surface.\n");
+      }
+      else if (al_get_bitmap_flags(bmp) & ALLEGRO_MIPMAP) {
+         d3d_bitmap->video_texture->GenerateMipSubLevels();
+      }
+      if (system_surface)
+         system_surface->Release();
+      if (video_surface)
+         video_surface->Release();
+   }
+   else if (_al_d3d_render_to_texture_supported()
          && !_al_pixel_format_is_compressed(al_get_bitmap_format(bmp))) {
       ALLEGRO_BITMAP_EXTRA_D3D *d3d_bitmap = get_extra(bmp);
       if (d3d_bitmap->display->device->UpdateTexture(
@@ -453,7 +519,8 @@ static ALLEGRO_BITMAP
 
    extra = get_extra(bitmap);
 
-   if (extra->system_texture->LockRect(0, &sys_locked_rect, 0, 0) != D3D_OK) {
+   if (!d3d_create_system_texture(bitmap) ||
+         extra->system_texture->LockRect(0, &sys_locked_rect, 0, 0) != D3D_OK) {
       surface->UnlockRect();
       al_destroy_bitmap(bitmap);
       ALLEGRO_ERROR("d3d_create_bitmap_from_surface: Lock system texture failed.\n");
@@ -477,6 +544,7 @@ static ALLEGRO_BITMAP
          (IDirect3DBaseTexture9 *)extra->video_texture) != D3D_OK) {
       ALLEGRO_ERROR("d3d_create_bitmap_from_surface: Couldn't update texture.\n");
    }
+   d3d_release_system_texture(bitmap);
 
    return bitmap;
 }
@@ -546,7 +614,7 @@ static bool _al_d3d_sync_bitmap(ALLEGRO_BITMAP *dest)
        }
    }
 
-   if (ok) {
+   if (ok && dest->memory) {
       d3d_sync_bitmap_memory(dest);
    }
 
@@ -610,10 +678,12 @@ bool _al_d3d_recreate_bitmap_textures(ALLEGRO_DISPLAY_D3D *disp)
             extra->texture_h,
             al_get_bitmap_flags(bmp),
             &extra->video_texture,
-            &extra->system_texture,
+            extra->no_shadow ? NULL : &extra->system_texture,
             al_get_bitmap_format(bmp),
             extra->system_format))
             return false;
+         if (extra->no_shadow)
+            continue;
          d3d_do_upload(bmp, 0, 0,
             _al_get_least_multiple(bmp->w, block_width),
             _al_get_least_multiple(bmp->h, block_height), true);
@@ -712,7 +782,7 @@ static bool d3d_upload_bitmap(ALLEGRO_BITMAP *bitmap)
                d3d_bmp->texture_h,
                al_get_bitmap_flags(bitmap),
                &d3d_bmp->video_texture,
-               &d3d_bmp->system_texture,
+               d3d_bmp->no_shadow ? NULL : &d3d_bmp->system_texture,
                bitmap_format,
                system_format)) {
             return false;
@@ -865,11 +935,14 @@ static ALLEGRO_LOCKED_REGION *d3d_lock_region(ALLEGRO_BITMAP *bitmap,
          texture = d3d_bmp->system_texture;
       }
       else if (_al_d3d_render_to_texture_supported()) {
+         if (!d3d_create_system_texture(bitmap))
+            return NULL;
          /* 
           * Sync bitmap->memory with texture
           */
          bitmap->locked = false;
          if (!(flags & ALLEGRO_LOCK_WRITEONLY) && !_al_d3d_sync_bitmap(bitmap)) {
+            d3d_release_system_texture(bitmap);
             return NULL;
          }
          bitmap->locked = true;
@@ -880,6 +953,7 @@ static ALLEGRO_LOCKED_REGION *d3d_lock_region(ALLEGRO_BITMAP *bitmap,
       }
       if (texture->LockRect(0, &d3d_bmp->locked_rect, &rect, Flags) != D3D_OK) {
          ALLEGRO_ERROR("LockRect failed in d3d_lock_region.\n");
+         d3d_release_system_texture(bitmap);
          return NULL;
       }
    }
@@ -896,10 +970,18 @@ static ALLEGRO_LOCKED_REGION *d3d_lock_region(ALLEGRO_BITMAP *bitmap,
       bitmap->locked_region.format = f;
       bitmap->locked_region.pixel_size = al_get_pixel_size(f);
       if (!(bitmap->lock_flags & ALLEGRO_LOCK_WRITEONLY)) {
-         _al_convert_bitmap_data(
-            d3d_bmp->locked_rect.pBits, system_format, d3d_bmp->locked_rect.Pitch,
-            bitmap->locked_region.data, f, bitmap->locked_region.pitch,
-            0, 0, 0, 0, w, h);
+         if (bitmap->_flags & ALLEGRO_PARALLEL_CONVERSION) {
+            _al_parallel_convert_bitmap_data(
+               d3d_bmp->locked_rect.pBits, system_format, d3d_bmp->locked_rect.Pitch,
+               bitmap->locked_region.data, f, bitmap->locked_region.pitch,
+               0, 0, 0, 0, w, h);
+         }
+         else {
+            _al_convert_bitmap_data(
+               d3d_bmp->locked_rect.pBits, system_format, d3d_bmp->locked_rect.Pitch,
+               bitmap->locked_region.data, f, bitmap->locked_region.pitch,
+               0, 0, 0, 0, w, h);
+         }
       }
    }
 
@@ -913,10 +995,18 @@ static void d3d_unlock_region(ALLEGRO_BITMAP *bitmap)
 
    if (bitmap->locked_region.format != 0 && bitmap->locked_region.format != system_format) {
       if (!(bitmap->lock_flags & ALLEGRO_LOCK_READONLY)) {
-         _al_convert_bitmap_data(
-            bitmap->locked_region.data, bitmap->locked_region.format, bitmap->locked_region.pitch,
-            d3d_bmp->locked_rect.pBits, system_format, d3d_bmp->locked_rect.Pitch,
-            0, 0, 0, 0, bitmap->lock_w, bitmap->lock_h);
+         if (bitmap->_flags & ALLEGRO_PARALLEL_CONVERSION) {
+            _al_parallel_convert_bitmap_data(
+               bitmap->locked_region.data, bitmap->locked_region.format, bitmap->locked_region.pitch,
+               d3d_bmp->locked_rect.pBits, system_format, d3d_bmp->locked_rect.Pitch,
+               0, 0, 0, 0, bitmap->lock_w, bitmap->lock_h);
+         }
+         else {
+            _al_convert_bitmap_data(
+               bitmap->locked_region.data, bitmap->locked_region.format, bitmap->locked_region.pitch,
+               d3d_bmp->locked_rect.pBits, system_format, d3d_bmp->locked_rect.Pitch,
+               0, 0, 0, 0, bitmap->lock_w, bitmap->lock_h);
+         }
       }
       al_free(bitmap->locked_region.data);
    }
@@ -935,8 +1025,10 @@ static void d3d_unlock_region(ALLEGRO_BITMAP *bitmap)
       else
          texture = d3d_bmp->video_texture;
       texture->UnlockRect(0);
-      if (bitmap->lock_flags & ALLEGRO_LOCK_READONLY)
+      if (bitmap->lock_flags & ALLEGRO_LOCK_READONLY) {
+         d3d_release_system_texture(bitmap);
          return;
+      }
 
       if (compressed) {
          int block_width = al_get_pixel_block_width(bitmap_format);
@@ -955,6 +1047,7 @@ static void d3d_unlock_region(ALLEGRO_BITMAP *bitmap)
       else {
          d3d_do_upload(bitmap, bitmap->lock_x, bitmap->lock_y,
             bitmap->lock_w, bitmap->lock_h, false);
+         d3d_release_system_texture(bitmap);
       }
    }
 }
@@ -1009,6 +1102,176 @@ static void d3d_unlock_compressed_region(ALLEGRO_BITMAP *bitmap)
 }
 
 
+/* Asynchronous readback: the region is copied on the GPU into a small render
+ * target and an event query is issued after it.  Only once the query has
+ * signalled is the render target copied into system memory, which then no
+ * longer stalls the pipeline.
+ */
+typedef struct D3D_READBACK
+{
+   LPDIRECT3DSURFACE9 render_target;
+   LPDIRECT3DSURFACE9 system_surface;
+   LPDIRECT3DQUERY9 query;
+   bool fetched;
+} D3D_READBACK;
+
+
+static void d3d_release_readback(D3D_READBACK *data)
+{
+   if (data->query)
+      data->query->Release();
+   if (data->system_surface)
+      data->system_surface->Release();
+   if (data->render_target)
+      data->render_target->Release();
+   al_free(data);
+}
+
+
+static bool d3d_readback_is_ready(ALLEGRO_BITMAP_READBACK *rb)
+{
+   D3D_READBACK *data = (D3D_READBACK *)rb->extra;
+
+   return data->fetched ||
+      data->query->GetData(NULL, 0, D3DGETDATA_FLUSH) != S_FALSE;
+}
+
+
+static bool d3d_readback_map(ALLEGRO_BITMAP_READBACK *rb)
+{
+   ALLEGRO_DISPLAY_D3D *disp = (ALLEGRO_DISPLAY_D3D *)rb->display;
+   D3D_READBACK *data = (D3D_READBACK *)rb->extra;
+   D3DLOCKED_RECT locked_rect;
+
+   if (disp->device_lost)
+      return false;
+
+   if (!data->fetched) {
+      while (data->query->GetData(NULL, 0, D3DGETDATA_FLUSH) == S_FALSE)
+         ;
+      if (disp->device->GetRenderTargetData(data->render_target,
+            data->system_surface) != D3D_OK) {
+         ALLEGRO_ERROR("GetRenderTargetData failed in d3d_readback_map.\n");
+         return false;
+      }
+      data->fetched = true;
+
+      /* Default pool resources would keep the device from being reset. */
+      data->query->Release();
+      data->query = NULL;
+      data->render_target->Release();
+      data->render_target = NULL;
+   }
+
+   if (data->system_surface->LockRect(&locked_rect, NULL,
+         D3DLOCK_READONLY) != D3D_OK) {
+      ALLEGRO_ERROR("LockRect failed in d3d_readback_map.\n");
+      return false;
+   }
+
+   rb->native.data = locked_rect.pBits;
+   rb->native.pitch = locked_rect.Pitch;
+   return true;
+}
+
+
+static void d3d_readback_unmap(ALLEGRO_BITMAP_READBACK *rb)
+{
+   D3D_READBACK *data = (D3D_READBACK *)rb->extra;
+
+   data->system_surface->UnlockRect();
+}
+
+
+static void d3d_readback_destroy(ALLEGRO_BITMAP_READBACK *rb)
+{
+   d3d_release_readback((D3D_READBACK *)rb->extra);
+   rb->extra = NULL;
+}
+
+
+static const _AL_READBACK_INTERFACE d3d_readback_vt =
+{
+   d3d_readback_is_ready,
+   d3d_readback_map,
+   d3d_readback_unmap,
+   d3d_readback_destroy
+};
+
+
+static bool d3d_start_readback(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_BITMAP_READBACK *rb, int x, int y, int w, int h)
+{
+   ALLEGRO_BITMAP_EXTRA_D3D *d3d_bmp = get_extra(bitmap);
+   ALLEGRO_DISPLAY_D3D *disp = d3d_bmp->display;
+   LPDIRECT3DDEVICE9 device = disp->device;
+   LPDIRECT3DSURFACE9 src;
+   D3DSURFACE_DESC desc;
+   D3D_READBACK *data;
+   RECT rect;
+   int format;
+   bool ok;
+
+   if (disp->device_lost)
+      return false;
+
+   if (d3d_bmp->is_backbuffer) {
+      src = disp->render_target;
+      src->AddRef();
+   }
+   else {
+      if (!_al_d3d_render_to_texture_supported() || !d3d_bmp->video_texture)
+         return false;
+      if (d3d_bmp->video_texture->GetSurfaceLevel(0, &src) != D3D_OK)
+         return false;
+   }
+
+   if (src->GetDesc(&desc) != D3D_OK) {
+      src->Release();
+      return false;
+   }
+   format = _al_d3d_format_to_allegro(desc.Format);
+   if (format < 0) {
+      src->Release();
+      return false;
+   }
+
+   data = (D3D_READBACK *)al_calloc(1, sizeof(*data));
+   if (!data) {
+      src->Release();
+      return false;
+   }
+
+   rect.left = x;
+   rect.right = x + w;
+   rect.top = y;
+   rect.bottom = y + h;
+
+   ok = device->CreateRenderTarget(w, h, desc.Format, D3DMULTISAMPLE_NONE, 0,
+         FALSE, &data->render_target, NULL) == D3D_OK &&
+      device->CreateOffscreenPlainSurface(w, h, desc.Format,
+         D3DPOOL_SYSTEMMEM, &data->system_surface, NULL) == D3D_OK &&
+      device->CreateQuery(D3DQUERYTYPE_EVENT, &data->query) == D3D_OK &&
+      device->StretchRect(src, &rect, data->render_target, NULL,
+         D3DTEXF_NONE) == D3D_OK;
+   src->Release();
+
+   if (!ok) {
+      ALLEGRO_WARN("Could not start an asynchronous readback.\n");
+      d3d_release_readback(data);
+      return false;
+   }
+
+   data->query->Issue(D3DISSUE_END);
+
+   rb->vt = &d3d_readback_vt;
+   rb->extra = data;
+   rb->native.format = format;
+   rb->native.pixel_size = al_get_pixel_size(format);
+   return true;
+}
+
+
 /* Obtain a reference to this driver. */
 ALLEGRO_BITMAP_INTERFACE *_al_bitmap_d3d_driver(void)
 {
@@ -1028,6 +1291,7 @@ ALLEGRO_BITMAP_INTERFACE *_al_bitmap_d3d_driver(void)
    vt->unlock_compressed_region = d3d_unlock_compressed_region;
    vt->update_clipping_rectangle = d3d_update_clipping_rectangle;
    vt->backup_dirty_bitmap = d3d_backup_dirty_bitmap;
+   vt->start_readback = d3d_start_readback;
 
    return vt;
 }
@@ -42,6 +42,7 @@ ALLEGRO_DEBUG_CHANNEL("d3dx9")
 static HMODULE _imp_d3dx9_module = 0;
 _ALLEGRO_D3DXCREATEEFFECTPROC _al_imp_D3DXCreateEffect = NULL;
 _ALLEGRO_D3DXLSFLSPROC _al_imp_D3DXLoadSurfaceFromSurface = NULL;
+_ALLEGRO_D3DXCREATEEFFECTCOMPILERPROC _al_imp_D3DXCreateEffectCompiler = NULL;
 
 extern "C"
 void _al_unload_d3dx9_module()
@@ -85,6 +86,9 @@ static bool _imp_load_d3dx9_module_version(int version)
       return false;
    }
 
+   _al_imp_D3DXCreateEffectCompiler =
+      (_ALLEGRO_D3DXCREATEEFFECTCOMPILERPROC)GetProcAddress(_imp_d3dx9_module, "D3DXCreateEffectCompiler");
+
    ALLEGRO_INFO("Module \"%s\" loaded.\n", module_name);
 
    return true;
@@ -54,6 +54,9 @@ static BOOL is_windows_vista_or_greater() {
 
 static void d3d_set_target_bitmap(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitmap);
 static void d3d_update_transformation(ALLEGRO_DISPLAY* disp, ALLEGRO_BITMAP *target);
+static void d3d_release_gpu_timers(ALLEGRO_DISPLAY_D3D *d3d_display);
+static void d3d_release_vertex_buffer(ALLEGRO_DISPLAY_D3D *d3d_display);
+static void d3d_release_frame_fences(ALLEGRO_DISPLAY_D3D *d3d_display);
 static bool d3d_init_display();
 
 // C++ needs to cast void pointers
@@ -131,6 +134,9 @@ static int allegro_formats[] = {
    ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1,
    ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3,
    ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5,
+   ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4,
+   ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5,
+   ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB,
    -1
 };
 
@@ -155,6 +161,9 @@ static int d3d_formats[] = {
    FOURCC('D', 'X', 'T', '1'),
    FOURCC('D', 'X', 'T', '3'),
    FOURCC('D', 'X', 'T', '5'),
+   FOURCC('A', 'T', 'I', '1'),
+   FOURCC('A', 'T', 'I', '2'),
+   D3DFMT_A8R8G8B8, /* ARGB_8888_SRGB, decoded by D3DSAMP_SRGBTEXTURE */
    -1
 };
 
@@ -530,6 +539,7 @@ static bool d3d_create_fullscreen_device(ALLEGRO_DISPLAY_D3D *d,
             }  }
          }
       }
+      d->device_ex = true;
    }
    else
 #endif
@@ -608,6 +618,7 @@ static void d3d_destroy_device(ALLEGRO_DISPLAY_D3D *disp)
       ALLEGRO_WARN("d3d_destroy_device: ref count not 0\n");
    }
    disp->device = NULL;
+   disp->device_ex = false;
 }
 
 
@@ -892,6 +903,9 @@ static void d3d_destroy_display_internals(ALLEGRO_DISPLAY_D3D *d3d_display)
       _al_add_display_validated_callback(al_display, _al_d3d_on_reset_shaders);
 #endif
       d3d_display->device->EndScene();
+      d3d_release_gpu_timers(d3d_display);
+      d3d_release_vertex_buffer(d3d_display);
+      d3d_release_frame_fences(d3d_display);
    }
 
    d3d_release_bitmaps((ALLEGRO_DISPLAY *)d3d_display);
@@ -959,7 +973,14 @@ void _al_d3d_prepare_for_reset(ALLEGRO_DISPLAY_D3D *disp)
 
    d3d_call_callbacks(&al_display->display_invalidated_callbacks, al_display);
 
+   /* Flipping doesn't keep the backups current for these. */
+   if (disp->device_ex)
+      al_backup_dirty_bitmaps(al_display);
+
    _al_d3d_release_default_pool_textures((ALLEGRO_DISPLAY *)disp);
+   d3d_release_gpu_timers(disp);
+   d3d_release_vertex_buffer(disp);
+   d3d_release_frame_fences(disp);
    while (disp->render_target && disp->render_target->Release() != 0) {
       ALLEGRO_WARN("_al_d3d_prepare_for_reset: (bb) ref count not 0\n");
    }
@@ -1180,12 +1201,31 @@ static BOOL IsTextureFormatOk(D3DFORMAT TextureFormat, D3DFORMAT AdapterFormat)
    return SUCCEEDED(hr);
 }
 
+/* Direct3D 9 has no sRGB formats, textures are decoded when sampled if the
+ * format can be.
+ */
+static BOOL IsSrgbTextureFormatOk(D3DFORMAT TextureFormat, D3DFORMAT AdapterFormat)
+{
+   HRESULT hr = _al_d3d->CheckDeviceFormat(D3DADAPTER_DEFAULT,
+      D3DDEVTYPE_HAL,
+      AdapterFormat,
+      D3DUSAGE_QUERY_SRGBREAD,
+      D3DRTYPE_TEXTURE,
+      TextureFormat);
+
+   return SUCCEEDED(hr);
+}
+
 /* Same as above, but using Allegro's formats */
 static bool is_texture_format_ok(ALLEGRO_DISPLAY *display, int texture_format)
 {
    ALLEGRO_DISPLAY_D3D *d3d_display = (ALLEGRO_DISPLAY_D3D*)display;
-   return IsTextureFormatOk((D3DFORMAT)_al_pixel_format_to_d3d(texture_format),
-      (D3DFORMAT)_al_pixel_format_to_d3d(d3d_display->format));
+   D3DFORMAT dformat = (D3DFORMAT)_al_pixel_format_to_d3d(texture_format);
+   D3DFORMAT adapter_format = (D3DFORMAT)_al_pixel_format_to_d3d(d3d_display->format);
+
+   if (_al_pixel_format_is_srgb(texture_format))
+      return IsSrgbTextureFormatOk(dformat, adapter_format);
+   return IsTextureFormatOk(dformat, adapter_format);
 }
 
 static int real_choose_bitmap_format(ALLEGRO_DISPLAY_D3D *d3d_display,
@@ -1684,10 +1724,17 @@ static ALLEGRO_DISPLAY_D3D *d3d_create_display_internals(
       d3d_display->depth_stencil_format = d3d_get_depth_stencil_format(eds);
       d3d_display->samples = eds->settings[ALLEGRO_SAMPLES];
       d3d_display->single_buffer = eds->settings[ALLEGRO_SINGLE_BUFFER] ? true : false;
-      d3d_display->vsync = eds->settings[ALLEGRO_VSYNC] == 1;
+      d3d_display->vsync = eds->settings[ALLEGRO_VSYNC] == 1 ||
+         eds->settings[ALLEGRO_VSYNC] == 3;
 
       memcpy(&al_display->extra_settings, eds, sizeof al_display->extra_settings);
 
+      /* Direct3D 9 can't let only the late frames tear, so adaptive vsync
+       * is plain vsync here.
+       */
+      if (eds->settings[ALLEGRO_VSYNC] == 3)
+         al_display->extra_settings.settings[ALLEGRO_VSYNC] = 1;
+
       params.init_failed = true;
       win_display->thread_ended = true;
       params.AckEvent = CreateEvent(NULL, false, false, NULL);
@@ -1968,6 +2015,7 @@ void _al_d3d_set_blender(ALLEGRO_DISPLAY_D3D *d3d_display)
 
    if (blender_changed) {
       bool enable_separate_blender = (op != alpha_op) || (src != alpha_src) || (dst != alpha_dst);
+      ((ALLEGRO_DISPLAY *)d3d_display)->stats.state_changes++;
       d3d_display->device->SetRenderState(D3DRS_BLENDFACTOR, D3DCOLOR_RGBA(r, g, b, a));
       if (enable_separate_blender) {
          if (d3d_display->device->SetRenderState(D3DRS_SEPARATEALPHABLENDENABLE, true) != D3D_OK)
@@ -2061,6 +2109,176 @@ static void d3d_draw_pixel(ALLEGRO_DISPLAY *disp, float x, float y, ALLEGRO_COLO
    }
 }
 
+static void d3d_release_gpu_timers(ALLEGRO_DISPLAY_D3D *d3d_display)
+{
+   int i;
+
+   for (i = 0; i < _AL_D3D_GPU_TIMERS; i++) {
+      if (d3d_display->timer_disjoint[i]) {
+         d3d_display->timer_disjoint[i]->Release();
+         d3d_display->timer_freq[i]->Release();
+         d3d_display->timer_begin[i]->Release();
+         d3d_display->timer_end[i]->Release();
+         d3d_display->timer_disjoint[i] = NULL;
+      }
+   }
+   d3d_display->timer_next = 0;
+   d3d_display->timers_pending = 0;
+   d3d_display->timer_running = false;
+}
+
+static bool d3d_create_gpu_timers(ALLEGRO_DISPLAY_D3D *d3d_display)
+{
+   LPDIRECT3DDEVICE9 device = d3d_display->device;
+   int i;
+
+   for (i = 0; i < _AL_D3D_GPU_TIMERS; i++) {
+      LPDIRECT3DQUERY9 q[4] = {NULL, NULL, NULL, NULL};
+      bool ok =
+         device->CreateQuery(D3DQUERYTYPE_TIMESTAMPDISJOINT, &q[0]) == D3D_OK &&
+         device->CreateQuery(D3DQUERYTYPE_TIMESTAMPFREQ, &q[1]) == D3D_OK &&
+         device->CreateQuery(D3DQUERYTYPE_TIMESTAMP, &q[2]) == D3D_OK &&
+         device->CreateQuery(D3DQUERYTYPE_TIMESTAMP, &q[3]) == D3D_OK;
+
+      if (!ok) {
+         int j;
+         for (j = 0; j < 4; j++) {
+            if (q[j])
+               q[j]->Release();
+         }
+         ALLEGRO_WARN("Timestamp queries are not supported.\n");
+         d3d_release_gpu_timers(d3d_display);
+         d3d_display->timer_unsupported = true;
+         return false;
+      }
+
+      d3d_display->timer_disjoint[i] = q[0];
+      d3d_display->timer_freq[i] = q[1];
+      d3d_display->timer_begin[i] = q[2];
+      d3d_display->timer_end[i] = q[3];
+   }
+   return true;
+}
+
+/* The timestamps taken around each frame are read back a few frames later,
+ * once they are available, so we never wait for the GPU.
+ */
+static void d3d_update_gpu_timer(ALLEGRO_DISPLAY *al_display)
+{
+   ALLEGRO_DISPLAY_D3D *d3d_display = (ALLEGRO_DISPLAY_D3D *)al_display;
+   const int n = _AL_D3D_GPU_TIMERS;
+   int i;
+
+   if (d3d_display->device_lost || d3d_display->timer_unsupported)
+      return;
+   if (!d3d_display->timer_disjoint[0] && !d3d_create_gpu_timers(d3d_display))
+      return;
+
+   if (d3d_display->timer_running) {
+      i = (d3d_display->timer_next + n - 1) % n;
+      d3d_display->timer_end[i]->Issue(D3DISSUE_END);
+      d3d_display->timer_freq[i]->Issue(D3DISSUE_END);
+      d3d_display->timer_disjoint[i]->Issue(D3DISSUE_END);
+      d3d_display->timer_running = false;
+      d3d_display->timers_pending++;
+   }
+
+   while (d3d_display->timers_pending > 0) {
+      BOOL disjoint;
+      UINT64 freq, begin, end;
+
+      i = (d3d_display->timer_next - d3d_display->timers_pending + n) % n;
+      if (d3d_display->timer_disjoint[i]->GetData(&disjoint, sizeof(disjoint),
+               0) != S_OK ||
+            d3d_display->timer_freq[i]->GetData(&freq, sizeof(freq), 0) != S_OK ||
+            d3d_display->timer_begin[i]->GetData(&begin, sizeof(begin), 0) != S_OK ||
+            d3d_display->timer_end[i]->GetData(&end, sizeof(end), 0) != S_OK) {
+         break;
+      }
+      if (!disjoint && freq > 0)
+         al_display->stats.gpu_frame_time = (double)(end - begin) / freq;
+      d3d_display->timers_pending--;
+   }
+
+   /* If the GPU is that far behind, skip timing this frame. */
+   if (d3d_display->timers_pending < n) {
+      i = d3d_display->timer_next;
+      d3d_display->timer_disjoint[i]->Issue(D3DISSUE_BEGIN);
+      d3d_display->timer_begin[i]->Issue(D3DISSUE_END);
+      d3d_display->timer_next = (i + 1) % n;
+      d3d_display->timer_running = true;
+   }
+}
+
+static void d3d_release_frame_fences(ALLEGRO_DISPLAY_D3D *d3d_display)
+{
+   int i;
+
+   for (i = 0; i < _AL_MAX_FRAME_LATENCY; i++) {
+      if (d3d_display->frame_fences[i]) {
+         d3d_display->frame_fences[i]->Release();
+         d3d_display->frame_fences[i] = NULL;
+      }
+   }
+   d3d_display->frame_fence_next = 0;
+   d3d_display->frame_fences_pending = 0;
+}
+
+static bool d3d_wait_for_frame_latency(ALLEGRO_DISPLAY *al_display, int frames)
+{
+   ALLEGRO_DISPLAY_D3D *d3d_display = (ALLEGRO_DISPLAY_D3D *)al_display;
+   const int n = _AL_MAX_FRAME_LATENCY;
+
+   if (d3d_display->frame_fences_unsupported)
+      return false;
+
+   while (d3d_display->frame_fences_pending > frames) {
+      int i = (d3d_display->frame_fence_next -
+         d3d_display->frame_fences_pending + n) % n;
+      HRESULT hr = d3d_display->frame_fences[i]->GetData(NULL, 0,
+         D3DGETDATA_FLUSH);
+
+      if (hr == S_FALSE) {
+         Sleep(0);
+         continue;
+      }
+      /* Done, or the device was lost and the frame will never finish. */
+      d3d_display->frame_fences_pending--;
+   }
+   return true;
+}
+
+/* Event queries issued after each Present are signalled once the GPU is
+ * done with that frame.
+ */
+static void d3d_insert_frame_fence(ALLEGRO_DISPLAY *al_display)
+{
+   ALLEGRO_DISPLAY_D3D *d3d_display = (ALLEGRO_DISPLAY_D3D *)al_display;
+   const int n = _AL_MAX_FRAME_LATENCY;
+   int i;
+
+   if (d3d_display->device_lost || d3d_display->frame_fences_unsupported)
+      return;
+
+   if (d3d_display->frame_fences_pending == n)
+      d3d_wait_for_frame_latency(al_display, n - 1);
+
+   i = d3d_display->frame_fence_next;
+   if (!d3d_display->frame_fences[i] &&
+         d3d_display->device->CreateQuery(D3DQUERYTYPE_EVENT,
+            &d3d_display->frame_fences[i]) != D3D_OK) {
+      ALLEGRO_WARN("Event queries are not supported.\n");
+      d3d_display->frame_fences[i] = NULL;
+      d3d_release_frame_fences(d3d_display);
+      d3d_display->frame_fences_unsupported = true;
+      return;
+   }
+
+   d3d_display->frame_fences[i]->Issue(D3DISSUE_END);
+   d3d_display->frame_fence_next = (i + 1) % n;
+   d3d_display->frame_fences_pending++;
+}
+
 static void d3d_flip_display(ALLEGRO_DISPLAY *al_display)
 {
    ALLEGRO_DISPLAY_D3D* d3d_display = (ALLEGRO_DISPLAY_D3D*)al_display;
@@ -2084,7 +2302,10 @@ static void d3d_flip_display(ALLEGRO_DISPLAY *al_display)
       d3d_display->device_lost = true;
       return;
    }
-   else {
+   else if (!d3d_display->device_ex) {
+      /* Once the device is lost it is too late to read the textures back,
+       * so with plain Direct3D 9 they have to be backed up every frame.
+       */
       al_backup_dirty_bitmaps(al_display);
    }
 }
@@ -2135,6 +2356,71 @@ static void d3d_update_display_region(ALLEGRO_DISPLAY *al_display,
    }
 }
 
+/* Only a single buffered (D3DSWAPEFFECT_COPY) swap chain can be presented
+ * with a dirty region, which is passed on to the driver as a list of
+ * rectangles.
+ */
+static void d3d_flip_display_regions(ALLEGRO_DISPLAY *al_display,
+   const int *rects, int num_rects)
+{
+   ALLEGRO_DISPLAY_D3D* d3d_display = (ALLEGRO_DISPLAY_D3D*)al_display;
+   ALLEGRO_DISPLAY_WIN *win_display = &d3d_display->win_display;
+   HRESULT hr;
+   RGNDATA *rgndata;
+   RECT *buffer;
+   RECT *bound;
+   int i;
+
+   if (d3d_display->device_lost)
+      return;
+
+   if (!d3d_display->single_buffer) {
+      d3d_flip_display(al_display);
+      return;
+   }
+
+   rgndata = (RGNDATA *)al_malloc(sizeof(RGNDATAHEADER) +
+      num_rects * sizeof(RECT));
+   if (!rgndata) {
+      d3d_flip_display(al_display);
+      return;
+   }
+   buffer = (RECT *)rgndata->Buffer;
+   bound = &rgndata->rdh.rcBound;
+
+   for (i = 0; i < num_rects; i++) {
+      const int *r = rects + i * 4;
+      buffer[i].left = r[0];
+      buffer[i].top = r[1];
+      buffer[i].right = r[0] + r[2];
+      buffer[i].bottom = r[1] + r[3];
+      if (i == 0) {
+         *bound = buffer[0];
+      }
+      else {
+         bound->left = _ALLEGRO_MIN(bound->left, buffer[i].left);
+         bound->top = _ALLEGRO_MIN(bound->top, buffer[i].top);
+         bound->right = _ALLEGRO_MAX(bound->right, buffer[i].right);
+         bound->bottom = _ALLEGRO_MAX(bound->bottom, buffer[i].bottom);
+      }
+   }
+   rgndata->rdh.dwSize = sizeof(RGNDATAHEADER);
+   rgndata->rdh.iType = RDH_RECTANGLES;
+   rgndata->rdh.nCount = num_rects;
+   rgndata->rdh.nRgnSize = num_rects * sizeof(RECT);
+
+   al_lock_mutex(present_mutex);
+   d3d_display->device->EndScene();
+   hr = d3d_display->device->Present(NULL, NULL, win_display->window, rgndata);
+   d3d_display->device->BeginScene();
+   al_unlock_mutex(present_mutex);
+
+   al_free(rgndata);
+
+   if (hr == D3DERR_DEVICELOST)
+      d3d_display->device_lost = true;
+}
+
 /*
  * Sets a clipping rectangle
  */
@@ -2161,6 +2447,7 @@ void _al_d3d_set_bitmap_clip(ALLEGRO_BITMAP *bitmap)
    }
 
    if (memcmp(&disp->scissor_state, &rect, sizeof(RECT)) != 0) {
+      disp->win_display.display.stats.state_changes++;
 
       if (rect.left == 0 && rect.top == 0 && rect.right == disp->win_display.display.w && rect.left == disp->win_display.display.h) {
          disp->device->SetRenderState(D3DRS_SCISSORTESTENABLE, false);
@@ -2399,15 +2686,21 @@ static ALLEGRO_BITMAP *d3d_create_bitmap(ALLEGRO_DISPLAY *d,
    bitmap->_flags = flags;
    al_identity_transform(&bitmap->transform);
 
+   bool no_shadow = !compressed && (flags & ALLEGRO_NO_PRESERVE_TEXTURE) &&
+      _al_d3d_render_to_texture_supported();
+
    bitmap->pitch =
       _al_get_least_multiple(w, block_width) / block_width * block_size;
-   bitmap->memory = (unsigned char *)al_malloc(
-      bitmap->pitch * _al_get_least_multiple(h, block_height) / block_height);
+   if (!no_shadow) {
+      bitmap->memory = (unsigned char *)al_malloc(
+         bitmap->pitch * _al_get_least_multiple(h, block_height) / block_height);
+   }
 
    extra = (ALLEGRO_BITMAP_EXTRA_D3D *)al_calloc(1, sizeof *extra);
    bitmap->extra = extra;
    extra->video_texture = 0;
    extra->system_texture = 0;
+   extra->no_shadow = no_shadow;
    extra->initialized = false;
    extra->is_backbuffer = false;
    extra->render_target = NULL;
@@ -2455,6 +2748,7 @@ static void d3d_set_target_bitmap(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitm
    ALLEGRO_BITMAP_EXTRA_D3D *d3d_target;
    ALLEGRO_BITMAP_EXTRA_D3D *old_target = NULL;
    ALLEGRO_DISPLAY_D3D *d3d_display = (ALLEGRO_DISPLAY_D3D *)display;
+   bool srgb;
 
    if (d3d_display->device_lost)
       return;
@@ -2492,6 +2786,7 @@ static void d3d_set_target_bitmap(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitm
          ALLEGRO_ERROR("d3d_set_target_bitmap: Unable to set render target to texture surface.\n");
          return;
       }
+      d3d_display->win_display.display.stats.target_switches++;
       d3d_target->render_target = d3d_display->render_target;
       d3d_display->target_bitmap = bitmap;
    }
@@ -2519,6 +2814,7 @@ static void d3d_set_target_bitmap(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitm
             d3d_target->render_target->Release();
             return;
          }
+         d3d_display->win_display.display.stats.target_switches++;
       }
       if (d3d_display->samples) {
          d3d_display->device->SetDepthStencilSurface(NULL);
@@ -2527,6 +2823,13 @@ static void d3d_set_target_bitmap(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *bitm
 
    d3d_reset_state(d3d_display);
 
+   /* sRGB targets are blended in linear space and encoded on write. */
+   if (d3d_target->is_backbuffer)
+      srgb = display->extra_settings.settings[ALLEGRO_SRGB_FRAMEBUFFER] != 0;
+   else
+      srgb = _al_pixel_format_is_srgb(al_get_bitmap_format(target));
+   d3d_display->device->SetRenderState(D3DRS_SRGBWRITEENABLE, srgb);
+
    _al_d3d_set_bitmap_clip(bitmap);
 }
 
@@ -2689,6 +2992,92 @@ static void* d3d_prepare_vertex_cache(ALLEGRO_DISPLAY* disp,
          (disp->num_cache_vertices - num_new_vertices) * size;
 }
 
+static void d3d_release_vertex_buffer(ALLEGRO_DISPLAY_D3D *d3d_display)
+{
+   if (d3d_display->vertex_buffer) {
+      d3d_display->vertex_buffer->Release();
+      d3d_display->vertex_buffer = NULL;
+   }
+   d3d_display->vertex_buffer_pos = 0;
+}
+
+/* Copies the vertices into the dynamic vertex buffer and binds it. Returns
+ * the index of the first vertex, or -1 to draw with DrawPrimitiveUP.
+ *
+ * Appending with D3DLOCK_NOOVERWRITE promises not to touch anything the GPU
+ * may still read, so the lock doesn't wait. Once the buffer is full it is
+ * locked with D3DLOCK_DISCARD, which hands out fresh memory instead.
+ */
+static int d3d_upload_vertices(ALLEGRO_DISPLAY_D3D *d3d_disp,
+   const void *vertices, int num_vertices, int stride)
+{
+   int bytes = num_vertices * stride;
+   int pos;
+   DWORD lock_flags;
+   void *ptr;
+
+   if (bytes > _AL_D3D_VERTEX_BUFFER_SIZE)
+      return -1;
+
+   if (!d3d_disp->vertex_buffer) {
+      if (d3d_disp->device->CreateVertexBuffer(_AL_D3D_VERTEX_BUFFER_SIZE,
+            D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY, 0, D3DPOOL_DEFAULT,
+            &d3d_disp->vertex_buffer, NULL) != D3D_OK) {
+         ALLEGRO_WARN("Could not create the dynamic vertex buffer.\n");
+         d3d_disp->vertex_buffer = NULL;
+         return -1;
+      }
+      d3d_disp->vertex_buffer_pos = _AL_D3D_VERTEX_BUFFER_SIZE;
+   }
+
+   /* Vertices are addressed in units of the stride. */
+   pos = (d3d_disp->vertex_buffer_pos + stride - 1) / stride * stride;
+   if (pos + bytes > _AL_D3D_VERTEX_BUFFER_SIZE) {
+      pos = 0;
+      lock_flags = D3DLOCK_DISCARD;
+   }
+   else {
+      lock_flags = D3DLOCK_NOOVERWRITE;
+   }
+
+   if (d3d_disp->vertex_buffer->Lock(pos, bytes, &ptr, lock_flags) != D3D_OK)
+      return -1;
+   memcpy(ptr, vertices, bytes);
+   d3d_disp->vertex_buffer->Unlock();
+
+   d3d_disp->vertex_buffer_pos = pos + bytes;
+
+   if (d3d_disp->device->SetStreamSource(0, d3d_disp->vertex_buffer, 0,
+         stride) != D3D_OK)
+      return -1;
+
+   return pos / stride;
+}
+
+/* Draws the vertex cache as a triangle list, from the dynamic vertex buffer
+ * if possible.
+ */
+static bool d3d_draw_vertex_cache(ALLEGRO_DISPLAY_D3D *d3d_disp, int first,
+   int stride)
+{
+   ALLEGRO_DISPLAY *disp = (ALLEGRO_DISPLAY *)d3d_disp;
+   HRESULT hr;
+
+   if (first >= 0) {
+      hr = d3d_disp->device->DrawPrimitive(D3DPT_TRIANGLELIST, first,
+         disp->num_cache_vertices / 3);
+   }
+   else {
+      hr = d3d_disp->device->DrawPrimitiveUP(D3DPT_TRIANGLELIST,
+         disp->num_cache_vertices / 3, disp->vertex_cache, stride);
+   }
+   if (hr != D3D_OK) {
+      ALLEGRO_ERROR("d3d_flush_vertex_cache: DrawPrimitive failed.\n");
+      return false;
+   }
+   return true;
+}
+
 static void d3d_flush_vertex_cache(ALLEGRO_DISPLAY* disp)
 {
    if (!disp->vertex_cache)
@@ -2722,6 +3111,8 @@ static void d3d_flush_vertex_cache(ALLEGRO_DISPLAY* disp)
    else {
       d3d_disp->device->SetSamplerState(0, D3DSAMP_MIPFILTER, D3DTEXF_NONE);
    }
+   d3d_disp->device->SetSamplerState(0, D3DSAMP_SRGBTEXTURE,
+      _al_pixel_format_is_srgb(al_get_bitmap_format(cache_bmp)));
 
    if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
       d3d_disp->device->SetFVF(D3DFVF_ALLEGRO_VERTEX);
@@ -2743,17 +3134,17 @@ static void d3d_flush_vertex_cache(ALLEGRO_DISPLAY* disp)
    }
 
    int size;
+   int first;
 
 #ifdef ALLEGRO_CFG_SHADER_HLSL
    if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
       size = sizeof(ALLEGRO_VERTEX);
+      first = d3d_upload_vertices(d3d_disp, disp->vertex_cache,
+         disp->num_cache_vertices, size);
       for (unsigned int i = 0; i < required_passes; i++) {
          d3d_disp->effect->BeginPass(i);
-         if (d3d_disp->device->DrawPrimitiveUP(D3DPT_TRIANGLELIST, disp->num_cache_vertices / 3,
-            (void *)disp->vertex_cache, size) != D3D_OK) {
-            ALLEGRO_ERROR("d3d_flush_vertex_cache: DrawPrimitive failed.\n");
+         if (!d3d_draw_vertex_cache(d3d_disp, first, size))
             return;
-         }
          d3d_disp->effect->EndPass();
       }
    }
@@ -2762,13 +3153,14 @@ static void d3d_flush_vertex_cache(ALLEGRO_DISPLAY* disp)
    {
       d3d_disp->device->SetFVF(D3DFVF_FIXED_VERTEX);
       size = sizeof(D3D_FIXED_VERTEX);
-      if (d3d_disp->device->DrawPrimitiveUP(D3DPT_TRIANGLELIST, disp->num_cache_vertices / 3,
-         (void *)disp->vertex_cache, size) != D3D_OK) {
-         ALLEGRO_ERROR("d3d_flush_vertex_cache: DrawPrimitive failed.\n");
+      first = d3d_upload_vertices(d3d_disp, disp->vertex_cache,
+         disp->num_cache_vertices, size);
+      if (!d3d_draw_vertex_cache(d3d_disp, first, size))
          return;
-      }
    }
 
+   disp->stats.draw_calls++;
+   disp->stats.vertices += disp->num_cache_vertices;
    disp->num_cache_vertices = 0;
 #ifdef ALLEGRO_CFG_SHADER_HLSL
    if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
@@ -2866,7 +3258,11 @@ ALLEGRO_DISPLAY_INTERFACE *_al_display_d3d_driver(void)
    vt->clear_depth_buffer = d3d_clear_depth_buffer;
    vt->draw_pixel = d3d_draw_pixel;
    vt->flip_display = d3d_flip_display;
+   vt->update_gpu_timer = d3d_update_gpu_timer;
+   vt->insert_frame_fence = d3d_insert_frame_fence;
+   vt->wait_for_frame_latency = d3d_wait_for_frame_latency;
    vt->update_display_region = d3d_update_display_region;
+   vt->flip_display_regions = d3d_flip_display_regions;
    vt->acknowledge_resize = d3d_acknowledge_resize;
    vt->resize_display = d3d_resize_display;
    vt->create_bitmap = d3d_create_bitmap;
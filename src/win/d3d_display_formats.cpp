@@ -30,6 +30,21 @@ static BOOL IsDepthFormatExisting(D3DFORMAT DepthFormat, D3DFORMAT AdapterFormat
    return SUCCEEDED(hr);
 }
 
+/* Whether the back buffer can encode to sRGB on write, which
+ * D3DRS_SRGBWRITEENABLE turns on.
+ */
+static bool IsSrgbWriteSupported(int adapter, D3DFORMAT AdapterFormat)
+{
+   HRESULT hr = _al_d3d->CheckDeviceFormat(adapter,
+      D3DDEVTYPE_HAL,
+      AdapterFormat,
+      D3DUSAGE_QUERY_SRGBWRITE,
+      D3DRTYPE_SURFACE,
+      AdapterFormat);
+
+   return SUCCEEDED(hr);
+}
+
 static const int D3D_DEPTH_FORMATS = sizeof(depth_stencil_formats) / sizeof(*depth_stencil_formats);
 
 static _AL_VECTOR eds_list;
@@ -77,6 +92,7 @@ void _al_d3d_generate_display_format_list(void)
       int allegro_format = ALLEGRO_PIXEL_FORMAT_XRGB_8888;
       if (format_num == 1) allegro_format = ALLEGRO_PIXEL_FORMAT_RGB_565;
       D3DFORMAT d3d_format = (D3DFORMAT)_al_pixel_format_to_d3d(allegro_format);
+      bool srgb_write = IsSrgbWriteSupported(adapter, d3d_format);
 
      /* Count available multisample quality levels. */
       DWORD quality_levels = 0;
@@ -128,6 +144,8 @@ void _al_d3d_generate_display_format_list(void)
                   eds->settings[ALLEGRO_VSYNC] = 1;
                }
 
+               eds->settings[ALLEGRO_SRGB_FRAMEBUFFER] = srgb_write;
+
                eds->settings[ALLEGRO_DEPTH_SIZE] = ds->d;
                eds->settings[ALLEGRO_STENCIL_SIZE] = ds->s;
                
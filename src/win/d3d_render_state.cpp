@@ -21,6 +21,8 @@ void _al_d3d_update_render_state(ALLEGRO_DISPLAY *display)
 
    if (!disp->device) return;
 
+   display->stats.state_changes++;
+
    /* TODO: We could store the previous state and/or mark updated states to
     * avoid so many redundant SetRenderState calls.
     */
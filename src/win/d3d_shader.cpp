@@ -73,6 +73,66 @@ static const char *technique_source_both =
    "}\n";
 
 
+/* Creates the effect from its compiled form in the shader cache if there is
+ * one, otherwise compiles the source and adds the result to the cache.
+ */
+static HRESULT create_effect(ALLEGRO_DISPLAY *display,
+   const ALLEGRO_USTR *source, LPD3DXEFFECT *effect, LPD3DXBUFFER *errors)
+{
+   LPDIRECT3DDEVICE9 device = al_get_d3d_device(display);
+   LPD3DXEFFECTCOMPILER compiler;
+   LPD3DXBUFFER compiled;
+   uint64_t key;
+   int version = ALLEGRO_VERSION_INT;
+   void *data;
+   size_t size;
+   HRESULT hr;
+
+   if (!_al_get_shader_cache_path() || !_al_imp_D3DXCreateEffectCompiler) {
+      return _al_imp_D3DXCreateEffect(device, al_cstr(source),
+         al_ustr_size(source), NULL, NULL, D3DXSHADER_PACKMATRIX_ROWMAJOR,
+         NULL, effect, errors);
+   }
+
+   key = _al_shader_cache_hash(_AL_SHADER_CACHE_HASH_INIT, al_cstr(source),
+      al_ustr_size(source));
+   key = _al_shader_cache_hash(key, &version, sizeof(version));
+
+   data = _al_load_shader_cache(key, &size);
+   if (data) {
+      hr = _al_imp_D3DXCreateEffect(device, data, size, NULL, NULL,
+         D3DXSHADER_PACKMATRIX_ROWMAJOR, NULL, effect, errors);
+      al_free(data);
+      if (hr == D3D_OK)
+         return hr;
+      ALLEGRO_WARN("Ignoring unusable shader cache entry\n");
+      if (*errors) {
+         (*errors)->Release();
+         *errors = NULL;
+      }
+   }
+
+   hr = _al_imp_D3DXCreateEffectCompiler(al_cstr(source),
+      al_ustr_size(source), NULL, NULL, D3DXSHADER_PACKMATRIX_ROWMAJOR,
+      &compiler, errors);
+   if (hr != D3D_OK)
+      return hr;
+   hr = compiler->CompileEffect(0, &compiled, errors);
+   compiler->Release();
+   if (hr != D3D_OK)
+      return hr;
+
+   hr = _al_imp_D3DXCreateEffect(device, compiled->GetBufferPointer(),
+      compiled->GetBufferSize(), NULL, NULL, D3DXSHADER_PACKMATRIX_ROWMAJOR,
+      NULL, effect, errors);
+   if (hr == D3D_OK) {
+      _al_save_shader_cache(key, compiled->GetBufferPointer(),
+         compiled->GetBufferSize());
+   }
+   compiled->Release();
+   return hr;
+}
+
 static bool hlsl_attach_shader_source(ALLEGRO_SHADER *shader,
                ALLEGRO_SHADER_TYPE type, const char *source);
 static bool hlsl_build_shader(ALLEGRO_SHADER *shader);
@@ -112,7 +172,8 @@ static struct ALLEGRO_SHADER_INTERFACE shader_hlsl_vt =
    hlsl_set_shader_float,
    hlsl_set_shader_int_vector,
    hlsl_set_shader_float_vector,
-   hlsl_set_shader_bool
+   hlsl_set_shader_bool,
+   NULL /* set_shader_uniform_block */
 };
 
 void _al_d3d_on_lost_shaders(ALLEGRO_DISPLAY *display)
@@ -243,17 +304,9 @@ static bool hlsl_attach_shader_source(ALLEGRO_SHADER *shader,
    if (hlsl_shader->hlsl_shader)
       hlsl_shader->hlsl_shader->Release();
 
-   DWORD ok = _al_imp_D3DXCreateEffect(
-      al_get_d3d_device(display),
-      al_cstr(full_source),
-      al_ustr_size(full_source),
-      NULL,
-      NULL,
-      D3DXSHADER_PACKMATRIX_ROWMAJOR,
-      NULL,
-      &hlsl_shader->hlsl_shader,
-      &errors
-   );
+   errors = NULL;
+   DWORD ok = create_effect(display, full_source, &hlsl_shader->hlsl_shader,
+      &errors);
 
    al_ustr_free(full_source);
 
@@ -11,6 +11,7 @@ typedef struct ALLEGRO_DISPLAY_WGL
    /* Driver specifics */
    HDC dc;
    HGLRC glrc;
+   int context_major, context_minor; /* As requested, 0 for the default. */
 } ALLEGRO_DISPLAY_WGL;
 
 int _al_win_determine_adapter(void);
@@ -285,6 +285,7 @@ static int decode_pixel_format_old(PIXELFORMATDESCRIPTOR *pfd,
     */
    eds->settings[ALLEGRO_FLOAT_COLOR] = 0;
    eds->settings[ALLEGRO_FLOAT_DEPTH] = 0;
+   eds->settings[ALLEGRO_SRGB_FRAMEBUFFER] = 0;
 
    // FIXME
 
@@ -305,6 +306,7 @@ static bool decode_pixel_format_attrib(ALLEGRO_EXTRA_DISPLAY_SETTINGS *eds, int
    eds->settings[ALLEGRO_SAMPLE_BUFFERS] = 0;
    eds->settings[ALLEGRO_FLOAT_DEPTH] = 0;
    eds->settings[ALLEGRO_FLOAT_COLOR] = 0;
+   eds->settings[ALLEGRO_SRGB_FRAMEBUFFER] = 0;
    eds->settings[ALLEGRO_COMPATIBLE_DISPLAY] = 1;
 
    for (i = 0; i < num_attribs; i++) {
@@ -409,6 +411,10 @@ static bool decode_pixel_format_attrib(ALLEGRO_EXTRA_DISPLAY_SETTINGS *eds, int
       else if (attrib[i] == WGL_DEPTH_FLOAT_EXT) {
          eds->settings[ALLEGRO_FLOAT_DEPTH] = value[i];
       }
+      /* sRGB encoding */
+      else if (attrib[i] == WGL_FRAMEBUFFER_SRGB_CAPABLE_EXT) {
+         eds->settings[ALLEGRO_SRGB_FRAMEBUFFER] = value[i];
+      }
    }
 
    return true;
@@ -479,6 +485,7 @@ static ALLEGRO_EXTRA_DISPLAY_SETTINGS* read_pixel_format_ext(_ALLEGRO_wglGetExte
       WGL_AUX_BUFFERS_ARB, /* placeholder for WGL_SAMPLE_BUFFERS_ARB */
       WGL_AUX_BUFFERS_ARB, /* placeholder for WGL_SAMPLES_ARB        */
       WGL_AUX_BUFFERS_ARB, /* placeholder for WGL_DEPTH_FLOAT_EXT    */
+      WGL_AUX_BUFFERS_ARB, /* placeholder for WGL_FRAMEBUFFER_SRGB_CAPABLE_EXT */
    };
 
    const int num_attribs = sizeof(attrib) / sizeof(attrib[0]);
@@ -490,11 +497,15 @@ static ALLEGRO_EXTRA_DISPLAY_SETTINGS* read_pixel_format_ext(_ALLEGRO_wglGetExte
 
    /* If multisampling is supported, query for it. */
    if (is_wgl_extension_supported(_wglGetExtensionsStringARB, "WGL_ARB_multisample", dc)) {
-      attrib[num_attribs - 3] = WGL_SAMPLE_BUFFERS_ARB;
-      attrib[num_attribs - 2] = WGL_SAMPLES_ARB;
+      attrib[num_attribs - 4] = WGL_SAMPLE_BUFFERS_ARB;
+      attrib[num_attribs - 3] = WGL_SAMPLES_ARB;
    }
    if (is_wgl_extension_supported(_wglGetExtensionsStringARB, "WGL_EXT_depth_float", dc)) {
-      attrib[num_attribs - 1] = WGL_DEPTH_FLOAT_EXT;
+      attrib[num_attribs - 2] = WGL_DEPTH_FLOAT_EXT;
+   }
+   if (is_wgl_extension_supported(_wglGetExtensionsStringARB, "WGL_EXT_framebuffer_sRGB", dc) ||
+       is_wgl_extension_supported(_wglGetExtensionsStringARB, "WGL_ARB_framebuffer_sRGB", dc)) {
+      attrib[num_attribs - 1] = WGL_FRAMEBUFFER_SRGB_CAPABLE_EXT;
    }
 
    /* Get the pf attributes */
@@ -924,6 +935,8 @@ static bool create_display_internals(_ALLEGRO_wglGetExtensionsStringARB_t _wglGe
 
    major = al_get_new_display_option(ALLEGRO_OPENGL_MAJOR_VERSION, 0);
    minor = al_get_new_display_option(ALLEGRO_OPENGL_MINOR_VERSION, 0);
+   wgl_disp->context_major = major;
+   wgl_disp->context_minor = minor;
 
    // TODO: request GLES context in GLES builds
    if ((disp->flags & ALLEGRO_OPENGL_3_0) || major != 0) {
@@ -974,7 +987,18 @@ static bool create_display_internals(_ALLEGRO_wglGetExtensionsStringARB_t _wglGe
     * does get loaded, so just check for that.
     */
    if (wglSwapIntervalEXT) {
-      if (disp->extra_settings.settings[ALLEGRO_VSYNC] == 1) {
+      if (disp->extra_settings.settings[ALLEGRO_VSYNC] == 3) {
+         /* Adaptive vsync, only late frames tear. */
+         if (disp->ogl_extras->extension_list->ALLEGRO_WGL_EXT_swap_control_tear) {
+            wglSwapIntervalEXT(-1);
+         }
+         else {
+            ALLEGRO_WARN("no adaptive vsync, WGL_EXT_swap_control_tear missing.\n");
+            wglSwapIntervalEXT(1);
+            disp->extra_settings.settings[ALLEGRO_VSYNC] = 1;
+         }
+      }
+      else if (disp->extra_settings.settings[ALLEGRO_VSYNC] == 1) {
          wglSwapIntervalEXT(1);
       }
       else if (disp->extra_settings.settings[ALLEGRO_VSYNC] == 2) {
@@ -1062,6 +1086,8 @@ static void destroy_display_internals(ALLEGRO_DISPLAY_WGL *wgl_disp)
       _al_convert_to_memory_bitmap(bmp);
    }
 
+   _al_ogl_destroy_upload_contexts(disp);
+
    if (disp->ogl_extras->backbuffer)
       _al_ogl_destroy_backbuffer(disp->ogl_extras->backbuffer);
    disp->ogl_extras->backbuffer = NULL;
@@ -1123,6 +1149,111 @@ static void wgl_destroy_display(ALLEGRO_DISPLAY *disp)
 }
 
 
+/* A context sharing the display's objects, with a hidden window of the
+ * display's pixel format to be made current on.
+ */
+typedef struct WGL_UPLOAD_CONTEXT
+{
+   HWND window;
+   HDC dc;
+   HGLRC glrc;
+} WGL_UPLOAD_CONTEXT;
+
+
+static void wgl_destroy_upload_context(ALLEGRO_DISPLAY *d, void *context)
+{
+   WGL_UPLOAD_CONTEXT *uc = context;
+   (void)d;
+
+   if (uc->glrc)
+      wglDeleteContext(uc->glrc);
+   if (uc->dc)
+      ReleaseDC(uc->window, uc->dc);
+   if (uc->window)
+      DestroyWindow(uc->window);
+   al_free(uc);
+}
+
+
+/* Called with the display's context current, which the new context shares
+ * its objects with.
+ */
+static void *wgl_create_upload_context(ALLEGRO_DISPLAY *d)
+{
+   ALLEGRO_DISPLAY_WGL *wgl_disp = (ALLEGRO_DISPLAY_WGL *)d;
+   PIXELFORMATDESCRIPTOR pfd;
+   WGL_UPLOAD_CONTEXT *uc;
+   int pf;
+
+   uc = al_calloc(1, sizeof(*uc));
+   if (!uc)
+      return NULL;
+
+   uc->window = _al_win_create_hidden_window();
+   if (!uc->window)
+      goto fail;
+   uc->dc = GetDC(uc->window);
+
+   pf = GetPixelFormat(wgl_disp->dc);
+   DescribePixelFormat(wgl_disp->dc, pf, sizeof(pfd), &pfd);
+   if (!SetPixelFormat(uc->dc, pf, &pfd)) {
+      ALLEGRO_ERROR("Unable to set the upload context's pixel format. %s\n",
+         _al_win_last_error());
+      goto fail;
+   }
+
+   if ((d->flags & ALLEGRO_OPENGL_3_0) || wgl_disp->context_major != 0) {
+      /* Share at creation, as wglShareLists may refuse a context created
+       * with attributes.
+       */
+      _ALLEGRO_wglCreateContextAttribsARB_t create_context_attribs =
+         (_ALLEGRO_wglCreateContextAttribsARB_t)
+            wglGetProcAddress("wglCreateContextAttribsARB");
+      int attrib[] = {WGL_CONTEXT_MAJOR_VERSION_ARB,
+                      d->extra_settings.settings[ALLEGRO_OPENGL_MAJOR_VERSION],
+                      WGL_CONTEXT_MINOR_VERSION_ARB,
+                      d->extra_settings.settings[ALLEGRO_OPENGL_MINOR_VERSION],
+                      WGL_CONTEXT_FLAGS_ARB, 0,
+                      0};
+      if (d->flags & ALLEGRO_OPENGL_FORWARD_COMPATIBLE)
+         attrib[5] = WGL_CONTEXT_FORWARD_COMPATIBLE_BIT_ARB;
+      if (create_context_attribs)
+         uc->glrc = create_context_attribs(uc->dc, wgl_disp->glrc, attrib);
+   }
+   else {
+      uc->glrc = wglCreateContext(uc->dc);
+      if (uc->glrc && !wglShareLists(wgl_disp->glrc, uc->glrc)) {
+         ALLEGRO_ERROR("wglShareLists failed. %s\n", _al_win_last_error());
+         wglDeleteContext(uc->glrc);
+         uc->glrc = NULL;
+      }
+   }
+
+   if (!uc->glrc) {
+      ALLEGRO_ERROR("Unable to create an upload context. %s\n",
+         _al_win_last_error());
+      goto fail;
+   }
+
+   return uc;
+
+fail:
+   wgl_destroy_upload_context(d, uc);
+   return NULL;
+}
+
+
+static bool wgl_make_upload_context_current(ALLEGRO_DISPLAY *d, void *context)
+{
+   WGL_UPLOAD_CONTEXT *uc = context;
+   (void)d;
+
+   if (!uc)
+      return wglMakeCurrent(NULL, NULL);
+   return wglMakeCurrent(uc->dc, uc->glrc);
+}
+
+
 static bool wgl_set_current_display(ALLEGRO_DISPLAY *d)
 {
    ALLEGRO_DISPLAY_WGL *wgl_disp = (ALLEGRO_DISPLAY_WGL *)d;
@@ -1329,6 +1460,27 @@ static void wgl_update_display_region(ALLEGRO_DISPLAY *d,
 }
 
 
+static void wgl_flip_display_regions(ALLEGRO_DISPLAY *d,
+                                     const int *rects, int num_rects)
+{
+   ALLEGRO_DISPLAY_WGL* disp = (ALLEGRO_DISPLAY_WGL*)d;
+   int i;
+
+   if (!al_get_opengl_extension_list()->ALLEGRO_WGL_WIN_swap_hint) {
+      wgl_flip_display(d);
+      return;
+   }
+
+   /* Same caveat as in wgl_update_display_region. */
+   for (i = 0; i < num_rects; i++) {
+      const int *r = rects + i * 4;
+      wglAddSwapHintRectWIN(r[0], r[1], r[2], r[3]);
+   }
+   glFlush();
+   SwapBuffers(disp->dc);
+}
+
+
 static bool wgl_resize_helper(_ALLEGRO_wglGetExtensionsStringARB_t _wglGetExtensionsStringARB, ALLEGRO_DISPLAY *d, int width, int height)
 {
    ALLEGRO_DISPLAY_WGL *wgl_disp = (ALLEGRO_DISPLAY_WGL *)d;
@@ -1529,6 +1681,7 @@ ALLEGRO_DISPLAY_INTERFACE *_al_display_wgl_driver(void)
    vt.unset_current_display = wgl_unset_current_display;
    vt.flip_display = wgl_flip_display;
    vt.update_display_region = wgl_update_display_region;
+   vt.flip_display_regions = wgl_flip_display_regions;
    vt.acknowledge_resize = wgl_acknowledge_resize;
    vt.create_bitmap = _al_ogl_create_bitmap;
    vt.get_backbuffer = _al_ogl_get_backbuffer;
@@ -1552,6 +1705,9 @@ ALLEGRO_DISPLAY_INTERFACE *_al_display_wgl_driver(void)
    vt.set_window_title = _al_win_set_window_title;
 
    vt.update_render_state = _al_ogl_update_render_state;
+   vt.create_upload_context = wgl_create_upload_context;
+   vt.make_upload_context_current = wgl_make_upload_context_current;
+   vt.destroy_upload_context = wgl_destroy_upload_context;
    _al_ogl_add_drawing_functions(&vt);
    _al_win_add_clipboard_functions(&vt);
 
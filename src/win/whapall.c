@@ -71,6 +71,8 @@ static bool hapall_play_effect(ALLEGRO_HAPTIC_EFFECT_ID *id, int loop);
 static bool hapall_stop_effect(ALLEGRO_HAPTIC_EFFECT_ID *id);
 static bool hapall_is_effect_playing(ALLEGRO_HAPTIC_EFFECT_ID *id);
 static bool hapall_release_effect(ALLEGRO_HAPTIC_EFFECT_ID *id);
+static bool hapall_update_effect(ALLEGRO_HAPTIC_EFFECT_ID *id,
+                                 ALLEGRO_HAPTIC_EFFECT *eff);
 
 static double hapall_get_autocenter(ALLEGRO_HAPTIC *dev);
 static bool hapall_set_autocenter(ALLEGRO_HAPTIC *dev, double);
@@ -113,7 +115,8 @@ ALLEGRO_HAPTIC_DRIVER _al_hapdrv_windows_all =
    hapall_release,
 
    hapall_get_autocenter,
-   hapall_set_autocenter
+   hapall_set_autocenter,
+   hapall_update_effect
 };
 
 
@@ -330,6 +333,15 @@ static bool hapall_release_effect(ALLEGRO_HAPTIC_EFFECT_ID *id)
 }
 
 
+static bool hapall_update_effect(ALLEGRO_HAPTIC_EFFECT_ID *id,
+                                 ALLEGRO_HAPTIC_EFFECT *effect)
+{
+   ALLEGRO_HAPTIC_DRIVER *driver = id->driver;
+   /* Use the stored driver to perform the operation. */
+   return driver->update_effect(id, effect);
+}
+
+
 static bool hapall_release(ALLEGRO_HAPTIC *haptic)
 {
    if (!haptic)
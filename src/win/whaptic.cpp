@@ -146,6 +146,8 @@ static bool whap_play_effect(ALLEGRO_HAPTIC_EFFECT_ID *id, int loop);
 static bool whap_stop_effect(ALLEGRO_HAPTIC_EFFECT_ID *id);
 static bool whap_is_effect_playing(ALLEGRO_HAPTIC_EFFECT_ID *id);
 static bool whap_release_effect(ALLEGRO_HAPTIC_EFFECT_ID *id);
+static bool whap_update_effect(ALLEGRO_HAPTIC_EFFECT_ID *id,
+                               ALLEGRO_HAPTIC_EFFECT *eff);
 
 static double whap_get_autocenter(ALLEGRO_HAPTIC *dev);
 static bool whap_set_autocenter(ALLEGRO_HAPTIC *dev, double);
@@ -186,7 +188,8 @@ ALLEGRO_HAPTIC_DRIVER _al_hapdrv_directx = {
    whap_release,
 
    whap_get_autocenter,
-   whap_set_autocenter
+   whap_set_autocenter,
+   whap_update_effect
 };
 
 
@@ -1321,6 +1324,58 @@ static bool whap_play_effect(ALLEGRO_HAPTIC_EFFECT_ID *id, int loops)
 }
 
 
+static bool whap_update_effect(ALLEGRO_HAPTIC_EFFECT_ID *id,
+                               ALLEGRO_HAPTIC_EFFECT *effect)
+{
+   HRESULT res;
+   ALLEGRO_HAPTIC_WINDOWS *whap = (ALLEGRO_HAPTIC_WINDOWS *)id->_haptic;
+   ALLEGRO_HAPTIC_EFFECT_WINDOWS *weff;
+   ALLEGRO_HAPTIC_EFFECT_WINDOWS update;
+   bool ok = false;
+
+   if ((!whap) || (id->_id < 0))
+      return false;
+   weff = whap->effects + id->_id;
+
+   /* whap_effect2win clears the whole structure, so convert into a copy.
+    * DirectInput copies the parameters, so the copy need not be kept.
+    */
+   if (!whap_effect2win(&update, effect, whap)) {
+      ALLEGRO_WARN("Could not convert haptic effect.\n");
+      return false;
+   }
+   if (update.guid != weff->guid) {
+      ALLEGRO_WARN("Cannot change the type of an uploaded effect.\n");
+      return false;
+   }
+
+   al_lock_mutex(haptic_mutex);
+
+   if (!whap_acquire_lock(whap)) {
+      ALLEGRO_WARN("Could not lock haptic device \n");
+   }
+   else {
+      /* Only pass what may change, and let a playing effect carry on with
+       * the new parameters instead of being restarted.
+       */
+      res = IDirectInputEffect_SetParameters(weff->ref, &update.effect,
+         DIEP_TYPESPECIFICPARAMS | DIEP_ENVELOPE | DIEP_DURATION |
+         DIEP_STARTDELAY | DIEP_DIRECTION);
+      if (FAILED(res)) {
+         ALLEGRO_WARN("Could not update haptic effect.\n");
+         warn_on_error(res);
+      }
+      else {
+         id->_effect_duration = al_get_haptic_effect_duration(effect);
+         ok = true;
+      }
+   }
+
+   al_unlock_mutex(haptic_mutex);
+   return ok;
+}
+
+
 static bool whap_stop_effect(ALLEGRO_HAPTIC_EFFECT_ID *id)
 {
    HRESULT res;
@@ -163,6 +163,8 @@ static bool hapxi_play_effect(ALLEGRO_HAPTIC_EFFECT_ID *id, int loop);
 static bool hapxi_stop_effect(ALLEGRO_HAPTIC_EFFECT_ID *id);
 static bool hapxi_is_effect_playing(ALLEGRO_HAPTIC_EFFECT_ID *id);
 static bool hapxi_release_effect(ALLEGRO_HAPTIC_EFFECT_ID *id);
+static bool hapxi_update_effect(ALLEGRO_HAPTIC_EFFECT_ID *id,
+                                ALLEGRO_HAPTIC_EFFECT *eff);
 
 static double hapxi_get_autocenter(ALLEGRO_HAPTIC *dev);
 static bool hapxi_set_autocenter(ALLEGRO_HAPTIC *dev, double);
@@ -206,7 +208,8 @@ ALLEGRO_HAPTIC_DRIVER _al_hapdrv_xinput =
    hapxi_release,
 
    hapxi_get_autocenter,
-   hapxi_set_autocenter
+   hapxi_set_autocenter,
+   hapxi_update_effect
 };
 
 
@@ -814,6 +817,34 @@ static bool hapxi_release_effect(ALLEGRO_HAPTIC_EFFECT_ID *id)
 }
 
 
+static bool hapxi_update_effect(ALLEGRO_HAPTIC_EFFECT_ID *id,
+                                ALLEGRO_HAPTIC_EFFECT *effect)
+{
+   ALLEGRO_HAPTIC_XINPUT *hapxi = hapxi_device_for_id(id);
+   ALLEGRO_HAPTIC_EFFECT_XINPUT *effxi = hapxi_effect_for_id(id);
+   bool result = true;
+
+   if ((!hapxi) || (!effxi))
+      return false;
+
+   al_lock_mutex(hapxi_mutex);
+   if (!hapxi_effect2win(effxi, effect, hapxi)) {
+      ALLEGRO_WARN("Cannot convert haptic effect to XINPUT effect.\n");
+      al_unlock_mutex(hapxi_mutex);
+      return false;
+   }
+   effxi->effect = (*effect);
+   id->_effect_duration = al_get_haptic_effect_duration(effect);
+   /* The motor speeds are all there is to an XInput effect, so a playing
+    * effect is updated right away instead of waiting for the next loop.
+    */
+   if (effxi->state == ALLEGRO_HAPTIC_EFFECT_XINPUT_STATE_PLAYING)
+      result = hapxi_force_play(hapxi, effxi);
+   al_unlock_mutex(hapxi_mutex);
+   return result;
+}
+
+
 static bool hapxi_release(ALLEGRO_HAPTIC *haptic)
 {
    ALLEGRO_HAPTIC_XINPUT *hapxi = hapxi_from_al(haptic);
@@ -41,7 +41,9 @@
    #undef MAKEFOURCC
 #endif
 
-/* Poll connected joysticks frequently and non-connected ones infrequently. */
+/* Poll connected joysticks frequently and non-connected ones infrequently.
+ * The first delay is the default for the xinput_poll_rate config key.
+ */
 #ifndef ALLEGRO_XINPUT_POLL_DELAY
 #define ALLEGRO_XINPUT_POLL_DELAY 0.01
 #endif
@@ -52,6 +54,8 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <allegro5/joystick.h>
 #include <mmsystem.h>
 #include <process.h>
@@ -124,14 +128,13 @@ XInputSetStatePROC _al_imp_XInputSetState = NULL;
 /* the joystick structures */
 static ALLEGRO_JOYSTICK_XINPUT joyxi_joysticks[MAX_JOYSTICKS];
 
-/* For the background threads. */
+/* For the background thread. */
 static ALLEGRO_THREAD *joyxi_thread = NULL;
-static ALLEGRO_THREAD *joyxi_disconnected_thread = NULL;
 static ALLEGRO_MUTEX  *joyxi_mutex = NULL;
-/* Use condition variables to put the thread to sleep and prevent too
+/* Use a condition variable to put the thread to sleep and prevent too
    frequent polling*/
 static ALLEGRO_COND   *joyxi_cond = NULL;
-static ALLEGRO_COND   *joyxi_disconnected_cond = NULL;
+static double joyxi_poll_delay = ALLEGRO_XINPUT_POLL_DELAY;
 
 /* Names for things in because XInput doesn't provide them. */
 
@@ -453,68 +456,120 @@ static void joyxi_poll_disconnected_joystick(ALLEGRO_JOYSTICK_XINPUT *xjoy)
 }
 
 
-/** Polls all connected joysticks. */
+/** Polls all connected joysticks. The events of all of them are emitted
+ * with the event source locked once.
+ */
 static void joyxi_poll_connected_joysticks(void)
 {
+   ALLEGRO_EVENT_SOURCE *es = NULL;
    int index;
 
+   if (al_is_joystick_installed())
+      es = al_get_joystick_event_source();
+   if (es)
+      _al_event_source_lock(es);
+
    for (index = 0; index < MAX_JOYSTICKS; index++) {
       if ((joyxi_joysticks + index)->active) {
          joyxi_poll_connected_joystick(joyxi_joysticks + index);
       }
    }
+
+   if (es)
+      _al_event_source_unlock(es);
 }
 
-/** Polls all disconnected joysticks. */
-static void joyxi_poll_disconnected_joysticks(void)
+/** Polls the next disconnected joystick. Asking for the capabilities of an
+ * empty slot can be slow, so the slots are checked one at a time, spread
+ * over the disconnected poll delay, rather than stalling one poll for all
+ * of them.
+ */
+static void joyxi_poll_disconnected_joystick_slot(void)
 {
+   static int next_slot = 0;
    int index;
 
    for (index = 0; index < MAX_JOYSTICKS; index++) {
-      if (!((joyxi_joysticks + index)->active)) {
-         joyxi_poll_disconnected_joystick(joyxi_joysticks + index);
+      ALLEGRO_JOYSTICK_XINPUT *xjoy = joyxi_joysticks + next_slot;
+      next_slot = (next_slot + 1) % MAX_JOYSTICKS;
+      if (!xjoy->active) {
+         joyxi_poll_disconnected_joystick(xjoy);
+         return;
       }
    }
 }
 
-/** Thread function that polls the active xinput joysticks. */
+/** Thread function that polls the xinput joysticks.
+ * Connected joysticks are polled at a fixed rate. The deadlines do not
+ * drift with the time the polling takes, which keeps the jitter low.
+ */
 static void *joyxi_poll_thread(ALLEGRO_THREAD *thread, void *arg)
 {
+   const double disconnected_delay =
+      ALLEGRO_XINPUT_DISCONNECTED_POLL_DELAY / MAX_JOYSTICKS;
    ALLEGRO_TIMEOUT timeout;
+   double next_poll, next_disconnected_poll;
+
    al_lock_mutex(joyxi_mutex);
-   /* Poll once every so much time, 10ms by default. */
+   next_poll = al_get_time();
+   next_disconnected_poll = next_poll + disconnected_delay;
    while (!al_get_thread_should_stop(thread)) {
-      al_init_timeout(&timeout, ALLEGRO_XINPUT_POLL_DELAY);
+      double now = al_get_time();
+
+      next_poll += joyxi_poll_delay;
+      /* Don't try to catch up after a stall. */
+      if (next_poll < now)
+         next_poll = now;
+
+      al_init_timeout(&timeout, next_poll - now);
       /* Wait for the condition for the polling time in stead of using
          al_rest to allows the polling thread to be awoken when needed. */
       al_wait_cond_until(joyxi_cond, joyxi_mutex, &timeout);
+      if (al_get_thread_should_stop(thread))
+         break;
       /* If we get here poll joystick for new input or connection
-       * and dispatch events. The mutexhas always been locked
+       * and dispatch events. The mutex has always been locked
        * so this should be OK. */
       joyxi_poll_connected_joysticks();
+
+      now = al_get_time();
+      if (now >= next_disconnected_poll) {
+         joyxi_poll_disconnected_joystick_slot();
+         next_disconnected_poll = now + disconnected_delay;
+      }
    }
    al_unlock_mutex(joyxi_mutex);
    return arg;
 }
 
-/** Thread function that polls the disconnected joysticks. */
-static void *joyxi_poll_disconnected_thread(ALLEGRO_THREAD *thread, void *arg)
+/** Reads the poll rate from the configuration. It is a number of polls per
+ * second, or "display" for the refresh rate of the current display.
+ */
+static double joyxi_get_poll_delay(void)
 {
-   ALLEGRO_TIMEOUT timeout;
-   al_lock_mutex(joyxi_mutex);
-   /* Poll once every so much time, 10ms by default. */
-   while (!al_get_thread_should_stop(thread)) {
-      al_init_timeout(&timeout, ALLEGRO_XINPUT_DISCONNECTED_POLL_DELAY);
-      /* Wait for the condition for the polling time in stead of using
-         al_rest to allows the polling thread to be awoken when needed. */
-      al_wait_cond_until(joyxi_disconnected_cond, joyxi_mutex, &timeout);
-      /* If we get here poll joystick for new input or connection
-       * and dispatch events. The mutex has always been locked
-       * so this should be OK. */
-      joyxi_poll_disconnected_joysticks();
+   const char *value = al_get_config_value(al_get_system_config(),
+      "joystick", "xinput_poll_rate");
+   double rate;
+
+   if (!value || value[0] == '\0')
+      return ALLEGRO_XINPUT_POLL_DELAY;
+
+   if (strcmp(value, "display") == 0) {
+      ALLEGRO_DISPLAY *display = al_get_current_display();
+      rate = display ? al_get_display_refresh_rate(display) : 0;
+      /* Windowed displays often don't know their refresh rate. */
+      if (rate <= 0)
+         rate = 60;
    }
-   al_unlock_mutex(joyxi_mutex);
-   return arg;
+   else {
+      rate = atof(value);
+      if (rate <= 0)
+         return ALLEGRO_XINPUT_POLL_DELAY;
+   }
+
+   if (rate > 1000)
+      rate = 1000;
+   return 1.0 / rate;
 }
 
 
@@ -551,16 +606,17 @@ static bool joyxi_init_joystick(void)
    if (!load_xinput_module())
       return false;
 
-   /* Create the mutex and two condition variables. */
+   /* Create the mutex and the condition variable. */
    joyxi_mutex = al_create_mutex_recursive();
    if (!joyxi_mutex)
       return false;
    joyxi_cond = al_create_cond();
    if (!joyxi_cond)
       return false;
-   joyxi_disconnected_cond = al_create_cond();
-   if (!joyxi_disconnected_cond)
-      return false;
+
+   joyxi_poll_delay = joyxi_get_poll_delay();
+   ALLEGRO_INFO("Polling XInput joysticks every %.1f ms.\n",
+      joyxi_poll_delay * 1000.0);
 
    al_lock_mutex(joyxi_mutex);
 
@@ -584,20 +640,17 @@ static bool joyxi_init_joystick(void)
          joyxi_joysticks[index].active = (res == ERROR_SUCCESS);
       }
    }
-   /* Now start two polling background thread, since XInput is a polled API.
-    * The first thread will poll the active joysticks frequently, the second
-    * thread will poll the inactive joysticks infrequently.
-    * This is done like this to preserve performance.
+   /* Now start the polling background thread, since XInput is a polled API.
+    * It polls the active joysticks frequently and the inactive joysticks
+    * infrequently.
     */
    joyxi_thread = al_create_thread(joyxi_poll_thread, NULL);
-   joyxi_disconnected_thread = al_create_thread(joyxi_poll_disconnected_thread, NULL);
 
    al_unlock_mutex(joyxi_mutex);
 
    if (joyxi_thread) al_start_thread(joyxi_thread);
-   if (joyxi_disconnected_thread) al_start_thread(joyxi_disconnected_thread);
 
-   return (joyxi_thread != NULL) && (joyxi_disconnected_thread != NULL);
+   return (joyxi_thread != NULL);
 }
 
 
@@ -612,13 +665,8 @@ static void joyxi_exit_joystick(void)
    al_set_thread_should_stop(joyxi_thread);
    al_signal_cond(joyxi_cond);
    al_join_thread(joyxi_thread, &ret_value);
-   al_set_thread_should_stop(joyxi_disconnected_thread);
-   al_signal_cond(joyxi_disconnected_cond);
-   al_join_thread(joyxi_disconnected_thread, &ret_value);
 
    /* clean it all up. */
-   al_destroy_thread(joyxi_disconnected_thread);
-   al_destroy_cond(joyxi_disconnected_cond);
    al_destroy_thread(joyxi_thread);
    al_destroy_cond(joyxi_cond);
 
@@ -649,10 +697,8 @@ static bool joyxi_reconfigure_joysticks(void)
       }
    }
    al_unlock_mutex(joyxi_mutex);
-   /** Signal the conditions so new events are sent immediately for the new joysticks. */
+   /** Signal the condition so new events are sent immediately for the new joysticks. */
    al_signal_cond(joyxi_cond);
-   /** Signal the disconnected thread in case another joystick got connected. */
-   al_signal_cond(joyxi_disconnected_cond);
    return true;
 }
 
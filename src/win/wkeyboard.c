@@ -364,7 +364,7 @@ void _al_win_kbd_handle_key_press(int scode, int vcode, bool extended,
       return;
 
    event.keyboard.type = ALLEGRO_EVENT_KEY_DOWN;
-   event.keyboard.timestamp = al_get_time();
+   event.keyboard.timestamp = _al_win_message_input_time(&the_keyboard.es);
    event.keyboard.display = display;
    event.keyboard.keycode = my_code;
    event.keyboard.unichar = 0;
@@ -458,7 +458,7 @@ void _al_win_kbd_handle_key_release(int scode, int vcode, bool extended, ALLEGRO
       return;
 
    event.keyboard.type = ALLEGRO_EVENT_KEY_UP;
-   event.keyboard.timestamp = al_get_time();
+   event.keyboard.timestamp = _al_win_message_input_time(&the_keyboard.es);
    event.keyboard.display = (void*)win_disp;
    event.keyboard.keycode = my_code;
    event.keyboard.unichar = 0;
@@ -15,13 +15,6 @@
  *      See readme.txt for copyright information.
  */
 
-#if 0
-/* Raw input */
-#define _WIN32_WINNT 0x0501
-#ifndef WINVER
-#define WINVER 0x0600
-#endif
-#endif
 #include <windows.h>
 
 /*
@@ -39,6 +32,8 @@
 #include "allegro5/platform/aintwin.h"
 #include "allegro5/internal/aintern_display.h"
 
+ALLEGRO_DEBUG_CHANNEL("wmouse")
+
 static ALLEGRO_MOUSE_STATE mouse_state;
 static ALLEGRO_MOUSE the_mouse;
 static bool installed = false;
@@ -47,6 +42,68 @@ static bool installed = false;
 static int raw_mouse_z = 0;
 static int raw_mouse_w = 0;
 
+/* With raw input the motion events carry the unaccelerated counts of the
+ * device in dx/dy, read from WM_INPUT. WM_MOUSEMOVE then only keeps track
+ * of the cursor position, unless the device reports absolute positions
+ * (e.g. a pen tablet).
+ */
+static bool raw_input = false;
+static bool raw_absolute = false;
+static bool coalesce_motion = true;
+/* RAWINPUTHEADER is bigger for 32-bit programs on 64-bit Windows, but only
+ * in the blocks returned by GetRawInputBuffer.
+ */
+static int raw_header_size = sizeof(RAWINPUTHEADER);
+
+
+static bool get_config_bool(const char *key, bool def)
+{
+   const char *value = al_get_config_value(al_get_system_config(), "mouse",
+      key);
+   if (!value)
+      return def;
+   return strcmp(value, "true") == 0;
+}
+
+
+static void register_raw_input(void)
+{
+   RAWINPUTDEVICE rid;
+
+   rid.usUsagePage = 0x01; /* generic desktop */
+   rid.usUsage = 0x02;     /* mouse */
+   rid.dwFlags = 0;
+   rid.hwndTarget = NULL;
+   if (!RegisterRawInputDevices(&rid, 1, sizeof(rid))) {
+      ALLEGRO_WARN("Could not register for raw mouse input.\n");
+      raw_input = false;
+      return;
+   }
+
+#ifndef _WIN64
+   {
+      BOOL wow64 = FALSE;
+      if (IsWow64Process(GetCurrentProcess(), &wow64) && wow64)
+         raw_header_size = sizeof(RAWINPUTHEADER) + 8;
+   }
+#endif
+
+   ALLEGRO_INFO("Using raw mouse input, %s.\n",
+      coalesce_motion ? "coalesced" : "not coalesced");
+}
+
+
+static void unregister_raw_input(void)
+{
+   RAWINPUTDEVICE rid;
+
+   rid.usUsagePage = 0x01;
+   rid.usUsage = 0x02;
+   rid.dwFlags = RIDEV_REMOVE;
+   rid.hwndTarget = NULL;
+   RegisterRawInputDevices(&rid, 1, sizeof(rid));
+}
+
 
 static bool init_mouse(void)
 {
@@ -65,18 +122,11 @@ static bool init_mouse(void)
 
    _al_event_source_init(&the_mouse.es);
 
-#if 0
-   if (al_get_new_display_flags() & ALLEGRO_FULLSCREEN) {
-      RAWINPUTDEVICE rid[1];
-      rid[0].usUsagePage = 0x01; 
-      rid[0].usUsage = 0x02; 
-      rid[0].dwFlags = RIDEV_NOLEGACY;
-      rid[0].hwndTarget = 0;
-      if (RegisterRawInputDevices(rid, 1, sizeof(rid[0])) == FALSE) {
-         return false;
-      }
-   }
-#endif
+   raw_input = get_config_bool("raw_input", false);
+   coalesce_motion = get_config_bool("coalesce_raw_motion", true);
+   raw_absolute = false;
+   if (raw_input)
+      register_raw_input();
 
    installed = true;
 
@@ -89,13 +139,18 @@ static void exit_mouse(void)
    if (!installed)
       return;
 
+   if (raw_input) {
+      unregister_raw_input();
+      raw_input = false;
+   }
+
    memset(&mouse_state, 0, sizeof(mouse_state));
    _al_event_source_free(&the_mouse.es);
    installed = false;
 }
 
 
-static void generate_mouse_event(unsigned int type,
+static void generate_mouse_event(unsigned int type, double timestamp,
                                  int x, int y, int z, int w, float pressure,
                                  int dx, int dy, int dz, int dw,
                                  unsigned int button,
@@ -108,7 +163,7 @@ static void generate_mouse_event(unsigned int type,
 
    _al_event_source_lock(&the_mouse.es);
    event.mouse.type = type;
-   event.mouse.timestamp = al_get_time();
+   event.mouse.timestamp = timestamp;
    event.mouse.display = source;
    event.mouse.x = x;
    event.mouse.y = y;
@@ -166,7 +221,7 @@ static bool set_mouse_xy(ALLEGRO_DISPLAY *disp, int x, int y)
       mouse_state.y = y;
 
       generate_mouse_event(
-         ALLEGRO_EVENT_MOUSE_WARPED,
+         ALLEGRO_EVENT_MOUSE_WARPED, al_get_time(),
          mouse_state.x, mouse_state.y, mouse_state.z, mouse_state.w, mouse_state.pressure,
          dx, dy, 0, 0,
          0, (void*)win_disp);
@@ -195,7 +250,7 @@ static bool set_mouse_axis(int which, int val)
          mouse_state.z = val;
 
          generate_mouse_event(
-            ALLEGRO_EVENT_MOUSE_AXES,
+            ALLEGRO_EVENT_MOUSE_AXES, al_get_time(),
             mouse_state.x, mouse_state.y, mouse_state.z, mouse_state.w, mouse_state.pressure,
             0, 0, dz, 0,
             0, mouse_state.display);
@@ -214,7 +269,7 @@ static bool set_mouse_axis(int which, int val)
          mouse_state.w = val;
 
          generate_mouse_event(
-            ALLEGRO_EVENT_MOUSE_AXES,
+            ALLEGRO_EVENT_MOUSE_AXES, al_get_time(),
             mouse_state.x, mouse_state.y, mouse_state.z, mouse_state.w, mouse_state.pressure,
             0, 0, 0, dw,
             0, mouse_state.display);
@@ -274,6 +329,7 @@ void _al_win_mouse_handle_leave(ALLEGRO_DISPLAY_WIN *win_disp)
       return;
 
    generate_mouse_event(ALLEGRO_EVENT_MOUSE_LEAVE_DISPLAY,
+      _al_win_message_input_time(&the_mouse.es),
       mouse_state.x, mouse_state.y, mouse_state.z, mouse_state.w, mouse_state.pressure,
       0, 0, 0, 0,
       0, (void*)win_disp);
@@ -291,6 +347,7 @@ void _al_win_mouse_handle_enter(ALLEGRO_DISPLAY_WIN *win_disp)
       return;
 
    generate_mouse_event(ALLEGRO_EVENT_MOUSE_ENTER_DISPLAY,
+      _al_win_message_input_time(&the_mouse.es),
       mouse_state.x, mouse_state.y, mouse_state.z, mouse_state.w, mouse_state.pressure,
       0, 0, 0, 0,
       0, (void*)win_disp);
@@ -321,8 +378,83 @@ void _al_win_mouse_handle_move(int x, int y, bool abs, ALLEGRO_DISPLAY_WIN *win_
       mouse_state.y = y;
    }
 
+   /* The event is generated from the raw input instead. */
+   if (raw_input && !raw_absolute)
+      return;
+
    if (oldx != mouse_state.x || oldy != mouse_state.y) {
       generate_mouse_event(ALLEGRO_EVENT_MOUSE_AXES,
+         _al_win_message_input_time(&the_mouse.es),
+         mouse_state.x, mouse_state.y, mouse_state.z, mouse_state.w, mouse_state.pressure,
+         dx, dy, 0, 0,
+         0, (void*)win_disp);
+   }
+}
+
+
+static void add_raw_motion(const RAWMOUSE *rm, int *dx, int *dy)
+{
+   if (rm->usFlags & MOUSE_MOVE_ABSOLUTE) {
+      raw_absolute = true;
+      return;
+   }
+
+   raw_absolute = false;
+   *dx += rm->lLastX;
+   *dy += rm->lLastY;
+}
+
+
+/* Add up the motion of all raw input which is already waiting, so that a
+ * mouse with a high report rate gives one event per message loop iteration
+ * rather than one per report.
+ */
+static void drain_raw_motion(int *dx, int *dy)
+{
+   RAWINPUT buffer[16];
+
+   for (;;) {
+      UINT size = sizeof(buffer);
+      UINT count = GetRawInputBuffer(buffer, &size, sizeof(RAWINPUTHEADER));
+      RAWINPUT *raw = buffer;
+      UINT i;
+
+      if (count == 0 || count == (UINT)-1)
+         break;
+
+      for (i = 0; i < count; i++) {
+         if (raw->header.dwType == RIM_TYPEMOUSE)
+            add_raw_motion((RAWMOUSE *)((BYTE *)raw + raw_header_size), dx, dy);
+         raw = NEXTRAWINPUTBLOCK(raw);
+      }
+   }
+}
+
+
+void _al_win_mouse_handle_raw_input(HRAWINPUT input,
+   ALLEGRO_DISPLAY_WIN *win_disp)
+{
+   RAWINPUT raw;
+   UINT size = sizeof(raw);
+   int dx = 0, dy = 0;
+
+   if (!installed || !raw_input)
+      return;
+
+   if (GetRawInputData(input, RID_INPUT, &raw, &size,
+         sizeof(RAWINPUTHEADER)) == (UINT)-1)
+      return;
+   if (raw.header.dwType != RIM_TYPEMOUSE)
+      return;
+
+   add_raw_motion(&raw.data.mouse, &dx, &dy);
+   if (coalesce_motion)
+      drain_raw_motion(&dx, &dy);
+
+   /* The position is kept up to date by WM_MOUSEMOVE. */
+   if (dx || dy) {
+      generate_mouse_event(ALLEGRO_EVENT_MOUSE_AXES,
+         _al_win_message_input_time(&the_mouse.es),
          mouse_state.x, mouse_state.y, mouse_state.z, mouse_state.w, mouse_state.pressure,
          dx, dy, 0, 0,
          0, (void*)win_disp);
@@ -350,6 +482,7 @@ void _al_win_mouse_handle_wheel(int raw_dz, bool abs, ALLEGRO_DISPLAY_WIN *win_d
    mouse_state.z = new_z;
 
    generate_mouse_event(ALLEGRO_EVENT_MOUSE_AXES,
+      _al_win_message_input_time(&the_mouse.es),
       mouse_state.x, mouse_state.y, mouse_state.z, mouse_state.w, mouse_state.pressure,
       0, 0, d, 0,
       0, (void*)win_disp);
@@ -376,6 +509,7 @@ void _al_win_mouse_handle_hwheel(int raw_dw, bool abs, ALLEGRO_DISPLAY_WIN *win_
    mouse_state.w = new_w;
 
    generate_mouse_event(ALLEGRO_EVENT_MOUSE_AXES,
+      _al_win_message_input_time(&the_mouse.es),
       mouse_state.x, mouse_state.y, mouse_state.z, mouse_state.w, mouse_state.pressure,
       0, 0, 0, d,
       0, (void*)win_disp);
@@ -409,6 +543,7 @@ void _al_win_mouse_handle_button(int button, bool down, int x, int y, bool abs,
    mouse_state.pressure = mouse_state.buttons ? 1.0 : 0.0; /* TODO */
 
    generate_mouse_event(type,
+      _al_win_message_input_time(&the_mouse.es),
       mouse_state.x, mouse_state.y, mouse_state.z, mouse_state.w, mouse_state.pressure,
       0, 0, 0, 0,
       button, (void*)win_disp);
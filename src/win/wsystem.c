@@ -916,6 +916,7 @@ static ALLEGRO_SYSTEM_INTERFACE *_al_system_win_driver(void)
    vt->get_time = _al_win_get_time;
    vt->rest = _al_win_rest;
    vt->init_timeout = _al_win_init_timeout;
+   vt->rest_until = _al_win_rest_until;
 
    return vt;
 }
@@ -17,6 +17,7 @@
 
 
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern_events.h"
 #include "allegro5/internal/aintern_thread.h"
 #include "allegro5/platform/aintwin.h"
 
@@ -37,6 +38,16 @@ static double (*real_get_time_func)(void);
 
 static _AL_MUTEX time_mutex = _AL_MUTEX_UNINITED;
 
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+   #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+typedef HANDLE (WINAPI *CREATE_WAITABLE_TIMER_EX_PROC)(
+   LPSECURITY_ATTRIBUTES, LPCWSTR, DWORD, DWORD);
+
+/* Used by _al_win_rest_until, which only the timer thread calls. */
+static HANDLE rest_timer;
+
 
 static double low_res_current_time(void)
 {
@@ -89,11 +100,53 @@ double _al_win_get_time(void)
 }
 
 
+
+/* _al_win_message_input_time:
+ *  Return the timestamp for the input of the message being processed by the
+ *  calling thread, and record its latency in the event source. Message times
+ *  come from GetTickCount, so they are only as precise as the system tick,
+ *  usually 10 to 16 ms.
+ */
+double _al_win_message_input_time(ALLEGRO_EVENT_SOURCE *es)
+{
+   DWORD age_ms = GetTickCount() - (DWORD)GetMessageTime();
+   double time;
+
+   _al_event_source_lock(es);
+   time = _al_event_source_input_time(es, al_get_time() - age_ms / 1000.0);
+   _al_event_source_unlock(es);
+
+   return time;
+}
+
+
+static HANDLE create_rest_timer(void)
+{
+   CREATE_WAITABLE_TIMER_EX_PROC create_ex;
+   HANDLE timer = NULL;
+
+   /* High resolution waitable timers exist since Windows 10 1803. */
+   create_ex = (CREATE_WAITABLE_TIMER_EX_PROC)GetProcAddress(
+      GetModuleHandle(TEXT("kernel32.dll")), "CreateWaitableTimerExW");
+   if (create_ex) {
+      timer = create_ex(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+         TIMER_ALL_ACCESS);
+   }
+   if (!timer)
+      timer = CreateWaitableTimer(NULL, TRUE, NULL);
+
+   return timer;
+}
+
+
+
 void _al_win_init_time(void)
 {
    LARGE_INTEGER tmp_freq;
    _al_win_total_time = 0;
 
+   rest_timer = create_rest_timer();
+
    _al_mutex_init(&time_mutex);
    
    if (QueryPerformanceFrequency(&tmp_freq) == 0) {
@@ -114,6 +167,11 @@ void _al_win_init_time(void)
 void _al_win_shutdown_time(void)
 {
    _al_mutex_destroy(&time_mutex);
+
+   if (rest_timer) {
+      CloseHandle(rest_timer);
+      rest_timer = NULL;
+   }
 }
 
 
@@ -128,6 +186,29 @@ void _al_win_rest(double seconds)
 
 
 
+void _al_win_rest_until(double time)
+{
+   double seconds = time - _al_win_get_time();
+   LARGE_INTEGER due;
+
+   if (seconds <= 0)
+      return;
+
+   if (!rest_timer) {
+      _al_win_rest(seconds);
+      return;
+   }
+
+   /* Negative due times are relative, in units of 100 nanoseconds. */
+   due.QuadPart = -(LONGLONG)(seconds * 1e7);
+   if (SetWaitableTimer(rest_timer, &due, 0, NULL, NULL, FALSE))
+      WaitForSingleObject(rest_timer, INFINITE);
+   else
+      _al_win_rest(seconds);
+}
+
+
+
 void _al_win_init_timeout(ALLEGRO_TIMEOUT *timeout, double seconds)
 {
    ALLEGRO_TIMEOUT_WIN *wt = (ALLEGRO_TIMEOUT_WIN *) timeout;
@@ -116,6 +116,14 @@ void _al_win_exit_touch_input_api(void)
 
 /* Actual driver implementation. */
 
+/* Must be called with the event source locked. */
+static void publish_state(double timestamp)
+{
+   _al_publish_input_snapshot(&touch_input.snapshot, &touch_input_state,
+      timestamp);
+}
+
+
 static void generate_touch_input_event(int type, double timestamp, int id, float x, float y, float dx, float dy, bool primary, ALLEGRO_DISPLAY_WIN *win_disp)
 {
    ALLEGRO_EVENT event;
@@ -130,6 +138,11 @@ static void generate_touch_input_event(int type, double timestamp, int id, float
    else if (touch_input.mouse_emulation_mode == ALLEGRO_MOUSE_EMULATION_EXCLUSIVE)
       want_touch_event = want_mouse_emulation_event ? false : want_touch_event;
 
+   if (want_touch_event &&
+         _al_touch_input_defer_event(&touch_input, type, timestamp,
+            (ALLEGRO_DISPLAY *)win_disp))
+      want_touch_event = false;
+
    if (!want_touch_event && !want_mouse_emulation_event)
       return;
 
@@ -198,6 +211,9 @@ static bool init_touch_input(void)
 
    memset(&touch_input_state, 0, sizeof(touch_input_state));
 
+   if (!_al_init_touch_input_frames(&touch_input))
+      ALLEGRO_WARN("Touch frame events are not available.\n");
+
    _al_event_source_init(&touch_input.es);
    _al_event_source_init(&touch_input.mouse_emulation_es);
 
@@ -230,6 +246,7 @@ static void exit_touch_input(void)
 
    _al_event_source_free(&touch_input.es);
    _al_event_source_free(&touch_input.mouse_emulation_es);
+   _al_destroy_touch_input_frames(&touch_input);
 
    _al_win_exit_touch_input_api();
 
@@ -322,6 +339,7 @@ void _al_win_touch_input_handle_begin(int id, size_t timestamp, float x, float y
    state->dx      = 0.0f;
    state->dy      = 0.0f;
    state->primary = primary;
+   publish_state(get_time_stamp(timestamp));
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_BEGIN, get_time_stamp(timestamp),
@@ -343,6 +361,7 @@ void _al_win_touch_input_handle_end(int id, size_t timestamp, float x, float y,
    state->dy      = y - state->y;
    state->x       = x;
    state->y       = y;
+   publish_state(get_time_stamp(timestamp));
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_END, get_time_stamp(timestamp),
@@ -350,6 +369,7 @@ void _al_win_touch_input_handle_end(int id, size_t timestamp, float x, float y,
 
    _al_event_source_lock(&touch_input.es);
    memset(state, 0, sizeof(ALLEGRO_TOUCH_STATE));
+   publish_state(get_time_stamp(timestamp));
    _al_event_source_unlock(&touch_input.es);
 }
 
@@ -368,6 +388,7 @@ void _al_win_touch_input_handle_move(int id, size_t timestamp, float x, float y,
    state->dy      = y - state->y;
    state->x       = x;
    state->y       = y;
+   publish_state(get_time_stamp(timestamp));
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_MOVE, get_time_stamp(timestamp),
@@ -389,6 +410,7 @@ void _al_win_touch_input_handle_cancel(int id, size_t timestamp, float x, float
    state->dy      = y - state->y;
    state->x       = x;
    state->y       = y;
+   publish_state(get_time_stamp(timestamp));
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_CANCEL, get_time_stamp(timestamp),
@@ -396,10 +418,17 @@ void _al_win_touch_input_handle_cancel(int id, size_t timestamp, float x, float
 
    _al_event_source_lock(&touch_input.es);
    memset(state, 0, sizeof(ALLEGRO_TOUCH_STATE));
+   publish_state(get_time_stamp(timestamp));
    _al_event_source_unlock(&touch_input.es);
 }
 
 
+void _al_win_touch_input_end_frame(void)
+{
+   _al_touch_input_end_frame(&touch_input);
+}
+
+
 /* the driver vtable */
 #define TOUCH_INPUT_WINAPI AL_ID('W','T','I','D')
 
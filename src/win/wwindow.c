@@ -408,6 +408,19 @@ static void break_window_message_pump(ALLEGRO_DISPLAY_WIN *win_display, HWND hWn
  * we do not want to use this, because Allegro driver provide emulation already. This
  * way we can be consistent across platforms.
  */
+/* Runs window commands that were posted but not yet handled, so that none
+ * are lost (and nothing they own is leaked) when the window goes away.
+ */
+static void run_pending_procs(HWND hWnd)
+{
+   MSG msg;
+
+   while (PeekMessage(&msg, hWnd, _al_win_msg_call_proc,
+         _al_win_msg_call_proc, PM_REMOVE)) {
+      ((void (*)(void*))msg.wParam) ((void*)msg.lParam);
+   }
+}
+
 static bool accept_mouse_event(void)
 {
    if (!al_is_touch_input_installed())
@@ -440,6 +453,7 @@ static LRESULT CALLBACK window_callback(HWND hWnd, UINT message,
    if (message == _al_win_msg_suicide && wParam) {
       win_display = (ALLEGRO_DISPLAY_WIN*)wParam;
       break_window_message_pump(win_display, hWnd);
+      run_pending_procs(hWnd);
       if (_al_win_unregister_touch_window)
          _al_win_unregister_touch_window(hWnd);
       DestroyWindow(hWnd);
@@ -461,6 +475,7 @@ static LRESULT CALLBACK window_callback(HWND hWnd, UINT message,
 
    if (message == _al_win_msg_suicide) {
       break_window_message_pump(win_display, hWnd);
+      run_pending_procs(hWnd);
       if (_al_win_unregister_touch_window)
          _al_win_unregister_touch_window(hWnd);
       DestroyWindow(hWnd);
@@ -476,69 +491,9 @@ static LRESULT CALLBACK window_callback(HWND hWnd, UINT message,
 
    switch (message) {
       case WM_INPUT:
-      {
-         /* RAW Input is currently unused. */
-          UINT dwSize;
-          LPBYTE lpb;
-          RAWINPUT* raw;
-
-          /* We can't uninstall WM_INPUT mesages. */
-          if (!al_is_mouse_installed())
-             break;
-
-          GetRawInputData((HRAWINPUT)lParam, RID_INPUT, NULL, &dwSize,
-                          sizeof(RAWINPUTHEADER));
-          lpb = al_malloc(sizeof(BYTE)*dwSize);
-          if (lpb == NULL)
-              break;
-
-          GetRawInputData((HRAWINPUT)lParam, RID_INPUT, lpb, &dwSize, sizeof(RAWINPUTHEADER));
-          raw = (RAWINPUT*)lpb;
-
-          if (raw->header.dwType != RIM_TYPEMOUSE) {
-             al_free(lpb);
-             break;
-          }
-
-       {
-          RAWMOUSE *rm = &raw->data.mouse;
-          int x = raw->data.mouse.lLastX;
-          int y = raw->data.mouse.lLastY;
-          bool abs = (rm->usFlags & (MOUSE_MOVE_ABSOLUTE
-                                    | MOUSE_VIRTUAL_DESKTOP)) != 0;
-          if (abs || x || y)
-             _al_win_mouse_handle_move(x, y, abs, win_display);
-
-          if (rm->usButtonFlags & RI_MOUSE_BUTTON_1_DOWN)
-             _al_win_mouse_handle_button(1, true, x, y, abs, win_display);
-          if (rm->usButtonFlags & RI_MOUSE_BUTTON_1_UP)
-             _al_win_mouse_handle_button(1, false, x, y, abs, win_display);
-          if (rm->usButtonFlags & RI_MOUSE_BUTTON_2_DOWN)
-             _al_win_mouse_handle_button(2, true, x, y, abs, win_display);
-          if (rm->usButtonFlags & RI_MOUSE_BUTTON_2_UP)
-             _al_win_mouse_handle_button(2, false, x, y, abs, win_display);
-          if (rm->usButtonFlags & RI_MOUSE_BUTTON_3_DOWN)
-             _al_win_mouse_handle_button(3, true, x, y, abs, win_display);
-          if (rm->usButtonFlags & RI_MOUSE_BUTTON_3_UP)
-             _al_win_mouse_handle_button(3, false, x, y, abs, win_display);
-          if (rm->usButtonFlags & RI_MOUSE_BUTTON_4_DOWN)
-             _al_win_mouse_handle_button(4, true, x, y, abs, win_display);
-          if (rm->usButtonFlags & RI_MOUSE_BUTTON_4_UP)
-             _al_win_mouse_handle_button(4, false, x, y, abs, win_display);
-          if (rm->usButtonFlags & RI_MOUSE_BUTTON_5_DOWN)
-             _al_win_mouse_handle_button(5, true, x, y, abs, win_display);
-          if (rm->usButtonFlags & RI_MOUSE_BUTTON_5_UP)
-             _al_win_mouse_handle_button(5, false, x, y, abs, win_display);
-
-          if (rm->usButtonFlags & RI_MOUSE_WHEEL) {
-             SHORT z = (SHORT)rm->usButtonData;
-             _al_win_mouse_handle_wheel(z, false, win_display);
-          }
-       }
-
-          al_free(lpb);
-          break;
-      }
+         /* Only delivered if raw mouse input is enabled in the config. */
+         _al_win_mouse_handle_raw_input((HRAWINPUT)lParam, win_display);
+         break;
       case WM_LBUTTONDOWN:
       case WM_LBUTTONUP: {
          if (accept_mouse_event()) {
@@ -680,6 +635,8 @@ static LRESULT CALLBACK window_callback(HWND hWnd, UINT message,
                      else if (touch->dwFlags & _AL_TOUCHEVENTF_MOVE)
                         _al_win_touch_input_handle_move((int)touch->dwID, (size_t)touch->dwTime, x, y, primary, win_display);
                   }
+
+                  _al_win_touch_input_end_frame();
                }
 
                _al_win_close_touch_input_handle((HANDLE)lParam);
@@ -996,6 +953,10 @@ static LRESULT CALLBACK window_callback(HWND hWnd, UINT message,
       case WM_DEVICECHANGE:
         _al_win_joystick_dinput_trigger_enumeration();
         break;
+      case WM_DISPLAYCHANGE:
+        /* Sent to every top level window, so each display gets the event. */
+        _al_display_topology_changed(d);
+        break;
    }
 
    return DefWindowProc(hWnd,message,wParam,lParam);
@@ -1060,12 +1021,60 @@ static int win_choose_icon_bitmap(const int sys_w, const int sys_h,
    return best_i;
 }
 
+/* Window operations which don't return anything are posted to the window
+ * thread instead of sent. Sending from another thread blocks the caller
+ * until the window thread gets around to it, which can take several
+ * milliseconds while it is busy in the message loop. The window thread's
+ * message queue keeps posted commands in order.
+ */
+static void post_window_command(HWND window, void (*proc)(void*), void *arg)
+{
+   if (GetWindowThreadProcessId(window, NULL) == GetCurrentThreadId() ||
+         !PostMessage(window, _al_win_msg_call_proc, (WPARAM)proc,
+            (LPARAM)arg)) {
+      proc(arg);
+   }
+}
+
+typedef struct WINDOW_ICON_COMMAND
+{
+   HWND window;
+   WPARAM icon_type;
+   HICON icon;
+} WINDOW_ICON_COMMAND;
+
+static void set_icon_proc(void *arg)
+{
+   WINDOW_ICON_COMMAND *cmd = arg;
+   HICON old_icon;
+
+   old_icon = (HICON)SendMessage(cmd->window, WM_SETICON, cmd->icon_type,
+      (LPARAM)cmd->icon);
+   if (old_icon)
+      DestroyIcon(old_icon);
+   al_free(cmd);
+}
+
+static void post_set_icon(HWND window, WPARAM icon_type, HICON icon)
+{
+   WINDOW_ICON_COMMAND *cmd = al_malloc(sizeof *cmd);
+
+   if (!cmd) {
+      if (icon)
+         DestroyIcon(icon);
+      return;
+   }
+   cmd->window = window;
+   cmd->icon_type = icon_type;
+   cmd->icon = icon;
+   post_window_command(window, set_icon_proc, cmd);
+}
+
 static void win_set_display_icon(ALLEGRO_DISPLAY_WIN *win_display,
    const WPARAM icon_type, const int sys_w, const int sys_h,
    const int num_icons, ALLEGRO_BITMAP *bmps[])
 {
    HICON icon;
-   HICON old_icon;
    ALLEGRO_BITMAP *bmp;
    int bmp_w;
    int bmp_h;
@@ -1103,11 +1112,7 @@ static void win_set_display_icon(ALLEGRO_DISPLAY_WIN *win_display,
       al_destroy_bitmap(tmp_bmp);
    }
 
-   old_icon = (HICON)SendMessage(win_display->window, WM_SETICON,
-      icon_type, (LPARAM)icon);
-
-   if (old_icon)
-      DestroyIcon(old_icon);
+   post_set_icon(win_display->window, icon_type, icon);
 }
 
 void _al_win_set_display_icons(ALLEGRO_DISPLAY *display,
@@ -1131,26 +1136,42 @@ void _al_win_set_display_icons(ALLEGRO_DISPLAY *display,
 void _al_win_destroy_display_icons(ALLEGRO_DISPLAY *display)
 {
    ALLEGRO_DISPLAY_WIN *win_display = (ALLEGRO_DISPLAY_WIN *)display;
-   HICON old_icon;
 
-   old_icon = (HICON)SendMessage(win_display->window, WM_SETICON, ICON_SMALL, 0);
-   if (old_icon)
-      DestroyIcon(old_icon);
-   old_icon = (HICON)SendMessage(win_display->window, WM_SETICON, ICON_BIG, 0);
-   if (old_icon)
-      DestroyIcon(old_icon);
+   post_set_icon(win_display->window, ICON_SMALL, NULL);
+   post_set_icon(win_display->window, ICON_BIG, NULL);
 }
 
-void _al_win_set_window_position(HWND window, int x, int y)
+typedef struct WINDOW_POSITION_COMMAND
 {
+   HWND window;
+   int x, y;
+} WINDOW_POSITION_COMMAND;
+
+static void set_window_position_proc(void *arg)
+{
+   WINDOW_POSITION_COMMAND *cmd = arg;
+
    SetWindowPos(
-      window,
+      cmd->window,
       HWND_TOP,
-      x,
-      y,
+      cmd->x,
+      cmd->y,
       0,
       0,
       SWP_NOSIZE | SWP_NOZORDER);
+   al_free(cmd);
+}
+
+void _al_win_set_window_position(HWND window, int x, int y)
+{
+   WINDOW_POSITION_COMMAND *cmd = al_malloc(sizeof *cmd);
+
+   if (!cmd)
+      return;
+   cmd->window = window;
+   cmd->x = x;
+   cmd->y = y;
+   post_window_command(window, set_window_position_proc, cmd);
 }
 
 void _al_win_get_window_position(HWND window, int *x, int *y)
@@ -1309,12 +1330,31 @@ bool _al_win_set_display_flag(ALLEGRO_DISPLAY *display, int flag, bool onoff)
 }
 
 
+typedef struct WINDOW_TITLE_COMMAND
+{
+   HWND window;
+   TCHAR *title;
+} WINDOW_TITLE_COMMAND;
+
+static void set_window_title_proc(void *arg)
+{
+   WINDOW_TITLE_COMMAND *cmd = arg;
+
+   SetWindowText(cmd->window, cmd->title);
+   al_free(cmd->title);
+   al_free(cmd);
+}
+
 void _al_win_set_window_title(ALLEGRO_DISPLAY *display, const char *title)
 {
    ALLEGRO_DISPLAY_WIN *win_display = (ALLEGRO_DISPLAY_WIN *)display;
-   TCHAR *ttitle = _twin_utf8_to_tchar(title);
-   SetWindowText(win_display->window, ttitle);
-   al_free(ttitle);
+   WINDOW_TITLE_COMMAND *cmd = al_malloc(sizeof *cmd);
+
+   if (!cmd)
+      return;
+   cmd->window = win_display->window;
+   cmd->title = _twin_utf8_to_tchar(title);
+   post_window_command(cmd->window, set_window_title_proc, cmd);
 }
 
 bool _al_win_set_window_constraints(ALLEGRO_DISPLAY *display,
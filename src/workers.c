@@ -0,0 +1,216 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Internal worker threads for splitting up large operations.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_atomicops.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_workers.h"
+
+ALLEGRO_DEBUG_CHANNEL("workers")
+
+#define MAX_WORKERS 16
+
+
+/*
+ * Large operations are split up over the default job pool, which is shared
+ * with user code. A parallel run submits one job per extra thread; each job,
+ * and the calling thread, then takes indices from a shared counter until all
+ * are done. The caller only waits for the calls which have started, never
+ * for the jobs themselves: those may sit behind unrelated user jobs, and
+ * whichever start late find no indices left. The run is therefore shared
+ * with the jobs and freed by whoever lets go of it last.
+ */
+
+typedef struct PARALLEL_RUN
+{
+   void (*func)(int index, void *arg);
+   void *arg;
+   int count;
+   volatile _AL_ATOMIC next;
+   volatile _AL_ATOMIC left;  /* calls not finished yet */
+   volatile _AL_ATOMIC refs;  /* jobs holding the run, plus the caller */
+} PARALLEL_RUN;
+
+static ALLEGRO_MUTEX *workers_mutex = NULL;
+static ALLEGRO_JOB_POOL *default_pool = NULL;
+static int num_workers = -1;
+
+/* Signalled whenever the last call of a run finishes. */
+static ALLEGRO_MUTEX *run_mutex = NULL;
+static ALLEGRO_COND *run_cond = NULL;
+
+
+static void shutdown_workers(void)
+{
+   al_destroy_job_pool(default_pool);
+   default_pool = NULL;
+   num_workers = -1;
+
+   al_destroy_cond(run_cond);
+   run_cond = NULL;
+   al_destroy_mutex(run_mutex);
+   run_mutex = NULL;
+   al_destroy_mutex(workers_mutex);
+   workers_mutex = NULL;
+}
+
+
+void _al_init_workers(void)
+{
+   workers_mutex = al_create_mutex();
+   run_mutex = al_create_mutex();
+   run_cond = al_create_cond();
+   _al_add_exit_func(shutdown_workers, "shutdown_workers");
+}
+
+
+/* Must be called with workers_mutex held. */
+static void start_workers(void)
+{
+   int n = al_get_cpu_count() - 1;
+
+   if (n > MAX_WORKERS)
+      n = MAX_WORKERS;
+   if (n < 1)
+      n = 1;
+
+   default_pool = al_create_job_pool(n);
+   num_workers = default_pool ? n : 0;
+   ALLEGRO_INFO("Started %d worker threads\n", num_workers);
+}
+
+
+/* Function: al_get_default_job_pool
+ */
+ALLEGRO_JOB_POOL *al_get_default_job_pool(void)
+{
+   ALLEGRO_JOB_POOL *pool;
+
+   if (!workers_mutex)
+      return NULL;
+
+   al_lock_mutex(workers_mutex);
+   if (num_workers < 0)
+      start_workers();
+   pool = default_pool;
+   al_unlock_mutex(workers_mutex);
+
+   return pool;
+}
+
+
+/* Internal function: _al_get_worker_count
+ *
+ * Returns the number of threads that will work on a job, including the
+ * calling one.
+ */
+int _al_get_worker_count(void)
+{
+   if (al_get_cpu_count() <= 1 || !al_get_default_job_pool())
+      return 1;
+   return num_workers + 1;
+}
+
+
+static void release_run(PARALLEL_RUN *run)
+{
+   if (_al_sub1_and_fetch(&run->refs) == 0)
+      al_free(run);
+}
+
+
+static void run_calls(PARALLEL_RUN *run)
+{
+   int index;
+
+   while ((index = _al_fetch_and_add1(&run->next)) < run->count) {
+      run->func(index, run->arg);
+      if (_al_sub1_and_fetch(&run->left) == 0) {
+         al_lock_mutex(run_mutex);
+         al_broadcast_cond(run_cond);
+         al_unlock_mutex(run_mutex);
+      }
+   }
+}
+
+
+static void *parallel_proc(void *arg)
+{
+   PARALLEL_RUN *run = arg;
+
+   run_calls(run);
+   release_run(run);
+   return NULL;
+}
+
+
+/* Internal function: _al_run_parallel
+ *
+ * Calls func(i, arg) for every i in [0, count), distributed over the worker
+ * threads, and returns once all calls are done.
+ */
+void _al_run_parallel(int count, void (*func)(int index, void *arg), void *arg)
+{
+   ALLEGRO_JOB_POOL *pool;
+   PARALLEL_RUN *run;
+   int num_jobs;
+   int i;
+
+   if (count <= 0)
+      return;
+
+   pool = (count > 1) ? al_get_default_job_pool() : NULL;
+   run = pool ? al_malloc(sizeof *run) : NULL;
+   if (!run) {
+      for (i = 0; i < count; i++)
+         func(i, arg);
+      return;
+   }
+
+   run->func = func;
+   run->arg = arg;
+   run->count = count;
+   run->next = 0;
+   run->left = count;
+   run->refs = 1;
+
+   num_jobs = count - 1;
+   if (num_jobs > num_workers)
+      num_jobs = num_workers;
+   for (i = 0; i < num_jobs; i++) {
+      ALLEGRO_JOB *job;
+
+      _al_fetch_and_add1(&run->refs);
+      job = al_submit_job(pool, parallel_proc, run);
+      if (!job) {
+         _al_sub1_and_fetch(&run->refs);
+         break;
+      }
+      al_release_job(job);
+   }
+
+   run_calls(run);
+
+   al_lock_mutex(run_mutex);
+   while (run->left > 0)
+      al_wait_cond(run_cond, run_mutex);
+   al_unlock_mutex(run_mutex);
+
+   release_run(run);
+}
+
+/* vim: set ts=8 sts=3 sw=3 et: */
@@ -19,6 +19,7 @@
 #include <X11/Xatom.h>
 
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_x.h"
 #include "allegro5/internal/aintern_xclipboard.h"
@@ -35,9 +36,222 @@
 ALLEGRO_DEBUG_CHANNEL("clipboard")
 
 
+/* Reading the clipboard: we ask the selection owner to convert the
+ * selection into a property of our window, and get a SelectionNotify event
+ * once it has. Large selections are sent in pieces with the INCR protocol:
+ * the property is then of type INCR, and each time we delete it the owner
+ * stores the next piece, down to an empty one. All of this happens on the
+ * X11 thread while the transfer is in progress. The pieces are read straight
+ * into the transfer buffer, which becomes the text.
+ */
+
+enum {
+   TRANSFER_NONE,
+   TRANSFER_CONVERTING,    /* waiting for SelectionNotify */
+   TRANSFER_INCR           /* waiting for the next piece */
+};
+
+/* In 32-bit units, as XGetWindowProperty counts them. */
+#define PROPERTY_CHUNK  (64 * 1024)
+
+typedef struct CLIPBOARD_ATOMS {
+   Atom clipboard;
+   Atom utf8_string;
+   Atom targets;
+   Atom incr;
+   Atom property;
+} CLIPBOARD_ATOMS;
+
+static CLIPBOARD_ATOMS atoms;
+
+
+/* get_atoms:
+ *  Atoms stay valid as long as the server runs, so they are only looked
+ *  up once.
+ */
+static CLIPBOARD_ATOMS *get_atoms(Display *xdisplay)
+{
+   if (atoms.clipboard == None) {
+      atoms.utf8_string = XInternAtom(xdisplay, "UTF8_STRING", False);
+      atoms.targets = XInternAtom(xdisplay, "TARGETS", False);
+      atoms.incr = XInternAtom(xdisplay, "INCR", False);
+      atoms.property = XInternAtom(xdisplay, "ALLEGRO_SELECTION", False);
+      atoms.clipboard = XInternAtom(xdisplay, "CLIPBOARD", False);
+   }
+   return &atoms;
+}
+
+
+static void free_transfer(ALLEGRO_DISPLAY_XGLX *glx)
+{
+   al_free(glx->clipboard_buf);
+   glx->clipboard_buf = NULL;
+   glx->clipboard_size = 0;
+   glx->clipboard_capacity = 0;
+   glx->clipboard_transfer = TRANSFER_NONE;
+}
+
+
+static bool reserve_transfer(ALLEGRO_DISPLAY_XGLX *glx, size_t size)
+{
+   char *buf;
+   size_t capacity;
+
+   /* One more for the terminating NUL. */
+   if (size + 1 <= glx->clipboard_capacity)
+      return true;
+
+   capacity = _ALLEGRO_MAX(size + 1, glx->clipboard_capacity * 2);
+   buf = al_realloc(glx->clipboard_buf, capacity);
+   if (!buf) {
+      ALLEGRO_ERROR("Out of memory for %lu bytes of clipboard data.\n",
+         (unsigned long)size);
+      return false;
+   }
+   glx->clipboard_buf = buf;
+   glx->clipboard_capacity = capacity;
+   return true;
+}
+
+
+/* read_property:
+ *  Append the contents of a property to the transfer buffer, and return its
+ *  type. The property is read in pieces, so that Xlib does not hold a
+ *  second copy of all of it. Items of format 32 are appended as longs, as
+ *  Xlib returns them.
+ */
+static Atom read_property(ALLEGRO_DISPLAY_XGLX *glx, Display *xdisplay,
+   Window window, Atom property, bool delete)
+{
+   Atom type = None;
+   int format;
+   unsigned long nitems;
+   unsigned long bytes_after;
+   unsigned char *data;
+   long offset = 0;
+   size_t item_size;
+
+   do {
+      if (XGetWindowProperty(xdisplay, window, property, offset,
+            PROPERTY_CHUNK, False, AnyPropertyType, &type, &format, &nitems,
+            &bytes_after, &data) != Success) {
+         return None;
+      }
+      if (type == None)
+         return None;
+
+      item_size = (format == 8) ? 1 : (format == 16) ? sizeof(short) :
+         sizeof(long);
+      if (!reserve_transfer(glx, glx->clipboard_size + nitems * item_size +
+            bytes_after)) {
+         XFree(data);
+         return None;
+      }
+      memcpy(glx->clipboard_buf + glx->clipboard_size, data,
+         nitems * item_size);
+      glx->clipboard_size += nitems * item_size;
+      XFree(data);
+
+      offset += nitems * format / 32;
+   } while (bytes_after > 0);
+
+   if (delete)
+      XDeleteProperty(xdisplay, window, property);
+   return type;
+}
+
+
+/* finish_transfer:
+ *  Hand the received text to whoever is waiting for it, or NULL if the
+ *  transfer failed. [X11 thread, or with the system locked]
+ */
+static void finish_transfer(ALLEGRO_DISPLAY_XGLX *glx, bool success)
+{
+   char *text = NULL;
+   size_t size = glx->clipboard_size;
+
+   if (success && reserve_transfer(glx, size)) {
+      glx->clipboard_buf[size] = '\0';
+      text = glx->clipboard_buf;
+      glx->clipboard_buf = NULL;
+   }
+   free_transfer(glx);
+
+   if (glx->clipboard_async) {
+      _al_clipboard_text_received(&glx->display, text);
+   }
+   else {
+      glx->clipboard_result = text;
+      glx->clipboard_result_size = size;
+      glx->is_selectioned = true;
+      _al_cond_broadcast(&glx->selectioned);
+   }
+}
+
+
 void _al_xwin_display_selection_notify(ALLEGRO_DISPLAY *display, XSelectionEvent *xselection)
 {
-   (void) display; (void) xselection;
+   ALLEGRO_DISPLAY_XGLX *glx = (void *)display;
+   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   Display *xdisplay = system->x11display;
+   CLIPBOARD_ATOMS *a = get_atoms(xdisplay);
+   Atom type;
+
+   if (glx->clipboard_transfer != TRANSFER_CONVERTING)
+      return;
+
+   if (xselection->property == None) {
+      ALLEGRO_DEBUG("The selection owner could not convert the selection.\n");
+      finish_transfer(glx, false);
+      return;
+   }
+
+   type = read_property(glx, xdisplay, glx->window, xselection->property,
+      true);
+   if (type == a->incr) {
+      /* Deleting the property asks for the first piece. */
+      ALLEGRO_DEBUG("Receiving the selection in pieces.\n");
+      glx->clipboard_size = 0;
+      glx->clipboard_transfer = TRANSFER_INCR;
+      glx->clipboard_time = al_get_time();
+      return;
+   }
+
+   finish_transfer(glx, type != None);
+}
+
+
+void _al_xwin_display_property_notify(ALLEGRO_DISPLAY *display, XPropertyEvent *xproperty)
+{
+   ALLEGRO_DISPLAY_XGLX *glx = (void *)display;
+   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   Display *xdisplay = system->x11display;
+   CLIPBOARD_ATOMS *a = get_atoms(xdisplay);
+   size_t old_size = glx->clipboard_size;
+
+   if (glx->clipboard_transfer != TRANSFER_INCR ||
+         xproperty->atom != a->property ||
+         xproperty->state != PropertyNewValue) {
+      return;
+   }
+
+   if (read_property(glx, xdisplay, glx->window, a->property, true) ==
+         None) {
+      finish_transfer(glx, false);
+      return;
+   }
+
+   /* An empty piece ends the transfer. */
+   if (glx->clipboard_size == old_size) {
+      ALLEGRO_DEBUG("Received %lu bytes of selection.\n",
+         (unsigned long)glx->clipboard_size);
+      finish_transfer(glx, true);
+      return;
+   }
+
+   glx->clipboard_time = al_get_time();
+   if (!glx->clipboard_async)
+      _al_cond_broadcast(&glx->selectioned);
 }
 
 
@@ -93,30 +307,99 @@ void _al_xwin_display_selection_request(ALLEGRO_DISPLAY *display, XSelectionRequ
 }
 
 
-/* Waits for a selection (copy/paste or DND event) */
-static bool _al_display_xglx_await_selection_event(ALLEGRO_DISPLAY *d)
+/* owns_clipboard:
+ *  Returns true if there is no selection owner other than us, in which case
+ *  the text is taken from the cut buffer xdpy_set_clipboard_text fills.
+ */
+static bool owns_clipboard(ALLEGRO_DISPLAY_XGLX *glx, Display *xdisplay)
 {
-   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
-   ALLEGRO_DISPLAY_XGLX *glx = (ALLEGRO_DISPLAY_XGLX *)d;
-   ALLEGRO_TIMEOUT timeout;
+   Window owner = XGetSelectionOwner(xdisplay, get_atoms(xdisplay)->clipboard);
+   return owner == None || owner == glx->window;
+}
 
-   ALLEGRO_DEBUG("Awaiting selection event\n");
 
-   XSync(system->x11display, False);
+/* read_cut_buffer:
+ *  Returns the text of the cut buffer, or NULL. The system must be locked
+ *  and no transfer in progress.
+ */
+static char *read_cut_buffer(ALLEGRO_DISPLAY_XGLX *glx, Display *xdisplay)
+{
+   char *text = NULL;
 
-   /* Wait until the selection event is notified.
-    * Don't wait forever if an event never comes.
-    */
-   al_init_timeout(&timeout, 1.0);
-   if (_al_cond_timedwait(&glx->selectioned, &system->lock, &timeout) == -1) {
-      ALLEGRO_ERROR("Timeout while waiting for selection event.\n");
-      return false;
+   if (read_property(glx, xdisplay, DefaultRootWindow(xdisplay),
+         XA_CUT_BUFFER0, false) == get_atoms(xdisplay)->utf8_string &&
+         reserve_transfer(glx, glx->clipboard_size)) {
+      glx->clipboard_buf[glx->clipboard_size] = '\0';
+      text = glx->clipboard_buf;
+      glx->clipboard_buf = NULL;
+   }
+   free_transfer(glx);
+   return text;
+}
+
+
+/* start_transfer:
+ *  Ask the selection owner for the clipboard converted to target. Returns
+ *  false if another transfer is still in progress. A transfer which has not
+ *  made progress for a second is given up. The system must be locked.
+ */
+static bool start_transfer(ALLEGRO_DISPLAY_XGLX *glx, Display *xdisplay,
+   Atom target, bool async)
+{
+   CLIPBOARD_ATOMS *a = get_atoms(xdisplay);
+
+   if (glx->clipboard_transfer != TRANSFER_NONE) {
+      if (al_get_time() - glx->clipboard_time < 1.0) {
+         ALLEGRO_WARN("Already reading the clipboard.\n");
+         return false;
+      }
+      ALLEGRO_WARN("Giving up the previous clipboard transfer.\n");
+      free_transfer(glx);
    }
 
+   glx->clipboard_transfer = TRANSFER_CONVERTING;
+   glx->clipboard_async = async;
+   glx->clipboard_time = al_get_time();
+   glx->is_selectioned = false;
+   XDeleteProperty(xdisplay, glx->window, a->property);
+   XConvertSelection(xdisplay, a->clipboard, target, a->property,
+      glx->window, CurrentTime);
+   XFlush(xdisplay);
    return true;
 }
 
 
+/* await_transfer:
+ *  Waits until the transfer is done and returns the received data, or NULL,
+ *  and its size in size. The timeout starts over whenever a piece arrives.
+ *  The system must be locked.
+ */
+static char *await_transfer(ALLEGRO_DISPLAY_XGLX *glx,
+   ALLEGRO_SYSTEM_XGLX *system, size_t *size)
+{
+   ALLEGRO_TIMEOUT timeout;
+   char *text;
+
+   ALLEGRO_DEBUG("Awaiting selection event\n");
+
+   while (!glx->is_selectioned) {
+      al_init_timeout(&timeout, 1.0);
+      if (_al_cond_timedwait(&glx->selectioned, &system->lock, &timeout) == -1
+            && !glx->is_selectioned) {
+         ALLEGRO_ERROR("Timeout while waiting for selection event.\n");
+         free_transfer(glx);
+         return NULL;
+      }
+   }
+
+   text = glx->clipboard_result;
+   glx->clipboard_result = NULL;
+   if (size)
+      *size = glx->clipboard_result_size;
+   return text;
+}
+
+
 static bool xdpy_set_clipboard_text(ALLEGRO_DISPLAY *display, const char *text)
 {
 
@@ -159,76 +442,116 @@ static char *xdpy_get_clipboard_text(ALLEGRO_DISPLAY *display)
    ALLEGRO_DISPLAY_XGLX *glx = (void *)display;
    ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
    Display *xdisplay = system->x11display;
-   Window xwindow = glx->window;
-
-   Atom format;
-   Window owner;
-   Atom selection;
-   Atom seln_type;
-   int seln_format;
-   unsigned long nbytes;
-   unsigned long overflow;
-   unsigned char *src;
    char *text = NULL;
 
-   Atom XA_CLIPBOARD = XInternAtom(xdisplay, "CLIPBOARD", 0);
-   if (XA_CLIPBOARD == None) {
-      ALLEGRO_DEBUG("Couldn't access X clipboard");
-      return NULL;
-   }
-
-   /* Get the window that holds the selection */
-   format = XInternAtom(xdisplay, "UTF8_STRING", 0);
-   owner = XGetSelectionOwner(xdisplay, XA_CLIPBOARD);
-   if ((owner == None) || (owner == xwindow)) {
-      owner = DefaultRootWindow(xdisplay);
-      selection = XA_CUT_BUFFER0;
-   } else {
-      /* Request that the selection owner copy the data to our window. */
-      owner = xwindow;
-      selection = XInternAtom(xdisplay, "ALLEGRO_SELECTION", False);
-      XConvertSelection(xdisplay, XA_CLIPBOARD, format, selection, owner,
-                        CurrentTime);
-
-      glx->is_selectioned = false;
-      if (!_al_display_xglx_await_selection_event(display))
-         return NULL;
+   _al_mutex_lock(&system->lock);
+
+   if (owns_clipboard(glx, xdisplay)) {
+      if (glx->clipboard_transfer == TRANSFER_NONE)
+         text = read_cut_buffer(glx, xdisplay);
+   }
+   else if (start_transfer(glx, xdisplay, get_atoms(xdisplay)->utf8_string,
+         false)) {
+      text = await_transfer(glx, system, NULL);
    }
 
-   if (XGetWindowProperty(xdisplay, owner, selection, 0, INT_MAX/4, False,
-                          format, &seln_type, &seln_format, &nbytes, &overflow, &src)
-         == Success) {
-      if (seln_type == format) {
-         text = (char *)al_malloc(nbytes+1);
-         if (text) {
-            memcpy(text, src, nbytes);
-            text[nbytes] = '\0';
-         }
+   _al_mutex_unlock(&system->lock);
+   return text;
+}
+
+
+static bool xdpy_request_clipboard_text(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_DISPLAY_XGLX *glx = (void *)display;
+   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   Display *xdisplay = system->x11display;
+   char *text;
+   bool ok;
+
+   _al_mutex_lock(&system->lock);
+
+   if (owns_clipboard(glx, xdisplay)) {
+      ok = (glx->clipboard_transfer == TRANSFER_NONE);
+      if (ok) {
+         text = read_cut_buffer(glx, xdisplay);
+         _al_mutex_unlock(&system->lock);
+         _al_clipboard_text_received(display, text);
+         return true;
       }
    }
-   XFree(src);
-   return text;
+   else {
+      ok = start_transfer(glx, xdisplay, get_atoms(xdisplay)->utf8_string,
+         true);
+   }
+
+   _al_mutex_unlock(&system->lock);
+   return ok;
 }
 
+
+/* xdpy_has_clipboard_text:
+ *  Only asks the selection owner for the list of targets, rather than for
+ *  all of the text.
+ */
 static bool xdpy_has_clipboard_text(ALLEGRO_DISPLAY *display)
 {
-   char *text = xdpy_get_clipboard_text(display);
-
-   if (!text) {
-      return false;
+   ALLEGRO_DISPLAY_XGLX *glx = (void *)display;
+   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   Display *xdisplay = system->x11display;
+   CLIPBOARD_ATOMS *a = get_atoms(xdisplay);
+   bool has_text = false;
+   char *targets;
+   size_t size;
+   size_t i;
+   Atom type;
+   int format;
+   unsigned long nitems;
+   unsigned long bytes_after;
+   unsigned char *data;
+
+   _al_mutex_lock(&system->lock);
+
+   if (owns_clipboard(glx, xdisplay)) {
+      if (XGetWindowProperty(xdisplay, DefaultRootWindow(xdisplay),
+            XA_CUT_BUFFER0, 0, 0, False, AnyPropertyType, &type, &format,
+            &nitems, &bytes_after, &data) == Success) {
+         has_text = (type == a->utf8_string && bytes_after > 0);
+         XFree(data);
+      }
+   }
+   else if (start_transfer(glx, xdisplay, a->targets, false)) {
+      targets = await_transfer(glx, system, &size);
+      for (i = 0; targets && i < size / sizeof(long); i++) {
+         if (((long *)targets)[i] == (long)a->utf8_string ||
+               ((long *)targets)[i] == (long)XA_STRING) {
+            has_text = true;
+            break;
+         }
+      }
+      al_free(targets);
    }
 
-   al_free(text);
-   return true;
+   _al_mutex_unlock(&system->lock);
+   return has_text;
 }
 
 
+void _al_xwin_destroy_clipboard(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_DISPLAY_XGLX *glx = (void *)display;
+
+   free_transfer(glx);
+   al_free(glx->clipboard_result);
+   glx->clipboard_result = NULL;
+}
+
 
 void _al_xwin_add_clipboard_functions(ALLEGRO_DISPLAY_INTERFACE *vt)
 {
    vt->set_clipboard_text = xdpy_set_clipboard_text;
    vt->get_clipboard_text = xdpy_get_clipboard_text;
    vt->has_clipboard_text = xdpy_has_clipboard_text;
+   vt->request_clipboard_text = xdpy_request_clipboard_text;
 }
 
 
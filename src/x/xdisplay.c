@@ -27,6 +27,7 @@
 ALLEGRO_DEBUG_CHANNEL("display")
 
 static ALLEGRO_DISPLAY_INTERFACE xdpy_vt;
+static ALLEGRO_DISPLAY_INTERFACE xsoft_vt;
 static const ALLEGRO_XWIN_DISPLAY_OVERRIDABLE_INTERFACE default_overridable_vt;
 static const ALLEGRO_XWIN_DISPLAY_OVERRIDABLE_INTERFACE *gtk_override_vt = NULL;
 
@@ -109,9 +110,24 @@ static int xdpy_swap_control(ALLEGRO_DISPLAY *display, int vsync_setting)
     * If the option is set to 0, we simply use the system default. The
     * above extension specifies vsync on as default though, so in the
     * end with GLX we can't force vsync on, just off.
+    * Adaptive vsync needs an interval of -1, which only
+    * GLX_EXT_swap_control_tear allows.
     */
    ALLEGRO_DEBUG("requested vsync=%d.\n", vsync_setting);
 
+   if (vsync_setting == 3) {
+      ALLEGRO_OGL_EXT_LIST *ext = display->ogl_extras->extension_list;
+      if (ext->ALLEGRO_GLX_EXT_swap_control &&
+            ext->ALLEGRO_GLX_EXT_swap_control_tear) {
+         ALLEGRO_SYSTEM_XGLX *system =
+            (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
+         glXSwapIntervalEXT(system->gfxdisplay, glXGetCurrentDrawable(), -1);
+         return vsync_setting;
+      }
+      ALLEGRO_WARN("no adaptive vsync, GLX_EXT_swap_control_tear missing.\n");
+      vsync_setting = 1;
+   }
+
    if (vsync_setting) {
       if (display->ogl_extras->extension_list->ALLEGRO_GLX_SGI_swap_control) {
          int x = (vsync_setting == 2) ? 0 : 1;
@@ -296,29 +312,100 @@ static bool xdpy_create_display_window(ALLEGRO_SYSTEM_XGLX *system,
 }
 
 
+/* Creates the GLX context of a new display and makes it current. */
+static bool xdpy_create_context(ALLEGRO_SYSTEM_XGLX *system,
+   ALLEGRO_DISPLAY_XGLX *d)
+{
+   ALLEGRO_DISPLAY *display = (ALLEGRO_DISPLAY *)d;
+   ALLEGRO_OGL_EXTRAS *ogl = display->ogl_extras;
+
+   if (!_al_xglx_config_create_context(d)) {
+      return false;
+   }
+
+   /* Make our GLX context current for reading and writing in the current
+    * thread.
+    */
+   if (d->fbc) {
+      if (!glXMakeContextCurrent(system->gfxdisplay, d->glxwindow,
+            d->glxwindow, d->context)) {
+         ALLEGRO_ERROR("glXMakeContextCurrent failed\n");
+      }
+   }
+   else {
+      if (!glXMakeCurrent(system->gfxdisplay, d->glxwindow, d->context)) {
+         ALLEGRO_ERROR("glXMakeCurrent failed\n");
+      }
+   }
+
+   _al_ogl_manage_extensions(display);
+   _al_ogl_set_extensions(ogl->extension_api);
+
+   /* Print out OpenGL version info */
+   ALLEGRO_INFO("OpenGL Version: %s\n", (const char*)glGetString(GL_VERSION));
+   ALLEGRO_INFO("Vendor: %s\n", (const char*)glGetString(GL_VENDOR));
+   ALLEGRO_INFO("Renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+
+   /* Fill in opengl version */
+   const int v = display->ogl_extras->ogl_info.version;
+   display->extra_settings.settings[ALLEGRO_OPENGL_MAJOR_VERSION] = (v >> 24) & 0xFF;
+   display->extra_settings.settings[ALLEGRO_OPENGL_MINOR_VERSION] = (v >> 16) & 0xFF;
+
+   if (display->ogl_extras->ogl_info.version < _ALLEGRO_OPENGL_VERSION_1_2) {
+      ALLEGRO_EXTRA_DISPLAY_SETTINGS *eds = _al_get_new_display_settings();
+      if (eds->required & (1<<ALLEGRO_COMPATIBLE_DISPLAY)) {
+         ALLEGRO_ERROR("Allegro requires at least OpenGL version 1.2 to work.\n");
+         return false;
+      }
+      display->extra_settings.settings[ALLEGRO_COMPATIBLE_DISPLAY] = 0;
+   }
+
+   if (display->extra_settings.settings[ALLEGRO_COMPATIBLE_DISPLAY])
+      _al_ogl_setup_gl(display);
+
+   /* vsync */
+   int vsync_setting = _al_get_new_display_settings()->settings[ALLEGRO_VSYNC];
+   vsync_setting = xdpy_swap_control(display, vsync_setting);
+   display->extra_settings.settings[ALLEGRO_VSYNC] = vsync_setting;
+
+   return true;
+}
+
+
 static ALLEGRO_DISPLAY_XGLX *xdpy_create_display_locked(
-   ALLEGRO_SYSTEM_XGLX *system, int flags, int w, int h, int adapter)
+   ALLEGRO_SYSTEM_XGLX *system, int flags, int w, int h, int adapter,
+   bool software)
 {
    ALLEGRO_DISPLAY_XGLX *d = al_calloc(1, sizeof *d);
    ALLEGRO_DISPLAY *display = (ALLEGRO_DISPLAY *)d;
-   ALLEGRO_OGL_EXTRAS *ogl = al_calloc(1, sizeof *ogl);
-   display->ogl_extras = ogl;
-
-   d->glx_version = query_glx_version(system);
+   ALLEGRO_OGL_EXTRAS *ogl = NULL;
 
    display->w = w;
    display->h = h;
-   display->vt = _al_display_xglx_driver();
    display->refresh_rate = al_get_new_display_refresh_rate();
    display->flags = flags;
-   // FIXME: default? Is this the right place to set this?
-   display->flags |= ALLEGRO_OPENGL;
+   d->software = software;
+
+   if (software) {
+      display->vt = _al_display_xsoft_driver();
+      display->flags &= ~(ALLEGRO_OPENGL | ALLEGRO_OPENGL_3_0 |
+         ALLEGRO_OPENGL_FORWARD_COMPATIBLE | ALLEGRO_OPENGL_ES_PROFILE |
+         ALLEGRO_OPENGL_CORE_PROFILE);
+   }
+   else {
+      ogl = al_calloc(1, sizeof *ogl);
+      display->ogl_extras = ogl;
+      d->glx_version = query_glx_version(system);
+      display->vt = _al_display_xglx_driver();
+      // FIXME: default? Is this the right place to set this?
+      display->flags |= ALLEGRO_OPENGL;
 #ifdef ALLEGRO_CFG_OPENGLES2
-   display->flags |= ALLEGRO_PROGRAMMABLE_PIPELINE;
+      display->flags |= ALLEGRO_PROGRAMMABLE_PIPELINE;
 #endif
 #ifdef ALLEGRO_CFG_OPENGLES
-   display->flags |= ALLEGRO_OPENGL_ES_PROFILE;
+      display->flags |= ALLEGRO_OPENGL_ES_PROFILE;
 #endif
+   }
 
    /* Store our initial virtual adapter, used by fullscreen and positioning
     * code.
@@ -353,7 +440,10 @@ static ALLEGRO_DISPLAY_XGLX *xdpy_create_display_locked(
    d->resize_count = 0;
    d->programmatic_resize = false;
 
-   _al_xglx_config_select_visual(d);
+   if (software)
+      _al_xsoft_select_visual(d);
+   else
+      _al_xglx_config_select_visual(d);
 
    if (!d->xvinfo) {
       ALLEGRO_ERROR("FIXME: Need better visual selection.\n");
@@ -461,54 +551,17 @@ static ALLEGRO_DISPLAY_XGLX *xdpy_create_display_locked(
       _al_xwin_maximize(display, true);
    }
 
-   if (!_al_xglx_config_create_context(d)) {
-      goto LateError;
-   }
-
-   /* Make our GLX context current for reading and writing in the current
-    * thread.
-    */
-   if (d->fbc) {
-      if (!glXMakeContextCurrent(system->gfxdisplay, d->glxwindow,
-            d->glxwindow, d->context)) {
-         ALLEGRO_ERROR("glXMakeContextCurrent failed\n");
-      }
-   }
-   else {
-      if (!glXMakeCurrent(system->gfxdisplay, d->glxwindow, d->context)) {
-         ALLEGRO_ERROR("glXMakeCurrent failed\n");
-      }
-   }
-
-   _al_ogl_manage_extensions(display);
-   _al_ogl_set_extensions(ogl->extension_api);
-
-   /* Print out OpenGL version info */
-   ALLEGRO_INFO("OpenGL Version: %s\n", (const char*)glGetString(GL_VERSION));
-   ALLEGRO_INFO("Vendor: %s\n", (const char*)glGetString(GL_VENDOR));
-   ALLEGRO_INFO("Renderer: %s\n", (const char*)glGetString(GL_RENDERER));
-
-   /* Fill in opengl version */
-   const int v = display->ogl_extras->ogl_info.version;
-   display->extra_settings.settings[ALLEGRO_OPENGL_MAJOR_VERSION] = (v >> 24) & 0xFF;
-   display->extra_settings.settings[ALLEGRO_OPENGL_MINOR_VERSION] = (v >> 16) & 0xFF;
-
-   if (display->ogl_extras->ogl_info.version < _ALLEGRO_OPENGL_VERSION_1_2) {
-      ALLEGRO_EXTRA_DISPLAY_SETTINGS *eds = _al_get_new_display_settings();
-      if (eds->required & (1<<ALLEGRO_COMPATIBLE_DISPLAY)) {
-         ALLEGRO_ERROR("Allegro requires at least OpenGL version 1.2 to work.\n");
+   if (software) {
+      if (!_al_xsoft_create_backbuffer(d)) {
          goto LateError;
       }
-      display->extra_settings.settings[ALLEGRO_COMPATIBLE_DISPLAY] = 0;
+      display->extra_settings.settings[ALLEGRO_COMPATIBLE_DISPLAY] = 1;
+      display->extra_settings.settings[ALLEGRO_RENDER_METHOD] = 0;
+      display->extra_settings.settings[ALLEGRO_VSYNC] = 2;
+   }
+   else if (!xdpy_create_context(system, d)) {
+      goto LateError;
    }
-
-   if (display->extra_settings.settings[ALLEGRO_COMPATIBLE_DISPLAY])
-      _al_ogl_setup_gl(display);
-
-   /* vsync */
-   int vsync_setting = _al_get_new_display_settings()->settings[ALLEGRO_VSYNC];
-   vsync_setting = xdpy_swap_control(display, vsync_setting);
-   display->extra_settings.settings[ALLEGRO_VSYNC] = vsync_setting;
 
    d->invisible_cursor = None; /* Will be created on demand. */
    d->current_cursor = None; /* Initially, we use the root cursor. */
@@ -578,8 +631,7 @@ static bool xdpy_create_display_hook_default(ALLEGRO_DISPLAY *display,
 }
 
 
-/* Create a new X11 display, which maps directly to a GLX window. */
-static ALLEGRO_DISPLAY *xdpy_create_display(int w, int h)
+static ALLEGRO_DISPLAY *create_display(int w, int h, bool software)
 {
    ALLEGRO_SYSTEM_XGLX *system = (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
    ALLEGRO_DISPLAY_XGLX *display;
@@ -607,11 +659,16 @@ static ALLEGRO_DISPLAY *xdpy_create_display(int w, int h)
          return NULL;
       }
    }
+   if (software && (flags & ALLEGRO_PROGRAMMABLE_PIPELINE)) {
+      ALLEGRO_ERROR("The software driver has no programmable pipeline\n");
+      return NULL;
+   }
 
    _al_mutex_lock(&system->lock);
 
    adapter = al_get_new_display_adapter();
-   display = xdpy_create_display_locked(system, flags, w, h, adapter);
+   display = xdpy_create_display_locked(system, flags, w, h, adapter,
+      software);
 
    _al_mutex_unlock(&system->lock);
 
@@ -619,6 +676,20 @@ static ALLEGRO_DISPLAY *xdpy_create_display(int w, int h)
 }
 
 
+/* Create a new X11 display, which maps directly to a GLX window. */
+static ALLEGRO_DISPLAY *xdpy_create_display(int w, int h)
+{
+   return create_display(w, h, false);
+}
+
+
+/* Create a new X11 display without a GLX context, see xsoftware.c. */
+static ALLEGRO_DISPLAY *xsoft_create_display(int w, int h)
+{
+   return create_display(w, h, true);
+}
+
+
 static void convert_display_bitmaps_to_memory_bitmap(ALLEGRO_DISPLAY *d)
 {
    ALLEGRO_DEBUG("converting display bitmaps to memory bitmaps.\n");
@@ -751,13 +822,21 @@ static void xdpy_destroy_display(ALLEGRO_DISPLAY *d)
    else
       transfer_display_bitmaps_to_any_other_display(s, d);
 
-   _al_ogl_unmanage_extensions(d);
-   ALLEGRO_DEBUG("unmanaged extensions.\n");
+   if (!glx->software) {
+      _al_ogl_destroy_upload_contexts(d);
+
+      _al_ogl_unmanage_extensions(d);
+      ALLEGRO_DEBUG("unmanaged extensions.\n");
+   }
 
    _al_mutex_lock(&s->lock);
    _al_vector_find_and_delete(&s->system.displays, &d);
+   _al_xwin_destroy_clipboard(d);
 
-   if (ogl->backbuffer) {
+   if (glx->software) {
+      _al_xsoft_destroy_backbuffer(glx);
+   }
+   else if (ogl->backbuffer) {
       _al_ogl_destroy_backbuffer(ogl->backbuffer);
       ogl->backbuffer = NULL;
       ALLEGRO_DEBUG("destroy backbuffer.\n");
@@ -825,6 +904,27 @@ static void xdpy_unset_current_display(ALLEGRO_DISPLAY *d)
 }
 
 
+static void *xdpy_create_upload_context(ALLEGRO_DISPLAY *d)
+{
+   return _al_xglx_config_create_upload_context((ALLEGRO_DISPLAY_XGLX *)d);
+}
+
+
+static bool xdpy_make_upload_context_current(ALLEGRO_DISPLAY *d,
+   void *context)
+{
+   (void)d;
+   return _al_xglx_config_make_upload_context_current(context);
+}
+
+
+static void xdpy_destroy_upload_context(ALLEGRO_DISPLAY *d, void *context)
+{
+   (void)d;
+   _al_xglx_config_destroy_upload_context(context);
+}
+
+
 static void xdpy_flip_display(ALLEGRO_DISPLAY *d)
 {
    ALLEGRO_SYSTEM_XGLX *system = (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
@@ -884,6 +984,9 @@ static bool xdpy_acknowledge_resize(ALLEGRO_DISPLAY *d)
       if (glx->context) {
          _al_ogl_setup_gl(d);
       }
+      else if (glx->software) {
+         _al_xsoft_resize_backbuffer(glx);
+      }
 
       _al_xwin_check_maximized(d);
    }
@@ -901,7 +1004,8 @@ static bool xdpy_acknowledge_resize(ALLEGRO_DISPLAY *d)
 void _al_display_xglx_await_resize(ALLEGRO_DISPLAY *d, int old_resize_count,
    bool delay_hack)
 {
-   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   ALLEGRO_SYSTEM_XGLX *system =
+            (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
    ALLEGRO_DISPLAY_XGLX *glx = (ALLEGRO_DISPLAY_XGLX *)d;
    ALLEGRO_TIMEOUT timeout;
 
@@ -1215,7 +1319,8 @@ static void xdpy_set_window_position_default(ALLEGRO_DISPLAY *display,
    int x, int y)
 {
    ALLEGRO_DISPLAY_XGLX *glx = (ALLEGRO_DISPLAY_XGLX *)display;
-   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   ALLEGRO_SYSTEM_XGLX *system =
+            (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
    Window root, parent, child, *children;
    unsigned int n;
 
@@ -1324,7 +1429,8 @@ static void xdpy_apply_window_constraints(ALLEGRO_DISPLAY *display,
 
 static void xdpy_set_fullscreen_window_default(ALLEGRO_DISPLAY *display, bool onoff)
 {
-   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   ALLEGRO_SYSTEM_XGLX *system =
+            (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
    if (onoff == !(display->flags & ALLEGRO_FULLSCREEN_WINDOW)) {
       _al_mutex_lock(&system->lock);
       _al_xwin_reset_size_hints(display);
@@ -1410,7 +1516,11 @@ ALLEGRO_DISPLAY_INTERFACE *_al_display_xglx_driver(void)
    xdpy_vt.apply_window_constraints = xdpy_apply_window_constraints;
    xdpy_vt.set_display_flag = xdpy_set_display_flag;
    xdpy_vt.wait_for_vsync = xdpy_wait_for_vsync;
+   xdpy_vt.wait_for_vblank = xdpy_wait_for_vsync;
    xdpy_vt.update_render_state = _al_ogl_update_render_state;
+   xdpy_vt.create_upload_context = xdpy_create_upload_context;
+   xdpy_vt.make_upload_context_current = xdpy_make_upload_context_current;
+   xdpy_vt.destroy_upload_context = xdpy_destroy_upload_context;
 
    _al_xwin_add_cursor_functions(&xdpy_vt);
    _al_xwin_add_clipboard_functions(&xdpy_vt);
@@ -1420,6 +1530,74 @@ ALLEGRO_DISPLAY_INTERFACE *_al_display_xglx_driver(void)
 }
 
 
+static bool xsoft_set_current_display(ALLEGRO_DISPLAY *d)
+{
+   /* There is no context to make current. */
+   (void)d;
+   return true;
+}
+
+
+static void xsoft_unset_current_display(ALLEGRO_DISPLAY *d)
+{
+   (void)d;
+}
+
+
+static void xsoft_update_transformation(ALLEGRO_DISPLAY *d,
+   ALLEGRO_BITMAP *target)
+{
+   /* The software routines read the bitmap's transformation directly. */
+   (void)d;
+   (void)target;
+}
+
+
+static void xsoft_flush_vertex_cache(ALLEGRO_DISPLAY *d)
+{
+   /* Held drawing goes straight to the backbuffer. */
+   (void)d;
+}
+
+
+/* Obtain a reference to the software driver. It shares the window handling
+ * with the GLX driver, but renders with the memory bitmap routines into a
+ * backbuffer that is presented with MIT-SHM.
+ */
+ALLEGRO_DISPLAY_INTERFACE *_al_display_xsoft_driver(void)
+{
+   if (xsoft_vt.create_display)
+      return &xsoft_vt;
+
+   xsoft_vt.create_display = xsoft_create_display;
+   xsoft_vt.destroy_display = xdpy_destroy_display;
+   xsoft_vt.set_current_display = xsoft_set_current_display;
+   xsoft_vt.unset_current_display = xsoft_unset_current_display;
+   xsoft_vt.flip_display = _al_xsoft_flip_display;
+   xsoft_vt.update_display_region = _al_xsoft_update_display_region;
+   xsoft_vt.flip_display_regions = _al_xsoft_flip_display_regions;
+   xsoft_vt.acknowledge_resize = xdpy_acknowledge_resize;
+   xsoft_vt.get_backbuffer = _al_xsoft_get_backbuffer;
+   xsoft_vt.is_compatible_bitmap = xdpy_is_compatible_bitmap;
+   xsoft_vt.resize_display = xdpy_resize_display;
+   xsoft_vt.set_icons = _al_xwin_set_icons;
+   xsoft_vt.set_window_title = xdpy_set_window_title;
+   xsoft_vt.set_window_position = xdpy_set_window_position;
+   xsoft_vt.get_window_position = xdpy_get_window_position;
+   xsoft_vt.set_window_constraints = xdpy_set_window_constraints;
+   xsoft_vt.get_window_constraints = xdpy_get_window_constraints;
+   xsoft_vt.apply_window_constraints = xdpy_apply_window_constraints;
+   xsoft_vt.set_display_flag = xdpy_set_display_flag;
+   xsoft_vt.update_transformation = xsoft_update_transformation;
+   xsoft_vt.flush_vertex_cache = xsoft_flush_vertex_cache;
+
+   _al_xwin_add_cursor_functions(&xsoft_vt);
+   _al_xwin_add_clipboard_functions(&xsoft_vt);
+
+   return &xsoft_vt;
+}
+
+
 static const ALLEGRO_XWIN_DISPLAY_OVERRIDABLE_INTERFACE default_overridable_vt =
 {
    xdpy_create_display_hook_default,
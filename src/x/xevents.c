@@ -39,6 +39,30 @@ void _al_display_xglx_closebutton(ALLEGRO_DISPLAY *d, XEvent *xevent)
    _al_event_source_unlock(es);
 }
 
+/* _al_xwin_event_time:
+ *  Convert the time of an X input event, in milliseconds of the server's
+ *  clock, to al_get_time() terms. The X.Org server uses the monotonic clock
+ *  like we do; if the server's clock is a different one the result is
+ *  nonsense, which _al_event_source_input_time recognises.
+ */
+double _al_xwin_event_time(Time time)
+{
+#ifdef ALLEGRO_UNIX_MONOTONIC_CLOCK
+   struct timespec ts;
+   uint32_t now_ms;
+   int32_t age_ms;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   now_ms = (uint32_t)ts.tv_sec * 1000 + (uint32_t)(ts.tv_nsec / 1000000);
+   /* Server times are 32 bits, and wrap around every 49.7 days. */
+   age_ms = (int32_t)(now_ms - (uint32_t)time);
+   return al_get_time() - age_ms / 1000.0;
+#else
+   (void)time;
+   return al_get_time();
+#endif
+}
+
 static void process_x11_event(ALLEGRO_SYSTEM_XGLX *s, XEvent event)
 {
    unsigned int i;
@@ -69,15 +93,16 @@ static void process_x11_event(ALLEGRO_SYSTEM_XGLX *s, XEvent event)
          break;
       case MotionNotify:
          _al_xwin_mouse_motion_notify_handler(
-            event.xmotion.x, event.xmotion.y, &d->display);
+            event.xmotion.x, event.xmotion.y, event.xmotion.time,
+            &d->display);
          break;
       case ButtonPress:
          _al_xwin_mouse_button_press_handler(event.xbutton.button,
-            &d->display);
+            event.xbutton.time, &d->display);
          break;
       case ButtonRelease:
          _al_xwin_mouse_button_release_handler(event.xbutton.button,
-            &d->display);
+            event.xbutton.time, &d->display);
          break;
       case ClientMessage:
          if (event.xclient.message_type == s->AllegroAtom) {
@@ -162,8 +187,10 @@ static void process_x11_event(ALLEGRO_SYSTEM_XGLX *s, XEvent event)
 
       case SelectionNotify:
         _al_xwin_display_selection_notify(&d->display, &event.xselection);
-        d->is_selectioned = true;
-        _al_cond_signal(&d->selectioned);
+        break;
+
+      case PropertyNotify:
+        _al_xwin_display_property_notify(&d->display, &event.xproperty);
         break;
 
       case SelectionRequest:
@@ -178,11 +205,47 @@ static void process_x11_event(ALLEGRO_SYSTEM_XGLX *s, XEvent event)
    }
 }
 
+/* Returns true if the next queued event makes this one redundant, so that
+ * a fast mouse or a window being dragged to a new size doesn't flood the
+ * queues. Only a MotionNotify or ConfigureNotify directly followed by the
+ * same kind of event for the same window is dropped. The mouse deltas are
+ * relative to the last position we reported, so the later event carries
+ * the accumulated movement. [X11 thread]
+ */
+static bool is_superseded(ALLEGRO_SYSTEM_XGLX *s, XEvent *event,
+   bool coalesce_motion)
+{
+   XEvent next;
+
+   if (event->type == MotionNotify) {
+      if (!coalesce_motion)
+         return false;
+   }
+   else if (event->type != ConfigureNotify) {
+      return false;
+   }
+
+   if (XEventsQueued(s->x11display, QueuedAlready) == 0)
+      return false;
+   XPeekEvent(s->x11display, &next);
+
+   if (next.type != event->type || next.xany.window != event->xany.window)
+      return false;
+   /* See _al_xglx_display_configure_event for why send_event matters. */
+   if (event->type == ConfigureNotify &&
+         next.xconfigure.send_event != event->xconfigure.send_event)
+      return false;
+   return true;
+}
+
 void _al_xwin_background_thread(_AL_THREAD *self, void *arg)
 {
    ALLEGRO_SYSTEM_XGLX *s = arg;
    XEvent event;
    double last_reset_screensaver_time = 0.0;
+   const char *value = al_get_config_value(al_get_system_config(), "x11",
+      "coalesce_mouse_motion");
+   bool coalesce_motion = value && strcmp(value, "true") == 0;
 
    while (!_al_get_thread_should_stop(self)) {
       /* Note:
@@ -212,8 +275,10 @@ void _al_xwin_background_thread(_AL_THREAD *self, void *arg)
 
       while (XEventsQueued(s->x11display, QueuedAfterFlush)) {
          XNextEvent(s->x11display, &event);
-         process_x11_event(s, event);
+         if (!is_superseded(s, &event, coalesce_motion))
+            process_x11_event(s, event);
       }
+      _al_x_end_touch_frame();
 
       /* The Xlib manual is particularly useless about the XResetScreenSaver()
        * function.  Nevertheless, this does seem to work to inhibit the native
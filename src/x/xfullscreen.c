@@ -765,6 +765,8 @@ void _al_xsys_mmon_exit(ALLEGRO_SYSTEM_XGLX *s)
 
 int _al_xglx_get_num_display_modes(ALLEGRO_SYSTEM_XGLX *s, int adapter)
 {
+   int n;
+
    if (!init_mmon_interface(s))
       return 0;
 
@@ -778,7 +780,11 @@ int _al_xglx_get_num_display_modes(ALLEGRO_SYSTEM_XGLX *s, int adapter)
       return 1;
    }
 
-   return _al_xglx_mmon_interface.get_num_display_modes(s, adapter);
+   /* The background thread may query XRandR again at any time. */
+   _al_mutex_lock(&s->lock);
+   n = _al_xglx_mmon_interface.get_num_display_modes(s, adapter);
+   _al_mutex_unlock(&s->lock);
+   return n;
 }
 
 ALLEGRO_DISPLAY_MODE *_al_xglx_get_display_mode(ALLEGRO_SYSTEM_XGLX *s, int adapter, int index,
@@ -798,7 +804,10 @@ ALLEGRO_DISPLAY_MODE *_al_xglx_get_display_mode(ALLEGRO_SYSTEM_XGLX *s, int adap
       return NULL;
    }
 
-   return _al_xglx_mmon_interface.get_display_mode(s, adapter, index, mode);
+   _al_mutex_lock(&s->lock);
+   mode = _al_xglx_mmon_interface.get_display_mode(s, adapter, index, mode);
+   _al_mutex_unlock(&s->lock);
+   return mode;
 }
 
 int _al_xglx_fullscreen_select_mode(ALLEGRO_SYSTEM_XGLX *s, int adapter, int w, int h, int format, int refresh_rate)
@@ -913,6 +922,8 @@ void _al_xglx_get_display_offset(ALLEGRO_SYSTEM_XGLX *s, int adapter, int *x, in
 
 bool _al_xglx_get_monitor_info(ALLEGRO_SYSTEM_XGLX *s, int adapter, ALLEGRO_MONITOR_INFO *info)
 {
+   bool ret;
+
    if (!init_mmon_interface(s))
       return false;
 
@@ -926,18 +937,26 @@ bool _al_xglx_get_monitor_info(ALLEGRO_SYSTEM_XGLX *s, int adapter, ALLEGRO_MONI
       return true;
    }
 
-   return _al_xglx_mmon_interface.get_monitor_info(s, adapter, info);
+   _al_mutex_lock(&s->lock);
+   ret = _al_xglx_mmon_interface.get_monitor_info(s, adapter, info);
+   _al_mutex_unlock(&s->lock);
+   return ret;
 }
 
 int _al_xglx_get_num_video_adapters(ALLEGRO_SYSTEM_XGLX *s)
 {
+   int n;
+
    if (!init_mmon_interface(s))
       return 0;
 
    if (!_al_xglx_mmon_interface.get_num_adapters)
       return 1;
 
-   return _al_xglx_mmon_interface.get_num_adapters(s);
+   _al_mutex_lock(&s->lock);
+   n = _al_xglx_mmon_interface.get_num_adapters(s);
+   _al_mutex_unlock(&s->lock);
+   return n;
 }
 
 int _al_xglx_get_default_adapter(ALLEGRO_SYSTEM_XGLX *s)
@@ -90,6 +90,7 @@ static ALLEGRO_EXTRA_DISPLAY_SETTINGS* read_fbconfig(Display *dpy,
 {
    int render_type, visual_type, buffer_size, sbuffers, samples;
    int drawable_type, renderable, swap_method, double_buffer;
+   int srgb_capable;
    ALLEGRO_EXTRA_DISPLAY_SETTINGS *eds;
    XVisualInfo *v;
 
@@ -168,6 +169,12 @@ static ALLEGRO_EXTRA_DISPLAY_SETTINGS* read_fbconfig(Display *dpy,
 
    eds->settings[ALLEGRO_FLOAT_COLOR] = (render_type & GLX_RGBA_FLOAT_BIT_ARB);
 
+   /* Unknown without GLX_EXT_framebuffer_sRGB. */
+   if (glXGetFBConfigAttrib(dpy, fbc, GLX_FRAMEBUFFER_SRGB_CAPABLE_EXT,
+         &srgb_capable))
+      srgb_capable = 0;
+   eds->settings[ALLEGRO_SRGB_FRAMEBUFFER] = (srgb_capable != 0);
+
    v = glXGetVisualFromFBConfig(dpy, fbc);
    if (!v) {
       ALLEGRO_DEBUG("Cannot get associated visual for the FBConfig.\n");
@@ -324,6 +331,7 @@ static ALLEGRO_EXTRA_DISPLAY_SETTINGS* read_xvisual(Display *dpy,
 
    eds->settings[ALLEGRO_FLOAT_COLOR] = 0;
    eds->settings[ALLEGRO_FLOAT_DEPTH] = 0;
+   eds->settings[ALLEGRO_SRGB_FRAMEBUFFER] = 0;
 
    if (glXGetConfig(dpy, v, GLX_SAMPLE_BUFFERS, &sbuffers) == GLX_BAD_ATTRIBUTE) {
       /* Multisample extension is not supported */
@@ -526,6 +534,41 @@ static GLXContext create_context_new(int ver, Display *dpy, GLXFBConfig fb,
    return _xglx_glXCreateContextAttribsARB(dpy, fb, ctx, True, attrib);
 }
 
+/* Creates a context from the display's FBC, with the version requested
+ * for the display.
+ */
+static GLXContext create_fbc_context(ALLEGRO_DISPLAY_XGLX *glx,
+   GLXContext share)
+{
+   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   ALLEGRO_DISPLAY *disp = (void*)glx;
+   bool forward_compat = (disp->flags & ALLEGRO_OPENGL_FORWARD_COMPATIBLE) != 0;
+   bool core_profile = (disp->flags & ALLEGRO_OPENGL_CORE_PROFILE) != 0;
+   int major = glx->context_major;
+   int minor = glx->context_minor;
+
+   if (disp->flags & ALLEGRO_OPENGL_ES_PROFILE) {
+      if (major == 0)
+         major = 2;
+      return create_context_new(glx->glx_version,
+         system->gfxdisplay, *glx->fbc, share, forward_compat,
+         true, core_profile, major, minor);
+   }
+   else if ((disp->flags & ALLEGRO_OPENGL_3_0) || major != 0 || core_profile) {
+      if (major == 0)
+         major = 3;
+      if (core_profile && major == 3 && minor < 2) // core profile requires at least 3.2
+         minor = 2;
+      return create_context_new(glx->glx_version,
+         system->gfxdisplay, *glx->fbc, share, forward_compat,
+            false, core_profile, major, minor);
+   }
+   else {
+      return glXCreateNewContext(system->gfxdisplay, *glx->fbc,
+         GLX_RGBA_TYPE, share, True);
+   }
+}
+
 bool _al_xglx_config_create_context(ALLEGRO_DISPLAY_XGLX *glx)
 {
    ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
@@ -540,28 +583,17 @@ bool _al_xglx_config_create_context(ALLEGRO_DISPLAY_XGLX *glx)
          existing_ctx = (*existing_dpy)->context;
    }
 
-   int major = al_get_new_display_option(ALLEGRO_OPENGL_MAJOR_VERSION, 0);
-   int minor = al_get_new_display_option(ALLEGRO_OPENGL_MINOR_VERSION, 0);
+   glx->context_major = al_get_new_display_option(ALLEGRO_OPENGL_MAJOR_VERSION, 0);
+   glx->context_minor = al_get_new_display_option(ALLEGRO_OPENGL_MINOR_VERSION, 0);
 
    if (glx->fbc) {
       bool forward_compat = (disp->flags & ALLEGRO_OPENGL_FORWARD_COMPATIBLE) != 0;
       bool core_profile = (disp->flags & ALLEGRO_OPENGL_CORE_PROFILE) != 0;
       /* Create a GLX context from FBC. */
-      if (disp->flags & ALLEGRO_OPENGL_ES_PROFILE) {
-         if (major == 0)
-            major = 2;
-         glx->context = create_context_new(glx->glx_version,
-            system->gfxdisplay, *glx->fbc, existing_ctx, forward_compat,
-            true, core_profile, major, minor);
-      }
-      else if ((disp->flags & ALLEGRO_OPENGL_3_0) || major != 0 || core_profile) {
-         if (major == 0)
-            major = 3;
-         if (core_profile && major == 3 && minor < 2) // core profile requires at least 3.2
-            minor = 2;
-         glx->context = create_context_new(glx->glx_version,
-            system->gfxdisplay, *glx->fbc, existing_ctx, forward_compat,
-               false, core_profile, major, minor);
+      glx->context = create_fbc_context(glx, existing_ctx);
+      if (!(disp->flags & ALLEGRO_OPENGL_ES_PROFILE) &&
+            ((disp->flags & ALLEGRO_OPENGL_3_0) || glx->context_major != 0 ||
+             core_profile)) {
          /* TODO: Right now Allegro's own OpenGL driver only works with a 3.0+
           * context when using the programmable pipeline, for some reason. All
           * that's missing is probably a default shader though.
@@ -570,10 +602,6 @@ bool _al_xglx_config_create_context(ALLEGRO_DISPLAY_XGLX *glx)
          if (forward_compat && !(disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE))
             disp->extra_settings.settings[ALLEGRO_COMPATIBLE_DISPLAY] = 0;
       }
-      else {
-         glx->context = glXCreateNewContext(system->gfxdisplay, *glx->fbc,
-            GLX_RGBA_TYPE, existing_ctx, True);
-      }
 
       /* Create a GLX subwindow inside our window. */
       glx->glxwindow = glXCreateWindow(system->gfxdisplay, *glx->fbc,
@@ -596,3 +624,70 @@ bool _al_xglx_config_create_context(ALLEGRO_DISPLAY_XGLX *glx)
    ALLEGRO_DEBUG("Got GLX context.\n");
    return true;
 }
+
+/* A context sharing the display's objects, made current on a 1x1 pbuffer
+ * since the window belongs to the display's own context.
+ */
+typedef struct XGLX_UPLOAD_CONTEXT
+{
+   GLXContext context;
+   GLXPbuffer pbuffer;
+} XGLX_UPLOAD_CONTEXT;
+
+void *_al_xglx_config_create_upload_context(ALLEGRO_DISPLAY_XGLX *glx)
+{
+   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   const int attrib[] = {GLX_PBUFFER_WIDTH, 1, GLX_PBUFFER_HEIGHT, 1, None};
+   XGLX_UPLOAD_CONTEXT *uc;
+   int drawable_type = 0;
+
+   if (!glx->fbc) {
+      ALLEGRO_WARN("Upload contexts need GLX 1.3.\n");
+      return NULL;
+   }
+   glXGetFBConfigAttrib(system->gfxdisplay, *glx->fbc, GLX_DRAWABLE_TYPE,
+      &drawable_type);
+   if (!(drawable_type & GLX_PBUFFER_BIT)) {
+      ALLEGRO_WARN("The display's FBConfig does not support pbuffers.\n");
+      return NULL;
+   }
+
+   uc = al_calloc(1, sizeof(*uc));
+   if (!uc)
+      return NULL;
+
+   uc->context = create_fbc_context(glx, glx->context);
+   if (uc->context)
+      uc->pbuffer = glXCreatePbuffer(system->gfxdisplay, *glx->fbc, attrib);
+
+   if (!uc->context || !uc->pbuffer) {
+      ALLEGRO_ERROR("Failed to create an upload context.\n");
+      _al_xglx_config_destroy_upload_context(uc);
+      return NULL;
+   }
+
+   return uc;
+}
+
+bool _al_xglx_config_make_upload_context_current(void *context)
+{
+   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   XGLX_UPLOAD_CONTEXT *uc = context;
+
+   if (!uc)
+      return glXMakeContextCurrent(system->gfxdisplay, None, None, NULL);
+   return glXMakeContextCurrent(system->gfxdisplay, uc->pbuffer, uc->pbuffer,
+      uc->context);
+}
+
+void _al_xglx_config_destroy_upload_context(void *context)
+{
+   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   XGLX_UPLOAD_CONTEXT *uc = context;
+
+   if (uc->pbuffer)
+      glXDestroyPbuffer(system->gfxdisplay, uc->pbuffer);
+   if (uc->context)
+      glXDestroyContext(system->gfxdisplay, uc->context);
+   al_free(uc);
+}
@@ -37,6 +37,7 @@
 #include "allegro5/internal/aintern_keyboard.h"
 #include "allegro5/internal/aintern_x.h"
 #include "allegro5/internal/aintern_xdisplay.h"
+#include "allegro5/internal/aintern_xevents.h"
 #include "allegro5/internal/aintern_xkeyboard.h"
 #include "allegro5/internal/aintern_xsystem.h"
 
@@ -49,8 +50,9 @@ ALLEGRO_DEBUG_CHANNEL("keyboard")
 
 /*----------------------------------------------------------------------*/
 static void handle_key_press(int mycode, int unichar, int filtered,
-   unsigned int modifiers, ALLEGRO_DISPLAY *display);
-static void handle_key_release(int mycode, unsigned int modifiers, ALLEGRO_DISPLAY *display);
+   unsigned int modifiers, Time time, ALLEGRO_DISPLAY *display);
+static void handle_key_release(int mycode, unsigned int modifiers, Time time,
+   ALLEGRO_DISPLAY *display);
 static int _key_shifts;
 /*----------------------------------------------------------------------*/
 
@@ -75,6 +77,8 @@ static ALLEGRO_KEYBOARD_XWIN the_keyboard;
 
 static int last_press_code = -1;
 
+static void publish_state(double timestamp);
+
 #ifdef ALLEGRO_XWINDOWS_WITH_XIM
 static XIM xim = NULL;
 static XIC xic = NULL;
@@ -444,7 +448,8 @@ void _al_xwin_keyboard_handler(XKeyEvent *event, ALLEGRO_DISPLAY *display)
       filtered = XFilterEvent((XEvent *)event, glx->window);
 #endif
       if (keycode || unicode) {
-         handle_key_press(keycode, unicode, filtered, _key_shifts, display);
+         handle_key_press(keycode, unicode, filtered, _key_shifts,
+            event->time, display);
       }
    }
    else { /* Key release. */
@@ -467,7 +472,7 @@ void _al_xwin_keyboard_handler(XKeyEvent *event, ALLEGRO_DISPLAY *display)
             return;
          }
       }
-      handle_key_release(keycode, _key_shifts, display);
+      handle_key_release(keycode, _key_shifts, event->time, display);
    }
 }
 
@@ -493,6 +498,7 @@ void _al_xwin_keyboard_switch_handler(ALLEGRO_DISPLAY *display, bool focus_in)
       the_keyboard.state.display = NULL;
    }
 
+   publish_state(al_get_time());
    _al_event_source_unlock(&the_keyboard.parent.es);
 }
 
@@ -932,6 +938,8 @@ static bool xkeybd_init_keyboard(void)
    memset(&the_keyboard, 0, sizeof the_keyboard);
 
    _al_event_source_init(&the_keyboard.parent.es);
+   _al_init_input_snapshot(&the_keyboard.parent.snapshot,
+      sizeof the_keyboard.state);
 
    the_keyboard.three_finger_flag = true;
 
@@ -961,6 +969,7 @@ static void xkeybd_exit_keyboard(void)
    x_keyboard_exit();
 
    _al_event_source_free(&the_keyboard.parent.es);
+   _al_destroy_input_snapshot(&the_keyboard.parent.snapshot);
 }
 
 
@@ -1019,18 +1028,31 @@ static void xkeybd_clear_keyboard_state(void)
    {
       last_press_code = -1;
       memset(&the_keyboard.state, 0, sizeof(the_keyboard.state));
+      publish_state(al_get_time());
    }
    _al_event_source_unlock(&the_keyboard.parent.es);
 }
 
 
 
+/* publish_state:
+ *  Make the keyboard state available to al_get_keyboard_state, which does
+ *  not lock. The event source must be locked.
+ */
+static void publish_state(double timestamp)
+{
+   _al_publish_input_snapshot(&the_keyboard.parent.snapshot,
+      &the_keyboard.state, timestamp);
+}
+
+
+
 /* handle_key_press: [bgman thread]
  *  Hook for the X event dispatcher to handle key presses.
  *  The caller must lock the X-display.
  */
 static void handle_key_press(int mycode, int unichar, int filtered,
-   unsigned int modifiers, ALLEGRO_DISPLAY *display)
+   unsigned int modifiers, Time time, ALLEGRO_DISPLAY *display)
 {
    bool is_repeat;
 
@@ -1040,15 +1062,19 @@ static void handle_key_press(int mycode, int unichar, int filtered,
 
    _al_event_source_lock(&the_keyboard.parent.es);
    {
+      double timestamp = _al_event_source_input_time(&the_keyboard.parent.es,
+         _al_xwin_event_time(time));
+
       /* Update the key_down array.  */
       _AL_KEYBOARD_STATE_SET_KEY_DOWN(the_keyboard.state, mycode);
+      publish_state(timestamp);
 
       /* Generate the events if necessary. */
       if (_al_event_source_needs_to_generate_event(&the_keyboard.parent.es)) {
          ALLEGRO_EVENT event;
 
          event.keyboard.type = ALLEGRO_EVENT_KEY_DOWN;
-         event.keyboard.timestamp = al_get_time();
+         event.keyboard.timestamp = timestamp;
          event.keyboard.display = display;
          event.keyboard.keycode = last_press_code;
          event.keyboard.unichar = 0;
@@ -1110,21 +1136,26 @@ static void handle_key_press(int mycode, int unichar, int filtered,
  *  Hook for the X event dispatcher to handle key releases.
  *  The caller must lock the X-display.
  */
-static void handle_key_release(int mycode, unsigned int modifiers, ALLEGRO_DISPLAY *display)
+static void handle_key_release(int mycode, unsigned int modifiers, Time time,
+   ALLEGRO_DISPLAY *display)
 {
    if (last_press_code == mycode)
       last_press_code = -1;
 
    _al_event_source_lock(&the_keyboard.parent.es);
    {
+      double timestamp = _al_event_source_input_time(&the_keyboard.parent.es,
+         _al_xwin_event_time(time));
+
       /* Update the key_down array.  */
       _AL_KEYBOARD_STATE_CLEAR_KEY_DOWN(the_keyboard.state, mycode);
+      publish_state(timestamp);
 
       /* Generate the release event if necessary. */
       if (_al_event_source_needs_to_generate_event(&the_keyboard.parent.es)) {
          ALLEGRO_EVENT event;
          event.keyboard.type = ALLEGRO_EVENT_KEY_UP;
-         event.keyboard.timestamp = al_get_time();
+         event.keyboard.timestamp = timestamp;
          event.keyboard.display = display;
          event.keyboard.keycode = mycode;
          event.keyboard.unichar = 0;
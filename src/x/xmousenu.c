@@ -28,6 +28,7 @@
 #include "allegro5/internal/aintern_mouse.h"
 #include "allegro5/internal/aintern_x.h"
 #include "allegro5/internal/aintern_xdisplay.h"
+#include "allegro5/internal/aintern_xevents.h"
 #include "allegro5/internal/aintern_xmouse.h"
 #include "allegro5/internal/aintern_xsystem.h"
 
@@ -67,9 +68,12 @@ static bool xmouse_set_mouse_xy(ALLEGRO_DISPLAY *,int x, int y);
 static bool xmouse_set_mouse_axis(int which, int z);
 static void xmouse_get_state(ALLEGRO_MOUSE_STATE *ret_state);
 
-static void wheel_motion_handler(int x_button, ALLEGRO_DISPLAY *display);
+static void wheel_motion_handler(int x_button, double timestamp,
+   ALLEGRO_DISPLAY *display);
+static double input_time(Time time);
+static void publish_state(double timestamp);
 static unsigned int x_button_to_al_button(unsigned int x_button);
-static void generate_mouse_event(unsigned int type,
+static void generate_mouse_event(unsigned int type, double timestamp,
    int x, int y, int z, int w, float pressure,
    int dx, int dy, int dz, int dw,
    unsigned int button,
@@ -130,6 +134,8 @@ static bool xmouse_init(void)
    the_mouse.state.y = y;
 
    _al_event_source_init(&the_mouse.parent.es);
+   _al_init_input_snapshot(&the_mouse.parent.snapshot, sizeof the_mouse.state);
+   publish_state(al_get_time());
 
    xmouse_installed = true;
 
@@ -148,6 +154,7 @@ static void xmouse_exit(void)
    xmouse_installed = false;
 
    _al_event_source_free(&the_mouse.parent.es);
+   _al_destroy_input_snapshot(&the_mouse.parent.snapshot);
 }
 
 
@@ -230,8 +237,11 @@ static bool xmouse_set_mouse_xy(ALLEGRO_DISPLAY *display, int x, int y)
    if (x < 0 || y < 0 || x >= window_width || y >= window_height)
       return false;
 
+   _al_event_source_lock(&the_mouse.parent.es);
    the_mouse.state.x = x;
    the_mouse.state.y = y;
+   publish_state(al_get_time());
+   _al_event_source_unlock(&the_mouse.parent.es);
 
 #ifdef ALLEGRO_RASPBERRYPI
    float scale_x, scale_y;
@@ -278,6 +288,7 @@ static bool xmouse_set_mouse_axis(int which, int v)
 
    _al_event_source_lock(&the_mouse.parent.es);
    {
+      double now = al_get_time();
       int z = which == 2 ? v : the_mouse.state.z;
       int w = which == 3 ? v : the_mouse.state.w;
       int dz = z - the_mouse.state.z;
@@ -288,12 +299,13 @@ static bool xmouse_set_mouse_axis(int which, int v)
          the_mouse.state.w = w;
 
          generate_mouse_event(
-            ALLEGRO_EVENT_MOUSE_AXES,
+            ALLEGRO_EVENT_MOUSE_AXES, now,
             the_mouse.state.x, the_mouse.state.y, the_mouse.state.z,
             the_mouse.state.w, the_mouse.state.pressure,
             0, 0, dz, dw,
             0, the_mouse.state.display);
       }
+      publish_state(now);
    }
    _al_event_source_unlock(&the_mouse.parent.es);
 
@@ -323,15 +335,20 @@ static void xmouse_get_state(ALLEGRO_MOUSE_STATE *ret_state)
  *  Called by _xwin_process_event() for ButtonPress events received from the X
  *  server.
  */
-void _al_xwin_mouse_button_press_handler(int x_button,
+void _al_xwin_mouse_button_press_handler(int x_button, Time time,
    ALLEGRO_DISPLAY *display)
 {
    unsigned int al_button;
+   double timestamp;
 
    if (!xmouse_installed)
       return;
 
-   wheel_motion_handler(x_button, display);
+   _al_event_source_lock(&the_mouse.parent.es);
+   timestamp = input_time(time);
+   _al_event_source_unlock(&the_mouse.parent.es);
+
+   wheel_motion_handler(x_button, timestamp, display);
 
    /* Is this button supported by the Allegro API? */
    al_button = x_button_to_al_button(x_button);
@@ -344,12 +361,13 @@ void _al_xwin_mouse_button_press_handler(int x_button,
       the_mouse.state.pressure = the_mouse.state.buttons ? 1.0 : 0.0; /* TODO */
 
       generate_mouse_event(
-         ALLEGRO_EVENT_MOUSE_BUTTON_DOWN,
+         ALLEGRO_EVENT_MOUSE_BUTTON_DOWN, timestamp,
          the_mouse.state.x, the_mouse.state.y, the_mouse.state.z,
          the_mouse.state.w, the_mouse.state.pressure,
          0, 0, 0, 0,
          al_button, display);
    }
+   publish_state(timestamp);
    _al_event_source_unlock(&the_mouse.parent.es);
 }
 
@@ -359,7 +377,8 @@ void _al_xwin_mouse_button_press_handler(int x_button,
  *  Called by _al_xwin_mouse_button_press_handler() if the ButtonPress event
  *  received from the X server is actually for a mouse wheel movement.
  */
-static void wheel_motion_handler(int x_button, ALLEGRO_DISPLAY *display)
+static void wheel_motion_handler(int x_button, double timestamp,
+   ALLEGRO_DISPLAY *display)
 {
    int dz = 0, dw = 0;
    if (x_button == Button4) dz = 1;
@@ -377,12 +396,13 @@ static void wheel_motion_handler(int x_button, ALLEGRO_DISPLAY *display)
       the_mouse.state.w += dw;
 
       generate_mouse_event(
-         ALLEGRO_EVENT_MOUSE_AXES,
+         ALLEGRO_EVENT_MOUSE_AXES, timestamp,
          the_mouse.state.x, the_mouse.state.y, the_mouse.state.z,
          the_mouse.state.w, the_mouse.state.pressure,
          0, 0, dz, dw,
          0, display);
    }
+   publish_state(timestamp);
    _al_event_source_unlock(&the_mouse.parent.es);
 }
 
@@ -392,7 +412,7 @@ static void wheel_motion_handler(int x_button, ALLEGRO_DISPLAY *display)
  *  Called by _xwin_process_event() for ButtonRelease events received from the
  *  X server.
  */
-void _al_xwin_mouse_button_release_handler(int x_button,
+void _al_xwin_mouse_button_release_handler(int x_button, Time time,
    ALLEGRO_DISPLAY *display)
 {
    int al_button;
@@ -406,15 +426,18 @@ void _al_xwin_mouse_button_release_handler(int x_button,
 
    _al_event_source_lock(&the_mouse.parent.es);
    {
+      double timestamp = input_time(time);
+
       the_mouse.state.buttons &=~ (1 << (al_button - 1));
       the_mouse.state.pressure = the_mouse.state.buttons ? 1.0 : 0.0; /* TODO */
 
       generate_mouse_event(
-         ALLEGRO_EVENT_MOUSE_BUTTON_UP,
+         ALLEGRO_EVENT_MOUSE_BUTTON_UP, timestamp,
          the_mouse.state.x, the_mouse.state.y, the_mouse.state.z,
          the_mouse.state.w, the_mouse.state.pressure,
          0, 0, 0, 0,
          al_button, display);
+      publish_state(timestamp);
    }
    _al_event_source_unlock(&the_mouse.parent.es);
 }
@@ -425,11 +448,12 @@ void _al_xwin_mouse_button_release_handler(int x_button,
  *  Called by _xwin_process_event() for MotionNotify events received from the X
  *  server.
  */
-void _al_xwin_mouse_motion_notify_handler(int x, int y,
+void _al_xwin_mouse_motion_notify_handler(int x, int y, Time time,
    ALLEGRO_DISPLAY *display)
 {
    ALLEGRO_DISPLAY_XGLX *glx = (void *)display;
    int event_type = ALLEGRO_EVENT_MOUSE_AXES;
+   double timestamp;
 
    if (!xmouse_installed)
       return;
@@ -441,6 +465,7 @@ void _al_xwin_mouse_motion_notify_handler(int x, int y,
    }
 
    _al_event_source_lock(&the_mouse.parent.es);
+   timestamp = input_time(time);
 
 #ifdef ALLEGRO_RASPBERRYPI
    float scale_x, scale_y;
@@ -457,17 +482,42 @@ void _al_xwin_mouse_motion_notify_handler(int x, int y,
    the_mouse.state.display = display;
 
    generate_mouse_event(
-      event_type,
+      event_type, timestamp,
       the_mouse.state.x, the_mouse.state.y, the_mouse.state.z,
       the_mouse.state.w, the_mouse.state.pressure,
       dx, dy, 0, 0,
       0, display);
 
+   publish_state(timestamp);
    _al_event_source_unlock(&the_mouse.parent.es);
 }
 
 
 
+/* input_time: [bgman thread]
+ *  Return the timestamp for input which the X server received at `time',
+ *  and measure the latency. The event source must be locked.
+ */
+static double input_time(Time time)
+{
+   return _al_event_source_input_time(&the_mouse.parent.es,
+      _al_xwin_event_time(time));
+}
+
+
+
+/* publish_state:
+ *  Make the mouse state available to al_get_mouse_state, which does not
+ *  lock. The event source must be locked.
+ */
+static void publish_state(double timestamp)
+{
+   _al_publish_input_snapshot(&the_mouse.parent.snapshot, &the_mouse.state,
+      timestamp);
+}
+
+
+
 /* x_button_to_al_button: [bgman thread]
  *  Map a X button number to an Allegro button number.
  */
@@ -499,7 +549,7 @@ static unsigned int x_button_to_al_button(unsigned int x_button)
 /* generate_mouse_event: [bgman thread]
  *  Helper to generate a mouse event.
  */
-static void generate_mouse_event(unsigned int type,
+static void generate_mouse_event(unsigned int type, double timestamp,
                                  int x, int y, int z, int w, float pressure,
                                  int dx, int dy, int dz, int dw,
                                  unsigned int button,
@@ -511,7 +561,7 @@ static void generate_mouse_event(unsigned int type,
       return;
 
    event.mouse.type = type;
-   event.mouse.timestamp = al_get_time();
+   event.mouse.timestamp = timestamp;
    event.mouse.display = display;
    event.mouse.x = x;
    event.mouse.y = y;
@@ -535,6 +585,7 @@ void _al_xwin_mouse_switch_handler(ALLEGRO_DISPLAY *display,
    const XCrossingEvent *event)
 {
    int event_type;
+   double timestamp;
 
    /* Ignore events where any of the buttons are held down. */
    if (event->state & (Button1Mask | Button2Mask | Button3Mask |
@@ -543,6 +594,7 @@ void _al_xwin_mouse_switch_handler(ALLEGRO_DISPLAY *display,
    }
 
    _al_event_source_lock(&the_mouse.parent.es);
+   timestamp = input_time(event->time);
 
    switch (event->type) {
       case EnterNotify:
@@ -564,12 +616,13 @@ void _al_xwin_mouse_switch_handler(ALLEGRO_DISPLAY *display,
    }
 
    generate_mouse_event(
-      event_type,
+      event_type, timestamp,
       the_mouse.state.x, the_mouse.state.y, the_mouse.state.z, the_mouse.state.pressure,
       the_mouse.state.w,
       0, 0, 0, 0,
       0, display);
 
+   publish_state(timestamp);
    _al_event_source_unlock(&the_mouse.parent.es);
 }
 
@@ -1,4 +1,5 @@
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_x.h"
 #include "allegro5/internal/aintern_xdisplay.h"
 #include "allegro5/internal/aintern_xfullscreen.h"
@@ -322,6 +323,7 @@ static bool xrandr_query(ALLEGRO_SYSTEM_XGLX *s)
 
    for(i = 0; i < screen_count; i++) {
       xrandr_screen *screen = _al_vector_alloc_back(&s->xrandr_screens);
+      memset(screen, 0, sizeof(*screen));
       
       XRRScreenResources *res = XRRGetScreenResources(s->x11display, XRootWindow(s->x11display, i));
       if(!res) {
@@ -428,6 +430,76 @@ static bool xrandr_query(ALLEGRO_SYSTEM_XGLX *s)
    return ret;
 }
 
+/* xrandr_free_screens:
+ *  Free the screens and adapter map stored by xrandr_query.
+ */
+static void xrandr_free_screens(_AL_VECTOR *screens, _AL_VECTOR *adaptermap)
+{
+   int i, j;
+
+   for(i = 0; i < (int)_al_vector_size(screens); i++) {
+      xrandr_screen *screen = _al_vector_ref(screens, i);
+
+      for(j = 0; j < (int)_al_vector_size(&screen->crtcs); j++) {
+         xrandr_crtc *crtc = _al_vector_ref(&screen->crtcs, j);
+         _al_vector_free(&crtc->connected);
+         _al_vector_free(&crtc->possible);
+      }
+
+      for(j = 0; j < (int)_al_vector_size(&screen->outputs); j++) {
+         xrandr_output *output = _al_vector_ref(&screen->outputs, j);
+         free(output->name);
+         _al_vector_free(&output->crtcs);
+         _al_vector_free(&output->clones);
+         _al_vector_free(&output->modes);
+      }
+
+      _al_vector_free(&screen->crtcs);
+      _al_vector_free(&screen->outputs);
+      _al_vector_free(&screen->modes);
+
+      if(screen->res)
+         XRRFreeScreenResources(screen->res);
+   }
+
+   _al_vector_free(screens);
+   _al_vector_free(adaptermap);
+}
+
+/* xrandr_requery:
+ *  Query the screens again after outputs were connected or disconnected.
+ *  The modes to restore are kept for the crtcs which are still there.
+ *  Called with s->lock held.
+ */
+static void xrandr_requery(ALLEGRO_SYSTEM_XGLX *s)
+{
+   _AL_VECTOR old_screens = s->xrandr_screens;
+   _AL_VECTOR old_adaptermap = s->xrandr_adaptermap;
+   int i, j;
+
+   ALLEGRO_DEBUG("xrandr: querying screens again.\n");
+
+   xrandr_query(s);
+
+   for(i = 0; i < (int)_al_vector_size(&old_screens) &&
+         i < (int)_al_vector_size(&s->xrandr_screens); i++) {
+      xrandr_screen *old_screen = _al_vector_ref(&old_screens, i);
+
+      for(j = 0; j < (int)_al_vector_size(&old_screen->crtcs); j++) {
+         xrandr_crtc *old_crtc = _al_vector_ref(&old_screen->crtcs, j);
+         xrandr_crtc *crtc = xrandr_fetch_crtc(s, i, old_crtc->id);
+         if(!crtc)
+            continue;
+
+         crtc->original_mode = old_crtc->original_mode;
+         crtc->original_xoff = old_crtc->original_xoff;
+         crtc->original_yoff = old_crtc->original_yoff;
+      }
+   }
+
+   xrandr_free_screens(&old_screens, &old_adaptermap);
+}
+
 static int xrandr_get_num_modes(ALLEGRO_SYSTEM_XGLX *s, int adapter)
 {
    if(adapter < 0 || adapter >= (int)_al_vector_size(&s->xrandr_adaptermap))
@@ -583,6 +655,10 @@ static bool xrandr_set_mode(ALLEGRO_SYSTEM_XGLX *s, ALLEGRO_DISPLAY_XGLX *d, int
 
 static void xrandr_restore_mode(ALLEGRO_SYSTEM_XGLX *s, int adapter)
 {
+   /* The monitor may have been disconnected since. */
+   if(adapter < 0 || adapter >= (int)_al_vector_size(&s->xrandr_adaptermap))
+      return;
+
    int xscreen = _al_xglx_get_xscreen(s, adapter);
    xrandr_screen *screen = _al_vector_ref(&s->xrandr_screens, xscreen);
    xrandr_crtc *crtc = xrandr_map_to_crtc(s, xscreen, adapter);
@@ -623,6 +699,9 @@ static void xrandr_restore_mode(ALLEGRO_SYSTEM_XGLX *s, int adapter)
 
 static void xrandr_get_display_offset(ALLEGRO_SYSTEM_XGLX *s, int adapter, int *x, int *y)
 {
+   if(adapter < 0 || adapter >= (int)_al_vector_size(&s->xrandr_adaptermap))
+      return;
+
    int xscreen = _al_xglx_get_xscreen(s, adapter);
    
    xrandr_crtc *crtc = xrandr_map_to_crtc(s, xscreen, adapter);
@@ -694,6 +773,19 @@ static int xrandr_get_xscreen(ALLEGRO_SYSTEM_XGLX *s, int adapter)
    return 0;
 }
 
+/* xrandr_topology_changed:
+ *  Tell every display that the monitors changed.
+ */
+static void xrandr_topology_changed(ALLEGRO_SYSTEM_XGLX *s)
+{
+   unsigned int i;
+
+   for(i = 0; i < _al_vector_size(&s->system.displays); i++) {
+      ALLEGRO_DISPLAY **dptr = _al_vector_ref(&s->system.displays, i);
+      _al_display_topology_changed(*dptr);
+   }
+}
+
 static void xrandr_handle_xevent(ALLEGRO_SYSTEM_XGLX *s, ALLEGRO_DISPLAY_XGLX *d, XEvent *e)
 {
    if(e->type == s->xrandr_event_base + RRNotify) {
@@ -732,6 +824,8 @@ static void xrandr_handle_xevent(ALLEGRO_SYSTEM_XGLX *s, ALLEGRO_DISPLAY_XGLX *d
          
          xrandr_screen *screen = _al_vector_ref(&s->xrandr_screens, d->xscreen);
          crtc->timestamp = screen->timestamp;
+
+         xrandr_topology_changed(s);
       }
       else if(rre->subtype == RRNotify_OutputChange) {
          XRROutputChangeNotifyEvent *rroe = (XRROutputChangeNotifyEvent*)rre;
@@ -749,16 +843,19 @@ static void xrandr_handle_xevent(ALLEGRO_SYSTEM_XGLX *s, ALLEGRO_DISPLAY_XGLX *d
             output->crtc = rroe->crtc;
          }
          
-         // XXX I'm not sure how monitor connections are handled here,
-         // that is, what happens when a monitor is connected, and disconnected...
-         // IE: CHECK!
+         xrandr_screen *screen = _al_vector_ref(&s->xrandr_screens, d->xscreen);
+         output->timestamp = screen->timestamp;
+
+         /* A monitor was connected or disconnected, which changes the crtcs
+          * in use and so the adapters, so start over.
+          */
          if(rroe->connection != output->connection) {
             ALLEGRO_DEBUG("connection changed from %i to %i.\n", output->connection, rroe->connection);
             output->connection = rroe->connection;
+            xrandr_requery(s);
          }
-         
-         xrandr_screen *screen = _al_vector_ref(&s->xrandr_screens, d->xscreen);
-         output->timestamp = screen->timestamp;
+
+         xrandr_topology_changed(s);
       }
       else if(rre->subtype == RRNotify_OutputProperty) {
          ALLEGRO_DEBUG("xrandr: RRNotify_OutputProperty!\n");
@@ -782,6 +879,8 @@ static void xrandr_handle_xevent(ALLEGRO_SYSTEM_XGLX *s, ALLEGRO_DISPLAY_XGLX *d
       xrandr_screen *screen = _al_vector_ref(&s->xrandr_screens, d->xscreen);
       screen->timestamp = rre->timestamp;
       screen->configTimestamp = rre->config_timestamp;
+
+      xrandr_topology_changed(s);
    }
 }
 
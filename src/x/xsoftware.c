@@ -0,0 +1,430 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Backbuffer of the X11 software display driver.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_x.h"
+#include "allegro5/internal/aintern_xdisplay.h"
+#include "allegro5/internal/aintern_xsystem.h"
+
+#ifdef ALLEGRO_XWINDOWS_WITH_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#endif
+
+ALLEGRO_DEBUG_CHANNEL("display")
+
+
+/* The backbuffer is a memory bitmap whose pixels live in an XImage, so all
+ * drawing goes through the software routines and presenting it is a single
+ * XShmPutImage (or XPutImage without MIT-SHM) into the window.
+ */
+struct ALLEGRO_XSOFT_BACKBUFFER
+{
+   ALLEGRO_BITMAP *bitmap;
+   XImage *image;
+   GC gc;
+#ifdef ALLEGRO_XWINDOWS_WITH_XSHM
+   XShmSegmentInfo shminfo;
+   bool shm;
+#endif
+};
+
+
+bool _al_xsoft_select_visual(ALLEGRO_DISPLAY_XGLX *d)
+{
+   ALLEGRO_SYSTEM_XGLX *system = (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
+   XVisualInfo vinfo;
+
+   if (!XMatchVisualInfo(system->x11display, d->xscreen, 24, TrueColor,
+         &vinfo) &&
+       !XMatchVisualInfo(system->x11display, d->xscreen, 16, TrueColor,
+         &vinfo)) {
+      ALLEGRO_ERROR("No 24 or 16 bit TrueColor visual.\n");
+      return false;
+   }
+
+   /* Freed with al_free by the destroy hook, as there is no fbc. */
+   d->xvinfo = al_malloc(sizeof *d->xvinfo);
+   if (!d->xvinfo)
+      return false;
+   *d->xvinfo = vinfo;
+   return true;
+}
+
+
+/* Returns the pixel format matching the image layout, or -1 if the software
+ * routines cannot draw to it directly.
+ */
+static int get_image_format(XImage *image)
+{
+#ifdef ALLEGRO_LITTLE_ENDIAN
+   const int native_order = LSBFirst;
+#else
+   const int native_order = MSBFirst;
+#endif
+
+   if (image->byte_order != native_order)
+      return -1;
+
+   if (image->bits_per_pixel == 32 && image->red_mask == 0xff0000 &&
+         image->green_mask == 0x00ff00 && image->blue_mask == 0x0000ff)
+      return ALLEGRO_PIXEL_FORMAT_XRGB_8888;
+   if (image->bits_per_pixel == 32 && image->red_mask == 0x0000ff &&
+         image->green_mask == 0x00ff00 && image->blue_mask == 0xff0000)
+      return ALLEGRO_PIXEL_FORMAT_XBGR_8888;
+   if (image->bits_per_pixel == 16 && image->red_mask == 0xf800 &&
+         image->green_mask == 0x07e0 && image->blue_mask == 0x001f)
+      return ALLEGRO_PIXEL_FORMAT_RGB_565;
+
+   return -1;
+}
+
+
+#ifdef ALLEGRO_XWINDOWS_WITH_XSHM
+
+static bool shm_attach_failed;
+
+static int shm_error_handler(Display *display, XErrorEvent *event)
+{
+   (void)display;
+   (void)event;
+   shm_attach_failed = true;
+   return 0;
+}
+
+
+static XImage *create_shm_image(ALLEGRO_SYSTEM_XGLX *system,
+   ALLEGRO_DISPLAY_XGLX *d, ALLEGRO_XSOFT_BACKBUFFER *soft, int w, int h)
+{
+   Display *x11display = system->x11display;
+   XShmSegmentInfo *info = &soft->shminfo;
+   int (*old_handler)(Display *, XErrorEvent *);
+   XImage *image;
+
+   if (!XShmQueryExtension(x11display))
+      return NULL;
+
+   image = XShmCreateImage(x11display, d->xvinfo->visual, d->xvinfo->depth,
+      ZPixmap, NULL, info, w, h);
+   if (!image)
+      return NULL;
+
+   info->shmid = shmget(IPC_PRIVATE, image->bytes_per_line * image->height,
+      IPC_CREAT | 0600);
+   if (info->shmid < 0) {
+      XDestroyImage(image);
+      return NULL;
+   }
+   info->shmaddr = image->data = shmat(info->shmid, NULL, 0);
+   info->readOnly = False;
+
+   /* Attaching fails asynchronously if the server is on another machine,
+    * so wait for the reply with our own error handler in place.
+    */
+   if (info->shmaddr != (char *)-1) {
+      XSync(x11display, False);
+      shm_attach_failed = false;
+      old_handler = XSetErrorHandler(shm_error_handler);
+      XShmAttach(x11display, info);
+      XSync(x11display, False);
+      XSetErrorHandler(old_handler);
+   }
+   else {
+      shm_attach_failed = true;
+   }
+
+   /* The segment goes away once both sides have detached from it. */
+   shmctl(info->shmid, IPC_RMID, NULL);
+
+   if (shm_attach_failed) {
+      ALLEGRO_WARN("Could not attach the shared memory segment.\n");
+      if (info->shmaddr != (char *)-1)
+         shmdt(info->shmaddr);
+      image->data = NULL;
+      XDestroyImage(image);
+      return NULL;
+   }
+
+   soft->shm = true;
+   return image;
+}
+
+#endif
+
+
+static bool create_image(ALLEGRO_DISPLAY_XGLX *d, ALLEGRO_XSOFT_BACKBUFFER *soft,
+   int w, int h)
+{
+   ALLEGRO_SYSTEM_XGLX *system = (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
+   XImage *image = NULL;
+
+#ifdef ALLEGRO_XWINDOWS_WITH_XSHM
+   soft->shm = false;
+   image = create_shm_image(system, d, soft, w, h);
+#endif
+
+   if (!image) {
+      image = XCreateImage(system->x11display, d->xvinfo->visual,
+         d->xvinfo->depth, ZPixmap, 0, NULL, w, h, 32, 0);
+      if (!image)
+         return false;
+      image->data = al_malloc(image->bytes_per_line * image->height);
+      if (!image->data) {
+         XDestroyImage(image);
+         return false;
+      }
+   }
+
+   soft->image = image;
+   return true;
+}
+
+
+static void destroy_image(ALLEGRO_XSOFT_BACKBUFFER *soft)
+{
+   ALLEGRO_SYSTEM_XGLX *system = (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
+   XImage *image = soft->image;
+
+   if (!image)
+      return;
+
+#ifdef ALLEGRO_XWINDOWS_WITH_XSHM
+   if (soft->shm) {
+      XShmDetach(system->x11display, &soft->shminfo);
+      XSync(system->x11display, False);
+      shmdt(soft->shminfo.shmaddr);
+      soft->shm = false;
+   }
+   else
+#endif
+   {
+      al_free(image->data);
+   }
+
+   /* XDestroyImage would free the data with free(). */
+   image->data = NULL;
+   XDestroyImage(image);
+   soft->image = NULL;
+}
+
+
+/* Points the backbuffer bitmap at the pixels of the current image. */
+static void update_bitmap(ALLEGRO_XSOFT_BACKBUFFER *soft)
+{
+   ALLEGRO_BITMAP *bitmap = soft->bitmap;
+   XImage *image = soft->image;
+
+   bitmap->w = image->width;
+   bitmap->h = image->height;
+   bitmap->pitch = image->bytes_per_line;
+   bitmap->memory = (unsigned char *)image->data;
+   bitmap->cl = bitmap->ct = 0;
+   bitmap->cr_excl = bitmap->w;
+   bitmap->cb_excl = bitmap->h;
+   al_identity_transform(&bitmap->proj_transform);
+   al_orthographic_transform(&bitmap->proj_transform, 0, 0, -1.0,
+      bitmap->w, bitmap->h, 1.0);
+}
+
+
+bool _al_xsoft_create_backbuffer(ALLEGRO_DISPLAY_XGLX *d)
+{
+   ALLEGRO_SYSTEM_XGLX *system = (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
+   ALLEGRO_DISPLAY *display = (ALLEGRO_DISPLAY *)d;
+   ALLEGRO_XSOFT_BACKBUFFER *soft;
+   ALLEGRO_BITMAP *bitmap;
+   int format;
+
+   soft = al_calloc(1, sizeof *soft);
+   if (!soft)
+      return false;
+   d->soft = soft;
+
+   if (!create_image(d, soft, display->w, display->h)) {
+      ALLEGRO_ERROR("Could not create the backbuffer image.\n");
+      return false;
+   }
+
+   format = get_image_format(soft->image);
+   if (format < 0) {
+      ALLEGRO_ERROR("Unsupported visual: %d bpp, masks %lx %lx %lx.\n",
+         soft->image->bits_per_pixel, soft->image->red_mask,
+         soft->image->green_mask, soft->image->blue_mask);
+      return false;
+   }
+
+   bitmap = al_calloc(1, sizeof *bitmap);
+   if (!bitmap)
+      return false;
+   bitmap->_format = format;
+   bitmap->_flags = ALLEGRO_MEMORY_BITMAP;
+   bitmap->_display = display;
+   al_identity_transform(&bitmap->transform);
+   al_identity_transform(&bitmap->inverse_transform);
+   bitmap->blender.blend_color = al_map_rgba(0, 0, 0, 0);
+   soft->bitmap = bitmap;
+   update_bitmap(soft);
+
+   soft->gc = XCreateGC(system->x11display, d->window, 0, NULL);
+
+   display->backbuffer_format = format;
+   display->extra_settings.settings[ALLEGRO_COLOR_SIZE] =
+      al_get_pixel_format_bits(format);
+
+   ALLEGRO_INFO("Software backbuffer: %s, format %d.\n",
+#ifdef ALLEGRO_XWINDOWS_WITH_XSHM
+      soft->shm ? "MIT-SHM" :
+#endif
+      "XPutImage", format);
+   return true;
+}
+
+
+void _al_xsoft_resize_backbuffer(ALLEGRO_DISPLAY_XGLX *d)
+{
+   ALLEGRO_DISPLAY *display = (ALLEGRO_DISPLAY *)d;
+   ALLEGRO_XSOFT_BACKBUFFER *soft = d->soft;
+   ALLEGRO_XSOFT_BACKBUFFER old;
+
+   /* The window can be resized before the backbuffer exists. */
+   if (!soft || !soft->bitmap)
+      return;
+
+   /* Keep the old image until the new one is there, so that the bitmap
+    * never points to freed memory.
+    */
+   old = *soft;
+   if (!create_image(d, soft, display->w, display->h)) {
+      ALLEGRO_ERROR("Could not resize the backbuffer image.\n");
+      *soft = old;
+      return;
+   }
+   if (get_image_format(soft->image) != soft->bitmap->_format) {
+      ALLEGRO_ERROR("Backbuffer image format changed.\n");
+      destroy_image(soft);
+      *soft = old;
+      return;
+   }
+
+   destroy_image(&old);
+   update_bitmap(soft);
+}
+
+
+void _al_xsoft_destroy_backbuffer(ALLEGRO_DISPLAY_XGLX *d)
+{
+   ALLEGRO_SYSTEM_XGLX *system = (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
+   ALLEGRO_XSOFT_BACKBUFFER *soft = d->soft;
+
+   if (!soft)
+      return;
+
+   if (soft->gc)
+      XFreeGC(system->x11display, soft->gc);
+   destroy_image(soft);
+   al_free(soft->bitmap);
+   al_free(soft);
+   d->soft = NULL;
+}
+
+
+ALLEGRO_BITMAP *_al_xsoft_get_backbuffer(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_DISPLAY_XGLX *d = (ALLEGRO_DISPLAY_XGLX *)display;
+   return d->soft->bitmap;
+}
+
+
+static void put_image(ALLEGRO_SYSTEM_XGLX *system, ALLEGRO_DISPLAY_XGLX *d,
+   int x, int y, int w, int h)
+{
+   ALLEGRO_XSOFT_BACKBUFFER *soft = d->soft;
+
+#ifdef ALLEGRO_XWINDOWS_WITH_XSHM
+   if (soft->shm) {
+      XShmPutImage(system->x11display, d->window, soft->gc, soft->image,
+         x, y, x, y, w, h, False);
+      return;
+   }
+#endif
+
+   XPutImage(system->x11display, d->window, soft->gc, soft->image,
+      x, y, x, y, w, h);
+}
+
+
+/* Clips a rectangle to the backbuffer, returns false if nothing is left. */
+static bool clip_region(ALLEGRO_DISPLAY_XGLX *d, int *x, int *y, int *w,
+   int *h)
+{
+   ALLEGRO_BITMAP *bitmap = d->soft->bitmap;
+   int x2 = _ALLEGRO_MIN(*x + *w, bitmap->w);
+   int y2 = _ALLEGRO_MIN(*y + *h, bitmap->h);
+
+   *x = _ALLEGRO_MAX(*x, 0);
+   *y = _ALLEGRO_MAX(*y, 0);
+   *w = x2 - *x;
+   *h = y2 - *y;
+   return *w > 0 && *h > 0;
+}
+
+
+void _al_xsoft_update_display_region(ALLEGRO_DISPLAY *display, int x, int y,
+   int w, int h)
+{
+   ALLEGRO_SYSTEM_XGLX *system = (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
+   ALLEGRO_DISPLAY_XGLX *d = (ALLEGRO_DISPLAY_XGLX *)display;
+
+   _al_mutex_lock(&system->lock);
+   if (clip_region(d, &x, &y, &w, &h)) {
+      put_image(system, d, x, y, w, h);
+      /* The server must be done reading the pixels before we draw again. */
+      XSync(system->x11display, False);
+   }
+   _al_mutex_unlock(&system->lock);
+}
+
+
+void _al_xsoft_flip_display(ALLEGRO_DISPLAY *display)
+{
+   _al_xsoft_update_display_region(display, 0, 0, display->w, display->h);
+}
+
+
+void _al_xsoft_flip_display_regions(ALLEGRO_DISPLAY *display,
+   const int *rects, int num_rects)
+{
+   ALLEGRO_SYSTEM_XGLX *system = (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
+   ALLEGRO_DISPLAY_XGLX *d = (ALLEGRO_DISPLAY_XGLX *)display;
+   int i;
+
+   _al_mutex_lock(&system->lock);
+   for (i = 0; i < num_rects; i++) {
+      int x = rects[i * 4 + 0];
+      int y = rects[i * 4 + 1];
+      int w = rects[i * 4 + 2];
+      int h = rects[i * 4 + 3];
+      if (clip_region(d, &x, &y, &w, &h))
+         put_image(system, d, x, y, w, h);
+   }
+   XSync(system->x11display, False);
+   _al_mutex_unlock(&system->lock);
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -167,19 +167,25 @@ bool al_x_set_initial_icon(ALLEGRO_BITMAP *bitmap)
 #endif
 }
 
-static ALLEGRO_SYSTEM *xglx_initialize(int flags)
+/* xglx_connect:
+ *  Connect to the X server the first time something needs it. Command line
+ *  tools which only load and save files then never wait for it, nor start
+ *  the events thread. Without a server we run headless as before.
+ */
+static ALLEGRO_SYSTEM_XGLX *xglx_connect(void)
 {
+   ALLEGRO_SYSTEM_XGLX *s = (void *)al_get_system_driver();
    Display *x11display;
    Display *gfxdisplay;
-   ALLEGRO_SYSTEM_XGLX *s;
-
-   (void)flags;
-
-#ifdef DEBUG_X11
-   _Xdebug = 1;
-#endif
+   double t0;
 
-   XInitThreads();
+   _al_mutex_lock(&s->lock);
+   if (s->connect_tried) {
+      _al_mutex_unlock(&s->lock);
+      return s;
+   }
+   s->connect_tried = true;
+   t0 = al_get_time();
 
    /* Get an X11 display handle. */
    x11display = XOpenDisplay(0);
@@ -189,7 +195,7 @@ static ALLEGRO_SYSTEM *xglx_initialize(int flags)
       if (!gfxdisplay) {
          ALLEGRO_ERROR("XOpenDisplay failed second time.\n");
          XCloseDisplay(x11display);
-         return NULL;
+         x11display = NULL;
       }
    }
    else {
@@ -197,19 +203,6 @@ static ALLEGRO_SYSTEM *xglx_initialize(int flags)
       gfxdisplay = NULL;
    }
 
-   _al_unix_init_time();
-
-   s = al_calloc(1, sizeof *s);
-
-   _al_mutex_init_recursive(&s->lock);
-   _al_cond_init(&s->resized);
-   s->inhibit_screensaver = false;
-   s->screen_saver_query_available = false;
-
-   _al_vector_init(&s->system.displays, sizeof (ALLEGRO_DISPLAY_XGLX *));
-
-   s->system.vt = xglx_vt;
-
    s->gfxdisplay = gfxdisplay;
    s->x11display = x11display;
 
@@ -233,6 +226,37 @@ static ALLEGRO_SYSTEM *xglx_initialize(int flags)
       ALLEGRO_INFO("events thread spawned.\n");
    }
 
+   ALLEGRO_INFO("Connecting to X11 took %.2f ms.\n",
+      (al_get_time() - t0) * 1000.0);
+   _al_mutex_unlock(&s->lock);
+   return s;
+}
+
+static ALLEGRO_SYSTEM *xglx_initialize(int flags)
+{
+   ALLEGRO_SYSTEM_XGLX *s;
+
+   (void)flags;
+
+#ifdef DEBUG_X11
+   _Xdebug = 1;
+#endif
+
+   XInitThreads();
+
+   _al_unix_init_time();
+
+   s = al_calloc(1, sizeof *s);
+
+   _al_mutex_init_recursive(&s->lock);
+   _al_cond_init(&s->resized);
+   s->inhibit_screensaver = false;
+   s->screen_saver_query_available = false;
+
+   _al_vector_init(&s->system.displays, sizeof (ALLEGRO_DISPLAY_XGLX *));
+
+   s->system.vt = xglx_vt;
+
    const char *binding = al_get_config_value(al_get_system_config(),
          "keyboard", "toggle_mouse_grab_key");
    if (binding) {
@@ -301,16 +325,26 @@ static void xglx_shutdown_system(void)
 
 static ALLEGRO_DISPLAY_INTERFACE *xglx_get_display_driver(void)
 {
+   const char *driver = al_get_config_value(al_get_system_config(),
+      "graphics", "driver");
+
+   xglx_connect();
+
+   if (driver && !_al_stricmp(driver, "software"))
+      return _al_display_xsoft_driver();
+
    return _al_display_xglx_driver();
 }
 
 static ALLEGRO_KEYBOARD_DRIVER *xglx_get_keyboard_driver(void)
 {
+   xglx_connect();
    return _al_xwin_keyboard_driver();
 }
 
 static ALLEGRO_MOUSE_DRIVER *xglx_get_mouse_driver(void)
 {
+   xglx_connect();
    return _al_xwin_mouse_driver();
 }
 
@@ -326,31 +360,36 @@ static ALLEGRO_HAPTIC_DRIVER *xglx_get_haptic_driver(void)
 
 static ALLEGRO_TOUCH_INPUT_DRIVER *xglx_get_touch_driver(void)
 {
+   xglx_connect();
    return _al_touch_input_driver_list[0].driver;
 }
 
 static int xglx_get_num_video_adapters(void)
 {
-   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   ALLEGRO_SYSTEM_XGLX *system = xglx_connect();
 
    return _al_xglx_get_num_video_adapters(system);
 }
 
 static bool xglx_get_monitor_info(int adapter, ALLEGRO_MONITOR_INFO *info)
 {
-   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   ALLEGRO_SYSTEM_XGLX *system = xglx_connect();
 
    return _al_xglx_get_monitor_info(system, adapter, info);
 }
 
 static bool xglx_get_cursor_position(int *ret_x, int *ret_y)
 {
-   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
-   Window root = RootWindow(system->x11display, 0);
+   ALLEGRO_SYSTEM_XGLX *system = xglx_connect();
+   Window root;
    Window child;
    int wx, wy;
    unsigned int mask;
 
+   if (!system->x11display)
+      return false;
+
+   root = RootWindow(system->x11display, 0);
    _al_mutex_lock(&system->lock);
    XQueryPointer(system->x11display, root, &root, &child, ret_x, ret_y,
       &wx, &wy, &mask);
@@ -360,9 +399,12 @@ static bool xglx_get_cursor_position(int *ret_x, int *ret_y)
 
 static bool xglx_inhibit_screensaver(bool inhibit)
 {
-   ALLEGRO_SYSTEM_XGLX *system = (void *)al_get_system_driver();
+   ALLEGRO_SYSTEM_XGLX *system = xglx_connect();
    int temp, version_min, version_max;
 
+   if (!system->x11display)
+      return false;
+
 #ifdef ALLEGRO_XWINDOWS_WITH_XSCREENSAVER
    if (!XScreenSaverQueryExtension(system->x11display, &temp, &temp) ||
       !XScreenSaverQueryVersion(system->x11display, &version_max, &version_min) ||
@@ -394,7 +436,7 @@ static bool xglx_inhibit_screensaver(bool inhibit)
 static int xglx_get_num_display_modes(void)
 {
    int adapter = al_get_new_display_adapter();
-   ALLEGRO_SYSTEM_XGLX *s = (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
+   ALLEGRO_SYSTEM_XGLX *s = xglx_connect();
 
    return _al_xglx_get_num_display_modes(s, adapter);
 }
@@ -402,7 +444,7 @@ static int xglx_get_num_display_modes(void)
 static ALLEGRO_DISPLAY_MODE *xglx_get_display_mode(int mode, ALLEGRO_DISPLAY_MODE *dm)
 {
    int adapter = al_get_new_display_adapter();
-   ALLEGRO_SYSTEM_XGLX *s = (ALLEGRO_SYSTEM_XGLX *)al_get_system_driver();
+   ALLEGRO_SYSTEM_XGLX *s = xglx_connect();
 
    return _al_xglx_get_display_mode(s, adapter, mode, dm);
 }
@@ -410,7 +452,7 @@ static ALLEGRO_DISPLAY_MODE *xglx_get_display_mode(int mode, ALLEGRO_DISPLAY_MOD
 static int xglx_get_monitor_dpi(int adapter)
 {
    ALLEGRO_MONITOR_INFO info;
-   ALLEGRO_SYSTEM_XGLX *s = (void *)al_get_system_driver();
+   ALLEGRO_SYSTEM_XGLX *s = xglx_connect();
    int x2_mm;
    int y2_mm;
    int dpi_hori;
@@ -429,6 +471,13 @@ static int xglx_get_monitor_dpi(int adapter)
    return sqrt(dpi_hori * dpi_vert);
 }
 
+static ALLEGRO_MOUSE_CURSOR *xglx_create_mouse_cursor(ALLEGRO_BITMAP *bmp,
+   int x_focus, int y_focus)
+{
+   xglx_connect();
+   return _al_xwin_create_mouse_cursor(bmp, x_focus, y_focus);
+}
+
 /* Internal function to get a reference to this driver. */
 ALLEGRO_SYSTEM_INTERFACE *_al_system_xglx_driver(void)
 {
@@ -451,7 +500,7 @@ ALLEGRO_SYSTEM_INTERFACE *_al_system_xglx_driver(void)
    xglx_vt->get_num_video_adapters = xglx_get_num_video_adapters;
    xglx_vt->get_monitor_info = xglx_get_monitor_info;
    xglx_vt->get_monitor_dpi = xglx_get_monitor_dpi;
-   xglx_vt->create_mouse_cursor = _al_xwin_create_mouse_cursor;
+   xglx_vt->create_mouse_cursor = xglx_create_mouse_cursor;
    xglx_vt->destroy_mouse_cursor = _al_xwin_destroy_mouse_cursor;
    xglx_vt->get_cursor_position = xglx_get_cursor_position;
    xglx_vt->grab_mouse = _al_xwin_grab_mouse;
@@ -461,6 +510,8 @@ ALLEGRO_SYSTEM_INTERFACE *_al_system_xglx_driver(void)
    xglx_vt->get_time = _al_unix_get_time;
    xglx_vt->rest = _al_unix_rest;
    xglx_vt->init_timeout = _al_unix_init_timeout;
+   xglx_vt->rest_until = _al_unix_rest_until;
+   xglx_vt->init_timeout_until = _al_unix_init_timeout_until;
 
    return xglx_vt;
 }
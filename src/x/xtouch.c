@@ -57,6 +57,14 @@ static void reset_touch_input_state(void)
 }
 
 
+/* Must be called with the event source locked. */
+static void publish_state(double timestamp)
+{
+   _al_publish_input_snapshot(&touch_input.snapshot, &touch_input_state,
+      timestamp);
+}
+
+
 static void generate_touch_input_event(unsigned int type, double timestamp,
    int id, float x, float y, float dx, float dy, bool primary,
    ALLEGRO_DISPLAY *disp)
@@ -80,6 +88,9 @@ static void generate_touch_input_event(unsigned int type, double timestamp,
    else if (touch_input.mouse_emulation_mode == ALLEGRO_MOUSE_EMULATION_EXCLUSIVE)
       want_touch_event = al_is_mouse_installed() ? false : want_touch_event;
 
+   if (want_touch_event &&
+         _al_touch_input_defer_event(&touch_input, type, timestamp, disp))
+      want_touch_event = false;
 
    if (!want_touch_event && !want_mouse_emulation_event)
       return;
@@ -192,6 +203,7 @@ static void touch_input_handle_begin(int id, double timestamp, float x, float y,
    state->dy      = 0.0f;
    state->primary = primary;
    state->display = disp;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_BEGIN, timestamp,
@@ -219,6 +231,7 @@ static void touch_input_handle_end(int id, double timestamp, float x, float y, b
    state->dy = y - state->y;
    state->x  = x;
    state->y  = y;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_END, timestamp,
@@ -228,6 +241,7 @@ static void touch_input_handle_end(int id, double timestamp, float x, float y, b
    _al_event_source_lock(&touch_input.es);
    state->id = -1;
    touch_ids[index]= -1;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 }
 
@@ -252,6 +266,7 @@ static void touch_input_handle_move(int id, double timestamp, float x, float y,
    state->dy = y - state->y;
    state->x  = x;
    state->y  = y;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_MOVE, timestamp,
@@ -277,6 +292,7 @@ static void touch_input_handle_cancel(int id, double timestamp, float x, float y
    state->dy = y - state->y;
    state->x  = x;
    state->y  = y;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 
    generate_touch_input_event(ALLEGRO_EVENT_TOUCH_CANCEL, timestamp,
@@ -284,6 +300,7 @@ static void touch_input_handle_cancel(int id, double timestamp, float x, float y
 
    _al_event_source_lock(&touch_input.es);
    state->id = -1;
+   publish_state(timestamp);
    _al_event_source_unlock(&touch_input.es);
 }
 
@@ -352,6 +369,9 @@ static bool xtouch_init(void)
    memset(&touch_input, 0, sizeof(touch_input));
    reset_touch_input_state();
 
+   if (!_al_init_touch_input_frames(&touch_input))
+      ALLEGRO_WARN("Touch frame events are not available.\n");
+
    /* Initialise the touch object for use as an event source. */
    _al_event_source_init(&touch_input.es);
 
@@ -368,6 +388,7 @@ static bool xtouch_init(void)
 
 static void xtouch_exit(void)
 {
+   _al_destroy_touch_input_frames(&touch_input);
 }
 
 
@@ -476,3 +497,14 @@ void _al_x_handle_touch_event(ALLEGRO_SYSTEM_XGLX *s, ALLEGRO_DISPLAY_XGLX *d, X
    (void)e;
 #endif
 }
+
+/* Called when all queued X events have been handled, which is what makes
+ * a frame of touch input.
+ */
+void _al_x_end_touch_frame(void)
+{
+#ifdef ALLEGRO_XWINDOWS_WITH_XINPUT2
+   if (installed)
+      _al_touch_input_end_frame(&touch_input);
+#endif
+}
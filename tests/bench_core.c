@@ -0,0 +1,817 @@
+/*
+ * Microbenchmarks of the core library's hot paths.
+ *
+ * Each benchmark is run with a growing number of iterations until it takes
+ * at least the minimum time, and the results are printed as JSON.
+ * See test_driver.txt for the options.
+ */
+
+#define ALLEGRO_UNSTABLE
+
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <allegro5/allegro.h>
+
+/* The inline functions of the internal headers use the library's name. */
+#define ASSERT(x) ALLEGRO_ASSERT(x)
+
+#include "allegro5/internal/aintern_aatree.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_vector.h"
+
+typedef void (*BenchFn)(void *data, int n);
+
+#define BMP_SIZE        256
+#define MAX_PIXEL_SIZE  16
+
+double            min_time = 0.1;
+bool              want_display = true;
+int               num_filters = 0;
+char            **filters = NULL;
+FILE             *out;
+int               num_results = 0;
+
+static void fatal_error(char const *msg, ...)
+{
+   va_list ap;
+
+   va_start(ap, msg);
+   fprintf(stderr, "bench_core: ");
+   vfprintf(stderr, msg, ap);
+   fprintf(stderr, "\n");
+   va_end(ap);
+   exit(EXIT_FAILURE);
+}
+
+static bool wanted(char const *name)
+{
+   int i;
+
+   if (num_filters == 0)
+      return true;
+   for (i = 0; i < num_filters; i++) {
+      if (strncmp(name, filters[i], strlen(filters[i])) == 0)
+         return true;
+   }
+   return false;
+}
+
+/* Runs fn with more and more iterations until they take min_time, then
+ * prints the result. Each iteration handles 'items' of 'unit'.
+ */
+static void run_bench(char const *name, BenchFn fn, void *data,
+   double items, char const *unit)
+{
+   double start;
+   double elapsed;
+   double grow;
+   int n = 1;
+
+   if (!wanted(name))
+      return;
+
+   fn(data, 1);
+
+   for (;;) {
+      start = al_get_time();
+      fn(data, n);
+      elapsed = al_get_time() - start;
+      if (elapsed >= min_time || n >= INT_MAX / 16)
+         break;
+      grow = (elapsed > 0.0) ? 1.2 * min_time / elapsed : 16.0;
+      if (grow > 16.0)
+         grow = 16.0;
+      if (grow < 2.0)
+         grow = 2.0;
+      n = (int)(n * grow);
+   }
+   if (elapsed <= 0.0)
+      elapsed = 1e-9;
+
+   fprintf(out, "%s\n    {\"name\": \"%s\", \"iterations\": %d, "
+      "\"seconds\": %.6f, \"ns_per_iteration\": %.3f, "
+      "\"%s_per_second\": %.1f}",
+      num_results > 0 ? "," : "", name, n, elapsed, 1e9 * elapsed / n,
+      unit, items * n / elapsed);
+   fflush(out);
+   num_results++;
+}
+
+
+/* Pixel conversion */
+
+typedef struct CONVERT_DATA {
+   unsigned char *src;
+   unsigned char *dst;
+   int src_format, dst_format;
+   int src_pitch, dst_pitch;
+} CONVERT_DATA;
+
+static void bench_convert(void *data, int n)
+{
+   CONVERT_DATA *c = data;
+   int i;
+
+   for (i = 0; i < n; i++) {
+      _al_convert_bitmap_data(c->src, c->src_format, c->src_pitch,
+         c->dst, c->dst_format, c->dst_pitch, 0, 0, 0, 0, BMP_SIZE, BMP_SIZE);
+   }
+}
+
+static bool is_plain_format(int format)
+{
+   return _al_pixel_format_is_real(format) &&
+      !_al_pixel_format_is_compressed(format);
+}
+
+static void convert_benchmarks(void)
+{
+   size_t size = BMP_SIZE * BMP_SIZE * MAX_PIXEL_SIZE;
+   unsigned char *argb = malloc(BMP_SIZE * BMP_SIZE * 4);
+   CONVERT_DATA c;
+   char name[128];
+   int i;
+
+   c.src = malloc(size);
+   c.dst = malloc(size);
+   if (!argb || !c.src || !c.dst)
+      fatal_error("out of memory");
+
+   /* Random colours, converted into each source format in turn, so that
+    * the float formats hold sensible values.
+    */
+   srand(1);
+   for (i = 0; i < BMP_SIZE * BMP_SIZE * 4; i++)
+      argb[i] = rand() & 0xff;
+
+   for (c.src_format = 0; c.src_format < ALLEGRO_NUM_PIXEL_FORMATS;
+         c.src_format++) {
+      if (!is_plain_format(c.src_format))
+         continue;
+      c.src_pitch = BMP_SIZE * al_get_pixel_size(c.src_format);
+      _al_convert_bitmap_data(argb, ALLEGRO_PIXEL_FORMAT_ARGB_8888,
+         BMP_SIZE * 4, c.src, c.src_format, c.src_pitch,
+         0, 0, 0, 0, BMP_SIZE, BMP_SIZE);
+
+      for (c.dst_format = 0; c.dst_format < ALLEGRO_NUM_PIXEL_FORMATS;
+            c.dst_format++) {
+         if (!is_plain_format(c.dst_format))
+            continue;
+         c.dst_pitch = BMP_SIZE * al_get_pixel_size(c.dst_format);
+         snprintf(name, sizeof(name), "convert %s to %s",
+            _al_pixel_format_name(c.src_format),
+            _al_pixel_format_name(c.dst_format));
+         run_bench(name, bench_convert, &c, BMP_SIZE * BMP_SIZE, "pixels");
+      }
+   }
+
+   free(argb);
+   free(c.src);
+   free(c.dst);
+}
+
+
+/* Blending into memory bitmaps */
+
+typedef struct BLEND_MODE {
+   char const *name;
+   int op, src, dst;
+} BLEND_MODE;
+
+static const BLEND_MODE blend_modes[] = {
+   { "alpha",      ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA },
+   { "add",        ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ONE },
+   { "copy",       ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO },
+   { "multiply",   ALLEGRO_ADD, ALLEGRO_DEST_COLOR, ALLEGRO_ZERO },
+   { "subtract",   ALLEGRO_DEST_MINUS_SRC, ALLEGRO_ONE, ALLEGRO_ONE },
+   { "const",      ALLEGRO_ADD, ALLEGRO_CONST_COLOR,
+                   ALLEGRO_INVERSE_CONST_COLOR },
+   { NULL, 0, 0, 0 }
+};
+
+typedef struct BLEND_DATA {
+   ALLEGRO_BITMAP *src;
+   ALLEGRO_BITMAP *dst;
+} BLEND_DATA;
+
+static void bench_blended_pixel(void *data, int n)
+{
+   BLEND_DATA *b = data;
+   ALLEGRO_COLOR color = al_map_rgba(40, 80, 120, 160);
+   int i, x, y;
+
+   al_set_target_bitmap(b->dst);
+   al_lock_bitmap(b->dst, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READWRITE);
+   for (i = 0; i < n; i++) {
+      for (y = 0; y < BMP_SIZE; y++) {
+         for (x = 0; x < BMP_SIZE; x++)
+            al_put_blended_pixel(x, y, color);
+      }
+   }
+   al_unlock_bitmap(b->dst);
+}
+
+static void bench_draw_bitmap(void *data, int n)
+{
+   BLEND_DATA *b = data;
+   int i;
+
+   al_set_target_bitmap(b->dst);
+   for (i = 0; i < n; i++)
+      al_draw_bitmap(b->src, 0, 0, 0);
+}
+
+static void blend_benchmarks(void)
+{
+   BLEND_DATA b;
+   char name[128];
+   int i, x, y;
+
+   al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+   al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ARGB_8888);
+   b.src = al_create_bitmap(BMP_SIZE, BMP_SIZE);
+   b.dst = al_create_bitmap(BMP_SIZE, BMP_SIZE);
+   if (!b.src || !b.dst)
+      fatal_error("failed to create bitmaps");
+
+   al_set_target_bitmap(b.src);
+   al_lock_bitmap(b.src, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_WRITEONLY);
+   for (y = 0; y < BMP_SIZE; y++) {
+      for (x = 0; x < BMP_SIZE; x++)
+         al_put_pixel(x, y, al_map_rgba(x, y, x ^ y, (x + y) / 2));
+   }
+   al_unlock_bitmap(b.src);
+   al_set_target_bitmap(b.dst);
+   al_clear_to_color(al_map_rgb(30, 60, 90));
+
+   for (i = 0; blend_modes[i].name; i++) {
+      const BLEND_MODE *m = &blend_modes[i];
+
+      al_set_target_bitmap(b.dst);
+      al_set_blender(m->op, m->src, m->dst);
+      al_set_blend_color(al_map_rgba_f(0.5, 0.5, 0.5, 0.5));
+
+      snprintf(name, sizeof(name), "blend pixel %s", m->name);
+      run_bench(name, bench_blended_pixel, &b, BMP_SIZE * BMP_SIZE,
+         "pixels");
+      snprintf(name, sizeof(name), "blend draw_bitmap %s", m->name);
+      run_bench(name, bench_draw_bitmap, &b, BMP_SIZE * BMP_SIZE, "pixels");
+   }
+
+   al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA);
+   al_set_target_bitmap(NULL);
+   al_destroy_bitmap(b.src);
+   al_destroy_bitmap(b.dst);
+}
+
+
+/* Event queues */
+
+#define EVENT_BATCH  64
+
+typedef struct EVENT_DATA {
+   ALLEGRO_EVENT_QUEUE *queue;
+   ALLEGRO_EVENT_SOURCE source;
+} EVENT_DATA;
+
+static void bench_events(void *data, int n)
+{
+   EVENT_DATA *e = data;
+   ALLEGRO_EVENT event;
+   int i, j;
+
+   memset(&event, 0, sizeof(event));
+   event.user.type = ALLEGRO_GET_EVENT_TYPE('B', 'E', 'N', 'C');
+
+   for (i = 0; i < n; i++) {
+      for (j = 0; j < EVENT_BATCH; j++) {
+         event.user.data1 = j;
+         al_emit_user_event(&e->source, &event, NULL);
+      }
+      while (al_get_next_event(e->queue, &event))
+         ;
+   }
+}
+
+static void event_benchmarks(void)
+{
+   EVENT_DATA e;
+
+   e.queue = al_create_event_queue();
+   if (!e.queue)
+      fatal_error("failed to create event queue");
+   al_init_user_event_source(&e.source);
+   al_register_event_source(e.queue, &e.source);
+
+   run_bench("event emit and get_next_event", bench_events, &e,
+      EVENT_BATCH, "events");
+
+   al_destroy_user_event_source(&e.source);
+   al_destroy_event_queue(e.queue);
+}
+
+
+/* Bitmap locking */
+
+typedef struct LOCK_DATA {
+   ALLEGRO_BITMAP *bitmap;
+   int format;
+   int flags;
+   int w, h;
+} LOCK_DATA;
+
+static void bench_lock(void *data, int n)
+{
+   LOCK_DATA *l = data;
+   int i;
+
+   for (i = 0; i < n; i++) {
+      if (!al_lock_bitmap_region(l->bitmap, 0, 0, l->w, l->h, l->format,
+            l->flags))
+         fatal_error("failed to lock bitmap");
+      al_unlock_bitmap(l->bitmap);
+   }
+}
+
+static void lock_benchmarks_for(char const *kind, int bitmap_flags)
+{
+   static const struct {
+      char const *name;
+      int format;
+      int flags;
+      int size;
+   } locks[] = {
+      { "readwrite",          ALLEGRO_PIXEL_FORMAT_ANY,
+                              ALLEGRO_LOCK_READWRITE, BMP_SIZE },
+      { "readonly",           ALLEGRO_PIXEL_FORMAT_ANY,
+                              ALLEGRO_LOCK_READONLY, BMP_SIZE },
+      { "writeonly",          ALLEGRO_PIXEL_FORMAT_ANY,
+                              ALLEGRO_LOCK_WRITEONLY, BMP_SIZE },
+      { "readwrite convert",  ALLEGRO_PIXEL_FORMAT_ABGR_8888,
+                              ALLEGRO_LOCK_READWRITE, BMP_SIZE },
+      { "readwrite 16x16",    ALLEGRO_PIXEL_FORMAT_ANY,
+                              ALLEGRO_LOCK_READWRITE, 16 },
+      { NULL, 0, 0, 0 }
+   };
+   LOCK_DATA l;
+   char name[128];
+   int i;
+
+   al_set_new_bitmap_flags(bitmap_flags);
+   al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ARGB_8888);
+   l.bitmap = al_create_bitmap(BMP_SIZE, BMP_SIZE);
+   if (!l.bitmap) {
+      fprintf(stderr, "bench_core: skipping %s bitmap locking\n", kind);
+      return;
+   }
+
+   for (i = 0; locks[i].name; i++) {
+      l.format = locks[i].format;
+      l.flags = locks[i].flags;
+      l.w = l.h = locks[i].size;
+      snprintf(name, sizeof(name), "lock %s %s", kind, locks[i].name);
+      run_bench(name, bench_lock, &l, 1, "locks");
+   }
+
+   al_destroy_bitmap(l.bitmap);
+}
+
+static void lock_benchmarks(void)
+{
+   ALLEGRO_DISPLAY *display = NULL;
+
+   lock_benchmarks_for("memory", ALLEGRO_MEMORY_BITMAP);
+
+   if (want_display && wanted("lock video")) {
+      display = al_create_display(BMP_SIZE, BMP_SIZE);
+      if (!display) {
+         fprintf(stderr, "bench_core: no display, skipping video bitmap "
+            "locking\n");
+         return;
+      }
+      lock_benchmarks_for("video", ALLEGRO_VIDEO_BITMAP);
+      al_destroy_display(display);
+   }
+}
+
+
+/* UTF-8 strings */
+
+typedef struct USTR_DATA {
+   ALLEGRO_USTR *text;
+   ALLEGRO_USTR *needle;
+   ALLEGRO_USTR *scratch;
+   int length;
+} USTR_DATA;
+
+static void bench_ustr_append(void *data, int n)
+{
+   USTR_DATA *u = data;
+   int i;
+
+   for (i = 0; i < n; i++) {
+      if (al_ustr_size(u->scratch) > 65536)
+         al_ustr_truncate(u->scratch, 0);
+      al_ustr_append_cstr(u->scratch, "h\xc3\xa9llo w\xc3\xb6rld ");
+   }
+}
+
+static void bench_ustr_length(void *data, int n)
+{
+   USTR_DATA *u = data;
+   int i;
+
+   for (i = 0; i < n; i++)
+      u->length = al_ustr_length(u->text);
+}
+
+static void bench_ustr_offset(void *data, int n)
+{
+   USTR_DATA *u = data;
+   int i;
+
+   for (i = 0; i < n; i++)
+      u->length = al_ustr_offset(u->text, i % 1024);
+}
+
+static void bench_ustr_get_next(void *data, int n)
+{
+   USTR_DATA *u = data;
+   int pos;
+   int i;
+
+   for (i = 0; i < n; i++) {
+      pos = 0;
+      while (al_ustr_get_next(u->text, &pos) >= 0)
+         ;
+   }
+}
+
+static void bench_ustr_find(void *data, int n)
+{
+   USTR_DATA *u = data;
+   int i;
+
+   for (i = 0; i < n; i++)
+      u->length = al_ustr_find_str(u->text, 0, u->needle);
+}
+
+static void bench_ustr_dup(void *data, int n)
+{
+   USTR_DATA *u = data;
+   int i;
+
+   for (i = 0; i < n; i++)
+      al_ustr_free(al_ustr_dup(u->text));
+}
+
+static void ustr_benchmarks(void)
+{
+   USTR_DATA u;
+   int size;
+   int i;
+
+   u.text = al_ustr_new("");
+   u.needle = al_ustr_new("n\xc3\xa9\xe6\x97\xa5\xf0\x9f\x98\x80!");
+   u.scratch = al_ustr_new("");
+   for (i = 0; i < 256; i++)
+      al_ustr_append_cstr(u.text, "ab\xc3\xa9\xe6\x97\xa5\xf0\x9f\x98\x80");
+   al_ustr_append(u.text, u.needle);
+   size = al_ustr_size(u.text);
+
+   run_bench("ustr append_cstr", bench_ustr_append, &u, 1, "calls");
+   run_bench("ustr length", bench_ustr_length, &u, size, "bytes");
+   run_bench("ustr offset", bench_ustr_offset, &u, 1, "calls");
+   run_bench("ustr get_next", bench_ustr_get_next, &u, size, "bytes");
+   run_bench("ustr find_str", bench_ustr_find, &u, size, "bytes");
+   run_bench("ustr dup", bench_ustr_dup, &u, size, "bytes");
+
+   al_ustr_free(u.text);
+   al_ustr_free(u.needle);
+   al_ustr_free(u.scratch);
+}
+
+
+/* Paths */
+
+typedef struct PATH_DATA {
+   ALLEGRO_PATH *base;
+   ALLEGRO_PATH *tail;
+   ALLEGRO_PATH *scratch;
+   const char *str;
+} PATH_DATA;
+
+static void bench_path_create(void *data, int n)
+{
+   int i;
+   (void)data;
+
+   for (i = 0; i < n; i++)
+      al_destroy_path(al_create_path("data/levels/world1/tiles/grass.png"));
+}
+
+static void bench_path_clone(void *data, int n)
+{
+   PATH_DATA *p = data;
+   int i;
+
+   for (i = 0; i < n; i++)
+      al_destroy_path(al_clone_path(p->base));
+}
+
+static void bench_path_cstr(void *data, int n)
+{
+   PATH_DATA *p = data;
+   int i;
+
+   for (i = 0; i < n; i++)
+      p->str = al_path_cstr(p->base, '/');
+}
+
+/* A temporary join, reusing one path. */
+static void bench_path_join(void *data, int n)
+{
+   PATH_DATA *p = data;
+   int i;
+
+   for (i = 0; i < n; i++) {
+      al_assign_path(p->scratch, p->base);
+      al_join_paths(p->scratch, p->tail);
+      p->str = al_path_cstr(p->scratch, '/');
+   }
+}
+
+static void path_benchmarks(void)
+{
+   PATH_DATA p;
+
+   p.base = al_create_path("/home/user/games/data/levels/world1/");
+   p.tail = al_create_path("tiles/grass.png");
+   p.scratch = al_create_path(NULL);
+
+   run_bench("path create", bench_path_create, &p, 1, "paths");
+   run_bench("path clone", bench_path_clone, &p, 1, "paths");
+   run_bench("path cstr", bench_path_cstr, &p, 1, "calls");
+   run_bench("path join", bench_path_join, &p, 1, "joins");
+
+   al_destroy_path(p.base);
+   al_destroy_path(p.tail);
+   al_destroy_path(p.scratch);
+}
+
+
+/* Configuration files */
+
+#define CONFIG_SECTIONS 64
+#define CONFIG_KEYS     32
+
+typedef struct CONFIG_DATA {
+   ALLEGRO_CONFIG *config;
+   char sections[CONFIG_SECTIONS][16];
+   char keys[CONFIG_KEYS][16];
+   char const *value;
+} CONFIG_DATA;
+
+static void bench_config_get(void *data, int n)
+{
+   CONFIG_DATA *c = data;
+   int i;
+
+   for (i = 0; i < n; i++) {
+      c->value = al_get_config_value(c->config,
+         c->sections[i % CONFIG_SECTIONS], c->keys[(i / 7) % CONFIG_KEYS]);
+   }
+}
+
+static void bench_config_get_missing(void *data, int n)
+{
+   CONFIG_DATA *c = data;
+   int i;
+
+   for (i = 0; i < n; i++) {
+      c->value = al_get_config_value(c->config,
+         c->sections[i % CONFIG_SECTIONS], "missing");
+   }
+}
+
+static void config_benchmarks(void)
+{
+   CONFIG_DATA *c = calloc(1, sizeof(*c));
+   int i, j;
+
+   if (!c)
+      fatal_error("out of memory");
+   c->config = al_create_config();
+   for (i = 0; i < CONFIG_SECTIONS; i++)
+      snprintf(c->sections[i], sizeof(c->sections[i]), "section%d", i);
+   for (j = 0; j < CONFIG_KEYS; j++)
+      snprintf(c->keys[j], sizeof(c->keys[j]), "key%d", j);
+   for (i = 0; i < CONFIG_SECTIONS; i++) {
+      for (j = 0; j < CONFIG_KEYS; j++)
+         al_set_config_value(c->config, c->sections[i], c->keys[j], "value");
+   }
+
+   run_bench("config get_value", bench_config_get, c, 1, "lookups");
+   run_bench("config get_value missing", bench_config_get_missing, c, 1,
+      "lookups");
+
+   al_destroy_config(c->config);
+   free(c);
+}
+
+
+/* Internal containers */
+
+#define CONTAINER_SIZE  1024
+
+typedef struct CONTAINER_DATA {
+   _AL_VECTOR vector;
+   int keys[CONTAINER_SIZE];
+   _AL_AATREE *tree;
+   int sum;
+} CONTAINER_DATA;
+
+static int compare_ints(const void *a, const void *b)
+{
+   return *(const int *)a - *(const int *)b;
+}
+
+static void bench_vector_alloc_back(void *data, int n)
+{
+   CONTAINER_DATA *c = data;
+   int i;
+
+   for (i = 0; i < n; i++) {
+      int *slot = _al_vector_alloc_back(&c->vector);
+      *slot = i;
+      if (_al_vector_size(&c->vector) >= CONTAINER_SIZE)
+         _al_vector_free(&c->vector);
+   }
+   _al_vector_free(&c->vector);
+}
+
+static void bench_vector_ref(void *data, int n)
+{
+   CONTAINER_DATA *c = data;
+   int i;
+
+   for (i = 0; i < n; i++)
+      c->sum += *(int *)_al_vector_ref(&c->vector, i % CONTAINER_SIZE);
+}
+
+static void bench_vector_find(void *data, int n)
+{
+   CONTAINER_DATA *c = data;
+   int i;
+
+   for (i = 0; i < n; i++)
+      c->sum += _al_vector_find(&c->vector, &c->keys[(i * 37) % CONTAINER_SIZE]);
+}
+
+static void bench_aa_insert(void *data, int n)
+{
+   CONTAINER_DATA *c = data;
+   _AL_AATREE *tree = NULL;
+   int i;
+
+   for (i = 0; i < n; i++) {
+      int *key = &c->keys[(i * 37) % CONTAINER_SIZE];
+      tree = _al_aa_insert(tree, key, key, compare_ints);
+      if ((i + 1) % CONTAINER_SIZE == 0) {
+         _al_aa_free(tree);
+         tree = NULL;
+      }
+   }
+   _al_aa_free(tree);
+}
+
+static void bench_aa_search(void *data, int n)
+{
+   CONTAINER_DATA *c = data;
+   int i;
+
+   for (i = 0; i < n; i++) {
+      int *value = _al_aa_search(c->tree, &c->keys[(i * 37) % CONTAINER_SIZE],
+         compare_ints);
+      c->sum += *value;
+   }
+}
+
+static void container_benchmarks(void)
+{
+   CONTAINER_DATA *c = calloc(1, sizeof(*c));
+   int i;
+
+   if (!c)
+      fatal_error("out of memory");
+   _al_vector_init(&c->vector, sizeof(int));
+
+   run_bench("vector alloc_back", bench_vector_alloc_back, c, 1, "calls");
+
+   for (i = 0; i < CONTAINER_SIZE; i++) {
+      c->keys[i] = i;
+      *(int *)_al_vector_alloc_back(&c->vector) = i;
+      c->tree = _al_aa_insert(c->tree, &c->keys[i], &c->keys[i], compare_ints);
+   }
+
+   run_bench("vector ref", bench_vector_ref, c, 1, "calls");
+   run_bench("vector find", bench_vector_find, c, 1, "calls");
+   run_bench("aatree insert", bench_aa_insert, c, 1, "calls");
+   run_bench("aatree search", bench_aa_search, c, 1, "calls");
+
+   _al_aa_free(c->tree);
+   _al_vector_free(&c->vector);
+   free(c);
+}
+
+
+static void print_help(void)
+{
+   printf(
+      "Microbenchmarks of the core library, printed as JSON.\n\n"
+      "Usage: bench_core [OPTIONS] [BENCHMARK-PREFIX...]\n"
+      "\n"
+      "Options:\n"
+      " -t, --time SECONDS    run each benchmark for at least SECONDS "
+      "(default 0.1)\n"
+      " -o, --output FILE     write the results to FILE\n"
+      " -n, --no-display      skip the benchmarks which need a display\n"
+      "\n"
+      "Only the benchmarks whose names start with one of the prefixes are\n"
+      "run, e.g. bench_core 'convert ARGB_8888' 'lock memory'\n");
+}
+
+int main(int argc, char const *argv[])
+{
+   char const *output = NULL;
+
+   out = stdout;
+   filters = calloc(argc, sizeof(char *));
+   if (!filters)
+      fatal_error("out of memory");
+
+   argc--;
+   argv++;
+   while (argc > 0) {
+      char const *opt = argv[0];
+      if (strcmp(opt, "-t") == 0 || strcmp(opt, "--time") == 0) {
+         if (argc < 2)
+            fatal_error("%s needs an argument", opt);
+         min_time = atof(argv[1]);
+         argc--;
+         argv++;
+      }
+      else if (strcmp(opt, "-o") == 0 || strcmp(opt, "--output") == 0) {
+         if (argc < 2)
+            fatal_error("%s needs an argument", opt);
+         output = argv[1];
+         argc--;
+         argv++;
+      }
+      else if (strcmp(opt, "-n") == 0 || strcmp(opt, "--no-display") == 0) {
+         want_display = false;
+      }
+      else if (strcmp(opt, "-h") == 0 || strcmp(opt, "--help") == 0) {
+         print_help();
+         return 0;
+      }
+      else {
+         filters[num_filters++] = (char *)opt;
+      }
+      argc--;
+      argv++;
+   }
+
+   if (!al_init())
+      fatal_error("failed to initialise Allegro");
+
+   if (output) {
+      out = fopen(output, "w");
+      if (!out)
+         fatal_error("failed to open %s", output);
+   }
+
+   fprintf(out, "{\n  \"min_time\": %.3f,\n  \"benchmarks\": [", min_time);
+
+   convert_benchmarks();
+   blend_benchmarks();
+   event_benchmarks();
+   lock_benchmarks();
+   ustr_benchmarks();
+   path_benchmarks();
+   config_benchmarks();
+   container_benchmarks();
+
+   fprintf(out, "\n  ]\n}\n");
+   if (out != stdout)
+      fclose(out);
+
+   free(filters);
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
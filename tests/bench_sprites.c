@@ -0,0 +1,369 @@
+/*
+ * Sprite throughput benchmark.
+ *
+ * A scripted version of what ex_draw_bitmap and the speed demo show on
+ * screen: N sprites from K textures are drawn into an offscreen video
+ * bitmap for a fixed number of frames, with and without held drawing and
+ * with tinting, rotation and scaling, on each display driver. The sprites
+ * move the same way on every run. The results are printed as JSON.
+ * See test_driver.txt for the options.
+ */
+
+#define ALLEGRO_UNSTABLE
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <allegro5/allegro.h>
+
+#define TEXTURE_SIZE    32
+#define TARGET_W        800
+#define TARGET_H        600
+
+typedef struct SPRITE {
+   float x, y;
+   float dx, dy;
+   float angle, spin;
+   int texture;
+} SPRITE;
+
+typedef struct CASE {
+   char const *name;
+   bool tint;
+   bool rotate;
+   bool scale;
+} CASE;
+
+static const CASE cases[] = {
+   { "plain",        false,   false,   false },
+   { "tinted",       true,    false,   false },
+   { "rotated",      false,   true,    false },
+   { "scaled",       false,   false,   true  },
+   { "transformed",  true,    true,    true  },
+   { NULL,           false,   false,   false }
+};
+
+typedef struct BACKEND {
+   char const *name;
+   int flags;
+} BACKEND;
+
+static const BACKEND backends[] = {
+   { "opengl",       ALLEGRO_OPENGL },
+#ifdef ALLEGRO_WINDOWS
+   { "direct3d",     ALLEGRO_DIRECT3D },
+#endif
+   { NULL,           0 }
+};
+
+int               num_sprites = 2000;
+int               num_textures = 4;
+int               num_frames = 200;
+char const       *only_backend = NULL;
+FILE             *out;
+int               num_results = 0;
+
+SPRITE           *sprites;
+ALLEGRO_BITMAP  **textures;
+
+static void fatal_error(char const *msg, ...)
+{
+   va_list ap;
+
+   va_start(ap, msg);
+   fprintf(stderr, "bench_sprites: ");
+   vfprintf(stderr, msg, ap);
+   fprintf(stderr, "\n");
+   va_end(ap);
+   exit(EXIT_FAILURE);
+}
+
+/* A fixed random sequence, so that every run draws the same frames. */
+static unsigned int rng_state;
+
+static float rng(float min, float max)
+{
+   rng_state = rng_state * 1103515245 + 12345;
+   return min + (max - min) * ((rng_state >> 8) & 0xffff) / 65535.0f;
+}
+
+static void init_sprites(void)
+{
+   int i;
+
+   rng_state = 1;
+   for (i = 0; i < num_sprites; i++) {
+      SPRITE *s = &sprites[i];
+      s->x = rng(0, TARGET_W - TEXTURE_SIZE);
+      s->y = rng(0, TARGET_H - TEXTURE_SIZE);
+      s->dx = rng(-4, 4);
+      s->dy = rng(-4, 4);
+      s->angle = rng(0, 2 * ALLEGRO_PI);
+      s->spin = rng(-0.1, 0.1);
+      /* Interleaved, so that held drawing has to switch textures. */
+      s->texture = i % num_textures;
+   }
+}
+
+static void update_sprites(void)
+{
+   int i;
+
+   for (i = 0; i < num_sprites; i++) {
+      SPRITE *s = &sprites[i];
+      s->x += s->dx;
+      s->y += s->dy;
+      if (s->x < 0 || s->x > TARGET_W - TEXTURE_SIZE)
+         s->dx = -s->dx;
+      if (s->y < 0 || s->y > TARGET_H - TEXTURE_SIZE)
+         s->dy = -s->dy;
+      s->angle += s->spin;
+   }
+}
+
+static bool create_textures(void)
+{
+   static const float colors[4][3] = {
+      { 1, 0.5, 0.5 }, { 0.5, 1, 0.5 }, { 0.5, 0.5, 1 }, { 1, 1, 0.5 }
+   };
+   int i, x, y;
+
+   al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
+   for (i = 0; i < num_textures; i++) {
+      textures[i] = al_create_bitmap(TEXTURE_SIZE, TEXTURE_SIZE);
+      if (!textures[i])
+         return false;
+      al_set_target_bitmap(textures[i]);
+      al_lock_bitmap(textures[i], ALLEGRO_PIXEL_FORMAT_ANY,
+         ALLEGRO_LOCK_WRITEONLY);
+      for (y = 0; y < TEXTURE_SIZE; y++) {
+         for (x = 0; x < TEXTURE_SIZE; x++) {
+            float dx = x - TEXTURE_SIZE / 2 + 0.5f;
+            float dy = y - TEXTURE_SIZE / 2 + 0.5f;
+            float a = 1.0f - sqrtf(dx * dx + dy * dy) / (TEXTURE_SIZE / 2);
+            if (a < 0)
+               a = 0;
+            al_put_pixel(x, y, al_map_rgba_f(a * colors[i % 4][0],
+               a * colors[i % 4][1], a * colors[i % 4][2], a));
+         }
+      }
+      al_unlock_bitmap(textures[i]);
+   }
+   return true;
+}
+
+static void destroy_textures(void)
+{
+   int i;
+
+   for (i = 0; i < num_textures; i++) {
+      al_destroy_bitmap(textures[i]);
+      textures[i] = NULL;
+   }
+}
+
+static void draw_sprites(const CASE *c)
+{
+   ALLEGRO_COLOR white = al_map_rgb_f(1, 1, 1);
+   float half = TEXTURE_SIZE / 2;
+   int i;
+
+   for (i = 0; i < num_sprites; i++) {
+      SPRITE *s = &sprites[i];
+      ALLEGRO_BITMAP *bmp = textures[s->texture];
+      ALLEGRO_COLOR tint = white;
+      float scale = 1;
+
+      if (c->tint)
+         tint = al_map_rgba_f(1, (i & 3) / 3.0f, (i & 7) / 7.0f, 1);
+      if (c->scale)
+         scale = 0.5f + (i & 15) / 10.0f;
+
+      if (c->rotate || c->scale) {
+         al_draw_tinted_scaled_rotated_bitmap(bmp, tint, half, half,
+            s->x + half, s->y + half, scale, scale,
+            c->rotate ? s->angle : 0, 0);
+      }
+      else {
+         al_draw_tinted_bitmap(bmp, tint, s->x, s->y, 0);
+      }
+   }
+}
+
+/* Draws num_frames frames into target. The time spent in the drawing calls
+ * is counted as Allegro's, the time spent in al_flip_display, where the
+ * driver catches up with the queued work, as the driver's.
+ */
+static void run_case(ALLEGRO_DISPLAY *display, ALLEGRO_BITMAP *target,
+   char const *backend, const CASE *c, bool hold)
+{
+   ALLEGRO_DISPLAY_STATS stats;
+   double allegro_time = 0;
+   double driver_time = 0;
+   double start, t0, t1;
+   int frame;
+
+   init_sprites();
+
+   /* One frame to warm up the driver's caches. */
+   al_set_target_bitmap(target);
+   draw_sprites(c);
+   al_set_target_backbuffer(display);
+   al_flip_display();
+   al_reset_display_stats(display);
+
+   start = al_get_time();
+   for (frame = 0; frame < num_frames; frame++) {
+      t0 = al_get_time();
+      al_set_target_bitmap(target);
+      al_clear_to_color(al_map_rgb(0, 0, 0));
+      if (hold)
+         al_hold_bitmap_drawing(true);
+      draw_sprites(c);
+      if (hold)
+         al_hold_bitmap_drawing(false);
+      al_set_target_backbuffer(display);
+      al_draw_bitmap(target, 0, 0, 0);
+      t1 = al_get_time();
+      al_flip_display();
+      allegro_time += t1 - t0;
+      driver_time += al_get_time() - t1;
+      update_sprites();
+   }
+   al_get_display_stats(display, &stats);
+
+   fprintf(out, "%s\n    {\"backend\": \"%s\", \"case\": \"%s\", "
+      "\"held\": %s, \"sprites\": %d, \"textures\": %d, \"frames\": %d, "
+      "\"fps\": %.1f, \"allegro_ms_per_frame\": %.3f, "
+      "\"driver_ms_per_frame\": %.3f, \"gpu_ms_last_frame\": %.3f, "
+      "\"draw_calls_per_frame\": %.1f, \"texture_flushes_per_frame\": %.1f}",
+      num_results > 0 ? "," : "", backend, c->name, hold ? "true" : "false",
+      num_sprites, num_textures, num_frames,
+      num_frames / (al_get_time() - start),
+      1000 * allegro_time / num_frames, 1000 * driver_time / num_frames,
+      1000 * stats.gpu_frame_time,
+      (double)stats.draw_calls / num_frames,
+      (double)stats.texture_flushes / num_frames);
+   fflush(out);
+   num_results++;
+}
+
+static void run_backend(const BACKEND *b)
+{
+   ALLEGRO_DISPLAY *display;
+   ALLEGRO_BITMAP *target;
+   ALLEGRO_DISPLAY_STATS stats;
+   int i;
+
+   al_set_new_display_flags(b->flags);
+   al_set_new_display_option(ALLEGRO_VSYNC, 2, ALLEGRO_SUGGEST);
+   display = al_create_display(TARGET_W, TARGET_H);
+   if (!display) {
+      fprintf(stderr, "bench_sprites: skipping %s, no display\n", b->name);
+      return;
+   }
+   /* Starts the GPU timing. */
+   al_get_display_stats(display, &stats);
+
+   al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
+   target = al_create_bitmap(TARGET_W, TARGET_H);
+   if (!target || !create_textures())
+      fatal_error("failed to create bitmaps for %s", b->name);
+
+   for (i = 0; cases[i].name; i++) {
+      run_case(display, target, b->name, &cases[i], false);
+      run_case(display, target, b->name, &cases[i], true);
+   }
+
+   destroy_textures();
+   al_destroy_bitmap(target);
+   al_destroy_display(display);
+}
+
+static void print_help(void)
+{
+   printf(
+      "Sprite throughput benchmark, printed as JSON.\n\n"
+      "Usage: bench_sprites [OPTIONS]\n"
+      "\n"
+      "Options:\n"
+      " -s, --sprites N       draw N sprites per frame (default 2000)\n"
+      " -k, --textures K      take the sprites from K textures (default 4)\n"
+      " -f, --frames F        draw F frames per case (default 200)\n"
+      " -b, --backend NAME    only use the opengl or direct3d driver\n"
+      " -o, --output FILE     write the results to FILE\n");
+}
+
+static int int_arg(char const *opt, char const *value)
+{
+   int i = atoi(value);
+   if (i < 1)
+      fatal_error("%s needs a positive number", opt);
+   return i;
+}
+
+int main(int argc, char const *argv[])
+{
+   char const *output = NULL;
+   int i;
+
+   out = stdout;
+
+   argc--;
+   argv++;
+   while (argc > 0) {
+      char const *opt = argv[0];
+      if (strcmp(opt, "-h") == 0 || strcmp(opt, "--help") == 0) {
+         print_help();
+         return 0;
+      }
+      if (argc < 2)
+         fatal_error("unknown option or missing argument: %s", opt);
+      if (strcmp(opt, "-s") == 0 || strcmp(opt, "--sprites") == 0)
+         num_sprites = int_arg(opt, argv[1]);
+      else if (strcmp(opt, "-k") == 0 || strcmp(opt, "--textures") == 0)
+         num_textures = int_arg(opt, argv[1]);
+      else if (strcmp(opt, "-f") == 0 || strcmp(opt, "--frames") == 0)
+         num_frames = int_arg(opt, argv[1]);
+      else if (strcmp(opt, "-b") == 0 || strcmp(opt, "--backend") == 0)
+         only_backend = argv[1];
+      else if (strcmp(opt, "-o") == 0 || strcmp(opt, "--output") == 0)
+         output = argv[1];
+      else
+         fatal_error("unknown option: %s", opt);
+      argc -= 2;
+      argv += 2;
+   }
+
+   if (!al_init())
+      fatal_error("failed to initialise Allegro");
+
+   sprites = calloc(num_sprites, sizeof(*sprites));
+   textures = calloc(num_textures, sizeof(*textures));
+   if (!sprites || !textures)
+      fatal_error("out of memory");
+
+   if (output) {
+      out = fopen(output, "w");
+      if (!out)
+         fatal_error("failed to open %s", output);
+   }
+
+   fprintf(out, "{\n  \"results\": [");
+   for (i = 0; backends[i].name; i++) {
+      if (only_backend && strcmp(only_backend, backends[i].name) != 0)
+         continue;
+      run_backend(&backends[i]);
+   }
+   fprintf(out, "\n  ]\n}\n");
+   if (out != stdout)
+      fclose(out);
+
+   free(sprites);
+   free(textures);
+   return num_results > 0 ? 0 : 1;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -19,8 +19,10 @@
 #define MAX_BITMAPS  128
 #define MAX_TRANS    8
 #define MAX_FONTS    16
-#define MAX_VERTICES 100
+#define MAX_VERTICES 512
 #define MAX_POLYGONS 8
+#define MAX_FILES    8
+#define MAX_ARCHIVES 4
 
 typedef struct {
    ALLEGRO_USTR   *name;
@@ -50,6 +52,16 @@ typedef struct {
    ALLEGRO_FONT   *font;
 } NamedFont;
 
+typedef struct {
+   ALLEGRO_USTR   *name;
+   ALLEGRO_FILE   *file;
+} NamedFile;
+
+typedef struct {
+   ALLEGRO_USTR      *name;
+   ALLEGRO_ARCHIVE   *archive;
+} NamedArchive;
+
 int               argc;
 char              **argv;
 ALLEGRO_DISPLAY   *display;
@@ -58,6 +70,8 @@ Bitmap            bitmaps[MAX_BITMAPS];
 LockRegion        lock_region;
 Transform         transforms[MAX_TRANS];
 NamedFont         fonts[MAX_FONTS];
+NamedFile         files[MAX_FILES];
+NamedArchive      archives[MAX_ARCHIVES];
 ALLEGRO_VERTEX    vertices[MAX_VERTICES];
 float             simple_vertices[2 * MAX_VERTICES];
 int               num_simple_vertices;
@@ -69,6 +83,12 @@ bool              save_on_failure = false;
 bool              quiet = false;
 bool              want_display = true;
 bool              on_xvfb = true;
+bool              benchmark = false;
+int               repeat = 0;
+char const        *baseline_file = NULL;
+char const        *save_baseline_file = NULL;
+ALLEGRO_CONFIG    *baseline;
+ALLEGRO_CONFIG    *bench_results;
 int               verbose = 0;
 int               total_tests = 0;
 int               passed_tests = 0;
@@ -393,6 +413,16 @@ static int get_pixel_format(char const *v)
       : streq(v, "ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1") ? ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1
       : streq(v, "ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3") ? ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3
       : streq(v, "ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5") ? ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5
+      : streq(v, "ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4") ? ALLEGRO_PIXEL_FORMAT_COMPRESSED_R_BC4
+      : streq(v, "ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5") ? ALLEGRO_PIXEL_FORMAT_COMPRESSED_RG_BC5
+      : streq(v, "ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_BC7") ? ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_BC7
+      : streq(v, "ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGB_ETC2") ? ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGB_ETC2
+      : streq(v, "ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ETC2") ? ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ETC2
+      : streq(v, "ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_4x4") ? ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_4x4
+      : streq(v, "ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_6x6") ? ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_6x6
+      : streq(v, "ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x8") ? ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x8
+      : streq(v, "ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB") ? ALLEGRO_PIXEL_FORMAT_ARGB_8888_SRGB
+      : streq(v, "ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB") ? ALLEGRO_PIXEL_FORMAT_ABGR_8888_SRGB
       : -1;
    if (format == -1)
       fatal_error("invalid format: %s", v);
@@ -411,6 +441,8 @@ static int get_bitmap_flags(char const *v)
 {
    return streq(v, "ALLEGRO_MEMORY_BITMAP") ? ALLEGRO_MEMORY_BITMAP
       : streq(v, "ALLEGRO_VIDEO_BITMAP") ? ALLEGRO_VIDEO_BITMAP
+      : streq(v, "ALLEGRO_MEMORY_BITMAP|ALLEGRO_TILED_BITMAP")
+         ? ALLEGRO_MEMORY_BITMAP|ALLEGRO_TILED_BITMAP
       : atoi(v);
 }
 
@@ -439,6 +471,36 @@ static void fill_lock_region(LockRegion *lr, float alphafactor, bool blended)
    }
 }
 
+/* Copy a rectangle row by row with al_get_pixel_row and al_put_pixel_span,
+ * or their _format variants unless format is ALLEGRO_PIXEL_FORMAT_ANY.
+ */
+static void copy_pixel_rows(ALLEGRO_BITMAP *src, int sx, int sy, int w, int h,
+   int dx, int dy, int format)
+{
+   void *row;
+   int y;
+
+   if (format == ALLEGRO_PIXEL_FORMAT_ANY)
+      row = malloc(w * sizeof(ALLEGRO_COLOR));
+   else
+      row = malloc(w * al_get_pixel_size(format));
+   if (!row)
+      return;
+
+   for (y = 0; y < h; y++) {
+      if (format == ALLEGRO_PIXEL_FORMAT_ANY) {
+         al_get_pixel_row(src, sx, sy + y, w, row);
+         al_put_pixel_span(dx, dy + y, w, row);
+      }
+      else {
+         al_get_pixel_row_format(src, sx, sy + y, w, row, format);
+         al_put_pixel_span_format(dx, dy + y, w, row, format);
+      }
+   }
+
+   free(row);
+}
+
 static int get_load_font_flags(char const *v)
 {
    return streq(v, "ALLEGRO_NO_PREMULTIPLIED_ALPHA") ? ALLEGRO_NO_PREMULTIPLIED_ALPHA
@@ -514,6 +576,104 @@ static ALLEGRO_FONT *get_font(char const *name)
    return NULL;
 }
 
+static ALLEGRO_FILE **reserve_file(char const *name)
+{
+   int i;
+
+   for (i = 0; i < MAX_FILES; i++) {
+      if (!files[i].name) {
+         files[i].name = al_ustr_new(name);
+         return &files[i].file;
+      }
+   }
+
+   fatal_error("file limit reached");
+   return NULL;
+}
+
+static ALLEGRO_FILE *get_file(char const *name)
+{
+   int i;
+
+   for (i = 0; i < MAX_FILES; i++) {
+      if (files[i].name && streq(al_cstr(files[i].name), name))
+         return files[i].file;
+   }
+
+   fatal_error("undefined file: %s", name);
+   return NULL;
+}
+
+static void close_file(char const *name)
+{
+   int i;
+
+   for (i = 0; i < MAX_FILES; i++) {
+      if (files[i].name && streq(al_cstr(files[i].name), name)) {
+         al_fclose(files[i].file);
+         al_ustr_free(files[i].name);
+         files[i].name = NULL;
+         files[i].file = NULL;
+         return;
+      }
+   }
+
+   fatal_error("undefined file: %s", name);
+}
+
+static ALLEGRO_ARCHIVE **reserve_archive(char const *name)
+{
+   int i;
+
+   for (i = 0; i < MAX_ARCHIVES; i++) {
+      if (!archives[i].name) {
+         archives[i].name = al_ustr_new(name);
+         return &archives[i].archive;
+      }
+   }
+
+   fatal_error("archive limit reached");
+   return NULL;
+}
+
+static ALLEGRO_ARCHIVE *get_archive(char const *name)
+{
+   int i;
+
+   for (i = 0; i < MAX_ARCHIVES; i++) {
+      if (archives[i].name && streq(al_cstr(archives[i].name), name))
+         return archives[i].archive;
+   }
+
+   fatal_error("undefined archive: %s", name);
+   return NULL;
+}
+
+static void close_archive(char const *name)
+{
+   int i;
+
+   for (i = 0; i < MAX_ARCHIVES; i++) {
+      if (archives[i].name && streq(al_cstr(archives[i].name), name)) {
+         al_close_archive(archives[i].archive);
+         al_ustr_free(archives[i].name);
+         archives[i].name = NULL;
+         archives[i].archive = NULL;
+         return;
+      }
+   }
+
+   fatal_error("undefined archive: %s", name);
+}
+
+static int get_seek_whence(char const *value)
+{
+   return streq(value, "ALLEGRO_SEEK_SET") ? ALLEGRO_SEEK_SET
+      : streq(value, "ALLEGRO_SEEK_CUR") ? ALLEGRO_SEEK_CUR
+      : streq(value, "ALLEGRO_SEEK_END") ? ALLEGRO_SEEK_END
+      : atoi(value);
+}
+
 static int get_font_align(char const *value)
 {
    return streq(value, "ALLEGRO_ALIGN_LEFT") ? ALLEGRO_ALIGN_LEFT
@@ -941,8 +1101,9 @@ static bool check_similarity(ALLEGRO_CONFIG const *cfg,
    }
 }
 
-static bool do_test(ALLEGRO_CONFIG *cfg, char const *testname,
-   ALLEGRO_BITMAP *target, int bmp_type, bool reliable, bool do_check_hash)
+/* Returns the number of statements run. */
+static int run_statements(ALLEGRO_CONFIG *cfg, char const *testname,
+   ALLEGRO_BITMAP *target, int bmp_type)
 {
 #define MAXBUF    80
 
@@ -952,15 +1113,7 @@ static bool do_test(ALLEGRO_CONFIG *cfg, char const *testname,
    char buf[MAXBUF];
    char arg[14][MAXBUF];
    char lval[MAXBUF];
-   int i;
-
-   if (verbose) {
-      /* So in case it segfaults, we know which test to re-run. */
-      printf("\nRunning %s [%s].\n", testname, bmp_type_to_string(bmp_type));
-      fflush(stdout);
-   }
-
-   set_target_reset(target);
+   int num_stmts = 0;
 
    for (op = 0; ; op++) {
       sprintf(buf, "op%d", op);
@@ -981,6 +1134,8 @@ static bool do_test(ALLEGRO_CONFIG *cfg, char const *testname,
       if (streq(stmt, ""))
          continue;
 
+      num_stmts++;
+
       if (SCAN("al_set_target_bitmap", 1)) {
          al_set_target_bitmap(B(0));
          continue;
@@ -1212,6 +1367,20 @@ static bool do_test(ALLEGRO_CONFIG *cfg, char const *testname,
          continue;
       }
 
+      /* Masking */
+      if (SCAN("al_convert_mask_to_alpha", 2)) {
+         al_convert_mask_to_alpha(B(0), C(1));
+         continue;
+      }
+      if (SCAN("al_set_bitmap_color_key", 2)) {
+         al_set_bitmap_color_key(B(0), C(1));
+         continue;
+      }
+      if (SCAN("al_clear_bitmap_color_key", 1)) {
+         al_clear_bitmap_color_key(B(0));
+         continue;
+      }
+
       /* Locking */
       if (SCAN("al_lock_bitmap", 3)) {
          ALLEGRO_BITMAP *bmp = B(0);
@@ -1237,6 +1406,19 @@ static bool do_test(ALLEGRO_CONFIG *cfg, char const *testname,
             get_lock_bitmap_flags(V(6)));
          continue;
       }
+      if (SCANLVAL("al_lock_bitmap_region", 7)) {
+         /* Only whether the lock succeeded is kept, the region is not filled. */
+         ALLEGRO_LOCKED_REGION *lr = al_lock_bitmap_region(B(0),
+            I(1), I(2), I(3), I(4),
+            get_pixel_format(V(5)),
+            get_lock_bitmap_flags(V(6)));
+         set_config_int(cfg, testname, lval, lr != NULL);
+         continue;
+      }
+      if (SCANLVAL("al_is_bitmap_locked", 1)) {
+         set_config_int(cfg, testname, lval, al_is_bitmap_locked(B(0)));
+         continue;
+      }
       if (SCAN("al_unlock_bitmap", 1)) {
          al_unlock_bitmap(B(0));
          lock_region.lr = NULL;
@@ -1246,6 +1428,11 @@ static bool do_test(ALLEGRO_CONFIG *cfg, char const *testname,
          fill_lock_region(&lock_region, F(0), get_bool(V(1)));
          continue;
       }
+      if (SCAN("copy_pixel_rows", 8)) {
+         copy_pixel_rows(B(0), I(1), I(2), I(3), I(4), I(5), I(6),
+            get_pixel_format(V(7)));
+         continue;
+      }
 
       /* Fonts */
       if (SCAN("al_draw_text", 6)) {
@@ -1291,6 +1478,100 @@ static bool do_test(ALLEGRO_CONFIG *cfg, char const *testname,
          al_set_fallback_font(get_font(V(0)), get_font(V(1)));
          continue;
       }
+      if (SCAN("al_set_text_layout_cache_size", 1)) {
+         al_set_text_layout_cache_size(I(0));
+         continue;
+      }
+      if (SCANLVAL("al_save_ttf_glyph_cache", 2)) {
+         bool ret = al_save_ttf_glyph_cache(get_font(V(0)), V(1));
+         set_config_int(cfg, testname, lval, ret);
+         continue;
+      }
+      if (SCANLVAL("al_load_ttf_glyph_cache", 2)) {
+         bool ret = al_load_ttf_glyph_cache(get_font(V(0)), V(1));
+         set_config_int(cfg, testname, lval, ret);
+         continue;
+      }
+      if (SCANLVAL("al_load_font", 3)) {
+         /* Only whether the font could be loaded is kept. */
+         ALLEGRO_FONT *font = al_load_font(V(0), I(1),
+            get_load_font_flags(V(2)));
+         set_config_int(cfg, testname, lval, font != NULL);
+         al_destroy_font(font);
+         continue;
+      }
+
+      /* Files */
+      if (SCANLVAL("al_fopen", 2)) {
+         ALLEGRO_FILE **f = reserve_file(lval);
+         *f = al_fopen(V(0), V(1));
+         if (!*f)
+            fatal_error("failed to open %s", V(0));
+         continue;
+      }
+      if (SCAN("al_fclose", 1)) {
+         close_file(V(0));
+         continue;
+      }
+      if (SCAN("al_fseek", 3)) {
+         al_fseek(get_file(V(0)), I(1), get_seek_whence(V(2)));
+         continue;
+      }
+      if (SCAN("al_fwrite32le", 2)) {
+         al_fwrite32le(get_file(V(0)), I(1));
+         continue;
+      }
+      if (SCAN("al_fputc", 2)) {
+         al_fputc(get_file(V(0)), I(1));
+         continue;
+      }
+      if (SCAN("al_fputs", 2)) {
+         al_fputs(get_file(V(0)), V(1));
+         continue;
+      }
+      if (SCAN("al_set_file_read_buffer_size", 2)) {
+         al_set_file_read_buffer_size(get_file(V(0)), I(1));
+         continue;
+      }
+      if (SCANLVAL("al_fread", 2)) {
+         /* Only the number of bytes read is kept. */
+         void *buf = al_malloc(I(1));
+         size_t n = al_fread(get_file(V(0)), buf, I(1));
+         al_free(buf);
+         set_config_int(cfg, testname, lval, n);
+         continue;
+      }
+      if (SCANLVAL("al_fgetc", 1)) {
+         int c = al_fgetc(get_file(V(0)));
+         set_config_int(cfg, testname, lval, c);
+         continue;
+      }
+      if (SCANLVAL("al_fgets", 2)) {
+         ALLEGRO_FILE *f = get_file(V(0));
+         char buf[80];
+         char const *line = NULL;
+         if (f && I(1) <= (int)sizeof(buf))
+            line = al_fgets(f, buf, I(1));
+         al_set_config_value(cfg, testname, lval, line ? line : "NULL");
+         continue;
+      }
+
+      /* Archives */
+      if (SCANLVAL("al_open_archive", 1)) {
+         ALLEGRO_ARCHIVE **archive = reserve_archive(lval);
+         *archive = al_open_archive(V(0));
+         continue;
+      }
+      if (SCAN("al_close_archive", 1)) {
+         close_archive(V(0));
+         continue;
+      }
+      if (SCANLVAL("al_fopen_archive_entry", 2)) {
+         ALLEGRO_ARCHIVE *archive = get_archive(V(0));
+         ALLEGRO_FILE **f = reserve_file(lval);
+         *f = archive ? al_fopen_archive_entry(archive, V(1)) : NULL;
+         continue;
+      }
 
       /* Primitives */
       if (SCAN("al_draw_line", 6)) {
@@ -1523,6 +1804,53 @@ static bool do_test(ALLEGRO_CONFIG *cfg, char const *testname,
       fatal_error("statement didn't scan: %s", stmt);
    }
 
+   return num_stmts;
+#undef MAXBUF
+}
+
+static void free_test_data(int bmp_type)
+{
+   int i;
+
+   /* Destroy local bitmaps. */
+   for (i = num_global_bitmaps; i < MAX_BITMAPS; i++) {
+      if (bitmaps[i].name) {
+         al_ustr_free(bitmaps[i].name);
+         bitmaps[i].name = NULL;
+         al_destroy_bitmap(bitmaps[i].bitmap[bmp_type]);
+         bitmaps[i].bitmap[bmp_type] = NULL;
+      }
+   }
+
+   /* Free transform names. */
+   for (i = 0; i < MAX_TRANS; i++) {
+      al_ustr_free(transforms[i].name);
+      transforms[i].name = NULL;
+   }
+
+   /* Close files and archives left open. */
+   for (i = 0; i < MAX_FILES; i++) {
+      if (files[i].name)
+         close_file(al_cstr(files[i].name));
+   }
+   for (i = 0; i < MAX_ARCHIVES; i++) {
+      if (archives[i].name)
+         close_archive(al_cstr(archives[i].name));
+   }
+}
+
+static bool do_test(ALLEGRO_CONFIG *cfg, char const *testname,
+   ALLEGRO_BITMAP *target, int bmp_type, bool reliable, bool do_check_hash)
+{
+   if (verbose) {
+      /* So in case it segfaults, we know which test to re-run. */
+      printf("\nRunning %s [%s].\n", testname, bmp_type_to_string(bmp_type));
+      fflush(stdout);
+   }
+
+   set_target_reset(target);
+   run_statements(cfg, testname, target, bmp_type);
+
    al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ANY_WITH_ALPHA);
 
    bool good;
@@ -1554,25 +1882,9 @@ static bool do_test(ALLEGRO_CONFIG *cfg, char const *testname,
 
    /* Ensure we don't target a bitmap which is about to be destroyed. */
    al_set_target_bitmap(display ? al_get_backbuffer(display) : NULL);
-
-   /* Destroy local bitmaps. */
-   for (i = num_global_bitmaps; i < MAX_BITMAPS; i++) {
-      if (bitmaps[i].name) {
-         al_ustr_free(bitmaps[i].name);
-         bitmaps[i].name = NULL;
-         al_destroy_bitmap(bitmaps[i].bitmap[bmp_type]);
-         bitmaps[i].bitmap[bmp_type] = NULL;
-      }
-   }
-
-   /* Free transform names. */
-   for (i = 0; i < MAX_TRANS; i++) {
-      al_ustr_free(transforms[i].name);
-      transforms[i].name = NULL;
-   }
+   free_test_data(bmp_type);
 
    return good;
-#undef MAXBUF
 }
 
 static void sw_hw_test(ALLEGRO_CONFIG *cfg, char const *testname)
@@ -1607,6 +1919,293 @@ static void sw_hw_test(ALLEGRO_CONFIG *cfg, char const *testname)
    }
 }
 
+static int get_bench_flags(ALLEGRO_CONFIG const *cfg, char const *section)
+{
+   char const *value = al_get_config_value(cfg, section, "flags");
+   int flags = 0;
+   char buf[256];
+   char *tok;
+
+   if (!value)
+      return ALLEGRO_NO_PREMULTIPLIED_ALPHA;
+
+   snprintf(buf, sizeof(buf), "%s", value);
+   for (tok = strtok(buf, "|"); tok; tok = strtok(NULL, "|")) {
+      flags |= get_load_bitmap_flag(tok);
+   }
+   return flags;
+}
+
+/* Decodes the image repeatedly for at least min_time seconds.  The file is
+ * mapped once up front so that only the decoder is measured, not the disk.
+ * Returns the number of loads per second, or 0 on failure.
+ */
+static double time_loads(ALLEGRO_FILE *fp, char const *ident, int flags,
+   double min_time, int *w, int *h, int *loads)
+{
+   ALLEGRO_BITMAP *bmp;
+   double start = al_get_time();
+   double elapsed;
+   int n = 0;
+
+   do {
+      al_fseek(fp, 0, ALLEGRO_SEEK_SET);
+      bmp = al_load_bitmap_flags_f(fp, ident, flags);
+      if (!bmp)
+         return 0;
+      *w = al_get_bitmap_width(bmp);
+      *h = al_get_bitmap_height(bmp);
+      al_destroy_bitmap(bmp);
+      n++;
+      elapsed = al_get_time() - start;
+   } while (elapsed < min_time);
+
+   *loads = n;
+   return n / elapsed;
+}
+
+static bool check_baseline(char const *section, char const *key,
+   double pixels_per_sec, double tolerance)
+{
+   char const *value;
+   double base;
+
+   if (!baseline)
+      return true;
+
+   value = al_get_config_value(baseline, section, key);
+   if (!value) {
+      printf("  (no baseline)\n");
+      return true;
+   }
+
+   base = atof(value);
+   if (base <= 0)
+      return true;
+
+   printf("  baseline %.2f Mpixels/s (%+.1f%%)\n", base / 1e6,
+      100.0 * (pixels_per_sec - base) / base);
+   return pixels_per_sec >= base * (1.0 - tolerance);
+}
+
+static void bench_format(ALLEGRO_CONFIG *cfg, char const *section,
+   ALLEGRO_FILE *fp, char const *ident, int64_t file_size, int flags,
+   char const *format, BmpType bmp_type)
+{
+   char const *v;
+   double min_time = 0.5;
+   double tolerance = 0.25;
+   double loads_per_sec;
+   double pixels_per_sec;
+   int w = 0, h = 0, loads = 0;
+   char key[128];
+   char buf[64];
+
+   v = al_get_config_value(cfg, section, "min_time");
+   if (v)
+      min_time = atof(v);
+   v = al_get_config_value(cfg, section, "bench_tolerance");
+   if (v)
+      tolerance = atof(v);
+
+   al_set_new_bitmap_format(get_pixel_format(format));
+   loads_per_sec = time_loads(fp, ident, flags, min_time, &w, &h, &loads);
+   al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ANY_WITH_ALPHA);
+
+   total_tests++;
+
+   if (loads_per_sec == 0) {
+      printf("FAIL %s [%s] %s: failed to load\n", section,
+         bmp_type_to_string(bmp_type), format);
+      failed_tests++;
+      return;
+   }
+
+   pixels_per_sec = loads_per_sec * w * h;
+   printf("%s [%s] %s: %.2f MB/s, %.2f Mpixels/s (%dx%d, %d loads)\n",
+      section, bmp_type_to_string(bmp_type), format,
+      loads_per_sec * file_size / 1e6, pixels_per_sec / 1e6, w, h, loads);
+
+   snprintf(key, sizeof(key), "%s %s", bmp_type_to_string(bmp_type), format);
+   if (check_baseline(section, key, pixels_per_sec, tolerance)) {
+      passed_tests++;
+   }
+   else {
+      printf("FAIL %s [%s] %s: slower than baseline by more than %.0f%%\n",
+         section, bmp_type_to_string(bmp_type), format, tolerance * 100);
+      failed_tests++;
+   }
+
+   if (bench_results) {
+      snprintf(buf, sizeof(buf), "%.0f", pixels_per_sec);
+      al_set_config_value(bench_results, section, key, buf);
+   }
+}
+
+static void bench_type(ALLEGRO_CONFIG *cfg, char const *section,
+   BmpType bmp_type)
+{
+   char const *filename = al_get_config_value(cfg, section, "filename");
+   char const *formats = al_get_config_value(cfg, section, "formats");
+   int flags = get_bench_flags(cfg, section);
+   char const *ident;
+   ALLEGRO_FILE *fp;
+   int64_t file_size;
+   char buf[1024];
+   char *tok;
+
+   if (!filename)
+      fatal_error("missing filename in section: %s", section);
+
+   fp = al_fopen_mmap(filename);
+   if (!fp) {
+      printf("WARNING: Skipping benchmark, could not open %s: %s\n",
+         filename, section);
+      skipped_tests++;
+      return;
+   }
+   file_size = al_fsize(fp);
+
+   ident = al_identify_bitmap_f(fp);
+   if (!ident)
+      ident = strrchr(filename, '.');
+   if (!ident) {
+      printf("WARNING: Skipping benchmark, unknown image type: %s\n", section);
+      skipped_tests++;
+      al_fclose(fp);
+      return;
+   }
+
+   if (verbose) {
+      printf("\nRunning %s [%s].\n", section, bmp_type_to_string(bmp_type));
+      fflush(stdout);
+   }
+
+   snprintf(buf, sizeof(buf), "%s",
+      formats ? formats : "ALLEGRO_PIXEL_FORMAT_ANY_WITH_ALPHA");
+   for (tok = strtok(buf, " ,"); tok; tok = strtok(NULL, " ,")) {
+      bench_format(cfg, section, fp, ident, file_size, flags, tok, bmp_type);
+   }
+
+   al_fclose(fp);
+}
+
+static void bench_test(ALLEGRO_CONFIG *cfg, char const *section)
+{
+   char const *hw_only_str = al_get_config_value(cfg, section, "hw_only");
+   char const *sw_only_str = al_get_config_value(cfg, section, "sw_only");
+   bool hw_only = hw_only_str && get_bool(hw_only_str);
+   bool sw_only = sw_only_str && get_bool(sw_only_str);
+
+   if (!hw_only) {
+      al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+      bench_type(cfg, section, SW);
+   }
+
+   if (sw_only) return;
+
+   if (display) {
+      al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
+      bench_type(cfg, section, HW);
+   } else if (hw_only) {
+      printf("WARNING: Skipping hardware-only benchmark due to the --no-display flag: %s\n",
+             section);
+      skipped_tests++;
+   }
+}
+
+/* Runs the statements of a test which was just checked another 'repeat'
+ * times and reports the time per statement and per pixel of the target.
+ * The pixel rate is compared against the baseline like those of the image
+ * benchmarks.
+ */
+static void time_draw_type(ALLEGRO_CONFIG *cfg, char const *section,
+   ALLEGRO_BITMAP *target, BmpType bmp_type)
+{
+   char const *v;
+   double tolerance = 0.25;
+   double pixels = al_get_bitmap_width(target) * al_get_bitmap_height(target);
+   double start;
+   double elapsed;
+   double pixels_per_sec;
+   int num_stmts = 0;
+   char key[128];
+   char buf[64];
+   int i;
+
+   v = al_get_config_value(cfg, section, "bench_tolerance");
+   if (v)
+      tolerance = atof(v);
+
+   start = al_get_time();
+   for (i = 0; i < repeat; i++) {
+      set_target_reset(target);
+      num_stmts = run_statements(cfg, section, target, bmp_type);
+      al_set_target_bitmap(display ? al_get_backbuffer(display) : NULL);
+      free_test_data(bmp_type);
+   }
+   if (bmp_type == HW) {
+      /* Wait for the drawing to finish. */
+      if (al_lock_bitmap_region(target, 0, 0, 1, 1, ALLEGRO_PIXEL_FORMAT_ANY,
+            ALLEGRO_LOCK_READONLY)) {
+         al_unlock_bitmap(target);
+      }
+   }
+   elapsed = al_get_time() - start;
+   if (elapsed <= 0.0)
+      elapsed = 1e-9;
+   if (num_stmts < 1)
+      num_stmts = 1;
+
+   total_tests++;
+
+   pixels_per_sec = repeat * pixels / elapsed;
+   printf("%s [%s]: %.2f us per statement, %.3f ns per pixel (%d runs)\n",
+      section, bmp_type_to_string(bmp_type),
+      1e6 * elapsed / (repeat * num_stmts),
+      1e9 * elapsed / (repeat * pixels), repeat);
+
+   snprintf(key, sizeof(key), "%s draw", bmp_type_to_string(bmp_type));
+   if (check_baseline(section, key, pixels_per_sec, tolerance)) {
+      passed_tests++;
+   }
+   else {
+      printf("FAIL %s [%s]: slower than baseline by more than %.0f%%\n",
+         section, bmp_type_to_string(bmp_type), tolerance * 100);
+      failed_tests++;
+   }
+
+   if (bench_results) {
+      snprintf(buf, sizeof(buf), "%.0f", pixels_per_sec);
+      al_set_config_value(bench_results, section, key, buf);
+   }
+}
+
+static void time_draw_test(ALLEGRO_CONFIG *cfg, char const *section)
+{
+   char const *hw_only_str = al_get_config_value(cfg, section, "hw_only");
+   char const *sw_only_str = al_get_config_value(cfg, section, "sw_only");
+   char const *skip_on_xvfb_str = al_get_config_value(cfg, section, "skip_on_xvfb");
+   bool hw_only = hw_only_str && get_bool(hw_only_str);
+   bool sw_only = sw_only_str && get_bool(sw_only_str);
+   bool skip_on_xvfb = skip_on_xvfb_str && get_bool(skip_on_xvfb_str);
+
+   if (skip_on_xvfb && on_xvfb)
+      return;
+
+   if (!hw_only) {
+      al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+      time_draw_type(cfg, section, membuf, SW);
+   }
+
+   if (sw_only) return;
+
+   if (display) {
+      al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
+      time_draw_type(cfg, section, al_get_backbuffer(display), HW);
+   }
+}
+
 static bool section_exists(ALLEGRO_CONFIG const *cfg, char const *section)
 {
    ALLEGRO_CONFIG_ENTRY *iter;
@@ -1656,7 +2255,14 @@ static void run_test(ALLEGRO_CONFIG const *cfg, char const *section)
    if (extend) {
       merge_config_sections(cfg2, section, cfg, section);
    }
-   sw_hw_test(cfg2, section);
+   if (benchmark) {
+      bench_test(cfg2, section);
+   }
+   else {
+      sw_hw_test(cfg2, section);
+      if (repeat > 0)
+         time_draw_test(cfg2, section);
+   }
    al_destroy_config(cfg2);
 }
 
@@ -1677,15 +2283,16 @@ static void run_matching_tests(ALLEGRO_CONFIG const *cfg, const char *prefix)
 static void partial_tests(ALLEGRO_CONFIG const *cfg, int n)
 {
    ALLEGRO_USTR *name = al_ustr_new("");
+   char const *prefix = benchmark ? "bench " : "test ";
 
    while (n > 0) {
-      /* Automatically prepend "test" for convenience. */
-      if (0 == strncmp(argv[0], "test ", 5)) {
+      /* Automatically prepend "test" (or "bench") for convenience. */
+      if (0 == strncmp(argv[0], prefix, strlen(prefix))) {
          al_ustr_assign_cstr(name, argv[0]);
       }
       else {
          al_ustr_truncate(name, 0);
-         al_ustr_appendf(name, "test %s", argv[0]);
+         al_ustr_appendf(name, "%s%s", prefix, argv[0]);
       }
 
       /* Star suffix means run all matching tests. */
@@ -1745,7 +2352,7 @@ static void process_ini_files(void)
       }
 
       if (n == 0)
-         run_matching_tests(cfg, "test ");
+         run_matching_tests(cfg, benchmark ? "bench " : "test ");
       else
          partial_tests(cfg, n);
 
@@ -1763,6 +2370,10 @@ const char* help_str =
 "file, but individual TEST_NAMEs can be specified after each CONFIG_FILE.\n"
 "\n"
 "Options:\n"
+" -b, --benchmark       time the [bench ...] sections instead of running tests\n"
+" --baseline FILE       fail benchmarks which are slower than in FILE\n"
+" --save-baseline FILE  save benchmark results to FILE\n"
+" -r, --repeat N        time each test by running it N more times\n"
 " -d, --delay           duration (in sec) to wait between tests\n"
 " --force-d3d           force using D3D (Windows only)\n"
 " --force-opengl-1.2    force using OpenGL 1.2\n"
@@ -1803,6 +2414,24 @@ int main(int _argc, char *_argv[])
       if (streq(opt, "-d") || streq(opt, "--delay")) {
          delay = 1.0;
       }
+      else if (streq(opt, "-b") || streq(opt, "--benchmark")) {
+         benchmark = true;
+      }
+      else if ((streq(opt, "-r") || streq(opt, "--repeat")) && argc > 1) {
+         repeat = atoi(argv[1]);
+         argc--;
+         argv++;
+      }
+      else if (streq(opt, "--baseline") && argc > 1) {
+         baseline_file = argv[1];
+         argc--;
+         argv++;
+      }
+      else if (streq(opt, "--save-baseline") && argc > 1) {
+         save_baseline_file = argv[1];
+         argc--;
+         argv++;
+      }
       else if (streq(opt, "-s") || streq(opt, "--save")) {
          save_outputs = true;
       }
@@ -1871,8 +2500,24 @@ int main(int _argc, char *_argv[])
       membuf = al_create_bitmap(640, 480);
    }
 
+   if (baseline_file) {
+      baseline = al_load_config_file(baseline_file);
+      if (!baseline)
+         fatal_error("failed to load baseline file %s", baseline_file);
+   }
+   if (save_baseline_file) {
+      bench_results = al_create_config();
+   }
+
    process_ini_files();
 
+   if (bench_results) {
+      if (!al_save_config_file(save_baseline_file, bench_results))
+         fatal_error("failed to save baseline file %s", save_baseline_file);
+      al_destroy_config(bench_results);
+   }
+   al_destroy_config(baseline);
+
    printf("\n");
    printf("total tests:  %d\n", total_tests);
    printf("passed tests: %d\n", passed_tests);